@@ -38,6 +38,7 @@
 #include <queue>
 #include <sstream>
 #include <string>
+#include <thread>
 
 AuditImpl::AuditImpl(std::string config_file,
                      ServerCookieIface* sapi,
@@ -339,15 +340,8 @@ bool AuditImpl::put_event(uint32_t event_id, cb::const_char_buffer payload) {
     //       in the correct fields.. if not we should add an
     //       event to the audit trail saying it is one in an illegal
     //       format (or missing fields)
-    try {
-        auto new_event = std::make_unique<Event>(event_id, payload);
-        std::lock_guard<std::mutex> guard(producer_consumer_lock);
-        if (filleventqueue.size() < max_audit_queue) {
-            filleventqueue.push(std::move(new_event));
-            events_arrived.notify_all();
-            return true;
-        }
-    } catch (const std::bad_alloc&) {
+    if (queue_event(event_id, payload)) {
+        return true;
     }
 
     dropped_events++;
@@ -357,11 +351,44 @@ bool AuditImpl::put_event(uint32_t event_id, cb::const_char_buffer payload) {
     return false;
 }
 
+bool AuditImpl::queue_event(uint32_t event_id, cb::const_char_buffer payload) {
+    if (queued_events.fetch_add(1) >= max_audit_queue) {
+        queued_events--;
+        return false;
+    }
+
+    static thread_local const size_t index =
+            std::hash<std::thread::id>()(std::this_thread::get_id()) %
+            num_event_queues;
+    auto& queue = event_queues[index];
+
+    const EventRecordHeader header{event_id, uint32_t(payload.size())};
+    try {
+        std::lock_guard<std::mutex> guard(queue.mutex);
+        queue.records.append(reinterpret_cast<const char*>(&header),
+                             sizeof(header));
+        queue.records.append(payload.data(), payload.size());
+    } catch (const std::bad_alloc&) {
+        queued_events--;
+        return false;
+    }
+
+    if (!events_pending.exchange(true)) {
+        // The consumer may be waiting for events; it checks events_pending
+        // with producer_consumer_lock held, so hold it while notifying to
+        // make sure the wakeup isn't lost.
+        std::lock_guard<std::mutex> guard(producer_consumer_lock);
+        events_arrived.notify_all();
+    }
+    return true;
+}
+
 bool AuditImpl::configure_auditdaemon(const std::string& configfile,
                                       gsl::not_null<const void*> cookie) {
     auto new_event = std::make_unique<ConfigureEvent>(configfile, cookie.get());
     std::lock_guard<std::mutex> guard(producer_consumer_lock);
     filleventqueue.push(std::move(new_event));
+    events_pending = true;
     events_arrived.notify_all();
     return true;
 }
@@ -405,6 +432,43 @@ void AuditImpl::stats(const AddStatFn& add_stats,
               num_of_dropped_events.data(),
               (uint32_t)num_of_dropped_events.length(),
               cookie.get());
+    const auto num_of_queued_events = std::to_string(queued_events);
+    add_stats("queued_events",
+              (uint16_t)strlen("queued_events"),
+              num_of_queued_events.data(),
+              (uint32_t)num_of_queued_events.length(),
+              cookie.get());
+}
+
+void AuditImpl::process_queued_events() {
+    for (auto& queue : event_queues) {
+        {
+            std::lock_guard<std::mutex> guard(queue.mutex);
+            if (queue.records.empty()) {
+                continue;
+            }
+            process_records.swap(queue.records);
+        }
+
+        size_t count = 0;
+        size_t offset = 0;
+        while (offset < process_records.size()) {
+            EventRecordHeader header;
+            std::memcpy(&header,
+                        process_records.data() + offset,
+                        sizeof(header));
+            offset += sizeof(header);
+            Event event(header.id,
+                        {process_records.data() + offset, header.size});
+            offset += header.size;
+            ++count;
+            if (!event.process(*this)) {
+                dropped_events++;
+            }
+        }
+        queued_events -= count;
+        process_records.clear();
+    }
 }
 
 void AuditImpl::consume_events() {
@@ -413,11 +477,12 @@ void AuditImpl::consume_events() {
     events_arrived.notify_one();
 
     while (!stop_audit_consumer) {
-        if (filleventqueue.empty()) {
-            events_arrived.wait_for(
+        if (!events_pending) {
+            const bool arrived = events_arrived.wait_for(
                     lock,
-                    std::chrono::seconds(auditfile.get_seconds_to_rotation()));
-            if (filleventqueue.empty()) {
+                    std::chrono::seconds(auditfile.get_seconds_to_rotation()),
+                    [this] { return events_pending || stop_audit_consumer; });
+            if (!arrived) {
                 // We timed out, so just rotate the files
                 if (auditfile.maybe_rotate_files()) {
                     // If the file was rotated then we need to open a new
@@ -429,10 +494,12 @@ void AuditImpl::consume_events() {
         /* now have producer_consumer lock!
          * event(s) have arrived or shutdown requested
          */
+        events_pending = false;
         processeventqueue.swap(filleventqueue);
         lock.unlock();
         // Now outside of the producer_consumer_lock
 
+        process_queued_events();
         while (!processeventqueue.empty()) {
             auto& event = processeventqueue.front();
             if (!event->process(*this)) {
@@ -443,6 +510,11 @@ void AuditImpl::consume_events() {
         auditfile.flush();
         lock.lock();
     }
+    lock.unlock();
+
+    // Don't lose the events queued while we processed the last batch
+    // (such as the shutdown event)
+    process_queued_events();
 
     // close the auditfile
     auditfile.close();
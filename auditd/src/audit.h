@@ -24,12 +24,14 @@
 #include <memcached/audit_interface.h>
 #include <platform/platform_thread.h>
 
+#include <array>
 #include <atomic>
 #include <cinttypes>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <string>
 #include <unordered_map>
 
 class AuditImpl : public cb::audit::Audit {
@@ -127,9 +129,55 @@ protected:
     /// The consumer should run until this flag is set to true
     bool stop_audit_consumer = {false};
 
-    // We maintain two Event queues. At any one time one will be used to accept
-    // new events, and the other will be processed. The two queues are swapped
-    // periodically.
+    /**
+     * A queue of audit events submitted through put_event(). To avoid an
+     * allocation per event the events are appended to a single buffer as
+     * compact records (an EventRecordHeader followed by the payload), which
+     * the consumer swaps out and processes as one batch.
+     */
+    struct alignas(64) EventQueue {
+        std::mutex mutex;
+        std::string records;
+    };
+
+    struct EventRecordHeader {
+        uint32_t id;
+        uint32_t size;
+    };
+
+    /**
+     * Append the event to the producer queue used by the calling thread
+     *
+     * @return true if the event was queued, false if it should be dropped
+     */
+    bool queue_event(uint32_t event_id, cb::const_char_buffer payload);
+
+    /**
+     * Process all of the events currently queued in the producer queues
+     */
+    void process_queued_events();
+
+    /// The number of producer queues. Each thread appends to the one
+    /// selected by its thread id, so front-end threads rarely contend
+    /// with each other (or with the consumer).
+    static const size_t num_event_queues = 16;
+    std::array<EventQueue, num_event_queues> event_queues;
+
+    /// The records swapped out of a producer queue by the consumer (kept
+    /// between batches so that its capacity is reused)
+    std::string process_records;
+
+    /// The number of events currently queued in the producer queues
+    std::atomic<size_t> queued_events = {0};
+
+    /// Set when events have been queued since the consumer last looked;
+    /// only the producer which sets it needs to wake the consumer
+    std::atomic<bool> events_pending = {false};
+
+    // We maintain two queues of the events which are not plain audit
+    // events (i.e. configure requests). At any one time one will be used to
+    // accept new events, and the other will be processed. The two queues are
+    // swapped periodically.
     std::queue<std::unique_ptr<Event>> processeventqueue;
     std::queue<std::unique_ptr<Event>> filleventqueue;
     std::condition_variable events_arrived;
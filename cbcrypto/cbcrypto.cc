@@ -19,7 +19,11 @@
 #include <nlohmann/json.hpp>
 #include <phosphor/phosphor.h>
 #include <platform/base64.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <iomanip>
+#include <limits>
 #include <memory>
 #include <sstream>
 #include <stdexcept>
@@ -372,6 +376,123 @@ std::string decrypt(const cb::crypto::Cipher cipher,
     return AES_256_cbc(false, key, iv, data);
 }
 
+/**
+ * AES-256-CTR keystream for cb::crypto::StreamCipher. BCrypt has no CTR
+ * chaining mode, so the counter blocks are encrypted with AES-256-ECB (a
+ * batch of them at a time) and the result XORed with the data.
+ */
+class CtrStream {
+public:
+    CtrStream(cb::const_char_buffer key, cb::const_char_buffer iv) {
+        auto status = BCryptOpenAlgorithmProvider(
+                &hAlg, BCRYPT_AES_ALGORITHM, nullptr, 0);
+        if (status < 0) {
+            throw std::runtime_error(
+                    "cb::crypto::StreamCipher: BCryptOpenAlgorithmProvider() "
+                    "return: " +
+                    std::to_string(status));
+        }
+
+        status = BCryptSetProperty(hAlg,
+                                   BCRYPT_CHAINING_MODE,
+                                   (PBYTE)BCRYPT_CHAIN_MODE_ECB,
+                                   sizeof(BCRYPT_CHAIN_MODE_ECB),
+                                   0);
+        if (status < 0) {
+            BCryptCloseAlgorithmProvider(hAlg, 0);
+            throw std::runtime_error(
+                    "cb::crypto::StreamCipher: BCryptSetProperty() return: " +
+                    std::to_string(status));
+        }
+
+        // Let BCrypt allocate (and free) the key object
+        status = BCryptGenerateSymmetricKey(hAlg,
+                                            &hKey,
+                                            nullptr,
+                                            0,
+                                            (PBYTE)key.data(),
+                                            ULONG(key.size()),
+                                            0);
+        if (status < 0) {
+            BCryptCloseAlgorithmProvider(hAlg, 0);
+            throw std::runtime_error(
+                    "cb::crypto::StreamCipher: BCryptGenerateSymmetricKey() "
+                    "return: " +
+                    std::to_string(status));
+        }
+
+        setCounter(reinterpret_cast<const uint8_t*>(iv.data()));
+    }
+
+    CtrStream(const CtrStream&) = delete;
+    CtrStream& operator=(const CtrStream&) = delete;
+
+    ~CtrStream() {
+        BCryptDestroyKey(hKey);
+        BCryptCloseAlgorithmProvider(hAlg, 0);
+    }
+
+    /// Restart the keystream at the given (16 byte) counter block
+    void setCounter(const uint8_t* counter) {
+        std::memcpy(this->counter.data(), counter, this->counter.size());
+        next = end = 0;
+    }
+
+    void update(const uint8_t* in, size_t len, uint8_t* out) {
+        for (size_t ii = 0; ii < len; ++ii) {
+            if (next == end) {
+                refill();
+            }
+            out[ii] = in[ii] ^ keystream[next++];
+        }
+    }
+
+private:
+    /// Generate the keystream of the next batch of counter blocks
+    void refill() {
+        for (size_t offset = 0; offset < keystream.size();
+             offset += counter.size()) {
+            std::memcpy(keystream.data() + offset,
+                        counter.data(),
+                        counter.size());
+            // The counter is a 128 bit big endian integer
+            for (int ii = int(counter.size()) - 1; ii >= 0; --ii) {
+                if (++counter[ii] != 0) {
+                    break;
+                }
+            }
+        }
+
+        ULONG cbResult = 0;
+        const auto status = BCryptEncrypt(hKey,
+                                          keystream.data(),
+                                          ULONG(keystream.size()),
+                                          nullptr,
+                                          nullptr,
+                                          0,
+                                          keystream.data(),
+                                          ULONG(keystream.size()),
+                                          &cbResult,
+                                          0);
+        if (status < 0 || cbResult != keystream.size()) {
+            throw std::runtime_error(
+                    "cb::crypto::StreamCipher: BCryptEncrypt() return: " +
+                    std::to_string(status));
+        }
+        next = 0;
+        end = keystream.size();
+    }
+
+    BCRYPT_ALG_HANDLE hAlg;
+    BCRYPT_KEY_HANDLE hKey;
+    /// The counter block which the next batch of keystream starts at
+    std::array<uint8_t, 16> counter;
+    /// A batch of keystream; the bytes from next to end are unused
+    std::array<uint8_t, 64 * 16> keystream;
+    size_t next = 0;
+    size_t end = 0;
+};
+
 #elif defined(__APPLE__)
 
 #include <CommonCrypto/CommonCryptor.h>
@@ -567,6 +688,9 @@ static void validateEncryptionCipher(const cb::crypto::Cipher cipher,
                     std::to_string(iv.size()));
         }
         return;
+    case cb::crypto::Cipher::AES_256_ctr:
+        // Only supported by StreamCipher
+        break;
     }
 
     throw std::invalid_argument(
@@ -642,6 +766,65 @@ std::string decrypt(const cb::crypto::Cipher cipher,
     return ret;
 }
 
+/**
+ * AES-256-CTR keystream for cb::crypto::StreamCipher, over a CommonCrypto
+ * cryptor.
+ */
+class CtrStream {
+public:
+    CtrStream(cb::const_char_buffer key, cb::const_char_buffer iv)
+        : key(key.data(), key.size()) {
+        setCounter(reinterpret_cast<const uint8_t*>(iv.data()));
+    }
+
+    ~CtrStream() {
+        if (cryptor != nullptr) {
+            CCCryptorRelease(cryptor);
+        }
+    }
+
+    /// Restart the keystream at the given (16 byte) counter block
+    void setCounter(const uint8_t* counter) {
+        // A CTR cryptor's counter can't be reset, so make a new one
+        if (cryptor != nullptr) {
+            CCCryptorRelease(cryptor);
+            cryptor = nullptr;
+        }
+        auto status = CCCryptorCreateWithMode(kCCEncrypt,
+                                              kCCModeCTR,
+                                              kCCAlgorithmAES,
+                                              ccNoPadding,
+                                              counter,
+                                              key.data(),
+                                              key.size(),
+                                              nullptr,
+                                              0,
+                                              0,
+                                              kCCModeOptionCTR_BE,
+                                              &cryptor);
+        if (status != kCCSuccess) {
+            throw std::runtime_error(
+                    "cb::crypto::StreamCipher: CCCryptorCreateWithMode "
+                    "failed: " +
+                    std::to_string(status));
+        }
+    }
+
+    void update(const uint8_t* in, size_t len, uint8_t* out) {
+        size_t moved = 0;
+        auto status = CCCryptorUpdate(cryptor, in, len, out, len, &moved);
+        if (status != kCCSuccess || moved != len) {
+            throw std::runtime_error(
+                    "cb::crypto::StreamCipher: CCCryptorUpdate failed: " +
+                    std::to_string(status));
+        }
+    }
+
+private:
+    const std::string key;
+    CCCryptorRef cryptor = nullptr;
+};
+
 #else
 
 #include <openssl/evp.h>
@@ -846,6 +1029,9 @@ static const EVP_CIPHER* getCipher(const cb::crypto::Cipher cipher,
     case cb::crypto::Cipher::AES_256_cbc:
         cip = EVP_aes_256_cbc();
         break;
+    case cb::crypto::Cipher::AES_256_ctr:
+        // Only supported by StreamCipher
+        break;
     }
 
     if (cip == nullptr) {
@@ -966,6 +1152,55 @@ std::string decrypt(const cb::crypto::Cipher cipher,
     return ret;
 }
 
+/**
+ * AES-256-CTR keystream for cb::crypto::StreamCipher, over an EVP context
+ * (which uses AES-NI where the CPU has it).
+ */
+class CtrStream {
+public:
+    CtrStream(cb::const_char_buffer key, cb::const_char_buffer iv)
+        : ctx(EVP_CIPHER_CTX_new()) {
+        if (!ctx ||
+            EVP_EncryptInit_ex(ctx.get(),
+                               EVP_aes_256_ctr(),
+                               nullptr,
+                               reinterpret_cast<const uint8_t*>(key.data()),
+                               reinterpret_cast<const uint8_t*>(iv.data())) !=
+                    1) {
+            throw std::runtime_error(
+                    "cb::crypto::StreamCipher: EVP_EncryptInit_ex failed");
+        }
+    }
+
+    /// Restart the keystream at the given (16 byte) counter block
+    void setCounter(const uint8_t* counter) {
+        // Only the counter is changed; the key schedule is kept
+        if (EVP_EncryptInit_ex(ctx.get(), nullptr, nullptr, nullptr, counter) !=
+            1) {
+            throw std::runtime_error(
+                    "cb::crypto::StreamCipher: EVP_EncryptInit_ex failed");
+        }
+    }
+
+    void update(const uint8_t* in, size_t len, uint8_t* out) {
+        while (len > 0) {
+            const int chunk = int(std::min(len, size_t(1) << 30));
+            int outlen = 0;
+            if (EVP_EncryptUpdate(ctx.get(), out, &outlen, in, chunk) != 1 ||
+                outlen != chunk) {
+                throw std::runtime_error(
+                        "cb::crypto::StreamCipher: EVP_EncryptUpdate failed");
+            }
+            in += chunk;
+            out += chunk;
+            len -= chunk;
+        }
+    }
+
+private:
+    unique_EVP_CIPHER_CTX_ptr ctx;
+};
+
 #endif
 
 } // namespace internal
@@ -1167,3 +1402,74 @@ cb::crypto::Cipher cb::crypto::to_cipher(const std::string& str) {
 
     throw std::invalid_argument("to_cipher: Unknown cipher: " + str);
 }
+
+struct cb::crypto::StreamCipher::Impl : public internal::CtrStream {
+    Impl(cb::const_char_buffer key, cb::const_char_buffer iv)
+        : CtrStream(key, iv) {
+        std::memcpy(this->iv.data(), iv.data(), this->iv.size());
+    }
+
+    std::array<uint8_t, 16> iv;
+    /// The offset in the stream the keystream is at
+    uint64_t position = 0;
+};
+
+cb::crypto::StreamCipher::StreamCipher(const Cipher cipher,
+                                       cb::const_char_buffer key,
+                                       cb::const_char_buffer iv) {
+    if (cipher != Cipher::AES_256_ctr) {
+        throw std::invalid_argument(
+                "cb::crypto::StreamCipher(): Unsupported cipher");
+    }
+
+    if (key.size() != 32) {
+        throw std::invalid_argument(
+                "cb::crypto::StreamCipher(): Invalid key size: " +
+                std::to_string(key.size()) + " (expected 32)");
+    }
+
+    if (iv.size() != 16) {
+        throw std::invalid_argument(
+                "cb::crypto::StreamCipher(): Invalid iv size: " +
+                std::to_string(iv.size()) + " (expected 16)");
+    }
+
+    impl = std::make_unique<Impl>(key, iv);
+}
+
+cb::crypto::StreamCipher::~StreamCipher() = default;
+
+void cb::crypto::StreamCipher::process(uint64_t offset,
+                                       cb::const_char_buffer in,
+                                       cb::char_buffer out) {
+    if (out.size() < in.size()) {
+        throw std::invalid_argument(
+                "cb::crypto::StreamCipher::process(): out is smaller than in");
+    }
+
+    if (offset != impl->position) {
+        // Restart the keystream at the counter of offset's block (the IV
+        // plus the block's index, as a 128 bit big endian integer), and
+        // skip to offset within the block.
+        std::array<uint8_t, 16> counter;
+        uint64_t blocks = offset / 16;
+        unsigned int carry = 0;
+        for (int ii = 15; ii >= 0; --ii) {
+            const unsigned int sum =
+                    impl->iv[ii] + unsigned(blocks & 0xff) + carry;
+            counter[ii] = uint8_t(sum);
+            carry = sum >> 8;
+            blocks >>= 8;
+        }
+        impl->setCounter(counter.data());
+        std::array<uint8_t, 16> skip{};
+        impl->update(skip.data(), offset % 16, skip.data());
+    }
+
+    // Until the update succeeds, where the keystream is at is unknown
+    impl->position = std::numeric_limits<uint64_t>::max();
+    impl->update(reinterpret_cast<const uint8_t*>(in.data()),
+                 in.size(),
+                 reinterpret_cast<uint8_t*>(out.data()));
+    impl->position = offset + in.size();
+}
@@ -678,3 +678,66 @@ TEST(Crypt, ns_server_password_encoding) {
               Couchbase::Base64::encode(
                       std::string{(const char*)pwent.data(), pwent.size()}));
 }
+
+static std::string fromHex(const std::string& hex) {
+    std::string ret;
+    for (size_t ii = 0; ii < hex.size(); ii += 2) {
+        ret.push_back(char(std::stoi(hex.substr(ii, 2), nullptr, 16)));
+    }
+    return ret;
+}
+
+// The CTR-AES256 test vectors of NIST SP 800-38A (F.5.5), where the
+// counter of the second block carries over from the last byte.
+static const std::string ctrKey = fromHex(
+        "603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4");
+static const std::string ctrIv = fromHex("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff");
+static const std::string ctrPlain = fromHex(
+        "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+        "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710");
+static const std::string ctrCipher = fromHex(
+        "601ec313775789a5b7a7f504bbf3d228f443e3ca4d62b59aca84e990cacaf5c5"
+        "2b0930daa23de94ce87017ba2d84988ddfc9c58db67aada613c2dd08457941a6");
+
+TEST(StreamCipher, AES_256_ctr) {
+    crypto::StreamCipher cipher(crypto::Cipher::AES_256_ctr, ctrKey, ctrIv);
+    std::string data = ctrPlain;
+    cipher.process(0, {&data[0], data.size()});
+    EXPECT_EQ(ctrCipher, data);
+
+    // Decrypting is the same operation
+    cipher.process(0, {&data[0], data.size()});
+    EXPECT_EQ(ctrPlain, data);
+}
+
+// Any range of the stream can be processed on its own, in any order.
+TEST(StreamCipher, AES_256_ctr_random_access) {
+    crypto::StreamCipher cipher(crypto::Cipher::AES_256_ctr, ctrKey, ctrIv);
+    std::string out(ctrPlain.size(), '\0');
+    const std::pair<size_t, size_t> ranges[] = {
+            {40, 24}, {0, 5}, {5, 11}, {16, 17}, {33, 7}};
+    for (const auto& r : ranges) {
+        cipher.process(r.first,
+                       {ctrPlain.data() + r.first, r.second},
+                       {&out[r.first], r.second});
+    }
+    EXPECT_EQ(ctrCipher, out);
+}
+
+TEST(StreamCipher, InvalidArguments) {
+    const std::string key(32, '\0');
+    const std::string iv(16, '\0');
+    EXPECT_THROW(crypto::StreamCipher(crypto::Cipher::AES_256_cbc, key, iv),
+                 std::invalid_argument);
+    EXPECT_THROW(crypto::StreamCipher(
+                         crypto::Cipher::AES_256_ctr, key.substr(1), iv),
+                 std::invalid_argument);
+    EXPECT_THROW(crypto::StreamCipher(
+                         crypto::Cipher::AES_256_ctr, key, iv.substr(1)),
+                 std::invalid_argument);
+
+    crypto::StreamCipher cipher(crypto::Cipher::AES_256_ctr, key, iv);
+    std::string out(1, '\0');
+    EXPECT_THROW(cipher.process(0, {"ab", 2}, {&out[0], out.size()}),
+                 std::invalid_argument);
+}
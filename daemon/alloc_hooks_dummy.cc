@@ -78,3 +78,8 @@ int DummyAllocHooks::set_allocator_property(const char* name,
                                             size_t newlen) {
     return 1;
 }
+
+bool DummyAllocHooks::get_slab_utilization(const void* ptr,
+                                           allocator_slab_utilization* util) {
+    return false;
+}
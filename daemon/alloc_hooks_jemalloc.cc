@@ -224,3 +224,59 @@ int JemallocHooks::set_allocator_property(const char* name,
                                           size_t newlen) {
     return je_mallctl(name, nullptr, 0, newp, newlen);
 }
+
+bool JemallocHooks::get_slab_utilization(const void* ptr,
+                                         allocator_slab_utilization* util) {
+#if JEMALLOC_VERSION_MAJOR > 5 || \
+        (JEMALLOC_VERSION_MAJOR == 5 && JEMALLOC_VERSION_MINOR >= 2)
+    /* The output of "experimental.utilization.query" */
+    struct {
+        void* slabcur_addr;
+        size_t nfree;
+        size_t nregs;
+        size_t size;
+        size_t bin_nfree;
+        size_t bin_nregs;
+    } out;
+
+    /* This is called for each object the defragmenter visits, so look the
+     * MIB up once rather than parsing the name each time. */
+    static size_t mib[3];
+    static size_t miblen = 0;
+    if (miblen == 0) {
+        size_t len = sizeof(mib) / sizeof(mib[0]);
+        if (je_mallctlnametomib("experimental.utilization.query", mib, &len) !=
+            0) {
+            return false;
+        }
+        miblen = len;
+    }
+
+    size_t outlen = sizeof(out);
+    if (je_mallctlbymib(mib,
+                        miblen,
+                        &out,
+                        &outlen,
+                        (void*)&ptr,
+                        sizeof(ptr)) != 0) {
+        return false;
+    }
+    /* A large allocation (or one jemalloc doesn't own) isn't in a slab */
+    if (out.nregs == 0) {
+        return false;
+    }
+
+    util->nfree = out.nfree;
+    util->nregs = out.nregs;
+    util->size = out.size;
+    util->bin_nfree = out.bin_nfree;
+    util->bin_nregs = out.bin_nregs;
+    const auto* slab = static_cast<const char*>(out.slabcur_addr);
+    util->is_current = slab != nullptr && ptr >= slab &&
+                       ptr < slab + out.nregs * out.size;
+    return true;
+#else
+    /* jemalloc before 5.2 can't query the utilization of a slab */
+    return false;
+#endif
+}
@@ -0,0 +1,138 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "bucket_throttle.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+constexpr std::chrono::milliseconds BucketThrottle::Window;
+
+using namespace std::chrono;
+
+BucketThrottle::Limits BucketThrottle::lookup(const nlohmann::json& config,
+                                              const std::string& bucket) {
+    if (config.is_null()) {
+        return {};
+    }
+    if (!config.is_object()) {
+        throw std::invalid_argument(R"("bucket_throttle" must be an object)");
+    }
+
+    auto iter = config.find(bucket);
+    if (iter == config.end()) {
+        iter = config.find("*");
+        if (iter == config.end()) {
+            return {};
+        }
+    }
+
+    if (!iter->is_object()) {
+        throw std::invalid_argument(R"("bucket_throttle": ")" + iter.key() +
+                                    R"(" must be an object)");
+    }
+
+    Limits limits;
+    for (auto it = iter->begin(); it != iter->end(); ++it) {
+        if (!it->is_number_unsigned()) {
+            throw std::invalid_argument(R"("bucket_throttle": ")" +
+                                        iter.key() + "." + it.key() +
+                                        R"(" must be an unsigned number)");
+        }
+        if (it.key() == "ops_per_sec") {
+            limits.opsPerSec = it->get<uint64_t>();
+        } else if (it.key() == "cpu_usec_per_sec") {
+            limits.cpuPerSec = microseconds(it->get<uint64_t>());
+        } else {
+            throw std::invalid_argument(R"("bucket_throttle": unknown key ")" +
+                                        iter.key() + "." + it.key() + R"(")");
+        }
+    }
+    return limits;
+}
+
+void BucketThrottle::setLimits(const Limits& limits) {
+    opsPerSec.store(limits.opsPerSec);
+    cpuPerSecUsec.store(limits.cpuPerSec.count());
+
+    // Round the commands up so that a small limit doesn't become unlimited
+    opsPerWindow.store((limits.opsPerSec * Window.count() + 999) / 1000);
+    cpuPerWindowNs.store(duration_cast<nanoseconds>(limits.cpuPerSec).count() *
+                         Window.count() / 1000);
+}
+
+BucketThrottle::Limits BucketThrottle::getLimits() const {
+    return {opsPerSec.load(), microseconds(cpuPerSecUsec.load())};
+}
+
+bool BucketThrottle::tryStartCommand() {
+    const auto maxOps = opsPerWindow.load(std::memory_order_relaxed);
+    const auto maxCpu = cpuPerWindowNs.load(std::memory_order_relaxed);
+    if (maxOps == 0 && maxCpu == 0) {
+        return true;
+    }
+
+    maybeStartWindow(steady_clock::now());
+    if (maxCpu != 0 && cpu.load(std::memory_order_relaxed) >= maxCpu) {
+        return false;
+    }
+    // A command refused here is counted too, which is harmless as the
+    // count is dropped when the next window starts
+    return maxOps == 0 || ops.fetch_add(1, std::memory_order_relaxed) < maxOps;
+}
+
+void BucketThrottle::addCpuTime(nanoseconds ns) {
+    if (cpuPerWindowNs.load(std::memory_order_relaxed) != 0) {
+        cpu.fetch_add(ns.count(), std::memory_order_relaxed);
+    }
+}
+
+steady_clock::time_point BucketThrottle::getWindowEnd() const {
+    return steady_clock::time_point(nanoseconds(windowStart.load())) + Window;
+}
+
+void BucketThrottle::reset() {
+    setLimits({});
+    ops.store(0);
+    cpu.store(0);
+    waitTimes.reset();
+}
+
+void BucketThrottle::maybeStartWindow(steady_clock::time_point now) {
+    const int64_t windowNs = duration_cast<nanoseconds>(Window).count();
+    const int64_t nowNs =
+            duration_cast<nanoseconds>(now.time_since_epoch()).count();
+    auto start = windowStart.load();
+    if (nowNs - start < windowNs ||
+        !windowStart.compare_exchange_strong(start, nowNs)) {
+        // The window hasn't ended, or another thread just started the next
+        return;
+    }
+
+    ops.store(0);
+
+    // Every window which has ended pays off a window's budget of the debt
+    // (capped, as the first window "ends" at the epoch of the clock)
+    const auto windows = std::min<int64_t>((nowNs - start) / windowNs, 1000);
+    const uint64_t allowance = cpuPerWindowNs.load() * windows;
+    auto used = cpu.load();
+    while (!cpu.compare_exchange_weak(
+            used, used > allowance ? used - allowance : 0)) {
+    }
+}
@@ -0,0 +1,113 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <nlohmann/json_fwd.hpp>
+#include <utilities/hdrhistogram.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * The front-end budget of a single bucket: how many commands its (non
+ * internal) connections may start, and how much front-end thread time they
+ * may use, per second.
+ *
+ * The budgets are enforced over windows of Window so that a bucket which
+ * has used up its budget only waits a fraction of a second for more. A
+ * connection whose bucket is over budget isn't failed; it's deferred (see
+ * throttle_connection) until the next window starts, leaving the front-end
+ * threads to the connections of the other buckets. CPU time used beyond the
+ * budget of a window is carried over as debt into the next one, so a bucket
+ * running expensive commands gets its fair share over time rather than
+ * overrunning every window by one command.
+ *
+ * All of the members may be used from any front-end thread.
+ */
+class BucketThrottle {
+public:
+    struct Limits {
+        /// The most commands to start per second (0 == unlimited)
+        uint64_t opsPerSec = 0;
+        /// The most front-end thread time to use per second (0 == unlimited)
+        std::chrono::microseconds cpuPerSec{0};
+
+        bool operator==(const Limits& other) const {
+            return opsPerSec == other.opsPerSec && cpuPerSec == other.cpuPerSec;
+        }
+    };
+
+    /// The length of the window the budgets are enforced over
+    static constexpr std::chrono::milliseconds Window{100};
+
+    /**
+     * Get the limits for the named bucket from the "bucket_throttle"
+     * setting: an object mapping a bucket name (or "*" for any bucket not
+     * listed) to an object with the optional (unsigned) members
+     * "ops_per_sec" and "cpu_usec_per_sec".
+     *
+     * @throws std::invalid_argument if the setting is malformed
+     */
+    static Limits lookup(const nlohmann::json& config,
+                         const std::string& bucket);
+
+    void setLimits(const Limits& limits);
+
+    Limits getLimits() const;
+
+    /**
+     * Account for a command about to be started by one of the bucket's
+     * connections.
+     *
+     * @return true if the command may be started now, false if the bucket
+     *         is over budget and the connection should be deferred until
+     *         getWindowEnd()
+     */
+    bool tryStartCommand();
+
+    /// Account for front-end thread time used by the bucket's connections
+    void addCpuTime(std::chrono::nanoseconds ns);
+
+    /// Get when the current window ends (and the budgets are replenished)
+    std::chrono::steady_clock::time_point getWindowEnd() const;
+
+    /// Drop the limits and the usage (the bucket is being deleted)
+    void reset();
+
+    /// How long connections were deferred for each time they were throttled
+    Hdr1sfMicroSecHistogram waitTimes;
+
+protected:
+    /// Start a new window if the current one has ended
+    void maybeStartWindow(std::chrono::steady_clock::time_point now);
+
+    /// The limits (see Limits), and the budgets per window they give
+    std::atomic<uint64_t> opsPerSec{0};
+    std::atomic<uint64_t> opsPerWindow{0};
+    std::atomic<uint64_t> cpuPerSecUsec{0};
+    std::atomic<uint64_t> cpuPerWindowNs{0};
+
+    /// When the current window started (steady_clock ns since its epoch)
+    std::atomic<int64_t> windowStart{0};
+    /// Commands started in the current window
+    std::atomic<uint64_t> ops{0};
+    /// Nanoseconds of CPU time used in the current window (and any debt)
+    std::atomic<uint64_t> cpu{0};
+};
@@ -40,6 +40,23 @@ void Bucket::setEngine(EngineIface* engine) {
     bucketDcp = dynamic_cast<DcpIface*>(engine);
 }
 
+std::array<uint64_t, size_t(cb::mcbp::Status::COUNT)>
+Bucket::getResponseCounters() const {
+    std::array<uint64_t, size_t(cb::mcbp::Status::COUNT)> ret{};
+    for (const auto& slot : responseCounters) {
+        for (size_t ii = 0; ii < ret.size(); ++ii) {
+            ret[ii] += (*slot)[ii].load();
+        }
+    }
+    return ret;
+}
+
+void Bucket::resetResponseCounters() {
+    for (auto& slot : responseCounters) {
+        slot->fill(0);
+    }
+}
+
 namespace BucketValidator {
     bool validateBucketName(const std::string& name, std::string& errors) {
         if (name.empty()) {
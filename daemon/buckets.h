@@ -16,6 +16,7 @@
  */
 #pragma once
 
+#include "bucket_throttle.h"
 #include "cluster_config.h"
 #include "mcbp_validators.h"
 #include "timings.h"
@@ -24,6 +25,8 @@
 #include <memcached/limits.h>
 #include <memcached/server_callback_iface.h>
 #include <memcached/types.h>
+#include <folly/CachelinePadded.h>
+#include <folly/lang/Align.h>
 #include <nlohmann/json_fwd.hpp>
 #include <utilities/hdrhistogram.h>
 
@@ -107,8 +110,14 @@ public:
      * The current state of the bucket. Atomic as we permit it to be
      * read without acquiring the mutex, for example in
      * is_bucket_dying().
+     *
+     * It's read by every command, so it (and the rest of the read-mostly
+     * members which follow) starts a new cache line rather than sharing
+     * one with the mutex and clients, which are written each time a
+     * connection selects or leaves the bucket.
      */
-    std::atomic<State> state{State::None};
+    alignas(folly::hardware_destructive_interference_size) std::atomic<State>
+            state{State::None};
 
     /**
      * The type of bucket
@@ -137,7 +146,7 @@ public:
     /**
      * Statistics vector, one per front-end thread.
      */
-    std::vector<thread_stats> stats;
+    ThreadStatsSlots stats;
 
     /**
      * Command timing data
@@ -150,12 +159,29 @@ public:
     Hdr1sfMicroSecHistogram subjson_operation_times;
 
     using ResponseCounter = cb::RelaxedAtomic<uint64_t>;
+    using ResponseCounters =
+            std::array<ResponseCounter, size_t(cb::mcbp::Status::COUNT)>;
 
     /**
      * Response counters that count the number of times a specific response
-     * status is sent
+     * status is sent, one set per front-end thread (like stats) so that
+     * counting a response doesn't bounce a cache line between all of the
+     * threads. See Connection::countResponse().
+     */
+    std::vector<folly::CachelinePadded<ResponseCounters>> responseCounters;
+
+    /// Get the number of times each response status was sent, over all of
+    /// the front-end threads
+    std::array<uint64_t, size_t(cb::mcbp::Status::COUNT)> getResponseCounters()
+            const;
+
+    void resetResponseCounters();
+
+    /**
+     * The front-end budgets of the bucket, and how long its connections
+     * were deferred for exceeding them
      */
-    std::array<ResponseCounter, size_t(cb::mcbp::Status::COUNT)> responseCounters;
+    BucketThrottle throttle;
 
     /**
      * The cluster configuration for this bucket
@@ -22,7 +22,6 @@
 #include "memcached.h"
 #include "server_event.h"
 
-#include <mcbp/protocol/framebuilder.h>
 #include <memory>
 #include <string>
 
@@ -60,45 +59,25 @@ public:
 
     bool execute(Connection& connection) override {
         auto& bucket = connection.getBucket();
-        auto payload = bucket.clusterConfiguration.getConfiguration();
-        if (payload.first < connection.getClustermapRevno()) {
-            // Ignore.. we've already sent a newer cluster config
+        auto packet = bucket.clusterConfiguration.getNotification(
+                bucket.name, connection.isSnappyEnabled());
+        if (packet.first <= connection.getClustermapRevno()) {
+            // Ignore.. we've already sent this (or a newer) cluster config
+            // (the connection may have been notified more than once)
             return true;
         }
 
-        connection.setClustermapRevno(payload.first);
+        connection.setClustermapRevno(packet.first);
         LOG_INFO("{}: Sending Cluster map revision {}",
                  connection.getId(),
-                 payload.first);
-
-        std::string name = bucket.name;
-
-        using namespace cb::mcbp;
-        size_t needed = sizeof(Request) + // packet header
-                        4 + // rev number in extdata
-                        name.size() + // the name of the bucket
-                        payload.second->size(); // The actual payload
-
-        connection.write->ensureCapacity(needed);
-        FrameBuilder<Request> builder(connection.write->wdata());
-        builder.setMagic(Magic::ServerRequest);
-        builder.setDatatype(cb::mcbp::Datatype::JSON);
-        builder.setOpcode(ServerOpcode::ClustermapChangeNotification);
-
-        // The extras contains the cluster revision number as an uint32_t
-        const uint32_t rev = htonl(payload.first);
-        builder.setExtras(
-                {reinterpret_cast<const uint8_t*>(&rev), sizeof(rev)});
-        builder.setKey(
-                {reinterpret_cast<const uint8_t*>(name.data()), name.size()});
-        builder.setValue(
-                {reinterpret_cast<const uint8_t*>(payload.second->data()),
-                 payload.second->size()});
-
-        // Inject our packet into the stream!
+                 packet.first);
+
+        // Inject our packet into the stream! The packet is shared with all
+        // of the other connections we push it to, so rather than copying
+        // it we keep a reference to it until it is sent.
         connection.addMsgHdr(true);
-        connection.addIov(connection.write->wdata().data(), needed);
-        connection.write->produced(needed);
+        connection.addIov(packet.second->data(), packet.second->size());
+        connection.pushSharedSendBuffer(std::move(packet.second));
 
         connection.setState(StateMachine::State::send_data);
         connection.setWriteAndGo(StateMachine::State::new_cmd);
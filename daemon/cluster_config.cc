@@ -16,6 +16,9 @@
  */
 #include "cluster_config.h"
 
+#include <mcbp/protocol/framebuilder.h>
+#include <platform/compress.h>
+#include <platform/socket.h>
 #include <subdoc/operations.h>
 
 #include <cstdlib>
@@ -26,6 +29,8 @@ void ClusterConfiguration::setConfiguration(cb::const_char_buffer buffer,
     std::lock_guard<std::mutex> guard(mutex);
     revision = rev;
     config = std::make_shared<std::string>(buffer.begin(), buffer.end());
+    notification.reset();
+    compressedNotification.reset();
 }
 
 void ClusterConfiguration::setConfiguration(cb::const_char_buffer buffer) {
@@ -39,6 +44,8 @@ void ClusterConfiguration::setConfiguration(cb::const_char_buffer buffer) {
     std::lock_guard<std::mutex> guard(mutex);
     revision = rev;
     config = std::make_shared<std::string>(buffer.begin(), buffer.end());
+    notification.reset();
+    compressedNotification.reset();
 }
 
 int ClusterConfiguration::getRevisionNumber(cb::const_char_buffer buffer) {
@@ -66,3 +73,62 @@ int ClusterConfiguration::getRevisionNumber(cb::const_char_buffer buffer) {
 
     return -1;
 }
+
+std::pair<int, std::shared_ptr<const std::string>>
+ClusterConfiguration::getNotification(const std::string& bucket,
+                                      bool snappy) const {
+    std::shared_ptr<std::string> payload;
+    int rev;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        const auto& cached = snappy ? compressedNotification : notification;
+        if (cached) {
+            return {revision, cached};
+        }
+        payload = config;
+        rev = revision;
+    }
+
+    // Build the packet outside the lock, so that we don't block the
+    // connections looking at the configuration while compressing it
+    auto datatype = cb::mcbp::Datatype::JSON;
+    cb::const_char_buffer value{payload->data(), payload->size()};
+    cb::compression::Buffer deflated;
+    if (snappy &&
+        cb::compression::deflate(
+                cb::compression::Algorithm::Snappy, value, deflated) &&
+        deflated.size() < value.size()) {
+        datatype = cb::mcbp::Datatype(uint8_t(datatype) |
+                                      uint8_t(cb::mcbp::Datatype::Snappy));
+        value = {deflated.data(), deflated.size()};
+    }
+
+    using namespace cb::mcbp;
+    auto packet = std::make_shared<std::string>();
+    packet->resize(sizeof(Request) + // packet header
+                   4 + // rev number in extdata
+                   bucket.size() + // the name of the bucket
+                   value.size()); // The actual payload
+    FrameBuilder<Request> builder(
+            {reinterpret_cast<uint8_t*>(&(*packet)[0]), packet->size()});
+    builder.setMagic(Magic::ServerRequest);
+    builder.setDatatype(datatype);
+    builder.setOpcode(ServerOpcode::ClustermapChangeNotification);
+
+    // The extras contains the cluster revision number as an uint32_t
+    const uint32_t netrev = htonl(rev);
+    builder.setExtras({reinterpret_cast<const uint8_t*>(&netrev),
+                       sizeof(netrev)});
+    builder.setKey(
+            {reinterpret_cast<const uint8_t*>(bucket.data()), bucket.size()});
+    builder.setValue(
+            {reinterpret_cast<const uint8_t*>(value.data()), value.size()});
+
+    std::lock_guard<std::mutex> guard(mutex);
+    if (config == payload) {
+        // Still the current configuration; let the other connections
+        // use the same packet
+        (snappy ? compressedNotification : notification) = packet;
+    }
+    return {rev, packet};
+}
@@ -51,6 +51,20 @@ public:
         return std::make_pair(revision, config);
     };
 
+    /**
+     * Get the ClustermapChangeNotification packet to push the current
+     * configuration to clients. The packet is built once per configuration
+     * and shared by all of the connections it is sent to (which must keep
+     * a reference to it until it is sent).
+     *
+     * @param bucket the name of the bucket (the key of the packet)
+     * @param snappy if the client accepts a Snappy compressed value
+     * @return a pair where the first element is the revision number, and
+     *         the second element is the packet
+     */
+    std::pair<int, std::shared_ptr<const std::string>> getNotification(
+            const std::string& bucket, bool snappy) const;
+
     /**
      * Pick out the revision number from the provided cluster configuration.
      *
@@ -78,4 +92,12 @@ private:
      * Cached revision so we don't have to parse it every time
      */
     int revision;
+
+    /**
+     * The ClustermapChangeNotification packets built for the current
+     * config (see getNotification()), with and without a Snappy
+     * compressed value. Reset whenever the config changes.
+     */
+    mutable std::shared_ptr<const std::string> notification;
+    mutable std::shared_ptr<const std::string> compressedNotification;
 };
@@ -46,6 +46,7 @@
 #include <utilities/logtags.h>
 #include <gsl/gsl>
 
+#include <algorithm>
 #include <cctype>
 #include <exception>
 #ifndef WIN32
@@ -250,8 +251,14 @@ void Connection::restartAuthentication() {
     username = "";
 }
 
+void Connection::setPrivilegeContext(cb::rbac::PrivilegeContext context) {
+    privilegeContext = std::move(context);
+    grantedCommands.reset();
+}
+
 cb::engine_errc Connection::dropPrivilege(cb::rbac::Privilege privilege) {
     if (privilegeContext.dropPrivilege(privilege)) {
+        grantedCommands.reset();
         return cb::engine_errc::success;
     }
 
@@ -278,12 +285,12 @@ cb::rbac::PrivilegeAccess Connection::checkPrivilege(
         // but let the client deal with whatever happens after
         // a single update.
         try {
-            privilegeContext = cb::rbac::createContext(
-                    getUsername(), getDomain(), all_buckets[bucketIndex].name);
+            setPrivilegeContext(cb::rbac::createContext(
+                    getUsername(), getDomain(), all_buckets[bucketIndex].name));
         } catch (const cb::rbac::NoSuchBucketException&) {
             // Remove all access to the bucket
-            privilegeContext =
-                    cb::rbac::createContext(getUsername(), getDomain(), "");
+            setPrivilegeContext(
+                    cb::rbac::createContext(getUsername(), getDomain(), ""));
             LOG_INFO(
                     "{}: RBAC: Connection::checkPrivilege({}) {} No access "
                     "to "
@@ -378,6 +385,10 @@ Bucket& Connection::getBucket() const {
     return all_buckets[getBucketIndex()];
 }
 
+void Connection::countResponse(cb::mcbp::Status status) {
+    ++(*getBucket().responseCounters.at(getThread()->index))[size_t(status)];
+}
+
 EngineIface* Connection::getBucketEngine() const {
     return getBucket().getEngine();
 }
@@ -486,8 +497,8 @@ void Connection::setBucketIndex(int bucketIndex) {
         if (authenticated) {
             // The user have logged in, so we should create a context
             // representing the users context in the desired bucket.
-            privilegeContext = cb::rbac::createContext(
-                    username, getDomain(), all_buckets[bucketIndex].name);
+            setPrivilegeContext(cb::rbac::createContext(
+                    username, getDomain(), all_buckets[bucketIndex].name));
         } else if (is_default_bucket_enabled() &&
                    strcmp("default", all_buckets[bucketIndex].name) == 0) {
             // We've just connected to the _default_ bucket, _AND_ the client
@@ -497,16 +508,16 @@ void Connection::setBucketIndex(int bucketIndex) {
             // a while... lets look up a profile named "default" and
             // assign that. It should only contain access to the default
             // bucket.
-            privilegeContext = cb::rbac::createContext(
-                    "default", getDomain(), all_buckets[bucketIndex].name);
+            setPrivilegeContext(cb::rbac::createContext(
+                    "default", getDomain(), all_buckets[bucketIndex].name));
         } else {
             // The user has not authenticated, and this isn't for the
             // "default bucket". Assign an empty profile which won't give
             // you any privileges.
-            privilegeContext = cb::rbac::PrivilegeContext{getDomain()};
+            setPrivilegeContext(cb::rbac::PrivilegeContext{getDomain()});
         }
     } catch (const cb::rbac::Exception&) {
-        privilegeContext = cb::rbac::PrivilegeContext{getDomain()};
+        setPrivilegeContext(cb::rbac::PrivilegeContext{getDomain()});
     }
 
     if (bucketIndex == 0) {
@@ -514,6 +525,7 @@ void Connection::setBucketIndex(int bucketIndex) {
         // no bucket instead of EACCESS. Lets give the connection all
         // possible bucket privileges
         privilegeContext.setBucketPrivileges();
+        grantedCommands.reset();
     }
 }
 
@@ -622,6 +634,47 @@ bool Connection::updateEvent(const short new_flags) {
     return true;
 }
 
+bool Connection::isMigratable() {
+    if (isDCP() || refcount > 1 || !registered_in_libevent ||
+        getState() != StateMachine::State::read_packet_header ||
+        ev_flags != (EV_READ | EV_PERSIST) || !server_events.empty()) {
+        return false;
+    }
+
+    for (const auto& c : cookies) {
+        if (c->isEwouldblock()) {
+            return false;
+        }
+    }
+
+    // Buffers are loaned from the thread; they can't go with the connection
+    if ((read && !read->empty()) || (write && !write->empty()) ||
+        ssl.havePendingInputData()) {
+        return false;
+    }
+
+    return true;
+}
+
+bool Connection::setEventBase(event_base* b) {
+    base = b;
+    if (event_assign(event.get(),
+                     base,
+                     socketDescriptor,
+                     ev_flags,
+                     event_handler,
+                     reinterpret_cast<void*>(this)) == -1) {
+        LOG_WARNING(
+                "{}: Failed to move event notification to a new thread. "
+                "Shutting down connection {}",
+                getId(),
+                getDescription());
+        return false;
+    }
+
+    return registerEvent();
+}
+
 bool Connection::initializeEvent() {
     short event_flags = (EV_READ | EV_PERSIST);
 
@@ -639,6 +692,24 @@ bool Connection::initializeEvent() {
     return registerEvent();
 }
 
+void Connection::ensureReadCapacity(size_t nbytes) {
+    auto* thr = getThread();
+    if (thr == nullptr) {
+        read->ensureCapacity(nbytes);
+    } else {
+        thr->pipes.ensureCapacity(read, nbytes);
+    }
+}
+
+void Connection::ensureWriteCapacity(size_t nbytes) {
+    auto* thr = getThread();
+    if (thr == nullptr) {
+        write->ensureCapacity(nbytes);
+    } else {
+        thr->pipes.ensureCapacity(write, nbytes);
+    }
+}
+
 void Connection::shrinkBuffers() {
     // We share the buffers with the thread, so we don't need to worry
     // about the read and write buffer.
@@ -670,10 +741,11 @@ void Connection::setAuthenticated(bool authenticated) {
     Connection::authenticated = authenticated;
     if (authenticated) {
         updateDescription();
-        privilegeContext = cb::rbac::createContext(username, getDomain(), "");
+        setPrivilegeContext(
+                cb::rbac::createContext(username, getDomain(), ""));
     } else {
         resetUsernameCache();
-        privilegeContext = cb::rbac::PrivilegeContext{getDomain()};
+        setPrivilegeContext(cb::rbac::PrivilegeContext{getDomain()});
     }
 }
 
@@ -812,6 +884,7 @@ int Connection::recv(char* dest, size_t nbytes) {
         if (res > 0) {
             totalRecv += res;
         }
+        socketReadPending = res > 0 && size_t(res) == nbytes;
     }
 
     return res;
@@ -820,13 +893,51 @@ int Connection::recv(char* dest, size_t nbytes) {
 ssize_t Connection::sendmsg(struct msghdr* m) {
     ssize_t res = 0;
     if (ssl.isEnabled()) {
-        for (int ii = 0; ii < int(m->msg_iovlen); ++ii) {
-            int n = sslWrite(reinterpret_cast<char*>(m->msg_iov[ii].iov_base),
-                             m->msg_iov[ii].iov_len);
+        // A response is typically made up of a number of small iovecs
+        // (header, extras, key, value). Writing each of them separately
+        // makes OpenSSL wrap each of them in a TLS record of its own (with
+        // its own record header, MAC and cipher setup), so coalesce
+        // consecutive iovecs into a buffer of up to a full record first.
+        // Iovecs which don't fit are written directly from their buffer.
+        static thread_local std::vector<char> coalesced;
+        coalesced.reserve(SSL3_RT_MAX_PLAIN_LENGTH);
+
+        int ii = 0;
+        while (ii < int(m->msg_iovlen)) {
+            const char* data;
+            size_t len;
+
+            coalesced.clear();
+            while (ii < int(m->msg_iovlen) &&
+                   coalesced.size() + m->msg_iov[ii].iov_len <=
+                           SSL3_RT_MAX_PLAIN_LENGTH) {
+                const auto* base =
+                        static_cast<const char*>(m->msg_iov[ii].iov_base);
+                coalesced.insert(
+                        coalesced.end(), base, base + m->msg_iov[ii].iov_len);
+                ++ii;
+            }
+
+            if (coalesced.empty()) {
+                data = static_cast<const char*>(m->msg_iov[ii].iov_base);
+                len = m->msg_iov[ii].iov_len;
+                ++ii;
+            } else {
+                data = coalesced.data();
+                len = coalesced.size();
+            }
+
+            int n = sslWrite(data, len);
             if (n > 0) {
                 res += n;
-            } else {
-                return res > 0 ? res : -1;
+            }
+            if (n < int(len)) {
+                // Blocked (or failed) part way through; don't carry on
+                // with the following iovecs or we'd send them out of order
+                if (res == 0) {
+                    res = -1;
+                }
+                break;
             }
         }
 
@@ -1098,7 +1209,10 @@ int Connection::sslRead(char* dest, size_t nbytes) {
 int Connection::sslWrite(const char* src, size_t nbytes) {
     int ret = 0;
 
-    int chunksize = settings.getBioDrainBufferSize();
+    // Hand OpenSSL (at least) a whole record at a time; the BIO pair is
+    // sized to take it in one go.
+    const int chunksize = std::max(int(settings.getBioDrainBufferSize()),
+                                   SSL3_RT_MAX_PLAIN_LENGTH);
 
     while (ret < int(nbytes)) {
         int n;
@@ -1152,6 +1266,11 @@ int Connection::sslWrite(const char* src, size_t nbytes) {
 
 void Connection::addMsgHdr(bool reset) {
     if (reset) {
+        responseDeferrable = false;
+        if (deferredResponses) {
+            // Append the response to the ones we're holding back
+            return;
+        }
         msgcurr = 0;
         msglist.clear();
         iovused = 0;
@@ -1171,6 +1290,14 @@ void Connection::addMsgHdr(bool reset) {
     STATS_MAX(this, msgused_high_watermark, gsl::narrow<int>(msglist.size()));
 }
 
+/// Fragments up to this size are copied into the write buffer rather than
+/// being sent from where they are (see addIov())
+static const size_t MaxCoalescedFragment = 256;
+
+/// ... as long as this much space is left in the write buffer afterwards
+/// (enough for the next responses to be deferred, see deferResponse())
+static const size_t CoalesceHeadroom = 2048;
+
 void Connection::addIov(const void* buf, size_t len) {
     if (len == 0) {
         return;
@@ -1178,6 +1305,34 @@ void Connection::addIov(const void* buf, size_t len) {
 
     struct msghdr* m = &msglist.back();
 
+    if (m->msg_iovlen > 0) {
+        auto& last = m->msg_iov[m->msg_iovlen - 1];
+        const auto* end = static_cast<const uint8_t*>(last.iov_base) +
+                          last.iov_len;
+
+        // A small fragment following data at the end of the write buffer
+        // is copied in after it, so the kernel gets one large entry rather
+        // than one per header / extras / key / value.
+        if (write && len <= MaxCoalescedFragment && buf != end) {
+            auto wdata = write->wdata();
+            if (wdata.data() == end &&
+                wdata.size() >= len + CoalesceHeadroom) {
+                std::copy_n(static_cast<const uint8_t*>(buf),
+                            len,
+                            wdata.begin());
+                write->produced(len);
+                buf = end;
+            }
+        }
+
+        // Extend the last entry if the data follows it
+        if (buf == end) {
+            last.iov_len += len;
+            msgbytes += len;
+            return;
+        }
+    }
+
     /* We may need to start a new msghdr if this one is full. */
     if (m->msg_iovlen == IOV_MAX) {
         addMsgHdr(false);
@@ -1346,6 +1501,122 @@ size_t Connection::getNumberOfCookies() const {
     return ret;
 }
 
+bool Connection::mayExecuteUnordered(const Cookie& cookie) const {
+    if (cookie.isStarted()) {
+        return true;
+    }
+
+    // A response (to a server initiated request) can't be reordered with
+    // anything. Use the frame infos decoded when the packets were
+    // validated, rather than parsing the framing extras of every inflight
+    // command. The cookie itself may be one of the parked cookies (if it
+    // was swapped out of the front), so it mustn't be counted as in flight.
+    const bool reorderable = cookie.getHeader().isRequest() &&
+                             cookie.getFrameInfos().reorderable;
+    for (const auto& other : cookies) {
+        if (other.get() == &cookie || !other->isStarted()) {
+            continue;
+        }
+        if (!reorderable || !other->getFrameInfos().reorderable) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Connection::parkCookie() {
+    auto& cookie = getCookieObject();
+    if (!cookie.isRequestDetached() ||
+        getNumberOfParkedCookies() >= settings.getMaxUnorderedCommands() ||
+        !cookie.getFrameInfos().reorderable) {
+        return false;
+    }
+
+    cookies.emplace(cookies.begin(),
+                    std::unique_ptr<Cookie>{new Cookie(*this)});
+    return true;
+}
+
+std::vector<std::unique_ptr<Cookie>>::iterator
+Connection::findRunnableParkedCookie() {
+    return std::find_if(cookies.begin() + 1,
+                        cookies.end(),
+                        [this](const std::unique_ptr<Cookie>& cookie) {
+                            return !cookie->isEwouldblock() &&
+                                   mayExecuteUnordered(*cookie);
+                        });
+}
+
+bool Connection::resumeParkedCookie() {
+    auto iter = findRunnableParkedCookie();
+    if (iter == cookies.end()) {
+        return false;
+    }
+
+    cookies.front() = std::move(*iter);
+    cookies.erase(iter);
+    return true;
+}
+
+bool Connection::swapParkedCookie() {
+    auto iter = findRunnableParkedCookie();
+    if (iter == cookies.end()) {
+        return false;
+    }
+
+    cookies.front().swap(*iter);
+    return true;
+}
+
+/// Responses are only held back while there is this much space left in the
+/// write buffer for the headers (and error messages) of the next responses
+static const size_t DeferredResponseHeadroom = 1024;
+
+/// The maximum number of bytes of responses we'll hold back
+static const size_t MaxDeferredResponseBytes = 256 * 1024;
+
+bool Connection::deferResponse() {
+    const bool deferrable = responseDeferrable;
+    responseDeferrable = false;
+    if (!deferrable || write_and_go != StateMachine::State::new_cmd ||
+        write->wsize() < DeferredResponseHeadroom ||
+        msgbytes >= MaxDeferredResponseBytes ||
+        msglist.size() != 1 || msglist.back().msg_iovlen + 8 > size_t(IOV_MAX) ||
+        !isNextCommandBatchable()) {
+        return false;
+    }
+
+    deferredResponses = true;
+    return true;
+}
+
+bool Connection::isNextCommandBatchable() const {
+    if (!isPacketAvailable()) {
+        return false;
+    }
+
+    const auto& header =
+            *reinterpret_cast<const cb::mcbp::Header*>(read->rdata().data());
+    if (!header.isValid() || !header.isRequest()) {
+        return false;
+    }
+    const auto& request = header.getRequest();
+    if (!cb::mcbp::is_client_magic(request.getMagic())) {
+        return false;
+    }
+
+    switch (request.getClientOpcode()) {
+    case cb::mcbp::ClientOpcode::Get:
+    case cb::mcbp::ClientOpcode::Getq:
+    case cb::mcbp::ClientOpcode::Getk:
+    case cb::mcbp::ClientOpcode::Getkq:
+    case cb::mcbp::ClientOpcode::Noop:
+        return true;
+    default:
+        return false;
+    }
+}
+
 bool Connection::isPacketAvailable() const {
     auto buffer = read->rdata();
 
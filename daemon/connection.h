@@ -21,12 +21,14 @@
 #include "ssl_context.h"
 #include "statemachine.h"
 #include "stats.h"
+#include "stats_delta.h"
 #include "task.h"
 
 #include <cbsasl/client.h>
 #include <cbsasl/server.h>
 #include <daemon/protocol/mcbp/command_context.h>
 #include <event.h>
+#include <mcbp/protocol/opcode.h>
 #include <mcbp/protocol/unsigned_leb128.h>
 #include <memcached/dcp.h>
 #include <memcached/openssl.h>
@@ -36,6 +38,7 @@
 #include <platform/socket.h>
 
 #include <array>
+#include <bitset>
 #include <chrono>
 #include <memory>
 #include <queue>
@@ -273,6 +276,29 @@ public:
      */
     cb::engine_errc dropPrivilege(cb::rbac::Privilege privilege);
 
+    /**
+     * Check if the current privilege context is already known to grant
+     * access to the given command; that is the command's privilege chain
+     * returned Ok since the context was last replaced or modified, and the
+     * privilege database hasn't been reloaded since. Lets the per-command
+     * access check be a single bit test in the common case.
+     */
+    bool isCommandGranted(cb::mcbp::ClientOpcode opcode) const {
+        return grantedCommands.test(
+                       std::underlying_type<cb::mcbp::ClientOpcode>::type(
+                               opcode)) &&
+               !privilegeContext.isStale();
+    }
+
+    /**
+     * Record that the current privilege context grants access to the given
+     * command (see isCommandGranted()).
+     */
+    void setCommandGranted(cb::mcbp::ClientOpcode opcode) {
+        grantedCommands.set(
+                std::underlying_type<cb::mcbp::ClientOpcode>::type(opcode));
+    }
+
     int getBucketIndex() const {
         return bucketIndex.load(std::memory_order_relaxed);
     }
@@ -281,6 +307,10 @@ public:
 
     Bucket& getBucket() const;
 
+    /// Count a response sent with the given status in the bucket's
+    /// responseCounters (of this connection's thread)
+    void countResponse(cb::mcbp::Status status);
+
     EngineIface* getBucketEngine() const;
 
     int getClustermapRevno() const {
@@ -324,6 +354,11 @@ public:
         return duplex_support;
     }
 
+    /// The snapshots of the stats groups polled with "stats delta"
+    StatsDeltaCache& getStatsDeltaCache() {
+        return statsDeltaCache;
+    }
+
     void setDuplexSupported(bool duplex_support) {
         Connection::duplex_support = duplex_support;
     }
@@ -377,6 +412,43 @@ public:
      */
     void addCpuTime(std::chrono::nanoseconds ns);
 
+    std::chrono::nanoseconds getTotalCpuTime() const {
+        return total_cpu_time;
+    }
+
+    /**
+     * Bookkeeping used by maybe_migrate_connection() to measure how busy
+     * this connection has been recently, and to avoid moving it between
+     * threads too often.
+     */
+    struct LoadSample {
+        std::chrono::steady_clock::time_point time;
+        std::chrono::nanoseconds cpu_time = std::chrono::nanoseconds::zero();
+        std::chrono::steady_clock::time_point last_migration;
+    };
+
+    LoadSample& getLoadSample() {
+        return load_sample;
+    }
+
+    /**
+     * May this connection be moved to another front-end thread? Only
+     * connections which are idle between commands (waiting for the next
+     * request header, with nothing buffered in either direction and no
+     * outstanding engine operations) may be moved. DCP connections never
+     * are.
+     */
+    bool isMigratable();
+
+    /**
+     * Re-bind this connection to a different event base (that of the
+     * front-end thread it has been moved to), and register its event with
+     * it. The event must not be registered with the old base.
+     *
+     * @return true if success, false otherwise
+     */
+    bool setEventBase(event_base* b);
+
     /**
      * Enqueue a new server event
      *
@@ -457,6 +529,11 @@ public:
         return --numEvents;
     }
 
+    /// Get the number of events left to process in this timeslice
+    int getNumEvents() const {
+        return numEvents;
+    }
+
     /**
      * Set the number of events to process per timeslice of the worker
      * thread before yielding.
@@ -600,13 +677,56 @@ public:
     /**
      * Adds a message header to a connection.
      *
-     * @param reset set to true to reset all message headers
+     * @param reset set to true to reset all message headers (a new
+     *              response is started). If we're holding back responses
+     *              the new response is appended to them instead
      * @throws std::bad_alloc
      */
     void addMsgHdr(bool reset);
 
     /**
-     * Add a chunk of memory to the the IO vector to send
+     * Mark the response being sent as one which may be held back and sent
+     * together with the responses of the following commands: it must only
+     * refer to data in the write buffer and to reserved items (and not to
+     * memory owned by the cookie, which is reset before the next command).
+     */
+    void setResponseDeferrable() {
+        responseDeferrable = true;
+    }
+
+    /**
+     * Called when the response is ready to be sent. If the response may be
+     * deferred (see setResponseDeferrable()) and the next command in the
+     * input buffer is a get (or a noop) whose response may be appended to
+     * it, we hold back the response to send all of them in a single write
+     * (clients send bulk gets as a run of GETQ/GETKQ terminated by a NOOP
+     * or GETK).
+     *
+     * @return true if the response should be held back
+     */
+    bool deferResponse();
+
+    /// Are there responses we've held back (see deferResponse())?
+    bool hasDeferredResponses() const {
+        return deferredResponses;
+    }
+
+    /// Called when all of the responses are sent
+    void clearDeferredResponses() {
+        deferredResponses = false;
+    }
+
+    /**
+     * Is the next command in the input buffer (completely received) one
+     * whose response may be appended to a deferred response?
+     */
+    bool isNextCommandBatchable() const;
+
+    /**
+     * Add a chunk of memory to the the IO vector to send. Data which
+     * directly follows the previous chunk extends it, and small chunks
+     * following data in the write buffer are copied into it (so the memory
+     * doesn't need to stay valid, nor may later changes to it be sent).
      *
      * @param buf pointer to the data to send
      * @param len number of bytes to send
@@ -639,12 +759,21 @@ public:
             cb_free(ptr);
         }
         temp_alloc.resize(0);
+        sharedSendBuffers.clear();
     }
 
     void pushTempAlloc(char* ptr) {
         temp_alloc.push_back(ptr);
     }
 
+    /**
+     * Keep a reference to a buffer shared with other connections (such as
+     * a cluster map notification) until it is sent
+     */
+    void pushSharedSendBuffer(std::shared_ptr<const std::string> buffer) {
+        sharedSendBuffers.push_back(std::move(buffer));
+    }
+
     /**
      * Enable the datatype which corresponds to the feature
      *
@@ -735,6 +864,17 @@ public:
         return (!read->empty() || ssl.havePendingInputData());
     }
 
+    /**
+     * Did the last read from the socket fill all of the buffer space we
+     * offered? If so the socket most likely has more data queued, and
+     * we may read it straight away rather than first going back to
+     * libevent to be told that it is readable (which costs an extra
+     * epoll round trip for pipelining and bulk-loading clients).
+     */
+    bool isSocketReadPending() const {
+        return socketReadPending;
+    }
+
     /**
      * Try to find RBAC user from the client ssl cert
      *
@@ -747,6 +887,21 @@ public:
 
     void runEventLoop(short which);
 
+    /**
+     * Make sure the input buffer has room for another nbytes of data,
+     * moving its content to a larger buffer (from the thread's pool) if
+     * it's too small. Note that this may move the data in the buffer.
+     *
+     * @throws std::bad_alloc if we fail to allocate memory
+     */
+    void ensureReadCapacity(size_t nbytes);
+
+    /**
+     * Make sure the output buffer has room for another nbytes of data
+     * (see ensureReadCapacity)
+     */
+    void ensureWriteCapacity(size_t nbytes);
+
     /**
      * Input buffer containing the data we've read of the socket. It is
      * assigned to the connection when the connection is to be served, and
@@ -767,6 +922,53 @@ public:
      */
     size_t getNumberOfCookies() const;
 
+    /**
+     * Get the number of commands parked while waiting for the engine.
+     *
+     * When unordered execution is enabled a reorderable command which
+     * blocks in the engine is "parked": it's kept in the list of cookies
+     * while a new cookie takes its place (at the front of the list) to
+     * execute the next command. Once the engine notifies the parked command
+     * it's moved back to the front and executed again to send its response,
+     * so that a command waiting for a background fetch doesn't stall the
+     * commands pipelined after it.
+     */
+    size_t getNumberOfParkedCookies() const {
+        return cookies.size() - 1;
+    }
+
+    /**
+     * May the command in the given cookie be executed now? A command which
+     * has been started may always be executed again, but a new command
+     * has to wait for the commands in flight it can't be reordered with.
+     */
+    bool mayExecuteUnordered(const Cookie& cookie) const;
+
+    /**
+     * Park the (blocked) command at the front, if it may be reordered and
+     * the connection hasn't reached the limit of parked commands.
+     *
+     * @return true if the command was parked
+     */
+    bool parkCookie();
+
+    /**
+     * Replace the (idle) front cookie with a parked one which may be
+     * executed.
+     *
+     * @return true if a parked command was moved to the front
+     */
+    bool resumeParkedCookie();
+
+    /**
+     * Swap the front cookie (a blocked command, or one which needs to wait
+     * for the parked commands to complete) with a parked one which may be
+     * executed.
+     *
+     * @return true if a parked command was moved to the front
+     */
+    bool swapParkedCookie();
+
     /**
      * Check to see if the next packet to process is completely received
      * and available in the input pipe.
@@ -960,6 +1162,12 @@ protected:
      */
     void updateDescription();
 
+    /**
+     * Replace the current privilege context (and forget which commands the
+     * old one granted access to)
+     */
+    void setPrivilegeContext(cb::rbac::PrivilegeContext context);
+
     void runStateMachinery();
 
     /**
@@ -1057,6 +1265,13 @@ protected:
      */
     cb::rbac::PrivilegeContext privilegeContext{cb::sasl::Domain::Local};
 
+    /**
+     * The commands the current privilege context is known to grant access
+     * to (see isCommandGranted()). Cleared whenever privilegeContext is
+     * replaced or modified.
+     */
+    std::bitset<0x100> grantedCommands;
+
     /**
      * The SASL object used to do sasl authentication
      */
@@ -1136,6 +1351,9 @@ protected:
 
     std::queue<std::unique_ptr<ServerEvent>> server_events;
 
+    /// What was last sent by each of the "stats delta" groups polled
+    StatsDeltaCache statsDeltaCache;
+
     /**
      * The total time this connection been on the CPU
      */
@@ -1149,6 +1367,9 @@ protected:
      */
     std::chrono::nanoseconds max_sched_time = std::chrono::nanoseconds::zero();
 
+    /// See getLoadSample()
+    LoadSample load_sample;
+
     /**
      * The name of the client provided to us by hello
      */
@@ -1225,6 +1446,13 @@ protected:
     /** number of bytes in current msg */
     size_t msgbytes = 0;
 
+    /// Set if the response being sent may be deferred (see
+    /// setResponseDeferrable())
+    bool responseDeferrable = false;
+
+    /// Set while the msglist holds responses we've held back
+    bool deferredResponses = false;
+
     /**
      * List of items we've reserved during the command (should call
      * item_release when transmit is complete)
@@ -1239,6 +1467,12 @@ protected:
      */
     std::vector<char*> temp_alloc;
 
+    /**
+     * The buffers shared with other connections that we're sending (see
+     * pushSharedSendBuffer()); released along with temp_alloc
+     */
+    std::vector<std::shared_ptr<const std::string>> sharedSendBuffers;
+
     /**
      * If the client enabled the mutation seqno feature each mutation
      * command will return the vbucket UUID and sequence number for the
@@ -1253,16 +1487,25 @@ protected:
 
     // Total number of bytes received on the network
     size_t totalRecv = 0;
+    /// Set if the last recv() filled the whole buffer (see
+    /// isSocketReadPending())
+    bool socketReadPending = false;
     // Total number of bytes sent to the network
     size_t totalSend = 0;
 
     /**
-     * The list of commands currently being processed. Currently we
-     * only use a single entry in this vector (and always reuse that
-     * object for all commands), but when the client tries to
-     * enable unordered execution we may operate with multiple
-     * commands at the same time and they're all stored in this
-     * vector)
+     * Get the first parked cookie which may be executed (it is no longer
+     * blocked in the engine, see mayExecuteUnordered()), or cookies.end()
+     * if there isn't one.
+     */
+    std::vector<std::unique_ptr<Cookie>>::iterator findRunnableParkedCookie();
+
+    /**
+     * The list of commands currently being processed. The front entry
+     * is used for the command being executed (and is reused for all
+     * commands), but when the client enables unordered execution the
+     * commands parked while waiting for the engine are stored after it
+     * in this vector (see getNumberOfParkedCookies()).
      */
     std::vector<std::unique_ptr<Cookie>> cookies;
 
@@ -53,10 +53,9 @@ enum class BufferLoan {
 /** Function prototypes ******************************************************/
 
 static BufferLoan loan_single_buffer(Connection& c,
-                                     std::unique_ptr<cb::Pipe>& thread_buf,
+                                     PipePool& pool,
                                      std::unique_ptr<cb::Pipe>& conn_buf);
-static void maybe_return_single_buffer(Connection& c,
-                                       std::unique_ptr<cb::Pipe>& thread_buf,
+static void maybe_return_single_buffer(PipePool& pool,
                                        std::unique_ptr<cb::Pipe>& conn_buf);
 static void conn_destructor(Connection* c);
 static Connection* allocate_connection(SOCKET sfd,
@@ -143,6 +142,10 @@ void close_all_connections() {
 }
 
 void run_event_loop(Connection* c, short which) {
+    // It's getting its timeslice now (it may have been on the run queue
+    // and then got an IO event or notification)
+    unschedule_connection(*c);
+
     const auto start = std::chrono::steady_clock::now();
     c->runEventLoop(which);
     const auto stop = std::chrono::steady_clock::now();
@@ -150,15 +153,31 @@ void run_event_loop(Connection* c, short which) {
     using namespace std::chrono;
     const auto ns = duration_cast<nanoseconds>(stop - start);
     c->addCpuTime(ns);
+    c->getBucket().throttle.addCpuTime(ns);
 
     auto* thread = c->getThread();
     if (thread != nullptr) {
         scheduler_info[thread->index].add(duration_cast<microseconds>(ns));
+        thread->busy_time += ns.count();
     }
 
     if (c->shouldDelete()) {
         release_connection(c);
+    } else {
+        maybe_migrate_connection(*c);
+    }
+}
+
+void conn_migrate(Connection& c, FrontEndThread& to) {
+    // Serialise with iterate_thread_connections, which selects connections
+    // by their thread
+    std::lock_guard<std::mutex> lock(connections.mutex);
+    auto* from = c.getThread();
+    if (from != nullptr) {
+        --from->num_connections;
     }
+    ++to.num_connections;
+    c.setThread(&to);
 }
 
 Connection* conn_new(SOCKET sfd,
@@ -198,7 +217,7 @@ void conn_loan_buffers(Connection* c) {
     }
 
     auto* ts = get_thread_stats(c);
-    switch (loan_single_buffer(*c, c->getThread()->read, c->read)) {
+    switch (loan_single_buffer(*c, c->getThread()->pipes, c->read)) {
     case BufferLoan::Existing:
         ts->rbufs_existing++;
         break;
@@ -210,7 +229,7 @@ void conn_loan_buffers(Connection* c) {
         break;
     }
 
-    switch (loan_single_buffer(*c, c->getThread()->write, c->write)) {
+    switch (loan_single_buffer(*c, c->getThread()->pipes, c->write)) {
     case BufferLoan::Existing:
         ts->wbufs_existing++;
         break;
@@ -240,8 +259,8 @@ void conn_return_buffers(Connection* c) {
         return;
     }
 
-    maybe_return_single_buffer(*c, thread->read, c->read);
-    maybe_return_single_buffer(*c, thread->write, c->write);
+    maybe_return_single_buffer(thread->pipes, c->read);
+    maybe_return_single_buffer(thread->pipes, c->write);
 }
 
 /** Internal functions *******************************************************/
@@ -291,7 +310,13 @@ static void release_connection(Connection* c) {
         // I should assert
         cb_assert(iter != connections.conns.end());
         connections.conns.erase(iter);
+
+        auto* thread = c->getThread();
+        if (thread != nullptr) {
+            --thread->num_connections;
+        }
     }
+    unschedule_connection(*c);
 
     // Finally free it
     conn_destructor(c);
@@ -299,26 +324,20 @@ static void release_connection(Connection* c) {
 
 /**
  * If the connection doesn't already have a populated conn_buff, ensure that
- * it does by either loaning out the threads, or allocating a new one if
- * necessary.
+ * it does by either loaning out one of the thread's cached buffers, or
+ * allocating a new one if necessary.
  */
 static BufferLoan loan_single_buffer(Connection& c,
-                                     std::unique_ptr<cb::Pipe>& thread_buf,
+                                     PipePool& pool,
                                      std::unique_ptr<cb::Pipe>& conn_buf) {
     /* Already have a (partial) buffer - nothing to do. */
     if (conn_buf) {
         return BufferLoan::Existing;
     }
 
-    // If the thread has a buffer, let's loan that to the connection
-    if (thread_buf) {
-        thread_buf.swap(conn_buf);
-        return BufferLoan::Loaned;
-    }
-
-    // Need to allocate a new buffer
+    bool allocated;
     try {
-        conn_buf = std::make_unique<cb::Pipe>(DATA_BUFFER_SIZE);
+        conn_buf = pool.allocate(DATA_BUFFER_SIZE, &allocated);
     } catch (const std::bad_alloc&) {
         // Unable to alloc a buffer for the thread. Not much we can do here
         // other than terminate the current connection.
@@ -331,19 +350,14 @@ static BufferLoan loan_single_buffer(Connection& c,
         return BufferLoan::Existing;
     }
 
-    return BufferLoan::Allocated;
+    return allocated ? BufferLoan::Allocated : BufferLoan::Loaned;
 }
 
-static void maybe_return_single_buffer(Connection& c,
-                                       std::unique_ptr<cb::Pipe>& thread_buf,
+static void maybe_return_single_buffer(PipePool& pool,
                                        std::unique_ptr<cb::Pipe>& conn_buf) {
     if (conn_buf && conn_buf->empty()) {
-        // Buffer clean, dispose of it
-        if (thread_buf) {
-            // Already got a thread buffer.. release this one
-            conn_buf.reset();
-        } else {
-            conn_buf.swap(thread_buf);
-        }
+        // Buffer clean, hand it back (the pool frees it if it already has
+        // enough buffers of its size)
+        pool.release(std::move(conn_buf));
     }
 }
@@ -74,6 +74,16 @@ Connection* conn_new(SOCKET sfd,
                      struct event_base* base,
                      FrontEndThread* thread);
 
+/**
+ * Move a connection to another front-end thread: update the thread it
+ * is bound to and the threads' connection counts. The caller is
+ * responsible for moving its libevent registration.
+ *
+ * @param c the connection to move
+ * @param to the thread to move it to
+ */
+void conn_migrate(Connection& c, FrontEndThread& to);
+
 /**
  * Signal all of the idle clients in the system.
  *
@@ -115,6 +115,7 @@ const std::string& Cookie::getErrorJson() {
 bool Cookie::execute() {
     // Reset ewouldblock state!
     setEwouldblock(false);
+    started = true;
     const auto& header = getHeader();
     if (header.isResponse()) {
         execute_response_packet(*this, header.getResponse());
@@ -294,13 +295,13 @@ void Cookie::sendResponse(cb::mcbp::Status status) {
             // The responseCounter is updated here as this is non-responding
             // code hence mcbp_add_header will not be called (which is what
             // normally updates the responseCounters).
-            auto& bucket = connection.getBucket();
-            ++bucket.responseCounters[int(cb::mcbp::Status::Success)];
+            connection.countResponse(cb::mcbp::Status::Success);
             connection.setState(StateMachine::State::new_cmd);
             return;
         }
 
         mcbp_add_header(*this, status, 0, 0, 0, PROTOCOL_BINARY_RAW_BYTES);
+        connection.setResponseDeferrable();
         connection.setState(StateMachine::State::send_data);
         connection.setWriteAndGo(StateMachine::State::new_cmd);
         return;
@@ -325,7 +326,7 @@ void Cookie::sendResponse(cb::mcbp::Status status,
                           cb::const_char_buffer value,
                           cb::mcbp::Datatype datatype,
                           uint64_t cas) {
-    if (!connection.write->empty()) {
+    if (!connection.write->empty() && !connection.hasDeferredResponses()) {
         // We can't continue as we might already have references
         // in the IOvector stack pointing into the existing buffer!
         throw std::logic_error(
@@ -358,10 +359,20 @@ void Cookie::sendResponse(cb::mcbp::Status status,
 
     size_t needed = sizeof(cb::mcbp::Header) + value.size() + key.size() +
                     extras.size();
-    if (isTracingEnabled()) {
+    if (isTracingResponseEnabled()) {
         needed += MCBP_TRACING_RESPONSE_SIZE;
     }
-    connection.write->ensureCapacity(needed);
+    if (connection.hasDeferredResponses()) {
+        // The iovecs of the responses we're holding back point into the
+        // write buffer, so we can't move it
+        if (needed > connection.write->wsize()) {
+            throw std::logic_error(
+                    "Cookie::sendResponse: Not enough space in the write "
+                    "buffer after the deferred responses");
+        }
+    } else {
+        connection.ensureWriteCapacity(needed);
+    }
 
     mcbp_add_header(*this,
                     status,
@@ -392,6 +403,8 @@ void Cookie::sendResponse(cb::mcbp::Status status,
         connection.addIov(wdata.data(), value.size());
     }
 
+    // The response only refers to the write buffer
+    connection.setResponseDeferrable();
     connection.setState(StateMachine::State::send_data);
     connection.setWriteAndGo(StateMachine::State::new_cmd);
 }
@@ -455,12 +468,57 @@ void Cookie::setCommandContext(CommandContext* ctx) {
     commandContext.reset(ctx);
 }
 
+/**
+ * Check if a slow operation which completed at the given time may be
+ * logged, given the adaptive configuration's limit on the slow operations
+ * logged per second.
+ *
+ * @param suppressed set to the number of slow operations not logged since
+ *                   the last one which was (if this one may be)
+ */
+static bool shouldLogSlowCommand(std::chrono::steady_clock::time_point now,
+                                 uint64_t& suppressed) {
+    static std::atomic<int64_t> window{0};
+    static std::atomic<size_t> logged{0};
+    static std::atomic<uint64_t> notLogged{0};
+
+    const auto config = cb::mcbp::sla::getAdaptiveConfig();
+    if (config.enabled && config.logLimit != 0) {
+        // Races with the start of a new second may log a few more
+        const int64_t second =
+                std::chrono::duration_cast<std::chrono::seconds>(
+                        now.time_since_epoch())
+                        .count();
+        auto current = window.load();
+        if (current != second &&
+            window.compare_exchange_strong(current, second)) {
+            logged = 0;
+        }
+        if (logged++ >= config.logLimit) {
+            ++notLogged;
+            return false;
+        }
+    }
+    suppressed = notLogged.exchange(0);
+    return true;
+}
+
 void Cookie::maybeLogSlowCommand(
         std::chrono::steady_clock::duration elapsed) const {
     const auto opcode = getRequest().getClientOpcode();
-    const auto limit = cb::mcbp::sla::getSlowOpThreshold(opcode);
+    auto limit = cb::mcbp::sla::getSlowOpThreshold(opcode);
+
+    // The threshold derived from the opcode's recent durations, if lower
+    const auto adaptive =
+            getConnection().getBucket().timings.get_slow_threshold(
+                    uint8_t(opcode));
+    if (adaptive.count() != 0) {
+        limit = std::min(limit, adaptive);
+    }
 
-    if (elapsed > limit) {
+    uint64_t suppressed = 0;
+    if (elapsed > limit &&
+        shouldLogSlowCommand(getStart() + elapsed, suppressed)) {
         const auto& header = getHeader();
         std::chrono::nanoseconds timings(elapsed);
         std::string command;
@@ -498,24 +556,29 @@ void Cookie::maybeLogSlowCommand(
 
         const std::string traceData = to_string(tracer);
         LOG_WARNING(
-                R"({}: Slow operation. {{"cid":"{}/{:x}","duration":"{}","trace":"{}","command":"{}","peer":"{}","bucket":"{}"}})",
+                R"({}: Slow operation. {{"cid":"{}/{:x}","duration":"{}","threshold":"{}","trace":"{}","command":"{}","peer":"{}","bucket":"{}","suppressed":{}}})",
                 c.getId(),
                 c.getConnectionId().data(),
                 ntohl(getHeader().getOpaque()),
                 cb::time2text(timings),
+                cb::time2text(limit),
                 traceData,
                 command,
                 c.getPeername(),
-                c.getBucket().name);
+                c.getBucket().name,
+                suppressed);
     }
 }
 
 Cookie::Cookie(Connection& conn) : connection(conn) {
 }
 
-void Cookie::initialize(cb::const_byte_buffer header, bool tracing_enabled) {
+void Cookie::initialize(cb::const_byte_buffer header,
+                        bool tracing_enabled,
+                        bool sampled) {
     reset();
     enableTracing = tracing_enabled;
+    Cookie::sampled = sampled;
     setPacket(Cookie::PacketContent::Header, header);
     setCas(0);
     start = std::chrono::steady_clock::now();
@@ -529,12 +592,16 @@ void Cookie::reset() {
     error_context.clear();
     json_message.clear();
     packet = {};
+    requestDetached = false;
+    started = false;
     cas = 0;
     commandContext.reset();
     dynamicBuffer.clear();
+    statsDelta = nullptr;
     tracer.clear();
     ewouldblock = false;
     openTracingContext.clear();
+    frameInfos = {};
 }
 
 void Cookie::setOpenTracingContext(cb::const_byte_buffer context) {
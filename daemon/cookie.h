@@ -19,9 +19,12 @@
 #include "dynamic_buffer.h"
 #include "tracing/tracer.h"
 
+#include <boost/optional/optional.hpp>
 #include <mcbp/protocol/datatype.h>
 #include <mcbp/protocol/status.h>
+#include <memcached/dcp_stream_id.h>
 #include <memcached/dockey.h>
+#include <memcached/durability_spec.h>
 #include <memcached/engine_error.h>
 #include <nlohmann/json.hpp>
 #include <platform/sized_buffer.h>
@@ -31,6 +34,7 @@
 class Connection;
 class CommandContext;
 struct CookieTraceContext;
+class StatsDeltaSnapshot;
 namespace cb {
 namespace mcbp {
 class Header;
@@ -66,8 +70,13 @@ public:
      *
      * @param header the packet header
      * @param tracing_enabled if tracing is enabled for this request
+     * @param sampled if the request was picked by the thread's
+     *                RequestSampler (its spans are recorded, but unlike
+     *                tracing_enabled the response is unchanged)
      */
-    void initialize(cb::const_byte_buffer header, bool tacing_enabled);
+    void initialize(cb::const_byte_buffer header,
+                    bool tacing_enabled,
+                    bool sampled = false);
 
     /**
      * Reset the Cookie object to allow it to be reused in the same
@@ -176,6 +185,18 @@ public:
         return dynamicBuffer;
     }
 
+    /**
+     * Get the snapshot the stats added by the current ("stats delta")
+     * command are filtered against, or nullptr if all of them are to be sent.
+     */
+    StatsDeltaSnapshot* getStatsDelta() const {
+        return statsDelta;
+    }
+
+    void setStatsDelta(StatsDeltaSnapshot* snapshot) {
+        statsDelta = snapshot;
+    }
+
     /**
      * Execute the current packet
      *
@@ -246,6 +267,33 @@ public:
         setPacket(PacketContent::Full, getPacket(), true);
     }
 
+    /**
+     * Preserve the input packet so that it may be consumed from the
+     * connection's input buffer before the command completes (the
+     * connection carries on reading and executing the following commands
+     * while an unordered command is blocked in the engine).
+     */
+    void detachRequest() {
+        preserveRequest();
+        requestDetached = true;
+    }
+
+    /**
+     * Has the input packet been consumed from the connection's input
+     * buffer (see detachRequest())?
+     */
+    bool isRequestDetached() const {
+        return requestDetached;
+    }
+
+    /**
+     * Has the execution of the command been started (it may be blocked
+     * waiting for the engine)?
+     */
+    bool isStarted() const {
+        return started;
+    }
+
     /**
      * Get the packet header for the current packet. The packet header
      * allows for getting the various common fields in a packet (request and
@@ -451,14 +499,28 @@ public:
         return start;
     }
 
+    /// Are the spans of the request being recorded in its Tracer?
     bool isTracingEnabled() const {
-        return enableTracing;
+        return enableTracing || sampled;
     }
 
     void setTracingEnabled(bool enable) {
         enableTracing = enable;
     }
 
+    /**
+     * Did the client enable tracing for the request (so its response
+     * should include the server duration)?
+     */
+    bool isTracingResponseEnabled() const {
+        return enableTracing;
+    }
+
+    /// Was the request picked by the thread's RequestSampler?
+    bool isSampled() const {
+        return sampled;
+    }
+
     cb::tracing::Tracer& getTracer() {
         return tracer;
     }
@@ -493,6 +555,27 @@ public:
         Cookie::engine_storage = engine_storage;
     }
 
+    /**
+     * The frame infos of the request, decoded once when the packet is
+     * validated so that the executors don't have to parse the framing
+     * extras again. (The OpenTracing context is kept separately, see
+     * setOpenTracingContext)
+     */
+    struct FrameInfos {
+        boost::optional<cb::durability::Requirements> durability;
+        cb::mcbp::DcpStreamId dcpStreamId;
+        /// The request has the Reorder frame info, and may be reordered
+        bool reorderable = false;
+    };
+
+    FrameInfos& getFrameInfos() {
+        return frameInfos;
+    }
+
+    const FrameInfos& getFrameInfos() const {
+        return frameInfos;
+    }
+
     void setOpenTracingContext(cb::const_byte_buffer context);
 
     /**
@@ -514,12 +597,15 @@ public:
 
 protected:
     bool enableTracing = false;
+    bool sampled = false;
     cb::tracing::Tracer tracer;
 
     /// The tracing context provided by the client to use as the
     /// parent span
     std::string openTracingContext;
 
+    FrameInfos frameInfos;
+
     /**
      * The connection object this cookie is bound to
      */
@@ -546,12 +632,22 @@ protected:
      */
     std::unique_ptr<uint8_t[]> received_packet;
 
+    /// Set when the packet is consumed from the input buffer before the
+    /// command is executed
+    bool requestDetached = false;
+
+    /// Set when the command is executed for the first time
+    bool started = false;
+
     /**
      * The dynamic buffer is used to format output packets to be sent on
      * the wire.
      */
     DynamicBuffer dynamicBuffer;
 
+    /// The snapshot of the stats delta being sent (if any)
+    StatsDeltaSnapshot* statsDelta = nullptr;
+
     /** The cas to return back to the client */
     uint64_t cas = 0;
 
@@ -16,22 +16,33 @@
  */
 
 #include "executor.h"
+#include "executorpool.h"
 #include "task.h"
 
 #include <algorithm>
 #include <iostream>
 
 Executor::~Executor() {
+    requestShutdown();
+    join();
+}
+
+void Executor::join() {
     std::unique_lock<std::mutex> lock(mutex);
-    shutdown = true;
-    idlecond.notify_all();
     // Wait until the thread stops
     while (running) {
         shutdowncond.wait(lock);
     }
+    lock.unlock();
     waitForState(Couchbase::ThreadState::Zombie);
 }
 
+void Executor::requestShutdown() {
+    std::lock_guard<std::mutex> guard(mutex);
+    shutdown = true;
+    idlecond.notify_all();
+}
+
 void Executor::run() {
     running = true;
     // According to the spec we have to call setRunning (that'll notify the
@@ -39,53 +50,45 @@ void Executor::run() {
     setRunning();
 
     while (true) {
-        std::unique_lock<std::mutex> lock(mutex);
-        while (!shutdown && runq.empty()) {
-            idlecond.wait(lock);
+        std::shared_ptr<Task> task;
+        std::chrono::steady_clock::time_point runnable;
+        // Read before looking for work, so that we don't miss work made
+        // runnable (or a class of tasks allowed to run again) on another
+        // executor while we look
+        const auto generation = pool ? pool->getWorkGeneration() : 0;
+        uint64_t seen;
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            if (shutdown) {
+                break;
+            }
+            popRunnable(task, runnable);
+            // The runq may not be empty, as it may only hold tasks of
+            // classes which can't run now. Wait for more to be pushed.
+            seen = pushes;
         }
 
-        if (shutdown) {
-            break;
+        if (!task && (pool == nullptr || !pool->steal(*this, task, runnable))) {
+            std::unique_lock<std::mutex> lock(mutex);
+            idlecond.wait(lock, [this, generation, seen]() {
+                return shutdown || pushes != seen ||
+                       (pool && pool->getWorkGeneration() != generation);
+            });
+            continue;
         }
 
-        auto task = runq.front();
-        runq.pop();
-
-        // Release the lock so that others may schedule new events
-        lock.unlock();
-
-        // Lock the task so no one else can touch it and we won't
-        // have any races..
-        task->getMutex().lock();
-        if (task->execute() == Task::Status::Finished) {
-            // Unlock the mutex, we're not going to use this anymore
-            // By not holding the mutex in notifyExecutionComplete
-            // we won't get any warnings from ThreadSanitizer by
-            // locking in oposite order (typically you hold the thread
-            // mutex when you create a task, and then aqcuire the task
-            // lock. This time we aqcuired the task mutex first and the
-            // notification method will try to grab the thread lock later
-            // on..
-            task->getMutex().unlock();
-
-            // tell the task that the executor consider it done with the
-            // task and will no longer operate on it.
-            task->notifyExecutionComplete();
-        } else {
-            // put it in the wait-queue.. We need the lock for the waitq
-            lock.lock();
-            waitq[task.get()] = task;
-            lock.unlock();
-            // Release the task lock so that the backend thread may start
-            // using it
-            task->getMutex().unlock();
-        }
+        runTask(std::move(task), runnable);
     }
 
     // move all items in future-queue out of the wait-queue
-    for (const auto& ftask : futureq) {
-        std::lock_guard<std::mutex> guard(ftask.first->getMutex());
-        makeRunnable(ftask.first);
+    std::vector<Task*> futureTasks;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        futureTasks = futureq.clear();
+    }
+    for (auto* ftask : futureTasks) {
+        std::lock_guard<std::mutex> guard(ftask->getMutex());
+        makeRunnable(ftask);
     }
 
     // wait for the wait-queue to drain...
@@ -98,15 +101,96 @@ void Executor::run() {
     shutdowncond.notify_all();
 }
 
-void Executor::schedule(const std::shared_ptr<Task>& task, bool runnable) {
-    std::lock_guard<std::mutex> guard(mutex);
-    task->setExecutor(this);
+void Executor::runTask(std::shared_ptr<Task> task,
+                       std::chrono::steady_clock::time_point runnable) {
+    busy = true;
+    const auto taskClass = task->getClass();
+    const auto start = std::chrono::steady_clock::now();
 
-    if (runnable) {
-        runq.push(task);
-        idlecond.notify_all();
+    // Lock the task so no one else can touch it and we won't
+    // have any races..
+    task->getMutex().lock();
+    if (task->execute() == Task::Status::Finished) {
+        // Unlock the mutex, we're not going to use this anymore
+        // By not holding the mutex in notifyExecutionComplete
+        // we won't get any warnings from ThreadSanitizer by
+        // locking in oposite order (typically you hold the thread
+        // mutex when you create a task, and then aqcuire the task
+        // lock. This time we aqcuired the task mutex first and the
+        // notification method will try to grab the thread lock later
+        // on..
+        task->getMutex().unlock();
+
+        // tell the task that the executor consider it done with the
+        // task and will no longer operate on it.
+        task->notifyExecutionComplete();
     } else {
-        waitq[task.get()] = task;
+        // put it in the wait-queue of the executor it's pinned to (which
+        // may not be us if we stole it). We need its lock for the waitq
+        auto& owner = *task->executor;
+        {
+            std::lock_guard<std::mutex> guard(owner.mutex);
+            owner.waitq[task.get()] = task;
+        }
+        // Release the task lock so that the backend thread may start
+        // using it
+        task->getMutex().unlock();
+    }
+
+    if (pool) {
+        pool->finishTask(taskClass,
+                         start - runnable,
+                         std::chrono::steady_clock::now() - start);
+    }
+    busy = false;
+}
+
+void Executor::pushRunnable(std::shared_ptr<Task> task) {
+    runq.push_back({std::move(task), std::chrono::steady_clock::now()});
+    ++pushes;
+    idlecond.notify_all();
+}
+
+bool Executor::popRunnable(std::shared_ptr<Task>& task,
+                           std::chrono::steady_clock::time_point& runnable) {
+    for (auto iter = runq.begin(); iter != runq.end(); ++iter) {
+        if (pool == nullptr || pool->tryStartTask(iter->task->getClass())) {
+            task = std::move(iter->task);
+            runnable = iter->runnable;
+            runq.erase(iter);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Executor::steal(std::shared_ptr<Task>& task,
+                     std::chrono::steady_clock::time_point& runnable) {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (shutdown) {
+        return false;
+    }
+    return popRunnable(task, runnable);
+}
+
+void Executor::wake() {
+    std::lock_guard<std::mutex> guard(mutex);
+    idlecond.notify_all();
+}
+
+void Executor::schedule(const std::shared_ptr<Task>& task, bool runnable) {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        task->setExecutor(this);
+
+        if (!runnable) {
+            waitq[task.get()] = task;
+            return;
+        }
+        pushRunnable(task);
+    }
+    if (pool && busy) {
+        pool->notifyWork(*this);
     }
 }
 
@@ -117,14 +201,19 @@ void Executor::makeRunnable(Task* task) {
             "The mutex should be held when trying to reschedule a event");
     }
 
-    std::lock_guard<std::mutex> guard(mutex);
-    auto iter = waitq.find(task);
-    if (iter == waitq.end()) {
-        throw std::runtime_error("Internal error object is not in the waitq");
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        auto iter = waitq.find(task);
+        if (iter == waitq.end()) {
+            throw std::runtime_error(
+                    "Internal error object is not in the waitq");
+        }
+        pushRunnable(iter->second);
+        waitq.erase(iter);
+    }
+    if (pool && busy) {
+        pool->notifyWork(*this);
     }
-    runq.push(iter->second);
-    waitq.erase(iter);
-    idlecond.notify_all();
 }
 
 void Executor::makeRunnable(Task& task,
@@ -136,7 +225,7 @@ void Executor::makeRunnable(Task& task,
     }
 
     std::lock_guard<std::mutex> guard(mutex);
-    futureq.emplace_back(&task, time);
+    futureq.add(&task, time);
 }
 
 void Executor::clockTick() {
@@ -144,19 +233,7 @@ void Executor::clockTick() {
 
     {
         std::lock_guard<std::mutex> guard(mutex);
-        auto now = clock.now();
-
-        futureq.erase(
-                std::remove_if(futureq.begin(),
-                               futureq.end(),
-                               [&now, &wakeableTasks](FutureTask& ftask) {
-                                   if (ftask.second <= now) {
-                                       wakeableTasks.push_back(ftask.first);
-                                       return true;
-                                   }
-                                   return false;
-                               }),
-                futureq.end());
+        futureq.removeDue(clock.now(), wakeableTasks);
     }
 
     // Need to do this without holding the executor lock to avoid lock inversion
@@ -181,8 +258,65 @@ size_t Executor::futureqSize() const {
     return futureq.size();
 }
 
-std::unique_ptr<Executor> createWorker(cb::ProcessClockSource& clock) {
-    auto* executor = new Executor(clock);
+int64_t Executor::FutureQueue::toSeconds(
+        std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+                   time.time_since_epoch())
+            .count();
+}
+
+void Executor::FutureQueue::add(Task* task,
+                                std::chrono::steady_clock::time_point time) {
+    // A task due before the last tick goes in the slot of the last tick
+    // (which the next tick looks at) rather than waiting for a whole turn
+    const auto second = std::max(toSeconds(time), lastTick);
+    slots[size_t(second) % Slots].emplace_back(task, time);
+    ++count;
+}
+
+void Executor::FutureQueue::removeDue(std::chrono::steady_clock::time_point now,
+                                      std::vector<Task*>& tasks) {
+    const auto second = toSeconds(now);
+    // Look at the slots from the last tick up to now (or all of them, if
+    // there wasn't a tick in the last turn of the wheel)
+    const auto first =
+            (lastTick < 0 || second - lastTick >= int64_t(Slots))
+                    ? second - int64_t(Slots) + 1
+                    : lastTick;
+    const auto before = tasks.size();
+    for (auto ii = first; ii <= second && count > tasks.size() - before;
+         ++ii) {
+        auto& slot = slots[size_t(ii) % Slots];
+        slot.erase(std::remove_if(slot.begin(),
+                                  slot.end(),
+                                  [&now, &tasks](FutureTask& ftask) {
+                                      if (ftask.second <= now) {
+                                          tasks.push_back(ftask.first);
+                                          return true;
+                                      }
+                                      return false;
+                                  }),
+                   slot.end());
+    }
+    count -= tasks.size() - before;
+    lastTick = std::max(lastTick, second);
+}
+
+std::vector<Task*> Executor::FutureQueue::clear() {
+    std::vector<Task*> tasks;
+    for (auto& slot : slots) {
+        for (const auto& ftask : slot) {
+            tasks.push_back(ftask.first);
+        }
+        slot.clear();
+    }
+    count = 0;
+    return tasks;
+}
+
+std::unique_ptr<Executor> createWorker(cb::ProcessClockSource& clock,
+                                       ExecutorPool* pool) {
+    auto* executor = new Executor(clock, pool);
     executor->start();
     return std::unique_ptr<Executor>(executor);
 }
@@ -19,16 +19,19 @@
 #include <platform/processclock.h>
 #include <platform/thread.h>
 
+#include <array>
 #include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <memory>
-#include <queue>
 #include <unordered_map>
+#include <vector>
 
 /**
  * Forward decl of the Task to avoid circular dependencies
  */
 class Task;
+class ExecutorPool;
 
 /**
  * The Executor class represents a single executor thread. It keeps
@@ -37,14 +40,24 @@ class Task;
  * makeRunnable (NOTE: you should hold the command's lock when calling that),
  * and it is NOT allowed to call it from any of the executors threads (that
  * may create deadlock)
+ *
+ * A task is pinned to the executor it was scheduled on: that executor
+ * keeps it in its queues. If the executor belongs to an ExecutorPool, an
+ * idle executor of the pool may steal a runnable task to run it (after
+ * which it's put back in the waitq of its own executor), so that a slow
+ * task doesn't hold up the tasks queued behind it.
  */
 class Executor : public Couchbase::Thread {
 public:
     /**
      * Initialize the Executor object
+     *
+     * @param clock the clock source for the futureq
+     * @param pool the pool the executor belongs to (and steals work from),
+     *             if any
      */
-    Executor(cb::ProcessClockSource& clock)
-        : Couchbase::Thread("mc:executor"), clock(clock) {
+    Executor(cb::ProcessClockSource& clock, ExecutorPool* pool = nullptr)
+        : Couchbase::Thread("mc:executor"), clock(clock), pool(pool) {
         shutdown.store(false);
         running.store(false);
     }
@@ -77,6 +90,32 @@ public:
      */
     void clockTick();
 
+    /**
+     * Ask the executor thread to stop, without waiting for it to do so
+     * (the destructor waits).
+     */
+    void requestShutdown();
+
+    /// Wait for the executor thread to stop (once asked to)
+    void join();
+
+    /**
+     * Take the first runnable task (of a class which may run now) from
+     * the runq, to run it on another executor of the pool.
+     *
+     * @return false if there's no such task
+     */
+    bool steal(std::shared_ptr<Task>& task,
+               std::chrono::steady_clock::time_point& runnable);
+
+    /// Is the executor thread running a task?
+    bool isBusy() const {
+        return busy;
+    }
+
+    /// Wake the executor thread if it's waiting for work
+    void wake();
+
     size_t waitqSize() const;
 
     size_t runqSize() const;
@@ -86,6 +125,20 @@ public:
 protected:
     void run() override;
 
+    /// Run a task taken from the runq of this (or another) executor
+    void runTask(std::shared_ptr<Task> task,
+                 std::chrono::steady_clock::time_point runnable);
+
+    /// Put a task in the runq. The mutex must be held
+    void pushRunnable(std::shared_ptr<Task> task);
+
+    /**
+     * Take the first task of the runq whose class may run now (see
+     * ExecutorPool::tryStartTask). The mutex must be held.
+     */
+    bool popRunnable(std::shared_ptr<Task>& task,
+                     std::chrono::steady_clock::time_point& runnable);
+
     /**
      * Is shutdown requested?
      */
@@ -95,6 +148,9 @@ protected:
      */
     std::atomic_bool running;
 
+    /// Is the thread running a task (rather than looking for one)?
+    std::atomic_bool busy{false};
+
     /**
      * All the data structures (and condition variables) is using this
      * single lock...
@@ -103,10 +159,19 @@ protected:
      */
     mutable std::mutex mutex;
 
+    struct RunnableTask {
+        std::shared_ptr<Task> task;
+        /// When the task was made runnable
+        std::chrono::steady_clock::time_point runnable;
+    };
+
     /**
      * The FIFO queue of commands ready to run
      */
-    std::queue<std::shared_ptr<Task> > runq;
+    std::deque<RunnableTask> runq;
+
+    /// The number of tasks ever pushed to the runq
+    uint64_t pushes = 0;
 
     /**
      * When a task is being served by a backend thread it is put in
@@ -125,11 +190,38 @@ protected:
      * then it is placed in the "future queue" with its time (at the same
      * time as being in the wait queue).
      *
-     * This vector *could* justifiably be sorted by time to reduce how
-     * much of it needs processing each time. But vectors are fast so it
-     * shouldn't be noticeable for the small size this should be.
+     * The future queue is a timer wheel of one second slots (the
+     * resolution of clockTick), so that each tick only looks at the tasks
+     * due in the seconds since the previous tick rather than at all of
+     * them. A task due more than a turn of the wheel away stays in its
+     * slot until the turn it's due in.
      */
-    std::vector<FutureTask> futureq;
+    class FutureQueue {
+    public:
+        void add(Task* task, std::chrono::steady_clock::time_point time);
+
+        /// Remove the tasks due by now, and append them to tasks
+        void removeDue(std::chrono::steady_clock::time_point now,
+                       std::vector<Task*>& tasks);
+
+        /// Remove and return all of the tasks
+        std::vector<Task*> clear();
+
+        size_t size() const {
+            return count;
+        }
+
+    protected:
+        static const size_t Slots = 64;
+
+        static int64_t toSeconds(std::chrono::steady_clock::time_point time);
+
+        std::array<std::vector<FutureTask>, Slots> slots;
+        size_t count = 0;
+        /// The second of the last tick; its slot is looked at again by the
+        /// next tick, as it may hold tasks due later in that second
+        int64_t lastTick = -1;
+    } futureq;
 
     /**
      * When the runqueue is empty the executor thread blocks on this condition
@@ -148,6 +240,10 @@ protected:
      * Mostly intended for allowing mocking of the time source in testing.
      */
     cb::ProcessClockSource& clock;
+
+    /// The pool the executor belongs to (if any)
+    ExecutorPool* const pool;
 };
 
-std::unique_ptr<Executor> createWorker(cb::ProcessClockSource& clock);
+std::unique_ptr<Executor> createWorker(cb::ProcessClockSource& clock,
+                                       ExecutorPool* pool = nullptr);
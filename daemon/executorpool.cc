@@ -28,14 +28,32 @@ ExecutorPool::ExecutorPool(size_t sz)
     : ExecutorPool(sz, cb::defaultProcessClockSource()) {
 }
 
-ExecutorPool::ExecutorPool(size_t sz, cb::ProcessClockSource& clock) {
+ExecutorPool::ExecutorPool(size_t sz, cb::ProcessClockSource& clock)
+    : maxPerClass(sz > 1 ? sz - 1 : 1) {
     roundRobin.store(0);
     executors.reserve(sz);
     for (size_t ii = 0; ii < sz; ++ii) {
-        executors.emplace_back(createWorker(clock));
+        executors.emplace_back(std::make_unique<Executor>(clock, this));
+    }
+    // Start them once they're all in place, as they look at each other
+    // when they steal work
+    for (const auto& executor : executors) {
+        executor->start();
     }
 }
 
+ExecutorPool::~ExecutorPool() {
+    // Stop all of the executors before destroying any of them, as an
+    // executor may be stealing from another
+    for (const auto& executor : executors) {
+        executor->requestShutdown();
+    }
+    for (const auto& executor : executors) {
+        executor->join();
+    }
+    executors.clear();
+}
+
 void ExecutorPool::schedule(std::shared_ptr<Task>& task, bool runnable) {
     if (task->getMutex().try_lock()) {
         task->getMutex().unlock();
@@ -52,6 +70,57 @@ void ExecutorPool::clockTick() {
     }
 }
 
+bool ExecutorPool::tryStartTask(Task::Class taskClass) {
+    auto& counter = running[size_t(taskClass)];
+    auto current = counter.load();
+    do {
+        if (current >= maxPerClass) {
+            return false;
+        }
+    } while (!counter.compare_exchange_weak(current, current + 1));
+    return true;
+}
+
+void ExecutorPool::finishTask(Task::Class taskClass,
+                              std::chrono::steady_clock::duration wait,
+                              std::chrono::steady_clock::duration runtime) {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    waitTimes[size_t(taskClass)].add(duration_cast<microseconds>(wait));
+    runtimes[size_t(taskClass)].add(duration_cast<microseconds>(runtime));
+
+    if (running[size_t(taskClass)]-- == maxPerClass) {
+        // The tasks of the class held back may run now
+        ++workGeneration;
+        for (const auto& executor : executors) {
+            executor->wake();
+        }
+    }
+}
+
+bool ExecutorPool::steal(Executor& thief,
+                         std::shared_ptr<Task>& task,
+                         std::chrono::steady_clock::time_point& runnable) {
+    // Start at a different executor each time to spread the thefts
+    const auto start = size_t(++roundRobin);
+    for (size_t ii = 0; ii < executors.size(); ++ii) {
+        auto& victim = *executors[(start + ii) % executors.size()];
+        if (&victim != &thief && victim.steal(task, runnable)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ExecutorPool::notifyWork(Executor& source) {
+    ++workGeneration;
+    for (const auto& executor : executors) {
+        if (executor.get() != &source && !executor->isBusy()) {
+            executor->wake();
+        }
+    }
+}
+
 size_t ExecutorPool::waitqSize() const {
     size_t count = 0;
     for (const auto& executor : executors) {
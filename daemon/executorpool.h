@@ -16,7 +16,13 @@
  */
 #pragma once
 
+#include "task.h"
+
+#include <utilities/hdrhistogram.h>
+
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <memory>
 #include <mutex>
 #include <vector>
@@ -25,12 +31,16 @@ namespace cb {
 struct ProcessClockSource;
 }
 class Executor;
-class Task;
 
 /**
  * As the name implies the ExecutorPool is pool of executors to execute
- * tasks. A task is pinned to a thread when it is being scheduled
- * (by using round robin) and never switch the thread.
+ * tasks. A task is pinned to an executor when it is being scheduled
+ * (by using round robin) and never switch the executor, but when it's
+ * runnable an idle executor may steal it to run it (see Executor).
+ *
+ * The tasks of a single class (see Task::Class) may only occupy all but
+ * one of the executors at a time, so that (for example) a burst of slow
+ * stats tasks can't hold up authentication.
  */
 class ExecutorPool {
 public:
@@ -48,6 +58,8 @@ public:
 
     ExecutorPool(const ExecutorPool &) = delete;
 
+    ~ExecutorPool();
+
     /**
      * Schedule a task for execution at some time. The tasks mutex
      * must be held while calling this method to avoid race conditions.
@@ -72,6 +84,54 @@ public:
 
     size_t futureqSize() const;
 
+    /// Get the distribution of the time tasks of the class ran for
+    const Hdr1sfMicroSecHistogram& getRuntimes(Task::Class taskClass) const {
+        return runtimes[size_t(taskClass)];
+    }
+
+    /// Get the distribution of the time tasks of the class were runnable
+    /// before they started to run
+    const Hdr1sfMicroSecHistogram& getWaitTimes(Task::Class taskClass) const {
+        return waitTimes[size_t(taskClass)];
+    }
+
+    // Interface for the Executors of the pool
+
+    /**
+     * Account for an executor starting a task of the given class.
+     *
+     * @return false if the class already occupies as many executors as
+     *         it may
+     */
+    bool tryStartTask(Task::Class taskClass);
+
+    /// Account for an executor having run a task of the given class
+    void finishTask(Task::Class taskClass,
+                    std::chrono::steady_clock::duration wait,
+                    std::chrono::steady_clock::duration runtime);
+
+    /**
+     * Find a runnable task on another executor for the idle executor to
+     * run.
+     *
+     * @return false if there's none
+     */
+    bool steal(Executor& thief,
+               std::shared_ptr<Task>& task,
+               std::chrono::steady_clock::time_point& runnable);
+
+    /**
+     * A task became runnable on the (busy) executor, or a task finished:
+     * wake the idle executors to steal it (or the tasks held back by
+     * tryStartTask).
+     */
+    void notifyWork(Executor& source);
+
+    /// Changes every time notifyWork is called
+    uint64_t getWorkGeneration() const {
+        return workGeneration;
+    }
+
 private:
     /**
      * The actual list of executors
@@ -83,4 +143,15 @@ private:
      * worker threads
      */
     std::atomic_int roundRobin;
+
+    /// The most executors the tasks of a single class may occupy
+    size_t maxPerClass = 0;
+
+    /// The number of executors running a task of each class
+    std::array<std::atomic<size_t>, Task::NumClasses> running{};
+
+    std::atomic<uint64_t> workGeneration{0};
+
+    std::array<Hdr1sfMicroSecHistogram, Task::NumClasses> runtimes;
+    std::array<Hdr1sfMicroSecHistogram, Task::NumClasses> waitTimes;
 };
@@ -17,13 +17,21 @@
 
 #pragma once
 
-#include <JSON_checker.h>
+#include "json_validator.h"
+#include "pipe_pool.h"
+#include "request_sampler.h"
+#include "subdocument_index.h"
+
 #include <event.h>
 #include <memcached/engine_error.h>
 #include <platform/platform_thread.h>
 #include <platform/socket.h>
 #include <subdoc/operations.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <mutex>
 #include <queue>
 #include <unordered_map>
@@ -36,6 +44,7 @@ class Pipe;
 
 class Cookie;
 class Connection;
+class Hdr1sfMicroSecHistogram;
 struct thread_stats;
 
 using SharedListeningPort = std::shared_ptr<ListeningPort>;
@@ -71,9 +80,23 @@ struct FrontEndThread {
      * The various worker threads are listening on index 0,
      * and in order to notify the thread other threads will
      * write data to index 1.
+     *
+     * On Linux the worker threads use an eventfd instead of a socket
+     * pair (see notify_eventfd), in which case both entries hold it.
      */
     SOCKET notify[2] = {INVALID_SOCKET, INVALID_SOCKET};
 
+    /// Is notify an eventfd (rather than a socket pair)?
+    bool notify_eventfd = false;
+
+    /**
+     * Set by notify_thread when it wakes the thread, and cleared by the
+     * thread when it wakes up (before it looks for work). While set,
+     * further notifications only need to queue their work: the thread is
+     * already going to look at it, so no more syscalls are needed.
+     */
+    std::atomic_bool notification_pending{false};
+
     /**
      * The dispatcher accepts new clients and needs to dispatch them
      * to the worker threads. In order to do so we use the ConnectionQueue
@@ -101,6 +124,42 @@ struct FrontEndThread {
         PendingIoMap map;
     } pending_io;
 
+    /**
+     * Connections which yielded (see conn_new_cmd) with their next
+     * command(s) already buffered, and when they did so. One queue per
+     * Connection::Priority (highest first). They get their next timeslice
+     * from run_queue_event rather than by going back through libevent for
+     * an IO event, and are only ever touched by this thread.
+     */
+    std::array<std::deque<std::pair<Connection*,
+                                    std::chrono::steady_clock::time_point>>,
+               3>
+            run_queue;
+
+    /// Timer (with a zero timeout) which runs the run_queue
+    struct event run_queue_event = {};
+
+    /// Is run_queue_event pending?
+    bool run_queue_scheduled = false;
+
+    /**
+     * Connections deferred (see throttle_connection) because their bucket
+     * was over its front-end budget: when they were deferred, and when
+     * they may try again. Only ever touched by this thread.
+     */
+    struct ThrottledConnection {
+        Connection* connection;
+        std::chrono::steady_clock::time_point deferred;
+        std::chrono::steady_clock::time_point until;
+    };
+    std::deque<ThrottledConnection> throttled;
+
+    /// Timer which resumes the throttled connections
+    struct event throttle_event = {};
+
+    /// When throttle_event fires, if it's pending
+    std::chrono::steady_clock::time_point throttle_scheduled{};
+
     /// A list of connections to signal if they're idle
     class NotificationList {
     public:
@@ -116,11 +175,9 @@ struct FrontEndThread {
     /// index of this thread in the threads array
     size_t index = 0;
 
-    /// Shared read buffer for all connections serviced by this thread.
-    std::unique_ptr<cb::Pipe> read;
-
-    /// Shared write buffer for all connections serviced by this thread.
-    std::unique_ptr<cb::Pipe> write;
+    /// Read and write buffers loaned to the connections while they're
+    /// being served by this thread.
+    PipePool pipes;
 
     /**
      * Shared sub-document operation for all connections serviced by this
@@ -128,16 +185,109 @@ struct FrontEndThread {
      */
     Subdoc::Operation subdoc_op;
 
+    /**
+     * Cached indexes of the (large) documents recently looked up by the
+     * connections serviced by this thread
+     */
+    SubdocIndexCache subdoc_index_cache;
+
     /**
      * Shared validator used by all connections serviced by this thread
      * when they need to validate a JSON document
      */
-    JSON_checker::Validator validator;
+    JsonValidator validator;
+
+    /// The sample of the requests executed by this thread
+    RequestSampler request_sampler;
 
     /// Is the thread running or not
     std::atomic_bool running{false};
+
+    /**
+     * Connections moved to this thread from a busier one (see
+     * maybe_migrate_connection), waiting to be registered with this
+     * thread's event base.
+     */
+    NotificationList migrated;
+
+    /// Number of connections bound to this thread
+    std::atomic<size_t> num_connections{0};
+
+    /// Total time spent running connections on this thread, in nanoseconds
+    std::atomic<uint64_t> busy_time{0};
+
+    /**
+     * The busy_time accumulated over the most recent load sample interval
+     * (see sample_front_end_thread_load), in nanoseconds
+     */
+    std::atomic<uint64_t> recent_busy_time{0};
+
+    /// busy_time when the load was last sampled (guarded by the sample lock)
+    uint64_t busy_time_at_sample = 0;
+
+    /// Connections moved to / from this thread
+    std::atomic<uint64_t> migrated_in{0};
+    std::atomic<uint64_t> migrated_out{0};
+};
+
+/// @return the front-end thread with the given index
+FrontEndThread& get_front_end_thread(size_t index);
+
+/// Per-thread load, as reported by "stats worker_thread_info load"
+struct FrontEndThreadLoad {
+    size_t connections;
+    /// Total busy time, in microseconds
+    uint64_t busy_time;
+    /// Percentage of the last load sample interval the thread was busy
+    uint64_t utilization;
+    uint64_t migrated_in;
+    uint64_t migrated_out;
 };
 
+/// @return the load of each front-end thread, by thread index
+std::vector<FrontEndThreadLoad> get_front_end_thread_load();
+
+/**
+ * Called after a connection has been run on its thread (with the thread
+ * locked). If connection rebalancing is enabled, the connection is idle
+ * between commands, and moving it to the least loaded front-end thread
+ * would reduce the load on the busiest, hand it over to that thread.
+ */
+void maybe_migrate_connection(Connection& c);
+
+/**
+ * Put a connection (which yielded with more work already buffered) on
+ * its thread's run queue. Must be called from the connection's thread.
+ */
+void schedule_connection(Connection& c);
+
+/**
+ * Defer a connection (which is about to start a command, but whose bucket
+ * is over its BucketThrottle budget) until the given time, when it's run
+ * again from its thread's throttle_event. The connection must not be
+ * waiting for any IO events. Must be called from the connection's thread.
+ */
+void throttle_connection(Connection& c,
+                         std::chrono::steady_clock::time_point until);
+
+/**
+ * Remove a connection from its thread's run queue (or the throttled
+ * connections), if it's there. Must be called from the connection's thread.
+ */
+void unschedule_connection(Connection& c);
+
+/**
+ * Get the distribution of time connections of the given priority (a
+ * Connection::Priority) spent waiting on the front-end threads' run
+ * queues.
+ */
+Hdr1sfMicroSecHistogram get_run_queue_wait(size_t priority);
+
+/**
+ * Wake the thread to process its queued work (new / migrated connections,
+ * pending IO notifications, ...). Coalesced: if the thread has already
+ * been woken but hasn't started processing yet, this is a no-op.
+ */
 void notify_thread(FrontEndThread& thread);
 void notify_dispatcher();
 void drain_notification_channel(evutil_socket_t fd);
\ No newline at end of file
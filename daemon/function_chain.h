@@ -107,7 +107,7 @@ public:
     ReturnType invoke(arguments... args) const {
         ReturnType rval = Success;
 
-        for (auto function : chain) {
+        for (const auto& function : chain) {
             if ((rval = function(args...)) != Success) {
                 return rval;
             }
@@ -0,0 +1,317 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "json_validator.h"
+
+#include <cstring>
+
+/*
+ * All of the functions below take the position to parse from and the end of
+ * the value, and return the position following what they parsed - or
+ * nullptr if it isn't valid.
+ */
+
+static const uint64_t ones = 0x0101010101010101ULL;
+static const uint64_t highs = 0x8080808080808080ULL;
+
+static inline uint64_t load_word(const uint8_t* ptr) {
+    uint64_t word;
+    std::memcpy(&word, ptr, sizeof(word));
+    return word;
+}
+
+/// @return non-zero if any byte of word is less than n (n <= 0x80)
+static inline uint64_t has_less(uint64_t word, uint8_t n) {
+    return (word - ones * n) & ~word & highs;
+}
+
+/// @return non-zero if any byte of word is equal to c
+static inline uint64_t has_byte(uint64_t word, uint8_t c) {
+    return has_less(word ^ (ones * c), 1);
+}
+
+/**
+ * @return true if any byte of word needs to be looked at within a string:
+ *         the closing quote, an escape, a control character (which must be
+ *         escaped) or part of a multi-byte UTF-8 sequence.
+ */
+static inline bool is_special(uint64_t word) {
+    return (has_less(word, 0x20) | has_byte(word, '"') | has_byte(word, '\\') |
+            (word & highs)) != 0;
+}
+
+static inline bool is_digit(uint8_t c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline bool is_hex_digit(uint8_t c) {
+    return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static const uint8_t* skip_whitespace(const uint8_t* ptr, const uint8_t* end) {
+    while (ptr < end &&
+           (*ptr == ' ' || *ptr == '\n' || *ptr == '\r' || *ptr == '\t')) {
+        ++ptr;
+    }
+    return ptr;
+}
+
+/// Validate the multi-byte UTF-8 sequence at ptr (as per RFC 3629).
+static const uint8_t* parse_utf8_sequence(const uint8_t* ptr,
+                                          const uint8_t* end) {
+    const uint8_t c = *ptr;
+    size_t continuations;
+    // The range of the first continuation byte, which excludes overlong
+    // encodings, surrogates and code points above U+10FFFF.
+    uint8_t low = 0x80;
+    uint8_t high = 0xbf;
+    if (c >= 0xc2 && c <= 0xdf) {
+        continuations = 1;
+    } else if (c == 0xe0) {
+        continuations = 2;
+        low = 0xa0;
+    } else if (c == 0xed) {
+        continuations = 2;
+        high = 0x9f;
+    } else if (c >= 0xe1 && c <= 0xef) {
+        continuations = 2;
+    } else if (c == 0xf0) {
+        continuations = 3;
+        low = 0x90;
+    } else if (c >= 0xf1 && c <= 0xf3) {
+        continuations = 3;
+    } else if (c == 0xf4) {
+        continuations = 3;
+        high = 0x8f;
+    } else {
+        return nullptr;
+    }
+
+    if (size_t(end - ptr) <= continuations || ptr[1] < low || ptr[1] > high) {
+        return nullptr;
+    }
+    for (size_t ii = 2; ii <= continuations; ++ii) {
+        if ((ptr[ii] & 0xc0) != 0x80) {
+            return nullptr;
+        }
+    }
+    return ptr + continuations + 1;
+}
+
+/// Parse the string starting at ptr (which points at its opening quote).
+static const uint8_t* parse_string(const uint8_t* ptr, const uint8_t* end) {
+    ++ptr;
+    for (;;) {
+        while (end - ptr >= 8 && !is_special(load_word(ptr))) {
+            ptr += 8;
+        }
+        if (ptr == end) {
+            return nullptr;
+        }
+
+        const uint8_t c = *ptr;
+        if (c == '"') {
+            return ptr + 1;
+        }
+
+        if (c == '\\') {
+            if (++ptr == end) {
+                return nullptr;
+            }
+            switch (*ptr) {
+            case '"':
+            case '\\':
+            case '/':
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+                ++ptr;
+                break;
+            case 'u':
+                if (end - ptr < 5 || !is_hex_digit(ptr[1]) ||
+                    !is_hex_digit(ptr[2]) || !is_hex_digit(ptr[3]) ||
+                    !is_hex_digit(ptr[4])) {
+                    return nullptr;
+                }
+                ptr += 5;
+                break;
+            default:
+                return nullptr;
+            }
+        } else if (c < 0x20) {
+            return nullptr;
+        } else if (c < 0x80) {
+            ++ptr;
+        } else {
+            ptr = parse_utf8_sequence(ptr, end);
+            if (ptr == nullptr) {
+                return nullptr;
+            }
+        }
+    }
+}
+
+static const uint8_t* parse_digits(const uint8_t* ptr, const uint8_t* end) {
+    if (ptr == end || !is_digit(*ptr)) {
+        return nullptr;
+    }
+    do {
+        ++ptr;
+    } while (ptr < end && is_digit(*ptr));
+    return ptr;
+}
+
+static const uint8_t* parse_number(const uint8_t* ptr, const uint8_t* end) {
+    if (*ptr == '-') {
+        ++ptr;
+    }
+
+    // Integer part; with no leading zeros.
+    if (ptr < end && *ptr == '0') {
+        ++ptr;
+    } else {
+        ptr = parse_digits(ptr, end);
+        if (ptr == nullptr) {
+            return nullptr;
+        }
+    }
+
+    if (ptr < end && *ptr == '.') {
+        ptr = parse_digits(ptr + 1, end);
+        if (ptr == nullptr) {
+            return nullptr;
+        }
+    }
+
+    if (ptr < end && (*ptr == 'e' || *ptr == 'E')) {
+        ++ptr;
+        if (ptr < end && (*ptr == '+' || *ptr == '-')) {
+            ++ptr;
+        }
+        ptr = parse_digits(ptr, end);
+    }
+    return ptr;
+}
+
+static const uint8_t* parse_literal(const uint8_t* ptr,
+                                    const uint8_t* end,
+                                    const char* literal,
+                                    size_t length) {
+    if (size_t(end - ptr) < length || std::memcmp(ptr, literal, length) != 0) {
+        return nullptr;
+    }
+    return ptr + length;
+}
+
+/// Parse an object's key and the colon following it.
+static const uint8_t* parse_key(const uint8_t* ptr, const uint8_t* end) {
+    if (ptr == end || *ptr != '"') {
+        return nullptr;
+    }
+    ptr = parse_string(ptr, end);
+    if (ptr == nullptr) {
+        return nullptr;
+    }
+    ptr = skip_whitespace(ptr, end);
+    if (ptr == end || *ptr != ':') {
+        return nullptr;
+    }
+    return skip_whitespace(ptr + 1, end);
+}
+
+bool JsonValidator::validate(const uint8_t* data, size_t size) {
+    const uint8_t* ptr = data;
+    const uint8_t* const end = data + size;
+    stack.clear();
+
+    ptr = skip_whitespace(ptr, end);
+    for (;;) {
+        // Expecting a value.
+        if (ptr == end) {
+            return false;
+        }
+        switch (*ptr) {
+        case '{':
+            ptr = skip_whitespace(ptr + 1, end);
+            if (ptr < end && *ptr == '}') {
+                ++ptr;
+                break;
+            }
+            stack.push_back('{');
+            ptr = parse_key(ptr, end);
+            if (ptr == nullptr) {
+                return false;
+            }
+            continue;
+        case '[':
+            ptr = skip_whitespace(ptr + 1, end);
+            if (ptr < end && *ptr == ']') {
+                ++ptr;
+                break;
+            }
+            stack.push_back('[');
+            continue;
+        case '"':
+            ptr = parse_string(ptr, end);
+            break;
+        case 't':
+            ptr = parse_literal(ptr, end, "true", 4);
+            break;
+        case 'f':
+            ptr = parse_literal(ptr, end, "false", 5);
+            break;
+        case 'n':
+            ptr = parse_literal(ptr, end, "null", 4);
+            break;
+        default:
+            ptr = parse_number(ptr, end);
+            break;
+        }
+        if (ptr == nullptr) {
+            return false;
+        }
+
+        // A value is complete; close the containers it completes (if any)
+        // until we find where the next value goes.
+        for (;;) {
+            ptr = skip_whitespace(ptr, end);
+            if (stack.empty()) {
+                return ptr == end;
+            }
+            if (ptr == end) {
+                return false;
+            }
+            if (*ptr == ',') {
+                ptr = skip_whitespace(ptr + 1, end);
+                if (stack.back() == '{') {
+                    ptr = parse_key(ptr, end);
+                    if (ptr == nullptr) {
+                        return false;
+                    }
+                }
+                break;
+            }
+            if (*ptr != (stack.back() == '{' ? '}' : ']')) {
+                return false;
+            }
+            stack.pop_back();
+            ++ptr;
+        }
+    }
+}
@@ -0,0 +1,54 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <platform/sized_buffer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * A validator used to determine if a value is JSON (when setting the
+ * datatype of a document) which, unlike a byte-at-a-time state machine,
+ * skips over the plain content of strings (which typically makes up most
+ * of a document) a word (8 bytes) at a time.
+ *
+ * A value is valid if it holds a single JSON value of any type (such as an
+ * object, or just a number) in UTF-8, optionally surrounded by whitespace.
+ *
+ * Not thread safe; it keeps its stack of open containers between calls to
+ * avoid allocating it for every document.
+ */
+class JsonValidator {
+public:
+    /// @return true if the given value is valid JSON
+    bool validate(const uint8_t* data, size_t size);
+
+    bool validate(cb::const_byte_buffer value) {
+        return validate(value.data(), value.size());
+    }
+
+    bool validate(const char* data, size_t size) {
+        return validate(reinterpret_cast<const uint8_t*>(data), size);
+    }
+
+private:
+    /// The containers ('{' or '[') enclosing the current position.
+    std::vector<uint8_t> stack;
+};
@@ -0,0 +1,160 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "keyed_timings.h"
+
+#include <nlohmann/json.hpp>
+
+boost::optional<KeyedTimings::Operation> KeyedTimings::getOperation(
+        cb::mcbp::ClientOpcode opcode) {
+    using cb::mcbp::ClientOpcode;
+    switch (opcode) {
+    case ClientOpcode::Get:
+    case ClientOpcode::Getq:
+    case ClientOpcode::Getk:
+    case ClientOpcode::Getkq:
+        return Operation::Get;
+    case ClientOpcode::Set:
+    case ClientOpcode::Setq:
+        return Operation::Set;
+    case ClientOpcode::Delete:
+    case ClientOpcode::Deleteq:
+        return Operation::Delete;
+    default:
+        return {};
+    }
+}
+
+boost::optional<KeyedTimings::Operation> KeyedTimings::getOperation(
+        const std::string& name) {
+    for (size_t ii = 0; ii < NumOperations; ++ii) {
+        if (name == ::to_string(Operation(ii))) {
+            return Operation(ii);
+        }
+    }
+    return {};
+}
+
+void KeyedTimings::collect(Operation operation,
+                           Vbid vbucket,
+                           CollectionID collection,
+                           std::chrono::nanoseconds duration) {
+    using namespace std::chrono;
+    const auto us = duration_cast<microseconds>(duration);
+    const auto op = size_t(operation);
+
+    if (vbucket.get() < MaxVBuckets) {
+        getVBucketHistograms(vbucket)[op].add(us);
+    }
+
+    {
+        auto map = collections.rlock();
+        auto it = map->find(uint32_t(collection));
+        if (it != map->end()) {
+            (*it->second)[op].add(us);
+            return;
+        }
+    }
+
+    auto map = collections.wlock();
+    auto& histograms = (*map)[uint32_t(collection)];
+    if (!histograms) {
+        histograms = std::make_unique<Histograms>();
+    }
+    (*histograms)[op].add(us);
+}
+
+KeyedTimings::Histograms& KeyedTimings::getVBucketHistograms(Vbid vbucket) {
+    auto& histograms = vbuckets[vbucket.get()];
+    if (histograms == nullptr) {
+        std::lock_guard<std::mutex> allocLock(allocMutex);
+        if (histograms == nullptr) {
+            histograms = std::make_unique<Histograms>();
+        }
+    }
+    return *histograms;
+}
+
+std::string KeyedTimings::generate(Operation operation, Vbid vbucket) const {
+    if (vbucket.get() < MaxVBuckets && vbuckets[vbucket.get()]) {
+        return (*vbuckets[vbucket.get()])[size_t(operation)].to_string();
+    }
+    return std::string("{}");
+}
+
+std::string KeyedTimings::generate(Operation operation,
+                                   CollectionID collection) const {
+    auto map = collections.rlock();
+    auto it = map->find(uint32_t(collection));
+    if (it != map->end()) {
+        return (*it->second)[size_t(operation)].to_string();
+    }
+    return std::string("{}");
+}
+
+static void add_histograms(nlohmann::json& json,
+                           const std::string& prefix,
+                           const KeyedTimings::Histograms& histograms) {
+    for (size_t ii = 0; ii < KeyedTimings::NumOperations; ++ii) {
+        if (histograms[ii].getValueCount() != 0) {
+            json[prefix + ::to_string(KeyedTimings::Operation(ii))] =
+                    histograms[ii].to_json();
+        }
+    }
+}
+
+nlohmann::json KeyedTimings::to_json() const {
+    nlohmann::json ret = nlohmann::json::object();
+    for (size_t ii = 0; ii < MaxVBuckets; ++ii) {
+        if (vbuckets[ii]) {
+            add_histograms(
+                    ret, "vb_" + std::to_string(ii) + ":", *vbuckets[ii]);
+        }
+    }
+
+    auto map = collections.rlock();
+    for (const auto& entry : *map) {
+        const CollectionID collection(entry.first,
+                                      CollectionID::SkipIDVerificationTag{});
+        add_histograms(ret,
+                       "collection_" + collection.to_string() + ":",
+                       *entry.second);
+    }
+    return ret;
+}
+
+void KeyedTimings::reset() {
+    for (auto& histograms : vbuckets) {
+        if (histograms) {
+            for (auto& histogram : *histograms) {
+                histogram.reset();
+            }
+        }
+    }
+    collections.wlock()->clear();
+}
+
+const char* to_string(KeyedTimings::Operation operation) {
+    switch (operation) {
+    case KeyedTimings::Operation::Get:
+        return "get";
+    case KeyedTimings::Operation::Set:
+        return "set";
+    case KeyedTimings::Operation::Delete:
+        return "delete";
+    }
+    return "unknown";
+}
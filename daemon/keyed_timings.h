@@ -0,0 +1,100 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <boost/optional/optional.hpp>
+#include <folly/Synchronized.h>
+#include <mcbp/protocol/opcode.h>
+#include <memcached/dockey.h>
+#include <memcached/vbucket.h>
+#include <nlohmann/json_fwd.hpp>
+#include <utilities/log_linear_histogram.h>
+
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * Optional latency histograms of the GET, SET and DELETE commands, per
+ * vbucket and per collection - to find out if the latency of a bucket is
+ * concentrated on a particular vbucket (for instance one being compacted
+ * or moved) or collection.
+ *
+ * The histograms of a vbucket or collection are only allocated when a
+ * command is first recorded for it, and only vbuckets below MaxVBuckets
+ * are tracked.
+ */
+class KeyedTimings {
+public:
+    enum class Operation { Get, Set, Delete };
+
+    static const size_t NumOperations = 3;
+
+    /// The (default) maximum number of vbuckets of a bucket
+    static const size_t MaxVBuckets = 1024;
+
+    using Histograms = std::array<LogLinearMicroSecHistogram, NumOperations>;
+
+    /// @return the operation the opcode is timed as (if it's one of them)
+    static boost::optional<Operation> getOperation(
+            cb::mcbp::ClientOpcode opcode);
+
+    /// @return the operation with the given name ("get", "set", "delete")
+    static boost::optional<Operation> getOperation(const std::string& name);
+
+    void collect(Operation operation,
+                 Vbid vbucket,
+                 CollectionID collection,
+                 std::chrono::nanoseconds duration);
+
+    /**
+     * Get the histogram of the operation on the vbucket (in the same format
+     * as Timings::generate), or "{}" if none has been recorded.
+     */
+    std::string generate(Operation operation, Vbid vbucket) const;
+
+    /// Get the histogram of the operation on the collection (or "{}")
+    std::string generate(Operation operation, CollectionID collection) const;
+
+    /**
+     * Get all of the histograms recorded, keyed by "vb_<vbid>:<operation>"
+     * and "collection_<cid>:<operation>".
+     */
+    nlohmann::json to_json() const;
+
+    /// Reset the vbucket histograms, and forget all of the collections
+    void reset();
+
+private:
+    Histograms& getVBucketHistograms(Vbid vbucket);
+
+    // Created (under allocMutex) when a vbucket is first recorded
+    std::array<std::unique_ptr<Histograms>, MaxVBuckets> vbuckets;
+    std::mutex allocMutex;
+
+    // Unlike vbuckets, collections are created and dropped over time so the
+    // histograms of a collection are dropped by reset(). The histograms are
+    // only updated while holding the (shared) read lock.
+    using CollectionMap =
+            std::unordered_map<uint32_t, std::unique_ptr<Histograms>>;
+    folly::Synchronized<CollectionMap> collections;
+};
+
+const char* to_string(KeyedTimings::Operation operation);
@@ -256,6 +256,9 @@ void mc_time_clock_tick(void) {
 
     // check on tasks to be made runnable in the future
     executorPool->clockTick();
+    if (saslAuthExecutorPool) {
+        saslAuthExecutorPool->clockTick();
+    }
 }
 
 static void mc_gather_timing_samples(void) {
@@ -19,6 +19,7 @@
 #include "buckets.h"
 #include "cookie.h"
 #include "cookie_trace_context.h"
+#include "front_end_thread.h"
 #include "memcached.h"
 #include "opentracing.h"
 #include "settings.h"
@@ -52,7 +53,7 @@ static cb::const_byte_buffer mcbp_add_header(Cookie& cookie,
     header->response.setOpaque(opaque);
     header->response.setCas(cas);
 
-    if (cookie.isTracingEnabled()) {
+    if (cookie.isTracingResponseEnabled()) {
         // When tracing is enabled we'll be using the alternative
         // response header where we inject the framing header.
         // For now we'll just hard-code the adding of the bytes
@@ -128,7 +129,7 @@ void mcbp_add_header(Cookie& cookie,
         }
     }
 
-    ++connection.getBucket().responseCounters[uint16_t(status)];
+    connection.countResponse(status);
     connection.addIov(wbuf.data(), wbuf.size());
 }
 
@@ -223,7 +224,7 @@ static bool mcbp_response_handler(const void* key,
     builder.setCas(cas);
     builder.validate();
 
-    ++c->getBucket().responseCounters[uint16_t(status)];
+    c->countResponse(status);
     dbuf.moveOffset(needed);
     return true;
 }
@@ -236,6 +237,38 @@ static bool mcbp_response_handler(const void* key,
 //
 AddResponseFn mcbpResponseHandlerFn = mcbp_response_handler;
 
+/**
+ * Record the duration of a GET, SET or DELETE in the histograms of its
+ * vbucket and collection.
+ */
+static void collect_keyed_timings(Cookie& cookie,
+                                  int bucketid,
+                                  cb::mcbp::ClientOpcode opcode,
+                                  std::chrono::nanoseconds elapsed) {
+    const auto operation = KeyedTimings::getOperation(opcode);
+    if (!operation) {
+        return;
+    }
+
+    CollectionID collection;
+    try {
+        const auto& request = cookie.getRequest(Cookie::PacketContent::Full);
+        collection = cookie.getConnection()
+                             .makeDocKey(request.getKey())
+                             .getCollectionID();
+    } catch (const std::exception&) {
+        // The key (and its collection) isn't available as the command was
+        // rejected based on its header alone.
+        return;
+    }
+
+    all_buckets[bucketid].timings.get_keyed_timings().collect(
+            *operation,
+            cookie.getHeader().getRequest().getVBucket(),
+            collection,
+            elapsed);
+}
+
 void mcbp_collect_timings(Cookie& cookie) {
     // The state machinery cause this method to be called for all kinds
     // of packets, but the header musts be a client request for the timings
@@ -270,6 +303,24 @@ void mcbp_collect_timings(Cookie& cookie) {
      */
     if (bucketid != 0) {
         all_buckets[bucketid].timings.collect(opcode, elapsed);
+        if (settings.isKeyedTimingsEnabled()) {
+            collect_keyed_timings(cookie, bucketid, opcode, elapsed);
+        }
+    }
+
+    // The breakdown of where the time went (as traced by the engine) is
+    // only available for the commands of connections with tracing enabled
+    // (and the sampled ones).
+    if (cookie.isTracingEnabled()) {
+        const auto& tracer = cookie.getTracer();
+        all_buckets[0].timings.collect(opcode, tracer);
+        if (bucketid != 0) {
+            all_buckets[bucketid].timings.collect(opcode, tracer);
+        }
+    }
+
+    if (cookie.isSampled()) {
+        c->getThread()->request_sampler.record(cookie);
     }
 
     // Log operations taking longer than the "slow" threshold for the opcode.
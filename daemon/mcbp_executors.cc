@@ -20,6 +20,7 @@
 #include "buckets.h"
 #include "config_parse.h"
 #include "external_auth_manager_thread.h"
+#include "front_end_thread.h"
 #include "ioctl.h"
 #include "mc_time.h"
 #include "mcaudit.h"
@@ -102,8 +103,11 @@ static void gat_executor(Cookie& cookie) {
  * of the context information about the command/response.
  *
  * When called the entire packet is available.
+ *
+ * A plain function pointer (rather than std::function) as every handler is
+ * a free function, and this is called for every packet.
  */
-using HandlerFunction = std::function<void(Cookie&)>;
+using HandlerFunction = void (*)(Cookie&);
 
 /**
  * A map between the request packets op-code and the function to handle
@@ -132,8 +136,7 @@ static void process_bin_unknown_packet(Cookie& cookie) {
         if (cookie.getDynamicBuffer().getRoot() != nullptr) {
             // We assume that if the underlying engine returns a success then
             // it is sending a success to the client.
-            ++connection.getBucket()
-                      .responseCounters[int(cb::mcbp::Status::Success)];
+            connection.countResponse(cb::mcbp::Status::Success);
             cookie.sendDynamicBuffer();
         } else {
             connection.setState(StateMachine::State::new_cmd);
@@ -595,13 +598,13 @@ static void process_bin_dcp_response(Cookie& cookie) {
 static void setup_response_handler(cb::mcbp::ClientOpcode opcode,
                                    HandlerFunction function) {
     response_handlers[std::underlying_type<cb::mcbp::ClientOpcode>::type(
-            opcode)] = std::move(function);
+            opcode)] = function;
 }
 
 static void setup_handler(cb::mcbp::ClientOpcode opcode,
                           HandlerFunction function) {
     handlers[std::underlying_type<cb::mcbp::ClientOpcode>::type(opcode)] =
-            std::move(function);
+            function;
 }
 
 void initialize_mbcp_lookup_map() {
@@ -937,9 +940,12 @@ void try_read_mcbp_command(Cookie& cookie) {
                 std::to_string(c.read->rsize()) + " of " +
                 std::to_string(sizeof(cb::mcbp::Request)) + ")");
     }
+    const bool sampled = c.getThread()->request_sampler.shouldSample(
+            settings.getRequestSampleInterval());
     cookie.initialize(
             cb::const_byte_buffer{input.data(), sizeof(cb::mcbp::Request)},
-            c.isTracingEnabled());
+            c.isTracingEnabled(),
+            sampled);
 
     const auto& header = cookie.getHeader();
     if (!header.isValid()) {
@@ -989,7 +995,7 @@ void try_read_mcbp_command(Cookie& cookie) {
         // we need to allocate more memory!!
         try {
             size_t needed = sizeof(cb::mcbp::Request) + header.getBodylen();
-            c.read->ensureCapacity(needed - c.read->rsize());
+            c.ensureReadCapacity(needed - c.read->rsize());
             // ensureCapacity may have reallocated the buffer.. make sure
             // that the packet in the cookie points to the correct address
             cookie.setPacket(Cookie::PacketContent::Header,
@@ -32,6 +32,11 @@ void McbpPrivilegeChains::setup(cb::mcbp::ClientOpcode command,
 
 PrivilegeAccess McbpPrivilegeChains::invoke(cb::mcbp::ClientOpcode command,
                                             Cookie& cookie) {
+    auto& connection = cookie.getConnection();
+    if (connection.isCommandGranted(command)) {
+        return cb::rbac::PrivilegeAccess::Ok;
+    }
+
     auto& chain =
             commandChains[std::underlying_type<cb::mcbp::ClientOpcode>::type(
                     command)];
@@ -39,12 +44,19 @@ PrivilegeAccess McbpPrivilegeChains::invoke(cb::mcbp::ClientOpcode command,
         return cb::rbac::PrivilegeAccess::Fail;
     } else {
         try {
-            return chain.invoke(cookie);
+            // All of the chain functions only depend on the connection's
+            // privilege context, so a successful check stays valid until
+            // the context changes.
+            const auto ret = chain.invoke(cookie);
+            if (ret == cb::rbac::PrivilegeAccess::Ok) {
+                connection.setCommandGranted(command);
+            }
+            return ret;
         } catch (const std::bad_function_call&) {
             LOG_WARNING(
                     "{}: bad_function_call caught while evaluating access "
                     "control for opcode: {:x}",
-                    cookie.getConnection().getId(),
+                    connection.getId(),
                     std::underlying_type<cb::mcbp::ClientOpcode>::type(
                             command));
             // Let the connection catch the exception and shut down the
@@ -284,6 +296,18 @@ McbpPrivilegeChains::McbpPrivilegeChains() {
      * Command to get all keys
      */
     setup(cb::mcbp::ClientOpcode::GetKeys, require<Privilege::Read>);
+    /**
+     * Command to read the documents of a key range
+     */
+    setup(cb::mcbp::ClientOpcode::RangeScan, require<Privilege::Read>);
+    /**
+     * Command to store a batch of documents
+     */
+    setup(cb::mcbp::ClientOpcode::BulkStore, require<Privilege::Upsert>);
+    /**
+     * Command to sample the keys of the bucket
+     */
+    setup(cb::mcbp::ClientOpcode::GetRandomKeys, require<Privilege::Read>);
     /**
      * Commands for GO-XDCR
      */
@@ -52,6 +52,10 @@ public:
 protected:
     /*
      * Silently ignores any attempt to push the same function onto the chain.
+     *
+     * The function must only depend on the connection's privilege context:
+     * once a command's chain returns Ok the connection skips it until the
+     * context changes (see Connection::isCommandGranted()).
      */
     void setup(cb::mcbp::ClientOpcode command,
                cb::rbac::PrivilegeAccess (*f)(Cookie&));
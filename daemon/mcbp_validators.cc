@@ -33,9 +33,7 @@
 
 using cb::mcbp::Status;
 
-bool is_document_key_valid(Cookie& cookie) {
-    const auto& req = cookie.getRequest(Cookie::PacketContent::Header);
-    const auto& key = req.getKey();
+static bool is_document_key_valid(Cookie& cookie, cb::const_byte_buffer key) {
     if (!cookie.getConnection().isCollectionsSupported()) {
         return true;
     }
@@ -80,6 +78,11 @@ bool is_document_key_valid(Cookie& cookie) {
     return rv;
 }
 
+bool is_document_key_valid(Cookie& cookie) {
+    const auto& req = cookie.getRequest(Cookie::PacketContent::Header);
+    return is_document_key_valid(cookie, req.getKey());
+}
+
 static inline bool may_accept_dcp_deleteV2(const Cookie& cookie) {
     return cookie.getConnection().isDcpDeleteV2();
 }
@@ -234,6 +237,9 @@ static bool supportsDurability(cb::mcbp::ClientOpcode opcode) {
     case ClientOpcode::CollectionsGetManifest:
     case ClientOpcode::CollectionsGetID:
     case ClientOpcode::CollectionsGetScopeID:
+    case ClientOpcode::RangeScan:
+    case ClientOpcode::BulkStore:
+    case ClientOpcode::GetRandomKeys:
     case ClientOpcode::SetDriftCounterState:
     case ClientOpcode::GetAdjustedTime:
     case ClientOpcode::SubdocGet:
@@ -387,6 +393,11 @@ Status McbpValidator::verify_header(Cookie& cookie,
         return Status::Einval;
     }
 
+    if (request.getFramingExtraslen() == 0) {
+        // The common case; skip creating the frame info callback
+        return Status::Success;
+    }
+
     // Validate the frame id's
     auto status = Status::Success;
     auto opcode = request.getClientOpcode();
@@ -397,14 +408,20 @@ Status McbpValidator::verify_header(Cookie& cookie,
                                          cb::const_byte_buffer data) -> bool {
             switch (id) {
             case cb::mcbp::request::FrameInfoId::Reorder:
-                if (data.empty()) {
-                    status = Status::NotSupported;
-                    cookie.setErrorContext("OoO is currently not supported");
-                } else {
+                if (!data.empty()) {
                     status = Status::Einval;
                     cookie.setErrorContext("Reorder should not contain value");
+                    return false;
+                }
+                if (!cookie.getConnection().allowUnorderedExecution()) {
+                    status = Status::NotSupported;
+                    cookie.setErrorContext(
+                            "Reorder requires unordered execution to be "
+                            "enabled");
+                    return false;
                 }
-                return false;
+                cookie.getFrameInfos().reorderable = true;
+                return true;
             case cb::mcbp::request::FrameInfoId::DurabilityRequirement:
                 try {
                     cb::durability::Requirements req(data);
@@ -415,6 +432,7 @@ Status McbpValidator::verify_header(Cookie& cookie,
                         // terminate parsing
                         return false;
                     }
+                    cookie.getFrameInfos().durability = req;
                     return true;
                 } catch (const std::exception& exception) {
                     // According to the spec the size may be 1 byte
@@ -439,19 +457,24 @@ Status McbpValidator::verify_header(Cookie& cookie,
                     status = Status::Einval;
                     cookie.setErrorContext("DcpStreamId invalid size:" +
                                            std::to_string(data.size()));
+                    return false;
                 }
+                // The u16 stream-ID in network byte-order
+                cookie.getFrameInfos().dcpStreamId = cb::mcbp::DcpStreamId(
+                        ntohs(*reinterpret_cast<const uint16_t*>(data.data())));
+                return true;
             case cb::mcbp::request::FrameInfoId::OpenTracingContext:
                 if (data.empty()) {
                     status = Status::Einval;
                     cookie.setErrorContext("OpenTracingContext cannot be empty");
-                } else {
-                    // Ideally we should only validate the packet here,
-                    // but given that we've parsed the packet and found all
-                    // the data I need I can might as well store it to avoid
-                    // having to parse it again just to pick out the value
-                    cookie.setOpenTracingContext(data);
+                    return false;
                 }
-                return false;
+                // Ideally we should only validate the packet here,
+                // but given that we've parsed the packet and found all
+                // the data I need I can might as well store it to avoid
+                // having to parse it again just to pick out the value
+                cookie.setOpenTracingContext(data);
+                return true;
             } // switch (id)
             status = Status::UnknownFrameInfo;
             return false;
@@ -461,6 +484,13 @@ Status McbpValidator::verify_header(Cookie& cookie,
         cookie.setErrorContext("Invalid encoding in FrameExtras");
     }
 
+    auto& frameInfos = cookie.getFrameInfos();
+    if (frameInfos.reorderable) {
+        // The Reorder frame info is ignored for the commands which we don't
+        // reorder
+        frameInfos.reorderable = request.isReorderable();
+    }
+
     return status;
 }
 
@@ -1922,6 +1952,31 @@ static Status get_random_key_validator(Cookie& cookie) {
  *    the case that it is valid JSON as otherwise we'd have to parse
  *    it just to throw it away)
  */
+static Status get_random_keys_validator(Cookie& cookie) {
+    using cb::mcbp::request::GetRandomKeysPayload;
+    auto status = McbpValidator::verify_header(cookie,
+                                               sizeof(GetRandomKeysPayload),
+                                               ExpectedKeyLen::Zero,
+                                               ExpectedValueLen::Zero,
+                                               ExpectedCas::NotSet,
+                                               PROTOCOL_BINARY_RAW_BYTES);
+    if (status != Status::Success) {
+        return status;
+    }
+
+    auto extras = cookie.getHeader().getExtdata();
+    const auto* payload =
+            reinterpret_cast<const GetRandomKeysPayload*>(extras.data());
+    if (payload->getCount() == 0 ||
+        payload->getCount() > GetRandomKeysPayload::MaxCount) {
+        cookie.setErrorContext("count must be between 1 and " +
+                               std::to_string(GetRandomKeysPayload::MaxCount));
+        return Status::Einval;
+    }
+
+    return Status::Success;
+}
+
 static Status set_vbucket_validator(Cookie& cookie) {
     auto& header = cookie.getHeader();
     auto status = McbpValidator::verify_header(
@@ -2040,6 +2095,85 @@ static Status get_keys_validator(Cookie& cookie) {
     return Status::Success;
 }
 
+static Status range_scan_validator(Cookie& cookie) {
+    using cb::mcbp::request::RangeScanPayload;
+    auto status = McbpValidator::verify_header(cookie,
+                                               sizeof(RangeScanPayload),
+                                               ExpectedKeyLen::NonZero,
+                                               ExpectedValueLen::Any,
+                                               ExpectedCas::NotSet,
+                                               PROTOCOL_BINARY_RAW_BYTES);
+    if (status != Status::Success) {
+        return status;
+    }
+
+    if (!is_document_key_valid(cookie)) {
+        return Status::Einval;
+    }
+
+    // The value is the (logical) end key
+    if (cookie.getHeader().getValue().size() > KEY_MAX_LENGTH) {
+        cookie.setErrorContext("End key exceeds " +
+                               std::to_string(KEY_MAX_LENGTH));
+        return Status::Einval;
+    }
+
+    auto extras = cookie.getHeader().getExtdata();
+    const auto* payload =
+            reinterpret_cast<const RangeScanPayload*>(extras.data());
+    if (payload->getMaxItems() == 0) {
+        cookie.setErrorContext("max_items must be non-zero");
+        return Status::Einval;
+    }
+    if ((payload->getFlags() & ~uint8_t(cb::mcbp::request::RangeScanFlag::
+                                                KeysOnly)) != 0) {
+        cookie.setErrorContext("Unknown flags");
+        return Status::Einval;
+    }
+
+    return Status::Success;
+}
+
+static Status bulk_store_validator(Cookie& cookie) {
+    auto status = McbpValidator::verify_header(cookie,
+                                               0,
+                                               ExpectedKeyLen::Zero,
+                                               ExpectedValueLen::NonZero,
+                                               ExpectedCas::NotSet,
+                                               PROTOCOL_BINARY_RAW_BYTES);
+    if (status != Status::Success) {
+        return status;
+    }
+
+    cb::mcbp::request::BulkStoreParser parser(cookie.getHeader().getValue());
+    if (!parser.isValid()) {
+        cookie.setErrorContext("Truncated document");
+        return Status::Einval;
+    }
+
+    auto& connection = cookie.getConnection();
+    cb::mcbp::request::BulkStoreDocument doc;
+    while (parser.next(doc)) {
+        if (doc.key.empty() || doc.key.size() > KEY_MAX_LENGTH) {
+            cookie.setErrorContext("Invalid key length " +
+                                   std::to_string(doc.key.size()));
+            return Status::Einval;
+        }
+        if (!is_document_key_valid(cookie, doc.key)) {
+            return Status::Einval;
+        }
+        // Values are stored as they are, so only JSON may be flagged (an
+        // xattr blob or snappy value would need the checks of a SET)
+        if ((doc.datatype & ~PROTOCOL_BINARY_DATATYPE_JSON) != 0 ||
+            !connection.isDatatypeEnabled(doc.datatype)) {
+            cookie.setErrorContext("Invalid document datatype");
+            return Status::Einval;
+        }
+    }
+
+    return Status::Success;
+}
+
 static Status set_param_validator(Cookie& cookie) {
     using cb::mcbp::request::SetParamPayload;
     auto status = McbpValidator::verify_header(cookie,
@@ -2354,6 +2488,7 @@ McbpValidator::McbpValidator() {
     setup(cb::mcbp::ClientOpcode::AdjustTimeofday, adjust_timeofday_validator);
     setup(cb::mcbp::ClientOpcode::EwouldblockCtl, ewb_validator);
     setup(cb::mcbp::ClientOpcode::GetRandomKey, get_random_key_validator);
+    setup(cb::mcbp::ClientOpcode::GetRandomKeys, get_random_keys_validator);
     setup(cb::mcbp::ClientOpcode::SetVbucket, set_vbucket_validator);
     setup(cb::mcbp::ClientOpcode::DelVbucket, del_vbucket_validator);
     setup(cb::mcbp::ClientOpcode::GetVbucket, get_vbucket_validator);
@@ -2366,6 +2501,8 @@ McbpValidator::McbpValidator() {
     setup(cb::mcbp::ClientOpcode::DisableTraffic,
           enable_disable_traffic_validator);
     setup(cb::mcbp::ClientOpcode::GetKeys, get_keys_validator);
+    setup(cb::mcbp::ClientOpcode::RangeScan, range_scan_validator);
+    setup(cb::mcbp::ClientOpcode::BulkStore, bulk_store_validator);
     setup(cb::mcbp::ClientOpcode::SetParam, set_param_validator);
     setup(cb::mcbp::ClientOpcode::GetReplica, get_validator);
     setup(cb::mcbp::ClientOpcode::ReturnMeta, return_meta_validator);
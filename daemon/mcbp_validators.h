@@ -24,7 +24,6 @@
 #include <mcbp/protocol/opcode.h>
 #include <mcbp/protocol/status.h>
 #include <array>
-#include <functional>
 
 class Cookie;
 
@@ -65,7 +64,8 @@ protected:
      */
     void setup(ClientOpcode command, Status (*f)(Cookie&));
 
-    std::array<std::function<Status(Cookie&)>, 0x100> validators;
+    /// Indexed by opcode; nullptr for the commands without a validator
+    std::array<Status (*)(Cookie&), 0x100> validators{};
 };
 
 /**
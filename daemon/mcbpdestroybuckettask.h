@@ -44,6 +44,10 @@ public:
         return Status::Finished;
     }
 
+    Class getClass() const override {
+        return Class::BucketManagement;
+    }
+
     void notifyExecutionComplete() override {
         const auto* cookie = thread.getCookie();
         if (cookie != nullptr) {
@@ -134,6 +134,7 @@ std::atomic<bool> memcached_shutdown;
 std::atomic<bool> service_online;
 
 std::unique_ptr<ExecutorPool> executorPool;
+std::unique_ptr<ExecutorPool> saslAuthExecutorPool;
 
 /* Mutex for global stats */
 std::mutex stats_mutex;
@@ -370,7 +371,7 @@ static void stats_init() {
 struct thread_stats* get_thread_stats(Connection* c) {
     cb_assert(c->getThread()->index < (settings.getNumWorkerThreads() + 1));
     auto& independent_stats = all_buckets[c->getBucketIndex()].stats;
-    return &independent_stats.at(c->getThread()->index);
+    return independent_stats.at(c->getThread()->index).get();
 }
 
 void stats_reset(Cookie& cookie) {
@@ -485,6 +486,36 @@ static void opcode_attributes_override_changed_listener(const std::string&,
              cb::mcbp::sla::to_json().dump());
 }
 
+/**
+ * Apply the "bucket_throttle" setting to the bucket. A malformed setting
+ * is rejected when it's set, so its parse errors are only logged here.
+ */
+static void configure_bucket_throttle(Bucket& bucket) {
+    try {
+        const auto config = settings.getBucketThrottle();
+        nlohmann::json json;
+        if (!config.empty()) {
+            json = nlohmann::json::parse(config);
+        }
+        bucket.throttle.setLimits(BucketThrottle::lookup(json, bucket.name));
+    } catch (const std::exception& e) {
+        LOG_WARNING("Failed to configure the throttle of bucket [{}]: {}",
+                    bucket.name,
+                    e.what());
+    }
+}
+
+static void bucket_throttle_changed_listener(const std::string&, Settings&) {
+    bucketsForEach(
+            [](Bucket& bucket, void*) {
+                if (bucket.name[0] != '\0') {
+                    configure_bucket_throttle(bucket);
+                }
+                return true;
+            },
+            nullptr);
+}
+
 static void interfaces_changed_listener(const std::string&, Settings &s) {
     check_listen_conn = true;
     notify_dispatcher();
@@ -651,6 +682,8 @@ static void update_settings_from_config()
 
     settings.addChangeListener("opcode_attributes_override",
                                opcode_attributes_override_changed_listener);
+    settings.addChangeListener("bucket_throttle",
+                               bucket_throttle_changed_listener);
 }
 
 struct {
@@ -670,6 +703,14 @@ uint64_t get_listen_disabled_num() {
     return listen_state.num_disable;
 }
 
+/// Set by request_disable_listen, handled by dispatch_event_handler
+static std::atomic_bool disable_listen_requested{false};
+
+void request_disable_listen() {
+    disable_listen_requested = true;
+    notify_dispatcher();
+}
+
 void disable_listen() {
     {
         std::lock_guard<std::mutex> guard(listen_state.mutex);
@@ -877,6 +918,13 @@ void event_handler(evutil_socket_t fd, short which, void *arg) {
 void listen_event_handler(evutil_socket_t, short, void *arg) {
     auto& c = *reinterpret_cast<ServerSocket*>(arg);
 
+    if (memcached_shutdown && c.isPerThread()) {
+        // A front-end thread's own socket. The thread stops once its
+        // clients have gone, so don't let new ones in meanwhile.
+        c.rejectNewClient();
+        return;
+    }
+
     if (memcached_shutdown) {
         // Someone requested memcached to shut down. The listen thread should
         // be stopped immediately to avoid new connections
@@ -1013,6 +1061,10 @@ static void dispatch_event_handler(evutil_socket_t fd, short, void *) {
             connection->enable();
         }
     }
+
+    if (disable_listen_requested.exchange(false)) {
+        disable_listen();
+    }
 }
 
 /*
@@ -1073,6 +1125,18 @@ static SOCKET new_server_socket(struct addrinfo* ai) {
     const int flags = 1;
     int error;
 
+#ifdef SO_REUSEPORT
+    if (settings.isPerThreadListenersEnabled() &&
+        cb::net::setsockopt(sfd,
+                            SOL_SOCKET,
+                            SO_REUSEPORT,
+                            reinterpret_cast<const void*>(&flags),
+                            sizeof(flags)) != 0) {
+        LOG_WARNING("setsockopt(SO_REUSEPORT): {}",
+                    cb_strerror(cb::net::get_socket_error()));
+    }
+#endif
+
 #ifdef IPV6_V6ONLY
     if (ai->ai_family == AF_INET6) {
         error = cb::net::setsockopt(sfd,
@@ -1118,6 +1182,65 @@ static SOCKET new_server_socket(struct addrinfo* ai) {
     return sfd;
 }
 
+/// Set once the front-end threads exist (see create_per_thread_listeners)
+static bool front_end_threads_started = false;
+
+/**
+ * In per_thread_listeners mode, give each front-end thread its own socket
+ * bound (with SO_REUSEPORT) to the same address as the given dispatcher
+ * socket, so the kernel spreads new clients over the threads and each
+ * thread accepts and serves its share itself. The dispatcher's socket
+ * stays open (it's part of the same SO_REUSEPORT group, so still gets its
+ * share, and handles them as before) as it's the one the interface is
+ * managed by.
+ */
+static void create_per_thread_listeners(ServerSocket& server) {
+    if (!settings.isPerThreadListenersEnabled() || !front_end_threads_started) {
+        return;
+    }
+
+#ifdef SO_REUSEPORT
+    sockaddr_storage addr{};
+    socklen_t addrlen = sizeof(addr);
+    if (getsockname(server.getSocket(),
+                    reinterpret_cast<sockaddr*>(&addr),
+                    &addrlen) != 0) {
+        LOG_WARNING("{}: Failed to look up the address to create per-thread "
+                    "listeners for: {}",
+                    server.getSocket(),
+                    cb_strerror(cb::net::get_socket_error()));
+        return;
+    }
+
+    addrinfo ai = {};
+    ai.ai_family = addr.ss_family;
+    ai.ai_socktype = SOCK_STREAM;
+    ai.ai_protocol = IPPROTO_TCP;
+    ai.ai_addr = reinterpret_cast<sockaddr*>(&addr);
+    ai.ai_addrlen = addrlen;
+
+    for (size_t ii = 0; ii < settings.getNumWorkerThreads(); ++ii) {
+        const auto sfd = new_server_socket(&ai);
+        if (sfd == INVALID_SOCKET) {
+            continue;
+        }
+        if (bind(sfd, ai.ai_addr, ai.ai_addrlen) == SOCKET_ERROR) {
+            LOG_WARNING("Failed to bind per-thread listener to {} - {}",
+                        cb::net::getsockname(server.getSocket()),
+                        cb_strerror(cb::net::get_socket_error()));
+            safe_close(sfd);
+            continue;
+        }
+        server.addPerThreadSocket(sfd, get_front_end_thread(ii));
+        stats.daemon_conns++;
+        stats.curr_conns.fetch_add(1, std::memory_order_relaxed);
+    }
+#else
+    LOG_WARNING("per_thread_listeners requires SO_REUSEPORT, which isn't "
+                "supported on this platform - ignored");
+#endif
+}
+
 static bool server_socket(const std::string& tag,
                           const std::string& host,
                           in_port_t port,
@@ -1250,6 +1373,7 @@ static bool server_socket(const std::string& tag,
                 std::make_unique<ServerSocket>(sfd, main_base, inter));
         stats.daemon_conns++;
         stats.curr_conns.fetch_add(1, std::memory_order_relaxed);
+        create_per_thread_listeners(*listen_conn.back());
     }
 
     freeaddrinfo(ai);
@@ -1742,6 +1866,7 @@ public:
         hooks_api.release_free_memory = AllocHooks::release_free_memory;
         hooks_api.enable_thread_cache = AllocHooks::enable_thread_cache;
         hooks_api.get_allocator_property = AllocHooks::get_allocator_property;
+        hooks_api.get_slab_utilization = AllocHooks::get_slab_utilization;
 
         core = &core_api;
         callback = &callback_api;
@@ -1830,8 +1955,10 @@ void CreateBucketThread::create() {
         all_buckets[ii].type = type;
         strcpy(all_buckets[ii].name, name.c_str());
         try {
-            all_buckets[ii].topkeys =
-                    std::make_unique<TopKeys>(settings.getTopkeysSize());
+            all_buckets[ii].topkeys = std::make_unique<TopKeys>(
+                    settings.getTopkeysSize(),
+                    std::max(settings.getNumWorkerThreads(),
+                             TopKeys::DEFAULT_SHARDS));
         } catch (const std::bad_alloc &) {
             result = ENGINE_ENOMEM;
             LOG_WARNING("{} Create bucket [{}] failed - out of memory",
@@ -1901,6 +2028,7 @@ void CreateBucketThread::create() {
                  name);
         bucket.max_document_size = engine->getMaxItemSize();
         bucket.supportedFeatures = engine->getFeatures();
+        configure_bucket_throttle(bucket);
     } else {
         {
             std::lock_guard<std::mutex> guard(bucket.mutex);
@@ -2114,10 +2242,11 @@ void DestroyBucketThread::destroy() {
         bucket.setEngine(nullptr);
         bucket.name[0] = '\0';
         bucket.topkeys.reset();
-        bucket.responseCounters.fill(0);
+        bucket.resetResponseCounters();
     }
     // don't need lock because all timing data uses atomics
     bucket.timings.reset();
+    bucket.throttle.reset();
 
     LOG_INFO("{} Delete bucket [{}] complete", connection_id, name);
     result = ENGINE_SUCCESS;
@@ -2134,6 +2263,7 @@ static void initialize_buckets() {
     size_t numthread = settings.getNumWorkerThreads() + 1;
     for (auto &b : all_buckets) {
         b.stats.resize(numthread);
+        b.responseCounters.resize(numthread);
     }
 
     // To make the life easier for us in the code, index 0
@@ -2211,6 +2341,10 @@ void delete_all_buckets() {
             return Status::Finished;
         }
 
+        Class getClass() const override {
+            return Class::BucketManagement;
+        }
+
         DestroyBucketThread thread;
     };
 
@@ -2475,8 +2609,19 @@ extern "C" int memcached_main(int argc, char **argv) {
     /* start up worker threads if MT mode */
     thread_init(settings.getNumWorkerThreads(), main_base, dispatch_event_handler);
 
+    // The sockets for per_thread_listeners mode need the threads' event
+    // bases, so are only created now
+    front_end_threads_started = true;
+    for (auto& connection : listen_conn) {
+        create_per_thread_listeners(*connection);
+    }
+
     executorPool =
             std::make_unique<ExecutorPool>(settings.getNumWorkerThreads());
+    if (settings.getSaslAuthThreads() != 0) {
+        saslAuthExecutorPool =
+                std::make_unique<ExecutorPool>(settings.getSaslAuthThreads());
+    }
 
     initializeTracing();
     TRACE_GLOBAL0("memcached", "Started");
@@ -2536,6 +2681,7 @@ extern "C" int memcached_main(int argc, char **argv) {
     threads_cleanup();
 
     LOG_INFO("Shutting down executor pool");
+    saslAuthExecutorPool.reset();
     executorPool.reset();
 
     LOG_INFO("Releasing signal handlers");
@@ -76,12 +76,26 @@ void threads_shutdown();
 void threads_cleanup();
 
 class ListeningPort;
-void dispatch_conn_new(SOCKET sfd, std::shared_ptr<ListeningPort>& interface);
+struct FrontEndThread;
+
+/**
+ * Bind a newly accepted client to a front-end thread.
+ *
+ * @param sfd the client's socket
+ * @param interface the interface it connected to
+ * @param acceptor the front-end thread which accepted it (from its own
+ *                 per-thread listening socket), which then serves it; or
+ *                 nullptr if it was accepted by the dispatcher, in which
+ *                 case it is handed to the least loaded thread
+ */
+void dispatch_conn_new(SOCKET sfd,
+                       std::shared_ptr<ListeningPort>& interface,
+                       FrontEndThread* acceptor = nullptr);
 
 /* Lock wrappers for cache functions that are called from main loop. */
 int is_listen_thread(void);
 
-void threadlocal_stats_reset(std::vector<thread_stats>& thread_stats);
+void threadlocal_stats_reset(ThreadStatsSlots& thread_stats);
 
 void notify_io_complete(gsl::not_null<const void*> cookie,
                         ENGINE_ERROR_CODE status);
@@ -117,6 +131,8 @@ bool associate_bucket(Connection& connection, const char* name);
 void disassociate_bucket(Connection& connection);
 
 void disable_listen();
+/// Ask the dispatcher to disable_listen() (from another thread)
+void request_disable_listen();
 bool is_listen_disabled();
 uint64_t get_listen_disabled_num();
 
@@ -128,6 +144,14 @@ uint64_t get_listen_disabled_num();
 class ExecutorPool;
 extern std::unique_ptr<ExecutorPool> executorPool;
 
+/**
+ * The executor pool SASL authentication tasks run on (see
+ * sasl_auth_threads), so a burst of authentications doesn't delay the
+ * tasks of executorPool. Null if not configured; they then run on
+ * executorPool.
+ */
+extern std::unique_ptr<ExecutorPool> saslAuthExecutorPool;
+
 void iterate_all_connections(std::function<void(Connection&)> callback);
 
 void start_stdin_listener(std::function<void()> function);
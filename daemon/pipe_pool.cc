@@ -0,0 +1,133 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "pipe_pool.h"
+
+#include <platform/pipe.h>
+
+#include <algorithm>
+
+const size_t PipePool::MinSize = 2048;
+const size_t PipePool::MaxCachedSize = 2 * 1024 * 1024;
+const size_t PipePool::MaxCachedBytesPerClass = 1024 * 1024;
+
+PipePool::PipePool() = default;
+PipePool::~PipePool() = default;
+
+size_t PipePool::getClassSize(size_t sizeClass) {
+    // Each class is 4 times the size of the previous one
+    return MinSize << (2 * sizeClass);
+}
+
+size_t PipePool::getAllocationClass(size_t size) {
+    size_t sizeClass = 0;
+    while (sizeClass < NumClasses && getClassSize(sizeClass) < size) {
+        ++sizeClass;
+    }
+    return sizeClass;
+}
+
+size_t PipePool::getReleaseClass(size_t capacity) {
+    if (capacity < MinSize) {
+        return NumClasses;
+    }
+    size_t sizeClass = 0;
+    while (sizeClass + 1 < NumClasses &&
+           getClassSize(sizeClass + 1) <= capacity) {
+        ++sizeClass;
+    }
+    return sizeClass;
+}
+
+size_t PipePool::getClassLimit(size_t sizeClass) {
+    const auto classSize = getClassSize(sizeClass);
+    if (classSize > MaxCachedSize) {
+        return 0;
+    }
+    return std::max(size_t(1), MaxCachedBytesPerClass / classSize);
+}
+
+std::unique_ptr<cb::Pipe> PipePool::allocate(size_t size, bool* allocated) {
+    const auto sizeClass = getAllocationClass(size);
+    if (sizeClass < NumClasses && !cache[sizeClass].empty()) {
+        auto ret = std::move(cache[sizeClass].back());
+        cache[sizeClass].pop_back();
+        if (allocated) {
+            *allocated = false;
+        }
+        return ret;
+    }
+
+    if (allocated) {
+        *allocated = true;
+    }
+    if (sizeClass == NumClasses) {
+        return std::make_unique<cb::Pipe>(size);
+    }
+    return std::make_unique<cb::Pipe>(getClassSize(sizeClass));
+}
+
+void PipePool::release(std::unique_ptr<cb::Pipe> pipe) {
+    if (!pipe) {
+        return;
+    }
+
+    const auto sizeClass = getReleaseClass(pipe->capacity());
+    if (sizeClass < NumClasses &&
+        cache[sizeClass].size() < getClassLimit(sizeClass)) {
+        pipe->clear();
+        cache[sizeClass].push_back(std::move(pipe));
+    }
+    // Otherwise the pipe goes out of scope and is freed
+}
+
+void PipePool::ensureCapacity(std::unique_ptr<cb::Pipe>& pipe,
+                              size_t nbytes) {
+    const auto used = pipe->rsize();
+    if (used + nbytes <= pipe->capacity()) {
+        // It fits (possibly after the pipe moves its data to the start of
+        // its buffer)
+        pipe->ensureCapacity(nbytes);
+        return;
+    }
+
+    auto next = allocate(used + nbytes);
+    if (used > 0) {
+        const auto data = pipe->rdata();
+        std::copy(data.begin(), data.end(), next->wdata().begin());
+        next->produced(used);
+    }
+    pipe.swap(next);
+    release(std::move(next));
+}
+
+size_t PipePool::size() const {
+    size_t ret = 0;
+    for (const auto& c : cache) {
+        ret += c.size();
+    }
+    return ret;
+}
+
+size_t PipePool::getCachedBytes() const {
+    size_t ret = 0;
+    for (const auto& c : cache) {
+        for (const auto& pipe : c) {
+            ret += pipe->capacity();
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,107 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace cb {
+class Pipe;
+}
+
+/**
+ * A cache of network buffers (cb::Pipe) owned by a front-end thread, used
+ * for the read and write buffers its connections borrow while they're
+ * being served.
+ *
+ * Buffers are kept in size classes (2KB, 8KB, ... 32MB, growing by a
+ * factor of 4), so a connection which needs a bigger buffer for a large
+ * packet gets one sized for the packet in a single allocation (and a
+ * single copy of the data it already has) rather than by repeatedly
+ * reallocating its buffer. Each class only caches up to
+ * MaxCachedBytesPerClass worth of buffers (but at least one buffer of up
+ * to MaxCachedSize), so a burst of large packets doesn't leave the thread
+ * holding on to the memory for good.
+ *
+ * Not thread safe; it's only used by its own thread.
+ */
+class PipePool {
+public:
+    /// The size of the smallest class
+    static const size_t MinSize;
+    /// Buffers larger than this aren't cached
+    static const size_t MaxCachedSize;
+    /// The maximum number of bytes cached in each size class.
+    static const size_t MaxCachedBytesPerClass;
+
+    PipePool();
+    ~PipePool();
+
+    /**
+     * Get an empty buffer with space for at least size bytes, from the
+     * cache if there is one.
+     *
+     * @param allocated set to true if a new buffer had to be allocated
+     * @throws std::bad_alloc if we fail to allocate memory
+     */
+    std::unique_ptr<cb::Pipe> allocate(size_t size, bool* allocated = nullptr);
+
+    /**
+     * Give a buffer back to the pool; it's freed if its size class is
+     * already full (or it's too big to be cached).
+     */
+    void release(std::unique_ptr<cb::Pipe> pipe);
+
+    /**
+     * Make sure the buffer has space for another nbytes of data. If it
+     * can't hold all of its data and nbytes more, its data is moved into a
+     * buffer of the right size class (from the pool) and the old buffer is
+     * released.
+     *
+     * @throws std::bad_alloc if we fail to allocate memory
+     */
+    void ensureCapacity(std::unique_ptr<cb::Pipe>& pipe, size_t nbytes);
+
+    /// The number of buffers currently cached
+    size_t size() const;
+
+    /// The number of bytes currently cached
+    size_t getCachedBytes() const;
+
+protected:
+    /// Number of size classes (2KB ... 32MB). Larger buffers are allocated
+    /// to size, and never cached.
+    static const size_t NumClasses = 8;
+
+    /// The size of the buffers in the given class
+    static size_t getClassSize(size_t sizeClass);
+
+    /// The smallest class whose buffers can hold size bytes (NumClasses if
+    /// there isn't one)
+    static size_t getAllocationClass(size_t size);
+
+    /// The largest class a buffer of capacity bytes may be cached as
+    /// (NumClasses if it's too small for any)
+    static size_t getReleaseClass(size_t capacity);
+
+    /// The number of buffers cached in the given class
+    static size_t getClassLimit(size_t sizeClass);
+
+    std::array<std::vector<std::unique_ptr<cb::Pipe>>, NumClasses> cache;
+};
@@ -0,0 +1,187 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "prometheus.h"
+
+#include <cmath>
+#include <cstdio>
+
+const size_t PrometheusRenderer::DefaultMaxSeries = 50000;
+
+static std::string format_double(double value) {
+    if (std::isnan(value)) {
+        return "NaN";
+    }
+    if (std::isinf(value)) {
+        return value > 0 ? "+Inf" : "-Inf";
+    }
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.17g", value);
+    return buffer;
+}
+
+PrometheusRenderer::PrometheusRenderer(cb::metrics::Cardinality cardinality,
+                                       size_t maxSeries)
+    : cardinality(cardinality), maxSeries(maxSeries) {
+}
+
+void PrometheusRenderer::setConstantLabels(
+        std::vector<std::pair<std::string, std::string>> l) {
+    constantLabels = std::move(l);
+}
+
+void PrometheusRenderer::addCounter(cb::const_char_buffer name,
+                                    cb::const_char_buffer help,
+                                    cb::metrics::Labels labels,
+                                    uint64_t value) {
+    if (beginSample(name, help, "counter", 1)) {
+        appendSeries(name, "", labels);
+        appendValue(value);
+    }
+}
+
+void PrometheusRenderer::addGauge(cb::const_char_buffer name,
+                                  cb::const_char_buffer help,
+                                  cb::metrics::Labels labels,
+                                  double value) {
+    if (beginSample(name, help, "gauge", 1)) {
+        appendSeries(name, "", labels);
+        appendValue(value);
+    }
+}
+
+void PrometheusRenderer::addHistogram(
+        cb::const_char_buffer name,
+        cb::const_char_buffer help,
+        cb::metrics::Labels labels,
+        const cb::metrics::HistogramData& histogram) {
+    // A series per bucket, and the +Inf bucket, sum and count
+    if (!beginSample(name, help, "histogram", histogram.buckets.size() + 3)) {
+        return;
+    }
+
+    for (const auto& bucket : histogram.buckets) {
+        const auto bound = format_double(bucket.first);
+        const cb::metrics::Label le{"le", bound};
+        appendSeries(name, "_bucket", labels, &le);
+        appendValue(bucket.second);
+    }
+    const cb::metrics::Label inf{"le", "+Inf"};
+    appendSeries(name, "_bucket", labels, &inf);
+    appendValue(histogram.count);
+    appendSeries(name, "_sum", labels);
+    appendValue(histogram.sum);
+    appendSeries(name, "_count", labels);
+    appendValue(histogram.count);
+}
+
+std::string PrometheusRenderer::finish() {
+    constantLabels.clear();
+    output.append("# HELP kv_metrics_dropped_series The series dropped as "
+                  "there were more than the max\n"
+                  "# TYPE kv_metrics_dropped_series gauge\n");
+    appendSeries("metrics_dropped_series", "", {});
+    appendValue(uint64_t(droppedSeries));
+    return std::move(output);
+}
+
+bool PrometheusRenderer::beginSample(cb::const_char_buffer name,
+                                     cb::const_char_buffer help,
+                                     const char* type,
+                                     size_t count) {
+    if (series + count > maxSeries) {
+        droppedSeries += count;
+        return false;
+    }
+    series += count;
+
+    if (family.compare(0, std::string::npos, name.data(), name.size()) != 0) {
+        family.assign(name.data(), name.size());
+        output.append("# HELP kv_");
+        output.append(name.data(), name.size());
+        output.push_back(' ');
+        output.append(help.data(), help.size());
+        output.append("\n# TYPE kv_");
+        output.append(name.data(), name.size());
+        output.push_back(' ');
+        output.append(type);
+        output.push_back('\n');
+    }
+    return true;
+}
+
+void PrometheusRenderer::appendSeries(cb::const_char_buffer name,
+                                      const char* suffix,
+                                      cb::metrics::Labels labels,
+                                      const cb::metrics::Label* extra) {
+    output.append("kv_");
+    output.append(name.data(), name.size());
+    output.append(suffix);
+    if (constantLabels.empty() && labels.size() == 0 && extra == nullptr) {
+        return;
+    }
+
+    char separator = '{';
+    auto append = [this, &separator](const cb::metrics::Label& label) {
+        output.push_back(separator);
+        output.append(label.first.data(), label.first.size());
+        output.append("=\"");
+        appendLabelValue(label.second);
+        output.push_back('"');
+        separator = ',';
+    };
+    for (const auto& label : constantLabels) {
+        append({label.first, label.second});
+    }
+    for (const auto& label : labels) {
+        append(label);
+    }
+    if (extra) {
+        append(*extra);
+    }
+    output.push_back('}');
+}
+
+void PrometheusRenderer::appendLabelValue(cb::const_char_buffer value) {
+    for (size_t ii = 0; ii < value.size(); ++ii) {
+        const char c = value.data()[ii];
+        switch (c) {
+        case '\\':
+            output.append("\\\\");
+            break;
+        case '"':
+            output.append("\\\"");
+            break;
+        case '\n':
+            output.append("\\n");
+            break;
+        default:
+            output.push_back(c);
+        }
+    }
+}
+
+void PrometheusRenderer::appendValue(uint64_t value) {
+    output.push_back(' ');
+    output.append(std::to_string(value));
+    output.push_back('\n');
+}
+
+void PrometheusRenderer::appendValue(double value) {
+    output.push_back(' ');
+    output.append(format_double(value));
+    output.push_back('\n');
+}
@@ -0,0 +1,106 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <memcached/metrics.h>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * A cb::metrics::Collector which renders the metrics added to it in the
+ * Prometheus text exposition format (as returned by "stats prometheus"), so
+ * that an exporter can serve them without parsing the stats.
+ *
+ * To bound the cost of a scrape (and the cardinality of the series the
+ * Prometheus server receives) the series beyond the max are dropped, and
+ * counted in kv_metrics_dropped_series.
+ */
+class PrometheusRenderer : public cb::metrics::Collector {
+public:
+    /// The default of the most series a rendering holds
+    static const size_t DefaultMaxSeries;
+
+    explicit PrometheusRenderer(cb::metrics::Cardinality cardinality,
+                                size_t maxSeries = DefaultMaxSeries);
+
+    cb::metrics::Cardinality getCardinality() const override {
+        return cardinality;
+    }
+
+    /**
+     * Set the labels added to each of the series added from now on (such as
+     * the name of the bucket).
+     */
+    void setConstantLabels(std::vector<std::pair<std::string, std::string>> l);
+
+    void addCounter(cb::const_char_buffer name,
+                    cb::const_char_buffer help,
+                    cb::metrics::Labels labels,
+                    uint64_t value) override;
+
+    void addGauge(cb::const_char_buffer name,
+                  cb::const_char_buffer help,
+                  cb::metrics::Labels labels,
+                  double value) override;
+
+    void addHistogram(cb::const_char_buffer name,
+                      cb::const_char_buffer help,
+                      cb::metrics::Labels labels,
+                      const cb::metrics::HistogramData& histogram) override;
+
+    /// Complete the rendering and get the text
+    std::string finish();
+
+    size_t getDroppedSeries() const {
+        return droppedSeries;
+    }
+
+private:
+    /**
+     * Begin a sample of the given metric, writing its HELP and TYPE lines if
+     * it is the first.
+     *
+     * @param series the number of series (lines) the sample adds
+     * @return false if the sample is to be dropped
+     */
+    bool beginSample(cb::const_char_buffer name,
+                     cb::const_char_buffer help,
+                     const char* type,
+                     size_t series);
+
+    /// Append name{labels[,extra]} (with the "kv_" prefix)
+    void appendSeries(cb::const_char_buffer name,
+                      const char* suffix,
+                      cb::metrics::Labels labels,
+                      const cb::metrics::Label* extra = nullptr);
+
+    void appendLabelValue(cb::const_char_buffer value);
+    void appendValue(uint64_t value);
+    void appendValue(double value);
+
+    const cb::metrics::Cardinality cardinality;
+    const size_t maxSeries;
+    std::vector<std::pair<std::string, std::string>> constantLabels;
+    /// The name of the metric of the last sample
+    std::string family;
+    size_t series = 0;
+    size_t droppedSeries = 0;
+    std::string output;
+};
@@ -49,6 +49,9 @@ ENGINE_ERROR_CODE AppendPrependCommandContext::step() {
         case State::InflateInputData:
             ret = inflateInputData();
             break;
+        case State::AppendPrependInPlace:
+            ret = appendPrependInPlace();
+            break;
         case State::GetItem:
             ret = getItem();
             break;
@@ -88,7 +91,7 @@ ENGINE_ERROR_CODE AppendPrependCommandContext::validateInput() {
     if (mcbp::datatype::is_snappy(datatype)) {
         state = State::InflateInputData;
     } else {
-        state = State::GetItem;
+        state = State::AppendPrependInPlace;
     }
     return ENGINE_SUCCESS;
 }
@@ -101,7 +104,7 @@ ENGINE_ERROR_CODE AppendPrependCommandContext::inflateInputData() {
             return ENGINE_EINVAL;
         }
         value = inputbuffer;
-        state = State::GetItem;
+        state = State::AppendPrependInPlace;
     } catch (const std::bad_alloc&) {
         return ENGINE_ENOMEM;
     }
@@ -109,6 +112,28 @@ ENGINE_ERROR_CODE AppendPrependCommandContext::inflateInputData() {
     return ENGINE_SUCCESS;
 }
 
+ENGINE_ERROR_CODE AppendPrependCommandContext::appendPrependInPlace() {
+    uint64_t ncas = cas;
+    auto ret = bucket_append_prepend(cookie,
+                                     key,
+                                     vbucket,
+                                     mode == Mode::Append,
+                                     value,
+                                     ncas,
+                                     cookie.getFrameInfos().durability,
+                                     extras);
+    if (ret == ENGINE_SUCCESS) {
+        sendSuccess(ncas);
+    } else if (ret == ENGINE_ENOTSUP) {
+        // The engine can't do it for this document; build the new
+        // document here and CAS store it.
+        state = State::GetItem;
+        ret = ENGINE_SUCCESS;
+    }
+
+    return ret;
+}
+
 ENGINE_ERROR_CODE AppendPrependCommandContext::getItem() {
     auto ret = bucket_get(cookie, key, vbucket);
     if (ret.first == cb::engine_errc::success) {
@@ -226,31 +251,19 @@ ENGINE_ERROR_CODE AppendPrependCommandContext::storeItem() {
                             newitem.get(),
                             ncas,
                             OPERATION_CAS,
-                            cookie.getRequest(Cookie::PacketContent::Full)
-                                    .getDurabilityRequirements());
+                            cookie.getFrameInfos().durability);
 
     if (ret == ENGINE_SUCCESS) {
-        update_topkeys(cookie);
-        cookie.setCas(ncas);
         if (connection.isSupportsMutationExtras()) {
             item_info newItemInfo;
             if (!bucket_get_item_info(
                         connection, newitem.get(), &newItemInfo)) {
                 return ENGINE_FAILED;
             }
-            extras.vbucket_uuid = htonll(newItemInfo.vbucket_uuid);
-            extras.seqno = htonll(newItemInfo.seqno);
-            cookie.sendResponse(
-                    cb::mcbp::Status::Success,
-                    {reinterpret_cast<const char*>(&extras), sizeof(extras)},
-                    {},
-                    {},
-                    cb::mcbp::Datatype::Raw,
-                    ncas);
-        } else {
-            cookie.sendResponse(cb::mcbp::Status::Success);
+            extras.vbucket_uuid = newItemInfo.vbucket_uuid;
+            extras.seqno = newItemInfo.seqno;
         }
-        state = State::Done;
+        sendSuccess(ncas);
     } else if (ret == ENGINE_KEY_EEXISTS && cas == 0) {
         state = State::Reset;
         // We need to return ENGINE_SUCCESS in order to continue processing
@@ -268,3 +281,22 @@ ENGINE_ERROR_CODE AppendPrependCommandContext::reset() {
     state = State::GetItem;
     return ENGINE_SUCCESS;
 }
+
+void AppendPrependCommandContext::sendSuccess(uint64_t ncas) {
+    update_topkeys(cookie);
+    cookie.setCas(ncas);
+    if (connection.isSupportsMutationExtras()) {
+        extras.vbucket_uuid = htonll(extras.vbucket_uuid);
+        extras.seqno = htonll(extras.seqno);
+        cookie.sendResponse(
+                cb::mcbp::Status::Success,
+                {reinterpret_cast<const char*>(&extras), sizeof(extras)},
+                {},
+                {},
+                cb::mcbp::Datatype::Raw,
+                ncas);
+    } else {
+        cookie.sendResponse(cb::mcbp::Status::Success);
+    }
+    state = State::Done;
+}
@@ -29,6 +29,10 @@
  * the document in the underlying engine. Multiple clients operating on the
  * same document will be detected by the CAS store operation returning EEXISTS,
  * and we just retry the operation.
+ *
+ * The underlying engine is first asked to perform the operation itself (in
+ * place, under its own locking) and we only fall back to the get/CAS store
+ * cycle if it doesn't support that for the document.
  */
 class AppendPrependCommandContext : public SteppableCommandContext {
 public:
@@ -43,6 +47,8 @@ public:
         // If the client sends compressed data we need to inflate the
         // input data before we can do anything
             InflateInputData,
+        // Ask the engine to perform the operation on the document in place
+            AppendPrependInPlace,
         // Look up the item to operate on
             GetItem,
         // Allocate the destination object
@@ -69,6 +75,8 @@ protected:
 
     ENGINE_ERROR_CODE inflateInputData();
 
+    ENGINE_ERROR_CODE appendPrependInPlace();
+
     ENGINE_ERROR_CODE getItem();
 
     ENGINE_ERROR_CODE allocateNewItem();
@@ -78,6 +86,10 @@ protected:
     ENGINE_ERROR_CODE reset();
 
 private:
+    /// Send the response for the successful mutation (described in extras
+    /// in host byte order) and move to Done.
+    void sendSuccess(uint64_t ncas);
+
     const Mode mode;
     const DocKey key;
     cb::const_char_buffer value;
@@ -96,8 +108,8 @@ private:
     // The extras section is used as a buffer to hold extra meta information
     // about the mutation while it is being sent back to the client iff the
     // client requested them (as the context object have the same lifetime
-    // as the command). They're stored in network byte order in this
-    // member variable.
+    // as the command). sendSuccess() converts them to network byte order
+    // in this member variable.
     mutation_descr_t extras = {};
     protocol_binary_datatype_t datatype;
 };
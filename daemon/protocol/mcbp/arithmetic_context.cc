@@ -40,6 +40,34 @@ ArithmeticCommandContext::ArithmeticCommandContext(Cookie& cookie,
                 req.getClientOpcode() == cb::mcbp::ClientOpcode::Incrementq) {
 }
 
+ENGINE_ERROR_CODE ArithmeticCommandContext::arithmeticInPlace() {
+    const auto ret = bucket_arithmetic(cookie,
+                                       key,
+                                       vbucket,
+                                       increment,
+                                       extras.getDelta(),
+                                       cas,
+                                       cookie.getFrameInfos().durability);
+    switch (ret.status) {
+    case cb::engine_errc::success: {
+        result = ret.value;
+        cookie.setCas(ret.cas);
+        mutation_descr_t mutation{};
+        mutation.vbucket_uuid = ret.vbucket_uuid;
+        mutation.seqno = ret.seqno;
+        inPlaceMutation = mutation;
+        state = State::SendResult;
+        return ENGINE_SUCCESS;
+    }
+    case cb::engine_errc::not_supported:
+        // Perform the operation as a get and a CAS store instead
+        state = State::GetItem;
+        return ENGINE_SUCCESS;
+    default:
+        return ENGINE_ERROR_CODE(ret.status);
+    }
+}
+
 ENGINE_ERROR_CODE ArithmeticCommandContext::getItem() {
     auto ret = bucket_get(cookie, key, vbucket);
     if (ret.first == cb::engine_errc::success) {
@@ -114,8 +142,7 @@ ENGINE_ERROR_CODE ArithmeticCommandContext::storeNewItem() {
                             newitem.get(),
                             ncas,
                             OPERATION_ADD,
-                            cookie.getRequest(Cookie::PacketContent::Full)
-                                    .getDurabilityRequirements());
+                            cookie.getFrameInfos().durability);
 
     if (ret == ENGINE_SUCCESS) {
         cookie.setCas(ncas);
@@ -219,8 +246,7 @@ ENGINE_ERROR_CODE ArithmeticCommandContext::storeItem() {
                             newitem.get(),
                             ncas,
                             OPERATION_CAS,
-                            cookie.getRequest(Cookie::PacketContent::Full)
-                                    .getDurabilityRequirements());
+                            cookie.getFrameInfos().durability);
 
     if (ret == ENGINE_SUCCESS) {
         cookie.setCas(ncas);
@@ -245,8 +271,7 @@ ENGINE_ERROR_CODE ArithmeticCommandContext::sendResult() {
     }
 
     if (cookie.getRequest().isQuiet()) {
-        ++connection.getBucket()
-                  .responseCounters[int(cb::mcbp::Status::Success)];
+        connection.countResponse(cb::mcbp::Status::Success);
         connection.setState(StateMachine::State::new_cmd);
         return ENGINE_SUCCESS;
     }
@@ -259,7 +284,10 @@ ENGINE_ERROR_CODE ArithmeticCommandContext::sendResult() {
     cb::const_char_buffer value = {reinterpret_cast<const char*>(&result),
                                    sizeof(result)};
 
-    if (connection.isSupportsMutationExtras()) {
+    if (connection.isSupportsMutationExtras() && inPlaceMutation) {
+        mutation_descr.vbucket_uuid = htonll(inPlaceMutation->vbucket_uuid);
+        mutation_descr.seqno = htonll(inPlaceMutation->seqno);
+    } else if (connection.isSupportsMutationExtras()) {
         item_info newItemInfo;
         if (!bucket_get_item_info(connection, newitem.get(), &newItemInfo)) {
             return ENGINE_FAILED;
@@ -287,6 +315,7 @@ ENGINE_ERROR_CODE ArithmeticCommandContext::reset() {
     olditem.reset();
     newitem.reset();
     buffer.reset();
-    state = State::GetItem;
+    inPlaceMutation.reset();
+    state = State::ArithmeticInPlace;
     return ENGINE_SUCCESS;
 }
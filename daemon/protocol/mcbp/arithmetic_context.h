@@ -36,16 +36,23 @@ class ArithmeticCommandContext : public SteppableCommandContext {
 public:
     /**
      * The internal state diagram for performing an arithmetic operation.
-     * We've got two different paths through the state diagram depending
-     * if the counter exists or not:
+     * The engine is first asked to perform the whole operation in place:
+     *
+     *    ArithmeticInPlace -> SendResult -> Done
+     *
+     * If it doesn't support that (for the document) we've got two
+     * different paths through the state diagram depending if the counter
+     * exists or not:
      *
      * If the document exists:
      *
-     *    GetItem -> AllocateNewItem -> StoreItem -> SendResult -> Done
+     *    ArithmeticInPlace -> GetItem -> AllocateNewItem -> StoreItem ->
+     *        SendResult -> Done
      *
      * If the document doesn't already exists:
      *
-     *    GetItem -> CreateNewItem -> StoreNewItem -> SendResult -> Done
+     *    ArithmeticInPlace -> GetItem -> CreateNewItem -> StoreNewItem ->
+     *        SendResult -> Done
      *
      * Each state may terminate the state machine immediately if the
      * underlying engine returns an error. In that case the error is
@@ -57,6 +64,7 @@ public:
      * forever we give up after a 10 times.
      */
     enum class State {
+        ArithmeticInPlace,
         GetItem,
         CreateNewItem,
         StoreNewItem,
@@ -78,6 +86,9 @@ protected:
         auto ret = ENGINE_SUCCESS;
         do {
             switch (state) {
+            case State::ArithmeticInPlace:
+                ret = arithmeticInPlace();
+                break;
             case State::GetItem:
                 ret = getItem();
                 break;
@@ -107,6 +118,8 @@ protected:
         return ret;
     }
 
+    ENGINE_ERROR_CODE arithmeticInPlace();
+
     ENGINE_ERROR_CODE getItem();
 
     ENGINE_ERROR_CODE createNewItem();
@@ -133,5 +146,7 @@ private:
     cb::unique_item_ptr newitem;
     cb::compression::Buffer buffer;
     uint64_t result = 0;
-    State state = State::GetItem;
+    /// The mutation, if the engine performed the operation in place
+    boost::optional<mutation_descr_t> inPlaceMutation;
+    State state = State::ArithmeticInPlace;
 };
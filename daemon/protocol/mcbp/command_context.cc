@@ -0,0 +1,113 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "command_context.h"
+
+#include <relaxed_atomic.h>
+
+#include <array>
+#include <new>
+
+/// Contexts are recycled in size classes of this granularity ...
+static const std::size_t SizeClassBytes = 64;
+/// ... up to this size (larger ones always come from the allocator)
+static const std::size_t MaxRecycledSize = 1024;
+/// The number of freed blocks each thread keeps per size class
+static const std::size_t BlocksPerClass = 8;
+
+static cb::RelaxedAtomic<uint64_t> contextsAllocated;
+static cb::RelaxedAtomic<uint64_t> contextsReused;
+
+namespace {
+/// Set once the thread's cache is destroyed (at thread exit), after which
+/// contexts freed by the thread go straight back to the allocator
+thread_local bool cacheDestroyed = false;
+
+class ContextCache {
+public:
+    ~ContextCache() {
+        for (auto& sizeClass : classes) {
+            for (std::size_t ii = 0; ii < sizeClass.count; ++ii) {
+                ::operator delete(sizeClass.blocks[ii]);
+            }
+            sizeClass.count = 0;
+        }
+        cacheDestroyed = true;
+    }
+
+    void* take(std::size_t index) {
+        auto& sizeClass = classes[index];
+        if (sizeClass.count == 0) {
+            return nullptr;
+        }
+        return sizeClass.blocks[--sizeClass.count];
+    }
+
+    bool put(std::size_t index, void* ptr) {
+        auto& sizeClass = classes[index];
+        if (sizeClass.count == BlocksPerClass) {
+            return false;
+        }
+        sizeClass.blocks[sizeClass.count++] = ptr;
+        return true;
+    }
+
+private:
+    struct SizeClass {
+        std::array<void*, BlocksPerClass> blocks;
+        std::size_t count = 0;
+    };
+    std::array<SizeClass, MaxRecycledSize / SizeClassBytes> classes;
+};
+
+thread_local ContextCache cache;
+
+std::size_t sizeClassIndex(std::size_t count) {
+    return (count - 1) / SizeClassBytes;
+}
+} // namespace
+
+void* CommandContext::operator new(std::size_t count) {
+    if (count <= MaxRecycledSize && !cacheDestroyed) {
+        const auto index = sizeClassIndex(count);
+        auto* ret = cache.take(index);
+        if (ret != nullptr) {
+            contextsReused++;
+            return ret;
+        }
+        // Allocate the whole size class so the block may be reused by any
+        // context of the class
+        contextsAllocated++;
+        return ::operator new((index + 1) * SizeClassBytes);
+    }
+    contextsAllocated++;
+    return ::operator new(count);
+}
+
+void CommandContext::operator delete(void* ptr, std::size_t count) {
+    if (ptr == nullptr) {
+        return;
+    }
+    if (count <= MaxRecycledSize && !cacheDestroyed &&
+        cache.put(sizeClassIndex(count), ptr)) {
+        return;
+    }
+    ::operator delete(ptr);
+}
+
+CommandContext::AllocationStats CommandContext::getAllocationStats() {
+    return {contextsAllocated.load(), contextsReused.load()};
+}
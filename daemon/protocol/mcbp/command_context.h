@@ -19,6 +19,9 @@
 #include <memcached/engine_error.h>
 #include <memcached/types.h>
 
+#include <cstddef>
+#include <cstdint>
+
 /**
  *  A command may need to store command specific context during the duration
  *  of a command (you might for instance want to keep state between multiple
@@ -27,11 +30,28 @@
  *  The implementation of such commands should subclass this class and
  *  allocate an instance and store in the commands commandContext member (which
  *  will be deleted and set to nullptr between each command being processed).
+ *
+ *  As one is created for most commands, their memory is recycled: each
+ *  thread keeps a few blocks of each size class freed by it, which the next
+ *  contexts created by the thread reuse rather than going to the allocator.
  */
 class CommandContext {
 public:
     virtual ~CommandContext(){};
 
+    static void* operator new(std::size_t count);
+    static void operator delete(void* ptr, std::size_t count);
+
+    struct AllocationStats {
+        /// Contexts whose memory came from the allocator
+        uint64_t allocated;
+        /// Contexts which reused the memory of a freed context
+        uint64_t reused;
+    };
+
+    /// Get the (process wide) statistics of the context memory recycling
+    static AllocationStats getAllocationStats();
+
     /**
      * The `pre_link_document()` is a hook called from the underlying engine
      * as part of the `store()` method in the engine API. See the `pre_link()`
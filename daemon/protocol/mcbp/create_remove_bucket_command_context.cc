@@ -45,6 +45,10 @@ public:
         return Status::Finished;
     }
 
+    Class getClass() const override {
+        return Class::BucketManagement;
+    }
+
     void notifyExecutionComplete() override {
         notify_io_complete(static_cast<const void*>(&cookie),
                            thread.getResult());
@@ -138,6 +138,53 @@ cb::EngineErrorCasPair bucket_store_if(
     return ret;
 }
 
+cb::EngineErrorArithmeticResult bucket_arithmetic(
+        Cookie& cookie,
+        const DocKey& key,
+        Vbid vbucket,
+        bool increment,
+        uint64_t delta,
+        uint64_t cas,
+        boost::optional<cb::durability::Requirements> durability) {
+    auto& c = cookie.getConnection();
+    auto ret = c.getBucketEngine()->arithmetic(
+            &cookie, key, vbucket, increment, delta, cas, durability);
+    if (ret.status == cb::engine_errc::success) {
+        using namespace cb::audit::document;
+        add(cookie, Operation::Modify);
+    } else if (ret.status == cb::engine_errc::disconnect) {
+        LOG_WARNING("{}: {} arithmetic return ENGINE_DISCONNECT",
+                    c.getId(),
+                    c.getDescription());
+    }
+
+    return ret;
+}
+
+ENGINE_ERROR_CODE bucket_append_prepend(
+        Cookie& cookie,
+        const DocKey& key,
+        Vbid vbucket,
+        bool append,
+        cb::const_char_buffer value,
+        uint64_t& cas,
+        boost::optional<cb::durability::Requirements> durability,
+        mutation_descr_t& mut_info) {
+    auto& c = cookie.getConnection();
+    auto ret = c.getBucketEngine()->append_prepend(
+            &cookie, key, vbucket, append, value, cas, durability, mut_info);
+    if (ret == ENGINE_SUCCESS) {
+        using namespace cb::audit::document;
+        add(cookie, Operation::Modify);
+    } else if (ret == ENGINE_DISCONNECT) {
+        LOG_WARNING("{}: {} append_prepend return ENGINE_DISCONNECT",
+                    c.getId(),
+                    c.getDescription());
+    }
+
+    return ret;
+}
+
 ENGINE_ERROR_CODE bucket_remove(
         Cookie& cookie,
         const DocKey& key,
@@ -325,6 +372,18 @@ ENGINE_ERROR_CODE bucket_get_stats(Cookie& cookie,
     return ret;
 }
 
+ENGINE_ERROR_CODE bucket_get_metrics(Cookie& cookie,
+                                     cb::metrics::Collector& collector) {
+    auto& c = cookie.getConnection();
+    auto ret = c.getBucketEngine()->get_metrics(&cookie, collector);
+    if (ret == ENGINE_DISCONNECT) {
+        LOG_WARNING("{}: {} bucket_get_metrics return ENGINE_DISCONNECT",
+                    c.getId(),
+                    c.getDescription());
+    }
+    return ret;
+}
+
 ENGINE_ERROR_CODE dcpAddStream(Cookie& cookie,
                                uint32_t opaque,
                                Vbid vbid,
@@ -71,6 +71,25 @@ cb::EngineErrorCasPair bucket_store_if(
         boost::optional<cb::durability::Requirements> durability,
         DocumentState document_state = DocumentState::Alive);
 
+cb::EngineErrorArithmeticResult bucket_arithmetic(
+        Cookie& cookie,
+        const DocKey& key,
+        Vbid vbucket,
+        bool increment,
+        uint64_t delta,
+        uint64_t cas,
+        boost::optional<cb::durability::Requirements> durability);
+
+ENGINE_ERROR_CODE bucket_append_prepend(
+        Cookie& cookie,
+        const DocKey& key,
+        Vbid vbucket,
+        bool append,
+        cb::const_char_buffer value,
+        uint64_t& cas,
+        boost::optional<cb::durability::Requirements> durability,
+        mutation_descr_t& mut_info);
+
 ENGINE_ERROR_CODE bucket_remove(
         Cookie& cookie,
         const DocKey& key,
@@ -129,6 +148,9 @@ ENGINE_ERROR_CODE bucket_get_stats(Cookie& cookie,
                                    cb::const_char_buffer key,
                                    const AddStatFn& add_stat);
 
+ENGINE_ERROR_CODE bucket_get_metrics(Cookie& cookie,
+                                     cb::metrics::Collector& collector);
+
 /**
  * Calls the underlying engine DCP add-stream
  *
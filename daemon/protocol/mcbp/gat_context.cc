@@ -52,8 +52,7 @@ ENGINE_ERROR_CODE GatCommandContext::getAndTouchItem() {
                                  key,
                                  vbucket,
                                  exptime,
-                                 cookie.getRequest(Cookie::PacketContent::Full)
-                                         .getDurabilityRequirements());
+                                 cookie.getFrameInfos().durability);
     if (ret.first == cb::engine_errc::success) {
         it = std::move(ret.second);
         if (!bucket_get_item_info(connection, it.get(), &info)) {
@@ -95,6 +94,7 @@ ENGINE_ERROR_CODE GatCommandContext::inflateItem() {
             return ENGINE_FAILED;
         }
         payload = buffer;
+        get_thread_stats(&connection)->bytes_get_inflated += buffer.size();
     } catch (const std::bad_alloc&) {
         return ENGINE_ENOMEM;
     }
@@ -148,8 +148,7 @@ ENGINE_ERROR_CODE GatCommandContext::sendResponse() {
 ENGINE_ERROR_CODE GatCommandContext::noSuchItem() {
     STATS_MISS(&connection, get);
     if (cookie.getRequest().isQuiet()) {
-        ++connection.getBucket()
-                    .responseCounters[int(cb::mcbp::Status::KeyEnoent)];
+        connection.countResponse(cb::mcbp::Status::KeyEnoent);
         connection.setState(StateMachine::State::new_cmd);
     } else {
         cookie.sendResponse(cb::mcbp::Status::KeyEnoent);
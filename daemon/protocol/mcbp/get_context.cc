@@ -27,6 +27,8 @@
 #include <xattr/utils.h>
 #include <gsl/gsl>
 
+#include <algorithm>
+
 ENGINE_ERROR_CODE GetCommandContext::getItem() {
     const auto key = cookie.getRequestKey();
     auto ret = bucket_get(cookie, key, vbucket);
@@ -67,6 +69,7 @@ ENGINE_ERROR_CODE GetCommandContext::inflateItem() {
             return ENGINE_FAILED;
         }
         payload = buffer;
+        get_thread_stats(&connection)->bytes_get_inflated += buffer.size();
     } catch (const std::bad_alloc&) {
         return ENGINE_ENOMEM;
     }
@@ -107,8 +110,14 @@ ENGINE_ERROR_CODE GetCommandContext::sendResponse() {
                     bodylen,
                     datatype);
 
-    // Add the flags
-    connection.addIov(&info.flags, sizeof(info.flags));
+    // Add the flags (copy them to the write buffer to let the response
+    // outlive this context)
+    auto wdata = connection.write->wdata();
+    std::copy_n(reinterpret_cast<const uint8_t*>(&info.flags),
+                sizeof(info.flags),
+                wdata.begin());
+    connection.write->produced(sizeof(info.flags));
+    connection.addIov(wdata.data(), sizeof(info.flags));
 
     // Add the value
     if (shouldSendKey()) {
@@ -116,6 +125,17 @@ ENGINE_ERROR_CODE GetCommandContext::sendResponse() {
     }
 
     connection.addIov(payload.buf, payload.len);
+
+    // Unless we had to inflate the value (into our buffer) the response
+    // refers to the item only. If the client sent more gets after this
+    // one, hand the item over to the connection so the response may be
+    // sent together with theirs.
+    if (buffer.size() == 0 && connection.isNextCommandBatchable() &&
+        connection.reserveItem(it.get())) {
+        it.release();
+        connection.setResponseDeferrable();
+    }
+
     connection.setState(StateMachine::State::send_data);
     cb::audit::document::add(cookie, cb::audit::document::Operation::Read);
 
@@ -132,8 +152,7 @@ ENGINE_ERROR_CODE GetCommandContext::noSuchItem() {
     const auto key = cookie.getRequestKey();
 
     if (cookie.getRequest().isQuiet()) {
-        ++connection.getBucket()
-                  .responseCounters[int(cb::mcbp::Status::KeyEnoent)];
+        connection.countResponse(cb::mcbp::Status::KeyEnoent);
         connection.setState(StateMachine::State::new_cmd);
     } else {
         if (shouldSendKey()) {
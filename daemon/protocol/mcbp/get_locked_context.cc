@@ -72,6 +72,7 @@ ENGINE_ERROR_CODE GetLockedCommandContext::inflateItem() {
             return ENGINE_FAILED;
         }
         payload = buffer;
+        get_thread_stats(&connection)->bytes_get_inflated += buffer.size();
     } catch (const std::bad_alloc&) {
         return ENGINE_ENOMEM;
     }
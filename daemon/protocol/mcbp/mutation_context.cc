@@ -287,13 +287,12 @@ ENGINE_ERROR_CODE MutationCommandContext::allocateNewItem() {
 }
 
 ENGINE_ERROR_CODE MutationCommandContext::storeItem() {
-    const auto& request = cookie.getRequest(Cookie::PacketContent::Full);
     auto ret = bucket_store_if(cookie,
                                newitem.get(),
                                input_cas,
                                operation,
                                store_if_predicate,
-                               request.getDurabilityRequirements());
+                               cookie.getFrameInfos().durability);
     if (ret.status == cb::engine_errc::success) {
         cookie.setCas(ret.cas);
         state = State::SendResponse;
@@ -329,8 +328,7 @@ ENGINE_ERROR_CODE MutationCommandContext::sendResponse() {
     state = State::Done;
 
     if (cookie.getRequest().isQuiet()) {
-        ++connection.getBucket()
-                  .responseCounters[int(cb::mcbp::Status::Success)];
+        connection.countResponse(cb::mcbp::Status::Success);
         connection.setState(StateMachine::State::new_cmd);
         return ENGINE_SUCCESS;
     }
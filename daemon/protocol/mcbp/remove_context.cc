@@ -158,12 +158,11 @@ ENGINE_ERROR_CODE RemoveCommandContext::storeItem() {
 
 ENGINE_ERROR_CODE RemoveCommandContext::removeItem() {
     uint64_t new_cas = input_cas;
-    const auto& request = cookie.getRequest(Cookie::PacketContent::Full);
     auto ret = bucket_remove(cookie,
                              key,
                              new_cas,
                              vbucket,
-                             request.getDurabilityRequirements(),
+                             cookie.getFrameInfos().durability,
                              mutation_descr);
 
     if (ret == ENGINE_SUCCESS) {
@@ -192,8 +191,7 @@ ENGINE_ERROR_CODE RemoveCommandContext::sendResponse() {
     state = State::Done;
 
     if (cookie.getRequest().isQuiet()) {
-        ++connection.getBucket()
-                  .responseCounters[int(cb::mcbp::Status::Success)];
+        connection.countResponse(cb::mcbp::Status::Success);
         connection.setState(StateMachine::State::new_cmd);
         return ENGINE_SUCCESS;
     }
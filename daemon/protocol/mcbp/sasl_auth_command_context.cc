@@ -56,7 +56,11 @@ ENGINE_ERROR_CODE SaslAuthCommandContext::initial() {
     }
 
     std::lock_guard<std::mutex> guard(task->getMutex());
-    executorPool->schedule(task, true);
+    if (saslAuthExecutorPool) {
+        saslAuthExecutorPool->schedule(task, true);
+    } else {
+        executorPool->schedule(task, true);
+    }
 
     state = State::ParseAuthTaskResult;
     return ENGINE_EWOULDBLOCK;
@@ -24,9 +24,11 @@
 #include <daemon/connection.h>
 #include <daemon/cookie.h>
 #include <daemon/executorpool.h>
+#include <daemon/front_end_thread.h>
 #include <daemon/mc_time.h>
 #include <daemon/mcaudit.h>
 #include <daemon/memcached.h>
+#include <daemon/prometheus.h>
 #include <daemon/runtime.h>
 #include <daemon/settings.h>
 #include <daemon/stats.h>
@@ -39,8 +41,16 @@
 #include <phosphor/stats_callback.h>
 #include <phosphor/trace_log.h>
 #include <platform/checked_snprintf.h>
+#include <platform/string_hex.h>
+#include <tracing/tracetypes.h>
 
 #include <gsl/gsl>
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+#include <algorithm>
+#include <array>
+#include <sstream>
 
 /*************************** ADD STAT CALLBACKS ***************************/
 
@@ -170,6 +180,33 @@ static ENGINE_ERROR_CODE server_stats(const AddStatFn& add_stat_callback,
         add_stat(cookie, add_stat_callback, "libevent", event_get_version());
         add_stat(cookie, add_stat_callback, "pointer_size", (8 * sizeof(void*)));
 
+#ifndef WIN32
+        // The CPU time used by the process (in seconds), for instance to
+        // work out the cost of each operation under a given load
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+            char buf[32];
+            checked_snprintf(buf,
+                             sizeof(buf),
+                             "%ld.%06ld",
+                             long(usage.ru_utime.tv_sec),
+                             long(usage.ru_utime.tv_usec));
+            add_stat(cookie,
+                     add_stat_callback,
+                     "rusage_user",
+                     (const char*)buf);
+            checked_snprintf(buf,
+                             sizeof(buf),
+                             "%ld.%06ld",
+                             long(usage.ru_stime.tv_sec),
+                             long(usage.ru_stime.tv_usec));
+            add_stat(cookie,
+                     add_stat_callback,
+                     "rusage_system",
+                     (const char*)buf);
+        }
+#endif
+
         add_stat(cookie, add_stat_callback, "daemon_connections",
                  stats.daemon_conns);
         add_stat(cookie, add_stat_callback, "curr_connections",
@@ -198,6 +235,8 @@ static ENGINE_ERROR_CODE server_stats(const AddStatFn& add_stat_callback,
                  thread_stats.bytes_subdoc_mutation_total);
         add_stat(cookie, add_stat_callback, "bytes_subdoc_mutation_inserted",
                  thread_stats.bytes_subdoc_mutation_inserted);
+        add_stat(cookie, add_stat_callback, "bytes_get_inflated",
+                 thread_stats.bytes_get_inflated);
 
         // index 0 contains the aggregated timings for all buckets
         auto& timings = all_buckets[0].timings;
@@ -250,6 +289,16 @@ static ENGINE_ERROR_CODE server_stats(const AddStatFn& add_stat_callback,
         add_stat(cookie, add_stat_callback, "msgused_high_watermark",
                  thread_stats.msgused_high_watermark);
 
+        const auto contexts = CommandContext::getAllocationStats();
+        add_stat(cookie,
+                 add_stat_callback,
+                 "cmd_context_allocated",
+                 contexts.allocated);
+        add_stat(cookie,
+                 add_stat_callback,
+                 "cmd_context_reused",
+                 contexts.reused);
+
         add_stat(cookie, add_stat_callback, "cmd_lock", thread_stats.cmd_lock);
         add_stat(cookie, add_stat_callback, "lock_errors",
                  thread_stats.lock_errors);
@@ -266,8 +315,8 @@ static ENGINE_ERROR_CODE server_stats(const AddStatFn& add_stat_callback,
         add_stat(cookie, add_stat_callback, "cmd_mutation_10s_duration_us",
                  mutation_latency.duration_ns / 1000);
 
-        auto& respCounters =
-                cookie.getConnection().getBucket().responseCounters;
+        const auto respCounters =
+                cookie.getConnection().getBucket().getResponseCounters();
         // Ignore success responses by starting from begin + 1
         uint64_t total_resp_errors = std::accumulate(
                 std::begin(respCounters) + 1, std::end(respCounters), 0);
@@ -317,6 +366,11 @@ static void append_stats(const char* key,
 
     auto& cookie = *const_cast<Cookie*>(
             reinterpret_cast<const Cookie*>(void_cookie.get()));
+    auto* delta = cookie.getStatsDelta();
+    if (delta && klen != 0 && !delta->update({key, klen}, {val, vlen})) {
+        // Unchanged since the connection's previous poll of the group
+        return;
+    }
     needed = vlen + klen + sizeof(protocol_binary_response_header);
     if (!cookie.growDynamicBuffer(needed)) {
         return;
@@ -424,6 +478,44 @@ static ENGINE_ERROR_CODE stat_sched_executor(const std::string& arg,
                      gsl::narrow<uint32_t>(hist.size()),
                      &cookie);
         return ENGINE_SUCCESS;
+    } else if (arg == "load") {
+        const auto load = get_front_end_thread_load();
+        for (size_t ii = 0; ii < load.size(); ++ii) {
+            const auto prefix = std::to_string(ii) + ":";
+            add_stat(cookie,
+                     appendStatsFn,
+                     (prefix + "connections").c_str(),
+                     load[ii].connections);
+            add_stat(cookie,
+                     appendStatsFn,
+                     (prefix + "busy_time").c_str(),
+                     load[ii].busy_time);
+            add_stat(cookie,
+                     appendStatsFn,
+                     (prefix + "utilization").c_str(),
+                     load[ii].utilization);
+            add_stat(cookie,
+                     appendStatsFn,
+                     (prefix + "migrated_in").c_str(),
+                     load[ii].migrated_in);
+            add_stat(cookie,
+                     appendStatsFn,
+                     (prefix + "migrated_out").c_str(),
+                     load[ii].migrated_out);
+        }
+        return ENGINE_SUCCESS;
+    } else if (arg == "run_queue") {
+        static const std::array<std::string, 3> keys = {
+                {"high", "medium", "low"}};
+        for (size_t ii = 0; ii < keys.size(); ++ii) {
+            auto hist = get_run_queue_wait(ii).to_string();
+            append_stats(keys[ii].data(),
+                         gsl::narrow<uint16_t>(keys[ii].size()),
+                         hist.data(),
+                         gsl::narrow<uint32_t>(hist.size()),
+                         &cookie);
+        }
+        return ENGINE_SUCCESS;
     } else {
         return ENGINE_EINVAL;
     }
@@ -600,15 +692,422 @@ static ENGINE_ERROR_CODE stat_subdoc_execute_executor(const std::string& arg,
     }
 }
 
+/**
+ * Handler for the <code>stats executor_timings</code> command used to
+ * retrieve the histograms of the runtime ("<class>:runtime") and the time
+ * spent runnable before it ran ("<class>:wait") of each class of task run
+ * by the daemon's executor pools.
+ *
+ * @param arg - should be empty
+ * @param cookie the command context
+ */
+static ENGINE_ERROR_CODE stat_executor_timings_executor(const std::string& arg,
+                                                        Cookie& cookie) {
+    if (!arg.empty()) {
+        return ENGINE_EINVAL;
+    }
+
+    auto append = [&cookie](const std::string& key,
+                            Hdr1sfMicroSecHistogram& histogram) {
+        const auto value = histogram.to_string();
+        append_stats(key.c_str(),
+                     gsl::narrow<uint16_t>(key.size()),
+                     value.c_str(),
+                     gsl::narrow<uint32_t>(value.size()),
+                     &cookie);
+    };
+
+    const std::array<const ExecutorPool*, 2> pools = {
+            {executorPool.get(), saslAuthExecutorPool.get()}};
+    for (size_t ii = 0; ii < Task::NumClasses; ++ii) {
+        const auto taskClass = Task::Class(ii);
+        Hdr1sfMicroSecHistogram runtimes{};
+        Hdr1sfMicroSecHistogram waitTimes{};
+        for (const auto* pool : pools) {
+            if (pool != nullptr) {
+                runtimes += pool->getRuntimes(taskClass);
+                waitTimes += pool->getWaitTimes(taskClass);
+            }
+        }
+        append(to_string(taskClass) + ":runtime", runtimes);
+        append(to_string(taskClass) + ":wait", waitTimes);
+    }
+    return ENGINE_SUCCESS;
+}
+
+/**
+ * Handler for the <code>stats throttle_wait</code> command used to retrieve
+ * the histogram of how long the connections of the selected bucket (or of
+ * all buckets, if none is selected) were deferred for exceeding the
+ * bucket's front-end budget.
+ *
+ * @param arg - should be empty
+ * @param cookie the command context
+ */
+static ENGINE_ERROR_CODE stat_throttle_wait_executor(const std::string& arg,
+                                                     Cookie& cookie) {
+    if (!arg.empty()) {
+        return ENGINE_EINVAL;
+    }
+
+    const auto index = cookie.getConnection().getBucketIndex();
+    std::string json_str;
+    if (index == 0) {
+        Hdr1sfMicroSecHistogram aggregated{};
+        for (const auto& bucket : all_buckets) {
+            aggregated += bucket.throttle.waitTimes;
+        }
+        json_str = aggregated.to_string();
+    } else {
+        json_str = all_buckets[index].throttle.waitTimes.to_string();
+    }
+    append_stats(nullptr,
+                 0,
+                 json_str.c_str(),
+                 gsl::narrow<uint32_t>(json_str.size()),
+                 &cookie);
+    return ENGINE_SUCCESS;
+}
+
+/**
+ * Handler for the <code>stats span_timings &lt;opcode&gt; &lt;span&gt;</code>
+ * command used to retrieve the histogram of the time the given opcode spent
+ * in one of the spans traced within it (such as "bg.load" or "ht.lock"), so
+ * that it can be displayed by mctimings.
+ *
+ * Spans are only recorded for connections which have tracing enabled (and
+ * the requests picked by the RequestSampler).
+ *
+ * @param arg - the opcode and the name of the span
+ * @param cookie the command context
+ */
+static ENGINE_ERROR_CODE stat_span_timings_executor(const std::string& arg,
+                                                   Cookie& cookie) {
+    // The opcode may itself contain spaces (e.g. "subdoc get").
+    const auto index = arg.rfind(' ');
+    if (index == std::string::npos) {
+        return ENGINE_EINVAL;
+    }
+
+    cb::mcbp::ClientOpcode opcode;
+    try {
+        opcode = to_opcode(arg.substr(0, index));
+    } catch (const std::invalid_argument&) {
+        return ENGINE_EINVAL;
+    }
+
+    const auto name = arg.substr(index + 1);
+    for (size_t ii = 0; ii < cb::tracing::NumTraceCodes; ++ii) {
+        const auto code = cb::tracing::TraceCode(ii);
+        if (to_string(code) != name) {
+            continue;
+        }
+
+        auto& bucket = all_buckets[cookie.getConnection().getBucketIndex()];
+        const auto* histogram =
+                bucket.timings.get_span_histogram(uint8_t(opcode), code);
+        const std::string json_str =
+                histogram ? histogram->to_string() : std::string("{}");
+        append_stats(nullptr,
+                     0,
+                     json_str.c_str(),
+                     gsl::narrow<uint32_t>(json_str.size()),
+                     &cookie);
+        return ENGINE_SUCCESS;
+    }
+    return ENGINE_EINVAL;
+}
+
+/**
+ * Summarise the histogram of the commands with the given opcode completed
+ * in the bucket's last one second interval (in microseconds).
+ */
+static nlohmann::json get_interval_timings(Timings& timings, uint8_t opcode) {
+    const auto histogram = timings.get_interval_histogram(opcode);
+    nlohmann::json json;
+    json["interval"] = timings.get_interval_sequence();
+    json["count"] = histogram.getValueCount();
+    if (histogram.getValueCount() != 0) {
+        json["p50"] = histogram.getValueAtPercentile(50.0);
+        json["p90"] = histogram.getValueAtPercentile(90.0);
+        json["p99"] = histogram.getValueAtPercentile(99.0);
+        json["p99.9"] = histogram.getValueAtPercentile(99.9);
+        json["max"] = histogram.getMaxValue();
+    }
+    return json;
+}
+
+/**
+ * Handler for the <code>stats interval_timings [opcode]</code> command used
+ * to retrieve the percentiles of the commands completed in the connected
+ * bucket's last one second interval, so that mctimings --interval can
+ * stream them without fetching (and diffing) the full histograms.
+ *
+ * With no argument one stat is returned per opcode with commands in the
+ * interval (keyed by the opcode's name); with the name of an opcode just
+ * that opcode is returned. Each includes the sequence number of the
+ * interval so that a client polling it can skip intervals already seen.
+ *
+ * @param arg - empty, or the opcode to get
+ * @param cookie the command context
+ */
+static ENGINE_ERROR_CODE stat_interval_timings_executor(const std::string& arg,
+                                                       Cookie& cookie) {
+    auto& bucket = all_buckets[cookie.getConnection().getBucketIndex()];
+
+    if (arg.empty()) {
+        for (int ii = 0; ii < MAX_NUM_OPCODES; ++ii) {
+            const auto json = get_interval_timings(bucket.timings, uint8_t(ii));
+            if (json["count"].get<uint64_t>() == 0) {
+                continue;
+            }
+            const auto opcode = cb::mcbp::ClientOpcode(ii);
+            std::string key;
+            try {
+                key = to_string(opcode);
+            } catch (const std::exception&) {
+                key = cb::to_hex(uint8_t(ii));
+            }
+            const auto value = json.dump();
+            append_stats(key.data(),
+                         gsl::narrow<uint16_t>(key.size()),
+                         value.data(),
+                         gsl::narrow<uint32_t>(value.size()),
+                         &cookie);
+        }
+        return ENGINE_SUCCESS;
+    }
+
+    cb::mcbp::ClientOpcode opcode;
+    try {
+        opcode = to_opcode(arg);
+    } catch (const std::invalid_argument&) {
+        return ENGINE_EINVAL;
+    }
+
+    const auto json_str =
+            get_interval_timings(bucket.timings, uint8_t(opcode)).dump();
+    append_stats(nullptr,
+                 0,
+                 json_str.c_str(),
+                 gsl::narrow<uint32_t>(json_str.size()),
+                 &cookie);
+    return ENGINE_SUCCESS;
+}
+
+/**
+ * Add the connected bucket's front-end metrics (and those of the server)
+ * to the collector.
+ */
+static void add_server_metrics(Cookie& cookie, PrometheusRenderer& renderer) {
+    renderer.addGauge("curr_connections",
+                      "The number of connections",
+                      {},
+                      stats.curr_conns.load(std::memory_order_relaxed));
+    renderer.addCounter("total_connections",
+                        "The number of connections accepted",
+                        {},
+                        stats.total_conns);
+    renderer.addGauge("uptime_seconds",
+                      "The time since the server started",
+                      {},
+                      mc_time_get_current_time());
+
+    auto& bucket = cookie.getConnection().getBucket();
+    if (bucket.type == Bucket::Type::NoBucket) {
+        return;
+    }
+    renderer.setConstantLabels({{"bucket", bucket.name}});
+
+    struct thread_stats thread_stats;
+    thread_stats.aggregate(bucket.stats);
+    renderer.addCounter("cmd_get",
+                        "The number of documents read",
+                        {},
+                        thread_stats.cmd_get);
+    renderer.addCounter("cmd_set",
+                        "The number of documents stored",
+                        {},
+                        thread_stats.cmd_set);
+    renderer.addCounter("get_hits",
+                        "The number of reads which found the document",
+                        {},
+                        thread_stats.get_hits);
+    renderer.addCounter("get_misses",
+                        "The number of reads which didn't find the document",
+                        {},
+                        thread_stats.get_misses);
+
+    for (int ii = 0; ii < MAX_NUM_OPCODES; ++ii) {
+        const auto* histogram = bucket.timings.get_timing_histogram(ii);
+        if (histogram == nullptr || histogram->getValueCount() == 0) {
+            continue;
+        }
+        std::string opcode;
+        try {
+            opcode = to_string(cb::mcbp::ClientOpcode(ii));
+        } catch (const std::exception&) {
+            opcode = cb::to_hex(uint8_t(ii));
+        }
+        renderer.addHistogram("cmd_duration_microseconds",
+                              "The time taken to execute the commands",
+                              {{"opcode", opcode}},
+                              histogram->getMetricsData());
+    }
+}
+
+/**
+ * Handler for the <code>stats prometheus [high]</code> command used to
+ * retrieve the metrics of the connected bucket (and the server) in the
+ * Prometheus text exposition format, as a single stat. The metrics are
+ * collected as typed values (see cb::metrics::Collector) and rendered
+ * directly, rather than built as strings by the stats groups and parsed
+ * by the exporter.
+ *
+ * By default just the metrics which are per bucket (or per vbucket state)
+ * are included; "high" also includes those per scope and collection. The
+ * number of series is capped (PrometheusRenderer::DefaultMaxSeries).
+ *
+ * @param arg - empty or "high"
+ * @param cookie the command context
+ */
+static ENGINE_ERROR_CODE stat_prometheus_executor(const std::string& arg,
+                                                  Cookie& cookie) {
+    cb::metrics::Cardinality cardinality;
+    if (arg.empty()) {
+        cardinality = cb::metrics::Cardinality::Low;
+    } else if (arg == "high") {
+        cardinality = cb::metrics::Cardinality::High;
+    } else {
+        return ENGINE_EINVAL;
+    }
+
+    PrometheusRenderer renderer(cardinality);
+    add_server_metrics(cookie, renderer);
+    if (cookie.getConnection().getBucket().type != Bucket::Type::NoBucket) {
+        const auto ret = bucket_get_metrics(cookie, renderer);
+        if (ret != ENGINE_SUCCESS && ret != ENGINE_ENOTSUP) {
+            return ret;
+        }
+    }
+
+    const auto text = renderer.finish();
+    append_stats(nullptr,
+                 0,
+                 text.data(),
+                 gsl::narrow<uint32_t>(text.size()),
+                 &cookie);
+    return ENGINE_SUCCESS;
+}
+
+/**
+ * Handler for the <code>stats keyed_timings</code> command used to retrieve
+ * the per vbucket and per collection histograms of the GET, SET and DELETE
+ * commands of the connected bucket (see KeyedTimings).
+ *
+ * With no argument all of the histograms are returned (keyed by
+ * "vb_&lt;vbid&gt;:&lt;operation&gt;" and
+ * "collection_&lt;cid&gt;:&lt;operation&gt;"). With an argument of
+ * <code>vbucket &lt;vbid&gt; &lt;operation&gt;</code> or
+ * <code>collection &lt;cid&gt; &lt;operation&gt;</code> (where the
+ * collection id is in hex) just that histogram is returned, so that it can
+ * be displayed by mctimings.
+ *
+ * @param arg - empty, or the histogram to get
+ * @param cookie the command context
+ */
+static ENGINE_ERROR_CODE stat_keyed_timings_executor(const std::string& arg,
+                                                     Cookie& cookie) {
+    auto& bucket = all_buckets[cookie.getConnection().getBucketIndex()];
+    auto& timings = bucket.timings.get_keyed_timings();
+
+    if (arg.empty()) {
+        const auto json = timings.to_json();
+        for (auto it = json.begin(); it != json.end(); ++it) {
+            const auto value = it.value().dump();
+            append_stats(it.key().data(),
+                         gsl::narrow<uint16_t>(it.key().size()),
+                         value.data(),
+                         gsl::narrow<uint32_t>(value.size()),
+                         &cookie);
+        }
+        return ENGINE_SUCCESS;
+    }
+
+    std::istringstream stream(arg);
+    std::string type;
+    std::string id;
+    std::string name;
+    stream >> type >> id >> name;
+    const auto operation = KeyedTimings::getOperation(name);
+    if (!operation || !stream.eof()) {
+        return ENGINE_EINVAL;
+    }
+
+    std::string json_str;
+    try {
+        if (type == "vbucket") {
+            json_str = timings.generate(
+                    *operation, Vbid(gsl::narrow<uint16_t>(std::stoul(id))));
+        } else if (type == "collection") {
+            json_str = timings.generate(*operation,
+                                        CollectionID(gsl::narrow<uint32_t>(
+                                                std::stoul(id, nullptr, 16))));
+        } else {
+            return ENGINE_EINVAL;
+        }
+    } catch (const std::exception&) {
+        return ENGINE_EINVAL;
+    }
+
+    append_stats(nullptr,
+                 0,
+                 json_str.c_str(),
+                 gsl::narrow<uint32_t>(json_str.size()),
+                 &cookie);
+    return ENGINE_SUCCESS;
+}
+
+/**
+ * Handler for the <code>stats request_samples</code> command used to
+ * retrieve the recent requests sampled by each front-end thread (see
+ * RequestSampler), as a JSON array per thread.
+ *
+ * @param arg - should be empty
+ * @param cookie the command context
+ */
+static ENGINE_ERROR_CODE stat_request_samples_executor(const std::string& arg,
+                                                       Cookie& cookie) {
+    if (!arg.empty()) {
+        return ENGINE_EINVAL;
+    }
+
+    for (size_t ii = 0; ii < settings.getNumWorkerThreads(); ++ii) {
+        auto samples = nlohmann::json::array();
+        for (const auto& sample :
+             get_front_end_thread(ii).request_sampler.getSamples()) {
+            samples.push_back(sample.to_json());
+        }
+        const auto key = std::to_string(ii);
+        const auto json_str = samples.dump();
+        append_stats(key.data(),
+                     gsl::narrow<uint16_t>(key.size()),
+                     json_str.data(),
+                     gsl::narrow<uint32_t>(json_str.size()),
+                     &cookie);
+    }
+    return ENGINE_SUCCESS;
+}
+
 static ENGINE_ERROR_CODE stat_responses_json_executor(const std::string& arg,
                                                       Cookie& cookie) {
     try {
-        auto& respCounters =
-                cookie.getConnection().getBucket().responseCounters;
+        const auto respCounters =
+                cookie.getConnection().getBucket().getResponseCounters();
         nlohmann::json json;
 
         for (uint16_t resp = 0; resp < respCounters.size(); ++resp) {
-            const auto value = respCounters[resp].load();
+            const auto value = respCounters[resp];
             if (value > 0) {
                 std::stringstream stream;
                 stream << std::hex << resp;
@@ -739,6 +1238,14 @@ static std::unordered_map<std::string, struct command_stat_handler>
                 {"topkeys", {false, stat_topkeys_executor}},
                 {"topkeys_json", {false, stat_topkeys_json_executor}},
                 {"subdoc_execute", {false, stat_subdoc_execute_executor}},
+                {"throttle_wait", {false, stat_throttle_wait_executor}},
+                {"executor_timings", {false, stat_executor_timings_executor}},
+                {"span_timings", {false, stat_span_timings_executor}},
+                {"interval_timings",
+                 {false, stat_interval_timings_executor}},
+                {"prometheus", {true, stat_prometheus_executor}},
+                {"keyed_timings", {false, stat_keyed_timings_executor}},
+                {"request_samples", {true, stat_request_samples_executor}},
                 {"responses", {false, stat_responses_json_executor}},
                 {"tracing", {true, stat_tracing_executor}}};
 
@@ -788,6 +1295,20 @@ ENGINE_ERROR_CODE StatsCommandContext::step() {
 }
 
 ENGINE_ERROR_CODE StatsCommandContext::parseCommandKey() {
+    // "delta <group>" polls the group, but only sends the stats which are
+    // new or changed since the connection's previous poll of the group.
+    {
+        const std::string statkey{reinterpret_cast<const char*>(key.data()),
+                                  key.size()};
+        if (statkey == "delta" || statkey.compare(0, 6, "delta ") == 0) {
+            const auto skip = std::min(key.size(), size_t(6));
+            key = {key.data() + skip, key.size() - skip};
+            delta = &connection.getStatsDeltaCache().beginPoll(
+                    statkey.substr(skip));
+            cookie.setStatsDelta(delta);
+        }
+    }
+
     if (key.empty()) {
         command = "";
     } else {
@@ -867,11 +1388,13 @@ ENGINE_ERROR_CODE StatsCommandContext::getTaskResult() {
 ENGINE_ERROR_CODE StatsCommandContext::commandComplete() {
     switch (command_exit_code) {
     case ENGINE_SUCCESS:
+        if (delta) {
+            delta->endPoll();
+        }
         append_stats(nullptr, 0, nullptr, 0, static_cast<void*>(&cookie));
 
         // We just want to record this once rather than for each packet sent
-        ++connection.getBucket()
-                  .responseCounters[int(cb::mcbp::Status::Success)];
+        connection.countResponse(cb::mcbp::Status::Success);
         cookie.sendDynamicBuffer();
         break;
     case ENGINE_EWOULDBLOCK:
@@ -884,8 +1407,8 @@ ENGINE_ERROR_CODE StatsCommandContext::commandComplete() {
         // stats for these.
         break;
     default:
-        ++connection.getBucket().responseCounters[int(
-                cb::mcbp::to_status(cb::engine_errc(command_exit_code)))];
+        connection.countResponse(
+                cb::mcbp::to_status(cb::engine_errc(command_exit_code)));
         break;
     }
     state = State::Done;
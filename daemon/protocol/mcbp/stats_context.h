@@ -81,7 +81,7 @@ private:
     /**
      * The key as specified in the input buffer (it may contain a sub command)
      */
-    const cb::const_byte_buffer key;
+    cb::const_byte_buffer key;
     std::string command;
     std::string argument;
     State state;
@@ -90,5 +90,11 @@ private:
      */
     ENGINE_ERROR_CODE command_exit_code;
 
+    /**
+     * The snapshot of the group if only the stats which changed since the
+     * connection's previous poll are to be sent ("stats delta <group>")
+     */
+    StatsDeltaSnapshot* delta = nullptr;
+
     std::shared_ptr<Task> task;
 };
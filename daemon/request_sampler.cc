@@ -0,0 +1,128 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "request_sampler.h"
+
+#include "connection.h"
+#include "cookie.h"
+
+#include <nlohmann/json.hpp>
+#include <platform/sized_buffer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+
+nlohmann::json RequestSample::to_json() const {
+    nlohmann::json ret;
+    ret["timestamp"] = timestamp;
+    ret["opcode"] = ::to_string(opcode);
+    ret["bucket"] = bucket;
+    ret["vbucket"] = vbucket.get();
+    ret["key_hash"] = key_hash;
+    auto array = nlohmann::json::array();
+    for (size_t ii = 0; ii < num_spans; ++ii) {
+        nlohmann::json span;
+        span["name"] = ::to_string(spans[ii].code);
+        span["start"] = spans[ii].start;
+        span["duration"] = spans[ii].duration;
+        array.push_back(span);
+    }
+    ret["spans"] = array;
+    return ret;
+}
+
+RequestSampleRing::RequestSampleRing(size_t capacity)
+    : capacity(capacity), slots(new Slot[capacity]) {
+}
+
+void RequestSampleRing::push(const RequestSample& sample) {
+    const auto index = next.load(std::memory_order_relaxed);
+    auto& slot = slots[index % capacity];
+    const auto sequence = slot.sequence.load(std::memory_order_relaxed);
+
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.sample = sample;
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    next.store(index + 1, std::memory_order_release);
+}
+
+std::vector<RequestSample> RequestSampleRing::snapshot() const {
+    const auto end = next.load(std::memory_order_acquire);
+    const auto begin = end > capacity ? end - capacity : 0;
+
+    std::vector<RequestSample> ret;
+    ret.reserve(end - begin);
+    for (auto index = begin; index < end; ++index) {
+        const auto& slot = slots[index % capacity];
+        const auto before = slot.sequence.load(std::memory_order_acquire);
+        RequestSample sample = slot.sample;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const auto after = slot.sequence.load(std::memory_order_relaxed);
+        // Skip the slot if the writer was busy with it (it has then been
+        // (or is being) overwritten by a newer sample which we'll miss, but
+        // the ring is only a sample anyway).
+        if (before == after && (before & 1) == 0 && before != 0) {
+            ret.push_back(sample);
+        }
+    }
+    return ret;
+}
+
+void RequestSampler::record(const Cookie& cookie) {
+    const auto& request = cookie.getHeader().getRequest();
+    const auto& connection = cookie.getConnection();
+    const auto& spans = cookie.getTracer().getDurations();
+    const auto start = cookie.getStart();
+
+    RequestSample sample{};
+    const auto age = std::chrono::steady_clock::now() - start;
+    sample.timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+                               (std::chrono::system_clock::now() - age)
+                                       .time_since_epoch())
+                               .count();
+    try {
+        const auto& full = cookie.getRequest(Cookie::PacketContent::Full);
+        const auto key = full.getKey();
+        sample.key_hash = std::hash<cb::const_char_buffer>()(
+                {reinterpret_cast<const char*>(key.data()), key.size()});
+    } catch (const std::logic_error&) {
+        // The body (and its key) isn't available as the request was
+        // rejected based on its header alone.
+    }
+    sample.opcode = request.getClientOpcode();
+    sample.bucket = uint16_t(connection.getBucketIndex());
+    sample.vbucket = request.getVBucket();
+
+    const auto count = std::min(spans.size(), size_t(RequestSample::MaxSpans));
+    for (size_t ii = 0; ii < count; ++ii) {
+        const auto& span = spans[ii];
+        sample.spans[ii].code = span.code;
+        sample.spans[ii].start = uint32_t(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                        span.start - start)
+                        .count());
+        sample.spans[ii].duration = span.duration == span.duration.max()
+                                            ? -1
+                                            : span.duration.count();
+    }
+    sample.num_spans = uint8_t(count);
+
+    ring.push(sample);
+}
@@ -0,0 +1,148 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <mcbp/protocol/opcode.h>
+#include <memcached/vbucket.h>
+#include <nlohmann/json_fwd.hpp>
+#include <tracing/tracetypes.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class Cookie;
+
+/**
+ * A request sampled by a RequestSampler: what it was, and where the time
+ * went while executing it (the spans of its Tracer).
+ *
+ * Deliberately trivially copyable (and of fixed size) so it may be copied
+ * in and out of the ring without locking or allocating.
+ */
+struct RequestSample {
+    struct Span {
+        cb::tracing::TraceCode code;
+        /// Start of the span, relative to the start of the request
+        uint32_t start;
+        /// Duration in microseconds (-1 if the span never ended)
+        int32_t duration;
+    };
+
+    /// The most spans kept for a single request; any more are dropped
+    static const size_t MaxSpans = 16;
+
+    /// When the request was received, in microseconds since the epoch
+    uint64_t timestamp;
+    /// std::hash of the key (the key itself may be user data)
+    uint64_t key_hash;
+    cb::mcbp::ClientOpcode opcode;
+    uint16_t bucket;
+    Vbid vbucket;
+    uint8_t num_spans;
+    std::array<Span, MaxSpans> spans;
+
+    nlohmann::json to_json() const;
+};
+
+/**
+ * A fixed size ring of the most recent RequestSamples recorded by a single
+ * thread, which may be read from any other thread without blocking the
+ * writer.
+ *
+ * Each slot is guarded by a sequence number (a "seqlock"): the writer makes
+ * it odd while it overwrites the slot and even again once it's done, and a
+ * reader discards any copy of a slot whose sequence number was odd or
+ * changed while it was copying it.
+ */
+class RequestSampleRing {
+public:
+    explicit RequestSampleRing(size_t capacity);
+
+    size_t getCapacity() const {
+        return capacity;
+    }
+
+    /// Record a sample. Must only be called by the thread owning the ring.
+    void push(const RequestSample& sample);
+
+    /// @return the samples currently in the ring, oldest first
+    std::vector<RequestSample> snapshot() const;
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};
+        RequestSample sample;
+    };
+
+    const size_t capacity;
+    std::unique_ptr<Slot[]> slots;
+    /// The number of samples pushed so far (the next one goes in
+    /// next % capacity)
+    std::atomic<uint64_t> next{0};
+};
+
+/**
+ * Always-on, low overhead sampling of the requests executed by a front-end
+ * thread.
+ *
+ * One in every request_sample_interval requests executed by the thread is
+ * picked when its header is read: its cookie records the spans of its
+ * Tracer (as if the client had enabled tracing, but without changing the
+ * response), and once it completes the sample is kept in the thread's ring
+ * of recent samples. Reported by "stats request_samples" and by mctrace.
+ */
+class RequestSampler {
+public:
+    /// The number of samples kept per thread
+    static const size_t Capacity = 256;
+
+    RequestSampler() : ring(Capacity) {
+    }
+
+    /**
+     * Count a request, and decide if it should be sampled.
+     *
+     * @param interval sample one in this many requests; 0 disables sampling
+     */
+    bool shouldSample(size_t interval) {
+        if (interval == 0) {
+            return false;
+        }
+        if (++requests < interval) {
+            return false;
+        }
+        requests = 0;
+        return true;
+    }
+
+    /// Record the (completed) request of a sampled cookie
+    void record(const Cookie& cookie);
+
+    std::vector<RequestSample> getSamples() const {
+        return ring.snapshot();
+    }
+
+private:
+    /// Requests since the last sample; only used by the owning thread
+    size_t requests = 0;
+    RequestSampleRing ring;
+};
@@ -49,6 +49,10 @@ public:
 
     void notifyExecutionComplete() override;
 
+    Class getClass() const override {
+        return Class::Auth;
+    }
+
     cb::sasl::Error getError() const {
         return response.first;
     }
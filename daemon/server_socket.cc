@@ -18,6 +18,7 @@
 #include "server_socket.h"
 
 #include "connections.h"
+#include "front_end_thread.h"
 #include "listening_port.h"
 #include "memcached.h"
 #include "network_interface.h"
@@ -37,7 +38,8 @@
 
 ServerSocket::ServerSocket(SOCKET fd,
                            event_base* b,
-                           std::shared_ptr<ListeningPort> interf)
+                           std::shared_ptr<ListeningPort> interf,
+                           FrontEndThread* thr)
     : sfd(fd),
       interface(interf),
       sockname(cb::net::getsockname(fd)),
@@ -45,7 +47,8 @@ ServerSocket::ServerSocket(SOCKET fd,
                    sfd,
                    EV_READ | EV_PERSIST,
                    listen_event_handler,
-                   reinterpret_cast<void*>(this))) {
+                   reinterpret_cast<void*>(this))),
+      thread(thr) {
     if (!ev) {
         throw std::bad_alloc();
     }
@@ -54,29 +57,41 @@ ServerSocket::ServerSocket(SOCKET fd,
 }
 
 ServerSocket::~ServerSocket() {
-    std::string tagstr;
-    if (!interface->tag.empty()) {
-        tagstr = " \"" + interface->tag + "\"";
-    }
-    LOG_INFO("Shutting down IPv{} interface{}: {}",
-             interface->family == AF_INET ? "4" : "6",
-             tagstr,
-             sockname);
-    disable();
-    safe_close(sfd);
-}
+    // Close the front-end threads' sockets first
+    perThread.clear();
 
-void ServerSocket::enable() {
-    if (!registered_in_libevent) {
+    if (thread == nullptr) {
         std::string tagstr;
         if (!interface->tag.empty()) {
             tagstr = " \"" + interface->tag + "\"";
         }
-        LOG_INFO("{} Listen on IPv{}{}: {}",
-                 sfd,
+        LOG_INFO("Shutting down IPv{} interface{}: {}",
                  interface->family == AF_INET ? "4" : "6",
                  tagstr,
                  sockname);
+    }
+    disable();
+    safe_close(sfd);
+}
+
+void ServerSocket::enable() {
+    for (auto& socket : perThread) {
+        socket->enable();
+    }
+
+    if (!registered_in_libevent) {
+        if (thread == nullptr) {
+            std::string tagstr;
+            if (!interface->tag.empty()) {
+                tagstr = " \"" + interface->tag + "\"";
+            }
+            LOG_INFO("{} Listen on IPv{}{}: {}{}",
+                     sfd,
+                     interface->family == AF_INET ? "4" : "6",
+                     tagstr,
+                     sockname,
+                     perThread.empty() ? "" : " (per-thread)");
+        }
         if (cb::net::listen(sfd, backlog) == SOCKET_ERROR) {
             LOG_WARNING("{}: Failed to listen on {}: {}",
                         sfd,
@@ -94,6 +109,10 @@ void ServerSocket::enable() {
 }
 
 void ServerSocket::disable() {
+    for (auto& socket : perThread) {
+        socket->disable();
+    }
+
     if (registered_in_libevent) {
         if (sfd != INVALID_SOCKET) {
             /*
@@ -119,6 +138,9 @@ void ServerSocket::disable() {
 }
 
 void ServerSocket::acceptNewClient() {
+    // A front-end thread's socket may have its interface updated by the
+    // dispatcher (see updateSSL)
+    auto port = std::atomic_load(&interface);
     sockaddr_storage addr{};
     socklen_t addrlen = sizeof(addr);
     auto client = cb::net::accept(
@@ -135,7 +157,12 @@ void ServerSocket::acceptNewClient() {
             LOG_WARNING("Too many open files. Current limit: {}",
                         limit.rlim_cur);
 #endif
-            disable_listen();
+            if (thread == nullptr) {
+                disable_listen();
+            } else {
+                // The listen sockets are managed by the dispatcher
+                request_disable_listen();
+            }
         } else if (!cb::net::is_blocking(error)) {
             LOG_WARNING("Failed to accept new client: {}", cb_strerror(error));
         }
@@ -149,7 +176,7 @@ void ServerSocket::acceptNewClient() {
     size_t current;
     size_t limit;
 
-    if (interface->system) {
+    if (port->system) {
         ++stats.system_conns;
         current = stats.getSystemConnections();
         limit = settings.getSystemConnections();
@@ -161,17 +188,17 @@ void ServerSocket::acceptNewClient() {
     LOG_DEBUG("Accepting client {} of {}{}",
               current,
               limit,
-              interface->system ? " on system port" : "");
+              port->system ? " on system port" : "");
     if (current > limit) {
         stats.rejected_conns++;
         LOG_WARNING(
                 "Shutting down client as we're running "
                 "out of connections{}: {} of {}",
-                interface->system ? " on system interface" : "",
+                port->system ? " on system interface" : "",
                 current,
                 limit);
         safe_close(client);
-        if (interface->system) {
+        if (port->system) {
             --stats.system_conns;
         }
         return;
@@ -183,7 +210,21 @@ void ServerSocket::acceptNewClient() {
         return;
     }
 
-    dispatch_conn_new(client, interface);
+    dispatch_conn_new(client, port, thread);
+}
+
+void ServerSocket::rejectNewClient() {
+    auto client = cb::net::accept(sfd, nullptr, nullptr);
+    if (client != INVALID_SOCKET) {
+        // Balance the decrement in safe_close
+        stats.curr_conns.fetch_add(1, std::memory_order_relaxed);
+        safe_close(client);
+    }
+}
+
+void ServerSocket::addPerThreadSocket(SOCKET fd, FrontEndThread& thr) {
+    perThread.emplace_back(
+            std::make_unique<ServerSocket>(fd, thr.base, interface, &thr));
 }
 
 nlohmann::json ServerSocket::toJson() const {
@@ -232,4 +273,7 @@ void ServerSocket::updateSSL(const std::string& key, const std::string& cert) {
                                                 interface->system,
                                                 key,
                                                 cert);
+    for (auto& socket : perThread) {
+        std::atomic_store(&socket->interface, interface);
+    }
 }
@@ -20,12 +20,20 @@
 
 #include <nlohmann/json_fwd.hpp>
 #include <memory>
+#include <vector>
 
 class ListeningPort;
 class NetworkInterface;
+struct FrontEndThread;
 
 /**
  * The ServerSocket represents the socket used to accept new clients.
+ *
+ * In per_thread_listeners mode each ServerSocket owned by the dispatcher
+ * also owns one socket per front-end thread, all bound to the same address
+ * with SO_REUSEPORT. The kernel spreads incoming connections over them, and
+ * a front-end thread serves the clients it accepts itself - there's no
+ * handoff via the dispatcher.
  */
 class ServerSocket {
 public:
@@ -38,10 +46,13 @@ public:
      * @param sfd The socket to operate on
      * @param b The event base to use (the caller owns the event base)
      * @param interf The interface object containing properties to use
+     * @param thr The front-end thread accepting (and serving) clients from
+     *            this socket, or nullptr for the dispatcher
      */
     ServerSocket(SOCKET sfd,
                  event_base* b,
-                 std::shared_ptr<ListeningPort> interf);
+                 std::shared_ptr<ListeningPort> interf,
+                 FrontEndThread* thr = nullptr);
 
     ~ServerSocket();
 
@@ -58,6 +69,21 @@ public:
 
     void acceptNewClient();
 
+    /// Accept and immediately close a new client (used during shutdown)
+    void rejectNewClient();
+
+    /// Is this one of a front-end thread's own sockets?
+    bool isPerThread() const {
+        return thread != nullptr;
+    }
+
+    /**
+     * Add a socket bound (with SO_REUSEPORT) to the same address as this
+     * one, from which the given front-end thread accepts clients itself.
+     * It is enabled, disabled and updated along with this one.
+     */
+    void addPerThreadSocket(SOCKET fd, FrontEndThread& thr);
+
     const ListeningPort& getInterfaceDescription() const {
         return *interface;
     }
@@ -92,4 +118,10 @@ protected:
 
     /// The libevent object we're using
     std::unique_ptr<struct event, EventDeleter> ev;
+
+    /// The front-end thread owning this socket (nullptr for the dispatcher)
+    FrontEndThread* const thread;
+
+    /// The front-end threads' own sockets for the same address (if any)
+    std::vector<std::unique_ptr<ServerSocket>> perThread;
 };
@@ -27,6 +27,7 @@
 #include <gsl/gsl>
 #include <system_error>
 
+#include "bucket_throttle.h"
 #include "log_macros.h"
 #include "opentracing_config.h"
 #include "settings.h"
@@ -188,6 +189,11 @@ static void handle_topkeys_enabled(Settings& s, const nlohmann::json& obj) {
     s.setTopkeysEnabled(obj.get<bool>());
 }
 
+static void handle_keyed_timings_enabled(Settings& s,
+                                         const nlohmann::json& obj) {
+    s.setKeyedTimingsEnabled(obj.get<bool>());
+}
+
 static void handle_scramsha_fallback_salt(Settings& s,
                                           const nlohmann::json& obj) {
     // Try to base64 decode it to validate that it is a legal value..
@@ -231,6 +237,44 @@ static void handle_tracing_enabled(Settings& s, const nlohmann::json& obj) {
     s.setTracingEnabled(obj.get<bool>());
 }
 
+/**
+ * Handle the "connection_rebalance" tag in the settings
+ *
+ *  The value must be a boolean value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_connection_rebalance(Settings& s,
+                                        const nlohmann::json& obj) {
+    s.setConnectionRebalanceEnabled(obj.get<bool>());
+}
+
+/**
+ * Handle the "per_thread_listeners" tag in the settings
+ *
+ *  The value must be a boolean value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_per_thread_listeners(Settings& s,
+                                        const nlohmann::json& obj) {
+    s.setPerThreadListenersEnabled(obj.get<bool>());
+}
+
+/**
+ * Handle the "numa_affinity" tag in the settings
+ *
+ *  The value must be a boolean value
+ *
+ * @param s the settings object to update
+ * @param obj the object in the configuration
+ */
+static void handle_numa_affinity(Settings& s, const nlohmann::json& obj) {
+    s.setNumaAffinityEnabled(obj.get<bool>());
+}
+
 /**
  * Handle the "stdin_listener" tag in the settings
  *
@@ -448,6 +492,32 @@ static void handle_system_connections(Settings& s, const nlohmann::json& obj) {
     s.setSystemConnections(obj.get<size_t>());
 }
 
+static void handle_max_unordered_commands(Settings& s,
+                                          const nlohmann::json& obj) {
+    if (!obj.is_number_unsigned()) {
+        cb::throwJsonTypeError(
+                R"("max_unordered_commands" must be a positive number)");
+    }
+    s.setMaxUnorderedCommands(obj.get<size_t>());
+}
+
+static void handle_sasl_auth_threads(Settings& s, const nlohmann::json& obj) {
+    if (!obj.is_number_unsigned()) {
+        cb::throwJsonTypeError(
+                R"("sasl_auth_threads" must be a positive number)");
+    }
+    s.setSaslAuthThreads(obj.get<size_t>());
+}
+
+static void handle_request_sample_interval(Settings& s,
+                                           const nlohmann::json& obj) {
+    if (!obj.is_number_unsigned()) {
+        cb::throwJsonTypeError(
+                R"("request_sample_interval" must be a positive number)");
+    }
+    s.setRequestSampleInterval(obj.get<size_t>());
+}
+
 /**
  * Handle the "sasl_mechanisms" tag in the settings
  *
@@ -530,6 +600,13 @@ static void handle_opcode_attributes_override(Settings& s,
     s.setOpcodeAttributesOverride(obj.dump());
 }
 
+static void handle_bucket_throttle(Settings& s, const nlohmann::json& obj) {
+    if (!obj.is_object()) {
+        cb::throwJsonTypeError(R"("bucket_throttle" must be an object)");
+    }
+    s.setBucketThrottle(obj.dump());
+}
+
 static void handle_extensions(Settings& s, const nlohmann::json& obj) {
     LOG_INFO("Extensions ignored");
 }
@@ -628,16 +705,24 @@ void Settings::reconfigure(const nlohmann::json& json) {
             {"max_packet_size", handle_max_packet_size},
             {"max_connections", handle_max_connections},
             {"system_connections", handle_system_connections},
+            {"max_unordered_commands", handle_max_unordered_commands},
+            {"sasl_auth_threads", handle_sasl_auth_threads},
+            {"request_sample_interval", handle_request_sample_interval},
             {"sasl_mechanisms", handle_sasl_mechanisms},
             {"ssl_sasl_mechanisms", handle_ssl_sasl_mechanisms},
             {"stdin_listener", handle_stdin_listener},
+            {"per_thread_listeners", handle_per_thread_listeners},
+            {"numa_affinity", handle_numa_affinity},
             {"dedupe_nmvb_maps", handle_dedupe_nmvb_maps},
             {"xattr_enabled", handle_xattr_enabled},
             {"client_cert_auth", handle_client_cert_auth},
             {"collections_enabled", handle_collections_enabled},
             {"opcode_attributes_override", handle_opcode_attributes_override},
+            {"bucket_throttle", handle_bucket_throttle},
             {"topkeys_enabled", handle_topkeys_enabled},
+            {"keyed_timings_enabled", handle_keyed_timings_enabled},
             {"tracing_enabled", handle_tracing_enabled},
+            {"connection_rebalance", handle_connection_rebalance},
             {"scramsha_fallback_salt", handle_scramsha_fallback_salt},
             {"external_auth_service", handle_external_auth_service},
             {"active_external_users_push_interval",
@@ -671,6 +756,24 @@ void Settings::setOpcodeAttributesOverride(const std::string& value) {
     notify_changed("opcode_attributes_override");
 }
 
+void Settings::setBucketThrottle(const std::string& value) {
+    if (!value.empty()) {
+        // Verify the limits of every bucket listed
+        const auto json = nlohmann::json::parse(value);
+        if (!json.is_object()) {
+            throw std::invalid_argument(
+                    R"("bucket_throttle" must be an object)");
+        }
+        for (auto it = json.begin(); it != json.end(); ++it) {
+            BucketThrottle::lookup(json, it.key());
+        }
+    }
+
+    bucket_throttle.wlock()->assign(value);
+    has.bucket_throttle = true;
+    notify_changed("bucket_throttle");
+}
+
 void Settings::updateSettings(const Settings& other, bool apply) {
     if (other.has.rbac_file) {
         if (other.rbac_file != rbac_file) {
@@ -719,6 +822,27 @@ void Settings::updateSettings(const Settings& other, bool apply) {
         }
     }
 
+    if (other.has.sasl_auth_threads) {
+        if (other.sasl_auth_threads != sasl_auth_threads) {
+            throw std::invalid_argument(
+                    "sasl_auth_threads can't be changed dynamically");
+        }
+    }
+
+    if (other.has.per_thread_listeners) {
+        if (other.per_thread_listeners.load() != per_thread_listeners.load()) {
+            throw std::invalid_argument(
+                    "per_thread_listeners can't be changed dynamically");
+        }
+    }
+
+    if (other.has.numa_affinity) {
+        if (other.numa_affinity.load() != numa_affinity.load()) {
+            throw std::invalid_argument(
+                    "numa_affinity can't be changed dynamically");
+        }
+    }
+
     if (other.has.logger) {
         if (other.logger_settings != logger_settings)
             throw std::invalid_argument(
@@ -884,6 +1008,24 @@ void Settings::updateSettings(const Settings& other, bool apply) {
         }
     }
 
+    if (other.has.max_unordered_commands) {
+        if (other.max_unordered_commands != max_unordered_commands) {
+            LOG_INFO(R"(Change max unordered commands from {} to {})",
+                     max_unordered_commands,
+                     other.max_unordered_commands);
+            setMaxUnorderedCommands(other.max_unordered_commands);
+        }
+    }
+
+    if (other.has.request_sample_interval) {
+        if (other.request_sample_interval != request_sample_interval) {
+            LOG_INFO(R"(Change request sample interval from {} to {})",
+                     request_sample_interval,
+                     other.request_sample_interval);
+            setRequestSampleInterval(other.request_sample_interval);
+        }
+    }
+
     if (other.has.xattr_enabled) {
         if (other.xattr_enabled != xattr_enabled) {
             LOG_INFO("{} XATTR",
@@ -979,6 +1121,18 @@ void Settings::updateSettings(const Settings& other, bool apply) {
         }
     }
 
+    if (other.has.bucket_throttle) {
+        auto current = getBucketThrottle();
+        auto proposed = other.getBucketThrottle();
+
+        if (proposed != current) {
+            LOG_INFO(R"(Change bucket throttle from "{}" to "{}")",
+                     current,
+                     proposed);
+            setBucketThrottle(proposed);
+        }
+    }
+
     if (other.has.topkeys_enabled) {
         if (other.isTopkeysEnabled() != isTopkeysEnabled()) {
             LOG_INFO("{} topkeys support",
@@ -987,6 +1141,14 @@ void Settings::updateSettings(const Settings& other, bool apply) {
         setTopkeysEnabled(other.isTopkeysEnabled());
     }
 
+    if (other.has.keyed_timings_enabled) {
+        if (other.isKeyedTimingsEnabled() != isKeyedTimingsEnabled()) {
+            LOG_INFO("{} keyed timings",
+                     other.isKeyedTimingsEnabled() ? "Enable" : "Disable");
+        }
+        setKeyedTimingsEnabled(other.isKeyedTimingsEnabled());
+    }
+
     if (other.has.tracing_enabled) {
         if (other.isTracingEnabled() != isTracingEnabled()) {
             LOG_INFO("{} tracing support",
@@ -995,6 +1157,16 @@ void Settings::updateSettings(const Settings& other, bool apply) {
         setTracingEnabled(other.isTracingEnabled());
     }
 
+    if (other.has.connection_rebalance) {
+        if (other.isConnectionRebalanceEnabled() !=
+            isConnectionRebalanceEnabled()) {
+            LOG_INFO("{} connection rebalancing between front-end threads",
+                     other.isConnectionRebalanceEnabled() ? "Enable"
+                                                          : "Disable");
+        }
+        setConnectionRebalanceEnabled(other.isConnectionRebalanceEnabled());
+    }
+
     if (other.has.scramsha_fallback_salt) {
         const auto o = other.getScramshaFallbackSalt();
         const auto m = getScramshaFallbackSalt();
@@ -175,6 +175,48 @@ public:
         notify_changed("stdin_listener");
     }
 
+    /**
+     * Get the per-thread listener mode: should each front-end thread
+     * accept clients on its own SO_REUSEPORT socket for each interface
+     *
+     * @return true if enabled, false otherwise
+     */
+    bool isPerThreadListenersEnabled() const {
+        return per_thread_listeners.load();
+    }
+
+    /**
+     * Set the per-thread listener mode
+     *
+     * @param enabled the new value
+     */
+    void setPerThreadListenersEnabled(bool enabled) {
+        per_thread_listeners.store(enabled);
+        has.per_thread_listeners = true;
+        notify_changed("per_thread_listeners");
+    }
+
+    /**
+     * Get the NUMA affinity mode: should each front-end thread be bound to
+     * (and allocate its memory from) one of the machine's NUMA nodes
+     *
+     * @return true if enabled, false otherwise
+     */
+    bool isNumaAffinityEnabled() const {
+        return numa_affinity.load();
+    }
+
+    /**
+     * Set the NUMA affinity mode
+     *
+     * @param enabled the new value
+     */
+    void setNumaAffinityEnabled(bool enabled) {
+        numa_affinity.store(enabled);
+        has.numa_affinity = true;
+        notify_changed("numa_affinity");
+    }
+
     cb::logger::Config getLoggerConfig() const {
         auto config = logger_settings;
         // log_level is synthesised from settings.verbose.
@@ -329,6 +371,51 @@ public:
         return getMaxConnections() - getSystemConnections();
     }
 
+    /**
+     * Get the number of threads of the executor pool dedicated to SASL
+     * authentication; 0 runs the authentication tasks on the shared
+     * executor pool.
+     */
+    size_t getSaslAuthThreads() const {
+        return sasl_auth_threads.load(std::memory_order_consume);
+    }
+
+    void setSaslAuthThreads(size_t threads) {
+        sasl_auth_threads.store(threads, std::memory_order_release);
+        has.sasl_auth_threads = true;
+        notify_changed("sasl_auth_threads");
+    }
+
+    /**
+     * Get the maximum number of commands a connection which negotiated
+     * unordered execution may have blocked in the engine at the same time
+     * (and allowed to complete and return their responses out of order).
+     */
+    size_t getMaxUnorderedCommands() const {
+        return max_unordered_commands.load(std::memory_order_consume);
+    }
+
+    void setMaxUnorderedCommands(size_t max_unordered_commands) {
+        Settings::max_unordered_commands.store(max_unordered_commands,
+                                               std::memory_order_release);
+        has.max_unordered_commands = true;
+        notify_changed("max_unordered_commands");
+    }
+
+    /**
+     * Get how often the front-end threads sample the requests they
+     * execute (one in this many requests, 0 to disable the sampling).
+     */
+    size_t getRequestSampleInterval() const {
+        return request_sample_interval.load(std::memory_order_consume);
+    }
+
+    void setRequestSampleInterval(size_t interval) {
+        request_sample_interval.store(interval, std::memory_order_release);
+        has.request_sample_interval = true;
+        notify_changed("request_sample_interval");
+    }
+
     /**
      * Set the number of request to handle per notification from the
      * event library
@@ -701,6 +788,20 @@ public:
 
     void setOpcodeAttributesOverride(const std::string& value);
 
+    /// Get the per-bucket front-end budgets (see BucketThrottle::lookup)
+    const std::string getBucketThrottle() const {
+        return std::string{*bucket_throttle.rlock()};
+    }
+
+    /**
+     * Set the per-bucket front-end budgets
+     *
+     * @param value JSON object as described by BucketThrottle::lookup, or
+     *              empty to drop all of the budgets
+     * @throws std::invalid_argument if the value is malformed
+     */
+    void setBucketThrottle(const std::string& value);
+
     bool isTopkeysEnabled() const {
         return topkeys_enabled.load(std::memory_order_acquire);
     }
@@ -711,6 +812,20 @@ public:
         notify_changed("topkeys_enabled");
     }
 
+    /**
+     * Are the per vbucket and per collection timings of the GET, SET and
+     * DELETE commands (see KeyedTimings) being recorded?
+     */
+    bool isKeyedTimingsEnabled() const {
+        return keyed_timings_enabled.load(std::memory_order_acquire);
+    }
+
+    void setKeyedTimingsEnabled(bool enabled) {
+        keyed_timings_enabled.store(enabled, std::memory_order_release);
+        has.keyed_timings_enabled = true;
+        notify_changed("keyed_timings_enabled");
+    }
+
     bool isTracingEnabled() const {
         return tracing_enabled.load(std::memory_order_acquire);
     }
@@ -721,6 +836,17 @@ public:
         notify_changed("tracing_enabled");
     }
 
+    bool isConnectionRebalanceEnabled() const {
+        return connection_rebalance.load(std::memory_order_acquire);
+    }
+
+    void setConnectionRebalanceEnabled(bool enabled) {
+        Settings::connection_rebalance.store(enabled,
+                                             std::memory_order_release);
+        has.connection_rebalance = true;
+        notify_changed("connection_rebalance");
+    }
+
     void setScramshaFallbackSalt(const std::string& value) {
         scramsha_fallback_salt.wlock()->assign(value);
         has.scramsha_fallback_salt = true;
@@ -912,21 +1038,44 @@ protected:
     /// Any settings to override opcode attributes
     folly::Synchronized<std::string> opcode_attributes_override;
 
+    /// The per-bucket front-end budgets
+    folly::Synchronized<std::string> bucket_throttle;
+
     /**
      * Is topkeys enabled or not
      */
     std::atomic_bool topkeys_enabled{false};
 
+    /// Are the per vbucket and per collection timings recorded?
+    std::atomic_bool keyed_timings_enabled{false};
+
     /**
      * Is tracing enabled or not
      */
     std::atomic_bool tracing_enabled{true};
 
+    /**
+     * May idle connections be moved from busy front-end threads to less
+     * loaded ones
+     */
+    std::atomic_bool connection_rebalance{false};
+
     /**
      * Use standard input listener
      */
     std::atomic_bool stdin_listener{true};
 
+    /**
+     * Let each front-end thread accept clients on its own SO_REUSEPORT
+     * listening sockets
+     */
+    std::atomic_bool per_thread_listeners{false};
+
+    /**
+     * Bind the front-end threads to the NUMA nodes of the machine
+     */
+    std::atomic_bool numa_affinity{false};
+
     /**
      * Should we allow for using the external authentication service or not
      */
@@ -941,6 +1090,16 @@ protected:
     /// The pool of connections reserved for system usage
     std::atomic<size_t> system_connections{5000};
 
+    /// The number of commands per connection which may be executed out of
+    /// order
+    std::atomic<size_t> max_unordered_commands{16};
+
+    /// The number of threads dedicated to SASL authentication (0: none)
+    std::atomic<size_t> sasl_auth_threads{0};
+
+    /// Sample one in this many requests (per front-end thread)
+    std::atomic<size_t> request_sample_interval{1000};
+
     /// The configuration used by OpenTracing
     std::shared_ptr<OpenTracingConfig> opentracing_config;
 
@@ -982,7 +1141,9 @@ public:
         bool xattr_enabled;
         bool collections_enabled;
         bool opcode_attributes_override;
+        bool bucket_throttle = false;
         bool topkeys_enabled;
+        bool keyed_timings_enabled = false;
         bool tracing_enabled;
         bool stdin_listener;
         bool scramsha_fallback_salt;
@@ -991,6 +1152,12 @@ public:
         bool max_connections = false;
         bool system_connections = false;
         bool opentracing_config = false;
+        bool connection_rebalance = false;
+        bool per_thread_listeners = false;
+        bool numa_affinity = false;
+        bool max_unordered_commands = false;
+        bool sasl_auth_threads = false;
+        bool request_sample_interval = false;
     } has;
 
 protected:
@@ -118,6 +118,14 @@ public:
      */
     void drainBioSendPipe(SOCKET sfd);
 
+    /**
+     * The size of the BIO pair (and of our pipes): bio_drain_buffer_sz, but
+     * never less than a whole TLS record on the wire. A smaller BIO makes
+     * OpenSSL hand a record over in pieces, returning WANT_WRITE (and us
+     * draining to the socket) in between.
+     */
+    static size_t getBioBufferSize();
+
     bool moreInputAvailable() const {
         return !inputPipe.empty();
     }
@@ -26,6 +26,8 @@
 #include <platform/strerror.h>
 #include <utilities/logtags.h>
 
+#include <algorithm>
+
 SslContext::~SslContext() {
     if (enabled) {
         disable();
@@ -96,20 +98,22 @@ bool SslContext::enable(const std::string& cert, const std::string& pkey) {
     error = false;
     client = NULL;
 
+    const auto bioSize = getBioBufferSize();
     try {
-        inputPipe.ensureCapacity(settings.getBioDrainBufferSize());
-        outputPipe.ensureCapacity(settings.getBioDrainBufferSize());
+        inputPipe.ensureCapacity(bioSize);
+        outputPipe.ensureCapacity(bioSize);
     } catch (std::bad_alloc) {
         return false;
     }
 
-    BIO_new_bio_pair(&application,
-                     settings.getBioDrainBufferSize(),
-                     &network,
-                     settings.getBioDrainBufferSize());
+    BIO_new_bio_pair(&application, bioSize, &network, bioSize);
 
     client = SSL_new(ctx);
     SSL_set_bio(client, application, application);
+    // Connection::sendmsg writes from a (thread local) staging buffer, so
+    // a write retried after SSL_ERROR_WANT_WRITE may come from a different
+    // address (with the same content).
+    SSL_set_mode(client, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
 
     return true;
 }
@@ -251,6 +255,11 @@ void SslContext::drainBioSendPipe(SOCKET sfd) {
     //   * The socket buffer is full
 }
 
+size_t SslContext::getBioBufferSize() {
+    return std::max(size_t(settings.getBioDrainBufferSize()),
+                    size_t(SSL3_RT_MAX_PACKET_SIZE));
+}
+
 void SslContext::dumpCipherList(uint32_t id) const {
     nlohmann::json array;
 
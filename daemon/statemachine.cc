@@ -192,8 +192,27 @@ bool StateMachine::conn_ship_log() {
             cookie.setEwouldblock(false);
             cont = true;
 
-            const auto ret = connection.getBucket().getDcpIface()->step(
-                    static_cast<const void*>(&cookie), &connection);
+            auto* dcp = connection.getBucket().getDcpIface();
+            auto ret = dcp->step(static_cast<const void*>(&cookie),
+                                 &connection);
+
+            // Pack as many further messages as are ready (within this
+            // event's budget) into the same write, so small messages don't
+            // each pay for a send_data round of the state machine and a
+            // sendmsg() of their own. The engine stops us by returning
+            // EWOULDBLOCK when nothing more is ready (or the flow control
+            // window is full), or E2BIG when the write buffer has no room
+            // for the next message's header - it retains that message and
+            // sends it on the next step.
+            while (ret == ENGINE_SUCCESS &&
+                   connection.decrementNumEvents() >= 0) {
+                const auto next = dcp->step(static_cast<const void*>(&cookie),
+                                            &connection);
+                if (next == ENGINE_EWOULDBLOCK || next == ENGINE_E2BIG) {
+                    break;
+                }
+                ret = next;
+            }
 
             switch (connection.remapErrorCode(ret)) {
             case ENGINE_SUCCESS:
@@ -252,6 +271,13 @@ bool StateMachine::conn_read_packet_header() {
         return true;
     }
 
+    if (connection.resumeParkedCookie()) {
+        // The engine notified one of the parked commands while we were
+        // waiting for the next command to arrive
+        setCurrentState(State::execute);
+        return true;
+    }
+
     auto res = connection.tryReadNetwork();
     switch (res) {
     case Connection::TryReadResult::NoDataReceived:
@@ -275,6 +301,28 @@ bool StateMachine::conn_read_packet_header() {
 }
 
 bool StateMachine::conn_parse_cmd() {
+    if (!connection.isInternal() &&
+        !connection.getBucket().throttle.tryStartCommand()) {
+        if (connection.hasDeferredResponses()) {
+            // Don't hold back the responses while we wait
+            connection.setWriteAndGo(State::parse_cmd);
+            setCurrentState(State::send_data);
+            return true;
+        }
+
+        // The bucket is over its budget: defer the command (rather than
+        // failing it) to the next window, leaving the thread to the other
+        // buckets' connections. Stop listening for IO in the meantime, as
+        // there's no point in being told about more input we can't process.
+        if (!connection.updateEvent(0)) {
+            setCurrentState(State::closing);
+            return true;
+        }
+        throttle_connection(connection,
+                            connection.getBucket().throttle.getWindowEnd());
+        return false;
+    }
+
     // Parse the data in the input pipe and prepare the cookie for execution.
     // If all data is available we'll move over to the execution phase,
     // otherwise we'll wait for the data to arrive
@@ -287,7 +335,18 @@ bool StateMachine::conn_new_cmd() {
         return true;
     }
 
-    if (!connection.write->empty()) {
+    if (connection.hasDeferredResponses() &&
+        (!connection.isNextCommandBatchable() ||
+         connection.getNumEvents() <= 0)) {
+        // Send the responses we've held back before we carry on with a
+        // command which can't be batched with them, wait for more data or
+        // yield
+        connection.setWriteAndGo(State::new_cmd);
+        setCurrentState(State::send_data);
+        return true;
+    }
+
+    if (!connection.write->empty() && !connection.hasDeferredResponses()) {
         LOG_WARNING("{}: Expected write buffer to be empty.. It's not! ({})",
                     connection.getId(),
                     connection.write->rsize());
@@ -301,10 +360,23 @@ bool StateMachine::conn_new_cmd() {
     if (connection.decrementNumEvents() >= 0) {
         connection.getCookieObject().reset();
 
-        connection.shrinkBuffers();
+        if (connection.resumeParkedCookie()) {
+            // Send the response for the parked command before we start on
+            // the next one
+            setCurrentState(State::execute);
+            return true;
+        }
+
+        if (!connection.hasDeferredResponses()) {
+            connection.shrinkBuffers();
+        }
         if (connection.read->rsize() >= sizeof(cb::mcbp::Header)) {
             setCurrentState(State::parse_cmd);
-        } else if (connection.isSslEnabled()) {
+        } else if (connection.isSslEnabled() ||
+                   connection.isSocketReadPending()) {
+            // The data may already be waiting for us in the SSL buffers,
+            // or (as our last read filled the buffer) in the socket. Try
+            // to read it without waiting for libevent to tell us.
             setCurrentState(State::read_packet_header);
         } else {
             setCurrentState(State::waiting);
@@ -317,14 +389,17 @@ bool StateMachine::conn_new_cmd() {
          * if we're waiting for a read event. Why? because we might
          * already have all of the data for the next command in the
          * userspace buffer so the client is idle waiting for the
-         * response to arrive. Lets set up a _write_ notification,
-         * since that'll most likely be true really soon.
+         * response to arrive. Put the connection on the thread's run
+         * queue to get another timeslice once the other connections
+         * have had theirs (without a round trip through libevent).
          *
          * DCP connections are different from normal
          * connections in the way that they may not even get data from
          * the other end so that they'll _have_ to wait for a write event.
          */
-        if (connection.havePendingInputData() || connection.isDCP()) {
+        if (connection.havePendingInputData() && !connection.isDCP()) {
+            schedule_connection(connection);
+        } else if (connection.isDCP()) {
             short flags = EV_WRITE | EV_PERSIST;
             if (!connection.updateEvent(flags)) {
                 LOG_WARNING(
@@ -394,6 +469,27 @@ bool StateMachine::conn_validate() {
         }
     } // We don't currently have any validators for response packets
 
+    if (connection.allowUnorderedExecution() && header.isRequest() &&
+        (connection.getNumberOfParkedCookies() != 0 ||
+         cookie.getRequest(Cookie::PacketContent::Full).isReorderable())) {
+        // The command may be parked (or has to wait for the parked
+        // commands to complete) while we carry on with the commands after
+        // it, so it can't refer to (and hold back) the input buffer
+        cookie.detachRequest();
+        connection.read->consume(
+                [&cookie](cb::const_byte_buffer buffer) -> ssize_t {
+                    size_t size =
+                            cookie.getPacket(Cookie::PacketContent::Full)
+                                    .size();
+                    if (size > buffer.size()) {
+                        throw std::logic_error(
+                                "conn_validate: Not enough data in input "
+                                "buffer");
+                    }
+                    return gsl::narrow<ssize_t>(size);
+                });
+    }
+
     setCurrentState(State::execute);
     return true;
 }
@@ -403,10 +499,31 @@ bool StateMachine::conn_execute() {
         return true;
     }
 
+    if (connection.getNumberOfParkedCookies() != 0) {
+        auto& front = connection.getCookieObject();
+        if (front.isEwouldblock() ||
+            !connection.mayExecuteUnordered(front)) {
+            // The command is still blocked (we were notified for one of
+            // the parked commands), or it must not be executed before the
+            // parked commands. Run one of the parked commands which may
+            // complete, or wait for the engine to notify us.
+            if (!connection.swapParkedCookie()) {
+                connection.unregisterEvent();
+                return false;
+            }
+        }
+    }
+
     auto& cookie = connection.getCookieObject();
     cookie.setEwouldblock(false);
 
     if (!cookie.execute()) {
+        if (connection.parkCookie()) {
+            // Carry on with the next command while the engine works on
+            // this one
+            setCurrentState(State::new_cmd);
+            return true;
+        }
         connection.unregisterEvent();
         return false;
     }
@@ -421,16 +538,22 @@ bool StateMachine::conn_execute() {
 
     mcbp_collect_timings(cookie);
 
-    // Consume the packet we just executed from the input buffer
-    connection.read->consume([&cookie](
-                                     cb::const_byte_buffer buffer) -> ssize_t {
-        size_t size = cookie.getPacket(Cookie::PacketContent::Full).size();
-        if (size > buffer.size()) {
-            throw std::logic_error(
-                    "conn_execute: Not enough data in input buffer");
-        }
-        return gsl::narrow<ssize_t>(size);
-    });
+    // Consume the packet we just executed from the input buffer (unless
+    // it was consumed before the command was executed)
+    if (!cookie.isRequestDetached()) {
+        connection.read->consume(
+                [&cookie](cb::const_byte_buffer buffer) -> ssize_t {
+                    size_t size =
+                            cookie.getPacket(Cookie::PacketContent::Full)
+                                    .size();
+                    if (size > buffer.size()) {
+                        throw std::logic_error(
+                                "conn_execute: Not enough data in input "
+                                "buffer");
+                    }
+                    return gsl::narrow<ssize_t>(size);
+                });
+    }
     // We've cleared the memory for this packet so we need to mark it
     // as cleared in the cookie to avoid having it dumped in toJSON and
     // using freed memory. We cannot call reset on the cookie as we
@@ -513,11 +636,19 @@ bool StateMachine::conn_read_packet_body() {
 bool StateMachine::conn_send_data() {
     bool ret = true;
 
+    if (connection.deferResponse()) {
+        // Hold back the response and send it together with the responses
+        // of the commands after it
+        setCurrentState(connection.getWriteAndGo());
+        return true;
+    }
+
     switch (connection.transmit()) {
     case Connection::TransmitResult::Complete:
         // Release all allocated resources
         connection.releaseTempAlloc();
         connection.releaseReservedItems();
+        connection.clearDeferredResponses();
 
         // We're done sending the response to the client. Enter the next
         // state in the state machine
@@ -16,6 +16,7 @@
  */
 #pragma once
 
+#include <folly/CachelinePadded.h>
 #include <relaxed_atomic.h>
 
 #include <cstdint>
@@ -60,6 +61,8 @@ struct thread_stats {
         bytes_subdoc_mutation_total = 0;
         bytes_subdoc_mutation_inserted = 0;
 
+        bytes_get_inflated = 0;
+
         rbufs_allocated = 0;
         rbufs_loaned = 0;
         rbufs_existing = 0;
@@ -102,6 +105,8 @@ struct thread_stats {
         bytes_subdoc_mutation_total += other.bytes_subdoc_mutation_total;
         bytes_subdoc_mutation_inserted += other.bytes_subdoc_mutation_inserted;
 
+        bytes_get_inflated += other.bytes_get_inflated;
+
         rbufs_allocated += other.rbufs_allocated;
         rbufs_loaned += other.rbufs_loaned;
         rbufs_existing += other.rbufs_existing;
@@ -115,9 +120,10 @@ struct thread_stats {
         return *this;
     }
 
-    void aggregate(const std::vector<thread_stats>& thread_stats) {
-        for (auto& ii : thread_stats) {
-            *this += ii;
+    void aggregate(
+            const std::vector<folly::CachelinePadded<thread_stats>>& slots) {
+        for (auto& ii : slots) {
+            *this += *ii;
         }
     }
 
@@ -166,6 +172,11 @@ struct thread_stats {
        received from the client). */
     cb::RelaxedAtomic<uint64_t> bytes_subdoc_mutation_inserted;
 
+    /* # of bytes of document values which retrieval commands (get, gat,
+       get_locked) had to inflate into a temporary buffer before sending them;
+       all other values are sent directly from the engine's item. */
+    cb::RelaxedAtomic<uint64_t> bytes_get_inflated;
+
     /* # of read buffers allocated. */
     cb::RelaxedAtomic<uint64_t> rbufs_allocated;
     /* # of read buffers which could be loaned (and hence didn't need to be allocated). */
@@ -187,6 +198,17 @@ struct thread_stats {
     cb::RelaxedAtomic<int> msgused_high_watermark;
 };
 
+/**
+ * A bucket's per-thread stats, one slot per front-end thread.
+ *
+ * Each slot is only updated by the thread it belongs to, so the counters
+ * never contend; the slots are padded onto cache lines of their own so
+ * that the threads' updates don't bounce a shared line between cores
+ * either. Readers (stats requests) aggregate the slots with relaxed loads,
+ * without any locking, so collecting stats never blocks the workers.
+ */
+using ThreadStatsSlots = std::vector<folly::CachelinePadded<thread_stats>>;
+
 /**
  * Global stats.
  */
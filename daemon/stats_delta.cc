@@ -0,0 +1,58 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "stats_delta.h"
+
+#include <functional>
+
+const size_t StatsDeltaCache::MaxGroups = 16;
+
+bool StatsDeltaSnapshot::update(cb::const_char_buffer key,
+                                cb::const_char_buffer value) {
+    std::hash<cb::const_char_buffer> hash;
+    const uint64_t valueHash = hash(value);
+    auto result = entries.emplace(hash(key), Entry{valueHash, poll});
+    auto& entry = result.first->second;
+    entry.poll = poll;
+    if (result.second) {
+        return true;
+    }
+    if (entry.value == valueHash) {
+        return false;
+    }
+    entry.value = valueHash;
+    return true;
+}
+
+void StatsDeltaSnapshot::endPoll() {
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->second.poll != poll) {
+            it = entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+StatsDeltaSnapshot& StatsDeltaCache::beginPoll(const std::string& group) {
+    if (groups.size() >= MaxGroups && groups.find(group) == groups.end()) {
+        groups.clear();
+    }
+    auto& snapshot = groups[group];
+    snapshot.beginPoll();
+    return snapshot;
+}
@@ -0,0 +1,100 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <platform/sized_buffer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+/**
+ * What a connection was last sent by one stats group it polls with
+ * "stats delta <group>": a hash of the value of each stat (keyed by a hash
+ * of its key), so that the next poll only sends the stats which are new or
+ * have changed since.
+ *
+ * Only the hashes are kept, as a group such as "vbucket-details" may hold
+ * hundreds of thousands of stats.
+ */
+class StatsDeltaSnapshot {
+public:
+    /// Start a new poll of the group
+    void beginPoll() {
+        ++poll;
+    }
+
+    /**
+     * Record the value of a stat in the current poll.
+     *
+     * @return true if the stat is to be sent (it is new or its value
+     *         changed since the previous poll)
+     */
+    bool update(cb::const_char_buffer key, cb::const_char_buffer value);
+
+    /**
+     * Complete the current poll: forget the stats it didn't report (such as
+     * those of a DCP connection which has since closed), so that they're
+     * sent again should they reappear.
+     */
+    void endPoll();
+
+    size_t size() const {
+        return entries.size();
+    }
+
+private:
+    struct Entry {
+        uint64_t value;
+        /// The poll which last reported the stat
+        uint64_t poll;
+    };
+
+    std::unordered_map<uint64_t, Entry> entries;
+    uint64_t poll = 0;
+};
+
+/**
+ * The StatsDeltaSnapshots of the stats groups polled by a connection.
+ */
+class StatsDeltaCache {
+public:
+    /**
+     * The most groups a connection may poll; to bound the memory used by a
+     * client which keeps changing the arguments of its polls, all of the
+     * snapshots are dropped if it polls any more.
+     */
+    static const size_t MaxGroups;
+
+    /**
+     * Start a poll of the given group (the stat key, without the "delta"
+     * prefix).
+     *
+     * @return the snapshot of the group, which remains valid until the next
+     *         poll of another group is started
+     */
+    StatsDeltaSnapshot& beginPoll(const std::string& group);
+
+    size_t size() const {
+        return groups.size();
+    }
+
+private:
+    std::unordered_map<std::string, StatsDeltaSnapshot> groups;
+};
@@ -40,6 +40,10 @@ public:
 
     void notifyExecutionComplete() override;
 
+    Class getClass() const override {
+        return Class::Stats;
+    }
+
     ENGINE_ERROR_CODE getCommandError() const {
         return command_error;
     }
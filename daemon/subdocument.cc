@@ -42,6 +42,8 @@
 #include <xattr/blob.h>
 #include <gsl/gsl>
 
+#include <algorithm>
+
 static const std::array<SubdocCmdContext::Phase, 2> phases{{SubdocCmdContext::Phase::XATTR,
                                                             SubdocCmdContext::Phase::Body}};
 
@@ -544,6 +546,77 @@ static bool subdoc_fetch(Cookie& cookie,
     return true;
 }
 
+/**
+ * For lookups in the body of a large document, use the (cached) index of
+ * its top-level keys so that subjson doesn't have to scan the document up
+ * to the value of the path's first component: narrow {doc} to that value and
+ * {path} to the rest of the path.
+ *
+ * @return true if doc and path were narrowed
+ */
+static bool subdoc_narrow_lookup(SubdocCmdContext& context,
+                                 const SubdocCmdContext::OperationSpec& spec,
+                                 cb::const_char_buffer& doc,
+                                 cb::const_char_buffer& path) {
+    if (context.traits.is_mutator ||
+        context.getCurrentPhase() != SubdocCmdContext::Phase::Body) {
+        return false;
+    }
+
+    // The first component of the path; unless it's quoted (and may hence
+    // contain escapes).
+    const char* const path_end = path.buf + path.len;
+    const char* end = std::find_if(path.buf, path_end, [](char c) {
+        return c == '.' || c == '[' || c == '`';
+    });
+    if (end == path.buf || (end != path_end && *end == '`')) {
+        return false;
+    }
+    const cb::const_char_buffer key{path.buf, size_t(end - path.buf)};
+    if (end != path_end && *end == '.') {
+        ++end;
+        if (end == path_end) {
+            return false;
+        }
+    }
+    const cb::const_char_buffer rest{end, size_t(path_end - end)};
+
+    switch (spec.traits.subdocCommand) {
+    case Subdoc::Command::GET:
+    case Subdoc::Command::EXISTS:
+        break;
+    case Subdoc::Command::GET_COUNT:
+        if (rest.empty()) {
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+
+    const auto& request =
+            context.cookie.getRequest(Cookie::PacketContent::Full);
+    auto& cache = context.connection.getThread()->subdoc_index_cache;
+    const auto* index = cache.get(context.connection.getBucketIndex(),
+                                  request.getVBucket(),
+                                  request.getKey(),
+                                  context.in_cas,
+                                  doc);
+    if (index == nullptr) {
+        return false;
+    }
+
+    const auto value = index->find(doc, key);
+    if (value.empty()) {
+        // Not indexed (or not there); let subjson work it out.
+        return false;
+    }
+
+    doc = value;
+    path = rest;
+    return true;
+}
+
 /**
  * Perform the subjson operation specified by {spec} to one path in the
  * document.
@@ -552,12 +625,20 @@ static cb::mcbp::Status subdoc_operate_one_path(
         SubdocCmdContext& context,
         SubdocCmdContext::OperationSpec& spec,
         const cb::const_char_buffer& in_doc) {
+    auto doc = in_doc;
+    auto path = spec.path;
+    if (subdoc_narrow_lookup(context, spec, doc, path) && path.empty()) {
+        // The path is a top-level key; doc is its value.
+        spec.result.set_matchloc({doc.buf, doc.len});
+        return cb::mcbp::Status::Success;
+    }
+
     // Prepare the specified sub-document command.
     auto& op = context.connection.getThread()->subdoc_op;
     op.clear();
     op.set_result_buf(&spec.result);
     op.set_code(spec.traits.subdocCommand);
-    op.set_doc(in_doc.buf, in_doc.len);
+    op.set_doc(doc.buf, doc.len);
 
     if (spec.flags & SUBDOC_FLAG_EXPAND_MACROS) {
         auto padded_macro = context.get_padded_macro(spec.value);
@@ -581,7 +662,7 @@ static cb::mcbp::Status subdoc_operate_one_path(
     }
 
     // ... and execute it.
-    const auto subdoc_res = op.op_exec(spec.path.buf, spec.path.len);
+    const auto subdoc_res = op.op_exec(path.buf, path.len);
 
     switch (subdoc_res) {
     case Subdoc::Error::SUCCESS:
@@ -649,6 +730,14 @@ static cb::mcbp::Status subdoc_operate_wholedoc(
         return cb::mcbp::Status::Success;
 
     case cb::mcbp::ClientOpcode::Set:
+        // The new body replaces the old one; determine if it is JSON (we
+        // do not trust the datatype of the old one to still apply).
+        if (context.connection.getThread()->validator.validate(
+                    spec.value.buf, spec.value.len)) {
+            context.in_datatype |= PROTOCOL_BINARY_DATATYPE_JSON;
+        } else {
+            context.in_datatype &= ~PROTOCOL_BINARY_DATATYPE_JSON;
+        }
         spec.result.push_newdoc({spec.value.buf, spec.value.len});
         return cb::mcbp::Status::Success;
 
@@ -673,6 +762,11 @@ static cb::mcbp::Status subdoc_operate_wholedoc(
  *                    allocations if we need to change the doc.
  * @param modified set to true upon return if any modifications happened
  *                 to the input document.
+ * @param segments if non-null, the result of the last mutation isn't
+ *                 flattened into temp_buffer; instead the segments making up
+ *                 the new document are appended to it (and doc is left
+ *                 referring to that mutation's input, which they may point
+ *                 into).
  * @return true if we should continue processing this request,
  *         false if we've sent the error packet and should temrinate
  *               execution for this request
@@ -683,12 +777,50 @@ static bool operate_single_doc(SubdocCmdContext& context,
                                 cb::const_char_buffer& doc,
                                 protocol_binary_datatype_t doc_datatype,
                                 std::unique_ptr<char[]>& temp_buffer,
-                                bool& modified) {
+                                bool& modified,
+                                std::vector<cb::const_char_buffer>* segments =
+                                        nullptr) {
     modified = false;
     auto& operations = context.getOperations();
 
+    // The last successful mutation, if its result (a set of iovecs) hasn't
+    // been made into a contiguous document yet. That is only needed when
+    // another operation has to read it.
+    SubdocCmdContext::OperationSpec* unflattened = nullptr;
+    auto flatten = [&doc, &temp_buffer, &unflattened]() {
+        // Determine how much space we now need.
+        size_t new_doc_len = 0;
+        for (auto& loc : unflattened->result.newdoc()) {
+            new_doc_len += loc.length;
+        }
+
+        // We need to create a contiguous input region for the next subjson
+        // call, from the set of iovecs in the result. We can't simply write
+        // into the dynamic_buffer, as that may be the underlying storage for
+        // iovecs from the result. For now we make a contiguous region in a
+        // temporary char[], and point doc at that.
+        std::unique_ptr<char[]> temp(new char[new_doc_len]);
+
+        size_t offset = 0;
+        for (auto& loc : unflattened->result.newdoc()) {
+            std::copy(loc.at, loc.at + loc.length, temp.get() + offset);
+            offset += loc.length;
+        }
+
+        // Copying complete - safe to delete the old temp_doc (even if it was
+        // the source of some of the newdoc iovecs).
+        temp_buffer.swap(temp);
+        doc.buf = temp_buffer.get();
+        doc.len = new_doc_len;
+        unflattened = nullptr;
+    };
+
     // 2. Perform each of the operations on document.
     for (auto op = operations.begin(); op != operations.end(); op++) {
+        if (unflattened != nullptr) {
+            flatten();
+        }
+
         switch (op->traits.scope) {
         case CommandScope::SubJSON:
             if (mcbp::datatype::is_json(doc_datatype)) {
@@ -707,36 +839,7 @@ static bool operate_single_doc(SubdocCmdContext& context,
         if (op->status == cb::mcbp::Status::Success) {
             if (context.traits.is_mutator) {
                 modified = true;
-
-                // Determine how much space we now need.
-                size_t new_doc_len = 0;
-                for (auto& loc : op->result.newdoc()) {
-                    new_doc_len += loc.length;
-                }
-
-                // TODO-PERF: We need to create a contiguous input
-                // region for the next subjson call, from the set of
-                // iovecs in the result. We can't simply write into
-                // the dynamic_buffer, as that may be the underlying
-                // storage for iovecs from the result. Ideally we'd
-                // either permit subjson to take an iovec as input, or
-                // permit subjson to take all the multipaths at once.
-                // For now we make a contiguous region in a temporary
-                // char[], and point in_doc at that.
-                std::unique_ptr<char[]> temp(new char[new_doc_len]);
-
-                size_t offset = 0;
-                for (auto& loc : op->result.newdoc()) {
-                    std::copy(loc.at, loc.at + loc.length, temp.get() + offset);
-                    offset += loc.length;
-                }
-
-                // Copying complete - safe to delete the old temp_doc
-                // (even if it was the source of some of the newdoc
-                // iovecs).
-                temp_buffer.swap(temp);
-                doc.buf = temp_buffer.get();
-                doc.len = new_doc_len;
+                unflattened = &*op;
             } else { // lookup
                 // nothing to do.
             }
@@ -768,6 +871,16 @@ static bool operate_single_doc(SubdocCmdContext& context,
         }
     }
 
+    if (unflattened != nullptr) {
+        if (segments == nullptr) {
+            flatten();
+        } else {
+            for (auto& loc : unflattened->result.newdoc()) {
+                segments->emplace_back(loc.at, loc.length);
+            }
+        }
+    }
+
     return true;
 }
 
@@ -1083,36 +1196,39 @@ static bool do_body_phase(SubdocCmdContext& context) {
     }
 
     std::unique_ptr<char[]> temp_doc;
+    std::vector<cb::const_char_buffer> segments;
     bool modified;
 
-    if (!operate_single_doc(
-                context, document, context.in_datatype, temp_doc, modified)) {
+    if (!operate_single_doc(context,
+                            document,
+                            context.in_datatype,
+                            temp_doc,
+                            modified,
+                            &segments)) {
         return false;
     }
 
-    // We didn't change anything in the document so just drop everything
-    if (!modified) {
+    if (context.overall_status != cb::mcbp::Status::Success) {
         return true;
     }
 
-    // There isn't any xattrs associated with the document. We shouldn't
-    // reallocate and move things around but just reuse the temporary
-    // buffer we've already created.
-    if (xattrsize == 0) {
-        context.temp_doc.swap(temp_doc);
-        context.in_doc = { context.temp_doc.get(), document.len };
+    // We didn't change anything in the document so just drop everything
+    if (!modified) {
         return true;
     }
 
-    // Time to rebuild the full document.
-    auto total = xattrsize + document.len;
-    std::unique_ptr<char[]> full_document(new char[total]);;
-
-    memcpy(full_document.get(), context.in_doc.buf, xattrsize);
-    memcpy(full_document.get() + xattrsize, document.buf, document.len);
-
-    context.temp_doc.swap(full_document);
-    context.in_doc = { context.temp_doc.get(), total };
+    // Rather than building the new document here (only for subdoc_update()
+    // to copy it again into the new item), keep it as the list of its
+    // segments: the (unchanged) xattrs followed by the pieces of the new
+    // body, which may point into the last mutation's input - temp_doc or
+    // in_doc - and its result.
+    context.out_segments.clear();
+    if (xattrsize != 0) {
+        context.out_segments.emplace_back(context.in_doc.buf, xattrsize);
+    }
+    context.out_segments.insert(
+            context.out_segments.end(), segments.begin(), segments.end());
+    context.segments_doc.swap(temp_doc);
 
     return true;
 }
@@ -1185,6 +1301,12 @@ static ENGINE_ERROR_CODE subdoc_update(SubdocCmdContext& context,
 
         if (ret == ENGINE_SUCCESS) {
             context.out_doc_len = context.in_doc.len;
+            if (!context.out_segments.empty()) {
+                context.out_doc_len = 0;
+                for (const auto& segment : context.out_segments) {
+                    context.out_doc_len += segment.len;
+                }
+            }
             auto allocate_key = cookie.getConnection().makeDocKey(key);
             const size_t priv_bytes =
                 cb::xattr::get_system_xattr_size(context.in_datatype,
@@ -1243,9 +1365,23 @@ static ENGINE_ERROR_CODE subdoc_update(SubdocCmdContext& context,
             return ENGINE_FAILED;
         }
 
-        // Copy the new document into the item.
+        // Copy the new document into the item; assembling it from its
+        // segments if the body was modified.
         char* write_ptr = static_cast<char*>(new_doc_info.value[0].iov_base);
-        std::memcpy(write_ptr, context.in_doc.buf, context.in_doc.len);
+        if (context.out_segments.empty()) {
+            std::memcpy(write_ptr, context.in_doc.buf, context.in_doc.len);
+        } else {
+            char* ptr = write_ptr;
+            for (const auto& segment : context.out_segments) {
+                std::memcpy(ptr, segment.buf, segment.len);
+                ptr += segment.len;
+            }
+            context.out_segments.clear();
+        }
+
+        // From now on in_doc refers to the new document (e.g.
+        // pre_link_document() calculates the value's CRC32C from it).
+        context.in_doc = {write_ptr, context.out_doc_len};
     }
 
     // And finally, store the new document.
@@ -1259,16 +1395,14 @@ static ENGINE_ERROR_CODE subdoc_update(SubdocCmdContext& context,
                             docKey,
                             new_cas,
                             vbucket,
-                            cookie.getRequest(Cookie::PacketContent::Full)
-                                    .getDurabilityRequirements(),
+                            cookie.getFrameInfos().durability,
                             mdt);
     } else {
         ret = bucket_store(cookie,
                            context.out_doc.get(),
                            new_cas,
                            new_op,
-                           cookie.getRequest(Cookie::PacketContent::Full)
-                                   .getDurabilityRequirements(),
+                           cookie.getFrameInfos().durability,
                            context.do_delete_doc ? DocumentState::Deleted
                                                  : context.in_document_state);
     }
@@ -31,6 +31,7 @@
 #include <iomanip>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 enum class MutationSemantics : uint8_t { Add, Replace, Set };
 
@@ -164,6 +165,17 @@ public:
     // as input for the next multi-path mutation.
     std::unique_ptr<char[]> temp_doc;
 
+    // [Mutations only] If the body was modified; the segments which make up
+    // the new document, in order. These are only assembled (by
+    // subdoc_update()) directly into the new item, saving a copy of the
+    // whole document. They may refer to {in_doc}, {segments_doc} and the
+    // result of the last body operation.
+    std::vector<cb::const_char_buffer> out_segments;
+
+    // Temporary buffer holding the input document of the last body mutation,
+    // which {out_segments} may refer to.
+    std::unique_ptr<char[]> segments_doc;
+
     // Temporary buffer used to hold the xattrs in use, as a get request
     // may hold pointers into the repacked xattr buckets
     std::unique_ptr<char[]> xattr_buffer;
@@ -0,0 +1,218 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "subdocument_index.h"
+
+#include <algorithm>
+#include <limits>
+
+const size_t SubdocIndexCache::minimumDocumentSize = 16 * 1024;
+const size_t SubdocIndexCache::capacity = 16;
+
+static const char* skip_whitespace(const char* ptr, const char* end) {
+    while (ptr < end &&
+           (*ptr == ' ' || *ptr == '\t' || *ptr == '\n' || *ptr == '\r')) {
+        ++ptr;
+    }
+    return ptr;
+}
+
+/**
+ * Skip the string starting at ptr (which points at its opening quote).
+ *
+ * @param escaped set to true if the string contains escape sequences
+ * @return the position following the closing quote, or nullptr if the
+ *         string isn't terminated
+ */
+static const char* skip_string(const char* ptr,
+                               const char* end,
+                               bool& escaped) {
+    for (++ptr; ptr < end; ++ptr) {
+        if (*ptr == '\\') {
+            escaped = true;
+            ++ptr;
+        } else if (*ptr == '"') {
+            return ptr + 1;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Skip the value starting at ptr. The document has already been validated
+ * as JSON, so this only has to find where the value ends (tracking nesting
+ * and strings), not check it.
+ *
+ * @return the position following the value, or nullptr if it isn't
+ *         terminated
+ */
+static const char* skip_value(const char* ptr, const char* end) {
+    bool escaped;
+    if (*ptr == '"') {
+        return skip_string(ptr, end, escaped);
+    }
+
+    if (*ptr != '{' && *ptr != '[') {
+        // A number, true, false or null.
+        while (ptr < end && *ptr != ',' && *ptr != '}' && *ptr != ']' &&
+               *ptr != ' ' && *ptr != '\t' && *ptr != '\n' && *ptr != '\r') {
+            ++ptr;
+        }
+        return ptr;
+    }
+
+    size_t depth = 0;
+    while (ptr < end) {
+        switch (*ptr) {
+        case '"':
+            ptr = skip_string(ptr, end, escaped);
+            if (ptr == nullptr) {
+                return nullptr;
+            }
+            continue;
+        case '{':
+        case '[':
+            ++depth;
+            break;
+        case '}':
+        case ']':
+            if (--depth == 0) {
+                return ptr + 1;
+            }
+            break;
+        }
+        ++ptr;
+    }
+    return nullptr;
+}
+
+std::unique_ptr<SubdocDocumentIndex> SubdocDocumentIndex::create(
+        cb::const_char_buffer doc) {
+    if (doc.size() > std::numeric_limits<uint32_t>::max()) {
+        return {};
+    }
+
+    const char* const begin = doc.data();
+    const char* const end = begin + doc.size();
+    const char* ptr = skip_whitespace(begin, end);
+    if (ptr == end || *ptr != '{') {
+        return {};
+    }
+
+    std::unique_ptr<SubdocDocumentIndex> ret(new SubdocDocumentIndex);
+    ptr = skip_whitespace(ptr + 1, end);
+    if (ptr < end && *ptr == '}') {
+        return ret;
+    }
+
+    while (ptr < end) {
+        // "key"
+        if (*ptr != '"') {
+            return {};
+        }
+        bool escaped = false;
+        const char* key = ptr + 1;
+        ptr = skip_string(ptr, end, escaped);
+        if (ptr == nullptr) {
+            return {};
+        }
+        const size_t keylen = (ptr - 1) - key;
+
+        // :
+        ptr = skip_whitespace(ptr, end);
+        if (ptr == end || *ptr != ':') {
+            return {};
+        }
+        ptr = skip_whitespace(ptr + 1, end);
+        if (ptr == end) {
+            return {};
+        }
+
+        // value
+        const char* value = ptr;
+        ptr = skip_value(ptr, end);
+        if (ptr == nullptr) {
+            return {};
+        }
+        if (!escaped) {
+            // Like subjson, a lookup of a duplicated key finds the first.
+            ret->values.emplace(std::string(key, keylen),
+                                std::make_pair(uint32_t(value - begin),
+                                               uint32_t(ptr - value)));
+        }
+
+        // , or }
+        ptr = skip_whitespace(ptr, end);
+        if (ptr == end) {
+            return {};
+        }
+        if (*ptr == '}') {
+            return ret;
+        }
+        if (*ptr != ',') {
+            return {};
+        }
+        ptr = skip_whitespace(ptr + 1, end);
+    }
+
+    return {};
+}
+
+cb::const_char_buffer SubdocDocumentIndex::find(
+        cb::const_char_buffer doc, cb::const_char_buffer key) const {
+    auto it = values.find(std::string(key.data(), key.size()));
+    if (it == values.end()) {
+        return {};
+    }
+    return {doc.data() + it->second.first, it->second.second};
+}
+
+const SubdocDocumentIndex* SubdocIndexCache::get(int bucket,
+                                                 Vbid vbucket,
+                                                 cb::const_byte_buffer key,
+                                                 uint64_t cas,
+                                                 cb::const_char_buffer doc) {
+    if (doc.size() < minimumDocumentSize || cas == 0) {
+        return nullptr;
+    }
+
+    const std::string docKey(reinterpret_cast<const char*>(key.data()),
+                             key.size());
+    auto it = std::find_if(
+            entries.begin(), entries.end(), [&](const Entry& entry) {
+                return entry.cas == cas && entry.size == doc.size() &&
+                       entry.bucket == bucket && entry.vbucket == vbucket &&
+                       entry.key == docKey;
+            });
+
+    if (it == entries.end()) {
+        if (entries.size() == capacity) {
+            entries.pop_back();
+        }
+        entries.insert(entries.begin(),
+                       Entry{bucket,
+                             vbucket,
+                             docKey,
+                             cas,
+                             doc.size(),
+                             SubdocDocumentIndex::create(doc)});
+    } else if (it != entries.begin()) {
+        std::rotate(entries.begin(), it, it + 1);
+    }
+
+    return entries.front().index.get();
+}
@@ -0,0 +1,108 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <memcached/vbucket.h>
+#include <platform/sized_buffer.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * An index of where the value of each top-level key of a JSON object
+ * document lives, so that a sub-document lookup can jump straight to the
+ * value of its path's first component instead of having subjson scan the
+ * document from the start.
+ *
+ * Keys containing escape sequences aren't indexed (they can't be compared
+ * with a path component byte by byte); looking them up just misses.
+ */
+class SubdocDocumentIndex {
+public:
+    /**
+     * Index the given document.
+     *
+     * @return the index, or nullptr if the document isn't a JSON object (or
+     *         is malformed).
+     */
+    static std::unique_ptr<SubdocDocumentIndex> create(
+            cb::const_char_buffer doc);
+
+    /**
+     * Find the value of a top-level key.
+     *
+     * @param doc the document this index was created from
+     * @param key the key to look up
+     * @return the value (within doc), or an empty buffer if the key isn't
+     *         indexed
+     */
+    cb::const_char_buffer find(cb::const_char_buffer doc,
+                               cb::const_char_buffer key) const;
+
+private:
+    /// Key -> (offset, length) of its value in the document.
+    std::unordered_map<std::string, std::pair<uint32_t, uint32_t>> values;
+};
+
+/**
+ * A small cache of the SubdocDocumentIndex of the documents most recently
+ * looked up by the connections served by a front end thread (hence not
+ * thread safe).
+ *
+ * Entries are identified by the document's bucket, vbucket, key and CAS; as
+ * every mutation changes the CAS a modified document never matches the
+ * index of its previous revision (which simply ages out of the cache).
+ */
+class SubdocIndexCache {
+public:
+    /// Documents smaller than this are cheap enough to scan.
+    static const size_t minimumDocumentSize;
+
+    /// The number of document indexes kept.
+    static const size_t capacity;
+
+    /**
+     * Get the index of the given (body of a) document, creating it if it
+     * isn't cached yet.
+     *
+     * @return the index, or nullptr if the document can't (or isn't worth
+     *         being) indexed
+     */
+    const SubdocDocumentIndex* get(int bucket,
+                                   Vbid vbucket,
+                                   cb::const_byte_buffer key,
+                                   uint64_t cas,
+                                   cb::const_char_buffer doc);
+
+private:
+    struct Entry {
+        int bucket;
+        Vbid vbucket;
+        std::string key;
+        uint64_t cas;
+        size_t size;
+        /// nullptr if the document can't be indexed.
+        std::unique_ptr<SubdocDocumentIndex> index;
+    };
+
+    /// The cached entries, most recently used first.
+    std::vector<Entry> entries;
+};
@@ -33,6 +33,21 @@ void Task::makeRunnable(std::chrono::steady_clock::time_point time) {
     executor->makeRunnable(*this, time);
 }
 
+std::string to_string(Task::Class taskClass) {
+    switch (taskClass) {
+    case Task::Class::General:
+        return "general";
+    case Task::Class::Auth:
+        return "auth";
+    case Task::Class::Stats:
+        return "stats";
+    case Task::Class::BucketManagement:
+        return "bucket_management";
+    }
+    throw std::invalid_argument("to_string(Task::Class): invalid class " +
+                                std::to_string(int(taskClass)));
+}
+
 Task::Status PeriodicTask::execute() {
     auto next_time = next();
     Status status = periodicExecute();
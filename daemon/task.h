@@ -24,6 +24,7 @@ class Executor;
 #include <chrono>
 #include <mutex>
 #include <stdexcept>
+#include <string>
 
 /**
  * The Task class represents a Task that needs to be performed by the
@@ -34,6 +35,14 @@ class Task {
 public:
     enum class Status { Finished, Continue };
 
+    /**
+     * The classes of tasks. The ExecutorPool stops the tasks of one class
+     * from occupying all of its executors, and keeps histograms of the
+     * runtime and wait time of each class.
+     */
+    enum class Class : uint8_t { General, Auth, Stats, BucketManagement };
+    static const size_t NumClasses = 4;
+
     Task() : executor(nullptr) {
         // empty
     }
@@ -60,6 +69,11 @@ public:
     virtual void notifyExecutionComplete() {
     }
 
+    /// Get the class of the task
+    virtual Class getClass() const {
+        return Class::General;
+    }
+
     /**
      * Get the mutex used to protect the task and to ensure that we don't
      * have any race conditions. It should be held when:
@@ -129,6 +143,8 @@ private:
     std::mutex mutex;
 };
 
+std::string to_string(Task::Class taskClass);
+
 /**
  * The PeriodicTask class represents a task that needs to be executed with a
  * regular period (passed in the constructor).
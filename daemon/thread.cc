@@ -23,8 +23,10 @@
 #include <platform/strerror.h>
 
 #include <fcntl.h>
+#include <algorithm>
 #include <atomic>
 #include <cerrno>
+#include <chrono>
 #include <condition_variable>
 #include <csignal>
 #include <cstdint>
@@ -33,6 +35,13 @@
 #include <cstring>
 #ifndef WIN32
 #include <netinet/tcp.h> // For TCP_NODELAY etc
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#ifdef HAVE_LIBNUMA
+#include <numa.h>
 #endif
 #include <memory>
 #include <mutex>
@@ -94,6 +103,12 @@ void FrontEndThread::NotificationList::swap(std::vector<Connection*>& other) {
 static std::vector<FrontEndThread> threads;
 std::vector<Hdr1sfMicroSecHistogram> scheduler_info;
 
+/*
+ * Per thread, per Connection::Priority: the time connections waited on the
+ * thread's run queue.
+ */
+static std::vector<std::array<Hdr1sfMicroSecHistogram, 3>> run_queue_info;
+
 /*
  * Number of worker threads that have finished setting themselves up.
  */
@@ -156,6 +171,25 @@ static bool create_notification_pipe(FrontEndThread& me) {
     return true;
 }
 
+/*
+ * Create the notification channel for a worker thread: an eventfd where
+ * available (one descriptor, and cheaper to signal and drain than a socket
+ * pair), otherwise a socket pair.
+ */
+static bool create_notification_channel(FrontEndThread& me) {
+#ifdef __linux__
+    const int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (efd != -1) {
+        me.notify[0] = me.notify[1] = efd;
+        me.notify_eventfd = true;
+        return true;
+    }
+    LOG_WARNING("Can't create notify eventfd: {} - using a socket pair",
+                cb_strerror());
+#endif
+    return create_notification_pipe(me);
+}
+
 static void setup_dispatcher(struct event_base *main_base,
                              void (*dispatcher_callback)(evutil_socket_t, short, void *))
 {
@@ -181,6 +215,9 @@ static void setup_dispatcher(struct event_base *main_base,
 /*
  * Set up a thread's information.
  */
+static void run_queue_handler(evutil_socket_t, short, void* arg);
+static void throttle_handler(evutil_socket_t, short, void* arg);
+
 static void setup_thread(FrontEndThread& me) {
     me.base = event_base_new();
 
@@ -188,6 +225,16 @@ static void setup_thread(FrontEndThread& me) {
         FATAL_ERROR(EXIT_FAILURE, "Can't allocate event base");
     }
 
+    if (evtimer_assign(
+                &me.run_queue_event, me.base, run_queue_handler, &me) == -1) {
+        FATAL_ERROR(EXIT_FAILURE, "Can't set up the run queue event");
+    }
+
+    if (evtimer_assign(&me.throttle_event, me.base, throttle_handler, &me) ==
+        -1) {
+        FATAL_ERROR(EXIT_FAILURE, "Can't set up the throttle event");
+    }
+
     /* Listen for notifications from other threads */
     if ((event_assign(&me.notify_event,
                       me.base,
@@ -200,12 +247,46 @@ static void setup_thread(FrontEndThread& me) {
     }
 }
 
+/*
+ * Bind the front-end thread to one of the machine's NUMA nodes (spreading
+ * the threads evenly over the nodes), and have it allocate memory (e.g. its
+ * connections' buffers) from that node rather than interleaved over all of
+ * them.
+ */
+static void bind_to_numa_node(const FrontEndThread& me) {
+#ifdef HAVE_LIBNUMA
+    if (numa_available() < 0) {
+        return;
+    }
+    const int nodes = numa_num_configured_nodes();
+    if (nodes < 2) {
+        return;
+    }
+    const int node = int(me.index % nodes);
+    if (numa_run_on_node(node) == 0) {
+        numa_set_localalloc();
+        LOG_INFO("Front-end thread {} bound to NUMA node {}", me.index, node);
+    } else {
+        LOG_WARNING("Failed to bind front-end thread {} to NUMA node {}: {}",
+                    me.index,
+                    node,
+                    cb_strerror());
+    }
+#else
+    (void)me;
+#endif
+}
+
 /*
  * Worker thread: main event loop
  */
 static void worker_libevent(void *arg) {
     auto& me = *reinterpret_cast<FrontEndThread*>(arg);
 
+    if (settings.isNumaAffinityEnabled()) {
+        bind_to_numa_node(me);
+    }
+
     // Any per-thread setup can happen here; thread_init() will block until
     // all threads have finished initializing.
     {
@@ -243,6 +324,17 @@ void drain_notification_channel(evutil_socket_t fd) {
     }
 }
 
+#ifdef __linux__
+static void drain_notification_eventfd(evutil_socket_t fd) {
+    // Reading an eventfd returns (and resets) the count of all the
+    // notifications since it was last read.
+    uint64_t count;
+    if (read(fd, &count, sizeof(count)) == -1 && errno != EAGAIN) {
+        LOG_WARNING("Can't read from notify eventfd: {}", cb_strerror());
+    }
+}
+#endif
+
 static void dispatch_new_connections(FrontEndThread& me) {
     std::vector<std::pair<SOCKET, SharedListeningPort>> connections;
     me.new_conn_queue.swap(connections);
@@ -251,6 +343,7 @@ static void dispatch_new_connections(FrontEndThread& me) {
         if (conn_new(entry.first, *entry.second, me.base, &me) == nullptr) {
             LOG_WARNING("Failed to dispatch event for socket {}",
                         long(entry.first));
+            --me.num_connections;
             if (entry.second->system) {
                 --stats.system_conns;
             }
@@ -271,7 +364,18 @@ static void thread_libevent_process(evutil_socket_t fd, short, void* arg) {
     // tries to notify us while we're doing the work below (so we don't have
     // to care about race conditions for stuff people try to notify us
     // about.
+#ifdef __linux__
+    if (me.notify_eventfd) {
+        drain_notification_eventfd(fd);
+    } else {
+        drain_notification_channel(fd);
+    }
+#else
     drain_notification_channel(fd);
+#endif
+    // Any notification from now on must wake us again, as we may already
+    // have looked at the work it queued.
+    me.notification_pending = false;
 
     if (memcached_shutdown) {
         // Someone requested memcached to shut down. The listen thread should
@@ -302,6 +406,19 @@ static void thread_libevent_process(evutil_socket_t fd, short, void* arg) {
                           "thread_libevent_process::threadLock",
                           SlowMutexThreshold);
 
+    // Register connections moved here from other threads before anything
+    // else, as they may also be on our notification list.
+    std::vector<Connection*> migrated;
+    me.migrated.swap(migrated);
+    for (auto* c : migrated) {
+        if (!c->setEventBase(me.base)) {
+            c->setState(StateMachine::State::closing);
+        }
+        // Run it once, in case data arrived while it was being moved.
+        c->setNumEvents(1);
+        run_event_loop(c, EV_READ);
+    }
+
     std::vector<Connection*> notify;
     me.notification.swap(notify);
 
@@ -388,23 +505,212 @@ void notify_io_complete(gsl::not_null<const void*> void_cookie,
     }
 }
 
+/******************************* LOAD BALANCING *****************************/
+
+/* How often the front-end threads' load is sampled. */
+static const std::chrono::nanoseconds loadSampleInterval =
+        std::chrono::seconds(1);
+
+/*
+ * Threads whose utilization is within this many percent of each other are
+ * considered equally loaded when placing new connections.
+ */
+static const uint64_t placementGranularity = 5;
+
+/* Connections are only moved off threads which are at least this busy (%). */
+static const uint64_t migrationMinUtilization = 50;
+
+/* A connection isn't moved again within this long of its previous move. */
+static const std::chrono::seconds migrationHoldoff{10};
+
+static std::mutex load_sample_mutex;
+static std::chrono::steady_clock::time_point last_load_sample;
+
+/*
+ * Update each thread's recent_busy_time, if loadSampleInterval has passed
+ * since they were last updated. Called by the dispatcher and the worker
+ * threads alike; whichever gets there first does the update.
+ */
+static void sample_front_end_thread_load() {
+    std::unique_lock<std::mutex> lock(load_sample_mutex, std::try_to_lock);
+    if (!lock) {
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const auto elapsed = now - last_load_sample;
+    if (elapsed < loadSampleInterval) {
+        return;
+    }
+
+    for (auto& thr : threads) {
+        const uint64_t busy = thr.busy_time;
+        // Normalise to one sample interval, as we may not have been called
+        // for a while
+        thr.recent_busy_time = uint64_t(
+                double(busy - thr.busy_time_at_sample) *
+                loadSampleInterval.count() /
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                        .count());
+        thr.busy_time_at_sample = busy;
+    }
+    last_load_sample = now;
+}
+
+/* Percentage of the last load sample interval the thread was busy. */
+static uint64_t get_utilization(const FrontEndThread& thr) {
+    return std::min(uint64_t(100),
+                    thr.recent_busy_time * 100 / loadSampleInterval.count());
+}
+
+static bool is_less_loaded(const FrontEndThread& a, const FrontEndThread& b) {
+    const auto ua = get_utilization(a) / placementGranularity;
+    const auto ub = get_utilization(b) / placementGranularity;
+    if (ua != ub) {
+        return ua < ub;
+    }
+    return a.num_connections < b.num_connections;
+}
+
+std::vector<FrontEndThreadLoad> get_front_end_thread_load() {
+    sample_front_end_thread_load();
+    std::vector<FrontEndThreadLoad> ret;
+    for (const auto& thr : threads) {
+        ret.push_back({thr.num_connections,
+                       thr.busy_time / 1000,
+                       get_utilization(thr),
+                       thr.migrated_in,
+                       thr.migrated_out});
+    }
+    return ret;
+}
+
+void maybe_migrate_connection(Connection& c) {
+    auto* from = c.getThread();
+    if (!settings.isConnectionRebalanceEnabled() || threads.size() < 2 ||
+        from == nullptr) {
+        return;
+    }
+
+    // Measure the connection's own load over (roughly) a sample interval
+    const auto now = std::chrono::steady_clock::now();
+    auto& sample = c.getLoadSample();
+    const auto elapsed = now - sample.time;
+    if (elapsed < loadSampleInterval) {
+        return;
+    }
+    const bool first = sample.time == std::chrono::steady_clock::time_point{};
+    const auto cpu = c.getTotalCpuTime();
+    const auto connBusy = uint64_t(
+            double((cpu - sample.cpu_time).count()) *
+            loadSampleInterval.count() /
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                    .count());
+    sample.time = now;
+    sample.cpu_time = cpu;
+
+    if (first || connBusy == 0 ||
+        now - sample.last_migration < migrationHoldoff || !c.isMigratable()) {
+        return;
+    }
+
+    sample_front_end_thread_load();
+    if (get_utilization(*from) < migrationMinUtilization) {
+        return;
+    }
+
+    FrontEndThread* to = &threads.front();
+    for (auto& thr : threads) {
+        if (thr.recent_busy_time < to->recent_busy_time) {
+            to = &thr;
+        }
+    }
+
+    // Only move the connection if its old thread would still be at least
+    // as busy as its new one; otherwise we'd just be moving the hot spot
+    // (and would probably move it straight back).
+    const uint64_t fromBusy = from->recent_busy_time;
+    const uint64_t toBusy = to->recent_busy_time;
+    if (to == from || fromBusy < toBusy + 2 * connBusy) {
+        return;
+    }
+
+    if (!c.unregisterEvent()) {
+        return;
+    }
+    from->notification.remove(&c);
+    conn_migrate(c, *to);
+    sample.last_migration = now;
+
+    // Account for the move straight away, so that one sample interval
+    // doesn't move many connections onto the same thread
+    to->recent_busy_time += connBusy;
+    ++from->migrated_out;
+    ++to->migrated_in;
+
+    LOG_DEBUG("{}: Moving connection from worker thread {} to {}",
+              c.getId(),
+              from->index,
+              to->index);
+    to->migrated.push(&c);
+    notify_thread(*to);
+}
+
 /* Which thread we assigned a connection to most recently. */
 static size_t last_thread = 0;
 
+/*
+ * Pick the front-end thread for a new connection: the least loaded one
+ * (by recent utilization, then number of connections), going round-robin
+ * between equally loaded threads.
+ */
+static FrontEndThread& pick_thread() {
+    sample_front_end_thread_load();
+    const auto nthreads = threads.size();
+    size_t tid = (last_thread + 1) % nthreads;
+    for (size_t ii = 1; ii < nthreads; ++ii) {
+        const auto candidate = (last_thread + 1 + ii) % nthreads;
+        if (is_less_loaded(threads[candidate], threads[tid])) {
+            tid = candidate;
+        }
+    }
+    last_thread = tid;
+    return threads[tid];
+}
+
 /*
  * Dispatches a new connection to another thread. This is only ever called
  * from the main thread, or because of an incoming connection.
  */
-void dispatch_conn_new(SOCKET sfd, SharedListeningPort& interface) {
-    size_t tid = (last_thread + 1) % settings.getNumWorkerThreads();
-    auto& thread = threads[tid];
-    last_thread = tid;
+void dispatch_conn_new(SOCKET sfd,
+                       SharedListeningPort& interface,
+                       FrontEndThread* acceptor) {
+    if (acceptor != nullptr) {
+        // Accepted by the thread's own listening socket, in its own event
+        // loop - serve it there without any handoff.
+        ++acceptor->num_connections;
+        if (conn_new(sfd, *interface, acceptor->base, acceptor) == nullptr) {
+            LOG_WARNING("Failed to dispatch event for socket {}", long(sfd));
+            --acceptor->num_connections;
+            if (interface->system) {
+                --stats.system_conns;
+            }
+            safe_close(sfd);
+        }
+        return;
+    }
+
+    auto& thread = pick_thread();
+    // Count the connection against the thread straight away, so a burst of
+    // new connections is spread out
+    ++thread.num_connections;
 
     try {
         thread.new_conn_queue.push(sfd, interface);
     } catch (const std::bad_alloc& e) {
         LOG_WARNING("dispatch_conn_new: Failed to dispatch new connection: {}",
                     e.what());
+        --thread.num_connections;
 
         if (interface->system) {
             --stats.system_conns;
@@ -416,6 +722,10 @@ void dispatch_conn_new(SOCKET sfd, SharedListeningPort& interface) {
     notify_thread(thread);
 }
 
+FrontEndThread& get_front_end_thread(size_t index) {
+    return threads.at(index);
+}
+
 /*
  * Returns true if this is the thread that listens for new TCP connections.
  */
@@ -431,9 +741,9 @@ void notify_dispatcher() {
 
 /******************************* GLOBAL STATS ******************************/
 
-void threadlocal_stats_reset(std::vector<thread_stats>& thread_stats) {
+void threadlocal_stats_reset(ThreadStatsSlots& thread_stats) {
     for (auto& ii : thread_stats) {
-        ii.reset();
+        ii->reset();
     }
 }
 
@@ -447,6 +757,7 @@ void thread_init(size_t nthr,
                  struct event_base* main_base,
                  void (*dispatcher_callback)(evutil_socket_t, short, void*)) {
     scheduler_info.resize(nthr);
+    run_queue_info.resize(nthr);
 
     try {
         threads = std::vector<FrontEndThread>(nthr);
@@ -457,7 +768,7 @@ void thread_init(size_t nthr,
     setup_dispatcher(main_base, dispatcher_callback);
 
     for (size_t ii = 0; ii < nthr; ii++) {
-        if (!create_notification_pipe(threads[ii])) {
+        if (!create_notification_channel(threads[ii])) {
             FATAL_ERROR(EXIT_FAILURE, "Cannot create notification pipe");
         }
         threads[ii].index = ii;
@@ -504,6 +815,10 @@ void threads_cleanup() {
 }
 
 FrontEndThread::~FrontEndThread() {
+    if (notify_eventfd) {
+        // Both entries hold the same eventfd
+        notify[1] = INVALID_SOCKET;
+    }
     for (auto& sock : notify) {
         if (sock != INVALID_SOCKET) {
             safe_close(sock);
@@ -511,7 +826,17 @@ FrontEndThread::~FrontEndThread() {
     }
 }
 
-void notify_thread(FrontEndThread& thread) {
+static void send_notification(FrontEndThread& thread) {
+#ifdef __linux__
+    if (thread.notify_eventfd) {
+        const uint64_t one = 1;
+        if (write(thread.notify[1], &one, sizeof(one)) == -1 &&
+            errno != EAGAIN) {
+            LOG_WARNING("Failed to notify thread: {}", cb_strerror());
+        }
+        return;
+    }
+#endif
     if (cb::net::send(thread.notify[1], "", 1, 0) != 1 &&
         !cb::net::is_blocking(cb::net::get_socket_error())) {
         LOG_WARNING("Failed to notify thread: {}",
@@ -519,6 +844,169 @@ void notify_thread(FrontEndThread& thread) {
     }
 }
 
+void notify_thread(FrontEndThread& thread) {
+    if (&thread == &dispatcher_thread) {
+        // The dispatcher drains its channel in dispatch_event_handler,
+        // which doesn't know about notification_pending.
+        send_notification(thread);
+        return;
+    }
+
+    if (!thread.notification_pending.exchange(true)) {
+        send_notification(thread);
+    }
+}
+
+/*
+ * Give each of the connections on the run queue another timeslice:
+ * highest priority first, and each for up to its priority's
+ * reqs_per_event. Connections which yield again are run in the next
+ * round, which is scheduled after libevent has polled for IO (so new
+ * requests on other connections don't wait for the run queue to drain).
+ */
+static void run_queue_handler(evutil_socket_t, short, void* arg) {
+    auto& me = *reinterpret_cast<FrontEndThread*>(arg);
+    me.run_queue_scheduled = false;
+
+    for (size_t priority = 0; priority < me.run_queue.size(); ++priority) {
+        auto& queue = me.run_queue[priority];
+        auto& histogram = run_queue_info[me.index][priority];
+        for (auto count = queue.size(); count > 0 && !queue.empty(); --count) {
+            auto* c = queue.front().first;
+            histogram.add(std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - queue.front().second));
+            queue.pop_front();
+
+            TRACE_LOCKGUARD_TIMED(me.mutex,
+                                  "mutex",
+                                  "run_queue_handler::threadLock",
+                                  SlowMutexThreshold);
+            run_event_loop(c, EV_READ);
+        }
+    }
+}
+
+void schedule_connection(Connection& c) {
+    auto& thread = *c.getThread();
+    thread.run_queue[size_t(c.getPriority())].emplace_back(
+            &c, std::chrono::steady_clock::now());
+
+    if (!thread.run_queue_scheduled) {
+        const timeval zero = {0, 0};
+        if (event_add(&thread.run_queue_event, &zero) == -1) {
+            FATAL_ERROR(EXIT_FAILURE, "Can't schedule the run queue event");
+        }
+        thread.run_queue_scheduled = true;
+    }
+}
+
+/*
+ * (Re)arm the thread's throttle_event to fire when the first of its
+ * throttled connections may try again.
+ */
+static void schedule_throttle_event(FrontEndThread& thread) {
+    if (thread.throttled.empty()) {
+        return;
+    }
+
+    auto next = thread.throttled.front().until;
+    for (const auto& entry : thread.throttled) {
+        next = std::min(next, entry.until);
+    }
+    if (thread.throttle_scheduled != std::chrono::steady_clock::time_point{} &&
+        thread.throttle_scheduled <= next) {
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const auto usec =
+            next > now ? std::chrono::duration_cast<std::chrono::microseconds>(
+                                 next - now)
+                                 .count()
+                       : 0;
+    const timeval tv = {long(usec / 1000000), long(usec % 1000000)};
+    if (event_add(&thread.throttle_event, &tv) == -1) {
+        FATAL_ERROR(EXIT_FAILURE, "Can't schedule the throttle event");
+    }
+    thread.throttle_scheduled = next;
+}
+
+/*
+ * Resume the throttled connections whose time has come. They start their
+ * command again, and if their bucket is (still, or again) over budget
+ * they're deferred to the back of the queue.
+ */
+static void throttle_handler(evutil_socket_t, short, void* arg) {
+    auto& me = *reinterpret_cast<FrontEndThread*>(arg);
+    me.throttle_scheduled = {};
+
+    const auto now = std::chrono::steady_clock::now();
+    for (auto count = me.throttled.size(); count > 0 && !me.throttled.empty();
+         --count) {
+        const auto entry = me.throttled.front();
+        me.throttled.pop_front();
+        if (entry.until > now) {
+            me.throttled.push_back(entry);
+            continue;
+        }
+
+        auto* c = entry.connection;
+        c->getBucket().throttle.waitTimes.add(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                        now - entry.deferred));
+
+        TRACE_LOCKGUARD_TIMED(me.mutex,
+                              "mutex",
+                              "throttle_handler::threadLock",
+                              SlowMutexThreshold);
+        run_event_loop(c, EV_READ);
+    }
+
+    schedule_throttle_event(me);
+}
+
+void throttle_connection(Connection& c,
+                         std::chrono::steady_clock::time_point until) {
+    auto& thread = *c.getThread();
+    thread.throttled.push_back({&c, std::chrono::steady_clock::now(), until});
+    schedule_throttle_event(thread);
+}
+
+void unschedule_connection(Connection& c) {
+    auto* thread = c.getThread();
+    if (thread == nullptr) {
+        return;
+    }
+    {
+        auto iter = std::find_if(
+                thread->throttled.begin(),
+                thread->throttled.end(),
+                [&c](const auto& entry) { return entry.connection == &c; });
+        if (iter != thread->throttled.end()) {
+            thread->throttled.erase(iter);
+            return;
+        }
+    }
+    for (auto& queue : thread->run_queue) {
+        auto iter = std::find_if(
+                queue.begin(), queue.end(), [&c](const auto& entry) {
+                    return entry.first == &c;
+                });
+        if (iter != queue.end()) {
+            queue.erase(iter);
+            return;
+        }
+    }
+}
+
+Hdr1sfMicroSecHistogram get_run_queue_wait(size_t priority) {
+    Hdr1sfMicroSecHistogram ret{};
+    for (const auto& info : run_queue_info) {
+        ret += info.at(priority);
+    }
+    return ret;
+}
+
 int add_conn_to_pending_io_list(Connection* c,
                                 Cookie* cookie,
                                 ENGINE_ERROR_CODE status) {
@@ -15,7 +15,11 @@
  *   limitations under the License.
  */
 #include "timings.h"
+#include <mcbp/mcbp.h>
 #include <memcached/protocol_binary.h>
+#include <tracing/tracer.h>
+
+#include <cmath>
 
 Timings::Timings() {
     reset();
@@ -27,26 +31,76 @@ void Timings::reset() {
             t->reset();
         }
     }
+    for (auto& spans : span_timings) {
+        if (spans) {
+            for (auto& t : *spans) {
+                if (t) {
+                    t->reset();
+                }
+            }
+        }
+    }
+
+    keyed_timings.reset();
 
     {
         std::lock_guard<std::mutex> lg(lock);
         interval_latency_lookups.reset();
         interval_latency_mutations.reset();
+        for (auto& interval : interval_timings) {
+            if (interval) {
+                for (auto& h : interval->histograms) {
+                    h.reset();
+                }
+            }
+        }
+        for (auto& threshold : slow_thresholds) {
+            threshold = std::chrono::nanoseconds::zero();
+        }
     }
 }
 
 void Timings::collect(cb::mcbp::ClientOpcode opcode,
                       std::chrono::nanoseconds nsec) {
     using namespace std::chrono;
-    get_or_create_timing_histogram(
-            std::underlying_type<cb::mcbp::ClientOpcode>::type(opcode))
-            .add(duration_cast<microseconds>(nsec));
+    const auto op = std::underlying_type<cb::mcbp::ClientOpcode>::type(opcode);
+    const auto usec = duration_cast<microseconds>(nsec);
+    get_or_create_timing_histogram(op).add(usec);
+    auto& histograms = get_or_create_interval_histograms(op);
+    histograms.histograms[histograms.current].add(usec);
     auto& interval = interval_counters
             [std::underlying_type<cb::mcbp::ClientOpcode>::type(opcode)];
     interval.count++;
     interval.duration_ns += nsec.count();
 }
 
+void Timings::collect(cb::mcbp::ClientOpcode opcode,
+                      const cb::tracing::Tracer& tracer) {
+    using namespace std::chrono;
+    const auto op = std::underlying_type<cb::mcbp::ClientOpcode>::type(opcode);
+    for (const auto& span : tracer.getDurations()) {
+        if (span.code == cb::tracing::TraceCode::REQUEST ||
+            span.duration == cb::tracing::Span::Duration::max()) {
+            continue;
+        }
+        const auto code = size_t(span.code);
+        if (span_timings[op] == nullptr) {
+            std::lock_guard<std::mutex> allocLock(histogram_mutex);
+            if (span_timings[op] == nullptr) {
+                span_timings[op] = std::make_unique<SpanHistograms>();
+            }
+        }
+        auto& histogram = (*span_timings[op])[code];
+        if (histogram == nullptr) {
+            std::lock_guard<std::mutex> allocLock(histogram_mutex);
+            if (histogram == nullptr) {
+                histogram = std::make_unique<Hdr1sfMicroSecHistogram>();
+            }
+        }
+        histogram->add(duration_cast<microseconds>(span.duration));
+    }
+}
+
 std::string Timings::generate(cb::mcbp::ClientOpcode opcode) {
     auto* histoPtr =
             timings[std::underlying_type<cb::mcbp::ClientOpcode>::type(opcode)]
@@ -152,12 +206,62 @@ Hdr1sfMicroSecHistogram& Timings::get_or_create_timing_histogram(
     return *timings[opcode];
 }
 
+Timings::IntervalHistograms& Timings::get_or_create_interval_histograms(
+        uint8_t opcode) {
+    if (interval_timings[opcode] == nullptr) {
+        std::lock_guard<std::mutex> allocLock(histogram_mutex);
+        if (interval_timings[opcode] == nullptr) {
+            interval_timings[opcode] = std::make_unique<IntervalHistograms>();
+        }
+    }
+    return *interval_timings[opcode];
+}
+
+Hdr1sfMicroSecHistogram Timings::get_interval_histogram(uint8_t opcode) {
+    std::lock_guard<std::mutex> lg(lock);
+    const auto* interval = interval_timings[opcode].get();
+    if (interval == nullptr) {
+        return {};
+    }
+    return interval->histograms[1 - interval->current];
+}
+
 Hdr1sfMicroSecHistogram* Timings::get_timing_histogram(uint8_t opcode) const {
     return timings[opcode].get();
 }
 
+Hdr1sfMicroSecHistogram* Timings::get_span_histogram(
+        uint8_t opcode, cb::tracing::TraceCode code) const {
+    const auto* spans = span_timings[opcode].get();
+    if (spans == nullptr) {
+        return nullptr;
+    }
+    return (*spans)[size_t(code)].get();
+}
+
+/**
+ * Get the adaptive slow operation threshold for an opcode from the
+ * histogram of its last interval; zero if the interval had too few
+ * operations to give the configured percentile.
+ */
+static std::chrono::nanoseconds getSlowThreshold(
+        const Hdr1sfMicroSecHistogram& histogram,
+        const cb::mcbp::sla::AdaptiveConfig& config) {
+    const auto minSamples = std::ceil(100.0 / (100.0 - config.percentile));
+    if (double(histogram.getValueCount()) < minSamples) {
+        return std::chrono::nanoseconds::zero();
+    }
+    const std::chrono::duration<double, std::micro> value(
+            histogram.getValueAtPercentile(config.percentile) *
+            config.factor);
+    return std::max(
+            config.minimum,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(value));
+}
+
 void Timings::sample(std::chrono::seconds sample_interval) {
     cb::sampling::Interval interval_lookup, interval_mutation;
+    const auto adaptive = cb::mcbp::sla::getAdaptiveConfig();
 
     for (auto op : timings_mutations) {
         interval_mutation += interval_counters
@@ -179,5 +283,31 @@ void Timings::sample(std::chrono::seconds sample_interval) {
         std::lock_guard<std::mutex> lg(lock);
         interval_latency_lookups.sample(interval_lookup);
         interval_latency_mutations.sample(interval_mutation);
+
+        // A command which read the old index just before the switch is
+        // recorded in the last interval rather than the new one; that's
+        // cheaper than making collect() take the lock.
+        for (size_t op = 0; op < interval_timings.size(); ++op) {
+            auto& interval = interval_timings[op];
+            if (!interval) {
+                continue;
+            }
+            const uint8_t next = 1 - interval->current;
+            interval->histograms[next].reset();
+            interval->current = next;
+
+            if (!adaptive.enabled) {
+                slow_thresholds[op] = std::chrono::nanoseconds::zero();
+                continue;
+            }
+            // An opcode without enough operations in the interval keeps its
+            // threshold from the last interval which had
+            const auto threshold =
+                    getSlowThreshold(interval->histograms[1 - next], adaptive);
+            if (threshold.count() != 0) {
+                slow_thresholds[op] = threshold;
+            }
+        }
+        ++interval_sequence;
     }
 }
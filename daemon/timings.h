@@ -16,17 +16,26 @@
  */
 #pragma once
 
+#include "keyed_timings.h"
 #include "timing_interval.h"
 
 #include <mcbp/protocol/opcode.h>
+#include <tracing/tracetypes.h>
 
 #include <utilities/hdrhistogram.h>
 #include <array>
+#include <atomic>
 #include <mutex>
 #include <string>
 
 #define MAX_NUM_OPCODES 0x100
 
+namespace cb {
+namespace tracing {
+class Tracer;
+} // namespace tracing
+} // namespace cb
+
 /** Records timings for each memcached opcode. Each opcode has a histogram of
  * times.
  */
@@ -37,6 +46,15 @@ public:
 
     void reset();
     void collect(cb::mcbp::ClientOpcode opcode, std::chrono::nanoseconds nsec);
+
+    /**
+     * Record the duration of each (completed) span a command's tracer holds
+     * below the request itself - such as the time the engine spent waiting
+     * for a hash bucket lock or a background fetch.
+     */
+    void collect(cb::mcbp::ClientOpcode opcode,
+                 const cb::tracing::Tracer& tracer);
+
     void sample(std::chrono::seconds sample_interval);
     std::string generate(cb::mcbp::ClientOpcode opcode);
     uint64_t get_aggregated_mutation_stats();
@@ -52,6 +70,47 @@ public:
      */
     Hdr1sfMicroSecHistogram* get_timing_histogram(uint8_t opcode) const;
 
+    /**
+     * Get a pointer to the histogram of the durations of the given span
+     * within the specified opcode, or nullptr if none has been recorded.
+     */
+    Hdr1sfMicroSecHistogram* get_span_histogram(
+            uint8_t opcode, cb::tracing::TraceCode code) const;
+
+    /**
+     * Get a copy of the histogram of the commands with the specified opcode
+     * which completed in the last (complete) interval passed to sample().
+     * The histogram is empty if there were none.
+     */
+    Hdr1sfMicroSecHistogram get_interval_histogram(uint8_t opcode);
+
+    /**
+     * The number of intervals sampled, so that a client polling
+     * get_interval_histogram() can tell whether it has already seen the
+     * last interval.
+     */
+    uint64_t get_interval_sequence() const {
+        return interval_sequence;
+    }
+
+    /**
+     * The adaptive slow operation threshold of the specified opcode (see
+     * cb::mcbp::sla::AdaptiveConfig), which sample() derives from the
+     * durations of the last interval. Zero if it has none (or adaptive
+     * thresholds aren't enabled).
+     */
+    std::chrono::nanoseconds get_slow_threshold(uint8_t opcode) const {
+        return slow_thresholds[opcode].load(std::memory_order_relaxed);
+    }
+
+    /**
+     * The per vbucket and per collection histograms of the GET, SET and
+     * DELETE commands (only recorded if keyed_timings_enabled is set).
+     */
+    KeyedTimings& get_keyed_timings() {
+        return keyed_timings;
+    }
+
 private:
     /**
      * Method to get histogram for timing, if the histogram hasn't been created
@@ -59,9 +118,23 @@ private:
      */
     Hdr1sfMicroSecHistogram& get_or_create_timing_histogram(uint8_t opcode);
 
+    /**
+     * The histograms of an opcode's commands completed in the current
+     * interval (which collect() adds to) and in the last interval. sample()
+     * resets the last interval's histogram and makes it the current one,
+     * so that the commands are never recorded under the lock.
+     */
+    struct IntervalHistograms {
+        std::array<Hdr1sfMicroSecHistogram, 2> histograms;
+        std::atomic<uint8_t> current{0};
+    };
+
+    IntervalHistograms& get_or_create_interval_histograms(uint8_t opcode);
+
     // This lock is only held by sample() and some blocks within generate().
     // It guards the various IntervalSeries variables which internally
-    // contain cb::RingBuffer objects which are not thread safe.
+    // contain cb::RingBuffer objects which are not thread safe (and the
+    // switch of the interval histograms).
     std::mutex lock;
 
     cb::sampling::IntervalSeries interval_latency_lookups;
@@ -71,6 +144,18 @@ private:
     // histogram class
     std::array<std::unique_ptr<Hdr1sfMicroSecHistogram>, MAX_NUM_OPCODES>
             timings;
+    // The span histograms of an opcode; created when a traced command
+    // first completes with the opcode (and the span code).
+    using SpanHistograms =
+            std::array<std::unique_ptr<Hdr1sfMicroSecHistogram>,
+                       cb::tracing::NumTraceCodes>;
+    std::array<std::unique_ptr<SpanHistograms>, MAX_NUM_OPCODES> span_timings;
+    std::array<std::unique_ptr<IntervalHistograms>, MAX_NUM_OPCODES>
+            interval_timings;
+    std::atomic<uint64_t> interval_sequence{0};
+    std::array<std::atomic<std::chrono::nanoseconds>, MAX_NUM_OPCODES>
+            slow_thresholds{};
     std::mutex histogram_mutex;
     std::array<cb::sampling::Interval, MAX_NUM_OPCODES> interval_counters;
+    KeyedTimings keyed_timings;
 };
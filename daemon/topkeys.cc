@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <gsl/gsl>
 #include <stdexcept>
@@ -31,66 +32,43 @@
  *
  * === TopKeys ===
  *
- * The TopKeys class is split into NUM_SHARDS shards, each which owns
- * 1/NUM_SHARDS of the keyspace. This is to allow some level of
- * concurrent access - each shard has a mutex guarding all access.
- * Other than that the TopKeys class is pretty uninteresting - it
- * simply passes on requests to the correct Shard, and when statistics
- * are requested it aggregates information from each shard.
- *
- * === TopKeys::Shard ===
- *
- * This is where the action happens. Each Shard maintains an ordered
- * list of key names and related statistics, orded by when they were
- * last accessed. There is a fixed number of keys each Shard tracks.
-
- * Given we generally track only a small number of keys per shard (10
- * by default), it's highly likely that any one key access will 'miss'
- * - i.e. not find an existing topkey. Therefore this class is
- * optimized for that case, attempting to minimise memory allocation
- * in steady-state.
- *
- * Internally Shard consists of a vector of topkey_t, storing the
- * current max_keys top_keys, and a list of topkey_t pointers, used to
- * main the current most -> least recently used ordering:
-
- * max_keys elements. Each element is a tuple of
- * {hash(key), key, topkey_stats}:
+ * updateKey() is called for every keyed operation, so (unlike the stats
+ * calls) it must not be a point of contention between the front end
+ * threads - in particular when many of them access the same hot key, which
+ * is exactly when the topkeys are most interesting.
  *
+ * The TopKeys class is therefore split into shards by thread rather than by
+ * key: each thread is given its own Shard (for up to nshards threads), which
+ * tracks the keys accessed by that thread. Each shard still has a mutex, but
+ * it is only contended on by the (rare) stats calls, which merge the shards
+ * (adding up the counts of each key) to report the overall top keys.
  *
- *       vector<topkey_t>
- *   +----------+-------------+---------------+
- *   | size_t   | std::string | topkey_item_t |
- *   +----------+-------------+---------------+
- *   | <hash 1> | <key 1>     | stats 1       | <--- Node1
- *   | <hash 2> | <key 2>     | stats 2       | <--- Node2
- *   | <hash 3> | <key 3>     | stats 3       | <--- Node3
- *   . ....                                   .
- *   | <hash N> | <key N>     | stats N       | <--- NodeN
- *   +----------------------------------------+
- *
- *   Node3 <---> Node1 <---> ... <---> Node2
- *   ^^^                               ^^^
- *   MRU                               LRU
- *
+ * === TopKeys::Shard ===
  *
- * Upon a key 'hit', TopKeys::updateKey() is called. That hashes the
- * key, and finds the Shard responsible for that
- * key. TopKeys::Shard::updateKey() is then called.
+ * Each Shard tracks the most frequently accessed keys with the Space-Saving
+ * algorithm: it has a fixed number (max_keys) of counters, one per tracked
+ * key. An access to a tracked key increments its counter; an access to any
+ * other key takes over the counter with the lowest count (min), and
+ * increments it. The count of a tracked key is hence overestimated by at
+ * most min, which is at most (accesses / max_keys); and any key accessed
+ * more often than that is guaranteed to be tracked.
  *
- * Shard::updateKey() iterates over the vector, searching for a hash
- * match with an existing element, using the actual key string to
- * validate (in case of a hash collision). If it is found, then the
- * stats are simply updated.  If it is not found, then the
- * least-recently-used element is selected as a 'victim' and it's
- * contents is replaced by the incoming key.  Finally the linked-list
- * is updated to move the updated element to the head of the list.
+ * The counters are kept in `order`, sorted by ascending count, so the
+ * victim is always at the front. As counts only ever increase by one, an
+ * increment keeps the order by first swapping the counter with the last
+ * counter of the same count (found by binary search). `index` maps keys
+ * (views of each counter's copy of its key) to their counter.
  */
 
+const size_t TopKeys::KEYS_PER_MKEY;
+const size_t TopKeys::DEFAULT_SHARDS;
 
-TopKeys::TopKeys(int mkeys) {
+static std::atomic<size_t> next_thread_id{0};
+
+TopKeys::TopKeys(int mkeys, size_t nshards)
+    : max_keys(mkeys * KEYS_PER_MKEY), shards(std::max(nshards, size_t(1))) {
     for (auto& shard : shards) {
-        shard.setMaxKeys(mkeys);
+        shard.setMaxKeys(max_keys);
     }
 }
 
@@ -124,72 +102,75 @@ ENGINE_ERROR_CODE TopKeys::json_stats(nlohmann::json& object,
     return ENGINE_SUCCESS;
 }
 
-TopKeys::Shard& TopKeys::getShard(size_t key_hash) {
-    /* This is special-cased for 8 */
-    static_assert(NUM_SHARDS == 8,
-                  "Topkeys::getShard() special-cased for SHARDS==8");
-    return shards[key_hash & 0x7];
+TopKeys::Shard& TopKeys::getShard() {
+    static thread_local const size_t thread_id = next_thread_id++;
+    return shards[thread_id % shards.size()];
 }
 
-TopKeys::Shard::topkey_t*
-TopKeys::Shard::searchForKey(size_t key_hash,
-                             const cb::const_char_buffer& key) {
-
-    for (auto& topkey : storage) {
-        if (topkey.first.hash == key_hash) {
-            // Double-check with full compare
-            if (topkey.first.key.compare(0, topkey.first.key.size(),
-                                         key.buf, key.len) == 0) {
-                // Match found.
-                return &topkey;
-            }
-        }
+void TopKeys::Shard::setMaxKeys(size_t mkeys) {
+    max_keys = mkeys;
+    index.clear();
+    order.clear();
+    storage.clear();
+    storage.reserve(max_keys);
+    order.reserve(max_keys);
+}
+
+void TopKeys::Shard::increment(Counter& counter) {
+    const auto count = counter.item.ti_access_count;
+    auto last = std::upper_bound(order.begin() + counter.rank,
+                                 order.end(),
+                                 count,
+                                 [](int value, const Counter* other) {
+                                     return value < other->item.ti_access_count;
+                                 }) -
+                1;
+    if ((*last) != &counter) {
+        const auto rank = counter.rank;
+        (*last)->rank = rank;
+        order[rank] = *last;
+        counter.rank = last - order.begin();
+        *last = &counter;
     }
-    return nullptr;
+    counter.item.ti_access_count++;
 }
 
 bool TopKeys::Shard::updateKey(const cb::const_char_buffer& key,
-                               size_t key_hash,
                                const rel_time_t ct) {
     try {
         std::lock_guard<std::mutex> lock(mutex);
 
-        topkey_t* found_key = searchForKey(key_hash, key);
-
-        if (found_key == NULL) {
-            // Key not found.
-            if (storage.size() == max_keys) {
-                // Re-use the lowest keys' storage.
-                found_key = list.back();
-                found_key->first.hash = key_hash;
-                found_key->first.key.assign(key.buf, key.len);
-                found_key->second = topkey_item_t(ct);
-
-                // Move back element to the front, shuffling down the
-                // rest.
-                list.splice(list.begin(), list, --list.end());
-
-            } else {
-                // add a new element to the storage array.
-
-                storage.emplace_back(
-                    std::make_pair(KeyId{key_hash,
-                                         std::string(key.buf, key.len)},
-                                   topkey_item_t(ct)));
-                found_key = &storage.back();
+        auto found = index.find(key);
+        if (found != index.end()) {
+            increment(*found->second);
+            return true;
+        }
 
-                // Insert the new item to the front of the list
-                list.push_front(found_key);
-            }
+        Counter* counter;
+        if (storage.size() == max_keys) {
+            // Take over the counter with the lowest count (keeping its
+            // count).
+            counter = order.front();
+            index.erase({counter->key.data(), counter->key.size()});
+            counter->key.assign(key.buf, key.len);
+            const auto count = counter->item.ti_access_count;
+            counter->item = topkey_item_t(ct);
+            counter->item.ti_access_count = count;
         } else {
-            // Found - shuffle to the front.
-            auto it = std::find(list.begin(), list.end(),
-                                found_key);
-            list.splice(list.begin(), list, it);
+            // Add a new counter, with the lowest count of all (zero).
+            storage.push_back({std::string(key.buf, key.len),
+                               topkey_item_t(ct),
+                               0});
+            counter = &storage.back();
+            order.insert(order.begin(), counter);
+            for (size_t rank = 0; rank < order.size(); ++rank) {
+                order[rank]->rank = rank;
+            }
         }
-
-        // Increment access count.
-        found_key->second.ti_access_count++;
+        index.emplace(cb::const_char_buffer{counter->key.data(),
+                                            counter->key.size()},
+                      counter);
+        increment(*counter);
         return true;
 
     } catch (const std::bad_alloc&) {
@@ -198,6 +179,19 @@ bool TopKeys::Shard::updateKey(const cb::const_char_buffer& key,
     }
 }
 
+void TopKeys::Shard::collect(
+        std::unordered_map<std::string, topkey_item_t>& keys) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& counter : storage) {
+        auto result = keys.emplace(counter.key, counter.item);
+        if (!result.second) {
+            auto& item = result.first->second;
+            item.ti_access_count += counter.item.ti_access_count;
+            item.ti_ctime = std::min(item.ti_ctime, counter.item.ti_ctime);
+        }
+    }
+}
+
 void TopKeys::doUpdateKey(const void* key,
                           size_t nkey,
                           rel_time_t operation_time) {
@@ -206,15 +200,8 @@ void TopKeys::doUpdateKey(const void* key,
                 "TopKeys::doUpdateKey: key must be specified");
     }
 
-    try {
-        cb::const_char_buffer key_buf(static_cast<const char*>(key), nkey);
-        std::hash<cb::const_char_buffer > hash_fn;
-        const size_t key_hash = hash_fn(key_buf);
-
-        getShard(key_hash).updateKey(key_buf, key_hash, operation_time);
-    } catch (const std::bad_alloc&) {
-        // Failed to increment topkeys, continue...
-    }
+    cb::const_char_buffer key_buf(static_cast<const char*>(key), nkey);
+    getShard().updateKey(key_buf, operation_time);
 }
 
 struct tk_context {
@@ -288,9 +275,7 @@ ENGINE_ERROR_CODE TopKeys::doStats(const void* cookie,
                                    const AddStatFn& add_stat) {
     struct tk_context context(cookie, add_stat, current_time, nullptr);
 
-    for (auto& shard : shards) {
-        shard.accept_visitor(tk_iterfunc, &context);
-    }
+    accept_visitor(tk_iterfunc, &context);
 
     return ENGINE_SUCCESS;
 }
@@ -311,18 +296,30 @@ ENGINE_ERROR_CODE TopKeys::do_json_stats(nlohmann::json& object,
     struct tk_context context(nullptr, nullptr, current_time, &topkeys);
 
     /* Collate the topkeys JSON object */
-    for (auto& shard : shards) {
-        shard.accept_visitor(tk_jsonfunc, &context);
-    }
+    accept_visitor(tk_jsonfunc, &context);
 
     object["topkeys"] = topkeys;
     return ENGINE_SUCCESS;
 }
 
-void TopKeys::Shard::accept_visitor(iterfunc_t visitor_func,
-                                    void* visitor_ctx) {
-    std::lock_guard<std::mutex> lock(mutex);
-    for (const auto key : list) {
-        visitor_func(key->first.key, key->second, visitor_ctx);
+void TopKeys::accept_visitor(iterfunc_t visitor_func, void* visitor_ctx) {
+    std::unordered_map<std::string, topkey_item_t> keys;
+    for (auto& shard : shards) {
+        shard.collect(keys);
+    }
+
+    std::vector<std::pair<std::string, topkey_item_t>> top(keys.begin(),
+                                                           keys.end());
+    const auto count = std::min(top.size(), max_keys);
+    std::partial_sort(
+            top.begin(),
+            top.begin() + count,
+            top.end(),
+            [](const std::pair<std::string, topkey_item_t>& a,
+               const std::pair<std::string, topkey_item_t>& b) {
+                return a.second.ti_access_count > b.second.ti_access_count;
+            });
+    for (size_t ii = 0; ii < count; ++ii) {
+        visitor_func(top[ii].first, top[ii].second, visitor_ctx);
     }
 }
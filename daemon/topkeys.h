@@ -19,18 +19,18 @@
 #include <memcached/engine.h>
 #include <nlohmann/json_fwd.hpp>
 #include <platform/sized_buffer.h>
-#include <array>
 
+#include <cstring>
 #include <mutex>
-#include <list>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 /*
  * TopKeys
  *
- * Tracks the top N most recently accessed keys. The details are
- * accessible by a stats call, which is used by ns_server to print the
+ * Tracks (approximately) the N most frequently accessed keys. The details
+ * are accessible by a stats call, which is used by ns_server to print the
  * top keys list in the GUI.
  */
 
@@ -48,10 +48,13 @@ struct topkey_item_t {
 class TopKeys {
 public:
     /* Constructor.
-     * @param mkeys Number of keys stored in each shard (i.e. up to
-     * mkeys * SHARDS will be tracked).
+     * @param mkeys Scales the number of keys tracked (and reported): up to
+     *        mkeys * KEYS_PER_MKEY.
+     * @param nshards Number of shards the accesses are split over; each
+     *        thread updating keys uses its own shard, so this should be (at
+     *        least) the number of those threads.
      */
-    explicit TopKeys(int mkeys);
+    explicit TopKeys(int mkeys, size_t nshards = DEFAULT_SHARDS);
     ~TopKeys();
 
     void updateKey(const void* key, size_t nkey, rel_time_t operation_time);
@@ -77,6 +80,11 @@ public:
     ENGINE_ERROR_CODE json_stats(nlohmann::json& object,
                                  rel_time_t current_time);
 
+    // The number of keys tracked for each unit of mkeys.
+    static const size_t KEYS_PER_MKEY = 8;
+
+    static const size_t DEFAULT_SHARDS = 8;
+
 protected:
     void doUpdateKey(const void* key, size_t nkey, rel_time_t operation_time);
 
@@ -88,79 +96,86 @@ protected:
                                     rel_time_t current_time);
 
 private:
-    // Number of shards the keyspace is broken into. Permits some level of
-    // concurrent update (there is one mutex per shard).
-    static const int NUM_SHARDS = 8;
+    typedef void (*iterfunc_t)(const std::string& key,
+                               const topkey_item_t& it,
+                               void* arg);
+
+    /* Merge the keys tracked by all shards and invoke the given callback
+     * function for each of the top ones, most frequently accessed first.
+     */
+    void accept_visitor(iterfunc_t visitor_func, void* visitor_ctx);
 
     class Shard;
 
-    Shard& getShard(size_t key_hash);
+    // The shard of the calling thread.
+    Shard& getShard();
 
-    // One of N Shards which the keyspace has been broken
-    // into.
-    // Responsible for tracking the top {mkeys} within it's keyspace.
+    // One of N Shards which the accesses have been split over (by the
+    // thread performing them).
+    // Responsible for tracking the (approximate) top {max_keys} keys
+    // accessed by its threads, using the Space-Saving algorithm: a fixed
+    // number of counters, kept ordered by count. A key which isn't tracked
+    // replaces the key with the lowest count, inheriting (and so possibly
+    // overestimating by) that count.
     class Shard {
     public:
+        void setMaxKeys(size_t mkeys);
 
-        void setMaxKeys(int mkeys) {
-            max_keys = mkeys;
-            storage.reserve(max_keys);
-            // reallocating storage invalidates the LRU list.
-            list.clear();
-        }
-
-        // Updates the topkey 'ranking' for the specified key.
-        // If the item does not exist it will be created (with it's creation
-        // time set to operation_time), otherwise the existing item will be
-        // updated.
+        // Increments the count of the specified key.
+        // If the key is not tracked it will be (with its creation time set
+        // to operation_time).
         // On success returns true, If insufficient memory to create a
         // new item, returns false.
         bool updateKey(const cb::const_char_buffer& key,
-                       size_t key_hash,
                        rel_time_t operation_time);
 
-        typedef void (*iterfunc_t)(const std::string& key,
-                                   const topkey_item_t& it,
-                                   void *arg);
-
-        /* For each key in this shard, invoke the given callback function.
-         */
-        void accept_visitor(iterfunc_t visitor_func, void* visitor_ctx);
+        // Add the count of each key in this shard to the given map.
+        void collect(std::unordered_map<std::string, topkey_item_t>& keys);
 
     private:
-
-        struct KeyId {
-            size_t hash;
+        struct Counter {
             std::string key;
+            topkey_item_t item;
+            // Position of this counter in {order}.
+            size_t rank;
         };
 
-        // Pair of the key's string and the statistics related to it.
-        typedef std::pair<KeyId, topkey_item_t> topkey_t;
+        // Moves the counter past all counters with the same count, and
+        // then increments it; keeping {order} sorted.
+        void increment(Counter& counter);
 
-        // An ordered list of topkey_t*, used for LRU.
-        typedef std::list<topkey_t*> key_history_t;
-
-        // Vector topket_t, used for actual topke storage.
-        typedef std::vector<topkey_t> key_storage_t;
-
-        // Searches for the given key. If found returns a pointer to the
-        // topkey_t, else returns NULL.
-        topkey_t* searchForKey(size_t hash, const cb::const_char_buffer& key);
+        struct KeyEqual {
+            bool operator()(const cb::const_char_buffer& a,
+                            const cb::const_char_buffer& b) const {
+                return a.len == b.len && std::memcmp(a.buf, b.buf, a.len) == 0;
+            }
+        };
 
         // Maxumum numbers of keys to be tracked per shard.
-        unsigned int max_keys;
+        size_t max_keys = 0;
 
-        // mutex to serial access to this shard.
+        // mutex to serial access to this shard; only contended when the
+        // stats are read.
         std::mutex mutex;
 
-        // list of keys, ordered from most-recently used (front) to least recently
-        // used (back).
-        key_history_t list;
+        // Underlying counter storage. Never reallocated (its capacity is
+        // max_keys), so the counters don't move.
+        std::vector<Counter> storage;
 
-        // Underlying topkey storage.
-        key_storage_t storage;
+        // The counters, ordered by ascending count.
+        std::vector<Counter*> order;
+
+        // The counters by (a view of their own copy of the) key.
+        std::unordered_map<cb::const_char_buffer,
+                           Counter*,
+                           std::hash<cb::const_char_buffer>,
+                           KeyEqual>
+                index;
     };
 
+    // The number of keys reported.
+    const size_t max_keys;
+
     // array of topkey shards.
-    std::array<Shard, NUM_SHARDS> shards;
+    std::vector<Shard> shards;
 };
@@ -13,9 +13,12 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <mutex>
 #include <thread>
@@ -25,13 +28,39 @@
 #define hashsize(n) ((size_t)1<<(n))
 #define hashmask(n) (hashsize(n)-1)
 
+/*
+ * The hash chains are protected by a fixed set of lock stripes; the chain
+ * for a given hash value is protected by stripe (hash & lockmask). As the
+ * table never has fewer buckets than there are stripes, all of the buckets
+ * a hash value can live in (in the old and the new table during expansion)
+ * are covered by the same stripe.
+ */
+static const unsigned int lock_hashpower = 12;
+static const unsigned int initial_hashpower = 16;
+static_assert(lock_hashpower <= initial_hashpower,
+              "Can't have more lock stripes than hash buckets");
+
+/*
+ * The maintenance thread migrates this many buckets (each under its own
+ * stripe lock) before yielding.
+ */
+static const unsigned int expand_chunk = 1024;
+
 struct Assoc {
     Assoc(unsigned int hp) : hashpower(hp) {
         primary_hashtable.resize(hashsize(hashpower));
+        hash_bytes = primary_hashtable.size() * sizeof(hash_item*);
     }
 
-    /* how many powers of 2's worth of buckets we use */
-    unsigned int hashpower;
+    std::mutex& getLock(uint32_t hash) {
+        return locks[hash & hashmask(lock_hashpower)];
+    }
+
+    /*
+     * how many powers of 2's worth of buckets we use. Only changed while
+     * holding all of the locks.
+     */
+    std::atomic<unsigned int> hashpower;
 
 
     /* Main hash table. This is where we look except during expansion. */
@@ -44,25 +73,60 @@ struct Assoc {
     std::vector<hash_item*> old_hashtable;
 
     /* Number of items in the hash table. */
-    unsigned int hash_items{0};
+    std::atomic<unsigned int> hash_items{0};
+
+    /*
+     * Flag: Are we in the middle of expanding now? Only changed while
+     * holding all of the locks.
+     */
+    std::atomic<bool> expanding{false};
+
+    /* Flag: Has the maintenance thread been started (to expand)? */
+    std::atomic<bool> maintenance_running{false};
 
-    /* Flag: Are we in the middle of expanding now? */
-    bool expanding{false};
+    /*
+     * Flag: Should the maintenance thread stop migrating buckets at the next
+     * chunk boundary (until cleared)? For testing.
+     */
+    std::atomic<bool> expansion_paused{false};
 
     /*
      * During expansion we migrate values with bucket granularity; this is how
      * far we've gotten so far. Ranges from 0 .. hashsize(hashpower - 1) - 1.
+     * Only advanced past a bucket while holding the bucket's lock.
      */
-    unsigned int expand_bucket{0};
+    std::atomic<unsigned int> expand_bucket{0};
+
+    /* Memory used by the bucket arrays (of both tables while expanding). */
+    std::atomic<size_t> hash_bytes{0};
+
+    /* Number of expansions completed. */
+    std::atomic<uint64_t> expansions{0};
 
     /*
-     * serialise access to the hashtable
+     * serialise access to the hash chains (and the items on them)
      */
-    std::mutex mutex;
+    std::array<std::mutex, hashsize(lock_hashpower)> locks;
 };
 
-/* One hashtable for all */
-static struct Assoc* global_assoc = nullptr;
+/* Hold all of the lock stripes (to resize the table) */
+class AllAssocLocks {
+public:
+    AllAssocLocks(Assoc& assoc) : assoc(assoc) {
+        for (auto& lock : assoc.locks) {
+            lock.lock();
+        }
+    }
+
+    ~AllAssocLocks() {
+        for (auto& lock : assoc.locks) {
+            lock.unlock();
+        }
+    }
+
+private:
+    Assoc& assoc;
+};
 
 /* assoc factory. returns one new assoc or NULL if out-of-memory */
 static struct Assoc* assoc_consruct(int hashpower) {
@@ -75,37 +139,49 @@ static struct Assoc* assoc_consruct(int hashpower) {
 
 ENGINE_ERROR_CODE assoc_init(struct default_engine *engine) {
     /*
-        construct and save away one assoc for use by all buckets.
+        each bucket has its own hashtable, so it is sized (and expanded)
+        for its own items only.
     */
-    if (global_assoc == nullptr) {
-        global_assoc = assoc_consruct(16);
+    if (engine->assoc == nullptr) {
+        engine->assoc = assoc_consruct(initial_hashpower);
     }
-    return (global_assoc != NULL) ? ENGINE_SUCCESS : ENGINE_ENOMEM;
+    return (engine->assoc != NULL) ? ENGINE_SUCCESS : ENGINE_ENOMEM;
 }
 
-void assoc_destroy() {
-    if (global_assoc != nullptr) {
-        while (global_assoc->expanding) {
+void assoc_destroy(struct default_engine *engine) {
+    if (engine->assoc != nullptr) {
+        engine->assoc->expansion_paused = false;
+        while (engine->assoc->maintenance_running) {
             std::this_thread::sleep_for(std::chrono::microseconds(250));
         }
-        delete global_assoc;
-        global_assoc = nullptr;
+        delete engine->assoc;
+        engine->assoc = nullptr;
     }
 }
 
-hash_item *assoc_find(uint32_t hash, const hash_key *key) {
-    hash_item *it;
+std::mutex& assoc_get_lock(struct default_engine *engine, uint32_t hash) {
+    return engine->assoc->getLock(hash);
+}
+
+/*
+    returns the bucket the given hash value currently lives in.
+    the lock for hash is assumed to be held by the caller.
+*/
+static hash_item** _hashbucket(Assoc& assoc, uint32_t hash) {
     unsigned int oldbucket;
-    hash_item *ret = NULL;
-    int depth = 0;
-    std::lock_guard<std::mutex> guard(global_assoc->mutex);
-    if (global_assoc->expanding &&
-        (oldbucket = (hash & hashmask(global_assoc->hashpower - 1))) >= global_assoc->expand_bucket)
+    if (assoc.expanding &&
+        (oldbucket = (hash & hashmask(assoc.hashpower - 1))) >= assoc.expand_bucket)
     {
-        it = global_assoc->old_hashtable[oldbucket];
-    } else {
-        it = global_assoc->primary_hashtable[hash & hashmask(global_assoc->hashpower)];
+        return &assoc.old_hashtable[oldbucket];
     }
+    return &assoc.primary_hashtable[hash & hashmask(assoc.hashpower)];
+}
+
+hash_item *assoc_find(struct default_engine *engine, uint32_t hash,
+                      const hash_key *key) {
+    hash_item *it = *_hashbucket(*engine->assoc, hash);
+    hash_item *ret = NULL;
+    int depth = 0;
 
     while (it) {
         const hash_key* it_key = item_get_key(it);
@@ -125,19 +201,11 @@ hash_item *assoc_find(uint32_t hash, const hash_key *key) {
 /*
     returns the address of the item pointer before the key.  if *item == 0,
     the item wasn't found
-    assoc->lock is assumed to be held by the caller.
+    the lock for hash is assumed to be held by the caller.
 */
-static hash_item** _hashitem_before(uint32_t hash, const hash_key* key) {
-    hash_item **pos;
-    unsigned int oldbucket;
-
-    if (global_assoc->expanding &&
-        (oldbucket = (hash & hashmask(global_assoc->hashpower - 1))) >= global_assoc->expand_bucket)
-    {
-        pos = &global_assoc->old_hashtable[oldbucket];
-    } else {
-        pos = &global_assoc->primary_hashtable[hash & hashmask(global_assoc->hashpower)];
-    }
+static hash_item** _hashitem_before(Assoc& assoc, uint32_t hash,
+                                    const hash_key* key) {
+    hash_item **pos = _hashbucket(assoc, hash);
 
     while (*pos) {
         const hash_key* pos_key = item_get_key(*pos);
@@ -157,72 +225,61 @@ static hash_item** _hashitem_before(uint32_t hash, const hash_key* key) {
 static void assoc_maintenance_thread(void *arg);
 
 /*
-    grows the hashtable to the next power of 2.
-    assoc->lock is assumed to be held by the caller.
+    installs table (twice the size of the current one) as the primary
+    hashtable, and starts migrating the items over to it. table is left
+    holding the previous old_hashtable (an empty one).
+    all of the locks are assumed to be held by the caller.
 */
-static void assoc_expand() {
-    global_assoc->old_hashtable.swap(global_assoc->primary_hashtable);
-
-    try {
-        global_assoc->primary_hashtable.resize(hashsize(global_assoc->hashpower + 1));
-    } catch (const std::bad_alloc&) {
-        global_assoc->primary_hashtable.swap(global_assoc->old_hashtable);
-        /* Bad news, but we can keep running. */
-        return;
-    }
-
-    int ret = 0;
-    cb_thread_t tid;
-
-    global_assoc->hashpower++;
-    global_assoc->expanding = true;
-    global_assoc->expand_bucket = 0;
-
-    /* start a thread to do the expansion */
-    if ((ret = cb_create_named_thread(&tid, assoc_maintenance_thread,
-                                      nullptr, 1, "mc:assoc_maint")) != 0)
-    {
-        LOG_ERROR("Can't create thread for rebalance assoc table: {}",
-                  cb_strerror());
-        global_assoc->hashpower--;
-        global_assoc->expanding = false;
-        global_assoc->primary_hashtable.swap(global_assoc->old_hashtable);
-        global_assoc->old_hashtable.resize(0);
-        global_assoc->old_hashtable.shrink_to_fit();
-    }
+static void assoc_expand(Assoc& assoc, std::vector<hash_item*>& table) {
+    assoc.old_hashtable.swap(assoc.primary_hashtable);
+    assoc.primary_hashtable.swap(table);
+    assoc.hashpower++;
+    assoc.expand_bucket = 0;
+    assoc.expanding = true;
 }
 
 /* Note: this isn't an assoc_update.  The key must not already exist to call this */
-int assoc_insert(uint32_t hash, hash_item *it) {
-    unsigned int oldbucket;
-
-    cb_assert(assoc_find(hash, item_get_key(it)) == 0);  /* shouldn't have duplicately named things defined */
-
-    std::lock_guard<std::mutex> guard(global_assoc->mutex);
-    if (global_assoc->expanding &&
-        (oldbucket = (hash & hashmask(global_assoc->hashpower - 1))) >= global_assoc->expand_bucket)
-    {
-        it->h_next = global_assoc->old_hashtable[oldbucket];
-        global_assoc->old_hashtable[oldbucket] = it;
-    } else {
-        it->h_next = global_assoc->primary_hashtable[hash & hashmask(global_assoc->hashpower)];
-        global_assoc->primary_hashtable[hash & hashmask(global_assoc->hashpower)] = it;
-    }
-
-    global_assoc->hash_items++;
-    if (! global_assoc->expanding && global_assoc->hash_items > (hashsize(global_assoc->hashpower) * 3) / 2) {
-        assoc_expand();
+int assoc_insert(struct default_engine *engine, uint32_t hash, hash_item *it) {
+    Assoc& assoc = *engine->assoc;
+    cb_assert(assoc_find(engine, hash, item_get_key(it)) == 0);  /* shouldn't have duplicately named things defined */
+
+    hash_item** bucket = _hashbucket(assoc, hash);
+    it->h_next = *bucket;
+    *bucket = it;
+
+    ++assoc.hash_items;
+    if (assoc_needs_expansion(assoc)) {
+        /*
+         * We can't take all of the locks to start the expansion while
+         * holding one of them; leave it to the maintenance thread.
+         */
+        bool expected = false;
+        if (assoc.maintenance_running.compare_exchange_strong(expected,
+                                                              true)) {
+            int ret;
+            cb_thread_t tid;
+            if ((ret = cb_create_named_thread(&tid,
+                                              assoc_maintenance_thread,
+                                              &assoc,
+                                              1,
+                                              "mc:assoc_maint")) != 0) {
+                LOG_ERROR("Can't create thread for rebalance assoc table: {}",
+                          cb_strerror());
+                assoc.maintenance_running = false;
+            }
+        }
     }
     return 1;
 }
 
-void assoc_delete(uint32_t hash, const hash_key *key) {
-    std::lock_guard<std::mutex> guard(global_assoc->mutex);
-    hash_item **before = _hashitem_before(hash, key);
+void assoc_delete(struct default_engine *engine, uint32_t hash,
+                  const hash_key *key) {
+    Assoc& assoc = *engine->assoc;
+    hash_item **before = _hashitem_before(assoc, hash, key);
 
     if (*before) {
         hash_item *nxt;
-        global_assoc->hash_items--;
+        assoc.hash_items--;
         nxt = (*before)->h_next;
         (*before)->h_next = 0;   /* probably pointless, but whatever. */
         *before = nxt;
@@ -233,48 +290,115 @@ void assoc_delete(uint32_t hash, const hash_key *key) {
     cb_assert(*before != 0);
 }
 
+static bool assoc_needs_expansion(const Assoc& assoc) {
+    return !assoc.expanding &&
+           assoc.hash_items > (hashsize(assoc.hashpower) * 3) / 2;
+}
 
+/*
+ * Expands the table in the background. Foreground operations only ever
+ * wait for it while it swaps the tables in and out (holding all of the
+ * locks for a few pointer swaps): the new table is allocated, and the old
+ * one freed, without holding any locks, and the items are migrated one
+ * bucket (and lock) at a time.
+ */
+static void assoc_maintenance_thread(void *arg) {
+    Assoc& assoc = *static_cast<Assoc*>(arg);
+    /* hashpower is only changed by this thread */
+    const unsigned int hashpower = assoc.hashpower;
+    std::vector<hash_item*> table;
 
-#define DEFAULT_HASH_BULK_MOVE 1
-int hash_bulk_move = DEFAULT_HASH_BULK_MOVE;
+    try {
+        if (assoc_needs_expansion(assoc)) {
+            table.resize(hashsize(hashpower + 1));
+        }
+    } catch (const std::bad_alloc&) {
+        /* Bad news, but we can keep running. */
+        LOG_WARNING("Failed to allocate memory to expand the hash table");
+    }
 
-static void assoc_maintenance_thread(void *arg) {
-    bool done = false;
-    do {
-        int ii;
-        std::lock_guard<std::mutex> guard(global_assoc->mutex);
+    if (table.empty()) {
+        assoc.maintenance_running = false;
+        return;
+    }
 
-        for (ii = 0; ii < hash_bulk_move && global_assoc->expanding; ++ii) {
+    {
+        AllAssocLocks guard(assoc);
+        assoc_expand(assoc, table);
+    }
+    assoc.hash_bytes += hashsize(hashpower + 1) * sizeof(hash_item*);
+
+    const unsigned int old_buckets = hashsize(hashpower);
+    for (unsigned int bucket = 0; bucket < old_buckets; ++bucket) {
+        {
+            std::lock_guard<std::mutex> guard(assoc.getLock(bucket));
             hash_item *it, *next;
-            int bucket;
 
-            for (it = global_assoc->old_hashtable[global_assoc->expand_bucket];
-                 NULL != it; it = next) {
+            for (it = assoc.old_hashtable[bucket]; NULL != it; it = next) {
                 next = it->h_next;
                 const hash_key* key = item_get_key(it);
-                bucket = crc32c(hash_key_get_key(key),
-                                hash_key_get_key_len(key),
-                                0) & hashmask(global_assoc->hashpower);
-                it->h_next = global_assoc->primary_hashtable[bucket];
-                global_assoc->primary_hashtable[bucket] = it;
+                const auto newbucket = crc32c(hash_key_get_key(key),
+                                              hash_key_get_key_len(key),
+                                              0) & hashmask(hashpower + 1);
+                it->h_next = assoc.primary_hashtable[newbucket];
+                assoc.primary_hashtable[newbucket] = it;
             }
 
-            global_assoc->old_hashtable[global_assoc->expand_bucket] = NULL;
-            global_assoc->expand_bucket++;
-            if (global_assoc->expand_bucket == hashsize(global_assoc->hashpower - 1)) {
-                global_assoc->expanding = false;
-                global_assoc->old_hashtable.resize(0);
-                global_assoc->old_hashtable.shrink_to_fit();
-                LOG_INFO("Hash table expansion done");
-            }
+            assoc.old_hashtable[bucket] = NULL;
+            assoc.expand_bucket = bucket + 1;
         }
-        if (!global_assoc->expanding) {
-            done = true;
+
+        if ((bucket + 1) % expand_chunk == 0) {
+            std::this_thread::yield();
+            while (assoc.expansion_paused && bucket + 1 < old_buckets) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
         }
-    } while (!done);
+    }
+
+    {
+        AllAssocLocks guard(assoc);
+        assoc.expanding = false;
+        assoc.old_hashtable.swap(table);
+    }
+    /* table now holds the old bucket array; free it outside of the locks */
+    table = std::vector<hash_item*>();
+    assoc.hash_bytes -= hashsize(hashpower) * sizeof(hash_item*);
+    assoc.expansions++;
+
+    LOG_INFO("Hash table expansion done");
+    assoc.maintenance_running = false;
 }
 
-bool assoc_expanding() {
-    std::lock_guard<std::mutex> guard(global_assoc->mutex);
-    return global_assoc->expanding;
+bool assoc_expanding(struct default_engine *engine) {
+    return engine->assoc->expanding;
+}
+
+void assoc_set_expansion_paused(struct default_engine* engine, bool paused) {
+    engine->assoc->expansion_paused = paused;
+}
+
+void assoc_stats(struct default_engine* engine,
+                 const AddStatFn& add_stats,
+                 const void* c) {
+    const Assoc& assoc = *engine->assoc;
+    const bool expanding = assoc.expanding;
+
+    add_statistics(c, add_stats, "hash", -1, "power_level", "%u",
+                   assoc.hashpower.load());
+    add_statistics(c, add_stats, "hash", -1, "bytes", "%" PRIu64,
+                   uint64_t(assoc.hash_bytes));
+    add_statistics(c, add_stats, "hash", -1, "items", "%u",
+                   assoc.hash_items.load());
+    add_statistics(c, add_stats, "hash", -1, "is_expanding", "%d",
+                   expanding ? 1 : 0);
+    /* The progress of the current expansion, or else the last one */
+    if (expanding || assoc.expansions > 0) {
+        add_statistics(c, add_stats, "hash", -1, "expand_buckets_done",
+                       "%u", assoc.expand_bucket.load());
+        add_statistics(c, add_stats, "hash", -1, "expand_buckets_total",
+                       "%u", unsigned(hashsize(assoc.hashpower - 1)));
+    }
+    add_statistics(c, add_stats, "hash", -1, "expansions", "%" PRIu64,
+                   assoc.expansions.load());
 }
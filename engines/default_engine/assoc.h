@@ -4,10 +4,40 @@
 
 #include "items.h"
 
-/* associative array */
+#include <mutex>
+
+/* associative array (one per bucket) */
+struct Assoc;
+
 ENGINE_ERROR_CODE assoc_init(struct default_engine *engine);
-void assoc_destroy(void);
-hash_item *assoc_find(uint32_t hash, const hash_key* key);
-int assoc_insert(uint32_t hash, hash_item *item);
-void assoc_delete(uint32_t hash, const hash_key* key);
-bool assoc_expanding();
+void assoc_destroy(struct default_engine *engine);
+
+/*
+ * The hash table is protected by lock stripes rather than one lock: get the
+ * lock for the given hash value. It must be held while calling the
+ * functions below with that hash, and it also protects the items on the
+ * hash chain (their refcount, link state and metadata).
+ */
+std::mutex& assoc_get_lock(struct default_engine *engine, uint32_t hash);
+
+hash_item *assoc_find(struct default_engine *engine, uint32_t hash,
+                      const hash_key* key);
+int assoc_insert(struct default_engine *engine, uint32_t hash,
+                 hash_item *item);
+void assoc_delete(struct default_engine *engine, uint32_t hash,
+                  const hash_key* key);
+bool assoc_expanding(struct default_engine *engine);
+
+/*
+ * Stop (or let resume) the migration of buckets by a hash table expansion at
+ * the next chunk boundary, so a test can operate on a half expanded table.
+ */
+void assoc_set_expansion_paused(struct default_engine* engine, bool paused);
+
+/*
+ * Add the "hash" stats: the table's size and memory use, and whether (and
+ * how far along) it is expanding.
+ */
+void assoc_stats(struct default_engine* engine,
+                 const AddStatFn& add_stats,
+                 const void* c);
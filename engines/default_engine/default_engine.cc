@@ -70,6 +70,10 @@ static bool handled_vbucket(struct default_engine* e, Vbid vbid) {
 void default_engine_constructor(struct default_engine* engine, bucket_id_t id)
 {
     engine->bucket_id = id;
+    engine->assoc = nullptr;
+    engine->lru_maintainer.running = false;
+    engine->lru_maintainer.stop = false;
+    engine->lru_maintainer.paused = false;
     engine->config.verbose = 0;
     engine->config.oldest_live = 0;
     engine->config.evict_to_free = true;
@@ -78,6 +82,9 @@ void default_engine_constructor(struct default_engine* engine, bucket_id_t id)
     engine->config.factor = 1.25;
     engine->config.chunk_size = 48;
     engine->config.item_size_max= 1024 * 1024;
+    engine->config.slab_chunk_max = 0;
+    engine->config.lru_segmented = false;
+    engine->config.slab_automove = false;
     engine->config.xattr_enabled = true;
     engine->config.compression_mode = BucketCompressionMode::Off;
     engine->config.min_compression_ratio = default_min_compression_ratio;
@@ -105,7 +112,6 @@ extern "C" ENGINE_ERROR_CODE create_instance(GET_SERVER_API get_server_api,
 
 extern "C" void destroy_engine() {
     engine_manager_shutdown();
-    assoc_destroy();
 }
 
 static struct default_engine* get_handle(EngineIface* handle) {
@@ -132,6 +138,20 @@ ENGINE_ERROR_CODE default_engine::initialize(const char* config_str) {
         return ret;
     }
 
+    if (config.lru_segmented) {
+        ret = item_lru_maintainer_start(this);
+        if (ret != ENGINE_SUCCESS) {
+            return ret;
+        }
+    }
+
+    if (config.slab_automove) {
+        ret = slabs_automove_start(this);
+        if (ret != ENGINE_SUCCESS) {
+            return ret;
+        }
+    }
+
     return ENGINE_SUCCESS;
 }
 
@@ -141,7 +161,13 @@ void default_engine::destroy(const bool force) {
 
 void destroy_engine_instance(struct default_engine* engine) {
     if (engine->initialized) {
-        /* Destory the slabs cache */
+        /*
+         * Stop the slab balancer and the LRU maintainer, destory the hash
+         * table and the slabs cache
+         */
+        slabs_automove_stop(engine);
+        item_lru_maintainer_stop(engine);
+        assoc_destroy(engine);
         slabs_destroy(engine);
 
         cb_free(engine->config.uuid);
@@ -479,6 +505,8 @@ ENGINE_ERROR_CODE default_engine::get_stats(gsl::not_null<const void*> cookie,
         item_stats(this, add_stat, cookie);
     } else if (key == "sizes"_ccb) {
         item_stats_sizes(this, add_stat, cookie);
+    } else if (key == "hash"_ccb) {
+        assoc_stats(this, add_stat, cookie);
     } else if (key == "uuid"_ccb) {
         if (config.uuid) {
             add_stat("uuid",
@@ -539,6 +567,62 @@ ENGINE_ERROR_CODE default_engine::store(
     return store_item(this, it, &cas, operation, cookie, document_state);
 }
 
+std::vector<cb::EngineErrorItemPair> default_engine::get_multi(
+        gsl::not_null<const void*> cookie,
+        const std::vector<DocKey>& keys,
+        Vbid vbucket,
+        DocStateFilter documentStateFilter) {
+    std::vector<cb::EngineErrorItemPair> ret;
+    ret.reserve(keys.size());
+    if (!handled_vbucket(this, vbucket)) {
+        for (size_t ii = 0; ii < keys.size(); ++ii) {
+            ret.emplace_back(
+                    cb::makeEngineErrorItemPair(cb::engine_errc::not_my_vbucket));
+        }
+        return ret;
+    }
+
+    for (const auto& key : keys) {
+        item* it = item_get(
+                this, cookie, key.data(), key.size(), documentStateFilter);
+        if (it != nullptr) {
+            ret.emplace_back(cb::makeEngineErrorItemPair(
+                    cb::engine_errc::success, it, this));
+        } else {
+            ret.emplace_back(
+                    cb::makeEngineErrorItemPair(cb::engine_errc::no_such_key));
+        }
+    }
+    return ret;
+}
+
+std::vector<cb::EngineErrorCasPair> default_engine::store_multi(
+        gsl::not_null<const void*> cookie,
+        const std::vector<std::pair<gsl::not_null<item*>, uint64_t>>& items,
+        ENGINE_STORE_OPERATION operation,
+        const boost::optional<cb::durability::Requirements>& durability,
+        DocumentState document_state) {
+    std::vector<cb::EngineErrorCasPair> ret;
+    ret.reserve(items.size());
+    if (durability) {
+        ret.assign(items.size(), {cb::engine_errc::not_supported, 0});
+        return ret;
+    }
+
+    const bool unlink =
+            document_state == DocumentState::Deleted && !config.keep_deleted;
+    for (const auto& entry : items) {
+        auto* it = get_real_item(entry.first);
+        uint64_t cas = entry.second;
+        const auto status =
+                unlink ? safe_item_unlink(this, it)
+                       : store_item(this, it, &cas, operation, cookie,
+                                    document_state);
+        ret.push_back({cb::engine_errc(status), cas});
+    }
+    return ret;
+}
+
 cb::EngineErrorCasPair default_engine::store_if(
         gsl::not_null<const void*> cookie,
         gsl::not_null<item*> item,
@@ -613,7 +697,7 @@ static ENGINE_ERROR_CODE initalize_configuration(struct default_engine *se,
    se->config.vb0 = true;
 
    if (cfg_str != NULL) {
-       struct config_item items[13];
+       struct config_item items[16];
        int ii = 0;
 
        memset(&items, 0, sizeof(items));
@@ -652,6 +736,11 @@ static ENGINE_ERROR_CODE initalize_configuration(struct default_engine *se,
        items[ii].value.dt_size = &se->config.item_size_max;
        ++ii;
 
+       items[ii].key = "slab_chunk_max";
+       items[ii].datatype = DT_SIZE;
+       items[ii].value.dt_size = &se->config.slab_chunk_max;
+       ++ii;
+
        items[ii].key = "ignore_vbucket";
        items[ii].datatype = DT_BOOL;
        items[ii].value.dt_bool = &se->config.ignore_vbucket;
@@ -676,9 +765,19 @@ static ENGINE_ERROR_CODE initalize_configuration(struct default_engine *se,
        items[ii].value.dt_bool = &se->config.keep_deleted;
        ++ii;
 
+       items[ii].key = "lru_segmented";
+       items[ii].datatype = DT_BOOL;
+       items[ii].value.dt_bool = &se->config.lru_segmented;
+       ++ii;
+
+       items[ii].key = "slab_automove";
+       items[ii].datatype = DT_BOOL;
+       items[ii].value.dt_bool = &se->config.slab_automove;
+       ++ii;
+
        items[ii].key = NULL;
        ++ii;
-       cb_assert(ii == 13);
+       cb_assert(ii == 16);
        ret = ENGINE_ERROR_CODE(se->server.core->parse_config(cfg_str,
                                                              items,
                                                              stderr));
@@ -771,8 +870,60 @@ static bool scrub_cmd(struct default_engine* e,
 }
 
 /**
- * set_param only added to allow per bucket xattr on/off
- * and toggle between compression modes for testing purposes
+ * Move a slab page between two slab classes (value is "<src>:<dst>"), so
+ * page reassignment may be triggered without waiting for the balancer.
+ */
+static bool slab_reassign_cmd(struct default_engine* e,
+                              const void* cookie,
+                              cb::const_char_buffer value,
+                              const AddResponseFn& response) {
+    const std::string classes{value.data(), value.size()};
+    const auto sep = classes.find(':');
+    uint32_t src;
+    uint32_t dst;
+    if (sep == std::string::npos ||
+        !safe_strtoul(classes.substr(0, sep).c_str(), src) ||
+        !safe_strtoul(classes.substr(sep + 1).c_str(), dst)) {
+        return false;
+    }
+
+    auto res = cb::mcbp::Status::Success;
+    switch (slabs_reassign(e, src, dst)) {
+    case ENGINE_SUCCESS:
+        break;
+    case ENGINE_KEY_ENOENT:
+        res = cb::mcbp::Status::KeyEnoent;
+        break;
+    case ENGINE_TMPFAIL:
+        res = cb::mcbp::Status::Etmpfail;
+        break;
+    case ENGINE_ENOMEM:
+        res = cb::mcbp::Status::Enomem;
+        break;
+    case ENGINE_ENOTSUP:
+        res = cb::mcbp::Status::NotSupported;
+        break;
+    default:
+        res = cb::mcbp::Status::Einval;
+        break;
+    }
+
+    return response(nullptr,
+                    0,
+                    nullptr,
+                    0,
+                    nullptr,
+                    0,
+                    PROTOCOL_BINARY_RAW_BYTES,
+                    res,
+                    0,
+                    cookie);
+}
+
+/**
+ * set_param only added to allow per bucket xattr on/off, toggle between
+ * compression modes, and move slab pages and pause hash table expansion and
+ * the LRU maintainer (or run it) for testing purposes
  */
 static bool set_param(struct default_engine* e,
                       const void* cookie,
@@ -792,7 +943,29 @@ static bool set_param(struct default_engine* e,
         cb::const_char_buffer value{reinterpret_cast<const char*>(v.data()),
                                     v.size()};
 
-        if (key == "xattr_enabled") {
+        if (key == "slab_reassign") {
+            return slab_reassign_cmd(e, cookie, value, response);
+        }
+
+        if (key == "lru_maintainer_run") {
+            item_lru_maintainer_run(e);
+        } else if (key == "lru_maintainer_paused") {
+            if (value == "true") {
+                item_lru_maintainer_pause(e, true);
+            } else if (value == "false") {
+                item_lru_maintainer_pause(e, false);
+            } else {
+                return false;
+            }
+        } else if (key == "hash_expansion_paused") {
+            if (value == "true") {
+                assoc_set_expansion_paused(e, true);
+            } else if (value == "false") {
+                assoc_set_expansion_paused(e, false);
+            } else {
+                return false;
+            }
+        } else if (key == "xattr_enabled") {
             if (value == "true") {
                 e->config.xattr_enabled = true;
             } else if (value == "false") {
@@ -9,11 +9,13 @@
 
 #include <stdbool.h>
 #include <atomic>
+#include <condition_variable>
 #include <mutex>
 
 #include <memcached/engine.h>
 #include <memcached/util.h>
 #include <memcached/visibility.h>
+#include <platform/platform_thread.h>
 #include <relaxed_atomic.h>
 
 /** How long an object can reasonably be assumed to be locked before
@@ -37,19 +39,25 @@ struct default_engine;
 /** The item is deleted (may only be accessed if explicitly asked for) */
 #define ITEM_ZOMBIE (4)
 
+/** The item has been accessed since it was linked into its LRU segment */
+#define ITEM_ACTIVE (8)
+
 struct config {
    size_t verbose;
-   rel_time_t oldest_live;
+   std::atomic<rel_time_t> oldest_live;
    bool evict_to_free;
    size_t maxbytes;
    bool preallocate;
    float factor;
    size_t chunk_size;
    size_t item_size_max;
+   size_t slab_chunk_max;
    bool ignore_vbucket;
    bool vb0;
    char *uuid;
    bool keep_deleted;
+   bool lru_segmented;
+   bool slab_automove;
    std::atomic<bool> xattr_enabled;
    std::atomic<BucketCompressionMode> compression_mode;
    std::atomic<float> min_compression_ratio;
@@ -76,6 +84,16 @@ struct engine_scrubber {
     bool force_delete;
 };
 
+struct engine_lru_maintainer {
+    std::mutex lock;
+    std::condition_variable cond;
+    cb_thread_t thread;
+    bool running;
+    bool stop;
+    /* Set (for testing) to stop the thread running passes */
+    bool paused;
+};
+
 struct vbucket_info {
     int state : 2;
 };
@@ -158,6 +176,20 @@ struct default_engine : public EngineIface {
             const boost::optional<cb::durability::Requirements>& durability,
             DocumentState document_state) override;
 
+    std::vector<cb::EngineErrorItemPair> get_multi(
+            gsl::not_null<const void*> cookie,
+            const std::vector<DocKey>& keys,
+            Vbid vbucket,
+            DocStateFilter documentStateFilter) override;
+
+    std::vector<cb::EngineErrorCasPair> store_multi(
+            gsl::not_null<const void*> cookie,
+            const std::vector<std::pair<gsl::not_null<item*>, uint64_t>>&
+                    items,
+            ENGINE_STORE_OPERATION operation,
+            const boost::optional<cb::durability::Requirements>& durability,
+            DocumentState document_state) override;
+
     cb::EngineErrorCasPair store_if(
             gsl::not_null<const void*> cookie,
             gsl::not_null<item*> item,
@@ -205,12 +237,15 @@ struct default_engine : public EngineIface {
     */
    bool initialized;
 
+   /* The bucket's hash table (see assoc.h) */
+   struct Assoc* assoc;
    struct slabs slabs;
    struct items items;
 
    struct config config;
    struct engine_stats stats;
    struct engine_scrubber scrubber;
+   struct engine_lru_maintainer lru_maintainer;
 
    char vbucket_infos[NUM_VBUCKETS];
 
@@ -7,6 +7,11 @@
 #include <string.h>
 #include <time.h>
 #include <gsl/gsl>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
 
 #include "default_engine_internal.h"
 #include "engine_manager.h"
@@ -16,6 +21,7 @@
 #include <platform/cb_malloc.h>
 #include <platform/cbassert.h>
 #include <platform/crc32c.h>
+#include <platform/strerror.h>
 
 /* Forward Declarations */
 static void item_link_q(struct default_engine *engine, hash_item *it);
@@ -25,14 +31,16 @@ static hash_item *do_item_alloc(struct default_engine *engine,
                                 const int flags, const rel_time_t exptime,
                                 const int nbytes,
                                 const void *cookie,
-                                uint8_t datatype);
+                                uint8_t datatype,
+                                std::mutex* held);
 static hash_item* do_item_get(struct default_engine* engine,
                               const hash_key* key,
                               const DocStateFilter document_state);
 static int do_item_link(struct default_engine *engine,
                         const void* cookie,
                         hash_item *it);
-static void do_item_unlink(struct default_engine *engine, hash_item *it);
+static void do_item_unlink(struct default_engine *engine, hash_item *it,
+                           bool lru_locked = false);
 static ENGINE_ERROR_CODE do_safe_item_unlink(struct default_engine *engine,
                                              hash_item *it);
 static void do_item_release(struct default_engine *engine, hash_item *it);
@@ -52,6 +60,60 @@ static bool hash_key_create(hash_key* hkey,
 static void hash_key_destroy(hash_key* hkey);
 static void hash_key_copy_to_item(hash_item* dst, const hash_key* src);
 
+/*
+ * Locking: an item (its refcount, link state and metadata) and its hash
+ * chain are protected by the hash table lock stripe of its key
+ * (assoc_get_lock), and each slab class' LRU by its lru_locks entry. The
+ * lock order is stripe, then LRU, then the slab lock. Code which walks an
+ * LRU (already holding its lock) may therefore only try to lock the stripe
+ * of the items it finds, and skips the ones it can't get.
+ */
+
+static uint32_t item_hash(const hash_key* key) {
+    return crc32c(hash_key_get_key(key), hash_key_get_key_len(key), 0);
+}
+
+/*
+ * Try to lock the stripe of an item found on an LRU. held is a stripe lock
+ * the caller already holds (if any), in which case there is nothing to
+ * lock. Returns true if the item is (now) protected.
+ */
+static bool try_lock_item(struct default_engine* engine,
+                          const hash_item* it,
+                          std::mutex* held,
+                          std::unique_lock<std::mutex>& lock) {
+    auto& mutex = assoc_get_lock(engine, item_hash(item_get_key(it)));
+    if (&mutex == held) {
+        return true;
+    }
+    lock = std::unique_lock<std::mutex>(mutex, std::try_to_lock);
+    return lock.owns_lock();
+}
+
+/* The number of items on the LRU segments of slab class id */
+static unsigned int lru_size(struct default_engine* engine, unsigned int id) {
+    return engine->items.sizes[id][LRU_HOT] +
+           engine->items.sizes[id][LRU_WARM] +
+           engine->items.sizes[id][LRU_COLD];
+}
+
+/*
+ * The share (in percent) of a slab class' items the LRU maintainer keeps in
+ * the hot and warm segments.
+ */
+static const unsigned int lru_hot_percent = 20;
+static const unsigned int lru_warm_percent = 40;
+
+/* The number of tail items the LRU maintainer looks at per segment and run */
+static const int lru_maintainer_batch = 500;
+
+/*
+ * How long the LRU maintainer sleeps between runs: as short as the minimum
+ * while it finds work, backing off to the maximum while it doesn't.
+ */
+static const std::chrono::milliseconds lru_maintainer_min_sleep{1};
+static const std::chrono::milliseconds lru_maintainer_max_sleep{1000};
+
 /*
  * We only reposition items in the LRU queue if they haven't been repositioned
  * in this many seconds. That saves us from churning on frequently-accessed
@@ -64,9 +126,26 @@ static void hash_key_copy_to_item(hash_item* dst, const hash_key* src);
  */
 static const int search_items = 50;
 
+/*
+ * Has the (linked) item been flushed: it was linked before the last flush,
+ * or it hasn't been accessed since the second before a flush (which also
+ * covers the flush generation wrapping around).
+ */
+static bool item_is_flushed(struct default_engine *engine,
+                            const hash_item *it,
+                            rel_time_t oldest_live,
+                            rel_time_t current_time) {
+    return it->flush_gen != engine->items.flush_gen.load() ||
+           (oldest_live != 0 && oldest_live <= current_time &&
+            it->time <= oldest_live);
+}
+
 void item_stats_reset(struct default_engine *engine) {
-    std::lock_guard<std::mutex> guard(engine->items.lock);
-    memset(engine->items.itemstats, 0, sizeof(engine->items.itemstats));
+    for (int ii = 0; ii < POWER_LARGEST; ++ii) {
+        std::lock_guard<std::mutex> guard(engine->items.lru_locks[ii]);
+        memset(&engine->items.itemstats[ii], 0,
+               sizeof(engine->items.itemstats[ii]));
+    }
 }
 
 
@@ -79,7 +158,7 @@ static size_t ITEM_ntotal(struct default_engine *engine,
 
 /* Get the next CAS id for a new item. */
 static uint64_t get_cas_id(void) {
-    static uint64_t cas_id = 0;
+    static std::atomic<uint64_t> cas_id{0};
     return ++cas_id;
 }
 
@@ -95,6 +174,17 @@ static uint64_t get_cas_id(void) {
 #endif
 
 
+/*
+ * Items are reclaimed and evicted from the tail of the cold segment first,
+ * then (e.g. before the LRU maintainer has moved anything, or when the LRU
+ * isn't segmented) the hot one, and only then the warm one.
+ */
+static const lru_segment eviction_order[] = {LRU_COLD, LRU_HOT, LRU_WARM};
+
+/*
+ * held is the stripe lock held by the caller (if any); expired items and
+ * eviction victims on other stripes are only taken if their lock is free.
+ */
 /*@null@*/
 hash_item *do_item_alloc(struct default_engine *engine,
                          const hash_key *key,
@@ -102,9 +192,10 @@ hash_item *do_item_alloc(struct default_engine *engine,
                          const rel_time_t exptime,
                          const int nbytes,
                          const void *cookie,
-                         uint8_t datatype) {
+                         uint8_t datatype,
+                         std::mutex* held) {
     hash_item *it = NULL;
-    int tries = search_items;
+    int tries;
     hash_item *search;
     rel_time_t oldest_live;
     rel_time_t current_time;
@@ -115,31 +206,44 @@ hash_item *do_item_alloc(struct default_engine *engine,
     if ((id = slabs_clsid(engine, ntotal)) == 0) {
         return 0;
     }
+    /* Large items get memory of their own size, so it can't be reused */
+    const bool large = slabs_is_large(engine, id);
 
     /* do a quick check if we have any expired items in the tail.. */
     oldest_live = engine->config.oldest_live;
     current_time = engine->server.core->get_current_time();
 
-    for (search = engine->items.tails[id];
-         tries > 0 && search != NULL;
-         tries--, search=search->prev) {
-        if (search->refcount == 0 &&
-            ((search->time < oldest_live) || /* dead by flush */
-             (search->exptime != 0 && search->exptime < current_time)) &&
-            (search->locktime <= current_time)) {
-            it = search;
-            /* I don't want to actually free the object, just steal
-             * the item to avoid to grab the slab mutex twice ;-)
-             */
-            engine->stats.reclaimed++;
-            engine->items.itemstats[id].reclaimed++;
-            it->refcount = 1;
-            slabs_adjust_mem_requested(engine, it->slabs_clsid, ITEM_ntotal(engine, it), ntotal);
-            do_item_unlink(engine, it);
-            /* Initialize the item block: */
-            it->slabs_clsid = 0;
-            it->refcount = 0;
-            break;
+    std::unique_lock<std::mutex> lru(engine->items.lru_locks[id]);
+    for (auto segment : eviction_order) {
+        for (tries = search_items, search = engine->items.tails[id][segment];
+             it == NULL && tries > 0 && search != NULL;
+             tries--, search=search->prev) {
+            std::unique_lock<std::mutex> item_lock;
+            if ((search->iflag & ITEM_LINKED) == 0 ||
+                !try_lock_item(engine, search, held, item_lock)) {
+                continue;
+            }
+            if (search->refcount == 0 &&
+                (item_is_flushed(engine, search, oldest_live, current_time) ||
+                 (search->exptime != 0 && search->exptime < current_time)) &&
+                (search->locktime <= current_time)) {
+                engine->stats.reclaimed++;
+                engine->items.itemstats[id].reclaimed++;
+                if (large) {
+                    do_item_unlink(engine, search, true);
+                    break;
+                }
+                it = search;
+                /* I don't want to actually free the object, just steal
+                 * the item to avoid to grab the slab mutex twice ;-)
+                 */
+                it->refcount = 1;
+                slabs_adjust_mem_requested(engine, it->slabs_clsid, ITEM_ntotal(engine, it), ntotal);
+                do_item_unlink(engine, it, true);
+                /* Initialize the item block: */
+                it->slabs_clsid = 0;
+                it->refcount = 0;
+            }
         }
     }
 
@@ -149,7 +253,6 @@ hash_item *do_item_alloc(struct default_engine *engine,
         ** Could not find an expired item at the tail, and memory allocation
         ** failed. Try to evict some items!
         */
-        tries = search_items;
 
         /* If requested to not push old items out of cache when memory runs out,
          * we're out of luck at this point...
@@ -167,29 +270,49 @@ hash_item *do_item_alloc(struct default_engine *engine,
          * tries
          */
 
-        if (engine->items.tails[id] == 0) {
+        if (engine->items.tails[id][LRU_HOT] == 0 &&
+            engine->items.tails[id][LRU_WARM] == 0 &&
+            engine->items.tails[id][LRU_COLD] == 0) {
             engine->items.itemstats[id].outofmemory++;
             return NULL;
         }
 
-        for (search = engine->items.tails[id]; tries > 0 && search != NULL; tries--, search=search->prev) {
-            if (search->refcount == 0 && search->locktime <= current_time) {
-                if (search->exptime == 0 || search->exptime > current_time) {
-                    engine->items.itemstats[id].evicted++;
-                    engine->items.itemstats[id].evicted_time = current_time - search->time;
-                    if (search->exptime != 0) {
-                        engine->items.itemstats[id].evicted_nonzero++;
+        bool evicted = false;
+        for (auto segment : eviction_order) {
+            hash_item *prev;
+            for (tries = search_items, search = engine->items.tails[id][segment];
+                 !evicted && tries > 0 && search != NULL;
+                 tries--, search = prev) {
+                /* search is freed if we evict it */
+                prev = search->prev;
+                std::unique_lock<std::mutex> item_lock;
+                if ((search->iflag & ITEM_LINKED) == 0 ||
+                    !try_lock_item(engine, search, held, item_lock)) {
+                    continue;
+                }
+                if (search->refcount == 0 && search->locktime <= current_time) {
+                    if (search->exptime == 0 || search->exptime > current_time) {
+                        engine->items.itemstats[id].evicted++;
+                        engine->items.itemstats[id].evicted_time = current_time - search->time;
+                        if (search->exptime != 0) {
+                            engine->items.itemstats[id].evicted_nonzero++;
+                        }
+                        engine->stats.evictions++;
+                    } else {
+                        engine->items.itemstats[id].reclaimed++;
+                        engine->stats.reclaimed++;
                     }
-                    engine->stats.evictions++;
-                } else {
-                    engine->items.itemstats[id].reclaimed++;
-                    engine->stats.reclaimed++;
+                    do_item_unlink(engine, search, true);
+                    /* A large item may need more than the one evicted */
+                    evicted = !large ||
+                              (it = static_cast<hash_item*>(slabs_alloc(
+                                       engine, ntotal, id))) != NULL;
                 }
-                do_item_unlink(engine, search);
-                break;
             }
         }
-        it = static_cast<hash_item*>(slabs_alloc(engine, ntotal, id));
+        if (it == NULL) {
+            it = static_cast<hash_item*>(slabs_alloc(engine, ntotal, id));
+        }
         if (it == 0) {
             engine->items.itemstats[id].outofmemory++;
             /* Last ditch effort. There is a very rare bug which causes
@@ -199,13 +322,24 @@ hash_item *do_item_alloc(struct default_engine *engine,
              * three hours, so if we find one in the tail which is that old,
              * free it anyway.
              */
-            tries = search_items;
-            for (search = engine->items.tails[id]; tries > 0 && search != NULL; tries--, search=search->prev) {
-                if (search->refcount != 0 && search->time + TAIL_REPAIR_TIME < current_time) {
-                    engine->items.itemstats[id].tailrepairs++;
-                    search->refcount = 0;
-                    do_item_unlink(engine, search);
-                    break;
+            bool repaired = false;
+            for (auto segment : eviction_order) {
+                hash_item *prev;
+                for (tries = search_items, search = engine->items.tails[id][segment];
+                     !repaired && tries > 0 && search != NULL;
+                     tries--, search = prev) {
+                    prev = search->prev;
+                    std::unique_lock<std::mutex> item_lock;
+                    if ((search->iflag & ITEM_LINKED) == 0 ||
+                        !try_lock_item(engine, search, held, item_lock)) {
+                        continue;
+                    }
+                    if (search->refcount != 0 && search->time + TAIL_REPAIR_TIME < current_time) {
+                        engine->items.itemstats[id].tailrepairs++;
+                        search->refcount = 0;
+                        do_item_unlink(engine, search, true);
+                        repaired = true;
+                    }
                 }
             }
             it = static_cast<hash_item*>(slabs_alloc(engine, ntotal, id));
@@ -219,12 +353,14 @@ hash_item *do_item_alloc(struct default_engine *engine,
 
     it->slabs_clsid = id;
 
-    cb_assert(it != engine->items.heads[it->slabs_clsid]);
+    cb_assert(it != engine->items.heads[it->slabs_clsid][LRU_HOT]);
+    lru.unlock();
 
     it->next = it->prev = it->h_next = 0;
     it->refcount = 1;     /* the caller will have a reference */
     DEBUG_REFCNT(it, '*');
     it->iflag = 0;
+    it->lru = LRU_HOT;
     it->nbytes = nbytes;
     it->flags = flags;
     it->datatype = datatype;
@@ -234,12 +370,13 @@ hash_item *do_item_alloc(struct default_engine *engine,
     return it;
 }
 
+/* The LRU lock of the item's slab class must be held. */
 static void item_free(struct default_engine *engine, hash_item *it) {
     size_t ntotal = ITEM_ntotal(engine, it);
     unsigned int clsid;
     cb_assert((it->iflag & ITEM_LINKED) == 0);
-    cb_assert(it != engine->items.heads[it->slabs_clsid]);
-    cb_assert(it != engine->items.tails[it->slabs_clsid]);
+    cb_assert(it != engine->items.heads[it->slabs_clsid][it->lru]);
+    cb_assert(it != engine->items.tails[it->slabs_clsid][it->lru]);
     cb_assert(it->refcount == 0 || engine->scrubber.force_delete);
 
     /* so slab size changer can tell later if item is already free or not */
@@ -250,13 +387,15 @@ static void item_free(struct default_engine *engine, hash_item *it) {
     slabs_free(engine, it, ntotal, clsid);
 }
 
+/* Links the item at the head of its LRU segment (it->lru) */
 static void item_link_q(struct default_engine *engine, hash_item *it) { /* item is the new head */
     hash_item **head, **tail;
     cb_assert(it->slabs_clsid < POWER_LARGEST);
+    cb_assert(it->lru < LRU_SEGMENTS);
     cb_assert((it->iflag & ITEM_SLABBED) == 0);
 
-    head = &engine->items.heads[it->slabs_clsid];
-    tail = &engine->items.tails[it->slabs_clsid];
+    head = &engine->items.heads[it->slabs_clsid][it->lru];
+    tail = &engine->items.tails[it->slabs_clsid][it->lru];
     cb_assert(it != *head);
     cb_assert((*head && *tail) || (*head == 0 && *tail == 0));
     it->prev = 0;
@@ -264,15 +403,16 @@ static void item_link_q(struct default_engine *engine, hash_item *it) { /* item
     if (it->next) it->next->prev = it;
     *head = it;
     if (*tail == 0) *tail = it;
-    engine->items.sizes[it->slabs_clsid]++;
+    engine->items.sizes[it->slabs_clsid][it->lru]++;
     return;
 }
 
 static void item_unlink_q(struct default_engine *engine, hash_item *it) {
     hash_item **head, **tail;
     cb_assert(it->slabs_clsid < POWER_LARGEST);
-    head = &engine->items.heads[it->slabs_clsid];
-    tail = &engine->items.tails[it->slabs_clsid];
+    cb_assert(it->lru < LRU_SEGMENTS);
+    head = &engine->items.heads[it->slabs_clsid][it->lru];
+    tail = &engine->items.tails[it->slabs_clsid][it->lru];
 
     if (*head == it) {
         cb_assert(it->prev == 0);
@@ -287,7 +427,7 @@ static void item_unlink_q(struct default_engine *engine, hash_item *it) {
 
     if (it->next) it->next->prev = it->prev;
     if (it->prev) it->prev->next = it->next;
-    engine->items.sizes[it->slabs_clsid]--;
+    engine->items.sizes[it->slabs_clsid][it->lru]--;
     return;
 }
 
@@ -298,9 +438,9 @@ int do_item_link(struct default_engine *engine,
     cb_assert((it->iflag & (ITEM_LINKED|ITEM_SLABBED)) == 0);
     it->iflag |= ITEM_LINKED;
     it->time = engine->server.core->get_current_time();
+    it->flush_gen = engine->items.flush_gen;
 
-    assoc_insert(crc32c(hash_key_get_key(key), hash_key_get_key_len(key), 0),
-                 it);
+    assoc_insert(engine, item_hash(key), it);
 
     engine->stats.curr_bytes += ITEM_ntotal(engine, it);
     engine->stats.curr_items += 1;
@@ -327,19 +467,32 @@ int do_item_link(struct default_engine *engine,
         return 0;
     }
 
-    item_link_q(engine, it);
+    {
+        std::lock_guard<std::mutex> guard(
+                engine->items.lru_locks[it->slabs_clsid]);
+        item_link_q(engine, it);
+    }
 
     return 1;
 }
 
-void do_item_unlink(struct default_engine *engine, hash_item *it) {
+/*
+ * lru_locked is set by the callers which found the item walking its LRU and
+ * already hold the LRU lock.
+ */
+void do_item_unlink(struct default_engine *engine, hash_item *it,
+                    bool lru_locked) {
     const hash_key* key = item_get_key(it);
     if ((it->iflag & ITEM_LINKED) != 0) {
         it->iflag &= ~ITEM_LINKED;
         engine->stats.curr_bytes -= ITEM_ntotal(engine, it);
         engine->stats.curr_items -= 1;
-        assoc_delete(crc32c(hash_key_get_key(key), hash_key_get_key_len(key), 0),
-                     key);
+        assoc_delete(engine, item_hash(key), key);
+        std::unique_lock<std::mutex> lru(
+                engine->items.lru_locks[it->slabs_clsid], std::defer_lock);
+        if (!lru_locked) {
+            lru.lock();
+        }
         item_unlink_q(engine, it);
         if (it->refcount == 0 || engine->scrubber.force_delete) {
             item_free(engine, it);
@@ -364,9 +517,9 @@ ENGINE_ERROR_CODE do_safe_item_unlink(struct default_engine* engine,
             stored->iflag &= ~ITEM_LINKED;
             engine->stats.curr_bytes -= ITEM_ntotal(engine, stored);
             engine->stats.curr_items -= 1;
-            assoc_delete(crc32c(hash_key_get_key(key),
-                                hash_key_get_key_len(key), 0),
-                         key);
+            assoc_delete(engine, item_hash(key), key);
+            std::lock_guard<std::mutex> guard(
+                    engine->items.lru_locks[stored->slabs_clsid]);
             item_unlink_q(engine, stored);
             if (stored->refcount == 0 || engine->scrubber.force_delete) {
                 item_free(engine, stored);
@@ -386,16 +539,43 @@ void do_item_release(struct default_engine *engine, hash_item *it) {
         DEBUG_REFCNT(it, '-');
     }
     if (it->refcount == 0 && (it->iflag & ITEM_LINKED) == 0) {
+        std::lock_guard<std::mutex> guard(
+                engine->items.lru_locks[it->slabs_clsid]);
         item_free(engine, it);
     }
 }
 
 void do_item_update(struct default_engine *engine, hash_item *it) {
     rel_time_t current_time = engine->server.core->get_current_time();
+    if (engine->config.lru_segmented) {
+        /*
+         * Lazy bumping: hot and warm items are only flagged as active (the
+         * LRU maintainer moves them if they reach the tail of their
+         * segment). Only a hit on a cold item moves it (to the warm
+         * segment) straight away.
+         */
+        if (it->lru != LRU_COLD) {
+            if ((it->iflag & ITEM_ACTIVE) == 0) {
+                it->iflag |= ITEM_ACTIVE;
+            }
+        } else if ((it->iflag & ITEM_LINKED) != 0) {
+            std::lock_guard<std::mutex> guard(
+                    engine->items.lru_locks[it->slabs_clsid]);
+            item_unlink_q(engine, it);
+            it->time = current_time;
+            it->lru = LRU_WARM;
+            it->iflag &= ~ITEM_ACTIVE;
+            item_link_q(engine, it);
+        }
+        return;
+    }
+
     if (it->time < current_time - ITEM_UPDATE_INTERVAL) {
         cb_assert((it->iflag & ITEM_SLABBED) == 0);
 
         if ((it->iflag & ITEM_LINKED) != 0) {
+            std::lock_guard<std::mutex> guard(
+                    engine->items.lru_locks[it->slabs_clsid]);
             item_unlink_q(engine, it);
             it->time = current_time;
             item_link_q(engine, it);
@@ -418,46 +598,74 @@ static void do_item_stats(struct default_engine* engine,
                           const void* c) {
     int i;
     rel_time_t current_time = engine->server.core->get_current_time();
+    rel_time_t oldest_live = engine->config.oldest_live;
     for (i = 0; i < POWER_LARGEST; i++) {
-        if (engine->items.tails[i] != NULL) {
-            const char *prefix = "items";
+        std::lock_guard<std::mutex> guard(engine->items.lru_locks[i]);
+        const char *prefix = "items";
+        bool empty = true;
+        rel_time_t age = 0;
+        for (int segment = 0; segment < LRU_SEGMENTS; ++segment) {
             int search = search_items;
-            while (search > 0 &&
-                   engine->items.tails[i] != NULL &&
-                   ((engine->config.oldest_live != 0 && /* Item flushd */
-                     engine->config.oldest_live <= current_time &&
-                     engine->items.tails[i]->time <= engine->config.oldest_live) ||
-                    (engine->items.tails[i]->exptime != 0 && /* and not expired */
-                     engine->items.tails[i]->exptime < current_time))) {
+            while (search > 0 && engine->items.tails[i][segment] != NULL) {
+                hash_item* tail = engine->items.tails[i][segment];
+                std::unique_lock<std::mutex> item_lock;
+                if ((tail->iflag & ITEM_LINKED) == 0 ||
+                    !try_lock_item(engine, tail, nullptr, item_lock)) {
+                    break;
+                }
+                if (!(item_is_flushed(engine, tail, oldest_live,
+                                      current_time) ||
+                      (tail->exptime != 0 && /* and not expired */
+                       tail->exptime < current_time))) {
+                    break;
+                }
                 --search;
-                if (engine->items.tails[i]->refcount == 0) {
-                    do_item_unlink(engine, engine->items.tails[i]);
+                if (tail->refcount == 0) {
+                    do_item_unlink(engine, tail, true);
                 } else {
                     break;
                 }
             }
-            if (engine->items.tails[i] == NULL) {
-                /* We removed all of the items in this slab class */
-                continue;
+            const hash_item* tail = engine->items.tails[i][segment];
+            if (tail != NULL) {
+                if (empty || tail->time < age) {
+                    age = tail->time;
+                }
+                empty = false;
             }
+        }
+        if (empty) {
+            /* We removed all of the items in this slab class */
+            continue;
+        }
 
-            add_statistics(c, add_stats, prefix, i, "number", "%u",
-                           engine->items.sizes[i]);
-            add_statistics(c, add_stats, prefix, i, "age", "%u",
-                           engine->items.tails[i]->time);
-            add_statistics(c, add_stats, prefix, i, "evicted",
-                           "%u", engine->items.itemstats[i].evicted);
-            add_statistics(c, add_stats, prefix, i, "evicted_nonzero",
-                           "%u", engine->items.itemstats[i].evicted_nonzero);
-            add_statistics(c, add_stats, prefix, i, "evicted_time",
-                           "%u", engine->items.itemstats[i].evicted_time);
-            add_statistics(c, add_stats, prefix, i, "outofmemory",
-                           "%u", engine->items.itemstats[i].outofmemory);
-            add_statistics(c, add_stats, prefix, i, "tailrepairs",
-                           "%u", engine->items.itemstats[i].tailrepairs);;
-            add_statistics(c, add_stats, prefix, i, "reclaimed",
-                           "%u", engine->items.itemstats[i].reclaimed);;
+        add_statistics(c, add_stats, prefix, i, "number", "%u",
+                       lru_size(engine, i));
+        if (engine->config.lru_segmented) {
+            add_statistics(c, add_stats, prefix, i, "number_hot", "%u",
+                           engine->items.sizes[i][LRU_HOT]);
+            add_statistics(c, add_stats, prefix, i, "number_warm", "%u",
+                           engine->items.sizes[i][LRU_WARM]);
+            add_statistics(c, add_stats, prefix, i, "number_cold", "%u",
+                           engine->items.sizes[i][LRU_COLD]);
+            add_statistics(c, add_stats, prefix, i, "moves_to_cold", "%u",
+                           engine->items.itemstats[i].moves_to_cold);
+            add_statistics(c, add_stats, prefix, i, "moves_to_warm", "%u",
+                           engine->items.itemstats[i].moves_to_warm);
         }
+        add_statistics(c, add_stats, prefix, i, "age", "%u", age);
+        add_statistics(c, add_stats, prefix, i, "evicted",
+                       "%u", engine->items.itemstats[i].evicted);
+        add_statistics(c, add_stats, prefix, i, "evicted_nonzero",
+                       "%u", engine->items.itemstats[i].evicted_nonzero);
+        add_statistics(c, add_stats, prefix, i, "evicted_time",
+                       "%u", engine->items.itemstats[i].evicted_time);
+        add_statistics(c, add_stats, prefix, i, "outofmemory",
+                       "%u", engine->items.itemstats[i].outofmemory);
+        add_statistics(c, add_stats, prefix, i, "tailrepairs",
+                       "%u", engine->items.itemstats[i].tailrepairs);;
+        add_statistics(c, add_stats, prefix, i, "reclaimed",
+                       "%u", engine->items.itemstats[i].reclaimed);;
     }
 }
 
@@ -476,17 +684,20 @@ static void do_item_stats_sizes(struct default_engine* engine,
 
         /* build the histogram */
         for (i = 0; i < POWER_LARGEST; i++) {
-            hash_item *iter = engine->items.heads[i];
-            while (iter) {
-                size_t ntotal = ITEM_ntotal(engine, iter);
-                size_t bucket = ntotal / 32;
-                if ((ntotal % 32) != 0) {
-                    bucket++;
-                }
-                if (bucket < num_buckets) {
-                    histogram[bucket]++;
+            std::lock_guard<std::mutex> guard(engine->items.lru_locks[i]);
+            for (int segment = 0; segment < LRU_SEGMENTS; ++segment) {
+                hash_item *iter = engine->items.heads[i][segment];
+                while (iter) {
+                    size_t ntotal = ITEM_ntotal(engine, iter);
+                    size_t bucket = ntotal / 32;
+                    if ((ntotal % 32) != 0) {
+                        bucket++;
+                    }
+                    if (bucket < num_buckets) {
+                        histogram[bucket]++;
+                    }
+                    iter = iter->next;
                 }
-                iter = iter->next;
             }
         }
 
@@ -512,19 +723,17 @@ hash_item* do_item_get(struct default_engine* engine,
                        const hash_key* key,
                        const DocStateFilter documentStateFilter) {
     rel_time_t current_time = engine->server.core->get_current_time();
-    hash_item *it = assoc_find(crc32c(hash_key_get_key(key),
-                                      hash_key_get_key_len(key), 0),
-                               key);
-
-    if (it != NULL && engine->config.oldest_live != 0 &&
-        engine->config.oldest_live <= current_time &&
-        it->time <= engine->config.oldest_live) {
-        do_item_unlink(engine, it);           /* MTSAFE - items.lock held */
+    rel_time_t oldest_live = engine->config.oldest_live;
+    hash_item *it = assoc_find(engine, item_hash(key), key);
+
+    if (it != NULL &&
+        item_is_flushed(engine, it, oldest_live, current_time)) {
+        do_item_unlink(engine, it);
         it = NULL;
     }
 
     if (it != NULL && it->exptime != 0 && it->exptime <= current_time) {
-        do_item_unlink(engine, it);           /* MTSAFE - items.lock held */
+        do_item_unlink(engine, it);
         it = NULL;
     }
 
@@ -551,7 +760,7 @@ hash_item* do_item_get(struct default_engine* engine,
 
 /*
  * Stores an item in the cache according to the semantics of one of the set
- * commands. In threaded mode, this is protected by the cache lock.
+ * commands. The caller must hold the lock stripe of the item's key.
  *
  * Returns the state of storage.
  */
@@ -638,11 +847,8 @@ hash_item *item_alloc(struct default_engine *engine,
         return NULL;
     }
 
-    {
-        std::lock_guard<std::mutex> guard(engine->items.lock);
-        it = do_item_alloc(
-                engine, &hkey, flags, exptime, nbytes, cookie, datatype);
-    }
+    it = do_item_alloc(
+            engine, &hkey, flags, exptime, nbytes, cookie, datatype, nullptr);
     hash_key_destroy(&hkey);
     return it;
 }
@@ -674,7 +880,8 @@ hash_item* item_get(struct default_engine* engine,
                     const void* cookie,
                     const hash_key& key,
                     const DocStateFilter state) {
-    std::lock_guard<std::mutex> guard(engine->items.lock);
+    std::lock_guard<std::mutex> guard(
+            assoc_get_lock(engine, item_hash(&key)));
     return do_item_get(engine, &key, state);
 }
 
@@ -683,7 +890,8 @@ hash_item* item_get(struct default_engine* engine,
  * needed.
  */
 void item_release(struct default_engine *engine, hash_item *item) {
-    std::lock_guard<std::mutex> guard(engine->items.lock);
+    std::lock_guard<std::mutex> guard(
+            assoc_get_lock(engine, item_hash(item_get_key(item))));
     do_item_release(engine, item);
 }
 
@@ -691,13 +899,15 @@ void item_release(struct default_engine *engine, hash_item *item) {
  * Unlinks an item from the LRU and hashtable.
  */
 void item_unlink(struct default_engine *engine, hash_item *item) {
-    std::lock_guard<std::mutex> guard(engine->items.lock);
+    std::lock_guard<std::mutex> guard(
+            assoc_get_lock(engine, item_hash(item_get_key(item))));
     do_item_unlink(engine, item);
 }
 
 ENGINE_ERROR_CODE safe_item_unlink(struct default_engine *engine,
                                    hash_item *it) {
-    std::lock_guard<std::mutex> guard(engine->items.lock);
+    std::lock_guard<std::mutex> guard(
+            assoc_get_lock(engine, item_hash(item_get_key(it))));
     return do_safe_item_unlink(engine, it);
 }
 
@@ -716,7 +926,8 @@ ENGINE_ERROR_CODE store_item(struct default_engine *engine,
         item->iflag |= ITEM_ZOMBIE;
     }
 
-    std::lock_guard<std::mutex> guard(engine->items.lock);
+    std::lock_guard<std::mutex> guard(
+            assoc_get_lock(engine, item_hash(item_get_key(item))));
     ret = do_store_item(engine, item, operation, cookie, &stored_item);
     if (ret == ENGINE_SUCCESS) {
         *cas = stored_item->cas;
@@ -730,6 +941,8 @@ ENGINE_ERROR_CODE do_item_get_locked(struct default_engine* engine,
                                      hash_item** it,
                                      const hash_key* hkey,
                                      rel_time_t locktime) {
+    // Clones are allocated holding the stripe lock of the key
+    auto* held = &assoc_get_lock(engine, item_hash(hkey));
     hash_item* item = do_item_get(engine, hkey, DocStateFilter::Alive);
     if (item == nullptr) {
         return ENGINE_KEY_ENOENT;
@@ -767,7 +980,8 @@ ENGINE_ERROR_CODE do_item_get_locked(struct default_engine* engine,
         // Unfortunately I can't return the actual object as that'll cause
         // the item's cas to be masked out ;-)
         auto* clone = do_item_alloc(engine, hkey, item->flags, item->exptime,
-                                    item->nbytes, cookie, item->datatype);
+                                    item->nbytes, cookie, item->datatype,
+                                    held);
         if (clone == nullptr) {
             do_item_release(engine, item);
             return ENGINE_TMPFAIL;
@@ -788,14 +1002,16 @@ ENGINE_ERROR_CODE do_item_get_locked(struct default_engine* engine,
         // Multiple entities holds a reference to the object. We
         // need to do a copy/replace.
         auto* clone1 = do_item_alloc(engine, hkey, item->flags, item->exptime,
-                                     item->nbytes, cookie, item->datatype);
+                                     item->nbytes, cookie, item->datatype,
+                                     held);
         if (clone1 == nullptr) {
             do_item_release(engine, item);
             return ENGINE_TMPFAIL;
         }
 
         auto* clone2 = do_item_alloc(engine, hkey, item->flags, item->exptime,
-                                     item->nbytes, cookie, item->datatype);
+                                     item->nbytes, cookie, item->datatype,
+                                     held);
         if (clone2 == nullptr) {
             do_item_release(engine, item);
             do_item_release(engine, clone1);
@@ -834,7 +1050,8 @@ ENGINE_ERROR_CODE item_get_locked(struct default_engine* engine,
 
     ENGINE_ERROR_CODE ret;
     {
-        std::lock_guard<std::mutex> guard(engine->items.lock);
+        std::lock_guard<std::mutex> guard(
+                assoc_get_lock(engine, item_hash(&hkey)));
         ret = do_item_get_locked(engine, cookie, it, &hkey, locktime);
     }
     hash_key_destroy(&hkey);
@@ -846,6 +1063,8 @@ static ENGINE_ERROR_CODE do_item_unlock(struct default_engine* engine,
                                         const void* cookie,
                                         const hash_key* hkey,
                                         uint64_t cas) {
+    // Clones are allocated holding the stripe lock of the key
+    auto* held = &assoc_get_lock(engine, item_hash(hkey));
     hash_item* item = do_item_get(engine, hkey, DocStateFilter::Alive);
     if (item == nullptr) {
         return ENGINE_KEY_ENOENT;
@@ -874,7 +1093,8 @@ static ENGINE_ERROR_CODE do_item_unlock(struct default_engine* engine,
     } else {
         // Someone else holds a reference to the object.
         auto* clone = do_item_alloc(engine, hkey, item->flags, item->exptime,
-                                    item->nbytes, cookie, item->datatype);
+                                    item->nbytes, cookie, item->datatype,
+                                    held);
         if (clone == nullptr) {
             do_item_release(engine, item);
             return ENGINE_TMPFAIL;
@@ -904,7 +1124,8 @@ ENGINE_ERROR_CODE item_unlock(struct default_engine* engine,
 
     ENGINE_ERROR_CODE ret;
     {
-        std::lock_guard<std::mutex> guard(engine->items.lock);
+        std::lock_guard<std::mutex> guard(
+                assoc_get_lock(engine, item_hash(&hkey)));
         ret = do_item_unlock(engine, cookie, &hkey, cas);
     }
     hash_key_destroy(&hkey);
@@ -917,6 +1138,8 @@ ENGINE_ERROR_CODE do_item_get_and_touch(struct default_engine* engine,
                                         hash_item** it,
                                         const hash_key* hkey,
                                         rel_time_t exptime) {
+    // Clones are allocated holding the stripe lock of the key
+    auto* held = &assoc_get_lock(engine, item_hash(hkey));
     hash_item* item = do_item_get(engine, hkey, DocStateFilter::Alive);
     if (item == nullptr) {
         return ENGINE_KEY_ENOENT;
@@ -950,7 +1173,8 @@ ENGINE_ERROR_CODE do_item_get_and_touch(struct default_engine* engine,
         // Multiple entities holds a reference to the object. We
         // need to do a copy/replace.
         auto* clone = do_item_alloc(engine, hkey, item->flags, exptime,
-                                    item->nbytes, cookie, item->datatype);
+                                    item->nbytes, cookie, item->datatype,
+                                    held);
         if (clone == nullptr) {
             do_item_release(engine, item);
             return ENGINE_TMPFAIL;
@@ -982,7 +1206,8 @@ ENGINE_ERROR_CODE item_get_and_touch(struct default_engine* engine,
 
     ENGINE_ERROR_CODE ret;
     {
-        std::lock_guard<std::mutex> guard(engine->items.lock);
+        std::lock_guard<std::mutex> guard(
+                assoc_get_lock(engine, item_hash(&hkey)));
         ret = do_item_get_and_touch(engine, cookie, it, &hkey, exptime);
     }
     hash_key_destroy(&hkey);
@@ -991,67 +1216,235 @@ ENGINE_ERROR_CODE item_get_and_touch(struct default_engine* engine,
 }
 
 /*
- * Flushes expired items after a flush_all call
+ * flush_all: bump the flush generation, which kills all of the items linked
+ * so far, rather than walking the LRUs with their locks held. The scrubber
+ * then reclaims their memory in the background.
  */
 void item_flush_expired(struct default_engine *engine) {
-    std::lock_guard<std::mutex> guard(engine->items.lock);
-
     rel_time_t now = engine->server.core->get_current_time();
     if (now > engine->config.oldest_live) {
         engine->config.oldest_live = now - 1;
     }
+    engine->items.flush_gen++;
 
-    for (int ii = 0; ii < POWER_LARGEST; ii++) {
-        hash_item *iter, *next;
-        /*
-         * The LRU is sorted in decreasing time order, and an item's
-         * timestamp is never newer than its last access time, so we
-         * only need to walk back until we hit an item older than the
-         * oldest_live time.
-         * The oldest_live checking will auto-expire the remaining items.
-         */
-        for (iter = engine->items.heads[ii]; iter != NULL; iter = next) {
-            if (iter->time >= engine->config.oldest_live) {
-                next = iter->next;
-                if ((iter->iflag & ITEM_SLABBED) == 0) {
-                    do_item_unlink(engine, iter);
-                }
-            } else {
-                /* We've hit the first old item. Continue to the next queue. */
-                break;
-            }
-        }
-    }
+    /* If it is already running it'll get the ones it hasn't visited yet */
+    item_start_scrub(engine);
 }
 
 void item_stats(struct default_engine* engine,
                 const AddStatFn& add_stat,
                 const void* cookie) {
-    std::lock_guard<std::mutex> guard(engine->items.lock);
     do_item_stats(engine, add_stat, cookie);
 }
 
 void item_stats_sizes(struct default_engine* engine,
                       const AddStatFn& add_stat,
                       const void* cookie) {
-    std::lock_guard<std::mutex> guard(engine->items.lock);
     do_item_stats_sizes(engine, add_stat, cookie);
 }
 
+bool item_unlink_chunk(struct default_engine *engine,
+                       hash_item *it,
+                       size_t chunk_size) {
+    if ((it->iflag & ITEM_LINKED) == 0) {
+        return false;
+    }
+
+    /*
+     * Without the item's stripe lock it may be unlinked and reused (with
+     * another key) at any point, so only trust a key which lies within the
+     * chunk, and check that it still hashes to the stripe we locked once
+     * we hold it.
+     */
+    const hash_key* key = item_get_key(it);
+    const uint16_t len = hash_key_get_key_len(key);
+    if (key->header.full_key != (hash_key_data*)&key->key_storage ||
+        sizeof(hash_item) + offsetof(hash_key, key_storage) + len >
+                chunk_size) {
+        return false;
+    }
+    auto& lock = assoc_get_lock(
+            engine, crc32c(hash_key_get_key(key), len, 0));
+    std::lock_guard<std::mutex> guard(lock);
+    if ((it->iflag & ITEM_LINKED) == 0 ||
+        &assoc_get_lock(engine, item_hash(key)) != &lock) {
+        return false;
+    }
+    do_item_unlink(engine, it);
+    return true;
+}
+
+/*
+ * Moves a linked item to the head of another LRU segment (or of its own).
+ * The item keeps its time unless that is older than the one of the new
+ * segment's head, to keep each segment sorted by time (item_flush_expired
+ * depends on it). The item's stripe and LRU locks must be held.
+ */
+static void lru_move(struct default_engine* engine,
+                     hash_item* it,
+                     lru_segment segment) {
+    item_unlink_q(engine, it);
+    const hash_item* head = engine->items.heads[it->slabs_clsid][segment];
+    if (head != NULL && head->time > it->time) {
+        it->time = head->time;
+    }
+    it->lru = segment;
+    it->iflag &= ~ITEM_ACTIVE;
+    item_link_q(engine, it);
+}
+
+/*
+ * Moves items off the tail of the given segment of slab class id until it
+ * holds no more than limit items: dead (expired or flushed) items are
+ * unlinked, active ones moved to the warm segment and the rest to the cold
+ * one. Items whose stripe lock is busy are skipped. The LRU lock of the
+ * slab class must be held. Returns the number of items handled.
+ */
+static int lru_juggle(struct default_engine* engine,
+                      unsigned int id,
+                      lru_segment segment,
+                      unsigned int limit) {
+    const rel_time_t current_time = engine->server.core->get_current_time();
+    const rel_time_t oldest_live = engine->config.oldest_live;
+    int handled = 0;
+
+    hash_item* search = engine->items.tails[id][segment];
+    for (int tries = lru_maintainer_batch;
+         tries > 0 && search != NULL && engine->items.sizes[id][segment] > limit;
+         --tries) {
+        hash_item* prev = search->prev;
+        std::unique_lock<std::mutex> item_lock;
+        if ((search->iflag & ITEM_LINKED) != 0 &&
+            try_lock_item(engine, search, nullptr, item_lock)) {
+            if (item_is_flushed(engine, search, oldest_live, current_time) ||
+                (search->exptime != 0 && search->exptime < current_time)) {
+                engine->items.itemstats[id].reclaimed++;
+                engine->stats.reclaimed++;
+                do_item_unlink(engine, search, true);
+            } else if ((search->iflag & ITEM_ACTIVE) != 0) {
+                engine->items.itemstats[id].moves_to_warm++;
+                lru_move(engine, search, LRU_WARM);
+            } else {
+                engine->items.itemstats[id].moves_to_cold++;
+                lru_move(engine, search, LRU_COLD);
+            }
+            ++handled;
+        }
+        search = prev;
+    }
+    return handled;
+}
+
+static int lru_maintain_class(struct default_engine* engine, unsigned int id) {
+    std::lock_guard<std::mutex> guard(engine->items.lru_locks[id]);
+    const unsigned int total = lru_size(engine, id);
+    int handled = lru_juggle(engine, id, LRU_HOT,
+                             (total * lru_hot_percent) / 100);
+    handled += lru_juggle(engine, id, LRU_WARM,
+                          (total * lru_warm_percent) / 100);
+    return handled;
+}
+
+/* One pass over all slab classes. The maintainer lock must be held. */
+static int lru_maintain(struct default_engine* engine) {
+    int handled = 0;
+    for (unsigned int id = 0; id < POWER_LARGEST; ++id) {
+        handled += lru_maintain_class(engine, id);
+    }
+    return handled;
+}
+
+static void item_lru_maintainer_main(void* arg) {
+    auto* engine = static_cast<struct default_engine*>(arg);
+    auto& maintainer = engine->lru_maintainer;
+    auto sleep = lru_maintainer_min_sleep;
+
+    /*
+     * The lock is held across each pass, so once item_lru_maintainer_pause
+     * has returned no pass is in progress.
+     */
+    std::unique_lock<std::mutex> lock(maintainer.lock);
+    while (!maintainer.stop) {
+        const int handled = maintainer.paused ? 0 : lru_maintain(engine);
+        if (handled != 0) {
+            sleep = lru_maintainer_min_sleep;
+        } else {
+            sleep = std::min(sleep * 2, lru_maintainer_max_sleep);
+        }
+        maintainer.cond.wait_for(
+                lock, sleep, [&maintainer] { return maintainer.stop; });
+    }
+}
+
+ENGINE_ERROR_CODE item_lru_maintainer_start(struct default_engine *engine) {
+    auto& maintainer = engine->lru_maintainer;
+    std::lock_guard<std::mutex> guard(maintainer.lock);
+    if (maintainer.running) {
+        return ENGINE_SUCCESS;
+    }
+
+    maintainer.stop = false;
+    if (cb_create_named_thread(&maintainer.thread,
+                               item_lru_maintainer_main,
+                               engine,
+                               0,
+                               "mc:lru_maint") != 0) {
+        LOG_WARNING("Failed to create the LRU maintainer thread: {}",
+                    cb_strerror());
+        return ENGINE_FAILED;
+    }
+    maintainer.running = true;
+    return ENGINE_SUCCESS;
+}
+
+void item_lru_maintainer_pause(struct default_engine *engine, bool paused) {
+    auto& maintainer = engine->lru_maintainer;
+    std::lock_guard<std::mutex> guard(maintainer.lock);
+    maintainer.paused = paused;
+}
+
+int item_lru_maintainer_run(struct default_engine *engine) {
+    std::lock_guard<std::mutex> guard(engine->lru_maintainer.lock);
+    return lru_maintain(engine);
+}
+
+void item_lru_maintainer_stop(struct default_engine *engine) {
+    auto& maintainer = engine->lru_maintainer;
+    {
+        std::lock_guard<std::mutex> guard(maintainer.lock);
+        if (!maintainer.running) {
+            return;
+        }
+        maintainer.stop = true;
+        maintainer.cond.notify_one();
+    }
+    cb_join_thread(maintainer.thread);
+    maintainer.running = false;
+}
+
+/* The LRU lock of slab class ii must be held. */
 static void do_item_link_cursor(struct default_engine *engine,
-                                hash_item *cursor, int ii)
+                                hash_item *cursor, int ii,
+                                lru_segment segment)
 {
     cursor->slabs_clsid = (uint8_t)ii;
+    cursor->lru = segment;
     cursor->next = NULL;
-    cursor->prev = engine->items.tails[ii];
-    engine->items.tails[ii]->next = cursor;
-    engine->items.tails[ii] = cursor;
-    engine->items.sizes[ii]++;
+    cursor->prev = engine->items.tails[ii][segment];
+    engine->items.tails[ii][segment]->next = cursor;
+    engine->items.tails[ii][segment] = cursor;
+    engine->items.sizes[ii][segment]++;
 }
 
 typedef ENGINE_ERROR_CODE (*ITERFUNC)(struct default_engine *engine,
                                       hash_item *item, void *cookie);
 
+/*
+ * Moves the cursor up its LRU (whose lock must be held), calling itemfunc
+ * for each item with its stripe lock held. If an item's stripe lock is
+ * busy the cursor stays where it is, and true is returned so that the
+ * caller retries after dropping the LRU lock.
+ */
 static bool do_item_walk_cursor(struct default_engine *engine,
                                 hash_item *cursor,
                                 int steplength,
@@ -1066,11 +1459,17 @@ static bool do_item_walk_cursor(struct default_engine *engine,
         /* Move cursor */
         hash_item *ptr = cursor->prev;
         bool done = false;
+        /* Cursors (and items being unlinked) aren't linked */
+        const bool is_item = (ptr->iflag & ITEM_LINKED) != 0;
+        std::unique_lock<std::mutex> item_lock;
+        if (is_item && !try_lock_item(engine, ptr, nullptr, item_lock)) {
+            return true;
+        }
 
         ++ii;
         item_unlink_q(engine, cursor);
 
-        if (ptr == engine->items.heads[cursor->slabs_clsid]) {
+        if (ptr == engine->items.heads[cursor->slabs_clsid][cursor->lru]) {
             done = true;
             cursor->prev = NULL;
         } else {
@@ -1080,8 +1479,7 @@ static bool do_item_walk_cursor(struct default_engine *engine,
             ptr->prev = cursor;
         }
 
-        /* Ignore cursors */
-        if (item_get_key(ptr)->header.len == 0 && ptr->nbytes == 0) {
+        if (!is_item) {
             --ii;
         } else {
             *error = itemfunc(engine, ptr, itemdata);
@@ -1102,11 +1500,12 @@ static ENGINE_ERROR_CODE item_scrub(struct default_engine *engine,
                                     hash_item *item,
                                     void *cookie) {
     rel_time_t current_time = engine->server.core->get_current_time();
+    rel_time_t oldest_live = engine->config.oldest_live;
     (void)cookie;
     engine->scrubber.visited++;
     /*
-        scrubber is used for generic bucket deletion and scrub_cmd
-        all expired or orphaned items are unlinked
+        scrubber is used for scrub_cmd and flush_all
+        all expired, flushed or orphaned items are unlinked
     */
     if (engine->scrubber.force_delete && item->refcount > 0) {
         // warn that someone isn't releasing items before deleting their bucket.
@@ -1116,8 +1515,10 @@ static ENGINE_ERROR_CODE item_scrub(struct default_engine *engine,
     }
 
     if (engine->scrubber.force_delete || (item->refcount == 0 &&
-       (item->exptime != 0 && item->exptime < current_time))) {
-        do_item_unlink(engine, item);
+       ((item->exptime != 0 && item->exptime < current_time) ||
+        item_is_flushed(engine, item, oldest_live, current_time)))) {
+        /* do_item_walk_cursor holds the LRU lock */
+        do_item_unlink(engine, item, true);
         engine->scrubber.cleaned++;
     }
     return ENGINE_SUCCESS;
@@ -1129,11 +1530,16 @@ static void item_scrub_class(struct default_engine *engine,
     ENGINE_ERROR_CODE ret;
     bool more;
     do {
-        std::lock_guard<std::mutex> guard(engine->items.lock);
-        more = do_item_walk_cursor(engine, cursor, 200, item_scrub, NULL, &ret);
+        {
+            std::lock_guard<std::mutex> guard(
+                    engine->items.lru_locks[cursor->slabs_clsid]);
+            more = do_item_walk_cursor(
+                    engine, cursor, 200, item_scrub, NULL, &ret);
+        }
         if (ret != ENGINE_SUCCESS) {
             break;
         }
+        std::this_thread::yield();
     } while (more);
 }
 
@@ -1144,20 +1550,28 @@ void item_scrubber_main(struct default_engine *engine)
 
     memset(&cursor, 0, sizeof(cursor));
     cursor.refcount = 1;
+    /*
+     * Items moved between the LRU segments by the LRU maintainer while
+     * we're scrubbing may be missed (until the next scrub).
+     */
     for (ii = 0; ii < POWER_LARGEST; ++ii) {
-        bool skip = false;
-        {
-            std::lock_guard<std::mutex> guard(engine->items.lock);
-            if (engine->items.heads[ii] == NULL) {
-                skip = true;
-            } else {
-                /* add the item at the tail */
-                do_item_link_cursor(engine, &cursor, ii);
+        for (int segment = 0; segment < LRU_SEGMENTS; ++segment) {
+            bool skip = false;
+            {
+                std::lock_guard<std::mutex> guard(
+                        engine->items.lru_locks[ii]);
+                if (engine->items.heads[ii][segment] == NULL) {
+                    skip = true;
+                } else {
+                    /* add the item at the tail */
+                    do_item_link_cursor(engine, &cursor, ii,
+                                        lru_segment(segment));
+                }
             }
-        }
 
-        if (!skip) {
-            item_scrub_class(engine, &cursor);
+            if (!skip) {
+                item_scrub_class(engine, &cursor);
+            }
         }
     }
 
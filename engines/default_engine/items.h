@@ -7,6 +7,7 @@
 #include <atomic>
 #include <cstddef>
 #include <cstring>
+#include <mutex>
 
 /*
  * You should not try to aquire any of the item locks before calling these
@@ -60,7 +61,11 @@ typedef struct _hash_item {
     /** to identify the type of the data */
     uint8_t datatype;
 
-    // There is 3 spare bytes due to alignment
+    /** which segment of the slab class' LRU we're in (see lru_segment) */
+    uint8_t lru;
+
+    /** The flush generation (items.flush_gen) the item was linked in */
+    uint16_t flush_gen;
 } hash_item;
 
 /*
@@ -145,17 +150,48 @@ typedef struct {
     unsigned int outofmemory;
     unsigned int tailrepairs;
     unsigned int reclaimed;
+    /** moved to the cold segment by the LRU maintainer */
+    unsigned int moves_to_cold;
+    /** moved to the warm segment (by the LRU maintainer or an access) */
+    unsigned int moves_to_warm;
 } itemstats_t;
 
+/*
+ * Each slab class' LRU is made of three segments. Without lru_segmented
+ * all of the items live in the hot segment, which is a plain LRU.
+ *
+ * With lru_segmented new items are linked into the hot segment, and hits
+ * only flag items as active. The LRU maintainer keeps the hot and warm
+ * segments within their share of the class' items by moving their tails:
+ * active items to (the head of) the warm segment, the others to the cold
+ * one. A hit on a cold item moves it to the warm segment. Items are
+ * evicted from the cold segment, so items which have only been accessed
+ * once (e.g. by a scan) never push out the warm ones.
+ */
+enum lru_segment {
+    LRU_HOT = 0,
+    LRU_WARM,
+    LRU_COLD,
+    LRU_SEGMENTS
+};
+
 struct items {
-   hash_item *heads[POWER_LARGEST];
-   hash_item *tails[POWER_LARGEST];
+   hash_item *heads[POWER_LARGEST][LRU_SEGMENTS];
+   hash_item *tails[POWER_LARGEST][LRU_SEGMENTS];
    itemstats_t itemstats[POWER_LARGEST];
-   unsigned int sizes[POWER_LARGEST];
+   unsigned int sizes[POWER_LARGEST][LRU_SEGMENTS];
    /*
-    * serialise access to the items data
+    * serialise access to each slab class' LRU (heads, tails, sizes and
+    * itemstats, and the items' next / prev pointers). The items themselves
+    * are protected by the lock of their hash chain (assoc_get_lock), which
+    * is always acquired before an LRU lock.
    */
-   std::mutex lock;
+   std::mutex lru_locks[POWER_LARGEST];
+   /*
+    * Bumped by every flush: the items linked in an older generation are
+    * dead, and are reclaimed when they're found (or by the scrubber).
+    */
+   std::atomic<uint16_t> flush_gen{0};
 };
 
 
@@ -286,7 +322,9 @@ void item_stats_sizes(struct default_engine* engine,
                       const void* cookie);
 
 /**
- * Flush expired items from the cache
+ * Flush all items from the cache. This doesn't visit the items: they're
+ * considered dead from now on, and their memory is reclaimed lazily and by
+ * the scrubber (which is started in the background).
  * @param engine handle to the storage engine
  */
 void  item_flush_expired(struct default_engine *engine);
@@ -339,6 +377,48 @@ ENGINE_ERROR_CODE store_item(struct default_engine *engine,
                              const void *cookie,
                              const DocumentState document_state);
 
+/**
+ * Unlink the item stored in a chunk of a slab page which is being moved to
+ * another slab class (see slabs_reassign), so that the chunk is freed once
+ * the item is released. Must be called without holding any item locks.
+ * @param engine handle to the storage engine
+ * @param it the chunk
+ * @param chunk_size the size of the chunk
+ * @return true if a linked item was unlinked
+ */
+bool item_unlink_chunk(struct default_engine *engine,
+                       hash_item *it,
+                       size_t chunk_size);
+
+/**
+ * Start the LRU maintainer thread (used with lru_segmented)
+ * @param engine handle to the storage engine
+ * @return ENGINE_SUCCESS if the thread was started
+ */
+ENGINE_ERROR_CODE item_lru_maintainer_start(struct default_engine *engine);
+
+/**
+ * Pause (or resume) the LRU maintainer thread, for testing. Once paused
+ * the segments are only maintained by item_lru_maintainer_run.
+ * @param engine handle to the storage engine
+ * @param paused true to pause the thread, false to resume it
+ */
+void item_lru_maintainer_pause(struct default_engine *engine, bool paused);
+
+/**
+ * Run one pass of the LRU maintainer over all slab classes in the calling
+ * thread, for testing
+ * @param engine handle to the storage engine
+ * @return the number of items handled
+ */
+int item_lru_maintainer_run(struct default_engine *engine);
+
+/**
+ * Stop (and join) the LRU maintainer thread if it is running
+ * @param engine handle to the storage engine
+ */
+void item_lru_maintainer_stop(struct default_engine *engine);
+
 /**
  * Run a single scrub loop for the engine.
  * @param engine handle to the storage engine
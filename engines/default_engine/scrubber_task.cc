@@ -64,8 +64,12 @@ void ScrubberTask::run() {
             workQueue.pop_front();
             state = State::Scrubbing;
             lck.unlock();
-            // Run the task without holding the lock
-            item_scrubber_main(engine.first);
+            // Run the task without holding the lock. A bucket being
+            // destroyed doesn't need scrubbing: its hash table and slabs
+            // aren't shared, and are released in one go.
+            if (!engine.second) {
+                item_scrubber_main(engine.first);
+            }
             engineManager.notifyScrubComplete(engine.first, engine.second);
 
             // relock so lck can safely unlock when destroyed at loop end.
@@ -29,8 +29,9 @@ class EngineManager;
  *   1. removing items from memory
  *   2. deleting engine structs
  *
- * The common use-case is for bucket deletion performing tasks 1 and 2.
- * The start_scrub command only performs 1.
+ * Bucket deletion only performs 2 (each bucket has its own hash table and
+ * slabs, which are released along with the engine). The start_scrub
+ * command only performs 1.
  *
  * Global destruction can safely join the task and allow the engine to
  * safely unload the shared object.
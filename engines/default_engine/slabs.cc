@@ -6,6 +6,12 @@
  * a multiplier factor from there, up to half the maximum slab size. The last
  * slab size is always 1MB, since that's the maximum item size allowed by the
  * memcached protocol.
+ *
+ * With slab_chunk_max the chunk sizes stop at that size instead: the items
+ * larger than it aren't stored in chunks at all, but in memory allocated for
+ * the item alone. That saves the (up to a factor) waste of rounding a large
+ * item up to the chunk size, and lets a small factor cover all item sizes
+ * with a modest number of classes.
  */
 #include <errno.h>
 #include <fcntl.h>
@@ -16,6 +22,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <chrono>
+#include <thread>
+
+#include <logger/logger.h>
+#include <platform/strerror.h>
 
 #ifdef VALGRIND
 // switch to malloc if VALGRIND so we can get some useful insight.
@@ -29,6 +40,8 @@
  */
 static int do_slabs_newslab(struct default_engine *engine, const unsigned int id);
 static void *memory_allocate(struct default_engine *engine, size_t size);
+static int do_slabs_add_free(slabclass_t *p, void *ptr);
+static bool rebal_chunk_free(struct default_engine *engine, const void *ptr);
 
 #ifndef DONT_PREALLOC_SLABS
 /* Preallocate as many slab pages as possible (called from slabs_init)
@@ -59,6 +72,10 @@ unsigned int slabs_clsid(struct default_engine *engine, const size_t size) {
     return res;
 }
 
+bool slabs_is_large(struct default_engine *engine, unsigned int id) {
+    return id != 0 && id == engine->slabs.large_clsid;
+}
+
 static void *my_allocate(struct default_engine *e, size_t size) {
     void *ptr;
     /* Is threre room? */
@@ -91,6 +108,18 @@ ENGINE_ERROR_CODE slabs_init(struct default_engine *engine,
                              const bool prealloc) {
     int i = POWER_SMALLEST - 1;
     unsigned int size = sizeof(hash_item) + (unsigned int)engine->config.chunk_size;
+    size_t chunk_max = engine->config.slab_chunk_max;
+    if (chunk_max == 0 || chunk_max >= engine->config.item_size_max) {
+        chunk_max = engine->config.item_size_max;
+    } else {
+        chunk_max -= chunk_max % CHUNK_ALIGN_BYTES;
+        if (chunk_max < size) {
+            chunk_max = size + CHUNK_ALIGN_BYTES - (size % CHUNK_ALIGN_BYTES);
+        }
+    }
+    /* Leave room for the chunk_max class below the large class */
+    const bool large = chunk_max < engine->config.item_size_max;
+    const int classes = large ? POWER_LARGEST - 1 : POWER_LARGEST;
 
     engine->slabs.mem_limit = limit;
 
@@ -106,8 +135,16 @@ ENGINE_ERROR_CODE slabs_init(struct default_engine *engine,
     }
 
     memset(engine->slabs.slabclass, 0, sizeof(engine->slabs.slabclass));
-
-    while (++i < POWER_LARGEST && size <= engine->config.item_size_max / factor) {
+    engine->slabs.rebal.running = false;
+    engine->slabs.slabs_moved = 0;
+    engine->slabs.reassign_evictions = 0;
+    engine->slabs.reassign_busy = 0;
+    engine->slabs.automove.running = false;
+    engine->slabs.automove.stop = false;
+    engine->slabs.large_clsid = 0;
+    engine->slabs.large_malloced = 0;
+
+    while (++i < classes && size <= chunk_max / factor) {
         /* Make sure items are always n-byte aligned */
         if (size % CHUNK_ALIGN_BYTES)
             size += CHUNK_ALIGN_BYTES - (size % CHUNK_ALIGN_BYTES);
@@ -117,6 +154,12 @@ ENGINE_ERROR_CODE slabs_init(struct default_engine *engine,
         size = (unsigned int)(size * factor);
     }
 
+    if (large) {
+        engine->slabs.slabclass[i].size = (unsigned int)chunk_max;
+        engine->slabs.slabclass[i].perslab = (unsigned int)(engine->config.item_size_max / chunk_max);
+        engine->slabs.large_clsid = ++i;
+    }
+
     engine->slabs.power_largest = i;
     engine->slabs.slabclass[engine->slabs.power_largest].size = (unsigned int)engine->config.item_size_max;
     engine->slabs.slabclass[engine->slabs.power_largest].perslab = 1;
@@ -176,9 +219,21 @@ static int grow_slab_list (struct default_engine *engine, const unsigned int id)
     return 1;
 }
 
+/*
+ * With slab_automove all of the pages are item_size_max bytes (which holds
+ * perslab chunks of any class), so a page may be moved to any class.
+ */
+static size_t slab_page_size(struct default_engine *engine,
+                             const slabclass_t *p) {
+    if (engine->config.slab_automove) {
+        return engine->config.item_size_max;
+    }
+    return size_t(p->size) * p->perslab;
+}
+
 static int do_slabs_newslab(struct default_engine *engine, const unsigned int id) {
     slabclass_t *p = &engine->slabs.slabclass[id];
-    int len = p->size * p->perslab;
+    int len = (int)slab_page_size(engine, p);
     char *ptr;
 
     if ((engine->slabs.mem_limit && engine->slabs.mem_malloced + len > engine->slabs.mem_limit && p->slabs > 0) ||
@@ -198,6 +253,45 @@ static int do_slabs_newslab(struct default_engine *engine, const unsigned int id
     return 1;
 }
 
+/* Allocate the memory for an item of the large class (slabs lock held) */
+static void *do_slabs_alloc_large(struct default_engine *engine,
+                                  const size_t size,
+                                  slabclass_t *p) {
+    if (engine->slabs.mem_limit &&
+        engine->slabs.mem_malloced + size > engine->slabs.mem_limit) {
+        return NULL;
+    }
+
+    void *ret = cb_malloc(size);
+    if (ret == NULL) {
+        return NULL;
+    }
+    try {
+        engine->slabs.large.emplace(ret, size);
+    } catch (const std::bad_alloc&) {
+        cb_free(ret);
+        return NULL;
+    }
+    /* The item code expects the header of a free chunk to be cleared */
+    memset(ret, 0, sizeof(hash_item));
+    engine->slabs.mem_malloced += size;
+    engine->slabs.large_malloced += size;
+    p->requested += size;
+    return ret;
+}
+
+static void do_slabs_free_large(struct default_engine *engine,
+                                void *ptr,
+                                slabclass_t *p) {
+    auto iter = engine->slabs.large.find(ptr);
+    cb_assert(iter != engine->slabs.large.end());
+    engine->slabs.mem_malloced -= iter->second;
+    engine->slabs.large_malloced -= iter->second;
+    p->requested -= iter->second;
+    engine->slabs.large.erase(iter);
+    cb_free(ptr);
+}
+
 /*@null@*/
 static void *do_slabs_alloc(struct default_engine *engine, const size_t size, unsigned int id) {
     slabclass_t *p;
@@ -220,6 +314,10 @@ static void *do_slabs_alloc(struct default_engine *engine, const size_t size, un
     return ret;
 #endif
 
+    if (slabs_is_large(engine, id)) {
+        return do_slabs_alloc_large(engine, size, p);
+    }
+
     /* fail unless we have space at the end of a recently allocated page,
        we have something on our freelist, or we could allocate a new page */
     if (! (p->end_page_ptr != 0 || p->sl_curr != 0 ||
@@ -261,18 +359,37 @@ static void do_slabs_free(struct default_engine *engine, void *ptr, const size_t
     return;
 #endif
 
+    if (slabs_is_large(engine, id)) {
+        do_slabs_free_large(engine, ptr, p);
+        return;
+    }
+
+    if (engine->slabs.rebal.running && id == engine->slabs.rebal.s_clsid &&
+        rebal_chunk_free(engine, ptr)) {
+        /* The chunk's page is being moved; don't hand it out again */
+        p->requested -= size;
+        return;
+    }
+
+    if (do_slabs_add_free(p, ptr) == 0)
+        return;
+    p->requested -= size;
+    return;
+}
+
+/* Puts a chunk on the free list of slab class p. Returns 0 on failure. */
+static int do_slabs_add_free(slabclass_t *p, void *ptr) {
     if (p->sl_curr == p->sl_total) { /* need more space on the free list */
         int new_size = (p->sl_total != 0) ? p->sl_total * 2 : 16;  /* 16 is arbitrary */
         void **new_slots = static_cast<void**>(cb_realloc(p->slots,
                                                new_size * sizeof(void *)));
         if (new_slots == 0)
-            return;
+            return 0;
         p->slots = new_slots;
         p->sl_total = new_size;
     }
     p->slots[p->sl_curr++] = ptr;
-    p->requested -= size;
-    return;
+    return 1;
 }
 
 void add_statistics(const void* cookie,
@@ -366,6 +483,20 @@ static void do_slabs_stats(struct default_engine* engine,
     add_statistics(cookie, add_stats, NULL, -1, "active_slabs", "%d", total);
     add_statistics(cookie, add_stats, NULL, -1, "total_malloced", "%" PRIu64,
                    (uint64_t)engine->slabs.mem_malloced);
+    add_statistics(cookie, add_stats, NULL, -1, "large_items", "%" PRIu64,
+                   (uint64_t)engine->slabs.large.size());
+    add_statistics(cookie, add_stats, NULL, -1, "large_malloced", "%" PRIu64,
+                   (uint64_t)engine->slabs.large_malloced);
+    add_statistics(cookie, add_stats, NULL, -1, "slab_automove", "%d",
+                   engine->config.slab_automove ? 1 : 0);
+    add_statistics(cookie, add_stats, NULL, -1, "slab_reassign_running", "%d",
+                   engine->slabs.rebal.running ? 1 : 0);
+    add_statistics(cookie, add_stats, NULL, -1, "slabs_moved", "%" PRIu64,
+                   engine->slabs.slabs_moved);
+    add_statistics(cookie, add_stats, NULL, -1, "slab_reassign_evictions",
+                   "%" PRIu64, engine->slabs.reassign_evictions);
+    add_statistics(cookie, add_stats, NULL, -1, "slab_reassign_busy",
+                   "%" PRIu64, engine->slabs.reassign_busy);
 }
 
 static void *memory_allocate(struct default_engine *engine, size_t size) {
@@ -439,6 +570,11 @@ void slabs_destroy(struct default_engine *e)
     }
     cb_free(e->slabs.allocs.ptrs);
 
+    for (auto& entry : e->slabs.large) {
+        cb_free(entry.first);
+    }
+    e->slabs.large.clear();
+
     /* Release the freelists */
     for (jj = POWER_SMALLEST; jj <= e->slabs.power_largest; jj++) {
         slabclass_t *p = &e->slabs.slabclass[jj];
@@ -446,3 +582,356 @@ void slabs_destroy(struct default_engine *e)
         cb_free(p->slab_list);
     }
 }
+
+/*
+ * Slab page reassignment.
+ *
+ * The first page of the source class is emptied: its free chunks are taken
+ * off the free list, chunks freed while it is being emptied aren't put back
+ * on it, and the linked items on it are unlinked (without holding the slab
+ * lock, as the item locks are acquired before it). Once all of its chunks
+ * are free it is handed to the destination class.
+ */
+
+/* How many times we try to evict the items on a page before giving up */
+static const int reassign_max_passes = 1000;
+
+/*
+ * How often the balancer looks at the evictions, and for how many periods
+ * a class must have had the most evictions (and another one none) before
+ * a page is moved.
+ */
+static const std::chrono::seconds automove_interval{10};
+static const int automove_windows = 3;
+
+/* Is ptr a chunk of the page being moved (slabs lock held) */
+static int rebal_chunk_index(struct default_engine *engine, const void *ptr) {
+    const auto& rebal = engine->slabs.rebal;
+    const slabclass_t *p = &engine->slabs.slabclass[rebal.s_clsid];
+    const char *chunk = static_cast<const char*>(ptr);
+    if (chunk < rebal.slab_start ||
+        chunk >= rebal.slab_start + size_t(p->size) * p->perslab) {
+        return -1;
+    }
+    return int((chunk - rebal.slab_start) / p->size);
+}
+
+/*
+ * Records that a chunk of the page being moved is free (slabs lock held).
+ * Returns false if ptr isn't on that page.
+ */
+static bool rebal_chunk_free(struct default_engine *engine, const void *ptr) {
+    auto& rebal = engine->slabs.rebal;
+    const int idx = rebal_chunk_index(engine, ptr);
+    if (idx < 0) {
+        return false;
+    }
+    if (!rebal.freed[idx]) {
+        rebal.freed[idx] = true;
+        ++rebal.nfreed;
+    }
+    return true;
+}
+
+static ENGINE_ERROR_CODE do_slabs_reassign_start(struct default_engine *engine,
+                                                 unsigned int src,
+                                                 unsigned int dst) {
+    auto& rebal = engine->slabs.rebal;
+    if (src == dst || src < POWER_SMALLEST || dst < POWER_SMALLEST ||
+        src > engine->slabs.power_largest || dst > engine->slabs.power_largest ||
+        slabs_is_large(engine, src) || slabs_is_large(engine, dst)) {
+        return ENGINE_EINVAL;
+    }
+    if (rebal.running) {
+        return ENGINE_TMPFAIL;
+    }
+
+    slabclass_t *p = &engine->slabs.slabclass[src];
+    /* Leave every class with at least one page */
+    if (p->slabs < 2) {
+        return ENGINE_KEY_ENOENT;
+    }
+    if (grow_slab_list(engine, dst) == 0) {
+        return ENGINE_ENOMEM;
+    }
+
+    rebal.running = true;
+    rebal.s_clsid = src;
+    rebal.d_clsid = dst;
+    rebal.slab_start = static_cast<char*>(p->slab_list[0]);
+    rebal.freed.assign(p->perslab, false);
+    rebal.nfreed = 0;
+    p->killing = 1;
+
+    /* Chunks on the free list are free already */
+    unsigned int kept = 0;
+    for (unsigned int ii = 0; ii < p->sl_curr; ++ii) {
+        if (!rebal_chunk_free(engine, p->slots[ii])) {
+            p->slots[kept++] = p->slots[ii];
+        }
+    }
+    p->sl_curr = kept;
+
+    /* So are the ones at the end of the page which were never handed out */
+    if (p->end_page_ptr != NULL &&
+        rebal_chunk_index(engine, p->end_page_ptr) >= 0) {
+        char *chunk = static_cast<char*>(p->end_page_ptr);
+        for (unsigned int ii = 0; ii < p->end_page_free; ++ii) {
+            rebal_chunk_free(engine, chunk);
+            chunk += p->size;
+        }
+        p->end_page_ptr = NULL;
+        p->end_page_free = 0;
+    }
+
+    return ENGINE_SUCCESS;
+}
+
+static void do_slabs_reassign_finish(struct default_engine *engine) {
+    auto& rebal = engine->slabs.rebal;
+    slabclass_t *s = &engine->slabs.slabclass[rebal.s_clsid];
+    slabclass_t *d = &engine->slabs.slabclass[rebal.d_clsid];
+
+    for (unsigned int ii = 0; ii < s->slabs; ++ii) {
+        if (s->slab_list[ii] == rebal.slab_start) {
+            s->slab_list[ii] = s->slab_list[--s->slabs];
+            break;
+        }
+    }
+    s->killing = 0;
+
+    memset(rebal.slab_start, 0, engine->config.item_size_max);
+    d->slab_list[d->slabs++] = rebal.slab_start;
+    if (d->end_page_ptr == NULL) {
+        d->end_page_ptr = rebal.slab_start;
+        d->end_page_free = d->perslab;
+    } else {
+        char *chunk = rebal.slab_start;
+        for (unsigned int ii = 0; ii < d->perslab; ++ii) {
+            if (do_slabs_add_free(d, chunk) == 0) {
+                break;
+            }
+            chunk += d->size;
+        }
+    }
+
+    rebal.running = false;
+    rebal.freed.clear();
+    engine->slabs.slabs_moved++;
+}
+
+static void do_slabs_reassign_abort(struct default_engine *engine) {
+    auto& rebal = engine->slabs.rebal;
+    slabclass_t *s = &engine->slabs.slabclass[rebal.s_clsid];
+
+    /* Give the free chunks back to the source class */
+    for (unsigned int ii = 0; ii < rebal.freed.size(); ++ii) {
+        if (rebal.freed[ii]) {
+            do_slabs_add_free(s, rebal.slab_start + size_t(ii) * s->size);
+        }
+    }
+    s->killing = 0;
+    rebal.running = false;
+    rebal.freed.clear();
+    engine->slabs.reassign_busy++;
+}
+
+ENGINE_ERROR_CODE slabs_reassign(struct default_engine *engine,
+                                 unsigned int src,
+                                 unsigned int dst) {
+#ifdef USE_SYSTEM_MALLOC
+    return ENGINE_ENOTSUP;
+#endif
+    if (!engine->config.slab_automove) {
+        return ENGINE_ENOTSUP;
+    }
+
+    std::unique_lock<std::mutex> guard(engine->slabs.lock);
+    auto ret = do_slabs_reassign_start(engine, src, dst);
+    if (ret != ENGINE_SUCCESS) {
+        return ret;
+    }
+
+    const auto& rebal = engine->slabs.rebal;
+    const size_t chunk_size = engine->slabs.slabclass[src].size;
+    std::vector<hash_item*> used;
+    for (int pass = 0;; ++pass) {
+        if (rebal.nfreed == rebal.freed.size()) {
+            do_slabs_reassign_finish(engine);
+            return ENGINE_SUCCESS;
+        }
+        if (pass == reassign_max_passes) {
+            do_slabs_reassign_abort(engine);
+            return ENGINE_TMPFAIL;
+        }
+
+        used.clear();
+        for (unsigned int ii = 0; ii < rebal.freed.size(); ++ii) {
+            if (!rebal.freed[ii]) {
+                used.push_back(reinterpret_cast<hash_item*>(
+                        rebal.slab_start + ii * chunk_size));
+            }
+        }
+
+        guard.unlock();
+        uint64_t evicted = 0;
+        for (auto* it : used) {
+            if (item_unlink_chunk(engine, it, chunk_size)) {
+                ++evicted;
+            }
+        }
+        if (pass != 0) {
+            /* Give the users of the remaining items time to release them */
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        guard.lock();
+        engine->slabs.reassign_evictions += evicted;
+    }
+}
+
+/*
+ * Picks a page to move: the class with the most evictions in each of the
+ * last automove_windows periods gets a page from the class with the most
+ * pages among those without evictions in all of them.
+ */
+struct automove_state {
+    unsigned int evicted[MAX_NUMBER_OF_SLAB_CLASSES] = {};
+    int zero_windows[MAX_NUMBER_OF_SLAB_CLASSES] = {};
+    unsigned int winner = 0;
+    int winner_windows = 0;
+};
+
+static bool automove_decide(struct default_engine *engine,
+                            automove_state& state,
+                            unsigned int& src,
+                            unsigned int& dst) {
+    unsigned int slabs[MAX_NUMBER_OF_SLAB_CLASSES];
+    unsigned int power_largest;
+    {
+        std::lock_guard<std::mutex> guard(engine->slabs.lock);
+        power_largest = engine->slabs.power_largest;
+        for (unsigned int ii = POWER_SMALLEST; ii <= power_largest; ++ii) {
+            slabs[ii] = engine->slabs.slabclass[ii].slabs;
+        }
+    }
+
+    unsigned int highest = 0;
+    unsigned int highest_delta = 0;
+    for (unsigned int ii = POWER_SMALLEST; ii <= power_largest; ++ii) {
+        if (slabs_is_large(engine, ii)) {
+            /* It has no pages */
+            continue;
+        }
+        unsigned int evicted;
+        {
+            std::lock_guard<std::mutex> guard(engine->items.lru_locks[ii]);
+            evicted = engine->items.itemstats[ii].evicted;
+        }
+        /* The stats may have been reset */
+        const unsigned int delta = evicted >= state.evicted[ii]
+                                           ? evicted - state.evicted[ii]
+                                           : evicted;
+        state.evicted[ii] = evicted;
+
+        if (delta == 0 && slabs[ii] > 2) {
+            state.zero_windows[ii]++;
+        } else {
+            state.zero_windows[ii] = 0;
+        }
+        if (delta > highest_delta) {
+            highest = ii;
+            highest_delta = delta;
+        }
+    }
+
+    if (highest == 0) {
+        state.winner_windows = 0;
+        return false;
+    }
+    if (highest == state.winner) {
+        state.winner_windows++;
+    } else {
+        state.winner = highest;
+        state.winner_windows = 1;
+    }
+    if (state.winner_windows < automove_windows) {
+        return false;
+    }
+
+    src = 0;
+    for (unsigned int ii = POWER_SMALLEST; ii <= power_largest; ++ii) {
+        if (ii != highest && state.zero_windows[ii] >= automove_windows &&
+            (src == 0 || slabs[ii] > slabs[src])) {
+            src = ii;
+        }
+    }
+    if (src == 0) {
+        return false;
+    }
+    dst = highest;
+    state.winner_windows = 0;
+    return true;
+}
+
+static void slabs_automove_main(void *arg) {
+    auto* engine = static_cast<struct default_engine*>(arg);
+    auto& automove = engine->slabs.automove;
+    automove_state state;
+
+    std::unique_lock<std::mutex> lock(automove.lock);
+    while (!automove.stop) {
+        automove.cond.wait_for(
+                lock, automove_interval, [&automove] { return automove.stop; });
+        if (automove.stop) {
+            break;
+        }
+        lock.unlock();
+        unsigned int src;
+        unsigned int dst;
+        if (automove_decide(engine, state, src, dst)) {
+            const auto ret = slabs_reassign(engine, src, dst);
+            if (ret != ENGINE_SUCCESS) {
+                LOG_DEBUG("Failed to move a slab page from class {} to {}: {}",
+                          src,
+                          dst,
+                          int(ret));
+            }
+        }
+        lock.lock();
+    }
+}
+
+ENGINE_ERROR_CODE slabs_automove_start(struct default_engine *engine) {
+    auto& automove = engine->slabs.automove;
+    std::lock_guard<std::mutex> guard(automove.lock);
+    if (automove.running) {
+        return ENGINE_SUCCESS;
+    }
+
+    automove.stop = false;
+    if (cb_create_named_thread(&automove.thread,
+                               slabs_automove_main,
+                               engine,
+                               0,
+                               "mc:slab_automove") != 0) {
+        LOG_WARNING("Failed to create the slab automove thread: {}",
+                    cb_strerror());
+        return ENGINE_FAILED;
+    }
+    automove.running = true;
+    return ENGINE_SUCCESS;
+}
+
+void slabs_automove_stop(struct default_engine *engine) {
+    auto& automove = engine->slabs.automove;
+    {
+        std::lock_guard<std::mutex> guard(automove.lock);
+        if (!automove.running) {
+            return;
+        }
+        automove.stop = true;
+        automove.cond.notify_one();
+    }
+    cb_join_thread(automove.thread);
+    automove.running = false;
+}
@@ -4,7 +4,13 @@
 #include <memcached/engine_common.h>
 #include <memcached/engine_error.h>
 
+#include <platform/platform_thread.h>
+
+#include <condition_variable>
+#include <cstdint>
 #include <mutex>
+#include <unordered_map>
+#include <vector>
 
 /* Slab sizing definitions. */
 #define POWER_SMALLEST 1
@@ -41,6 +47,16 @@ struct slabs {
    size_t mem_malloced;
    unsigned int power_largest;
 
+   /**
+    * With slab_chunk_max the slab classes only go up to that size, and the
+    * items larger than it are in this class (power_largest, or 0 if there
+    * is none). Rather than from slab pages their memory is allocated one
+    * item at a time, of the item's size; large maps it to its size.
+    */
+   unsigned int large_clsid;
+   std::unordered_map<void*, size_t> large;
+   size_t large_malloced;
+
    void *mem_base;
    void *mem_current;
    size_t mem_avail;
@@ -51,6 +67,36 @@ struct slabs {
       size_t size;
    } allocs;
 
+   /**
+    * The page being moved to another slab class by slabs_reassign. Its
+    * chunks aren't handed out (or put back on the free list) while it is
+    * being emptied; freed records the ones which are free.
+    */
+   struct {
+      bool running;
+      unsigned int s_clsid;
+      unsigned int d_clsid;
+      char *slab_start;
+      std::vector<bool> freed;
+      unsigned int nfreed;
+   } rebal;
+
+   /** Pages moved between slab classes */
+   uint64_t slabs_moved;
+   /** Items evicted to empty pages being moved */
+   uint64_t reassign_evictions;
+   /** Page moves given up as their items couldn't be evicted */
+   uint64_t reassign_busy;
+
+   /** The background balancer (slab_automove) */
+   struct {
+      std::mutex lock;
+      std::condition_variable cond;
+      cb_thread_t thread;
+      bool running;
+      bool stop;
+   } automove;
+
    /**
     * Access to the slab allocator is protected by this lock
     */
@@ -73,6 +119,29 @@ ENGINE_ERROR_CODE slabs_init(struct default_engine *engine,
 
 void slabs_destroy(struct default_engine *engine);
 
+/**
+ * Move a page from slab class src to slab class dst (requires
+ * slab_automove, which makes all of the pages the same size). The items on
+ * the page are evicted; blocks until the page has been moved or given up.
+ *
+ * @return ENGINE_SUCCESS if the page was moved, ENGINE_KEY_ENOENT if src
+ *         has no page to spare, ENGINE_TMPFAIL if the page's items couldn't
+ *         be evicted (they're in use), ENGINE_EINVAL for invalid classes
+ *         and ENGINE_ENOTSUP without slab_automove
+ */
+ENGINE_ERROR_CODE slabs_reassign(struct default_engine *engine,
+                                 unsigned int src,
+                                 unsigned int dst);
+
+/**
+ * Start the background balancer, which moves pages from slab classes
+ * without evictions to the class with the most evictions.
+ */
+ENGINE_ERROR_CODE slabs_automove_start(struct default_engine *engine);
+
+/** Stop (and join) the background balancer if it is running */
+void slabs_automove_stop(struct default_engine *engine);
+
 /**
  * Given object size, return id to use when allocating/freeing memory for object
  * 0 means error: can't store such a large object
@@ -80,6 +149,9 @@ void slabs_destroy(struct default_engine *engine);
 
 unsigned int slabs_clsid(struct default_engine *engine, const size_t size);
 
+/** Is id the class of the items allocated one at a time (slab_chunk_max) */
+bool slabs_is_large(struct default_engine *engine, unsigned int id);
+
 /** Allocate object of given length. 0 on error */ /*@null@*/
 void *slabs_alloc(struct default_engine *engine, size_t size, unsigned int id);
 
@@ -22,12 +22,17 @@
 #include <access_scanner.h>
 #include <fakes/fake_executorpool.h>
 #include <mock/mock_synchronous_ep_engine.h>
+#include <mutation_log.h>
+#include <platform/dirutils.h>
 #include <programs/engine_testapp/mock_server.h>
 
 #include "benchmark_memory_tracker.h"
 
 #include "engine_fixture.h"
 
+#include <algorithm>
+#include <vector>
+
 class AccessLogBenchEngine : public EngineFixture {
 protected:
     void SetUp(const benchmark::State& state) override {
@@ -112,3 +117,52 @@ static void AccessScannerArguments(benchmark::internal::Benchmark* b) {
 BENCHMARK_REGISTER_F(AccessLogBenchEngine, MemoryOverhead)
         ->Apply(AccessScannerArguments)
         ->MinTime(0.000001);
+
+/*
+ * Measures the time taken to read back (harvest) an access log, as done by
+ * warmup, along with the on-disk size of the log.
+ * Variables:
+ *  - range(0) : The number of keys in the log
+ */
+static void AccessLogRead(benchmark::State& state) {
+    const auto logPath = cb::io::mktemp("access_log_bench");
+    const auto numKeys = size_t(state.range(0));
+    std::string keyPrefixPre(20, 'a');
+
+    size_t logSize;
+    {
+        // The AccessScanner writes keys in sorted order.
+        std::vector<std::string> keys;
+        for (size_t i = 0; i < numKeys; ++i) {
+            keys.push_back(keyPrefixPre + std::to_string(i));
+        }
+        std::sort(keys.begin(), keys.end());
+
+        MutationLog ml(logPath);
+        ml.open();
+        for (const auto& key : keys) {
+            ml.newItem(Vbid(0), StoredDocKey(key, CollectionID::Default));
+        }
+        ml.commit1();
+        ml.commit2();
+        logSize = ml.logSize;
+    }
+
+    while (state.KeepRunning()) {
+        MutationLog ml(logPath);
+        ml.open(true);
+        MutationLogHarvester harvester(ml);
+        harvester.setVBucket(Vbid(0));
+        harvester.load();
+        if (harvester.total() != numKeys) {
+            state.SkipWithError("Failed to read back all keys");
+            break;
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * numKeys);
+    state.counters["LogBytesPerKey"] = double(logSize) / numKeys;
+    cb::io::rmrf(logPath);
+}
+
+BENCHMARK(AccessLogRead)->Arg(32768)->Arg(65536);
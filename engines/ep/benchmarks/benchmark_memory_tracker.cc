@@ -26,6 +26,7 @@ std::atomic<BenchmarkMemoryTracker*> BenchmarkMemoryTracker::instance;
 std::mutex BenchmarkMemoryTracker::instanceMutex;
 std::atomic<size_t> BenchmarkMemoryTracker::maxTotalAllocation;
 std::atomic<size_t> BenchmarkMemoryTracker::currentAlloc;
+std::atomic<size_t> BenchmarkMemoryTracker::allocCount;
 
 BenchmarkMemoryTracker::~BenchmarkMemoryTracker() {
     hooks_api.remove_new_hook(&NewHook);
@@ -65,6 +66,10 @@ size_t BenchmarkMemoryTracker::getCurrentAlloc() {
     return currentAlloc;
 }
 
+size_t BenchmarkMemoryTracker::getAllocCount() {
+    return allocCount;
+}
+
 BenchmarkMemoryTracker::BenchmarkMemoryTracker(
         const ServerAllocatorIface& hooks_api)
     : hooks_api(hooks_api) {
@@ -87,6 +92,7 @@ void BenchmarkMemoryTracker::NewHook(const void* ptr, size_t) {
         void* p = const_cast<void*>(ptr);
         size_t alloc = tracker->hooks_api.get_allocation_size(p);
         currentAlloc += alloc;
+        ++allocCount;
         maxTotalAllocation.store(
                 std::max(currentAlloc.load(), maxTotalAllocation.load()));
         ObjectRegistry::memoryAllocated(alloc);
@@ -105,4 +111,5 @@ void BenchmarkMemoryTracker::DeleteHook(const void* ptr) {
 void BenchmarkMemoryTracker::reset() {
     currentAlloc.store(0);
     maxTotalAllocation.store(0);
+    allocCount.store(0);
 }
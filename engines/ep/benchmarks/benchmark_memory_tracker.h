@@ -28,7 +28,7 @@
  * singleton is created.
  *
  * Tracks the current allocation along with the maximum total allocation size
- * it has seen.
+ * it has seen, and the number of allocations made.
  */
 class BenchmarkMemoryTracker {
 public:
@@ -43,6 +43,7 @@ public:
 
     size_t getMaxAlloc();
     size_t getCurrentAlloc();
+    size_t getAllocCount();
 
 private:
     BenchmarkMemoryTracker(const ServerAllocatorIface& hooks_api);
@@ -55,4 +56,5 @@ private:
     ServerAllocatorIface hooks_api;
     static std::atomic<size_t> maxTotalAllocation;
     static std::atomic<size_t> currentAlloc;
+    static std::atomic<size_t> allocCount;
 };
@@ -0,0 +1,86 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks relating to the BloomFilter class.
+ */
+
+#include "bloomfilter.h"
+#include "module_tests/test_helpers.h"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+static std::vector<StoredDocKey> makeKeys(size_t count, const char* prefix) {
+    std::vector<StoredDocKey> keys;
+    keys.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        keys.push_back(makeStoredDocKey(prefix + std::to_string(i)));
+    }
+    return keys;
+}
+
+/**
+ * Benchmark lookups of keys which are not in a filter sized for (and
+ * holding) state.range(1) keys - the common case for a full-eviction
+ * front-end miss. state.range(0) selects the BloomFilter::Type.
+ */
+static void BM_BloomFilterMaybeKeyExists(benchmark::State& state) {
+    const auto type = BloomFilter::Type(state.range(0));
+    const size_t keyCount = state.range(1);
+    BloomFilter filter(keyCount, 0.01, BFILTER_ENABLED, type);
+    for (const auto& key : makeKeys(keyCount, "key_")) {
+        filter.addKey(key);
+    }
+
+    const auto missing = makeKeys(10000, "missing_");
+    size_t ii = 0;
+    size_t positives = 0;
+    while (state.KeepRunning()) {
+        positives += filter.maybeKeyExists(missing[ii]);
+        ii = (ii + 1) % missing.size();
+    }
+    state.counters["FalsePositiveRate"] =
+            double(positives) / state.iterations();
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_BloomFilterAddKey(benchmark::State& state) {
+    const auto type = BloomFilter::Type(state.range(0));
+    const size_t keyCount = state.range(1);
+    BloomFilter filter(keyCount, 0.01, BFILTER_ENABLED, type);
+    const auto keys = makeKeys(10000, "key_");
+    size_t ii = 0;
+    while (state.KeepRunning()) {
+        filter.addKey(keys[ii]);
+        ii = (ii + 1) % keys.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BloomFilterArgs(benchmark::internal::Benchmark* b) {
+    for (auto type : {BloomFilter::Type::Standard, BloomFilter::Type::Blocked}) {
+        // Sized so the filter fits in cache, and so it doesn't.
+        for (int keys : {10000, 10000000}) {
+            b->Args({int(type), keys});
+        }
+    }
+}
+
+BENCHMARK(BM_BloomFilterMaybeKeyExists)->Apply(BloomFilterArgs);
+BENCHMARK(BM_BloomFilterAddKey)->Apply(BloomFilterArgs);
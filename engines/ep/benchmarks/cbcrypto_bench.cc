@@ -0,0 +1,74 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks of the encryption of couchstore files (see
+ * couchstore_encryption_key_file): cb::crypto::StreamCipher encrypting a
+ * buffer in place, against cb::crypto::encrypt (which allocates the
+ * ciphertext of every call).
+ */
+
+#include <benchmark/benchmark.h>
+#include <cbcrypto/cbcrypto.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+static std::vector<char> makeBuffer(size_t size) {
+    std::vector<char> buffer(size);
+    std::mt19937 rng(0);
+    for (auto& byte : buffer) {
+        byte = char(rng());
+    }
+    return buffer;
+}
+
+static const std::string key(32, 'k');
+static const std::string iv(16, 'i');
+
+static void BM_StreamCipher(benchmark::State& state) {
+    auto buffer = makeBuffer(state.range(0));
+    cb::crypto::StreamCipher cipher(
+            cb::crypto::Cipher::AES_256_ctr, {key}, {iv});
+    uint64_t offset = 0;
+    while (state.KeepRunning()) {
+        cipher.process(offset, {buffer.data(), buffer.size()});
+        offset += buffer.size();
+    }
+    state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+
+static void BM_EncryptCbc(benchmark::State& state) {
+    const auto buffer = makeBuffer(state.range(0));
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(
+                cb::crypto::encrypt(cb::crypto::Cipher::AES_256_cbc,
+                                    {key},
+                                    {iv},
+                                    {buffer.data(), buffer.size()}));
+    }
+    state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+
+// From a couchstore block (4KB) to a large document or compaction write.
+BENCHMARK(BM_StreamCipher)->RangeMultiplier(8)->Range(4096, 1 << 20);
+BENCHMARK(BM_EncryptCbc)->RangeMultiplier(8)->Range(4096, 1 << 20);
+BENCHMARK(BM_StreamCipher)
+        ->RangeMultiplier(8)
+        ->Range(4096, 1 << 20)
+        ->ThreadPerCpu();
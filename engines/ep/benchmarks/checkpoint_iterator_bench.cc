@@ -20,10 +20,14 @@
  */
 
 #include "atomic.h"
+#include "checkpoint.h"
 #include "checkpoint_iterator.h"
+#include "item.h"
+#include "stats.h"
 
 #include <benchmark/benchmark.h>
 #include <list>
+#include <random>
 
 typedef std::unique_ptr<int> TestItem;
 typedef std::list<TestItem> ListContainer;
@@ -59,3 +63,52 @@ static void BM_CheckpointIteratorCompare(benchmark::State& state) {
 
 // Register the function as a benchmark
 BENCHMARK(BM_CheckpointIteratorCompare);
+
+/**
+ * Benchmark positioning an iterator at a random seqno in a large checkpoint,
+ * as CheckpointManager::registerCursorBySeqno does for each new cursor.
+ * Arguments are the number of items in the checkpoint, and whether to start
+ * the search from the checkpoint's seqno index (1) or from its beginning (0).
+ */
+static void BM_CheckpointPositionBySeqno(benchmark::State& state) {
+    const int64_t numItems = state.range(0);
+    const bool useIndex = state.range(1);
+
+    EPStats stats;
+    Checkpoint checkpoint(stats, 1, 0, numItems, Vbid(0));
+    checkpoint.addItemToCheckpoint(queued_item(
+            new Item(StoredDocKey(std::string("dummy_key"),
+                                  CollectionID::Default),
+                     Vbid(0),
+                     queue_op::empty,
+                     /*revSeq*/ 0,
+                     /*bySeq*/ 0)));
+    for (int64_t seqno = 1; seqno <= numItems; ++seqno) {
+        checkpoint.addItemToCheckpoint(queued_item(
+                new Item(StoredDocKey("key" + std::to_string(seqno),
+                                      CollectionID::Default),
+                         Vbid(0),
+                         queue_op::mutation,
+                         /*revSeq*/ 0,
+                         seqno)));
+    }
+
+    std::mt19937 gen;
+    std::uniform_int_distribution<int64_t> dist(1, numItems);
+    while (state.KeepRunning()) {
+        const auto seqno = dist(gen);
+        auto it = useIndex ? checkpoint.getIteratorAtOrBeforeSeqno(seqno)
+                           : checkpoint.begin();
+        auto next = it;
+        while (++next != checkpoint.end() && (*next)->getBySeqno() <= seqno) {
+            it = next;
+        }
+        benchmark::DoNotOptimize((*it)->getBySeqno());
+    }
+}
+
+BENCHMARK(BM_CheckpointPositionBySeqno)
+        ->Args({1000, 0})
+        ->Args({1000, 1})
+        ->Args({500000, 0})
+        ->Args({500000, 1});
@@ -0,0 +1,61 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks of the checksums used by ep-engine: crc32buf (the CRC-32 of
+ * the access log) and platform's crc32c (HashTable snapshots, spilled
+ * values, key hashing).
+ */
+
+extern "C" {
+#include "crc32.h"
+}
+
+#include <benchmark/benchmark.h>
+#include <platform/crc32c.h>
+
+#include <random>
+#include <vector>
+
+static std::vector<uint8_t> makeBuffer(size_t size) {
+    std::vector<uint8_t> buffer(size);
+    std::mt19937 rng(0);
+    for (auto& byte : buffer) {
+        byte = uint8_t(rng());
+    }
+    return buffer;
+}
+
+static void BM_Crc32buf(benchmark::State& state) {
+    auto buffer = makeBuffer(state.range(0));
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(crc32buf(buffer.data(), buffer.size()));
+    }
+    state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+
+static void BM_Crc32c(benchmark::State& state) {
+    const auto buffer = makeBuffer(state.range(0));
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(crc32c(buffer.data(), buffer.size(), 0));
+    }
+    state.SetBytesProcessed(state.iterations() * buffer.size());
+}
+
+// From a key to an access log block (4KB) and a large value.
+BENCHMARK(BM_Crc32buf)->RangeMultiplier(8)->Range(16, 1 << 20);
+BENCHMARK(BM_Crc32c)->RangeMultiplier(8)->Range(16, 1 << 20);
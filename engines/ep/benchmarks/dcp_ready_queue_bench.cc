@@ -0,0 +1,80 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks relating to the DcpReadyQueue class.
+ */
+
+#include "dcp/ready-queue.h"
+
+#include <benchmark/benchmark.h>
+#include <platform/sysinfo.h>
+
+#include <random>
+
+static const size_t numVBuckets = 1024;
+
+/**
+ * Models a DcpProducer: thread 0 repeatedly pops a ready vbucket and
+ * re-pushes it (as getNextItem does when a stream returned an item), while
+ * every other thread notifies random vbuckets as ready - as front-end and
+ * checkpoint processor threads do via notifyStreamReady.
+ */
+static void BM_DcpReadyQueueNotifyAndPop(benchmark::State& state) {
+    static DcpReadyQueue* queue;
+    if (state.thread_index == 0) {
+        queue = new DcpReadyQueue(numVBuckets);
+        for (uint16_t vb = 0; vb < numVBuckets; ++vb) {
+            queue->pushUnique(Vbid(vb));
+        }
+    }
+
+    std::mt19937 gen(state.thread_index);
+    std::uniform_int_distribution<uint16_t> dist(0, numVBuckets - 1);
+    while (state.KeepRunning()) {
+        if (state.thread_index == 0) {
+            Vbid vbucket(0);
+            if (queue->popFront(vbucket)) {
+                queue->pushUnique(vbucket);
+            }
+        } else {
+            benchmark::DoNotOptimize(queue->pushUnique(Vbid(dist(gen))));
+        }
+    }
+
+    if (state.thread_index == 0) {
+        delete queue;
+    }
+}
+
+/**
+ * Notify a vbucket which is already queued - the common case for a busy
+ * producer, where the notification is a no-op.
+ */
+static void BM_DcpReadyQueuePushQueued(benchmark::State& state) {
+    static DcpReadyQueue queue(numVBuckets);
+    if (state.thread_index == 0) {
+        queue.pushUnique(Vbid(0));
+    }
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(queue.pushUnique(Vbid(0)));
+    }
+}
+
+BENCHMARK(BM_DcpReadyQueueNotifyAndPop)->ThreadRange(1, 16);
+BENCHMARK(BM_DcpReadyQueueNotifyAndPop)->Threads(cb::get_cpu_count() * 2);
+BENCHMARK(BM_DcpReadyQueuePushQueued)->ThreadRange(1, 16);
@@ -0,0 +1,115 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks relating to the DurabilityMonitor: the throughput of durable
+ * writes (Prepare, seqno-ack by the replicas and Commit) at the Active.
+ */
+
+#include "checkpoint_manager.h"
+#include "engine_fixture.h"
+#include "item.h"
+#include "kv_bucket.h"
+#include "vbucket.h"
+
+#include <folly/portability/GTest.h>
+
+class DurabilityBench : public EngineFixture {
+protected:
+    void SetUp(const benchmark::State& state) override {
+        varConfig = "max_size=1000000000";
+        EngineFixture::SetUp(state);
+
+        // First chain: the active and the given number of replicas.
+        nlohmann::json chain = {"active"};
+        for (int64_t i = 1; i <= state.range(0); ++i) {
+            replicas.push_back("replica" + std::to_string(i));
+            chain.push_back(replicas.back());
+        }
+        ASSERT_EQ(ENGINE_SUCCESS,
+                  engine->getKVBucket()->setVBucketState(
+                          vbid,
+                          vbucket_state_active,
+                          {{"topology", nlohmann::json::array({chain})}}));
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        engine->getKVBucket()->deleteVBucket(vbid, nullptr);
+        replicas.clear();
+        EngineFixture::TearDown(state);
+    }
+
+    std::vector<std::string> replicas;
+};
+
+/**
+ * Benchmark durable (Level::Majority) writes: each iteration prepares the
+ * given number of SyncWrites and then every replica acks all of them, so
+ * the Prepares become satisfied - and are committed - together when the
+ * majority has acked.
+ *
+ * Arguments: number of replicas, SyncWrites acked per seqno-ack.
+ */
+BENCHMARK_DEFINE_F(DurabilityBench, SyncWriteThroughput)
+(benchmark::State& state) {
+    const auto batchSize = state.range(1);
+    auto vb = engine->getKVBucket()->getVBucket(vbid);
+    vb->ht.resize(batchSize);
+
+    using namespace cb::durability;
+    const Requirements reqs{Level::Majority, Timeout::Infinity()};
+    const std::string value(1, 'x');
+    std::vector<std::string> keys;
+    for (int64_t i = 0; i < batchSize; ++i) {
+        keys.push_back("key" + std::to_string(i));
+    }
+
+    size_t syncWrites = 0;
+    while (state.KeepRunning()) {
+        for (const auto& key : keys) {
+            auto item = make_item(vbid, key, value);
+            item.setPendingSyncWrite(reqs);
+            ASSERT_EQ(ENGINE_EWOULDBLOCK,
+                      engine->getKVBucket()->set(item, cookie));
+        }
+
+        const auto seqno = vb->getHighSeqno();
+        for (const auto& replica : replicas) {
+            vb->seqnoAcknowledged(replica, seqno);
+        }
+        syncWrites += batchSize;
+
+        state.PauseTiming();
+        vb->checkpointManager->clear(*vb, vb->getHighSeqno());
+        state.ResumeTiming();
+    }
+
+    state.SetItemsProcessed(syncWrites);
+    state.SetLabel(("replicas:" + std::to_string(replicas.size())).c_str());
+}
+
+static void SyncWriteArguments(benchmark::internal::Benchmark* b) {
+    // 1..3 replicas, for 1..100 SyncWrites acked at once.
+    for (int replicas = 1; replicas <= 3; ++replicas) {
+        for (int batch = 1; batch <= 100; batch *= 10) {
+            b->ArgPair(replicas, batch);
+        }
+    }
+}
+
+BENCHMARK_REGISTER_F(DurabilityBench, SyncWriteThroughput)
+        ->Apply(SyncWriteArguments);
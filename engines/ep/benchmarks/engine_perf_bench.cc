@@ -0,0 +1,353 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks of whole-bucket operations (the scenarios of ep_perfsuite):
+ * front-end GET / SET at a range of residency ratios, BG fetches, and DCP
+ * streaming from memory and from disk. They run against a single vBucket of
+ * a couchstore bucket, with the tasks run inline, so the results are stable
+ * enough to compare from run to run (see tests/cbnt_tests).
+ */
+
+#include "bgfetcher.h"
+#include "checkpoint_manager.h"
+#include "dcp/active_stream_checkpoint_processor_task.h"
+#include "dcp/backfill-manager.h"
+#include "engine_fixture.h"
+#include "ep_bucket.h"
+#include "failover-table.h"
+#include "item.h"
+#include "kvshard.h"
+
+#include "../tests/mock/mock_dcp.h"
+#include "../tests/mock/mock_dcp_producer.h"
+#include "../tests/mock/mock_global_task.h"
+#include "../tests/module_tests/test_helpers.h"
+
+#include <folly/portability/GTest.h>
+
+#include <random>
+
+/// The number of documents loaded by the GET / SET benchmarks.
+static const size_t residencyItemCount = 100000;
+
+class EnginePerfBench : public EngineFixture {
+protected:
+    void SetUp(const benchmark::State& state) override {
+        varConfig = "max_size=1000000000";
+        EngineFixture::SetUp(state);
+        engine->getKVBucket()->setVBucketState(vbid, vbucket_state_active);
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        if (producer) {
+            producer->closeAllStreams();
+            producer->cancelCheckpointCreatorTask();
+            producer.reset();
+        }
+        EngineFixture::TearDown(state);
+    }
+
+    static std::string makeKey(size_t i) {
+        return "key" + std::to_string(i);
+    }
+
+    /// Set the given number of documents, and flush them to disk.
+    void loadItems(size_t count) {
+        const std::string value(256, 'x');
+        for (size_t i = 0; i < count; ++i) {
+            auto item = make_item(vbid, makeKey(i), value);
+            ASSERT_EQ(ENGINE_SUCCESS, engine->getKVBucket()->set(item, cookie));
+        }
+        flushAllItems();
+    }
+
+    size_t flushAllItems() {
+        size_t itemsFlushed = 0;
+        auto& ep = dynamic_cast<EPBucket&>(*engine->getKVBucket());
+        bool moreAvailable;
+        do {
+            size_t count;
+            std::tie(moreAvailable, count) = ep.flushVBucket(vbid);
+            itemsFlushed += count;
+        } while (moreAvailable);
+        return itemsFlushed;
+    }
+
+    /// Evict the value of the document, which must be clean.
+    void evict(size_t i) {
+        const char* msg;
+        ASSERT_EQ(cb::mcbp::Status::Success,
+                  engine->getKVBucket()->evictKey(
+                          makeStoredDocKey(makeKey(i)), vbid, &msg));
+    }
+
+    /**
+     * Load residencyItemCount documents and evict the values of all but the
+     * given percentage of them (spread evenly over the keys).
+     */
+    void loadAtResidency(int residentPercent) {
+        loadItems(residencyItemCount);
+        for (size_t i = 0; i < residencyItemCount; ++i) {
+            if (int(i % 100) >= residentPercent) {
+                evict(i);
+            }
+        }
+    }
+
+    /// Run the BG fetcher of the vBucket, completing all queued fetches.
+    void runBGFetcher() {
+        MockGlobalTask task(engine->getTaskable(), TaskId::MultiBGFetcherTask);
+        engine->getKVBucket()
+                ->getVBucket(vbid)
+                ->getShard()
+                ->getBgFetcher()
+                ->run(&task);
+    }
+
+    /// GET the document, running a BG fetch if the value isn't resident.
+    /// @return true if it needed a BG fetch
+    bool getDocument(const DocKey& key) {
+        auto* store = engine->getKVBucket();
+        auto gv = store->get(key, vbid, cookie, QUEUE_BG_FETCH);
+        if (gv.getStatus() == ENGINE_EWOULDBLOCK) {
+            runBGFetcher();
+            gv = store->get(key, vbid, cookie, QUEUE_BG_FETCH);
+            EXPECT_EQ(ENGINE_SUCCESS, gv.getStatus());
+            return true;
+        }
+        EXPECT_EQ(ENGINE_SUCCESS, gv.getStatus());
+        return false;
+    }
+
+    /// Create the producer, running its checkpoint processor inline.
+    void createProducer() {
+        producer = std::make_shared<MockDcpProducer>(
+                *engine, cookie, "bench_producer", 0, false /*startTask*/);
+        producer->createCheckpointProcessorTask();
+    }
+
+    /// Open a stream of the vBucket's seqnos from startSeqno to endSeqno.
+    void streamRequest(uint64_t startSeqno, uint64_t endSeqno) {
+        auto vb = engine->getKVBucket()->getVBucket(vbid);
+        uint64_t rollbackSeqno;
+        ASSERT_EQ(ENGINE_SUCCESS,
+                  producer->streamRequest(
+                          0,
+                          1 /*opaque*/,
+                          vbid,
+                          startSeqno,
+                          endSeqno,
+                          vb->failovers->getLatestUUID(),
+                          startSeqno,
+                          startSeqno,
+                          &rollbackSeqno,
+                          [](vbucket_failover_t*,
+                             size_t,
+                             gsl::not_null<const void*>) {
+                              return ENGINE_SUCCESS;
+                          },
+                          {}));
+    }
+
+    /**
+     * Step the producer until the given number of mutations have been sent
+     * (or the stream ends), running the backfill and checkpoint processor
+     * whenever the producer has nothing ready.
+     * @return the number of mutations sent
+     */
+    size_t streamMutations(MockDcpMessageProducers& producers, size_t count) {
+        size_t mutations = 0;
+        while (mutations < count) {
+            const auto rv = producer->stepWithBorderGuard(producers);
+            if (rv == ENGINE_SUCCESS) {
+                if (producers.last_op == cb::mcbp::ClientOpcode::DcpMutation) {
+                    ++mutations;
+                } else if (producers.last_op ==
+                           cb::mcbp::ClientOpcode::DcpStreamEnd) {
+                    break;
+                }
+            } else if (rv == ENGINE_EWOULDBLOCK) {
+                if (producer->getBFM().backfill() == backfill_finished) {
+                    producer->getCheckpointSnapshotTask().run();
+                }
+            } else {
+                ADD_FAILURE() << "Unexpected step() result " << rv;
+                break;
+            }
+        }
+        return mutations;
+    }
+
+    std::shared_ptr<MockDcpProducer> producer;
+};
+
+/*
+ * GET latency of random documents, with the given percentage of them
+ * resident (the rest needing a BG fetch).
+ */
+BENCHMARK_DEFINE_F(EnginePerfBench, Get)(benchmark::State& state) {
+    const int residentPercent = state.range(0);
+    loadAtResidency(residentPercent);
+
+    std::mt19937 gen(1); // A fixed seed, so each run GETs the same keys
+    std::uniform_int_distribution<size_t> dist(0, residencyItemCount - 1);
+    size_t bgFetches = 0;
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        const size_t i = dist(gen);
+        const auto key = makeStoredDocKey(makeKey(i));
+        state.ResumeTiming();
+
+        if (getDocument(key)) {
+            ++bgFetches;
+            // Evict again so the residency ratio stays put
+            state.PauseTiming();
+            evict(i);
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["BgFetchRatio"] = double(bgFetches) / state.iterations();
+}
+
+/*
+ * SET latency of random (existing) documents, with the given percentage of
+ * them resident.
+ */
+BENCHMARK_DEFINE_F(EnginePerfBench, Set)(benchmark::State& state) {
+    const int residentPercent = state.range(0);
+    loadAtResidency(residentPercent);
+
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<size_t> dist(0, residencyItemCount - 1);
+    const std::string value(256, 'y');
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        auto item = make_item(vbid, makeKey(dist(gen)), value);
+        state.ResumeTiming();
+        ASSERT_EQ(ENGINE_SUCCESS, engine->getKVBucket()->set(item, cookie));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/*
+ * Run the BG fetcher over the given number of queued fetches of
+ * non-resident documents, as GETs in a fully non-resident bucket queue
+ * them.
+ */
+BENCHMARK_DEFINE_F(EnginePerfBench, BgFetch)(benchmark::State& state) {
+    const size_t batchSize = state.range(0);
+    loadAtResidency(0);
+
+    auto* store = engine->getKVBucket();
+    size_t next = 0;
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        std::vector<size_t> batch;
+        for (size_t ii = 0; ii < batchSize; ++ii) {
+            batch.push_back(next);
+            auto gv = store->get(makeStoredDocKey(makeKey(next)),
+                                 vbid,
+                                 cookie,
+                                 QUEUE_BG_FETCH);
+            ASSERT_EQ(ENGINE_EWOULDBLOCK, gv.getStatus());
+            next = (next + 1) % residencyItemCount;
+        }
+        state.ResumeTiming();
+
+        runBGFetcher();
+
+        state.PauseTiming();
+        for (auto i : batch) {
+            evict(i);
+        }
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * batchSize);
+}
+
+/*
+ * Stream the given number of new mutations per iteration to a DCP client
+ * whose stream is already in-memory (so they come from the checkpoint).
+ */
+BENCHMARK_DEFINE_F(EnginePerfBench, DcpInMemory)(benchmark::State& state) {
+    const size_t itemCount = state.range(0);
+    const std::string value(256, 'x');
+    auto vb = engine->getKVBucket()->getVBucket(vbid);
+
+    createProducer();
+    streamRequest(0, ~0ull);
+    MockDcpMessageProducers producers(engine.get());
+
+    size_t streamed = 0;
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        for (size_t i = 0; i < itemCount; ++i) {
+            auto item = make_item(vbid, makeKey(i), value);
+            ASSERT_EQ(ENGINE_SUCCESS, engine->getKVBucket()->set(item, cookie));
+        }
+        flushAllItems();
+        producer->notifySeqnoAvailable(vbid, vb->getHighSeqno());
+        state.ResumeTiming();
+
+        streamed += streamMutations(producers, itemCount);
+    }
+    ASSERT_EQ(state.iterations() * itemCount, streamed);
+    state.SetItemsProcessed(streamed);
+}
+
+/*
+ * Stream the given number of documents from disk (a backfill) to a DCP
+ * client each iteration.
+ */
+BENCHMARK_DEFINE_F(EnginePerfBench, DcpBackfill)(benchmark::State& state) {
+    const size_t itemCount = state.range(0);
+    loadItems(itemCount);
+
+    // Remove the documents from the checkpoints, so that only the disk has
+    // them
+    auto vb = engine->getKVBucket()->getVBucket(vbid);
+    vb->checkpointManager->createNewCheckpoint();
+    bool newCheckpointCreated;
+    vb->checkpointManager->removeClosedUnrefCheckpoints(*vb,
+                                                        newCheckpointCreated);
+
+    createProducer();
+    MockDcpMessageProducers producers(engine.get());
+    size_t streamed = 0;
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        streamRequest(0, vb->getHighSeqno());
+        state.ResumeTiming();
+
+        streamed += streamMutations(producers, itemCount);
+
+        // Step on to the stream end, so the next request may replace it
+        state.PauseTiming();
+        streamMutations(producers, 1);
+        state.ResumeTiming();
+    }
+    ASSERT_EQ(state.iterations() * itemCount, streamed);
+    state.SetItemsProcessed(streamed);
+}
+
+BENCHMARK_REGISTER_F(EnginePerfBench, Get)->Arg(100)->Arg(50)->Arg(0);
+BENCHMARK_REGISTER_F(EnginePerfBench, Set)->Arg(100)->Arg(50)->Arg(0);
+BENCHMARK_REGISTER_F(EnginePerfBench, BgFetch)->Arg(1)->Arg(16)->Arg(128);
+BENCHMARK_REGISTER_F(EnginePerfBench, DcpInMemory)->Arg(1000);
+BENCHMARK_REGISTER_F(EnginePerfBench, DcpBackfill)->Arg(10000);
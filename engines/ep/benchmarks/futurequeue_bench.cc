@@ -0,0 +1,131 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks relating to the FutureQueue class.
+ */
+
+#include "futurequeue.h"
+#include "taskable.h"
+#include "workload.h"
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+namespace {
+class BenchTaskable : public Taskable {
+public:
+    const std::string& getName() const override {
+        return name;
+    }
+    task_gid_t getGID() const override {
+        return 0;
+    }
+    bucket_priority_t getWorkloadPriority() const override {
+        return HIGH_BUCKET_PRIORITY;
+    }
+    void setWorkloadPriority(bucket_priority_t prio) override {
+    }
+    WorkLoadPolicy& getWorkLoadPolicy() override {
+        return policy;
+    }
+    void logQTime(TaskId id,
+                  const std::chrono::steady_clock::duration enqTime) override {
+    }
+    void logRunTime(TaskId id,
+                    const std::chrono::steady_clock::duration runTime) override {
+    }
+
+private:
+    const std::string name{"bench"};
+    WorkLoadPolicy policy{HIGH_BUCKET_PRIORITY, 1};
+};
+
+class BenchTask : public GlobalTask {
+public:
+    explicit BenchTask(Taskable& t)
+        : GlobalTask(t, TaskId::PendingOpsNotification, 0.0, false) {
+    }
+    bool run() override {
+        return false;
+    }
+    std::string getDescription() override {
+        return "BenchTask";
+    }
+    std::chrono::microseconds maxExpectedDuration() override {
+        return std::chrono::seconds(0);
+    }
+};
+
+std::vector<ExTask> fillQueue(FutureQueue<>& queue,
+                              Taskable& taskable,
+                              size_t numTasks) {
+    std::vector<ExTask> tasks;
+    for (size_t ii = 0; ii < numTasks; ++ii) {
+        ExTask task = std::make_shared<BenchTask>(taskable);
+        task->updateWaketime(std::chrono::steady_clock::time_point(
+                std::chrono::milliseconds(ii)));
+        queue.push(task);
+        tasks.push_back(task);
+    }
+    return tasks;
+}
+} // namespace
+
+/**
+ * Wake (move to the front) and then snooze (move back) tasks in a queue of
+ * state.range(0) tasks - what ExecutorPool::wake / snooze do to the
+ * futureQueue of a TaskQueue.
+ */
+static void BM_FutureQueueWakeAndSnooze(benchmark::State& state) {
+    BenchTaskable taskable;
+    FutureQueue<> queue;
+    const auto tasks = fillQueue(queue, taskable, state.range(0));
+
+    size_t next = 0;
+    while (state.KeepRunning()) {
+        const auto& task = tasks[next];
+        queue.updateWaketime(task, std::chrono::steady_clock::time_point());
+        queue.updateWaketime(task,
+                             std::chrono::steady_clock::time_point(
+                                     std::chrono::milliseconds(next)));
+        next = (next + 1) % tasks.size();
+    }
+}
+
+/**
+ * Pop the earliest task and push it back with a later wakeTime, as a
+ * thread running and rescheduling a periodic task does.
+ */
+static void BM_FutureQueuePopAndPush(benchmark::State& state) {
+    BenchTaskable taskable;
+    FutureQueue<> queue;
+    fillQueue(queue, taskable, state.range(0));
+
+    auto wake = std::chrono::milliseconds(state.range(0));
+    while (state.KeepRunning()) {
+        ExTask task = queue.top();
+        queue.pop();
+        task->updateWaketime(std::chrono::steady_clock::time_point(wake));
+        queue.push(task);
+        wake += std::chrono::milliseconds(1);
+    }
+}
+
+BENCHMARK(BM_FutureQueueWakeAndSnooze)->RangeMultiplier(4)->Range(16, 16384);
+BENCHMARK(BM_FutureQueuePopAndPush)->RangeMultiplier(4)->Range(16, 16384);
@@ -30,11 +30,18 @@
 // Benchmarks inserting items into a HashTable
 class HashTableBench : public benchmark::Fixture {
 public:
-    HashTableBench()
+    HashTableBench(
+            HashTable::Layout layout = HashTable::Layout::Chained,
+            HashTable::HashAlgorithm hashAlgorithm = HashTable::HashAlgorithm::Djb,
+            bool sharedReaderLocks = false)
         : ht(stats,
              std::make_unique<StoredValueFactory>(stats),
              Configuration().getHtSize(),
-             Configuration().getHtLocks()) {
+             Configuration().getHtLocks(),
+             layout,
+             hashAlgorithm,
+             0,
+             sharedReaderLocks) {
     }
 
     void SetUp(benchmark::State& state) {
@@ -111,6 +118,61 @@ public:
         }
     }
 
+    /**
+     * Benchmark finding items in the HashTable via the given find function.
+     * Includes extra 50% of Items are prepared SyncWrites - an unrealistically
+     * high percentage in a real-world, but want to measure any performance
+     * impact in having such items present in the HashTable.
+     */
+    template <typename FindFn>
+    void benchFind(benchmark::State& state, FindFn find) {
+        // Populate the HashTable with numItems.
+        if (state.thread_index == 0) {
+            sharedItems = createItems(
+                    "Thread" + std::to_string(state.thread_index) + "::", 50);
+            for (auto& item : sharedItems) {
+                ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
+            }
+        }
+
+        // Benchmark - find them.
+        while (state.KeepRunning()) {
+            auto& key = sharedItems[state.iterations() % numItems].getKey();
+            benchmark::DoNotOptimize(find(key));
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    // Benchmark inserting an item into the HashTable.
+    void benchInsert(benchmark::State& state) {
+        // To ensure we insert and not replace items, create a per-thread items
+        // vector so each thread inserts a different set of items.
+        auto items = createItems("Thread" +
+                                 std::to_string(state.thread_index) + "::");
+
+        while (state.KeepRunning()) {
+            const auto index = state.iterations() % numItems;
+            ASSERT_EQ(MutationStatus::WasClean, ht.set(items[index]));
+
+            // Once a thread gets to the end of it's items; pause timing and
+            // let the *last* thread clear them all - this is to avoid
+            // measuring any of the ht.clear() cost indirectly when other
+            // threads are trying to insert.
+            // Note: state.iterations() starts at 0; hence checking for
+            // state.iterations() % numItems (aka 'index') is zero to represent
+            // we wrapped.
+            if (index == 0) {
+                state.PauseTiming();
+                waitForAllThreadsThenExecuteOnce(state,
+                                                 [this]() { ht.clear(); });
+                state.ResumeTiming();
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations());
+    }
+
     EPStats stats;
     HashTable ht;
     static const size_t numItems = 100000;
@@ -124,77 +186,162 @@ public:
     int waiters = 0;
 };
 
+/// HashTableBench variant using Layout::Bucketed, to compare against the
+/// default (Chained) layout.
+class BucketedHashTableBench : public HashTableBench {
+public:
+    BucketedHashTableBench() : HashTableBench(HashTable::Layout::Bucketed) {
+    }
+};
+
+/// HashTableBench variant using HashAlgorithm::Crc32c.
+class Crc32cHashTableBench : public HashTableBench {
+public:
+    Crc32cHashTableBench()
+        : HashTableBench(HashTable::Layout::Chained,
+                         HashTable::HashAlgorithm::Crc32c) {
+    }
+};
+
+/// HashTableBench variant with shared reader locks.
+class SharedReaderHashTableBench : public HashTableBench {
+public:
+    SharedReaderHashTableBench()
+        : HashTableBench(HashTable::Layout::Chained,
+                         HashTable::HashAlgorithm::Djb,
+                         true) {
+    }
+};
+
 // Benchmark finding items in the HashTable.
-// Includes extra  50% of Items are prepared SyncWrites -  an unrealistically
-// high percentage in a real-world, but want to measure any performance impact
-// in having such items present in the HashTable.
 BENCHMARK_DEFINE_F(HashTableBench, FindForRead)(benchmark::State& state) {
-    // Populate the HashTable with numItems.
+    benchFind(state, [this](const DocKey& key) { return ht.findForRead(key); });
+}
+
+// Benchmark finding items (for write) in the HashTable.
+BENCHMARK_DEFINE_F(HashTableBench, FindForWrite)(benchmark::State& state) {
+    benchFind(state,
+              [this](const DocKey& key) { return ht.findForWrite(key); });
+}
+
+BENCHMARK_DEFINE_F(HashTableBench, Insert)(benchmark::State& state) {
+    benchInsert(state);
+}
+
+BENCHMARK_DEFINE_F(BucketedHashTableBench, FindForRead)
+(benchmark::State& state) {
+    benchFind(state, [this](const DocKey& key) { return ht.findForRead(key); });
+}
+
+BENCHMARK_DEFINE_F(BucketedHashTableBench, FindForWrite)
+(benchmark::State& state) {
+    benchFind(state,
+              [this](const DocKey& key) { return ht.findForWrite(key); });
+}
+
+BENCHMARK_DEFINE_F(BucketedHashTableBench, Insert)(benchmark::State& state) {
+    benchInsert(state);
+}
+
+BENCHMARK_DEFINE_F(Crc32cHashTableBench, FindForRead)
+(benchmark::State& state) {
+    benchFind(state, [this](const DocKey& key) { return ht.findForRead(key); });
+}
+
+// Benchmark GETs of a few hot keys from every thread - finding them for
+// read (tracking the reference) and taking a copy of each as an Item, as
+// VBucket::getInternal does, while holding the hash bucket lock.
+// Arguments: number of hot keys.
+BENCHMARK_DEFINE_F(HashTableBench, FindForReadHotKeys)
+(benchmark::State& state) {
     if (state.thread_index == 0) {
-        sharedItems = createItems(
-                "Thread" + std::to_string(state.thread_index) + "::", 50);
+        sharedItems = createItems("HotKey::");
         for (auto& item : sharedItems) {
             ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
         }
     }
 
-    // Benchmark - find them.
+    const size_t hotKeys = state.range(0);
     while (state.KeepRunning()) {
-        auto& key = sharedItems[state.iterations() % numItems].getKey();
-        benchmark::DoNotOptimize(ht.findForRead(key));
+        auto& key = sharedItems[state.iterations() % hotKeys].getKey();
+        auto result = ht.findForRead(key, TrackReference::Yes);
+        benchmark::DoNotOptimize(result.storedValue->toItem(Vbid(0)));
     }
 
     state.SetItemsProcessed(state.iterations());
 }
 
-// Benchmark finding items (for write) in the HashTable.
-// Includes extra  50% of Items are prepared SyncWrites -  an unrealistically
-// high percentage in a real-world, but want to measure any performance impact
-// in having such items present in the HashTable.
-BENCHMARK_DEFINE_F(HashTableBench, FindForWrite)(benchmark::State& state) {
-    // Populate the HashTable with numItems.
+// As FindForReadHotKeys, but finding the keys with findForReadShared as
+// VBucket::getInternal does; with the exclusive stripe locks of
+// HashTableBench this is the same as findForRead, so the fixtures compare
+// exclusive and shared reader locks.
+// Arguments: number of hot keys.
+static void findForReadSharedHotKeys(benchmark::State& state,
+                                     HashTable& ht,
+                                     std::vector<Item>& items) {
+    const size_t hotKeys = state.range(0);
+    while (state.KeepRunning()) {
+        auto& key = items[state.iterations() % hotKeys].getKey();
+        auto result = ht.findForReadShared(key, TrackReference::Yes);
+        benchmark::DoNotOptimize(result.storedValue->toItem(Vbid(0)));
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_DEFINE_F(HashTableBench, FindForReadSharedHotKeys)
+(benchmark::State& state) {
     if (state.thread_index == 0) {
-        sharedItems = createItems(
-                "Thread" + std::to_string(state.thread_index) + "::", 50);
+        sharedItems = createItems("HotKey::");
         for (auto& item : sharedItems) {
             ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
         }
     }
+    findForReadSharedHotKeys(state, ht, sharedItems);
+}
 
-    // Benchmark - find them.
-    while (state.KeepRunning()) {
-        auto& key = sharedItems[state.iterations() % numItems].getKey();
-        benchmark::DoNotOptimize(ht.findForWrite(key));
+BENCHMARK_DEFINE_F(SharedReaderHashTableBench, FindForReadSharedHotKeys)
+(benchmark::State& state) {
+    if (state.thread_index == 0) {
+        sharedItems = createItems("HotKey::");
+        for (auto& item : sharedItems) {
+            ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
+        }
     }
-
-    state.SetItemsProcessed(state.iterations());
+    findForReadSharedHotKeys(state, ht, sharedItems);
 }
 
-// Benchmark inserting an item into the HashTable.
-BENCHMARK_DEFINE_F(HashTableBench, Insert)(benchmark::State& state) {
-    // To ensure we insert and not replace items, create a per-thread items
-    // vector so each thread inserts a different set of items.
-    auto items =
-            createItems("Thread" + std::to_string(state.thread_index) + "::");
+/**
+ * Make a collection-prefixed key of the given length, representative of the
+ * keys seen in collection-heavy buckets.
+ */
+static StoredDocKey makeBenchKey(size_t length, char fill = 'k') {
+    return StoredDocKey(std::string(length, fill), CollectionID(8));
+}
 
+// Benchmark the cost of hashing a key with each HashAlgorithm.
+// Arguments: key length, HashAlgorithm.
+static void HashKey(benchmark::State& state) {
+    const auto key = makeBenchKey(state.range(0));
+    const auto algorithm = HashTable::HashAlgorithm(state.range(1));
     while (state.KeepRunning()) {
-        const auto index = state.iterations() % numItems;
-        ASSERT_EQ(MutationStatus::WasClean, ht.set(items[index]));
-
-        // Once a thread gets to the end of it's items; pause timing and let
-        // the *last* thread clear them all - this is to avoid measuring any
-        // of the ht.clear() cost indirectly when other threads are trying to
-        // insert.
-        // Note: state.iterations() starts at 0; hence checking for
-        // state.iterations() % numItems (aka 'index') is zero to represent we
-        // wrapped.
-        if (index == 0) {
-            state.PauseTiming();
-            waitForAllThreadsThenExecuteOnce(state, [this]() { ht.clear(); });
-            state.ResumeTiming();
-        }
+        benchmark::DoNotOptimize(HashTable::hashKey(DocKey(key), algorithm));
     }
+    state.SetItemsProcessed(state.iterations());
+}
 
+// Benchmark comparing a StoredValue's key against an equal (but distinct)
+// key - the worst case when walking a hash chain.
+// Arguments: key length.
+static void StoredValueHasKey(benchmark::State& state) {
+    EPStats stats;
+    StoredValueFactory factory(stats);
+    const auto key = makeBenchKey(state.range(0));
+    const auto other = makeBenchKey(state.range(0));
+    auto sv = factory(make_item(Vbid(0), key, "x"), {});
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(sv->hasKey(other));
+    }
     state.SetItemsProcessed(state.iterations());
 }
 
@@ -267,3 +414,44 @@ BENCHMARK_REGISTER_F(HashTableBench, Replace)
 BENCHMARK_REGISTER_F(HashTableBench, Delete)
         ->ThreadPerCpu()
         ->Iterations(HashTableBench::numItems);
+BENCHMARK_REGISTER_F(HashTableBench, FindForReadHotKeys)
+        ->ThreadPerCpu()
+        ->Arg(1)
+        ->Arg(16)
+        ->Iterations(HashTableBench::numItems);
+// Hot-key reads scale with the number of readers only if they don't
+// serialise on the stripe lock, so measure well beyond the core count too.
+BENCHMARK_REGISTER_F(HashTableBench, FindForReadSharedHotKeys)
+        ->Threads(1)
+        ->Threads(8)
+        ->Threads(32)
+        ->Threads(64)
+        ->Arg(1)
+        ->Arg(16)
+        ->Iterations(HashTableBench::numItems);
+BENCHMARK_REGISTER_F(SharedReaderHashTableBench, FindForReadSharedHotKeys)
+        ->Threads(1)
+        ->Threads(8)
+        ->Threads(32)
+        ->Threads(64)
+        ->Arg(1)
+        ->Arg(16)
+        ->Iterations(HashTableBench::numItems);
+BENCHMARK_REGISTER_F(BucketedHashTableBench, FindForRead)
+        ->ThreadPerCpu()
+        ->Iterations(HashTableBench::numItems);
+BENCHMARK_REGISTER_F(BucketedHashTableBench, FindForWrite)
+        ->ThreadPerCpu()
+        ->Iterations(HashTableBench::numItems);
+BENCHMARK_REGISTER_F(BucketedHashTableBench, Insert)
+        ->ThreadPerCpu()
+        ->Iterations(HashTableBench::numItems);
+BENCHMARK_REGISTER_F(Crc32cHashTableBench, FindForRead)
+        ->ThreadPerCpu()
+        ->Iterations(HashTableBench::numItems);
+BENCHMARK(HashKey)
+        ->Args({40, int(HashTable::HashAlgorithm::Djb)})
+        ->Args({40, int(HashTable::HashAlgorithm::Crc32c)})
+        ->Args({120, int(HashTable::HashAlgorithm::Djb)})
+        ->Args({120, int(HashTable::HashAlgorithm::Crc32c)});
+BENCHMARK(StoredValueHasKey)->Arg(40)->Arg(120);
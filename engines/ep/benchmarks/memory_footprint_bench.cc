@@ -0,0 +1,268 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks of the memory used per item by a vBucket, for a range of item
+ * layouts and bucket types, broken down by where the bytes go.
+ */
+
+#include "benchmark_memory_tracker.h"
+#include "checkpoint_manager.h"
+#include "engine_fixture.h"
+#include "ep_bucket.h"
+#include "item.h"
+
+#include "../tests/module_tests/test_helpers.h"
+
+#include <folly/portability/GTest.h>
+#include <programs/engine_testapp/mock_server.h>
+
+#include <random>
+
+enum class BucketConfig { ValueEviction = 0, FullEviction = 1, Ephemeral = 2 };
+
+static std::string to_string(BucketConfig config) {
+    switch (config) {
+    case BucketConfig::ValueEviction:
+        return "value_eviction";
+    case BucketConfig::FullEviction:
+        return "full_eviction";
+    case BucketConfig::Ephemeral:
+        return "ephemeral";
+    }
+    throw std::invalid_argument(
+            "to_string(BucketConfig): invalid enumeration " +
+            std::to_string(int(config)));
+}
+
+/// The optional HashTable layout changes, as a bit mask
+enum HashTableOption { InlineValues = 1, KeyPrefixCompression = 2 };
+static const int allHashTableOptions = InlineValues | KeyPrefixCompression;
+
+static std::string hashTableOptionsToString(int options) {
+    switch (options) {
+    case 0:
+        return "default";
+    case InlineValues:
+        return "inline_values";
+    case KeyPrefixCompression:
+        return "key_prefix_compression";
+    case InlineValues | KeyPrefixCompression:
+        return "inline_values+key_prefix_compression";
+    }
+    throw std::invalid_argument(
+            "hashTableOptionsToString: invalid options " +
+            std::to_string(options));
+}
+
+/**
+ * The distributions of the documents' keys and values. Key and value
+ * lengths are drawn uniformly from [min, 2 * min); the key length includes
+ * the prefix shared by all of the keys.
+ */
+struct ItemLayout {
+    std::string name;
+    size_t minKeyLen;
+    size_t minValueLen;
+    /// The fraction of documents with (system and user) xattrs
+    double xattrRatio;
+    std::string keyPrefix;
+};
+
+// tiny values fit inline (ht_inline_values), and the prefixed keys share a
+// dictionary entry (ht_key_prefix_compression).
+static const std::vector<ItemLayout> itemLayouts = {
+        {"tiny", 16, 4, 0.0, ""},
+        {"tiny_prefixed", 24, 4, 0.0, "user::"},
+        {"small", 16, 64, 0.0, ""},
+        {"small_prefixed", 24, 64, 0.0, "user::"},
+        {"medium", 32, 512, 0.0, ""},
+        {"medium_xattr", 32, 512, 0.5, ""},
+        {"large", 48, 4096, 0.0, ""}};
+
+class MemoryFootprintBench : public EngineFixture {
+protected:
+    void SetUp(const benchmark::State& state) override {
+        config = BucketConfig(state.range(0));
+        switch (config) {
+        case BucketConfig::ValueEviction:
+            varConfig = "item_eviction_policy=value_only";
+            break;
+        case BucketConfig::FullEviction:
+            varConfig = "item_eviction_policy=full_eviction";
+            break;
+        case BucketConfig::Ephemeral:
+            varConfig = "bucket_type=ephemeral";
+            break;
+        }
+        varConfig += ";max_size=4000000000";
+        const int options = state.range(3);
+        if (options & InlineValues) {
+            varConfig += ";ht_inline_values=true";
+        }
+        if (options & KeyPrefixCompression) {
+            varConfig += ";ht_key_prefix_compression=true";
+        }
+
+        memoryTracker = BenchmarkMemoryTracker::getInstance(
+                *get_mock_server_api()->alloc_hooks);
+        memoryTracker->reset();
+        EngineFixture::SetUp(state);
+        engine->getKVBucket()->setVBucketState(vbid, vbucket_state_active);
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        memoryTracker->destroyInstance();
+        EngineFixture::TearDown(state);
+    }
+
+    /// Flush the vBucket and drop its (closed) checkpoints.
+    void persistAndRemoveCheckpoints(VBucket& vb) {
+        if (config != BucketConfig::Ephemeral) {
+            auto& ep = dynamic_cast<EPBucket&>(*engine->getKVBucket());
+            bool moreAvailable;
+            do {
+                std::tie(moreAvailable, std::ignore) = ep.flushVBucket(vbid);
+            } while (moreAvailable);
+        }
+        vb.checkpointManager->createNewCheckpoint();
+        bool newCheckpointCreated;
+        vb.checkpointManager->removeClosedUnrefCheckpoints(
+                vb, newCheckpointCreated);
+    }
+
+    BucketConfig config;
+    BenchmarkMemoryTracker* memoryTracker;
+};
+
+/*
+ * Load the given number of documents of the given layout into a vBucket,
+ * with the given HashTable options (ht_inline_values,
+ * ht_key_prefix_compression), and report the bytes per document:
+ * - Total: all of the memory allocated by loading them.
+ * - StoredValue / Key: the HashTable's metadata (StoredValue objects with
+ *   their serialised key); Key is the mean key length within that.
+ * - Blob: the values (including xattrs).
+ * - Checkpoint: the checkpoints' memory, before they are flushed and
+ *   removed.
+ * - HashTable: the HashTable's array of slots.
+ * - Steady: all of the memory once the checkpoints are removed.
+ * - Evicted: all of the memory once every document has been evicted
+ *   (persistent buckets only); full eviction frees the metadata too.
+ */
+BENCHMARK_DEFINE_F(MemoryFootprintBench, LoadItems)
+(benchmark::State& state) {
+    const auto& layout = itemLayouts.at(state.range(1));
+    const size_t itemCount = state.range(2);
+
+    std::mt19937 gen(1); // A fixed seed, so each run loads the same items
+    std::uniform_int_distribution<size_t> keyLen(layout.minKeyLen,
+                                                 2 * layout.minKeyLen - 1);
+    std::uniform_int_distribution<size_t> valueLen(layout.minValueLen,
+                                                   2 * layout.minValueLen - 1);
+    std::bernoulli_distribution hasXattrs(layout.xattrRatio);
+
+    // Generate the documents up front, outside of the tracked memory
+    struct Document {
+        std::string key;
+        std::string value;
+        protocol_binary_datatype_t datatype;
+    };
+    std::vector<Document> documents;
+    size_t keyBytes = 0;
+    for (size_t i = 0; i < itemCount; ++i) {
+        auto key = std::to_string(i);
+        const size_t len =
+                std::max(keyLen(gen), layout.keyPrefix.size() + key.size());
+        key.insert(0, len - layout.keyPrefix.size() - key.size(), 'k');
+        key.insert(0, layout.keyPrefix);
+        std::string body =
+                R"({"v":")" + std::string(valueLen(gen), 'x') + R"("})";
+        protocol_binary_datatype_t datatype = PROTOCOL_BINARY_DATATYPE_JSON;
+        if (hasXattrs(gen)) {
+            body = createXattrValue(body);
+            datatype |= PROTOCOL_BINARY_DATATYPE_XATTR;
+        }
+        keyBytes += key.size();
+        documents.push_back({std::move(key), std::move(body), datatype});
+    }
+
+    auto* store = engine->getKVBucket();
+    auto vb = store->getVBucket(vbid);
+    while (state.KeepRunning()) {
+        const size_t baseBytes = memoryTracker->getCurrentAlloc();
+        for (const auto& doc : documents) {
+            Item item({doc.key, DocKeyEncodesCollectionId::No},
+                      0,
+                      0,
+                      doc.value.data(),
+                      doc.value.size(),
+                      doc.datatype);
+            item.setVBucketId(vbid);
+            ASSERT_EQ(ENGINE_SUCCESS, store->set(item, cookie));
+        }
+        // Size the HashTable as the resizer task would
+        vb->ht.resize();
+
+        const double n = itemCount;
+        const size_t loadedBytes =
+                memoryTracker->getCurrentAlloc() - baseBytes;
+        const size_t metadata = vb->ht.getMetadataMemory();
+        state.counters["Total"] = loadedBytes / n;
+        // With key prefix compression the keys take less than keyBytes
+        state.counters["StoredValue"] = (double(metadata) - keyBytes) / n;
+        state.counters["Key"] = keyBytes / n;
+        state.counters["Blob"] = (vb->ht.getItemMemory() - metadata) / n;
+        state.counters["Checkpoint"] =
+                vb->checkpointManager->getMemoryUsage() / n;
+        state.counters["HashTable"] =
+                vb->ht.getNumBuckets() * sizeof(void*) / n;
+
+        persistAndRemoveCheckpoints(*vb);
+        state.counters["Steady"] =
+                (memoryTracker->getCurrentAlloc() - baseBytes) / n;
+
+        if (config != BucketConfig::Ephemeral) {
+            for (const auto& doc : documents) {
+                const char* msg;
+                store->evictKey({doc.key, DocKeyEncodesCollectionId::No},
+                                vbid,
+                                &msg);
+            }
+            state.counters["Evicted"] =
+                    (memoryTracker->getCurrentAlloc() - baseBytes) / n;
+        }
+    }
+    state.SetLabel((to_string(config) + "/" + layout.name + "/" +
+                    hashTableOptionsToString(state.range(3)))
+                           .c_str());
+}
+
+static void FootprintArguments(benchmark::internal::Benchmark* b) {
+    for (int config = 0; config <= int(BucketConfig::Ephemeral); ++config) {
+        for (size_t layout = 0; layout < itemLayouts.size(); ++layout) {
+            for (int options = 0; options <= allHashTableOptions; ++options) {
+                b->Args({config, int(layout), 100000, options});
+            }
+        }
+    }
+}
+
+// Each run loads the items once; the counters are the measurements.
+BENCHMARK_REGISTER_F(MemoryFootprintBench, LoadItems)
+        ->Apply(FootprintArguments)
+        ->Iterations(1);
@@ -199,6 +199,88 @@ BENCHMARK_DEFINE_F(MemTrackingVBucketBench, QueueDirty)
     state.counters["PeakBytesPerItem"] = (peakBytes - baseBytes) / itemCount;
 }
 
+/**
+ * Benchmark the write throughput of a single vBucket as the number of threads
+ * mutating it grows. Every mutation is assigned its seqno (and CAS) and queued
+ * into the open checkpoint under the CheckpointManager's queueLock, so this
+ * shows how far that critical section limits a hot vBucket.
+ * Each thread sets its own range of keys, repeatedly, so the open checkpoint
+ * de-duplicates them rather than growing.
+ */
+BENCHMARK_DEFINE_F(VBucketBench, QueueDirtyConcurrent)
+(benchmark::State& state) {
+    // Thread 0 activates the vBucket after the engine is visible to the other
+    // threads
+    while (!engine->getKVBucket()->getVBucket(vbid)) {
+        std::this_thread::yield();
+    }
+
+    const auto keyCount = state.range(1);
+    const std::string value(1, 'x');
+    std::vector<Item> items;
+    items.reserve(keyCount);
+    for (int i = 0; i < keyCount; ++i) {
+        items.push_back(make_item(vbid,
+                                  "key" + std::to_string(state.thread_index) +
+                                          "_" + std::to_string(i),
+                                  value));
+    }
+
+    size_t next = 0;
+    while (state.KeepRunning()) {
+        auto item = items[next];
+        ASSERT_EQ(ENGINE_SUCCESS, engine->getKVBucket()->set(item, cookie));
+        if (++next == items.size()) {
+            next = 0;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * Benchmark a SET as the front end performs one: allocate the Item, store it,
+ * then release it. Reports the heap allocations made per SET, which include
+ * any the checkpoint makes to queue the mutation.
+ * Sets a range of keys repeatedly, so the open checkpoint de-duplicates them
+ * rather than growing.
+ */
+BENCHMARK_DEFINE_F(MemTrackingVBucketBench, FrontEndSet)
+(benchmark::State& state) {
+    const auto keyCount = state.range(1);
+    const std::string value(100, 'x');
+    std::vector<std::string> keys;
+    for (int i = 0; i < keyCount; ++i) {
+        keys.push_back("key" + std::to_string(i));
+    }
+
+    const size_t baseAllocs = memoryTracker->getAllocCount();
+    size_t next = 0;
+    while (state.KeepRunning()) {
+        item* itm = nullptr;
+        ASSERT_EQ(ENGINE_SUCCESS,
+                  engine->itemAllocate(
+                          &itm,
+                          DocKey(keys[next], DocKeyEncodesCollectionId::No),
+                          value.size(),
+                          0,
+                          0,
+                          0,
+                          0,
+                          vbid));
+        auto* it = reinterpret_cast<Item*>(itm);
+        std::copy(value.begin(), value.end(), const_cast<char*>(it->getData()));
+        ASSERT_EQ(ENGINE_SUCCESS, engine->getKVBucket()->set(*it, cookie));
+        engine->itemRelease(itm);
+        if (++next == keys.size()) {
+            next = 0;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["AllocsPerSet"] =
+            double(memoryTracker->getAllocCount() - baseAllocs) /
+            state.iterations();
+}
+
 BENCHMARK_DEFINE_F(MemTrackingVBucketBench, FlushVBucket)
 (benchmark::State& state) {
     const auto itemCount = state.range(1);
@@ -393,6 +475,11 @@ BENCHMARK_REGISTER_F(MemTrackingVBucketBench, QueueDirty)
         ->Args({10000})
         ->Args({1000000});
 
+BENCHMARK_REGISTER_F(VBucketBench, QueueDirtyConcurrent)
+        ->Args({0, 1000})
+        ->ThreadRange(1, 16)
+        ->UseRealTime();
+
 static void FlushArguments(benchmark::internal::Benchmark* b) {
     // Add both couchstore (0) and rocksdb (1) variants for a range of sizes.
     for (size_t items = 1; items <= 1000000; items *= 100) {
@@ -401,6 +488,8 @@ static void FlushArguments(benchmark::internal::Benchmark* b) {
     }
 }
 
+BENCHMARK_REGISTER_F(MemTrackingVBucketBench, FrontEndSet)->Args({0, 1000});
+
 BENCHMARK_REGISTER_F(MemTrackingVBucketBench, FlushVBucket)
         ->Apply(FlushArguments);
 
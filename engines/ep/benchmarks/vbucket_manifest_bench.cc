@@ -0,0 +1,115 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks of the per-operation collection lookup of a vBucket's
+ * Collections::VB::Manifest: locking a key's collection and updating its
+ * stats, as a front end write and its flush do, with many collections.
+ */
+
+#include "collections/kvstore.h"
+#include "collections/vbucket_manifest.h"
+#include "module_tests/test_helpers.h"
+
+#include <benchmark/benchmark.h>
+
+#include <unordered_map>
+
+static std::vector<StoredDocKey> makeKeys(size_t collections) {
+    std::vector<StoredDocKey> keys;
+    keys.push_back(makeStoredDocKey("key", CollectionID::Default));
+    for (size_t ii = 1; ii < collections; ++ii) {
+        // Collection IDs are allocated from 8
+        keys.push_back(makeStoredDocKey("key", uint32_t(7 + ii)));
+    }
+    return keys;
+}
+
+class VBManifestBench : public benchmark::Fixture {
+public:
+    void SetUp(benchmark::State& state) override {
+        if (state.thread_index == 0) {
+            keys = makeKeys(state.range(0));
+            Collections::KVStore::Manifest data{
+                    Collections::KVStore::Manifest::Empty{}};
+            data.scopes.push_back(ScopeID::Default);
+            int64_t startSeqno = 0;
+            for (const auto& key : keys) {
+                Collections::CollectionMetaData meta;
+                meta.cid = key.getCollectionID();
+                data.collections.push_back({startSeqno++, meta});
+            }
+            manifest = std::make_unique<Collections::VB::Manifest>(data);
+        }
+    }
+
+    void TearDown(benchmark::State& state) override {
+        if (state.thread_index == 0) {
+            manifest.reset();
+            keys.clear();
+        }
+    }
+
+    std::vector<StoredDocKey> keys;
+    std::unique_ptr<Collections::VB::Manifest> manifest;
+};
+
+// A front end write's collection lookup, and its flush's stats update, with
+// the writes spread over all of the collections.
+BENCHMARK_DEFINE_F(VBManifestBench, LockAndUpdateStats)
+(benchmark::State& state) {
+    size_t ii = state.thread_index;
+    uint64_t seqno = 1;
+    while (state.KeepRunning()) {
+        const auto& key = keys[ii++ % keys.size()];
+        auto handle = manifest->lock(key);
+        benchmark::DoNotOptimize(handle.valid());
+        handle.incrementDiskCount();
+        handle.setHighSeqno(seqno++);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// The same lookups in an unordered_map keyed by CollectionID (the manifest's
+// previous container), for comparison.
+static void BM_UnorderedMapLookup(benchmark::State& state) {
+    const auto keys = makeKeys(state.range(0));
+    std::unordered_map<CollectionID, Collections::VB::ManifestEntry> map;
+    int64_t startSeqno = 0;
+    for (const auto& key : keys) {
+        map.emplace(key.getCollectionID(),
+                    Collections::VB::ManifestEntry{
+                            ScopeID::Default, {}, startSeqno++});
+    }
+
+    size_t ii = 0;
+    uint64_t seqno = 1;
+    while (state.KeepRunning()) {
+        const auto& key = keys[ii++ % keys.size()];
+        auto itr = map.find(key.getCollectionID());
+        benchmark::DoNotOptimize(itr);
+        itr->second.incrementDiskCount();
+        itr->second.setHighSeqno(seqno++);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(VBManifestBench, LockAndUpdateStats)
+        ->RangeMultiplier(10)
+        ->Range(1, 1000)
+        ->ThreadRange(1, 8);
+BENCHMARK(BM_UnorderedMapLookup)->RangeMultiplier(10)->Range(1, 1000);
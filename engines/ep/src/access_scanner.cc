@@ -24,10 +24,12 @@
 #include "stats.h"
 #include "vb_count_visitor.h"
 
+#include <boost/optional/optional.hpp>
 #include <phosphor/phosphor.h>
 #include <platform/dirutils.h>
 #include <platform/platform_time.h>
 
+#include <algorithm>
 #include <iostream>
 #include <memory>
 #include <numeric>
@@ -50,7 +52,9 @@ public:
           stateFinalizer(sfin),
           as(aS),
           items_scanned(0),
-          items_to_scan(items_to_scan) {
+          items_to_scan(items_to_scan),
+          maxItemsPerSec(conf.getAlogMaxItemsPerSec()),
+          residencyChangeThreshold(conf.getAlogResidencyChangeThreshold()) {
         setVBucketFilter(VBucketFilter(
                 _store.getVBuckets().getShard(sh)->getVBuckets()));
         name = conf.getAlogPath();
@@ -70,6 +74,14 @@ public:
                     "Attempting to generate new access file "
                     "'{}'",
                     next);
+            // The new log only replaces the current one once it's complete
+            // (and close() syncs it), so rather than flushing and syncing
+            // each chunk gather the blocks into large writes.
+            log->setSyncConfig(0);
+            log->setWriteBufferSize(conf.getAlogWriteBufferSize());
+            if (residencyChangeThreshold > 0) {
+                openCurrent();
+            }
         }
     }
 
@@ -89,6 +101,10 @@ public:
 
     void update(Vbid vbid) {
         if (log != nullptr) {
+            // Write each chunk of keys sorted, so consecutive keys share
+            // long prefixes (which the log compresses) and each chunk is a
+            // sorted run which readers can search / merge.
+            std::sort(accessed.begin(), accessed.end());
             for (auto it = accessed.begin(); it != accessed.end(); ++it) {
                 log->newItem(vbid, *it);
             }
@@ -102,16 +118,53 @@ public:
         if (log == nullptr) {
             return;
         }
+        if (!vBucketFilter(vb->getId())) {
+            return;
+        }
+        if (copyFromCurrent(*vb)) {
+            ++stats.alogNumVbsReused;
+            return;
+        }
+
+        auto& last = as.residency[vb->getId().get()];
+        last.numItems = vb->getNumItems();
+        last.numNonResident = vb->getNumNonResidentItems();
+        last.scanned = true;
+
+        const size_t logged = log->itemsLogged[int(MutationLogType::New)];
         HashTable::Position ht_start;
-        if (vBucketFilter(vb->getId())) {
-            while (ht_start != vb->ht.endPosition()) {
-                ht_start = vb->ht.pauseResumeVisit(*this, ht_start);
-                update(vb->getId());
-                log->commit1();
-                log->commit2();
-                items_scanned = 0;
-            }
+        while (ht_start != vb->ht.endPosition()) {
+            ht_start = vb->ht.pauseResumeVisit(*this, ht_start);
+            update(vb->getId());
+            log->commit1();
+            log->commit2();
+            items_scanned = 0;
         }
+        itemsLoggedByScan +=
+                log->itemsLogged[int(MutationLogType::New)] - logged;
+    }
+
+    bool pauseVisitor() override {
+        pauseDuration = 0;
+        if (CappedDurationVBucketVisitor::pauseVisitor()) {
+            return true;
+        }
+        if (maxItemsPerSec == 0) {
+            return false;
+        }
+        // Pause for as long as the scan is ahead of the max rate.
+        const double due = double(itemsLoggedByScan) / maxItemsPerSec;
+        const std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - taskStart;
+        if (due > elapsed.count()) {
+            pauseDuration = due - elapsed.count();
+            return true;
+        }
+        return false;
+    }
+
+    double getPauseDuration() const override {
+        return pauseDuration;
     }
 
     void complete() override {
@@ -123,6 +176,8 @@ public:
             log->commit1();
             log->commit2();
             log.reset();
+            currentIt.reset();
+            current.reset();
             stats.alogRuntime.store(ep_real_time() - startTime);
             stats.alogNumItems.store(num_items);
             stats.accessScannerHisto.add(
@@ -207,6 +262,91 @@ private:
         }
     }
 
+    /**
+     * Open the current access log, to copy the entries of the vBuckets whose
+     * residency hasn't changed since they were last scanned from.
+     */
+    void openCurrent() {
+        if (!cb::io::isFile(name)) {
+            return;
+        }
+        try {
+            current = std::make_unique<MutationLog>(name,
+                                                    log->getBlockSize());
+            current->open(true);
+            currentIt = current->begin();
+        } catch (const std::exception& e) {
+            EP_LOG_WARN("Failed to read access log '{}', scanning all of "
+                        "the vBuckets: {}",
+                        name,
+                        e.what());
+            currentIt.reset();
+            current.reset();
+        }
+    }
+
+    /**
+     * Has the number of resident items changed by less than the threshold
+     * since the vBucket was last scanned? (An approximation, as the same
+     * count of different items may now be resident.)
+     */
+    bool isResidencyUnchanged(const VBucket& vb) const {
+        const auto& last = as.residency[vb.getId().get()];
+        if (!last.scanned) {
+            return false;
+        }
+        auto diff = [](size_t a, size_t b) { return a > b ? a - b : b - a; };
+        const size_t items = vb.getNumItems();
+        const size_t changed =
+                diff(items, last.numItems) +
+                diff(vb.getNumNonResidentItems(), last.numNonResident);
+        return changed * 100 <
+               residencyChangeThreshold * std::max(items, last.numItems);
+    }
+
+    /**
+     * Copy the vBucket's entries from the current access log to the new one
+     * if its residency is unchanged. The logs are in vbid order, so the
+     * current log is read in step with the visit.
+     *
+     * @return true if entries were copied (and so the vBucket needn't be
+     *         scanned).
+     */
+    bool copyFromCurrent(const VBucket& vb) {
+        if (!currentIt || !isResidencyUnchanged(vb)) {
+            return false;
+        }
+
+        const auto vbid = vb.getId();
+        const size_t logged = log->itemsLogged[int(MutationLogType::New)];
+        try {
+            auto& it = *currentIt;
+            for (; it != current->end(); ++it) {
+                const auto entry = *it;
+                if (entry->vbucket() > vbid) {
+                    break;
+                }
+                if (entry->vbucket() == vbid &&
+                    entry->type() == MutationLogType::New) {
+                    log->newItem(vbid, StoredDocKey(entry->key()));
+                }
+            }
+        } catch (const std::exception& e) {
+            // Any entries already copied are harmless duplicates of those the
+            // scan will log.
+            EP_LOG_WARN("Failed to read access log '{}', scanning the "
+                        "remaining vBuckets: {}",
+                        name,
+                        e.what());
+            currentIt.reset();
+            current.reset();
+            return false;
+        }
+        log->commit1();
+        log->commit2();
+        return log->itemsLogged[int(MutationLogType::New)] > logged;
+    }
+
     VBucketFilter vBucketFilter;
 
     KVBucket& store;
@@ -221,6 +361,10 @@ private:
     std::vector<StoredDocKey> accessed;
 
     std::unique_ptr<MutationLog> log;
+    // The current access log (which the new log will replace), and how far
+    // into it the visit has read.
+    std::unique_ptr<MutationLog> current;
+    boost::optional<MutationLog::iterator> currentIt;
     std::atomic<bool> &stateFinalizer;
     AccessScanner &as;
 
@@ -228,6 +372,16 @@ private:
     uint64_t items_scanned;
     // The number of items to scan before we pause
     const uint64_t items_to_scan;
+
+    // The number of items logged by scanning (rather than copying), which
+    // maxItemsPerSec limits the rate of.
+    uint64_t itemsLoggedByScan = 0;
+    const size_t maxItemsPerSec;
+    // How long to sleep for when rate limited
+    double pauseDuration = 0;
+    // The percentage change in residency below which a vBucket's entries are
+    // copied from the current log rather than rescanned; 0 always rescans.
+    const size_t residencyChangeThreshold;
 };
 
 AccessScanner::AccessScanner(KVBucket& _store,
@@ -241,6 +395,7 @@ AccessScanner::AccessScanner(KVBucket& _store,
                  sleeptime,
                  completeBeforeShutdown),
       completedCount(0),
+      residency(_store.getVBuckets().getSize()),
       store(_store),
       conf(conf),
       stats(st),
@@ -19,6 +19,7 @@
 #include "globaltask.h"
 
 #include <string>
+#include <vector>
 
 // Forward declaration.
 class Configuration;
@@ -42,6 +43,23 @@ public:
 
     std::atomic<size_t> completedCount;
 
+    /**
+     * The item counts of a vBucket when it was last scanned, which later runs
+     * compare against to decide if the vBucket's entries in the previous
+     * access log are still representative.
+     */
+    struct Residency {
+        size_t numItems = 0;
+        size_t numNonResident = 0;
+        bool scanned = false;
+    };
+
+    /**
+     * The Residency of each vBucket (indexed by vbid). Each is only accessed
+     * by the visitor of the vBucket's shard, and the runs don't overlap.
+     */
+    std::vector<Residency> residency;
+
 protected:
     void createAndScheduleTask(size_t shard);
 
@@ -128,6 +128,10 @@ private:
     template <class MyTT> friend class RCPtr;
     template <class MySS, class Pointer, class Deleter>
     friend class SingleThreadedRCPtr;
+    // An inline Blob holds a reference on behalf of its owner
+    friend class Blob;
+    // A shared front-end Item holds a reference on behalf of the front end
+    friend class Item;
     int _rc_incref() const {
         return ++_rc_refcount;
     }
@@ -21,6 +21,7 @@
 #include "executorthread.h"
 #include "kv_bucket.h"
 #include "kvshard.h"
+#include "kvstore.h"
 #include "tasks.h"
 #include "vbucket_bgfetch_item.h"
 #include <phosphor/phosphor.h>
@@ -47,6 +48,7 @@ void BgFetcher::start() {
     ExecutorPool* iom = ExecutorPool::get();
     auto task =
             std::make_shared<MultiBGFetcherTask>(&(store.getEPEngine()), this);
+    task->setNumaNode(shard.getNumaNode());
     this->setTaskId(task->getId());
     iom->schedule(task);
 }
@@ -57,8 +59,8 @@ void BgFetcher::stop() {
     ExecutorPool::get()->cancel(taskId);
 }
 
-void BgFetcher::notifyBGEvent(void) {
-    ++stats.numRemainingBgItems;
+void BgFetcher::notifyBGEvent(size_t numItems) {
+    stats.numRemainingBgItems.fetch_add(numItems);
     wakeUpTaskIfSnoozed();
 }
 
@@ -69,7 +71,8 @@ void BgFetcher::wakeUpTaskIfSnoozed() {
     }
 }
 
-size_t BgFetcher::doFetch(Vbid vbId, vb_bgfetch_queue_t& itemsToFetch) {
+size_t BgFetcher::doFetch(VBucket& vb, vb_bgfetch_queue_t& itemsToFetch) {
+    const auto vbId = vb.getId();
     TRACE_EVENT2("BgFetcher",
                  "doFetch",
                  "vbid",
@@ -87,7 +90,24 @@ size_t BgFetcher::doFetch(Vbid vbId, vb_bgfetch_queue_t& itemsToFetch) {
                     startTime.time_since_epoch())
                     .count());
 
-    shard.getROUnderlying()->getMulti(vbId, itemsToFetch);
+    registerInFlight(vbId, itemsToFetch);
+    // Values still in the spill cache needn't be read from disk
+    auto spilled = vb.fetchSpilledValues(itemsToFetch);
+    if (!itemsToFetch.empty()) {
+        shard.getROUnderlying()->getMulti(vbId, itemsToFetch);
+    }
+    if (!spilled.empty()) {
+        for (auto& fetch : spilled) {
+            itemsToFetch.emplace(fetch.first, std::move(fetch.second));
+        }
+        // The moved contexts' values have new addresses
+        for (auto& fetch : itemsToFetch) {
+            for (auto& itm : fetch.second.bgfetched_list) {
+                itm->value = &fetch.second.value;
+            }
+        }
+    }
+    completeInFlight(vbId, itemsToFetch);
 
     std::vector<bgfetched_item_t> fetchedItems;
     for (const auto& fetch : itemsToFetch) {
@@ -113,6 +133,56 @@ size_t BgFetcher::doFetch(Vbid vbId, vb_bgfetch_queue_t& itemsToFetch) {
     return fetchedItems.size();
 }
 
+bool BgFetcher::coalesceFetch(Vbid vbId,
+                              const DiskDocKey& key,
+                              std::unique_ptr<VBucketBGFetchItem>& fetch) {
+    LockHolder lh(inFlightMutex);
+    auto vbIt = inFlight.find(vbId);
+    if (vbIt == inFlight.end()) {
+        return false;
+    }
+    auto it = vbIt->second.find(key);
+    if (it == vbIt->second.end()) {
+        return false;
+    }
+    auto& ctx = it->second;
+    if (ctx.isMetaOnly == GetMetaOnly::Yes && !fetch->metaDataOnly) {
+        // In-flight read will not return the value.
+        return false;
+    }
+    ctx.bgfetched_list.push_back(std::move(fetch));
+    ++stats.bg_fetch_coalesced;
+    return true;
+}
+
+void BgFetcher::registerInFlight(Vbid vbId, const vb_bgfetch_queue_t& items) {
+    LockHolder lh(inFlightMutex);
+    auto& fetches = inFlight[vbId];
+    for (const auto& item : items) {
+        fetches[item.first].isMetaOnly = item.second.isMetaOnly;
+    }
+}
+
+void BgFetcher::completeInFlight(Vbid vbId, vb_bgfetch_queue_t& items) {
+    LockHolder lh(inFlightMutex);
+    auto vbIt = inFlight.find(vbId);
+    if (vbIt == inFlight.end()) {
+        return;
+    }
+    for (auto& fetch : vbIt->second) {
+        auto it = items.find(fetch.first);
+        if (it == items.end()) {
+            continue;
+        }
+        auto& ctx = it->second;
+        for (auto& waiter : fetch.second.bgfetched_list) {
+            waiter->value = &ctx.value;
+            ctx.bgfetched_list.push_back(std::move(waiter));
+        }
+    }
+    inFlight.erase(vbIt);
+}
+
 bool BgFetcher::run(GlobalTask *task) {
     // Setup to snooze forever, and *then* clear the pending flag.
     // The ordering of these two statements is important - if we were
@@ -156,7 +226,7 @@ bool BgFetcher::run(GlobalTask *task) {
 
             auto items = vb->getBGFetchItems();
             if (items.size() > 0) {
-                num_fetched_items += doFetch(vbId, items);
+                num_fetched_items += doFetch(*vb, items);
             }
         }
     }
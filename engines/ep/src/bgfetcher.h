@@ -22,6 +22,9 @@
 
 #include "stats.h"
 #include "vbucket.h"
+#include "vbucket_bgfetch_item.h"
+
+#include <unordered_map>
 
 // Forward declarations.
 class KVBucket;
@@ -62,15 +65,48 @@ public:
     void stop(void);
     bool run(GlobalTask *task);
     bool pendingJob(void) const;
-    void notifyBGEvent(void);
+    /// Wake the BgFetcher for the given number of newly queued fetches.
+    void notifyBGEvent(size_t numItems = 1);
     void setTaskId(size_t newId) { taskId = newId; }
     void addPendingVB(Vbid vbId) {
         LockHolder lh(queueMutex);
         pendingVbs.insert(vbId);
     }
 
+    /**
+     * Attempt to satisfy a background fetch by attaching it to an identical
+     * fetch which this BgFetcher is currently reading from disk, instead of
+     * queueing another read of the same document.
+     *
+     * A fetch in flight for the full document satisfies both full and
+     * metadata-only requests; a metadata-only fetch in flight only
+     * satisfies metadata-only requests.
+     *
+     * @param vbId vBucket the key belongs to
+     * @param key key to fetch
+     * @param fetch request to attach; ownership is taken (and fetch reset)
+     *        if it was attached.
+     * @return true if the request was attached to an in-flight fetch.
+     */
+    bool coalesceFetch(Vbid vbId,
+                       const DiskDocKey& key,
+                       std::unique_ptr<VBucketBGFetchItem>& fetch);
+
+    /**
+     * Record the given batch of fetches as in flight, so identical requests
+     * arriving while it is read can attach to it (see coalesceFetch()).
+     */
+    void registerInFlight(Vbid vbId, const vb_bgfetch_queue_t& items);
+
+    /**
+     * Stop accepting requests for the given (previously registered) batch,
+     * moving any requests which attached to it into the batch so they are
+     * completed along with it.
+     */
+    void completeInFlight(Vbid vbId, vb_bgfetch_queue_t& items);
+
 private:
-    size_t doFetch(Vbid vbId, vb_bgfetch_queue_t& items);
+    size_t doFetch(VBucket& vb, vb_bgfetch_queue_t& items);
 
     /// If the BGFetch task is currently snoozed (not scheduled to
     /// run), wake it up. Has no effect the if the task has already
@@ -85,4 +121,12 @@ private:
 
     std::atomic<bool> pendingFetch;
     std::set<Vbid> pendingVbs;
+
+    /**
+     * Fetches currently being read from disk, per vBucket. For each key the
+     * context records whether the in-flight read is metadata-only, and
+     * holds the requests which attached to it while it was being read.
+     */
+    std::mutex inFlightMutex;
+    std::unordered_map<Vbid, vb_bgfetch_queue_t> inFlight;
 };
@@ -20,25 +20,79 @@
 #include "objectregistry.h"
 
 #include <cstring>
+#include <stdexcept>
+#include <string>
 
 Blob* Blob::New(const char* start, const size_t len) {
+    MemoryDomainGuard guard(MemoryDomain::Blob);
     size_t total_len = getAllocationSize(len);
     Blob* t = new (::operator new(total_len)) Blob(start, len);
     return t;
 }
 
 Blob* Blob::New(const size_t len) {
+    MemoryDomainGuard guard(MemoryDomain::Blob);
     size_t total_len = getAllocationSize(len);
     Blob* t = new (::operator new(total_len)) Blob(len);
     return t;
 }
 
 Blob* Blob::Copy(const Blob& other) {
+    MemoryDomainGuard guard(MemoryDomain::Blob);
     Blob* t = new (::operator new(Blob::getAllocationSize(other.valueSize())))
             Blob(other);
     return t;
 }
 
+Blob* Blob::NewInline(void* storage,
+                      size_t ownerOffset,
+                      const char* start,
+                      const size_t len) {
+    if (len > MaxInlineSize || ownerOffset > MaxInlineOwnerOffset) {
+        throw std::invalid_argument(
+                "Blob::NewInline: len:" + std::to_string(len) +
+                " or ownerOffset:" + std::to_string(ownerOffset) +
+                " too large");
+    }
+    Blob* t = new (storage) Blob(start, len, ownerOffset);
+    t->_rc_incref();
+    return t;
+}
+
+void Blob::releaseInline(Blob* blob) {
+    if (blob->_rc_decref() == 0) {
+        Deleter()(blob);
+    }
+}
+
+void Blob::reuseInline(const char* start, const size_t len) {
+    const uint32_t ownerBits = size & ~(uncompressibleFlag | inlineSizeMask);
+    ObjectRegistry::onDeleteBlob(this);
+    std::memcpy(data, start, len);
+    size = uint32_t(len) | ownerBits;
+    age = 0;
+    ObjectRegistry::onCreateBlob(this);
+}
+
+void Blob::Deleter::operator()(TaggedPtr<Blob> item) {
+    Blob* blob = item.get();
+    if (!blob->isInline()) {
+        delete blob;
+        return;
+    }
+    // The owner has already been destroyed (it holds a reference until
+    // then), so free its storage along with the Blob.
+    char* owner = blob->getInlineOwner();
+    blob->~Blob();
+    MemoryDomainGuard guard(MemoryDomain::HashTable);
+    ::operator delete(owner);
+}
+
+void Blob::operator delete(void* p) {
+    MemoryDomainGuard guard(MemoryDomain::Blob);
+    ::operator delete(p);
+}
+
 Blob::Blob(const char* start, const size_t len)
     : size(static_cast<uint32_t>(len)), age(0) {
     if (start != NULL) {
@@ -54,8 +108,19 @@ Blob::Blob(const char* start, const size_t len)
 Blob::Blob(const size_t len) : Blob(nullptr, len) {
 }
 
+Blob::Blob(const char* start, const size_t len, size_t ownerOffset)
+    : size(uint32_t(len) | inlineFlag |
+           uint32_t(ownerOffset << inlineOwnerOffsetShift)),
+      age(0) {
+    if (start != nullptr) {
+        std::memcpy(data, start, len);
+    }
+    ObjectRegistry::onCreateBlob(this);
+}
+
 Blob::Blob(const Blob& other)
-    : size(other.size.load()),
+    : size(uint32_t(other.valueSize()) |
+           (other.size.load() & uncompressibleFlag)),
       // While this is a copy, it is a new allocation therefore reset age.
       age(0) {
     std::memcpy(data, other.data, other.valueSize());
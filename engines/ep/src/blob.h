@@ -52,6 +52,48 @@ public:
      */
     static Blob* Copy(const Blob& other);
 
+    /**
+     * Create a new "inline" Blob holding the given data, in storage which is
+     * part of its owner's allocation (see StoredValue's inline value) rather
+     * than an allocation of its own.
+     *
+     * The Blob is created holding a reference on behalf of its owner, which
+     * must be dropped with releaseInline() once the owner is destroyed. The
+     * owner's allocation is freed along with the Blob, when its last
+     * reference is dropped - so a Blob shared with Items stays valid (and
+     * keeps its owner's storage) until those Items are freed.
+     *
+     * @param storage where to create the Blob, of getAllocationSize(len)
+     * @param ownerOffset the offset of storage from the start of the
+     *        owner's allocation (at most MaxInlineOwnerOffset)
+     * @param start the beginning of the data to copy into this blob
+     * @param len the amount of data to copy in (at most MaxInlineSize)
+     *
+     * @return the new Blob instance
+     */
+    static Blob* NewInline(void* storage,
+                           size_t ownerOffset,
+                           const char* start,
+                           const size_t len);
+
+    /**
+     * Drop the owner's reference to an inline Blob, called by the owner when
+     * destroyed. If this was the last reference, the Blob and the owner's
+     * allocation are freed.
+     */
+    static void releaseInline(Blob* blob);
+
+    /// @return the number of bytes used by a Blob holding len bytes
+    static size_t getAllocationSize(size_t len) {
+        return sizeof(Blob) + len - sizeof(Blob(0, 0).data);
+    }
+
+    /// The largest value an inline Blob may hold
+    static const size_t MaxInlineSize = 0xffff;
+
+    /// The largest offset of an inline Blob in its owner's allocation
+    static const size_t MaxInlineOwnerOffset = 0x3fff;
+
     // Actual accessorish things.
 
     /**
@@ -65,7 +107,11 @@ public:
      * Get the size of this Blob's value.
      */
     size_t valueSize() const {
-        return size & ~(0x80000000);
+        const uint32_t s = size;
+        if (s & inlineFlag) {
+            return s & inlineSizeMask;
+        }
+        return s & ~uncompressibleFlag;
     }
 
     /**
@@ -99,7 +145,7 @@ public:
      * Check if the given data is compressible
      */
     bool isCompressible() {
-        return ~(size & 0x80000000);
+        return ~(size & uncompressibleFlag);
     }
 
     /**
@@ -107,9 +153,28 @@ public:
      * This should be fine given that the maximum value we support is 20 MiB
      */
     void setUncompressible() {
-        size |= 0x80000000;
+        size |= uncompressibleFlag;
+    }
+
+    /// @return true if this Blob is stored in its owner's allocation
+    bool isInline() const {
+        return size & inlineFlag;
+    }
+
+    /**
+     * @return true if this is an inline Blob only referenced by its owner,
+     *         so it may be recreated (with reuseInline) to hold another value
+     */
+    bool isInlineUnused() const {
+        return isInline() && _rc_refcount == 1;
     }
 
+    /**
+     * Recreate an unused inline Blob (see isInlineUnused) to hold the given
+     * data, which must fit the storage it was created with.
+     */
+    void reuseInline(const char* start, const size_t len);
+
     /**
      * Get a std::string representation of this blob.
      */
@@ -118,9 +183,7 @@ public:
     // This is necessary for making C++ happy when I'm doing a
     // placement new on fairly "normal" c++ heap allocations, just
     // with variable-sized objects.
-    void operator delete(void* p) {
-        ::operator delete(p);
-    }
+    void operator delete(void* p);
 
     ~Blob();
 
@@ -131,15 +194,22 @@ public:
 
     class Deleter {
     public:
-        void operator()(TaggedPtr<Blob> item) {
-            delete item.get();
-        }
+        void operator()(TaggedPtr<Blob> item);
     };
 
 private:
     //Ensure Blob size of 12 bytes by padding by 3.
     static constexpr int paddingSize{3};
 
+    // The highest bit of size is set if the value is uncompressible. The
+    // next one is set for an inline Blob, whose size is then made of its
+    // value size (in the lower 16 bits) and its owner offset (see NewInline)
+    // in the 14 bits above.
+    static constexpr uint32_t uncompressibleFlag{0x80000000};
+    static constexpr uint32_t inlineFlag{0x40000000};
+    static constexpr uint32_t inlineSizeMask{0xffff};
+    static constexpr int inlineOwnerOffsetShift{16};
+
 protected:
     /* Constructor.
      * @param start If non-NULL, pointer to array which will be copied into
@@ -153,8 +223,13 @@ protected:
 
     explicit Blob(const Blob& other);
 
-    static size_t getAllocationSize(size_t len) {
-        return sizeof(Blob) + len - sizeof(Blob(0, 0).data);
+    /// Constructor of an inline Blob, see NewInline
+    Blob(const char* start, const size_t len, size_t ownerOffset);
+
+    /// @return the start of the owner's allocation of an inline Blob
+    char* getInlineOwner() {
+        return reinterpret_cast<char*>(this) -
+               ((size >> inlineOwnerOffsetShift) & MaxInlineOwnerOffset);
     }
 
     // Size of the value. The highest bit is used to represent if the
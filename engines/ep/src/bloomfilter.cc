@@ -21,7 +21,9 @@
 
 #include "murmurhash3.h"
 
+#include <algorithm>
 #include <cmath>
+#include <stdexcept>
 
 #if __x86_64__ || __ppc64__
 #define MURMURHASH_3 MurmurHash3_x64_128
@@ -29,19 +31,51 @@
 #define MURMURHASH_3 MurmurHash3_x86_128
 #endif
 
-BloomFilter::BloomFilter(size_t key_count, double false_positive_prob,
-                         bfilter_status_t new_status) {
-
+BloomFilter::BloomFilter(size_t key_count,
+                         double false_positive_prob,
+                         bfilter_status_t new_status,
+                         Type type)
+    : type(type) {
     status = new_status;
+    estimatedKeyCount = key_count;
     filterSize = estimateFilterSize(key_count, false_positive_prob);
-    noOfHashes = estimateNoOfHashes(key_count);
     keyCounter = 0;
-    bitArray.assign(filterSize, false);
+    if (type == Type::Standard) {
+        noOfHashes = estimateNoOfHashes(key_count);
+        bitArray.assign(filterSize, false);
+    } else {
+        const size_t blockBits = blockWords * 32;
+        numBlocks = std::max(size_t(1), (filterSize + blockBits - 1) / blockBits);
+        filterSize = numBlocks * blockBits;
+        noOfHashes = blockWords;
+        // Align the blocks to their size, so none straddles a cache line.
+        blockArray.assign(numBlocks * blockWords + blockWords - 1, 0);
+        const auto addr = reinterpret_cast<uintptr_t>(blockArray.data());
+        const size_t blockBytes = blockWords * sizeof(uint32_t);
+        blockOffset = ((blockBytes - addr % blockBytes) % blockBytes) /
+                      sizeof(uint32_t);
+    }
 }
 
 BloomFilter::~BloomFilter() {
     status = BFILTER_DISABLED;
+    clearBits();
+}
+
+BloomFilter::Type BloomFilter::typeFromString(const std::string& name) {
+    if (name == "standard") {
+        return Type::Standard;
+    }
+    if (name == "blocked") {
+        return Type::Blocked;
+    }
+    throw std::invalid_argument(
+            "BloomFilter::typeFromString: unknown type '" + name + "'");
+}
+
+void BloomFilter::clearBits() {
     bitArray.clear();
+    blockArray.clear();
 }
 
 size_t BloomFilter::estimateFilterSize(size_t key_count,
@@ -62,6 +96,31 @@ uint64_t BloomFilter::hashDocKey(const DocKey& key, uint32_t iteration) {
     return result;
 }
 
+uint32_t* BloomFilter::getBlock(uint64_t hash) {
+    // The upper half of the hash selects the block, the lower half the bits
+    // within it.
+    const size_t block = size_t(hash >> 32) % numBlocks;
+    return blockArray.data() + blockOffset + block * blockWords;
+}
+
+void BloomFilter::makeBlockMask(uint64_t hash, uint32_t (&mask)[blockWords]) {
+    // Derive one bit index (0-31) per word by multiplying the hash by an odd
+    // constant per word and taking the top 5 bits of the product, as in the
+    // "split block" bloom filters of Impala / Parquet.
+    static const uint32_t salt[blockWords] = {0x47b6137bU,
+                                              0x44974d91U,
+                                              0x8824ad5bU,
+                                              0xa2b7289dU,
+                                              0x705495c7U,
+                                              0x2df1424bU,
+                                              0x9efc4947U,
+                                              0x5c6bfb31U};
+    const auto h = uint32_t(hash);
+    for (size_t i = 0; i < blockWords; i++) {
+        mask[i] = uint32_t(1) << ((h * salt[i]) >> 27);
+    }
+}
+
 void BloomFilter::setStatus(bfilter_status_t to) {
     switch (status) {
         case BFILTER_DISABLED:
@@ -72,7 +131,7 @@ void BloomFilter::setStatus(bfilter_status_t to) {
         case BFILTER_PENDING:
             if (to == BFILTER_DISABLED) {
                 status = to;
-                bitArray.clear();
+                clearBits();
             } else if (to == BFILTER_COMPACTING) {
                 status = to;
             }
@@ -80,7 +139,7 @@ void BloomFilter::setStatus(bfilter_status_t to) {
         case BFILTER_COMPACTING:
             if (to == BFILTER_DISABLED) {
                 status = to;
-                bitArray.clear();
+                clearBits();
             } else if (to == BFILTER_ENABLED) {
                 status = to;
             }
@@ -88,7 +147,7 @@ void BloomFilter::setStatus(bfilter_status_t to) {
         case BFILTER_ENABLED:
             if (to == BFILTER_DISABLED) {
                 status = to;
-                bitArray.clear();
+                clearBits();
             } else if (to == BFILTER_COMPACTING) {
                 status = to;
             }
@@ -115,7 +174,21 @@ std::string BloomFilter::getStatusString() {
 }
 
 void BloomFilter::addKey(const DocKey& key) {
-    if (status == BFILTER_COMPACTING || status == BFILTER_ENABLED) {
+    if ((status == BFILTER_COMPACTING || status == BFILTER_ENABLED) &&
+        type == Type::Blocked) {
+        const uint64_t hash = hashDocKey(key, 0);
+        uint32_t* block = getBlock(hash);
+        uint32_t mask[blockWords];
+        makeBlockMask(hash, mask);
+        uint32_t missing = 0;
+        for (size_t i = 0; i < blockWords; i++) {
+            missing |= mask[i] & ~block[i];
+            block[i] |= mask[i];
+        }
+        if (missing != 0) {
+            keyCounter++;
+        }
+    } else if (status == BFILTER_COMPACTING || status == BFILTER_ENABLED) {
         bool overlap = true;
         for (uint32_t i = 0; i < noOfHashes; i++) {
             uint64_t result = hashDocKey(key, i);
@@ -131,7 +204,20 @@ void BloomFilter::addKey(const DocKey& key) {
 }
 
 bool BloomFilter::maybeKeyExists(const DocKey& key) {
-    if (status == BFILTER_COMPACTING || status == BFILTER_ENABLED) {
+    if ((status == BFILTER_COMPACTING || status == BFILTER_ENABLED) &&
+        type == Type::Blocked) {
+        const uint64_t hash = hashDocKey(key, 0);
+        const uint32_t* block = getBlock(hash);
+        uint32_t mask[blockWords];
+        makeBlockMask(hash, mask);
+        // Test every word without branching, so the loop vectorises.
+        uint32_t missing = 0;
+        for (size_t i = 0; i < blockWords; i++) {
+            missing |= mask[i] & ~block[i];
+        }
+        // The key does NOT exist if any of its bits are clear.
+        return missing == 0;
+    } else if (status == BFILTER_COMPACTING || status == BFILTER_ENABLED) {
         for (uint32_t i = 0; i < noOfHashes; i++) {
             uint64_t result = hashDocKey(key, i);
             if (bitArray[result % filterSize] == 0) {
@@ -16,6 +16,7 @@
  */
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -33,13 +34,38 @@ enum bfilter_status_t {
  * We are to maintain the vbucket-number of these instances.
  *
  * Each vbucket will hold one such object.
+ *
+ * Two layouts are supported:
+ *  - Standard: noOfHashes independent hashes of the key, each selecting a bit
+ *    anywhere in the filter - so a lookup touches up to noOfHashes cache
+ *    lines.
+ *  - Blocked: a single hash of the key selects one block of blockWords
+ *    32-bit words (which never straddles a cache line), and sets / tests one
+ *    bit in each word of it. A lookup is therefore one hash and one cache
+ *    miss, and the per-word tests are written so the compiler can vectorise
+ *    them. For the same size the false positive rate is somewhat higher than
+ *    a standard filter's.
  */
 class BloomFilter {
 public:
-    BloomFilter(size_t key_count, double false_positive_prob,
-                bfilter_status_t newStatus = BFILTER_DISABLED);
+    enum class Type { Standard, Blocked };
+
+    BloomFilter(size_t key_count,
+                double false_positive_prob,
+                bfilter_status_t newStatus = BFILTER_DISABLED,
+                Type type = Type::Standard);
     ~BloomFilter();
 
+    /**
+     * @return the Type named by the given bfilter_type config value
+     * @throws std::invalid_argument if it doesn't name one
+     */
+    static Type typeFromString(const std::string& name);
+
+    Type getType() const {
+        return type;
+    }
+
     void setStatus(bfilter_status_t to);
     bfilter_status_t getStatus();
     std::string getStatusString();
@@ -50,17 +76,41 @@ public:
     size_t getNumOfKeysInFilter();
     size_t getFilterSize();
 
+    /// @return the number of keys the filter was sized for
+    size_t getEstimatedKeyCount() const {
+        return estimatedKeyCount;
+    }
+
 protected:
+    /// Number of 32-bit words (and so bits set per key) in a Blocked block.
+    static const size_t blockWords = 8;
+
     size_t estimateFilterSize(size_t key_count, double false_positive_prob);
     size_t estimateNoOfHashes(size_t key_count);
 
     uint64_t hashDocKey(const DocKey& key, uint32_t iteration);
 
+    /// @return the first word of the Blocked block the key hash selects.
+    uint32_t* getBlock(uint64_t hash);
+    /// Compute the bit to set / test in each word of a Blocked block.
+    static void makeBlockMask(uint64_t hash, uint32_t (&mask)[blockWords]);
+
+    void clearBits();
+
+    const Type type;
+
+    size_t estimatedKeyCount;
     size_t filterSize;
     size_t noOfHashes;
 
     size_t keyCounter;
 
     bfilter_status_t status;
+    // Standard filter bits.
     std::vector<bool> bitArray;
+    // Blocked filter blocks, numBlocks * blockWords words starting at
+    // blockOffset (over-allocated so the blocks can be aligned).
+    std::vector<uint32_t> blockArray;
+    size_t blockOffset = 0;
+    size_t numBlocks = 0;
 };
@@ -17,6 +17,7 @@
 
 #include <gsl.h>
 #include <platform/checked_snprintf.h>
+#include <algorithm>
 #include <string>
 #include <utility>
 #include <vector>
@@ -131,13 +132,17 @@ QueueDirtyStatus Checkpoint::queueDirty(const queued_item& qi,
     }
 
     QueueDirtyStatus rv;
+    // The keyIndex entry for a non-meta item, looked up once and reused below
+    // to save hashing the key again. No other keyIndex insert happens in
+    // between so it remains valid.
+    checkpoint_index::iterator it = keyIndex.end();
 
     // Check if the item is a meta item
     if (qi->isCheckPointMetaItem()) {
         rv = QueueDirtyStatus::SuccessNewItem;
         addItemToCheckpoint(qi);
     } else {
-        checkpoint_index::iterator it = keyIndex.find(qi->getKey());
+        it = keyIndex.find(qi->getKey());
         // Check if this checkpoint already has an item for the same key
         // and the item has not been expelled.
         if (it != keyIndex.end() &&
@@ -210,6 +215,7 @@ QueueDirtyStatus Checkpoint::queueDirty(const queued_item& qi,
             // item being removed.
             queuedItemsMemUsage -= ((*currPos)->size());
             // Remove the existing item for the same key from the list.
+            removeFromSeqnoIndex(currPos.getUnderlyingIterator());
             toWrite.erase(currPos.getUnderlyingIterator());
 
             // Reduce the number of items because addItemToCheckpoint
@@ -234,13 +240,12 @@ QueueDirtyStatus Checkpoint::queueDirty(const queued_item& qi,
                 // Did not manage to insert - so update the value directly
                 result.first->second = entry;
             }
+        } else if (it != keyIndex.end()) {
+            // The key is already indexed - update the value directly
+            it->second = entry;
         } else {
             // Insert the new entry into the keyIndex
-            auto result = keyIndex.emplace(qi->getKey(), entry);
-            if (!result.second) {
-                // Did not manage to insert - so update the value directly
-                result.first->second = entry;
-            }
+            keyIndex.emplace(qi->getKey(), entry);
         }
 
         if (rv == QueueDirtyStatus::SuccessNewItem) {
@@ -298,6 +303,39 @@ void Checkpoint::addItemToCheckpoint(const queued_item& qi) {
     } else {
         // Not a meta item
         ++numItems;
+        if (++itemsSinceSeqnoIndexEntry == seqnoIndexInterval) {
+            seqnoIndex.emplace_back(qi->getBySeqno(), std::prev(toWrite.end()));
+            itemsSinceSeqnoIndexEntry = 0;
+        }
+    }
+}
+
+ChkptQueueIterator Checkpoint::getIteratorAtOrBeforeSeqno(
+        uint64_t seqno) const {
+    // Find the last index entry with a seqno <= the requested one.
+    auto it = std::upper_bound(
+            seqnoIndex.begin(),
+            seqnoIndex.end(),
+            int64_t(seqno),
+            [](int64_t s, const std::pair<int64_t, CheckpointQueue::iterator>&
+                                  entry) { return s < entry.first; });
+    if (it == seqnoIndex.begin()) {
+        return begin();
+    }
+    return ChkptQueueIterator(const_cast<CheckpointQueue&>(toWrite),
+                              std::prev(it)->second);
+}
+
+void Checkpoint::removeFromSeqnoIndex(CheckpointQueue::iterator position) {
+    const auto seqno = (*position)->getBySeqno();
+    auto it = std::lower_bound(
+            seqnoIndex.begin(),
+            seqnoIndex.end(),
+            seqno,
+            [](const std::pair<int64_t, CheckpointQueue::iterator>& entry,
+               int64_t s) { return entry.first < s; });
+    if (it != seqnoIndex.end() && it->second == position) {
+        seqnoIndex.erase(it);
     }
 }
 
@@ -330,6 +368,17 @@ CheckpointQueue Checkpoint::expelItems(
                          begin().getUnderlyingIterator(),
                          iterator.getUnderlyingIterator());
 
+    // Drop the seqno index entries for the expelled items.
+    seqnoIndex.erase(
+            seqnoIndex.begin(),
+            std::upper_bound(
+                    seqnoIndex.begin(),
+                    seqnoIndex.end(),
+                    int64_t(highestExpelledSeqno),
+                    [](int64_t s,
+                       const std::pair<int64_t, CheckpointQueue::iterator>&
+                               entry) { return s < entry.first; }));
+
     // Return the items that have been expelled in a separate queue.
     return expelledItems;
 }
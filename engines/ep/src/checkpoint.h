@@ -32,6 +32,7 @@
 #include <map>
 #include <set>
 #include <unordered_map>
+#include <vector>
 
 #define GIGANTOR ((size_t)1<<(sizeof(size_t)*8-1))
 
@@ -56,10 +57,43 @@ enum checkpoint_state {
 
 const char* to_string(enum checkpoint_state);
 
+/**
+ * The allocator of the checkpoint queues and indexes: a
+ * MemoryTrackingAllocator which also attributes their memory to
+ * MemoryDomain::Checkpoint (but not that of the items and keys they hold,
+ * which are allocated and released elsewhere).
+ */
+template <class T>
+class CheckpointAllocator : public MemoryTrackingAllocator<T> {
+public:
+    using value_type = T;
+
+    CheckpointAllocator() noexcept = default;
+
+    template <class U>
+    CheckpointAllocator(CheckpointAllocator<U> const& other) noexcept
+        : MemoryTrackingAllocator<T>(other) {
+    }
+
+    value_type* allocate(std::size_t n) {
+        MemoryDomainGuard guard(MemoryDomain::Checkpoint);
+        return MemoryTrackingAllocator<T>::allocate(n);
+    }
+
+    void deallocate(value_type* p, std::size_t n) noexcept {
+        MemoryDomainGuard guard(MemoryDomain::Checkpoint);
+        MemoryTrackingAllocator<T>::deallocate(p, n);
+    }
+
+    CheckpointAllocator select_on_container_copy_construction() const {
+        return CheckpointAllocator();
+    }
+};
+
 // List is used for queueing mutations as vector incurs shift operations for
 // de-duplication.  We template the list on a queued_item and our own
 // memory allocator which allows memory usage to be tracked.
-typedef std::list<queued_item, MemoryTrackingAllocator<queued_item>>
+typedef std::list<queued_item, CheckpointAllocator<queued_item>>
         CheckpointQueue;
 
 // Iterator for the Checkpoint queue.  The iterator is templated on the
@@ -82,7 +116,7 @@ using checkpoint_index = std::unordered_map<
         index_entry,
         std::hash<StoredDocKey>,
         std::equal_to<StoredDocKey>,
-        MemoryTrackingAllocator<std::pair<const StoredDocKey, index_entry>>>;
+        CheckpointAllocator<std::pair<const StoredDocKey, index_entry>>>;
 
 class Checkpoint;
 class CheckpointManager;
@@ -345,7 +379,7 @@ std::string to_string(QueueDirtyStatus value);
  * backwards until either a mutation item or the dummy item is reached.
  *
  */
-class Checkpoint {
+class Checkpoint : public MemoryDomainAllocated<MemoryDomain::Checkpoint> {
 public:
     Checkpoint(EPStats& st,
                uint64_t id,
@@ -489,6 +523,15 @@ public:
                                   ChkptQueueIterator::Position::end);
     }
 
+    /**
+     * Returns an iterator to a position in the checkpoint where it and every
+     * item before it have a seqno no greater than the given seqno, as close
+     * to the last such item as the seqno index allows (begin() if there is
+     * no closer indexed position). Used to avoid walking the whole
+     * checkpoint when looking for a seqno.
+     */
+    ChkptQueueIterator getIteratorAtOrBeforeSeqno(uint64_t seqno) const;
+
     /**
      * Returns the memory held by the checkpoint, which is the sum of the
      * memory used by all items held in the checkpoint plus the checkpoint
@@ -535,6 +578,15 @@ public:
     CheckpointQueue expelItems(CheckpointCursor& expelUpToAndIncluding);
 
 private:
+    /**
+     * Remove the seqno index entry (if any) for the given position, which is
+     * about to be erased from toWrite.
+     */
+    void removeFromSeqnoIndex(CheckpointQueue::iterator position);
+
+    /// Every seqnoIndexInterval'th non-meta item is added to the seqnoIndex.
+    static const size_t seqnoIndexInterval = 64;
+
     EPStats                       &stats;
     uint64_t                       checkpointId;
     uint64_t                       snapStartSeqno;
@@ -553,13 +605,21 @@ private:
     cb::NonNegativeCounter<size_t> numOfCursorsInCheckpoint = 0;
 
     // Allocator used for tracking memory used by the CheckpointQueue
-    MemoryTrackingAllocator<queued_item> trackingAllocator;
+    CheckpointAllocator<queued_item> trackingAllocator;
     // Allocator used for tracking memory used by the CheckpointQueue
     checkpoint_index::allocator_type keyIndexTrackingAllocator;
     CheckpointQueue toWrite;
     checkpoint_index               keyIndex;
     /* Index for meta keys like "dummy_key" */
     checkpoint_index               metaKeyIndex;
+    /*
+     * Sparse index of (seqno, position) for every seqnoIndexInterval'th
+     * non-meta item in toWrite, in seqno order. Entries are removed when
+     * their item is de-duplicated or expelled.
+     */
+    std::vector<std::pair<int64_t, CheckpointQueue::iterator>> seqnoIndex;
+    /// Number of non-meta items added since the last seqnoIndex entry.
+    size_t itemsSinceSeqnoIndexEntry = 0;
 
     // Record the memory overhead of maintaining the keyIndex and metaKeyIndex.
     // This includes each item's key size and sizeof(index_entry).
@@ -45,6 +45,8 @@ public:
             config.allowItemNumBasedNewCheckpoint(value);
         } else if (key.compare("keep_closed_chks") == 0) {
             config.allowKeepClosedCheckpoints(value);
+        } else if (key.compare("chk_compress_values") == 0) {
+            config.allowCompressValues(value);
         }
     }
 
@@ -58,7 +60,8 @@ CheckpointConfig::CheckpointConfig()
       maxCheckpoints(DEFAULT_MAX_CHECKPOINTS),
       itemNumBasedNewCheckpoint(true),
       keepClosedCheckpoints(false),
-      persistenceEnabled(true) { /* empty */
+      persistenceEnabled(true),
+      compressValues(false) { /* empty */
 }
 
 CheckpointConfig::CheckpointConfig(rel_time_t period,
@@ -66,13 +69,15 @@ CheckpointConfig::CheckpointConfig(rel_time_t period,
                                    size_t max_ckpts,
                                    bool item_based_new_ckpt,
                                    bool keep_closed_ckpts,
-                                   bool persistence_enabled)
+                                   bool persistence_enabled,
+                                   bool compress_values)
     : checkpointPeriod(period),
       checkpointMaxItems(max_items),
       maxCheckpoints(max_ckpts),
       itemNumBasedNewCheckpoint(item_based_new_ckpt),
       keepClosedCheckpoints(keep_closed_ckpts),
-      persistenceEnabled(persistence_enabled) {
+      persistenceEnabled(persistence_enabled),
+      compressValues(compress_values) {
 }
 
 CheckpointConfig::CheckpointConfig(EventuallyPersistentEngine& e) {
@@ -83,6 +88,7 @@ CheckpointConfig::CheckpointConfig(EventuallyPersistentEngine& e) {
     itemNumBasedNewCheckpoint = config.isItemNumBasedNewChk();
     keepClosedCheckpoints = config.isKeepClosedChks();
     persistenceEnabled = config.getBucketType() == "persistent";
+    compressValues = config.isChkCompressValues();
 }
 
 void CheckpointConfig::addConfigChangeListener(
@@ -103,6 +109,9 @@ void CheckpointConfig::addConfigChangeListener(
     configuration.addValueChangedListener(
             "keep_closed_chks",
             std::make_unique<ChangeListener>(engine.getCheckpointConfig()));
+    configuration.addValueChangedListener(
+            "chk_compress_values",
+            std::make_unique<ChangeListener>(engine.getCheckpointConfig()));
 }
 
 bool CheckpointConfig::validateCheckpointMaxItemsParam(
@@ -34,7 +34,8 @@ public:
                      size_t max_ckpts,
                      bool item_based_new_ckpt,
                      bool keep_closed_ckpts,
-                     bool persistence_enabled);
+                     bool persistence_enabled,
+                     bool compress_values = false);
 
     CheckpointConfig(EventuallyPersistentEngine& e);
 
@@ -62,6 +63,10 @@ public:
         return persistenceEnabled;
     }
 
+    bool isCompressValuesEnabled() const {
+        return compressValues;
+    }
+
 protected:
     friend class CheckpointConfigChangeListener;
     friend class EventuallyPersistentEngine;
@@ -82,6 +87,10 @@ protected:
         keepClosedCheckpoints = value;
     }
 
+    void allowCompressValues(bool value) {
+        compressValues = value;
+    }
+
     static void addConfigChangeListener(EventuallyPersistentEngine& engine);
 
 private:
@@ -104,4 +113,8 @@ private:
 
     // Flag indicating if persistence is enabled.
     bool persistenceEnabled;
+
+    // Flag indicating if item values should be compressed when queued into a
+    // checkpoint.
+    bool compressValues;
 };
@@ -73,6 +73,14 @@ public:
         }
     }
 
+    /**
+     * Construct an iterator at the given position in the container. The
+     * position must not be a null element.
+     */
+    CheckpointIterator(std::reference_wrapper<C> c, typename C::iterator it)
+        : container(c), iter(it) {
+    }
+
     auto operator++() {
         moveForward();
 
@@ -20,11 +20,14 @@
 #include "bucket_logger.h"
 #include "checkpoint.h"
 #include "ep_time.h"
+#include "lock_profiler.h"
 #include "pre_link_document_context.h"
 #include "statwriter.h"
+#include "trace_helpers.h"
 #include "vbucket.h"
 
 #include <gsl.h>
+#include <phosphor/phosphor.h>
 
 CheckpointManager::CheckpointManager(EPStats& st,
                                      Vbid vbucket,
@@ -40,7 +43,7 @@ CheckpointManager::CheckpointManager(EPStats& st,
       lastBySeqno(lastSeqno),
       pCursorPreCheckpointId(0),
       flusherCB(cb) {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
 
     // Note: this is the last moment in the CheckpointManager lifetime
     //     when the checkpointList is empty.
@@ -63,7 +66,7 @@ uint64_t CheckpointManager::getOpenCheckpointId_UNLOCKED(const LockHolder& lh) {
 }
 
 uint64_t CheckpointManager::getOpenCheckpointId() {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     return getOpenCheckpointId_UNLOCKED(lh);
 }
 
@@ -74,12 +77,12 @@ uint64_t CheckpointManager::getLastClosedCheckpointId_UNLOCKED(
 }
 
 uint64_t CheckpointManager::getLastClosedCheckpointId() {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     return getLastClosedCheckpointId_UNLOCKED(lh);
 }
 
 void CheckpointManager::setOpenCheckpointId(uint64_t id) {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     setOpenCheckpointId_UNLOCKED(lh, id);
 }
 
@@ -225,7 +228,7 @@ void CheckpointManager::addOpenCheckpoint(uint64_t id,
 
 CursorRegResult CheckpointManager::registerCursorBySeqno(
         const std::string& name, uint64_t startBySeqno) {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     return registerCursorBySeqno_UNLOCKED(lh, name, startBySeqno);
 }
 
@@ -274,8 +277,11 @@ CursorRegResult CheckpointManager::registerCursorBySeqno_UNLOCKED(
             break;
         } else if (startBySeqno <= en) {
             // Requested sequence number lies within this checkpoint.
-            // Calculate which item to position the cursor at.
-            ChkptQueueIterator iitr = (*itr)->begin();
+            // Calculate which item to position the cursor at, starting from
+            // the nearest indexed position rather than walking the whole
+            // checkpoint.
+            ChkptQueueIterator iitr =
+                    (*itr)->getIteratorAtOrBeforeSeqno(startBySeqno);
             while (++iitr != (*itr)->end() &&
                     (startBySeqno >=
                      static_cast<uint64_t>((*iitr)->getBySeqno()))) {
@@ -312,7 +318,7 @@ CursorRegResult CheckpointManager::registerCursorBySeqno_UNLOCKED(
 }
 
 bool CheckpointManager::removeCursor(const CheckpointCursor* cursor) {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     return removeCursor_UNLOCKED(cursor);
 }
 
@@ -366,7 +372,7 @@ size_t CheckpointManager::removeClosedUnrefCheckpoints(
     // returns).
     CheckpointList unrefCheckpointList;
     {
-        LockHolder lh(queueLock);
+        ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
         uint64_t oldCheckpointId = 0;
         bool canCreateNewCheckpoint = false;
         if (checkpointList.size() < checkpointConfig.getMaxCheckpoints() ||
@@ -452,7 +458,7 @@ CheckpointManager::ExpelResult
 CheckpointManager::expelUnreferencedCheckpointItems() {
     CheckpointQueue expelledItems;
     {
-        LockHolder lh(queueLock);
+        ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
 
         const auto containsCursors = [](std::unique_ptr<Checkpoint>& c) {
             if (c->getNumCursorsInCheckpoint() > 0) {
@@ -611,7 +617,7 @@ CheckpointManager::expelUnreferencedCheckpointItems() {
 }
 
 std::vector<Cursor> CheckpointManager::getListOfCursorsToDrop() {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
 
     Checkpoint* persistentCheckpoint =
             (persistenceCursor == nullptr)
@@ -655,7 +661,7 @@ std::vector<Cursor> CheckpointManager::getListOfCursorsToDrop() {
 }
 
 bool CheckpointManager::hasClosedCheckpointWhichCanBeRemoved() const {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     // Check oldest checkpoint; if closed and contains no cursors then
     // we can remove it (and possibly additional old-but-not-oldest
     // checkpoints).
@@ -673,13 +679,48 @@ void CheckpointManager::updateStatsForNewQueuedItem_UNLOCKED(
     }
 }
 
+void CheckpointManager::compressValue(Item& item) {
+    // Only compress documents - meta items, system events etc. are small and
+    // some of them have their value read directly by the flusher.
+    if (item.getNBytes() == 0 || !(item.isCommitted() || item.isPending()) ||
+        mcbp::datatype::is_snappy(item.getDataType())) {
+        return;
+    }
+    const auto before = item.getNBytes();
+    if (item.compressValue()) {
+        stats.checkpointCompressedBytesSaved += before - item.getNBytes();
+    }
+}
+
 bool CheckpointManager::queueDirty(
         VBucket& vb,
         queued_item& qi,
         const GenerateBySeqno generateBySeqno,
         const GenerateCas generateCas,
         PreLinkDocumentContext* preLinkDocumentContext) {
-    LockHolder lh(queueLock);
+    // Only front-end mutations have a cookie the spans can be traced into.
+    const void* cookie = preLinkDocumentContext
+                                 ? preLinkDocumentContext->getCookie()
+                                 : nullptr;
+    // The pre_link callback may rewrite the value in place (subdoc expands
+    // its ${Mutation.*} macros into the document's xattrs) once the CAS and
+    // seqno are known, which is under the queueLock. Such a value is only
+    // compressed after that, or the checkpoint (and so the flusher and DCP)
+    // would keep the unexpanded copy.
+    const bool compress = checkpointConfig.isCompressValuesEnabled();
+    const bool compressAfterPreLink =
+            compress && preLinkDocumentContext != nullptr &&
+            GenerateCas::Yes == generateCas &&
+            mcbp::datatype::is_xattr(qi->getDataType());
+    if (compress && !compressAfterPreLink) {
+        // Done before acquiring the queueLock to keep the cost of compression
+        // off the critical section.
+        TRACE_SCOPE(cookie, cb::tracing::TraceCode::COMPRESS);
+        compressValue(*qi);
+    }
+
+    TRACE_SCOPE(cookie, cb::tracing::TraceCode::QUEUE_DIRTY);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
 
     bool canCreateNewCheckpoint = false;
     if (checkpointList.size() < checkpointConfig.getMaxCheckpoints() ||
@@ -709,6 +750,10 @@ bool CheckpointManager::queueDirty(
             preLinkDocumentContext->preLink(cas, newLastBySeqno);
         }
     }
+    if (compressAfterPreLink) {
+        TRACE_SCOPE(cookie, cb::tracing::TraceCode::COMPRESS);
+        compressValue(*qi);
+    }
 
     QueueDirtyStatus result = openCkpt->queueDirty(qi, this);
 
@@ -787,7 +832,7 @@ bool CheckpointManager::queueDirty(
 
 void CheckpointManager::queueSetVBState(VBucket& vb) {
     // Take lock to serialize use of {lastBySeqno} and to queue op.
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
 
     // Create the setVBState operation, and enqueue it.
     queued_item item = createCheckpointItem(/*id*/0, vbucketId,
@@ -819,7 +864,13 @@ CheckpointManager::ItemsForCursor CheckpointManager::getItemsForCursor(
         CheckpointCursor* cursorPtr,
         std::vector<queued_item>& items,
         size_t approxLimit) {
-    LockHolder lh(queueLock);
+    TRACE_EVENT2("ep-engine/checkpoint",
+                 "getItemsForCursor",
+                 "vbid",
+                 vbucketId.get(),
+                 "limit",
+                 approxLimit);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     if (!cursorPtr) {
         EP_LOG_WARN("getAllItemsForCursor(): Caller had a null cursor {}",
                     vbucketId);
@@ -893,17 +944,17 @@ void CheckpointManager::notifyFlusher() {
 }
 
 void CheckpointManager::setBySeqno(int64_t seqno) {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     lastBySeqno = seqno;
 }
 
 int64_t CheckpointManager::getHighSeqno() const {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     return lastBySeqno;
 }
 
 int64_t CheckpointManager::nextBySeqno() {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     return ++lastBySeqno;
 }
 
@@ -912,7 +963,7 @@ void CheckpointManager::dump() const {
 }
 
 void CheckpointManager::clear(VBucket& vb, uint64_t seqno) {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     clear_UNLOCKED(vb.getState(), seqno);
 
     // Reset the disk write queue size stat for the vbucket
@@ -972,7 +1023,7 @@ bool CheckpointManager::moveCursorToNextCheckpoint(CheckpointCursor &cursor) {
 }
 
 size_t CheckpointManager::getNumOpenChkItems() const {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     return getOpenCheckpoint_UNLOCKED(lh).getNumItems();
 }
 
@@ -1003,7 +1054,7 @@ uint64_t CheckpointManager::checkOpenCheckpoint_UNLOCKED(const LockHolder& lh,
 
 size_t CheckpointManager::getNumItemsForCursor(
         const CheckpointCursor* cursor) const {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     return getNumItemsForCursor_UNLOCKED(cursor);
 }
 
@@ -1031,7 +1082,7 @@ size_t CheckpointManager::getNumItemsForCursor_UNLOCKED(
 }
 
 void CheckpointManager::clear(vbucket_state_t vbState) {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     clear_UNLOCKED(vbState, lastBySeqno);
 }
 
@@ -1047,7 +1098,7 @@ bool CheckpointManager::isLastMutationItemInCheckpoint(
 }
 
 void CheckpointManager::setBackfillPhase(uint64_t start, uint64_t end) {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     setOpenCheckpointId_UNLOCKED(lh, 0);
     auto& openCkpt = getOpenCheckpoint_UNLOCKED(lh);
     openCkpt.setSnapshotStartSeqno(start);
@@ -1056,7 +1107,7 @@ void CheckpointManager::setBackfillPhase(uint64_t start, uint64_t end) {
 
 void CheckpointManager::createSnapshot(uint64_t snapStartSeqno,
                                        uint64_t snapEndSeqno) {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
 
     auto& openCkpt = getOpenCheckpoint_UNLOCKED(lh);
     const auto openCkptId = openCkpt.getId();
@@ -1075,7 +1126,7 @@ void CheckpointManager::createSnapshot(uint64_t snapStartSeqno,
 }
 
 void CheckpointManager::resetSnapshotRange() {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
 
     auto& openCkpt = getOpenCheckpoint_UNLOCKED(lh);
 
@@ -1090,12 +1141,12 @@ void CheckpointManager::resetSnapshotRange() {
 }
 
 void CheckpointManager::updateCurrentSnapshotEnd(uint64_t snapEnd) {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     getOpenCheckpoint_UNLOCKED(lh).setSnapshotEndSeqno(snapEnd);
 }
 
 snapshot_info_t CheckpointManager::getSnapshotInfo() {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
 
     const auto& openCkpt = getOpenCheckpoint_UNLOCKED(lh);
 
@@ -1122,7 +1173,7 @@ snapshot_info_t CheckpointManager::getSnapshotInfo() {
 }
 
 void CheckpointManager::checkAndAddNewCheckpoint() {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     const auto& openCkpt = getOpenCheckpoint_UNLOCKED(lh);
     const auto openCkptId = openCkpt.getId();
 
@@ -1183,7 +1234,7 @@ queued_item CheckpointManager::createCheckpointItem(uint64_t id,
 }
 
 uint64_t CheckpointManager::createNewCheckpoint() {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
 
     const auto& openCkpt = getOpenCheckpoint_UNLOCKED(lh);
 
@@ -1196,12 +1247,12 @@ uint64_t CheckpointManager::createNewCheckpoint() {
 }
 
 uint64_t CheckpointManager::getPersistenceCursorPreChkId() {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     return pCursorPreCheckpointId;
 }
 
 void CheckpointManager::itemsPersisted() {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     auto itr = persistenceCursor->currentCheckpoint;
     pCursorPreCheckpointId = ((*itr)->getId() > 0) ? (*itr)->getId() - 1 : 0;
 }
@@ -1223,12 +1274,12 @@ size_t CheckpointManager::getMemoryOverhead_UNLOCKED() const {
 }
 
 size_t CheckpointManager::getMemoryUsage() const {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     return getMemoryUsage_UNLOCKED();
 }
 
 size_t CheckpointManager::getMemoryUsageOfUnrefCheckpoints() const {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
 
     size_t memUsage = 0;
     for (const auto& checkpoint : checkpointList) {
@@ -1242,13 +1293,13 @@ size_t CheckpointManager::getMemoryUsageOfUnrefCheckpoints() const {
 }
 
 size_t CheckpointManager::getMemoryOverhead() const {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     return getMemoryOverhead_UNLOCKED();
 }
 
 void CheckpointManager::addStats(const AddStatFn& add_stat,
                                  const void* cookie) {
-    LockHolder lh(queueLock);
+    ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
     char buf[256];
 
     try {
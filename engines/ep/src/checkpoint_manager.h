@@ -365,6 +365,12 @@ protected:
 
     void setOpenCheckpointId_UNLOCKED(const LockHolder& lh, uint64_t id);
 
+    /**
+     * Snappy-compress the value of a document about to be queued (if
+     * chk_compress_values is enabled), so it uses less checkpoint memory.
+     */
+    void compressValue(Item& item);
+
     // Helper method for queueing methods - update the global and per-VBucket
     // stats after queueing a new item to a checkpoint.
     // Must be called with queueLock held (LockHolder passed in as argument to
@@ -20,18 +20,23 @@
 #include "collections/manifest.h"
 #include "ep_engine.h"
 #include "kv_bucket.h"
+#include "objectregistry.h"
 #include "statwriter.h"
 #include "string_utils.h"
 #include "vb_visitors.h"
 #include "vbucket.h"
 
+#include <memcached/metrics.h>
 #include <spdlog/fmt/ostr.h>
 
+#include <unordered_map>
+
 Collections::Manager::Manager() {
 }
 
 cb::engine_error Collections::Manager::update(KVBucket& bucket,
                                               cb::const_char_buffer manifest) {
+    MemoryDomainGuard guard(MemoryDomain::Collections);
     std::unique_lock<std::mutex> ul(lock, std::try_to_lock);
     if (!ul.owns_lock()) {
         // Make concurrent updates fail, in reality there should only be one
@@ -174,6 +179,7 @@ cb::EngineErrorGetScopeIDResult Collections::Manager::getScopeID(
 }
 
 void Collections::Manager::update(VBucket& vb) const {
+    MemoryDomainGuard guard(MemoryDomain::Collections);
     // Lock manager updates
     std::lock_guard<std::mutex> ul(lock);
     if (current) {
@@ -253,6 +259,7 @@ public:
         success = vb->lockCollections().addCollectionStats(
                           vb->getId(), cookie, add_stat) ||
                   success;
+        addMemoryStats(*vb);
     }
 
     bool getSuccess() const {
@@ -260,6 +267,30 @@ public:
     }
 
 private:
+    // The memory used by each collection's items in the vBucket's
+    // HashTable (which the manifest, tracking what's on disk, doesn't know).
+    void addMemoryStats(VBucket& vb) {
+        try {
+            const int bsize = 512;
+            char buffer[bsize];
+            for (const auto& entry : vb.ht.getCollectionItemMemory()) {
+                checked_snprintf(buffer,
+                                 bsize,
+                                 "vb_%d:collection:%s:entry:memory",
+                                 vb.getId().get(),
+                                 entry.first.to_string().c_str());
+                add_casted_stat(buffer, entry.second, add_stat, cookie);
+            }
+        } catch (const std::exception& error) {
+            EP_LOG_WARN(
+                    "CollectionDetailedVBucketVisitor::addMemoryStats {}, "
+                    "failed to build stats, exception:{}",
+                    vb.getId(),
+                    error.what());
+            success = false;
+        }
+    }
+
     const void* cookie;
     AddStatFn add_stat;
     bool success = true;
@@ -355,6 +386,49 @@ ENGINE_ERROR_CODE Collections::Manager::doCollectionStats(
     return success ? ENGINE_SUCCESS : ENGINE_FAILED;
 }
 
+void Collections::Manager::doCollectionMetrics(
+        KVBucket& bucket, cb::metrics::Collector& collector) {
+    CollectionCountVBucketVisitor visitor;
+    bucket.visit(visitor);
+    bucket.getCollectionsManager().addCollectionMetrics(visitor.summary,
+                                                        collector);
+}
+
+void Collections::Manager::addCollectionMetrics(
+        const Summary& summary, cb::metrics::Collector& collector) const {
+    std::lock_guard<std::mutex> lg(lock);
+    std::unordered_map<CollectionID, const std::string*> scopes;
+    if (current) {
+        for (auto scope = current->beginScopes(); scope != current->endScopes();
+             ++scope) {
+            for (const auto& collection : scope->second.collections) {
+                scopes[collection.id] = &scope->second.name;
+            }
+        }
+    }
+
+    for (const auto& entry : summary) {
+        // A collection which isn't in the manifest (such as one being
+        // dropped) is labelled with its id.
+        std::string name = entry.first.to_string();
+        std::string scope;
+        if (current) {
+            auto collection = current->findCollection(entry.first);
+            if (collection != current->end()) {
+                name = collection->second;
+            }
+            auto iter = scopes.find(entry.first);
+            if (iter != scopes.end()) {
+                scope = *iter->second;
+            }
+        }
+        collector.addGauge("collection_items",
+                           "The number of documents in the collection",
+                           {{"scope", scope}, {"collection", name}},
+                           entry.second);
+    }
+}
+
 // scopes-details
 //   - return top level stats (manager/manifest)
 //   - iterate vbucket returning detailed VB stats
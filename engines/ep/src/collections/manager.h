@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include "collections/collections_types.h"
+
 #include <memcached/engine.h>
 #include <memcached/engine_error.h>
 #include <platform/sized_buffer.h>
@@ -27,6 +29,12 @@
 class KVBucket;
 class VBucket;
 
+namespace cb {
+namespace metrics {
+class Collector;
+}
+} // namespace cb
+
 namespace Collections {
 
 class Manifest;
@@ -128,7 +136,21 @@ public:
                                           const AddStatFn& add_stat,
                                           const std::string& statKey);
 
+    /**
+     * Add the number of items of each collection (in the active vBuckets)
+     * to the collector.
+     */
+    static void doCollectionMetrics(KVBucket& bucket,
+                                    cb::metrics::Collector& collector);
+
 private:
+    /**
+     * Add the item counts of the summary, labelled with the names of the
+     * collections and of their scopes in the current manifest.
+     */
+    void addCollectionMetrics(const Summary& summary,
+                              cb::metrics::Collector& collector) const;
+
     /**
      * Apply newManifest to all active vbuckets
      * @return uninitialized if success, else the vbid which triggered failure.
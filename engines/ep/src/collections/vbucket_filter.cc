@@ -241,6 +241,18 @@ bool Filter::remove(const Item& item) {
     }
 }
 
+boost::optional<std::vector<CollectionID>> Filter::getCollections() const {
+    if (passthrough || scopeID) {
+        return {};
+    }
+
+    std::vector<CollectionID> collections(filter.begin(), filter.end());
+    if (defaultAllowed) {
+        collections.push_back(CollectionID::Default);
+    }
+    return collections;
+}
+
 bool Filter::empty() const {
     if (scopeID) {
         return scopeIsDropped;
@@ -20,6 +20,7 @@
 #include "collections/collections_types.h"
 #include "item.h"
 
+#include <boost/optional/optional.hpp>
 #include <memcached/dcp_stream_id.h>
 #include <memcached/engine_common.h>
 #include <nlohmann/json_fwd.hpp>
@@ -28,6 +29,7 @@
 #include <memory>
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 class SystemEventMessage;
 
@@ -159,6 +161,13 @@ public:
         return systemEventsAllowed;
     }
 
+    /**
+     * @return the collections this filter allows, if it allows a fixed set
+     *         of them; nothing if it's a passthrough or a scope filter (whose
+     *         collections can be created as the stream runs).
+     */
+    boost::optional<std::vector<CollectionID>> getCollections() const;
+
     std::string getUid() const;
 
     cb::mcbp::DcpStreamId getStreamId() const {
@@ -871,8 +871,8 @@ boost::optional<std::vector<CollectionID>> Manifest::getCollectionsForScope(
 }
 
 bool Manifest::operator==(const Manifest& rhs) const {
-    std::lock_guard<cb::ReaderLock> readLock(rwlock.reader());
-    std::lock_guard<cb::ReaderLock> otherReadLock(rhs.rwlock.reader());
+    std::shared_lock<Mutex> readLock(rwlock);
+    std::shared_lock<Mutex> otherReadLock(rhs.rwlock);
 
     if (rhs.map.size() != map.size()) {
         return false;
@@ -21,11 +21,12 @@
 #include "collections/collections_types.h"
 #include "collections/manifest.h"
 #include "collections/vbucket_manifest_entry.h"
+#include "collections/vbucket_manifest_entry_map.h"
 #include "systemevent.h"
 
 #include <boost/optional/optional_fwd.hpp>
+#include <folly/SharedMutex.h>
 #include <platform/non_negative_counter.h>
-#include <platform/rwlock.h>
 #include <platform/sized_buffer.h>
 
 #include <functional>
@@ -33,6 +34,7 @@
 #include <list>
 #include <mutex>
 #include <set>
+#include <shared_mutex>
 #include <unordered_map>
 
 class VBucket;
@@ -53,9 +55,9 @@ namespace VB {
  * knows about.
  *
  * Each collection is represented by a Collections::VB::ManifestEntry and all of
- * the collections are stored in an unordered_map. The map is implemented to
- * allow look-up by collection-name without having to allocate a std::string,
- * callers only need a cb::const_char_buffer for look-ups.
+ * the collections are stored in a ManifestEntryMap, so that the look-up of a
+ * key's collection is (for all but very large collection IDs) an index into
+ * a table rather than a hash lookup.
  *
  * The Manifest allows for an external manager to drive the lifetime of each
  * collection.
@@ -78,7 +80,16 @@ namespace VB {
  */
 class Manifest {
 public:
-    using container = ::std::unordered_map<CollectionID, ManifestEntry>;
+    using container = ManifestEntryMap;
+
+    /**
+     * The manifest's lock is read locked by (almost) every front-end
+     * operation against the vBucket, so it must not make readers write to a
+     * shared cache line: folly's SharedMutex lets readers mark themselves
+     * in one of its (per-core striped) deferred reader slots instead of
+     * incrementing a reader count. Read priority, as readers may nest.
+     */
+    using Mutex = folly::SharedMutexReadPriority;
 
     /**
      * RAII read locking for access to the Manifest.
@@ -95,7 +106,7 @@ public:
          */
         ReadHandle() = default;
 
-        ReadHandle(const Manifest* m, cb::RWLock& lock)
+        ReadHandle(const Manifest* m, Mutex& lock)
             : readLock(lock), manifest(m) {
         }
 
@@ -257,7 +268,7 @@ public:
     protected:
         friend std::ostream& operator<<(std::ostream& os,
                                         const Manifest::ReadHandle& readHandle);
-        std::unique_lock<cb::ReaderLock> readLock;
+        std::shared_lock<Mutex> readLock;
         const Manifest* manifest;
     };
 
@@ -289,7 +300,7 @@ public:
          *        should not be allowed, whereas a disk backfill is allowed
          */
         CachingReadHandle(const Manifest* m,
-                          cb::RWLock& lock,
+                          Mutex& lock,
                           DocKey key,
                           bool allowSystem)
             : ReadHandle(m, lock),
@@ -466,7 +477,7 @@ public:
      */
     class StatsReadHandle : private ReadHandle {
     public:
-        StatsReadHandle(const Manifest* m, cb::RWLock& lock, CollectionID cid)
+        StatsReadHandle(const Manifest* m, Mutex& lock, CollectionID cid)
             : ReadHandle(m, lock), itr(m->getManifestIterator(cid)) {
         }
 
@@ -500,7 +511,7 @@ public:
      */
     class WriteHandle {
     public:
-        WriteHandle(Manifest& m, cb::RWLock& lock)
+        WriteHandle(Manifest& m, Mutex& lock)
             : writeLock(lock), manifest(m) {
         }
 
@@ -641,7 +652,7 @@ public:
         }
 
     private:
-        std::unique_lock<cb::WriterLock> writeLock;
+        std::unique_lock<Mutex> writeLock;
         Manifest& manifest;
     };
 
@@ -1253,7 +1264,7 @@ protected:
     /**
      * shared lock to allow concurrent readers and safe updates
      */
-    mutable cb::RWLock rwlock;
+    mutable Mutex rwlock;
 
     friend std::ostream& operator<<(std::ostream& os, const Manifest& manifest);
 
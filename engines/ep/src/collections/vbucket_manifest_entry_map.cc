@@ -0,0 +1,69 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "collections/vbucket_manifest_entry_map.h"
+
+const CollectionIDType Collections::VB::ManifestEntryMap::maxIndexedID;
+constexpr Collections::VB::ManifestEntryMap::Slot
+        Collections::VB::ManifestEntryMap::noSlot;
+
+std::pair<Collections::VB::ManifestEntryMap::iterator, bool>
+Collections::VB::ManifestEntryMap::emplace(CollectionID id,
+                                           const ManifestEntry& entry) {
+    const auto slot = getSlot(id);
+    if (slot != noSlot) {
+        return {entries.begin() + slot, false};
+    }
+
+    entries.emplace_back(id, entry);
+    setSlot(id, Slot(entries.size() - 1));
+    return {entries.end() - 1, true};
+}
+
+Collections::VB::ManifestEntryMap::iterator
+Collections::VB::ManifestEntryMap::erase(const_iterator pos) {
+    const auto slot = Slot(pos - entries.cbegin());
+    setSlot(pos->first, noSlot);
+
+    // Move the last entry into the erased slot, so the entries stay dense
+    if (slot != entries.size() - 1) {
+        entries[slot] = entries.back();
+        setSlot(entries[slot].first, slot);
+    }
+    entries.pop_back();
+    return entries.begin() + slot;
+}
+
+void Collections::VB::ManifestEntryMap::setSlot(CollectionID id, Slot slot) {
+    const CollectionIDType index = id;
+    if (index >= maxIndexedID) {
+        if (slot == noSlot) {
+            unindexedSlots.erase(id);
+        } else {
+            unindexedSlots[id] = slot;
+        }
+        return;
+    }
+
+    if (index >= slots.size()) {
+        if (slot == noSlot) {
+            return;
+        }
+        slots.resize(index + 1, noSlot);
+    }
+    slots[index] = slot;
+}
@@ -0,0 +1,141 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "collections/vbucket_manifest_entry.h"
+
+#include <memcached/dockey.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Collections {
+namespace VB {
+
+/**
+ * The map of CollectionID to ManifestEntry of a VB::Manifest, which every
+ * keyed operation looks its collection up in.
+ *
+ * The entries are kept contiguously in a vector; each collection is given a
+ * slot (its index in the vector) when it is added. The slot of a collection
+ * is found by indexing a table with the CollectionID - collection IDs are
+ * allocated sequentially by the cluster manager, so the table stays dense.
+ * Only IDs of maxIndexedID and over (which a bucket only reaches after many
+ * collections have been created) fall back to a hash lookup.
+ *
+ * Adding or erasing a collection invalidates iterators and references to
+ * the entries (erase moves the last entry into the erased slot), which the
+ * Manifest only does with its write lock held.
+ */
+class ManifestEntryMap {
+public:
+    using value_type = std::pair<CollectionID, ManifestEntry>;
+    using iterator = std::vector<value_type>::iterator;
+    using const_iterator = std::vector<value_type>::const_iterator;
+
+    /// IDs below this are found by directly indexing the slot table
+    static const CollectionIDType maxIndexedID = 1 << 16;
+
+    iterator find(CollectionID id) {
+        const auto slot = getSlot(id);
+        return slot == noSlot ? entries.end() : entries.begin() + slot;
+    }
+
+    const_iterator find(CollectionID id) const {
+        const auto slot = getSlot(id);
+        return slot == noSlot ? entries.end() : entries.begin() + slot;
+    }
+
+    size_t count(CollectionID id) const {
+        return getSlot(id) == noSlot ? 0 : 1;
+    }
+
+    /**
+     * Add the entry for id, if it has none.
+     *
+     * @return an iterator to id's entry, and true if it was added
+     */
+    std::pair<iterator, bool> emplace(CollectionID id,
+                                      const ManifestEntry& entry);
+
+    /**
+     * Erase the entry at pos.
+     *
+     * @return an iterator to the entry which now occupies pos' slot (the
+     *         last entry, moved into it), or end()
+     */
+    iterator erase(const_iterator pos);
+
+    size_t size() const {
+        return entries.size();
+    }
+
+    bool empty() const {
+        return entries.empty();
+    }
+
+    iterator begin() {
+        return entries.begin();
+    }
+
+    iterator end() {
+        return entries.end();
+    }
+
+    const_iterator begin() const {
+        return entries.begin();
+    }
+
+    const_iterator end() const {
+        return entries.end();
+    }
+
+private:
+    using Slot = uint32_t;
+    static constexpr Slot noSlot = std::numeric_limits<Slot>::max();
+
+    Slot getSlot(CollectionID id) const {
+        const CollectionIDType index = id;
+        if (index < slots.size()) {
+            return slots[index];
+        }
+        if (index < maxIndexedID || unindexedSlots.empty()) {
+            return noSlot;
+        }
+        const auto itr = unindexedSlots.find(id);
+        return itr == unindexedSlots.end() ? noSlot : itr->second;
+    }
+
+    void setSlot(CollectionID id, Slot slot);
+
+    std::vector<value_type> entries;
+
+    /// The slot of each collection with an ID below maxIndexedID, indexed by
+    /// ID (noSlot if there is no such collection).
+    std::vector<Slot> slots;
+
+    /// The slots of the collections with IDs of maxIndexedID and over
+    std::unordered_map<CollectionID, Slot> unindexedSlots;
+};
+
+} // end namespace VB
+} // end namespace Collections
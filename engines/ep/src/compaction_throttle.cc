@@ -0,0 +1,113 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "compaction_throttle.h"
+
+#include "stats.h"
+
+#include <algorithm>
+#include <thread>
+
+const std::chrono::milliseconds CompactionThrottle::latencyPause{100};
+const int CompactionThrottle::maxLatencyPauses = 10;
+
+CompactionThrottle::CompactionThrottle(
+        EPStats& stats, std::chrono::milliseconds latencySampleInterval)
+    : stats(stats),
+      sampleInterval(latencySampleInterval),
+      sampleStart(std::chrono::steady_clock::now()),
+      sampleOps(stats.bgNumOperations),
+      sampleTime(stats.bgWait + stats.bgLoad) {
+}
+
+void CompactionThrottle::throttle(size_t bytes) {
+    const size_t rate = maxBytesPerSec;
+    if (rate == 0 && bgFetchLatencyThreshold == 0) {
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    bool waited = false;
+
+    // Back off while front-end reads are suffering, but not indefinitely - a
+    // compaction which never progresses never frees any space either.
+    for (int ii = 0; ii < maxLatencyPauses && isBgFetchLatencyHigh(); ++ii) {
+        std::this_thread::sleep_for(latencyPause);
+        waited = true;
+    }
+
+    if (rate != 0) {
+        const auto slot = reserve(bytes, rate);
+        if (slot > std::chrono::steady_clock::now()) {
+            std::this_thread::sleep_until(slot);
+            waited = true;
+        }
+    }
+
+    if (waited) {
+        stats.compactionThrottledTime.fetch_add(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count());
+    }
+}
+
+void CompactionThrottle::charge(size_t bytes) {
+    const size_t rate = maxBytesPerSec;
+    if (rate != 0) {
+        reserve(bytes, rate);
+    }
+}
+
+std::chrono::steady_clock::time_point CompactionThrottle::reserve(size_t bytes,
+                                                                  size_t rate) {
+    std::lock_guard<std::mutex> lh(mutex);
+    // No credit is accumulated while compaction is idle; a slot in the past
+    // just means the IO can go now.
+    const auto slot = std::max(std::chrono::steady_clock::now(), nextFree);
+    nextFree = slot + std::chrono::duration_cast<
+                              std::chrono::steady_clock::duration>(
+                              std::chrono::duration<double>(double(bytes) /
+                                                            rate));
+    return slot;
+}
+
+bool CompactionThrottle::isBgFetchLatencyHigh() {
+    const uint64_t threshold = bgFetchLatencyThreshold;
+    if (threshold == 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lh(mutex);
+    const auto now = std::chrono::steady_clock::now();
+    if (now - sampleStart < sampleInterval) {
+        return latencyHigh;
+    }
+
+    const uint64_t ops = stats.bgNumOperations;
+    const uint64_t time = stats.bgWait + stats.bgLoad;
+    if (ops > sampleOps && time >= sampleTime) {
+        latencyHigh = (time - sampleTime) / (ops - sampleOps) > threshold;
+    } else {
+        // No BG fetches since the last sample (or the stats were reset).
+        latencyHigh = false;
+    }
+    sampleStart = now;
+    sampleOps = ops;
+    sampleTime = time;
+    return latencyHigh;
+}
@@ -0,0 +1,111 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+class EPStats;
+
+/**
+ * Paces the disk IO of a bucket's compactions so that they don't starve
+ * front-end reads (BG fetches) of disk bandwidth.
+ *
+ * Every read and write a compaction makes calls throttle() first, which:
+ *  - while the mean BG fetch latency is above a threshold, pauses the
+ *    compaction (for at most maxLatencyPauses * latencyPause per IO, so a
+ *    compaction always makes some progress);
+ *  - then delays the IO so that the bytes read and written by all of the
+ *    bucket's compactions together don't exceed a bytes/sec budget.
+ *
+ * Both limits are disabled when set to 0. Time spent waiting is added to
+ * EPStats::compactionThrottledTime.
+ */
+class CompactionThrottle {
+public:
+    /**
+     * @param stats stats to sample BG fetch latency from
+     * @param latencySampleInterval how often the BG fetch latency is
+     *        re-sampled
+     */
+    explicit CompactionThrottle(EPStats& stats,
+                                std::chrono::milliseconds latencySampleInterval =
+                                        std::chrono::seconds(1));
+
+    /// Set the compaction bandwidth budget; 0 means unlimited.
+    void setMaxBytesPerSec(size_t value) {
+        maxBytesPerSec = value;
+    }
+
+    /// Set the BG fetch latency above which compaction pauses; 0 disables.
+    void setBgFetchLatencyThreshold(std::chrono::microseconds value) {
+        bgFetchLatencyThreshold = value.count();
+    }
+
+    /**
+     * Called by a compaction before it reads or writes the given number of
+     * bytes; blocks until the IO may proceed.
+     */
+    void throttle(size_t bytes);
+
+    /**
+     * Account for the given number of bytes of compaction IO against the
+     * bytes/sec budget without waiting. For a compaction which must not block
+     * while holding a lock: a later throttle() (throttle(0) once the lock is
+     * released) waits out the debt.
+     */
+    void charge(size_t bytes);
+
+    /**
+     * @return true if the mean latency (wait + load) of the BG fetches
+     *         completed in the last sample interval exceeded the threshold.
+     */
+    bool isBgFetchLatencyHigh();
+
+    /// How long compaction sleeps between re-checks of the BG fetch latency.
+    static const std::chrono::milliseconds latencyPause;
+    /// Maximum number of latencyPause sleeps before a single IO.
+    static const int maxLatencyPauses;
+
+private:
+    /**
+     * Take the next slot of the bytes/sec budget for the given number of
+     * bytes.
+     * @return when the IO may be issued
+     */
+    std::chrono::steady_clock::time_point reserve(size_t bytes, size_t rate);
+
+    EPStats& stats;
+    const std::chrono::steady_clock::duration sampleInterval;
+
+    std::atomic<size_t> maxBytesPerSec{0};
+    /// In microseconds.
+    std::atomic<uint64_t> bgFetchLatencyThreshold{0};
+
+    std::mutex mutex;
+    /// Earliest time the next compaction IO may be issued (guarded by mutex).
+    std::chrono::steady_clock::time_point nextFree;
+    /// When the BG fetch stats were last sampled, and their values then
+    /// (guarded by mutex).
+    std::chrono::steady_clock::time_point sampleStart;
+    uint64_t sampleOps;
+    uint64_t sampleTime;
+    bool latencyHigh = false;
+};
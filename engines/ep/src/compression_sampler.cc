@@ -0,0 +1,97 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "compression_sampler.h"
+
+#include <algorithm>
+
+// The failure and skip counts are 16 bits wide.
+static const size_t maxCount = 0xffff;
+
+CompressionSampler::CompressionSampler(size_t skipThreshold,
+                                       size_t sampleInterval) {
+    setSkipThreshold(skipThreshold);
+    setSampleInterval(sampleInterval);
+    reset();
+}
+
+bool CompressionSampler::shouldAttempt(CollectionID cid) {
+    const auto threshold = skipThreshold.load(std::memory_order_relaxed);
+    if (threshold == 0) {
+        return true;
+    }
+
+    auto& slot = getSlot(cid);
+    auto current = slot.load(std::memory_order_relaxed);
+    uint64_t desired;
+    bool attempt;
+    do {
+        if (getCid(current) != uint32_t(cid) ||
+            getFailures(current) < threshold) {
+            return true;
+        }
+        // Incompressible so far; only let every Nth value through to notice
+        // if the collection's data changes.
+        auto skips = getSkips(current) + 1;
+        attempt = skips >= sampleInterval.load(std::memory_order_relaxed);
+        if (attempt) {
+            skips = 0;
+        }
+        desired = makeSlot(uint32_t(cid), getFailures(current), skips);
+    } while (!slot.compare_exchange_weak(
+            current, desired, std::memory_order_relaxed));
+    return attempt;
+}
+
+void CompressionSampler::record(CollectionID cid, bool compressed) {
+    if (skipThreshold.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+
+    auto& slot = getSlot(cid);
+    auto current = slot.load(std::memory_order_relaxed);
+    uint64_t desired;
+    do {
+        uint32_t failures = 0;
+        uint32_t skips = 0;
+        if (getCid(current) == uint32_t(cid)) {
+            failures = getFailures(current);
+            skips = getSkips(current);
+        }
+        if (compressed) {
+            failures = 0;
+        } else if (failures < maxCount) {
+            ++failures;
+        }
+        desired = makeSlot(uint32_t(cid), failures, skips);
+    } while (!slot.compare_exchange_weak(
+            current, desired, std::memory_order_relaxed));
+}
+
+void CompressionSampler::setSkipThreshold(size_t value) {
+    skipThreshold.store(std::min(value, maxCount));
+}
+
+void CompressionSampler::setSampleInterval(size_t value) {
+    sampleInterval.store(std::min(std::max(value, size_t(1)), maxCount));
+}
+
+void CompressionSampler::reset() {
+    for (auto& slot : slots) {
+        slot.store(0, std::memory_order_relaxed);
+    }
+}
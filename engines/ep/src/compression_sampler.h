@@ -0,0 +1,112 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <memcached/dockey.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Tracks, per collection, whether recent attempts to compress values
+ * succeeded, so that callers can stop spending CPU compressing values of
+ * collections which hold incompressible data (images, encrypted or already
+ * compressed blobs).
+ *
+ * Once `skipThreshold` consecutive values of a collection failed to compress
+ * well enough, shouldAttempt() only returns true for one in every
+ * `sampleInterval` of its values; the rest are skipped. A single successful
+ * sample makes every value of the collection eligible again.
+ *
+ * The state is kept in a small direct-mapped table indexed by collection ID.
+ * Each slot remembers the ID it describes, so a collection which maps to a
+ * slot already used by another one simply takes it over (starting from a
+ * clean state) - collections sharing a slot can only cause extra attempts,
+ * never extra skips.
+ *
+ * Thread safe; slots are updated with single atomic operations.
+ */
+class CompressionSampler {
+public:
+    /// Number of slots in the table.
+    static const size_t NumSlots = 256;
+
+    /**
+     * @param skipThreshold number of consecutive failures after which a
+     *        collection's values are only sampled (0 to disable skipping)
+     * @param sampleInterval attempt one in every sampleInterval values of a
+     *        collection once it is considered incompressible
+     */
+    CompressionSampler(size_t skipThreshold, size_t sampleInterval);
+
+    /**
+     * @return true if a value of the given collection should be compressed,
+     *         false if the attempt should be skipped.
+     */
+    bool shouldAttempt(CollectionID cid);
+
+    /**
+     * Record the outcome of an attempt to compress a value of the given
+     * collection.
+     *
+     * @param compressed true if the value compressed well enough to be kept
+     *        compressed
+     */
+    void record(CollectionID cid, bool compressed);
+
+    void setSkipThreshold(size_t value);
+
+    void setSampleInterval(size_t value);
+
+    /// Forget what has been learnt about every collection.
+    void reset();
+
+private:
+    /*
+     * Slot layout: the collection ID in the upper 32 bits, the number of
+     * consecutive failures in bits 16-31, and the number of values skipped
+     * since the last sample in bits 0-15. 0 is an unused slot - it describes
+     * the default collection which hasn't failed, which is the same thing.
+     */
+    static uint64_t makeSlot(uint32_t cid, uint32_t failures, uint32_t skips) {
+        return (uint64_t(cid) << 32) | (uint64_t(failures) << 16) | skips;
+    }
+
+    static uint32_t getCid(uint64_t slot) {
+        return uint32_t(slot >> 32);
+    }
+
+    static uint32_t getFailures(uint64_t slot) {
+        return uint32_t(slot >> 16) & 0xffff;
+    }
+
+    static uint32_t getSkips(uint64_t slot) {
+        return uint32_t(slot) & 0xffff;
+    }
+
+    std::atomic<uint64_t>& getSlot(CollectionID cid) {
+        return slots[uint32_t(cid) % NumSlots];
+    }
+
+    std::atomic<size_t> skipThreshold;
+    std::atomic<size_t> sampleInterval;
+
+    std::array<std::atomic<uint64_t>, NumSlots> slots;
+};
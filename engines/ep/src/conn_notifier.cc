@@ -16,7 +16,9 @@
  */
 
 #include "conn_notifier.h"
+#include "configuration.h"
 #include "connmap.h"
+#include "ep_engine.h"
 #include "executorpool.h"
 #include "globaltask.h"
 
@@ -87,6 +89,22 @@ void ConnNotifier::notifyMutationEvent(void) {
 }
 
 bool ConnNotifier::notifyConnections() {
+    if (!lingered && pendingNotification.load()) {
+        // Wait a little before notifying, so that the connections (which
+        // stay paused meanwhile) have more items ready when they run; and
+        // any other connection which becomes ready in that time is notified
+        // by the same run.
+        const auto linger = connMap.getEngine()
+                                    .getConfiguration()
+                                    .getDcpConnNotifierLingerTime();
+        if (linger > 0) {
+            lingered = true;
+            ExecutorPool::get()->snooze(task, linger / 1e6);
+            return true;
+        }
+    }
+    lingered = false;
+
     bool inverse = true;
     pendingNotification.compare_exchange_strong(inverse, false);
     connMap.processPendingNotifications();
@@ -41,4 +41,11 @@ private:
     ConnMap& connMap;
     std::atomic<size_t> task;
     std::atomic<bool> pendingNotification;
+
+    /**
+     * True if the task has snoozed for dcp_conn_notifier_linger_time after
+     * being woken, and should notify the pending connections on its next
+     * run. Only accessed by the task.
+     */
+    bool lingered = false;
 };
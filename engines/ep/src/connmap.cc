@@ -20,6 +20,7 @@
 #include <queue>
 #include <set>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #include <daemon/tracing.h>
@@ -33,8 +34,6 @@
 #include "dcp/producer.h"
 #include "executorpool.h"
 
-size_t ConnMap::vbConnLockNum = 32;
-
 /**
  * A task to manage connections.
  */
@@ -83,15 +82,9 @@ private:
 };
 
 ConnMap::ConnMap(EventuallyPersistentEngine &theEngine)
-    :  vbConnLocks(vbConnLockNum),
+    :  vbConns(theEngine.getConfiguration().getMaxVbuckets()),
        engine(theEngine),
        connNotifier_(nullptr) {
-
-    Configuration &config = engine.getConfiguration();
-    size_t max_vbs = config.getMaxVbuckets();
-    for (size_t i = 0; i < max_vbs; ++i) {
-        vbConns.push_back(std::list<std::weak_ptr<ConnHandler>>());
-    }
 }
 
 void ConnMap::initialize() {
@@ -149,9 +142,13 @@ void ConnMap::processPendingNotifications() {
                           "ConnMap::processPendingNotifications::releaseLock",
                           SlowMutexThreshold);
 
+    // A connection may have been queued more than once since the last run;
+    // only notify it once.
+    std::unordered_set<const void*> notified;
     while (!queue.empty()) {
         auto conn = queue.front().lock();
-        if (conn && conn->isPaused() && conn->isReserved()) {
+        if (conn && conn->isPaused() && conn->isReserved() &&
+            notified.insert(conn->getCookie()).second) {
             engine.notifyIOComplete(conn->getCookie(), ENGINE_SUCCESS);
         }
         queue.pop();
@@ -163,13 +160,13 @@ void ConnMap::addVBConnByVBId(std::shared_ptr<ConnHandler> conn, Vbid vbid) {
         return;
     }
 
-    size_t lock_num = vbid.get() % vbConnLockNum;
-    std::lock_guard<std::mutex> lh(vbConnLocks[lock_num]);
-    vbConns[vbid.get()].emplace_back(std::move(conn));
+    auto& vb_conns = *vbConns[vbid.get()];
+    std::lock_guard<std::mutex> lh(vb_conns.mutex);
+    vb_conns.conns.emplace_back(std::move(conn));
 }
 
 void ConnMap::removeVBConnByVBId_UNLOCKED(const void* connCookie, Vbid vbid) {
-    std::list<std::weak_ptr<ConnHandler>>& vb_conns = vbConns[vbid.get()];
+    auto& vb_conns = vbConns[vbid.get()]->conns;
     for (auto itr = vb_conns.begin(); itr != vb_conns.end(); ++itr) {
         auto connection = (*itr).lock();
         // Erase if we cannot lock, or if the cookie matches
@@ -182,7 +179,20 @@ void ConnMap::removeVBConnByVBId_UNLOCKED(const void* connCookie, Vbid vbid) {
 }
 
 void ConnMap::removeVBConnByVBId(const void* connCookie, Vbid vbid) {
-    size_t lock_num = vbid.get() % vbConnLockNum;
-    std::lock_guard<std::mutex> lh(vbConnLocks[lock_num]);
+    std::lock_guard<std::mutex> lh(vbConns[vbid.get()]->mutex);
     removeVBConnByVBId_UNLOCKED(connCookie, vbid);
 }
+
+std::vector<std::shared_ptr<ConnHandler>> ConnMap::getVBConnections(
+        Vbid vbid) {
+    std::vector<std::shared_ptr<ConnHandler>> rv;
+    auto& vb_conns = *vbConns[vbid.get()];
+    std::lock_guard<std::mutex> lh(vb_conns.mutex);
+    for (const auto& weakPtr : vb_conns.conns) {
+        auto connection = weakPtr.lock();
+        if (connection) {
+            rv.push_back(std::move(connection));
+        }
+    }
+    return rv;
+}
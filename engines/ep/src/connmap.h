@@ -21,6 +21,8 @@
 #include "atomicqueue.h"
 #include "dcp/dcp-types.h"
 
+#include <folly/CachelinePadded.h>
+
 #include <climits>
 #include <iterator>
 #include <list>
@@ -96,7 +98,7 @@ public:
     /**
      * Notifies the front-end for all the connections in the
      * pendingNotifications queue that they should now be re-considered for
-     * work.
+     * work. Each connection is notified at most once per call.
      */
     void processPendingNotifications();
 
@@ -121,14 +123,29 @@ protected:
             std::unordered_map<const void*, std::shared_ptr<ConnHandler>>;
     CookieToConnectionMap map_;
 
-    std::vector<std::mutex> vbConnLocks;
-    std::vector<std::list<std::weak_ptr<ConnHandler>>> vbConns;
+    /**
+     * The connections with a stream for a single vBucket. Each vBucket has
+     * its own mutex (on its own cache line), so adding and removing the
+     * streams of one vBucket and notifying its connections never waits for
+     * the streams of another vBucket.
+     */
+    struct VBConnections {
+        std::mutex mutex;
+        std::list<std::weak_ptr<ConnHandler>> conns;
+    };
+
+    /**
+     * Get the (remaining) connections with a stream for the given vBucket.
+     * They're copied out so that the caller can call into them without
+     * holding the vBucket's mutex.
+     */
+    std::vector<std::shared_ptr<ConnHandler>> getVBConnections(Vbid vbid);
+
+    std::vector<folly::CachelinePadded<VBConnections>> vbConns;
 
     /* Handle to the engine who owns us */
     EventuallyPersistentEngine &engine;
 
     AtomicQueue<std::weak_ptr<ConnHandler>> pendingNotifications;
     std::shared_ptr<ConnNotifier> connNotifier_;
-
-    static size_t vbConnLockNum;
 };
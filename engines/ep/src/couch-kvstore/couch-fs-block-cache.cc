@@ -0,0 +1,204 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couch-kvstore/couch-fs-block-cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+CouchBlockCache::CouchBlockCache(size_t capacity)
+    : capacityBlocks(capacity / BlockSize) {
+}
+
+uint64_t CouchBlockCache::getFileId(const std::string& path) {
+    std::lock_guard<std::mutex> lh(mutex);
+    auto it = files.find(path);
+    if (it == files.end()) {
+        it = files.emplace(path, nextFileId++).first;
+    }
+    return it->second;
+}
+
+void CouchBlockCache::forgetFile(const std::string& path) {
+    std::lock_guard<std::mutex> lh(mutex);
+    files.erase(path);
+}
+
+bool CouchBlockCache::lookup(uint64_t fileId, uint64_t block, uint8_t* dst) {
+    std::lock_guard<std::mutex> lh(mutex);
+    auto it = index.find({fileId, block});
+    if (it == index.end()) {
+        return false;
+    }
+    lru.splice(lru.begin(), lru, it->second);
+    std::memcpy(dst, it->second->data.get(), BlockSize);
+    return true;
+}
+
+void CouchBlockCache::insert(uint64_t fileId,
+                             uint64_t block,
+                             const uint8_t* src) {
+    if (!isEnabled()) {
+        return;
+    }
+
+    const Key key{fileId, block};
+    std::lock_guard<std::mutex> lh(mutex);
+    auto it = index.find(key);
+    if (it != index.end()) {
+        // Another reader got there first; the contents are the same.
+        lru.splice(lru.begin(), lru, it->second);
+        return;
+    }
+
+    if (lru.size() >= capacityBlocks) {
+        // Reuse the least recently used block's buffer.
+        index.erase(lru.back().key);
+        lru.splice(lru.begin(), lru, std::prev(lru.end()));
+        lru.front().key = key;
+    } else {
+        lru.push_front({key, std::make_unique<uint8_t[]>(BlockSize)});
+    }
+    std::memcpy(lru.front().data.get(), src, BlockSize);
+    index[key] = lru.begin();
+}
+
+size_t CouchBlockCache::getMemoryUsage() const {
+    std::lock_guard<std::mutex> lh(mutex);
+    return lru.size() * BlockSize;
+}
+
+couch_file_handle BlockCacheOps::constructor(couchstore_error_info_t* errinfo) {
+    auto* bf = new BlockCacheFile(wrapped_ops.constructor(errinfo));
+    return reinterpret_cast<couch_file_handle>(bf);
+}
+
+couchstore_error_t BlockCacheOps::open(couchstore_error_info_t* errinfo,
+                                       couch_file_handle* h,
+                                       const char* path,
+                                       int flags) {
+    auto* bf = reinterpret_cast<BlockCacheFile*>(*h);
+    bf->fileId = cache.getFileId(path);
+    return wrapped_ops.open(errinfo, &bf->orig_handle, path, flags);
+}
+
+couchstore_error_t BlockCacheOps::close(couchstore_error_info_t* errinfo,
+                                        couch_file_handle h) {
+    auto* bf = reinterpret_cast<BlockCacheFile*>(h);
+    return wrapped_ops.close(errinfo, bf->orig_handle);
+}
+
+couchstore_error_t BlockCacheOps::set_periodic_sync(couch_file_handle h,
+                                                    uint64_t period_bytes) {
+    auto* bf = reinterpret_cast<BlockCacheFile*>(h);
+    return wrapped_ops.set_periodic_sync(bf->orig_handle, period_bytes);
+}
+
+ssize_t BlockCacheOps::pread(couchstore_error_info_t* errinfo,
+                             couch_file_handle h,
+                             void* buf,
+                             size_t sz,
+                             cs_off_t off) {
+    auto* bf = reinterpret_cast<BlockCacheFile*>(h);
+    if (sz == 0 || sz > MaxCachedReadSize || !cache.isEnabled()) {
+        return wrapped_ops.pread(errinfo, bf->orig_handle, buf, sz, off);
+    }
+
+    const size_t blockSize = CouchBlockCache::BlockSize;
+    const uint64_t first = off / blockSize;
+    const uint64_t last = (off + sz - 1) / blockSize;
+    const size_t numBlocks = last - first + 1;
+    const size_t skip = off - first * blockSize;
+    std::vector<uint8_t> blocks(numBlocks * blockSize);
+
+    bool allCached = true;
+    for (size_t ii = 0; ii < numBlocks && allCached; ++ii) {
+        allCached = cache.lookup(
+                bf->fileId, first + ii, blocks.data() + ii * blockSize);
+    }
+    if (allCached) {
+        ++hits;
+        std::memcpy(buf, blocks.data() + skip, sz);
+        return sz;
+    }
+
+    ++misses;
+    const ssize_t got = wrapped_ops.pread(errinfo,
+                                          bf->orig_handle,
+                                          blocks.data(),
+                                          blocks.size(),
+                                          first * blockSize);
+    if (got < 0) {
+        return got;
+    }
+
+    // Only complete blocks are cached; the last block of the file may still
+    // be appended to.
+    const size_t complete = size_t(got) / blockSize;
+    for (size_t ii = 0; ii < complete; ++ii) {
+        cache.insert(bf->fileId, first + ii, blocks.data() + ii * blockSize);
+    }
+
+    if (size_t(got) <= skip) {
+        return 0;
+    }
+    const size_t n = std::min(sz, size_t(got) - skip);
+    std::memcpy(buf, blocks.data() + skip, n);
+    return n;
+}
+
+ssize_t BlockCacheOps::pwrite(couchstore_error_info_t* errinfo,
+                              couch_file_handle h,
+                              const void* buf,
+                              size_t sz,
+                              cs_off_t off) {
+    auto* bf = reinterpret_cast<BlockCacheFile*>(h);
+    return wrapped_ops.pwrite(errinfo, bf->orig_handle, buf, sz, off);
+}
+
+cs_off_t BlockCacheOps::goto_eof(couchstore_error_info_t* errinfo,
+                                 couch_file_handle h) {
+    auto* bf = reinterpret_cast<BlockCacheFile*>(h);
+    return wrapped_ops.goto_eof(errinfo, bf->orig_handle);
+}
+
+couchstore_error_t BlockCacheOps::sync(couchstore_error_info_t* errinfo,
+                                       couch_file_handle h) {
+    auto* bf = reinterpret_cast<BlockCacheFile*>(h);
+    return wrapped_ops.sync(errinfo, bf->orig_handle);
+}
+
+couchstore_error_t BlockCacheOps::advise(couchstore_error_info_t* errinfo,
+                                         couch_file_handle h,
+                                         cs_off_t offs,
+                                         cs_off_t len,
+                                         couchstore_file_advice_t adv) {
+    auto* bf = reinterpret_cast<BlockCacheFile*>(h);
+    return wrapped_ops.advise(errinfo, bf->orig_handle, offs, len, adv);
+}
+
+FileOpsInterface::FHStats* BlockCacheOps::get_stats(couch_file_handle h) {
+    auto* bf = reinterpret_cast<BlockCacheFile*>(h);
+    return wrapped_ops.get_stats(bf->orig_handle);
+}
+
+void BlockCacheOps::destructor(couch_file_handle h) {
+    auto* bf = reinterpret_cast<BlockCacheFile*>(h);
+    wrapped_ops.destructor(bf->orig_handle);
+    delete bf;
+}
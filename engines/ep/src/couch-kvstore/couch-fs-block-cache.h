@@ -0,0 +1,192 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <libcouchstore/couch_db.h>
+#include <relaxed_atomic.h>
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * A bounded LRU cache of fixed size blocks of couchstore files, shared by
+ * the BlockCacheOps of a shard's read-write and read-only stores.
+ *
+ * Couchstore files are append-only: once a byte has been written at an
+ * offset it never changes for the life of the file, so a complete block
+ * which has been read once can be served from memory until the file is
+ * deleted. Files are identified by path; forgetFile() must be called when a
+ * file is removed, so a later file of the same name doesn't see its blocks.
+ * Blocks of forgotten files are no longer reachable and age out of the LRU.
+ *
+ * Thread safe.
+ */
+class CouchBlockCache {
+public:
+    /// Size of a cached block; also couchstore's default read buffer size.
+    static const size_t BlockSize = 4096;
+
+    /// @param capacity maximum number of bytes of blocks to keep
+    explicit CouchBlockCache(size_t capacity);
+
+    /// @return false if the cache can't hold a single block.
+    bool isEnabled() const {
+        return capacityBlocks != 0;
+    }
+
+    /// @return the identifier to cache the blocks of the given file under.
+    uint64_t getFileId(const std::string& path);
+
+    /// The given file has been removed; forget its blocks.
+    void forgetFile(const std::string& path);
+
+    /**
+     * Copy the given block into dst (BlockSize bytes) if it is cached.
+     *
+     * @return true on a hit.
+     */
+    bool lookup(uint64_t fileId, uint64_t block, uint8_t* dst);
+
+    /// Add the given (complete) block, evicting the least recently used one
+    /// if the cache is full.
+    void insert(uint64_t fileId, uint64_t block, const uint8_t* src);
+
+    /// @return the number of bytes of blocks cached.
+    size_t getMemoryUsage() const;
+
+private:
+    struct Key {
+        bool operator==(const Key& other) const {
+            return fileId == other.fileId && block == other.block;
+        }
+
+        uint64_t fileId;
+        uint64_t block;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return std::hash<uint64_t>()(key.fileId * 0x9e3779b97f4a7c15ull ^
+                                         key.block);
+        }
+    };
+
+    struct Block {
+        Key key;
+        std::unique_ptr<uint8_t[]> data;
+    };
+
+    using BlockList = std::list<Block>;
+
+    const size_t capacityBlocks;
+
+    mutable std::mutex mutex;
+    /// Cached blocks, most recently used first.
+    BlockList lru;
+    /// Block key to its entry in lru.
+    std::unordered_map<Key, BlockList::iterator, KeyHash> index;
+    /// Path of each file seen to its identifier.
+    std::unordered_map<std::string, uint64_t> files;
+    uint64_t nextFileId = 1;
+};
+
+/**
+ * FileOpsInterface implementation which serves reads from a CouchBlockCache,
+ * for use by reads of documents (get / BG fetch).
+ *
+ * Each read is widened to the blocks it covers. If all of them are cached
+ * the read is served from memory; otherwise the blocks are read from the
+ * wrapped FileOps in one go and the complete ones added to the cache. Reads
+ * of more than MaxCachedReadSize bytes (large documents) bypass the cache,
+ * as do all reads if the cache is disabled.
+ *
+ * Couchstore can't tell us what a read is for, so documents and leaf nodes
+ * are cached as well as interior btree nodes - but the latter are read by
+ * every lookup of the vBucket, so it's them which stay resident in the LRU.
+ */
+class BlockCacheOps : public FileOpsInterface {
+public:
+    /// Reads larger than this go straight to the wrapped FileOps.
+    static const size_t MaxCachedReadSize = 16 * CouchBlockCache::BlockSize;
+
+    BlockCacheOps(FileOpsInterface& ops, CouchBlockCache& cache)
+        : wrapped_ops(ops), cache(cache), hits(0), misses(0) {
+    }
+
+    couch_file_handle constructor(couchstore_error_info_t* errinfo) override;
+    couchstore_error_t open(couchstore_error_info_t* errinfo,
+                            couch_file_handle* handle,
+                            const char* path,
+                            int oflag) override;
+    couchstore_error_t close(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle) override;
+    couchstore_error_t set_periodic_sync(couch_file_handle handle,
+                                         uint64_t period_bytes) override;
+    ssize_t pread(couchstore_error_info_t* errinfo,
+                  couch_file_handle handle,
+                  void* buf,
+                  size_t nbytes,
+                  cs_off_t offset) override;
+    ssize_t pwrite(couchstore_error_info_t* errinfo,
+                   couch_file_handle handle,
+                   const void* buf,
+                   size_t nbytes,
+                   cs_off_t offset) override;
+    cs_off_t goto_eof(couchstore_error_info_t* errinfo,
+                      couch_file_handle handle) override;
+    couchstore_error_t sync(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle) override;
+    couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle,
+                              cs_off_t offset,
+                              cs_off_t len,
+                              couchstore_file_advice_t advice) override;
+    FHStats* get_stats(couch_file_handle handle) override;
+    void destructor(couch_file_handle handle) override;
+
+    /// @return the number of reads served from the cache.
+    size_t getHits() const {
+        return hits;
+    }
+
+    /// @return the number of reads which had to read from the file.
+    size_t getMisses() const {
+        return misses;
+    }
+
+protected:
+    struct BlockCacheFile {
+        explicit BlockCacheFile(couch_file_handle orig_handle)
+            : orig_handle(orig_handle) {
+        }
+
+        couch_file_handle orig_handle;
+        /// Identifier of the open file in the cache.
+        uint64_t fileId = 0;
+    };
+
+    FileOpsInterface& wrapped_ops;
+    CouchBlockCache& cache;
+
+    cb::RelaxedAtomic<size_t> hits;
+    cb::RelaxedAtomic<size_t> misses;
+};
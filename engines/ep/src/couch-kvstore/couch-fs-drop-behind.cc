@@ -0,0 +1,164 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couch-kvstore/couch-fs-drop-behind.h"
+
+#include <algorithm>
+
+couch_file_handle DropBehindOps::constructor(couchstore_error_info_t* errinfo) {
+    auto* df = new DropBehindFile(wrapped_ops.constructor(errinfo));
+    return reinterpret_cast<couch_file_handle>(df);
+}
+
+couchstore_error_t DropBehindOps::open(couchstore_error_info_t* errinfo,
+                                       couch_file_handle* h,
+                                       const char* path,
+                                       int flags) {
+    auto* df = reinterpret_cast<DropBehindFile*>(*h);
+    df->read.clear();
+    df->readBytes = 0;
+    df->written = {};
+    return wrapped_ops.open(errinfo, &df->orig_handle, path, flags);
+}
+
+couchstore_error_t DropBehindOps::close(couchstore_error_info_t* errinfo,
+                                        couch_file_handle h) {
+    auto* df = reinterpret_cast<DropBehindFile*>(h);
+    if (dropBehindSize != 0) {
+        dropRead(*df);
+        dropWritten(*df);
+    }
+    return wrapped_ops.close(errinfo, df->orig_handle);
+}
+
+couchstore_error_t DropBehindOps::set_periodic_sync(couch_file_handle h,
+                                                    uint64_t period_bytes) {
+    auto* df = reinterpret_cast<DropBehindFile*>(h);
+    return wrapped_ops.set_periodic_sync(df->orig_handle, period_bytes);
+}
+
+ssize_t DropBehindOps::pread(couchstore_error_info_t* errinfo,
+                             couch_file_handle h,
+                             void* buf,
+                             size_t sz,
+                             cs_off_t off) {
+    auto* df = reinterpret_cast<DropBehindFile*>(h);
+    const ssize_t got =
+            wrapped_ops.pread(errinfo, df->orig_handle, buf, sz, off);
+    if (dropBehindSize != 0 && got > 0) {
+        recordRead(*df, off, got);
+    }
+    return got;
+}
+
+ssize_t DropBehindOps::pwrite(couchstore_error_info_t* errinfo,
+                              couch_file_handle h,
+                              const void* buf,
+                              size_t sz,
+                              cs_off_t off) {
+    auto* df = reinterpret_cast<DropBehindFile*>(h);
+    const ssize_t written =
+            wrapped_ops.pwrite(errinfo, df->orig_handle, buf, sz, off);
+    if (dropBehindSize != 0 && written > 0) {
+        auto& range = df->written;
+        if (range.start == range.end) {
+            range = {off, off + written};
+        } else {
+            range.start = std::min(range.start, off);
+            range.end = std::max(range.end, off + written);
+        }
+    }
+    return written;
+}
+
+cs_off_t DropBehindOps::goto_eof(couchstore_error_info_t* errinfo,
+                                 couch_file_handle h) {
+    auto* df = reinterpret_cast<DropBehindFile*>(h);
+    return wrapped_ops.goto_eof(errinfo, df->orig_handle);
+}
+
+couchstore_error_t DropBehindOps::sync(couchstore_error_info_t* errinfo,
+                                       couch_file_handle h) {
+    auto* df = reinterpret_cast<DropBehindFile*>(h);
+    const auto err = wrapped_ops.sync(errinfo, df->orig_handle);
+    if (dropBehindSize != 0 && err == COUCHSTORE_SUCCESS) {
+        dropWritten(*df);
+    }
+    return err;
+}
+
+couchstore_error_t DropBehindOps::advise(couchstore_error_info_t* errinfo,
+                                         couch_file_handle h,
+                                         cs_off_t offs,
+                                         cs_off_t len,
+                                         couchstore_file_advice_t adv) {
+    auto* df = reinterpret_cast<DropBehindFile*>(h);
+    return wrapped_ops.advise(errinfo, df->orig_handle, offs, len, adv);
+}
+
+FileOpsInterface::FHStats* DropBehindOps::get_stats(couch_file_handle h) {
+    auto* df = reinterpret_cast<DropBehindFile*>(h);
+    return wrapped_ops.get_stats(df->orig_handle);
+}
+
+void DropBehindOps::destructor(couch_file_handle h) {
+    auto* df = reinterpret_cast<DropBehindFile*>(h);
+    wrapped_ops.destructor(df->orig_handle);
+    delete df;
+}
+
+void DropBehindOps::recordRead(DropBehindFile& df,
+                               cs_off_t offset,
+                               size_t nbytes) {
+    const cs_off_t end = offset + nbytes;
+    if (!df.read.empty() && offset >= df.read.back().start &&
+        offset <= df.read.back().end) {
+        df.read.back().end = std::max(df.read.back().end, end);
+    } else {
+        df.read.push_back({offset, end});
+    }
+
+    df.readBytes += nbytes;
+    if (df.readBytes >= dropBehindSize) {
+        dropRead(df);
+    }
+}
+
+void DropBehindOps::dropRead(DropBehindFile& df) {
+    for (const auto& range : df.read) {
+        dontNeed(df, range);
+    }
+    df.read.clear();
+    df.readBytes = 0;
+}
+
+void DropBehindOps::dropWritten(DropBehindFile& df) {
+    if (df.written.start != df.written.end) {
+        dontNeed(df, df.written);
+        df.written = {};
+    }
+}
+
+void DropBehindOps::dontNeed(DropBehindFile& df, const Range& range) {
+    // Only advisory; ignore any error.
+    couchstore_error_info_t errinfo;
+    wrapped_ops.advise(&errinfo,
+                       df.orig_handle,
+                       range.start,
+                       range.end - range.start,
+                       COUCHSTORE_FILE_ADVICE_DONTNEED);
+}
@@ -0,0 +1,118 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <libcouchstore/couch_db.h>
+
+#include <vector>
+
+/**
+ * FileOpsInterface implementation which asks the OS to drop the pages of a
+ * file from the page cache once they have been read or written, for use by
+ * bulk streams (compaction, DCP backfill) which touch whole files once.
+ *
+ * Without it such a stream brings the whole file through the page cache,
+ * evicting the pages foreground reads (BG fetches) depend on. Once
+ * dropBehindSize bytes have been read, a DONTNEED advice is issued for each
+ * (coalesced) range read so far; written ranges are dropped once synced (a
+ * dirty page can't be dropped), and anything left on close.
+ *
+ * Note the pages of a range read are dropped even if they were cached before
+ * the stream read them.
+ *
+ * O_DIRECT isn't used as couchstore's reads and writes are not aligned to the
+ * device's block size.
+ */
+class DropBehindOps : public FileOpsInterface {
+public:
+    /**
+     * @param ops FileOps implementation to wrap
+     * @param dropBehindSize bytes to read between drops; 0 makes this a
+     *        pass-through.
+     */
+    DropBehindOps(FileOpsInterface& ops, size_t dropBehindSize)
+        : wrapped_ops(ops), dropBehindSize(dropBehindSize) {
+    }
+
+    couch_file_handle constructor(couchstore_error_info_t* errinfo) override;
+    couchstore_error_t open(couchstore_error_info_t* errinfo,
+                            couch_file_handle* handle,
+                            const char* path,
+                            int oflag) override;
+    couchstore_error_t close(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle) override;
+    couchstore_error_t set_periodic_sync(couch_file_handle handle,
+                                         uint64_t period_bytes) override;
+    ssize_t pread(couchstore_error_info_t* errinfo,
+                  couch_file_handle handle,
+                  void* buf,
+                  size_t nbytes,
+                  cs_off_t offset) override;
+    ssize_t pwrite(couchstore_error_info_t* errinfo,
+                   couch_file_handle handle,
+                   const void* buf,
+                   size_t nbytes,
+                   cs_off_t offset) override;
+    cs_off_t goto_eof(couchstore_error_info_t* errinfo,
+                      couch_file_handle handle) override;
+    couchstore_error_t sync(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle) override;
+    couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle,
+                              cs_off_t offset,
+                              cs_off_t len,
+                              couchstore_file_advice_t advice) override;
+    FHStats* get_stats(couch_file_handle handle) override;
+    void destructor(couch_file_handle handle) override;
+
+protected:
+    /// A range of file offsets [start, end).
+    struct Range {
+        cs_off_t start = 0;
+        cs_off_t end = 0;
+    };
+
+    struct DropBehindFile {
+        explicit DropBehindFile(couch_file_handle orig_handle)
+            : orig_handle(orig_handle) {
+        }
+
+        couch_file_handle orig_handle;
+        /// Ranges read since the last drop, adjacent reads coalesced.
+        std::vector<Range> read;
+        /// Bytes read since the last drop.
+        size_t readBytes = 0;
+        /// Range written since the last sync; couchstore only appends.
+        Range written;
+    };
+
+    /// Record a read of [offset, offset + nbytes), dropping if due.
+    void recordRead(DropBehindFile& df, cs_off_t offset, size_t nbytes);
+
+    /// Drop the ranges read since the last drop.
+    void dropRead(DropBehindFile& df);
+
+    /// Drop the range written since the last sync.
+    void dropWritten(DropBehindFile& df);
+
+    /// Advise the given range isn't needed; errors are ignored.
+    void dontNeed(DropBehindFile& df, const Range& range);
+
+    FileOpsInterface& wrapped_ops;
+    const size_t dropBehindSize;
+};
@@ -0,0 +1,281 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couch-kvstore/couch-fs-encryption.h"
+
+#include <platform/base64.h>
+#include <platform/dirutils.h>
+#include <platform/random.h>
+
+#include <fcntl.h>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+/// The start of an encrypted file's header block; the rest of it is zero.
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    /// The cb::crypto::Cipher the file is encrypted with
+    uint32_t cipher;
+    uint8_t iv[16];
+    /// HMAC-SHA256 of the IV with the key
+    uint8_t keyCheck[32];
+};
+
+const char fileMagic[8] = {'c', 'b', 'e', 'n', 'c', 'r', 'y', 'p'};
+const uint32_t fileVersion = 1;
+const auto fileCipher = cb::crypto::Cipher::AES_256_ctr;
+
+/// Size of the buffer a handle encrypts its writes into
+const size_t writeBufferSize = 64 * 1024;
+} // namespace
+
+EncryptedOps::EncryptedOps(FileOpsInterface& ops, std::string key)
+    : wrapped_ops(ops), key(std::move(key)) {
+    if (this->key.size() != 32) {
+        throw std::invalid_argument(
+                "EncryptedOps: Invalid key size: " +
+                std::to_string(this->key.size()) + " (expected 32)");
+    }
+}
+
+std::string EncryptedOps::loadKey(const std::string& path) {
+    auto encoded = cb::io::loadFile(path);
+    encoded.erase(std::remove_if(encoded.begin(),
+                                 encoded.end(),
+                                 [](unsigned char c) { return std::isspace(c); }),
+                  encoded.end());
+    auto key = Couchbase::Base64::decode(encoded);
+    if (key.size() != 32) {
+        throw std::runtime_error("EncryptedOps::loadKey: " + path +
+                                 " doesn't hold a base64 encoded 32 byte key");
+    }
+    return key;
+}
+
+std::string EncryptedOps::keyCheck(cb::const_char_buffer iv) const {
+    return cb::crypto::HMAC(cb::crypto::Algorithm::SHA256, key, iv);
+}
+
+couchstore_error_t EncryptedOps::initFile(couchstore_error_info_t* errinfo,
+                                          EncryptedFile& ef,
+                                          bool writable) {
+    const cs_off_t eof = wrapped_ops.goto_eof(errinfo, ef.orig_handle);
+    if (eof < 0) {
+        return static_cast<couchstore_error_t>(eof);
+    }
+
+    FileHeader header{};
+    if (eof == 0) {
+        if (!writable) {
+            return COUCHSTORE_SUCCESS;
+        }
+        // A new file: give it its own IV
+        std::memcpy(header.magic, fileMagic, sizeof(header.magic));
+        header.version = fileVersion;
+        header.cipher = uint32_t(fileCipher);
+        cb::RandomGenerator random;
+        if (!random.getBytes(header.iv, sizeof(header.iv))) {
+            return COUCHSTORE_ERROR_WRITE;
+        }
+        const auto check = keyCheck(
+                {reinterpret_cast<const char*>(header.iv), sizeof(header.iv)});
+        std::memcpy(header.keyCheck, check.data(), sizeof(header.keyCheck));
+
+        std::array<char, headerSize> block{};
+        std::memcpy(block.data(), &header, sizeof(header));
+        const ssize_t written = wrapped_ops.pwrite(
+                errinfo, ef.orig_handle, block.data(), block.size(), 0);
+        if (written < 0) {
+            return static_cast<couchstore_error_t>(written);
+        }
+        if (size_t(written) != block.size()) {
+            return COUCHSTORE_ERROR_WRITE;
+        }
+    } else {
+        if (size_t(eof) < sizeof(header)) {
+            return COUCHSTORE_SUCCESS;
+        }
+        const ssize_t nread = wrapped_ops.pread(
+                errinfo, ef.orig_handle, &header, sizeof(header), 0);
+        if (nread < 0) {
+            return static_cast<couchstore_error_t>(nread);
+        }
+        if (size_t(nread) != sizeof(header) ||
+            std::memcmp(header.magic, fileMagic, sizeof(header.magic)) != 0) {
+            // Not encrypted
+            return COUCHSTORE_SUCCESS;
+        }
+        const auto check = keyCheck(
+                {reinterpret_cast<const char*>(header.iv), sizeof(header.iv)});
+        if (header.version != fileVersion ||
+            header.cipher != uint32_t(fileCipher) ||
+            size_t(eof) < headerSize ||
+            std::memcmp(header.keyCheck, check.data(), check.size()) != 0) {
+            return COUCHSTORE_ERROR_CORRUPT;
+        }
+    }
+
+    try {
+        ef.cipher = std::make_unique<cb::crypto::StreamCipher>(
+                fileCipher,
+                key,
+                cb::const_char_buffer{reinterpret_cast<const char*>(header.iv),
+                                      sizeof(header.iv)});
+    } catch (const std::exception&) {
+        return COUCHSTORE_ERROR_OPEN_FILE;
+    }
+    return COUCHSTORE_SUCCESS;
+}
+
+couch_file_handle EncryptedOps::constructor(couchstore_error_info_t* errinfo) {
+    auto* ef = new EncryptedFile(wrapped_ops.constructor(errinfo));
+    return reinterpret_cast<couch_file_handle>(ef);
+}
+
+couchstore_error_t EncryptedOps::open(couchstore_error_info_t* errinfo,
+                                      couch_file_handle* h,
+                                      const char* path,
+                                      int flags) {
+    auto* ef = reinterpret_cast<EncryptedFile*>(*h);
+    ef->cipher.reset();
+    auto err = wrapped_ops.open(errinfo, &ef->orig_handle, path, flags);
+    if (err != COUCHSTORE_SUCCESS) {
+        return err;
+    }
+    err = initFile(errinfo, *ef, (flags & (O_WRONLY | O_RDWR)) != 0);
+    if (err != COUCHSTORE_SUCCESS) {
+        couchstore_error_info_t closeErrinfo;
+        wrapped_ops.close(&closeErrinfo, ef->orig_handle);
+    }
+    return err;
+}
+
+couchstore_error_t EncryptedOps::close(couchstore_error_info_t* errinfo,
+                                       couch_file_handle h) {
+    auto* ef = reinterpret_cast<EncryptedFile*>(h);
+    ef->cipher.reset();
+    return wrapped_ops.close(errinfo, ef->orig_handle);
+}
+
+couchstore_error_t EncryptedOps::set_periodic_sync(couch_file_handle h,
+                                                   uint64_t period_bytes) {
+    auto* ef = reinterpret_cast<EncryptedFile*>(h);
+    return wrapped_ops.set_periodic_sync(ef->orig_handle, period_bytes);
+}
+
+ssize_t EncryptedOps::pread(couchstore_error_info_t* errinfo,
+                            couch_file_handle h,
+                            void* buf,
+                            size_t sz,
+                            cs_off_t off) {
+    auto* ef = reinterpret_cast<EncryptedFile*>(h);
+    const ssize_t nread = wrapped_ops.pread(
+            errinfo, ef->orig_handle, buf, sz, ef->physical(off));
+    if (!ef->cipher || nread <= 0) {
+        return nread;
+    }
+    try {
+        ef->cipher->process(off, {static_cast<char*>(buf), size_t(nread)});
+    } catch (const std::exception&) {
+        return COUCHSTORE_ERROR_READ;
+    }
+    return nread;
+}
+
+ssize_t EncryptedOps::pwrite(couchstore_error_info_t* errinfo,
+                             couch_file_handle h,
+                             const void* buf,
+                             size_t sz,
+                             cs_off_t off) {
+    auto* ef = reinterpret_cast<EncryptedFile*>(h);
+    if (!ef->cipher) {
+        return wrapped_ops.pwrite(errinfo, ef->orig_handle, buf, sz, off);
+    }
+
+    // The caller's buffer can't be encrypted in place, so encrypt it a
+    // chunk at a time into the handle's buffer.
+    if (ef->buffer.empty()) {
+        ef->buffer.resize(writeBufferSize);
+    }
+    const auto* in = static_cast<const char*>(buf);
+    size_t done = 0;
+    while (done < sz) {
+        const size_t chunk = std::min(sz - done, ef->buffer.size());
+        try {
+            ef->cipher->process(off + done,
+                                {in + done, chunk},
+                                {ef->buffer.data(), chunk});
+        } catch (const std::exception&) {
+            return done > 0 ? ssize_t(done) : ssize_t(COUCHSTORE_ERROR_WRITE);
+        }
+        const ssize_t written = wrapped_ops.pwrite(errinfo,
+                                                   ef->orig_handle,
+                                                   ef->buffer.data(),
+                                                   chunk,
+                                                   ef->physical(off + done));
+        if (written <= 0) {
+            return done > 0 ? ssize_t(done) : written;
+        }
+        done += written;
+        if (size_t(written) < chunk) {
+            break;
+        }
+    }
+    return ssize_t(done);
+}
+
+cs_off_t EncryptedOps::goto_eof(couchstore_error_info_t* errinfo,
+                                couch_file_handle h) {
+    auto* ef = reinterpret_cast<EncryptedFile*>(h);
+    const cs_off_t eof = wrapped_ops.goto_eof(errinfo, ef->orig_handle);
+    if (!ef->cipher || eof < 0) {
+        return eof;
+    }
+    return eof - cs_off_t(headerSize);
+}
+
+couchstore_error_t EncryptedOps::sync(couchstore_error_info_t* errinfo,
+                                      couch_file_handle h) {
+    auto* ef = reinterpret_cast<EncryptedFile*>(h);
+    return wrapped_ops.sync(errinfo, ef->orig_handle);
+}
+
+couchstore_error_t EncryptedOps::advise(couchstore_error_info_t* errinfo,
+                                        couch_file_handle h,
+                                        cs_off_t offs,
+                                        cs_off_t len,
+                                        couchstore_file_advice_t adv) {
+    auto* ef = reinterpret_cast<EncryptedFile*>(h);
+    return wrapped_ops.advise(
+            errinfo, ef->orig_handle, ef->physical(offs), len, adv);
+}
+
+FileOpsInterface::FHStats* EncryptedOps::get_stats(couch_file_handle h) {
+    auto* ef = reinterpret_cast<EncryptedFile*>(h);
+    return wrapped_ops.get_stats(ef->orig_handle);
+}
+
+void EncryptedOps::destructor(couch_file_handle h) {
+    auto* ef = reinterpret_cast<EncryptedFile*>(h);
+    wrapped_ops.destructor(ef->orig_handle);
+    delete ef;
+}
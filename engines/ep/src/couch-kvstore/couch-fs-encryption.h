@@ -0,0 +1,127 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <cbcrypto/cbcrypto.h>
+#include <libcouchstore/couch_db.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * FileOpsInterface implementation which encrypts what couchstore writes to
+ * a file, and decrypts what it reads, with AES-256 in CTR mode
+ * (cb::crypto::StreamCipher) - in place when reading, and through a buffer
+ * of the handle's when writing.
+ *
+ * A file created through these ops starts with a header block of
+ * headerSize bytes, holding a random IV for the file and a check value of
+ * the key; the wrapped file's offsets are couchstore's plus headerSize,
+ * which keeps couchstore's blocks aligned. A file without the header - one
+ * written before encryption was enabled - is read and appended to as it
+ * is, until compaction rewrites it (encrypted) to a new file. Opening an
+ * encrypted file with a different key fails with COUCHSTORE_ERROR_CORRUPT.
+ *
+ * couchstore only appends to a file, so no offset of it is encrypted
+ * twice with the keystream.
+ */
+class EncryptedOps : public FileOpsInterface {
+public:
+    /// Size of the header at the start of an encrypted file
+    static const size_t headerSize = 4096;
+
+    /**
+     * @param ops FileOps implementation to wrap
+     * @param key the AES-256 key (32 bytes)
+     * @throws std::invalid_argument if the key is the wrong size
+     */
+    EncryptedOps(FileOpsInterface& ops, std::string key);
+
+    /**
+     * Read a key from a file, holding it base64 encoded.
+     *
+     * @throws std::runtime_error if the file can't be read or doesn't hold a
+     *         32 byte key
+     */
+    static std::string loadKey(const std::string& path);
+
+    couch_file_handle constructor(couchstore_error_info_t* errinfo) override;
+    couchstore_error_t open(couchstore_error_info_t* errinfo,
+                            couch_file_handle* handle,
+                            const char* path,
+                            int oflag) override;
+    couchstore_error_t close(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle) override;
+    couchstore_error_t set_periodic_sync(couch_file_handle handle,
+                                         uint64_t period_bytes) override;
+    ssize_t pread(couchstore_error_info_t* errinfo,
+                  couch_file_handle handle,
+                  void* buf,
+                  size_t nbytes,
+                  cs_off_t offset) override;
+    ssize_t pwrite(couchstore_error_info_t* errinfo,
+                   couch_file_handle handle,
+                   const void* buf,
+                   size_t nbytes,
+                   cs_off_t offset) override;
+    cs_off_t goto_eof(couchstore_error_info_t* errinfo,
+                      couch_file_handle handle) override;
+    couchstore_error_t sync(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle) override;
+    couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle,
+                              cs_off_t offset,
+                              cs_off_t len,
+                              couchstore_file_advice_t advice) override;
+    FHStats* get_stats(couch_file_handle handle) override;
+    void destructor(couch_file_handle handle) override;
+
+protected:
+    struct EncryptedFile {
+        explicit EncryptedFile(couch_file_handle orig_handle)
+            : orig_handle(orig_handle) {
+        }
+
+        /// @return the wrapped file's offset for couchstore's offset
+        cs_off_t physical(cs_off_t offset) const {
+            return cipher ? offset + cs_off_t(headerSize) : offset;
+        }
+
+        couch_file_handle orig_handle;
+        /// The file's cipher; null if the file isn't encrypted.
+        std::unique_ptr<cb::crypto::StreamCipher> cipher;
+        /// What pwrite() encrypts into; allocated by the first write.
+        std::vector<char> buffer;
+    };
+
+    /**
+     * Write a new header (with a new IV) to the just created file, or
+     * validate the header of an existing one, and set up wf's cipher
+     * accordingly.
+     */
+    couchstore_error_t initFile(couchstore_error_info_t* errinfo,
+                                EncryptedFile& wf,
+                                bool writable);
+
+    /// @return the value stored in a file's header to check the key with
+    std::string keyCheck(cb::const_char_buffer iv) const;
+
+    FileOpsInterface& wrapped_ops;
+    const std::string key;
+};
@@ -0,0 +1,121 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couch-kvstore/couch-fs-header-seek.h"
+
+#include <algorithm>
+#include <cstring>
+
+couch_file_handle HeaderSeekOps::constructor(couchstore_error_info_t* errinfo) {
+    auto* hf = new HeaderSeekFile(wrapped_ops.constructor(errinfo));
+    return reinterpret_cast<couch_file_handle>(hf);
+}
+
+couchstore_error_t HeaderSeekOps::open(couchstore_error_info_t* errinfo,
+                                       couch_file_handle* h,
+                                       const char* path,
+                                       int flags) {
+    auto* hf = reinterpret_cast<HeaderSeekFile*>(*h);
+    hf->hideTo = -1;
+    return wrapped_ops.open(errinfo, &hf->orig_handle, path, flags);
+}
+
+couchstore_error_t HeaderSeekOps::close(couchstore_error_info_t* errinfo,
+                                        couch_file_handle h) {
+    auto* hf = reinterpret_cast<HeaderSeekFile*>(h);
+    return wrapped_ops.close(errinfo, hf->orig_handle);
+}
+
+couchstore_error_t HeaderSeekOps::set_periodic_sync(couch_file_handle h,
+                                                    uint64_t period_bytes) {
+    auto* hf = reinterpret_cast<HeaderSeekFile*>(h);
+    return wrapped_ops.set_periodic_sync(hf->orig_handle, period_bytes);
+}
+
+ssize_t HeaderSeekOps::pread(couchstore_error_info_t* errinfo,
+                             couch_file_handle h,
+                             void* buf,
+                             size_t sz,
+                             cs_off_t off) {
+    auto* hf = reinterpret_cast<HeaderSeekFile*>(h);
+    const cs_off_t end = off + sz;
+    const cs_off_t from = std::max(off, hideFrom);
+    const cs_off_t to = hf->hideTo < 0 ? end : std::min(end, hf->hideTo);
+    if (from >= to) {
+        return wrapped_ops.pread(errinfo, hf->orig_handle, buf, sz, off);
+    }
+
+    if (from == off && to == end) {
+        // Wholly hidden; no need to read it.
+        std::memset(buf, 0, sz);
+        return sz;
+    }
+
+    const ssize_t got =
+            wrapped_ops.pread(errinfo, hf->orig_handle, buf, sz, off);
+    if (got > 0 && off + got > from) {
+        const cs_off_t hiddenEnd = std::min(to, cs_off_t(off + got));
+        std::memset(static_cast<char*>(buf) + (from - off),
+                    0,
+                    hiddenEnd - from);
+    }
+    return got;
+}
+
+ssize_t HeaderSeekOps::pwrite(couchstore_error_info_t* errinfo,
+                              couch_file_handle h,
+                              const void* buf,
+                              size_t sz,
+                              cs_off_t off) {
+    auto* hf = reinterpret_cast<HeaderSeekFile*>(h);
+    if (hf->hideTo < 0 || off < hf->hideTo) {
+        hf->hideTo = off;
+    }
+    return wrapped_ops.pwrite(errinfo, hf->orig_handle, buf, sz, off);
+}
+
+cs_off_t HeaderSeekOps::goto_eof(couchstore_error_info_t* errinfo,
+                                 couch_file_handle h) {
+    auto* hf = reinterpret_cast<HeaderSeekFile*>(h);
+    return wrapped_ops.goto_eof(errinfo, hf->orig_handle);
+}
+
+couchstore_error_t HeaderSeekOps::sync(couchstore_error_info_t* errinfo,
+                                       couch_file_handle h) {
+    auto* hf = reinterpret_cast<HeaderSeekFile*>(h);
+    return wrapped_ops.sync(errinfo, hf->orig_handle);
+}
+
+couchstore_error_t HeaderSeekOps::advise(couchstore_error_info_t* errinfo,
+                                         couch_file_handle h,
+                                         cs_off_t offs,
+                                         cs_off_t len,
+                                         couchstore_file_advice_t adv) {
+    auto* hf = reinterpret_cast<HeaderSeekFile*>(h);
+    return wrapped_ops.advise(errinfo, hf->orig_handle, offs, len, adv);
+}
+
+FileOpsInterface::FHStats* HeaderSeekOps::get_stats(couch_file_handle h) {
+    auto* hf = reinterpret_cast<HeaderSeekFile*>(h);
+    return wrapped_ops.get_stats(hf->orig_handle);
+}
+
+void HeaderSeekOps::destructor(couch_file_handle h) {
+    auto* hf = reinterpret_cast<HeaderSeekFile*>(h);
+    wrapped_ops.destructor(hf->orig_handle);
+    delete hf;
+}
@@ -0,0 +1,93 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <libcouchstore/couch_db.h>
+
+/**
+ * FileOpsInterface implementation which hides the tail of a file from reads,
+ * so that couchstore opens it at an earlier header: the one which ends at
+ * hideFrom.
+ *
+ * couchstore finds a file's latest header by reading the marker byte of each
+ * block back from the end of the file; reads from hideFrom onwards return
+ * zeros, which mark a data block, so every header after hideFrom is
+ * skipped. couchstore has no API to open a file at a given header, and
+ * rewinding to it (couchstore_rewind_db_header) reads each later header in
+ * turn.
+ *
+ * Writes (and goto_eof) are not affected, so a header committed through the
+ * handle is appended at the real end of the file; nothing written through
+ * the handle is hidden.
+ */
+class HeaderSeekOps : public FileOpsInterface {
+public:
+    /**
+     * @param ops FileOps implementation to wrap
+     * @param hideFrom file offset from which reads are hidden
+     */
+    HeaderSeekOps(FileOpsInterface& ops, cs_off_t hideFrom)
+        : wrapped_ops(ops), hideFrom(hideFrom) {
+    }
+
+    couch_file_handle constructor(couchstore_error_info_t* errinfo) override;
+    couchstore_error_t open(couchstore_error_info_t* errinfo,
+                            couch_file_handle* handle,
+                            const char* path,
+                            int oflag) override;
+    couchstore_error_t close(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle) override;
+    couchstore_error_t set_periodic_sync(couch_file_handle handle,
+                                         uint64_t period_bytes) override;
+    ssize_t pread(couchstore_error_info_t* errinfo,
+                  couch_file_handle handle,
+                  void* buf,
+                  size_t nbytes,
+                  cs_off_t offset) override;
+    ssize_t pwrite(couchstore_error_info_t* errinfo,
+                   couch_file_handle handle,
+                   const void* buf,
+                   size_t nbytes,
+                   cs_off_t offset) override;
+    cs_off_t goto_eof(couchstore_error_info_t* errinfo,
+                      couch_file_handle handle) override;
+    couchstore_error_t sync(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle) override;
+    couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle,
+                              cs_off_t offset,
+                              cs_off_t len,
+                              couchstore_file_advice_t advice) override;
+    FHStats* get_stats(couch_file_handle handle) override;
+    void destructor(couch_file_handle handle) override;
+
+protected:
+    struct HeaderSeekFile {
+        explicit HeaderSeekFile(couch_file_handle orig_handle)
+            : orig_handle(orig_handle) {
+        }
+
+        couch_file_handle orig_handle;
+        /// End of the hidden range: the lowest offset written through the
+        /// handle (couchstore only appends), else unbounded.
+        cs_off_t hideTo = -1;
+    };
+
+    FileOpsInterface& wrapped_ops;
+    const cs_off_t hideFrom;
+};
@@ -0,0 +1,167 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couch-kvstore/couch-fs-merge.h"
+
+#include <algorithm>
+#include <cstring>
+
+/// The plan installed on this thread by a ScopedPlan, if any.
+static thread_local MergedReadOps::Plan* currentPlan = nullptr;
+
+void MergedReadOps::Plan::add(cs_off_t offset, size_t length) {
+    const auto align = cs_off_t(ReadBufferSize);
+    const cs_off_t start = offset - offset % align;
+    const cs_off_t end = ((offset + length + align - 1) / align) * align;
+
+    if (!runs.empty()) {
+        auto& last = runs.back();
+        if (start <= last.end + cs_off_t(maxGap) &&
+            size_t(std::max(end, last.end) - last.start) <= maxRunSize) {
+            last.end = std::max(end, last.end);
+            ++last.numRanges;
+            return;
+        }
+    }
+    runs.push_back({start, end, 1, {}, false});
+}
+
+size_t MergedReadOps::Plan::getNumMergedRuns() const {
+    return std::count_if(runs.begin(), runs.end(), [](const Run& run) {
+        return run.numRanges > 1;
+    });
+}
+
+MergedReadOps::Plan::Run* MergedReadOps::Plan::find(cs_off_t offset,
+                                                     size_t nbytes) {
+    // Runs are in ascending order; find the last one starting at or before
+    // offset.
+    auto it = std::upper_bound(
+            runs.begin() + current,
+            runs.end(),
+            offset,
+            [](cs_off_t off, const Run& run) { return off < run.start; });
+    if (it == runs.begin() + current) {
+        return nullptr;
+    }
+    --it;
+    if (it->numRanges < 2 || offset + cs_off_t(nbytes) > it->end) {
+        return nullptr;
+    }
+
+    // Reads are made in ascending order, so earlier runs are done with.
+    const size_t index = it - runs.begin();
+    for (; current < index; ++current) {
+        runs[current].data = {};
+    }
+    return &*it;
+}
+
+MergedReadOps::ScopedPlan::ScopedPlan(Plan& plan) : previous(currentPlan) {
+    currentPlan = &plan;
+}
+
+MergedReadOps::ScopedPlan::~ScopedPlan() {
+    currentPlan = previous;
+}
+
+couch_file_handle MergedReadOps::constructor(couchstore_error_info_t* errinfo) {
+    // No per-file state; use the wrapped handles directly.
+    return wrapped_ops.constructor(errinfo);
+}
+
+couchstore_error_t MergedReadOps::open(couchstore_error_info_t* errinfo,
+                                       couch_file_handle* h,
+                                       const char* path,
+                                       int flags) {
+    return wrapped_ops.open(errinfo, h, path, flags);
+}
+
+couchstore_error_t MergedReadOps::close(couchstore_error_info_t* errinfo,
+                                        couch_file_handle h) {
+    return wrapped_ops.close(errinfo, h);
+}
+
+couchstore_error_t MergedReadOps::set_periodic_sync(couch_file_handle h,
+                                                    uint64_t period_bytes) {
+    return wrapped_ops.set_periodic_sync(h, period_bytes);
+}
+
+ssize_t MergedReadOps::pread(couchstore_error_info_t* errinfo,
+                             couch_file_handle h,
+                             void* buf,
+                             size_t sz,
+                             cs_off_t off) {
+    auto* run = currentPlan ? currentPlan->find(off, sz) : nullptr;
+    if (!run) {
+        return wrapped_ops.pread(errinfo, h, buf, sz, off);
+    }
+
+    if (!run->loaded) {
+        run->data.resize(run->end - run->start);
+        const ssize_t got = wrapped_ops.pread(
+                errinfo, h, run->data.data(), run->data.size(), run->start);
+        if (got < 0) {
+            run->data = {};
+            return got;
+        }
+        run->data.resize(got);
+        run->loaded = true;
+    }
+
+    const size_t skip = off - run->start;
+    if (skip >= run->data.size()) {
+        return 0;
+    }
+    const size_t n = std::min(sz, run->data.size() - skip);
+    std::memcpy(buf, run->data.data() + skip, n);
+    return n;
+}
+
+ssize_t MergedReadOps::pwrite(couchstore_error_info_t* errinfo,
+                              couch_file_handle h,
+                              const void* buf,
+                              size_t sz,
+                              cs_off_t off) {
+    return wrapped_ops.pwrite(errinfo, h, buf, sz, off);
+}
+
+cs_off_t MergedReadOps::goto_eof(couchstore_error_info_t* errinfo,
+                                 couch_file_handle h) {
+    return wrapped_ops.goto_eof(errinfo, h);
+}
+
+couchstore_error_t MergedReadOps::sync(couchstore_error_info_t* errinfo,
+                                       couch_file_handle h) {
+    return wrapped_ops.sync(errinfo, h);
+}
+
+couchstore_error_t MergedReadOps::advise(couchstore_error_info_t* errinfo,
+                                         couch_file_handle h,
+                                         cs_off_t offs,
+                                         cs_off_t len,
+                                         couchstore_file_advice_t adv) {
+    return wrapped_ops.advise(errinfo, h, offs, len, adv);
+}
+
+FileOpsInterface::FHStats* MergedReadOps::get_stats(couch_file_handle h) {
+    return wrapped_ops.get_stats(h);
+}
+
+void MergedReadOps::destructor(couch_file_handle h) {
+    wrapped_ops.destructor(h);
+}
@@ -0,0 +1,140 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <libcouchstore/couch_db.h>
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * FileOpsInterface implementation which merges the reads of documents a
+ * background fetch batch is about to make, when they are close together in
+ * the file, into one read per run of documents.
+ *
+ * Couchstore reads each document on its own (through its read buffer), so a
+ * batch read in file offset order (bgfetch_offset_order) still costs at
+ * least one read() per document - and one seek per document on a HDD. The
+ * caller instead describes the byte ranges it is about to read in a Plan
+ * and installs it on the reading thread with a ScopedPlan. Ranges no more
+ * than maxGap bytes apart are merged into runs; the first read which falls
+ * within a run of two or more documents reads the whole run from the
+ * wrapped FileOps, and the remaining reads of the run are served from that
+ * buffer. Any read not entirely within a run (btree nodes, a document
+ * larger than described) goes to the wrapped FileOps as normal.
+ *
+ * Without a plan installed this is a pass-through.
+ */
+class MergedReadOps : public FileOpsInterface {
+public:
+    /**
+     * The ranges of a file a batch is about to read, in ascending offset
+     * order, merged into runs.
+     */
+    class Plan {
+    public:
+        /**
+         * @param maxGap ranges at most this many bytes apart are merged
+         * @param maxRunSize a run isn't extended beyond this many bytes
+         */
+        Plan(size_t maxGap, size_t maxRunSize)
+            : maxGap(maxGap), maxRunSize(maxRunSize) {
+        }
+
+        /// Add the range [offset, offset + length); offsets must not
+        /// decrease.
+        void add(cs_off_t offset, size_t length);
+
+        /// @return the number of runs which merge two or more ranges.
+        size_t getNumMergedRuns() const;
+
+    private:
+        friend class MergedReadOps;
+
+        struct Run {
+            cs_off_t start;
+            cs_off_t end;
+            size_t numRanges;
+            /// The run's data once read; may be shorter than the run at the
+            /// end of the file.
+            std::vector<uint8_t> data;
+            bool loaded;
+        };
+
+        /// @return the run containing [offset, offset + nbytes), or nullptr.
+        Run* find(cs_off_t offset, size_t nbytes);
+
+        const size_t maxGap;
+        const size_t maxRunSize;
+        std::vector<Run> runs;
+        /// Runs before this one have been read past; their data is freed.
+        size_t current = 0;
+    };
+
+    /// Installs a Plan for the reads made by the current thread (through
+    /// any MergedReadOps) for its lifetime.
+    class ScopedPlan {
+    public:
+        explicit ScopedPlan(Plan& plan);
+        ~ScopedPlan();
+
+    private:
+        Plan* previous;
+    };
+
+    /// Assumed size (and alignment) of couchstore's reads through its read
+    /// buffer; runs are widened to multiples of it.
+    static const size_t ReadBufferSize = 4096;
+
+    explicit MergedReadOps(FileOpsInterface& ops) : wrapped_ops(ops) {
+    }
+
+    couch_file_handle constructor(couchstore_error_info_t* errinfo) override;
+    couchstore_error_t open(couchstore_error_info_t* errinfo,
+                            couch_file_handle* handle,
+                            const char* path,
+                            int oflag) override;
+    couchstore_error_t close(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle) override;
+    couchstore_error_t set_periodic_sync(couch_file_handle handle,
+                                         uint64_t period_bytes) override;
+    ssize_t pread(couchstore_error_info_t* errinfo,
+                  couch_file_handle handle,
+                  void* buf,
+                  size_t nbytes,
+                  cs_off_t offset) override;
+    ssize_t pwrite(couchstore_error_info_t* errinfo,
+                   couch_file_handle handle,
+                   const void* buf,
+                   size_t nbytes,
+                   cs_off_t offset) override;
+    cs_off_t goto_eof(couchstore_error_info_t* errinfo,
+                      couch_file_handle handle) override;
+    couchstore_error_t sync(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle) override;
+    couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle,
+                              cs_off_t offset,
+                              cs_off_t len,
+                              couchstore_file_advice_t advice) override;
+    FHStats* get_stats(couch_file_handle handle) override;
+    void destructor(couch_file_handle handle) override;
+
+protected:
+    FileOpsInterface& wrapped_ops;
+};
@@ -0,0 +1,131 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couch-kvstore/couch-fs-readahead.h"
+
+#include <algorithm>
+
+couch_file_handle ReadaheadOps::constructor(couchstore_error_info_t* errinfo) {
+    auto* rf = new ReadaheadFile(wrapped_ops.constructor(errinfo));
+    return reinterpret_cast<couch_file_handle>(rf);
+}
+
+couchstore_error_t ReadaheadOps::open(couchstore_error_info_t* errinfo,
+                                      couch_file_handle* h,
+                                      const char* path,
+                                      int flags) {
+    auto* rf = reinterpret_cast<ReadaheadFile*>(*h);
+    rf->stream = {};
+    rf->lastRead = {};
+    return wrapped_ops.open(errinfo, &rf->orig_handle, path, flags);
+}
+
+couchstore_error_t ReadaheadOps::close(couchstore_error_info_t* errinfo,
+                                       couch_file_handle h) {
+    auto* rf = reinterpret_cast<ReadaheadFile*>(h);
+    return wrapped_ops.close(errinfo, rf->orig_handle);
+}
+
+couchstore_error_t ReadaheadOps::set_periodic_sync(couch_file_handle h,
+                                                   uint64_t period_bytes) {
+    auto* rf = reinterpret_cast<ReadaheadFile*>(h);
+    return wrapped_ops.set_periodic_sync(rf->orig_handle, period_bytes);
+}
+
+ssize_t ReadaheadOps::pread(couchstore_error_info_t* errinfo,
+                            couch_file_handle h,
+                            void* buf,
+                            size_t sz,
+                            cs_off_t off) {
+    auto* rf = reinterpret_cast<ReadaheadFile*>(h);
+    if (readaheadSize != 0) {
+        maybeReadahead(*rf, off, sz);
+    }
+    return wrapped_ops.pread(errinfo, rf->orig_handle, buf, sz, off);
+}
+
+ssize_t ReadaheadOps::pwrite(couchstore_error_info_t* errinfo,
+                             couch_file_handle h,
+                             const void* buf,
+                             size_t sz,
+                             cs_off_t off) {
+    auto* rf = reinterpret_cast<ReadaheadFile*>(h);
+    return wrapped_ops.pwrite(errinfo, rf->orig_handle, buf, sz, off);
+}
+
+cs_off_t ReadaheadOps::goto_eof(couchstore_error_info_t* errinfo,
+                                couch_file_handle h) {
+    auto* rf = reinterpret_cast<ReadaheadFile*>(h);
+    return wrapped_ops.goto_eof(errinfo, rf->orig_handle);
+}
+
+couchstore_error_t ReadaheadOps::sync(couchstore_error_info_t* errinfo,
+                                      couch_file_handle h) {
+    auto* rf = reinterpret_cast<ReadaheadFile*>(h);
+    return wrapped_ops.sync(errinfo, rf->orig_handle);
+}
+
+couchstore_error_t ReadaheadOps::advise(couchstore_error_info_t* errinfo,
+                                        couch_file_handle h,
+                                        cs_off_t offs,
+                                        cs_off_t len,
+                                        couchstore_file_advice_t adv) {
+    auto* rf = reinterpret_cast<ReadaheadFile*>(h);
+    return wrapped_ops.advise(errinfo, rf->orig_handle, offs, len, adv);
+}
+
+FileOpsInterface::FHStats* ReadaheadOps::get_stats(couch_file_handle h) {
+    auto* rf = reinterpret_cast<ReadaheadFile*>(h);
+    return wrapped_ops.get_stats(rf->orig_handle);
+}
+
+void ReadaheadOps::destructor(couch_file_handle h) {
+    auto* rf = reinterpret_cast<ReadaheadFile*>(h);
+    wrapped_ops.destructor(rf->orig_handle);
+    delete rf;
+}
+
+void ReadaheadOps::maybeReadahead(ReadaheadFile& rf,
+                                  cs_off_t offset,
+                                  size_t nbytes) {
+    const cs_off_t end = offset + nbytes;
+    const auto gap = cs_off_t(maxGap);
+    if (!rf.stream.continues(offset, gap)) {
+        if (!rf.lastRead.continues(offset, gap)) {
+            // A read elsewhere in the file (e.g. a btree node) - don't
+            // read ahead of it unless the next read carries on from it.
+            rf.lastRead = {offset, end};
+            return;
+        }
+        // Two consecutive reads - start following a new stream.
+        rf.stream = {rf.lastRead.start, end};
+        rf.lastRead = {};
+    }
+
+    const auto window = cs_off_t(readaheadSize);
+    if (end + window / 2 > rf.stream.end) {
+        const auto from = std::max(rf.stream.end, end);
+        // Readahead is only advisory; ignore any error.
+        couchstore_error_info_t errinfo;
+        wrapped_ops.advise(&errinfo,
+                           rf.orig_handle,
+                           from,
+                           window,
+                           COUCHSTORE_FILE_ADVICE_WILLNEED);
+        rf.stream.end = from + window;
+    }
+}
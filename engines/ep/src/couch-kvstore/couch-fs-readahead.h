@@ -0,0 +1,119 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <libcouchstore/couch_db.h>
+
+/**
+ * FileOpsInterface implementation which asks the OS to read ahead of
+ * sequential reads, for use by by-seqno scans (DCP backfill).
+ *
+ * Couchstore files are append-only and compaction rewrites documents in
+ * seqno order, so a by-seqno scan mostly reads documents at ascending file
+ * offsets - interleaved with reads of the by-seqno btree nodes, which live
+ * elsewhere in the file. The kernel's own readahead heuristic gets reset by
+ * those interleaved reads; this class instead tracks the sequential stream
+ * of reads itself (ignoring reads which jump elsewhere) and, whenever the
+ * stream gets within half a window of the end of what has already been
+ * requested, issues a WILLNEED advice for the next readaheadSize bytes.
+ *
+ * The order reads are issued in is not changed - DCP requires items in seqno
+ * order.
+ *
+ * A non-zero maxGap also treats a read which skips forward by up to that many
+ * bytes as continuing the stream - for callers which read documents in
+ * ascending offset order but not contiguously (access log warmup).
+ */
+class ReadaheadOps : public FileOpsInterface {
+public:
+    /**
+     * @param ops FileOps implementation to wrap
+     * @param readaheadSize bytes to read ahead of a sequential stream of
+     *        reads; 0 makes this a pass-through.
+     * @param maxGap bytes a read may skip forward by and still continue a
+     *        stream.
+     */
+    ReadaheadOps(FileOpsInterface& ops, size_t readaheadSize, size_t maxGap = 0)
+        : wrapped_ops(ops), readaheadSize(readaheadSize), maxGap(maxGap) {
+    }
+
+    couch_file_handle constructor(couchstore_error_info_t* errinfo) override;
+    couchstore_error_t open(couchstore_error_info_t* errinfo,
+                            couch_file_handle* handle,
+                            const char* path,
+                            int oflag) override;
+    couchstore_error_t close(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle) override;
+    couchstore_error_t set_periodic_sync(couch_file_handle handle,
+                                         uint64_t period_bytes) override;
+    ssize_t pread(couchstore_error_info_t* errinfo,
+                  couch_file_handle handle,
+                  void* buf,
+                  size_t nbytes,
+                  cs_off_t offset) override;
+    ssize_t pwrite(couchstore_error_info_t* errinfo,
+                   couch_file_handle handle,
+                   const void* buf,
+                   size_t nbytes,
+                   cs_off_t offset) override;
+    cs_off_t goto_eof(couchstore_error_info_t* errinfo,
+                      couch_file_handle handle) override;
+    couchstore_error_t sync(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle) override;
+    couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle,
+                              cs_off_t offset,
+                              cs_off_t len,
+                              couchstore_file_advice_t advice) override;
+    FHStats* get_stats(couch_file_handle handle) override;
+    void destructor(couch_file_handle handle) override;
+
+protected:
+    /// A range of file offsets [start, end).
+    struct Range {
+        /// @return true if a read at offset is within, or carries on from
+        ///         (skipping at most maxGap bytes), this range.
+        bool continues(cs_off_t offset, cs_off_t maxGap) const {
+            return offset >= start && offset <= end + maxGap;
+        }
+
+        cs_off_t start = 0;
+        cs_off_t end = 0;
+    };
+
+    struct ReadaheadFile {
+        explicit ReadaheadFile(couch_file_handle orig_handle)
+            : orig_handle(orig_handle) {
+        }
+
+        couch_file_handle orig_handle;
+        /// The sequential stream of reads being followed; end is the end of
+        /// the readahead requested for it.
+        Range stream;
+        /// The last read which wasn't part of stream; if the next read
+        /// continues on from it, it becomes the new stream.
+        Range lastRead;
+    };
+
+    /// Issue readahead for a read of [offset, offset + nbytes) if needed.
+    void maybeReadahead(ReadaheadFile& rf, cs_off_t offset, size_t nbytes);
+
+    FileOpsInterface& wrapped_ops;
+    const size_t readaheadSize;
+    const size_t maxGap;
+};
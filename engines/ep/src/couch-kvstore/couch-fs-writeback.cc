@@ -0,0 +1,124 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couch-kvstore/couch-fs-writeback.h"
+
+#include <algorithm>
+
+couch_file_handle WritebackOps::constructor(couchstore_error_info_t* errinfo) {
+    auto* wf = new WritebackFile(wrapped_ops.constructor(errinfo));
+    return reinterpret_cast<couch_file_handle>(wf);
+}
+
+couchstore_error_t WritebackOps::open(couchstore_error_info_t* errinfo,
+                                      couch_file_handle* h,
+                                      const char* path,
+                                      int flags) {
+    auto* wf = reinterpret_cast<WritebackFile*>(*h);
+    wf->reset();
+    return wrapped_ops.open(errinfo, &wf->orig_handle, path, flags);
+}
+
+couchstore_error_t WritebackOps::close(couchstore_error_info_t* errinfo,
+                                       couch_file_handle h) {
+    auto* wf = reinterpret_cast<WritebackFile*>(h);
+    return wrapped_ops.close(errinfo, wf->orig_handle);
+}
+
+couchstore_error_t WritebackOps::set_periodic_sync(couch_file_handle h,
+                                                   uint64_t period_bytes) {
+    auto* wf = reinterpret_cast<WritebackFile*>(h);
+    return wrapped_ops.set_periodic_sync(wf->orig_handle, period_bytes);
+}
+
+ssize_t WritebackOps::pread(couchstore_error_info_t* errinfo,
+                            couch_file_handle h,
+                            void* buf,
+                            size_t sz,
+                            cs_off_t off) {
+    auto* wf = reinterpret_cast<WritebackFile*>(h);
+    return wrapped_ops.pread(errinfo, wf->orig_handle, buf, sz, off);
+}
+
+ssize_t WritebackOps::pwrite(couchstore_error_info_t* errinfo,
+                             couch_file_handle h,
+                             const void* buf,
+                             size_t sz,
+                             cs_off_t off) {
+    auto* wf = reinterpret_cast<WritebackFile*>(h);
+    const ssize_t written =
+            wrapped_ops.pwrite(errinfo, wf->orig_handle, buf, sz, off);
+    if (writebackBytes == 0 || written <= 0) {
+        return written;
+    }
+
+    if (wf->start == wf->end) {
+        wf->start = off;
+        wf->end = off + written;
+    } else {
+        wf->start = std::min(wf->start, off);
+        wf->end = std::max(wf->end, cs_off_t(off + written));
+    }
+
+    if (size_t(wf->end - wf->start) >= writebackBytes) {
+        // Only advisory; ignore any error.
+        couchstore_error_info_t adviseErrinfo;
+        wrapped_ops.advise(&adviseErrinfo,
+                           wf->orig_handle,
+                           wf->start,
+                           wf->end - wf->start,
+                           COUCHSTORE_FILE_ADVICE_DONTNEED);
+        wf->reset();
+    }
+    return written;
+}
+
+cs_off_t WritebackOps::goto_eof(couchstore_error_info_t* errinfo,
+                                couch_file_handle h) {
+    auto* wf = reinterpret_cast<WritebackFile*>(h);
+    return wrapped_ops.goto_eof(errinfo, wf->orig_handle);
+}
+
+couchstore_error_t WritebackOps::sync(couchstore_error_info_t* errinfo,
+                                      couch_file_handle h) {
+    auto* wf = reinterpret_cast<WritebackFile*>(h);
+    const auto err = wrapped_ops.sync(errinfo, wf->orig_handle);
+    if (err == COUCHSTORE_SUCCESS) {
+        wf->reset();
+    }
+    return err;
+}
+
+couchstore_error_t WritebackOps::advise(couchstore_error_info_t* errinfo,
+                                        couch_file_handle h,
+                                        cs_off_t offs,
+                                        cs_off_t len,
+                                        couchstore_file_advice_t adv) {
+    auto* wf = reinterpret_cast<WritebackFile*>(h);
+    return wrapped_ops.advise(errinfo, wf->orig_handle, offs, len, adv);
+}
+
+FileOpsInterface::FHStats* WritebackOps::get_stats(couch_file_handle h) {
+    auto* wf = reinterpret_cast<WritebackFile*>(h);
+    return wrapped_ops.get_stats(wf->orig_handle);
+}
+
+void WritebackOps::destructor(couch_file_handle h) {
+    auto* wf = reinterpret_cast<WritebackFile*>(h);
+    wrapped_ops.destructor(wf->orig_handle);
+    delete wf;
+}
@@ -0,0 +1,97 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <libcouchstore/couch_db.h>
+
+/**
+ * FileOpsInterface implementation which starts the writeback of what has
+ * been written to a file every writebackBytes bytes, without waiting for
+ * it, so that by the time the writer syncs the file (a flush's commit, or a
+ * periodic sync of compaction; see fsync_after_every_n_bytes_written) little
+ * is left to be written and the sync is short.
+ *
+ * couchstore's FileOps have no sync_file_range(SYNC_FILE_RANGE_WRITE); a
+ * DONTNEED advice for the range written is used instead, which on Linux
+ * starts the asynchronous writeback of its dirty pages (and drops those
+ * already clean). On other platforms it may only drop clean pages.
+ */
+class WritebackOps : public FileOpsInterface {
+public:
+    /**
+     * @param ops FileOps implementation to wrap
+     * @param writebackBytes bytes to write between the start of each
+     *        writeback; 0 makes this a pass-through.
+     */
+    WritebackOps(FileOpsInterface& ops, size_t writebackBytes)
+        : wrapped_ops(ops), writebackBytes(writebackBytes) {
+    }
+
+    couch_file_handle constructor(couchstore_error_info_t* errinfo) override;
+    couchstore_error_t open(couchstore_error_info_t* errinfo,
+                            couch_file_handle* handle,
+                            const char* path,
+                            int oflag) override;
+    couchstore_error_t close(couchstore_error_info_t* errinfo,
+                             couch_file_handle handle) override;
+    couchstore_error_t set_periodic_sync(couch_file_handle handle,
+                                         uint64_t period_bytes) override;
+    ssize_t pread(couchstore_error_info_t* errinfo,
+                  couch_file_handle handle,
+                  void* buf,
+                  size_t nbytes,
+                  cs_off_t offset) override;
+    ssize_t pwrite(couchstore_error_info_t* errinfo,
+                   couch_file_handle handle,
+                   const void* buf,
+                   size_t nbytes,
+                   cs_off_t offset) override;
+    cs_off_t goto_eof(couchstore_error_info_t* errinfo,
+                      couch_file_handle handle) override;
+    couchstore_error_t sync(couchstore_error_info_t* errinfo,
+                            couch_file_handle handle) override;
+    couchstore_error_t advise(couchstore_error_info_t* errinfo,
+                              couch_file_handle handle,
+                              cs_off_t offset,
+                              cs_off_t len,
+                              couchstore_file_advice_t advice) override;
+    FHStats* get_stats(couch_file_handle handle) override;
+    void destructor(couch_file_handle handle) override;
+
+protected:
+    struct WritebackFile {
+        explicit WritebackFile(couch_file_handle orig_handle)
+            : orig_handle(orig_handle) {
+        }
+
+        /// Forget what was written; it has been synced.
+        void reset() {
+            start = 0;
+            end = 0;
+        }
+
+        couch_file_handle orig_handle;
+        /// Range [start, end) written since writeback was last started (or
+        /// the file synced); couchstore only appends.
+        cs_off_t start = 0;
+        cs_off_t end = 0;
+    };
+
+    FileOpsInterface& wrapped_ops;
+    const size_t writebackBytes;
+};
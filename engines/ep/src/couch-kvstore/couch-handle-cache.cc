@@ -0,0 +1,140 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "couch-kvstore/couch-handle-cache.h"
+
+#include <tuple>
+
+CouchHandleCache::CouchHandleCache(size_t capacity, CloseFn close)
+    : capacity(capacity),
+      close(std::move(close)),
+      hits(0),
+      misses(0),
+      evictions(0) {
+}
+
+CouchHandleCache::~CouchHandleCache() {
+    clear();
+}
+
+Db* CouchHandleCache::take(Vbid vbid, uint64_t fileRev, uint64_t generation) {
+    Db* stale = nullptr;
+    {
+        std::lock_guard<std::mutex> lh(mutex);
+        auto it = index.find(vbid.get());
+        if (it != index.end()) {
+            const auto entry = *it->second;
+            lru.erase(it->second);
+            index.erase(it);
+            if (entry.fileRev == fileRev && entry.generation == generation) {
+                ++hits;
+                return entry.db;
+            }
+            stale = entry.db;
+        }
+    }
+
+    ++misses;
+    if (stale) {
+        close(stale);
+    }
+    return nullptr;
+}
+
+void CouchHandleCache::put(Vbid vbid,
+                           uint64_t fileRev,
+                           uint64_t generation,
+                           Db* db) {
+    if (!isEnabled()) {
+        close(db);
+        return;
+    }
+
+    std::vector<Db*> toClose;
+    {
+        std::lock_guard<std::mutex> lh(mutex);
+        auto it = index.find(vbid.get());
+        if (it != index.end()) {
+            // Another reader returned a handle for the vBucket first; keep
+            // whichever is the newer.
+            auto& existing = *it->second;
+            if (std::tie(existing.fileRev, existing.generation) >=
+                std::tie(fileRev, generation)) {
+                toClose.push_back(db);
+                db = nullptr;
+            } else {
+                toClose.push_back(existing.db);
+                lru.erase(it->second);
+                index.erase(it);
+            }
+        }
+
+        if (db) {
+            lru.push_front({vbid, fileRev, generation, db});
+            index[vbid.get()] = lru.begin();
+            while (lru.size() > capacity) {
+                toClose.push_back(lru.back().db);
+                index.erase(lru.back().vbid.get());
+                lru.pop_back();
+                ++evictions;
+            }
+        }
+    }
+    closeAll(toClose);
+}
+
+void CouchHandleCache::purgeOldRevisions(
+        const std::function<uint64_t(Vbid)>& currentRev) {
+    std::vector<Db*> toClose;
+    {
+        std::lock_guard<std::mutex> lh(mutex);
+        for (auto it = lru.begin(); it != lru.end();) {
+            if (it->fileRev != currentRev(it->vbid)) {
+                toClose.push_back(it->db);
+                index.erase(it->vbid.get());
+                it = lru.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    closeAll(toClose);
+}
+
+void CouchHandleCache::clear() {
+    std::vector<Db*> toClose;
+    {
+        std::lock_guard<std::mutex> lh(mutex);
+        for (auto& entry : lru) {
+            toClose.push_back(entry.db);
+        }
+        lru.clear();
+        index.clear();
+    }
+    closeAll(toClose);
+}
+
+size_t CouchHandleCache::size() const {
+    std::lock_guard<std::mutex> lh(mutex);
+    return lru.size();
+}
+
+void CouchHandleCache::closeAll(const std::vector<Db*>& handles) {
+    for (auto* db : handles) {
+        close(db);
+    }
+}
@@ -0,0 +1,137 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "libcouchstore/couch_db.h"
+
+#include <memcached/vbucket.h>
+#include <relaxed_atomic.h>
+
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * A bounded LRU cache of idle, read-only couchstore Db handles, so that
+ * reads (BG fetches in particular) don't have to open the file, read and
+ * validate its header and rebuild the btree roots for every batch.
+ *
+ * A couchstore handle sees the file as of the header it was opened with, so
+ * each cached handle is tagged with the file revision and the "header
+ * generation" current when it was opened. The generation of a vBucket must
+ * be incremented (after the fact) whenever a new header is committed to
+ * its file; a handle is only handed out again while both still match,
+ * otherwise it is closed and the caller opens a fresh one.
+ *
+ * A handle is used by one reader at a time: take() removes it from the
+ * cache and put() returns it. At most one idle handle is kept per vBucket.
+ *
+ * Thread safe. Handles are closed (with the function given to the
+ * constructor) outside of the cache's lock.
+ */
+class CouchHandleCache {
+public:
+    using CloseFn = std::function<void(Db*)>;
+
+    /**
+     * @param capacity maximum number of idle handles to keep (0 disables
+     *        the cache - put() closes every handle)
+     * @param close function to close a handle the cache no longer wants
+     */
+    CouchHandleCache(size_t capacity, CloseFn close);
+
+    /// Closes all the cached handles.
+    ~CouchHandleCache();
+
+    CouchHandleCache(const CouchHandleCache&) = delete;
+    CouchHandleCache& operator=(const CouchHandleCache&) = delete;
+
+    bool isEnabled() const {
+        return capacity != 0;
+    }
+
+    /**
+     * Take the cached handle of the given vBucket file, if there is one and
+     * it was opened at the given generation.
+     *
+     * @return the handle (now owned by the caller), or nullptr on a miss.
+     */
+    Db* take(Vbid vbid, uint64_t fileRev, uint64_t generation);
+
+    /**
+     * Return a handle to the cache (or close it, if the cache already has a
+     * handle at least as new for the vBucket). The least recently used
+     * handle is closed if the cache is full.
+     *
+     * @param fileRev file revision the handle was opened for
+     * @param generation header generation read before the handle was opened
+     */
+    void put(Vbid vbid, uint64_t fileRev, uint64_t generation, Db* db);
+
+    /**
+     * Close every cached handle of a file revision other than the current
+     * one of its vBucket (as given by currentRev), so that the cache doesn't
+     * keep the files compaction replaced (and unlinked) open.
+     */
+    void purgeOldRevisions(const std::function<uint64_t(Vbid)>& currentRev);
+
+    /// Close all the cached handles.
+    void clear();
+
+    size_t size() const;
+
+    size_t getHits() const {
+        return hits;
+    }
+
+    size_t getMisses() const {
+        return misses;
+    }
+
+    size_t getEvictions() const {
+        return evictions;
+    }
+
+private:
+    struct Entry {
+        Vbid vbid;
+        uint64_t fileRev;
+        uint64_t generation;
+        Db* db;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    /// Close the given handles (without the lock held).
+    void closeAll(const std::vector<Db*>& handles);
+
+    const size_t capacity;
+    const CloseFn close;
+
+    mutable std::mutex mutex;
+    /// Idle handles, most recently used first.
+    EntryList lru;
+    /// vBucket to its entry in lru.
+    std::unordered_map<uint16_t, EntryList::iterator> index;
+
+    cb::RelaxedAtomic<size_t> hits;
+    cb::RelaxedAtomic<size_t> misses;
+    cb::RelaxedAtomic<size_t> evictions;
+};
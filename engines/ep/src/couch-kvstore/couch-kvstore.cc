@@ -20,6 +20,12 @@
 #include "collections/collection_persisted_stats.h"
 #include "collections/kvstore_generated.h"
 #include "common.h"
+#include "couch-kvstore/couch-fs-drop-behind.h"
+#include "couch-kvstore/couch-fs-encryption.h"
+#include "couch-kvstore/couch-fs-header-seek.h"
+#include "couch-kvstore/couch-fs-readahead.h"
+#include "couch-kvstore/couch-fs-throttle.h"
+#include "couch-kvstore/couch-fs-writeback.h"
 #include "diskdockey.h"
 #include "ep_time.h"
 #include "item.h"
@@ -35,6 +41,9 @@
 #include <platform/dirutils.h>
 #include <gsl/gsl>
 
+#include <algorithm>
+#include <cstring>
+
 extern "C" {
     static int recordDbDumpC(Db *db, DocInfo *docinfo, void *ctx)
     {
@@ -199,6 +208,41 @@ static std::unique_ptr<Item> makeItemFromDocInfo(Vbid vbid,
     return item;
 }
 
+/// Bytes couchstore stores for a document besides its (compressed) body: the
+/// chunk header (length and CRC).
+static const size_t docChunkOverhead = 8;
+
+/// Largest single read getMulti merges the reads of documents into.
+static const size_t maxMergedReadSize = 1024 * 1024;
+
+/// Local document holding a vBucket file's rollback index.
+static constexpr const char* rollbackIndexName = "_local/rollback_index";
+
+/// Most headers a vBucket's rollback index holds; the oldest are dropped.
+static const size_t rollbackIndexMaxEntries = 1024;
+
+/**
+ * Copy of a couchstore DocInfo which owns the buffers it references, so it
+ * remains valid after the couchstore callback it was obtained from returns.
+ */
+struct OwnedDocInfo {
+    explicit OwnedDocInfo(const DocInfo& src)
+        : info(src),
+          id(src.id.buf, src.id.buf + src.id.size),
+          revMeta(src.rev_meta.buf, src.rev_meta.buf + src.rev_meta.size) {
+        info.id.buf = id.data();
+        info.rev_meta.buf = revMeta.data();
+    }
+
+    // Moving the vectors preserves their buffers, so info stays valid.
+    OwnedDocInfo(OwnedDocInfo&&) = default;
+    OwnedDocInfo& operator=(OwnedDocInfo&&) = default;
+
+    DocInfo info;
+    std::vector<char> id;
+    std::vector<char> revMeta;
+};
+
 struct GetMultiCbCtx {
     GetMultiCbCtx(CouchKVStore& c, Vbid v, vb_bgfetch_queue_t& f)
         : cks(c), vbId(v), fetches(f) {
@@ -207,6 +251,11 @@ struct GetMultiCbCtx {
     CouchKVStore &cks;
     Vbid vbId;
     vb_bgfetch_queue_t &fetches;
+
+    /// If true, getMultiCb only records each DocInfo in docInfos, for the
+    /// documents to be read afterwards (in file offset order).
+    bool deferReads = false;
+    std::vector<OwnedDocInfo> docInfos;
 };
 
 struct AllKeysCtx {
@@ -311,18 +360,71 @@ CouchKVStore::CouchKVStore(KVStoreConfig& config)
 CouchKVStore::CouchKVStore(KVStoreConfig& config,
                            FileOpsInterface& ops,
                            bool readOnly,
-                           std::shared_ptr<RevisionMap> dbFileRevMap)
+                           std::shared_ptr<RevisionMap> dbFileRevMap,
+                           std::shared_ptr<HeaderGenerations> headerGenerations,
+                           std::shared_ptr<CouchBlockCache> blockCache)
     : KVStore(config, readOnly),
       dbname(config.getDBName()),
       dbFileRevMap(dbFileRevMap),
+      headerGenerations(headerGenerations),
       intransaction(false),
+      blockCache(blockCache),
       scanCounter(0),
       logger(config.getLogger()),
       base_ops(ops) {
     createDataDir(dbname);
-    statCollectingFileOps = getCouchstoreStatsOps(st.fsStats, base_ops);
+    if (!config.getEncryptionKeyFile().empty()) {
+        encryptedFileOps = std::make_unique<EncryptedOps>(
+                base_ops,
+                EncryptedOps::loadKey(config.getEncryptionKeyFile()));
+    }
+    auto& fileOps = encryptedFileOps ? *encryptedFileOps : base_ops;
+    statCollectingFileOps = getCouchstoreStatsOps(st.fsStats, fileOps);
     statCollectingFileOpsCompaction = getCouchstoreStatsOps(
-        st.fsStatsCompaction, base_ops);
+        st.fsStatsCompaction, fileOps);
+    if (config.getWritebackBytes() != 0) {
+        writebackFileOps = std::make_unique<WritebackOps>(
+                *statCollectingFileOps, config.getWritebackBytes());
+        compactionWritebackFileOps = std::make_unique<WritebackOps>(
+                *statCollectingFileOpsCompaction, config.getWritebackBytes());
+    }
+    if (config.getCompactionDropBehindSize() != 0) {
+        compactionDropBehindFileOps = std::make_unique<DropBehindOps>(
+                compactionWritebackFileOps ? *compactionWritebackFileOps
+                                           : *statCollectingFileOpsCompaction,
+                config.getCompactionDropBehindSize());
+    }
+    if (config.getBackfillDropBehindSize() != 0) {
+        scanDropBehindFileOps = std::make_unique<DropBehindOps>(
+                *statCollectingFileOps, config.getBackfillDropBehindSize());
+    }
+    if (config.getBackfillReadaheadSize() != 0) {
+        scanFileOps = std::make_unique<ReadaheadOps>(
+                scanDropBehindFileOps ? *scanDropBehindFileOps
+                                      : *statCollectingFileOps,
+                config.getBackfillReadaheadSize());
+    }
+    if (config.getWarmupReadaheadSize() != 0) {
+        // The documents read are sparse, so allow reads to skip up to a
+        // readahead window and still count as sequential.
+        warmupFileOps =
+                std::make_unique<ReadaheadOps>(*statCollectingFileOps,
+                                               config.getWarmupReadaheadSize(),
+                                               config.getWarmupReadaheadSize());
+    }
+    readFileOps = statCollectingFileOps.get();
+    if (blockCache) {
+        blockCacheFileOps =
+                std::make_unique<BlockCacheOps>(*readFileOps, *blockCache);
+        readFileOps = blockCacheFileOps.get();
+    }
+    if (config.getBgFetchOffsetOrder()) {
+        mergedReadFileOps = std::make_unique<MergedReadOps>(*readFileOps);
+        readFileOps = mergedReadFileOps.get();
+    }
+    readHandleCache = std::make_unique<CouchHandleCache>(
+            config.getReadHandleCacheSize(),
+            [this](Db* db) { closeDatabaseHandle(db); });
 
     // init db file map with default revision number, 1
     numDbFiles = configuration.getMaxVBuckets();
@@ -333,7 +435,12 @@ CouchKVStore::CouchKVStore(KVStoreConfig& config,
     cachedDeleteCount.assign(numDbFiles, cb::RelaxedAtomic<size_t>(-1));
     cachedFileSize.assign(numDbFiles, cb::RelaxedAtomic<uint64_t>(0));
     cachedSpaceUsed.assign(numDbFiles, cb::RelaxedAtomic<uint64_t>(0));
+    droppedItemsPendingPurge.assign(numDbFiles,
+                                    cb::RelaxedAtomic<uint64_t>(0));
     cachedVBStates.resize(numDbFiles);
+    rollbackIndexes.resize(numDbFiles);
+    vbWriteMutexes = std::vector<std::mutex>(numDbFiles);
+    vbRollbackCount.assign(numDbFiles, cb::RelaxedAtomic<uint64_t>(0));
 
     initialize();
 }
@@ -342,7 +449,13 @@ CouchKVStore::CouchKVStore(KVStoreConfig& config, FileOpsInterface& ops)
     : CouchKVStore(config,
                    ops,
                    false /*readonly*/,
-                   std::make_shared<RevisionMap>(config.getMaxVBuckets())) {
+                   std::make_shared<RevisionMap>(config.getMaxVBuckets()),
+                   std::make_shared<HeaderGenerations>(
+                           config.getMaxVBuckets()),
+                   config.getBlockCacheSize() != 0
+                           ? std::make_shared<CouchBlockCache>(
+                                     config.getBlockCacheSize())
+                           : nullptr) {
 }
 
 /**
@@ -351,15 +464,22 @@ CouchKVStore::CouchKVStore(KVStoreConfig& config, FileOpsInterface& ops)
 std::unique_ptr<CouchKVStore> CouchKVStore::makeReadOnlyStore() {
     // Not using make_unique due to the private constructor we're calling
     return std::unique_ptr<CouchKVStore>(
-            new CouchKVStore(configuration, dbFileRevMap));
+            new CouchKVStore(configuration,
+                             dbFileRevMap,
+                             headerGenerations,
+                             blockCache));
 }
 
 CouchKVStore::CouchKVStore(KVStoreConfig& config,
-                           std::shared_ptr<RevisionMap> dbFileRevMap)
+                           std::shared_ptr<RevisionMap> dbFileRevMap,
+                           std::shared_ptr<HeaderGenerations> headerGenerations,
+                           std::shared_ptr<CouchBlockCache> blockCache)
     : CouchKVStore(config,
                    *couchstore_get_default_file_ops(),
                    true /*readonly*/,
-                   dbFileRevMap) {
+                   dbFileRevMap,
+                   headerGenerations,
+                   blockCache) {
 }
 
 void CouchKVStore::initialize() {
@@ -409,6 +529,7 @@ void CouchKVStore::initialize() {
 }
 
 CouchKVStore::~CouchKVStore() {
+    readHandleCache->clear();
     close();
 }
 
@@ -426,13 +547,22 @@ void CouchKVStore::reset(Vbid vbucketId) {
         cachedDeleteCount[vbucketId.get()] = 0;
         cachedFileSize[vbucketId.get()] = 0;
         cachedSpaceUsed[vbucketId.get()] = 0;
+        droppedItemsPendingPurge[vbucketId.get()] = 0;
 
         // Unlink the current revision and then increment it to ensure any
         // pending delete doesn't delete us. Note that the expectation is that
         // some higher level per VB lock is required to prevent data-races here.
-        // KVBucket::vb_mutexes is used in this case.
-        unlinkCouchFile(vbucketId, (*dbFileRevMap)[vbucketId.get()]);
-        incrementRevision(vbucketId);
+        // KVBucket::vb_mutexes is used in this case. A concurrent compaction
+        // doesn't hold that, so the write mutex is held across both (and the
+        // compaction told to discard its file), else the compaction could
+        // switch in a revision between them which would then be orphaned.
+        {
+            std::lock_guard<std::mutex> lg(vbWriteMutexes[vbucketId.get()]);
+            ++vbRollbackCount[vbucketId.get()];
+            unlinkCouchFile(vbucketId, (*dbFileRevMap)[vbucketId.get()]);
+            (*dbFileRevMap)[vbucketId.get()]++;
+            fileRevisionChanged(vbucketId);
+        }
 
         setVBucketState(
                 vbucketId, *state, VBStatePersist::VBSTATE_PERSIST_WITH_COMMIT);
@@ -460,7 +590,7 @@ void CouchKVStore::set(const Item& itm, SetCallback cb) {
 
 GetValue CouchKVStore::get(const DiskDocKey& key, Vbid vb, bool fetchDelete) {
     DbHolder db(*this);
-    couchstore_error_t errCode = openDB(vb, db, COUCHSTORE_OPEN_FLAG_RDONLY);
+    couchstore_error_t errCode = openCachedDB(vb, db);
     if (errCode != COUCHSTORE_SUCCESS) {
         ++st.numGetFailure;
         logger.warn("CouchKVStore::get: openDB error:{}, {}",
@@ -470,6 +600,10 @@ GetValue CouchKVStore::get(const DiskDocKey& key, Vbid vb, bool fetchDelete) {
     }
 
     GetValue gv = getWithHeader(db, key, vb, GetMetaOnly::No, fetchDelete);
+    if (gv.getStatus() != ENGINE_SUCCESS &&
+        gv.getStatus() != ENGINE_KEY_ENOENT) {
+        db.setUncacheable();
+    }
     return gv;
 }
 
@@ -533,13 +667,32 @@ GetValue CouchKVStore::getWithHeader(void* dbHandle,
 }
 
 void CouchKVStore::getMulti(Vbid vb, vb_bgfetch_queue_t& itms) {
+    getMultiImpl(vb, itms, configuration.getBgFetchOffsetOrder(), nullptr);
+}
+
+void CouchKVStore::getMultiSequential(Vbid vb, vb_bgfetch_queue_t& itms) {
+    if (!warmupFileOps) {
+        getMulti(vb, itms);
+        return;
+    }
+    getMultiImpl(vb, itms, true, warmupFileOps.get());
+}
+
+void CouchKVStore::getMultiImpl(Vbid vb,
+                                vb_bgfetch_queue_t& itms,
+                                bool offsetOrder,
+                                FileOpsInterface* ops) {
     if (itms.empty()) {
         return;
     }
     int numItems = itms.size();
 
+    // Other FileOps (readahead) are specific to this read, so only handles
+    // with the default ones are cached.
     DbHolder db(*this);
-    couchstore_error_t errCode = openDB(vb, db, COUCHSTORE_OPEN_FLAG_RDONLY);
+    couchstore_error_t errCode =
+            ops ? openDB(vb, db, COUCHSTORE_OPEN_FLAG_RDONLY, ops)
+                : openCachedDB(vb, db);
     if (errCode != COUCHSTORE_SUCCESS) {
         logger.warn(
                 "CouchKVStore::getMulti: openDB error:{}, "
@@ -554,6 +707,10 @@ void CouchKVStore::getMulti(Vbid vb, vb_bgfetch_queue_t& itms) {
         return;
     }
 
+    auto* initialStats = couchstore_get_db_filestats(db);
+    const size_t initialReadCount =
+            initialStats ? initialStats->getReadCount() : 0;
+
     size_t idx = 0;
     std::vector<sized_buf> ids(itms.size());
     for (auto& item : itms) {
@@ -561,11 +718,45 @@ void CouchKVStore::getMulti(Vbid vb, vb_bgfetch_queue_t& itms) {
         ++idx;
     }
 
+    st.getMultiBatchSizeHisto.add(itms.size());
+
     GetMultiCbCtx ctx(*this, vb, itms);
+    if (offsetOrder) {
+        ctx.deferReads = true;
+        ctx.docInfos.reserve(itms.size());
+    }
 
     errCode = couchstore_docinfos_by_id(
             db, ids.data(), itms.size(), 0, getMultiCbC, &ctx);
+    if (errCode == COUCHSTORE_SUCCESS && ctx.deferReads) {
+        // All documents located; now read them in the order they appear in
+        // the file so the reads are (mostly) sequential.
+        std::sort(ctx.docInfos.begin(),
+                  ctx.docInfos.end(),
+                  [](const OwnedDocInfo& a, const OwnedDocInfo& b) {
+                      return a.info.bp < b.info.bp;
+                  });
+        // Merge the reads of documents close together in the file (if the
+        // handle reads through mergedReadFileOps).
+        MergedReadOps::Plan plan(configuration.getBgFetchMergeGap(),
+                                 maxMergedReadSize);
+        if (!ops && mergedReadFileOps) {
+            for (const auto& docInfo : ctx.docInfos) {
+                auto it = itms.find(makeDiskDocKey(docInfo.info.id));
+                if (it != itms.end() &&
+                    it->second.isMetaOnly == GetMetaOnly::No) {
+                    plan.add(docInfo.info.bp,
+                             docInfo.info.size + docChunkOverhead);
+                }
+            }
+        }
+        MergedReadOps::ScopedPlan scopedPlan(plan);
+        for (auto& docInfo : ctx.docInfos) {
+            getMultiFetchDoc(db, &docInfo.info, ctx);
+        }
+    }
     if (errCode != COUCHSTORE_SUCCESS) {
+        db.setUncacheable();
         st.numGetFailure += numItems;
         logger.warn(
                 "CouchKVStore::getMulti: "
@@ -579,24 +770,26 @@ void CouchKVStore::getMulti(Vbid vb, vb_bgfetch_queue_t& itms) {
     }
 
     // If available, record how many reads() we did for this getMulti;
-    // and the average reads per document.
+    // and the average reads per document. (A cached handle's count includes
+    // the reads of earlier requests.)
     auto* stats = couchstore_get_db_filestats(db);
     if (stats != nullptr) {
-        const auto readCount = stats->getReadCount();
+        const auto readCount = stats->getReadCount() - initialReadCount;
         st.getMultiFsReadCount += readCount;
         st.getMultiFsReadHisto.add(readCount);
         st.getMultiFsReadPerDocHisto.add(readCount / itms.size());
     }
 }
 
-void CouchKVStore::getRange(Vbid vb,
-                            const DiskDocKey& startKey,
-                            const DiskDocKey& endKey,
-                            const KVStore::GetRangeCb& cb) {
+void CouchKVStore::scanRange(Vbid vb,
+                             const DiskDocKey& startKey,
+                             const DiskDocKey& endKey,
+                             ValueFilter filter,
+                             const KVStore::ScanRangeCb& cb) {
     DbHolder db(*this);
-    auto errCode = openDB(vb, db, COUCHSTORE_OPEN_FLAG_RDONLY);
+    auto errCode = openCachedDB(vb, db);
     if (errCode != COUCHSTORE_SUCCESS) {
-        throw std::runtime_error("CouchKVStore::getRange: openDB error for " +
+        throw std::runtime_error("CouchKVStore::scanRange: openDB error for " +
                                  vb.to_string() +
                                  " - couchstore returned error: " +
                                  couchstore_strerror(errCode));
@@ -607,9 +800,10 @@ void CouchKVStore::getRange(Vbid vb,
     struct TrampolineState {
         Vbid vb;
         const DiskDocKey& endKey;
-        const KVStore::GetRangeCb& userFunc;
+        ValueFilter filter;
+        const KVStore::ScanRangeCb& userFunc;
     };
-    TrampolineState trampoline_state{vb, endKey, cb};
+    TrampolineState trampoline_state{vb, endKey, filter, cb};
 
     // Trampoline to fetch the document value, and map C++ std::function to
     // C-style callback expected by couchstore.
@@ -639,20 +833,45 @@ void CouchKVStore::getRange(Vbid vb,
             return COUCHSTORE_ERROR_DB_NO_LONGER_VALID;
         }
 
-        // Fetch document value.
+        if (state.filter == ValueFilter::KEYS_ONLY) {
+            auto it = makeItemFromDocInfo(
+                    state.vb, *docinfo, *metadata, {nullptr, 0});
+            const bool more = state.userFunc(
+                    GetValue{std::move(it), ENGINE_SUCCESS, -1, true});
+            return more ? COUCHSTORE_SUCCESS : COUCHSTORE_ERROR_CANCEL;
+        }
+
+        // Fetch document value. As with a DCP backfill, documents are only
+        // returned compressed (as stored) if the caller asked for that and
+        // the metadata records their datatype.
+        couchstore_open_options openOptions = DECOMPRESS_DOC_BODIES;
+        if (state.filter == ValueFilter::VALUES_COMPRESSED &&
+            metadata->getVersionInitialisedFrom() != MetaData::Version::V0) {
+            openOptions = 0;
+        }
         Doc* doc = nullptr;
         auto errCode = couchstore_open_doc_with_docinfo(
-                db, docinfo, &doc, DECOMPRESS_DOC_BODIES);
+                db, docinfo, &doc, openOptions);
         if (errCode != COUCHSTORE_SUCCESS) {
             // Failed to fetch document - cancel couchstore_docinfos_by_id
             // scan.
             return errCode;
         }
 
-        state.userFunc(GetValue{
+        if (doc->data.size == 0) {
+            metadata->setDataType(PROTOCOL_BINARY_RAW_BYTES);
+        } else if (openOptions == 0) {
+            metadata->setDataType(metadata->getDataType() |
+                                  PROTOCOL_BINARY_DATATYPE_SNAPPY);
+        } else if (metadata->getVersionInitialisedFrom() ==
+                   MetaData::Version::V0) {
+            metadata->setDataType(determine_datatype(doc->data));
+        }
+
+        const bool more = state.userFunc(GetValue{
                 makeItemFromDocInfo(state.vb, *docinfo, *metadata, doc->data)});
         couchstore_free_document(doc);
-        return COUCHSTORE_SUCCESS;
+        return more ? COUCHSTORE_SUCCESS : COUCHSTORE_ERROR_CANCEL;
     };
 
     const std::array<sized_buf, 2> range = {
@@ -663,9 +882,10 @@ void CouchKVStore::getRange(Vbid vb,
                                         RANGES,
                                         callback_trampoline,
                                         &trampoline_state);
-    if (errCode != COUCHSTORE_SUCCESS) {
+    if (errCode != COUCHSTORE_SUCCESS && errCode != COUCHSTORE_ERROR_CANCEL) {
+        db.setUncacheable();
         throw std::runtime_error(
-                "CouchKVStore::getRange: docinfos_by_id failed for " +
+                "CouchKVStore::scanRange: docinfos_by_id failed for " +
                 vb.to_string() + " - couchstore returned error: " +
                 couchstore_strerror(errCode));
     }
@@ -690,7 +910,9 @@ void CouchKVStore::delVBucket(Vbid vbucket, uint64_t fileRev) {
                         "read-only object.");
     }
 
+    std::lock_guard<std::mutex> lg(vbWriteMutexes[vbucket.get()]);
     unlinkCouchFile(vbucket, fileRev);
+    fileRevisionChanged(vbucket);
 }
 
 std::vector<vbucket_state *> CouchKVStore::listPersistedVbuckets() {
@@ -1022,7 +1244,22 @@ bool CouchKVStore::compactDBInternal(compaction_ctx* hook_ctx,
     }
     couchstore_compact_hook       hook = time_purge_hook;
     couchstore_docinfo_hook dhook = docinfo_hook;
-    FileOpsInterface         *def_iops = statCollectingFileOpsCompaction.get();
+    FileOpsInterface* def_iops = statCollectingFileOpsCompaction.get();
+    if (compactionDropBehindFileOps) {
+        def_iops = compactionDropBehindFileOps.get();
+    } else if (compactionWritebackFileOps) {
+        def_iops = compactionWritebackFileOps.get();
+    }
+    // The bulk of the compaction's IO is paced by the bucket's throttle (if
+    // any). Catching up is not - the flusher may be blocked meanwhile.
+    // (Declared before compactdb, which uses it until closed.)
+    FileOpsInterface* compact_iops = def_iops;
+    std::unique_ptr<ThrottledOps> throttledOps;
+    if (hook_ctx->throttle) {
+        throttledOps = std::make_unique<ThrottledOps>(
+                *def_iops, *hook_ctx->throttle, hook_ctx->throttleDeferred);
+        compact_iops = throttledOps.get();
+    }
     DbHolder compactdb(*this);
     DbHolder targetDb(*this);
     couchstore_error_t         errCode = COUCHSTORE_SUCCESS;
@@ -1038,8 +1275,10 @@ bool CouchKVStore::compactDBInternal(compaction_ctx* hook_ctx,
     TRACE_EVENT1("CouchKVStore", "compactDB", "vbid", vbid.get());
 
     // Open the source VBucket database file ...
-    errCode = openDB(
-            vbid, compactdb, (uint64_t)COUCHSTORE_OPEN_FLAG_RDONLY, def_iops);
+    errCode = openDB(vbid,
+                     compactdb,
+                     (uint64_t)COUCHSTORE_OPEN_FLAG_RDONLY,
+                     compact_iops);
     if (errCode != COUCHSTORE_SUCCESS) {
         logger.warn("CouchKVStore::compactDB openDB error:{}, {}, fileRev:{}",
                     couchstore_strerror(errCode),
@@ -1051,6 +1290,16 @@ bool CouchKVStore::compactDBInternal(compaction_ctx* hook_ctx,
     hook_ctx->eraserContext = std::make_unique<Collections::VB::EraserContext>(
             getDroppedCollections(*compactdb));
 
+    // If the flusher may write to the vBucket while it is compacted, note
+    // what the compacted file will be missing so it can be caught up.
+    const bool concurrent = configuration.getConcurrentCompaction();
+    std::unique_lock<std::mutex> writeLock(vbWriteMutexes[vbid.get()],
+                                           std::defer_lock);
+    const uint64_t rollbacks = vbRollbackCount[vbid.get()];
+    const auto collectionsMeta =
+            concurrent ? readCollectionsMeta(*compactdb) : std::string();
+    std::chrono::steady_clock::time_point writeBlockStart;
+
     uint64_t new_rev = compactdb.getFileRev() + 1;
 
     // Build the temporary vbucket.compact file name
@@ -1085,7 +1334,7 @@ bool CouchKVStore::compactDBInternal(compaction_ctx* hook_ctx,
                                        hook,
                                        dhook,
                                        hook_ctx,
-                                       def_iops);
+                                       compact_iops);
     if (errCode != COUCHSTORE_SUCCESS) {
         logger.warn(
                 "CouchKVStore::compactDB:couchstore_compact_db_ex "
@@ -1099,9 +1348,23 @@ bool CouchKVStore::compactDBInternal(compaction_ctx* hook_ctx,
     // Close the source Database File once compaction is done
     compactdb.close();
 
+    if (concurrent &&
+        !catchUpCompactedFile(vbid,
+                              compactdb.getFileRev(),
+                              rollbacks,
+                              collectionsMeta,
+                              compact_file,
+                              info.last_sequence,
+                              writeLock,
+                              writeBlockStart,
+                              def_iops)) {
+        removeCompactFile(compact_file);
+        return false;
+    }
+
     // Rename the .compact file to one with the next revision number
     new_file = getDBFileName(dbname, vbid, new_rev);
-    if (rename(compact_file.c_str(), new_file.c_str()) != 0) {
+    if (renameFile(compact_file, new_file) != 0) {
         logger.warn("CouchKVStore::compactDB: rename error:{}, old:{}, new:{}",
                     cb_strerror(),
                     compact_file,
@@ -1125,7 +1388,7 @@ bool CouchKVStore::compactDBInternal(compaction_ctx* hook_ctx,
                 couchstore_strerror(errCode),
                 new_file,
                 targetDb.getFileRev());
-        if (remove(new_file.c_str()) != 0) {
+        if (removeFile(new_file) != 0) {
             logger.warn("CouchKVStore::compactDB: remove error:{}, path:{}",
                         cb_strerror(),
                         new_file);
@@ -1143,6 +1406,7 @@ bool CouchKVStore::compactDBInternal(compaction_ctx* hook_ctx,
         }
         // Need to ensure the 'dropped' list on disk is now gone
         deleteLocalDoc(*targetDb.getDb(), Collections::droppedCollectionsName);
+        droppedItemsPendingPurge[vbid.get()] = 0;
 
         errCode = couchstore_commit(targetDb.getDb());
         if (errCode != COUCHSTORE_SUCCESS) {
@@ -1175,6 +1439,14 @@ bool CouchKVStore::compactDBInternal(compaction_ctx* hook_ctx,
         cachedDocCount[vbid.get()] = info.doc_count;
     }
 
+    if (writeLock.owns_lock()) {
+        writeLock.unlock();
+        st.compactWriteBlockHisto.add(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() -
+                        writeBlockStart));
+    }
+
     // Removing the stale couch file
     unlinkCouchFile(vbid, compactdb.getFileRev());
 
@@ -1184,6 +1456,207 @@ bool CouchKVStore::compactDBInternal(compaction_ctx* hook_ctx,
     return true;
 }
 
+namespace {
+/**
+ * Rounds of catching up without blocking the flusher that a concurrent
+ * compaction makes before it blocks writes to copy whatever remains, so a
+ * vBucket being written faster than it can be caught up still finishes.
+ */
+const size_t maxCatchupRounds = 10;
+
+/// Documents read by copyChangesSince() before they are written out.
+const size_t catchupBatchSize = 1000;
+
+/// State of a copyChangesSince(), passed to catchupCopyCallback.
+struct CatchupCopyContext {
+    explicit CatchupCopyContext(Db& target) : target(target) {
+    }
+
+    ~CatchupCopyContext() {
+        freeBatch();
+    }
+
+    /// Write the buffered documents to the target
+    couchstore_error_t flush() {
+        if (docinfos.empty()) {
+            return COUCHSTORE_SUCCESS;
+        }
+        // The bodies are copied as stored (i.e. already compressed).
+        auto errCode = couchstore_save_documents(&target,
+                                                 docs.data(),
+                                                 docinfos.data(),
+                                                 unsigned(docinfos.size()),
+                                                 COUCHSTORE_SEQUENCE_AS_IS);
+        copied += docinfos.size();
+        freeBatch();
+        return errCode;
+    }
+
+    void freeBatch() {
+        for (auto* doc : docs) {
+            couchstore_free_document(doc);
+        }
+        for (auto* docinfo : docinfos) {
+            couchstore_free_docinfo(docinfo);
+        }
+        docs.clear();
+        docinfos.clear();
+    }
+
+    Db& target;
+    std::vector<Doc*> docs;
+    std::vector<DocInfo*> docinfos;
+    size_t copied = 0;
+    couchstore_error_t error = COUCHSTORE_SUCCESS;
+};
+
+int catchupCopyCallback(Db* db, DocInfo* docinfo, void* ctx) {
+    auto& cctx = *static_cast<CatchupCopyContext*>(ctx);
+
+    // A document without a body (e.g. a deletion) is copied with no Doc.
+    Doc* doc = nullptr;
+    auto errCode = couchstore_open_doc_with_docinfo(db, docinfo, &doc, 0);
+    if (errCode != COUCHSTORE_SUCCESS &&
+        errCode != COUCHSTORE_ERROR_DOC_NOT_FOUND) {
+        cctx.error = errCode;
+        return errCode;
+    }
+
+    cctx.docs.push_back(doc);
+    cctx.docinfos.push_back(docinfo);
+    if (cctx.docinfos.size() >= catchupBatchSize) {
+        cctx.error = cctx.flush();
+        if (cctx.error != COUCHSTORE_SUCCESS) {
+            return cctx.error;
+        }
+    }
+
+    // Keep the docinfo - it's freed once written to the target.
+    return 1;
+}
+} // anonymous namespace
+
+bool CouchKVStore::catchUpCompactedFile(
+        Vbid vbid,
+        uint64_t sourceRev,
+        uint64_t rollbacks,
+        const std::string& collectionsMeta,
+        const std::string& compactFile,
+        uint64_t compactedSeqno,
+        std::unique_lock<std::mutex>& writeLock,
+        std::chrono::steady_clock::time_point& lockedAt,
+        FileOpsInterface* ops) {
+    DbHolder target(*this);
+    auto errCode = couchstore_open_db_ex(
+            compactFile.c_str(), 0, ops, target.getDbAddress());
+    if (errCode != COUCHSTORE_SUCCESS) {
+        logger.warn(
+                "CouchKVStore::catchUpCompactedFile: couchstore_open_db_ex "
+                "error:{}, name:{}",
+                couchstore_strerror(errCode),
+                compactFile);
+        return false;
+    }
+
+    uint64_t seqno = compactedSeqno;
+    size_t rounds = 0;
+    while (true) {
+        DbHolder source(*this);
+        errCode = openSpecificDB(
+                vbid, sourceRev, source, COUCHSTORE_OPEN_FLAG_RDONLY, ops);
+        if (errCode != COUCHSTORE_SUCCESS) {
+            // openSpecificDB has logged the error
+            return false;
+        }
+        DbInfo info;
+        couchstore_db_info(source, &info);
+
+        if (!writeLock.owns_lock() &&
+            (info.last_sequence <=
+                     seqno + configuration.getCompactionTailItems() ||
+             ++rounds > maxCatchupRounds)) {
+            // Block writes to copy the rest, re-opening the source to see its
+            // latest header once they are blocked.
+            writeLock.lock();
+            lockedAt = std::chrono::steady_clock::now();
+            if ((*dbFileRevMap)[vbid.get()] != sourceRev ||
+                vbRollbackCount[vbid.get()] != rollbacks) {
+                logger.info(
+                        "CouchKVStore::catchUpCompactedFile: {} was reset, "
+                        "deleted or rolled back whilst being compacted; "
+                        "discarding {}",
+                        vbid,
+                        compactFile);
+                return false;
+            }
+            continue;
+        }
+
+        if (info.last_sequence > seqno) {
+            errCode = copyChangesSince(*source, *target, seqno + 1);
+            if (errCode != COUCHSTORE_SUCCESS) {
+                return false;
+            }
+            seqno = info.last_sequence;
+        }
+
+        if (writeLock.owns_lock()) {
+            // The compaction purged dropped collections as they were when it
+            // started; it can't be caught up with any change since.
+            if (readCollectionsMeta(*source) != collectionsMeta) {
+                logger.info(
+                        "CouchKVStore::catchUpCompactedFile: collections of "
+                        "{} changed whilst being compacted; discarding {}",
+                        vbid,
+                        compactFile);
+                return false;
+            }
+
+            errCode = copyFlusherLocalDocs(*source, *target);
+            if (errCode == COUCHSTORE_SUCCESS) {
+                errCode = couchstore_commit(target);
+            }
+            if (errCode != COUCHSTORE_SUCCESS) {
+                logger.warn(
+                        "CouchKVStore::catchUpCompactedFile: failed to commit "
+                        "{} error:{} [{}]",
+                        compactFile,
+                        couchstore_strerror(errCode),
+                        couchkvstore_strerrno(target, errCode));
+                return false;
+            }
+            return true;
+        }
+    }
+}
+
+couchstore_error_t CouchKVStore::copyChangesSince(Db& source,
+                                                  Db& target,
+                                                  uint64_t startSeqno) {
+    CatchupCopyContext ctx(target);
+    auto errCode = couchstore_changes_since(&source,
+                                            startSeqno,
+                                            COUCHSTORE_NO_OPTIONS,
+                                            catchupCopyCallback,
+                                            &ctx);
+    if (ctx.error != COUCHSTORE_SUCCESS) {
+        errCode = ctx.error;
+    } else if (errCode == COUCHSTORE_SUCCESS) {
+        errCode = ctx.flush();
+    }
+    st.compactCatchupItems.fetch_add(ctx.copied);
+
+    if (errCode != COUCHSTORE_SUCCESS) {
+        logger.warn(
+                "CouchKVStore::copyChangesSince: error:{} [{}], "
+                "startSeqno:{}",
+                couchstore_strerror(errCode),
+                couchkvstore_strerrno(&source, errCode),
+                startSeqno);
+    }
+    return errCode;
+}
+
 vbucket_state* CouchKVStore::getVBucketState(Vbid vbucketId) {
     return cachedVBStates[vbucketId.get()].get();
 }
@@ -1196,6 +1669,7 @@ bool CouchKVStore::setVBucketState(Vbid vbucketId,
 
     if (options == VBStatePersist::VBSTATE_PERSIST_WITHOUT_COMMIT ||
             options == VBStatePersist::VBSTATE_PERSIST_WITH_COMMIT) {
+        std::lock_guard<std::mutex> lg(vbWriteMutexes[vbucketId.get()]);
         DbHolder db(*this);
         errorCode =
                 openDB(vbucketId, db, (uint64_t)COUCHSTORE_OPEN_FLAG_CREATE);
@@ -1224,6 +1698,7 @@ bool CouchKVStore::setVBucketState(Vbid vbucketId,
 
         if (options == VBStatePersist::VBSTATE_PERSIST_WITH_COMMIT) {
             errorCode = couchstore_commit(db);
+            headerCommitted(vbucketId);
             if (errorCode != COUCHSTORE_SUCCESS) {
                 ++st.numVbSetFailure;
                 logger.warn(
@@ -1300,7 +1775,11 @@ StorageProperties CouchKVStore::getStorageProperties() {
                          StorageProperties::EfficientVBDeletion::Yes,
                          StorageProperties::PersistedDeletion::Yes,
                          StorageProperties::EfficientGet::Yes,
-                         StorageProperties::ConcurrentWriteCompact::No);
+                         configuration.getConcurrentCompaction()
+                                 ? StorageProperties::ConcurrentWriteCompact::Yes
+                                 : StorageProperties::ConcurrentWriteCompact::No,
+                         StorageProperties::RangeScan::Yes,
+                         StorageProperties::ConcurrentFlush::Yes);
     return rv;
 }
 
@@ -1310,14 +1789,51 @@ bool CouchKVStore::commit(Collections::VB::Flush& collectionsFlush) {
                         "object.");
     }
 
-    if (intransaction) {
-        if (commit2couchstore(collectionsFlush)) {
-            intransaction = false;
-            transactionCtx.reset();
-        }
+    if (!intransaction) {
+        return true;
+    }
+
+    // Take the transaction's state, so once the requests are queued another
+    // thread can begin the flush of a different vBucket while this one is
+    // written and synced. The collections metadata is shared by the store,
+    // so a commit which writes it holds on to the transaction until done.
+    PendingRequestQueue reqs;
+    reqs.swap(pendingReqsQ);
+    auto txCtx = std::move(transactionCtx);
+    intransaction = false;
+    const bool writeCollectionsMeta = collectionsMeta.needsCommit;
+    if (!writeCollectionsMeta) {
+        releaseTransaction();
     }
 
-    return !intransaction;
+    const bool success = commit2couchstore(
+            reqs, *txCtx, collectionsFlush, writeCollectionsMeta);
+
+    if (writeCollectionsMeta) {
+        releaseTransaction();
+    }
+    return success;
+}
+
+void CouchKVStore::acquireTransaction() {
+    const auto self = std::this_thread::get_id();
+    std::unique_lock<std::mutex> lh(transactionMutex);
+    transactionReleased.wait(lh, [this, self]() {
+        return transactionOwner == std::thread::id() ||
+               transactionOwner == self;
+    });
+    transactionOwner = self;
+}
+
+void CouchKVStore::releaseTransaction() {
+    {
+        std::lock_guard<std::mutex> lh(transactionMutex);
+        if (transactionOwner != std::this_thread::get_id()) {
+            return;
+        }
+        transactionOwner = std::thread::id();
+    }
+    transactionReleased.notify_one();
 }
 
 bool CouchKVStore::getStat(const char* name, size_t& value)  {
@@ -1344,6 +1860,21 @@ bool CouchKVStore::getStat(const char* name, size_t& value)  {
     } else if (strcmp("io_bg_fetch_read_count", name) == 0) {
         value = st.getMultiFsReadCount;
         return true;
+    } else if (strcmp("read_handle_cache_hits", name) == 0) {
+        value = readHandleCache->getHits();
+        return true;
+    } else if (strcmp("read_handle_cache_misses", name) == 0) {
+        value = readHandleCache->getMisses();
+        return true;
+    } else if (blockCacheFileOps && strcmp("block_cache_hits", name) == 0) {
+        value = blockCacheFileOps->getHits();
+        return true;
+    } else if (blockCacheFileOps && strcmp("block_cache_misses", name) == 0) {
+        value = blockCacheFileOps->getMisses();
+        return true;
+    } else if (blockCache && strcmp("block_cache_memory", name) == 0) {
+        value = blockCache->getMemoryUsage();
+        return true;
     }
 
     return false;
@@ -1361,7 +1892,7 @@ void CouchKVStore::pendingTasks() {
 
         while (!queue.empty()) {
             std::string filename_str = queue.front();
-            if (remove(filename_str.c_str()) == -1) {
+            if (removeFile(filename_str) == -1) {
                 logger.warn(
                         "CouchKVStore::pendingTasks: "
                         "remove error:{}, file{}",
@@ -1384,8 +1915,9 @@ ScanContext* CouchKVStore::initScanContext(
         DocumentFilter options,
         ValueFilter valOptions) {
     DbHolder db(*this);
+    auto* ops = scanFileOps ? scanFileOps.get() : scanDropBehindFileOps.get();
     couchstore_error_t errorCode =
-            openDB(vbid, db, COUCHSTORE_OPEN_FLAG_RDONLY);
+            openDB(vbid, db, COUCHSTORE_OPEN_FLAG_RDONLY, ops);
     if (errorCode != COUCHSTORE_SUCCESS) {
         logger.warn(
                 "CouchKVStore::initScanContext: openDB error:{}, "
@@ -1451,6 +1983,90 @@ ScanContext* CouchKVStore::initScanContext(
     return sctx;
 }
 
+bool CouchKVStore::setScanKeyOrder(ScanContext& sctx) {
+    sctx.keyOrder = true;
+    return true;
+}
+
+bool CouchKVStore::setScanCollections(
+        ScanContext& sctx, const std::vector<CollectionID>& collections) {
+    Db* db;
+    {
+        LockHolder lh(scanLock);
+        auto itr = scans.find(sctx.scanId);
+        if (itr == scans.end()) {
+            return false;
+        }
+        db = itr->second;
+    }
+
+    // Read the key ranges of the collections' committed and prepared keys,
+    // and of the system namespace: it holds the (few) system events, which
+    // the stream's filter checks itself.
+    std::vector<std::pair<DiskDocKey, DiskDocKey>> ranges{
+            DiskDocKey::collectionRange(CollectionID::System)};
+    for (const auto cid : collections) {
+        ranges.push_back(DiskDocKey::collectionRange(cid));
+        ranges.push_back(DiskDocKey::collectionRange(cid, /*prepared*/ true));
+    }
+
+    struct State {
+        const ScanContext& sctx;
+        const DiskDocKey* prefix;
+        std::vector<std::pair<uint64_t, DiskDocKey>> keys;
+    };
+    State state{sctx, nullptr, {}};
+
+    auto callback = [](Db* db, DocInfo* docinfo, void* ctx) -> int {
+        auto& state = *reinterpret_cast<State*>(ctx);
+        // couchstore includes the end key of the range; skip it.
+        const auto& prefix = *state.prefix;
+        if (docinfo->id.size < prefix.size() ||
+            std::memcmp(docinfo->id.buf, prefix.data(), prefix.size()) != 0) {
+            return COUCHSTORE_SUCCESS;
+        }
+        if (docinfo->db_seq < uint64_t(state.sctx.startSeqno) ||
+            (docinfo->deleted &&
+             state.sctx.docFilter == DocumentFilter::NO_DELETES)) {
+            return COUCHSTORE_SUCCESS;
+        }
+        state.keys.emplace_back(docinfo->db_seq, makeDiskDocKey(docinfo->id));
+        return COUCHSTORE_SUCCESS;
+    };
+
+    for (const auto& keyRange : ranges) {
+        const std::array<sized_buf, 2> range = {
+                {to_sized_buf(keyRange.first), to_sized_buf(keyRange.second)}};
+        state.prefix = &keyRange.first;
+        auto errCode = couchstore_docinfos_by_id(db,
+                                                 range.data(),
+                                                 range.size(),
+                                                 RANGES,
+                                                 callback,
+                                                 &state);
+        if (errCode != COUCHSTORE_SUCCESS) {
+            logger.warn(
+                    "CouchKVStore::setScanCollections: "
+                    "couchstore_docinfos_by_id error:{} [{}], {}",
+                    couchstore_strerror(errCode),
+                    couchkvstore_strerrno(db, errCode),
+                    sctx.vbid);
+            return false;
+        }
+    }
+
+    if (!sctx.keyOrder) {
+        std::sort(state.keys.begin(),
+                  state.keys.end(),
+                  [](const auto& a, const auto& b) {
+                      return a.first < b.first;
+                  });
+    }
+    sctx.documentCount = state.keys.size();
+    sctx.collectionKeys = std::move(state.keys);
+    return true;
+}
+
 static couchstore_docinfos_options getDocFilter(const DocumentFilter& filter) {
     switch (filter) {
     case DocumentFilter::ALL_ITEMS:
@@ -1470,7 +2086,9 @@ scan_error_t CouchKVStore::scan(ScanContext* ctx) {
         return scan_failed;
     }
 
-    if (ctx->lastReadSeqno == ctx->maxSeqno) {
+    // (lastReadSeqno is the seqno of the last document visited, which for a
+    // key order scan needn't be the last one.)
+    if (!ctx->keyOrder && ctx->lastReadSeqno == ctx->maxSeqno) {
         return scan_success;
     }
 
@@ -1492,6 +2110,14 @@ scan_error_t CouchKVStore::scan(ScanContext* ctx) {
         db = itr->second;
     }
 
+    if (ctx->collectionKeys || ctx->keyOrder) {
+        const auto ret = ctx->collectionKeys ? scanCollectionKeys(db, *ctx)
+                                             : scanKeyOrder(db, *ctx);
+        TRACE_EVENT_END1(
+                "CouchKVStore", "scan", "lastReadSeqno", ctx->lastReadSeqno);
+        return ret;
+    }
+
     uint64_t start = ctx->startSeqno;
     if (ctx->lastReadSeqno != 0) {
         start = ctx->lastReadSeqno + 1;
@@ -1522,6 +2148,73 @@ scan_error_t CouchKVStore::scan(ScanContext* ctx) {
     return scan_success;
 }
 
+scan_error_t CouchKVStore::scanCollectionKeys(Db* db, ScanContext& sctx) {
+    const auto& keys = *sctx.collectionKeys;
+    for (; sctx.collectionKeysVisited < keys.size();
+         ++sctx.collectionKeysVisited) {
+        sized_buf id = to_sized_buf(keys[sctx.collectionKeysVisited].second);
+        DocInfo* docinfo = nullptr;
+        auto errCode = couchstore_docinfo_by_id(
+                db, (uint8_t*)id.buf, id.size, &docinfo);
+        if (errCode != COUCHSTORE_SUCCESS) {
+            // The scan's file was opened before the keys were read, so the
+            // document must still be there.
+            logger.warn(
+                    "CouchKVStore::scanCollectionKeys: "
+                    "couchstore_docinfo_by_id error:{} [{}], {}",
+                    couchstore_strerror(errCode),
+                    couchkvstore_strerrno(db, errCode),
+                    sctx.vbid);
+            return scan_failed;
+        }
+
+        const auto ret = recordDbDump(db, docinfo, &sctx);
+        couchstore_free_docinfo(docinfo);
+        if (ret == COUCHSTORE_ERROR_CANCEL) {
+            // Resume at this document.
+            return scan_again;
+        }
+    }
+    return scan_success;
+}
+
+scan_error_t CouchKVStore::scanKeyOrder(Db* db, ScanContext& sctx) {
+    auto callback = [](Db* db, DocInfo* docinfo, void* ctx) -> int {
+        auto& sctx = *reinterpret_cast<ScanContext*>(ctx);
+        if (docinfo->db_seq < uint64_t(sctx.startSeqno)) {
+            return COUCHSTORE_SUCCESS;
+        }
+        const auto ret = recordDbDump(db, docinfo, &sctx);
+        if (ret == COUCHSTORE_ERROR_CANCEL) {
+            // Resume at this document.
+            sctx.keyOrderResumeKey = makeDiskDocKey(docinfo->id);
+        }
+        return ret;
+    };
+
+    sized_buf start{nullptr, 0};
+    if (sctx.keyOrderResumeKey) {
+        start = to_sized_buf(*sctx.keyOrderResumeKey);
+    }
+    auto errCode = couchstore_all_docs(db,
+                                       sctx.keyOrderResumeKey ? &start : nullptr,
+                                       getDocFilter(sctx.docFilter),
+                                       callback,
+                                       &sctx);
+    if (errCode == COUCHSTORE_ERROR_CANCEL) {
+        return scan_again;
+    } else if (errCode != COUCHSTORE_SUCCESS) {
+        logger.warn(
+                "CouchKVStore::scanKeyOrder: couchstore_all_docs "
+                "error:{} [{}], {}",
+                couchstore_strerror(errCode),
+                couchkvstore_strerrno(db, errCode),
+                sctx.vbid);
+        return scan_failed;
+    }
+    return scan_success;
+}
+
 void CouchKVStore::destroyScanContext(ScanContext* ctx) {
     if (!ctx) {
         return;
@@ -1623,6 +2316,7 @@ void CouchKVStore::updateDbFileMap(Vbid vbucketId, uint64_t newFileRev) {
     std::lock_guard<cb::WriterLock> lg(openDbMutex);
 
     (*dbFileRevMap)[vbucketId.get()] = newFileRev;
+    fileRevisionChanged(vbucketId);
 }
 
 couchstore_error_t CouchKVStore::openDB(Vbid vbucketId,
@@ -1637,6 +2331,54 @@ couchstore_error_t CouchKVStore::openDB(Vbid vbucketId,
     return openSpecificDB(vbucketId, fileRev, db, options, ops);
 }
 
+couchstore_error_t CouchKVStore::openCachedDB(Vbid vbucketId, DbHolder& db) {
+    if (!readHandleCache->isEnabled()) {
+        return openDB(vbucketId, db, COUCHSTORE_OPEN_FLAG_RDONLY, readFileOps);
+    }
+
+    // Don't keep the files compaction replaced open.
+    auto revisionChanges = headerGenerations->revisionChanges.load();
+    if (readHandleCacheRevisionChanges.exchange(revisionChanges) !=
+        revisionChanges) {
+        readHandleCache->purgeOldRevisions([this](Vbid vbid) -> uint64_t {
+            return (*dbFileRevMap)[vbid.get()];
+        });
+    }
+
+    std::lock_guard<cb::ReaderLock> lg(openDbMutex);
+    // Read the generation before opening, so a commit which races with the
+    // open at worst makes the handle look stale.
+    const uint64_t generation =
+            headerGenerations->perVBucket[vbucketId.get()].load();
+    const uint64_t fileRev = (*dbFileRevMap)[vbucketId.get()];
+
+    couchstore_error_t errorCode = COUCHSTORE_SUCCESS;
+    auto* cached = readHandleCache->take(vbucketId, fileRev, generation);
+    if (cached) {
+        *db.getDbAddress() = cached;
+        db.setFileRev(fileRev);
+    } else {
+        errorCode = openSpecificDB(vbucketId,
+                                   fileRev,
+                                   db,
+                                   COUCHSTORE_OPEN_FLAG_RDONLY,
+                                   readFileOps);
+    }
+    if (errorCode == COUCHSTORE_SUCCESS) {
+        db.setCacheable(vbucketId, generation);
+    }
+    return errorCode;
+}
+
+void CouchKVStore::headerCommitted(Vbid vbucketId) {
+    ++headerGenerations->perVBucket[vbucketId.get()];
+}
+
+void CouchKVStore::fileRevisionChanged(Vbid vbucketId) {
+    headerCommitted(vbucketId);
+    ++headerGenerations->revisionChanges;
+}
+
 couchstore_error_t CouchKVStore::openSpecificDB(Vbid vbucketId,
                                                 uint64_t fileRev,
                                                 DbHolder& db,
@@ -1731,7 +2473,7 @@ void CouchKVStore::populateFileNameMap(std::vector<std::string>& filenames,
             old_file << dbname << "/" << vbId << ".couch." << old_rev_num;
             if (cb::io::isFile(old_file.str())) {
                 if (!isReadOnly()) {
-                    if (remove(old_file.str().c_str()) == 0) {
+                    if (removeFile(old_file.str()) == 0) {
                         logger.debug(
                                 "CouchKVStore::populateFileNameMap: Removed "
                                 "stale file:{}",
@@ -1945,16 +2687,19 @@ int CouchKVStore::recordDbDump(Db *db, DocInfo *docinfo, void *ctx) {
     return COUCHSTORE_SUCCESS;
 }
 
-bool CouchKVStore::commit2couchstore(Collections::VB::Flush& collectionsFlush) {
+bool CouchKVStore::commit2couchstore(PendingRequestQueue& reqs,
+                                     TransactionContext& txCtx,
+                                     Collections::VB::Flush& collectionsFlush,
+                                     bool writeCollectionsMeta) {
     bool success = true;
 
-    size_t pendingCommitCnt = pendingReqsQ.size();
+    size_t pendingCommitCnt = reqs.size();
     if (pendingCommitCnt == 0) {
         return success;
     }
 
     // Use the vbucket of the first item
-    auto vbucket2flush = pendingReqsQ[0].getVBucketId();
+    auto vbucket2flush = reqs[0].getVBucketId();
 
     TRACE_EVENT2("CouchKVStore",
                  "commit2couchstore",
@@ -1967,14 +2712,14 @@ bool CouchKVStore::commit2couchstore(Collections::VB::Flush& collectionsFlush) {
     std::vector<DocInfo*> docinfos(pendingCommitCnt);
 
     for (size_t i = 0; i < pendingCommitCnt; ++i) {
-        auto& req = pendingReqsQ[i];
+        auto& req = reqs[i];
         docs[i] = req.getDbDoc();
         docinfos[i] = req.getDbDocInfo();
         if (vbucket2flush != req.getVBucketId()) {
             throw std::logic_error(
                     "CouchKVStore::commit2couchstore: "
                     "mismatch between vbucket2flush (which is " +
-                    vbucket2flush.to_string() + ") and pendingReqsQ[" +
+                    vbucket2flush.to_string() + ") and reqs[" +
                     std::to_string(i) + "] (which is " +
                     req.getVBucketId().to_string() + ")");
         }
@@ -1984,7 +2729,12 @@ bool CouchKVStore::commit2couchstore(Collections::VB::Flush& collectionsFlush) {
     kvstats_ctx kvctx(collectionsFlush);
     // flush all
     couchstore_error_t errCode =
-            saveDocs(vbucket2flush, docs, docinfos, kvctx, collectionsFlush);
+            saveDocs(vbucket2flush,
+                     docs,
+                     docinfos,
+                     kvctx,
+                     collectionsFlush,
+                     writeCollectionsMeta);
 
     if (errCode) {
         success = false;
@@ -1995,9 +2745,7 @@ bool CouchKVStore::commit2couchstore(Collections::VB::Flush& collectionsFlush) {
                 vbucket2flush);
     }
 
-    commitCallback(pendingReqsQ, kvctx, errCode);
-
-    pendingReqsQ.clear();
+    commitCallback(reqs, txCtx, kvctx, errCode);
     return success;
 }
 
@@ -2058,11 +2806,15 @@ couchstore_error_t CouchKVStore::saveDocs(
         const std::vector<Doc*>& docs,
         std::vector<DocInfo*>& docinfos,
         kvstats_ctx& kvctx,
-        Collections::VB::Flush& collectionsFlush) {
+        Collections::VB::Flush& collectionsFlush,
+        bool writeCollectionsMeta) {
     couchstore_error_t errCode;
     DbInfo info;
+    // Must not switch files under a concurrent compaction part way through.
+    std::lock_guard<std::mutex> lg(vbWriteMutexes[vbid.get()]);
     DbHolder db(*this);
-    errCode = openDB(vbid, db, COUCHSTORE_OPEN_FLAG_CREATE);
+    errCode = openDB(
+            vbid, db, COUCHSTORE_OPEN_FLAG_CREATE, writebackFileOps.get());
     if (errCode != COUCHSTORE_SUCCESS) {
         logger.warn(
                 "CouchKVStore::saveDocs: openDB error:{}, {}, rev:{}, "
@@ -2133,8 +2885,8 @@ couchstore_error_t CouchKVStore::saveDocs(
             return errCode;
         }
 
-        if (collectionsMeta.needsCommit) {
-            errCode = updateCollectionsMeta(*db, collectionsFlush);
+        if (writeCollectionsMeta) {
+            errCode = updateCollectionsMeta(*db, vbid, collectionsFlush);
             if (errCode) {
                 logger.warn(
                         "CouchKVStore::saveDocs: updateCollectionsMeta "
@@ -2144,9 +2896,18 @@ couchstore_error_t CouchKVStore::saveDocs(
             }
         }
 
+        errCode = saveRollbackIndex(*db, vbid, db.getFileRev());
+        if (errCode) {
+            logger.warn(
+                    "CouchKVStore::saveDocs: saveRollbackIndex error:{} [{}]",
+                    couchstore_strerror(errCode),
+                    couchkvstore_strerrno(db, errCode));
+        }
+
         auto cs_begin = std::chrono::steady_clock::now();
 
         errCode = couchstore_commit(db);
+        headerCommitted(vbid);
         st.commitHisto.add(
                 std::chrono::duration_cast<std::chrono::microseconds>(
                         std::chrono::steady_clock::now() - cs_begin));
@@ -2173,6 +2934,7 @@ couchstore_error_t CouchKVStore::saveDocs(
         cachedFileSize[vbid.get()] = info.file_size;
         cachedDeleteCount[vbid.get()] = info.deleted_count;
         cachedDocCount[vbid.get()] = info.doc_count;
+        addRollbackIndexEntry(vbid, db.getFileRev(), info);
 
         // Check seqno if we wrote documents
         if (docs.size() > 0 && maxDBSeqno != info.last_sequence) {
@@ -2196,8 +2958,13 @@ couchstore_error_t CouchKVStore::saveDocs(
 }
 
 void CouchKVStore::commitCallback(PendingRequestQueue& committedReqs,
+                                  TransactionContext& txCtx,
                                   kvstats_ctx& kvctx,
                                   couchstore_error_t errCode) {
+    TRACE_EVENT1("CouchKVStore",
+                 "commitCallback",
+                 "count",
+                 committedReqs.size());
     for (auto& committed : committedReqs) {
         size_t dataSize = committed.getNBytes();
         size_t keySize = committed.getKeySize();
@@ -2220,7 +2987,7 @@ void CouchKVStore::commitCallback(PendingRequestQueue& committedReqs,
             } else {
                 st.delTimeHisto.add(committed.getDelta());
             }
-            committed.getDelCallback()(*transactionCtx, rv);
+            committed.getDelCallback()(txCtx, rv);
         } else {
             int rv = getMutationStatus(errCode);
             const auto& key = committed.getKey();
@@ -2232,7 +2999,7 @@ void CouchKVStore::commitCallback(PendingRequestQueue& committedReqs,
                 st.writeSizeHisto.add(dataSize + keySize);
             }
             mutation_result p(rv, insertion);
-            committed.getSetCallback()(*transactionCtx, p);
+            committed.getSetCallback()(txCtx, p);
         }
     }
 }
@@ -2442,33 +3209,48 @@ int CouchKVStore::getMultiCb(Db *db, DocInfo *docinfo, void *ctx) {
     }
 
     GetMultiCbCtx *cbCtx = static_cast<GetMultiCbCtx *>(ctx);
+    if (cbCtx->deferReads) {
+        cbCtx->docInfos.emplace_back(*docinfo);
+    } else {
+        getMultiFetchDoc(db, docinfo, *cbCtx);
+    }
+    return 0;
+}
+
+void CouchKVStore::getMultiFetchDoc(Db* db,
+                                    DocInfo* docinfo,
+                                    GetMultiCbCtx& ctx) {
     auto key = makeDiskDocKey(docinfo->id);
-    KVStoreStats& st = cbCtx->cks.getKVStoreStat();
+    KVStoreStats& st = ctx.cks.getKVStoreStat();
 
-    vb_bgfetch_queue_t::iterator qitr = cbCtx->fetches.find(key);
-    if (qitr == cbCtx->fetches.end()) {
+    vb_bgfetch_queue_t::iterator qitr = ctx.fetches.find(key);
+    if (qitr == ctx.fetches.end()) {
         // this could be a serious race condition in couchstore,
         // log a warning message and continue
-        cbCtx->cks.logger.warn(
+        ctx.cks.logger.warn(
                 "CouchKVStore::getMultiCb: Couchstore returned "
                 "invalid docinfo, no pending bgfetch has been "
                 "issued for a key in {}, "
                 "seqno:{}",
-                cbCtx->vbId,
+                ctx.vbId,
                 docinfo->rev_seq);
-        return 0;
+        return;
     }
 
     vb_bgfetch_item_ctx_t& bg_itm_ctx = (*qitr).second;
     GetMetaOnly meta_only = bg_itm_ctx.isMetaOnly;
 
-    couchstore_error_t errCode = cbCtx->cks.fetchDoc(
-            db, docinfo, bg_itm_ctx.value, cbCtx->vbId, meta_only);
+    const auto readStart = std::chrono::steady_clock::now();
+    couchstore_error_t errCode = ctx.cks.fetchDoc(
+            db, docinfo, bg_itm_ctx.value, ctx.vbId, meta_only);
+    st.getMultiDocReadTimeHisto.add(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - readStart));
     if (errCode != COUCHSTORE_SUCCESS && (meta_only == GetMetaOnly::No)) {
         st.numGetFailure++;
     }
 
-    bg_itm_ctx.value.setStatus(cbCtx->cks.couchErr2EngineErr(errCode));
+    bg_itm_ctx.value.setStatus(ctx.cks.couchErr2EngineErr(errCode));
 
     bool return_val_ownership_transferred = false;
     for (auto& fetch : bg_itm_ctx.bgfetched_list) {
@@ -2485,17 +3267,14 @@ int CouchKVStore::getMultiCb(Db *db, DocInfo *docinfo, void *ctx) {
         }
     }
     if (!return_val_ownership_transferred) {
-        cbCtx->cks.logger.warn(
+        ctx.cks.logger.warn(
                 "CouchKVStore::getMultiCb called with zero"
                 "items in bgfetched_list, {}, seqno:{}",
-                cbCtx->vbId,
+                ctx.vbId,
                 docinfo->rev_seq);
     }
-
-    return 0;
 }
 
-
 void CouchKVStore::closeDatabaseHandle(Db *db) {
     couchstore_error_t ret = couchstore_close_file(db);
     if (ret != COUCHSTORE_SUCCESS) {
@@ -2604,6 +3383,13 @@ size_t CouchKVStore::getItemCount(Vbid vbid) {
 RollbackResult CouchKVStore::rollback(Vbid vbid,
                                       uint64_t rollbackSeqno,
                                       std::shared_ptr<RollbackCB> cb) {
+    // Stop any concurrent compaction of the vBucket from switching to its
+    // compacted file - it won't include the rewind.
+    {
+        std::lock_guard<std::mutex> lg(vbWriteMutexes[vbid.get()]);
+        ++vbRollbackCount[vbid.get()];
+    }
+
     DbHolder db(*this);
     DbInfo info;
     couchstore_error_t errCode;
@@ -2649,15 +3435,64 @@ RollbackResult CouchKVStore::rollback(Vbid vbid,
         return RollbackResult(false, 0, 0, 0);
     }
 
+    // If the rollback index has a header after the requested rollback point
+    // (other than the latest), the search below can start from the first
+    // such header rather than rewind through all the later ones.
+    boost::optional<RollbackIndexEntry> indexed;
+    if (configuration.getRollbackIndexInterval() != 0) {
+        std::lock_guard<std::mutex> lh(rollbackIndexMutex);
+        const auto& entries =
+                getRollbackIndex(*db, vbid, db.getFileRev()).entries;
+        auto it = std::upper_bound(
+                entries.begin(),
+                entries.end(),
+                rollbackSeqno,
+                [](uint64_t seqno, const RollbackIndexEntry& entry) {
+                    return seqno < entry.seqno;
+                });
+        if (it != entries.end() && it->seqno < latestSeqno) {
+            indexed = *it;
+        }
+    }
+
     // Open the vBucket file again; and search for a header which is
     // before the requested rollback point - the Rollback Header.
+    std::unique_ptr<HeaderSeekOps> seekOps; // Must outlive newdb.
     DbHolder newdb(*this);
-    errCode = openDB(vbid, newdb, 0);
-    if (errCode != COUCHSTORE_SUCCESS) {
-        logger.warn("CouchKVStore::rollback: openDB#2 error:{}, name:{}",
-                    couchstore_strerror(errCode),
-                    dbFileName.str());
-        return RollbackResult(false, 0, 0, 0);
+    if (indexed) {
+        // Open the file at the indexed header by hiding the rest of it.
+        seekOps = std::make_unique<HeaderSeekOps>(*statCollectingFileOps,
+                                                  indexed->headerEnd);
+        DbInfo seekInfo;
+        errCode = openDB(vbid, newdb, 0, seekOps.get());
+        if (errCode == COUCHSTORE_SUCCESS) {
+            errCode = couchstore_db_info(newdb, &seekInfo);
+        }
+        if (errCode == COUCHSTORE_SUCCESS &&
+            seekInfo.last_sequence == indexed->seqno &&
+            seekInfo.header_position == indexed->headerPos) {
+            info = seekInfo;
+        } else {
+            logger.info(
+                    "CouchKVStore::rollback: indexed header not found, {}, "
+                    "rev:{}, seqno:{}, pos:{}; rewinding from the latest "
+                    "header",
+                    vbid,
+                    db.getFileRev(),
+                    indexed->seqno,
+                    indexed->headerPos);
+            newdb.close();
+        }
+    }
+
+    if (!newdb.getDb()) {
+        errCode = openDB(vbid, newdb, 0);
+        if (errCode != COUCHSTORE_SUCCESS) {
+            logger.warn("CouchKVStore::rollback: openDB#2 error:{}, name:{}",
+                        couchstore_strerror(errCode),
+                        dbFileName.str());
+            return RollbackResult(false, 0, 0, 0);
+        }
     }
 
     while (info.last_sequence > rollbackSeqno) {
@@ -2744,11 +3579,25 @@ RollbackResult CouchKVStore::rollback(Vbid vbid,
 
     //Append the rewinded header to the database file
     errCode = couchstore_commit(newdb);
+    headerCommitted(vbid);
 
     if (errCode != COUCHSTORE_SUCCESS) {
         return RollbackResult(false, 0, 0, 0);
     }
 
+    // Headers past the Rollback Header are no longer in the file's history.
+    {
+        std::lock_guard<std::mutex> lh(rollbackIndexMutex);
+        auto& index = rollbackIndexes[vbid.get()];
+        if (index.loaded && index.fileRev == newdb.getFileRev()) {
+            while (!index.entries.empty() &&
+                   index.entries.back().seqno > info.last_sequence) {
+                index.entries.pop_back();
+                index.dirty = true;
+            }
+        }
+    }
+
     vbucket_state* vb_state = getVBucketState(vbid);
     return RollbackResult(true, vb_state->highSeqno,
                           vb_state->lastSnapStart, vb_state->lastSnapEnd);
@@ -2808,10 +3657,9 @@ void CouchKVStore::unlinkCouchFile(Vbid vbucket, uint64_t fRev) {
                 "read-only object.");
     }
 
-    std::string fname = dbname + "/" + std::to_string(vbucket.get()) +
-                        ".couch." + std::to_string(fRev);
-    cb::io::sanitizePath(fname);
-    if (remove(fname.c_str()) == -1) {
+    // Use the same path the file was opened (and its blocks cached) under.
+    const auto fname = getDBFileName(dbname, vbucket, fRev);
+    if (removeFile(fname) == -1) {
         logger.warn(
                 "CouchKVStore::unlinkCouchFile: remove error:{}, "
                 "{}, rev:{}, fname:{}",
@@ -2827,6 +3675,31 @@ void CouchKVStore::unlinkCouchFile(Vbid vbucket, uint64_t fRev) {
     }
 }
 
+int CouchKVStore::removeFile(const std::string& path) {
+    const auto rv = remove(path.c_str());
+    const auto savedErrno = errno;
+    // Forget the file even if remove failed (it may have been partially
+    // written); after the remove, so a reader opening it in between can't
+    // re-cache its blocks under the identifier a new file would get.
+    if (blockCache) {
+        blockCache->forgetFile(path);
+    }
+    // Callers inspect errno on failure.
+    errno = savedErrno;
+    return rv;
+}
+
+int CouchKVStore::renameFile(const std::string& from, const std::string& to) {
+    const auto rv = rename(from.c_str(), to.c_str());
+    const auto savedErrno = errno;
+    if (blockCache) {
+        blockCache->forgetFile(from);
+        blockCache->forgetFile(to);
+    }
+    errno = savedErrno;
+    return rv;
+}
+
 void CouchKVStore::removeCompactFile(const std::string& dbname, Vbid vbid) {
     std::string dbfile =
             getDBFileName(dbname, vbid, (*dbFileRevMap)[vbid.get()]);
@@ -2850,7 +3723,7 @@ void CouchKVStore::removeCompactFile(const std::string &filename) {
     }
 
     if (cb::io::isFile(filename)) {
-        if (remove(filename.c_str()) == 0) {
+        if (removeFile(filename) == 0) {
             logger.warn(
                     "CouchKVStore::removeCompactFile: Removed compact "
                     "filename:{}",
@@ -2875,7 +3748,7 @@ std::unique_ptr<KVFileHandle, KVFileHandleDeleter> CouchKVStore::makeFileHandle(
     std::unique_ptr<CouchKVFileHandle, KVFileHandleDeleter> db(
             new CouchKVFileHandle(*this));
     // openDB logs errors
-    openDB(vbid, db->getDbHolder(), COUCHSTORE_OPEN_FLAG_RDONLY);
+    openCachedDB(vbid, db->getDbHolder());
 
     return std::move(db);
 }
@@ -2885,7 +3758,9 @@ void CouchKVStore::freeFileHandle(KVFileHandle* kvFileHandle) const {
 }
 
 void CouchKVStore::incrementRevision(Vbid vbid) {
+    std::lock_guard<std::mutex> lg(vbWriteMutexes[vbid.get()]);
     (*dbFileRevMap)[vbid.get()]++;
+    fileRevisionChanged(vbid);
 }
 
 uint64_t CouchKVStore::prepareToDelete(Vbid vbid) {
@@ -2895,6 +3770,12 @@ uint64_t CouchKVStore::prepareToDelete(Vbid vbid) {
     cachedDeleteCount[vbid.get()] = 0;
     cachedFileSize[vbid.get()] = 0;
     cachedSpaceUsed[vbid.get()] = 0;
+    droppedItemsPendingPurge[vbid.get()] = 0;
+
+    // Stop any concurrent compaction of the vBucket from switching to a new
+    // revision, which delVBucket (only given this one) would leave behind.
+    std::lock_guard<std::mutex> lg(vbWriteMutexes[vbid.get()]);
+    ++vbRollbackCount[vbid.get()];
     return (*dbFileRevMap)[vbid.get()];
 }
 
@@ -2972,6 +3853,101 @@ couchstore_error_t CouchKVStore::deleteLocalDoc(Db& db,
     return errCode;
 }
 
+CouchKVStore::RollbackIndex& CouchKVStore::getRollbackIndex(
+        Db& db, Vbid vbid, uint64_t fileRev) {
+    auto& index = rollbackIndexes[vbid.get()];
+    if (index.loaded && index.fileRev == fileRev) {
+        return index;
+    }
+
+    index = {};
+    index.loaded = true;
+    index.fileRev = fileRev;
+
+    auto lDoc = readLocalDoc(db, rollbackIndexName);
+    if (!lDoc.getLocalDoc()) {
+        return index;
+    }
+
+    try {
+        const auto buffer = lDoc.getBuffer();
+        const auto json = nlohmann::json::parse(buffer.begin(), buffer.end());
+        // Compaction copies the document to the new file, where the
+        // offsets it holds are meaningless.
+        if (json.at("rev").get<uint64_t>() != fileRev) {
+            return index;
+        }
+        for (const auto& entry : json.at("entries")) {
+            index.entries.push_back({entry.at(0).get<uint64_t>(),
+                                     entry.at(1).get<cs_off_t>(),
+                                     entry.at(2).get<cs_off_t>()});
+        }
+    } catch (const nlohmann::json::exception& e) {
+        logger.warn(
+                "CouchKVStore::getRollbackIndex: Failed to parse the rollback "
+                "index of {}, rev:{}, with reason:{}",
+                vbid,
+                fileRev,
+                e.what());
+        index.entries.clear();
+    }
+    return index;
+}
+
+couchstore_error_t CouchKVStore::saveRollbackIndex(Db& db,
+                                                   Vbid vbid,
+                                                   uint64_t fileRev) {
+    if (configuration.getRollbackIndexInterval() == 0) {
+        return COUCHSTORE_SUCCESS;
+    }
+
+    std::lock_guard<std::mutex> lh(rollbackIndexMutex);
+    auto& index = getRollbackIndex(db, vbid, fileRev);
+    if (!index.dirty) {
+        return COUCHSTORE_SUCCESS;
+    }
+
+    nlohmann::json entries = nlohmann::json::array();
+    for (const auto& entry : index.entries) {
+        entries.push_back({entry.seqno, entry.headerPos, entry.headerEnd});
+    }
+    const auto json =
+            nlohmann::json{{"rev", fileRev}, {"entries", entries}}.dump();
+    const auto errCode = writeLocalDoc(db, rollbackIndexName, json);
+    if (errCode == COUCHSTORE_SUCCESS) {
+        index.dirty = false;
+    }
+    return errCode;
+}
+
+void CouchKVStore::addRollbackIndexEntry(Vbid vbid,
+                                         uint64_t fileRev,
+                                         const DbInfo& info) {
+    const auto interval = configuration.getRollbackIndexInterval();
+    if (interval == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lh(rollbackIndexMutex);
+    auto& index = rollbackIndexes[vbid.get()];
+    // saveRollbackIndex() loads the index before each commit.
+    if (!index.loaded || index.fileRev != fileRev) {
+        return;
+    }
+    if (!index.entries.empty() &&
+        info.last_sequence < index.entries.back().seqno + interval) {
+        return;
+    }
+
+    index.entries.push_back({info.last_sequence,
+                             info.header_position,
+                             cs_off_t(info.file_size)});
+    if (index.entries.size() > rollbackIndexMaxEntries) {
+        index.entries.pop_front();
+    }
+    index.dirty = true;
+}
+
 template <class T>
 static void verifyFlatbuffersData(cb::const_byte_buffer buf,
                                   const std::string& caller) {
@@ -2988,6 +3964,65 @@ static void verifyFlatbuffersData(cb::const_byte_buffer buf,
     throw std::runtime_error(ss.str());
 }
 
+couchstore_error_t CouchKVStore::copyFlusherLocalDocs(Db& source,
+                                                      Db& target) {
+    std::vector<std::string> names{"_local/vbstate"};
+
+    // Each open collection's stats (see saveCollectionStats)
+    auto collections = readLocalDoc(source, Collections::openCollectionsName);
+    if (collections.getLocalDoc()) {
+        verifyFlatbuffersData<Collections::KVStore::OpenCollections>(
+                collections.getBuffer(), "copyFlusherLocalDocs(open)");
+        auto fbData =
+                flatbuffers::GetRoot<Collections::KVStore::OpenCollections>(
+                        reinterpret_cast<const uint8_t*>(
+                                collections.getLocalDoc()->json.buf));
+        for (const auto& entry : *fbData->entries()) {
+            names.push_back(
+                    "|" + CollectionID(entry->collectionId()).to_string() +
+                    "|");
+        }
+    } else {
+        names.push_back("|" + CollectionID(CollectionID::Default).to_string() +
+                        "|");
+    }
+
+    for (const auto& name : names) {
+        auto lDoc = readLocalDoc(source, name);
+        couchstore_error_t errCode;
+        if (lDoc.getLocalDoc()) {
+            errCode = writeLocalDoc(target,
+                                    name,
+                                    {lDoc.getLocalDoc()->json.buf,
+                                     lDoc.getLocalDoc()->json.size});
+        } else {
+            errCode = deleteLocalDoc(target, name);
+        }
+        if (errCode != COUCHSTORE_SUCCESS) {
+            return errCode;
+        }
+    }
+    return COUCHSTORE_SUCCESS;
+}
+
+std::string CouchKVStore::readCollectionsMeta(Db& db) {
+    std::string rv;
+    for (const auto* name : {Collections::manifestName,
+                             Collections::openCollectionsName,
+                             Collections::scopesName,
+                             Collections::droppedCollectionsName}) {
+        auto lDoc = readLocalDoc(db, name);
+        if (lDoc.getLocalDoc()) {
+            const auto& json = lDoc.getLocalDoc()->json;
+            rv += std::to_string(json.size) + ":";
+            rv.append(json.buf, json.size);
+        } else {
+            rv += "-:";
+        }
+    }
+    return rv;
+}
+
 Collections::KVStore::Manifest CouchKVStore::getCollectionsManifest(Vbid vbid) {
     DbHolder db(*this);
 
@@ -3118,7 +4153,7 @@ size_t CouchKVStore::getDroppedCollectionCount(Db& db) {
 }
 
 couchstore_error_t CouchKVStore::updateCollectionsMeta(
-        Db& db, Collections::VB::Flush& collectionsFlush) {
+        Db& db, Vbid vbid, Collections::VB::Flush& collectionsFlush) {
     auto err = updateManifestUid(db);
     if (err != COUCHSTORE_SUCCESS) {
         return err;
@@ -3141,11 +4176,21 @@ couchstore_error_t CouchKVStore::updateCollectionsMeta(
     }
 
     if (!collectionsMeta.droppedCollections.empty()) {
-        err = updateDroppedCollections(db, dropped);
+        uint64_t droppedItems = 0;
+        err = updateDroppedCollections(db, dropped, droppedItems);
         if (err != COUCHSTORE_SUCCESS) {
             return err;
         }
-        collectionsFlush.setNeedsPurge();
+        droppedItemsPendingPurge[vbid.get()] += droppedItems;
+
+        // The purge rewrites the whole file, so isn't worth it for a small
+        // part of the vBucket.
+        const auto ratio = configuration.getCollectionPurgeRatio();
+        DbInfo info;
+        if (ratio <= 0 || couchstore_db_info(&db, &info) != COUCHSTORE_SUCCESS ||
+            droppedItemsPendingPurge[vbid.get()] >= ratio * info.doc_count) {
+            collectionsFlush.setNeedsPurge();
+        }
     }
 
     if (!collectionsMeta.scopes.empty() ||
@@ -3276,7 +4321,8 @@ CouchKVStore::updateOpenCollections(Db& db) {
 couchstore_error_t CouchKVStore::updateDroppedCollections(
         Db& db,
         boost::optional<std::vector<Collections::KVStore::DroppedCollection>>
-                dropped) {
+                dropped,
+        uint64_t& droppedItems) {
     flatbuffers::FlatBufferBuilder builder;
     std::vector<flatbuffers::Offset<Collections::KVStore::Dropped>>
             droppedCollections;
@@ -3288,7 +4334,15 @@ couchstore_error_t CouchKVStore::updateDroppedCollections(
                                                     dropped.collectionId);
         droppedCollections.push_back(newEntry);
 
-        // Delete the 'stats' document for the collection
+        // Note the collection's item count, then delete its 'stats' document
+        auto stats = readLocalDoc(
+                db, "|" + dropped.collectionId.to_string() + "|");
+        if (stats.getLocalDoc()) {
+            droppedItems += Collections::VB::PersistedStats(
+                                    stats.getLocalDoc()->json.buf,
+                                    stats.getLocalDoc()->json.size)
+                                    .itemCount;
+        }
         deleteCollectionStats(db, dropped.collectionId);
     }
 
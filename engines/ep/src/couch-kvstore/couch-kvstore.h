@@ -18,7 +18,10 @@
 
 #include "atomicqueue.h"
 #include "configuration.h"
+#include "couch-kvstore/couch-fs-block-cache.h"
+#include "couch-kvstore/couch-fs-merge.h"
 #include "couch-kvstore/couch-fs-stats.h"
+#include "couch-kvstore/couch-handle-cache.h"
 #include "couch-kvstore/couch-kvstore-metadata.h"
 #include "kvstore.h"
 #include "kvstore_priv.h"
@@ -28,15 +31,22 @@
 #include <platform/strerror.h>
 #include <relaxed_atomic.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 
 #define COUCHSTORE_NO_OPTIONS 0
 
 class EventuallyPersistentEngine;
+struct GetMultiCbCtx;
 
 /**
  * Class representing a document to be persisted in couchstore.
@@ -156,6 +166,7 @@ public:
             throw std::logic_error(
                     "CouchKVStore::begin: Not valid on a read-only object.");
         }
+        acquireTransaction();
         if (collectionsMeta.needsCommit) {
             throw std::logic_error("CouchKVStore::begin needsCommit:true");
         }
@@ -186,6 +197,7 @@ public:
             intransaction = false;
             transactionCtx.reset();
         }
+        releaseTransaction();
     }
 
     /**
@@ -230,10 +242,13 @@ public:
 
     void getMulti(Vbid vb, vb_bgfetch_queue_t& itms) override;
 
-    void getRange(Vbid vb,
-                  const DiskDocKey& startKey,
-                  const DiskDocKey& endKey,
-                  const KVStore::GetRangeCb& cb) override;
+    void getMultiSequential(Vbid vb, vb_bgfetch_queue_t& itms) override;
+
+    void scanRange(Vbid vb,
+                   const DiskDocKey& startKey,
+                   const DiskDocKey& endKey,
+                   ValueFilter filter,
+                   const ScanRangeCb& cb) override;
 
     /**
      * Get the number of vbuckets in a single database file
@@ -353,8 +368,26 @@ public:
     bool getStat(const char* name, size_t& value) override;
 
     static int recordDbDump(Db *db, DocInfo *docinfo, void *ctx);
+
+    /**
+     * scan() of a context restricted by setScanCollections(): visit the
+     * remaining documents of sctx.collectionKeys.
+     */
+    scan_error_t scanCollectionKeys(Db* db, ScanContext& sctx);
+
+    /**
+     * scan() of a context set to key order by setScanKeyOrder(): walk the
+     * by-key index from sctx.keyOrderResumeKey (or the start).
+     */
+    scan_error_t scanKeyOrder(Db* db, ScanContext& sctx);
     static int recordDbStat(Db *db, DocInfo *docinfo, void *ctx);
     static int getMultiCb(Db *db, DocInfo *docinfo, void *ctx);
+
+    /**
+     * Read the document described by docinfo and complete the matching
+     * background fetch(es) in ctx.
+     */
+    static void getMultiFetchDoc(Db* db, DocInfo* docinfo, GetMultiCbCtx& ctx);
     ENGINE_ERROR_CODE readVBState(Db* db, Vbid vbId);
 
     couchstore_error_t fetchDoc(Db* db,
@@ -383,6 +416,12 @@ public:
             DocumentFilter options,
             ValueFilter valOptions) override;
 
+    bool setScanKeyOrder(ScanContext& sctx) override;
+
+    bool setScanCollections(
+            ScanContext& sctx,
+            const std::vector<CollectionID>& collections) override;
+
     scan_error_t scan(ScanContext* sctx) override;
 
     void destroyScanContext(ScanContext* ctx) override;
@@ -426,7 +465,12 @@ protected:
      */
     class DbHolder {
     public:
-        DbHolder(CouchKVStore& kvs) : kvstore(kvs), db(nullptr), fileRev(0) {
+        DbHolder(CouchKVStore& kvs)
+            : kvstore(kvs),
+              db(nullptr),
+              fileRev(0),
+              cacheable(false),
+              generation(0) {
         }
 
         DbHolder(const DbHolder&) = delete;
@@ -464,10 +508,34 @@ protected:
             return fileRev;
         }
 
+        /**
+         * Return the handle to the store's readHandleCache when closed,
+         * rather than closing it.
+         *
+         * @param gen header generation read before the handle was opened
+         */
+        void setCacheable(Vbid vb, uint64_t gen) {
+            vbid = vb;
+            generation = gen;
+            cacheable = true;
+        }
+
+        // Close the handle when done even if it could be cached, e.g. as
+        // reading it failed.
+        void setUncacheable() {
+            cacheable = false;
+        }
+
         // Allow a non-RAII close, needed for some use-cases
         void close() {
             if (db) {
-                kvstore.closeDatabaseHandle(releaseDb());
+                if (cacheable) {
+                    cacheable = false;
+                    kvstore.readHandleCache->put(
+                            vbid, fileRev, generation, releaseDb());
+                } else {
+                    kvstore.closeDatabaseHandle(releaseDb());
+                }
             }
         }
 
@@ -477,6 +545,10 @@ protected:
         CouchKVStore& kvstore;
         Db* db;
         uint64_t fileRev;
+        // See setCacheable()
+        bool cacheable;
+        Vbid vbid;
+        uint64_t generation;
     };
 
     /**
@@ -552,7 +624,20 @@ protected:
     void operator=(const CouchKVStore &from);
 
     void close();
-    bool commit2couchstore(Collections::VB::Flush& collectionsFlush);
+    bool commit2couchstore(PendingRequestQueue& reqs,
+                           TransactionContext& txCtx,
+                           Collections::VB::Flush& collectionsFlush,
+                           bool writeCollectionsMeta);
+
+    /**
+     * Wait until no other thread has a write transaction open on this
+     * store, then take ownership of it for the calling thread (see
+     * transactionOwner).
+     */
+    void acquireTransaction();
+
+    /// Give up the calling thread's ownership of the write transaction.
+    void releaseTransaction();
 
     uint64_t checkNewRevNum(std::string &dbname, bool newFile = false);
     void populateFileNameMap(std::vector<std::string>& filenames,
@@ -563,6 +648,37 @@ protected:
                               couchstore_open_flags options,
                               FileOpsInterface* ops = nullptr);
 
+    /**
+     * Open the vBucket's file read-only, reusing a handle from
+     * readHandleCache if it holds a current one; the handle is returned to
+     * the cache when db is closed.
+     */
+    couchstore_error_t openCachedDB(Vbid vbucketId, DbHolder& db);
+
+    /**
+     * Record that a new header was committed to the vBucket's file, so
+     * cached read handles opened before it are no longer used.
+     */
+    void headerCommitted(Vbid vbucketId);
+
+    /**
+     * Record that the vBucket's file revision changed (compaction, reset
+     * or deletion), so cached read handles of the old file are closed.
+     */
+    void fileRevisionChanged(Vbid vbucketId);
+
+    /**
+     * Implementation of getMulti() / getMultiSequential().
+     *
+     * @param offsetOrder read the documents in ascending file offset order
+     *        once all have been looked up, instead of in key order.
+     * @param ops FileOps to open the file with (nullptr for the default).
+     */
+    void getMultiImpl(Vbid vb,
+                      vb_bgfetch_queue_t& itms,
+                      bool offsetOrder,
+                      FileOpsInterface* ops);
+
     couchstore_error_t openSpecificDB(Vbid vbucketId,
                                       uint64_t rev,
                                       DbHolder& db,
@@ -586,9 +702,11 @@ protected:
                                 const std::vector<Doc*>& docs,
                                 std::vector<DocInfo*>& docinfos,
                                 kvstats_ctx& kvctx,
-                                Collections::VB::Flush& collectionsFlush);
+                                Collections::VB::Flush& collectionsFlush,
+                                bool writeCollectionsMeta);
 
     void commitCallback(PendingRequestQueue& committedReqs,
+                        TransactionContext& txCtx,
                         kvstats_ctx& kvctx,
                         couchstore_error_t errCode);
     couchstore_error_t saveVBState(Db *db, const vbucket_state &vbState);
@@ -649,14 +767,71 @@ protected:
      */
     couchstore_error_t deleteLocalDoc(Db& db, const std::string& name);
 
+    /// A header committed to a vBucket's file; see RollbackIndex.
+    struct RollbackIndexEntry {
+        uint64_t seqno;
+        /// File offset of the header.
+        cs_off_t headerPos;
+        /// File offset just past the header.
+        cs_off_t headerEnd;
+    };
+
+    /**
+     * Sparse index of the headers committed to a vBucket's file, one every
+     * couchstore_rollback_index_interval seqnos, so that rollback can open
+     * the file at the first indexed header past the rollback seqno instead
+     * of rewinding through every header after it. Persisted (as of the
+     * previous commit) in the file's rollbackIndexName local document.
+     */
+    struct RollbackIndex {
+        /// Whether the index has been read from the file yet.
+        bool loaded = false;
+        /// Whether entries changed since the index was last persisted.
+        bool dirty = false;
+        /// Revision of the file the entries are of.
+        uint64_t fileRev = 0;
+        /// In order of seqno (and so of file offset).
+        std::deque<RollbackIndexEntry> entries;
+    };
+
+    /**
+     * Get the vBucket's rollback index for the given revision of its file,
+     * reading it from db (the latest header of that revision) if not yet
+     * read. Requires rollbackIndexMutex to be held.
+     */
+    RollbackIndex& getRollbackIndex(Db& db, Vbid vbid, uint64_t fileRev);
+
+    /**
+     * If the vBucket's rollback index has changed since it was persisted,
+     * write it to db, to be committed with the flush.
+     *
+     * @return error code success or other (non-success is logged)
+     */
+    couchstore_error_t saveRollbackIndex(Db& db, Vbid vbid, uint64_t fileRev);
+
+    /**
+     * Add the header just committed to db (described by info) to the
+     * vBucket's rollback index, if it is at least
+     * couchstore_rollback_index_interval seqnos after the last one indexed.
+     */
+    void addRollbackIndexEntry(Vbid vbid,
+                               uint64_t fileRev,
+                               const DbInfo& info);
+
     /**
      * Sync the KVStore::collectionsMeta structures to the database.
      *
+     * If collections were dropped, the flush is told to purge them with a
+     * compaction only once the vBucket's dropped collections hold at least
+     * couchstore_collection_purge_ratio of its items; until then their
+     * documents are skipped at read time, and purged by the next compaction.
+     *
      * @param db The database handle to update
+     * @param vbid The vBucket of db
      * @return error code success or other (non-success is logged)
      */
     couchstore_error_t updateCollectionsMeta(
-            Db& db, Collections::VB::Flush& collectionsFlush);
+            Db& db, Vbid vbid, Collections::VB::Flush& collectionsFlush);
 
     /**
      * Called from updateCollectionsMeta this function maintains the current
@@ -689,13 +864,16 @@ protected:
      * @param db The database handle to update
      * @param dropped This method will only read the dropped collections from
      *        storage if this optional is not initialised
+     * @param [out] droppedItems the number of items the newly dropped
+     *        collections held
      * @return error code success or other (non-success is logged)
      */
     couchstore_error_t updateDroppedCollections(
             Db& db,
             boost::optional<
                     std::vector<Collections::KVStore::DroppedCollection>>
-                    dropped);
+                    dropped,
+            uint64_t& droppedItems);
 
     /**
      * Called from updateCollectionsMeta this function maintains the set of
@@ -742,6 +920,22 @@ protected:
 
     void removeCompactFile(const std::string &filename);
 
+    /**
+     * Remove the given file and drop it from the block cache, so a later
+     * file of the same name isn't served its blocks. All removal of couch
+     * files must go through here (or renameFile).
+     *
+     * @return the result of remove()
+     */
+    int removeFile(const std::string& path);
+
+    /**
+     * Rename from over to, dropping both from the block cache.
+     *
+     * @return the result of rename()
+     */
+    int renameFile(const std::string& from, const std::string& to);
+
     /**
      * Perform compaction using the context and dhook call back.
      * @param hook_ctx a context with information for the compaction process
@@ -751,6 +945,63 @@ protected:
     bool compactDBInternal(compaction_ctx* hook_ctx,
                            couchstore_docinfo_hook dhook);
 
+    /**
+     * Bring a file compacted concurrently with the flusher up to date with
+     * the writes made to the vBucket's file since compaction started.
+     *
+     * Changes are copied without blocking the flusher until no more than
+     * compactionTailItems seqnos remain (or maxCatchupRounds is reached);
+     * the remainder, along with the vBucket state and collection stats, is
+     * copied with writeLock held.
+     *
+     * @param vbid vBucket being compacted
+     * @param sourceRev revision of the file which was compacted
+     * @param rollbacks vbRollbackCount of the vBucket when compaction started
+     * @param collectionsMeta the source's collections metadata (see
+     *        readCollectionsMeta) when compaction started
+     * @param compactFile path of the compacted file
+     * @param compactedSeqno high seqno of the source when compaction started
+     * @param writeLock lock (not yet owned) on vbWriteMutexes[vbid]
+     * @param [out] lockedAt when writeLock was acquired
+     * @param ops file ops to use
+     * @return true if the compacted file was caught up, in which case
+     *         writeLock is held and the caller must switch to it before
+     *         releasing writeLock
+     */
+    bool catchUpCompactedFile(Vbid vbid,
+                              uint64_t sourceRev,
+                              uint64_t rollbacks,
+                              const std::string& collectionsMeta,
+                              const std::string& compactFile,
+                              uint64_t compactedSeqno,
+                              std::unique_lock<std::mutex>& writeLock,
+                              std::chrono::steady_clock::time_point& lockedAt,
+                              FileOpsInterface* ops);
+
+    /**
+     * Copy all documents (including deletions) with a seqno of at least
+     * startSeqno from source to target, preserving their seqnos.
+     *
+     * @return COUCHSTORE_SUCCESS or the error which stopped the copy
+     */
+    couchstore_error_t copyChangesSince(Db& source,
+                                        Db& target,
+                                        uint64_t startSeqno);
+
+    /**
+     * Copy the local documents the flusher updates as it writes (the
+     * vBucket state and each open collection's stats) from source to
+     * target.
+     */
+    couchstore_error_t copyFlusherLocalDocs(Db& source, Db& target);
+
+    /**
+     * @return the collections metadata local documents of db (manifest, open
+     *         collections, scopes and dropped collections) concatenated, for
+     *         checking whether they changed.
+     */
+    std::string readCollectionsMeta(Db& db);
+
     /// Copy relevant DbInfo stats to the common FileStats struct
     static FileInfo toFileInfo(const DbInfo& info);
 
@@ -768,6 +1019,22 @@ protected:
      */
     std::shared_ptr<RevisionMap> dbFileRevMap;
 
+    /**
+     * Counts of changes to the files which invalidate read handles opened
+     * before them: per vBucket, of the headers committed to its file; and
+     * overall, of file revision changes. Shared by a RW/RO pair the same as
+     * dbFileRevMap, as the RW store makes the changes and both cache read
+     * handles.
+     */
+    struct HeaderGenerations {
+        explicit HeaderGenerations(size_t numVBuckets)
+            : perVBucket(numVBuckets), revisionChanges(0) {
+        }
+        std::vector<std::atomic<uint64_t>> perVBucket;
+        std::atomic<uint64_t> revisionChanges;
+    };
+    std::shared_ptr<HeaderGenerations> headerGenerations;
+
     /**
      * An internal rwlock used to keep openDB and compaction in sync
      * Primarily that compaction and scans can be ran concurrently, we must
@@ -777,11 +1044,52 @@ protected:
      */
     cb::RWLock openDbMutex;
 
+    /**
+     * Per-vBucket mutex serialising writes to a vBucket's file (by the
+     * flusher, reset, deletion and rollback) with the final phase of a
+     * concurrent compaction of it; see catchUpCompactedFile().
+     */
+    std::vector<std::mutex> vbWriteMutexes;
+
+    /**
+     * Per-vBucket count of rollbacks, resets and deletions, so a concurrent
+     * compaction can tell that the file it compacted was rewound or
+     * discarded. Updated with vbWriteMutexes held.
+     */
+    std::vector<cb::RelaxedAtomic<uint64_t>> vbRollbackCount;
+
+    /// Per-vBucket rollback index; guarded by rollbackIndexMutex.
+    std::vector<RollbackIndex> rollbackIndexes;
+    std::mutex rollbackIndexMutex;
+
     uint16_t numDbFiles;
     PendingRequestQueue pendingReqsQ;
     bool intransaction;
     std::unique_ptr<TransactionContext> transactionCtx;
 
+    /**
+     * The thread whose write transaction (pendingReqsQ, transactionCtx and
+     * collectionsMeta) is open; none if default constructed. A transaction
+     * is owned from begin() until commit() has taken its state (or it is
+     * rolled back), so while one vBucket's flush writes and syncs its file,
+     * another thread may begin the flush of a different vBucket. begin() by
+     * the owning thread replaces its transaction, as it always has; by any
+     * other thread it waits on transactionReleased.
+     */
+    std::thread::id transactionOwner;
+    std::mutex transactionMutex;
+    std::condition_variable transactionReleased;
+
+    /**
+     * FileOpsInterface implementation which encrypts the files couchstore
+     * writes, and decrypts them as it reads them back (see
+     * couchstore_encryption_key_file).
+     *
+     * Wraps base_ops, and is wrapped by the stat collecting ops (so those
+     * count the bytes couchstore sees). Null if disabled.
+     */
+    std::unique_ptr<FileOpsInterface> encryptedFileOps;
+
     /**
      * FileOpsInterface implementation for couchstore which tracks
      * all bytes read/written by couchstore *except* compaction.
@@ -798,11 +1106,107 @@ protected:
      */
     std::unique_ptr<FileOpsInterface> statCollectingFileOpsCompaction;
 
+    /**
+     * FileOpsInterface implementation used by flushes (saveDocs) which
+     * starts the writeback of what they write as they write it; see
+     * fsync_writeback_after_every_n_bytes_written.
+     *
+     * Wraps statCollectingFileOps. Null if disabled.
+     */
+    std::unique_ptr<FileOpsInterface> writebackFileOps;
+
+    /**
+     * FileOpsInterface implementation used by compaction which starts the
+     * writeback of the compacted file as it is written.
+     *
+     * Wraps statCollectingFileOpsCompaction. Null if disabled.
+     */
+    std::unique_ptr<FileOpsInterface> compactionWritebackFileOps;
+
+    /**
+     * FileOpsInterface implementation used by compaction which drops the
+     * pages it has read and written from the page cache; see
+     * compaction_drop_behind_size.
+     *
+     * Wraps compactionWritebackFileOps if enabled, else
+     * statCollectingFileOpsCompaction. Null if disabled.
+     */
+    std::unique_ptr<FileOpsInterface> compactionDropBehindFileOps;
+
+    /**
+     * FileOpsInterface implementation used by by-seqno scans which drops
+     * the pages they have read from the page cache; see
+     * backfill_drop_behind_size.
+     *
+     * Wraps statCollectingFileOps. Null if disabled.
+     */
+    std::unique_ptr<FileOpsInterface> scanDropBehindFileOps;
+
+    /**
+     * FileOpsInterface implementation used by by-seqno scans (initScanContext)
+     * which reads ahead of sequential reads; see backfill_readahead_size.
+     *
+     * Wraps scanDropBehindFileOps if enabled, else statCollectingFileOps.
+     * Null if readahead is disabled.
+     */
+    std::unique_ptr<FileOpsInterface> scanFileOps;
+
+    /**
+     * FileOpsInterface implementation used by getMultiSequential(), reading
+     * ahead of its offset-ordered reads; see
+     * warmup_access_log_readahead_size.
+     *
+     * Wraps statCollectingFileOps. Null if disabled.
+     */
+    std::unique_ptr<FileOpsInterface> warmupFileOps;
+
+    /**
+     * Cache of file blocks shared by the shard's RW and RO stores; see
+     * couchstore_block_cache_ratio. Null if disabled.
+     */
+    std::shared_ptr<CouchBlockCache> blockCache;
+
+    /**
+     * FileOpsInterface implementation reading through blockCache.
+     *
+     * Wraps statCollectingFileOps. Null if blockCache is disabled.
+     */
+    std::unique_ptr<BlockCacheOps> blockCacheFileOps;
+
+    /**
+     * FileOpsInterface implementation merging the document reads of
+     * offset-ordered getMulti batches; see bgfetch_merge_gap.
+     *
+     * Wraps blockCacheFileOps if enabled, else statCollectingFileOps. Null
+     * if bgfetch_offset_order is disabled.
+     */
+    std::unique_ptr<MergedReadOps> mergedReadFileOps;
+
+    /**
+     * The FileOps used by openCachedDB() (get, getMulti, getRange and file
+     * handles): the outermost of the above.
+     */
+    FileOpsInterface* readFileOps;
+
+    /**
+     * Idle read-only handles for reads (get, getMulti, getRange and file
+     * handles); see couchstore_read_handle_cache_size. Declared after the
+     * FileOps the handles use, so it's destroyed before them.
+     */
+    std::unique_ptr<CouchHandleCache> readHandleCache;
+
+    /// HeaderGenerations::revisionChanges as of the last purge of
+    /// readHandleCache.
+    std::atomic<uint64_t> readHandleCacheRevisionChanges{0};
+
     /* deleted docs in each file, indexed by vBucket. RelaxedAtomic
        to allow stats access witout lock */
     std::vector<cb::RelaxedAtomic<size_t>> cachedDeleteCount;
     std::vector<cb::RelaxedAtomic<uint64_t>> cachedFileSize;
     std::vector<cb::RelaxedAtomic<uint64_t>> cachedSpaceUsed;
+    /* items of each vBucket's dropped collections which no compaction has
+       purged yet (see couchstore_collection_purge_ratio) */
+    std::vector<cb::RelaxedAtomic<uint64_t>> droppedItemsPendingPurge;
     /* pending file deletions */
     AtomicQueue<std::string> pendingFileDeletions;
 
@@ -828,11 +1232,17 @@ private:
      * @param readOnly true if the store can only do read functionality
      * @param dbFileRevMap a revisionMap to use (which should be data owned by
      *        the RW store).
+     * @param headerGenerations the HeaderGenerations to use (also owned by
+     *        the RW store).
+     * @param blockCache the CouchBlockCache to read through (shared with the
+     *        RW store; null if disabled).
      */
     CouchKVStore(KVStoreConfig& config,
                  FileOpsInterface& ops,
                  bool readOnly,
-                 std::shared_ptr<RevisionMap> dbFileRevMap);
+                 std::shared_ptr<RevisionMap> dbFileRevMap,
+                 std::shared_ptr<HeaderGenerations> headerGenerations,
+                 std::shared_ptr<CouchBlockCache> blockCache);
 
     /**
      * Construct a read-only store - private as should be called via
@@ -841,9 +1251,13 @@ private:
      * @param config configuration data for the store
      * @param dbFileRevMap The revisionMap to use (which should be intially
      * created owned by the RW store).
+     * @param headerGenerations The HeaderGenerations of the RW store.
+     * @param blockCache The CouchBlockCache of the RW store (may be null).
      */
     CouchKVStore(KVStoreConfig& config,
-                 std::shared_ptr<RevisionMap> dbFileRevMap);
+                 std::shared_ptr<RevisionMap> dbFileRevMap,
+                 std::shared_ptr<HeaderGenerations> headerGenerations,
+                 std::shared_ptr<CouchBlockCache> blockCache);
 
 
     class CouchKVFileHandle : public ::KVFileHandle {
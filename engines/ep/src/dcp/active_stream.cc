@@ -18,8 +18,10 @@
 #include "active_stream_impl.h"
 
 #include "checkpoint_manager.h"
+#include "dcp/dcpconnmap.h"
 #include "dcp/producer.h"
 #include "dcp/response.h"
+#include "dcp/transformed_item_cache.h"
 #include "ep_time.h"
 #include "kv_bucket.h"
 #include "statwriter.h"
@@ -79,6 +81,11 @@ ActiveStream::ActiveStream(EventuallyPersistentEngine* e,
                                     : ForceValueCompression::No),
       syncReplication(p->isSyncReplicationEnabled() ? SyncReplication::Yes
                                                     : SyncReplication::No),
+      persistedOnly(p->isPersistedOnlyEnabled() ? PersistedOnly::Yes
+                                                : PersistedOnly::No),
+      backfillOrder(p->isKeyOrderBackfillEnabled() ? BackfillOrder::Key
+                                                   : BackfillOrder::Seqno),
+      transformedItemCache(vbucket.getTransformedItemCache()),
       filter(std::move(f)),
       sid(filter.getStreamId()) {
     const char* type = "";
@@ -87,7 +94,8 @@ ActiveStream::ActiveStream(EventuallyPersistentEngine* e,
         end_seqno_ = dcpMaxSeqno;
     }
 
-    folly::SharedMutex::ReadHolder rlh(vbucket.getStateLock());
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, vbucket.getStateLock());
     if (vbucket.getState() == vbucket_state_replica) {
         snapshot_info_t info = vbucket.checkpointManager->getSnapshotInfo();
         if (info.range.end > en_seqno) {
@@ -126,7 +134,7 @@ ActiveStream::ActiveStream(EventuallyPersistentEngine* e,
         /* streamMutex lock needs to be acquired because endStream
          * potentially makes call to pushToReadyQueue.
          */
-        LockHolder lh(streamMutex);
+        ProfiledLockHolder<LockHolder> lh(LockSite::DcpStream, streamMutex);
         endStream(END_STREAM_OK);
         itemsReady.store(true);
         // lock is released on leaving the scope
@@ -140,7 +148,7 @@ ActiveStream::~ActiveStream() {
 }
 
 std::unique_ptr<DcpResponse> ActiveStream::next() {
-    std::lock_guard<std::mutex> lh(streamMutex);
+    ProfiledLockHolder<LockHolder> lh(LockSite::DcpStream, streamMutex);
     return next(lh);
 }
 
@@ -233,7 +241,7 @@ void ActiveStream::registerCursor(CheckpointManager& chkptmgr,
 
 void ActiveStream::markDiskSnapshot(uint64_t startSeqno, uint64_t endSeqno) {
     {
-        LockHolder lh(streamMutex);
+        ProfiledLockHolder<LockHolder> lh(LockSite::DcpStream, streamMutex);
         uint64_t chkCursorSeqno = endSeqno;
 
         if (!isBackfilling()) {
@@ -292,7 +300,7 @@ void ActiveStream::markDiskSnapshot(uint64_t startSeqno, uint64_t endSeqno) {
                 opaque_, vb_, startSeqno, endSeqno, MARKER_FLAG_DISK, sid));
         lastSentSnapEndSeqno.store(endSeqno, std::memory_order_relaxed);
 
-        if (!(flags_ & DCP_ADD_STREAM_FLAG_DISKONLY)) {
+        if (!(flags_ & DCP_ADD_STREAM_FLAG_DISKONLY) && !isPersistedOnly()) {
             // Only re-register the cursor if we still need to get memory
             // snapshots
             registerCursor(*vb->checkpointManager, chkCursorSeqno);
@@ -328,7 +336,12 @@ bool ActiveStream::backfillReceived(std::unique_ptr<Item> itm,
 
         bufferedBackfill.bytes.fetch_add(resp->getApproximateSize());
         bufferedBackfill.items++;
-        lastReadSeqno.store(uint64_t(*resp->getBySeqno()));
+        const auto seqno = uint64_t(*resp->getBySeqno());
+        if (!isKeyOrderBackfill() || seqno > lastReadSeqno.load()) {
+            // The items of a key order backfill are not in seqno order; the
+            // stream has read up to the highest seqno once it completes.
+            lastReadSeqno.store(seqno);
+        }
 
         pushToReadyQ(std::move(resp));
 
@@ -347,7 +360,7 @@ bool ActiveStream::backfillReceived(std::unique_ptr<Item> itm,
 
 void ActiveStream::completeBackfill() {
     {
-        LockHolder lh(streamMutex);
+        ProfiledLockHolder<LockHolder> lh(LockSite::DcpStream, streamMutex);
         if (isBackfilling()) {
             log(spdlog::level::level_enum::info,
                 "{} Backfill complete, {}"
@@ -395,7 +408,8 @@ void ActiveStream::setVBucketStateAckRecieved() {
            any potential lock inversion problems */
         std::unique_lock<std::mutex> epVbSetLh(
                 engine->getKVBucket()->getVbSetMutexLock());
-        folly::SharedMutex::WriteHolder vbStateLh(vbucket->getStateLock());
+        ProfiledLockHolder<folly::SharedMutex::WriteHolder> vbStateLh(
+                LockSite::VBucketState, vbucket->getStateLock());
         std::unique_lock<std::mutex> lh(streamMutex);
         if (isTakeoverWait()) {
             if (takeoverState == vbucket_state_pending) {
@@ -423,11 +437,14 @@ void ActiveStream::setVBucketStateAckRecieved() {
                     lastSentSeqno.load(),
                     vbucket->getHighSeqno());
             } else {
+                endStream(END_STREAM_OK);
                 log(spdlog::level::level_enum::info,
                     "{} Receive ack for set vbucket state to "
-                    "active message",
-                    logPrefix);
-                endStream(END_STREAM_OK);
+                    "active message, takeover spent {}us sending and {}us "
+                    "waiting for acks",
+                    logPrefix,
+                    takeoverTimes.sendUsec.load(),
+                    takeoverTimes.waitUsec.load());
             }
         } else {
             log(spdlog::level::level_enum::warn,
@@ -491,12 +508,21 @@ std::unique_ptr<DcpResponse> ActiveStream::backfillPhase(
                 resp = nextQueuedItem();
             }
         } else {
-            if (lastReadSeqno.load() >= end_seqno_) {
+            if (lastReadSeqno.load() >= end_seqno_ ||
+                (isPersistedOnly() && getBackfilledSeqno() >= end_seqno_)) {
                 endStream(END_STREAM_OK);
             } else if (flags_ & DCP_ADD_STREAM_FLAG_TAKEOVER) {
                 transitionState(StreamState::TakeoverSend);
             } else if (flags_ & DCP_ADD_STREAM_FLAG_DISKONLY) {
                 endStream(END_STREAM_OK);
+            } else if (isPersistedOnly()) {
+                // Stay in Backfilling; backfill whatever has been persisted
+                // since the last backfill (if anything - else
+                // notifySeqnoPersisted will wake us once there is).
+                if (engine->getKVBucket()->getLastPersistedSeqno(vb_) >
+                    getBackfilledSeqno()) {
+                    scheduleBackfill_UNLOCKED(true);
+                }
             } else {
                 transitionState(StreamState::InMemory);
             }
@@ -675,6 +701,23 @@ void ActiveStream::addStats(const AddStatFn& add_stat, const void* c) {
                          vb_.get());
         add_casted_stat(buffer, cursor.lock() != nullptr, add_stat, c);
 
+        if (flags_ & DCP_ADD_STREAM_FLAG_TAKEOVER) {
+            checked_snprintf(buffer,
+                             bsize,
+                             "%s:stream_%d_takeover_send_usec",
+                             name_.c_str(),
+                             vb_.get());
+            add_casted_stat(
+                    buffer, takeoverTimes.sendUsec.load(), add_stat, c);
+            checked_snprintf(buffer,
+                             bsize,
+                             "%s:stream_%d_takeover_wait_usec",
+                             name_.c_str(),
+                             vb_.get());
+            add_casted_stat(
+                    buffer, takeoverTimes.waitUsec.load(), add_stat, c);
+        }
+
         if (isTakeoverSend() && takeoverStart != 0) {
             checked_snprintf(buffer,
                              bsize,
@@ -697,7 +740,7 @@ void ActiveStream::addStats(const AddStatFn& add_stat, const void* c) {
 void ActiveStream::addTakeoverStats(const AddStatFn& add_stat,
                                     const void* cookie,
                                     const VBucket& vb) {
-    LockHolder lh(streamMutex);
+    ProfiledLockHolder<LockHolder> lh(LockSite::DcpStream, streamMutex);
 
     add_casted_stat("name", name_, add_stat, cookie);
     if (!isActive()) {
@@ -802,7 +845,7 @@ bool ActiveStream::nextCheckpointItem() {
 
 void ActiveStream::nextCheckpointItemTask() {
     // MB-29369: Obtain stream mutex here
-    LockHolder lh(streamMutex);
+    ProfiledLockHolder<LockHolder> lh(LockSite::DcpStream, streamMutex);
     nextCheckpointItemTask(lh);
 }
 
@@ -841,6 +884,24 @@ std::vector<queued_item> ActiveStream::getOutstandingItems(VBucket& vb) {
     return items;
 }
 
+/**
+ * Is stripping the xattrs the only change needed to send the item? If so
+ * the xattrs can be hidden (see Item::hideXattrs()) rather than copying the
+ * value without them.
+ */
+static bool canHideXattrs(const queued_item& item,
+                          IncludeValue includeValue,
+                          IncludeXattrs includeXattrs,
+                          bool isForceValueCompressionEnabled,
+                          bool isSnappyEnabled) {
+    const auto datatype = item->getDataType();
+    return item->getValue() && includeValue == IncludeValue::Yes &&
+           includeXattrs == IncludeXattrs::No &&
+           mcbp::datatype::is_xattr(datatype) &&
+           !mcbp::datatype::is_snappy(datatype) &&
+           !(isSnappyEnabled && isForceValueCompressionEnabled);
+}
+
 /**
  * This function is used to find out if a given item's value
  * needs to be changed
@@ -916,34 +977,44 @@ std::unique_ptr<DcpResponse> ActiveStream::makeResponseFromItem(
     }
 
     if (item->getOperation() != queue_op::system_event) {
+        if (canHideXattrs(item,
+                          includeValue,
+                          includeXattributes,
+                          isForceValueCompressionEnabled(),
+                          isSnappyEnabled())) {
+            // Send the value from the original (shared) blob, skipping the
+            // xattrs, rather than copying the value without them.
+            auto finalItem = std::make_unique<Item>(*item);
+            finalItem->hideXattrs();
+            return std::make_unique<MutationResponse>(std::move(finalItem),
+                                                      opaque_,
+                                                      includeValue,
+                                                      includeXattributes,
+                                                      includeDeleteTime,
+                                                      includeCollectionID,
+                                                      enableExpiryOutput,
+                                                      sid);
+        }
+
         if (shouldModifyItem(item,
                              includeValue,
                              includeXattributes,
                              isForceValueCompressionEnabled(),
                              isSnappyEnabled())) {
-            auto finalItem = std::make_unique<Item>(*item);
-            finalItem->pruneValueAndOrXattrs(includeValue, includeXattributes);
-
-            if (isSnappyEnabled()) {
-                if (isForceValueCompressionEnabled()) {
-                    if (!mcbp::datatype::is_snappy(finalItem->getDataType())) {
-                        if (!finalItem->compressValue()) {
-                            log(spdlog::level::level_enum::warn,
-                                "{} Failed to snappy compress an uncompressed "
-                                "value",
-                                logPrefix);
-                        }
-                    }
-                }
-            } else {
-                if (mcbp::datatype::is_snappy(finalItem->getDataType())) {
-                    if (!finalItem->decompressValue()) {
-                        log(spdlog::level::level_enum::warn,
-
-                            "{} Failed to snappy uncompress a compressed "
-                            "value",
-                            logPrefix);
-                    }
+            // Streams of this vBucket with the same features transform the
+            // item identically, so share the result if possible.
+            queued_item finalItem;
+            const TransformedItemCache::Features features{includeValue,
+                                                          includeXattributes,
+                                                          snappyEnabled,
+                                                          forceValueCompression};
+            if (transformedItemCache) {
+                finalItem = transformedItemCache->find(*item, features);
+            }
+            if (!finalItem) {
+                finalItem = makeTransformedItem(*item);
+                if (transformedItemCache) {
+                    transformedItemCache->insert(*item, features, finalItem);
                 }
             }
 
@@ -973,6 +1044,54 @@ std::unique_ptr<DcpResponse> ActiveStream::makeResponseFromItem(
     return SystemEventProducerMessage::make(opaque_, item, sid);
 }
 
+std::unique_ptr<Item> ActiveStream::makeTransformedItem(const Item& item) {
+    auto finalItem = std::make_unique<Item>(item);
+    finalItem->pruneValueAndOrXattrs(includeValue, includeXattributes);
+
+    if (isSnappyEnabled()) {
+        if (isForceValueCompressionEnabled()) {
+            if (!mcbp::datatype::is_snappy(finalItem->getDataType())) {
+                // Values of collections whose recent values didn't compress
+                // are only compressed as a sample; empty values (deletes,
+                // key-only streams) say nothing about the collection.
+                auto& sampler = engine->getDcpConnMap().getCompressionSampler();
+                const auto cid = finalItem->getKey().getCollectionID();
+                const bool sample = finalItem->getNBytes() > 0;
+                if (sample && !sampler.shouldAttempt(cid)) {
+                    ++engine->getEpStats().dcpCompressionNumSkipped;
+                } else {
+                    // Ship the value as is if compressing it saves too
+                    // little for the consumer's decompression to be
+                    // worthwhile.
+                    const auto ratio =
+                            engine->getDcpConnMap().getMinCompressionRatio();
+                    if (!finalItem->compressValue(ratio)) {
+                        log(spdlog::level::level_enum::warn,
+                            "{} Failed to snappy compress an uncompressed "
+                            "value",
+                            logPrefix);
+                    }
+                    if (sample) {
+                        sampler.record(cid,
+                                       mcbp::datatype::is_snappy(
+                                               finalItem->getDataType()));
+                    }
+                }
+            }
+        }
+    } else {
+        if (mcbp::datatype::is_snappy(finalItem->getDataType())) {
+            if (!finalItem->decompressValue()) {
+                log(spdlog::level::level_enum::warn,
+                    "{} Failed to snappy uncompress a compressed "
+                    "value",
+                    logPrefix);
+            }
+        }
+    }
+    return finalItem;
+}
+
 void ActiveStream::processItems(std::vector<queued_item>& items,
                                 const LockHolder& streamMutex) {
     if (!items.empty()) {
@@ -1118,7 +1237,7 @@ void ActiveStream::snapshot(std::deque<std::unique_ptr<DcpResponse>>& items) {
 
 uint32_t ActiveStream::setDead(end_stream_status_t status) {
     {
-        LockHolder lh(streamMutex);
+        ProfiledLockHolder<LockHolder> lh(LockSite::DcpStream, streamMutex);
         endStream(status);
     }
 
@@ -1129,7 +1248,22 @@ uint32_t ActiveStream::setDead(end_stream_status_t status) {
 }
 
 void ActiveStream::notifySeqnoAvailable(uint64_t seqno) {
-    if (isActive()) {
+    // A persisted-only stream has nothing to send until the item is
+    // persisted; see notifySeqnoPersisted.
+    if (isActive() && !isPersistedOnly()) {
+        notifyStreamReady();
+    }
+}
+
+uint64_t ActiveStream::getBackfilledSeqno() const {
+    // The disk snapshot may end after the last item read, if the items
+    // at its end were not replicated (e.g. filtered out by collections).
+    return std::max(lastReadSeqno.load(),
+                    lastSentSnapEndSeqno.load(std::memory_order_relaxed));
+}
+
+void ActiveStream::notifySeqnoPersisted(uint64_t seqno) {
+    if (isActive() && isPersistedOnly() && seqno > getBackfilledSeqno()) {
         notifyStreamReady();
     }
 }
@@ -1216,7 +1350,8 @@ void ActiveStream::scheduleBackfill_UNLOCKED(bool reschedule) {
     uint64_t backfillEnd = 0;
     bool tryBackfill = false;
 
-    if ((flags_ & DCP_ADD_STREAM_FLAG_DISKONLY) || reschedule) {
+    if ((flags_ & DCP_ADD_STREAM_FLAG_DISKONLY) || reschedule ||
+        isPersistedOnly()) {
         uint64_t vbHighSeqno = static_cast<uint64_t>(vbucket->getHighSeqno());
         if (lastReadSeqno.load() > vbHighSeqno) {
             throw std::logic_error(logPrefix +
@@ -1228,7 +1363,13 @@ void ActiveStream::scheduleBackfill_UNLOCKED(bool reschedule) {
                                    "for stream " + producer->logHeader() +
                                    "; " + logPrefix);
         }
-        if (reschedule) {
+        if (isPersistedOnly()) {
+            // Persisted-only streams backfill everything on disk, repeatedly,
+            // instead of registering a cursor.
+            backfillEnd = std::min(
+                    end_seqno_,
+                    engine->getKVBucket()->getLastPersistedSeqno(vb_));
+        } else if (reschedule) {
             /* We need to do this for reschedule because in case of
                DCP_ADD_STREAM_FLAG_DISKONLY (the else part), end_seqno_ is
                set to last persisted seqno befor calling
@@ -1301,6 +1442,12 @@ void ActiveStream::scheduleBackfill_UNLOCKED(bool reschedule) {
         producer->scheduleBackfillManager(
                 *vbucket, shared_from_this(), backfillStart, backfillEnd);
         isBackfillTaskRunning.store(true);
+    } else if (isPersistedOnly()) {
+        // Nothing persisted to send yet; stay in Backfilling until
+        // notifySeqnoPersisted.
+        if (getBackfilledSeqno() >= end_seqno_) {
+            endStream(END_STREAM_OK);
+        }
     } else {
         if (reschedule) {
             // Infrequent code path, see comment below.
@@ -1392,7 +1539,7 @@ void ActiveStream::scheduleBackfill_UNLOCKED(bool reschedule) {
 }
 
 bool ActiveStream::handleSlowStream() {
-    LockHolder lh(streamMutex);
+    ProfiledLockHolder<LockHolder> lh(LockSite::DcpStream, streamMutex);
     log(spdlog::level::level_enum::info,
         "{} Handling slow stream; "
         "state_ : {}, "
@@ -1470,6 +1617,25 @@ std::string ActiveStream::getEndStreamStatusStr(end_stream_status_t status) {
                        "; this should not have happened!"};
 }
 
+void ActiveStream::recordTakeoverPhase(StreamState oldState,
+                                       StreamState newState) {
+    const auto now = std::chrono::steady_clock::now();
+    if (oldState == StreamState::TakeoverSend ||
+        oldState == StreamState::TakeoverWait) {
+        const auto duration = std::chrono::duration_cast<
+                std::chrono::microseconds>(now - takeoverPhaseStart);
+        auto& stats = engine->getEpStats();
+        if (oldState == StreamState::TakeoverSend) {
+            stats.dcpTakeoverSendHisto.add(duration);
+            takeoverTimes.sendUsec += duration.count();
+        } else {
+            stats.dcpTakeoverWaitHisto.add(duration);
+            takeoverTimes.waitUsec += duration.count();
+        }
+    }
+    takeoverPhaseStart = now;
+}
+
 void ActiveStream::transitionState(StreamState newState) {
     if (state_ == newState) {
         return;
@@ -1538,6 +1704,13 @@ void ActiveStream::transitionState(StreamState newState) {
     StreamState oldState = state_.load();
     state_ = newState;
 
+    if (oldState == StreamState::TakeoverSend ||
+        oldState == StreamState::TakeoverWait ||
+        newState == StreamState::TakeoverSend ||
+        newState == StreamState::TakeoverWait) {
+        recordTakeoverPhase(oldState, newState);
+    }
+
     switch (newState) {
     case StreamState::Backfilling:
         if (StreamState::Pending == oldState) {
@@ -19,9 +19,13 @@
 
 #include "collections/vbucket_filter.h"
 #include "dcp/stream.h"
+#include "lock_profiler.h"
 #include <spdlog/common.h>
 
+#include <chrono>
+
 class CheckpointManager;
+class TransformedItemCache;
 class VBucket;
 
 /**
@@ -96,7 +100,7 @@ public:
     std::unique_ptr<DcpResponse> next() override;
 
     void setActive() override {
-        LockHolder lh(streamMutex);
+        ProfiledLockHolder<LockHolder> lh(LockSite::DcpStream, streamMutex);
         if (isPending()) {
             transitionState(StreamState::Backfilling);
         }
@@ -106,6 +110,8 @@ public:
 
     void notifySeqnoAvailable(uint64_t seqno) override;
 
+    void notifySeqnoPersisted(uint64_t seqno) override;
+
     void snapshotMarkerAckReceived();
 
     void setVBucketStateAckRecieved();
@@ -124,6 +130,15 @@ public:
 
     bool isCompressionEnabled();
 
+    /**
+     * @return the collections the stream's filter allows, if it allows a
+     *         fixed set (see Collections::VB::Filter::getCollections()).
+     */
+    boost::optional<std::vector<CollectionID>> getFilterCollections() {
+        ProfiledLockHolder<LockHolder> lh(LockSite::DcpStream, streamMutex);
+        return filter.getCollections();
+    }
+
     bool isForceValueCompressionEnabled() const {
         return forceValueCompression == ForceValueCompression::Yes;
     }
@@ -177,6 +192,14 @@ public:
                (includeXattributes == IncludeXattrs::No);
     }
 
+    bool isPersistedOnly() const {
+        return persistedOnly == PersistedOnly::Yes;
+    }
+
+    bool isKeyOrderBackfill() const {
+        return backfillOrder == BackfillOrder::Key;
+    }
+
     const Cursor& getCursor() const override {
         return cursor;
     }
@@ -216,11 +239,23 @@ protected:
      */
     std::unique_ptr<DcpResponse> makeResponseFromItem(const queued_item& item);
 
+    /**
+     * @return a copy of the item with its value / xattrs pruned and its
+     *         value (de)compressed according to the stream's features.
+     */
+    std::unique_ptr<Item> makeTransformedItem(const Item& item);
+
     /* The transitionState function is protected (as opposed to private) for
      * testing purposes.
      */
     void transitionState(StreamState newState);
 
+    /**
+     * Account for the time spent in the takeover phase being left (if any),
+     * and note when the one being entered (if any) began.
+     */
+    void recordTakeoverPhase(StreamState oldState, StreamState newState);
+
     /**
      * Registers a cursor with a given CheckpointManager.
      * The result of calling the function is that it sets the pendingBackfill
@@ -343,6 +378,12 @@ private:
     spdlog::level::level_enum getTransitionStateLogLevel(StreamState currState,
                                                          StreamState newState);
 
+    /**
+     * @returns the seqno up to which the stream's backfills have read; used
+     * by persisted-only streams to decide if there is more to backfill.
+     */
+    uint64_t getBackfilledSeqno() const;
+
     /* The last sequence number queued from memory, but is yet to be
        snapshotted and put onto readyQ */
     std::atomic<uint64_t> lastReadSeqnoUnSnapshotted;
@@ -395,6 +436,20 @@ private:
      */
     const size_t takeoverSendMaxTime;
 
+    /// When the current TakeoverSend or TakeoverWait phase began
+    std::chrono::steady_clock::time_point takeoverPhaseStart;
+
+    /**
+     * The total time spent in the TakeoverSend (sending the remaining
+     * mutations and the vbucket state) and TakeoverWait (waiting for the
+     * consumer to ack the vbucket state) phases; each phase is entered once
+     * for the pending state and once for the active state.
+     */
+    struct {
+        std::atomic<uint64_t> sendUsec{0};
+        std::atomic<uint64_t> waitUsec{0};
+    } takeoverTimes;
+
     //! Last snapshot end seqno sent to the DCP client
     std::atomic<uint64_t> lastSentSnapEndSeqno;
 
@@ -427,6 +482,17 @@ private:
     /// Does this stream support synchronous replication?
     const SyncReplication syncReplication;
 
+    /// Does this stream send only persisted items (and never register a
+    /// checkpoint cursor)?
+    const PersistedOnly persistedOnly;
+
+    /// May this stream's disk backfills send documents in key order?
+    const BackfillOrder backfillOrder;
+
+    /// Cache of transformed items shared by this vBucket's streams, or
+    /// nullptr if disabled.
+    const std::shared_ptr<TransformedItemCache> transformedItemCache;
+
     /**
      * The filter the stream will use to decide which keys should be transmitted
      */
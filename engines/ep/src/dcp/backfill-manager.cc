@@ -28,8 +28,18 @@
 
 #include <phosphor/phosphor.h>
 
+#include <algorithm>
+
 static const size_t sleepTime = 1;
 
+/**
+ * The scan buffer of the backfill the current thread is running (if any), so
+ * bytesCheckAndRead / bytesForceRead (which are called from within
+ * DCPBackfill::run) account against the correct buffer when a manager runs
+ * more than one backfill at once.
+ */
+static thread_local BackfillScanBuffer* runningScanBuffer = nullptr;
+
 class BackfillManagerTask : public GlobalTask {
 public:
     BackfillManagerTask(EventuallyPersistentEngine& e,
@@ -71,7 +81,7 @@ bool BackfillManagerTask::run() {
         return false;
     }
 
-    backfill_status_t status = manager->backfill();
+    backfill_status_t status = manager->backfill(this);
     if (status == backfill_finished) {
         return false;
     } else if (status == backfill_snooze) {
@@ -96,7 +106,12 @@ std::chrono::microseconds BackfillManagerTask::maxExpectedDuration() {
 }
 
 BackfillManager::BackfillManager(EventuallyPersistentEngine& e)
-    : engine(e), managerTask(NULL) {
+    : engine(e),
+      maxConcurrency(
+              std::max(size_t(1),
+                       e.getConfiguration().getDcpBackfillConcurrency())),
+      numRunning(0),
+      extraScanBuffers(maxConcurrency - 1) {
     Configuration& config = e.getConfiguration();
 
     scanBuffer.bytesRead = 0;
@@ -104,6 +119,13 @@ BackfillManager::BackfillManager(EventuallyPersistentEngine& e)
     scanBuffer.maxBytes = config.getDcpScanByteLimit();
     scanBuffer.maxItems = config.getDcpScanItemLimit();
 
+    // scanBuffer goes last so it is the first to be acquired.
+    for (auto& extra : extraScanBuffers) {
+        extra = scanBuffer;
+        freeScanBuffers.push_back(&extra);
+    }
+    freeScanBuffers.push_back(&scanBuffer);
+
     buffer.bytesRead = 0;
     buffer.maxBytes = config.getDcpBackfillByteLimit();
     buffer.nextReadSize = 0;
@@ -123,13 +145,14 @@ void BackfillManager::addStats(DcpProducer& conn,
     conn.addStat(
             "backfill_num_snoozing", snoozingBackfills.size(), add_stat, c);
     conn.addStat("backfill_num_pending", pendingBackfills.size(), add_stat, c);
+    conn.addStat("backfill_num_running", numRunning, add_stat, c);
 }
 
 BackfillManager::~BackfillManager() {
-    if (managerTask) {
-        managerTask->cancel();
-        managerTask.reset();
+    for (auto& task : managerTasks) {
+        task->cancel();
     }
+    managerTasks.clear();
 
     while (!activeBackfills.empty()) {
         UniqueDCPBackfillPtr backfill = std::move(activeBackfills.front());
@@ -168,17 +191,27 @@ void BackfillManager::schedule(VBucket& vb,
         pendingBackfills.push_back(std::move(backfill));
     }
 
-    if (managerTask && !managerTask->isdead()) {
-        ExecutorPool::get()->wake(managerTask->getId());
-        return;
+    removeDeadTasks();
+    for (auto& task : managerTasks) {
+        ExecutorPool::get()->wake(task->getId());
     }
 
-    managerTask.reset(new BackfillManagerTask(engine, shared_from_this()));
-    ExecutorPool::get()->schedule(managerTask);
+    // Add another task if there are more backfills than tasks to run them,
+    // up to the concurrency limit.
+    const size_t numBackfills = activeBackfills.size() +
+                                snoozingBackfills.size() +
+                                pendingBackfills.size() + numRunning;
+    if (managerTasks.size() < std::min(maxConcurrency, numBackfills)) {
+        ExTask task = std::make_shared<BackfillManagerTask>(engine,
+                                                            shared_from_this());
+        managerTasks.push_back(task);
+        ExecutorPool::get()->schedule(task);
+    }
 }
 
 bool BackfillManager::bytesCheckAndRead(size_t bytes) {
     LockHolder lh(lock);
+    auto& scanBuffer = getScanBuffer();
     if (scanBuffer.itemsRead >= scanBuffer.maxItems) {
         return false;
     }
@@ -212,6 +245,7 @@ void BackfillManager::bytesForceRead(size_t bytes) {
 
     /* Irrespective of the scan buffer usage and overall backfill buffer usage
        we want to complete this backfill */
+    auto& scanBuffer = getScanBuffer();
     ++scanBuffer.itemsRead;
     scanBuffer.bytesRead += bytes;
     buffer.bytesRead += bytes;
@@ -251,19 +285,31 @@ void BackfillManager::bytesSent(size_t bytes) {
         if (canFitNext && enoughCleared) {
             buffer.nextReadSize = 0;
             buffer.full = false;
-            if (managerTask) {
-                ExecutorPool::get()->wake(managerTask->getId());
+            for (auto& task : managerTasks) {
+                ExecutorPool::get()->wake(task->getId());
             }
         }
     }
 }
 
-backfill_status_t BackfillManager::backfill() {
+backfill_status_t BackfillManager::backfill(GlobalTask* caller) {
     std::unique_lock<std::mutex> lh(lock);
 
     if (activeBackfills.empty() && snoozingBackfills.empty()
         && pendingBackfills.empty()) {
-        managerTask.reset();
+        // Nothing left for this task to do (other tasks may still be running
+        // a backfill, which they'll requeue themselves if needed).
+        if (caller) {
+            managerTasks.erase(
+                    std::remove_if(managerTasks.begin(),
+                                   managerTasks.end(),
+                                   [caller](const ExTask& task) {
+                                       return task.get() == caller;
+                                   }),
+                    managerTasks.end());
+        } else {
+            managerTasks.clear();
+        }
         return backfill_finished;
     }
 
@@ -306,15 +352,24 @@ backfill_status_t BackfillManager::backfill() {
         return reschedule ? backfill_success : backfill_snooze;
     }
 
+    auto* scan = acquireScanBuffer();
+    if (!scan) {
+        // Already running as many backfills as allowed.
+        return backfill_snooze;
+    }
+
     UniqueDCPBackfillPtr backfill = std::move(activeBackfills.front());
     activeBackfills.pop_front();
+    ++numRunning;
 
     lh.unlock();
+    runningScanBuffer = scan;
     backfill_status_t status = backfill->run();
+    runningScanBuffer = nullptr;
     lh.lock();
 
-    scanBuffer.bytesRead = 0;
-    scanBuffer.itemsRead = 0;
+    --numRunning;
+    releaseScanBuffer(*scan);
 
     switch (status) {
         case backfill_success:
@@ -373,7 +428,45 @@ void BackfillManager::moveToActiveQueue() {
 
 void BackfillManager::wakeUpTask() {
     LockHolder lh(lock);
-    if (managerTask) {
-        ExecutorPool::get()->wake(managerTask->getId());
+    for (auto& task : managerTasks) {
+        ExecutorPool::get()->wake(task->getId());
     }
 }
+
+size_t BackfillManager::getNumRunningBackfills() {
+    LockHolder lh(lock);
+    return numRunning;
+}
+
+BackfillScanBuffer& BackfillManager::getScanBuffer() {
+    return runningScanBuffer ? *runningScanBuffer : scanBuffer;
+}
+
+BackfillScanBuffer* BackfillManager::acquireScanBuffer() {
+    if (freeScanBuffers.empty()) {
+        return nullptr;
+    }
+    auto* buf = freeScanBuffers.back();
+    freeScanBuffers.pop_back();
+    if (buf != &scanBuffer) {
+        // Limits may have been changed since construction.
+        buf->maxBytes = scanBuffer.maxBytes;
+        buf->maxItems = scanBuffer.maxItems;
+    }
+    return buf;
+}
+
+void BackfillManager::releaseScanBuffer(BackfillScanBuffer& buf) {
+    buf.bytesRead = 0;
+    buf.itemsRead = 0;
+    freeScanBuffers.push_back(&buf);
+}
+
+void BackfillManager::removeDeadTasks() {
+    managerTasks.erase(std::remove_if(managerTasks.begin(),
+                                      managerTasks.end(),
+                                      [](const ExTask& task) {
+                                          return task->isdead();
+                                      }),
+                       managerTasks.end());
+}
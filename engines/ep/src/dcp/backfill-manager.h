@@ -40,12 +40,22 @@
  * - dcp_scan_byte_limit
  * - dcp_scan_item_limit
  * - dcp_backfill_byte_limit
+ * - dcp_backfill_concurrency
+ *
+ * By default a connection's backfills are run one at a time by a single
+ * BackfillManagerTask. If dcp_backfill_concurrency is greater than one, up to
+ * that many BackfillManagerTasks are scheduled, each running a different
+ * backfill, so a connection streaming many vBuckets from disk can use more
+ * than one AuxIO thread. Each running backfill has its own scan buffer; the
+ * connection-wide buffer (and hence dcp_backfill_byte_limit) is shared by
+ * all of them.
  */
 #pragma once
 
 #include "dcp/backfill.h"
 
 #include <list>
+#include <vector>
 
 class EventuallyPersistentEngine;
 class GlobalTask;
@@ -93,9 +103,18 @@ public:
 
     void bytesSent(size_t bytes);
 
-    // Called by the managerTask to acutally perform backfilling & manage
-    // backfills between the different queues.
-    backfill_status_t backfill();
+    /**
+     * Called by the managerTasks to acutally perform backfilling & manage
+     * backfills between the different queues.
+     *
+     * @param caller the BackfillManagerTask calling; it is forgotten about
+     *        once there are no more backfills (tests may pass nullptr, in
+     *        which case all tasks are).
+     */
+    backfill_status_t backfill(GlobalTask* caller = nullptr);
+
+    /// @return the number of backfills currently being run.
+    size_t getNumRunningBackfills();
 
     void wakeUpTask();
 
@@ -108,13 +127,37 @@ protected:
         bool full;
     } buffer;
 
-    //! The scan buffer is for the current stream being backfilled
+    //! The scan buffer is for the current stream being backfilled (the
+    //! first one, if more than one backfill is running).
     BackfillScanBuffer scanBuffer;
 
 private:
 
     void moveToActiveQueue();
 
+    /**
+     * @return the scan buffer the calling thread should account reads
+     * against - that of the backfill it is running, or scanBuffer if it is not
+     * running one.
+     */
+    BackfillScanBuffer& getScanBuffer();
+
+    /**
+     * Take a scan buffer for a backfill which is about to run. Must be called
+     * with lock held.
+     *
+     * @return the buffer, or nullptr if all are in use.
+     */
+    BackfillScanBuffer* acquireScanBuffer();
+
+    /// Return a scan buffer taken by acquireScanBuffer. Must be called with
+    /// lock held.
+    void releaseScanBuffer(BackfillScanBuffer& buf);
+
+    /// Remove (dead) tasks which are no longer scheduled. Must be called with
+    /// lock held.
+    void removeDeadTasks();
+
     std::mutex lock;
     std::list<UniqueDCPBackfillPtr> activeBackfills;
     std::list<std::pair<rel_time_t, UniqueDCPBackfillPtr> > snoozingBackfills;
@@ -122,5 +165,17 @@ private:
     //!   threshold we use waitingBackfills
     std::list<UniqueDCPBackfillPtr> pendingBackfills;
     EventuallyPersistentEngine& engine;
-    ExTask managerTask;
+
+    //! Max number of backfills which may run concurrently
+    //! (dcp_backfill_concurrency).
+    const size_t maxConcurrency;
+    //! Number of backfills currently being run by managerTasks.
+    size_t numRunning;
+    //! Scan buffers for the 2nd..Nth concurrently running backfills. Sized at
+    //! construction and never resized, so pointers to elements are stable.
+    std::vector<BackfillScanBuffer> extraScanBuffers;
+    //! Scan buffers not in use by a running backfill.
+    std::vector<BackfillScanBuffer*> freeScanBuffers;
+    //! The tasks running backfills; at most maxConcurrency.
+    std::vector<ExTask> managerTasks;
 };
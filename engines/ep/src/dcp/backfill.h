@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include "objectregistry.h"
+
 class ActiveStream;
 class ScanContext;
 
@@ -29,7 +31,7 @@ enum backfill_status_t {
     backfill_snooze
 };
 
-class DCPBackfill {
+class DCPBackfill : public MemoryDomainAllocated<MemoryDomain::Backfill> {
 public:
     DCPBackfill(std::shared_ptr<ActiveStream> s,
                 uint64_t startSeqno,
@@ -21,6 +21,8 @@
 #include "kv_bucket.h"
 #include "vbucket.h"
 
+#include <phosphor/phosphor.h>
+
 static std::string backfillStateToString(backfill_state_t state) {
     switch (state) {
     case backfill_state_init:
@@ -143,6 +145,12 @@ DCPBackfillDisk::DCPBackfillDisk(EventuallyPersistentEngine& e,
 
 backfill_status_t DCPBackfillDisk::run() {
     LockHolder lh(lock);
+    TRACE_EVENT2("dcp/backfill",
+                 "Disk::run",
+                 "vbid",
+                 getVBucketId().get(),
+                 "state",
+                 uint8_t(state));
     switch (state) {
     case backfill_state_init:
         return create();
@@ -203,10 +211,14 @@ backfill_status_t DCPBackfillDisk::create() {
         }
     }
 
-    auto cb = std::make_shared<DiskCallback>(stream);
-    auto cl = std::make_shared<CacheCallback>(engine, stream);
-    scanCtx = kvstore->initScanContext(
-            cb, cl, vbid, startSeqno, DocumentFilter::ALL_ITEMS, valFilter);
+    {
+        // The scan context (and its callbacks) is released by complete()
+        MemoryDomainGuard guard(MemoryDomain::Backfill);
+        auto cb = std::make_shared<DiskCallback>(stream);
+        auto cl = std::make_shared<CacheCallback>(engine, stream);
+        scanCtx = kvstore->initScanContext(
+                cb, cl, vbid, startSeqno, DocumentFilter::ALL_ITEMS, valFilter);
+    }
 
     // Check startSeqno against the purge-seqno of the opened datafile.
     // 1) A normal stream request would of checked inside streamRequest, but
@@ -224,6 +236,7 @@ backfill_status_t DCPBackfillDisk::create() {
         if (scanCtx) {
             log << " startSeqno:" << startSeqno
                 << " < purgeSeqno:" << scanCtx->purgeSeqno;
+            MemoryDomainGuard guard(MemoryDomain::Backfill);
             kvstore->destroyScanContext(scanCtx);
             status = END_STREAM_ROLLBACK;
         } else {
@@ -240,6 +253,14 @@ backfill_status_t DCPBackfillDisk::create() {
         stream->setDead(status);
         transitionState(backfill_state_done);
     } else {
+        if (stream->isKeyOrderBackfill() &&
+            !kvstore->setScanKeyOrder(*scanCtx)) {
+            stream->log(spdlog::level::level_enum::info,
+                        "({}) KVStore can't backfill in key order, "
+                        "backfilling in seqno order",
+                        stream->getVBucket());
+        }
+        setScanCollections(*kvstore, *stream);
         stream->incrBackfillRemaining(scanCtx->documentCount);
         stream->markDiskSnapshot(startSeqno, scanCtx->maxSeqno);
         transitionState(backfill_state_scanning);
@@ -248,6 +269,42 @@ backfill_status_t DCPBackfillDisk::create() {
     return backfill_success;
 }
 
+void DCPBackfillDisk::setScanCollections(KVStore& kvstore,
+                                         ActiveStream& stream) {
+    const double ratio =
+            engine.getConfiguration().getDcpBackfillCollectionScanRatio();
+    if (ratio <= 0) {
+        return;
+    }
+    auto collections = stream.getFilterCollections();
+    auto vb = engine.getVBucket(stream.getVBucket());
+    if (!collections || !vb) {
+        return;
+    }
+
+    uint64_t items = 0;
+    {
+        auto handle = vb->lockCollections();
+        for (const auto cid : *collections) {
+            if (handle.exists(cid)) {
+                items += handle.getItemCount(cid);
+            }
+        }
+    }
+    if (items > ratio * vb->getNumTotalItems()) {
+        return;
+    }
+
+    if (kvstore.setScanCollections(*scanCtx, *collections)) {
+        stream.log(spdlog::level::level_enum::info,
+                   "({}) Backfilling {} collection(s) by key range, "
+                   "{} documents",
+                   stream.getVBucket(),
+                   collections->size(),
+                   scanCtx->documentCount);
+    }
+}
+
 backfill_status_t DCPBackfillDisk::scan() {
     auto stream = streamPtr.lock();
     if (!stream) {
@@ -276,7 +333,10 @@ backfill_status_t DCPBackfillDisk::complete(bool cancelled) {
     /* we want to destroy kv store context irrespective of a premature complete
        or not */
     KVStore* kvstore = engine.getKVBucket()->getROUnderlying(getVBucketId());
-    kvstore->destroyScanContext(scanCtx);
+    {
+        MemoryDomainGuard guard(MemoryDomain::Backfill);
+        kvstore->destroyScanContext(scanCtx);
+    }
 
     auto stream = streamPtr.lock();
     if (!stream) {
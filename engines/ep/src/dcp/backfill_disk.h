@@ -23,6 +23,7 @@
 #include <mutex>
 
 class EventuallyPersistentEngine;
+class KVStore;
 class ScanContext;
 class VBucket;
 
@@ -90,6 +91,14 @@ private:
      */
     backfill_status_t create();
 
+    /**
+     * If the stream is filtered to a fixed set of collections which hold a
+     * small part of the vBucket (see dcp_backfill_collection_scan_ratio),
+     * restrict the scan to their key ranges rather than reading (and then
+     * discarding) every document of the vBucket.
+     */
+    void setScanCollections(KVStore& kvstore, ActiveStream& stream);
+
     /**
      * Scan the disk (by calling KVStore apis) for the items in the backfill
      * snapshot range created in the create scan context. This is an
@@ -48,7 +48,8 @@ backfill_status_t DCPBackfillMemory::run() {
     }
 
     /* Get vb state lock */
-    folly::SharedMutex::ReadHolder rlh(evb->getStateLock());
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, evb->getStateLock());
     if (evb->getState() == vbucket_state_dead) {
         /* We don't have to close the stream here. Task doing vbucket state
            change should handle stream closure */
@@ -128,7 +129,8 @@ DCPBackfillMemoryBuffered::~DCPBackfillMemoryBuffered() {
 }
 
 backfill_status_t DCPBackfillMemoryBuffered::run() {
-    folly::SharedMutex::ReadHolder rlh(evb->getStateLock());
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, evb->getStateLock());
     if (evb->getState() == vbucket_state_dead) {
         /* We don't have to close the stream here. Task doing vbucket state
            change should handle stream closure */
@@ -187,14 +189,16 @@ backfill_status_t DCPBackfillMemoryBuffered::create() {
 
     /* Create range read cursor */
     try {
-        auto rangeItrOptional = evb->makeRangeIterator(true /*isBackfill*/);
+        auto rangeItrOptional =
+                evb->makeRangeIterator(true /*isBackfill*/,
+                                       static_cast<seqno_t>(startSeqno));
         if (rangeItrOptional) {
             rangeItr = std::move(*rangeItrOptional);
         } else {
             stream->log(spdlog::level::level_enum::debug,
                         "{}"
-                        " Deferring backfill creation as another "
-                        "range iterator is already on the sequence list",
+                        " Deferring backfill creation as the sequence "
+                        "list is being purged",
                         getVBucketId());
             return backfill_snooze;
         }
@@ -223,8 +227,9 @@ backfill_status_t DCPBackfillMemoryBuffered::create() {
         return backfill_finished;
     }
 
-    /* Advance the cursor till start, mark snapshot and update backfill
-       remaining count */
+    /* Advance the cursor till start (the iterator is created at the first
+       item >= startSeqno, so this only skips when there is no such item),
+       mark snapshot and update backfill remaining count */
     while (rangeItr.curr() != rangeItr.end()) {
         if (static_cast<uint64_t>((*rangeItr).getBySeqno()) >= startSeqno) {
             /* Incr backfill remaining
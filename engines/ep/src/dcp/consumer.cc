@@ -51,6 +51,7 @@ class DcpConsumerTask : public GlobalTask {
 public:
     DcpConsumerTask(EventuallyPersistentEngine* e,
                     std::shared_ptr<DcpConsumer> c,
+                    size_t index,
                     double sleeptime = 1,
                     bool completeBeforeShutdown = true)
         : GlobalTask(e,
@@ -58,6 +59,7 @@ public:
                      sleeptime,
                      completeBeforeShutdown),
           consumerPtr(c),
+          index(index),
           description("DcpConsumerTask, processing buffered items for " +
                       c->getName()) {
     }
@@ -98,31 +100,33 @@ public:
 
         // Check if we've been notified of more work to do - if not then sleep;
         // if so then wakeup and re-run the task.
+        // Each task has a notification flag of its own, so one task taking
+        // a notification can't make another one miss it.
         // Note: The order of the wakeUp / snooze here is *critical* - another
-        // thread may concurrently notify us (set processorNotification=true)
+        // thread may concurrently notify us (set our notification=true)
         // while we are performing the checks, so we need to ensure we don't
         // loose a wakeup as that would result in this Task sleeping forever
         // (and DCP hanging).
         // To prevent this, we perform an initial check of notifiedProcessor(),
         // which if false we initially sleep, and then check a second time.
-        // We could race if the other actor sets processorNotification=true
+        // We could race if the other actor sets our notification=true
         // between the second `if(consumer->notifiedProcessor)` and us calling
         // `wakeUp()`; but that's essentially a benign race as it will just
         // result in wakeUp() being called twice which is benign.
-        if (consumer->notifiedProcessor(false)) {
+        if (consumer->notifiedProcessor(index, false)) {
             wakeUp();
             state = more_to_process;
         } else {
             snooze(sleepFor);
             // Check if the processor was notified again,
             // in which case the task should wake immediately.
-            if (consumer->notifiedProcessor(false)) {
+            if (consumer->notifiedProcessor(index, false)) {
                 wakeUp();
                 state = more_to_process;
             }
         }
 
-        consumer->setProcessorTaskState(state);
+        consumer->setProcessorTaskState(index, state);
 
         return true;
     }
@@ -138,9 +142,12 @@ public:
     }
 
 private:
-    /* we have one task per consumer. the task only needs a reference to the
-       consumer object and does not own it. Hence std::weak_ptr should be used*/
+    /* we have one or more tasks per consumer. the task only needs a reference
+       to the consumer object and does not own it. Hence std::weak_ptr should
+       be used*/
     const std::weak_ptr<DcpConsumer> consumerPtr;
+    /// This task's index into the consumer's processorTasks
+    const size_t index;
     const std::string description;
 };
 
@@ -152,9 +159,11 @@ DcpConsumer::DcpConsumer(EventuallyPersistentEngine& engine,
       lastMessageTime(ep_current_time()),
       engine(engine),
       opaqueCounter(0),
-      processorTaskId(0),
-      processorTaskState(all_processed),
-      processorNotification(false),
+      processorTasks(std::max(
+              size_t(1),
+              engine.getConfiguration()
+                      .getDcpConsumerProcessBufferedMessagesConcurrency())),
+      vbReady(engine.getConfiguration().getMaxVbuckets()),
       backoffs(0),
       dcpNoopTxInterval(engine.getConfiguration().getDcpNoopTxInterval()),
       pendingSendStreamEndOnClientStreamClose(true),
@@ -195,7 +204,9 @@ DcpConsumer::~DcpConsumer() {
 void DcpConsumer::cancelTask() {
     bool exp = true;
     if (processorTaskRunning.compare_exchange_strong(exp, false)) {
-        ExecutorPool::get()->cancel(processorTaskId);
+        for (auto& task : processorTasks) {
+            ExecutorPool::get()->cancel(task.id);
+        }
     }
 }
 
@@ -291,9 +302,11 @@ ENGINE_ERROR_CODE DcpConsumer::addStream(uint32_t opaque,
      only once when the first stream is added */
     bool exp = false;
     if (processorTaskRunning.compare_exchange_strong(exp, true)) {
-        ExTask task = std::make_shared<DcpConsumerTask>(
-                &engine, shared_from_this(), 1);
-        processorTaskId = ExecutorPool::get()->schedule(task);
+        for (size_t ii = 0; ii < processorTasks.size(); ++ii) {
+            ExTask task = std::make_shared<DcpConsumerTask>(
+                    &engine, shared_from_this(), ii, 1);
+            processorTasks[ii].id = ExecutorPool::get()->schedule(task);
+        }
     }
 
     stream = makePassiveStream(engine_,
@@ -1133,12 +1146,19 @@ void DcpConsumer::addStats(const AddStatFn& add_stat, const void* c) {
     }
 
     addStat("total_backoffs", backoffs, add_stat, c);
-    addStat("processor_task_state", getProcessorTaskStatusStr(), add_stat, c);
+    addStat("processor_task_state", getProcessorTaskStatusStr(0), add_stat, c);
+    for (size_t ii = 1; ii < processorTasks.size(); ++ii) {
+        const auto name = "processor_task_state_" + std::to_string(ii);
+        addStat(name.c_str(),
+                getProcessorTaskStatusStr(ii),
+                add_stat,
+                c);
+    }
     flowControl.addStats(add_stat, c);
 
     vbReady.addStats(getName() + ":dcp_buffered_ready_queue_", add_stat, c);
     addStat("processor_notification",
-            processorNotification.load(),
+            processorTasks[0].notification.load(),
             add_stat,
             c);
 
@@ -1205,14 +1225,20 @@ process_items_error_t DcpConsumer::processBufferedItems() {
     process_items_error_t process_ret = all_processed;
     Vbid vbucket = Vbid(0);
     while (vbReady.popFront(vbucket)) {
+        if (!startProcessingVBucket(vbucket)) {
+            continue;
+        }
+
         auto stream = findStream(vbucket);
 
         if (!stream) {
+            finishProcessingVBucket(vbucket);
             continue;
         }
 
         process_ret = drainStreamsBufferedItems(stream,
                                                 processBufferedMessagesYieldThreshold);
+        finishProcessingVBucket(vbucket);
 
         switch (process_ret) {
         case all_processed:
@@ -1237,23 +1263,73 @@ process_items_error_t DcpConsumer::processBufferedItems() {
 }
 
 void DcpConsumer::notifyVbucketReady(Vbid vbucket) {
-    if (vbReady.pushUnique(vbucket) &&
-        notifiedProcessor(true)) {
-        ExecutorPool::get()->wake(processorTaskId);
+    if (vbReady.pushUnique(vbucket)) {
+        wakeProcessorTasks();
+    }
+}
+
+void DcpConsumer::wakeProcessorTasks() {
+    for (size_t ii = 0; ii < processorTasks.size(); ++ii) {
+        // A task which was already notified re-runs before it snoozes
+        if (notifiedProcessor(ii, true)) {
+            ExecutorPool::get()->wake(processorTasks[ii].id);
+        }
+    }
+}
+
+bool DcpConsumer::startProcessingVBucket(Vbid vbucket) {
+    if (processorTasks.size() == 1) {
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lh(vbsProcessingMutex);
+        auto result = vbsProcessing.emplace(vbucket, false);
+        if (!result.second) {
+            // Being processed by another task; have it re-queue the vBucket.
+            result.first->second = true;
+            return false;
+        }
+    }
+
+    // Have the other tasks pick up any other ready vBuckets meanwhile (they
+    // are only woken when vbReady becomes non-empty).
+    if (vbReady.size() > 0) {
+        wakeProcessorTasks();
     }
+    return true;
 }
 
-bool DcpConsumer::notifiedProcessor(bool to) {
+void DcpConsumer::finishProcessingVBucket(Vbid vbucket) {
+    if (processorTasks.size() == 1) {
+        return;
+    }
+
+    bool requeue;
+    {
+        std::lock_guard<std::mutex> lh(vbsProcessingMutex);
+        auto itr = vbsProcessing.find(vbucket);
+        requeue = itr->second;
+        vbsProcessing.erase(itr);
+    }
+    if (requeue) {
+        notifyVbucketReady(vbucket);
+    }
+}
+
+bool DcpConsumer::notifiedProcessor(size_t task, bool to) {
     bool inverse = !to;
-    return processorNotification.compare_exchange_strong(inverse, to);
+    return processorTasks.at(task).notification.compare_exchange_strong(inverse,
+                                                                        to);
 }
 
-void DcpConsumer::setProcessorTaskState(enum process_items_error_t to) {
-    processorTaskState = to;
+void DcpConsumer::setProcessorTaskState(size_t task,
+                                        enum process_items_error_t to) {
+    processorTasks.at(task).state = to;
 }
 
-std::string DcpConsumer::getProcessorTaskStatusStr() {
-    switch (processorTaskState.load()) {
+std::string DcpConsumer::getProcessorTaskStatusStr(size_t task) {
+    switch (processorTasks.at(task).state.load()) {
         case all_processed:
             return "ALL_PROCESSED";
         case more_to_process:
@@ -1306,18 +1382,22 @@ std::unique_ptr<DcpResponse> DcpConsumer::getNextItem() {
     return nullptr;
 }
 
-void DcpConsumer::notifyStreamReady(Vbid vbucket) {
+void DcpConsumer::notifyStreamReady(Vbid vbucket, bool immediate) {
     {
         std::lock_guard<std::mutex> lh(readyMutex);
         auto iter = std::find(ready.begin(), ready.end(), vbucket);
-        if (iter != ready.end()) {
+        if (iter == ready.end()) {
+            ready.push_back(vbucket);
+        } else if (!immediate) {
             return;
         }
-
-        ready.push_back(vbucket);
     }
 
-    scheduleNotify();
+    if (immediate) {
+        immediatelyNotify();
+    } else {
+        scheduleNotify();
+    }
 }
 
 void DcpConsumer::streamAccepted(uint32_t opaque,
@@ -31,6 +31,8 @@
 
 #include <list>
 #include <map>
+#include <unordered_map>
+#include <vector>
 #include <engines/ep/src/collections/collections_types.h>
 
 class DcpResponse;
@@ -242,7 +244,11 @@ public:
 
     void aggregateQueueStats(ConnCounter& aggregator) override;
 
-    void notifyStreamReady(Vbid vbucket);
+    /**
+     * Add the vBucket to the streams with items ready, and notify the
+     * connection: synchronously if immediate, else via the ConnNotifier.
+     */
+    void notifyStreamReady(Vbid vbucket, bool immediate = false);
 
     void closeAllStreams();
 
@@ -264,11 +270,16 @@ public:
 
     void taskCancelled();
 
-    bool notifiedProcessor(bool to);
+    /**
+     * Set the notification flag of the given Processor task to `to`.
+     *
+     * @return true if the flag changed (i.e. it was !to)
+     */
+    bool notifiedProcessor(size_t task, bool to);
 
-    void setProcessorTaskState(enum process_items_error_t to);
+    void setProcessorTaskState(size_t task, enum process_items_error_t to);
 
-    std::string getProcessorTaskStatusStr();
+    std::string getProcessorTaskStatusStr(size_t task);
 
     /**
      * Check if the enough bytes have been removed from the flow control
@@ -372,6 +383,24 @@ protected:
 
     void notifyVbucketReady(Vbid vbucket);
 
+    /// Notify all of the Processor tasks, waking those not already notified.
+    void wakeProcessorTasks();
+
+    /**
+     * Called by a Processor task before processing the buffered messages of a
+     * vBucket it has taken from vbReady. If there is more than one Processor
+     * task, ensures a vBucket is only processed by one of them at a time (so
+     * its messages are applied in order).
+     *
+     * @return false if another task is already processing the vBucket; it
+     *         will re-queue the vBucket when it has finished.
+     */
+    bool startProcessingVBucket(Vbid vbucket);
+
+    /// Called by a Processor task when it has finished processing a vBucket
+    /// which startProcessingVBucket returned true for.
+    void finishProcessingVBucket(Vbid vbucket);
+
     /**
      * Drain the stream of bufferedItems
      * The function will stop draining
@@ -479,6 +508,7 @@ protected:
             if (bytes == 0) {
                 throw std::invalid_argument("UpdateFlowControl given 0 bytes");
             }
+            consumer.flowControl.incrReceivedBytes(bytes);
         }
 
         ~UpdateFlowControl() {
@@ -504,11 +534,25 @@ protected:
     /* Reference to the ep engine; need to create the 'Processor' task */
     EventuallyPersistentEngine& engine;
     uint64_t opaqueCounter;
-    size_t processorTaskId;
-    std::atomic<enum process_items_error_t> processorTaskState;
+    /// One of the 'Processor' tasks (see
+    /// dcp_consumer_process_buffered_messages_concurrency).
+    struct ProcessorTask {
+        /// The task's id; 0 until scheduled.
+        std::atomic<size_t> id{0};
+        std::atomic<enum process_items_error_t> state{all_processed};
+        /// Set when there is more work for the task; it re-runs rather than
+        /// snoozing if this was set while it was running.
+        std::atomic<bool> notification{false};
+    };
+    std::vector<ProcessorTask> processorTasks;
 
     DcpReadyQueue vbReady;
-    std::atomic<bool> processorNotification;
+
+    /// vBuckets being processed by a Processor task (only tracked if there
+    /// is more than one), mapped to whether the vBucket was taken from
+    /// vbReady again by another task meanwhile (and so must be re-queued).
+    std::mutex vbsProcessingMutex;
+    std::unordered_map<Vbid, bool> vbsProcessing;
 
     std::mutex readyMutex;
     std::list<Vbid> ready;
@@ -157,3 +157,17 @@ enum class MultipleStreamRequests : bool {
 
 /// Does the stream support synchronous replication?
 enum class SyncReplication : bool { Yes, No };
+
+/**
+ * PersistedOnly is used to state whether an active stream sends only
+ * persisted items, read from disk by repeated backfills, instead of
+ * registering a checkpoint cursor for in-memory items.
+ */
+enum class PersistedOnly : bool { Yes, No };
+
+/**
+ * BackfillOrder is used to state the order in which an active stream's disk
+ * backfills may send documents: by seqno, or by key (if the KVStore supports
+ * it), for clients which only need the snapshot contents.
+ */
+enum class BackfillOrder : bool { Seqno, Key };
@@ -22,6 +22,7 @@
 #include "dcp/consumer.h"
 #include "dcp/producer.h"
 #include "ep_engine.h"
+#include "objectregistry.h"
 #include "statwriter.h"
 #include <daemon/tracing.h>
 #include <memcached/server_cookie_iface.h>
@@ -45,6 +46,9 @@ private:
 
 DcpConnMap::DcpConnMap(EventuallyPersistentEngine &e)
     : ConnMap(e),
+      compressionSampler(
+              e.getConfiguration().getCompressionSkipThreshold(),
+              e.getConfiguration().getCompressionSampleInterval()),
       aggrDcpConsumerBufferSize(0) {
     backfills.numActiveSnoozing = 0;
     updateMaxActiveSnoozingBackfills(engine.getEpStats().getMaxDataSize());
@@ -58,6 +62,12 @@ DcpConnMap::DcpConnMap(EventuallyPersistentEngine &e)
     engine.getConfiguration().addValueChangedListener(
             "dcp_consumer_process_buffered_messages_batch_size",
             std::make_unique<DcpConfigChangeListener>(*this));
+    engine.getConfiguration().addValueChangedListener(
+            "compression_skip_threshold",
+            std::make_unique<DcpConfigChangeListener>(*this));
+    engine.getConfiguration().addValueChangedListener(
+            "compression_sample_interval",
+            std::make_unique<DcpConfigChangeListener>(*this));
 }
 
 DcpConnMap::~DcpConnMap() {
@@ -67,6 +77,7 @@ DcpConnMap::~DcpConnMap() {
 DcpConsumer* DcpConnMap::newConsumer(const void* cookie,
                                      const std::string& name,
                                      const std::string& consumerName) {
+    MemoryDomainGuard guard(MemoryDomain::Connections);
     LockHolder lh(connsLock);
 
     std::string conn_name("eq_dcpq:");
@@ -152,6 +163,7 @@ ENGINE_ERROR_CODE DcpConnMap::addPassiveStream(ConnHandler& conn,
 DcpProducer* DcpConnMap::newProducer(const void* cookie,
                                      const std::string& name,
                                      uint32_t flags) {
+    MemoryDomainGuard guard(MemoryDomain::Connections);
     LockHolder lh(connsLock);
 
     std::string conn_name("eq_dcpq:");
@@ -223,22 +235,21 @@ void DcpConnMap::shutdownAllConnections() {
 void DcpConnMap::vbucketStateChanged(Vbid vbucket,
                                      vbucket_state_t state,
                                      bool closeInboundStreams) {
-    LockHolder lh(connsLock);
-    for (const auto& cookieToConn : map_) {
-        auto* producer = dynamic_cast<DcpProducer*>(cookieToConn.second.get());
+    // Only the connections with a stream for the vBucket need to be visited
+    for (const auto& conn : getVBConnections(vbucket)) {
+        auto* producer = dynamic_cast<DcpProducer*>(conn.get());
         if (producer) {
             producer->closeStreamDueToVbStateChange(vbucket, state);
         } else if (closeInboundStreams) {
-            static_cast<DcpConsumer*>(cookieToConn.second.get())
+            static_cast<DcpConsumer*>(conn.get())
                     ->closeStreamDueToVbStateChange(vbucket, state);
         }
     }
 }
 
 void DcpConnMap::closeStreamsDueToRollback(Vbid vbucket) {
-    LockHolder lh(connsLock);
-    for (const auto& cookieToConn : map_) {
-        auto* producer = dynamic_cast<DcpProducer*>(cookieToConn.second.get());
+    for (const auto& conn : getVBConnections(vbucket)) {
+        auto* producer = dynamic_cast<DcpProducer*>(conn.get());
         if (producer) {
             producer->closeStreamDueToRollback(vbucket);
         }
@@ -246,10 +257,10 @@ void DcpConnMap::closeStreamsDueToRollback(Vbid vbucket) {
 }
 
 bool DcpConnMap::handleSlowStream(Vbid vbid, const CheckpointCursor* cursor) {
-    size_t lock_num = vbid.get() % vbConnLockNum;
-    std::lock_guard<std::mutex> lh(vbConnLocks[lock_num]);
+    auto& vb_conns = *vbConns[vbid.get()];
+    std::lock_guard<std::mutex> lh(vb_conns.mutex);
 
-    for (const auto& weakPtr : vbConns[vbid.get()]) {
+    for (const auto& weakPtr : vb_conns.conns) {
         auto connection = weakPtr.lock();
         if (!connection) {
             continue;
@@ -295,6 +306,7 @@ void DcpConnMap::cancelTasks(CookieToConnectionMap& map) {
 }
 
 void DcpConnMap::disconnect(const void *cookie) {
+    MemoryDomainGuard guard(MemoryDomain::Connections);
     // Move the connection matching this cookie from the map_
     // data structure (under connsLock).
     std::shared_ptr<ConnHandler> conn;
@@ -345,6 +357,7 @@ void DcpConnMap::disconnect(const void *cookie) {
 }
 
 void DcpConnMap::manageConnections() {
+    MemoryDomainGuard guard(MemoryDomain::Connections);
     std::list<std::shared_ptr<ConnHandler>> release;
     std::list<std::shared_ptr<ConnHandler>> toNotify;
     {
@@ -395,9 +408,8 @@ void DcpConnMap::manageConnections() {
 
 void DcpConnMap::removeVBConnections(DcpProducer& prod) {
     for (const auto vbid : prod.getVBVector()) {
-        size_t lock_num = vbid.get() % vbConnLockNum;
-        std::lock_guard<std::mutex> lh(vbConnLocks[lock_num]);
-        auto& vb_conns = vbConns[vbid.get()];
+        std::lock_guard<std::mutex> lh(vbConns[vbid.get()]->mutex);
+        auto& vb_conns = vbConns[vbid.get()]->conns;
         for (auto itr = vb_conns.begin(); itr != vb_conns.end(); ++itr) {
             auto connection = (*itr).lock();
             // Erase if we cannot lock, or if the cookie matches
@@ -411,10 +423,10 @@ void DcpConnMap::removeVBConnections(DcpProducer& prod) {
 }
 
 void DcpConnMap::notifyVBConnections(Vbid vbid, uint64_t bySeqno) {
-    size_t lock_num = vbid.get() % vbConnLockNum;
-    std::lock_guard<std::mutex> lh(vbConnLocks[lock_num]);
+    auto& vb_conns = *vbConns[vbid.get()];
+    std::lock_guard<std::mutex> lh(vb_conns.mutex);
 
-    for (auto& weakPtr : vbConns[vbid.get()]) {
+    for (auto& weakPtr : vb_conns.conns) {
         auto connection = weakPtr.lock();
         if (!connection) {
             continue;
@@ -426,29 +438,44 @@ void DcpConnMap::notifyVBConnections(Vbid vbid, uint64_t bySeqno) {
     }
 }
 
-void DcpConnMap::seqnoAckVBPassiveStream(Vbid vbid, int64_t seqno) {
-    size_t index = vbid.get() % vbConnLockNum;
-    std::lock_guard<std::mutex> lg(vbConnLocks[index]);
+void DcpConnMap::notifyVBConnectionsPersisted(Vbid vbid, uint64_t seqno) {
+    auto& vb_conns = *vbConns[vbid.get()];
+    std::lock_guard<std::mutex> lh(vb_conns.mutex);
 
-    // Note: logically we can have only one Consumer per VBucket, but I keep
-    // using the existing vbConns mapping for now (originally added for tracking
-    // only Producers).
-    // @todo-durability: not clear yet if for Consumers we can simplify by
-    //     keeping a 1-to-1 VB-to-Consumer mapping
-    for (auto& weakPtr : vbConns[vbid.get()]) {
+    for (auto& weakPtr : vb_conns.conns) {
         auto connection = weakPtr.lock();
         if (!connection) {
             continue;
         }
-        auto* consumer = dynamic_cast<DcpConsumer*>(connection.get());
-        if (consumer) {
-            // Note: Sync Repl enabled at Consumer only if Producer supports it.
-            //     This is to prevent that 6.5 Consumers send DCP_SEQNO_ACK to
-            //     pre-6.5 Producers (e.g., topology change in a 6.5 cluster
-            //     where a new pre-6.5 Active is elected).
-            if (consumer->isSyncReplicationEnabled()) {
-                consumer->seqnoAckStream(vbid, seqno);
-            }
+        auto* producer = dynamic_cast<DcpProducer*>(connection.get());
+        if (producer) {
+            producer->notifySeqnoPersisted(vbid, seqno);
+        }
+    }
+}
+
+void DcpConnMap::seqnoAckVBPassiveStream(Vbid vbid, int64_t seqno) {
+    // The ack is sent with an immediate notification of the connection,
+    // which acquires releaseLock: collect the Consumers under the vBucket's
+    // mutex but ack outside of it, as manageConnections() acquires them in
+    // the opposite order.
+    //
+    // Note: logically we can have only one Consumer per VBucket, but I
+    // keep using the existing vbConns mapping for now (originally added
+    // for tracking only Producers).
+    // @todo-durability: not clear yet if for Consumers we can simplify by
+    //     keeping a 1-to-1 VB-to-Consumer mapping
+    for (const auto& conn : getVBConnections(vbid)) {
+        auto consumer = std::dynamic_pointer_cast<DcpConsumer>(conn);
+        if (!consumer) {
+            continue;
+        }
+        // Note: Sync Repl enabled at Consumer only if Producer supports it.
+        //     This is to prevent that 6.5 Consumers send DCP_SEQNO_ACK to
+        //     pre-6.5 Producers (e.g., topology change in a 6.5 cluster
+        //     where a new pre-6.5 Active is elected).
+        if (consumer->isSyncReplicationEnabled()) {
+            consumer->seqnoAckStream(vbid, seqno);
         }
     }
 }
@@ -526,6 +553,10 @@ void DcpConnMap::DcpConfigChangeListener::sizeValueChanged(const std::string &ke
         myConnMap.consumerYieldConfigChanged(value);
     } else if (key == "dcp_consumer_process_buffered_messages_batch_size") {
         myConnMap.consumerBatchSizeConfigChanged(value);
+    } else if (key == "compression_skip_threshold") {
+        myConnMap.compressionSampler.setSkipThreshold(value);
+    } else if (key == "compression_sample_interval") {
+        myConnMap.compressionSampler.setSampleInterval(value);
     }
 }
 
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include "compression_sampler.h"
 #include "connmap.h"
 
 #include <memcached/engine.h>
@@ -65,6 +66,12 @@ public:
 
     void notifyVBConnections(Vbid vbid, uint64_t bySeqno);
 
+    /**
+     * Notify the producers of the given VBucket that it has persisted up to
+     * the given seqno, for their persisted-only streams.
+     */
+    void notifyVBConnectionsPersisted(Vbid vbid, uint64_t seqno);
+
     /**
      * Send a SeqnoAck message over the PassiveStream for the given VBucket.
      *
@@ -147,6 +154,14 @@ public:
 
     float getMinCompressionRatio();
 
+    /**
+     * @return the tracker of which collections hold incompressible values,
+     *         which producers use to skip force compressing their values.
+     */
+    CompressionSampler& getCompressionSampler() {
+        return compressionSampler;
+    }
+
     std::shared_ptr<ConnHandler> findByName(const std::string& name);
 
     bool isConnections() {
@@ -224,6 +239,8 @@ protected:
 
     std::atomic<float> minCompressionRatioForProducer;
 
+    CompressionSampler compressionSampler;
+
     /* Total memory used by all DCP consumer buffers */
     std::atomic<size_t> aggrDcpConsumerBufferSize;
 
@@ -21,6 +21,8 @@
 #include "dcp/consumer.h"
 #include "ep_engine.h"
 
+#include <algorithm>
+
 DcpFlowControlManager::DcpFlowControlManager(EventuallyPersistentEngine &engine)
     : engine_(engine)
 {
@@ -39,6 +41,16 @@ bool DcpFlowControlManager::isEnabled() const
     return false;
 }
 
+bool DcpFlowControlManager::isAdaptive() const {
+    return false;
+}
+
+size_t DcpFlowControlManager::resizeConsumerConn(DcpConsumer*,
+                                                 size_t bufSize,
+                                                 size_t) {
+    return bufSize;
+}
+
 void DcpFlowControlManager::setBufSizeWithinBounds(DcpConsumer *consumerConn,
                                                    size_t &bufSize)
 {
@@ -223,3 +235,70 @@ void DcpFlowControlManagerAggressive::resizeBuffers_UNLOCKED(size_t bufferSize)
         iter.second->setFlowControlBufSize(bufferSize);
     }
 }
+
+DcpFlowControlManagerBdp::DcpFlowControlManagerBdp(
+        EventuallyPersistentEngine& engine)
+    : DcpFlowControlManager(engine), aggrDcpConsumerBufferSize(0) {
+}
+
+size_t DcpFlowControlManagerBdp::newConsumerConn(DcpConsumer* consumerConn) {
+    if (consumerConn == nullptr) {
+        throw std::invalid_argument(
+                "DcpFlowControlManagerBdp::newConsumerConn: resp is NULL");
+    }
+    /* Start at the min size; the buffer grows once the connection has
+       measured its round trip time */
+    const size_t bufferSize = engine_.getConfiguration().getDcpConnBufferSize();
+    std::lock_guard<std::mutex> lh(aggrMutex);
+    aggrDcpConsumerBufferSize += bufferSize;
+    return bufferSize;
+}
+
+void DcpFlowControlManagerBdp::handleDisconnect(DcpConsumer* consumerConn) {
+    std::lock_guard<std::mutex> lh(aggrMutex);
+    aggrDcpConsumerBufferSize -= consumerConn->getFlowControlBufSize();
+}
+
+bool DcpFlowControlManagerBdp::isEnabled() const {
+    return true;
+}
+
+bool DcpFlowControlManagerBdp::isAdaptive() const {
+    return true;
+}
+
+size_t DcpFlowControlManagerBdp::resizeConsumerConn(DcpConsumer* consumerConn,
+                                                    size_t bufSize,
+                                                    size_t wantedBufSize) {
+    setBufSizeWithinBounds(consumerConn, wantedBufSize);
+
+    const auto diff = (wantedBufSize > bufSize) ? wantedBufSize - bufSize
+                                                : bufSize - wantedBufSize;
+    if (diff < bufSize / 4) {
+        return bufSize;
+    }
+
+    std::lock_guard<std::mutex> lh(aggrMutex);
+    if (wantedBufSize > bufSize) {
+        /* Only grow while the aggr memory used for flow control buffers
+           across all consumers stays within the threshold */
+        Configuration& config = engine_.getConfiguration();
+        const double dcpConnBufferSizeThreshold =
+                static_cast<double>(
+                        config.getDcpConnBufferSizeAggrMemThreshold()) /
+                100;
+        const size_t limit = dcpConnBufferSizeThreshold *
+                             engine_.getEpStats().getMaxDataSize();
+        const size_t available = (aggrDcpConsumerBufferSize < limit)
+                                         ? limit - aggrDcpConsumerBufferSize
+                                         : 0;
+        wantedBufSize = std::min(wantedBufSize, bufSize + available);
+    }
+    aggrDcpConsumerBufferSize += wantedBufSize;
+    aggrDcpConsumerBufferSize -= bufSize;
+    EP_LOG_DEBUG("{} Conn flow control buffer resized from {} to {}",
+                 consumerConn->logHeader(),
+                 bufSize,
+                 wantedBufSize);
+    return wantedBufSize;
+}
@@ -48,6 +48,17 @@ public:
     /* Will indicate if flow control is enabled */
     virtual bool isEnabled(void) const;
 
+    /* Will indicate if the policy resizes buffers based on the measured
+       buffer ack round trip time (see resizeConsumerConn) */
+    virtual bool isAdaptive() const;
+
+    /* To be called periodically by an adaptive consumer connection with its
+       current flow control buffer size and the size it would like.
+       Returns the size the buffer should now be */
+    virtual size_t resizeConsumerConn(DcpConsumer* consumerConn,
+                                      size_t bufSize,
+                                      size_t wantedBufSize);
+
 protected:
     void setBufSizeWithinBounds(DcpConsumer *consumerConn, size_t &bufSize);
 
@@ -127,3 +138,36 @@ private:
     /* Fraction of memQuota for all dcp consumer connection buffers */
     std::atomic<double> dcpConnBufferSizeAggrFrac;
 };
+
+/**
+ * In this policy each flow control buffer is sized to the bandwidth-delay
+ * product of its connection. Connections start with the min size (10 MB); each
+ * consumer measures the round trip time of its buffer acks and the rate it is
+ * consuming at, and periodically asks for a buffer of twice their product.
+ * Buffers are kept within the max (50MB) and min values, and grow only while
+ * the aggr flow control buffer memory stays below the threshold (10% of bucket
+ * memory). Small changes (less than a quarter of the buffer) are ignored to
+ * avoid repeatedly resizing.
+ */
+class DcpFlowControlManagerBdp : public DcpFlowControlManager {
+public:
+    DcpFlowControlManagerBdp(EventuallyPersistentEngine& engine);
+
+    size_t newConsumerConn(DcpConsumer* consumerConn) override;
+
+    void handleDisconnect(DcpConsumer* consumerConn) override;
+
+    bool isEnabled() const override;
+
+    bool isAdaptive() const override;
+
+    size_t resizeConsumerConn(DcpConsumer* consumerConn,
+                              size_t bufSize,
+                              size_t wantedBufSize) override;
+
+private:
+    /* Mutex to serialise changes to aggrDcpConsumerBufferSize */
+    std::mutex aggrMutex;
+    /* Total memory used by all DCP consumer buffers */
+    size_t aggrDcpConsumerBufferSize;
+};
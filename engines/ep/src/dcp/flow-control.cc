@@ -21,6 +21,7 @@
 #include "ep_engine.h"
 #include "ep_time.h"
 #include "objectregistry.h"
+#include "replicationthrottle.h"
 
 FlowControl::FlowControl(EventuallyPersistentEngine &engine,
                          DcpConsumer* consumer) :
@@ -29,9 +30,15 @@ FlowControl::FlowControl(EventuallyPersistentEngine &engine,
     pendingControl(true),
     lastBufferAck(ep_current_time()),
     ackedBytes(0),
-    freedBytes(0)
+    freedBytes(0),
+    receivedBytes(0),
+    rttProbeStart(0),
+    smoothedRtt(0),
+    lastResize(std::chrono::steady_clock::now()),
+    ackedBytesAtLastResize(0)
 {
     enabled = engine.getDcpFlowControlManager().isEnabled();
+    adaptive = enabled && engine.getDcpFlowControlManager().isAdaptive();
     if (enabled) {
         bufferSize =
                     engine.getDcpFlowControlManager().newConsumerConn(consumer);
@@ -59,23 +66,22 @@ ENGINE_ERROR_CODE FlowControl::handleFlowCtl(
             NonBucketAllocationGuard guard;
             ret = producers->control(opaque, controlMsgKey, buf_size);
             return ret;
-        } else if (isBufferSufficientlyDrained_UNLOCKED(ackable_bytes)) {
+        } else if (isBufferSufficientlyDrained_UNLOCKED(ackable_bytes) ||
+                   (ackable_bytes > 0 &&
+                    (ep_current_time() - lastBufferAck) > 5)) {
             lh.unlock();
-            /* Send a buffer ack when at least 20% of the buffer is drained */
-            uint64_t opaque = consumerConn->incrOpaqueCounter();
-            ret = producers->buffer_acknowledgement(
-                    opaque, Vbid(0), ackable_bytes);
-            lastBufferAck = ep_current_time();
-            ackedBytes.fetch_add(ackable_bytes);
-            freedBytes.fetch_sub(ackable_bytes);
-            return ret;
-        } else if (ackable_bytes > 0 &&
-                   (ep_current_time() - lastBufferAck) > 5) {
-            lh.unlock();
-            /* Ack at least every 5 seconds */
+            /* Send a buffer ack when at least 20% of the buffer is drained,
+               and at least every 5 seconds - of as many of the bytes as the
+               replication throttle allows, if it's pacing acks */
+            ackable_bytes = engine_.getReplicationThrottle().getAckableBytes(
+                    ackable_bytes);
+            if (ackable_bytes == 0) {
+                return ENGINE_FAILED;
+            }
             uint64_t opaque = consumerConn->incrOpaqueCounter();
             ret = producers->buffer_acknowledgement(
                     opaque, Vbid(0), ackable_bytes);
+            onBufferAck(ackable_bytes);
             lastBufferAck = ep_current_time();
             ackedBytes.fetch_add(ackable_bytes);
             freedBytes.fetch_sub(ackable_bytes);
@@ -92,6 +98,60 @@ void FlowControl::incrFreedBytes(uint32_t bytes)
     freedBytes.fetch_add(bytes);
 }
 
+void FlowControl::incrReceivedBytes(uint32_t bytes) {
+    if (!adaptive) {
+        return;
+    }
+    receivedBytes.fetch_add(bytes);
+
+    const auto start = rttProbeStart.exchange(0);
+    if (start != 0) {
+        const auto now = std::chrono::steady_clock::now().time_since_epoch();
+        const auto sample = now.count() - start;
+        /* Exponentially weighted moving average, as used by TCP (RFC 6298) */
+        const auto prev = smoothedRtt.load();
+        smoothedRtt = (prev == 0) ? sample : (prev * 7 + sample) / 8;
+    }
+}
+
+void FlowControl::onBufferAck(uint32_t ackable_bytes) {
+    if (!adaptive) {
+        return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+
+    /* If the producer had (close to) a full window of bytes unacked it will
+       be waiting for this ack, so the time until the next message arrives is
+       the round trip time */
+    const int64_t unacked = receivedBytes.load() - ackedBytes.load();
+    if (unacked >= int64_t(bufferSize * .9)) {
+        rttProbeStart = now.time_since_epoch().count();
+    }
+
+    /* Re-evaluate the buffer size at most once a second. The window needed
+       to keep the connection busy is the bandwidth-delay product: the rate we
+       are consuming at times the round trip time. While the window is the
+       bottleneck the consumed rate is bufferSize / RTT, so asking for twice
+       the product grows the window until it no longer limits throughput */
+    const auto elapsed = now - lastResize;
+    const auto rtt = std::chrono::steady_clock::duration(smoothedRtt.load());
+    if (elapsed < std::chrono::seconds(1) || rtt.count() == 0) {
+        return;
+    }
+    const uint64_t acked = ackedBytes.load() + ackable_bytes;
+    const double rate = double(acked - ackedBytesAtLastResize) /
+                        std::chrono::duration<double>(elapsed).count();
+    lastResize = now;
+    ackedBytesAtLastResize = acked;
+
+    const size_t wanted =
+            2 * rate * std::chrono::duration<double>(rtt).count();
+    const auto newSize =
+            engine_.getDcpFlowControlManager().resizeConsumerConn(
+                    consumerConn, bufferSize, wanted);
+    setFlowControlBufSize(newSize);
+}
+
 uint32_t FlowControl::getFlowControlBufSize(void)
 {
     return bufferSize;
@@ -119,4 +179,14 @@ void FlowControl::addStats(const AddStatFn& add_stat, const void* c) {
     consumerConn->addStat("total_acked_bytes", ackedBytes, add_stat, c);
     consumerConn->addStat("max_buffer_bytes", bufferSize, add_stat, c);
     consumerConn->addStat("unacked_bytes", freedBytes, add_stat, c);
+    if (adaptive) {
+        consumerConn->addStat(
+                "buffer_ack_rtt_us",
+                uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                                 std::chrono::steady_clock::duration(
+                                         smoothedRtt.load()))
+                                 .count()),
+                add_stat,
+                c);
+    }
 }
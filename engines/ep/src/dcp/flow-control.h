@@ -21,6 +21,8 @@
 
 #include <relaxed_atomic.h>
 
+#include <chrono>
+
 class DcpConsumer;
 class EventuallyPersistentEngine;
 
@@ -41,6 +43,13 @@ public:
 
     void incrFreedBytes(uint32_t bytes);
 
+    /**
+     * Record that a message of the given size has been received from the
+     * producer. Used by adaptive flow control policies to measure the
+     * buffer ack round trip time.
+     */
+    void incrReceivedBytes(uint32_t bytes);
+
     uint32_t getFlowControlBufSize(void);
 
     void setFlowControlBufSize(uint32_t newSize);
@@ -58,6 +67,13 @@ private:
 
     bool isBufferSufficientlyDrained_UNLOCKED(uint32_t ackable_bytes);
 
+    /**
+     * Bookkeeping for adaptive policies when a buffer ack of ackable_bytes
+     * is sent: start an RTT measurement if the producer's window was full,
+     * and periodically ask the flow control manager to resize the buffer.
+     */
+    void onBufferAck(uint32_t ackable_bytes);
+
     /* Associated consumer connection handler */
     DcpConsumer* consumerConn;
 
@@ -85,4 +101,23 @@ private:
 
     /* Bytes processed from the flow control buffer */
     std::atomic<uint64_t> freedBytes;
+
+    /* Indicates if the flow control policy resizes the buffer based on the
+       measured round trip time */
+    bool adaptive;
+
+    /* Total bytes received by this connection (adaptive policies only) */
+    std::atomic<uint64_t> receivedBytes;
+
+    /* Time (steady_clock ticks) a buffer ack was sent while the producer's
+       window was full; zero if no RTT measurement is in progress. The first
+       message received after it completes the measurement */
+    std::atomic<std::chrono::steady_clock::rep> rttProbeStart;
+
+    /* Smoothed buffer ack round trip time */
+    std::atomic<std::chrono::steady_clock::rep> smoothedRtt;
+
+    /* Time of, and total bytes acked at, the last buffer resize check */
+    std::chrono::steady_clock::time_point lastResize;
+    uint64_t ackedBytesAtLastResize;
 };
@@ -654,7 +654,9 @@ void PassiveStream::seqnoAck(int64_t seqno) {
         pushToReadyQ(
                 std::make_unique<SeqnoAcknowledgement>(opaque_, vb_, seqno));
     }
-    notifyStreamReady();
+    // The Active is waiting on this ack to complete SyncWrites: wake the
+    // connection now rather than via the ConnNotifier task.
+    notifyStreamReady(true /*immediate*/);
 }
 
 ENGINE_ERROR_CODE PassiveStream::processCommit(const CommitSyncWrite& commit) {
@@ -1049,7 +1051,7 @@ std::string PassiveStream::getEndStreamStatusStr(end_stream_status_t status) {
                        "; this should not have happened!"};
 }
 
-void PassiveStream::notifyStreamReady() {
+void PassiveStream::notifyStreamReady(bool immediate) {
     auto consumer = consumerPtr.lock();
     if (!consumer) {
         return;
@@ -1057,7 +1059,11 @@ void PassiveStream::notifyStreamReady() {
 
     bool inverse = false;
     if (itemsReady.compare_exchange_strong(inverse, true)) {
-        consumer->notifyStreamReady(vb_);
+        consumer->notifyStreamReady(vb_, immediate);
+    } else if (immediate) {
+        // The connection already knows about the stream, but may still be
+        // waiting for its (scheduled) notification.
+        consumer->immediatelyNotify();
     }
 }
 
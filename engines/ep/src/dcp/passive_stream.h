@@ -212,8 +212,12 @@ protected:
     /**
      * Notifies the consumer connection that the stream has items ready to be
      * pick up.
+     *
+     * @param immediate Notify the connection synchronously on this thread
+     *     (see DcpConsumer::immediatelyNotify) rather than scheduling the
+     *     notification. Default is 'false'
      */
-    void notifyStreamReady();
+    void notifyStreamReady(bool immediate = false);
 
     const std::string createStreamReqValue() const;
 
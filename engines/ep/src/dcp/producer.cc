@@ -166,9 +166,12 @@ DcpProducer::DcpProducer(EventuallyPersistentEngine& e,
       notifyOnly((flags & cb::mcbp::request::DcpOpenPayload::Notifier) != 0),
       sendStreamEndOnClientStreamClose(false),
       consumerSupportsHifiMfu(false),
+      persistedOnly(false),
+      keyOrderBackfill(false),
       lastSendTime(ep_current_time()),
       log(*this),
       backfillMgr(std::make_shared<BackfillManager>(engine_)),
+      ready(e.getConfiguration().getMaxVbuckets()),
       streams(streamsMapSize),
       itemsSent(0),
       totalBytesSent(0),
@@ -306,6 +309,14 @@ ENGINE_ERROR_CODE DcpProducer::streamRequest(
         }
     }
 
+    if ((flags & DCP_ADD_STREAM_FLAG_TAKEOVER) && persistedOnly) {
+        logger->warn(
+                "({}) Stream request failed because takeover streams "
+                "are not supported when persisted_only is enabled",
+                vbucket);
+        return ENGINE_ENOTSUP;
+    }
+
     if ((flags & DCP_ADD_STREAM_ACTIVE_VB_ONLY) &&
         (vb->getState() != vbucket_state_active)) {
         logger->info(
@@ -495,7 +506,8 @@ ENGINE_ERROR_CODE DcpProducer::streamRequest(
 
     bool add_vb_conn_map = true;
     {
-        folly::SharedMutex::ReadHolder rlh(vb->getStateLock());
+        ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+                LockSite::VBucketState, vb->getStateLock());
         if (vb->getState() == vbucket_state_dead) {
             logger->warn(
                     "({}) Stream request failed because "
@@ -989,6 +1001,25 @@ ENGINE_ERROR_CODE DcpProducer::control(uint32_t opaque,
     } else if (key == "consumer_name") {
         consumerName = valueStr;
         return ENGINE_SUCCESS;
+    } else if (key == "persisted_only") {
+        // Streams only read persisted items from disk, so this needs a
+        // persistent bucket.
+        if (engine_.getConfiguration().getBucketType() != "persistent") {
+            engine_.setErrorContext(getCookie(),
+                                    "The ctrl parameter persisted_only is "
+                                    "only supported by persistent buckets");
+            return ENGINE_ENOTSUP;
+        }
+        persistedOnly = (valueStr == "true");
+        return ENGINE_SUCCESS;
+    } else if (key == "backfill_order") {
+        if (valueStr == "key") {
+            keyOrderBackfill = true;
+            return ENGINE_SUCCESS;
+        } else if (valueStr == "seqno") {
+            keyOrderBackfill = false;
+            return ENGINE_SUCCESS;
+        }
     }
 
     logger->warn("Invalid ctrl parameter '{}' for {}", valueStr, keyStr);
@@ -1209,6 +1240,8 @@ void DcpProducer::addStats(const AddStatFn& add_stat, const void* c) {
             add_stat,
             c);
     addStat("synchronous_replication", isSyncReplicationEnabled(), add_stat, c);
+    addStat("persisted_only", persistedOnly, add_stat, c);
+    addStat("backfill_order", keyOrderBackfill ? "key" : "seqno", add_stat, c);
 
     // Possible that the producer has had its streams closed and hence doesn't
     // have a backfill manager anymore.
@@ -1317,6 +1350,23 @@ void DcpProducer::notifySeqnoAvailable(Vbid vbucket, uint64_t seqno) {
     }
 }
 
+void DcpProducer::notifySeqnoPersisted(Vbid vbucket, uint64_t seqno) {
+    if (!persistedOnly) {
+        return;
+    }
+
+    auto rv = streams.find(vbucket.get());
+
+    if (rv != streams.end()) {
+        auto handle = rv->second->rlock();
+        for (; !handle.end(); handle.next()) {
+            if (handle.get()->isActive()) {
+                handle.get()->notifySeqnoPersisted(seqno);
+            }
+        }
+    }
+}
+
 void DcpProducer::closeStreamDueToVbStateChange(Vbid vbucket,
                                                 vbucket_state_t state) {
     if (setStreamDeadStatus(vbucket, {}, END_STREAM_STATE)) {
@@ -113,6 +113,12 @@ public:
 
     void notifySeqnoAvailable(Vbid vbucket, uint64_t seqno);
 
+    /**
+     * Notifies the persisted-only streams of the vbucket that it has
+     * persisted up to seqno. Does nothing unless persisted_only is enabled.
+     */
+    void notifySeqnoPersisted(Vbid vbucket, uint64_t seqno);
+
     void closeStreamDueToVbStateChange(Vbid vbucket, vbucket_state_t state);
 
     void closeStreamDueToRollback(Vbid vbucket);
@@ -192,6 +198,14 @@ public:
         return supportsCursorDropping.load();
     }
 
+    bool isPersistedOnlyEnabled() const {
+        return persistedOnly.load();
+    }
+
+    bool isKeyOrderBackfillEnabled() const {
+        return keyOrderBackfill.load();
+    }
+
     /**
      * Notifies the front-end synchronously on this thread that this paused
      * connection should be re-considered for work.
@@ -516,6 +530,13 @@ protected:
     cb::RelaxedAtomic<bool> consumerSupportsHifiMfu;
     cb::RelaxedAtomic<bool> enableExpiryOpcode;
 
+    // Do streams send only persisted items, read from disk, and never
+    // register a checkpoint cursor?
+    cb::RelaxedAtomic<bool> persistedOnly;
+
+    // May disk backfills send documents in key order (backfill_order=key)?
+    cb::RelaxedAtomic<bool> keyOrderBackfill;
+
     // SyncReplication: Producer needs to know the Consumer name to identify
     // the source of received SeqnoAck messages.
     std::string consumerName;
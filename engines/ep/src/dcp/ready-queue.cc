@@ -20,9 +20,16 @@
 #include "locks.h"
 #include "statwriter.h"
 
+#include <gsl/gsl>
+
+DcpReadyQueue::DcpReadyQueue(size_t maxVBuckets) : queued(maxVBuckets) {
+    for (auto& flag : queued) {
+        flag.store(false);
+    }
+}
+
 bool DcpReadyQueue::exists(Vbid vbucket) {
-    LockHolder lh(lock);
-    return (queuedValues.count(vbucket) != 0);
+    return queuedFlag(vbucket).load();
 }
 
 bool DcpReadyQueue::popFront(Vbid& frontValue) {
@@ -30,7 +37,7 @@ bool DcpReadyQueue::popFront(Vbid& frontValue) {
     if (!readyQueue.empty()) {
         frontValue = readyQueue.front();
         readyQueue.pop();
-        queuedValues.erase(frontValue);
+        queuedFlag(frontValue).store(false);
         return true;
     }
     return false;
@@ -39,21 +46,23 @@ bool DcpReadyQueue::popFront(Vbid& frontValue) {
 void DcpReadyQueue::pop() {
     LockHolder lh(lock);
     if (!readyQueue.empty()) {
-        queuedValues.erase(readyQueue.front());
+        queuedFlag(readyQueue.front()).store(false);
         readyQueue.pop();
     }
 }
 
 bool DcpReadyQueue::pushUnique(Vbid vbucket) {
-    bool wasEmpty;
-    {
-        LockHolder lh(lock);
-        wasEmpty = queuedValues.empty();
-        const bool inserted = queuedValues.emplace(vbucket).second;
-        if (inserted) {
-            readyQueue.push(vbucket);
-        }
+    auto& flag = queuedFlag(vbucket);
+    // Fast path - already queued, hence the queue is not empty. A pop of
+    // this vbucket racing with us is fine; the popper has yet to service it
+    // so will observe whatever made us push it.
+    if (flag.load() || flag.exchange(true)) {
+        return false;
     }
+
+    LockHolder lh(lock);
+    const bool wasEmpty = readyQueue.empty();
+    readyQueue.push(vbucket);
     return wasEmpty;
 }
 
@@ -72,11 +81,15 @@ void DcpReadyQueue::addStats(const std::string& prefix,
                              const void* c) {
     // Take a copy of the queue data under lock; then format it to stats.
     std::queue<Vbid> qCopy;
-    std::unordered_set<Vbid> qMapCopy;
+    std::vector<Vbid> qMapCopy;
     {
         LockHolder lh(lock);
         qCopy = readyQueue;
-        qMapCopy = queuedValues;
+        for (size_t vbid = 0; vbid < queued.size(); ++vbid) {
+            if (queued[vbid].load()) {
+                qMapCopy.emplace_back(gsl::narrow_cast<uint16_t>(vbid));
+            }
+        }
     }
 
     add_casted_stat((prefix + "size").c_str(), qCopy.size(), add_stat, c);
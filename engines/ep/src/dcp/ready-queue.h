@@ -20,9 +20,10 @@
 #include <memcached/engine_common.h>
 #include <memcached/vbucket.h>
 
+#include <atomic>
 #include <mutex>
 #include <queue>
-#include <unordered_set>
+#include <vector>
 
 /**
  * DcpReadyQueue is a std::queue wrapper for managing a
@@ -33,11 +34,20 @@
  *   DCPProducer threads are accessing this data.
  * - processBufferedItems by the processer task of the consumer
  *
- * Internally a std::queue and std::set track the contents and the std::set
- * enables a fast exists method which is used by front-end threads.
+ * Internally a std::queue tracks the order of the contents, and a per-vbucket
+ * atomic flag records which vbuckets are queued. The flag enables a lock-free
+ * exists method, and lets pushUnique return without taking the lock when the
+ * vbucket is already queued - the common case when many front-end threads
+ * notify the same (already ready) streams.
  */
 class DcpReadyQueue {
 public:
+    /**
+     * @param maxVBuckets upper bound (exclusive) of the vbucket ids which may
+     *        be pushed.
+     */
+    explicit DcpReadyQueue(size_t maxVBuckets);
+
     bool exists(Vbid vbucket);
 
     /**
@@ -71,15 +81,21 @@ public:
                   const void* c);
 
 private:
+    std::atomic<bool>& queuedFlag(Vbid vbucket) {
+        return queued.at(vbucket.get());
+    }
+
+    /**
+     * Guards readyQueue. A vbucket's flag in 'queued' is set before it is
+     * pushed (so at most one thread pushes it) and is only cleared under the
+     * lock by the thread which popped it.
+     */
     std::mutex lock;
 
     /* a queue of vbuckets that are ready for producing */
     std::queue<Vbid> readyQueue;
 
-    /**
-     * maintain a std::unordered_set of values that are in the readyQueue.
-     * find() is performed by front-end threads so we want it to be
-     * efficient so just a set lookup is required.
-     */
-    std::unordered_set<Vbid> queuedValues;
+    /* Indexed by vbucket id; true if that vbucket is in (or being pushed
+     * onto) the readyQueue. */
+    std::vector<std::atomic<bool>> queued;
 };
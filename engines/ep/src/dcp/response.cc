@@ -102,7 +102,7 @@ uint32_t MutationResponse::getMessageSize() const {
     } else {
         keySize = item_->getKey().makeDocKeyWithoutCollectionID().size();
     }
-    uint32_t body = keySize + item_->getNBytes();
+    uint32_t body = keySize + item_->getVisibleValue().size();
 
     return header + body;
 }
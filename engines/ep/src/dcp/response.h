@@ -21,13 +21,14 @@
 #include "ep_types.h"
 #include "ext_meta_parser.h"
 #include "item.h"
+#include "objectregistry.h"
 #include "systemevent.h"
 
 #include <memcached/dcp_stream_id.h>
 #include <memcached/protocol_binary.h>
 #include <memory>
 
-class DcpResponse {
+class DcpResponse : public MemoryDomainAllocated<MemoryDomain::Dcp> {
 public:
     enum class Event : uint8_t {
         Mutation,
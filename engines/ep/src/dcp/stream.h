@@ -87,6 +87,9 @@ public:
 
     virtual void notifySeqnoAvailable(uint64_t seqno) {}
 
+    /// Notifies the stream that the vbucket has persisted up to seqno.
+    virtual void notifySeqnoPersisted(uint64_t seqno) {}
+
     const std::string& getName() {
         return name_;
     }
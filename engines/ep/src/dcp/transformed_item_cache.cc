@@ -0,0 +1,77 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "dcp/transformed_item_cache.h"
+
+#include "stats.h"
+
+#include <stdexcept>
+
+TransformedItemCache::TransformedItemCache(size_t slots, EPStats& stats)
+    : stats(stats), entries(slots) {
+    if (slots == 0) {
+        throw std::invalid_argument(
+                "TransformedItemCache: slots must be non-zero");
+    }
+}
+
+queued_item TransformedItemCache::find(const Item& original,
+                                       const Features& features) {
+    const auto slot = slotFor(original, features);
+    {
+        std::lock_guard<std::mutex> lh(mutex);
+        const auto& entry = entries[slot];
+        if (entry.item && entry.bySeqno == original.getBySeqno() &&
+            entry.cas == original.getCas() && entry.features == features) {
+            ++stats.dcpTransformedItemCacheHits;
+            return entry.item;
+        }
+    }
+    ++stats.dcpTransformedItemCacheMisses;
+    return {};
+}
+
+void TransformedItemCache::insert(const Item& original,
+                                  const Features& features,
+                                  queued_item transformed) {
+    const auto slot = slotFor(original, features);
+    queued_item evicted;
+    {
+        std::lock_guard<std::mutex> lh(mutex);
+        auto& entry = entries[slot];
+        entry.bySeqno = original.getBySeqno();
+        entry.cas = original.getCas();
+        entry.features = features;
+        evicted = std::move(entry.item);
+        entry.item = std::move(transformed);
+    }
+    // evicted (if last reference) is freed here, outside the lock.
+}
+
+size_t TransformedItemCache::slotFor(const Item& original,
+                                     const Features& features) const {
+    // Consecutive seqnos map to consecutive slots; streams with different
+    // features are offset from each other so they don't evict each other's
+    // entries for the same seqno.
+    const auto featureBits =
+            (size_t(features.includeValue) << 3) |
+            (size_t(features.includeXattrs == IncludeXattrs::Yes) << 2) |
+            (size_t(features.snappyEnabled == SnappyEnabled::Yes) << 1) |
+            size_t(features.forceValueCompression == ForceValueCompression::Yes);
+    return (size_t(original.getBySeqno()) + featureBits * 0x9e3779b9) %
+           entries.size();
+}
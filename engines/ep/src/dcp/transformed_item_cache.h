@@ -0,0 +1,108 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include "dcp/dcp-types.h"
+#include "ep_types.h"
+#include "item.h"
+
+#include <mutex>
+#include <vector>
+
+class EPStats;
+
+/**
+ * Cache of the Items which ActiveStreams of one vBucket send in place of a
+ * checkpoint (or backfill) item when the stream's negotiated features
+ * require the value to be modified - xattrs or value pruned, value
+ * compressed or decompressed.
+ *
+ * Without this cache every stream performs that transformation itself, so a
+ * mutation streamed by several producers with the same feature set (e.g.
+ * multiple replicas with forced value compression) gets compressed once per
+ * stream. With it, the first stream stores the transformed Item and the
+ * others share it (Items are immutable once handed to a MutationResponse).
+ *
+ * Entries are identified by the original item's seqno and CAS (which
+ * together identify a revision of a document in a vBucket) plus the
+ * features the transformation depends on. The cache is direct-mapped with a
+ * fixed number of slots; streams of a vBucket generally process the same
+ * recent items close together in time, so a small cache is sufficient and
+ * bounds the memory used by cached items.
+ *
+ * Thread-safe.
+ */
+class TransformedItemCache {
+public:
+    /**
+     * Features of a stream which affect how an item is transformed.
+     */
+    struct Features {
+        IncludeValue includeValue;
+        IncludeXattrs includeXattrs;
+        SnappyEnabled snappyEnabled;
+        ForceValueCompression forceValueCompression;
+
+        bool operator==(const Features& other) const {
+            return includeValue == other.includeValue &&
+                   includeXattrs == other.includeXattrs &&
+                   snappyEnabled == other.snappyEnabled &&
+                   forceValueCompression == other.forceValueCompression;
+        }
+    };
+
+    /**
+     * @param slots number of items the cache can hold; must be non-zero.
+     * @param stats stats to record hits / misses into.
+     */
+    TransformedItemCache(size_t slots, EPStats& stats);
+
+    /**
+     * Look up the transformed version of the given item.
+     *
+     * @return the cached item, or a null queued_item if not present.
+     */
+    queued_item find(const Item& original, const Features& features);
+
+    /**
+     * Add the transformed version of the given item, replacing whatever
+     * occupied the slot.
+     */
+    void insert(const Item& original,
+                const Features& features,
+                queued_item transformed);
+
+    size_t getNumSlots() const {
+        return entries.size();
+    }
+
+private:
+    struct Entry {
+        int64_t bySeqno = 0;
+        uint64_t cas = 0;
+        Features features{};
+        queued_item item;
+    };
+
+    size_t slotFor(const Item& original, const Features& features) const;
+
+    EPStats& stats;
+
+    std::mutex mutex;
+    std::vector<Entry> entries;
+};
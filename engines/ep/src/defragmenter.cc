@@ -25,18 +25,24 @@
 #include "stored-value.h"
 #include <memcached/server_allocator_iface.h>
 #include <phosphor/phosphor.h>
+#include <algorithm>
 #include <cinttypes>
 
 DefragmenterTask::DefragmenterTask(EventuallyPersistentEngine* e,
                                    EPStats& stats_)
     : GlobalTask(e, TaskId::DefragmenterTask, 0, false),
       stats(stats_),
-      epstore_position(engine->getKVBucket()->startPosition()) {
+      epstore_position(engine->getKVBucket()->startPosition()),
+      pid(engine->getConfiguration().getDefragmenterAutoTargetFragmentation(),
+          engine->getConfiguration().getDefragmenterAutoPidP(),
+          engine->getConfiguration().getDefragmenterAutoPidI(),
+          engine->getConfiguration().getDefragmenterAutoPidD()) {
 }
 
 bool DefragmenterTask::run(void) {
     TRACE_EVENT0("ep-engine/task", "DefragmenterTask");
-    if (engine->getConfiguration().isDefragmenterEnabled()) {
+    if (engine->getConfiguration().isDefragmenterEnabled() &&
+        updateIntensity() > 0) {
         ServerAllocatorIface* alloc_hooks = engine->getServerApi()->alloc_hooks;
         // Get our pause/resume visitor. If we didn't finish the previous pass,
         // then resume from where we last were, otherwise create a new visitor
@@ -63,6 +69,7 @@ bool DefragmenterTask::run(void) {
            << " mem_used=" << stats.getEstimatedTotalMemoryUsed()
            << ", mapped_bytes=" << getMappedBytes();
         EP_LOG_DEBUG("{}", ss.str());
+        const size_t mappedBefore = getMappedBytes();
 
         // Disable thread-caching (as we are about to defragment, and hence don't
         // want any of the new Blobs in tcache).
@@ -74,6 +81,10 @@ bool DefragmenterTask::run(void) {
         const auto deadline = start + getChunkDuration();
         visitor.setDeadline(deadline);
         visitor.setBlobAgeThreshold(getAgeThreshold());
+        visitor.setAllocHooks(
+                engine->getConfiguration().isDefragmenterSlabAware()
+                        ? alloc_hooks
+                        : nullptr);
         // Only defragment StoredValues of persistent buckets because the
         // HashTable defrag method doesn't yet know how to maintain the
         // ephemeral seqno linked-list
@@ -97,6 +108,14 @@ bool DefragmenterTask::run(void) {
         // add? How much memory does it return?
         alloc_hooks->release_free_memory();
 
+        // What the moves (and the purge) gave back, to weigh against the
+        // bytes moved. Other threads allocate and free meanwhile, so this is
+        // only an estimate.
+        const size_t mappedAfter = getMappedBytes();
+        if (mappedAfter < mappedBefore) {
+            stats.defragBytesReclaimed.fetch_add(mappedBefore - mappedAfter);
+        }
+
         // Check if the visitor completed a full pass.
         bool completed = (epstore_position ==
                                     engine->getKVBucket()->endPosition());
@@ -114,7 +133,9 @@ bool DefragmenterTask::run(void) {
                                                                       start);
         ss << " Took " << duration.count() << " us."
            << " moved " << visitor.getDefragCount() << "/"
-           << visitor.getVisitedCount() << " visited documents."
+           << visitor.getVisitedCount() << " visited documents ("
+           << visitor.getDefragBytes() << " bytes), skipped "
+           << visitor.getSkippedCount() << " in dense slabs."
            << " mem_used=" << stats.getEstimatedTotalMemoryUsed()
            << ", mapped_bytes=" << getMappedBytes() << ". Sleeping for "
            << getSleepTime() << " seconds.";
@@ -153,7 +174,56 @@ std::chrono::microseconds DefragmenterTask::maxExpectedDuration() {
 }
 
 double DefragmenterTask::getSleepTime() const {
-    return engine->getConfiguration().getDefragmenterInterval();
+    auto& config = engine->getConfiguration();
+    if (!config.isDefragmenterAutoEnabled()) {
+        return config.getDefragmenterInterval();
+    }
+    const double maxSleep = config.getDefragmenterAutoMaxSleep();
+    const double minSleep =
+            std::min(maxSleep, double(config.getDefragmenterAutoMinSleep()));
+    return maxSleep - intensity * (maxSleep - minSleep);
+}
+
+double DefragmenterTask::updateIntensity() {
+    auto& config = engine->getConfiguration();
+    if (!config.isDefragmenterAutoEnabled()) {
+        // Start afresh if auto mode is (re-)enabled
+        pid.reset();
+        intensity = 1.0;
+        return intensity;
+    }
+
+    const double fragmentation = getFragmentation();
+    pid.setSetPoint(config.getDefragmenterAutoTargetFragmentation());
+    pid.setGains(config.getDefragmenterAutoPidP(),
+                 config.getDefragmenterAutoPidI(),
+                 config.getDefragmenterAutoPidD());
+    intensity = pid.step(fragmentation, std::chrono::steady_clock::now());
+
+    stats.defragFragmentation = fragmentation;
+    stats.defragIntensity = intensity;
+    EP_LOG_DEBUG(
+            "{} for bucket '{}': fragmentation={}, target={}, intensity={}",
+            getDescription(),
+            engine->getName(),
+            fragmentation,
+            config.getDefragmenterAutoTargetFragmentation(),
+            intensity);
+    return intensity;
+}
+
+double DefragmenterTask::getFragmentation() {
+    ServerAllocatorIface* alloc_hooks = engine->getServerApi()->alloc_hooks;
+
+    allocator_stats stats = {0};
+    stats.ext_stats.resize(alloc_hooks->get_extra_stats_size());
+    alloc_hooks->get_allocator_stats(&stats);
+
+    if (stats.resident_size == 0 ||
+        stats.allocated_size >= stats.resident_size) {
+        return 0.0;
+    }
+    return 1.0 - double(stats.allocated_size) / double(stats.resident_size);
 }
 
 size_t DefragmenterTask::getAgeThreshold() const {
@@ -169,6 +239,8 @@ void DefragmenterTask::updateStats(DefragmentVisitor& visitor) {
     stats.defragStoredValueNumMoved.fetch_add(
             visitor.getStoredValueDefragCount());
     stats.defragNumVisited.fetch_add(visitor.getVisitedCount());
+    stats.defragBytesMoved.fetch_add(visitor.getDefragBytes());
+    stats.defragNumSkipped.fetch_add(visitor.getSkippedCount());
 }
 
 size_t DefragmenterTask::getMaxValueSize(ServerAllocatorIface* alloc_hooks) {
@@ -188,8 +260,15 @@ size_t DefragmenterTask::getMaxValueSize(ServerAllocatorIface* alloc_hooks) {
 }
 
 std::chrono::milliseconds DefragmenterTask::getChunkDuration() const {
+    auto& config = engine->getConfiguration();
+    const size_t minChunk = config.getDefragmenterChunkDuration();
+    if (!config.isDefragmenterAutoEnabled()) {
+        return std::chrono::milliseconds(minChunk);
+    }
+    const size_t maxChunk =
+            std::max(minChunk, config.getDefragmenterAutoMaxChunkDuration());
     return std::chrono::milliseconds(
-            engine->getConfiguration().getDefragmenterChunkDuration());
+            minChunk + size_t(intensity * (maxChunk - minChunk)));
 }
 
 size_t DefragmenterTask::getMappedBytes() {
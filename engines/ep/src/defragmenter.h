@@ -18,6 +18,7 @@
 
 #include "globaltask.h"
 #include "kv_bucket_iface.h"
+#include "pid_controller.h"
 
 class DefragmentVisitor;
 class EPStats;
@@ -115,6 +116,22 @@ private:
     /// Duration (in seconds) defragmenter should sleep for between iterations.
     double getSleepTime() const;
 
+    /**
+     * In auto mode, measure the fragmentation and step the controller with
+     * it, to pick the effort (the interval and chunk duration) of the next
+     * run.
+     *
+     * @return the effort, from 0 (don't run) to 1 (the min sleep and max
+     *         chunk duration); always 1 outside of auto mode.
+     */
+    double updateIntensity();
+
+    /**
+     * @return the share (0-1) of the allocator's resident memory which
+     *         isn't allocated.
+     */
+    double getFragmentation();
+
     // Minimum age (measured in defragmenter task passes) that a document
     // must be to be considered for defragmentation.
     size_t getAgeThreshold() const;
@@ -148,4 +165,10 @@ private:
      * complete pass.
      */
     std::unique_ptr<PauseResumeVBAdapter> prAdapter;
+
+    /// Drives the effort of each run from the fragmentation, in auto mode
+    PIDController pid;
+
+    /// The effort picked by updateIntensity() for the current run
+    double intensity = 1.0;
 };
@@ -17,6 +17,10 @@
 
 #include "defragmenter_visitor.h"
 
+#include "stored_value_arena.h"
+
+#include <memcached/server_allocator_iface.h>
+
 // DegragmentVisitor implementation ///////////////////////////////////////////
 
 DefragmentVisitor::DefragmentVisitor(size_t max_size_class)
@@ -42,6 +46,10 @@ void DefragmentVisitor::setStoredValueAgeThreshold(uint8_t age) {
     sv_age_threshold = age;
 }
 
+void DefragmentVisitor::setAllocHooks(ServerAllocatorIface* hooks) {
+    alloc_hooks = hooks;
+}
+
 bool DefragmentVisitor::visit(const HashTable::HashBucketLock& lh,
                               StoredValue& v) {
     const size_t value_len = v.valuelen();
@@ -58,8 +66,13 @@ bool DefragmentVisitor::visit(const HashTable::HashBucketLock& lh,
         // should be good enough.
         if (v.getValue()->getAge() >= age_threshold &&
             v.getValue().refCount() < 2) {
-            v.reallocate();
-            defrag_count++;
+            if (isInSparseSlab(v.getValue().get())) {
+                defrag_bytes += v.getValue()->getSize();
+                v.reallocate();
+                defrag_count++;
+            } else {
+                skipped_count++;
+            }
         } else {
             v.getValue()->incrementAge();
         }
@@ -84,6 +97,8 @@ void DefragmentVisitor::clearStats() {
     defrag_count = 0;
     visited_count = 0;
     sv_defrag_count = 0;
+    defrag_bytes = 0;
+    skipped_count = 0;
 }
 
 size_t DefragmentVisitor::getDefragCount() const {
@@ -98,12 +113,47 @@ size_t DefragmentVisitor::getStoredValueDefragCount() const {
     return sv_defrag_count;
 }
 
+size_t DefragmentVisitor::getDefragBytes() const {
+    return defrag_bytes;
+}
+
+size_t DefragmentVisitor::getSkippedCount() const {
+    return skipped_count;
+}
+
 void DefragmentVisitor::setCurrentVBucket(VBucket& vb) {
     currentVb = &vb;
 }
 
 void DefragmentVisitor::defragmentStoredValue(StoredValue& v) const {
+    // Arena-allocated StoredValues only benefit from relocation if they live
+    // in a sparsely used slab; moving them drains that slab so the arena can
+    // release it.
+    if (v.isArenaAllocated() ? !StoredValueArena::isFragmented(&v)
+                             : !isInSparseSlab(&v)) {
+        skipped_count++;
+        return;
+    }
+    const auto size = v.getObjectSize();
     if (currentVb->ht.reallocateStoredValue(std::forward<StoredValue>(v))) {
         sv_defrag_count++;
+        defrag_bytes += size;
+    }
+}
+
+bool DefragmentVisitor::isInSparseSlab(const void* ptr) const {
+    allocator_slab_utilization util;
+    if (!alloc_hooks || !alloc_hooks->get_slab_utilization ||
+        !alloc_hooks->get_slab_utilization(ptr, &util)) {
+        // Without the utilization go by the age alone
+        return true;
+    }
+    // The size class allocates from its current slab first, so moving an
+    // object out of it frees nothing. Otherwise move the object if its slab
+    // has a larger share of free objects than the size class as a whole -
+    // the slabs which are the emptiest are the ones which can be drained.
+    if (util.is_current) {
+        return false;
     }
+    return util.nfree * util.bin_nregs > util.bin_nfree * util.nregs;
 }
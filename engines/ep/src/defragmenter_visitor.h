@@ -22,6 +22,8 @@
 #include "vb_visitors.h"
 #include "vbucket.h"
 
+struct ServerAllocatorIface;
+
 /**
  * Defragmentation visitor - visit all objects in a VBucket, compress the
  * documents and defragment any which have reached the specified age.
@@ -46,6 +48,14 @@ public:
      */
     void setStoredValueAgeThreshold(uint8_t age);
 
+    /**
+     * Only move the objects which live in a sparsely used slab (one no more
+     * used than the average of its size class), as reported by the given
+     * allocator, as moving the others doesn't free any memory. nullptr (the
+     * default) moves every object old enough.
+     */
+    void setAllocHooks(ServerAllocatorIface* hooks);
+
     // Implementation of HashTableVisitor interface:
     virtual bool visit(const HashTable::HashBucketLock& lh,
                        StoredValue& v) override;
@@ -62,12 +72,22 @@ public:
     // Returns the number of StoredValues that have been defragmented.
     size_t getStoredValueDefragCount() const;
 
+    // Returns the bytes of the Blobs and StoredValues moved.
+    size_t getDefragBytes() const;
+
+    // Returns the number of objects old enough to move but left where they
+    // are as their slab is densely used.
+    size_t getSkippedCount() const;
+
     void setCurrentVBucket(VBucket& vb) override;
 
 private:
     /// Request to reallocate the StoredValue
     void defragmentStoredValue(StoredValue& v) const;
 
+    /// @return true if moving the object would help free its slab
+    bool isInSparseSlab(const void* ptr) const;
+
     /* Configuration parameters */
 
     // Size of the largest size class from the allocator.
@@ -88,6 +108,13 @@ private:
     size_t visited_count;
     // How many stored-values have been defrag'd
     mutable size_t sv_defrag_count{0};
+    // How many bytes (of both) have been defrag'd
+    mutable size_t defrag_bytes{0};
+    // How many objects were old enough, but in a dense slab
+    mutable size_t skipped_count{0};
+
+    // If set, the allocator queried for the utilization of the slabs
+    ServerAllocatorIface* alloc_hooks{nullptr};
 
     // The current vbucket that is being processed
     VBucket* currentVb;
@@ -48,6 +48,23 @@ DiskDocKey::DiskDocKey(const Item& item)
 DiskDocKey::DiskDocKey(const char* ptr, size_t len) : keydata(ptr, len) {
 }
 
+std::pair<DiskDocKey, DiskDocKey> DiskDocKey::collectionRange(
+        CollectionID cid, bool prepared) {
+    std::string prefix;
+    if (prepared) {
+        prefix.push_back(CollectionID::DurabilityPrepare);
+    }
+    cb::mcbp::unsigned_leb128<CollectionIDType> leb128(uint32_t(cid));
+    prefix.append(reinterpret_cast<const char*>(leb128.data()),
+                  leb128.size());
+    DiskDocKey start(prefix.data(), prefix.size());
+
+    // The last byte of a leb128 encoding never has its top bit set, so
+    // incrementing it can't carry.
+    prefix.back()++;
+    return {std::move(start), DiskDocKey(prefix.data(), prefix.size())};
+}
+
 std::size_t DiskDocKey::hash() const {
     return std::hash<std::string>()(keydata);
 }
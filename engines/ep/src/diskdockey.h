@@ -18,6 +18,7 @@
 
 #include <memcached/dockey.h>
 #include <string>
+#include <utility>
 
 struct DocKey;
 class Item;
@@ -60,6 +61,15 @@ public:
      */
     explicit DiskDocKey(const char* ptr, size_t len);
 
+    /**
+     * @return the half-open range [first, second) holding every key of the
+     *         given collection - its committed keys, or those in the
+     *         DurabilityPrepare namespace if prepared - as they all start
+     *         with the same prefix.
+     */
+    static std::pair<DiskDocKey, DiskDocKey> collectionRange(
+            CollectionID cid, bool prepared = false);
+
     bool operator==(const DiskDocKey& rhs) const {
         return keydata == rhs.keydata;
     }
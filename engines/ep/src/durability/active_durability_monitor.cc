@@ -31,10 +31,17 @@ ActiveDurabilityMonitor::ActiveDurabilityMonitor(VBucket& vb)
 
 ActiveDurabilityMonitor::ActiveDurabilityMonitor(PassiveDurabilityMonitor&& pdm)
     : ActiveDurabilityMonitor(pdm.vb) {
-    auto s = state.wlock();
-    s->trackedWrites.swap(pdm.state.wlock()->trackedWrites);
-    if (!s->trackedWrites.empty()) {
-        s->lastTrackedSeqno = s->trackedWrites.back().getBySeqno();
+    boost::optional<std::chrono::steady_clock::time_point> expiry;
+    {
+        auto s = state.wlock();
+        s->trackedWrites.swap(pdm.state.wlock()->trackedWrites);
+        if (!s->trackedWrites.empty()) {
+            s->lastTrackedSeqno = s->trackedWrites.back().getBySeqno();
+        }
+        expiry = s->getEarliestExpiryTime();
+    }
+    if (expiry) {
+        vb.scheduleSyncWriteTimeout(*expiry);
     }
 }
 
@@ -76,9 +83,7 @@ void ActiveDurabilityMonitor::setReplicationTopology(
         toCommit = s->updateHighPreparedSeqno();
     }
 
-    for (const auto& sw : toCommit) {
-        commit(sw);
-    }
+    commit(toCommit);
 }
 
 int64_t ActiveDurabilityMonitor::getHighPreparedSeqno() const {
@@ -117,18 +122,22 @@ void ActiveDurabilityMonitor::addSyncWrite(const void* cookie,
     }
 
     Container toCommit;
+    boost::optional<std::chrono::steady_clock::time_point> expiry;
     {
         auto s = state.wlock();
         s->addSyncWrite(cookie, std::move(item));
+        expiry = s->trackedWrites.back().getExpiryTime();
         toCommit = s->updateHighPreparedSeqno();
     }
 
+    if (expiry) {
+        vb.scheduleSyncWriteTimeout(*expiry);
+    }
+
     // @todo: Consider to commit in a dedicated function for minimizing
     //     contention on front-end threads, as this function is supposed to
     //     execute under VBucket-level lock.
-    for (const auto& sw : toCommit) {
-        commit(sw);
-    }
+    commit(toCommit);
 }
 
 ENGINE_ERROR_CODE ActiveDurabilityMonitor::seqnoAckReceived(
@@ -164,9 +173,7 @@ ENGINE_ERROR_CODE ActiveDurabilityMonitor::seqnoAckReceived(
     state.wlock()->processSeqnoAck(replica, preparedSeqno, toCommit);
 
     // Commit the verified SyncWrites
-    for (const auto& sw : toCommit) {
-        commit(sw);
-    }
+    commit(toCommit);
 
     return ENGINE_SUCCESS;
 }
@@ -181,7 +188,18 @@ void ActiveDurabilityMonitor::processTimeout(
     }
 
     Container toAbort;
-    state.wlock()->removeExpired(asOf, toAbort);
+    boost::optional<std::chrono::steady_clock::time_point> expiry;
+    {
+        auto s = state.wlock();
+        s->removeExpired(asOf, toAbort);
+        expiry = s->getEarliestExpiryTime();
+    }
+
+    // The SyncWrites still tracked are due a timeout check at the earliest
+    // of their expiry-times.
+    if (expiry) {
+        vb.scheduleSyncWriteTimeout(*expiry);
+    }
 
     for (const auto& entry : toAbort) {
         abort(entry);
@@ -194,9 +212,7 @@ void ActiveDurabilityMonitor::notifyLocalPersistence() {
     // at seqnoAckReceived(), details in there).
     Container toCommit = state.wlock()->updateHighPreparedSeqno();
 
-    for (const auto& sw : toCommit) {
-        commit(sw);
-    }
+    commit(toCommit);
 }
 
 void ActiveDurabilityMonitor::addStats(const AddStatFn& addStat,
@@ -523,17 +539,22 @@ ActiveDurabilityMonitor::State::removeSyncWrite(Container::iterator it) {
     return removed;
 }
 
-void ActiveDurabilityMonitor::commit(const SyncWrite& sw) {
-    const auto& key = sw.getKey();
-    auto result = vb.commit(key,
-                            sw.getBySeqno() /*prepareSeqno*/,
-                            {} /*commitSeqno*/,
-                            vb.lockCollections(key),
-                            sw.getCookie());
+void ActiveDurabilityMonitor::commit(const Container& toCommit) {
+    if (toCommit.empty()) {
+        return;
+    }
+
+    std::vector<PendingCommit> commits;
+    commits.reserve(toCommit.size());
+    for (const auto& sw : toCommit) {
+        commits.push_back({sw.getKey(), sw.getCookie()});
+    }
+
+    auto result = vb.commitBatch(commits);
     if (result != ENGINE_SUCCESS) {
         throw std::logic_error(
-                "ActiveDurabilityMonitor::commit: VBucket::commit failed with "
-                "status:" +
+                "ActiveDurabilityMonitor::commit: VBucket::commitBatch failed "
+                "with status:" +
                 std::to_string(result));
     }
 }
@@ -704,6 +725,18 @@ void ActiveDurabilityMonitor::State::addSyncWrite(const void* cookie,
     lastTrackedSeqno = seqno;
 }
 
+boost::optional<std::chrono::steady_clock::time_point>
+ActiveDurabilityMonitor::State::getEarliestExpiryTime() const {
+    boost::optional<std::chrono::steady_clock::time_point> earliest;
+    for (const auto& sw : trackedWrites) {
+        const auto expiry = sw.getExpiryTime();
+        if (expiry && (!earliest || *expiry < *earliest)) {
+            earliest = expiry;
+        }
+    }
+    return earliest;
+}
+
 void ActiveDurabilityMonitor::State::removeExpired(
         std::chrono::steady_clock::time_point asOf, Container& expired) {
     Container::iterator it = trackedWrites.begin();
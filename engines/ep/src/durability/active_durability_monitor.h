@@ -171,11 +171,12 @@ protected:
     void toOStream(std::ostream& os) const override;
 
     /**
-     * Commit the given SyncWrite.
+     * Commit the given SyncWrites, in order, as a single batch (see
+     * VBucket::commitBatch).
      *
-     * @param sw The SyncWrite to commit
+     * @param toCommit The SyncWrites to commit
      */
-    void commit(const SyncWrite& sw);
+    void commit(const Container& toCommit);
 
     /**
      * Abort the given SyncWrite.
@@ -249,6 +250,13 @@ protected:
 
         void addSyncWrite(const void* cookie, queued_item item);
 
+        /**
+         * @return the earliest expiry-time of the tracked SyncWrites, none
+         *     if none of them can time out
+         */
+        boost::optional<std::chrono::steady_clock::time_point>
+        getEarliestExpiryTime() const;
+
         /**
          * Returns the next position for a node iterator.
          *
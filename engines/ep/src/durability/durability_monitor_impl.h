@@ -86,6 +86,12 @@ public:
      */
     bool isExpired(std::chrono::steady_clock::time_point asOf) const;
 
+    /// @return this SW's expiry-time, none if it never times out
+    boost::optional<std::chrono::steady_clock::time_point> getExpiryTime()
+            const {
+        return expiryTime;
+    }
+
     /**
      * Reset the ack-state for this SyncWrite and set it up for the new
      * given topology.
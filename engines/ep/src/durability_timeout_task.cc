@@ -17,10 +17,21 @@
 
 #include "durability_timeout_task.h"
 #include "ep_engine.h"
+#include "executorpool.h"
 #include "kv_bucket.h"
+#include "vbucket.h"
 
 #include <phosphor/phosphor.h>
 
+/// @return the time from now until tp, in seconds (0 if tp has passed)
+static double secondsUntil(std::chrono::steady_clock::time_point tp) {
+    const auto now = std::chrono::steady_clock::now();
+    if (tp <= now) {
+        return 0;
+    }
+    return std::chrono::duration<double>(tp - now).count();
+}
+
 DurabilityTimeoutTask::DurabilityTimeoutTask(EventuallyPersistentEngine& engine,
                                              std::chrono::milliseconds interval)
     : GlobalTask(&engine,
@@ -33,24 +44,77 @@ DurabilityTimeoutTask::DurabilityTimeoutTask(EventuallyPersistentEngine& engine,
 bool DurabilityTimeoutTask::run() {
     TRACE_EVENT0("ep-engine/task", "DurabilityTimeoutTask");
 
-    // @todo: A meaningful value will be the P99.99
-    const auto maxExpectedDurationForVisitorTask =
-            std::chrono::milliseconds(100);
-
+    const auto now = std::chrono::steady_clock::now();
     auto& kvBucket = *engine->getKVBucket();
-    kvBucket.visitAsync(std::make_unique<DurabilityTimeoutVisitor>(),
-                        "DurabilityTimeoutVisitor",
-                        TaskId::DurabilityTimeoutVisitor,
-                        maxExpectedDurationForVisitorTask);
+    for (const auto vbid : takeDue(now)) {
+        auto vb = kvBucket.getVBucket(vbid);
+        if (vb) {
+            // Re-registers the deadline of the SyncWrites still tracked.
+            vb->processDurabilityTimeout(now);
+        }
+    }
 
-    // Note: Default unit for std::duration is seconds, so the following gives
-    // the seconds-representation (as double) of the given millis (sleepTime)
-    snooze(std::chrono::duration<double>(sleepTime).count());
+    // Sleep until the next deadline. Snooze under the mutex, so that a
+    // concurrent addDeadline() either is seen here or wakes us after this.
+    std::lock_guard<std::mutex> lh(mutex);
+    auto wakeTime = std::chrono::steady_clock::now() + sleepTime;
+    popStaleDeadlines();
+    if (!deadlines.empty() && deadlines.top().first < wakeTime) {
+        wakeTime = deadlines.top().first;
+    }
+    snooze(secondsUntil(wakeTime));
 
     // Schedule again
     return true;
 }
 
-void DurabilityTimeoutVisitor::visitBucket(const VBucketPtr& vb) {
-    vb->processDurabilityTimeout(startTime);
+void DurabilityTimeoutTask::addDeadline(
+        Vbid vbid, std::chrono::steady_clock::time_point expiry) {
+    std::lock_guard<std::mutex> lh(mutex);
+    auto registered = vbDeadlines.find(vbid);
+    if (registered != vbDeadlines.end()) {
+        if (registered->second <= expiry) {
+            return;
+        }
+        // Supersedes the registered deadline, which becomes stale.
+        registered->second = expiry;
+    } else {
+        vbDeadlines.emplace(vbid, expiry);
+    }
+    deadlines.emplace(expiry, vbid);
+
+    // Note: the top may be a stale (earlier) deadline, in which case the
+    // task is already due to run before expiry.
+    if (!(deadlines.top().first < expiry)) {
+        ExecutorPool::get()->snooze(getId(), secondsUntil(expiry));
+    }
+}
+
+std::vector<Vbid> DurabilityTimeoutTask::takeDue(
+        std::chrono::steady_clock::time_point asOf) {
+    std::vector<Vbid> due;
+    std::lock_guard<std::mutex> lh(mutex);
+    while (!deadlines.empty() && deadlines.top().first <= asOf) {
+        const auto deadline = deadlines.top();
+        deadlines.pop();
+        auto registered = vbDeadlines.find(deadline.second);
+        if (registered != vbDeadlines.end() &&
+            registered->second == deadline.first) {
+            vbDeadlines.erase(registered);
+            due.push_back(deadline.second);
+        }
+    }
+    return due;
+}
+
+void DurabilityTimeoutTask::popStaleDeadlines() {
+    while (!deadlines.empty()) {
+        const auto& top = deadlines.top();
+        auto registered = vbDeadlines.find(top.second);
+        if (registered != vbDeadlines.end() &&
+            registered->second == top.first) {
+            return;
+        }
+        deadlines.pop();
+    }
 }
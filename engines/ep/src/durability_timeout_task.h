@@ -17,15 +17,30 @@
 #pragma once
 
 #include "globaltask.h"
-#include "vb_visitors.h"
+
+#include <memcached/vbucket.h>
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+#include <vector>
 
 /*
  * Enforces the Durability Timeout for the SyncWrites tracked in this KVBucket.
+ *
+ * Rather than visiting every vBucket periodically, the task keeps a min-heap
+ * of the earliest SyncWrite expiry-time of each vBucket which has SyncWrites
+ * that can time out (registered via addDeadline(), see
+ * VBucket::scheduleSyncWriteTimeout), visits only the vBuckets which are due
+ * and sleeps until the next deadline.
  */
 class DurabilityTimeoutTask : public GlobalTask {
 public:
     /**
      * @param engine The engine that will be visited
+     * @param interval The maximum time between runs
      */
     DurabilityTimeoutTask(EventuallyPersistentEngine& engine,
                           std::chrono::milliseconds interval);
@@ -37,31 +52,38 @@ public:
     }
 
     std::chrono::microseconds maxExpectedDuration() override {
-        // This tasks just spawns a new VBCBAdaptor, which is the actual tasks
-        // that executes the DurabilityTimeoutVisitor. So, keeping the value
-        // relatively high as there is no too much value in logging this timing.
-        return std::chrono::seconds(1);
+        // Only the vBuckets with expired SyncWrites are visited, but timing
+        // out a SyncWrite involves queueing the abort and notifying the
+        // client, so allow some time for a burst of them.
+        return std::chrono::milliseconds(100);
     }
 
+    /**
+     * Record that vbid has a SyncWrite which times out at expiry: vbid will
+     * be visited then (or earlier, if it is already due an earlier visit),
+     * and the task woken up for it if that is its new earliest deadline.
+     */
+    void addDeadline(Vbid vbid, std::chrono::steady_clock::time_point expiry);
+
 private:
-    // Note: this is the actual minimum interval between subsequent runs.
-    // The VBCBAdaptor (which is the actual task that executes this Visitor)
-    // has its internal sleep-time which is used for a different purpose,
-    // details in VBCBAdaptor.
-    std::chrono::milliseconds sleepTime;
-};
+    using Deadline = std::pair<std::chrono::steady_clock::time_point, Vbid>;
 
-/**
- * DurabilityTimeoutVisitor visits a VBucket for enforcing the Durability
- * Timeout for the SyncWrites tracked by VBucket.
- */
-class DurabilityTimeoutVisitor : public CappedDurationVBucketVisitor {
-public:
-    DurabilityTimeoutVisitor() : startTime(std::chrono::steady_clock::now()) {
-    }
+    /// Remove and return the vBuckets due a visit as of asOf.
+    std::vector<Vbid> takeDue(std::chrono::steady_clock::time_point asOf);
 
-    void visitBucket(const VBucketPtr& vb) override;
+    /// Pop the deadlines superseded by an earlier one for the same vBucket
+    /// off the top of the heap (mutex must be held).
+    void popStaleDeadlines();
 
-private:
-    const std::chrono::steady_clock::time_point startTime;
+    // Note: this is the maximum interval between subsequent runs, the task
+    // runs earlier if a deadline is due.
+    const std::chrono::milliseconds sleepTime;
+
+    std::mutex mutex;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>>
+            deadlines;
+    /// The (single, earliest) deadline in the heap which is valid for each
+    /// vBucket; other entries for it in the heap are stale.
+    std::unordered_map<Vbid, std::chrono::steady_clock::time_point>
+            vbDeadlines;
 };
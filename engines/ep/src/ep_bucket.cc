@@ -23,99 +23,79 @@
 #include "bucket_logger.h"
 #include "checkpoint_manager.h"
 #include "collections/manager.h"
+#include "compaction_throttle.h"
 #include "ep_engine.h"
 #include "ep_time.h"
 #include "ep_vb.h"
+#include "eviction_ghost_list.h"
 #include "failover-table.h"
 #include "flusher.h"
+#include "hash_table_snapshot.h"
 #include "item.h"
+#include "kvshard.h"
+#include "numa_topology.h"
 #include "persistence_callback.h"
 #include "replicationthrottle.h"
 #include "statwriter.h"
 #include "tasks.h"
+#include "value_spill_cache.h"
 #include "vb_visitors.h"
 #include "vbucket_state.h"
 #include "warmup.h"
 
 #include "dcp/dcpconnmap.h"
 
+#include <phosphor/phosphor.h>
+
 /**
- * Callback class used by EpStore, for adding relevant keys
- * to bloomfilter during compaction.
+ * @return true if the given on-disk key of vb should be added to a bloom
+ *         filter being built for it (by compaction, or by a rebuild).
  */
-class BloomFilterCallback : public Callback<Vbid&, const DocKey&, bool&> {
-public:
-    BloomFilterCallback(KVBucket& eps) : store(eps) {
+static bool isBloomFilterKey(KVBucket& store,
+                             VBucketPtr& vb,
+                             const DocKey& key,
+                             bool isDeleted) {
+    if (store.getItemEvictionPolicy() == EvictionPolicy::Value) {
+        /**
+         * VALUE-ONLY EVICTION POLICY
+         * Consider deleted items only.
+         */
+        return isDeleted;
     }
 
-    void callback(Vbid& vbucketId, const DocKey& key, bool& isDeleted) {
-        VBucketPtr vb = store.getVBucket(vbucketId);
-        if (vb) {
-            /* Check if a temporary filter has been initialized. If not,
-             * initialize it. If initialization fails, throw an exception
-             * to the caller and let the caller deal with it.
-             */
-            bool tempFilterInitialized = vb->isTempFilterAvailable();
-            if (!tempFilterInitialized) {
-                tempFilterInitialized = initTempFilter(vbucketId);
-            }
-
-            if (!tempFilterInitialized) {
-                throw std::runtime_error(
-                        "BloomFilterCallback::callback: Failed "
-                        "to initialize temporary filter for " +
-                        vbucketId.to_string());
-            }
-
-            if (store.getItemEvictionPolicy() == EvictionPolicy::Value) {
-                /**
-                 * VALUE-ONLY EVICTION POLICY
-                 * Consider deleted items only.
-                 */
-                if (isDeleted) {
-                    vb->addToTempFilter(key);
-                }
-            } else {
-                /**
-                 * FULL EVICTION POLICY
-                 * If vbucket's resident ratio is found to be less than
-                 * the residency threshold, consider all items, otherwise
-                 * consider deleted and non-resident items only.
-                 */
-                bool residentRatioLessThanThreshold =
-                        vb->isResidentRatioUnderThreshold(
-                                store.getBfiltersResidencyThreshold());
-                if (residentRatioLessThanThreshold) {
-                    vb->addToTempFilter(key);
-                } else {
-                    if (isDeleted || !store.isMetaDataResident(vb, key)) {
-                        vb->addToTempFilter(key);
-                    }
-                }
-            }
-        }
+    /**
+     * FULL EVICTION POLICY
+     * If vbucket's resident ratio is found to be less than
+     * the residency threshold, consider all items, otherwise
+     * consider deleted and non-resident items only.
+     */
+    bool residentRatioLessThanThreshold = vb->isResidentRatioUnderThreshold(
+            store.getBfiltersResidencyThreshold());
+    if (residentRatioLessThanThreshold) {
+        return true;
     }
+    return isDeleted || !store.isMetaDataResident(vb, key);
+}
 
-private:
-    bool initTempFilter(Vbid vbucketId);
-    KVBucket& store;
-};
-
-bool BloomFilterCallback::initTempFilter(Vbid vbucketId) {
+/**
+ * Estimate how many keys a new bloom filter for vb needs to be sized for.
+ *
+ * @return false if the estimate couldn't be made.
+ */
+static bool estimateBloomFilterKeyCount(KVBucket& store,
+                                        VBucket& vb,
+                                        size_t& estimated_count) {
     Configuration& config = store.getEPEngine().getConfiguration();
-    VBucketPtr vb = store.getVBucket(vbucketId);
-    if (!vb) {
-        return false;
-    }
+    const Vbid vbucketId = vb.getId();
 
     size_t initial_estimation = config.getBfilterKeyCount();
-    size_t estimated_count;
     size_t num_deletes = 0;
     try {
-        num_deletes = store.getROUnderlying(vbucketId)->getNumPersistedDeletes(vbucketId);
+        num_deletes = store.getROUnderlying(vbucketId)->getNumPersistedDeletes(
+                vbucketId);
     } catch (std::runtime_error& re) {
         EP_LOG_WARN(
-                "BloomFilterCallback::initTempFilter: runtime error while "
+                "estimateBloomFilterKeyCount: runtime error while "
                 "getting "
                 "number of persisted deletes for {} Details: {}",
                 vbucketId,
@@ -137,7 +117,7 @@ bool BloomFilterCallback::initTempFilter(Vbid vbucketId) {
          * First determine if the resident ratio of vbucket is less than
          * the threshold from configuration.
          */
-        bool residentRatioAlert = vb->isResidentRatioUnderThreshold(
+        bool residentRatioAlert = vb.isResidentRatioUnderThreshold(
                 store.getBfiltersResidencyThreshold());
 
         /**
@@ -156,22 +136,105 @@ bool BloomFilterCallback::initTempFilter(Vbid vbucketId) {
          */
 
         if (residentRatioAlert) {
-            estimated_count = round(1.25 * vb->getNumItems());
+            estimated_count = round(1.25 * vb.getNumItems());
         } else {
             estimated_count =
-                    round(1.25 * (num_deletes + vb->getNumNonResidentItems()));
+                    round(1.25 * (num_deletes + vb.getNumNonResidentItems()));
         }
     }
 
     if (estimated_count < initial_estimation) {
         estimated_count = initial_estimation;
     }
+    return true;
+}
+
+/**
+ * Callback class used by EpStore, for adding relevant keys
+ * to bloomfilter during compaction.
+ */
+class BloomFilterCallback : public Callback<Vbid&, const DocKey&, bool&> {
+public:
+    BloomFilterCallback(KVBucket& eps) : store(eps) {
+    }
 
-    vb->initTempFilter(estimated_count, config.getBfilterFpProb());
+    void callback(Vbid& vbucketId, const DocKey& key, bool& isDeleted) {
+        VBucketPtr vb = store.getVBucket(vbucketId);
+        if (vb) {
+            /* Check if a temporary filter has been initialized. If not,
+             * initialize it. If initialization fails, throw an exception
+             * to the caller and let the caller deal with it.
+             */
+            bool tempFilterInitialized = vb->isTempFilterAvailable();
+            if (!tempFilterInitialized) {
+                tempFilterInitialized = initTempFilter(vbucketId);
+            }
+
+            if (!tempFilterInitialized) {
+                throw std::runtime_error(
+                        "BloomFilterCallback::callback: Failed "
+                        "to initialize temporary filter for " +
+                        vbucketId.to_string());
+            }
+
+            if (isBloomFilterKey(store, vb, key, isDeleted)) {
+                vb->addToTempFilter(key);
+            }
+        }
+    }
+
+private:
+    bool initTempFilter(Vbid vbucketId);
+    KVBucket& store;
+};
+
+bool BloomFilterCallback::initTempFilter(Vbid vbucketId) {
+    Configuration& config = store.getEPEngine().getConfiguration();
+    VBucketPtr vb = store.getVBucket(vbucketId);
+    if (!vb) {
+        return false;
+    }
+
+    size_t estimated_count;
+    if (!estimateBloomFilterKeyCount(store, *vb, estimated_count)) {
+        return false;
+    }
+
+    vb->initTempFilter(estimated_count,
+                       config.getBfilterFpProb(),
+                       BloomFilter::typeFromString(config.getBfilterType()));
 
     return true;
 }
 
+/**
+ * Callback for the key-only disk scan made by EPBucket::rebuildBloomFilter,
+ * adding the relevant keys to the vBucket's filter being rebuilt.
+ */
+class BloomFilterRebuildCallback : public StatusCallback<GetValue> {
+public:
+    BloomFilterRebuildCallback(KVBucket& store, VBucketPtr vb)
+        : store(store), vb(std::move(vb)) {
+    }
+
+    void callback(GetValue& val) override {
+        const auto& item = *val.item;
+        if (isBloomFilterKey(store, vb, item.getKey(), item.isDeleted())) {
+            vb->addToRebuildFilter(item.getKey());
+        }
+    }
+
+private:
+    KVBucket& store;
+    VBucketPtr vb;
+};
+
+/**
+ * Collects the items compaction finds expired, and expires them in batches
+ * (see KVBucket::deleteExpiredItems) rather than one at a time as they are
+ * found. flush() must be called once compaction is done, to expire the last
+ * batch.
+ */
 class ExpiredItemsCallback : public Callback<Item&, time_t&> {
 public:
     ExpiredItemsCallback(KVBucket& store) : epstore(store) {
@@ -179,12 +242,42 @@ public:
 
     void callback(Item& it, time_t& startTime) {
         if (epstore.compactionCanExpireItems()) {
-            epstore.deleteExpiredItem(it, startTime, ExpireBy::Compactor);
+            expired.push_back(it);
+            batchStartTime = startTime;
+            if (expired.size() >= batchSize) {
+                flush();
+            }
+        }
+    }
+
+    void flush() {
+        if (expired.empty()) {
+            return;
         }
+        const auto start = std::chrono::steady_clock::now();
+        epstore.deleteExpiredItems(
+                expired, batchStartTime, ExpireBy::Compactor);
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        epstore.getEPEngine().getEpStats().compactionExpiryTime.fetch_add(
+                std::chrono::duration_cast<std::chrono::microseconds>(elapsed)
+                        .count());
+        numExpired += expired.size();
+        expiryTime += elapsed;
+        expired.clear();
     }
 
+    /// Number of items expired (by flush()) so far
+    size_t numExpired = 0;
+    /// Time spent expiring them
+    std::chrono::steady_clock::duration expiryTime{};
+
 private:
+    /// Number of expired items collected before they are expired
+    static const size_t batchSize = 1000;
+
     KVBucket& epstore;
+    std::list<Item> expired;
+    time_t batchStartTime = 0;
 };
 
 class EPBucket::ValueChangedListener : public ::ValueChangedListener {
@@ -196,10 +289,27 @@ public:
                                   size_t value) override {
         if (key == "flusher_batch_split_trigger") {
             bucket.setFlusherBatchSplitTrigger(value);
+        } else if (key == "flusher_batch_delay") {
+            bucket.setFlusherBatchDelay(std::chrono::milliseconds(value));
+        } else if (key == "flusher_batch_min_items") {
+            bucket.setFlusherBatchMinItems(value);
+        } else if (key == "flusher_concurrency") {
+            bucket.setFlusherConcurrency(value);
+        } else if (key == "flusher_hot_key_delay") {
+            bucket.setFlusherHotKeyDelay(std::chrono::milliseconds(value));
+        } else if (key == "flusher_hot_key_percent") {
+            bucket.setFlusherHotKeyPercent(value);
+        } else if (key == "flusher_vbstate_delay") {
+            bucket.setFlusherVBStateDelay(std::chrono::milliseconds(value));
         } else if (key == "alog_sleep_time") {
             bucket.setAccessScannerSleeptime(value, false);
         } else if (key == "alog_task_time") {
             bucket.resetAccessScannerStartTime();
+        } else if (key == "compaction_max_bytes_per_sec") {
+            bucket.compactionThrottle->setMaxBytesPerSec(value);
+        } else if (key == "compaction_bg_fetch_latency_threshold") {
+            bucket.compactionThrottle->setBgFetchLatencyThreshold(
+                    std::chrono::microseconds(value));
         } else {
             EP_LOG_WARN("Failed to change value for unknown variable, {}", key);
         }
@@ -243,11 +353,69 @@ EPBucket::EPBucket(EventuallyPersistentEngine& theEngine)
             "flusher_batch_split_trigger",
             std::make_unique<ValueChangedListener>(*this));
 
+    flusherBatchDelay = config.getFlusherBatchDelay();
+    config.addValueChangedListener(
+            "flusher_batch_delay",
+            std::make_unique<ValueChangedListener>(*this));
+    flusherBatchMinItems = config.getFlusherBatchMinItems();
+    config.addValueChangedListener(
+            "flusher_batch_min_items",
+            std::make_unique<ValueChangedListener>(*this));
+    flusherConcurrency = config.getFlusherConcurrency();
+    config.addValueChangedListener(
+            "flusher_concurrency",
+            std::make_unique<ValueChangedListener>(*this));
+    flusherHotKeyDelay = config.getFlusherHotKeyDelay();
+    config.addValueChangedListener(
+            "flusher_hot_key_delay",
+            std::make_unique<ValueChangedListener>(*this));
+    flusherHotKeyPercent = config.getFlusherHotKeyPercent();
+    config.addValueChangedListener(
+            "flusher_hot_key_percent",
+            std::make_unique<ValueChangedListener>(*this));
+    flusherVBStateDelay = config.getFlusherVbstateDelay();
+    config.addValueChangedListener(
+            "flusher_vbstate_delay",
+            std::make_unique<ValueChangedListener>(*this));
+
     retainErroneousTombstones = config.isRetainErroneousTombstones();
     config.addValueChangedListener(
            "retain_erroneous_tombstones",
            std::make_unique<ValueChangedListener>(*this));
 
+    if (eviction_policy == EvictionPolicy::Value &&
+        !config.getValueSpillCachePath().empty() &&
+        config.getValueSpillCacheSize() > 0) {
+        try {
+            valueSpillCache = std::make_unique<ValueSpillCache>(
+                    stats,
+                    config.getValueSpillCachePath(),
+                    config.getValueSpillCacheSize());
+        } catch (const std::exception& e) {
+            // Not fatal; ejected values are just read back from disk.
+            EP_LOG_WARN(
+                    "EPBucket: failed to create value spill cache '{}': {}",
+                    config.getValueSpillCachePath(),
+                    e.what());
+        }
+    }
+
+    if (config.getEvictionRefetchTrackingSize() > 0) {
+        evictionGhostList = std::make_unique<EvictionGhostList>(
+                stats, config.getEvictionRefetchTrackingSize());
+    }
+
+    compactionThrottle = std::make_unique<CompactionThrottle>(stats);
+    compactionThrottle->setMaxBytesPerSec(config.getCompactionMaxBytesPerSec());
+    config.addValueChangedListener(
+            "compaction_max_bytes_per_sec",
+            std::make_unique<ValueChangedListener>(*this));
+    compactionThrottle->setBgFetchLatencyThreshold(std::chrono::microseconds(
+            config.getCompactionBgFetchLatencyThreshold()));
+    config.addValueChangedListener(
+            "compaction_bg_fetch_latency_threshold",
+            std::make_unique<ValueChangedListener>(*this));
+
     initializeWarmupTask();
 }
 
@@ -276,7 +444,15 @@ void EPBucket::deinitialize() {
     stopFlusher();
     stopBgFetcher();
 
+    if (!stats.forceShutdown &&
+        engine.getConfiguration().isWarmupHashTableSnapshot()) {
+        saveHashTableSnapshots();
+    }
+
     stopWarmup();
+    if (bfilterRebuildTaskId != 0) {
+        ExecutorPool::get()->cancel(bfilterRebuildTaskId);
+    }
     KVBucket::deinitialize();
 }
 
@@ -315,7 +491,57 @@ static bool canDeDuplicate(Item* lastFlushed, Item& candidate) {
     return true;
 }
 
+void EPBucket::recordSupersededItems(VBucket& vb,
+                                     uint64_t mutations,
+                                     size_t written) {
+    // Every mutation is assigned its own seqno, so the seqnos covered by the
+    // flush which weren't written are mutations superseded by a later one of
+    // the same key; either de-duplicated in the checkpoint or above.
+    if (mutations <= written) {
+        vb.setFlushSupersededPercent(0);
+        return;
+    }
+    const auto superseded = mutations - written;
+    stats.flusherSupersededItems += superseded;
+    vb.setFlushSupersededPercent((superseded * 100) / mutations);
+}
+
+bool EPBucket::commitDeferredVBState(Vbid vbid) {
+    auto vb = getLockedVBucket(vbid);
+    if (!vb || vb->isBucketCreation()) {
+        // Deleted since; or deleted and recreated, in which case its first
+        // flush writes its state.
+        return true;
+    }
+
+    KVStore* rwUnderlying = getRWUnderlying(vbid);
+    const auto* cached = rwUnderlying->getVBucketState(vbid);
+    if (!cached) {
+        return true;
+    }
+
+    // Everything but the state change itself is as of the vBucket's last
+    // flush.
+    auto vbstate = *cached;
+    const auto current = vb->getVBucketState();
+    vbstate.state = current.state;
+    vbstate.failovers = current.failovers;
+    vbstate.replicationTopology = current.replicationTopology;
+
+    while (!rwUnderlying->begin(
+            std::make_unique<EPTransactionContext>(stats, *vb))) {
+        ++stats.beginFailed;
+        EP_LOG_WARN("Failed to start a transaction!!! Retry in 1 sec ...");
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    const bool committed = rwUnderlying->snapshotVBucket(
+            vbid, vbstate, VBStatePersist::VBSTATE_PERSIST_WITH_COMMIT);
+    rwUnderlying->rollback();
+    return committed;
+}
+
 std::pair<bool, size_t> EPBucket::flushVBucket(Vbid vbid) {
+    TRACE_EVENT1("ep-engine/flusher", "flushVBucket", "vbid", vbid.get());
     KVShard *shard = vbMap.getShardByVbId(vbid);
     if (diskDeleteAll && !deleteAllTaskCtx.delay) {
         if (shard->getId() == EP_PRIMARY_SHARD) {
@@ -364,6 +590,7 @@ std::pair<bool, size_t> EPBucket::flushVBucket(Vbid vbid) {
             range.start = std::max(range.start, vbstate.lastSnapStart);
 
             bool mustCheckpointVBState = false;
+            bool deferVBState = false;
 
             Collections::VB::Flush collectionFlush(vb->getManifest());
 
@@ -379,6 +606,11 @@ std::pair<bool, size_t> EPBucket::flushVBucket(Vbid vbid) {
             //     FlushBatch has been committed (and only if the flag is set)
             bool pendingSyncWrite = false;
 
+            // The items written, to update the vBucket's index of the
+            // prepares on disk which are yet to be completed.
+            std::vector<const Item*> flushed;
+            flushed.reserve(items.size());
+
             // Iterate through items, checking if we (a) can skip persisting,
             // (b) can de-duplicate as the previous key was the same, or (c)
             // actually need to persist.
@@ -390,6 +622,8 @@ std::pair<bool, size_t> EPBucket::flushVBucket(Vbid vbid) {
             // underlying KVStore - however the KVStore itself only stores a
             // single value per key, and so even if we don't de-dupe here the
             // KVStore will eventually - just potentialy after unnecessary work.
+            TRACE_EVENT_START1(
+                    "ep-engine/flusher", "writeItems", "items", items.size());
             for (const auto& item : items) {
                 if (!item->shouldPersist()) {
                     continue;
@@ -412,6 +646,7 @@ std::pair<bool, size_t> EPBucket::flushVBucket(Vbid vbid) {
                     prev = item.get();
                     ++items_flushed;
                     flushOneDelOrSet(item, vb.getVB());
+                    flushed.push_back(item.get());
 
                     // At least one pending SyncWrite in the FlushBatch?
                     if (item->isPending()) {
@@ -443,10 +678,15 @@ std::pair<bool, size_t> EPBucket::flushVBucket(Vbid vbid) {
                     vb->doStatsForFlushing(*item, item->size());
                 }
             }
+            TRACE_EVENT_END1(
+                    "ep-engine/flusher", "writeItems", "flushed", items_flushed);
 
+            auto& epVb = static_cast<EPVBucket&>(*vb);
+            epVb.updateOnDiskPrepares(flushed);
 
             {
-                folly::SharedMutex::ReadHolder rlh(vb->getStateLock());
+                ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+                        LockSite::VBucketState, vb->getStateLock());
                 if (vb->getState() == vbucket_state_active) {
                     if (maxSeqno) {
                         range.start = maxSeqno;
@@ -473,16 +713,36 @@ std::pair<bool, size_t> EPBucket::flushVBucket(Vbid vbid) {
                 // Track if the VB has xattrs present
                 vbstate.mightContainXattrs = vb->mightContainXattrs();
 
+                // Where warmup must start looking for outstanding prepares
+                vbstate.preparesStartSeqno = epVb.getOnDiskPreparesStartSeqno(
+                        std::max(maxSeqno, vb->getPersistenceSeqno()));
+
                 // Do we need to trigger a persist of the state?
                 // If there are no "real" items to flush, and we encountered
                 // a set_vbucket_state meta-item.
                 auto options = VBStatePersist::VBSTATE_CACHE_UPDATE_ONLY;
                 if ((items_flushed == 0) && mustCheckpointVBState) {
+                    // The commit of a state change on its own costs an
+                    // fsync; unless someone is waiting on it, defer it so
+                    // it is written by the vBucket's next data commit or
+                    // together with the shard's other deferred states.
+                    deferVBState =
+                            !vb->isBucketCreation() &&
+                            vb->getHighPriorityChkSize() == 0 &&
+                            !vb->hasTrackedSyncWrites() &&
+                            rwUnderlying->getVBucketState(vbid) &&
+                            shard->getFlusher()->deferVBStateCommit(vbid);
                     options = VBStatePersist::VBSTATE_PERSIST_WITH_COMMIT;
                 }
 
-                if (rwUnderlying->snapshotVBucket(vb->getId(), vbstate,
+                // A deferred state isn't cached either, so the KVStore
+                // still sees it as a change when it is finally committed.
+                if (!deferVBState &&
+                    rwUnderlying->snapshotVBucket(vb->getId(), vbstate,
                                                   options) != true) {
+                    // End the transaction, so the store is free for the
+                    // flushes of other vBuckets.
+                    rwUnderlying->rollback();
                     return {true, 0};
                 }
 
@@ -497,18 +757,34 @@ std::pair<bool, size_t> EPBucket::flushVBucket(Vbid vbid) {
              */
             if (items_flushed > 0) {
                 commit(*rwUnderlying, collectionFlush);
+                stats.flusherCommittedItems += items_flushed;
 
                 // Now the commit is complete, vBucket file must exist.
                 if (vb->setBucketCreation(false)) {
                     EP_LOG_DEBUG("{} created", vbid);
                 }
+            } else {
+                // Nothing to commit; end the (empty) transaction.
+                rwUnderlying->rollback();
+            }
+
+            // Any state whose commit was deferred has now been written by
+            // this commit.
+            if (!deferVBState && (items_flushed > 0 || mustCheckpointVBState) &&
+                shard->getFlusher()->vbStateCommitted(vbid)) {
+                ++stats.flusherVBStateFolded;
             }
 
             if (vb->rejectQueue.empty()) {
                 vb->setPersistedSnapshot(range.start, range.end);
                 uint64_t highSeqno = rwUnderlying->getLastPersistedSeqno(vbid);
                 if (highSeqno > 0 && highSeqno != vb->getPersistenceSeqno()) {
+                    recordSupersededItems(*vb.getVB(),
+                                          highSeqno - vb->getPersistenceSeqno(),
+                                          items_flushed);
                     vb->setPersistenceSeqno(highSeqno);
+                    engine.getDcpConnMap().notifyVBConnectionsPersisted(
+                            vbid, highSeqno);
                 }
 
                 // Notify the local DM if the flush-batch contains any durable
@@ -568,6 +844,7 @@ void EPBucket::setFlusherBatchSplitTrigger(size_t limit) {
 
 void EPBucket::commit(KVStore& kvstore,
                       Collections::VB::Flush& collectionsFlush) {
+    TRACE_EVENT0("ep-engine/flusher", "commit");
     BlockTimer timer(&stats.diskCommitHisto, "disk_commit", stats.timingLog);
     auto commit_start = std::chrono::steady_clock::now();
 
@@ -813,13 +1090,14 @@ void EPBucket::dropKey(Vbid vbid, const DiskDocKey& diskKey, int64_t bySeqno) {
 }
 
 void EPBucket::compactInternal(const CompactionConfig& config,
-                               uint64_t purgeSeqno) {
+                               uint64_t purgeSeqno,
+                               bool throttleDeferred) {
     compaction_ctx ctx(config, purgeSeqno);
 
     BloomFilterCBPtr filter(new BloomFilterCallback(*this));
     ctx.bloomFilterCallback = filter;
 
-    ExpiredItemsCBPtr expiry(new ExpiredItemsCallback(*this));
+    auto expiry = std::make_shared<ExpiredItemsCallback>(*this);
     ctx.expiryCallback = expiry;
 
     ctx.droppedKeyCb = std::bind(&EPBucket::dropKey,
@@ -828,9 +1106,13 @@ void EPBucket::compactInternal(const CompactionConfig& config,
                                  std::placeholders::_1,
                                  std::placeholders::_2);
 
+    ctx.throttle = compactionThrottle.get();
+    ctx.throttleDeferred = throttleDeferred;
+
     KVShard* shard = vbMap.getShardByVbId(config.db_file_id);
     KVStore* store = shard->getRWUnderlying();
     bool result = store->compactDB(&ctx);
+    expiry->flush();
 
     /* Iterate over all the vbucket ids set in max_purged_seq map. If there is
      * an entry
@@ -853,12 +1135,17 @@ void EPBucket::compactInternal(const CompactionConfig& config,
     EP_LOG_INFO(
             "Compaction of db file id: {} completed ({}). "
             "tombstones_purged:{}, "
+            "expired:{{items:{}, time_ms:{}}}, "
             "collection_items_erased:alive:{},deleted:{}, "
             "pre{{size:{}, items:{}, deleted_items:{}, purge_seqno:{}}}, "
             "post{{size:{}, items:{}, deleted_items:{}, purge_seqno:{}}}",
             config.db_file_id.get(),
             result ? "ok" : "failed",
             ctx.stats.tombstonesPurged,
+            expiry->numExpired,
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                    expiry->expiryTime)
+                    .count(),
             ctx.stats.collectionsItemsPurged,
             ctx.stats.collectionsDeletedItemsPurged,
             ctx.stats.pre.size,
@@ -886,25 +1173,34 @@ bool EPBucket::doCompact(const CompactionConfig& config,
      * the writer and compactor threads
      */
     if (concWriteCompact == false) {
-        auto vb = getLockedVBucket(vbid, std::try_to_lock);
-        if (!vb.owns_lock()) {
-            // VB currently locked; try again later.
-            return true;
-        }
+        {
+            auto vb = getLockedVBucket(vbid, std::try_to_lock);
+            if (!vb.owns_lock()) {
+                // VB currently locked; try again later.
+                return true;
+            }
 
-        if (!vb) {
-            err = ENGINE_NOT_MY_VBUCKET;
-            engine.storeEngineSpecific(cookie, NULL);
-            /**
-             * Decrement session counter here, as memcached thread wouldn't
-             * visit the engine interface in case of a NOT_MY_VB notification
-             */
-            engine.decrementSessionCtr();
-        } else {
-            compactInternal(config, purgeSeqno);
+            if (!vb) {
+                err = ENGINE_NOT_MY_VBUCKET;
+                engine.storeEngineSpecific(cookie, NULL);
+                /**
+                 * Decrement session counter here, as memcached thread
+                 * wouldn't visit the engine interface in case of a NOT_MY_VB
+                 * notification
+                 */
+                engine.decrementSessionCtr();
+            } else {
+                // Sleeping in the throttle here would block the flusher
+                // (and any other user of the vBucket lock) too.
+                compactInternal(config, purgeSeqno, true);
+            }
+        }
+        if (err == ENGINE_SUCCESS) {
+            // Lock released; now wait out the IO the compaction was charged.
+            compactionThrottle->throttle(0);
         }
     } else {
-        compactInternal(config, purgeSeqno);
+        compactInternal(config, purgeSeqno, false);
     }
 
     updateCompactionTasks(vbid);
@@ -917,25 +1213,41 @@ bool EPBucket::doCompact(const CompactionConfig& config,
 }
 
 void EPBucket::updateCompactionTasks(Vbid db_file_id) {
-    LockHolder lh(compactionLock);
-    bool erased = false, woke = false;
-    std::list<CompTaskEntry>::iterator it = compactionTasks.begin();
-    while (it != compactionTasks.end()) {
-        if ((*it).first == db_file_id) {
-            it = compactionTasks.erase(it);
-            erased = true;
-        } else {
-            ExTask& task = (*it).second;
-            if (task->getState() == TASK_SNOOZED) {
-                ExecutorPool::get()->wake(task->getId());
-                woke = true;
+    std::vector<CompTaskEntry> snoozed;
+    {
+        LockHolder lh(compactionLock);
+        std::list<CompTaskEntry>::iterator it = compactionTasks.begin();
+        while (it != compactionTasks.end()) {
+            if ((*it).first == db_file_id) {
+                it = compactionTasks.erase(it);
+            } else {
+                if ((*it).second->getState() == TASK_SNOOZED) {
+                    snoozed.push_back(*it);
+                }
+                ++it;
             }
-            ++it;
         }
-        if (erased && woke) {
-            break;
+    }
+
+    // Of the snoozed tasks, run next the one which should free the most disk
+    // space. (Reading the file info may need IO, so isn't done under
+    // compactionLock; waking a task which has since run is harmless.)
+    ExTask next;
+    uint64_t nextReclaimable = 0;
+    for (const auto& entry : snoozed) {
+        const auto info =
+                getRWUnderlying(entry.first)->getDbFileInfo(entry.first);
+        const uint64_t reclaimable = info.fileSize > info.spaceUsed
+                                             ? info.fileSize - info.spaceUsed
+                                             : 0;
+        if (!next || reclaimable > nextReclaimable) {
+            next = entry.second;
+            nextReclaimable = reclaimable;
         }
     }
+    if (next) {
+        ExecutorPool::get()->wake(next->getId());
+    }
 }
 
 std::pair<uint64_t, bool> EPBucket::getLastPersistedCheckpointId(Vbid vb) {
@@ -1021,11 +1333,13 @@ VBucketPtr EPBucket::makeVBucket(
         bool mightContainXattrs,
         const nlohmann::json& replicationTopology) {
     auto flusherCb = std::make_shared<NotifyFlusherCB>(shard);
+    // Allocate the vBucket (notably its HashTable) from its shard's node.
+    NumaPreferredNodeGuard numaGuard(shard ? shard->getNumaNode() : -1);
     // Not using make_shared or allocate_shared
     // 1. make_shared doesn't accept a Deleter
     // 2. allocate_shared has inconsistencies between platforms in calling
     //    alloc.destroy (libc++ doesn't call it)
-    return VBucketPtr(new EPVBucket(id,
+    auto* vb = new EPVBucket(id,
                                     state,
                                     stats,
                                     engine.getCheckpointConfig(),
@@ -1046,8 +1360,10 @@ VBucketPtr EPBucket::makeVBucket(
                                     maxCas,
                                     hlcEpochSeqno,
                                     mightContainXattrs,
-                                    replicationTopology),
-                      VBucket::DeferredDeleter(engine));
+                                    replicationTopology);
+    vb->setValueSpillCache(valueSpillCache.get());
+    vb->setSyncWriteTimeoutCallback(makeSyncWriteTimeoutCB());
+    return VBucketPtr(vb, VBucket::DeferredDeleter(engine));
 }
 
 ENGINE_ERROR_CODE EPBucket::statsVKey(const DocKey& key,
@@ -1197,6 +1513,10 @@ RollbackResult EPBucket::doRollback(Vbid vbid, uint64_t rollbackSeqno) {
 }
 
 void EPBucket::rollbackUnpersistedItems(VBucket& vb, int64_t rollbackSeqno) {
+    // The rollback may have brought back prepares the index had seen
+    // completed; until warmup rebuilds it, warmup must scan for them all.
+    static_cast<EPVBucket&>(vb).setOnDiskPreparesKnown(false);
+
     std::vector<queued_item> items;
     vb.checkpointManager->getAllItemsForPersistence(items);
     for (const auto& item : items) {
@@ -1232,6 +1552,10 @@ bool EPBucket::isWarmingUp() {
     return warmupTask && !warmupTask->isComplete();
 }
 
+bool EPBucket::isVBucketWarmingUp(Vbid vbid) {
+    return warmupTask && !warmupTask->isVBucketWarmedUp(vbid);
+}
+
 bool EPBucket::isWarmupOOMFailure() {
     return warmupTask && warmupTask->hasOOMFailure();
 }
@@ -1351,9 +1675,81 @@ void EPBucket::warmupCompleted() {
     ExTask task = std::make_shared<StatSnap>(&engine, 0, false);
     statsSnapshotTaskId = iom->schedule(task);
 
+    // Warmed up vBuckets have no bloom filter; start rebuilding them now.
+    if (engine.getConfiguration().getBfilterRebuildInterval() != 0) {
+        bfilterRebuildTaskId =
+                iom->schedule(std::make_shared<BloomFilterRebuildTask>(*this));
+    }
+
     collectionsManager->warmupCompleted(*this);
 }
 
+bool EPBucket::rebuildBloomFilter(Vbid vbid) {
+    auto vb = getVBucket(vbid);
+    if (!vb) {
+        return false;
+    }
+
+    const auto& config = engine.getConfiguration();
+    size_t keyCount;
+    if (!estimateBloomFilterKeyCount(*this, *vb, keyCount) ||
+        !vb->initRebuildFilter(
+                keyCount,
+                config.getBfilterFpProb(),
+                BloomFilter::typeFromString(config.getBfilterType()))) {
+        return false;
+    }
+
+    // The rebuild filter exists before the scan's snapshot of the file is
+    // taken, so keys persisted after the snapshot are added to it by
+    // addToFilter().
+    auto cb = std::make_shared<BloomFilterRebuildCallback>(*this, vb);
+    auto cl = std::make_shared<NoLookupCallback>();
+    auto* kvstore = getROUnderlying(vbid);
+    auto* ctx = kvstore->initScanContext(cb,
+                                         cl,
+                                         vbid,
+                                         0,
+                                         DocumentFilter::ALL_ITEMS,
+                                         ValueFilter::KEYS_ONLY);
+    bool success = false;
+    if (ctx) {
+        success = kvstore->scan(ctx) == scan_success;
+        kvstore->destroyScanContext(ctx);
+    }
+
+    if (!success) {
+        EP_LOG_WARN("EPBucket::rebuildBloomFilter: scan of {} failed", vbid);
+        vb->clearRebuildFilter();
+        return false;
+    }
+    vb->swapRebuiltFilter();
+    ++stats.bfilterRebuilds;
+    EP_LOG_DEBUG("EPBucket::rebuildBloomFilter: rebuilt filter of {} for {} "
+                 "keys",
+                 vbid,
+                 keyCount);
+    return true;
+}
+
+void EPBucket::saveHashTableSnapshots() {
+    // Snapshots are only used by the value-eviction KeyDump, and are only
+    // complete if every key was loaded into the HashTable by warmup.
+    if (getItemEvictionPolicy() != EvictionPolicy::Value || !warmupTask ||
+        !warmupTask->isComplete() || warmupTask->hasOOMFailure()) {
+        return;
+    }
+
+    const auto dbname = engine.getConfiguration().getDbname();
+    for (const auto vbid : vbMap.getBuckets()) {
+        auto vb = getVBucket(vbid);
+        if (vb) {
+            HashTableSnapshot::save(HashTableSnapshot::getPath(dbname, vbid),
+                                    *vb);
+        }
+    }
+}
+
 void EPBucket::stopWarmup(void) {
     // forcefully stop current warmup task
     if (isWarmingUp()) {
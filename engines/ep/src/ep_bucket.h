@@ -19,6 +19,9 @@
 
 #include "kv_bucket.h"
 
+class CompactionThrottle;
+class ValueSpillCache;
+
 /**
  * Eventually Persistent Bucket
  *
@@ -57,6 +60,92 @@ public:
      */
     void setFlusherBatchSplitTrigger(size_t limit);
 
+    /**
+     * Set the maximum time a vBucket with fewer than flusherBatchMinItems
+     * outstanding items may have its flush deferred, to allow more items to
+     * accumulate into a single commit. Zero disables deferral.
+     */
+    void setFlusherBatchDelay(std::chrono::milliseconds delay) {
+        flusherBatchDelay = delay.count();
+    }
+
+    std::chrono::milliseconds getFlusherBatchDelay() const {
+        return std::chrono::milliseconds(flusherBatchDelay.load());
+    }
+
+    /**
+     * Set the number of outstanding items at (or above) which a vBucket is
+     * flushed immediately, regardless of flusherBatchDelay.
+     */
+    void setFlusherBatchMinItems(size_t items) {
+        flusherBatchMinItems = items;
+    }
+
+    size_t getFlusherBatchMinItems() const {
+        return flusherBatchMinItems;
+    }
+
+    /**
+     * Set the maximum time a vBucket with hot keys (see
+     * setFlusherHotKeyPercent) may have its flush deferred, so that repeated
+     * updates of those keys are de-duplicated rather than written. Zero
+     * disables deferral.
+     */
+    void setFlusherHotKeyDelay(std::chrono::milliseconds delay) {
+        flusherHotKeyDelay = delay.count();
+    }
+
+    std::chrono::milliseconds getFlusherHotKeyDelay() const {
+        return std::chrono::milliseconds(flusherHotKeyDelay.load());
+    }
+
+    /**
+     * Set the percentage of the mutations covered by a vBucket's last flush
+     * which must have been superseded for the vBucket to be considered to
+     * have hot keys.
+     */
+    void setFlusherHotKeyPercent(size_t percent) {
+        flusherHotKeyPercent = percent;
+    }
+
+    size_t getFlusherHotKeyPercent() const {
+        return flusherHotKeyPercent;
+    }
+
+    /**
+     * Set the maximum number of a shard's vBuckets which may be flushed
+     * concurrently (if the KVStore supports it).
+     */
+    void setFlusherConcurrency(size_t concurrency) {
+        flusherConcurrency = concurrency;
+    }
+
+    size_t getFlusherConcurrency() const {
+        return flusherConcurrency;
+    }
+
+    /**
+     * Set the maximum time the commit of a vBucket state change which has
+     * no data to be written with it may be deferred, so that it is written
+     * by the vBucket's next data commit or together with the shard's other
+     * deferred states. Zero commits each state change immediately.
+     */
+    void setFlusherVBStateDelay(std::chrono::milliseconds delay) {
+        flusherVBStateDelay = delay.count();
+    }
+
+    std::chrono::milliseconds getFlusherVBStateDelay() const {
+        return std::chrono::milliseconds(flusherVBStateDelay.load());
+    }
+
+    /**
+     * Commit the given vBucket's state, whose commit was deferred by
+     * flushVBucket (see setFlusherVBStateDelay()).
+     *
+     * @return false if the commit failed and must be retried.
+     */
+    bool commitDeferredVBState(Vbid vbid);
+
     void commit(KVStore& kvstore, Collections::VB::Flush& collectionsFlush);
 
     /// Start the Flusher for all shards in this bucket.
@@ -155,6 +244,8 @@ public:
 
     bool isWarmingUp() override;
 
+    bool isVBucketWarmingUp(Vbid vbid) override;
+
     bool isWarmupOOMFailure() override;
 
     /**
@@ -181,6 +272,16 @@ public:
 
     void warmupCompleted();
 
+    /**
+     * Rebuild the given vBucket's bloom filter from a key-only scan of its
+     * disk data (instead of waiting for the next compaction to), sized from
+     * its current item counts. The new filter is swapped in once the scan
+     * completes.
+     *
+     * @return true if the filter was rebuilt
+     */
+    bool rebuildBloomFilter(Vbid vbid);
+
 protected:
     // During the warmup phase we might want to enable external traffic
     // at a given point in time.. The LoadStorageKvPairCallback will be
@@ -193,15 +294,32 @@ protected:
 
     void flushOneDelOrSet(const queued_item& qi, VBucketPtr& vb);
 
+    /**
+     * Account for the mutations a flush covered which were superseded by a
+     * later mutation of the same key, and so weren't written.
+     *
+     * @param vb The vBucket flushed
+     * @param mutations Number of seqnos the flush advanced the persisted
+     *        seqno by
+     * @param written Number of items the flush wrote
+     */
+    void recordSupersededItems(VBucket& vb, uint64_t mutations, size_t written);
+
     /**
      * Compaction of a database file
      *
      * @param config the configuration to use for running compaction
+     * @param throttleDeferred if true, only charge the compaction's IO to
+     *        the throttle rather than wait for it (the caller holds the
+     *        vBucket lock, and waits once it has released it)
      */
-    void compactInternal(const CompactionConfig& config, uint64_t purgeSeqno);
+    void compactInternal(const CompactionConfig& config,
+                         uint64_t purgeSeqno,
+                         bool throttleDeferred);
 
     /**
-     * Remove completed compaction tasks or wake snoozed tasks
+     * Remove the completed compaction task, and wake the snoozed task (if
+     * any) whose vBucket has the most space to reclaim
      *
      * @param db_file_id vbucket id for couchstore
      */
@@ -209,6 +327,13 @@ protected:
 
     void stopWarmup();
 
+    /**
+     * At clean shutdown (once the flusher has drained) write a snapshot of
+     * each vBucket's HashTable metadata, for the next warmup to load keys
+     * from. See HashTableSnapshot.
+     */
+    void saveHashTableSnapshots();
+
     /// function which is passed down to compactor for dropping keys
     void dropKey(Vbid vbid, const DiskDocKey& key, int64_t bySeqno);
 
@@ -218,11 +343,38 @@ protected:
      */
     size_t flusherBatchSplitTrigger;
 
+    /// See setFlusherBatchDelay() (in milliseconds).
+    std::atomic<size_t> flusherBatchDelay;
+
+    /// See setFlusherBatchMinItems().
+    std::atomic<size_t> flusherBatchMinItems;
+
+    /// See setFlusherConcurrency().
+    std::atomic<size_t> flusherConcurrency;
+
+    /// See setFlusherHotKeyDelay() (in milliseconds).
+    std::atomic<size_t> flusherHotKeyDelay;
+
+    /// See setFlusherHotKeyPercent().
+    std::atomic<size_t> flusherHotKeyPercent;
+
+    /// See setFlusherVBStateDelay() (in milliseconds).
+    std::atomic<size_t> flusherVBStateDelay;
+
     /**
      * Indicates whether erroneous tombstones need to retained or not during
      * compaction
      */
     cb::RelaxedAtomic<bool> retainErroneousTombstones;
 
+    /// Paces the disk IO of all of this bucket's compactions.
+    std::unique_ptr<CompactionThrottle> compactionThrottle;
+
+    /// Second-tier cache of ejected values (see value_spill_cache_path).
+    std::unique_ptr<ValueSpillCache> valueSpillCache;
+
+    /// Id of the BloomFilterRebuildTask (0 if not scheduled).
+    size_t bfilterRebuildTaskId = 0;
+
     std::unique_ptr<Warmup> warmupTask;
 };
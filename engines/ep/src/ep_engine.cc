@@ -32,10 +32,12 @@
 #include "ep_bucket.h"
 #include "ep_vb.h"
 #include "ephemeral_bucket.h"
+#include "eviction_ghost_list.h"
 #include "ext_meta_parser.h"
 #include "failover-table.h"
 #include "flusher.h"
 #include "htresizer.h"
+#include "lock_profiler.h"
 #include "memory_tracker.h"
 #include "replicationthrottle.h"
 #include "stats-info.h"
@@ -47,6 +49,7 @@
 #include <JSON_checker.h>
 #include <logger/logger.h>
 #include <memcached/engine.h>
+#include <memcached/metrics.h>
 #include <memcached/protocol_binary.h>
 #include <memcached/server_cookie_iface.h>
 #include <memcached/util.h>
@@ -338,6 +341,56 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::get_stats(
                                          addStatExitBorderGuard);
 }
 
+/**
+ * A cb::metrics::Collector which forwards to the daemon's collector outside
+ * of the engine's memory accounting (as makeExitBorderGuard does for the
+ * AddStatFn of get_stats).
+ */
+class ExitBorderCollector : public cb::metrics::Collector {
+public:
+    explicit ExitBorderCollector(cb::metrics::Collector& wrapped)
+        : wrapped(wrapped) {
+    }
+
+    cb::metrics::Cardinality getCardinality() const override {
+        return wrapped.getCardinality();
+    }
+
+    void addCounter(cb::const_char_buffer name,
+                    cb::const_char_buffer help,
+                    cb::metrics::Labels labels,
+                    uint64_t value) override {
+        NonBucketAllocationGuard exitGuard;
+        wrapped.addCounter(name, help, labels, value);
+    }
+
+    void addGauge(cb::const_char_buffer name,
+                  cb::const_char_buffer help,
+                  cb::metrics::Labels labels,
+                  double value) override {
+        NonBucketAllocationGuard exitGuard;
+        wrapped.addGauge(name, help, labels, value);
+    }
+
+    void addHistogram(cb::const_char_buffer name,
+                      cb::const_char_buffer help,
+                      cb::metrics::Labels labels,
+                      const cb::metrics::HistogramData& histogram) override {
+        NonBucketAllocationGuard exitGuard;
+        wrapped.addHistogram(name, help, labels, histogram);
+    }
+
+private:
+    cb::metrics::Collector& wrapped;
+};
+
+ENGINE_ERROR_CODE EventuallyPersistentEngine::get_metrics(
+        gsl::not_null<const void*> cookie, cb::metrics::Collector& collector) {
+    ExitBorderCollector exitBorderCollector(collector);
+    acquireEngine(this)->doMetrics(exitBorderCollector);
+    return ENGINE_SUCCESS;
+}
+
 ENGINE_ERROR_CODE EventuallyPersistentEngine::store(
         gsl::not_null<const void*> cookie,
         gsl::not_null<item*> itm,
@@ -375,6 +428,39 @@ cb::EngineErrorCasPair EventuallyPersistentEngine::store_if(
             cookie, item, cas, operation, predicate);
 }
 
+cb::EngineErrorArithmeticResult EventuallyPersistentEngine::arithmetic(
+        gsl::not_null<const void*> cookie,
+        const DocKey& key,
+        Vbid vbucket,
+        bool increment,
+        uint64_t delta,
+        uint64_t cas,
+        const boost::optional<cb::durability::Requirements>& durability) {
+    if (durability) {
+        // A SyncWrite completes asynchronously; leave it to store()
+        return {cb::engine_errc::not_supported, 0, 0, 0, 0};
+    }
+    return acquireEngine(this)->arithmeticInner(
+            cookie, key, vbucket, increment, delta, cas);
+}
+
+ENGINE_ERROR_CODE EventuallyPersistentEngine::append_prepend(
+        gsl::not_null<const void*> cookie,
+        const DocKey& key,
+        Vbid vbucket,
+        bool append,
+        cb::const_char_buffer value,
+        uint64_t& cas,
+        const boost::optional<cb::durability::Requirements>& durability,
+        mutation_descr_t& mut_info) {
+    if (durability) {
+        // A SyncWrite completes asynchronously; leave it to store()
+        return ENGINE_ENOTSUP;
+    }
+    return acquireEngine(this)->appendPrependInner(
+            cookie, key, vbucket, append, value, cas, mut_info);
+}
+
 void EventuallyPersistentEngine::reset_stats(
         gsl::not_null<const void*> cookie) {
     acquireEngine(this)->resetStats();
@@ -392,6 +478,8 @@ cb::mcbp::Status EventuallyPersistentEngine::setReplicationParam(
             getConfiguration().setReplicationThrottleQueueCap(std::stoll(val));
         } else if (key == "replication_throttle_cap_pcnt") {
             getConfiguration().setReplicationThrottleCapPcnt(std::stoull(val));
+        } else if (key == "replication_throttle_rate_based") {
+            getConfiguration().setReplicationThrottleRateBased(cb_stob(val));
         } else {
             msg = "Unknown config param";
             rv = cb::mcbp::Status::KeyEnoent;
@@ -442,6 +530,8 @@ cb::mcbp::Status EventuallyPersistentEngine::setCheckpointParam(
             getConfiguration().setItemNumBasedNewChk(cb_stob(val));
         } else if (key == "keep_closed_chks") {
             getConfiguration().setKeepClosedChks(cb_stob(val));
+        } else if (key == "chk_compress_values") {
+            getConfiguration().setChkCompressValues(cb_stob(val));
         } else if (key == "cursor_dropping_checkpoint_mem_upper_mark") {
             size_t v = std::stoull(val);
             validate(v,
@@ -510,6 +600,13 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
             getConfiguration().setCompactionExpMemThreshold(std::stoull(val));
         } else if (key == "mutation_mem_threshold") {
             getConfiguration().setMutationMemThreshold(std::stoull(val));
+        } else if (key == "proactive_eviction_threshold") {
+            getConfiguration().setProactiveEvictionThreshold(
+                    std::stoull(val));
+        } else if (key == "proactive_eviction_max_items") {
+            getConfiguration().setProactiveEvictionMaxItems(std::stoull(val));
+        } else if (key == "touch_coalesce_window") {
+            getConfiguration().setTouchCoalesceWindow(std::stoull(val));
         } else if (key == "timing_log") {
             EPStats& stats = getEpStats();
             std::ostream* old = stats.timingLog;
@@ -545,6 +642,17 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
         } else if (key == "alog_task_time") {
             getConfiguration().requirementsMetOrThrow("alog_task_time");
             getConfiguration().setAlogTaskTime(std::stoull(val));
+        } else if (key == "alog_max_items_per_sec") {
+            getConfiguration().requirementsMetOrThrow("alog_max_items_per_sec");
+            getConfiguration().setAlogMaxItemsPerSec(std::stoull(val));
+        } else if (key == "alog_residency_change_threshold") {
+            getConfiguration().requirementsMetOrThrow(
+                    "alog_residency_change_threshold");
+            getConfiguration().setAlogResidencyChangeThreshold(
+                    std::stoull(val));
+        } else if (key == "alog_write_buffer_size") {
+            getConfiguration().requirementsMetOrThrow("alog_write_buffer_size");
+            getConfiguration().setAlogWriteBufferSize(std::stoull(val));
             /* Start of ItemPager parameters */
         } else if (key == "pager_active_vb_pcnt") {
             getConfiguration().setPagerActiveVbPcnt(std::stoull(val));
@@ -555,6 +663,10 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
         } else if (key == "item_eviction_freq_counter_age_threshold") {
             getConfiguration().setItemEvictionFreqCounterAgeThreshold(
                     std::stoull(val));
+        } else if (key == "item_eviction_sample_size") {
+            getConfiguration().setItemEvictionSampleSize(std::stoull(val));
+        } else if (key == "item_eviction_strategy") {
+            getConfiguration().setItemEvictionStrategy(val);
         } else if (key == "item_freq_decayer_chunk_duration") {
             getConfiguration().setItemFreqDecayerChunkDuration(
                     std::stoull(val));
@@ -587,9 +699,29 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
             getConfiguration().setBfilterResidencyThreshold(std::stof(val));
         } else if (key == "defragmenter_enabled") {
             getConfiguration().setDefragmenterEnabled(cb_stob(val));
+        } else if (key == "defragmenter_slab_aware") {
+            getConfiguration().setDefragmenterSlabAware(cb_stob(val));
         } else if (key == "defragmenter_interval") {
             auto v = std::stod(val);
             getConfiguration().setDefragmenterInterval(v);
+        } else if (key == "defragmenter_auto_enabled") {
+            getConfiguration().setDefragmenterAutoEnabled(cb_stob(val));
+        } else if (key == "defragmenter_auto_target_fragmentation") {
+            getConfiguration().setDefragmenterAutoTargetFragmentation(
+                    std::stof(val));
+        } else if (key == "defragmenter_auto_min_sleep") {
+            getConfiguration().setDefragmenterAutoMinSleep(std::stof(val));
+        } else if (key == "defragmenter_auto_max_sleep") {
+            getConfiguration().setDefragmenterAutoMaxSleep(std::stof(val));
+        } else if (key == "defragmenter_auto_max_chunk_duration") {
+            getConfiguration().setDefragmenterAutoMaxChunkDuration(
+                    std::stoull(val));
+        } else if (key == "defragmenter_auto_pid_p") {
+            getConfiguration().setDefragmenterAutoPidP(std::stof(val));
+        } else if (key == "defragmenter_auto_pid_i") {
+            getConfiguration().setDefragmenterAutoPidI(std::stof(val));
+        } else if (key == "defragmenter_auto_pid_d") {
+            getConfiguration().setDefragmenterAutoPidD(std::stof(val));
         } else if (key == "item_compressor_interval") {
             size_t v = std::stoull(val);
             // Adding separate validation as external limit is minimum 1
@@ -598,6 +730,12 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
             getConfiguration().setItemCompressorInterval(v);
         } else if (key == "item_compressor_chunk_duration") {
             getConfiguration().setItemCompressorChunkDuration(std::stoull(val));
+        } else if (key == "item_compressor_hot_threshold") {
+            getConfiguration().setItemCompressorHotThreshold(std::stoull(val));
+        } else if (key == "compression_skip_threshold") {
+            getConfiguration().setCompressionSkipThreshold(std::stoull(val));
+        } else if (key == "compression_sample_interval") {
+            getConfiguration().setCompressionSampleInterval(std::stoull(val));
         } else if (key == "defragmenter_age_threshold") {
             getConfiguration().setDefragmenterAgeThreshold(std::stoull(val));
         } else if (key == "defragmenter_chunk_duration") {
@@ -607,8 +745,31 @@ cb::mcbp::Status EventuallyPersistentEngine::setFlushParam(
                     std::stoull(val));
         } else if (key == "defragmenter_run") {
             runDefragmenterTask();
+        } else if (key == "nonio_task_cpu_budget") {
+            getConfiguration().setNonioTaskCpuBudget(std::stoull(val));
         } else if (key == "compaction_write_queue_cap") {
             getConfiguration().setCompactionWriteQueueCap(std::stoull(val));
+        } else if (key == "compaction_max_bytes_per_sec") {
+            getConfiguration().requirementsMetOrThrow(
+                    "compaction_max_bytes_per_sec");
+            getConfiguration().setCompactionMaxBytesPerSec(std::stoull(val));
+        } else if (key == "flusher_concurrency") {
+            getConfiguration().setFlusherConcurrency(std::stoull(val));
+        } else if (key == "flusher_hot_key_delay") {
+            getConfiguration().setFlusherHotKeyDelay(std::stoull(val));
+        } else if (key == "flusher_hot_key_percent") {
+            getConfiguration().setFlusherHotKeyPercent(std::stoull(val));
+        } else if (key == "flusher_vbstate_delay") {
+            getConfiguration().setFlusherVbstateDelay(std::stoull(val));
+        } else if (key == "range_scan_max_bytes_per_sec") {
+            getConfiguration().requirementsMetOrThrow(
+                    "range_scan_max_bytes_per_sec");
+            getConfiguration().setRangeScanMaxBytesPerSec(std::stoull(val));
+        } else if (key == "compaction_bg_fetch_latency_threshold") {
+            getConfiguration().requirementsMetOrThrow(
+                    "compaction_bg_fetch_latency_threshold");
+            getConfiguration().setCompactionBgFetchLatencyThreshold(
+                    std::stoull(val));
         } else if (key == "chk_expel_enabled") {
             getConfiguration().setChkExpelEnabled(cb_stob(val));
         } else if (key == "dcp_min_compression_ratio") {
@@ -705,6 +866,10 @@ cb::mcbp::Status EventuallyPersistentEngine::setDcpParam(const std::string& key,
             checkNumeric(val.c_str());
             validate(v, size_t(1), std::numeric_limits<size_t>::max());
             getConfiguration().setDcpIdleTimeout(v);
+        } else if (key == "dcp_conn_notifier_linger_time") {
+            size_t v = size_t(std::stoul(val));
+            checkNumeric(val.c_str());
+            getConfiguration().setDcpConnNotifierLingerTime(v);
         } else {
             msg = "Unknown config param";
             rv = cb::mcbp::Status::KeyEnoent;
@@ -1171,8 +1336,14 @@ static ENGINE_ERROR_CODE processUnknownCommand(EventuallyPersistentEngine* h,
     }
     case cb::mcbp::ClientOpcode::GetRandomKey:
         return h->getRandomKey(cookie, response);
+    case cb::mcbp::ClientOpcode::GetRandomKeys:
+        return h->getRandomKeys(cookie, request, response);
     case cb::mcbp::ClientOpcode::GetKeys:
         return h->getAllKeys(cookie, request, response);
+    case cb::mcbp::ClientOpcode::RangeScan:
+        return h->rangeScan(cookie, request, response);
+    case cb::mcbp::ClientOpcode::BulkStore:
+        return h->bulkStore(cookie, request, response);
         // MB-21143: Remove adjusted time/drift API, but return NOT_SUPPORTED
     case cb::mcbp::ClientOpcode::GetAdjustedTime:
     case cb::mcbp::ClientOpcode::SetDriftCounterState: {
@@ -1748,6 +1919,13 @@ cb::EngineErrorMetadataPair EventuallyPersistentEngine::get_meta(
     return acquireEngine(this)->getMetaInner(cookie, key, vbucket);
 }
 
+std::vector<cb::EngineErrorMetadataPair>
+EventuallyPersistentEngine::get_meta_multi(gsl::not_null<const void*> cookie,
+                                           const std::vector<DocKey>& keys,
+                                           Vbid vbucket) {
+    return acquireEngine(this)->getMetaMultiInner(cookie, keys, vbucket);
+}
+
 cb::engine_errc EventuallyPersistentEngine::set_collection_manifest(
         gsl::not_null<const void*> cookie, cb::const_char_buffer json) {
     auto engine = acquireEngine(this);
@@ -1951,6 +2129,8 @@ public:
             engine.setMaxItemSize(value);
         } else if (key.compare("max_item_privileged_bytes") == 0) {
             engine.setMaxItemPrivilegedBytes(value);
+        } else if (key == "lock_profile_sample_interval") {
+            LockProfiler::setSampleInterval(value);
         }
     }
 
@@ -2034,6 +2214,12 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::initialize(const char* config) {
             "getl_max_timeout",
             std::make_unique<EpEngineValueChangeListener>(*this));
 
+    LockProfiler::setSampleInterval(
+            configuration.getLockProfileSampleInterval());
+    configuration.addValueChangedListener(
+            "lock_profile_sample_interval",
+            std::make_unique<EpEngineValueChangeListener>(*this));
+
     workload = new WorkLoadPolicy(configuration.getMaxNumWorkers(),
                                   configuration.getMaxNumShards());
     if ((unsigned int)workload->getNumShards() >
@@ -2058,6 +2244,9 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::initialize(const char* config) {
     } else if (!flowCtlPolicy.compare("aggressive")) {
         dcpFlowControlManager_ =
                 std::make_unique<DcpFlowControlManagerAggressive>(*this);
+    } else if (!flowCtlPolicy.compare("bdp")) {
+        dcpFlowControlManager_ =
+                std::make_unique<DcpFlowControlManagerBdp>(*this);
     } else {
         /* Flow control is not enabled */
         dcpFlowControlManager_ = std::make_unique<DcpFlowControlManager>(*this);
@@ -2164,6 +2353,7 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::itemAllocate(
     if (*itm == NULL) {
         return memoryCondition();
     } else {
+        reinterpret_cast<Item*>(*itm)->setFrontEndOwned();
         stats.itemAllocSizeHisto.addValue(nbytes);
         return ENGINE_SUCCESS;
     }
@@ -2197,7 +2387,7 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::itemDelete(
     case ENGINE_KEY_ENOENT:
         // FALLTHROUGH
     case ENGINE_NOT_MY_VBUCKET:
-        if (isDegradedMode()) {
+        if (isDegradedMode(vbucket)) {
             return ENGINE_TMPFAIL;
         }
         break;
@@ -2225,7 +2415,7 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::itemDelete(
 }
 
 void EventuallyPersistentEngine::itemRelease(item* itm) {
-    delete reinterpret_cast<Item*>(itm);
+    Item::releaseFromFrontEnd(reinterpret_cast<Item*>(itm));
 }
 
 ENGINE_ERROR_CODE EventuallyPersistentEngine::get(const void* cookie,
@@ -2246,7 +2436,7 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::get(const void* cookie,
             ++stats.numOpsGet;
         }
     } else if (ret == ENGINE_KEY_ENOENT || ret == ENGINE_NOT_MY_VBUCKET) {
-        if (isDegradedMode()) {
+        if (isDegradedMode(vbucket)) {
             return ENGINE_TMPFAIL;
         }
     }
@@ -2270,7 +2460,7 @@ cb::EngineErrorItemPair EventuallyPersistentEngine::getAndTouchInner(
                 cb::engine_errc::success, gv.item.release(), handle);
     }
 
-    if (isDegradedMode()) {
+    if (isDegradedMode(vbucket)) {
         // Remap all some of the error codes
         switch (rv) {
         case ENGINE_KEY_EEXISTS:
@@ -2333,7 +2523,7 @@ cb::EngineErrorItemPair EventuallyPersistentEngine::getIfInner(
 
         case ENGINE_KEY_ENOENT: // FALLTHROUGH
         case ENGINE_NOT_MY_VBUCKET: // FALLTHROUGH
-            if (isDegradedMode()) {
+            if (isDegradedMode(vbucket)) {
                 status = ENGINE_TMPFAIL;
             }
             // FALLTHROUGH
@@ -2443,14 +2633,14 @@ cb::EngineErrorCasPair EventuallyPersistentEngine::storeIfInner(
         }
     // FALLTHROUGH
     case OPERATION_SET:
-        if (isDegradedMode()) {
+        if (isDegradedMode(item.getVBucketId())) {
             return {cb::engine_errc::temporary_failure, cas};
         }
         status = kvBucket->set(item, cookie, predicate);
         break;
 
     case OPERATION_ADD:
-        if (isDegradedMode()) {
+        if (isDegradedMode(item.getVBucketId())) {
             return {cb::engine_errc::temporary_failure, cas};
         }
 
@@ -2480,7 +2670,7 @@ cb::EngineErrorCasPair EventuallyPersistentEngine::storeIfInner(
         break;
     case ENGINE_NOT_STORED:
     case ENGINE_NOT_MY_VBUCKET:
-        if (isDegradedMode()) {
+        if (isDegradedMode(item.getVBucketId())) {
             return {cb::engine_errc::temporary_failure, cas};
         }
         break;
@@ -2501,6 +2691,71 @@ cb::EngineErrorCasPair EventuallyPersistentEngine::storeIfInner(
     return {cb::engine_errc(status), item.getCas()};
 }
 
+cb::EngineErrorArithmeticResult EventuallyPersistentEngine::arithmeticInner(
+        const void* cookie,
+        const DocKey& key,
+        Vbid vbucket,
+        bool increment,
+        uint64_t delta,
+        uint64_t cas) {
+    ScopeTimer2<HdrMicroSecStopwatch, TracerStopwatch> timer(
+            HdrMicroSecStopwatch(stats.storeCmdHisto),
+            TracerStopwatch(cookie, cb::tracing::TraceCode::STORE));
+
+    if (isDegradedMode(vbucket)) {
+        return {cb::engine_errc::temporary_failure, 0, 0, 0, 0};
+    }
+
+    auto result =
+            kvBucket->arithmetic(key, vbucket, cookie, increment, delta, cas);
+    switch (result.status) {
+    case cb::engine_errc::success:
+        ++stats.numOpsStore;
+        ++stats.numOpsArithmeticInPlace;
+        kvBucket->checkAndMaybeFreeMemory();
+        break;
+    case cb::engine_errc::no_memory:
+        result.status = cb::engine_errc(memoryCondition());
+        break;
+    default:
+        break;
+    }
+    return result;
+}
+
+ENGINE_ERROR_CODE EventuallyPersistentEngine::appendPrependInner(
+        const void* cookie,
+        const DocKey& key,
+        Vbid vbucket,
+        bool append,
+        cb::const_char_buffer value,
+        uint64_t& cas,
+        mutation_descr_t& mut_info) {
+    ScopeTimer2<HdrMicroSecStopwatch, TracerStopwatch> timer(
+            HdrMicroSecStopwatch(stats.storeCmdHisto),
+            TracerStopwatch(cookie, cb::tracing::TraceCode::STORE));
+
+    if (isDegradedMode(vbucket)) {
+        return ENGINE_TMPFAIL;
+    }
+
+    auto status = kvBucket->appendPrepend(
+            key, vbucket, cookie, append, value, cas, mut_info);
+    switch (status) {
+    case ENGINE_SUCCESS:
+        ++stats.numOpsStore;
+        ++stats.numOpsAppendPrependInPlace;
+        kvBucket->checkAndMaybeFreeMemory();
+        break;
+    case ENGINE_ENOMEM:
+        status = memoryCondition();
+        break;
+    default:
+        break;
+    }
+    return status;
+}
+
 ENGINE_ERROR_CODE EventuallyPersistentEngine::storeInner(
         const void* cookie,
         Item& itm,
@@ -2604,6 +2859,37 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(
     if (flusher) {
         add_casted_stat("ep_commit_num", epstats.flusherCommits,
                         add_stat, cookie);
+        add_casted_stat("ep_commit_items",
+                        epstats.flusherCommittedItems,
+                        add_stat,
+                        cookie);
+        const auto commits = epstats.flusherCommits.load();
+        add_casted_stat("ep_commit_items_per_commit",
+                        commits ? double(epstats.flusherCommittedItems) /
+                                          commits
+                                : 0.0,
+                        add_stat,
+                        cookie);
+        add_casted_stat("ep_flusher_deferrals",
+                        epstats.flusherDeferrals,
+                        add_stat,
+                        cookie);
+        add_casted_stat("ep_flusher_hot_key_deferrals",
+                        epstats.flusherHotKeyDeferrals,
+                        add_stat,
+                        cookie);
+        add_casted_stat("ep_flusher_superseded_items",
+                        epstats.flusherSupersededItems,
+                        add_stat,
+                        cookie);
+        add_casted_stat("ep_flusher_vbstate_deferrals",
+                        epstats.flusherVBStateDeferrals,
+                        add_stat,
+                        cookie);
+        add_casted_stat("ep_flusher_vbstate_folded",
+                        epstats.flusherVBStateFolded,
+                        add_stat,
+                        cookie);
         add_casted_stat("ep_commit_time",
                         epstats.commit_time, add_stat, cookie);
         add_casted_stat("ep_commit_time_total",
@@ -2686,6 +2972,8 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(
                     add_stat, cookie);
     add_casted_stat("ep_bg_meta_fetched", epstats.bg_meta_fetched,
                     add_stat, cookie);
+    add_casted_stat("ep_bg_fetch_coalesced", epstats.bg_fetch_coalesced,
+                    add_stat, cookie);
     add_casted_stat("ep_bg_remaining_items", epstats.numRemainingBgItems,
                     add_stat, cookie);
     add_casted_stat("ep_bg_remaining_jobs", epstats.numRemainingBgJobs,
@@ -2694,6 +2982,44 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(
                     add_stat, cookie);
     add_casted_stat("ep_num_expiry_pager_runs", epstats.expiryPagerRuns,
                     add_stat, cookie);
+    add_casted_stat("ep_pager_items_visited",
+                    epstats.pagerItemsVisited,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_pager_items_evicted",
+                    epstats.pagerItemsEvicted,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_num_proactive_evictions",
+                    epstats.numProactiveEvictions,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_evicted_refetched",
+                    epstats.evictedRefetched,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_spill_cache_writes",
+                    epstats.spillCacheWrites,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_spill_cache_bytes_written",
+                    epstats.spillCacheBytesWritten,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_spill_cache_hits",
+                    epstats.spillCacheHits,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_spill_cache_misses",
+                    epstats.spillCacheMisses,
+                    add_stat,
+                    cookie);
+    auto* ghosts = kvBucket->getEvictionGhostList();
+    add_casted_stat("ep_eviction_recency_target",
+                    ghosts ? ghosts->getRecencyTarget()
+                           : EvictionGhostList::initialRecencyTarget,
+                    add_stat,
+                    cookie);
     add_casted_stat("ep_num_freq_decayer_runs",
                     epstats.freqDecayerRuns,
                     add_stat,
@@ -2701,6 +3027,10 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(
     add_casted_stat("ep_items_expelled_from_checkpoints",
                     epstats.itemsExpelledFromCheckpoints,
                     add_stat, cookie);
+    add_casted_stat("ep_checkpoint_compressed_bytes_saved",
+                    epstats.checkpointCompressedBytesSaved,
+                    add_stat,
+                    cookie);
     add_casted_stat("ep_items_rm_from_checkpoints",
                     epstats.itemsRemovedFromCheckpoints,
                     add_stat, cookie);
@@ -2710,6 +3040,18 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(
                     add_stat, cookie);
     add_casted_stat("ep_num_not_my_vbuckets", epstats.numNotMyVBuckets,
                     add_stat, cookie);
+    add_casted_stat("ep_num_ops_append_prepend_in_place",
+                    epstats.numOpsAppendPrependInPlace,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_num_ops_arithmetic_in_place",
+                    epstats.numOpsArithmeticInPlace,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_num_ops_touch_coalesced",
+                    epstats.numOpsTouchCoalesced,
+                    add_stat,
+                    cookie);
 
     add_casted_stat("ep_pending_ops", epstats.pendingOps, add_stat, cookie);
     add_casted_stat("ep_pending_ops_total", epstats.pendingOpsTotal,
@@ -2722,6 +3064,22 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(
 
     add_casted_stat("ep_pending_compactions", epstats.pendingCompactions,
                     add_stat, cookie);
+    add_casted_stat("ep_compaction_throttled_time",
+                    epstats.compactionThrottledTime,
+                    add_stat, cookie);
+    add_casted_stat("ep_compaction_expiry_time",
+                    epstats.compactionExpiryTime,
+                    add_stat, cookie);
+    add_casted_stat("ep_replication_throttle_ack_rate",
+                    getReplicationThrottle().getAckRate(),
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_replication_throttle_deferred_acks",
+                    epstats.replicationThrottleDeferredAcks,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_bfilter_rebuilds", epstats.bfilterRebuilds,
+                    add_stat, cookie);
     add_casted_stat("ep_rollback_count", epstats.rollbackCount,
                     add_stat, cookie);
 
@@ -2775,6 +3133,10 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(
                     add_stat, cookie);
     add_casted_stat("ep_access_scanner_num_items", epstats.alogNumItems,
                     add_stat, cookie);
+    add_casted_stat("ep_access_scanner_num_vbs_reused",
+                    epstats.alogNumVbsReused,
+                    add_stat,
+                    cookie);
 
     if (kvBucket->isAccessScannerEnabled() && epstats.alogTime.load() != 0)
     {
@@ -2864,6 +3226,26 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(
                     epstats.defragStoredValueNumMoved,
                     add_stat,
                     cookie);
+    add_casted_stat("ep_defragmenter_bytes_moved",
+                    epstats.defragBytesMoved,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_defragmenter_num_skipped",
+                    epstats.defragNumSkipped,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_defragmenter_bytes_reclaimed",
+                    epstats.defragBytesReclaimed,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_defragmenter_fragmentation",
+                    epstats.defragFragmentation,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_defragmenter_intensity",
+                    epstats.defragIntensity,
+                    add_stat,
+                    cookie);
 
     add_casted_stat("ep_item_compressor_num_visited",
                     epstats.compressorNumVisited,
@@ -2873,6 +3255,14 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(
                     epstats.compressorNumCompressed,
                     add_stat,
                     cookie);
+    add_casted_stat("ep_item_compressor_num_skipped_hot",
+                    epstats.compressorNumSkippedHot,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_item_compressor_num_skipped_incompressible",
+                    epstats.compressorNumSkippedIncompressible,
+                    add_stat,
+                    cookie);
 
     add_casted_stat("ep_cursor_dropping_lower_threshold",
                     epstats.cursorDroppingLThreshold, add_stat, cookie);
@@ -3048,6 +3438,65 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEngineStats(
     return ENGINE_SUCCESS;
 }
 
+void EventuallyPersistentEngine::doMetrics(cb::metrics::Collector& collector) {
+    collector.addGauge("mem_used_bytes",
+                       "The memory used by the bucket",
+                       {},
+                       stats.getEstimatedTotalMemoryUsed());
+    collector.addGauge("ep_max_size_bytes",
+                       "The bucket's memory quota",
+                       {},
+                       stats.getMaxDataSize());
+    collector.addGauge("ep_mem_high_wat_bytes",
+                       "The memory used above which items are evicted",
+                       {},
+                       stats.mem_high_wat.load());
+    collector.addGauge("ep_mem_low_wat_bytes",
+                       "The memory used the item pager evicts down to",
+                       {},
+                       stats.mem_low_wat.load());
+    collector.addGauge("ep_diskqueue_items",
+                       "The number of items waiting to be written to disk",
+                       {},
+                       stats.diskQueueSize.load());
+    collector.addCounter("ep_total_enqueued",
+                         "The number of items queued for storage",
+                         {},
+                         stats.totalEnqueued.load());
+    collector.addCounter("ep_bg_fetched",
+                         "The number of items fetched from disk",
+                         {},
+                         stats.bg_fetched.load());
+    collector.addCounter("ep_oom_errors",
+                         "The number of requests rejected as out of memory",
+                         {},
+                         stats.oom_errors.load());
+    collector.addCounter("ep_tmp_oom_errors",
+                         "The number of requests rejected as temporarily "
+                         "out of memory",
+                         {},
+                         stats.tmp_oom_errors.load());
+
+    collector.addHistogram("bg_load_microseconds",
+                           "The time taken to fetch items from disk",
+                           {},
+                           stats.bgLoadHisto.getMetricsData());
+    collector.addHistogram("get_cmd_microseconds",
+                           "The time taken by the engine to get documents",
+                           {},
+                           stats.getCmdHisto.getMetricsData());
+    collector.addHistogram("store_cmd_microseconds",
+                           "The time taken by the engine to store documents",
+                           {},
+                           stats.storeCmdHisto.getMetricsData());
+
+    kvBucket->getAggregatedVBucketMetrics(collector);
+
+    if (collector.getCardinality() == cb::metrics::Cardinality::High) {
+        Collections::Manager::doCollectionMetrics(*kvBucket, collector);
+    }
+}
+
 ENGINE_ERROR_CODE EventuallyPersistentEngine::doMemoryStats(
         const void* cookie, const AddStatFn& add_stat) {
     add_casted_stat(
@@ -3097,6 +3546,14 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doMemoryStats(
             "ep_storedval_num", stats.getNumStoredVal(), add_stat, cookie);
     add_casted_stat("ep_item_num", stats.getNumItem(), add_stat, cookie);
 
+    for (size_t ii = 0; ii < size_t(MemoryDomain::Count); ++ii) {
+        const auto domain = MemoryDomain(ii);
+        add_casted_stat(("ep_mem_domain_" + to_string(domain)).c_str(),
+                        stats.getMemoryDomainUsed(domain),
+                        add_stat,
+                        cookie);
+    }
+
     std::map<std::string, size_t> alloc_stats;
     MemoryTracker::getInstance(*getServerApiFunc()->alloc_hooks)->
         getAllocatorStats(alloc_stats);
@@ -3694,6 +4151,18 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doDcpStats(
                     dcpConnMap_->getNumActiveSnoozingBackfills(), add_stat, cookie);
     add_casted_stat("ep_dcp_max_running_backfills",
                     dcpConnMap_->getMaxActiveSnoozingBackfills(), add_stat, cookie);
+    add_casted_stat("ep_dcp_transformed_item_cache_hits",
+                    stats.dcpTransformedItemCacheHits,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_dcp_transformed_item_cache_misses",
+                    stats.dcpTransformedItemCacheMisses,
+                    add_stat,
+                    cookie);
+    add_casted_stat("ep_dcp_compression_num_skipped",
+                    stats.dcpCompressionNumSkipped,
+                    add_stat,
+                    cookie);
 
     dcpConnMap_->addStats(add_stat, cookie);
     return ENGINE_SUCCESS;
@@ -3727,6 +4196,15 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doEvictionStats(
                     stats.replicaFrequencyValuesSnapshotHisto,
                     add_stat,
                     cookie);
+    /**
+     * How long (in seconds) after being evicted items were BG fetched back;
+     * lots of short intervals mean the pager is evicting items which are
+     * still in use.
+     */
+    add_casted_stat("ep_eviction_refetch_interval",
+                    stats.evictionRefetchIntervalHisto,
+                    add_stat,
+                    cookie);
     return ENGINE_SUCCESS;
 }
 
@@ -3751,7 +4229,7 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doKeyStats(
     } else if (validate) {
         rv = kvBucket->statsVKey(key, vbid, cookie);
         if (rv == ENGINE_NOT_MY_VBUCKET || rv == ENGINE_KEY_ENOENT) {
-            if (isDegradedMode()) {
+            if (isDegradedMode(vbid)) {
                 return ENGINE_TMPFAIL;
             }
         }
@@ -3848,6 +4326,15 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doTimingStats(
     add_casted_stat("del_vb_cmd", stats.delVbucketCmdHisto, add_stat, cookie);
     add_casted_stat("chk_persistence_cmd", stats.chkPersistenceHisto,
                     add_stat, cookie);
+    // DCP takeover phases
+    add_casted_stat("dcp_takeover_send",
+                    stats.dcpTakeoverSendHisto,
+                    add_stat,
+                    cookie);
+    add_casted_stat("dcp_takeover_wait",
+                    stats.dcpTakeoverWaitHisto,
+                    add_stat,
+                    cookie);
     // Misc
     add_casted_stat("notify_io", stats.notifyIOHisto, add_stat, cookie);
     add_casted_stat("batch_read", stats.getMultiHisto, add_stat, cookie);
@@ -3918,6 +4405,13 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doTasksStats(
     return ENGINE_SUCCESS;
 }
 
+ENGINE_ERROR_CODE EventuallyPersistentEngine::doTaskTypeStats(
+        const void* cookie, const AddStatFn& add_stat) {
+    ExecutorPool::get()->doTaskTypeStat(
+            ObjectRegistry::getCurrentEngine(), cookie, add_stat);
+    return ENGINE_SUCCESS;
+}
+
 ENGINE_ERROR_CODE EventuallyPersistentEngine::doWorkloadStats(
         const void* cookie, const AddStatFn& add_stat) {
     try {
@@ -3969,6 +4463,16 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::doWorkloadStats(
                          "ep_workload:num_sleepers");
         add_casted_stat(statname, numSleepers, add_stat, cookie);
 
+        checked_snprintf(statname, sizeof(statname),
+                         "ep_workload:num_stolen_tasks");
+        add_casted_stat(
+                statname, expool->getNumStolenTasks(), add_stat, cookie);
+
+        checked_snprintf(statname, sizeof(statname),
+                         "ep_workload:num_idle_sleeps");
+        add_casted_stat(
+                statname, expool->getNumIdleSleeps(), add_stat, cookie);
+
         expool->doTaskQStat(ObjectRegistry::getCurrentEngine(),
                             cookie, add_stat);
 
@@ -4200,10 +4704,15 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::getStats(
         rv = doDispatcherStats(cookie, add_stat);
     } else if (statKey == "tasks") {
         rv = doTasksStats(cookie, add_stat);
+    } else if (statKey == "task_types") {
+        rv = doTaskTypeStats(cookie, add_stat);
     } else if (statKey == "scheduler") {
         rv = doSchedulerStats(cookie, add_stat);
     } else if (statKey == "runtimes") {
         rv = doRunTimeStats(cookie, add_stat);
+    } else if (statKey == "lockprofile") {
+        LockProfiler::addStats(add_stat, cookie);
+        rv = ENGINE_SUCCESS;
     } else if (statKey == "memory") {
         rv = doMemoryStats(cookie, add_stat);
     } else if (statKey == "uuid") {
@@ -4471,7 +4980,8 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::observe_seqno(
         return ENGINE_NOT_MY_VBUCKET;
     }
 
-    folly::SharedMutex::ReadHolder rlh(vb->getStateLock());
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, vb->getStateLock());
     if (vb->getState() == vbucket_state_dead) {
         return ENGINE_NOT_MY_VBUCKET;
     }
@@ -4759,13 +5269,39 @@ cb::EngineErrorMetadataPair EventuallyPersistentEngine::getMetaInner(
     if (ret == ENGINE_SUCCESS) {
         metadata = to_item_info(itemMeta, datatype, deleted);
     } else if (ret == ENGINE_KEY_ENOENT || ret == ENGINE_NOT_MY_VBUCKET) {
-        if (isDegradedMode()) {
+        if (isDegradedMode(vbucket)) {
             ret = ENGINE_TMPFAIL;
         }
     }
 
     return std::make_pair(cb::engine_errc(ret), metadata);
 }
+
+std::vector<cb::EngineErrorMetadataPair>
+EventuallyPersistentEngine::getMetaMultiInner(const void* cookie,
+                                              const std::vector<DocKey>& keys,
+                                              Vbid vbucket) {
+    const auto results = kvBucket->getMetaDataMulti(keys, vbucket, cookie);
+
+    std::vector<cb::EngineErrorMetadataPair> ret;
+    ret.reserve(results.size());
+    for (const auto& result : results) {
+        auto status = result.status;
+        item_info metadata;
+        if (status == ENGINE_SUCCESS) {
+            metadata = to_item_info(
+                    result.metadata, result.datatype, result.deleted);
+        } else if (status == ENGINE_KEY_ENOENT ||
+                   status == ENGINE_NOT_MY_VBUCKET) {
+            if (isDegradedMode(vbucket)) {
+                status = ENGINE_TMPFAIL;
+            }
+        }
+        ret.emplace_back(cb::engine_errc(status), metadata);
+    }
+    return ret;
+}
+
 bool EventuallyPersistentEngine::decodeSetWithMetaOptions(
         cb::const_byte_buffer extras,
         GenerateCas& generateCas,
@@ -4887,7 +5423,7 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::setWithMeta(
         const void* cookie,
         const cb::mcbp::Request& request,
         const AddResponseFn& response) {
-    if (isDegradedMode()) {
+    if (isDegradedMode(request.getVBucket())) {
         return ENGINE_TMPFAIL;
     }
 
@@ -5094,7 +5630,7 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::deleteWithMeta(
         const void* cookie,
         const cb::mcbp::Request& request,
         const AddResponseFn& response) {
-    if (isDegradedMode()) {
+    if (isDegradedMode(request.getVBucket())) {
         return ENGINE_TMPFAIL;
     }
 
@@ -5234,7 +5770,10 @@ EventuallyPersistentEngine::handleTrafficControlCmd(
         const AddResponseFn& response) {
     switch (request.getClientOpcode()) {
     case cb::mcbp::ClientOpcode::EnableTraffic:
-        if (kvBucket->isWarmingUp()) {
+        // With early vBucket traffic each vBucket serves traffic once warmup
+        // has loaded it, so traffic can be enabled before then
+        if (kvBucket->isWarmingUp() &&
+            !configuration.isWarmupEarlyVbucketTraffic()) {
             // engine is still warming up, do not turn on data traffic yet
             setErrorContext(cookie, "Persistent engine is still warming up!");
             return ENGINE_TMPFAIL;
@@ -5295,6 +5834,10 @@ bool EventuallyPersistentEngine::isDegradedMode() const {
     return kvBucket->isWarmingUp() || !trafficEnabled.load();
 }
 
+bool EventuallyPersistentEngine::isDegradedMode(Vbid vbid) const {
+    return kvBucket->isVBucketWarmingUp(vbid) || !trafficEnabled.load();
+}
+
 ENGINE_ERROR_CODE
 EventuallyPersistentEngine::doDcpVbTakeoverStats(const void* cookie,
                                                  const AddStatFn& add_stat,
@@ -5366,7 +5909,7 @@ EventuallyPersistentEngine::returnMeta(const void* cookie,
     auto* payload =
             reinterpret_cast<const ReturnMetaPayload*>(req.getExtdata().data());
 
-    if (isDegradedMode()) {
+    if (isDegradedMode(req.getVBucket())) {
         return ENGINE_TMPFAIL;
     }
 
@@ -5622,7 +6165,8 @@ EventuallyPersistentEngine::getAllKeys(const void* cookie,
         return ENGINE_NOT_MY_VBUCKET;
     }
 
-    folly::SharedMutex::ReadHolder rlh(vb->getStateLock());
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, vb->getStateLock());
     if (vb->getState() != vbucket_state_active) {
         return ENGINE_NOT_MY_VBUCKET;
     }
@@ -5647,6 +6191,364 @@ EventuallyPersistentEngine::getAllKeys(const void* cookie,
     return ENGINE_EWOULDBLOCK;
 }
 
+/*
+ * Builds the response of a RANGE_SCAN page from the items a scanRange()
+ * returns, stopping it once the page is full.
+ */
+class RangeScanPage {
+public:
+    RangeScanPage(uint32_t maxItems,
+                  uint32_t maxBytes,
+                  bool keysOnly,
+                  bool collectionsSupported,
+                  protocol_binary_datatype_t supportedDatatypes)
+        : maxItems(maxItems),
+          maxBytes(maxBytes),
+          keysOnly(keysOnly),
+          collectionsSupported(collectionsSupported),
+          supportedDatatypes(supportedDatatypes) {
+    }
+
+    /// @return false once the page is full (and the scan should stop).
+    bool add(GetValue&& gv) {
+        DocKey key = gv.item->getKey();
+        if (key.isPrivate() || gv.item->isPending()) {
+            // Skip system-event and durability-prepared keys
+            return true;
+        }
+        if (!collectionsSupported) {
+            if (!key.getCollectionID().isDefaultCollection()) {
+                return true;
+            }
+            key = key.makeDocKeyWithoutCollectionID();
+        }
+
+        if (numItems == maxItems ||
+            (maxBytes != 0 && buffer.size() >= maxBytes)) {
+            // Full; this is where the next page starts.
+            nextKey.assign(key.data(), key.data() + key.size());
+            return false;
+        }
+
+        appendUint16(key.size());
+        buffer.insert(buffer.end(), key.data(), key.data() + key.size());
+        if (!keysOnly) {
+            appendValue(*gv.item);
+        }
+        ++numItems;
+        return true;
+    }
+
+    bool isKeysOnly() const {
+        return keysOnly;
+    }
+
+    cb::const_char_buffer getValue() const {
+        return {buffer.data(), buffer.size()};
+    }
+
+    /// @return the continuation token; empty if the scan completed.
+    cb::const_char_buffer getNextKey() const {
+        return {reinterpret_cast<const char*>(nextKey.data()), nextKey.size()};
+    }
+
+private:
+    void appendUint16(uint16_t value) {
+        value = htons(value);
+        const auto* ptr = reinterpret_cast<const char*>(&value);
+        buffer.insert(buffer.end(), ptr, ptr + sizeof(value));
+    }
+
+    void appendUint32(uint32_t value) {
+        value = htonl(value);
+        const auto* ptr = reinterpret_cast<const char*>(&value);
+        buffer.insert(buffer.end(), ptr, ptr + sizeof(value));
+    }
+
+    void appendValue(Item& item) {
+        if (mcbp::datatype::is_snappy(item.getDataType()) &&
+            !(supportedDatatypes & PROTOCOL_BINARY_DATATYPE_SNAPPY)) {
+            item.decompressValue();
+        }
+        auto datatype = item.getDataType();
+        cb::const_char_buffer value{item.getData(), item.getNBytes()};
+        if (mcbp::datatype::is_xattr(datatype) &&
+            !(supportedDatatypes & PROTOCOL_BINARY_DATATYPE_XATTR)) {
+            value = cb::xattr::get_body(value);
+            datatype &= ~PROTOCOL_BINARY_DATATYPE_XATTR;
+        }
+        if (!(supportedDatatypes & PROTOCOL_BINARY_DATATYPE_JSON)) {
+            datatype &= ~PROTOCOL_BINARY_DATATYPE_JSON;
+        }
+
+        // Flags are kept in network byte order.
+        const uint32_t flags = item.getFlags();
+        const auto* flagsPtr = reinterpret_cast<const char*>(&flags);
+        buffer.insert(buffer.end(), flagsPtr, flagsPtr + sizeof(flags));
+        buffer.push_back(char(datatype));
+        appendUint32(value.size());
+        buffer.insert(buffer.end(), value.begin(), value.end());
+    }
+
+    const uint32_t maxItems;
+    const uint32_t maxBytes;
+    const bool keysOnly;
+    const bool collectionsSupported;
+    const protocol_binary_datatype_t supportedDatatypes;
+
+    std::vector<char> buffer;
+    uint32_t numItems = 0;
+    std::vector<uint8_t> nextKey;
+};
+
+/*
+ * Task that reads a page of a range scan and returns it as the response,
+ * runs in background.
+ */
+class RangeScanTask : public GlobalTask {
+public:
+    RangeScanTask(EventuallyPersistentEngine* e,
+                  const void* c,
+                  const AddResponseFn& resp,
+                  DiskDocKey startKey,
+                  DiskDocKey endKey,
+                  Vbid vbucket,
+                  RangeScanPage page)
+        : GlobalTask(e, TaskId::RangeScanTask, 0, false),
+          engine(e),
+          cookie(c),
+          description("Running a range scan on " + vbucket.to_string()),
+          response(resp),
+          startKey(std::move(startKey)),
+          endKey(std::move(endKey)),
+          vbid(vbucket),
+          page(std::move(page)) {
+    }
+
+    std::string getDescription() {
+        return description;
+    }
+
+    std::chrono::microseconds maxExpectedDuration() {
+        // Duration will be a function of the size of the page; however for
+        // simplicity just return a fixed "reasonable" duration.
+        return std::chrono::milliseconds(100);
+    }
+
+    bool run() {
+        TRACE_EVENT0("ep-engine/task", "RangeScanTask");
+        const auto delay = engine->getRangeScanDelay();
+        if (delay.count() > 0) {
+            // Over range_scan_max_bytes_per_sec; wait without holding a
+            // reader thread.
+            snooze(std::chrono::duration<double>(delay).count());
+            return true;
+        }
+
+        ENGINE_ERROR_CODE err;
+        try {
+            engine->getKVBucket()->getROUnderlying(vbid)->scanRange(
+                    vbid,
+                    startKey,
+                    endKey,
+                    page.isKeysOnly() ? ValueFilter::KEYS_ONLY
+                                      : ValueFilter::VALUES_COMPRESSED,
+                    [this](GetValue&& gv) { return page.add(std::move(gv)); });
+            const auto value = page.getValue();
+            engine->chargeRangeScanBytes(value.size());
+            const auto nextKey = page.getNextKey();
+            err = sendResponse(response,
+                               nextKey.data(),
+                               nextKey.size(),
+                               NULL,
+                               0,
+                               value.data(),
+                               value.size(),
+                               PROTOCOL_BINARY_RAW_BYTES,
+                               cb::mcbp::Status::Success,
+                               0,
+                               cookie);
+        } catch (const std::runtime_error& e) {
+            EP_LOG_WARN("RangeScanTask: scan of {} failed: {}", vbid, e.what());
+            err = ENGINE_FAILED;
+        }
+        engine->addLookupAllKeys(cookie, err);
+        engine->notifyIOComplete(cookie, err);
+        return false;
+    }
+
+private:
+    EventuallyPersistentEngine* engine;
+    const void* cookie;
+    const std::string description;
+    AddResponseFn response;
+    DiskDocKey startKey;
+    DiskDocKey endKey;
+    Vbid vbid;
+    RangeScanPage page;
+};
+
+ENGINE_ERROR_CODE
+EventuallyPersistentEngine::rangeScan(const void* cookie,
+                                      const cb::mcbp::Request& request,
+                                      const AddResponseFn& response) {
+    if (!getKVBucket()->isGetAllKeysSupported() ||
+        !getKVBucket()->getStorageProperties().hasRangeScan()) {
+        return ENGINE_ENOTSUP;
+    }
+
+    {
+        LockHolder lh(lookupMutex);
+        auto it = allKeysLookups.find(cookie);
+        if (it != allKeysLookups.end()) {
+            ENGINE_ERROR_CODE err = it->second;
+            allKeysLookups.erase(it);
+            return err;
+        }
+    }
+
+    VBucketPtr vb = getVBucket(request.getVBucket());
+    if (!vb) {
+        return ENGINE_NOT_MY_VBUCKET;
+    }
+
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, vb->getStateLock());
+    if (vb->getState() != vbucket_state_active) {
+        return ENGINE_NOT_MY_VBUCKET;
+    }
+
+    // key: start key, value: (logical) end key, ext: page size and flags
+    using cb::mcbp::request::RangeScanPayload;
+    const auto* payload = reinterpret_cast<const RangeScanPayload*>(
+            request.getExtdata().data());
+
+    const DocKey startKey = makeDocKey(cookie, request.getKey());
+    const auto cid = startKey.getCollectionID();
+    DiskDocKey endKey = DiskDocKey::collectionRange(cid).second;
+    const auto end = request.getValue();
+    if (!end.empty()) {
+        endKey = DiskDocKey{StoredDocKey{
+                std::string{reinterpret_cast<const char*>(end.data()),
+                            end.size()},
+                cid}};
+    }
+
+    protocol_binary_datatype_t supportedDatatypes = PROTOCOL_BINARY_RAW_BYTES;
+    for (auto datatype : {PROTOCOL_BINARY_DATATYPE_JSON,
+                          PROTOCOL_BINARY_DATATYPE_SNAPPY,
+                          PROTOCOL_BINARY_DATATYPE_XATTR}) {
+        if (isDatatypeSupported(cookie, datatype)) {
+            supportedDatatypes |= datatype;
+        }
+    }
+
+    ExTask task = std::make_shared<RangeScanTask>(
+            this,
+            cookie,
+            response,
+            DiskDocKey{startKey},
+            std::move(endKey),
+            request.getVBucket(),
+            RangeScanPage{payload->getMaxItems(),
+                          payload->getMaxBytes(),
+                          payload->isKeysOnly(),
+                          isCollectionsSupported(cookie),
+                          supportedDatatypes});
+    ExecutorPool::get()->schedule(task);
+    return ENGINE_EWOULDBLOCK;
+}
+
+std::chrono::steady_clock::duration
+EventuallyPersistentEngine::getRangeScanDelay() {
+    if (configuration.getRangeScanMaxBytesPerSec() == 0) {
+        return {};
+    }
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lh(rangeScanMutex);
+    return std::max(rangeScanNextFree - now,
+                    std::chrono::steady_clock::duration::zero());
+}
+
+void EventuallyPersistentEngine::chargeRangeScanBytes(size_t bytes) {
+    const size_t rate = configuration.getRangeScanMaxBytesPerSec();
+    if (rate == 0) {
+        return;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lh(rangeScanMutex);
+    // No credit is accumulated while range scans are idle.
+    rangeScanNextFree =
+            std::max(rangeScanNextFree, now) +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(double(bytes) / rate));
+}
+
+ENGINE_ERROR_CODE
+EventuallyPersistentEngine::bulkStore(const void* cookie,
+                                      const cb::mcbp::Request& request,
+                                      const AddResponseFn& response) {
+    if (isDegradedMode()) {
+        return ENGINE_TMPFAIL;
+    }
+
+    const auto value = request.getValue();
+    if (!hasMemoryForItemAllocation(value.size())) {
+        return memoryCondition();
+    }
+
+    // The validator has checked that the documents are well formed
+    std::vector<std::unique_ptr<Item>> items;
+    cb::mcbp::request::BulkStoreParser parser(value);
+    cb::mcbp::request::BulkStoreDocument doc;
+    while (parser.next(doc)) {
+        if (doc.value.size() > maxItemSize) {
+            return ENGINE_E2BIG;
+        }
+        const time_t expiry =
+                (doc.expiry == 0) ? 0 : ep_abs_time(ep_reltime(doc.expiry));
+        items.push_back(std::make_unique<Item>(makeDocKey(cookie, doc.key),
+                                               doc.flags,
+                                               expiry,
+                                               doc.value.data(),
+                                               doc.value.size(),
+                                               doc.datatype,
+                                               0 /*cas*/,
+                                               -1 /*seq*/,
+                                               request.getVBucket()));
+        stats.itemAllocSizeHisto.addValue(doc.value.size());
+    }
+
+    size_t stored = 0;
+    auto status =
+            kvBucket->bulkSet(request.getVBucket(), items, cookie, stored);
+    if (stored > 0) {
+        stats.numOpsStore += stored;
+        kvBucket->checkAndMaybeFreeMemory();
+    }
+    if (status == ENGINE_ENOMEM) {
+        status = memoryCondition();
+    }
+    if (stored == 0 && status != ENGINE_SUCCESS) {
+        // Nothing was stored (or a pending vbucket will notify the cookie),
+        // so let the core send the error (and any cluster map)
+        return status;
+    }
+
+    const uint32_t count = htonl(gsl::narrow<uint32_t>(stored));
+    return sendResponse(response,
+                        NULL,
+                        0,
+                        NULL,
+                        0,
+                        &count,
+                        sizeof(count),
+                        PROTOCOL_BINARY_RAW_BYTES,
+                        serverApi->cookie->engine_error2mcbp(cookie, status),
+                        0,
+                        cookie);
+}
+
 CONN_PRIORITY EventuallyPersistentEngine::getDCPPriority(const void* cookie) {
     NonBucketAllocationGuard guard;
     auto priority = serverApi->cookie->get_priority(cookie);
@@ -5694,6 +6596,46 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::getRandomKey(
     return ret;
 }
 
+ENGINE_ERROR_CODE EventuallyPersistentEngine::getRandomKeys(
+        const void* cookie,
+        const cb::mcbp::Request& request,
+        const AddResponseFn& response) {
+    using cb::mcbp::request::GetRandomKeysPayload;
+    const auto* payload = reinterpret_cast<const GetRandomKeysPayload*>(
+            request.getExtdata().data());
+    const bool collectionsSupported = isCollectionsSupported(cookie);
+
+    std::vector<char> buffer;
+    for (const auto& key : kvBucket->getRandomKeys(payload->getCount())) {
+        DocKey outKey = key;
+        if (!collectionsSupported) {
+            if (!outKey.getCollectionID().isDefaultCollection()) {
+                // Only default collection keys can be sent back if
+                // collectionsSupported is false
+                continue;
+            }
+            outKey = outKey.makeDocKeyWithoutCollectionID();
+        }
+        const uint16_t outlen = htons(gsl::narrow<uint16_t>(outKey.size()));
+        const auto* outlenPtr = reinterpret_cast<const char*>(&outlen);
+        buffer.insert(buffer.end(), outlenPtr, outlenPtr + sizeof(uint16_t));
+        buffer.insert(
+                buffer.end(), outKey.data(), outKey.data() + outKey.size());
+    }
+
+    return sendResponse(response,
+                        NULL,
+                        0,
+                        NULL,
+                        0,
+                        buffer.data(),
+                        buffer.size(),
+                        PROTOCOL_BINARY_RAW_BYTES,
+                        cb::mcbp::Status::Success,
+                        0,
+                        cookie);
+}
+
 ENGINE_ERROR_CODE EventuallyPersistentEngine::dcpOpen(
         const void* cookie,
         uint32_t opaque,
@@ -6083,6 +7025,7 @@ ENGINE_ERROR_CODE EventuallyPersistentEngine::setVBucketState(
 EventuallyPersistentEngine::~EventuallyPersistentEngine() {
     if (kvBucket) {
         kvBucket->deinitialize();
+        kvBucket->freeVBuckets(configuration.getVbucketTeardownThreads());
     }
     EP_LOG_INFO("~EPEngine: Completed deinitialize.");
     delete workload;
@@ -141,6 +141,11 @@ public:
                                          const DocKey& key,
                                          Vbid vbucket) override;
 
+    std::vector<cb::EngineErrorMetadataPair> get_meta_multi(
+            gsl::not_null<const void*> cookie,
+            const std::vector<DocKey>& keys,
+            Vbid vbucket) override;
+
     cb::EngineErrorItemPair get_locked(gsl::not_null<const void*> cookie,
                                        const DocKey& key,
                                        Vbid vbucket,
@@ -175,6 +180,26 @@ public:
             const boost::optional<cb::durability::Requirements>& durability,
             DocumentState document_state) override;
 
+    cb::EngineErrorArithmeticResult arithmetic(
+            gsl::not_null<const void*> cookie,
+            const DocKey& key,
+            Vbid vbucket,
+            bool increment,
+            uint64_t delta,
+            uint64_t cas,
+            const boost::optional<cb::durability::Requirements>& durability)
+            override;
+
+    ENGINE_ERROR_CODE append_prepend(
+            gsl::not_null<const void*> cookie,
+            const DocKey& key,
+            Vbid vbucket,
+            bool append,
+            cb::const_char_buffer value,
+            uint64_t& cas,
+            const boost::optional<cb::durability::Requirements>& durability,
+            mutation_descr_t& mut_info) override;
+
     // Need to explicilty import EngineIface::flush to avoid warning about
     // DCPIface::flush hiding it.
     using EngineIface::flush;
@@ -185,6 +210,9 @@ public:
 
     void reset_stats(gsl::not_null<const void*> cookie) override;
 
+    ENGINE_ERROR_CODE get_metrics(gsl::not_null<const void*> cookie,
+                                  cb::metrics::Collector& collector) override;
+
     ENGINE_ERROR_CODE unknown_command(const void* cookie,
                                       const cb::mcbp::Request& request,
                                       const AddResponseFn& response) override;
@@ -492,6 +520,21 @@ public:
                                         ENGINE_STORE_OPERATION operation,
                                         const cb::StoreIfPredicate& predicate);
 
+    cb::EngineErrorArithmeticResult arithmeticInner(const void* cookie,
+                                                    const DocKey& key,
+                                                    Vbid vbucket,
+                                                    bool increment,
+                                                    uint64_t delta,
+                                                    uint64_t cas);
+
+    ENGINE_ERROR_CODE appendPrependInner(const void* cookie,
+                                         const DocKey& key,
+                                         Vbid vbucket,
+                                         bool append,
+                                         cb::const_char_buffer value,
+                                         uint64_t& cas,
+                                         mutation_descr_t& mut_info);
+
     ENGINE_ERROR_CODE dcpOpen(const void* cookie,
                               uint32_t opaque,
                               uint32_t seqno,
@@ -508,6 +551,9 @@ public:
                                              const DocKey& key,
                                              Vbid vbucket);
 
+    std::vector<cb::EngineErrorMetadataPair> getMetaMultiInner(
+            const void* cookie, const std::vector<DocKey>& keys, Vbid vbucket);
+
     ENGINE_ERROR_CODE setWithMeta(const void* cookie,
                                   const cb::mcbp::Request& request,
                                   const AddResponseFn& response);
@@ -524,6 +570,24 @@ public:
                                  const cb::mcbp::Request& request,
                                  const AddResponseFn& response);
 
+    ENGINE_ERROR_CODE rangeScan(const void* cookie,
+                                const cb::mcbp::Request& request,
+                                const AddResponseFn& response);
+
+    /**
+     * @return how long a RANGE_SCAN must wait before reading its next page,
+     *         to keep all range scans within range_scan_max_bytes_per_sec
+     *         (zero if it may read now).
+     */
+    std::chrono::steady_clock::duration getRangeScanDelay();
+
+    /// Account for a RANGE_SCAN page of the given size having been read.
+    void chargeRangeScanBytes(size_t bytes);
+
+    ENGINE_ERROR_CODE bulkStore(const void* cookie,
+                                const cb::mcbp::Request& request,
+                                const AddResponseFn& response);
+
     CONN_PRIORITY getDCPPriority(const void* cookie);
 
     void setDCPPriority(const void* cookie, CONN_PRIORITY priority);
@@ -696,6 +760,13 @@ public:
 
     bool isDegradedMode() const;
 
+    /**
+     * @return true if the given vBucket can't serve front-end traffic yet:
+     *         data traffic isn't enabled, or warmup hasn't loaded the
+     *         vBucket (see warmup_early_vbucket_traffic).
+     */
+    bool isDegradedMode(Vbid vbid) const;
+
     WorkLoadPolicy& getWorkLoadPolicy() {
         return *workload;
     }
@@ -711,6 +782,10 @@ public:
     ENGINE_ERROR_CODE getRandomKey(const void* cookie,
                                    const AddResponseFn& response);
 
+    ENGINE_ERROR_CODE getRandomKeys(const void* cookie,
+                                    const cb::mcbp::Request& request,
+                                    const AddResponseFn& response);
+
     void setCompressionMode(const std::string& compressModeStr);
 
     void setMinCompressionRatio(float minCompressRatio) {
@@ -841,6 +916,7 @@ protected:
 
     ENGINE_ERROR_CODE doEngineStats(const void* cookie,
                                     const AddStatFn& add_stat);
+    void doMetrics(cb::metrics::Collector& collector);
     ENGINE_ERROR_CODE doMemoryStats(const void* cookie,
                                     const AddStatFn& add_stat);
     ENGINE_ERROR_CODE doVBucketStats(const void* cookie,
@@ -885,6 +961,8 @@ protected:
                                         const AddStatFn& add_stat);
     ENGINE_ERROR_CODE doTasksStats(const void* cookie,
                                    const AddStatFn& add_stat);
+    ENGINE_ERROR_CODE doTaskTypeStats(const void* cookie,
+                                      const AddStatFn& add_stat);
     ENGINE_ERROR_CODE doKeyStats(const void* cookie,
                                  const AddStatFn& add_stat,
                                  Vbid vbid,
@@ -1114,8 +1192,14 @@ protected:
     bucket_priority_t workloadPriority;
 
     std::map<const void*, std::unique_ptr<Item>> lookups;
+    /// Results of GET_KEYS and RANGE_SCAN tasks, for when the cookie is
+    /// notified.
     std::unordered_map<const void*, ENGINE_ERROR_CODE> allKeysLookups;
     std::mutex lookupMutex;
+    std::mutex rangeScanMutex;
+    /// Earliest time the next RANGE_SCAN page may be read (guarded by
+    /// rangeScanMutex).
+    std::chrono::steady_clock::time_point rangeScanNextFree;
     GET_SERVER_API getServerApiFunc;
 
     std::unique_ptr<DcpFlowControlManager> dcpFlowControlManager_;
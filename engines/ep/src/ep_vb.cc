@@ -25,9 +25,11 @@
 #include "executorpool.h"
 #include "failover-table.h"
 #include "item.h"
+#include "item_eviction.h"
 #include "kvshard.h"
 #include "stored_value_factories.h"
 #include "tasks.h"
+#include "value_spill_cache.h"
 #include "vbucket_bgfetch_item.h"
 #include "vbucketdeletiontask.h"
 #include <folly/lang/Assume.h>
@@ -63,7 +65,11 @@ EPVBucket::EPVBucket(Vbid i,
               lastSnapEnd,
               std::move(table),
               flusherCb,
-              std::make_unique<StoredValueFactory>(st),
+              std::make_unique<StoredValueFactory>(
+                      st,
+                      config.isHtStoredValueArena(),
+                      config.isHtInlineValues(),
+                      config.isHtKeyPrefixCompression()),
               std::move(newSeqnoCb),
               syncWriteCb,
               seqnoAckCb,
@@ -94,7 +100,8 @@ ENGINE_ERROR_CODE EPVBucket::completeBGFetchForSingleItem(
     Item* fetchedValue = fetched_item.value->item.get();
     { // locking scope
         auto docKey = key.getDocKey();
-        folly::SharedMutex::ReadHolder rlh(getStateLock());
+        ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+                LockSite::VBucketState, getStateLock());
         auto cHandle = lockCollections(docKey);
         auto res = fetchValidValue(
                 WantsDeleted::Yes,
@@ -468,6 +475,14 @@ cb::mcbp::Status EPVBucket::evictKey(
 bool EPVBucket::pageOut(const Collections::VB::Manifest::ReadHandle& readHandle,
                         const HashTable::HashBucketLock& lh,
                         StoredValue*& v) {
+    if (spillCache && eviction == EvictionPolicy::Value &&
+        v->eligibleForEviction(eviction) && v->getValue()) {
+        const auto& value = *v->getValue();
+        spillCache->spill(getId(),
+                          v->getBySeqno(),
+                          v->getCas(),
+                          {value.getData(), value.valueSize()});
+    }
     return ht.unlocked_ejectItem(lh, v, eviction);
 }
 
@@ -476,6 +491,91 @@ bool EPVBucket::eligibleToPageOut(const HashTable::HashBucketLock& lh,
     return v.eligibleForEviction(eviction);
 }
 
+vb_bgfetch_queue_t EPVBucket::fetchSpilledValues(
+        vb_bgfetch_queue_t& fetches) {
+    vb_bgfetch_queue_t spilled;
+    if (!spillCache || eviction != EvictionPolicy::Value) {
+        return spilled;
+    }
+
+    for (auto it = fetches.begin(); it != fetches.end();) {
+        std::unique_ptr<Item> item;
+        if (it->second.isMetaOnly == GetMetaOnly::No &&
+            !it->first.isPrepared()) {
+            item = restoreSpilledValue(it->first.getDocKey());
+        }
+        if (!item) {
+            ++it;
+            continue;
+        }
+        auto& ctx = spilled[it->first];
+        ctx = std::move(it->second);
+        ctx.value = GetValue(std::move(item), ENGINE_SUCCESS);
+        it = fetches.erase(it);
+    }
+    return spilled;
+}
+
+std::unique_ptr<Item> EPVBucket::restoreSpilledValue(const DocKey& key) {
+    int64_t bySeqno;
+    uint64_t cas;
+    {
+        auto res = ht.findForWrite(key, WantsDeleted::No);
+        const auto* v = res.storedValue;
+        if (!v || v->isResident() || v->isTempItem() || !v->isCommitted()) {
+            return {};
+        }
+        bySeqno = v->getBySeqno();
+        cas = v->getCas();
+    }
+
+    // Read the value without the hash bucket locked, so no other key of the
+    // chain waits for the read...
+    auto value = spillCache->fetch(getId(), bySeqno, cas);
+    if (!value) {
+        return {};
+    }
+
+    // ... which means the item may have been changed (or restored) since.
+    auto res = ht.findForWrite(key, WantsDeleted::No);
+    auto* v = res.storedValue;
+    if (!v || v->isResident() || !v->isCommitted() ||
+        v->getBySeqno() != bySeqno || v->getCas() != cas) {
+        return {};
+    }
+    auto item = v->toItem(getId());
+    item->replaceValue(value.get());
+    if (!ht.unlocked_restoreValue(res.lock.getHTLock(), *item, *v)) {
+        return {};
+    }
+    return item;
+}
+
+size_t EPVBucket::evictColdItemsFromChain(const HashTable::HashBucketLock& lh,
+                                          const StoredValue& written,
+                                          size_t maxItems) {
+    size_t evicted = 0;
+    while (evicted < maxItems) {
+        // Only items colder than a newly stored one are candidates, so we
+        // never evict anything the item pager wouldn't consider first.
+        StoredValue* v = ht.unlocked_findColdestEvictable(
+                lh, eviction, ItemEviction::initialFreqCount, &written);
+        if (!v) {
+            break;
+        }
+        // Take a copy of the key; under full eviction v is freed by the eject
+        const StoredDocKey key(v->getKey());
+        if (!ht.unlocked_ejectItem(lh, v, eviction)) {
+            break;
+        }
+        if (eviction == EvictionPolicy::Full) {
+            addToFilter(key);
+        }
+        ++evicted;
+    }
+    return evicted;
+}
+
 void EPVBucket::queueBackfillItem(queued_item& qi,
                                   const GenerateBySeqno generateBySeqno) {
     if (GenerateBySeqno::Yes == generateBySeqno) {
@@ -505,6 +605,13 @@ size_t EPVBucket::queueBGFetchItem(const DocKey& key,
     // DiskDocKey with pending unconditionally false.
     DiskDocKey diskKey{key, /*pending*/ false};
     LockHolder lh(pendingBGFetchesLock);
+
+    // If the same key is already being read from disk, piggy-back on that
+    // read instead of queueing another one.
+    if (bgFetcher->coalesceFetch(getId(), diskKey, fetch)) {
+        return pendingBGFetches.size();
+    }
+
     vb_bgfetch_item_ctx_t& bgfetch_itm_ctx = pendingBGFetches[diskKey];
 
     if (bgfetch_itm_ctx.bgfetched_list.empty()) {
@@ -648,6 +755,29 @@ void EPVBucket::bgFetch(const DocKey& key,
                  uint64_t(bgfetch_size));
 }
 
+void EPVBucket::bgFetchMulti(const std::vector<DocKey>& keys,
+                             const void* cookie,
+                             EventuallyPersistentEngine& engine,
+                             bool isMeta) {
+    if (keys.empty()) {
+        return;
+    }
+    auto* bgFetcher = getShard()->getBgFetcher();
+    size_t bgfetch_size = 0;
+    for (const auto& key : keys) {
+        bgfetch_size = queueBGFetchItem(
+                key,
+                std::make_unique<VBucketBGFetchItem>(cookie, isMeta),
+                bgFetcher);
+    }
+    // Only wake the BgFetcher once all of the keys are queued, so they're
+    // read by the same KVStore::getMulti.
+    bgFetcher->notifyBGEvent(keys.size());
+    EP_LOG_DEBUG("Queued {} background fetches, now at {}",
+                 keys.size(),
+                 uint64_t(bgfetch_size));
+}
+
 /* [TBD]: Get rid of std::unique_lock<std::mutex> lock */
 ENGINE_ERROR_CODE
 EPVBucket::addTempItemAndBGFetch(HashTable::HashBucketLock& hbl,
@@ -722,12 +852,18 @@ void EPVBucket::scheduleDeferredDeletion(EventuallyPersistentEngine& engine) {
 
 MutationStatus EPVBucket::insertFromWarmup(Item& itm,
                                          bool eject,
-                                         bool keyMetaDataOnly) {
+                                         bool keyMetaDataOnly,
+                                         bool restoreOnly) {
     if (!hasMemoryForStoredValue(stats, itm, UseActiveVBMemThreshold::Yes)) {
         return MutationStatus::NoMem;
     }
 
-    return ht.insertFromWarmup(itm, eject, keyMetaDataOnly, eviction);
+    const auto status = ht.insertFromWarmup(
+            itm, eject, keyMetaDataOnly, eviction, restoreOnly);
+    if (status == MutationStatus::NotFound) {
+        updateExpiryIndex(itm);
+    }
+    return status;
 }
 
 size_t EPVBucket::estimateNewMemoryUsage(EPStats& st, const Item& item) {
@@ -743,6 +879,72 @@ size_t EPVBucket::getNumPersistedDeletes() const {
     return shard->getROUnderlying()->getNumPersistedDeletes(getId());
 }
 
+void EPVBucket::updateOnDiskPrepares(const std::vector<const Item*>& flushed) {
+    auto locked = onDiskPrepares.lock();
+    // Apply the prepares and aborts before the committed items, so the
+    // Commit of a prepare flushed in the same batch completes it.
+    for (const auto* item : flushed) {
+        if (item->isPending() || item->isAbort()) {
+            locked->update(*item);
+        }
+    }
+    if (locked->seqnos.empty()) {
+        return;
+    }
+    for (const auto* item : flushed) {
+        if (item->isCommitted()) {
+            locked->update(*item);
+        }
+    }
+}
+
+void EPVBucket::loadOnDiskPrepare(const Item& item) {
+    onDiskPrepares.lock()->update(item);
+}
+
+void EPVBucket::setOnDiskPreparesKnown(bool known) {
+    auto locked = onDiskPrepares.lock();
+    locked->known = known;
+    if (!known) {
+        locked->seqnos.clear();
+        locked->ordered.clear();
+    }
+}
+
+uint64_t EPVBucket::getOnDiskPreparesStartSeqno(
+        uint64_t persistedHighSeqno) const {
+    auto locked = onDiskPrepares.lock();
+    if (!locked->known) {
+        return 0;
+    }
+    if (locked->ordered.empty()) {
+        return persistedHighSeqno + 1;
+    }
+    return *locked->ordered.begin();
+}
+
+void EPVBucket::OnDiskPrepares::update(const Item& item) {
+    const auto seqno = item.getBySeqno();
+    auto itr = seqnos.find(item.getKey());
+    if (itr != seqnos.end()) {
+        if (itr->second > seqno) {
+            return;
+        }
+        ordered.erase(itr->second);
+    }
+
+    if (item.isPending()) {
+        if (itr == seqnos.end()) {
+            seqnos.emplace(item.getKey(), seqno);
+        } else {
+            itr->second = seqno;
+        }
+        ordered.insert(seqno);
+    } else if (itr != seqnos.end()) {
+        seqnos.erase(itr);
+    }
+}
+
 void EPVBucket::dropKey(int64_t bySeqno,
                         Collections::VB::Manifest::CachingReadHandle& cHandle) {
     // dropKey must not generate expired items as it's used for erasing a
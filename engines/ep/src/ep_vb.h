@@ -20,7 +20,13 @@
 #include "vbucket.h"
 #include "vbucket_bgfetch_item.h"
 
+#include <folly/Synchronized.h>
+
+#include <set>
+#include <unordered_map>
+
 class BgFetcher;
+class ValueSpillCache;
 
 /**
  * Eventually Peristent VBucket (EPVBucket) is a child class of VBucket.
@@ -105,6 +111,22 @@ public:
     bool eligibleToPageOut(const HashTable::HashBucketLock& lh,
                            const StoredValue& v) const override;
 
+    size_t evictColdItemsFromChain(const HashTable::HashBucketLock& lh,
+                                   const StoredValue& written,
+                                   size_t maxItems) override;
+
+    vb_bgfetch_queue_t fetchSpilledValues(
+            vb_bgfetch_queue_t& fetches) override;
+
+    /**
+     * Set the cache which the item pager writes values to as it ejects
+     * them (value eviction only), and which the BG fetcher checks before
+     * reading from disk.
+     */
+    void setValueSpillCache(ValueSpillCache* cache) {
+        spillCache = cache;
+    }
+
     bool areDeletedItemsAlwaysResident() const override;
 
     void addStats(bool details,
@@ -168,12 +190,44 @@ public:
      * @param eject true if we should eject the value immediately
      * @param keyMetaDataOnly is this just the key and meta-data or a complete
      *                        item
+     * @param restoreOnly only restore the value of an evicted item (see
+     *                    HashTable::insertFromWarmup)
      *
      * @return the result of the operation
      */
     MutationStatus insertFromWarmup(Item& itm,
                                     bool eject,
-                                    bool keyMetaDataOnly);
+                                    bool keyMetaDataOnly,
+                                    bool restoreOnly = false);
+
+    /**
+     * Update the index of the prepared SyncWrites on disk which have no
+     * persisted Commit or Abort, for the items written by a flush batch.
+     * The batch may be in any order (the flusher sorts by key).
+     */
+    void updateOnDiskPrepares(const std::vector<const Item*>& flushed);
+
+    /**
+     * Update the index of outstanding prepares for an item loaded from
+     * disk by warmup, which scans in seqno order: a prepare is added, a
+     * committed item completes its key's prepare.
+     */
+    void loadOnDiskPrepare(const Item& item);
+
+    /**
+     * Set whether the index of outstanding prepares covers all of those on
+     * disk. It doesn't while warmup is yet to rebuild it, or after a
+     * rollback.
+     */
+    void setOnDiskPreparesKnown(bool known);
+
+    /**
+     * @param persistedHighSeqno the vBucket's high seqno on disk
+     * @return the seqno warmup must scan from to find all of the outstanding
+     *         prepares (see vbucket_state::preparesStartSeqno); 0 if they
+     *         aren't known.
+     */
+    uint64_t getOnDiskPreparesStartSeqno(uint64_t persistedHighSeqno) const;
 
     size_t getNumPersistedDeletes() const override;
 
@@ -213,12 +267,22 @@ protected:
      * queue a background fetch of the specified item.
      * Returns the number of pending background fetches after
      * adding the specified item.
+     * If the item is already being fetched by bgFetcher, the request is
+     * attached to that fetch instead of being queued.
      */
     size_t queueBGFetchItem(const DocKey& key,
                             std::unique_ptr<VBucketBGFetchItem> fetch,
                             BgFetcher* bgFetcher);
 
 private:
+    /**
+     * Make the value of the given key resident again from the spill cache,
+     * if it holds the value of the key's (non-resident) revision.
+     *
+     * @return the item, with the value restored; null if it couldn't be
+     */
+    std::unique_ptr<Item> restoreSpilledValue(const DocKey& key);
+
     std::tuple<StoredValue*, MutationStatus, VBNotifyCtx> updateStoredValue(
             const HashTable::HashBucketLock& hbl,
             StoredValue& v,
@@ -256,6 +320,11 @@ private:
                  EventuallyPersistentEngine& engine,
                  bool isMeta = false) override;
 
+    void bgFetchMulti(const std::vector<DocKey>& keys,
+                      const void* cookie,
+                      EventuallyPersistentEngine& engine,
+                      bool isMeta) override;
+
     ENGINE_ERROR_CODE
     addTempItemAndBGFetch(HashTable::HashBucketLock& hbl,
                           const DocKey& key,
@@ -291,12 +360,30 @@ private:
      */
     cb::NonNegativeCounter<size_t> onDiskTotalItems;
 
+    /**
+     * The prepared SyncWrites on disk which have no persisted Commit or
+     * Abort, maintained by the flusher.
+     */
+    struct OnDiskPrepares {
+        /// Add, replace or complete (remove) the prepare of the item's key.
+        /// Ignores an item older than the key's prepare.
+        void update(const Item& item);
+
+        bool known = true;
+        std::unordered_map<StoredDocKey, int64_t> seqnos;
+        std::set<int64_t> ordered;
+    };
+    folly::Synchronized<OnDiskPrepares, std::mutex> onDiskPrepares;
+
     std::mutex pendingBGFetchesLock;
     vb_bgfetch_queue_t pendingBGFetches;
 
     /* Pointer to the shard to which this VBucket belongs to */
     KVShard* shard;
 
+    /// Second-tier cache of ejected values (owned by the bucket), if any.
+    ValueSpillCache* spillCache = nullptr;
+
     /**
      * When deferred deletion is enabled for this object we store the database
      * file revision we will unlink from disk.
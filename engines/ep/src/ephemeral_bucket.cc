@@ -18,15 +18,21 @@
 #include "ephemeral_bucket.h"
 
 #include "bucket_logger.h"
+#include "checkpoint_manager.h"
+#include "collections/vbucket_manifest.h"
 #include "ep_engine.h"
 #include "ep_types.h"
+#include "ephemeral_restart_snapshot.h"
 #include "ephemeral_tombstone_purger.h"
 #include "ephemeral_vb.h"
 #include "ephemeral_vb_count_visitor.h"
 #include "failover-table.h"
+#include "kvshard.h"
+#include "numa_topology.h"
 #include "replicationthrottle.h"
 #include "statwriter.h"
 
+#include <platform/dirutils.h>
 #include <platform/sized_buffer.h>
 
 /**
@@ -143,9 +149,96 @@ bool EphemeralBucket::initialize() {
     // High priority vbucket request notification task
     ExecutorPool::get()->schedule(notifyHpReqTask);
 
+    if (config.isEphemeralRestartSnapshot()) {
+        loadRestartSnapshots();
+    }
+
     return true;
 }
 
+void EphemeralBucket::deinitialize() {
+    if (!stats.forceShutdown &&
+        engine.getConfiguration().isEphemeralRestartSnapshot()) {
+        saveRestartSnapshots();
+    }
+    KVBucket::deinitialize();
+}
+
+void EphemeralBucket::saveRestartSnapshots() {
+    const auto dbname = engine.getConfiguration().getDbname();
+    try {
+        cb::io::mkdirp(dbname);
+    } catch (const std::exception& e) {
+        EP_LOG_WARN(
+                "EphemeralBucket::saveRestartSnapshots: Failed to create "
+                "'{}': {}",
+                dbname,
+                e.what());
+        return;
+    }
+
+    for (const auto vbid : vbMap.getBuckets()) {
+        auto vb = getVBucket(vbid);
+        if (vb) {
+            EphemeralRestartSnapshot::save(
+                    EphemeralRestartSnapshot::getPath(dbname, vbid),
+                    static_cast<EphemeralVBucket&>(*vb));
+        }
+    }
+}
+
+void EphemeralBucket::loadRestartSnapshots() {
+    const auto dbname = engine.getConfiguration().getDbname();
+    for (size_t id = 0; id < vbMap.getSize(); ++id) {
+        const Vbid vbid(id);
+        const auto path = EphemeralRestartSnapshot::getPath(dbname, vbid);
+        if (!cb::io::isFile(path) || getVBucket(vbid)) {
+            continue;
+        }
+
+        VBucketPtr vb;
+        auto makeVB = [this, vbid, &vb](
+                              const EphemeralRestartSnapshot::VBucketState&
+                                      state) -> EphemeralVBucket* {
+            vb = makeVBucket(vbid,
+                             state.state,
+                             vbMap.getShardByVbId(vbid),
+                             std::make_unique<FailoverTable>(
+                                     state.failovers,
+                                     engine.getMaxFailoverEntries(),
+                                     state.highSeqno),
+                             std::make_unique<NotifyNewSeqnoCB>(*this),
+                             std::make_unique<Collections::VB::Manifest>(),
+                             state.state,
+                             state.highSeqno,
+                             state.snapStart,
+                             state.snapEnd,
+                             state.purgeSeqno,
+                             state.maxCas,
+                             0,
+                             state.mightContainXattrs,
+                             state.replicationTopology);
+            return static_cast<EphemeralVBucket*>(vb.get());
+        };
+        EphemeralRestartSnapshot::load(path, vbid, makeVB);
+
+        // A snapshot is only valid for the shutdown it was written at (the
+        // vBucket moves on from it as soon as it takes writes), so never
+        // reload it.
+        remove(path.c_str());
+
+        if (vb) {
+            vb->setFreqSaturatedCallback(
+                    [this] { this->wakeItemFreqDecayerTask(); });
+            // As for a newly created vBucket, the first checkpoint for an
+            // active vbucket should start with id 2.
+            vb->checkpointManager->setOpenCheckpointId(
+                    vb->getState() == vbucket_state_active ? 2 : 0);
+            vbMap.addBucket(vb);
+        }
+    }
+}
+
 void EphemeralBucket::attemptToFreeMemory() {
     // Call down to the base class; do to whatever it can to free memory.
     KVBucket::attemptToFreeMemory();
@@ -192,31 +285,34 @@ VBucketPtr EphemeralBucket::makeVBucket(
         bool mightContainXattrs,
         const nlohmann::json& replicationTopology) {
     (void)hlcEpochSeqno; // Ephemeral overrides this to be 0
+    // Allocate the vBucket (notably its HashTable) from its shard's node.
+    NumaPreferredNodeGuard numaGuard(shard ? shard->getNumaNode() : -1);
     // Not using make_shared or allocate_shared
     // 1. make_shared doesn't accept a Deleter
     // 2. allocate_shared has inconsistencies between platforms in calling
     //    alloc.destroy (libc++ doesn't call it)
-    return VBucketPtr(new EphemeralVBucket(id,
-                                           state,
-                                           stats,
-                                           engine.getCheckpointConfig(),
-                                           shard,
-                                           lastSeqno,
-                                           lastSnapStart,
-                                           lastSnapEnd,
-                                           std::move(table),
-                                           std::move(newSeqnoCb),
-                                           makeSyncWriteCompleteCB(),
-                                           makeSeqnoAckCB(),
-                                           engine.getConfiguration(),
-                                           eviction_policy,
-                                           std::move(manifest),
-                                           initState,
-                                           purgeSeqno,
-                                           maxCas,
-                                           mightContainXattrs,
-                                           replicationTopology),
-                      VBucket::DeferredDeleter(engine));
+    auto* vb = new EphemeralVBucket(id,
+                                    state,
+                                    stats,
+                                    engine.getCheckpointConfig(),
+                                    shard,
+                                    lastSeqno,
+                                    lastSnapStart,
+                                    lastSnapEnd,
+                                    std::move(table),
+                                    std::move(newSeqnoCb),
+                                    makeSyncWriteCompleteCB(),
+                                    makeSeqnoAckCB(),
+                                    engine.getConfiguration(),
+                                    eviction_policy,
+                                    std::move(manifest),
+                                    initState,
+                                    purgeSeqno,
+                                    maxCas,
+                                    mightContainXattrs,
+                                    replicationTopology);
+    vb->setSyncWriteTimeoutCallback(makeSyncWriteTimeoutCB());
+    return VBucketPtr(vb, VBucket::DeferredDeleter(engine));
 }
 
 void EphemeralBucket::completeStatsVKey(const void* cookie,
@@ -318,6 +414,7 @@ void EphemeralBucket::appendAggregatedVBucketStats(VBucketCountVisitor& active,
     ARP_STAT("seqlist_deleted_count", seqlistDeletedCount);
     ARP_STAT("seqlist_purged_count", seqListPurgeCount);
     ARP_STAT("seqlist_read_range_count", seqlistReadRangeCount);
+    ARP_STAT("seqlist_range_read_stale_count", seqlistRangeReadStaleCount);
     ARP_STAT("seqlist_stale_count", seqlistStaleCount);
     ARP_STAT("seqlist_stale_value_bytes", seqlistStaleValueBytes);
     ARP_STAT("seqlist_stale_metadata_bytes", seqlistStaleMetadataBytes);
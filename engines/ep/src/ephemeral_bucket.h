@@ -36,6 +36,15 @@ public:
 
     bool initialize() override;
 
+    void deinitialize() override;
+
+    /**
+     * Recreate the vBuckets (and their items) from any restart snapshots in
+     * dbname, deleting the snapshot files. Called by initialize() when
+     * ephemeral_restart_snapshot is enabled.
+     */
+    void loadRestartSnapshots();
+
     ENGINE_ERROR_CODE scheduleCompaction(Vbid vbid,
                                          const CompactionConfig& c,
                                          const void* ck) override;
@@ -146,6 +155,12 @@ protected:
     ExTask tombstonePurgerTask;
 
 private:
+    /**
+     * Write a restart snapshot of each vBucket to dbname, for the next
+     * startup to load. See EphemeralRestartSnapshot.
+     */
+    void saveRestartSnapshots();
+
     /**
      * Task responsible for notifying high priority requests (usually during
      * rebalance)
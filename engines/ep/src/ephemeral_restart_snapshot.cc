@@ -0,0 +1,432 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "ephemeral_restart_snapshot.h"
+
+#include "bucket_logger.h"
+#include "checkpoint_manager.h"
+#include "ephemeral_vb.h"
+#include "failover-table.h"
+#include "item.h"
+
+#include <platform/crc32c.h>
+#include <platform/memorymap.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const uint32_t snapshotMagic = 0x45525331; // "ERS1"
+const uint32_t snapshotVersion = 1;
+
+/// Bytes of records buffered before they are written out by save().
+const size_t writeBufferSize = 64 * 1024;
+
+/**
+ * File layout: a FileHeader, followed by FileHeader::metaLen bytes of JSON
+ * (the failover table and replication topology), followed by
+ * FileHeader::count records in seqno order, each a RecordHeader followed by
+ * RecordHeader::keyLen bytes of (collection-encoded) key and
+ * RecordHeader::valueLen bytes of value. FileHeader::crc is the CRC32-C of
+ * everything after the FileHeader. Fields are in host byte order - a
+ * snapshot is only ever read back by the node which wrote it.
+ */
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    int64_t highSeqno;
+    uint64_t snapStart;
+    uint64_t snapEnd;
+    uint64_t purgeSeqno;
+    uint64_t maxCas;
+    uint64_t failoverUuid;
+    uint64_t count;
+    uint32_t metaLen;
+    uint32_t crc;
+    uint16_t vbid;
+    uint8_t state;
+    uint8_t mightContainXattrs;
+    uint32_t padding;
+};
+
+struct RecordHeader {
+    uint64_t cas;
+    uint64_t revSeqno;
+    int64_t bySeqno;
+    uint32_t flags;
+    uint32_t exptime;
+    uint32_t valueLen;
+    uint16_t keyLen;
+    uint8_t datatype;
+    uint8_t deleted;
+};
+
+/// Buffers data to be written to a file, maintaining the CRC of it.
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(FILE* file) : file(file) {
+        buffer.reserve(writeBufferSize);
+    }
+
+    /// Append size bytes. @return false on a write error.
+    bool append(const void* data, size_t size) {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        buffer.insert(buffer.end(), bytes, bytes + size);
+        if (buffer.size() >= writeBufferSize) {
+            return flush();
+        }
+        return !failed;
+    }
+
+    /// Write out any buffered data. @return false on a write error.
+    bool flush() {
+        if (buffer.empty()) {
+            return !failed;
+        }
+        crc = crc32c(buffer.data(), buffer.size(), crc);
+        if (fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+            failed = true;
+        }
+        buffer.clear();
+        return !failed;
+    }
+
+    FILE* file;
+    std::vector<uint8_t> buffer;
+    uint32_t crc = 0;
+    bool failed = false;
+};
+
+/**
+ * Append a record for each committed item in the vBucket's sequence list.
+ *
+ * @return the number of records written, or -1 on error
+ */
+int64_t writeRecords(EphemeralVBucket& vb, SnapshotWriter& writer) {
+    auto rangeItr = vb.makeRangeIterator(false /*isBackfill*/);
+    if (!rangeItr) {
+        EP_LOG_WARN(
+                "EphemeralRestartSnapshot::save: {} sequence list is being "
+                "purged; not writing a snapshot",
+                vb.getId());
+        return -1;
+    }
+
+    int64_t count = 0;
+    for (; rangeItr->curr() != rangeItr->end(); ++(*rangeItr)) {
+        const auto& osv = **rangeItr;
+        // Completed prepares are not needed to rebuild the vBucket (and
+        // there are no SyncWrites in flight). System events are only
+        // written by collections other than the default.
+        if (!osv.isCommitted() || osv.isTempItem() ||
+            osv.getKey().getCollectionID().isSystem()) {
+            continue;
+        }
+
+        // Read the OSV under its HashBucketLock (see MB-27199).
+        auto hbl = vb.ht.getLockedBucket(osv.getKey());
+        RecordHeader rec{};
+        rec.cas = osv.getCas();
+        rec.revSeqno = osv.getRevSeqno();
+        rec.bySeqno = osv.getBySeqno();
+        rec.flags = osv.getFlags();
+        rec.exptime = uint32_t(osv.getExptime());
+        const auto key = osv.getKey();
+        rec.keyLen = uint16_t(key.size());
+        rec.datatype = osv.getDatatype();
+        rec.deleted = osv.isDeleted() ? 1 : 0;
+        const auto& value = osv.getValue();
+        rec.valueLen = value ? uint32_t(value->valueSize()) : 0;
+
+        if (!writer.append(&rec, sizeof(rec)) ||
+            !writer.append(key.data(), key.size()) ||
+            (rec.valueLen && !writer.append(value->getData(), rec.valueLen))) {
+            return -1;
+        }
+        ++count;
+    }
+    return count;
+}
+
+} // anonymous namespace
+
+std::string EphemeralRestartSnapshot::getPath(const std::string& dbname,
+                                              Vbid vbid) {
+    return dbname + "/" + std::to_string(vbid.get()) + ".ephsnapshot";
+}
+
+bool EphemeralRestartSnapshot::save(const std::string& path,
+                                    EphemeralVBucket& vb) {
+    if (vb.hasTrackedSyncWrites()) {
+        EP_LOG_INFO(
+                "EphemeralRestartSnapshot::save: {} has SyncWrites in "
+                "flight; not writing a snapshot",
+                vb.getId());
+        return false;
+    }
+    if (vb.lockCollections().getManifestUid() != 0) {
+        EP_LOG_INFO(
+                "EphemeralRestartSnapshot::save: {} has collections; not "
+                "writing a snapshot",
+                vb.getId());
+        return false;
+    }
+
+    const auto state = vb.getState();
+    nlohmann::json meta;
+    meta["failover_table"] = vb.failovers->toJSON();
+    if (state == vbucket_state_active) {
+        meta["replication_topology"] = vb.getReplicationTopology();
+    }
+    const auto metaStr = meta.dump();
+
+    // Write to a temporary file and rename it into place, so a partially
+    // written snapshot is never found at startup.
+    const std::string tmpPath = path + ".tmp";
+    FILE* file = fopen(tmpPath.c_str(), "wb");
+    if (file == nullptr) {
+        EP_LOG_WARN("EphemeralRestartSnapshot::save: Failed to open '{}': {}",
+                    tmpPath,
+                    strerror(errno));
+        return false;
+    }
+
+    // Reserve space for the header; it's written once the count and CRC are
+    // known.
+    FileHeader header{};
+    bool rv = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    SnapshotWriter writer(file);
+    int64_t count = -1;
+    if (rv && writer.append(metaStr.data(), metaStr.size())) {
+        count = writeRecords(vb, writer);
+    }
+    rv = count >= 0 && writer.flush();
+
+    if (rv) {
+        const auto snapshot = vb.checkpointManager->getSnapshotInfo();
+        header.magic = snapshotMagic;
+        header.version = snapshotVersion;
+        header.highSeqno = vb.getHighSeqno();
+        header.snapStart = snapshot.range.start;
+        header.snapEnd = snapshot.range.end;
+        header.purgeSeqno = vb.getPurgeSeqno();
+        header.maxCas = vb.getMaxCas();
+        header.failoverUuid = vb.failovers->getLatestUUID();
+        header.count = uint64_t(count);
+        header.metaLen = uint32_t(metaStr.size());
+        header.crc = writer.crc;
+        header.vbid = vb.getId().get();
+        header.state = uint8_t(state);
+        header.mightContainXattrs = vb.mightContainXattrs() ? 1 : 0;
+        rv = fseek(file, 0, SEEK_SET) == 0 &&
+             fwrite(&header, sizeof(header), 1, file) == 1;
+    }
+
+    if (fclose(file) != 0) {
+        rv = false;
+    }
+
+    if (!rv) {
+        EP_LOG_WARN("EphemeralRestartSnapshot::save: Failed to write '{}': {}",
+                    tmpPath,
+                    strerror(errno));
+        remove(tmpPath.c_str());
+        return false;
+    }
+
+    if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+        EP_LOG_WARN(
+                "EphemeralRestartSnapshot::save: Failed to rename '{}' to "
+                "'{}': {}",
+                tmpPath,
+                path,
+                strerror(errno));
+        remove(tmpPath.c_str());
+        return false;
+    }
+
+    EP_LOG_INFO(
+            "EphemeralRestartSnapshot::save: Wrote {} items of {} (high "
+            "seqno:{}) to '{}'",
+            count,
+            vb.getId(),
+            header.highSeqno,
+            path);
+    return true;
+}
+
+bool EphemeralRestartSnapshot::load(const std::string& path,
+                                    Vbid vbid,
+                                    const StateCallback& callback) {
+    std::unique_ptr<cb::io::MemoryMappedFile> map;
+    try {
+        map = std::make_unique<cb::io::MemoryMappedFile>(
+                path.c_str(), cb::io::MemoryMappedFile::Mode::RDONLY);
+    } catch (const std::exception& e) {
+        EP_LOG_WARN("EphemeralRestartSnapshot::load: Failed to map '{}': {}",
+                    path,
+                    e.what());
+        return false;
+    }
+
+    const auto content = map->content();
+    const auto* data = reinterpret_cast<const uint8_t*>(content.data());
+    const size_t size = content.size();
+
+    FileHeader header;
+    if (size < sizeof(header)) {
+        EP_LOG_WARN("EphemeralRestartSnapshot::load: '{}' is truncated",
+                    path);
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    const auto vbState = vbucket_state_t(header.state);
+    if (header.magic != snapshotMagic || header.version != snapshotVersion ||
+        header.vbid != vbid.get() || !is_valid_vbucket_state_t(vbState)) {
+        EP_LOG_WARN(
+                "EphemeralRestartSnapshot::load: '{}' is not a snapshot of {}",
+                path,
+                vbid);
+        return false;
+    }
+
+    const uint8_t* body = data + sizeof(header);
+    const size_t bodySize = size - sizeof(header);
+    if (crc32c(body, bodySize, 0) != header.crc ||
+        bodySize < header.metaLen) {
+        EP_LOG_WARN("EphemeralRestartSnapshot::load: '{}' failed CRC check",
+                    path);
+        return false;
+    }
+
+    VBucketState state;
+    state.state = vbState;
+    state.highSeqno = header.highSeqno;
+    state.snapStart = header.snapStart;
+    state.snapEnd = header.snapEnd;
+    state.purgeSeqno = header.purgeSeqno;
+    state.maxCas = header.maxCas;
+    state.mightContainXattrs = header.mightContainXattrs != 0;
+
+    // The failover table must be the one the snapshot was taken with, and
+    // its latest entry no later than the snapshot's seqno - DCP relies on
+    // the (uuid, seqno) pair to decide whether the vBucket can be caught up
+    // from here or must be rolled back.
+    try {
+        const auto meta = nlohmann::json::parse(body, body + header.metaLen);
+        state.failovers = meta.at("failover_table").get<std::string>();
+        auto topology = meta.find("replication_topology");
+        if (topology != meta.end()) {
+            state.replicationTopology = *topology;
+        }
+        FailoverTable table(state.failovers, 1, state.highSeqno);
+        const auto entry = table.getLatestEntry();
+        if (entry.vb_uuid != header.failoverUuid ||
+            int64_t(entry.by_seqno) > state.highSeqno) {
+            EP_LOG_WARN(
+                    "EphemeralRestartSnapshot::load: '{}' failover table "
+                    "(uuid:{} seqno:{}) does not match the snapshot (uuid:{} "
+                    "seqno:{})",
+                    path,
+                    entry.vb_uuid,
+                    entry.by_seqno,
+                    header.failoverUuid,
+                    state.highSeqno);
+            return false;
+        }
+    } catch (const std::exception& e) {
+        EP_LOG_WARN(
+                "EphemeralRestartSnapshot::load: '{}' has invalid metadata: "
+                "{}",
+                path,
+                e.what());
+        return false;
+    }
+
+    // Check the records exactly fill the file, in increasing seqno order up
+    // to the snapshot's seqno, before loading any of them.
+    const uint8_t* records = body + header.metaLen;
+    const size_t recordsSize = bodySize - header.metaLen;
+    uint64_t count = 0;
+    size_t offset = 0;
+    int64_t lastSeqno = 0;
+    bool ordered = true;
+    while (offset < recordsSize) {
+        RecordHeader rec;
+        if (recordsSize - offset < sizeof(rec)) {
+            break;
+        }
+        std::memcpy(&rec, records + offset, sizeof(rec));
+        if (rec.bySeqno <= lastSeqno || rec.bySeqno > state.highSeqno) {
+            ordered = false;
+            break;
+        }
+        lastSeqno = rec.bySeqno;
+        offset += sizeof(rec) + rec.keyLen + rec.valueLen;
+        ++count;
+    }
+    if (!ordered || offset != recordsSize || count != header.count) {
+        EP_LOG_WARN("EphemeralRestartSnapshot::load: '{}' is corrupt", path);
+        return false;
+    }
+
+    auto* vb = callback(state);
+    if (!vb) {
+        return false;
+    }
+
+    offset = 0;
+    while (offset < recordsSize) {
+        RecordHeader rec;
+        std::memcpy(&rec, records + offset, sizeof(rec));
+        offset += sizeof(rec);
+        DocKey key(records + offset,
+                   rec.keyLen,
+                   DocKeyEncodesCollectionId::Yes);
+        offset += rec.keyLen;
+
+        Item item(key,
+                  rec.flags,
+                  time_t(rec.exptime),
+                  records + offset,
+                  rec.valueLen,
+                  rec.datatype,
+                  rec.cas,
+                  rec.bySeqno,
+                  vbid,
+                  rec.revSeqno);
+        offset += rec.valueLen;
+        if (rec.deleted) {
+            item.setDeleted();
+        }
+        vb->restoreItem(item);
+    }
+
+    EP_LOG_INFO(
+            "EphemeralRestartSnapshot::load: Restored {} items of {} (high "
+            "seqno:{}) from '{}'",
+            count,
+            vbid,
+            state.highSeqno,
+            path);
+    return true;
+}
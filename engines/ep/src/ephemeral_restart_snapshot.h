@@ -0,0 +1,91 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <memcached/vbucket.h>
+#include <nlohmann/json.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+class EphemeralVBucket;
+class Item;
+
+/**
+ * A snapshot of an Ephemeral vBucket - its state, failover table and every
+ * committed item (alive or deleted, with its value) in its sequence list, in
+ * seqno order.
+ *
+ * Written at clean shutdown when ephemeral_restart_snapshot is enabled, so
+ * that at startup the vBucket can be recreated at the seqno it was shut down
+ * at, with the failover table it had; DCP then only has to catch it up from
+ * that seqno (or rolls it back, if the vBucket's history has since diverged)
+ * rather than rebuilding it from nothing.
+ *
+ * vBuckets with SyncWrites in flight, or with any collections other than the
+ * default, are not snapshotted - they're rebuilt over DCP as before.
+ */
+class EphemeralRestartSnapshot {
+public:
+    /// The vBucket-level state saved in a snapshot.
+    struct VBucketState {
+        vbucket_state_t state;
+        int64_t highSeqno;
+        uint64_t snapStart;
+        uint64_t snapEnd;
+        uint64_t purgeSeqno;
+        uint64_t maxCas;
+        bool mightContainXattrs;
+        /// The failover table, as FailoverTable::toJSON()
+        std::string failovers;
+        nlohmann::json replicationTopology;
+    };
+
+    /**
+     * Callback invoked once a snapshot has been validated, with the state of
+     * the vBucket it was taken from. Return the vBucket to restore the items
+     * into, or nullptr to not load the snapshot.
+     */
+    using StateCallback =
+            std::function<EphemeralVBucket*(const VBucketState& state)>;
+
+    /// @return the path of the snapshot file for vbid in the given dbname
+    static std::string getPath(const std::string& dbname, Vbid vbid);
+
+    /**
+     * Write a snapshot of the given vBucket to path. There must be no front
+     * end or DCP writes to the vBucket while it is written (at shutdown).
+     *
+     * @return true if the snapshot was written
+     */
+    static bool save(const std::string& path, EphemeralVBucket& vb);
+
+    /**
+     * Load the snapshot at path: once the whole file has been validated,
+     * pass its state to the callback, then restore each item (in seqno
+     * order) into the vBucket it returns.
+     *
+     * @param vbid vBucket the snapshot is expected to be for
+     * @return true if the snapshot was valid and was loaded
+     */
+    static bool load(const std::string& path,
+                     Vbid vbid,
+                     const StateCallback& callback);
+};
@@ -61,7 +61,11 @@ EphemeralVBucket::EphemeralVBucket(
               lastSnapEnd,
               std::move(table),
               /*flusherCb*/ nullptr,
-              std::make_unique<OrderedStoredValueFactory>(st),
+              std::make_unique<OrderedStoredValueFactory>(
+                      st,
+                      config.isHtStoredValueArena(),
+                      config.isHtInlineValues(),
+                      config.isHtKeyPrefixCompression()),
               std::move(newSeqnoCb),
               syncWriteCb,
               seqnoAckCb,
@@ -190,6 +194,14 @@ void EphemeralVBucket::addStats(bool details,
         addStat("seqlist_range_read_begin", rr_begin, add_stat, c);
         addStat("seqlist_range_read_end", rr_end, add_stat, c);
         addStat("seqlist_range_read_count", rr_end - rr_begin, add_stat, c);
+        addStat("seqlist_range_reads",
+                seqList->getNumRangeReads(),
+                add_stat,
+                c);
+        addStat("seqlist_range_read_stale_count",
+                seqList->getNumRangeReadStaleItems(),
+                add_stat,
+                c);
         addStat("seqlist_stale_count",
                 seqList->getNumStaleItems(),
                 add_stat,
@@ -312,8 +324,34 @@ EphemeralVBucket::inMemoryBackfill(uint64_t start, uint64_t end) {
 }
 
 boost::optional<SequenceList::RangeIterator>
-EphemeralVBucket::makeRangeIterator(bool isBackfill) {
-    return seqList->makeRangeIterator(isBackfill);
+EphemeralVBucket::makeRangeIterator(bool isBackfill, seqno_t start) {
+    return seqList->makeRangeIterator(isBackfill, start);
+}
+
+void EphemeralVBucket::restoreItem(const Item& item) {
+    auto hbl = ht.getLockedBucket(item.getKey());
+    StoredValue* v = ht.unlocked_addNewStoredValue(hbl, item);
+    // Note: a restored tombstone has a deleted time of 0 - i.e. it is aged
+    // for purging from (about) when the bucket was started.
+
+    std::lock_guard<std::mutex> lh(sequenceLock);
+    auto* osv = v->toOrderedStoredValue();
+    {
+        std::lock_guard<std::mutex> listWriteLg(seqList->getListWriteLock());
+        seqList->appendToList(lh, listWriteLg, *osv);
+        seqList->updateHighSeqno(listWriteLg, *osv);
+        // The items before shutdown were de-duplicated arbitrarily, so the
+        // restored list is only a consistent snapshot up to its last item.
+        seqList->updateHighestDedupedSeqno(listWriteLg, *osv);
+    }
+    seqList->updateNumDeletedItems(false, item.isDeleted());
+
+    auto cHandle = lockCollections(item.getKey());
+    cHandle.setHighSeqno(item.getBySeqno());
+    if (!item.isDeleted()) {
+        cHandle.incrementDiskCount();
+    }
+    updateExpiryIndex(*v);
 }
 
 /* Vb level backfill queue is for items in a huge snapshot (disk backfill
@@ -502,12 +540,13 @@ std::pair<StoredValue*, VBNotifyCtx> EphemeralVBucket::addNewStoredValue(
     try {
         osv = v->toOrderedStoredValue();
     } catch (const std::bad_cast& e) {
+        const auto key = v->getKey();
         throw std::logic_error(
                 "EphemeralVBucket::addNewStoredValue(): Error " +
                 std::string(e.what()) + " for " + getId().to_string() +
                 " for key: " +
-                std::string(reinterpret_cast<const char*>(v->getKey().data()),
-                            v->getKey().size()));
+                std::string(reinterpret_cast<const char*>(key.data()),
+                            key.size()));
     }
 
     VBNotifyCtx notifyCtx;
@@ -656,6 +695,15 @@ void EphemeralVBucket::bgFetch(const DocKey& key,
             std::string(reinterpret_cast<const char*>(key.data()), key.size()));
 }
 
+void EphemeralVBucket::bgFetchMulti(const std::vector<DocKey>& keys,
+                                    const void* cookie,
+                                    EventuallyPersistentEngine& engine,
+                                    bool isMeta) {
+    throw std::logic_error(
+            "EphemeralVBucket::bgFetchMulti() is not valid. Called on " +
+            getId().to_string());
+}
+
 ENGINE_ERROR_CODE
 EphemeralVBucket::addTempItemAndBGFetch(HashTable::HashBucketLock& hbl,
                                         const DocKey& key,
@@ -768,6 +816,12 @@ int64_t EphemeralVBucket::addSystemEventItem(
     notifyCtx.bySeqno = v->getBySeqno();
     notifyNewSeqno(notifyCtx);
 
+    // A collection (or scope) was dropped, the stale item deleter must now
+    // find and purge its keys
+    if (item->isDeleted()) {
+        seqList->scheduleDroppedKeysPurge();
+    }
+
     // We don't record anything interesting for scopes
     if (cid) {
         doCollectionsStats(wHandle, *cid, notifyCtx);
@@ -150,12 +150,25 @@ public:
      * the SequenceList, new range iterator will not be allowed
      *
      * @param isBackfill indicates if the iterator is for backfill (for debug)
+     * @param start seqno from which the iterator is to read
      *
      * @return range iterator object when possible
      *         null when not possible
      */
     boost::optional<SequenceList::RangeIterator> makeRangeIterator(
-            bool isBackfill);
+            bool isBackfill, seqno_t start = 1);
+
+    /**
+     * Add an item loaded from a restart snapshot (see
+     * EphemeralRestartSnapshot) to the HashTable and the end of the sequence
+     * list, with its original seqno and CAS. The item is not queued into
+     * the checkpoint - the vBucket is created at the snapshot's high seqno,
+     * and DCP streams backfill the restored items from the sequence list.
+     *
+     * Items must be restored in seqno order, before the vBucket is added to
+     * the VBucketMap.
+     */
+    void restoreItem(const Item& item);
 
     void dump() const override;
 
@@ -301,6 +314,11 @@ private:
                  EventuallyPersistentEngine& engine,
                  bool isMeta = false) override;
 
+    void bgFetchMulti(const std::vector<DocKey>& keys,
+                      const void* cookie,
+                      EventuallyPersistentEngine& engine,
+                      bool isMeta) override;
+
     ENGINE_ERROR_CODE
     addTempItemAndBGFetch(HashTable::HashBucketLock& hbl,
                           const DocKey& key,
@@ -36,6 +36,8 @@ void EphemeralVBucket::CountVisitor::visitBucket(const VBucketPtr& vb) {
         seqListPurgeCount += ephVB.seqListPurgeCount;
         seqlistReadRangeCount += ephVB.seqList->getRangeReadEnd() -
                                  ephVB.seqList->getRangeReadBegin();
+        seqlistRangeReadStaleCount +=
+                ephVB.seqList->getNumRangeReadStaleItems();
         seqlistStaleCount += ephVB.seqList->getNumStaleItems();
         seqlistStaleValueBytes += ephVB.seqList->getStaleValueBytes();
         seqlistStaleMetadataBytes += ephVB.seqList->getStaleMetadataBytes();
@@ -38,6 +38,7 @@ public:
     uint64_t seqlistDeletedCount = 0;
     size_t seqListPurgeCount = 0;
     uint64_t seqlistReadRangeCount = 0;
+    uint64_t seqlistRangeReadStaleCount = 0;
     uint64_t seqlistStaleCount = 0;
     size_t seqlistStaleValueBytes = 0;
     size_t seqlistStaleMetadataBytes = 0;
@@ -0,0 +1,209 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "evicted_meta_index.h"
+
+#include "objectregistry.h"
+
+#include <algorithm>
+
+// The shard is selected by the top 4 bits of the fingerprint.
+static_assert(EvictedMetaIndex::NumShards == 16,
+              "shardFor() assumes 16 shards");
+
+static const uint64_t RevSeqnoMask = (uint64_t(1) << 48) - 1;
+static const int DatatypeShift = 48;
+static const int CommittedShift = 56;
+
+static size_t nextPowerOfTwo(size_t value) {
+    size_t ret = 1;
+    while (ret < value) {
+        ret <<= 1;
+    }
+    return ret;
+}
+
+static size_t getShardEntries(size_t maxEntries) {
+    return (maxEntries + EvictedMetaIndex::NumShards - 1) /
+           EvictedMetaIndex::NumShards;
+}
+
+EvictedMetaIndex::EvictedMetaIndex(size_t maxEntries)
+    : maxShardEntries(getShardEntries(maxEntries)),
+      // Keep the tables at most 3/4 full.
+      maxShardCapacity(std::max(size_t(MinShardCapacity),
+                                nextPowerOfTwo(maxShardEntries * 4 / 3 + 1))) {
+    if (maxEntries != 0) {
+        MemoryDomainGuard guard(MemoryDomain::HashTable);
+        shards = std::make_unique<std::array<Shard, NumShards>>();
+    }
+}
+
+EvictedMetaIndex::~EvictedMetaIndex() {
+    clear();
+    MemoryDomainGuard guard(MemoryDomain::HashTable);
+    shards.reset();
+}
+
+bool EvictedMetaIndex::insert(uint64_t fingerprint, const Meta& meta) {
+    if (!shards) {
+        return false;
+    }
+    fingerprint = sanitise(fingerprint);
+    auto& shard = shardFor(fingerprint);
+    std::lock_guard<std::mutex> lh(shard.mutex);
+    // Replace any existing entry, else add one (growing the table first).
+    auto index = shard.count == 0 ? 0 : find(shard, fingerprint);
+    if (shard.count == 0 || shard.slots[index].fingerprint == 0) {
+        if (!reserve(shard)) {
+            return false;
+        }
+        index = find(shard, fingerprint);
+        shard.slots[index].fingerprint = fingerprint;
+        ++shard.count;
+        count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    auto& slot = shard.slots[index];
+    slot.cas = meta.cas;
+    slot.bySeqno = meta.bySeqno;
+    slot.revSeqnoDatatypeCommitted =
+            (meta.revSeqno & RevSeqnoMask) |
+            (uint64_t(meta.datatype) << DatatypeShift) |
+            (uint64_t(uint8_t(meta.committed)) << CommittedShift);
+    slot.flags = meta.flags;
+    slot.exptime = meta.exptime;
+    return true;
+}
+
+boost::optional<EvictedMetaIndex::Meta> EvictedMetaIndex::take(
+        uint64_t fingerprint) {
+    if (!shards || size() == 0) {
+        return {};
+    }
+    fingerprint = sanitise(fingerprint);
+    auto& shard = shardFor(fingerprint);
+    std::lock_guard<std::mutex> lh(shard.mutex);
+    if (shard.count == 0) {
+        return {};
+    }
+
+    const auto index = find(shard, fingerprint);
+    const auto& slot = shard.slots[index];
+    if (slot.fingerprint == 0) {
+        return {};
+    }
+    Meta meta;
+    meta.cas = slot.cas;
+    meta.bySeqno = slot.bySeqno;
+    meta.revSeqno = slot.revSeqnoDatatypeCommitted & RevSeqnoMask;
+    meta.datatype = protocol_binary_datatype_t(
+            slot.revSeqnoDatatypeCommitted >> DatatypeShift);
+    meta.committed = CommittedState(
+            uint8_t(slot.revSeqnoDatatypeCommitted >> CommittedShift));
+    meta.flags = slot.flags;
+    meta.exptime = slot.exptime;
+
+    eraseSlot(shard, index);
+    numHits.fetch_add(1, std::memory_order_relaxed);
+    return meta;
+}
+
+void EvictedMetaIndex::erase(uint64_t fingerprint) {
+    // Called for every key added to the HashTable, so avoid taking the lock
+    // if there's nothing indexed.
+    if (!shards || size() == 0) {
+        return;
+    }
+    fingerprint = sanitise(fingerprint);
+    auto& shard = shardFor(fingerprint);
+    std::lock_guard<std::mutex> lh(shard.mutex);
+    if (shard.count == 0) {
+        return;
+    }
+    const auto index = find(shard, fingerprint);
+    if (shard.slots[index].fingerprint != 0) {
+        eraseSlot(shard, index);
+    }
+}
+
+void EvictedMetaIndex::clear() {
+    if (!shards) {
+        return;
+    }
+    MemoryDomainGuard guard(MemoryDomain::HashTable);
+    for (auto& shard : *shards) {
+        std::lock_guard<std::mutex> lh(shard.mutex);
+        count.fetch_sub(shard.count, std::memory_order_relaxed);
+        memory.fetch_sub(shard.slots.size() * sizeof(Slot),
+                         std::memory_order_relaxed);
+        shard.count = 0;
+        std::vector<Slot>().swap(shard.slots);
+    }
+}
+
+size_t EvictedMetaIndex::find(const Shard& shard, uint64_t fingerprint) {
+    const size_t mask = shard.slots.size() - 1;
+    size_t index = fingerprint & mask;
+    while (shard.slots[index].fingerprint != 0 &&
+           shard.slots[index].fingerprint != fingerprint) {
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+bool EvictedMetaIndex::reserve(Shard& shard) {
+    const auto capacity = shard.slots.size();
+    if ((shard.count + 1) * 4 <= capacity * 3) {
+        return shard.count < maxShardEntries;
+    }
+    if (capacity >= maxShardCapacity || shard.count >= maxShardEntries) {
+        return false;
+    }
+
+    MemoryDomainGuard guard(MemoryDomain::HashTable);
+    const auto newCapacity = std::max(size_t(MinShardCapacity), capacity * 2);
+    std::vector<Slot> slots(newCapacity, Slot{});
+    slots.swap(shard.slots);
+    for (const auto& slot : slots) {
+        if (slot.fingerprint != 0) {
+            shard.slots[find(shard, slot.fingerprint)] = slot;
+        }
+    }
+    memory.fetch_add((newCapacity - capacity) * sizeof(Slot),
+                     std::memory_order_relaxed);
+    return true;
+}
+
+void EvictedMetaIndex::eraseSlot(Shard& shard, size_t index) {
+    const size_t mask = shard.slots.size() - 1;
+    // Shift back each following entry of the probe sequence which can be
+    // reached from its home slot by going through the hole (so lookups
+    // never need to probe past an empty slot).
+    size_t hole = index;
+    for (size_t next = (index + 1) & mask; shard.slots[next].fingerprint != 0;
+         next = (next + 1) & mask) {
+        const size_t home = shard.slots[next].fingerprint & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            shard.slots[hole] = shard.slots[next];
+            hole = next;
+        }
+    }
+    shard.slots[hole].fingerprint = 0;
+    --shard.count;
+    count.fetch_sub(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,172 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <boost/optional/optional.hpp>
+#include <mcbp/protocol/datatype.h>
+#include <memcached/types.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * A compact index of the metadata of items which have been evicted from a
+ * HashTable (full eviction), so that metadata lookups for them - GET_META
+ * and the conflict resolution of SET/DEL_WITH_META from XDCR - don't need
+ * a background fetch from disk.
+ *
+ * Entries are keyed by a 64-bit fingerprint of the key (see
+ * HashTable::fingerprintKey) rather than the key itself, and hold just the
+ * metadata, in 40 bytes - a fraction of the StoredValue (and key) they
+ * replace. The table is open-addressing with linear probing (and
+ * backward-shift deletion, so there are no tombstones), split in NumShards
+ * independently locked shards which grow on demand up to the configured
+ * number of entries; once full, further evicted items simply aren't
+ * indexed.
+ *
+ * The owning HashTable keeps the index exact: an entry is added when an
+ * item is evicted and removed whenever the key is added back to the
+ * HashTable (or removed from the vBucket), all under the key's hash bucket
+ * lock.
+ *
+ * Thread safe.
+ */
+class EvictedMetaIndex {
+public:
+    /// The metadata of an evicted item.
+    struct Meta {
+        uint64_t cas;
+        int64_t bySeqno;
+        uint64_t revSeqno;
+        uint32_t flags;
+        uint32_t exptime;
+        protocol_binary_datatype_t datatype;
+        CommittedState committed;
+    };
+
+    static const size_t NumShards = 16;
+
+    /// The smallest table allocated for a shard.
+    static const size_t MinShardCapacity = 64;
+
+    /**
+     * @param maxEntries the most entries held (across all shards); 0
+     *        disables the index.
+     */
+    explicit EvictedMetaIndex(size_t maxEntries);
+
+    EvictedMetaIndex(const EvictedMetaIndex&) = delete;
+    EvictedMetaIndex& operator=(const EvictedMetaIndex&) = delete;
+
+    ~EvictedMetaIndex();
+
+    bool isEnabled() const {
+        return shards != nullptr;
+    }
+
+    /**
+     * Record the metadata of the key with the given fingerprint, replacing
+     * any previous entry for it.
+     *
+     * @return false if the index is disabled or full
+     */
+    bool insert(uint64_t fingerprint, const Meta& meta);
+
+    /// Remove and return the entry for the given fingerprint, if any.
+    boost::optional<Meta> take(uint64_t fingerprint);
+
+    /// Forget the given fingerprint (a no-op if it isn't indexed).
+    void erase(uint64_t fingerprint);
+
+    /// Remove all entries, freeing the tables.
+    void clear();
+
+    /// @return the number of entries.
+    size_t size() const {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    /// @return the memory allocated for the tables.
+    size_t getMemoryUsage() const {
+        return memory.load(std::memory_order_relaxed);
+    }
+
+    /// @return the number of lookups (take()) which found an entry.
+    size_t getNumHits() const {
+        return numHits.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot {
+        /// 0 if the slot is empty
+        uint64_t fingerprint;
+        uint64_t cas;
+        int64_t bySeqno;
+        /// The revSeqno (48 bits), datatype and committed state
+        uint64_t revSeqnoDatatypeCommitted;
+        uint32_t flags;
+        uint32_t exptime;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        /// Power-of-two sized (or empty, until first used)
+        std::vector<Slot> slots;
+        size_t count = 0;
+    };
+
+    Shard& shardFor(uint64_t fingerprint) {
+        return (*shards)[fingerprint >> 60];
+    }
+
+    /**
+     * @return the index of the slot holding the given fingerprint, or of
+     *         the empty slot where it belongs (shard.mutex must be held and
+     *         the shard not empty).
+     */
+    static size_t find(const Shard& shard, uint64_t fingerprint);
+
+    /// Grow the shard's table if it's too full to add an entry.
+    /// @return false if it's full and already as large as allowed.
+    bool reserve(Shard& shard);
+
+    /// Empty the given slot, shifting back any entries which follow it.
+    void eraseSlot(Shard& shard, size_t index);
+
+    static uint64_t sanitise(uint64_t fingerprint) {
+        // 0 marks an empty slot, so is stored as 1.
+        return fingerprint == 0 ? 1 : fingerprint;
+    }
+
+    /// The most entries in a shard.
+    const size_t maxShardEntries;
+
+    /// The largest table of a shard.
+    const size_t maxShardCapacity;
+
+    /// nullptr if disabled (so a disabled index costs next to nothing)
+    std::unique_ptr<std::array<Shard, NumShards>> shards;
+
+    std::atomic<size_t> count{0};
+    std::atomic<size_t> memory{0};
+    std::atomic<size_t> numHits{0};
+};
@@ -0,0 +1,79 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "eviction_ghost_list.h"
+
+#include "stats.h"
+
+#include <stdexcept>
+
+static size_t roundUpToPowerOfTwo(size_t size) {
+    if (size == 0) {
+        throw std::invalid_argument("EvictionGhostList: size must be > 0");
+    }
+    size_t ret = 1;
+    while (ret < size) {
+        ret <<= 1;
+    }
+    return ret;
+}
+
+EvictionGhostList::EvictionGhostList(EPStats& stats, size_t size)
+    : stats(stats),
+      mask(roundUpToPowerOfTwo(size) - 1),
+      slots(new std::atomic<uint64_t>[mask + 1]) {
+    for (size_t ii = 0; ii <= mask; ++ii) {
+        slots[ii].store(0, std::memory_order_relaxed);
+    }
+}
+
+void EvictionGhostList::recordEviction(const DocKey& key,
+                                       rel_time_t now,
+                                       bool referenced) {
+    const auto hash = key.hash();
+    slots[hash & mask].store(makeEntry(hash, now, referenced),
+                             std::memory_order_relaxed);
+}
+
+bool EvictionGhostList::recordFetch(const DocKey& key, rel_time_t now) {
+    const auto hash = key.hash();
+    auto& slot = slots[hash & mask];
+    auto entry = slot.load(std::memory_order_relaxed);
+    if (entry == 0 || uint32_t(entry >> 32) != hash) {
+        return false;
+    }
+    // Only the first fetch after the eviction counts.
+    if (!slot.compare_exchange_strong(entry, 0, std::memory_order_relaxed)) {
+        return false;
+    }
+
+    const auto evicted = rel_time_t((entry & 0xffffffff) >> 1);
+    // Only 31 bits of the eviction time are kept.
+    const auto elapsed = (now - evicted) & 0x7fffffff;
+    ++stats.evictedRefetched;
+    stats.evictionRefetchIntervalHisto.add(elapsed);
+
+    // Move the recency target one point towards the kind of item which was
+    // wrongly evicted.
+    auto target = recencyTarget.load();
+    const bool referenced = entry & 1;
+    if (referenced ? target > 0 : target < 100) {
+        const auto next = referenced ? target - 1 : target + 1;
+        recencyTarget.compare_exchange_strong(target, next);
+    }
+    return true;
+}
@@ -0,0 +1,107 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <memcached/dockey.h>
+#include <memcached/types.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+class EPStats;
+
+/**
+ * A "ghost list" of the keys the item pager recently evicted, used to
+ * measure the quality of its eviction decisions: how often (and how soon)
+ * an evicted key has to be BG fetched back from disk.
+ *
+ * It's a fixed size, direct-mapped table of (key hash, eviction time)
+ * slots; a newer eviction simply overwrites whatever was in its slot, so
+ * the table only remembers roughly the last `size` evictions and costs 8
+ * bytes per slot regardless of key size. Two keys with the same 32-bit
+ * hash are indistinguishable, so the counts are an (over) estimate.
+ *
+ * When a BG fetch completes for a key which is in the table, the key is
+ * forgotten (so each eviction is counted at most once) and
+ * EPStats::evictedRefetched and EPStats::evictionRefetchIntervalHisto
+ * (seconds from eviction to refetch) are updated.
+ *
+ * The refetches also drive the "adaptive" item eviction algorithm, in the
+ * manner of ARC's ghost lists: each eviction records whether the item had
+ * been referenced since it was stored. A refetch of an unreferenced item
+ * means recency mattered, and moves the recency target (the age percentile
+ * below which unreferenced items are kept) up; a refetch of a referenced
+ * item means frequency mattered, and moves it down.
+ *
+ * Thread safe; slots are updated with single atomic operations.
+ */
+class EvictionGhostList {
+public:
+    /**
+     * @param stats stats to record refetches in
+     * @param size number of slots (rounded up to a power of two)
+     */
+    EvictionGhostList(EPStats& stats, size_t size);
+
+    /**
+     * Remember that key was evicted at the given time.
+     *
+     * @param referenced true if the item had been referenced since it was
+     *        stored (its frequency counter was above the initial count)
+     */
+    void recordEviction(const DocKey& key, rel_time_t now, bool referenced);
+
+    /**
+     * Note that key was BG fetched at the given time.
+     *
+     * @return true if the key was recently evicted (and hasn't been
+     *         refetched since).
+     */
+    bool recordFetch(const DocKey& key, rel_time_t now);
+
+    /// @return the number of slots in the table
+    size_t size() const {
+        return mask + 1;
+    }
+
+    /**
+     * @return the percentile (0-100) of item age below which items which
+     *         haven't been referenced since they were stored aren't evicted
+     *         by the adaptive algorithm.
+     */
+    size_t getRecencyTarget() const {
+        return recencyTarget;
+    }
+
+    static const size_t initialRecencyTarget = 50;
+
+private:
+    static uint64_t makeEntry(uint32_t hash, rel_time_t time, bool referenced) {
+        // The time is stored in seconds shifted up by one to make room for
+        // the referenced bit. Force a non-zero entry; zero marks an empty
+        // slot (it just makes a hash of 0 look a second older).
+        return (uint64_t(hash) << 32) | (uint32_t(time) << 1) |
+               uint64_t(referenced) | (hash == 0 ? 2 : 0);
+    }
+
+    EPStats& stats;
+    const size_t mask;
+    std::unique_ptr<std::atomic<uint64_t>[]> slots;
+    std::atomic<size_t> recencyTarget{initialRecencyTarget};
+};
@@ -20,6 +20,7 @@
 #include "ep_engine.h"
 #include "ep_time.h"
 #include "executorthread.h"
+#include "numa_topology.h"
 #include "statwriter.h"
 #include "taskqueue.h"
 
@@ -29,6 +30,7 @@
 #include <platform/sysinfo.h>
 #include <algorithm>
 #include <chrono>
+#include <limits>
 #include <queue>
 #include <sstream>
 
@@ -46,6 +48,9 @@ static const size_t EP_MAX_WRITER_THREADS = 8;
 static const size_t EP_MAX_AUXIO_THREADS  = 8;
 static const size_t EP_MAX_NONIO_THREADS  = 8;
 
+const size_t ExecutorPool::maxLocalTasks = 4;
+const std::chrono::seconds ExecutorPool::taskTypeSampleInterval{10};
+
 size_t ExecutorPool::getNumNonIO(void) {
     // 1. compute: 30% of total threads
     size_t count = maxGlobalThreads * 0.3;
@@ -137,6 +142,15 @@ ExecutorPool *ExecutorPool::get(void) {
                                    config.getNumWriterThreads(),
                                    config.getNumAuxioThreads(),
                                    config.getNumNonioThreads());
+            tmp->setNumaAffinity(config.isNumaAffinityEnabled() &&
+                                 NumaTopology::getNumNodes() > 1);
+            if (config.isIoThreadsAdaptive()) {
+                tmp->setAdaptiveIOThreads(
+                        config.getIoThreadsAdaptiveMin(),
+                        config.getIoThreadsAdaptiveMax(),
+                        std::chrono::microseconds(
+                                config.getIoThreadsAdaptiveWaitThreshold()));
+            }
             instance.store(tmp);
         }
     }
@@ -158,7 +172,8 @@ ExecutorPool::ExecutorPool(size_t maxThreads, size_t nTaskSets,
                            size_t maxAuxIO,   size_t maxNonIO) :
                   numTaskSets(nTaskSets), totReadyTasks(0),
                   isHiPrioQset(false), isLowPrioQset(false), numBuckets(0),
-                  numSleepers(0), curWorkers(nTaskSets), numWorkers(nTaskSets),
+                  numSleepers(0), numStolenTasks(0), numIdleSleeps(0),
+                  curWorkers(nTaskSets), numWorkers(nTaskSets),
                   numReadyTasks(nTaskSets) {
     size_t numCPU = Couchbase::get_available_cpu_count();
     size_t numThreads = (size_t)((numCPU * 3)/4);
@@ -212,13 +227,22 @@ TaskQueue *ExecutorPool::_nextTask(ExecutorThread &t, uint8_t tick) {
                 (isLowPrioQset ? lpTaskQ[myq] : NULL);
         checkNextQ = isLowPrioQset ? lpTaskQ[myq] : checkQ;
     }
+
+    if (TaskQueue* localQ = _nextLocalTask(t, checkQ)) {
+        return localQ;
+    }
     while (t.state == EXECUTOR_RUNNING) {
-        if (checkQ && checkQ->fetchNextTask(t)) {
+        if (checkQ && checkQ->fetchNextTask(t, maxLocalTasks)) {
             return checkQ;
         }
         if (toggle || checkQ == checkNextQ) {
+            // Nothing ready in the shared queues; before sleeping, help out
+            // with the tasks another thread has taken but not yet run.
+            if (TaskQueue* stolenQ = _stealTask(t)) {
+                return stolenQ;
+            }
             TaskQueue *sleepQ = getSleepQ(myq);
-            if (sleepQ->sleepThenFetchNextTask(t)) {
+            if (sleepQ->sleepThenFetchNextTask(t, maxLocalTasks)) {
                 return sleepQ;
             } else {
                 return NULL;
@@ -237,6 +261,82 @@ TaskQueue *ExecutorPool::nextTask(ExecutorThread &t, uint8_t tick) {
     return tq;
 }
 
+TaskQueue* ExecutorPool::_nextLocalTask(ExecutorThread& t,
+                                        TaskQueue* checkQ) {
+    TaskQpair next;
+    {
+        std::lock_guard<std::mutex> lh(t.localTasksMutex);
+        if (t.localTasks.empty()) {
+            return nullptr;
+        }
+        const auto& front = t.localTasks.front();
+        // Dead tasks are cleaned out first, as in the shared queue
+        if (!front.first->isdead() &&
+            front.first->getQueuePriority() >
+                    front.second->getReadyTopPriority()) {
+            return nullptr;
+        }
+        // Keep to the high/low priority alternation: if this tick polls the
+        // other set first and it has a task ready, that one goes first.
+        if (checkQ && checkQ != front.second &&
+            checkQ->getReadyTopPriority() !=
+                    std::numeric_limits<queue_priority_t>::max()) {
+            return nullptr;
+        }
+        next = std::move(t.localTasks.front());
+        t.localTasks.pop_front();
+    }
+    lessWork(t.taskType);
+    t.setCurrentTask(next.first);
+    return next.second;
+}
+
+TaskQueue* ExecutorPool::_stealTask(ExecutorThread& t) {
+    if (!numReadyTasks[t.taskType]) {
+        return nullptr;
+    }
+
+    TaskQpair stolen;
+    {
+        // Don't wait for tMutex; it's held while threads are stopped and
+        // joined, and we'll come back here if we don't get to sleep anyway.
+        std::unique_lock<std::mutex> lh(tMutex, std::try_to_lock);
+        if (!lh) {
+            return nullptr;
+        }
+        for (auto* victim : threadQ) {
+            if (victim == &t || victim->taskType != t.taskType) {
+                continue;
+            }
+            std::lock_guard<std::mutex> guard(victim->localTasksMutex);
+            if (!victim->localTasks.empty()) {
+                stolen = std::move(victim->localTasks.front());
+                victim->localTasks.pop_front();
+                break;
+            }
+        }
+    }
+
+    if (!stolen.first) {
+        return nullptr;
+    }
+    numStolenTasks++;
+    lessWork(t.taskType);
+    t.setCurrentTask(stolen.first);
+    return stolen.second;
+}
+
+void ExecutorPool::requeueLocalTasks(ExecutorThread& t) {
+    std::deque<TaskQpair> tasks;
+    {
+        std::lock_guard<std::mutex> lh(t.localTasksMutex);
+        tasks.swap(t.localTasks);
+    }
+    for (auto& task : tasks) {
+        task.second->requeueReadyTask(task.first);
+    }
+}
+
 void ExecutorPool::addWork(size_t newWork, task_type_t qType) {
     if (newWork) {
         totReadyTasks.fetch_add(newWork);
@@ -520,10 +620,15 @@ ssize_t ExecutorPool::_adjustWorkers(task_type_t type, size_t desiredNumItems) {
             // If we want to increase the number of threads, they must be
             // created and started
             for (size_t tidx = numItems; tidx < desiredNumItems; ++tidx) {
+                // Spread each type's threads over the NUMA nodes
+                const int numaNode =
+                        numaAffinity ? int(tidx % NumaTopology::getNumNodes())
+                                     : -1;
                 threadQ.push_back(new ExecutorThread(
                         this,
                         type,
-                        typeName + "_worker_" + std::to_string(tidx)));
+                        typeName + "_worker_" + std::to_string(tidx),
+                        numaNode));
                 threadQ.back()->start();
             }
         } else if (numItems > desiredNumItems) {
@@ -537,6 +642,9 @@ ssize_t ExecutorPool::_adjustWorkers(task_type_t type, size_t desiredNumItems) {
                     // stop but /don't/ join yet
                     (*itr)->stop(false);
 
+                    // and let the other threads have its local tasks
+                    requeueLocalTasks(**itr);
+
                     // store temporarily
                     removed.push_back(*itr);
 
@@ -768,6 +876,157 @@ void ExecutorPool::doTaskQStat(EventuallyPersistentEngine* engine,
     }
 }
 
+void ExecutorPool::doTaskTypeStat(EventuallyPersistentEngine* engine,
+                                  const void* cookie,
+                                  const AddStatFn& add_stat) {
+    if (engine->getEpStats().isShutdown) {
+        return;
+    }
+
+    NonBucketAllocationGuard guard;
+    try {
+        for (size_t i = 0; i < taskTypeStats.size(); i++) {
+            const auto type = static_cast<task_type_t>(i);
+            taskTypeStats[i].addStats(
+                    std::string("ep_task_type:") + to_string(type),
+                    cookie,
+                    add_stat);
+        }
+        add_casted_stat("ep_io_threads_pattern",
+                        WorkLoadPolicy::stringOfWorkLoadPattern(ioPattern),
+                        add_stat,
+                        cookie);
+        add_casted_stat("ep_io_threads_moves_to_readers",
+                        numIOMovesToReaders,
+                        add_stat,
+                        cookie);
+        add_casted_stat("ep_io_threads_moves_to_writers",
+                        numIOMovesToWriters,
+                        add_stat,
+                        cookie);
+        add_casted_stat("ep_io_threads_num_readers",
+                        numWorkers[READER_TASK_IDX],
+                        add_stat,
+                        cookie);
+        add_casted_stat("ep_io_threads_num_writers",
+                        numWorkers[WRITER_TASK_IDX],
+                        add_stat,
+                        cookie);
+    } catch (std::exception& error) {
+        EP_LOG_WARN("ExecutorPool::doTaskTypeStat: Failed to build stats: {}",
+                    error.what());
+    }
+}
+
+void ExecutorPool::logTaskTypeQTime(task_type_t type,
+                                    std::chrono::steady_clock::duration wait) {
+    taskTypeStats[type].logQTime(
+            std::chrono::duration_cast<std::chrono::microseconds>(wait));
+}
+
+void ExecutorPool::logTaskTypeRunTime(
+        task_type_t type, std::chrono::steady_clock::duration runtime) {
+    taskTypeStats[type].logRunTime(
+            std::chrono::duration_cast<std::chrono::microseconds>(runtime));
+}
+
+void ExecutorPool::maybeSampleTaskTypes(
+        std::chrono::steady_clock::time_point now, task_type_t caller) {
+    if (ioMovePending) {
+        balanceIOThreads(caller);
+    }
+
+    auto next = nextTaskTypeSample.load();
+    if (now.time_since_epoch().count() < next) {
+        return;
+    }
+    // Only the thread which moves the next sample on takes this one
+    const auto following = (now + taskTypeSampleInterval).time_since_epoch();
+    if (nextTaskTypeSample.compare_exchange_strong(next, following.count())) {
+        sampleTaskTypes(now);
+    }
+}
+
+void ExecutorPool::sampleTaskTypes(std::chrono::steady_clock::time_point now) {
+    for (size_t i = 0; i < taskTypeStats.size(); i++) {
+        size_t ready = 0;
+        size_t future = 0;
+        if (i < numTaskSets) {
+            if (isHiPrioQset) {
+                ready += hpTaskQ[i]->getReadyQueueSize();
+                future += hpTaskQ[i]->getFutureQueueSize();
+            }
+            if (isLowPrioQset) {
+                ready += lpTaskQ[i]->getReadyQueueSize();
+                future += lpTaskQ[i]->getFutureQueueSize();
+            }
+        }
+        taskTypeStats[i].sample(ready, future, now);
+    }
+
+    if (adaptiveIOThreads) {
+        ioPattern = WorkLoadPolicy::patternFromQueueWaits(
+                taskTypeStats[READER_TASK_IDX].getLastIntervalQueueWait(99),
+                taskTypeStats[WRITER_TASK_IDX].getLastIntervalQueueWait(99),
+                adaptiveIOWaitThreshold);
+        ioMovePending = ioPattern != MIXED;
+    }
+}
+
+void ExecutorPool::setAdaptiveIOThreads(
+        size_t minThreads,
+        size_t maxThreads,
+        std::chrono::microseconds waitThreshold) {
+    adaptiveIOMinThreads = minThreads;
+    adaptiveIOMaxThreads = maxThreads;
+    adaptiveIOWaitThreshold = waitThreshold;
+    adaptiveIOThreads = true;
+}
+
+void ExecutorPool::balanceIOThreads(task_type_t caller) {
+    const auto pattern = ioPattern.load();
+    if (pattern == MIXED) {
+        return;
+    }
+    const auto to = pattern == READ_HEAVY ? READER_TASK_IDX : WRITER_TASK_IDX;
+    const auto from = pattern == READ_HEAVY ? WRITER_TASK_IDX : READER_TASK_IDX;
+    bool pending = true;
+    if (caller == from ||
+        !ioMovePending.compare_exchange_strong(pending, false)) {
+        return;
+    }
+
+    const size_t numTo = numWorkers[to];
+    const size_t numFrom = numWorkers[from];
+    size_t maxThreads = adaptiveIOMaxThreads;
+    if (maxThreads == 0) {
+        maxThreads = numTo + numFrom;
+    }
+    if (numFrom <= adaptiveIOMinThreads || numTo >= maxThreads) {
+        return;
+    }
+
+    auto& readers = taskTypeStats[READER_TASK_IDX];
+    auto& writers = taskTypeStats[WRITER_TASK_IDX];
+    EP_LOG_INFO(
+            "ExecutorPool::balanceIOThreads: Moving a thread from type:{} "
+            "({} threads) to type:{} ({} threads); last interval queue wait "
+            "p99 reader:{}us writer:{}us",
+            to_string(from),
+            numFrom,
+            to_string(to),
+            numTo,
+            readers.getLastIntervalQueueWait(99).count(),
+            writers.getLastIntervalQueueWait(99).count());
+    adjustWorkers(to, numTo + 1);
+    adjustWorkers(from, numFrom - 1);
+    if (pattern == READ_HEAVY) {
+        ++numIOMovesToReaders;
+    } else {
+        ++numIOMovesToWriters;
+    }
+}
+
 static void addWorkerStats(const char* prefix,
                            ExecutorThread* t,
                            const void* cookie,
@@ -861,6 +1120,7 @@ void ExecutorPool::doTasksStat(EventuallyPersistentEngine* engine,
         obj["priority"] = task->getQueuePriority();
         obj["waketime_ns"] = task->getWaketime().time_since_epoch().count();
         obj["total_runtime_ns"] = task->getTotalRuntime().count();
+        obj["total_cputime_ns"] = task->getTotalCpuTime().count();
         obj["last_starttime_ns"] =
                 to_ns_since_epoch(task->getLastStartTime()).count();
         obj["previous_runtime_ns"] = task->getPrevRuntime().count();
@@ -27,6 +27,14 @@
  * up and fetches (TaskQueue::fetchNextTask) a task for execution
  * (GlobalTask::run() is called to execute the task).
  *
+ * To keep the shared queues' locks cold when there are many ready tasks, a
+ * thread fetching a task also takes a small batch of the next ready tasks
+ * (see maxLocalTasks) into its own local queue, which it then runs without
+ * going back to the shared queue - unless a more urgent task has since
+ * become ready there. A thread which finds the shared queues empty steals
+ * from the local queues of the other threads of its type before it goes
+ * to sleep, so a batch never waits behind a long-running task.
+ *
  * The pool also has the concept of high and low priority which is achieved by
  * having two TaskQueue objects per task-type. When a thread wakes up to run
  * a task, it will service the high-priority queue more frequently than the
@@ -67,9 +75,12 @@
 
 #include "syncobject.h"
 #include "task_type.h"
+#include "task_type_stats.h"
 #include "taskable.h"
+#include "workload.h"
 
 #include <memcached/engine.h>
+#include <array>
 #include <map>
 #include <set>
 
@@ -95,6 +106,7 @@ public:
     bool trySleep(task_type_t task_type) {
         if (!numReadyTasks[task_type]) {
             numSleepers++;
+            numIdleSleeps++;
             return true;
         }
         return false;
@@ -106,6 +118,12 @@ public:
 
     TaskQueue *nextTask(ExecutorThread &t, uint8_t tick);
 
+    /**
+     * Put the tasks in the thread's local queue back into the shared queues
+     * they came from; called when the thread stops.
+     */
+    void requeueLocalTasks(ExecutorThread& t);
+
     TaskQueue *getSleepQ(unsigned int curTaskType) {
         return isHiPrioQset ? hpTaskQ[curTaskType] : lpTaskQ[curTaskType];
     }
@@ -147,6 +165,83 @@ public:
                      const void* cookie,
                      const AddStatFn& add_stat);
 
+    /**
+     * Add the queue wait and runtime histograms of each task type (for the
+     * tasks of all of the buckets), in total and for the last interval, and
+     * the depth of the type's queues at the end of the interval.
+     */
+    void doTaskTypeStat(EventuallyPersistentEngine* engine,
+                        const void* cookie,
+                        const AddStatFn& add_stat);
+
+    /// Record how long a task of the given type waited to run once ready
+    void logTaskTypeQTime(task_type_t type,
+                          std::chrono::steady_clock::duration wait);
+
+    /// Record how long a task of the given type ran for
+    void logTaskTypeRunTime(task_type_t type,
+                            std::chrono::steady_clock::duration runtime);
+
+    /**
+     * End the task types' interval if taskTypeSampleInterval has passed
+     * since it began (and make any reader/writer thread move the last
+     * sample decided on). Called by the threads after running each task.
+     *
+     * @param caller the type of the calling thread
+     */
+    void maybeSampleTaskTypes(std::chrono::steady_clock::time_point now,
+                              task_type_t caller = NO_TASK_TYPE);
+
+    /// End the task types' interval now, recording the queue depths
+    void sampleTaskTypes(std::chrono::steady_clock::time_point now);
+
+    const TaskTypeStats& getTaskTypeStats(task_type_t type) const {
+        return taskTypeStats[type];
+    }
+
+    /**
+     * Rebalance the IO threads between the readers and the writers: each
+     * time the task types are sampled, move one thread from the writers to
+     * the readers if the reader tasks' (BG fetches') p99 queue wait shows
+     * the workload is READ_HEAVY, or from the readers to the writers if the
+     * writer tasks' (flushers') shows it's WRITE_HEAVY. See
+     * WorkLoadPolicy::patternFromQueueWaits.
+     *
+     * @param minThreads the fewest threads to leave the readers or writers
+     * @param maxThreads the most threads to give the readers or writers (0
+     *        for no limit)
+     * @param waitThreshold the p99 queue wait below which a type is never
+     *        considered starved
+     */
+    void setAdaptiveIOThreads(size_t minThreads,
+                              size_t maxThreads,
+                              std::chrono::microseconds waitThreshold);
+
+    /**
+     * Make the reader/writer thread move decided on by the last sample, if
+     * any. A thread can't stop itself, so a caller of the type which is to
+     * lose a thread leaves the move to a thread of another type.
+     *
+     * @param caller the type of the calling thread (or NO_TASK_TYPE)
+     */
+    void balanceIOThreads(task_type_t caller);
+
+    /// The IO workload pattern measured at the last sample
+    workload_pattern_t getIOPattern() const {
+        return ioPattern;
+    }
+
+    size_t getNumIOThreadMovesToReaders() const {
+        return numIOMovesToReaders;
+    }
+
+    size_t getNumIOThreadMovesToWriters() const {
+        return numIOMovesToWriters;
+    }
+
+    /// How often the task types' interval stats are sampled
+    static const std::chrono::seconds taskTypeSampleInterval;
+
     size_t getNumWorkersStat(void) {
         LockHolder lh(tMutex);
         return threadQ.size();
@@ -196,6 +291,27 @@ public:
 
     size_t getNumSleepers(void) { return numSleepers; }
 
+    /// Number of tasks threads have stolen from another's local queue
+    size_t getNumStolenTasks() const {
+        return numStolenTasks;
+    }
+
+    /// Number of times a thread found no work and went to sleep
+    size_t getNumIdleSleeps() const {
+        return numIdleSleeps;
+    }
+
+    /**
+     * Bind the threads created from now on to the NUMA nodes of the
+     * machine, spreading the threads of each type over the nodes.
+     */
+    void setNumaAffinity(bool enabled) {
+        numaAffinity = enabled;
+    }
+
+    /// The most ready tasks a thread takes into its local queue at once
+    static const size_t maxLocalTasks;
+
     size_t schedule(ExTask task);
 
     static ExecutorPool *get(void);
@@ -209,6 +325,21 @@ protected:
     virtual ~ExecutorPool(void);
 
     TaskQueue* _nextTask(ExecutorThread &t, uint8_t tick);
+
+    /**
+     * Take the next task from the thread's local queue, unless the queue
+     * it came from has a more urgent task ready, or it came from the other
+     * priority set than checkQ and checkQ has a task ready.
+     * @param checkQ the queue this tick of the thread polls first
+     * @return the queue the task came from, or nullptr if none was taken
+     */
+    TaskQueue* _nextLocalTask(ExecutorThread& t, TaskQueue* checkQ);
+
+    /**
+     * Take a task from the local queue of another thread of the same type.
+     * @return the queue the task came from, or nullptr if none was taken
+     */
+    TaskQueue* _stealTask(ExecutorThread& t);
     bool _cancel(size_t taskId, bool eraseTask=false);
     bool _wake(size_t taskId);
     virtual bool _startWorkers(void);
@@ -254,10 +385,31 @@ protected:
     SyncObject tMutex; // to serialize taskLocator, threadQ, numBuckets access
 
     std::atomic<uint16_t> numSleepers; // total number of sleeping threads
+    std::atomic<size_t> numStolenTasks; // tasks stolen from local queues
+    std::atomic<size_t> numIdleSleeps; // times a thread went to sleep idle
+    std::atomic<bool> numaAffinity{false}; // bind new threads to NUMA nodes
     std::vector<std::atomic<uint16_t>> curWorkers; // track # of active workers per TaskSet
     std::vector<std::atomic<uint16_t>> numWorkers; // and limit it to the value set here
     std::vector<std::atomic<size_t>> numReadyTasks; // number of ready tasks per task set
 
+    // Queue wait and runtime of the tasks of each type, across the buckets
+    std::array<TaskTypeStats, NUM_TASK_GROUPS> taskTypeStats;
+    // When the task types' current interval is to be sampled (as the count
+    // of steady_clock ticks)
+    std::atomic<std::chrono::steady_clock::rep> nextTaskTypeSample{0};
+
+    // Adaptive reader/writer thread balance (see setAdaptiveIOThreads)
+    std::atomic<bool> adaptiveIOThreads{false};
+    std::atomic<size_t> adaptiveIOMinThreads{1};
+    std::atomic<size_t> adaptiveIOMaxThreads{0};
+    std::atomic<std::chrono::microseconds> adaptiveIOWaitThreshold{};
+    // The pattern measured at the last sample, and whether a thread is yet
+    // to be moved for it
+    std::atomic<workload_pattern_t> ioPattern{MIXED};
+    std::atomic<bool> ioMovePending{false};
+    std::atomic<size_t> numIOMovesToReaders{0};
+    std::atomic<size_t> numIOMovesToWriters{0};
+
     // Set of all known task owners
     std::set<void *> taskOwners;
 
@@ -23,8 +23,10 @@
 #include "executorpool.h"
 #include "executorthread.h"
 #include "globaltask.h"
+#include "numa_topology.h"
 #include "taskqueue.h"
 
+#include <phosphor/phosphor.h>
 #include <platform/timeutils.h>
 #include <sstream>
 
@@ -76,6 +78,14 @@ void ExecutorThread::stop(bool wait) {
 void ExecutorThread::run() {
     EP_LOG_DEBUG("Thread {} running..", getName());
 
+    if (numaNode >= 0) {
+        if (NumaTopology::bindCurrentThreadToNode(numaNode)) {
+            EP_LOG_INFO("{}: Bound to NUMA node {}", name, numaNode);
+        } else {
+            EP_LOG_WARN("{}: Failed to bind to NUMA node {}", name, numaNode);
+        }
+    }
+
     for (uint8_t tick = 1;; tick++) {
         resetCurrentTask();
 
@@ -115,6 +125,7 @@ void ExecutorThread::run() {
 
             currentTask->getTaskable().logQTime(currentTask->getTaskId(),
                                                 scheduleOverhead);
+            manager->logTaskTypeQTime(taskType, scheduleOverhead);
             // MB-25822: It could be useful to have the exact datetime of long
             // schedule times, in the same way we have for long runtimes.
             // It is more difficult to estimate the expected schedule time than
@@ -150,13 +161,29 @@ void ExecutorThread::run() {
 
             // Now Run the Task ....
             currentTask->setState(TASK_RUNNING, TASK_SNOOZED);
-            bool again = currentTask->run();
+            currentTask->startCpuBudget();
+            bool again;
+            {
+                // A scope around every task run, so a trace shows each of
+                // them (not only those tasks which trace themselves).
+                TRACE_EVENT2("ep-engine/executor",
+                             "run",
+                             "task",
+                             GlobalTask::getTaskName(currentTask->getTaskId()),
+                             "uid",
+                             currentTask->getId());
+                again = currentTask->run();
+            }
+            currentTask->stopCpuBudget();
 
             // Task done, log it ...
             const std::chrono::steady_clock::duration runtime(
                     std::chrono::steady_clock::now() - getTaskStart());
             currentTask->getTaskable().logRunTime(currentTask->getTaskId(),
                                                   runtime);
+            manager->logTaskTypeRunTime(taskType, runtime);
+            manager->maybeSampleTaskTypes(std::chrono::steady_clock::now(),
+                                          taskType);
             currentTask->updateRuntime(runtime);
 
             // Check if exceeded expected duration; and if so log.
@@ -198,6 +225,9 @@ void ExecutorThread::run() {
             manager->doneWork(taskType);
         }
     }
+    // Hand back any tasks we took but won't get to run.
+    manager->requeueLocalTasks(*this);
+
     // Thread is about to terminate - disassociate it from any engine.
     ObjectRegistry::onSwitchThread(nullptr);
 
@@ -82,10 +82,18 @@ public:
         std::chrono::steady_clock::time_point timepoint;
     };
 
-    ExecutorThread(ExecutorPool* m, task_type_t type, const std::string nm)
+    /**
+     * @param numaNode the NUMA node to bind the thread to once it starts,
+     *        or -1 to leave it unbound
+     */
+    ExecutorThread(ExecutorPool* m,
+                   task_type_t type,
+                   const std::string nm,
+                   int numaNode = -1)
         : manager(m),
           taskType(type),
           name(nm),
+          numaNode(numaNode),
           state(EXECUTOR_RUNNING),
           now(std::chrono::steady_clock::now()),
           waketime(std::chrono::steady_clock::time_point::max()),
@@ -117,6 +125,11 @@ public:
 
     const std::string& getName() const { return name; }
 
+    /// The NUMA node the thread is bound to; -1 if it isn't.
+    int getNumaNode() const {
+        return numaNode;
+    }
+
     std::string getTaskName();
 
     const std::string getTaskableName();
@@ -156,6 +169,7 @@ protected:
     ExecutorPool *manager;
     task_type_t taskType;
     const std::string name;
+    const int numaNode;
     std::atomic<executor_state_t> state;
 
     // record of current time
@@ -166,4 +180,13 @@ protected:
 
     std::mutex currentTaskMutex; // Protects currentTask
     ExTask currentTask;
+
+    /**
+     * Ready tasks this thread has taken from the shared TaskQueues of its
+     * type in a batch (see TaskQueue::fetchNextTask), with the queue each
+     * came from; in priority order. Threads of the same type which run out
+     * of work steal from the front.
+     */
+    std::mutex localTasksMutex; // Protects localTasks
+    std::deque<std::pair<ExTask, TaskQueue*>> localTasks;
 };
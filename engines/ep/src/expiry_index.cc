@@ -0,0 +1,95 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "expiry_index.h"
+
+const time_t ExpiryIndex::slotSeconds = 60;
+
+void ExpiryIndex::add(const DocKey& key, const Entry& entry) {
+    std::lock_guard<std::mutex> lh(mutex);
+    auto result = entries.emplace(StoredDocKey(key), entry);
+    auto it = result.first;
+    if (!result.second) {
+        if (slotFor(it->second.exptime) == slotFor(entry.exptime)) {
+            it->second = entry;
+            return;
+        }
+        removeFromWheel(it);
+        it->second = entry;
+    }
+    wheel[slotFor(entry.exptime)].insert(&it->first);
+}
+
+void ExpiryIndex::remove(const DocKey& key) {
+    std::lock_guard<std::mutex> lh(mutex);
+    if (entries.empty()) {
+        return;
+    }
+    auto it = entries.find(StoredDocKey(key));
+    if (it != entries.end()) {
+        removeFromWheel(it);
+        entries.erase(it);
+    }
+}
+
+std::vector<std::pair<StoredDocKey, ExpiryIndex::Entry>>
+ExpiryIndex::takeExpired(time_t now) {
+    std::vector<std::pair<StoredDocKey, Entry>> ret;
+    std::lock_guard<std::mutex> lh(mutex);
+    for (auto slot = wheel.begin(); slot != wheel.end() && slot->first <= now;) {
+        auto& keys = slot->second;
+        for (auto key = keys.begin(); key != keys.end();) {
+            auto it = entries.find(**key);
+            // Only the last slot visited can hold items which haven't
+            // expired yet.
+            if (it->second.exptime < now) {
+                ret.emplace_back(it->first, it->second);
+                key = keys.erase(key);
+                entries.erase(it);
+            } else {
+                ++key;
+            }
+        }
+        if (keys.empty()) {
+            slot = wheel.erase(slot);
+        } else {
+            ++slot;
+        }
+    }
+    return ret;
+}
+
+void ExpiryIndex::clear() {
+    std::lock_guard<std::mutex> lh(mutex);
+    wheel.clear();
+    entries.clear();
+}
+
+size_t ExpiryIndex::size() const {
+    std::lock_guard<std::mutex> lh(mutex);
+    return entries.size();
+}
+
+void ExpiryIndex::removeFromWheel(EntryMap::const_iterator it) {
+    auto slot = wheel.find(slotFor(it->second.exptime));
+    if (slot != wheel.end()) {
+        slot->second.erase(&it->first);
+        if (slot->second.empty()) {
+            wheel.erase(slot);
+        }
+    }
+}
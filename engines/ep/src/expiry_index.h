@@ -0,0 +1,102 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "storeddockey.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * An index of the keys in a vBucket which have an expiry time, so that the
+ * expiry pager can find the items which have expired without visiting
+ * every item in the HashTable: its cost is proportional to the number of
+ * items expiring, not to the number of items.
+ *
+ * Keys are kept in a coarse time wheel of slots of slotSeconds each (an
+ * ordered map from slot to the keys expiring in it), alongside the latest
+ * known (expiry, CAS, revision) of each key. Re-indexing a key moves it to
+ * the slot of its new expiry; removing it (it was deleted, or rewritten
+ * without an expiry) drops it altogether.
+ *
+ * The index holds the metadata needed to expire an item, so it also covers
+ * items which are no longer in the HashTable at all (full eviction), which
+ * would otherwise only be expired by compaction - except for those with
+ * xattrs, whose system xattrs must be preserved from the value on disk.
+ *
+ * Thread safe.
+ */
+class ExpiryIndex {
+public:
+    /// What the index knows about a key (as of its last mutation).
+    struct Entry {
+        time_t exptime;
+        uint64_t cas;
+        uint64_t revSeqno;
+        uint32_t flags;
+        /// The value has xattrs (which a TTL deletion must preserve).
+        bool xattrs;
+    };
+
+    /// Width of each slot of the wheel.
+    static const time_t slotSeconds;
+
+    /**
+     * Record the expiry time (entry.exptime, non-zero) of key's latest
+     * revision, replacing any previous entry for it.
+     */
+    void add(const DocKey& key, const Entry& entry);
+
+    /// Forget key (a no-op if it isn't indexed).
+    void remove(const DocKey& key);
+
+    /**
+     * Remove and return all entries with an expiry time before now (i.e.
+     * which StoredValue::isExpired(now) considers expired).
+     */
+    std::vector<std::pair<StoredDocKey, Entry>> takeExpired(time_t now);
+
+    /// Remove all entries.
+    void clear();
+
+    /// @return the number of keys indexed.
+    size_t size() const;
+
+private:
+    using EntryMap = std::unordered_map<StoredDocKey, Entry>;
+
+    static time_t slotFor(time_t exptime) {
+        return exptime - (exptime % slotSeconds);
+    }
+
+    /// Remove key's node from its slot of the wheel (mutex must be held).
+    void removeFromWheel(EntryMap::const_iterator it);
+
+    mutable std::mutex mutex;
+    EntryMap entries;
+    /**
+     * Slot start time -> the keys (in `entries`, whose nodes don't move)
+     * expiring in that slot.
+     */
+    std::map<time_t, std::unordered_set<const StoredDocKey*>> wheel;
+};
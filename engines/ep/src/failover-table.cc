@@ -25,7 +25,7 @@
 FailoverTable::FailoverTable(size_t capacity)
     : max_entries(capacity), erroneousEntriesErased(0) {
     createEntry(0);
-    cacheTableJSON();
+    cacheTable();
 }
 
 FailoverTable::FailoverTable(const std::string& json,
@@ -50,7 +50,7 @@ void FailoverTable::removeLatestEntry() {
     std::lock_guard<std::mutex> lh(lock);
     if (!table.empty()) {
         table.pop_front();
-        cacheTableJSON();
+        cacheTable();
     }
 }
 
@@ -86,7 +86,7 @@ void FailoverTable::createEntry(uint64_t high_seqno) {
     while (table.size() > max_entries) {
         table.pop_back();
     }
-    cacheTableJSON();
+    cacheTable();
 }
 
 bool FailoverTable::getLastSeqnoForUUID(uint64_t uuid,
@@ -225,7 +225,7 @@ void FailoverTable::pruneEntries(uint64_t seqno) {
 
     latest_uuid = table.front().vb_uuid;
 
-    cacheTableJSON();
+    cacheTable();
 }
 
 std::string FailoverTable::toJSON() {
@@ -236,16 +236,34 @@ std::string FailoverTable::toJSON() {
     return std::string(cachedTableJSON.begin(), cachedTableJSON.end());
 }
 
-void FailoverTable::cacheTableJSON() {
-    nlohmann::json json = nlohmann::json::array();
-    table_t::iterator it;
-    for (it = table.begin(); it != table.end(); ++it) {
-        nlohmann::json obj;
-        obj["id"] = (*it).vb_uuid;
-        obj["seq"] = (*it).by_seqno;
-        json.push_back(obj);
+void FailoverTable::cacheTable() {
+    // Formatted directly rather than via nlohmann::json as this runs on every
+    // change to the table. The output is the same as json::dump() of an
+    // array of {"id":..., "seq":...} objects.
+    cachedTableJSON.clear();
+    cachedTableJSON.reserve(table.size() * 48);
+    cachedTableJSON.push_back('[');
+    for (const auto& entry : table) {
+        if (cachedTableJSON.size() > 1) {
+            cachedTableJSON.push_back(',');
+        }
+        cachedTableJSON.append(R"({"id":)");
+        cachedTableJSON.append(std::to_string(entry.vb_uuid));
+        cachedTableJSON.append(R"(,"seq":)");
+        cachedTableJSON.append(std::to_string(entry.by_seqno));
+        cachedTableJSON.push_back('}');
+    }
+    cachedTableJSON.push_back(']');
+
+    cacheFailoverLog();
+}
+
+void FailoverTable::cacheFailoverLog() {
+    cachedFailoverLog.clear();
+    cachedFailoverLog.reserve(table.size());
+    for (const auto& entry : table) {
+        cachedFailoverLog.push_back({entry.vb_uuid, entry.by_seqno});
     }
-    cachedTableJSON = json.dump();
 }
 
 void FailoverTable::addStats(const void* cookie,
@@ -289,14 +307,7 @@ void FailoverTable::addStats(const void* cookie,
 
 std::vector<vbucket_failover_t> FailoverTable::getFailoverLog() {
     std::lock_guard<std::mutex> lh(lock);
-    std::vector<vbucket_failover_t> result;
-    for (const auto& entry : table) {
-        vbucket_failover_t failoverEntry;
-        failoverEntry.uuid = entry.vb_uuid;
-        failoverEntry.seqno = entry.by_seqno;
-        result.push_back(failoverEntry);
-    }
-    return result;
+    return cachedFailoverLog;
 }
 
 bool FailoverTable::loadFromJSON(const nlohmann::json& json) {
@@ -351,6 +362,7 @@ bool FailoverTable::loadFromJSON(const std::string& json) {
 
     auto ret = loadFromJSON(parsed);
     cachedTableJSON = json;
+    cacheFailoverLog();
 
     return ret;
 }
@@ -375,7 +387,7 @@ void FailoverTable::replaceFailoverLog(const uint8_t* bytes, uint32_t length) {
 
     latest_uuid = table.front().vb_uuid;
 
-    cacheTableJSON();
+    cacheTable();
 }
 
 size_t FailoverTable::getNumEntries() const
@@ -423,7 +435,7 @@ void FailoverTable::sanitizeFailoverTable(int64_t highSeqno) {
     if (table.empty()) {
         createEntry(highSeqno);
     } else if (erroneousEntriesErased) {
-        cacheTableJSON();
+        cacheTable();
     }
 }
 
@@ -27,6 +27,7 @@
 #include <list>
 #include <mutex>
 #include <string>
+#include <vector>
 
 typedef struct {
     uint64_t vb_uuid;
@@ -143,7 +144,8 @@ class FailoverTable {
     void addStats(const void* cookie, Vbid vbid, const AddStatFn& add_stat);
 
     /**
-     * Returns a vector with the current failover table entries.
+     * Returns a vector with the current failover table entries. This is a
+     * copy of a cached vector which is only rebuilt when the table changes.
      */
     std::vector<vbucket_failover_t> getFailoverLog();
 
@@ -166,9 +168,18 @@ class FailoverTable {
     size_t getNumErroneousEntriesErased() const;
 
  private:
-     bool loadFromJSON(const nlohmann::json& json);
+    bool loadFromJSON(const nlohmann::json& json);
     bool loadFromJSON(const std::string& json);
-    void cacheTableJSON();
+
+    /**
+     * Regenerate the cached encodings of the table (the JSON persisted in the
+     * vbucket_state and the failover log returned to DCP clients). Must be
+     * called whenever the table changes.
+     */
+    void cacheTable();
+
+    /// Regenerate only the cached failover log from the table
+    void cacheFailoverLog();
 
     /**
      * DCP consumer being in middle of a snapshot is one of the reasons for rollback.
@@ -198,6 +209,9 @@ class FailoverTable {
     size_t erroneousEntriesErased;
     cb::RandomGenerator provider;
     std::string cachedTableJSON;
+    // The table in the form sent by GetFailoverLog and StreamRequest, so
+    // they only need to copy it
+    std::vector<vbucket_failover_t> cachedFailoverLog;
     std::atomic<uint64_t> latest_uuid;
 
     friend std::ostream& operator<<(std::ostream& os,
@@ -18,13 +18,16 @@
 #include "flusher.h"
 
 #include "bucket_logger.h"
+#include "checkpoint_manager.h"
 #include "common.h"
 #include "ep_bucket.h"
+#include "ep_engine.h"
 #include "tasks.h"
 
 #include <platform/timeutils.h>
 
 #include <stdlib.h>
+#include <algorithm>
 #include <chrono>
 #include <sstream>
 #include <thread>
@@ -161,6 +164,7 @@ void Flusher::schedule_UNLOCKED() {
     ExecutorPool* iom = ExecutorPool::get();
     ExTask task = std::make_shared<FlusherTask>(
             ObjectRegistry::getCurrentEngine(), this, shard->getId());
+    task->setNumaNode(shard->getNumaNode());
     this->setTaskId(task->getId());
     iom->schedule(task);
 }
@@ -200,6 +204,8 @@ bool Flusher::step(GlobalTask *task) {
     case State::Paused:
     case State::Pausing:
         if (currentState == State::Pausing) {
+            // Paused for the files to be copied; leave nothing uncommitted.
+            commitDeferredVBStates(true);
             transitionState(State::Paused);
         }
         // Indefinitely put task to sleep..
@@ -235,9 +241,20 @@ bool Flusher::step(GlobalTask *task) {
 }
 
 void Flusher::completeFlush() {
-    while(!canSnooze()) {
+    // Flush everything, including vBuckets whose flush was deferred or is
+    // still in progress on another thread.
+    for (const auto& deferred : deferredVbs) {
+        lpVbs.push(deferred.first);
+    }
+    deferredVbs.clear();
+    while (!canSnooze() || hasDispatchedFlushes()) {
+        if (canSnooze()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
         flushVB();
     }
+    commitDeferredVBStates(true);
 }
 
 double Flusher::computeMinSleepTime() {
@@ -246,7 +263,228 @@ double Flusher::computeMinSleepTime() {
         return 0;
     }
     minSleepTime *= 2;
-    return std::min(minSleepTime, DEFAULT_MAX_SLEEP_TIME);
+    auto sleepTime = std::min(minSleepTime, DEFAULT_MAX_SLEEP_TIME);
+
+    // Don't sleep past the deadline of any deferred vBucket or state.
+    auto deadline = getVBStateDeadline();
+    for (const auto& deferred : deferredVbs) {
+        deadline = std::min(deadline, deferred.second);
+    }
+    if (deadline != std::chrono::steady_clock::time_point::max()) {
+        const std::chrono::duration<double> untilDeadline =
+                deadline - std::chrono::steady_clock::now();
+        sleepTime = std::min(sleepTime, std::max(0.0, untilDeadline.count()));
+    }
+    return sleepTime;
+}
+
+bool Flusher::deferFlush(Vbid vbid) {
+    const auto batchDelay = store->getFlusherBatchDelay();
+    const auto hotKeyDelay = store->getFlusherHotKeyDelay();
+    if ((batchDelay.count() == 0 && hotKeyDelay.count() == 0) ||
+        _state != State::Running) {
+        deferredVbs.clear();
+        return false;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    auto deferred = deferredVbs.find(vbid);
+    if (deferred != deferredVbs.end() && now >= deferred->second) {
+        // Deferred for long enough.
+        deferredVbs.erase(deferred);
+        return false;
+    }
+
+    VBucketPtr vb = store->getVBucket(vbid);
+    if (!vb) {
+        return false;
+    }
+    const auto items = vb->checkpointManager->getNumItemsForPersistence();
+    // A small batch is worth deferring so more items share its commit;
+    // a vBucket whose recent mutations mostly superseded each other has hot
+    // keys, and deferring lets more of their updates be de-duplicated in the
+    // checkpoint instead of written.
+    const bool smallBatch = batchDelay.count() != 0 &&
+                            items < store->getFlusherBatchMinItems();
+    const bool hotKeys = hotKeyDelay.count() != 0 &&
+                         vb->getFlushSupersededPercent() >=
+                                 store->getFlusherHotKeyPercent();
+    if (items == 0 || !(smallBatch || hotKeys) ||
+        vb->getHighPriorityChkSize() > 0 || vb->hasTrackedSyncWrites()) {
+        // Nothing to batch, nothing to gain from deferring, or clients are
+        // waiting on persistence (directly, or for SyncWrites).
+        if (deferred != deferredVbs.end()) {
+            deferredVbs.erase(deferred);
+        }
+        return false;
+    }
+
+    if (deferred == deferredVbs.end()) {
+        // The deadline is fixed when first deferred, so the persistence lag
+        // added is bounded by the larger of the delays.
+        std::chrono::milliseconds delay{0};
+        if (smallBatch) {
+            delay = batchDelay;
+        }
+        if (hotKeys) {
+            delay = std::max(delay, hotKeyDelay);
+        }
+        deferredVbs.emplace(vbid, now + delay);
+        auto& stats = store->getEPEngine().getEpStats();
+        ++stats.flusherDeferrals;
+        if (hotKeys) {
+            ++stats.flusherHotKeyDeferrals;
+        }
+    }
+    return true;
+}
+
+void Flusher::queueExpiredDeferredVbs() {
+    const auto now = std::chrono::steady_clock::now();
+    for (const auto& deferred : deferredVbs) {
+        if (now >= deferred.second) {
+            lpVbs.push(deferred.first);
+        }
+    }
+}
+
+bool Flusher::deferVBStateCommit(Vbid vbid) {
+    const auto delay = store->getFlusherVBStateDelay();
+    if (delay.count() == 0 || _state != State::Running) {
+        return false;
+    }
+
+    bool first;
+    {
+        std::lock_guard<std::mutex> lh(vbStateMutex);
+        // The deadline is fixed when first deferred, so a state is left
+        // uncommitted for at most the delay.
+        first = deferredVBStates
+                        .emplace(vbid,
+                                 std::chrono::steady_clock::now() + delay)
+                        .second;
+    }
+    ++store->getEPEngine().getEpStats().flusherVBStateDeferrals;
+    if (first) {
+        // If deferred by a dispatched flush the flusher task may be asleep;
+        // make sure it wakes by the deadline.
+        wake();
+    }
+    return true;
+}
+
+bool Flusher::vbStateCommitted(Vbid vbid) {
+    std::lock_guard<std::mutex> lh(vbStateMutex);
+    return deferredVBStates.erase(vbid) != 0;
+}
+
+void Flusher::commitDeferredVBStates(bool force) {
+    std::vector<Vbid> due;
+    {
+        std::lock_guard<std::mutex> lh(vbStateMutex);
+        if (deferredVBStates.empty()) {
+            return;
+        }
+        if (!force) {
+            const auto now = std::chrono::steady_clock::now();
+            if (std::none_of(deferredVBStates.begin(),
+                             deferredVBStates.end(),
+                             [now](const auto& deferred) {
+                                 return now >= deferred.second;
+                             })) {
+                return;
+            }
+        }
+        for (const auto& deferred : deferredVBStates) {
+            due.push_back(deferred.first);
+        }
+        deferredVBStates.clear();
+    }
+
+    for (auto vbid : due) {
+        if (!store->commitDeferredVBState(vbid)) {
+            // Retry on the next pass.
+            std::lock_guard<std::mutex> lh(vbStateMutex);
+            deferredVBStates.emplace(vbid, std::chrono::steady_clock::now());
+        }
+    }
+}
+
+std::chrono::steady_clock::time_point Flusher::getVBStateDeadline() {
+    std::lock_guard<std::mutex> lh(vbStateMutex);
+    auto deadline = std::chrono::steady_clock::time_point::max();
+    for (const auto& deferred : deferredVBStates) {
+        deadline = std::min(deadline, deferred.second);
+    }
+    return deadline;
+}
+
+bool Flusher::isDispatched(Vbid vbid) {
+    std::lock_guard<std::mutex> lh(dispatchMutex);
+    if (dispatchedVbs.count(vbid)) {
+        redispatchVbs.insert(vbid);
+        return true;
+    }
+    return false;
+}
+
+bool Flusher::dispatchFlush(Vbid vbid) {
+    // Only the flusher task dispatches, so the vBucket can't be dispatched
+    // between the check and taking the lock.
+    if (isDispatched(vbid)) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lh(dispatchMutex);
+    // Keep one of the flusher_concurrency flushes for the flusher task.
+    if (_state != State::Running ||
+        dispatchedVbs.size() + 1 >= store->getFlusherConcurrency() ||
+        store->isDeleteAllScheduled() ||
+        !store->getStorageProperties().hasConcurrentFlush()) {
+        return false;
+    }
+
+    dispatchedVbs.insert(vbid);
+    ExTask task = std::make_shared<FlushVBucketTask>(
+            ObjectRegistry::getCurrentEngine(), this, vbid);
+    task->setNumaNode(shard->getNumaNode());
+    ExecutorPool::get()->schedule(task);
+    return true;
+}
+
+void Flusher::flushDispatched(Vbid vbid) {
+    // A delete-all is flushed by the flusher task alone; hand the vBucket
+    // back to it.
+    const bool moreAvailable = store->isDeleteAllScheduled() ||
+                               store->flushVBucket(vbid).first;
+    {
+        std::lock_guard<std::mutex> lh(dispatchMutex);
+        dispatchedVbs.erase(vbid);
+        const bool redispatch = redispatchVbs.erase(vbid) != 0;
+        if (!moreAvailable && !redispatch) {
+            return;
+        }
+        completedDispatches.push_back(vbid);
+    }
+    wake();
+}
+
+void Flusher::queueCompletedDispatches() {
+    std::lock_guard<std::mutex> lh(dispatchMutex);
+    for (auto vbid : completedDispatches) {
+        lpVbs.push(vbid);
+    }
+    completedDispatches.clear();
+}
+
+bool Flusher::hasCompletedDispatches() {
+    std::lock_guard<std::mutex> lh(dispatchMutex);
+    return !completedDispatches.empty();
+}
+
+bool Flusher::hasDispatchedFlushes() {
+    std::lock_guard<std::mutex> lh(dispatchMutex);
+    return !dispatchedVbs.empty();
 }
 
 void Flusher::flushVB(void) {
@@ -257,6 +495,9 @@ void Flusher::flushVB(void) {
         return;
     }
 
+    queueCompletedDispatches();
+    commitDeferredVBStates(false);
+
     // If the low-priority vBucket queue is empty, see if there's any
     // pending mutations - and if so re-populate the low pri queue.
     if (lpVbs.empty()) {
@@ -265,9 +506,19 @@ void Flusher::flushVB(void) {
         }
         bool inverse = true;
         if (pendingMutation.compare_exchange_strong(inverse, false)) {
-            for (auto vbid : shard->getVBucketsSortedByState()) {
+            // vBuckets with SyncWrites in flight go first: their
+            // persistence (and, at a replica, the seqno ack which follows
+            // it) is on the durable writes' critical path.
+            auto vbs = shard->getVBucketsSortedByState();
+            std::stable_partition(vbs.begin(), vbs.end(), [this](Vbid vbid) {
+                auto vb = store->getVBucket(vbid);
+                return vb && vb->hasTrackedSyncWrites();
+            });
+            for (auto vbid : vbs) {
                 lpVbs.push(vbid);
             }
+        } else {
+            queueExpiredDeferredVbs();
         }
     }
 
@@ -290,6 +541,9 @@ void Flusher::flushVB(void) {
     } else if (!hpVbs.empty()) {
         Vbid vbid = hpVbs.front();
         hpVbs.pop();
+        if (isDispatched(vbid)) {
+            return;
+        }
         if (store->flushVBucket(vbid).first) {
             // More items still available, add vbid back to pending set.
             hpVbs.push(vbid);
@@ -300,6 +554,9 @@ void Flusher::flushVB(void) {
         }
         Vbid vbid = lpVbs.front();
         lpVbs.pop();
+        if (deferFlush(vbid) || dispatchFlush(vbid)) {
+            return;
+        }
         if (store->flushVBucket(vbid).first) {
             // More items still available, add vbid back to pending set.
             lpVbs.push(vbid);
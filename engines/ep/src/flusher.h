@@ -21,10 +21,14 @@
 
 #include <memcached/vbucket.h>
 
+#include <chrono>
 #include <list>
 #include <map>
+#include <mutex>
 #include <queue>
+#include <set>
 #include <string>
+#include <vector>
 
 #define NO_VBUCKETS_INSTANTIATED 0xFFFF
 #define RETRY_FLUSH_VBUCKET (-1)
@@ -37,6 +41,27 @@ class KVShard;
 
 /**
  * Manage persistence of data for an EPBucket.
+ *
+ * Each commit to disk costs (at least) one fsync, so flushing vBuckets which
+ * only have a handful of outstanding items is expensive. When
+ * flusher_batch_delay is non-zero, the flush of a (low priority) vBucket
+ * with fewer than flusher_batch_min_items outstanding items is deferred for
+ * up to that delay, allowing further mutations to accumulate and be written
+ * in a single commit.
+ *
+ * A shard's vBuckets are flushed by its FlusherTask, one at a time. When
+ * flusher_concurrency is greater than one (and the KVStore supports
+ * concurrent flushes), the FlusherTask instead hands (low priority)
+ * vBuckets to FlushVBucketTasks, so up to that many of the shard's
+ * vBuckets are flushed at once by different writer threads; a vBucket is
+ * only ever flushed by one task at a time.
+ *
+ * A vBucket state change (e.g. during rebalance) with no data to go with it
+ * also costs an fsync when committed on its own. When flusher_vbstate_delay
+ * is non-zero its commit is deferred: if the vBucket is flushed again in the
+ * meantime the state is written by that commit, otherwise all of the shard's
+ * deferred states are committed back to back once the earliest deadline
+ * passes.
  */
 class Flusher {
 public:
@@ -65,6 +90,31 @@ public:
     }
     void setTaskId(size_t newId) { taskId = newId; }
 
+    /**
+     * Flush the given vBucket, handed to a FlushVBucketTask by
+     * dispatchFlush(). Once done the vBucket is queued for the flusher task
+     * again if it still has items to flush.
+     */
+    void flushDispatched(Vbid vbid);
+
+    /**
+     * Defer the commit of the given vBucket's state change, which has no
+     * data to be written with it, if flusher_vbstate_delay allows. Called
+     * by EPBucket::flushVBucket, possibly from a FlushVBucketTask.
+     *
+     * @return true if deferred; the flusher task commits it (with the
+     *         shard's other deferred states) by the deadline, unless
+     *         vbStateCommitted() is called first.
+     */
+    bool deferVBStateCommit(Vbid vbid);
+
+    /**
+     * The given vBucket's state has been written by a commit.
+     *
+     * @return true if its commit was deferred.
+     */
+    bool vbStateCommitted(Vbid vbid);
+
 private:
     enum class State {
         Initializing,
@@ -86,9 +136,72 @@ private:
     const char* stateName(State st) const;
 
     bool canSnooze(void) {
-        return lpVbs.empty() && hpVbs.empty() && !pendingMutation.load();
+        return lpVbs.empty() && hpVbs.empty() && !pendingMutation.load() &&
+               !hasCompletedDispatches();
     }
 
+    /**
+     * Is the given vBucket being flushed by a FlushVBucketTask? If so notes
+     * that it must be flushed again once that completes.
+     */
+    bool isDispatched(Vbid vbid);
+
+    /**
+     * Hand the flush of the given vBucket to a FlushVBucketTask if
+     * flusher_concurrency allows (see also isDispatched()).
+     *
+     * @return true if the flusher task shouldn't flush the vBucket itself.
+     */
+    bool dispatchFlush(Vbid vbid);
+
+    /// Queue the vBuckets whose dispatched flush completed with more to do.
+    void queueCompletedDispatches();
+
+    bool hasCompletedDispatches();
+    bool hasDispatchedFlushes();
+
+    /**
+     * Should the flush of the given (low priority) vBucket be deferred to
+     * allow more items to accumulate (flusher_batch_delay), or more updates
+     * of its hot keys to be de-duplicated (flusher_hot_key_delay)? If so
+     * records the deadline by which it must be flushed.
+     */
+    bool deferFlush(Vbid vbid);
+
+    /// Queue any deferred vBuckets whose deadline has passed for flushing.
+    void queueExpiredDeferredVbs();
+
+    /**
+     * Commit the deferred vBucket states if the earliest deadline has passed
+     * (or if force), one after another so their fsyncs share the same
+     * window.
+     */
+    void commitDeferredVBStates(bool force);
+
+    /// @return the earliest deadline of the deferred vBucket states.
+    std::chrono::steady_clock::time_point getVBStateDeadline();
+
+    /// Guards deferredVBStates, as flushes may be dispatched.
+    std::mutex vbStateMutex;
+    /// vBuckets whose state change is yet to be committed, and the time by
+    /// which each must be.
+    std::map<Vbid, std::chrono::steady_clock::time_point> deferredVBStates;
+
+    /// vBuckets whose flush has been deferred, and the time by which each
+    /// must be flushed.
+    std::map<Vbid, std::chrono::steady_clock::time_point> deferredVbs;
+
+    /// Guards the dispatch state below, shared with FlushVBucketTasks.
+    std::mutex dispatchMutex;
+    /// vBuckets being flushed by FlushVBucketTasks.
+    std::set<Vbid> dispatchedVbs;
+    /// Dispatched vBuckets which must be flushed again once their flush has
+    /// completed, as they were found to be pending in the meantime.
+    std::set<Vbid> redispatchVbs;
+    /// vBuckets whose dispatched flush has completed, which still need
+    /// flushing.
+    std::vector<Vbid> completedDispatches;
+
     EPBucket* store;
     std::atomic<State> _state;
 
@@ -28,8 +28,11 @@
 
 #include <algorithm>
 #include <chrono>
+#include <deque>
+#include <iterator>
+#include <limits>
 #include <mutex>
-#include <queue>
+#include <unordered_map>
 
 #include "globaltask.h"
 
@@ -99,41 +102,97 @@ public:
 protected:
 
     /*
-     * HeapifiableQueue exposes a method to maintain the heap ordering
-     * of the underlying queue.
+     * HeapifiableQueue is a binary heap (laid out as std::push_heap et al.
+     * do, so it's also a valid std::priority_queue) which additionally
+     * tracks the position of each task in it. That makes re-ordering a
+     * task after its wakeTime changed O(log n) - a sift up or down from
+     * where it is - rather than a linear search for it followed by
+     * rebuilding the whole heap.
      *
      * This class is deliberately hidden inside FutureQueue so that any
-     * extensions made to priority_queue can't be accessed without work.
-     * I.e. correct locking and any need to 'heapify'.
+     * extensions can't be accessed without work. I.e. correct locking and
+     * any need to 'heapify'.
      */
-    class HeapifiableQueue : public std::priority_queue<ExTask, C, Compare> {
+    class HeapifiableQueue {
     public:
+        void push(ExTask task) {
+            c.push_back(std::move(task));
+            const size_t pos = c.size() - 1;
+            auto& location = locations[c[pos]->getId()];
+            if (++location.count == 1) {
+                location.pos = pos;
+            } else {
+                location.pos = npos;
+            }
+            siftUp(pos);
+        }
+
+        void pop() {
+            swapEntries(0, c.size() - 1);
+            auto it = locations.find(c.back()->getId());
+            if (--it->second.count == 0) {
+                locations.erase(it);
+            } else {
+                // We no longer know which copy is where
+                it->second.pos = npos;
+            }
+            c.pop_back();
+            if (!c.empty()) {
+                siftDown(0);
+            }
+        }
+
+        const ExTask& top() const {
+            return c.front();
+        }
+
+        size_t size() const {
+            return c.size();
+        }
+
+        bool empty() const {
+            return c.empty();
+        }
+
         /*
-         * Ensure the heap property is maintained
+         * Ensure the heap property is maintained after task's wakeTime
+         * changed.
          * @returns true if 'task' is in the queue and heapify() did something.
          */
         bool heapify(const ExTask& task) {
-            // if the task exists, rebuild
-            if (exists(task)) {
-                if (this->c.back()->getId() == task->getId()) {
-                    std::push_heap(this->c.begin(),
-                                   this->c.end(),
-                                   this->comp);
-                } else {
-                    std::make_heap(this->c.begin(),
-                                   this->c.end(),
-                                   this->comp);
+            auto it = locations.find(task->getId());
+            if (it == locations.end()) {
+                return false;
+            }
+
+            if (it->second.count > 1) {
+                // The same task is queued more than once; rebuild the heap
+                // (and every position) the slow way.
+                std::make_heap(c.begin(), c.end(), comp);
+                for (size_t ii = 0; ii < c.size(); ++ii) {
+                    setPosition(ii);
                 }
                 return true;
-            } else {
-                return false;
             }
+
+            if (it->second.pos == npos) {
+                // Lost track of it when its duplicates were popped
+                it->second.pos = std::distance(
+                        c.begin(),
+                        std::find_if(c.begin(),
+                                     c.end(),
+                                     [&task](const ExTask& qTask) {
+                                         return task->getId() ==
+                                                qTask->getId();
+                                     }));
+            }
+            siftDown(siftUp(it->second.pos));
+            return true;
         }
 
         void verifyHeapProperty() {
-            auto heap_end = std::is_heap_until(
-                    this->c.begin(), this->c.end(), this->comp);
-            if (heap_end != this->c.end()) {
+            auto heap_end = std::is_heap_until(c.begin(), c.end(), comp);
+            if (heap_end != c.end()) {
                 std::string msg;
                 msg += "FutureQueue::verifyHeapProperty() - heap invariant "
                        "broken. First non-heap is task:" +
@@ -143,7 +202,7 @@ protected:
                                        .count()) +
                        "\nAll items:\n";
 
-                for (auto& task : this->c) {
+                for (auto& task : c) {
                     msg += "\t task:" + task->getDescription() + " wake:" +
                            std::to_string(to_ns_since_epoch(task->getWaketime())
                                                   .count()) +
@@ -154,14 +213,66 @@ protected:
         }
 
     protected:
-        bool exists(const ExTask& task) {
-            return std::find_if(this->c.begin(),
-                                this->c.end(),
-                                [&task](const ExTask& qTask) {
-                                    return task->getId() == qTask->getId();
-                                }) != this->c.end();
+        static const size_t npos = std::numeric_limits<size_t>::max();
+
+        /// Where a task is in the heap
+        struct Location {
+            /// Number of copies of the task in the heap
+            size_t count = 0;
+            /// Its index in c if there's only one copy and it's known,
+            /// otherwise npos
+            size_t pos = npos;
+        };
+
+        void setPosition(size_t pos) {
+            auto& location = locations.find(c[pos]->getId())->second;
+            if (location.count == 1) {
+                location.pos = pos;
+            }
+        }
+
+        void swapEntries(size_t a, size_t b) {
+            std::swap(c[a], c[b]);
+            setPosition(a);
+            setPosition(b);
+        }
+
+        /// Move the task at pos up towards the top as far as it should go
+        /// @returns the task's new position
+        size_t siftUp(size_t pos) {
+            while (pos > 0) {
+                const size_t parent = (pos - 1) / 2;
+                if (!comp(c[parent], c[pos])) {
+                    break;
+                }
+                swapEntries(parent, pos);
+                pos = parent;
+            }
+            return pos;
+        }
+
+        /// Move the task at pos down away from the top as far as it should go
+        void siftDown(size_t pos) {
+            const size_t size = c.size();
+            for (;;) {
+                size_t child = (2 * pos) + 1;
+                if (child >= size) {
+                    return;
+                }
+                if (child + 1 < size && comp(c[child], c[child + 1])) {
+                    ++child;
+                }
+                if (!comp(c[pos], c[child])) {
+                    return;
+                }
+                swapEntries(pos, child);
+                pos = child;
+            }
         }
 
+        C c;
+        Compare comp;
+        std::unordered_map<size_t, Location> locations;
     } queue;
 
     // All access to queue must be done with the queueMutex
@@ -16,10 +16,17 @@
  */
 
 #include <limits.h>
+#include <limits>
 
 #include "ep_engine.h"
 #include "globaltask.h"
 
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
 // These static_asserts previously were in priority_test.cc
 static_assert(TaskPriority::VKeyStatBGFetchTask < TaskPriority::FlusherTask,
               "VKeyStatBGFetchTask not less than FlusherTask");
@@ -29,6 +36,36 @@ static_assert(TaskPriority::ItemPager < TaskPriority::BackfillManagerTask,
 
 std::atomic<size_t> GlobalTask::task_id_counter(1);
 
+/// The CPU budget of each task type, in microseconds (0 = no budget).
+static std::array<std::atomic<int64_t>, NUM_TASK_GROUPS> cpuBudgets;
+
+/// The thread CPU time (ns) at which the task this thread is running
+/// started its current run, and at which it will have used up its budget.
+static thread_local int64_t runCpuStart = 0;
+static thread_local int64_t runCpuDeadline =
+        std::numeric_limits<int64_t>::max();
+
+/// The CPU time the calling thread has used, in nanoseconds.
+static int64_t getThreadCpuTime() {
+#ifdef WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    const auto toInt = [](const FILETIME& ft) {
+        return (int64_t(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+    };
+    // FILETIME is in units of 100ns
+    return (toInt(kernel) + toInt(user)) * 100;
+#else
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+        return 0;
+    }
+    return (int64_t(ts.tv_sec) * 1000000000) + ts.tv_nsec;
+#endif
+}
+
 GlobalTask::GlobalTask(Taskable& t,
                        TaskId taskId,
                        double initialSleepTime,
@@ -41,7 +78,8 @@ GlobalTask::GlobalTask(Taskable& t,
       taskable(t),
       totalRuntime(0),
       previousRuntime(0),
-      lastStartTime(0) {
+      lastStartTime(0),
+      totalCpuTime(0) {
     priority = getTaskPriority(taskId);
     snooze(initialSleepTime);
 }
@@ -78,6 +116,33 @@ void GlobalTask::wakeUp() {
     updateWaketime(std::chrono::steady_clock::now());
 }
 
+void GlobalTask::startCpuBudget() {
+    runCpuStart = getThreadCpuTime();
+    const int64_t budget = cpuBudgets[getTaskType(taskId)];
+    runCpuDeadline = budget ? runCpuStart + (budget * 1000)
+                            : std::numeric_limits<int64_t>::max();
+}
+
+void GlobalTask::stopCpuBudget() {
+    totalCpuTime += getThreadCpuTime() - runCpuStart;
+    runCpuDeadline = std::numeric_limits<int64_t>::max();
+}
+
+bool GlobalTask::isCpuBudgetExhausted() {
+    const int64_t deadline = runCpuDeadline;
+    return deadline != std::numeric_limits<int64_t>::max() &&
+           getThreadCpuTime() >= deadline;
+}
+
+void GlobalTask::setCpuBudget(task_type_t type,
+                              std::chrono::microseconds budget) {
+    cpuBudgets.at(type) = budget.count();
+}
+
+std::chrono::microseconds GlobalTask::getCpuBudget(task_type_t type) {
+    return std::chrono::microseconds(cpuBudgets.at(type));
+}
+
 /*
  * Generate a switch statement from tasks.def.h that maps TaskId to a
  * stringified value of the task's name.
@@ -56,6 +56,7 @@ class GlobalTask {
     friend class CompareByPriority;
     friend class ExecutorPool;
     friend class ExecutorThread;
+    friend class TaskQueue;
 public:
 
     GlobalTask(Taskable& t,
@@ -218,6 +219,60 @@ public:
         return static_cast<queue_priority_t>(priority);
     }
 
+    /**
+     * Set the NUMA node this task would prefer to run on (-1 for none).
+     * Threads bound to another node leave a ready task with a preference
+     * to the threads of its node, for as long as they have another task of
+     * the same priority to run instead (see TaskQueue).
+     */
+    void setNumaNode(int node) {
+        numaNode = node;
+    }
+
+    int getNumaNode() const {
+        return numaNode;
+    }
+
+    /// Total CPU time the task's runs have used (see startCpuBudget())
+    std::chrono::nanoseconds getTotalCpuTime() const {
+        return std::chrono::nanoseconds(totalCpuTime);
+    }
+
+    /**
+     * Start accounting the CPU time the calling thread spends in this task
+     * against the CPU budget of its task type. Called by the ExecutorThread
+     * immediately before run().
+     */
+    void startCpuBudget();
+
+    /**
+     * Stop accounting CPU time started by startCpuBudget(), adding the CPU
+     * time used to the task's total. Called by the ExecutorThread
+     * immediately after run().
+     */
+    void stopCpuBudget();
+
+    /**
+     * Has the task running on the calling thread used up the CPU budget of
+     * its task type in its current run()?
+     *
+     * This is the signal long-running tasks (and the visitors they drive)
+     * use to decide when to pause and snooze, so that they don't hold a
+     * thread for long while other tasks of the same type are waiting.
+     * Always false if the task type has no budget, or if the caller isn't
+     * running a task on an ExecutorThread (e.g. a test calling run()).
+     */
+    static bool isCpuBudgetExhausted();
+
+    /**
+     * Set the CPU time a single run() of a task of the given type may use
+     * before isCpuBudgetExhausted() returns true; zero means no budget.
+     */
+    static void setCpuBudget(task_type_t type,
+                             std::chrono::microseconds budget);
+
+    static std::chrono::microseconds getCpuBudget(task_type_t type);
+
     /*
      * Lookup the task name for TaskId id.
      * The data used is generated from tasks.def.h
@@ -278,6 +333,13 @@ protected:
     atomic_duration totalRuntime;
     atomic_duration previousRuntime;
     atomic_time_point lastStartTime;
+    atomic_duration totalCpuTime;
+
+    std::atomic<int> numaNode{-1};
+    /// Has a thread of another NUMA node already left this task for one of
+    /// the numaNode's threads since it became ready? (guarded by the
+    /// TaskQueue's mutex)
+    bool passedOverForNumaNode = false;
 
 private:
     atomic_time_point waketime; // used for priority_queue
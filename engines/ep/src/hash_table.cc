@@ -18,14 +18,17 @@
 #include "hash_table.h"
 
 #include "item.h"
+#include "objectregistry.h"
 #include "stats.h"
 #include "stored_value_factories.h"
 
 #include <folly/lang/Assume.h>
 #include <phosphor/phosphor.h>
 #include <platform/compress.h>
+#include <platform/crc32c.h>
 
 #include <logtags.h>
+#include <cmath>
 #include <cstring>
 
 static const ssize_t prime_size_table[] = {
@@ -88,10 +91,18 @@ std::ostream& operator<<(std::ostream& os, const HashTable::Position& pos) {
 HashTable::HashTable(EPStats& st,
                      std::unique_ptr<AbstractStoredValueFactory> svFactory,
                      size_t initialSize,
-                     size_t locks)
+                     size_t locks,
+                     Layout layout,
+                     HashAlgorithm hashAlgorithm,
+                     size_t evictedMetaIndexSize,
+                     bool sharedReaderLocks)
     : initialSize(initialSize),
+      layout(layout),
+      hashAlgorithm(hashAlgorithm),
       size(initialSize),
+      resizeCursor(locks),
       mutexes(locks),
+      sharedReaderLocks(sharedReaderLocks),
       stats(st),
       valFact(std::move(svFactory)),
       visitors(0),
@@ -99,11 +110,57 @@ HashTable::HashTable(EPStats& st,
       numEjects(0),
       numResizes(0),
       maxDeletedRevSeqno(0),
+      evictedMeta(evictedMetaIndexSize),
       probabilisticCounter(freqCounterIncFactor) {
+    MemoryDomainGuard guard(MemoryDomain::HashTable);
     values.resize(size);
+    decayEpochs.resize(size);
+    for (auto& mutex : mutexes) {
+        mutex.setSharedReaders(sharedReaderLocks);
+    }
+    if (layout == Layout::Bucketed) {
+        bucketTags.resize(size);
+        refreshAllBucketTags();
+    }
     activeState = true;
 }
 
+HashTable::Layout HashTable::layoutFromString(const std::string& layout) {
+    if (layout == "chained") {
+        return Layout::Chained;
+    }
+    if (layout == "bucketed") {
+        return Layout::Bucketed;
+    }
+    throw std::invalid_argument(
+            "HashTable::layoutFromString: unknown layout '" + layout + "'");
+}
+
+HashTable::HashAlgorithm HashTable::hashAlgorithmFromString(
+        const std::string& algorithm) {
+    if (algorithm == "djb") {
+        return HashAlgorithm::Djb;
+    }
+    if (algorithm == "crc32c") {
+        return HashAlgorithm::Crc32c;
+    }
+    throw std::invalid_argument(
+            "HashTable::hashAlgorithmFromString: unknown algorithm '" +
+            algorithm + "'");
+}
+
+uint32_t HashTable::crc32cHash(const uint8_t* data,
+                               size_t size,
+                               DocKeyEncodesCollectionId encoding) {
+    uint32_t crc = 0;
+    if (encoding == DocKeyEncodesCollectionId::No) {
+        // Hash as if the key had the DefaultCollection prefix, so it matches
+        // the same key stored in the HashTable.
+        crc = crc32c(&DefaultCollectionLeb128Encoded, 1, crc);
+    }
+    return crc32c(data, size, crc);
+}
+
 HashTable::~HashTable() {
     // Use unlocked clear for the destructor, avoids lock inversions on VBucket
     // delete
@@ -112,6 +169,13 @@ HashTable::~HashTable() {
     while (visitors > 0) {
         std::this_thread::sleep_for(std::chrono::microseconds(100));
     }
+    // Release the (now empty) bucket arrays here rather than when the members
+    // are destroyed, so they're credited to the domain they were charged to.
+    MemoryDomainGuard guard(MemoryDomain::HashTable);
+    table_type().swap(values);
+    table_type().swap(resizeValues);
+    BucketTagsVector().swap(bucketTags);
+    BucketTagsVector().swap(resizeBucketTags);
 }
 
 void HashTable::cleanupIfTemporaryItem(const HashBucketLock& hbl,
@@ -129,7 +193,7 @@ void HashTable::clear(bool deactivate) {
                     "non-active object");
         }
     }
-    MultiLockHolder mlh(mutexes);
+    MultiLockHolder<StripeMutex> mlh(mutexes);
     clear_UNLOCKED(deactivate);
 }
 
@@ -139,21 +203,28 @@ void HashTable::clear_UNLOCKED(bool deactivate) {
     }
     size_t clearedMemSize = 0;
     size_t clearedValSize = 0;
-    for (int i = 0; i < (int)size; i++) {
-        while (values[i]) {
+    for (int i = 0; i < static_cast<int>(getNumBuckets()); i++) {
+        auto& chain = chainHead(i);
+        while (chain) {
             // Take ownership of the StoredValue from the vector, update
             // statistics and release it.
-            auto v = std::move(values[i]);
+            auto v = std::move(chain);
             clearedMemSize += v->size();
             clearedValSize += v->valuelen();
-            values[i] = std::move(v->getNext());
+            chain = std::move(v->getNext());
         }
     }
+    if (resizing) {
+        // Nothing left to migrate; simply discard the new table.
+        abandonIncrementalResize_UNLOCKED();
+    }
+    refreshAllBucketTags();
 
     stats.coreLocal.get()->currentSize.fetch_sub(clearedMemSize -
                                                  clearedValSize);
 
     valueStats.reset();
+    evictedMeta.clear();
 }
 
 static size_t distance(size_t a, size_t b) {
@@ -170,6 +241,10 @@ static bool isCurrently(size_t size, ssize_t a, ssize_t b) {
 }
 
 void HashTable::resize() {
+    resize(getPreferredSize());
+}
+
+size_t HashTable::getPreferredSize() const {
     size_t ni = getNumInMemoryItems();
     int i(0);
     size_t new_size(0);
@@ -197,7 +272,7 @@ void HashTable::resize() {
         new_size = nearest(ni, prime_size_table[i-1], prime_size_table[i]);
     }
 
-    resize(new_size);
+    return new_size;
 }
 
 void HashTable::resize(size_t newSize) {
@@ -213,14 +288,15 @@ void HashTable::resize(size_t newSize) {
     }
 
     // Don't resize to the same size, either.
-    if (newSize == size) {
+    if (newSize == size && !resizing) {
         return;
     }
 
     TRACE_EVENT2(
             "HashTable", "resize", "size", size.load(), "newSize", newSize);
 
-    MultiLockHolder mlh(mutexes);
+    MemoryDomainGuard guard(MemoryDomain::HashTable);
+    MultiLockHolder<StripeMutex> mlh(mutexes);
     if (visitors.load() > 0) {
         // Do not allow a resize while any visitors are actually
         // processing.  The next attempt will have to pick it up.  New
@@ -229,12 +305,30 @@ void HashTable::resize(size_t newSize) {
         return;
     }
 
+    if (resizing) {
+        // We need exclusive use of the current table; finish off the
+        // incremental resize before starting this one.
+        completeIncrementalResize_UNLOCKED();
+        if (newSize == size) {
+            return;
+        }
+    }
+
     // Get a place for the new items.
     table_type newValues(newSize);
 
     stats.coreLocal.get()->memOverhead.fetch_sub(memorySize());
     ++numResizes;
 
+    // Bring every bucket up to the current decay epoch, so the new buckets
+    // all start from it.
+    const uint32_t epoch = freqDecayEpoch;
+    for (size_t i = 0; i < size; i++) {
+        if (decayEpochs[i] != epoch) {
+            decayBucket_UNLOCKED(i, epoch);
+        }
+    }
+
     // Set the new size so all the hashy stuff works.
     size_t oldSize = size;
     size.store(newSize);
@@ -247,7 +341,7 @@ void HashTable::resize(size_t newSize) {
             values[i] = std::move(v->getNext());
 
             // And re-link it into the correct place in newValues.
-            int newBucket = getBucketForHash(v->getKey().hash());
+            int newBucket = getBucketForHash(hashKey(v->getKey()));
             v->setNext(std::move(newValues[newBucket]));
             newValues[newBucket] = std::move(v);
         }
@@ -255,10 +349,193 @@ void HashTable::resize(size_t newSize) {
 
     // Finally assign the new table to values.
     values = std::move(newValues);
+    decayEpochs.assign(newSize, epoch);
+    decayEpochs.shrink_to_fit();
+    if (layout == Layout::Bucketed) {
+        bucketTags.resize(newSize);
+        bucketTags.shrink_to_fit();
+        refreshAllBucketTags();
+    }
 
     stats.coreLocal.get()->memOverhead.fetch_add(memorySize());
 }
 
+bool HashTable::resizeIncrementally(size_t maxBuckets) {
+    if (!isActive()) {
+        throw std::logic_error(
+                "HashTable::resizeIncrementally: Cannot call on a "
+                "non-active object");
+    }
+    if (maxBuckets == 0) {
+        throw std::invalid_argument(
+                "HashTable::resizeIncrementally: maxBuckets must be non-zero");
+    }
+
+    MemoryDomainGuard guard(MemoryDomain::HashTable);
+
+    const size_t numLocks = mutexes.size();
+    if (!resizing) {
+        // Round up to a multiple of the lock count, so each key is guarded by
+        // the same lock in both the current and new table.
+        auto newSize = getPreferredSize();
+        newSize = ((newSize + numLocks - 1) / numLocks) * numLocks;
+        if (newSize > static_cast<size_t>(std::numeric_limits<int>::max()) ||
+            newSize == size) {
+            return false;
+        }
+        if (size % numLocks != 0) {
+            // Cannot migrate incrementally from the current size; perform a
+            // one-off blocking resize to a suitable size instead.
+            resize(newSize);
+            return false;
+        }
+
+        // Allocate the new table before acquiring any locks.
+        table_type newValues(newSize);
+
+        MultiLockHolder<StripeMutex> mlh(mutexes);
+        if (visitors.load() > 0 || resizing) {
+            return resizing;
+        }
+        TRACE_EVENT2("HashTable",
+                     "beginIncrementalResize",
+                     "size",
+                     size.load(),
+                     "newSize",
+                     newSize);
+        beginIncrementalResize_UNLOCKED(std::move(newValues));
+    }
+
+    TRACE_EVENT1("HashTable", "resizeIncrementally", "maxBuckets", maxBuckets);
+
+    bool complete = true;
+    for (size_t lock = 0; lock < numLocks; ++lock) {
+        // Acquire mutexes[0] before checking {visitors} (and hold it until the
+        // stripe's lock is acquired) - this is the same mutex visitors acquire
+        // when registering themselves, so no visitor can start part way
+        // through a visit while we might move items from a visited bucket
+        // into one not yet visited.
+        std::unique_lock<StripeMutex> visitorGuard(mutexes[0]);
+        if (visitors.load() > 0 || !resizing) {
+            return resizing;
+        }
+        std::unique_lock<StripeMutex> stripeLock;
+        if (lock != 0) {
+            stripeLock = std::unique_lock<StripeMutex>(mutexes[lock]);
+            visitorGuard.unlock();
+        }
+
+        size_t bucket = resizeCursor[lock];
+        for (size_t migrated = 0; bucket < size && migrated < maxBuckets;
+             ++migrated, bucket += numLocks) {
+            migrateBucket_UNLOCKED(bucket);
+            resizeCursor[lock] = bucket + numLocks;
+        }
+        if (bucket < size) {
+            complete = false;
+        }
+    }
+
+    if (!complete) {
+        return true;
+    }
+
+    MultiLockHolder<StripeMutex> mlh(mutexes);
+    if (visitors.load() > 0) {
+        // Switching tables changes bucket numbering; wait for any visitors
+        // to finish.
+        return resizing;
+    }
+    if (resizing) {
+        completeIncrementalResize_UNLOCKED();
+    }
+    return false;
+}
+
+void HashTable::beginIncrementalResize_UNLOCKED(table_type newValues) {
+    Expects(!resizing);
+    Expects(size % mutexes.size() == 0);
+    Expects(newValues.size() % mutexes.size() == 0);
+
+    stats.coreLocal.get()->memOverhead.fetch_sub(memorySize());
+
+    resizeSize = newValues.size();
+    resizeValues = std::move(newValues);
+    resizeDecayEpochs.assign(resizeSize, freqDecayEpoch);
+    if (layout == Layout::Bucketed) {
+        resizeBucketTags.resize(resizeSize);
+    }
+    for (size_t lock = 0; lock < resizeCursor.size(); ++lock) {
+        resizeCursor[lock] = lock;
+    }
+    resizing = true;
+
+    stats.coreLocal.get()->memOverhead.fetch_add(memorySize());
+}
+
+void HashTable::migrateBucket_UNLOCKED(size_t bucket_num) {
+    // Decay both the old chain and each new one to the same epoch before
+    // merging them.
+    const uint32_t epoch = freqDecayEpoch;
+    if (decayEpochs[bucket_num] != epoch) {
+        decayBucket_UNLOCKED(bucket_num, epoch);
+    }
+
+    auto& oldChain = values[bucket_num];
+    while (oldChain) {
+        // unlink the front element from the old chain...
+        auto v = std::move(oldChain);
+        oldChain = std::move(v->getNext());
+
+        // ...and re-link it into the correct place in the new table.
+        const int h = hashKey(v->getKey());
+        const int newBucket = abs(h % static_cast<int>(resizeSize));
+        if (resizeDecayEpochs[newBucket] != epoch) {
+            decayBucket_UNLOCKED(size + newBucket, epoch);
+        }
+        v->setNext(std::move(resizeValues[newBucket]));
+        resizeValues[newBucket] = std::move(v);
+        refreshBucketTags(size + newBucket);
+    }
+    refreshBucketTags(bucket_num);
+}
+
+void HashTable::completeIncrementalResize_UNLOCKED() {
+    Expects(resizing);
+    for (size_t lock = 0; lock < resizeCursor.size(); ++lock) {
+        for (size_t bucket = resizeCursor[lock]; bucket < size;
+             bucket += mutexes.size()) {
+            migrateBucket_UNLOCKED(bucket);
+        }
+        resizeCursor[lock] = size;
+    }
+
+    stats.coreLocal.get()->memOverhead.fetch_sub(memorySize());
+    ++numResizes;
+
+    values = std::move(resizeValues);
+    resizeValues = table_type();
+    bucketTags = std::move(resizeBucketTags);
+    resizeBucketTags = BucketTagsVector();
+    decayEpochs = std::move(resizeDecayEpochs);
+    resizeDecayEpochs = std::vector<uint32_t>();
+    size.store(resizeSize);
+    resizing = false;
+
+    stats.coreLocal.get()->memOverhead.fetch_add(memorySize());
+}
+
+void HashTable::abandonIncrementalResize_UNLOCKED() {
+    Expects(resizing);
+    MemoryDomainGuard guard(MemoryDomain::HashTable);
+    stats.coreLocal.get()->memOverhead.fetch_sub(memorySize());
+    resizing = false;
+    resizeValues = table_type();
+    resizeBucketTags = BucketTagsVector();
+    resizeDecayEpochs = std::vector<uint32_t>();
+    stats.coreLocal.get()->memOverhead.fetch_add(memorySize());
+}
+
 HashTable::FindResult HashTable::find(const DocKey& key,
                                       TrackReference trackReference,
                                       WantsDeleted wantsDeleted,
@@ -267,26 +544,58 @@ HashTable::FindResult HashTable::find(const DocKey& key,
         throw std::logic_error("HashTable::find: Cannot call on a "
                 "non-active object");
     }
-    HashBucketLock hbl = getLockedBucket(key);
-    auto* sv = unlocked_find(
-            key, hbl.getBucketNum(), wantsDeleted, trackReference, perspective);
+    const auto hash = hashKey(key);
+    HashBucketLock hbl = getLockedBucketForHash(hash);
+    auto* sv = unlocked_find(key,
+                             hash,
+                             hbl.getBucketNum(),
+                             wantsDeleted,
+                             trackReference,
+                             perspective);
     return {sv, std::move(hbl)};
 }
 
 std::unique_ptr<Item> HashTable::getRandomKey(long rnd) {
-    /* Try to locate a partition */
-    size_t start = rnd % size;
-    size_t curr = start;
     std::unique_ptr<Item> ret;
+    visitRandomValue(rnd,
+                     [&ret](const StoredValue& v) { ret = v.toItem(Vbid(0)); });
+    return ret;
+}
+
+boost::optional<StoredDocKey> HashTable::getRandomDocKey(long rnd) {
+    boost::optional<StoredDocKey> ret;
+    visitRandomValue(rnd, [&ret](const StoredValue& v) { ret = v.getKey(); });
+    return ret;
+}
+
+bool HashTable::visitRandomValue(
+        long rnd, const std::function<void(const StoredValue&)>& visitor) {
+    std::minstd_rand generator(static_cast<uint32_t>(rnd));
 
+    // The table is resized to hold about one item per bucket, so a random
+    // probe is expected to find one in a couple of tries unless the table
+    // is mostly empty (or non-resident).
+    for (size_t probe = 0; probe < randomKeyProbes; ++probe) {
+        if (visitRandomValueInSlot(
+                    generator() % getNumBuckets(), generator, visitor)) {
+            return true;
+        }
+    }
+
+    /* Try to locate a partition */
+    const size_t numBuckets = getNumBuckets();
+    size_t start = generator() % numBuckets;
+    size_t curr = start;
     do {
-        ret = getRandomKeyFromSlot(curr++);
-        if (curr == size) {
+        if (visitRandomValueInSlot(curr++, generator, visitor)) {
+            return true;
+        }
+        if (curr == numBuckets) {
             curr = 0;
         }
-    } while (ret == NULL && curr != start);
+    } while (curr != start);
 
-    return ret;
+    return false;
 }
 
 MutationStatus HashTable::set(Item& val) {
@@ -310,9 +619,9 @@ void HashTable::commit(const HashTable::HashBucketLock& hbl, StoredValue& v) {
     const auto pendingPreProps = valueStats.prologue(&v);
 
     // Locate any existing committed SV and remove it.
-    auto& key = v.getKey();
+    const auto key = v.getKey();
     auto oldValue = hashChainRemoveFirst(
-            values[hbl.getBucketNum()], [&key](const StoredValue* v) {
+            chainHead(hbl.getBucketNum()), [&key](const StoredValue* v) {
                 return v->hasKey(key) &&
                        v->getCommitted() != CommittedState::Pending;
             });
@@ -322,6 +631,7 @@ void HashTable::commit(const HashTable::HashBucketLock& hbl, StoredValue& v) {
         const auto committedPreProps =
                 valueStats.prologue(oldValue.get().get());
         valueStats.epilogue(committedPreProps, nullptr);
+        refreshBucketTags(hbl.getBucketNum());
     }
 
     // Change the pending item to Committed.
@@ -341,9 +651,9 @@ void HashTable::abort(const HashBucketLock& hbl, StoredValue& v) {
     const auto pendingPreProps = valueStats.prologue(&v);
 
     // Locate the existing Pending SV and remove it
-    auto& key = v.getKey();
+    const auto key = v.getKey();
     auto removed = hashChainRemoveFirst(
-            values[hbl.getBucketNum()], [&key](const StoredValue* v) {
+            chainHead(hbl.getBucketNum()), [&key](const StoredValue* v) {
                 return v->hasKey(key) &&
                        v->getCommitted() == CommittedState::Pending;
             });
@@ -353,6 +663,7 @@ void HashTable::abort(const HashBucketLock& hbl, StoredValue& v) {
                 "HashTable::abort: No matching StoredValue found at removing "
                 "Pending item");
     }
+    refreshBucketTags(hbl.getBucketNum());
 
     // Update stats for Pending -> Removed item
     valueStats.epilogue(pendingPreProps, nullptr);
@@ -420,13 +731,21 @@ StoredValue* HashTable::unlocked_addNewStoredValue(const HashBucketLock& hbl,
 
     const auto emptyProperties = valueStats.prologue(nullptr);
 
+    // The HashTable is now authoritative for the key - forget any metadata
+    // it was evicted with.
+    if (evictedMeta.size() != 0) {
+        evictedMeta.erase(fingerprintKey(itm.getKey()));
+    }
+
     // Create a new StoredValue and link it into the head of the bucket chain.
-    auto v = (*valFact)(itm, std::move(values[hbl.getBucketNum()]));
+    auto v = (*valFact)(itm, std::move(chainHead(hbl.getBucketNum())));
+    v->setKeyHashTag(tagForHash(hashKey(itm.getKey())));
 
     valueStats.epilogue(emptyProperties, v.get().get());
 
-    values[hbl.getBucketNum()] = std::move(v);
-    return values[hbl.getBucketNum()].get().get();
+    chainHead(hbl.getBucketNum()) = std::move(v);
+    refreshBucketTags(hbl.getBucketNum());
+    return chainHead(hbl.getBucketNum()).get().get();
 }
 
 HashTable::Statistics::StoredValueProperties::StoredValueProperties(
@@ -445,7 +764,8 @@ HashTable::Statistics::StoredValueProperties::StoredValueProperties(
     isResident = sv->isResident();
     isDeleted = sv->isDeleted();
     isTempItem = sv->isTempItem();
-    isSystemItem = sv->getKey().getCollectionID().isSystem();
+    collection = sv->getKey().getCollectionID();
+    isSystemItem = collection.isSystem();
     isPreparedSyncWrite = sv->isPending();
 }
 
@@ -465,6 +785,16 @@ void HashTable::Statistics::epilogue(StoredValueProperties pre,
     if (pre.size != post.size) {
         cacheSize.fetch_add(post.size - pre.size);
         memSize.fetch_add(post.size - pre.size);
+        if (pre.isValid && post.isValid && pre.collection == post.collection) {
+            updateCollectionMemSize(post.collection, post.size - pre.size);
+        } else {
+            if (pre.isValid) {
+                updateCollectionMemSize(pre.collection, -pre.size);
+            }
+            if (post.isValid) {
+                updateCollectionMemSize(post.collection, post.size);
+            }
+        }
     }
     if (pre.metaDataSize != post.metaDataSize) {
         metaDataMemory.fetch_add(post.metaDataSize - pre.metaDataSize);
@@ -539,6 +869,44 @@ void HashTable::Statistics::reset() {
     memSize.store(0);
     cacheSize.store(0);
     uncompressedMemSize.store(0);
+    for (auto& stripe : collectionMem) {
+        std::lock_guard<std::mutex> lh(stripe.mutex);
+        stripe.sizes.clear();
+    }
+}
+
+void HashTable::Statistics::updateCollectionMemSize(CollectionID cid,
+                                                    int64_t delta) {
+    auto& stripe = collectionMem[std::hash<CollectionID>()(cid) %
+                                 collectionMemStripes];
+    std::lock_guard<std::mutex> lh(stripe.mutex);
+    auto it = stripe.sizes.emplace(cid, 0).first;
+    it->second += delta;
+    // Drop collections once their last item has gone, so dropped
+    // collections don't linger.
+    if (it->second <= 0) {
+        stripe.sizes.erase(it);
+    }
+}
+
+size_t HashTable::Statistics::getCollectionMemSize(CollectionID cid) const {
+    const auto& stripe = collectionMem[std::hash<CollectionID>()(cid) %
+                                       collectionMemStripes];
+    std::lock_guard<std::mutex> lh(stripe.mutex);
+    auto it = stripe.sizes.find(cid);
+    return it == stripe.sizes.end() ? 0 : size_t(it->second);
+}
+
+std::unordered_map<CollectionID, size_t>
+HashTable::Statistics::getCollectionMemSizes() const {
+    std::unordered_map<CollectionID, size_t> ret;
+    for (const auto& stripe : collectionMem) {
+        std::lock_guard<std::mutex> lh(stripe.mutex);
+        for (const auto& entry : stripe.sizes) {
+            ret.emplace(entry.first, size_t(entry.second));
+        }
+    }
+    return ret;
 }
 
 std::pair<StoredValue*, StoredValue::UniquePtr>
@@ -561,14 +929,15 @@ HashTable::unlocked_replaceByCopy(const HashBucketLock& hbl,
 
     /* Copy the StoredValue and link it into the head of the bucket chain. */
     auto newSv = valFact->copyStoredValue(
-            vToCopy, std::move(values[hbl.getBucketNum()]));
+            vToCopy, std::move(chainHead(hbl.getBucketNum())));
 
     // Adding a new item into the HashTable; update stats.
     const auto emptyProperties = valueStats.prologue(nullptr);
     valueStats.epilogue(emptyProperties, newSv.get().get());
 
-    values[hbl.getBucketNum()] = std::move(newSv);
-    return {values[hbl.getBucketNum()].get().get(), std::move(releasedSv)};
+    chainHead(hbl.getBucketNum()) = std::move(newSv);
+    refreshBucketTags(hbl.getBucketNum());
+    return {chainHead(hbl.getBucketNum()).get().get(), std::move(releasedSv)};
 }
 
 HashTable::DeleteResult HashTable::unlocked_softDelete(
@@ -594,17 +963,18 @@ HashTable::DeleteResult HashTable::unlocked_softDelete(
             // as a deleted item. The existing StoredValue keeps the same state
             // until we Commit the pending one.
             auto pendingDel = valFact->copyStoredValue(
-                    v, std::move(values[hbl.getBucketNum()]));
+                    v, std::move(chainHead(hbl.getBucketNum())));
             pendingDel->setCommitted(CommittedState::Pending);
             pendingDel->del(delSource);
 
             // Adding a new item into the HashTable; update stats.
             const auto emptyProperties = valueStats.prologue(nullptr);
             valueStats.epilogue(emptyProperties, pendingDel.get().get());
-            values[hbl.getBucketNum()] = std::move(pendingDel);
+            chainHead(hbl.getBucketNum()) = std::move(pendingDel);
+            refreshBucketTags(hbl.getBucketNum());
 
             return {DeletionStatus::Success,
-                    values[hbl.getBucketNum()].get().get()};
+                    chainHead(hbl.getBucketNum()).get().get()};
         }
         // non-syncDelete requests, can directly update existing SV.
         const auto preProps = valueStats.prologue(&v);
@@ -626,34 +996,79 @@ StoredValue* HashTable::unlocked_find(const DocKey& key,
                                       WantsDeleted wantsDeleted,
                                       TrackReference trackReference,
                                       Perspective perspective) {
-    // Scan through all elements in the hash bucket chain looking for a
-    // matching key.
+    return unlocked_find(key,
+                         hashKey(key),
+                         bucket_num,
+                         wantsDeleted,
+                         trackReference,
+                         perspective);
+}
+
+StoredValue* HashTable::unlocked_find(const DocKey& key,
+                                      uint32_t hash,
+                                      int bucket_num,
+                                      WantsDeleted wantsDeleted,
+                                      TrackReference trackReference,
+                                      Perspective perspective) {
     StoredValue* foundSv = nullptr;
-    for (StoredValue* v = values[bucket_num].get().get(); v;
-            v = v->getNext().get().get()) {
-        if (v->hasKey(key)) {
-            // When using Committed perspective; only return Committed
-            // items - skip pending.
-            if ((perspective == Perspective::Committed) & v->isPending()) {
-                continue;
-            }
+    const auto tag = tagForHash(hash);
+
+    // Check if the given element of the chain is the one we are looking for.
+    // Returns true if the search is complete.
+    auto matches = [&key, tag, perspective, &foundSv](StoredValue* v) {
+        // Compare the key hash tag first; this rejects almost all other keys
+        // in the chain without touching their key bytes.
+        if (v->getKeyHashTag() != tag || !v->hasKey(key)) {
+            return false;
+        }
+        // When using Committed perspective; only return Committed
+        // items - skip pending.
+        if ((perspective == Perspective::Committed) & v->isPending()) {
+            return false;
+        }
 
-            // For Perspective::Pending, given we could have both pending *and*
-            // Committed items for the same key, we need to check the entire
-            // bucket chain for a Pending even if we first find a Committed
-            // item.
-            if ((perspective == Perspective::Pending) && v->isCommitted()) {
-                // Note the committed item found, continue checking for a
-                // pending.
-                Expects(!foundSv);
-                foundSv = v;
-                continue;
-            } else {
-                // Found matching item and don't need to check further.
-                foundSv = v;
-                break;
+        // For Perspective::Pending, given we could have both pending *and*
+        // Committed items for the same key, we need to check the entire
+        // bucket chain for a Pending even if we first find a Committed
+        // item.
+        if ((perspective == Perspective::Pending) && v->isCommitted()) {
+            // Note the committed item found, continue checking for a
+            // pending.
+            Expects(!foundSv);
+            foundSv = v;
+            return false;
+        }
+        // Found matching item and don't need to check further.
+        foundSv = v;
+        return true;
+    };
+
+    StoredValue* chainStart = chainHead(bucket_num).get().get();
+    if (layout == Layout::Bucketed) {
+        // Only visit chain elements whose tag matches; if the chain is longer
+        // than the tags can describe then walk the remainder.
+        const auto& group = tagsFor(bucket_num);
+        bool done = false;
+        for (size_t i = 0; i < group.count && !done; ++i) {
+            if (group.tags[i] == tag) {
+                done = matches(group.values[i]);
             }
         }
+        chainStart = nullptr;
+        if (!done && group.overflow) {
+            chainStart = group.values[BucketTags::Slots - 1]
+                                 ->getNext()
+                                 .get()
+                                 .get();
+        }
+    }
+
+    // Scan through all (remaining) elements in the hash bucket chain looking
+    // for a matching key.
+    for (StoredValue* v = chainStart; v; v = v->getNext().get().get()) {
+        if (matches(v)) {
+            break;
+        }
     }
 
     if (!foundSv) {
@@ -684,6 +1099,80 @@ HashTable::FindROResult HashTable::findForRead(const DocKey& key,
     return {result.storedValue, std::move(result.lock)};
 }
 
+HashTable::FindSharedResult HashTable::findForReadShared(
+        const DocKey& key, TrackReference trackReference) {
+    if (!sharedReaderLocks) {
+        auto result = find(
+                key, trackReference, WantsDeleted::No, Perspective::Committed);
+        return {result.storedValue, {}, std::move(result.lock)};
+    }
+    if (!isActive()) {
+        throw std::logic_error(
+                "HashTable::findForReadShared: Cannot call on a "
+                "non-active object");
+    }
+
+    const auto hash = hashKey(key);
+    int bucket;
+    std::shared_lock<StripeMutex> sharedLock;
+    do {
+        bucket = getBucketForHash(hash);
+        sharedLock = std::shared_lock<StripeMutex>(
+                mutexes[mutexForBucket(bucket)]);
+    } while (bucket != getBucketForHash(hash));
+
+    // A pending decay modifies the bucket's counters, so must be applied
+    // with the stripe held exclusively.
+    if (decayEpochFor(bucket) != freqDecayEpoch) {
+        sharedLock.unlock();
+        auto result = find(
+                key, trackReference, WantsDeleted::No, Perspective::Committed);
+        return {result.storedValue, {}, std::move(result.lock)};
+    }
+
+    auto* sv = unlocked_find(key,
+                             hash,
+                             bucket,
+                             WantsDeleted::No,
+                             TrackReference::No,
+                             Perspective::Committed);
+    if (!sv || trackReference == TrackReference::No) {
+        return {sv, std::move(sharedLock), {}};
+    }
+
+    // The NRU bits are atomic, so can be updated by concurrent readers; the
+    // frequency counter is part of the value pointer's tag so is only
+    // written exclusively. The new counter value is generated here (rather
+    // than again once exclusive) so that falling back doesn't change the
+    // probability of the increment.
+    sv->referenced();
+    const auto freqCounterValue = sv->getFreqCounterValue();
+    const auto updatedFreqCounterValue = generateFreqValue(freqCounterValue);
+    if (updatedFreqCounterValue == freqCounterValue) {
+        if (freqCounterValue == std::numeric_limits<uint8_t>::max()) {
+            frequencyCounterSaturated();
+        }
+        return {sv, std::move(sharedLock), {}};
+    }
+
+    sharedLock.unlock();
+    auto hbl = getLockedBucketForHash(hash);
+    sv = unlocked_find(key,
+                       hash,
+                       hbl.getBucketNum(),
+                       WantsDeleted::No,
+                       TrackReference::No,
+                       Perspective::Committed);
+    // Skip the increment if the item was changed (or decayed) meanwhile.
+    if (sv && sv->getFreqCounterValue() == freqCounterValue) {
+        sv->setFreqCounterValue(updatedFreqCounterValue);
+        if (updatedFreqCounterValue == std::numeric_limits<uint8_t>::max()) {
+            frequencyCounterSaturated();
+        }
+    }
+    return {sv, {}, std::move(hbl)};
+}
+
 HashTable::FindResult HashTable::findForWrite(const DocKey& key,
                                               WantsDeleted wantsDeleted) {
     return find(key, TrackReference::No, wantsDeleted, Perspective::Pending);
@@ -709,7 +1198,7 @@ StoredValue::UniquePtr HashTable::unlocked_release(
 
     // Remove the first (should only be one) StoredValue with the given key.
     auto released = hashChainRemoveFirst(
-            values[hbl.getBucketNum()],
+            chainHead(hbl.getBucketNum()),
             [key](const StoredValue* v) { return v->hasKey(key); });
 
     if (!released) {
@@ -719,6 +1208,7 @@ StoredValue::UniquePtr HashTable::unlocked_release(
                 "HashTable::unlocked_release: StoredValue to be released "
                 "not found in HashTable; possibly HashTable leak");
     }
+    refreshBucketTags(hbl.getBucketNum());
 
     // Update statistics for the item which is now gone.
     const auto preProps = valueStats.prologue(released.get().get());
@@ -730,7 +1220,8 @@ StoredValue::UniquePtr HashTable::unlocked_release(
 MutationStatus HashTable::insertFromWarmup(Item& itm,
                                            bool eject,
                                            bool keyMetaDataOnly,
-                                           EvictionPolicy evictionPolicy) {
+                                           EvictionPolicy evictionPolicy,
+                                           bool restoreOnly) {
     const auto perspective = itm.isPending()
                                      ? HashTable::Perspective::Pending
                                      : HashTable::Perspective::Committed;
@@ -739,6 +1230,13 @@ MutationStatus HashTable::insertFromWarmup(Item& itm,
     auto* v = htRes.storedValue;
     auto& hbl = htRes.lock;
 
+    if (restoreOnly &&
+        (v == nullptr || keyMetaDataOnly || v->isResident() ||
+         v->isTempItem())) {
+        // Deleted, modified or being fetched since warmup read it
+        return MutationStatus::InvalidCas;
+    }
+
     if (v == NULL) {
         v = unlocked_addNewStoredValue(hbl, itm);
 
@@ -788,19 +1286,44 @@ MutationStatus HashTable::insertFromWarmup(Item& itm,
 
 bool HashTable::reallocateStoredValue(StoredValue&& sv) {
     // Search the chain and reallocate
-    for (StoredValue::UniquePtr* curr =
-                 &values[getBucketForHash(sv.getKey().hash())];
-         curr->get().get();
+    const int bucket = getBucketForHash(hashKey(sv.getKey()));
+    for (StoredValue::UniquePtr* curr = &chainHead(bucket); curr->get().get();
          curr = &curr->get()->getNext()) {
         if (&sv == curr->get().get()) {
             auto newSv = valFact->copyStoredValue(sv, std::move(sv.getNext()));
             curr->swap(newSv);
+            refreshBucketTags(bucket);
             return true;
         }
     }
     return false;
 }
 
+void HashTable::refreshBucketTags(int bucket_num) {
+    if (layout != Layout::Bucketed) {
+        return;
+    }
+    auto& group = tagsFor(bucket_num);
+    group.count = 0;
+    group.overflow = false;
+    for (StoredValue* v = chainHead(bucket_num).get().get(); v;
+         v = v->getNext().get().get()) {
+        if (group.count == BucketTags::Slots) {
+            group.overflow = true;
+            break;
+        }
+        group.values[group.count] = v;
+        group.tags[group.count] = v->getKeyHashTag();
+        ++group.count;
+    }
+}
+
+void HashTable::refreshAllBucketTags() {
+    for (int i = 0; i < static_cast<int>(bucketTags.size()); ++i) {
+        refreshBucketTags(i);
+    }
+}
+
 void HashTable::dump() const {
     std::cerr << *this << std::endl;
 }
@@ -829,22 +1352,23 @@ void HashTable::visitDepth(HashTableDepthVisitor &visitor) {
     // Acquire one (any) of the mutexes before incrementing {visitors}, this
     // prevents any race between this visitor and the HashTable resizer.
     // See comments in pauseResumeVisit() for further details.
-    std::unique_lock<std::mutex> lh(mutexes[0]);
+    std::unique_lock<StripeMutex> lh(mutexes[0]);
     VisitorTracker vt(&visitors);
+    const int numBuckets = getNumBuckets();
     lh.unlock();
 
     for (int l = 0; l < static_cast<int>(mutexes.size()); l++) {
-        for (int i = l; i < static_cast<int>(size); i+= mutexes.size()) {
+        for (int i = l; i < numBuckets; i += mutexes.size()) {
             // (re)acquire mutex on each HashBucket, to minimise any impact
             // on front-end threads.
-            LockHolder lh(mutexes[l]);
+            std::lock_guard<StripeMutex> lh(mutexes[l]);
 
             size_t depth = 0;
-            StoredValue* p = values[i].get().get();
+            StoredValue* p = chainHead(i).get().get();
             if (p) {
                 // TODO: Perf: This check seems costly - do we think it's still
                 // worth keeping?
-                auto hashbucket = getBucketForHash(p->getKey().hash());
+                auto hashbucket = getBucketForHash(hashKey(p->getKey()));
                 if (i != hashbucket) {
                     throw std::logic_error("HashTable::visit: inconsistency "
                             "between StoredValue's calculated hashbucket "
@@ -886,29 +1410,49 @@ HashTable::Position HashTable::pauseResumeVisit(HashTableVisitor& visitor,
     // inside the inner for() loop. To prevent this race, we explicitly acquire
     // (any) mutex, increment {visitors} and then release the mutex. This
     //avoids the race as if visitors >0 then Resizer will not attempt to resize.
-    std::unique_lock<std::mutex> lh(mutexes[0]);
+    // While an incremental resize is in progress both the old and new tables
+    // are visited - bucket numbers for each lock are contiguous across them
+    // (see getBucketForHash()). Buckets are only migrated while there are no
+    // visitors, but may be between a pause and the resume; see below.
+    std::unique_lock<StripeMutex> lh(mutexes[0]);
     VisitorTracker vt(&visitors);
+    const size_t numBuckets = getNumBuckets();
     lh.unlock();
 
     // Start from the requested lock number if in range.
     size_t lock = (start_pos.lock < mutexes.size()) ? start_pos.lock : 0;
     size_t hash_bucket = 0;
+    size_t resizeStart = 0;
 
     for (; isActive() && !paused && lock < mutexes.size(); lock++) {
 
         // If the bucket position is *this* lock, then start from the
         // recorded bucket (as long as we haven't resized).
         hash_bucket = lock;
+        resizeStart = getResizeCursor(lock);
         if (start_pos.lock == lock &&
-            start_pos.ht_size == size &&
-            start_pos.hash_bucket < size) {
-            hash_bucket = start_pos.hash_bucket;
+            start_pos.ht_size == numBuckets &&
+            start_pos.hash_bucket < numBuckets) {
+            // An incremental resize may have migrated some of the lock's
+            // buckets since the position was recorded. Those it migrated
+            // from the old buckets already visited have their items skipped
+            // in the new table. If it overtook the visit (migrating old
+            // buckets not yet visited too), the lock's buckets must be
+            // started again instead, so none of the items are missed.
+            const size_t cursor = getResizeCursor(lock);
+            if (cursor == start_pos.resize_cursor ||
+                start_pos.hash_bucket >= size ||
+                cursor <= start_pos.hash_bucket) {
+                hash_bucket = start_pos.hash_bucket;
+                resizeStart = start_pos.resize_start;
+            }
         }
 
         // Iterate across all values in the hash buckets owned by this lock.
         // Note: we don't record how far into the bucket linked-list we
         // pause at; so any restart will begin from the next bucket.
-        for (; !paused && hash_bucket < size; hash_bucket += mutexes.size()) {
+        for (; !paused && hash_bucket < numBuckets;
+             hash_bucket += mutexes.size()) {
             visitor.setUpHashBucketVisit();
 
             // HashBucketLock scope. If a visitor needs additional locking
@@ -916,11 +1460,21 @@ HashTable::Position HashTable::pauseResumeVisit(HashTableVisitor& visitor,
             // tearDownHashBucketVisit() is called.
             {
                 HashBucketLock lh(hash_bucket, mutexes[lock]);
+                maybeDecayBucket_UNLOCKED(hash_bucket);
+
+                // Skip the items migrated (into the new table) from old
+                // buckets visited before a pause.
+                const bool skipMigrated = hash_bucket >= size &&
+                                          resizeStart < getResizeCursor(lock);
 
-                StoredValue* v = values[hash_bucket].get().get();
+                StoredValue* v = chainHead(hash_bucket).get().get();
                 while (!paused && v) {
                     StoredValue* tmp = v->getNext().get().get();
-                    paused = !visitor.visit(lh, *v);
+                    if (!skipMigrated ||
+                        size_t(abs(int(hashKey(v->getKey())) %
+                                   static_cast<int>(size))) < resizeStart) {
+                        paused = !visitor.visit(lh, *v);
+                    }
                     v = tmp;
                 }
             }
@@ -931,21 +1485,86 @@ HashTable::Position HashTable::pauseResumeVisit(HashTableVisitor& visitor,
         // If the visitor paused us before we visited all hash buckets owned
         // by this lock, we don't want to skip the remaining hash buckets, so
         // stop the outer for loop from advancing to the next lock.
-        if (paused && hash_bucket < size) {
+        if (paused && hash_bucket < numBuckets) {
             break;
         }
 
-        // Finished all buckets owned by this lock. Set hash_bucket to 'size'
-        // to give a consistent marker for "end of lock".
-        hash_bucket = size;
+        // Finished all buckets owned by this lock. Set hash_bucket to
+        // 'numBuckets' to give a consistent marker for "end of lock".
+        hash_bucket = numBuckets;
     }
 
     // Return the *next* location that should be visited.
-    return HashTable::Position(size, lock, hash_bucket);
+    if (lock == mutexes.size()) {
+        return endPosition();
+    }
+    return HashTable::Position(numBuckets,
+                               lock,
+                               hash_bucket,
+                               getResizeCursor(lock),
+                               resizeStart);
+}
+
+size_t HashTable::visitRandomBucket(HashTableVisitor& visitor, size_t rnd) {
+    if (!isActive()) {
+        return 0;
+    }
+    const size_t bucket_num = rnd % getNumBuckets();
+
+    size_t visited = 0;
+    visitor.setUpHashBucketVisit();
+    {
+        auto lh = getLockedBucket(bucket_num);
+        // Re-check now the lock is held; the table may have been resized
+        // (or an incremental resize completed) since the bucket was chosen.
+        if (bucket_num < getNumBuckets()) {
+            StoredValue* v = chainHead(bucket_num).get().get();
+            while (v) {
+                StoredValue* tmp = v->getNext().get().get();
+                visitor.visit(lh, *v);
+                ++visited;
+                v = tmp;
+            }
+        }
+    }
+    visitor.tearDownHashBucketVisit();
+    return visited;
 }
 
 HashTable::Position HashTable::endPosition() const  {
-    return HashTable::Position(size, mutexes.size(), size);
+    const auto numBuckets = getNumBuckets();
+    return HashTable::Position(numBuckets, mutexes.size(), numBuckets, 0, 0);
+}
+
+StoredValue* HashTable::unlocked_findColdestEvictable(
+        const HashBucketLock& hbl,
+        EvictionPolicy policy,
+        uint8_t freqLimit,
+        const StoredValue* exclude) {
+    if (!hbl.getHTLock()) {
+        throw std::invalid_argument(
+                "HashTable::unlocked_findColdestEvictable: htLock not held");
+    }
+    if (!isActive()) {
+        throw std::invalid_argument(
+                "HashTable::unlocked_findColdestEvictable: Cannot call on a "
+                "non-active HT object");
+    }
+
+    StoredValue* coldest = nullptr;
+    for (StoredValue* v = chainHead(hbl.getBucketNum()).get().get(); v;
+         v = v->getNext().get().get()) {
+        if (v == exclude || v->isTempItem() ||
+            v->getFreqCounterValue() >= freqLimit ||
+            !v->eligibleForEviction(policy)) {
+            continue;
+        }
+        if (!coldest ||
+            v->getFreqCounterValue() < coldest->getFreqCounterValue()) {
+            coldest = v;
+        }
+    }
+    return coldest;
 }
 
 bool HashTable::unlocked_ejectItem(const HashTable::HashBucketLock&,
@@ -972,16 +1591,30 @@ bool HashTable::unlocked_ejectItem(const HashTable::HashBucketLock&,
     }
     case EvictionPolicy::Full: {
         // Remove the item from the hash table.
-        int bucket_num = getBucketForHash(vptr->getKey().hash());
+        int bucket_num = getBucketForHash(hashKey(vptr->getKey()));
         auto removed = hashChainRemoveFirst(
-                values[bucket_num],
+                chainHead(bucket_num),
                 [vptr](const StoredValue* v) { return v == vptr; });
+        refreshBucketTags(bucket_num);
 
         if (removed->isResident()) {
             ++stats.numValueEjects;
         }
         valueStats.epilogue(preProps, nullptr);
 
+        if (evictedMeta.isEnabled() && !removed->isDeleted() &&
+            !removed->isTempItem()) {
+            const auto key = removed->getKey();
+            evictedMeta.insert(fingerprintKey(key),
+                               {removed->getCas(),
+                                removed->getBySeqno(),
+                                removed->getRevSeqno(),
+                                removed->getFlags(),
+                                uint32_t(removed->getExptime()),
+                                removed->getDatatype(),
+                                removed->getCommitted()});
+        }
+
         updateMaxDeletedRevSeqno(vptr->getRevSeqno());
         break;
     }
@@ -991,21 +1624,79 @@ bool HashTable::unlocked_ejectItem(const HashTable::HashBucketLock&,
     return true;
 }
 
-std::unique_ptr<Item> HashTable::getRandomKeyFromSlot(int slot) {
+std::unique_ptr<Item> HashTable::unlocked_takeEvictedMeta(
+        const HashBucketLock& hbl, const DocKey& key) {
+    if (!hbl.getHTLock()) {
+        throw std::invalid_argument(
+                "HashTable::unlocked_takeEvictedMeta: htLock not held");
+    }
+    if (evictedMeta.size() == 0) {
+        return nullptr;
+    }
+    auto meta = evictedMeta.take(fingerprintKey(key));
+    if (!meta) {
+        return nullptr;
+    }
+    auto item = std::make_unique<Item>(key,
+                                       meta->flags,
+                                       meta->exptime,
+                                       value_t{},
+                                       meta->datatype,
+                                       meta->cas,
+                                       meta->bySeqno,
+                                       Vbid(0),
+                                       meta->revSeqno);
+    if (meta->committed == CommittedState::CommittedViaPrepare) {
+        item->setCommittedviaPrepareSyncWrite();
+    }
+    return item;
+}
+
+void HashTable::unlocked_eraseEvictedMeta(const HashBucketLock& hbl,
+                                          const DocKey& key) {
+    if (!hbl.getHTLock()) {
+        throw std::invalid_argument(
+                "HashTable::unlocked_eraseEvictedMeta: htLock not held");
+    }
+    if (evictedMeta.size() != 0) {
+        evictedMeta.erase(fingerprintKey(key));
+    }
+}
+
+bool HashTable::visitRandomValueInSlot(
+        size_t slot,
+        std::minstd_rand& generator,
+        const std::function<void(const StoredValue&)>& visitor) {
     auto lh = getLockedBucket(slot);
-    for (StoredValue* v = values[slot].get().get(); v;
+    if (slot >= getNumBuckets()) {
+        // Table was resized (or an incremental resize completed) since the
+        // slot was chosen.
+        return false;
+    }
+
+    // Pick one of the chain's resident items with equal probability, in
+    // one pass (a reservoir of one).
+    const StoredValue* chosen = nullptr;
+    size_t candidates = 0;
+    for (StoredValue* v = chainHead(slot).get().get(); v;
             v = v->getNext().get().get()) {
         if (!v->isTempItem() && !v->isDeleted() && v->isResident() &&
             v->getCommitted() != CommittedState::Pending) {
-            return v->toItem(Vbid(0));
+            if (generator() % ++candidates == 0) {
+                chosen = v;
+            }
         }
     }
 
-    return nullptr;
+    if (chosen) {
+        visitor(*chosen);
+        return true;
+    }
+    return false;
 }
 
 bool HashTable::unlocked_restoreValue(
-        const std::unique_lock<std::mutex>& htLock,
+        const std::unique_lock<StripeMutex>& htLock,
         const Item& itm,
         StoredValue& v) {
     if (!htLock || !isActive() || v.isResident()) {
@@ -1027,9 +1718,10 @@ bool HashTable::unlocked_restoreValue(
     return true;
 }
 
-void HashTable::unlocked_restoreMeta(const std::unique_lock<std::mutex>& htLock,
-                                     const Item& itm,
-                                     StoredValue& v) {
+void HashTable::unlocked_restoreMeta(
+        const std::unique_lock<StripeMutex>& htLock,
+        const Item& itm,
+        StoredValue& v) {
     if (!htLock) {
         throw std::invalid_argument(
                 "HashTable::unlocked_restoreMeta: htLock "
@@ -1058,8 +1750,14 @@ void HashTable::updateFreqCounter(StoredValue& v) {
     // value.  Because a probabilistic counter is used the new
     // value will either be the same or an increment of the
     // current value.
-    auto updatedFreqCounterValue = generateFreqValue(v.getFreqCounterValue());
-    v.setFreqCounterValue(updatedFreqCounterValue);
+    // Only write the counter back when it changed - a hot item's counter
+    // rarely does, and not writing avoids every read of it dirtying the
+    // StoredValue's cache line.
+    const auto freqCounterValue = v.getFreqCounterValue();
+    auto updatedFreqCounterValue = generateFreqValue(freqCounterValue);
+    if (updatedFreqCounterValue != freqCounterValue) {
+        v.setFreqCounterValue(updatedFreqCounterValue);
+    }
 
     if (updatedFreqCounterValue == std::numeric_limits<uint8_t>::max()) {
         // Invoke the registered callback function which
@@ -1068,6 +1766,22 @@ void HashTable::updateFreqCounter(StoredValue& v) {
     }
 }
 
+void HashTable::advanceFreqDecayEpoch(uint16_t percentage) {
+    freqDecayPercent = percentage;
+    ++freqDecayEpoch;
+}
+
+void HashTable::decayBucket_UNLOCKED(int bucket_num, uint32_t epoch) {
+    auto& bucketEpoch = decayEpochFor(bucket_num);
+    const auto behind = static_cast<uint32_t>(epoch - bucketEpoch);
+    const double factor = std::pow(freqDecayPercent * 0.01, behind);
+    for (StoredValue* v = chainHead(bucket_num).get().get(); v;
+         v = v->getNext().get().get()) {
+        v->setFreqCounterValue(v->getFreqCounterValue() * factor);
+    }
+    bucketEpoch = epoch;
+}
+
 std::ostream& operator<<(std::ostream& os, const HashTable& ht) {
     os << "HashTable[" << &ht << "] with"
        << " numItems:" << ht.getNumItems()
@@ -1078,11 +1792,13 @@ std::ostream& operator<<(std::ostream& os, const HashTable& ht) {
        << " numSystemItems:" << ht.getNumSystemItems()
        << " numPreparedSW:" << ht.getNumPreparedSyncWrites()
        << " values: " << std::endl;
-    for (const auto& chain : ht.values) {
-        if (chain) {
-            for (StoredValue* sv = chain.get().get(); sv != nullptr;
-                 sv = sv->getNext().get().get()) {
-                os << "    " << *sv << std::endl;
+    for (const auto* table : {&ht.values, &ht.resizeValues}) {
+        for (const auto& chain : *table) {
+            if (chain) {
+                for (StoredValue* sv = chain.get().get(); sv != nullptr;
+                     sv = sv->getNext().get().get()) {
+                    os << "    " << *sv << std::endl;
+                }
             }
         }
     }
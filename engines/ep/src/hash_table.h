@@ -17,15 +17,26 @@
 
 #pragma once
 
+#include "evicted_meta_index.h"
+#include "lock_profiler.h"
 #include "probabilistic_counter.h"
 #include "stored-value.h"
 #include "storeddockey.h"
 
+#include <boost/optional/optional.hpp>
+#include <folly/Memory.h>
+#include <folly/SharedMutex.h>
+#include <folly/lang/Assume.h>
 #include <platform/non_negative_counter.h>
 #include <utilities/hdrhistogram.h>
 
 #include <array>
 #include <functional>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
 
 class AbstractStoredValueFactory;
 class HashTableVisitor;
@@ -139,13 +150,32 @@ enum class DeletionDurability : uint8_t {};
  * The HashTable object is implemented as a vector of buckets; each bucket
  * being unique_ptr<StoredValue>. Keys are hashed mod size() to select the
  * bucket; then chaining is used (StoredValue::chain_next_or_replacement) to
- * handle any collisions.
+ * handle any collisions. Each StoredValue records the same 16-bit tag of its
+ * key's hash (StoredValue::getKeyHashTag), so walking a chain only compares
+ * the full key of elements whose tag matches.
+ *
+ * With Layout::Bucketed a parallel vector of cache-line sized BucketTags is
+ * additionally maintained, recording a 16-bit hash tag (and address) for the
+ * first few StoredValues of each chain. A lookup compares the tags first and
+ * only dereferences (and compares the key of) StoredValues whose tag matches,
+ * so a miss typically costs a single cache line rather than a walk of the
+ * chain.
  *
  * The HashTable can be resized if it grows too full - this is done by
  * acquiring all the ht_locks, and then allocating a new vector of buckets and
  * re-hashing all elements into the new table. While resizing is occuring all
  * other access to the HashTable is blocked.
  *
+ * Alternatively the HashTable can be resized incrementally (see
+ * resizeIncrementally()), which keeps both the old and new bucket vectors
+ * live and migrates a bounded number of buckets per ht_lock acquisition. This
+ * relies on both the old and new sizes being a multiple of the number of
+ * ht_locks, so a given key is guarded by the same mutex in either table - a
+ * lookup acquires that mutex and then checks if the key's old bucket has
+ * already been migrated to decide which table to search. While a resize is in
+ * progress bucket numbers in the range [size, size + resizeSize) address the
+ * new table.
+ *
  * Support for holding both Committed and Pending items requires that we
  * can represent having for each key, either:
  *  1. No item present
@@ -168,6 +198,35 @@ public:
     using DatatypeCombo = std::array<cb::NonNegativeCounter<size_t>,
                                      mcbp::datatype::highest + 1>;
 
+    /**
+     * Physical layout of the hash bucket array.
+     *
+     * Both layouts chain colliding StoredValues via
+     * StoredValue::chain_next_or_replacement; they differ in what a lookup
+     * has to touch before it finds (or rejects) a key.
+     */
+    enum class Layout {
+        /// Vector of chain heads - every chain element visited costs a
+        /// dependent load of the StoredValue (and its key).
+        Chained,
+        /**
+         * Chained, plus a cache-line sized BucketTags group per bucket which
+         * holds a short hash tag and pointer for the first few elements of
+         * the chain. Lookups only dereference StoredValues whose tag matches
+         * the key being searched for.
+         */
+        Bucketed,
+    };
+
+    /// Hash function used to map keys to buckets.
+    enum class HashAlgorithm {
+        /// DocKey::hash() - byte-at-a-time djb2 variant.
+        Djb,
+        /// CRC32C of the key, using the SSE4.2 crc32 instruction where
+        /// available.
+        Crc32c,
+    };
+
     /// Under what perspective (view) should the HashTable be accessed.
     enum class Perspective {
         /// Only access items which are Committed
@@ -186,12 +245,20 @@ public:
     public:
         // Allow default construction positioned at the start,
         // but nothing else.
-        Position() : ht_size(0), lock(0), hash_bucket(0) {}
+        Position()
+            : ht_size(0),
+              lock(0),
+              hash_bucket(0),
+              resize_cursor(0),
+              resize_start(0) {
+        }
 
         bool operator==(const Position& other) const {
             return (ht_size == other.ht_size) &&
                    (lock == other.lock) &&
-                   (hash_bucket == other.hash_bucket);
+                   (hash_bucket == other.hash_bucket) &&
+                   (resize_cursor == other.resize_cursor) &&
+                   (resize_start == other.resize_start);
         }
 
         bool operator!=(const Position& other) const {
@@ -199,10 +266,17 @@ public:
         }
 
     private:
-        Position(size_t ht_size_, int lock_, int hash_bucket_)
-          : ht_size(ht_size_),
-            lock(lock_),
-            hash_bucket(hash_bucket_) {}
+        Position(size_t ht_size_,
+                 int lock_,
+                 int hash_bucket_,
+                 size_t resize_cursor_,
+                 size_t resize_start_)
+            : ht_size(ht_size_),
+              lock(lock_),
+              hash_bucket(hash_bucket_),
+              resize_cursor(resize_cursor_),
+              resize_start(resize_start_) {
+        }
 
         // Size of the hashtable when the position was created.
         size_t ht_size;
@@ -210,6 +284,13 @@ public:
         size_t lock;
         // hash bucket ID (under the given lock) we are up to.
         size_t hash_bucket;
+        // Migration cursor of the lock (see resizeCursor) when the position
+        // was created, if an incremental resize was in progress.
+        size_t resize_cursor;
+        // Migration cursor of the lock when the visit of its buckets
+        // started; the items migrated from old buckets at or above it since
+        // have already been visited.
+        size_t resize_start;
 
         friend class HashTable;
         friend std::ostream& operator<<(std::ostream& os, const Position& pos);
@@ -256,6 +337,7 @@ public:
             bool isTempItem = false;
             bool isSystemItem = false;
             bool isPreparedSyncWrite = false;
+            CollectionID collection = CollectionID::Default;
         };
 
         /**
@@ -343,7 +425,16 @@ public:
             return uncompressedMemSize;
         }
 
+        /// Memory consumed by the items of the given collection.
+        size_t getCollectionMemSize(CollectionID cid) const;
+
+        /// Memory consumed by the items of each collection with any items.
+        std::unordered_map<CollectionID, size_t> getCollectionMemSizes() const;
+
     private:
+        /// Add delta to the memory consumed by the given collection.
+        void updateCollectionMemSize(CollectionID cid, int64_t delta);
+
         /// Count of alive & deleted, in-memory non-resident and resident items.
         /// Excludes temporary and prepared items.
         cb::NonNegativeCounter<size_t> numItems;
@@ -385,9 +476,70 @@ public:
         /// Memory consumed if the items were uncompressed.
         std::atomic<size_t> uncompressedMemSize = {};
 
+        /**
+         * Memory consumed by the items of each collection (the per-collection
+         * breakdown of memSize). Collections are spread over a few
+         * independently locked stripes, so that front-end threads updating
+         * different collections rarely contend.
+         */
+        struct CollectionMemStripe {
+            mutable std::mutex mutex;
+            std::unordered_map<CollectionID, int64_t> sizes;
+        };
+        static constexpr size_t collectionMemStripes = 8;
+        std::array<CollectionMemStripe, collectionMemStripes> collectionMem;
+
         EPStats& epStats;
     };
 
+    /**
+     * The lock of one of the ht_locks stripes.
+     *
+     * Exclusive only, unless the HashTable was created with shared reader
+     * locks (ht_shared_reader_locks): then the stripe can additionally be
+     * locked shared by lookups which don't modify the HashTable (see
+     * findForReadShared), so readers of the same stripe don't block each
+     * other. Everything else, and in particular every writer, still takes
+     * the stripe exclusively.
+     */
+    class StripeMutex {
+    public:
+        void setSharedReaders(bool value) {
+            sharedReaders = value;
+        }
+
+        void lock() {
+            if (sharedReaders) {
+                shared.lock();
+            } else {
+                exclusive.lock();
+            }
+        }
+
+        void unlock() {
+            if (sharedReaders) {
+                shared.unlock();
+            } else {
+                exclusive.unlock();
+            }
+        }
+
+        /// Only valid if the stripe has shared readers.
+        void lock_shared() {
+            shared.lock_shared();
+        }
+
+        void unlock_shared() {
+            shared.unlock_shared();
+        }
+
+    private:
+        std::mutex exclusive;
+        // Writer priority, so a stripe of hot keys can't starve its writers.
+        folly::SharedMutex shared;
+        bool sharedReaders = false;
+    };
+
     /**
      * Represents a locked hash bucket that provides RAII semantics for the lock
      *
@@ -399,31 +551,47 @@ public:
         HashBucketLock()
             : bucketNum(-1) {}
 
-        HashBucketLock(int bucketNum, std::mutex& mutex)
-            : bucketNum(bucketNum), htLock(mutex) {
+        HashBucketLock(int bucketNum, StripeMutex& mutex)
+            : bucketNum(bucketNum),
+              lockSample(LockSite::HashBucket),
+              htLock(mutex) {
+            lockSample.acquired();
         }
 
         HashBucketLock(HashBucketLock&& other)
-            : bucketNum(other.bucketNum), htLock(std::move(other.htLock)) {
+            : bucketNum(other.bucketNum),
+              lockSample(std::move(other.lockSample)),
+              htLock(std::move(other.htLock)) {
         }
 
         HashBucketLock(const HashBucketLock& other) = delete;
 
+        ~HashBucketLock() {
+            // Callers may have unlocked the lock early (via getHTLock()),
+            // in which case we don't know how long it was held for.
+            if (!htLock.owns_lock()) {
+                lockSample.discard();
+            }
+        }
+
         int getBucketNum() const {
             return bucketNum;
         }
 
-        const std::unique_lock<std::mutex>& getHTLock() const {
+        const std::unique_lock<StripeMutex>& getHTLock() const {
             return htLock;
         }
 
-        std::unique_lock<std::mutex>& getHTLock() {
+        std::unique_lock<StripeMutex>& getHTLock() {
             return htLock;
         }
 
     private:
         int bucketNum;
-        std::unique_lock<std::mutex> htLock;
+        // Declared before (so destroyed after) htLock, to include the
+        // unlock in the hold time.
+        LockSample lockSample;
+        std::unique_lock<StripeMutex> htLock;
     };
 
     /**
@@ -433,18 +601,66 @@ public:
      * @param svFactory Factory to use for constructing stored values
      * @param initialSize the number of hash table buckets to initially create.
      * @param locks the number of locks in the hash table
+     * @param layout the physical layout of the hash bucket array
+     * @param hashAlgorithm the hash function used to map keys to buckets
+     * @param evictedMetaIndexSize the most fully evicted items whose
+     *        metadata is kept in the EvictedMetaIndex; 0 disables it.
+     * @param sharedReaderLocks whether findForReadShared may lock a stripe
+     *        shared with other readers (see StripeMutex)
      */
     HashTable(EPStats& st,
               std::unique_ptr<AbstractStoredValueFactory> svFactory,
               size_t initialSize,
-              size_t locks);
+              size_t locks,
+              Layout layout = Layout::Chained,
+              HashAlgorithm hashAlgorithm = HashAlgorithm::Djb,
+              size_t evictedMetaIndexSize = 0,
+              bool sharedReaderLocks = false);
 
     ~HashTable();
 
     size_t memorySize() {
         return sizeof(HashTable)
-            + (size * sizeof(StoredValue*))
-            + (mutexes.size() * sizeof(std::mutex));
+            + ((values.size() + resizeValues.size()) * sizeof(StoredValue*))
+            + ((bucketTags.size() + resizeBucketTags.size()) *
+               sizeof(BucketTags))
+            + ((decayEpochs.size() + resizeDecayEpochs.size()) *
+               sizeof(uint32_t))
+            + (mutexes.size() * sizeof(StripeMutex));
+    }
+
+    /**
+     * Convert the ht_layout configuration string into a Layout.
+     * @throws std::invalid_argument if the string is not a known layout.
+     */
+    static Layout layoutFromString(const std::string& layout);
+
+    /// Get the physical layout of this hash table.
+    Layout getLayout() const {
+        return layout;
+    }
+
+    /**
+     * Convert the ht_hash_algorithm configuration string into a
+     * HashAlgorithm.
+     * @throws std::invalid_argument if the string is not a known algorithm.
+     */
+    static HashAlgorithm hashAlgorithmFromString(const std::string& algorithm);
+
+    /**
+     * Hash the given key with the given algorithm. Keys which don't encode a
+     * collection-ID hash the same as the equivalent key in the default
+     * collection.
+     */
+    template <typename Key>
+    static uint32_t hashKey(const Key& key, HashAlgorithm algorithm) {
+        switch (algorithm) {
+        case HashAlgorithm::Djb:
+            return key.hash();
+        case HashAlgorithm::Crc32c:
+            return crc32cHash(key.data(), key.size(), key.getEncoding());
+        }
+        folly::assume_unreachable();
     }
 
     /**
@@ -519,6 +735,22 @@ public:
         return frequencyCounterSaturated;
     }
 
+    /**
+     * Decay the frequency counter of every StoredValue by the given
+     * percentage. Rather than visiting each of them this starts a new decay
+     * epoch, which is applied to each hash bucket (for all of the epochs it
+     * is behind by) when the bucket is next locked or visited.
+     *
+     * @param percentage to decay the counters to; 0 resets them, 100 leaves
+     *        them unchanged. Applies to any epochs still pending as well.
+     */
+    void advanceFreqDecayEpoch(uint16_t percentage);
+
+    /// @return the current frequency counter decay epoch.
+    uint32_t getFreqDecayEpoch() const {
+        return freqDecayEpoch;
+    }
+
     /**
      * Remove in case of a temporary item
      *
@@ -561,6 +793,22 @@ public:
         return valueStats.getUncompressedMemSize();
     }
 
+    /**
+     * Get the memory consumed by the items of the given collection in this
+     * hash table.
+     */
+    size_t getCollectionItemMemory(CollectionID cid) const {
+        return valueStats.getCollectionMemSize(cid);
+    }
+
+    /**
+     * Get the memory consumed by the items of each collection (with any
+     * items) in this hash table.
+     */
+    std::unordered_map<CollectionID, size_t> getCollectionItemMemory() const {
+        return valueStats.getCollectionMemSizes();
+    }
+
     /**
      * Clear the hash table.
      *
@@ -591,9 +839,37 @@ public:
 
     /**
      * Resize to the specified size.
+     *
+     * If an incremental resize is in progress it is completed first.
      */
     void resize(size_t to);
 
+    /**
+     * Automatically resize to fit the current data, without blocking all
+     * access to the HashTable for the duration of the resize.
+     *
+     * The first call picks the new size and allocates the new bucket vector;
+     * each call (including the first) then migrates up to maxBuckets hash
+     * buckets from every ht_lock's stripe, acquiring each lock in turn. Other
+     * operations on keys under a lock can proceed as soon as that lock's
+     * batch of buckets has been migrated.
+     *
+     * Migration does not make progress while visitors are active. If the
+     * current size is not a multiple of the number of locks (e.g. the initial
+     * size) then a one-off blocking resize is performed instead.
+     *
+     * @param maxBuckets The maximum number of buckets to migrate per lock
+     *        acquisition.
+     * @return true if the resize is still in progress (and this should be
+     *         called again), false if no resize is in progress.
+     */
+    bool resizeIncrementally(size_t maxBuckets);
+
+    /// @return true if an incremental resize is in progress.
+    bool isResizing() const {
+        return resizing;
+    }
+
     /**
      * Result of the findForRead() method.
      */
@@ -630,6 +906,42 @@ public:
             TrackReference trackReference = TrackReference::Yes,
             WantsDeleted wantsDeleted = WantsDeleted::No);
 
+    /**
+     * Result of findForReadShared(). Exactly one of sharedLock and lock is
+     * held.
+     */
+    struct FindSharedResult {
+        /// If find successful then pointer to found StoredValue; else nullptr.
+        const StoredValue* storedValue;
+        /// Held if the lookup could be done with the stripe locked shared.
+        std::shared_lock<StripeMutex> sharedLock;
+        /// Held otherwise.
+        HashBucketLock lock;
+    };
+
+    /**
+     * Find a (non-deleted) committed item with the specified key for
+     * read-only access, where possible holding its stripe's lock only shared
+     * with other readers. The StoredValue can be read (and converted
+     * toItem) for as long as either lock in the result is held, but nothing
+     * may be modified with it.
+     *
+     * The lookup falls back to holding the lock exclusively if the table
+     * doesn't have shared reader locks, if the bucket has a frequency counter
+     * decay pending or if the item's frequency counter is to be incremented;
+     * the rest of the referenced status is updated under the shared lock.
+     *
+     * @param key The key of the item to find
+     * @param trackReference Should this lookup update referenced status
+     */
+    FindSharedResult findForReadShared(const DocKey& key,
+                                       TrackReference trackReference);
+
+    /// @return whether findForReadShared may lock a stripe shared.
+    bool hasSharedReaderLocks() const {
+        return sharedReaderLocks;
+    }
+
     /**
      * Result of the find() methods.
      */
@@ -672,13 +984,27 @@ public:
                             WantsDeleted wantsDeleted = WantsDeleted::Yes);
 
     /**
-     * Find a resident item
+     * Find a random resident item.
+     *
+     * Random buckets are probed (picking a random item of the bucket's
+     * chain) so each item is about equally likely to be chosen, however
+     * the items are spread over the table; only if none of the probes
+     * finds an item is the table scanned from a random bucket.
      *
      * @param rnd a randomization input
      * @return an item -- NULL if not fount
      */
     std::unique_ptr<Item> getRandomKey(long rnd);
 
+    /**
+     * Find the key of a random resident item, as getRandomKey() but
+     * without copying the item's value.
+     *
+     * @param rnd a randomization input
+     * @return the key, or none if there are no resident items
+     */
+    boost::optional<StoredDocKey> getRandomDocKey(long rnd);
+
     /**
      * Set an Item into the this hashtable
      *
@@ -846,7 +1172,7 @@ public:
             throw std::logic_error("HashTable::getLockedBucket: Cannot call on a "
                     "non-active object");
         }
-        return getLockedBucketForHash(key.hash());
+        return getLockedBucketForHash(hashKey(key));
     }
 
     /**
@@ -892,6 +1218,20 @@ public:
      */
     Position pauseResumeVisit(HashTableVisitor& visitor, Position& start_pos);
 
+    /**
+     * Visit the items in a single, randomly chosen hash bucket (one chain),
+     * under the bucket's lock. Allows a visitor to sample the hashtable
+     * without iterating over all of it.
+     *
+     * The visitor's requests to pause are ignored - a chain is short.
+     *
+     * @param visitor The visitor object to use.
+     * @param rnd A random number, selecting the bucket to visit.
+     * @return The number of items visited; 0 if the bucket was empty (or
+     *         the table was resized while the bucket was being locked).
+     */
+    size_t visitRandomBucket(HashTableVisitor& visitor, size_t rnd);
+
     /**
      * Return a position at the end of the hashtable. Has similar semantics
      * as STL end() (i.e. one past the last element).
@@ -936,6 +1276,47 @@ public:
                             StoredValue*& vptr,
                             EvictionPolicy policy);
 
+    /**
+     * Take the metadata of a fully evicted item from the EvictedMetaIndex.
+     * Assumes that the hash bucket lock is already held.
+     *
+     * @param hbl HashBucketLock that must be held
+     * @param key the key of the item (which isn't in the HashTable)
+     * @return an Item (with no value) holding the metadata the item was
+     *         evicted with, or nullptr if it isn't indexed
+     */
+    std::unique_ptr<Item> unlocked_takeEvictedMeta(const HashBucketLock& hbl,
+                                                   const DocKey& key);
+
+    /**
+     * Forget any metadata of the given (fully evicted) key held in the
+     * EvictedMetaIndex, as the item has been modified on disk.
+     * Assumes that the hash bucket lock is already held.
+     */
+    void unlocked_eraseEvictedMeta(const HashBucketLock& hbl,
+                                   const DocKey& key);
+
+    const EvictedMetaIndex& getEvictedMetaIndex() const {
+        return evictedMeta;
+    }
+
+    /**
+     * Find the coldest item in the locked hash chain which could be evicted.
+     *
+     * @param hbl Lock for the chain to search (must be held)
+     * @param policy item eviction policy
+     * @param freqLimit only items with a frequency counter below this are
+     *        considered
+     * @param exclude an item which must not be returned (e.g. the one which
+     *        was just written)
+     * @return the eligible item with the lowest frequency counter, or
+     *         nullptr if there isn't one
+     */
+    StoredValue* unlocked_findColdestEvictable(const HashBucketLock& hbl,
+                                               EvictionPolicy policy,
+                                               uint8_t freqLimit,
+                                               const StoredValue* exclude);
+
     /**
      * Restore the value for the item.
      * Assumes that HT bucket lock is grabbed.
@@ -946,7 +1327,7 @@ public:
      *
      * @return true if restored; else false
      */
-    bool unlocked_restoreValue(const std::unique_lock<std::mutex>& htLock,
+    bool unlocked_restoreValue(const std::unique_lock<StripeMutex>& htLock,
                                const Item& itm,
                                StoredValue& v);
 
@@ -959,7 +1340,7 @@ public:
      * @param itm the Item whose metadata is being restored
      * @param v corresponding StoredValue
      */
-    void unlocked_restoreMeta(const std::unique_lock<std::mutex>& htLock,
+    void unlocked_restoreMeta(const std::unique_lock<StripeMutex>& htLock,
                               const Item& itm,
                               StoredValue& v);
 
@@ -992,11 +1373,16 @@ public:
      * @param keyMetaDataOnly Is the item being inserted metadata-only?
      * @param evictionPolicy What eviction policy should be used if eject is
      * true?
+     * @param restoreOnly Only restore the value of a non-resident item with
+     *        the same CAS, for a vBucket which is already serving traffic
+     *        (so its items may have been modified or deleted since warmup
+     *        read them)
      */
     MutationStatus insertFromWarmup(Item& itm,
                                     bool eject,
                                     bool keyMetaDataOnly,
-                                    EvictionPolicy evictionPolicy);
+                                    EvictionPolicy evictionPolicy,
+                                    bool restoreOnly = false);
 
     /**
      * 'Defragment' the StoredValue, this really means reallocate the object
@@ -1020,6 +1406,145 @@ private:
     // The container for actually holding the StoredValues.
     using table_type = std::vector<StoredValue::UniquePtr>;
 
+    /**
+     * Layout::Bucketed lookaside for one hash bucket, sized to a single
+     * cache line. Records the hash tag and address of the first `Slots`
+     * elements of the bucket's chain (in chain order); elements beyond that
+     * are only reachable by walking on from the last slot.
+     *
+     * Guarded by the same ht_lock as the bucket it describes, and refreshed
+     * via refreshBucketTags() whenever that bucket's chain is modified.
+     */
+    struct alignas(64) BucketTags {
+        static constexpr size_t Slots = 6;
+
+        std::array<StoredValue*, Slots> values;
+        std::array<uint16_t, Slots> tags;
+        /// Number of valid entries in values / tags.
+        uint8_t count;
+        /// True if the chain has more than Slots elements.
+        bool overflow;
+    };
+    static_assert(sizeof(BucketTags) == 64,
+                  "BucketTags should occupy exactly one cache line");
+    /// The default allocator doesn't honour alignas(64) (pre C++17), so a
+    /// BucketTags could otherwise straddle two cache lines.
+    using BucketTagsVector = std::vector<
+            BucketTags,
+            folly::AlignedSysAllocator<BucketTags,
+                                       folly::FixedAlign<alignof(BucketTags)>>>;
+
+    /// @return the hash of the given key, using this table's HashAlgorithm.
+    template <typename Key>
+    uint32_t hashKey(const Key& key) const {
+        return hashKey(key, hashAlgorithm);
+    }
+
+    static uint32_t crc32cHash(const uint8_t* data,
+                               size_t size,
+                               DocKeyEncodesCollectionId encoding);
+
+    /**
+     * @return the 64-bit fingerprint identifying the given key in the
+     *         EvictedMetaIndex - made of two independent hashes, so
+     *         independent of the table's HashAlgorithm.
+     */
+    template <typename Key>
+    static uint64_t fingerprintKey(const Key& key) {
+        return (uint64_t(crc32cHash(key.data(), key.size(), key.getEncoding()))
+                << 32) |
+               key.hash();
+    }
+
+    /// @return the hash tag recorded in BucketTags and in each StoredValue
+    /// (see StoredValue::getKeyHashTag) for the given key hash.
+    static uint16_t tagForHash(uint32_t h) {
+        // Low bits select the bucket; use the high bits so keys in the same
+        // bucket are unlikely to share a tag.
+        return static_cast<uint16_t>(h >> 16);
+    }
+
+    /**
+     * @return the total number of hash buckets which can be addressed - the
+     * size of the table, plus the size of the new table if an incremental
+     * resize is in progress.
+     */
+    size_t getNumBuckets() const {
+        return size + (resizing ? resizeSize.load() : 0);
+    }
+
+    /// @return the chain of StoredValues for the given bucket number.
+    StoredValue::UniquePtr& chainHead(int bucket_num) {
+        if (bucket_num < static_cast<int>(size)) {
+            return values[bucket_num];
+        }
+        return resizeValues[bucket_num - size];
+    }
+
+    /// @return the BucketTags for the given bucket number.
+    BucketTags& tagsFor(int bucket_num) {
+        if (bucket_num < static_cast<int>(size)) {
+            return bucketTags[bucket_num];
+        }
+        return resizeBucketTags[bucket_num - size];
+    }
+
+    /// @return the decay epoch of the given bucket number.
+    uint32_t& decayEpochFor(int bucket_num) {
+        if (bucket_num < static_cast<int>(size)) {
+            return decayEpochs[bucket_num];
+        }
+        return resizeDecayEpochs[bucket_num - size];
+    }
+
+    /**
+     * Apply the frequency counter decay the given bucket is behind by, if
+     * any. Requires the bucket's ht_lock is held.
+     */
+    void maybeDecayBucket_UNLOCKED(int bucket_num) {
+        const uint32_t epoch = freqDecayEpoch;
+        if (decayEpochFor(bucket_num) != epoch) {
+            decayBucket_UNLOCKED(bucket_num, epoch);
+        }
+    }
+
+    /**
+     * Decay the frequency counters of the given bucket's chain from the
+     * bucket's epoch to the given one. Requires the bucket's ht_lock is held.
+     */
+    void decayBucket_UNLOCKED(int bucket_num, uint32_t epoch);
+
+    /// @return the preferred number of buckets given the current number of
+    /// items.
+    size_t getPreferredSize() const;
+
+    /**
+     * Start an incremental resize to the given size. Requires all ht_locks
+     * are held, no incremental resize is already in progress and that both
+     * the current and new size are a multiple of the number of locks.
+     *
+     * @param newValues Bucket vector (of the new size) to migrate into.
+     */
+    void beginIncrementalResize_UNLOCKED(table_type newValues);
+
+    /**
+     * Migrate the chain of the given old bucket into the new table. Requires
+     * the bucket's ht_lock is held.
+     */
+    void migrateBucket_UNLOCKED(size_t bucket_num);
+
+    /**
+     * Migrate all remaining buckets and switch over to the new table.
+     * Requires all ht_locks are held.
+     */
+    void completeIncrementalResize_UNLOCKED();
+
+    /**
+     * Discard an in-progress incremental resize whose tables have already
+     * been emptied (by clear). Requires all ht_locks are held.
+     */
+    void abandonIncrementalResize_UNLOCKED();
+
     friend class StoredValue;
     friend std::ostream& operator<<(std::ostream& os, const HashTable& ht);
 
@@ -1033,7 +1558,9 @@ private:
      * @return HashBucektLock which contains a lock and the hash bucket number
      */
     inline HashBucketLock getLockedBucket(int bucket) {
-        return HashBucketLock(bucket, mutexes[mutexForBucket(bucket)]);
+        HashBucketLock rv(bucket, mutexes[mutexForBucket(bucket)]);
+        maybeDecayBucket_UNLOCKED(bucket);
+        return rv;
     }
 
     /**
@@ -1053,6 +1580,7 @@ private:
             int bucket = getBucketForHash(h);
             HashBucketLock rv(bucket, mutexes[mutexForBucket(bucket)]);
             if (bucket == getBucketForHash(h)) {
+                maybeDecayBucket_UNLOCKED(bucket);
                 return rv;
             }
         }
@@ -1083,14 +1611,63 @@ private:
                     WantsDeleted wantsDeleted,
                     Perspective perspective = Perspective::Committed);
 
+    /**
+     * Implementation of unlocked_find(), taking the already-computed hash of
+     * the key so it isn't recalculated by callers which have it to hand.
+     */
+    StoredValue* unlocked_find(const DocKey& key,
+                               uint32_t hash,
+                               int bucket_num,
+                               WantsDeleted wantsDeleted,
+                               TrackReference trackReference,
+                               Perspective perspective);
+
+    /**
+     * Rebuild the BucketTags of the given bucket from its chain. Must be
+     * called (with the bucket's ht_lock held) after any change to the
+     * chain's membership or order. No-op for Layout::Chained.
+     */
+    void refreshBucketTags(int bucket_num);
+
+    /// Rebuild the BucketTags of every bucket (all ht_locks must be held).
+    void refreshAllBucketTags();
+
     // The initial (and minimum) size of the HashTable.
     const size_t initialSize;
 
+    const Layout layout;
+
+    const HashAlgorithm hashAlgorithm;
+
     // The size of the hash table (number of buckets) - i.e. number of elements
     // in `values`
     std::atomic<size_t> size;
     table_type values;
-    std::vector<std::mutex> mutexes;
+    // Per-bucket tags for Layout::Bucketed, parallel to `values` (empty for
+    // Layout::Chained).
+    BucketTagsVector bucketTags;
+    // The frequency counter decay epoch each bucket was last decayed to,
+    // parallel to `values` and guarded by the bucket's ht_lock.
+    std::vector<uint32_t> decayEpochs;
+
+    /*
+     * Incremental resize state. resizeValues (and resizeBucketTags /
+     * resizeDecayEpochs) are the new table being migrated into; only
+     * non-empty while resizing is true.
+     * For each lock L, resizeCursor[L] is the next old bucket (of those
+     * guarded by L) to be migrated - old buckets below it are empty, with
+     * their items present in resizeValues. resizeCursor elements are written
+     * with lock L held, but read without it to select which lock to acquire.
+     */
+    std::atomic<bool> resizing{false};
+    std::atomic<size_t> resizeSize{0};
+    table_type resizeValues;
+    BucketTagsVector resizeBucketTags;
+    std::vector<uint32_t> resizeDecayEpochs;
+    std::vector<std::atomic<size_t>> resizeCursor;
+
+    std::vector<StripeMutex> mutexes;
+    const bool sharedReaderLocks;
     EPStats&             stats;
     std::unique_ptr<AbstractStoredValueFactory> valFact;
     std::atomic<size_t>       visitors;
@@ -1103,6 +1680,10 @@ private:
     std::atomic<uint64_t> maxDeletedRevSeqno;
     bool                 activeState;
 
+    // The metadata of fully evicted items; guarded by the hash bucket lock
+    // of each key as well as its own locks.
+    EvictedMetaIndex evictedMeta;
+
     // Used by generateFreqCounter to provide an incrementing value for the
     // frequency counter of storedValues.  The frequency counter is used to
     // identify which hash table entries should be evicted first.
@@ -1118,8 +1699,30 @@ private:
     // responsible for waking the ItemFreqDecayer task.
     std::function<void()> frequencyCounterSaturated{[]() {}};
 
+    // The current frequency counter decay epoch, and the percentage each
+    // epoch decays the counters to (see advanceFreqDecayEpoch()). A bucket
+    // whose epoch is behind this hasn't had the decay applied yet. 32 bits
+    // wide, as a bucket untouched for a whole wrap of the epoch (65536 epochs
+    // would be reachable with 16 bits) wouldn't be decayed at all.
+    std::atomic<uint32_t> freqDecayEpoch{0};
+    std::atomic<uint16_t> freqDecayPercent{100};
+
     int getBucketForHash(int h) {
-        return abs(h % static_cast<int>(size));
+        const int bucket = abs(h % static_cast<int>(size));
+        if (resizing && static_cast<size_t>(bucket) <
+                                resizeCursor[bucket % mutexes.size()]) {
+            // Already migrated to the new table.
+            return size + abs(h % static_cast<int>(resizeSize));
+        }
+        return bucket;
+    }
+
+    /**
+     * @return the migration cursor of the given lock if an incremental
+     *         resize is in progress, else 0.
+     */
+    size_t getResizeCursor(size_t lock) const {
+        return resizing ? resizeCursor[lock].load() : 0;
     }
 
     inline size_t mutexForBucket(size_t bucket_num) {
@@ -1130,7 +1733,28 @@ private:
         return bucket_num % mutexes.size();
     }
 
-    std::unique_ptr<Item> getRandomKeyFromSlot(int slot);
+    /**
+     * Call visitor (under the bucket's lock) with a random resident item,
+     * as described for getRandomKey().
+     * @return true if an item was visited
+     */
+    bool visitRandomValue(
+            long rnd, const std::function<void(const StoredValue&)>& visitor);
+
+    /**
+     * Call visitor with a random resident item of the chain of the given
+     * slot.
+     * @return true if an item was visited, false if the slot has none (or
+     *         is beyond the table, after a resize)
+     */
+    bool visitRandomValueInSlot(
+            size_t slot,
+            std::minstd_rand& generator,
+            const std::function<void(const StoredValue&)>& visitor);
+
+    /// The number of random buckets getRandomKey() probes before it falls
+    /// back to scanning the table.
+    static const size_t randomKeyProbes = 32;
 
     /** Searches for the first element in the specified hashChain which matches
      * predicate p, and unlinks it from the chain.
@@ -0,0 +1,306 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "hash_table_snapshot.h"
+
+#include "bucket_logger.h"
+#include "failover-table.h"
+#include "item.h"
+#include "vbucket.h"
+
+#include <platform/crc32c.h>
+#include <platform/memorymap.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const uint32_t snapshotMagic = 0x48545331; // "HTS1"
+const uint32_t snapshotVersion = 1;
+
+/// Bytes of records buffered before they are written out by save().
+const size_t writeBufferSize = 64 * 1024;
+
+/**
+ * File layout: a FileHeader, followed by FileHeader::count records, each a
+ * RecordHeader followed by RecordHeader::keyLen bytes of (collection-encoded)
+ * key. FileHeader::crc is the CRC32-C of everything after the FileHeader.
+ * Fields are in host byte order - a snapshot is only ever read back by the
+ * node which wrote it.
+ */
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t highSeqno;
+    uint64_t failoverUuid;
+    uint64_t count;
+    uint32_t crc;
+    uint16_t vbid;
+    uint16_t padding;
+};
+
+struct RecordHeader {
+    uint64_t cas;
+    uint64_t revSeqno;
+    int64_t bySeqno;
+    uint32_t flags;
+    uint32_t exptime;
+    uint16_t keyLen;
+    uint8_t datatype;
+    uint8_t freqCounter;
+};
+
+/**
+ * Serialises the metadata of each committed item in a HashTable, writing it
+ * to a file in writeBufferSize chunks.
+ */
+class SnapshotVisitor : public HashTableVisitor {
+public:
+    explicit SnapshotVisitor(FILE* file) : file(file) {
+        buffer.reserve(writeBufferSize + sizeof(RecordHeader) + 256);
+    }
+
+    bool visit(const HashTable::HashBucketLock& lh, StoredValue& v) override {
+        // Deleted items aren't loaded by the KeyDump either; prepared
+        // SyncWrites are loaded separately by warmup.
+        if (v.isDeleted() || v.isTempItem() || !v.isCommitted()) {
+            return true;
+        }
+
+        RecordHeader rec{};
+        rec.cas = v.getCas();
+        rec.revSeqno = v.getRevSeqno();
+        rec.bySeqno = v.getBySeqno();
+        rec.flags = v.getFlags();
+        rec.exptime = uint32_t(v.getExptime());
+        const auto key = v.getKey();
+        rec.keyLen = uint16_t(key.size());
+        rec.datatype = v.getDatatype();
+        rec.freqCounter = v.getFreqCounterValue();
+
+        const auto* recBytes = reinterpret_cast<const uint8_t*>(&rec);
+        buffer.insert(buffer.end(), recBytes, recBytes + sizeof(rec));
+        buffer.insert(buffer.end(), key.data(), key.data() + key.size());
+        ++count;
+
+        if (buffer.size() >= writeBufferSize) {
+            return flush();
+        }
+        return true;
+    }
+
+    /// Write out any buffered records. @return false on a write error.
+    bool flush() {
+        if (buffer.empty()) {
+            return !failed;
+        }
+        crc = crc32c(buffer.data(), buffer.size(), crc);
+        if (fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+            failed = true;
+        }
+        buffer.clear();
+        return !failed;
+    }
+
+    FILE* file;
+    std::vector<uint8_t> buffer;
+    uint64_t count = 0;
+    uint32_t crc = 0;
+    bool failed = false;
+};
+
+} // anonymous namespace
+
+std::string HashTableSnapshot::getPath(const std::string& dbname,
+                                       Vbid vbid) {
+    return dbname + "/" + std::to_string(vbid.get()) + ".htsnapshot";
+}
+
+bool HashTableSnapshot::save(const std::string& path, VBucket& vb) {
+    const auto highSeqno = vb.getPersistenceSeqno();
+    if (highSeqno != uint64_t(vb.getHighSeqno())) {
+        EP_LOG_WARN(
+                "HashTableSnapshot::save: {} not fully persisted (high "
+                "seqno:{} persisted:{}); not writing a snapshot",
+                vb.getId(),
+                vb.getHighSeqno(),
+                highSeqno);
+        return false;
+    }
+
+    // Write to a temporary file and rename it into place, so a partially
+    // written snapshot is never found by warmup.
+    const std::string tmpPath = path + ".tmp";
+    FILE* file = fopen(tmpPath.c_str(), "wb");
+    if (file == nullptr) {
+        EP_LOG_WARN("HashTableSnapshot::save: Failed to open '{}': {}",
+                    tmpPath,
+                    strerror(errno));
+        return false;
+    }
+
+    // Reserve space for the header; it's written once the count and CRC are
+    // known.
+    FileHeader header{};
+    bool rv = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    SnapshotVisitor visitor(file);
+    if (rv) {
+        vb.ht.visit(visitor);
+        rv = visitor.flush();
+    }
+
+    if (rv) {
+        header.magic = snapshotMagic;
+        header.version = snapshotVersion;
+        header.highSeqno = highSeqno;
+        header.failoverUuid = vb.failovers->getLatestUUID();
+        header.count = visitor.count;
+        header.crc = visitor.crc;
+        header.vbid = vb.getId().get();
+        rv = fseek(file, 0, SEEK_SET) == 0 &&
+             fwrite(&header, sizeof(header), 1, file) == 1;
+    }
+
+    if (fclose(file) != 0) {
+        rv = false;
+    }
+
+    if (!rv) {
+        EP_LOG_WARN("HashTableSnapshot::save: Failed to write '{}': {}",
+                    tmpPath,
+                    strerror(errno));
+        remove(tmpPath.c_str());
+        return false;
+    }
+
+    if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+        EP_LOG_WARN("HashTableSnapshot::save: Failed to rename '{}' to '{}': {}",
+                    tmpPath,
+                    path,
+                    strerror(errno));
+        remove(tmpPath.c_str());
+        return false;
+    }
+
+    EP_LOG_INFO("HashTableSnapshot::save: Wrote {} items of {} to '{}'",
+                visitor.count,
+                vb.getId(),
+                path);
+    return true;
+}
+
+bool HashTableSnapshot::load(const std::string& path,
+                             Vbid vbid,
+                             uint64_t highSeqno,
+                             uint64_t failoverUuid,
+                             const LoadCallback& callback) {
+    std::unique_ptr<cb::io::MemoryMappedFile> map;
+    try {
+        map = std::make_unique<cb::io::MemoryMappedFile>(
+                path.c_str(), cb::io::MemoryMappedFile::Mode::RDONLY);
+    } catch (const std::exception& e) {
+        EP_LOG_WARN("HashTableSnapshot::load: Failed to map '{}': {}",
+                    path,
+                    e.what());
+        return false;
+    }
+
+    const auto content = map->content();
+    const auto* data = reinterpret_cast<const uint8_t*>(content.data());
+    const size_t size = content.size();
+
+    FileHeader header;
+    if (size < sizeof(header)) {
+        EP_LOG_WARN("HashTableSnapshot::load: '{}' is truncated", path);
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+
+    if (header.magic != snapshotMagic || header.version != snapshotVersion ||
+        header.vbid != vbid.get()) {
+        EP_LOG_WARN("HashTableSnapshot::load: '{}' is not a snapshot of {}",
+                    path,
+                    vbid);
+        return false;
+    }
+    if (header.highSeqno != highSeqno ||
+        header.failoverUuid != failoverUuid) {
+        EP_LOG_INFO(
+                "HashTableSnapshot::load: '{}' is stale (snapshot seqno:{} "
+                "uuid:{}, on disk seqno:{} uuid:{})",
+                path,
+                header.highSeqno,
+                header.failoverUuid,
+                highSeqno,
+                failoverUuid);
+        return false;
+    }
+
+    const uint8_t* records = data + sizeof(header);
+    const size_t recordsSize = size - sizeof(header);
+    if (crc32c(records, recordsSize, 0) != header.crc) {
+        EP_LOG_WARN("HashTableSnapshot::load: '{}' failed CRC check", path);
+        return false;
+    }
+
+    // Check the records exactly fill the file before loading any of them.
+    uint64_t count = 0;
+    size_t offset = 0;
+    while (offset < recordsSize) {
+        RecordHeader rec;
+        if (recordsSize - offset < sizeof(rec)) {
+            break;
+        }
+        std::memcpy(&rec, records + offset, sizeof(rec));
+        offset += sizeof(rec) + rec.keyLen;
+        ++count;
+    }
+    if (offset != recordsSize || count != header.count) {
+        EP_LOG_WARN("HashTableSnapshot::load: '{}' is corrupt", path);
+        return false;
+    }
+
+    offset = 0;
+    while (offset < recordsSize) {
+        RecordHeader rec;
+        std::memcpy(&rec, records + offset, sizeof(rec));
+        offset += sizeof(rec);
+        DocKey key(records + offset,
+                   rec.keyLen,
+                   DocKeyEncodesCollectionId::Yes);
+        offset += rec.keyLen;
+
+        auto item = std::make_unique<Item>(key,
+                                           rec.flags,
+                                           time_t(rec.exptime),
+                                           value_t{},
+                                           rec.datatype,
+                                           rec.cas,
+                                           rec.bySeqno,
+                                           vbid,
+                                           rec.revSeqno);
+        item->setFreqCounterValue(rec.freqCounter);
+        if (!callback(std::move(item))) {
+            break;
+        }
+    }
+    return true;
+}
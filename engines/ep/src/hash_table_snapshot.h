@@ -0,0 +1,79 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <memcached/vbucket.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+class Item;
+class VBucket;
+
+/**
+ * A compact binary snapshot of the metadata (key, CAS, revSeqno, bySeqno,
+ * flags, expiry, datatype and frequency counter) of every committed item in
+ * a vBucket's HashTable.
+ *
+ * Written at clean shutdown so that a value-eviction warmup can bulk-load a
+ * vBucket's keys from the (memory-mapped) snapshot instead of scanning the
+ * whole of its couchstore file in the KeyDump phase.
+ *
+ * A snapshot is only valid for the exact on-disk state it was taken from: it
+ * records the vBucket's persisted high seqno and latest failover UUID, and
+ * load() rejects it if they don't match what warmup found on disk (e.g. after
+ * an unclean shutdown, or a rollback).
+ */
+class HashTableSnapshot {
+public:
+    /// Callback for each item in a snapshot; return false to stop loading.
+    using LoadCallback = std::function<bool(std::unique_ptr<Item>)>;
+
+    /// @return the path of the snapshot file for vbid in the given dbname
+    static std::string getPath(const std::string& dbname, Vbid vbid);
+
+    /**
+     * Write a snapshot of the given vBucket's HashTable to path. The vBucket
+     * must be fully persisted; the snapshot is tagged with its persistence
+     * seqno.
+     *
+     * @return true if the snapshot was written
+     */
+    static bool save(const std::string& path, VBucket& vb);
+
+    /**
+     * Load the snapshot at path, passing each item (metadata only - the
+     * value is not included) to the callback.
+     *
+     * The whole file is validated before any item is passed to the callback,
+     * so a false return means the callback was never invoked and the caller
+     * should fall back to loading the vBucket from disk.
+     *
+     * @param vbid vBucket the snapshot is expected to be for
+     * @param highSeqno the vBucket's persisted high seqno
+     * @param failoverUuid the vBucket's latest failover UUID
+     * @return true if the snapshot was valid and was loaded
+     */
+    static bool load(const std::string& path,
+                     Vbid vbid,
+                     uint64_t highSeqno,
+                     uint64_t failoverUuid,
+                     const LoadCallback& callback);
+};
@@ -59,22 +59,22 @@ void HLC::addStats(const std::string& prefix,
         add_prefixed_stat(prefix.data(), "max_cas_str", "could not get string", add_stat, c);
     }
 
-    add_prefixed_stat(prefix.data(), "total_abs_drift", cummulativeDrift.load(), add_stat, c);
-    add_prefixed_stat(prefix.data(), "total_abs_drift_count", cummulativeDriftIncrements.load(), add_stat, c);
-    add_prefixed_stat(prefix.data(), "drift_ahead_threshold_exceeded", driftAheadExceeded.load(), add_stat, c);
-    add_prefixed_stat(prefix.data(), "drift_behind_threshold_exceeded", driftBehindExceeded.load(), add_stat, c);
+    add_prefixed_stat(prefix.data(), "total_abs_drift", drift->cummulativeDrift.load(), add_stat, c);
+    add_prefixed_stat(prefix.data(), "total_abs_drift_count", drift->cummulativeDriftIncrements.load(), add_stat, c);
+    add_prefixed_stat(prefix.data(), "drift_ahead_threshold_exceeded", drift->driftAheadExceeded.load(), add_stat, c);
+    add_prefixed_stat(prefix.data(), "drift_behind_threshold_exceeded", drift->driftBehindExceeded.load(), add_stat, c);
     add_prefixed_stat(prefix.data(), "logical_clock_ticks", logicalClockTicks.load(), add_stat, c);
 
     // These are printed "as is" so we know what is being compared. Do not convert to microseconds
-    add_prefixed_stat(prefix.data(), "drift_ahead_threshold", driftAheadThreshold.load(), add_stat, c);
-    add_prefixed_stat(prefix.data(), "drift_behind_threshold", driftBehindThreshold.load(), add_stat, c);
+    add_prefixed_stat(prefix.data(), "drift_ahead_threshold", drift->driftAheadThreshold.load(), add_stat, c);
+    add_prefixed_stat(prefix.data(), "drift_behind_threshold", drift->driftBehindThreshold.load(), add_stat, c);
 }
 
 void HLC::resetStats() {
     // Don't clear max_cas or the threshold values.
-    cummulativeDrift = 0;
-    cummulativeDriftIncrements = 0;
-    driftAheadExceeded = 0;
-    driftBehindExceeded = 0;
+    drift->cummulativeDrift = 0;
+    drift->cummulativeDriftIncrements = 0;
+    drift->driftAheadExceeded = 0;
+    drift->driftBehindExceeded = 0;
     logicalClockTicks = 0;
 }
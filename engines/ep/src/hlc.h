@@ -21,6 +21,7 @@
 
 #include "atomic.h"
 
+#include <folly/CachelinePadded.h>
 #include <memcached/engine_common.h>
 #include <platform/checked_snprintf.h>
 
@@ -37,6 +38,12 @@
  * The paired "drift" counter, which is used to monitor drift over time
  * isn't atomic in that the total and update parts are not a consistent
  * snapshot.
+ *
+ * nextHLC is called for every mutation of the vbucket (normally under the
+ * CheckpointManager's queueLock, so that the CAS is ordered along with the
+ * seqno), while the drift is tracked for every setWithMeta; the drift
+ * counters are kept on their own cache line so that the threads tracking
+ * drift don't contend with the ones generating CAS values.
  */
 class HLC {
 public:
@@ -62,13 +69,7 @@ public:
         int64_t epochSeqno,
         std::chrono::microseconds aheadThreshold,
         std::chrono::microseconds behindThreshold)
-        : maxHLC(initHLC),
-          cummulativeDrift(0),
-          cummulativeDriftIncrements(0),
-          logicalClockTicks(0),
-          driftAheadExceeded(0),
-          driftBehindExceeded(0),
-          epochSeqno(epochSeqno) {
+        : maxHLC(initHLC), logicalClockTicks(0), epochSeqno(epochSeqno) {
         setDriftAheadThreshold(aheadThreshold);
         setDriftBehindThreshold(behindThreshold);
     }
@@ -79,16 +80,22 @@ public:
         // b) dropping 16-bits (done by nowHLC)
         // c) comparing it with the last known time (max_cas)
         // d) returning either now or max_cas + 1
-        uint64_t timeNow = getMasked48(getTime());
+        //
+        // A single compare-exchange normally succeeds, as the callers are
+        // serialised by the queueLock; retrying (rather than returning a
+        // value computed from a stale max_cas) keeps every value returned
+        // unique and monotonic should a setMax* race with it.
+        const uint64_t timeNow = getMasked48(getTime());
         uint64_t l = maxHLC.load();
+        uint64_t next;
+        do {
+            next = timeNow > l ? timeNow : l + 1;
+        } while (!maxHLC.compare_exchange_weak(l, next));
 
-        if (timeNow > l) {
-            atomic_setIfBigger(maxHLC, timeNow);
-            return timeNow;
+        if (next != timeNow) {
+            logicalClockTicks.fetch_add(1, std::memory_order_relaxed);
         }
-        logicalClockTicks++;
-        atomic_setIfBigger(maxHLC, l + 1);
-        return l + 1;
+        return next;
     }
 
     void setMaxHLCAndTrackDrift(uint64_t hlc) {
@@ -101,23 +108,31 @@ public:
         // E.g. 5s drift then has ~3.6 trillion updates before overflow vs 3.6
         // million if we tracked in nanoseconds.
         const auto ns = std::chrono::nanoseconds(std::abs(difference));
-        cummulativeDrift +=
-            std::chrono::duration_cast<std::chrono::microseconds>(ns).count();
-        cummulativeDriftIncrements++;
+        drift->cummulativeDrift.fetch_add(
+                std::chrono::duration_cast<std::chrono::microseconds>(ns)
+                        .count(),
+                std::memory_order_relaxed);
+        drift->cummulativeDriftIncrements.fetch_add(1,
+                                                    std::memory_order_relaxed);
 
         // If the difference is greater, count peer ahead exeception
         // If the difference is less than our -ve threshold.. count that
-        if (difference > int64_t(driftAheadThreshold)) {
-            driftAheadExceeded++;
-        } else if(difference < (0 - int64_t(driftBehindThreshold))) {
-            driftBehindExceeded++;
+        if (difference > int64_t(drift->driftAheadThreshold.load())) {
+            drift->driftAheadExceeded.fetch_add(1, std::memory_order_relaxed);
+        } else if (difference <
+                   (0 - int64_t(drift->driftBehindThreshold.load()))) {
+            drift->driftBehindExceeded.fetch_add(1, std::memory_order_relaxed);
         }
 
         setMaxHLC(hlc);
     }
 
     void setMaxHLC(uint64_t hlc) {
-        atomic_setIfBigger(maxHLC, hlc);
+        // Most peer CAS values are behind ours, so only write to (and take
+        // ownership of the cache line of) maxHLC when it has to move
+        if (hlc > maxHLC.load(std::memory_order_relaxed)) {
+            atomic_setIfBigger(maxHLC, hlc);
+        }
     }
 
     void forceMaxHLC(uint64_t hlc) {
@@ -130,12 +145,12 @@ public:
 
     DriftStats getDriftStats() const {
         // Deliberately not locking to read this pair
-        return {cummulativeDrift, cummulativeDriftIncrements};
+        return {drift->cummulativeDrift, drift->cummulativeDriftIncrements};
     }
 
     DriftExceptions getDriftExceptionCounters() const {
         // Deliberately not locking to read this pair
-        return {driftAheadExceeded, driftBehindExceeded};
+        return {drift->driftAheadExceeded, drift->driftBehindExceeded};
     }
 
     /*
@@ -144,7 +159,7 @@ public:
      * - internally we work in nanoseconds
      */
     void setDriftAheadThreshold(std::chrono::microseconds threshold) {
-        driftAheadThreshold =
+        drift->driftAheadThreshold =
             std::chrono::duration_cast<std::chrono::nanoseconds>(threshold).count();
     }
 
@@ -154,7 +169,7 @@ public:
      * - internally we work in nanoseconds
      */
     void setDriftBehindThreshold(std::chrono::microseconds threshold) {
-        driftBehindThreshold =
+        drift->driftBehindThreshold =
             std::chrono::duration_cast<std::chrono::nanoseconds>(threshold).count();
     }
 
@@ -192,18 +207,23 @@ private:
      */
     std::atomic<uint64_t> maxHLC;
 
+    /// Incremented (along with maxHLC) when nextHLC couldn't use the time
+    std::atomic<uint64_t> logicalClockTicks;
+
     /*
      * The following are used for stats/drift tracking.
      * many threads could be setting cas so they need to be atomically
      * updated for consisent totals.
      */
-    std::atomic<uint64_t> cummulativeDrift;
-    std::atomic<uint64_t> cummulativeDriftIncrements;
-    std::atomic<uint64_t> logicalClockTicks;
-    std::atomic<uint32_t> driftAheadExceeded;
-    std::atomic<uint32_t> driftBehindExceeded;
-    std::atomic<uint64_t> driftAheadThreshold;
-    std::atomic<uint64_t> driftBehindThreshold;
+    struct DriftCounters {
+        std::atomic<uint64_t> cummulativeDrift{0};
+        std::atomic<uint64_t> cummulativeDriftIncrements{0};
+        std::atomic<uint32_t> driftAheadExceeded{0};
+        std::atomic<uint32_t> driftBehindExceeded{0};
+        std::atomic<uint64_t> driftAheadThreshold{0};
+        std::atomic<uint64_t> driftBehindThreshold{0};
+    };
+    folly::CachelinePadded<DriftCounters> drift;
 
     /**
      * Documents with a seqno >= epochSeqno have a HLC generated CAS.
@@ -24,16 +24,35 @@
 
 #include <memory>
 
+/**
+ * Number of hash buckets migrated per lock acquisition when resizing
+ * incrementally. Bounds the time a front-end operation may wait on a single
+ * ht_lock.
+ */
+static const size_t incrementalResizeBatchSize = 512;
+
 /**
  * Look at all the hash tables and make sure they're sized appropriately.
  */
 class ResizingVisitor : public CappedDurationVBucketVisitor {
 public:
-    ResizingVisitor() { }
+    ResizingVisitor(bool incremental) : incremental(incremental) {
+    }
 
     void visitBucket(const VBucketPtr& vb) override {
-        vb->ht.resize();
+        if (!incremental && !vb->ht.isResizing()) {
+            vb->ht.resize();
+            return;
+        }
+        // Migrate until the resize completes or we have used up this chunk's
+        // time; any remainder is picked up by the next run of the task.
+        while (vb->ht.resizeIncrementally(incrementalResizeBatchSize) &&
+               !pauseVisitor()) {
+        }
     }
+
+private:
+    const bool incremental;
 };
 
 HashtableResizerTask::HashtableResizerTask(KVBucketIface& s, double sleepTime)
@@ -46,12 +65,14 @@ HashtableResizerTask::HashtableResizerTask(KVBucketIface& s, double sleepTime)
 
 bool HashtableResizerTask::run(void) {
     TRACE_EVENT0("ep-engine/task", "HashtableResizerTask");
-    auto pv = std::make_unique<ResizingVisitor>();
+    const bool incremental =
+            engine->getConfiguration().getHtResizeAlgo() == "incremental";
+    auto pv = std::make_unique<ResizingVisitor>(incremental);
 
-    // [per-VBucket Task] While a Hashtable is resizing no user
-    // requests can be performed (the resizing process needs to
-    // acquire all HT locks). As such we are sensitive to the duration
-    // of this task - we want to log anything which has a
+    // [per-VBucket Task] While a Hashtable is resizing (using the blocking
+    // algorithm) no user requests can be performed (the resizing process
+    // needs to acquire all HT locks). As such we are sensitive to the
+    // duration of this task - we want to log anything which has a
     // non-negligible impact on frontend operations.
     const auto maxExpectedDurationForVisitorTask =
             std::chrono::milliseconds(100);
@@ -47,6 +47,8 @@ Item::Item(const DocKey& k,
                                                      : queue_op::mutation),
       nru(INITIAL_NRU_VALUE),
       deleted(0), // false
+      xattrsHidden(0),
+      frontEndOwned(0),
       datatype(dtype) {
     if (bySeqno == 0) {
         throw std::invalid_argument("Item(): bySeqno must be non-zero");
@@ -77,6 +79,8 @@ Item::Item(const DocKey& k,
                                                      : queue_op::mutation),
       nru(nru),
       deleted(0), // false
+      xattrsHidden(0),
+      frontEndOwned(0),
       datatype(dtype) {
     if (bySeqno == 0) {
         throw std::invalid_argument("Item(): bySeqno must be non-zero");
@@ -99,7 +103,9 @@ Item::Item(const DocKey& k,
       vbucketId(vb),
       op(o),
       nru(INITIAL_NRU_VALUE),
-      deleted(0) { // false
+      deleted(0), // false
+      xattrsHidden(0),
+      frontEndOwned(0) {
     if (bySeqno < 0) {
         throw std::invalid_argument("Item(): bySeqno must be non-negative");
     }
@@ -118,6 +124,8 @@ Item::Item(const Item& other)
       nru(other.nru),
       deleted(other.deleted),
       deletionCause(other.deletionCause),
+      xattrsHidden(other.xattrsHidden),
+      frontEndOwned(0),
       datatype(other.datatype),
       durabilityReqs(other.durabilityReqs) {
     ObjectRegistry::onCreateItem(this);
@@ -127,6 +135,23 @@ Item::~Item() {
     ObjectRegistry::onDeleteItem(this);
 }
 
+queued_item Item::shareWithCheckpoint() {
+    // Until it is shared only the front end references the Item, by raw
+    // pointer, so the count is zero.
+    if (!frontEndOwned || _rc_refcount != 0) {
+        return {};
+    }
+    // The front end's reference, dropped by releaseFromFrontEnd()
+    _rc_incref();
+    return queued_item(this);
+}
+
+void Item::releaseFromFrontEnd(Item* item) {
+    if (item->_rc_refcount == 0 || item->_rc_decref() == 0) {
+        delete item;
+    }
+}
+
 std::string to_string(queue_op op) {
     switch(op) {
     case queue_op::mutation:
@@ -242,7 +267,7 @@ std::ostream& operator<<(std::ostream& os, const Blob& b) {
     return os;
 }
 
-bool Item::compressValue() {
+bool Item::compressValue(float maxCompressedRatio) {
     auto datatype = getDataType();
     if (!mcbp::datatype::is_snappy(datatype)) {
         // Attempt compression only if datatype indicates
@@ -250,9 +275,9 @@ bool Item::compressValue() {
         cb::compression::Buffer deflated;
         if (cb::compression::deflate(cb::compression::Algorithm::Snappy,
                                      {getData(), getNBytes()}, deflated)) {
-            if (deflated.size() > getNBytes()) {
-                //No point doing the compression if the deflated length
-                //is greater than the original length
+            if (deflated.size() > getNBytes() * double(maxCompressedRatio)) {
+                // No point doing the compression if the deflated length
+                // isn't sufficiently smaller than the original length
                 return true;
             }
             setData(deflated.data(), deflated.size());
@@ -341,17 +366,21 @@ item_info Item::toItemInfo(uint64_t vb_uuid, int64_t hlcEpoch) const {
     info.vbucket_uuid = vb_uuid;
     info.seqno = getBySeqno();
     info.exptime = getExptime();
-    info.nbytes = getNBytes();
     info.flags = getFlags();
     info.datatype = getDataType();
+    if (xattrsHidden) {
+        info.datatype &= ~PROTOCOL_BINARY_DATATYPE_XATTR;
+    }
 
     if (isDeleted()) {
         info.document_state = DocumentState::Deleted;
     } else {
         info.document_state = DocumentState::Alive;
     }
-    info.value[0].iov_base = const_cast<char*>(getData());
-    info.value[0].iov_len = getNBytes();
+    const auto visible = getVisibleValue();
+    info.nbytes = uint32_t(visible.size());
+    info.value[0].iov_base = const_cast<char*>(visible.data());
+    info.value[0].iov_len = visible.size();
 
     info.cas_is_hlc = hlcEpoch > HlcCasSeqnoUninitialised &&
                       int64_t(info.seqno) >= hlcEpoch;
@@ -425,6 +454,27 @@ void Item::pruneValueAndOrXattrs(IncludeValue includeVal,
     }
 }
 
+void Item::hideXattrs() {
+    if (!value || !mcbp::datatype::is_xattr(getDataType())) {
+        return;
+    }
+    if (mcbp::datatype::is_snappy(getDataType())) {
+        throw std::logic_error(
+                "Item::hideXattrs: Can't hide the xattrs of a compressed "
+                "value");
+    }
+    xattrsHidden = 1;
+}
+
+cb::const_char_buffer Item::getVisibleValue() const {
+    const cb::const_char_buffer buffer{getData(), getNBytes()};
+    if (!xattrsHidden) {
+        return buffer;
+    }
+    const auto offset = cb::xattr::get_body_offset(buffer);
+    return {buffer.data() + offset, buffer.size() - offset};
+}
+
 item_info to_item_info(const ItemMetaData& itemMeta,
                        uint8_t datatype,
                        uint32_t deleted) {
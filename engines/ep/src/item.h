@@ -117,11 +117,41 @@ public:
          const uint64_t revSeq,
          const int64_t bySeq);
 
-    /* Copy constructor */
+    /* Copy constructor (the copy is not owned by the front end) */
     Item(const Item& other);
 
     ~Item();
 
+    /**
+     * Mark this Item as allocated for (and owned by) the front end, so that
+     * it may be shared with a checkpoint.
+     */
+    void setFrontEndOwned() {
+        frontEndOwned = 1;
+    }
+
+    /**
+     * Share an Item owned by the front end with a checkpoint, instead of the
+     * checkpoint allocating a copy (and a copy of the key) from the
+     * StoredValue. Takes a reference on behalf of the front end, so the Item
+     * lives until both releaseFromFrontEnd() and the checkpoint are done
+     * with it.
+     *
+     * Must be called by the thread storing the Item; once it returns the
+     * Item may be read by other threads, so the front end must not modify
+     * it further.
+     *
+     * @return the Item as a queued_item, or null if the Item isn't owned by
+     *         the front end or has already been shared.
+     */
+    queued_item shareWithCheckpoint();
+
+    /**
+     * Free an Item the front end has finished with; if it was shared with a
+     * checkpoint, just drop the front end's reference.
+     */
+    static void releaseFromFrontEnd(Item* item);
+
     static Item* makeDeletedItem(
             DeleteSource cause,
             const DocKey& k,
@@ -152,8 +182,14 @@ public:
         return ret;
     }
 
-    /* Snappy compress value and update datatype */
-    bool compressValue();
+    /**
+     * Snappy compress value and update datatype.
+     *
+     * @param maxCompressedRatio the value is left uncompressed if it would
+     *        compress to more than this fraction of its size
+     * @return false if the compression failed
+     */
+    bool compressValue(float maxCompressedRatio = 1.0);
 
     /* Snappy uncompress value and update datatype */
     bool decompressValue();
@@ -236,6 +272,7 @@ public:
         auto freqCount = getFreqCounterValue();
         value.reset(data);
         setFreqCounterValue(freqCount);
+        xattrsHidden = 0;
     }
 
     void setFlags(uint32_t f) {
@@ -463,6 +500,22 @@ public:
     void pruneValueAndOrXattrs(IncludeValue includeVal,
                                IncludeXattrs includeXattrs);
 
+    /**
+     * Hide the xattrs at the start of the value from toItemInfo(), so that
+     * the item is sent without them; the same as pruneValueAndOrXattrs()
+     * with IncludeValue::Yes and IncludeXattrs::No except that the value
+     * (which may be shared with other items) isn't copied.
+     *
+     * @throws std::logic_error if the value is Snappy compressed
+     */
+    void hideXattrs();
+
+    /**
+     * Get the part of the value which is exposed through toItemInfo(); the
+     * whole value unless its xattrs are hidden (see hideXattrs()).
+     */
+    cb::const_char_buffer getVisibleValue() const;
+
     /// Returns if this item is a system event
     bool isSystemEvent() const {
         return op == queue_op::system_event;
@@ -515,6 +568,10 @@ private:
     uint8_t deleted : 1;
     // If deleted, deletionCause stores the cause of the deletion.
     uint8_t deletionCause : 1;
+    // Set by hideXattrs(); cleared whenever the value is replaced.
+    uint8_t xattrsHidden : 1;
+    // Set by setFrontEndOwned(); never copied.
+    uint8_t frontEndOwned : 1;
 
     // Keep a cached version of the datatype. It allows for using
     // "partial" items created from from the hashtable. Every time the
@@ -22,13 +22,16 @@
 #include "item_compressor_visitor.h"
 #include "kv_bucket.h"
 #include "stored-value.h"
+#include <gsl/gsl>
 #include <phosphor/phosphor.h>
 
 ItemCompressorTask::ItemCompressorTask(EventuallyPersistentEngine* e,
                                        EPStats& stats_)
     : GlobalTask(e, TaskId::ItemCompressorTask, 0, false),
       stats(stats_),
-      epstore_position(engine->getKVBucket()->startPosition()) {
+      epstore_position(engine->getKVBucket()->startPosition()),
+      sampler(e->getConfiguration().getCompressionSkipThreshold(),
+              e->getConfiguration().getCompressionSampleInterval()) {
 }
 
 bool ItemCompressorTask::run(void) {
@@ -64,6 +67,13 @@ bool ItemCompressorTask::run(void) {
         visitor.clearStats();
         visitor.setCompressionMode(engine->getCompressionMode());
         visitor.setMinCompressionRatio(engine->getMinCompressionRatio());
+        visitor.setHotThreshold(gsl::narrow_cast<uint8_t>(
+                engine->getConfiguration().getItemCompressorHotThreshold()));
+        sampler.setSkipThreshold(
+                engine->getConfiguration().getCompressionSkipThreshold());
+        sampler.setSampleInterval(
+                engine->getConfiguration().getCompressionSampleInterval());
+        visitor.setCompressionSampler(&sampler);
 
         // Do it - set off the visitor.
         epstore_position = engine->getKVBucket()->pauseResumeVisit(
@@ -73,6 +83,9 @@ bool ItemCompressorTask::run(void) {
         // Update stats
         stats.compressorNumCompressed.fetch_add(visitor.getCompressedCount());
         stats.compressorNumVisited.fetch_add(visitor.getVisitedCount());
+        stats.compressorNumSkippedHot.fetch_add(visitor.getSkippedHotCount());
+        stats.compressorNumSkippedIncompressible.fetch_add(
+                visitor.getSkippedIncompressibleCount());
 
         // Check if the visitor completed a full pass.
         bool completed =
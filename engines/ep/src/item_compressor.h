@@ -16,6 +16,7 @@
  */
 #pragma once
 
+#include "compression_sampler.h"
 #include "globaltask.h"
 #include "kv_bucket_iface.h"
 
@@ -62,4 +63,10 @@ private:
      * complete pass.
      */
     std::unique_ptr<PauseResumeVBAdapter> prAdapter;
+
+    /**
+     * Which collections hold incompressible data. Kept across passes, so
+     * each pass benefits from what the previous ones learnt.
+     */
+    CompressionSampler sampler;
 };
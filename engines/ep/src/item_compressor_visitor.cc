@@ -16,6 +16,7 @@
  */
 
 #include "item_compressor_visitor.h"
+#include "compression_sampler.h"
 #include <platform/compress.h>
 
 // ItemCompressorVisitor implementation //////////////////////////////
@@ -23,8 +24,12 @@
 ItemCompressorVisitor::ItemCompressorVisitor()
     : compressed_count(0),
       visited_count(0),
+      skipped_hot_count(0),
+      skipped_incompressible_count(0),
       currentVb(nullptr),
-      currentMinCompressionRatio(0.0) {
+      currentMinCompressionRatio(0.0),
+      hotThreshold(0),
+      sampler(nullptr) {
 }
 
 ItemCompressorVisitor::~ItemCompressorVisitor() {
@@ -40,6 +45,23 @@ bool ItemCompressorVisitor::visit(const HashTable::HashBucketLock& lh,
 
     // Check if the item can be compressed
     if (compressMode == BucketCompressionMode::Active && v.isCompressible()) {
+        // Leave hot items uncompressed; otherwise every read from a client
+        // which doesn't support Snappy would have to decompress them.
+        if (hotThreshold != 0 && v.getFreqCounterValue() >= hotThreshold) {
+            skipped_hot_count++;
+            visited_count++;
+            return progressTracker.shouldContinueVisiting(visited_count);
+        }
+
+        // Don't try to compress values of collections whose recent values
+        // all turned out to be incompressible, other than as a sample.
+        const auto cid = v.getKey().getCollectionID();
+        if (sampler && !sampler->shouldAttempt(cid)) {
+            skipped_incompressible_count++;
+            visited_count++;
+            return progressTracker.shouldContinueVisiting(visited_count);
+        }
+
         cb::compression::Buffer deflated;
         if (cb::compression::deflate(cb::compression::Algorithm::Snappy,
                                      {v.getValue()->getData(), v.valuelen()},
@@ -49,7 +71,11 @@ bool ItemCompressorVisitor::visit(const HashTable::HashBucketLock& lh,
 
             // Compress the document only if the compression ratio is greater
             // than or equal to the current minium compression ratio
-            if (comp_ratio >= currentMinCompressionRatio) {
+            const bool compress = comp_ratio >= currentMinCompressionRatio;
+            if (sampler) {
+                sampler->record(cid, compress);
+            }
+            if (compress) {
                 currentVb->ht.storeCompressedBuffer(deflated, v);
 
                 // If the value was compressed, increment the count of number
@@ -71,6 +97,8 @@ bool ItemCompressorVisitor::visit(const HashTable::HashBucketLock& lh,
 void ItemCompressorVisitor::clearStats() {
     compressed_count = 0;
     visited_count = 0;
+    skipped_hot_count = 0;
+    skipped_incompressible_count = 0;
 }
 
 size_t ItemCompressorVisitor::getCompressedCount() const {
@@ -81,6 +109,14 @@ size_t ItemCompressorVisitor::getVisitedCount() const {
     return visited_count;
 }
 
+size_t ItemCompressorVisitor::getSkippedHotCount() const {
+    return skipped_hot_count;
+}
+
+size_t ItemCompressorVisitor::getSkippedIncompressibleCount() const {
+    return skipped_incompressible_count;
+}
+
 void ItemCompressorVisitor::setCompressionMode(
         const BucketCompressionMode compressionMode) {
     compressMode = compressionMode;
@@ -93,3 +129,12 @@ void ItemCompressorVisitor::setCurrentVBucket(VBucket& vb) {
 void ItemCompressorVisitor::setMinCompressionRatio(float minCompressionRatio) {
     currentMinCompressionRatio = minCompressionRatio;
 }
+
+void ItemCompressorVisitor::setHotThreshold(uint8_t threshold) {
+    hotThreshold = threshold;
+}
+
+void ItemCompressorVisitor::setCompressionSampler(
+        CompressionSampler* compressionSampler) {
+    sampler = compressionSampler;
+}
@@ -22,6 +22,8 @@
 #include "vb_visitors.h"
 #include "vbucket.h"
 
+class CompressionSampler;
+
 /**
  * Item Compressor visitor - visit all objects in a VBucket and compress
  * the values
@@ -41,6 +43,14 @@ public:
     // Set the minimum compression ratio
     void setMinCompressionRatio(float minCompressionRatio);
 
+    // Set the frequency counter value at or above which items are left
+    // uncompressed (0 to compress items regardless of frequency).
+    void setHotThreshold(uint8_t threshold);
+
+    // Set the sampler used to skip compressing values of collections which
+    // hold incompressible data (nullptr to attempt every value).
+    void setCompressionSampler(CompressionSampler* compressionSampler);
+
     // Implementation of HashTableVisitor interface:
     virtual bool visit(const HashTable::HashBucketLock& lh,
                        StoredValue& v) override;
@@ -54,6 +64,13 @@ public:
     // Returns the number of documents that have been visited.
     size_t getVisitedCount() const;
 
+    // Returns the number of documents left uncompressed as they are hot.
+    size_t getSkippedHotCount() const;
+
+    // Returns the number of documents not compressed as their collection
+    // appears to hold incompressible data.
+    size_t getSkippedIncompressibleCount() const;
+
     void setCurrentVBucket(VBucket& vb) override;
 
 private:
@@ -67,6 +84,11 @@ private:
     size_t compressed_count;
     // How many documents have been visited.
     size_t visited_count;
+    // How many compressible documents were skipped as they are hot.
+    size_t skipped_hot_count;
+    // How many compressible documents were skipped as their collection's
+    // recent values were incompressible.
+    size_t skipped_incompressible_count;
 
     // Current compression mode of the bucket
     BucketCompressionMode compressMode;
@@ -76,4 +98,11 @@ private:
 
     // The current minimum compression ratio supported by the bucket
     float currentMinCompressionRatio;
+
+    // Frequency counter value at or above which items are not compressed;
+    // 0 if disabled.
+    uint8_t hotThreshold;
+
+    // Tracks which collections hold incompressible data; not owned.
+    CompressionSampler* sampler;
 };
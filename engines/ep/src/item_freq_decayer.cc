@@ -18,19 +18,33 @@
 #include "item_freq_decayer.h"
 #include "bucket_logger.h"
 #include "ep_engine.h"
-#include "item_freq_decayer_visitor.h"
 #include "kv_bucket.h"
-#include "stored-value.h"
+#include "vb_visitors.h"
 
 #include <phosphor/phosphor.h>
 
 #include <limits>
 
+namespace {
+/// Starts a new frequency counter decay epoch in each vBucket.
+class FreqDecayEpochVisitor : public VBucketVisitor {
+public:
+    explicit FreqDecayEpochVisitor(uint16_t percentage)
+        : percentage(percentage) {
+    }
+
+    void visitBucket(const VBucketPtr& vb) override {
+        vb->ht.advanceFreqDecayEpoch(percentage);
+    }
+
+private:
+    const uint16_t percentage;
+};
+} // namespace
+
 ItemFreqDecayerTask::ItemFreqDecayerTask(EventuallyPersistentEngine* e,
                                          uint16_t percentage_)
     : GlobalTask(e, TaskId::ItemFreqDecayerTask, 0, false),
-      completed(false),
-      epstore_position(engine->getKVBucket()->startPosition()),
       notified(false),
       percentage(percentage_) {
 }
@@ -45,66 +59,16 @@ bool ItemFreqDecayerTask::run(void) {
 
     ++(engine->getEpStats().freqDecayerRuns);
 
-    // Get our pause/resume visitor. If we didn't finish the previous pass,
-    // then resume from where we last were, otherwise create a new visitor
-    // starting from the beginning.
-    if (!prAdapter) {
-        prAdapter = std::make_unique<PauseResumeVBAdapter>(
-                std::make_unique<ItemFreqDecayerVisitor>(percentage));
-        epstore_position = engine->getKVBucket()->startPosition();
-        completed = false;
-    }
+    // The decay itself is applied to each hash bucket as it is next locked,
+    // so there's no need to visit the documents.
+    FreqDecayEpochVisitor visitor(percentage);
+    engine->getKVBucket()->visit(visitor);
+    EP_LOG_DEBUG("{} for bucket '{}' advanced the decay epoch.",
+                 getDescription(),
+                 engine->getName());
 
-    // Print start status.
-    std::stringstream ss;
-    ss << getDescription() << " for bucket '" << engine->getName() << "'";
-    if (epstore_position == engine->getKVBucket()->startPosition()) {
-        ss << " starting. ";
-    } else {
-        ss << " resuming from " << epstore_position << ", ";
-        ss << prAdapter->getHashtablePosition() << ".";
-    }
-    ss << " Using chunk_duration=" << getChunkDuration().count() << " ms.";
-    EP_LOG_DEBUG("{}", ss.str());
-
-    // Prepare the underlying visitor.
-    auto& visitor = getItemFreqDecayerVisitor();
-    const auto start = std::chrono::steady_clock::now();
-    const auto deadline = start + getChunkDuration();
-    visitor.setDeadline(deadline);
-    visitor.clearStats();
-
-    // Do it - set off the visitor.
-    epstore_position = engine->getKVBucket()->pauseResumeVisit(
-            *prAdapter, epstore_position);
-    const auto end = std::chrono::steady_clock::now();
-
-    // Check if the visitor completed a full pass.
-    completed = (epstore_position == engine->getKVBucket()->endPosition());
-
-    // Print status.
-    ss.str("");
-    ss << getDescription() << " for bucket '" << engine->getName() << "'";
-    if (completed) {
-        ss << " finished.";
-    } else {
-        ss << " paused at position " << epstore_position << ".";
-    }
-    std::chrono::microseconds duration =
-            std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-    ss << " Took " << duration.count() << " us. to visit "
-       << visitor.getVisitedCount() << " documents.";
-    EP_LOG_DEBUG("{}", ss.str());
-
-    // Delete(reset) visitor and allow to be notified if it finished.
-    if (completed) {
-        prAdapter.reset();
-        notified.store(false);
-    } else {
-        // We have not completed decaying all the items so wake the task back
-        // up
-        wakeUp();
-    }
+    // Allow to be notified again.
+    notified.store(false);
 
     if (engine->getEpStats().isShutdown) {
         return false;
@@ -120,8 +84,11 @@ void ItemFreqDecayerTask::stop(void) {
 }
 
 void ItemFreqDecayerTask::wakeup() {
+    // Called on every access to a saturated item until the task runs, so
+    // check before attempting the exchange to keep the flag's cache line
+    // shared between the readers.
     bool expected = false;
-    if (notified.compare_exchange_strong(expected, true)) {
+    if (!notified.load() && notified.compare_exchange_strong(expected, true)) {
         ExecutorPool::get()->wake(getId());
     }
 }
@@ -131,19 +98,6 @@ std::string ItemFreqDecayerTask::getDescription() {
 }
 
 std::chrono::microseconds ItemFreqDecayerTask::maxExpectedDuration() {
-    // ItemFreqDecayerTask processes items in chunks, with each chunk
-    // constrained by a ChunkDuration runtime, so we expect to only take that
-    // long.  However, the ProgressTracker used estimates the time remaining,
-    // so apply some headroom to that figure so we don't get inundated with
-    // spurious "slow tasks" which only just exceed the limit.
-    return getChunkDuration() * 10;
-}
-
-std::chrono::milliseconds ItemFreqDecayerTask::getChunkDuration() const {
-    return std::chrono::milliseconds(
-            engine->getConfiguration().getItemFreqDecayerChunkDuration());
-}
-
-ItemFreqDecayerVisitor& ItemFreqDecayerTask::getItemFreqDecayerVisitor() {
-    return dynamic_cast<ItemFreqDecayerVisitor&>(prAdapter->getHTVisitor());
+    // The task only advances the decay epoch of each vBucket, so is quick.
+    return std::chrono::milliseconds(10);
 }
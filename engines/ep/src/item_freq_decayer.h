@@ -18,15 +18,13 @@
 #pragma once
 
 #include "globaltask.h"
-#include "kv_bucket_iface.h"
-
-class ItemFreqDecayerVisitor;
-class PauseResumeVBAdapter;
 
 /**
- * The task is responsible for running a visitor that iterates over all
- * documents in a given hash table, decaying the frequency count of each
- * document by a given percentage.
+ * The task is responsible for decaying the frequency count of every document
+ * in the bucket by a given percentage. It does so by advancing the decay
+ * epoch of each vBucket's hash table (see HashTable::advanceFreqDecayEpoch),
+ * which applies the decay lazily as each hash bucket is next accessed or
+ * visited, rather than by visiting every document.
  */
 class ItemFreqDecayerTask : public GlobalTask {
 public:
@@ -46,33 +44,11 @@ public:
     // Made virtual so can be overridden in mock version used in testing.
     virtual void wakeup();
 
-protected:
-    // bool used to indicate whether the task's visitor has finished visiting
-    // all the documents in the given hash table.
-    bool completed;
-
-    // Upper limit on how long each ager chunk can run for, before
-    // being paused.
-    virtual std::chrono::milliseconds getChunkDuration() const;
-
 private:
-    // Returns the underlying AgeVisitor instance.
-    ItemFreqDecayerVisitor& getItemFreqDecayerVisitor();
-
-    // Opaque marker indicating how far through the epStore we have visited.
-    KVBucketIface::Position epstore_position;
-
     // Atomic bool used to ensure that the task is not trigger multiple times
     std::atomic<bool> notified;
 
     // Defines by that percentage the values should be aged. 0 means that no
     // aging is performed, whilst 100 means that the values are reset.
     uint16_t percentage;
-
-    /**
-     * Visitor adapter which supports pausing & resuming (records how far
-     * though a VBucket is has got). unique_ptr as we re-create it for each
-     * complete pass.
-     */
-    std::unique_ptr<PauseResumeVBAdapter> prAdapter;
 };
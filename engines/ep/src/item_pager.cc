@@ -144,6 +144,13 @@ bool ItemPager::run(void) {
                 isEphemeral,
                 cfg.getItemEvictionAgePercentage(),
                 cfg.getItemEvictionFreqCounterAgeThreshold());
+        if (cfg.getItemEvictionStrategy() == "sampled") {
+            pv->setSampleSize(cfg.getItemEvictionSampleSize());
+        }
+        if (cfg.getItemEvictionAlgorithm() == "adaptive") {
+            pv->setEvictionPolicy(PagingVisitor::EvictionPolicy::adaptive);
+        }
+        pv->setCollectionMemoryShare(cfg.getCollectionMemoryShare());
 
         // p99.99 is ~200ms
         const auto maxExpectedDurationForVisitorTask =
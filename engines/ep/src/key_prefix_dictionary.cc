@@ -0,0 +1,119 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "key_prefix_dictionary.h"
+
+#include "objectregistry.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <shared_mutex>
+
+KeyPrefixDictionary& KeyPrefixDictionary::get() {
+    static KeyPrefixDictionary dictionary;
+    return dictionary;
+}
+
+uint16_t KeyPrefixDictionary::intern(const DocKey& key) {
+    const auto length = getPrefixLength(key);
+    if (length == 0) {
+        return 0;
+    }
+    const cb::const_char_buffer prefix{
+            reinterpret_cast<const char*>(key.data()), length};
+    {
+        std::shared_lock<folly::SharedMutex> rlh(mutex);
+        auto it = ids.find(prefix);
+        if (it != ids.end()) {
+            return it->second;
+        }
+    }
+
+    std::lock_guard<folly::SharedMutex> wlh(mutex);
+    auto it = ids.find(prefix);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    // ID 0 means "no prefix"
+    const auto id = uint16_t(ids.size() + 1);
+    if (id >= MaxPrefixes) {
+        return 0;
+    }
+    // The dictionary is shared by all buckets, so isn't accounted to the
+    // one which happens to intern a prefix.
+    NonBucketAllocationGuard guard;
+    auto* stored = new std::string(prefix.data(), prefix.size());
+    prefixes[id].store(stored, std::memory_order_release);
+    ids.emplace(cb::const_char_buffer{stored->data(), stored->size()}, id);
+    return id;
+}
+
+size_t KeyPrefixDictionary::size() const {
+    std::shared_lock<folly::SharedMutex> rlh(mutex);
+    return ids.size();
+}
+
+size_t KeyPrefixDictionary::getPrefixLength(const DocKey& key) {
+    if (key.getEncoding() != DocKeyEncodesCollectionId::Yes) {
+        return 0;
+    }
+    const auto* data = key.data();
+    const auto size = key.size();
+
+    // Skip the (unsigned_leb128 encoded) collection-ID
+    size_t pos = 0;
+    while (pos < size && (data[pos] & 0x80) != 0) {
+        ++pos;
+    }
+    ++pos;
+
+    const auto* end = data + std::min(size, size_t(MaxPrefixLength));
+    const auto* separator = std::find(data + pos, end, ':');
+    if (separator == end) {
+        return 0;
+    }
+    pos = separator - data;
+    while (pos < size && data[pos] == ':') {
+        ++pos;
+    }
+    if (pos < MinPrefixLength || pos > MaxPrefixLength) {
+        return 0;
+    }
+    return pos;
+}
+
+KeyPrefixDictionary::~KeyPrefixDictionary() {
+    for (auto& prefix : prefixes) {
+        delete prefix.load();
+    }
+}
+
+size_t KeyPrefixDictionary::BufferHash::operator()(
+        cb::const_char_buffer buffer) const {
+    size_t h = 5381;
+    for (auto c : buffer) {
+        h = ((h << 5) + h) ^ size_t(uint8_t(c));
+    }
+    return h;
+}
+
+bool KeyPrefixDictionary::BufferEqual::operator()(
+        cb::const_char_buffer a, cb::const_char_buffer b) const {
+    return a.size() == b.size() &&
+           std::memcmp(a.data(), b.data(), a.size()) == 0;
+}
@@ -0,0 +1,108 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <folly/SharedMutex.h>
+#include <memcached/dockey.h>
+#include <platform/sized_buffer.h>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+/**
+ * A dictionary of key prefixes, so StoredValues can store the (typically
+ * widely shared) prefix of their key as a 2-byte ID - see
+ * StoredValue::isKeyPrefixed.
+ *
+ * The prefix of a key is its encoded collection-ID followed by the key up to
+ * and including its first run of ':' (for example "user::" or "session:"),
+ * if that is within the first MaxPrefixLength bytes. A prefix is interned the
+ * first time it's seen and is never removed, which bounds the dictionary to
+ * MaxPrefixes entries; once full, keys with a new prefix are stored whole.
+ *
+ * Looking up a prefix by ID is lock-free, as entries never move.
+ */
+class KeyPrefixDictionary {
+public:
+    /// The most prefixes held, including the unused ID 0
+    static const size_t MaxPrefixes = 4096;
+
+    /// Shorter prefixes aren't worth replacing by an ID
+    static const size_t MinPrefixLength = 4;
+
+    /// The longest prefix, including the collection-ID
+    static const size_t MaxPrefixLength = 32;
+
+    /// The bytes taken by a prefix ID in a key
+    static const size_t IdSize = sizeof(uint16_t);
+
+    /// @return the dictionary shared by every bucket
+    static KeyPrefixDictionary& get();
+
+    /**
+     * Look up the prefix of the given key, interning it if new.
+     *
+     * @return the ID of the prefix, or 0 if the key doesn't have one (or
+     *         has a new one and the dictionary is full)
+     */
+    uint16_t intern(const DocKey& key);
+
+    /// @return the prefix with the given (non-zero) ID
+    cb::const_byte_buffer getPrefix(uint16_t id) const {
+        const auto* prefix = prefixes[id].load(std::memory_order_acquire);
+        return {reinterpret_cast<const uint8_t*>(prefix->data()),
+                prefix->size()};
+    }
+
+    /// @return the number of prefixes interned
+    size_t size() const;
+
+    /**
+     * @return the length of the prefix of the given key (including its
+     *         collection-ID), or 0 if it has none
+     */
+    static size_t getPrefixLength(const DocKey& key);
+
+    ~KeyPrefixDictionary();
+
+private:
+    struct BufferHash {
+        size_t operator()(cb::const_char_buffer buffer) const;
+    };
+
+    struct BufferEqual {
+        bool operator()(cb::const_char_buffer a,
+                        cb::const_char_buffer b) const;
+    };
+
+    mutable folly::SharedMutex mutex;
+
+    /// The ID of each prefix, keyed by a view of its string in prefixes.
+    /// Guarded by mutex.
+    std::unordered_map<cb::const_char_buffer, uint16_t, BufferHash, BufferEqual>
+            ids;
+
+    /// The prefix of each ID, written once (under mutex) and then read
+    /// without locking.
+    std::array<std::atomic<const std::string*>, MaxPrefixes> prefixes{};
+};
@@ -18,14 +18,20 @@
 #include <string.h>
 #include <time.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <functional>
 #include <map>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <system_error>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#include <memcached/metrics.h>
 #include <memcached/server_document_iface.h>
 #include <phosphor/phosphor.h>
 #include <utilities/logtags.h>
@@ -42,6 +48,7 @@
 #include "durability_timeout_task.h"
 #include "ep_engine.h"
 #include "ep_time.h"
+#include "eviction_ghost_list.h"
 #include "ext_meta_parser.h"
 #include "failover-table.h"
 #include "flusher.h"
@@ -54,6 +61,7 @@
 #include "kvstore.h"
 #include "locks.h"
 #include "mutation_log.h"
+#include "objectregistry.h"
 #include "replicationthrottle.h"
 #include "statwriter.h"
 #include "tasks.h"
@@ -140,6 +148,12 @@ public:
             store.setExpiryPagerSleeptime(value);
         } else if (key.compare("mutation_mem_threshold") == 0) {
             VBucket::setMutationMemoryThreshold(value);
+        } else if (key.compare("proactive_eviction_threshold") == 0) {
+            VBucket::setProactiveEvictionThreshold(value);
+        } else if (key.compare("proactive_eviction_max_items") == 0) {
+            VBucket::setProactiveEvictionMaxItems(value);
+        } else if (key.compare("touch_coalesce_window") == 0) {
+            VBucket::setTouchCoalesceWindow(value);
         } else if (key.compare("backfill_mem_threshold") == 0) {
             double backfill_threshold = static_cast<double>(value) / 100;
             store.setBackfillMemoryThreshold(backfill_threshold);
@@ -149,6 +163,9 @@ public:
             store.getEPEngine().getReplicationThrottle().setCapPercent(value);
         } else if (key.compare("max_ttl") == 0) {
             store.setMaxTtl(value);
+        } else if (key.compare("nonio_task_cpu_budget") == 0) {
+            GlobalTask::setCpuBudget(NONIO_TASK_IDX,
+                                     std::chrono::milliseconds(value));
         } else {
             EP_LOG_WARN("Failed to change value for unknown variable, {}", key);
         }
@@ -173,6 +190,8 @@ public:
             }
         } else if (key.compare("xattr_enabled") == 0) {
             store.setXattrEnabled(value);
+        } else if (key.compare("replication_throttle_rate_based") == 0) {
+            store.getEPEngine().getReplicationThrottle().setRateBased(value);
         }
     }
 
@@ -310,6 +329,9 @@ KVBucket::KVBucket(EventuallyPersistentEngine& theEngine)
     config.addValueChangedListener(
             "replication_throttle_cap_pcnt",
             std::make_unique<EPStoreValueChangeListener>(*this));
+    config.addValueChangedListener(
+            "replication_throttle_rate_based",
+            std::make_unique<EPStoreValueChangeListener>(*this));
 
     stats.warmupMemUsedCap.store(static_cast<double>
                                (config.getWarmupMinMemoryThreshold()) / 100.0);
@@ -327,6 +349,28 @@ KVBucket::KVBucket(EventuallyPersistentEngine& theEngine)
             "mutation_mem_threshold",
             std::make_unique<EPStoreValueChangeListener>(*this));
 
+    VBucket::setProactiveEvictionThreshold(
+            config.getProactiveEvictionThreshold());
+    config.addValueChangedListener(
+            "proactive_eviction_threshold",
+            std::make_unique<EPStoreValueChangeListener>(*this));
+    VBucket::setProactiveEvictionMaxItems(
+            config.getProactiveEvictionMaxItems());
+    config.addValueChangedListener(
+            "proactive_eviction_max_items",
+            std::make_unique<EPStoreValueChangeListener>(*this));
+    VBucket::setTouchCoalesceWindow(config.getTouchCoalesceWindow());
+    config.addValueChangedListener(
+            "touch_coalesce_window",
+            std::make_unique<EPStoreValueChangeListener>(*this));
+
+    GlobalTask::setCpuBudget(
+            NONIO_TASK_IDX,
+            std::chrono::milliseconds(config.getNonioTaskCpuBudget()));
+    config.addValueChangedListener(
+            "nonio_task_cpu_budget",
+            std::make_unique<EPStoreValueChangeListener>(*this));
+
     double backfill_threshold = static_cast<double>
                                       (config.getBackfillMemThreshold()) / 100;
     setBackfillMemoryThreshold(backfill_threshold);
@@ -438,6 +482,52 @@ void KVBucket::deinitialize() {
                                             stats.forceShutdown);
 }
 
+void KVBucket::freeVBuckets(size_t threads) {
+    // Detach them all first so that nothing finds a vBucket while it's being
+    // freed
+    auto vbuckets = vbMap.detachAllBuckets();
+    if (vbuckets.empty()) {
+        return;
+    }
+
+    // Start with the largest so the threads finish at about the same time
+    std::sort(vbuckets.begin(),
+              vbuckets.end(),
+              [](const VBucketPtr& a, const VBucketPtr& b) {
+                  return a->ht.getNumItems() > b->ht.getNumItems();
+              });
+    threads = std::max(size_t(1), std::min(threads, vbuckets.size()));
+    EP_LOG_INFO("Freeing {} vBuckets using {} threads",
+                vbuckets.size(),
+                threads);
+
+    std::atomic<size_t> next{0};
+    auto free = [this, &vbuckets, &next]() {
+        // The memory must be credited to this bucket whichever thread
+        // releases it
+        auto* old = ObjectRegistry::onSwitchThread(&engine, true);
+        for (auto ii = next++; ii < vbuckets.size(); ii = next++) {
+            vbuckets[ii].reset();
+        }
+        ObjectRegistry::onSwitchThread(old);
+    };
+
+    std::vector<std::thread> helpers;
+    for (size_t ii = 1; ii < threads; ++ii) {
+        try {
+            helpers.emplace_back(free);
+        } catch (const std::system_error& e) {
+            EP_LOG_WARN("Failed to create vBucket teardown thread: {}",
+                        e.what());
+            break;
+        }
+    }
+    free();
+    for (auto& helper : helpers) {
+        helper.join();
+    }
+}
+
 KVBucket::~KVBucket() {
     EP_LOG_INFO("Deleting vb_mutexes");
     EP_LOG_INFO("Deleting defragmenterTask");
@@ -529,27 +619,32 @@ void KVBucket::runPreExpiryHook(VBucket& vb, Item& it) {
     }
 }
 
+void KVBucket::prepareExpiredItem(VBucket& vb, Item& it) {
+    // MB-25931: Empty XATTR items need their value before we can call
+    // pre_expiry. These occur because the value has been evicted.
+    if (mcbp::datatype::is_xattr(it.getDataType()) && it.getNBytes() == 0) {
+        getValue(it);
+    }
+
+    // Process positive seqnos (ignoring special *temp* items) and only
+    // those items with a value
+    if (it.getBySeqno() >= 0 && it.getNBytes()) {
+        runPreExpiryHook(vb, it);
+    }
+}
+
 void KVBucket::deleteExpiredItem(Item& it,
                                  time_t startTime,
                                  ExpireBy source) {
     VBucketPtr vb = getVBucket(it.getVBucketId());
 
     if (vb) {
-        // MB-25931: Empty XATTR items need their value before we can call
-        // pre_expiry. These occur because the value has been evicted.
-        if (mcbp::datatype::is_xattr(it.getDataType()) && it.getNBytes() == 0) {
-            getValue(it);
-        }
-
-        // Process positive seqnos (ignoring special *temp* items) and only
-        // those items with a value
-        if (it.getBySeqno() >= 0 && it.getNBytes()) {
-            runPreExpiryHook(*vb, it);
-        }
+        prepareExpiredItem(*vb, it);
 
         // Obtain reader access to the VB state change lock so that
         // the VB can't switch state whilst we're processing
-        folly::SharedMutex::ReadHolder rlh(vb->getStateLock());
+        ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+                LockSite::VBucketState, vb->getStateLock());
         if (vb->getState() == vbucket_state_active) {
             vb->deleteExpiredItem(it, startTime, source);
         }
@@ -558,10 +653,35 @@ void KVBucket::deleteExpiredItem(Item& it,
 
 void KVBucket::deleteExpiredItems(
         std::list<Item>& itms, ExpireBy source) {
-    std::list<std::pair<uint16_t, std::string> >::iterator it;
-    time_t startTime = ep_real_time();
-    for (auto& it : itms) {
-        deleteExpiredItem(it, startTime, source);
+    deleteExpiredItems(itms, ep_real_time(), source);
+}
+
+void KVBucket::deleteExpiredItems(std::list<Item>& itms,
+                                  time_t startTime,
+                                  ExpireBy source) {
+    auto begin = itms.begin();
+    while (begin != itms.end()) {
+        const Vbid vbid = begin->getVBucketId();
+        const auto end =
+                std::find_if(begin, itms.end(), [vbid](const Item& it) {
+                    return it.getVBucketId() != vbid;
+                });
+
+        VBucketPtr vb = getVBucket(vbid);
+        if (vb) {
+            for (auto it = begin; it != end; ++it) {
+                prepareExpiredItem(*vb, *it);
+            }
+
+            ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+                    LockSite::VBucketState, vb->getStateLock());
+            if (vb->getState() == vbucket_state_active) {
+                for (auto it = begin; it != end; ++it) {
+                    vb->deleteExpiredItem(*it, startTime, source);
+                }
+            }
+        }
+        begin = end;
     }
 }
 
@@ -599,7 +719,8 @@ ENGINE_ERROR_CODE KVBucket::set(Item& itm,
 
     // Obtain read-lock on VB state to ensure VB state changes are interlocked
     // with this set
-    folly::SharedMutex::ReadHolder rlh(vb->getStateLock());
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, vb->getStateLock());
     if (vb->getState() == vbucket_state_dead) {
         ++stats.numNotMyVBuckets;
         return ENGINE_NOT_MY_VBUCKET;
@@ -635,6 +756,154 @@ ENGINE_ERROR_CODE KVBucket::set(Item& itm,
     }
 }
 
+cb::EngineErrorArithmeticResult KVBucket::arithmetic(const DocKey& key,
+                                                     Vbid vbid,
+                                                     const void* cookie,
+                                                     bool increment,
+                                                     uint64_t delta,
+                                                     uint64_t cas) {
+    VBucketPtr vb = getVBucket(vbid);
+    if (!vb) {
+        ++stats.numNotMyVBuckets;
+        return {cb::engine_errc::not_my_vbucket, 0, 0, 0, 0};
+    }
+
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, vb->getStateLock());
+    if (vb->getState() == vbucket_state_dead ||
+        vb->getState() == vbucket_state_replica) {
+        ++stats.numNotMyVBuckets;
+        return {cb::engine_errc::not_my_vbucket, 0, 0, 0, 0};
+    } else if (vb->getState() == vbucket_state_pending) {
+        // Leave blocking until the vbucket is active to set()
+        return {cb::engine_errc::not_supported, 0, 0, 0, 0};
+    } else if (vb->isTakeoverBackedUp()) {
+        EP_LOG_DEBUG(
+                "({}) Returned TMPFAIL to an arithmetic op, because "
+                "takeover is lagging",
+                vb->getId());
+        return {cb::engine_errc::temporary_failure, 0, 0, 0, 0};
+    }
+
+    auto cHandle = vb->lockCollections(key);
+    if (!cHandle.valid()) {
+        engine.setErrorJsonExtras(
+                cookie,
+                Collections::getUnknownCollectionErrorContext(
+                        cHandle.getManifestUid()));
+        return {cb::engine_errc::unknown_collection, 0, 0, 0, 0};
+    }
+    return vb->arithmetic(
+            cookie, engine, increment, delta, cas, getMaxTtl(), cHandle);
+}
+
+ENGINE_ERROR_CODE KVBucket::appendPrepend(const DocKey& key,
+                                          Vbid vbid,
+                                          const void* cookie,
+                                          bool append,
+                                          cb::const_char_buffer value,
+                                          uint64_t& cas,
+                                          mutation_descr_t& mutInfo) {
+    VBucketPtr vb = getVBucket(vbid);
+    if (!vb) {
+        ++stats.numNotMyVBuckets;
+        return ENGINE_NOT_MY_VBUCKET;
+    }
+
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, vb->getStateLock());
+    if (vb->getState() == vbucket_state_dead ||
+        vb->getState() == vbucket_state_replica) {
+        ++stats.numNotMyVBuckets;
+        return ENGINE_NOT_MY_VBUCKET;
+    } else if (vb->getState() == vbucket_state_pending) {
+        // Leave blocking until the vbucket is active to set()
+        return ENGINE_ENOTSUP;
+    } else if (vb->isTakeoverBackedUp()) {
+        EP_LOG_DEBUG(
+                "({}) Returned TMPFAIL to an append/prepend op, because "
+                "takeover is lagging",
+                vb->getId());
+        return ENGINE_TMPFAIL;
+    }
+
+    auto cHandle = vb->lockCollections(key);
+    if (!cHandle.valid()) {
+        engine.setErrorJsonExtras(
+                cookie,
+                Collections::getUnknownCollectionErrorContext(
+                        cHandle.getManifestUid()));
+        return ENGINE_UNKNOWN_COLLECTION;
+    }
+    return vb->appendPrepend(cookie,
+                             engine,
+                             append,
+                             value,
+                             cas,
+                             getMaxTtl(),
+                             cHandle,
+                             mutInfo);
+}
+
+ENGINE_ERROR_CODE KVBucket::bulkSet(Vbid vbid,
+                                    std::vector<std::unique_ptr<Item>>& items,
+                                    const void* cookie,
+                                    size_t& stored) {
+    stored = 0;
+    VBucketPtr vb = getVBucket(vbid);
+    if (!vb) {
+        ++stats.numNotMyVBuckets;
+        return ENGINE_NOT_MY_VBUCKET;
+    }
+
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, vb->getStateLock());
+    if (vb->getState() == vbucket_state_dead ||
+        vb->getState() == vbucket_state_replica) {
+        ++stats.numNotMyVBuckets;
+        return ENGINE_NOT_MY_VBUCKET;
+    } else if (vb->getState() == vbucket_state_pending) {
+        if (vb->addPendingOp(cookie)) {
+            return ENGINE_EWOULDBLOCK;
+        }
+    } else if (vb->isTakeoverBackedUp()) {
+        return ENGINE_TMPFAIL;
+    }
+
+    if (items.empty()) {
+        return ENGINE_SUCCESS;
+    }
+    const auto cid = items.front()->getKey().getCollectionID();
+    for (const auto& itm : items) {
+        if (itm->getKey().getCollectionID() != cid) {
+            engine.setErrorContext(cookie,
+                                   "All documents must be of one collection");
+            return ENGINE_EINVAL;
+        }
+    }
+
+    // The handle is looked up by the first key, but VBucket::set only uses
+    // it for the collection of the key (which all of the items share)
+    auto cHandle = vb->lockCollections(items.front()->getKey());
+    if (!cHandle.valid()) {
+        engine.setErrorJsonExtras(
+                cookie,
+                Collections::getUnknownCollectionErrorContext(
+                        cHandle.getManifestUid()));
+        return ENGINE_UNKNOWN_COLLECTION;
+    }
+
+    for (auto& itm : items) {
+        cHandle.processExpiryTime(*itm, getMaxTtl());
+        const auto rv = vb->set(*itm, cookie, engine, {}, cHandle);
+        if (rv != ENGINE_SUCCESS) {
+            return rv;
+        }
+        ++stored;
+    }
+    return ENGINE_SUCCESS;
+}
+
 ENGINE_ERROR_CODE KVBucket::add(Item &itm, const void *cookie)
 {
     VBucketPtr vb = getVBucket(itm.getVBucketId());
@@ -645,7 +914,8 @@ ENGINE_ERROR_CODE KVBucket::add(Item &itm, const void *cookie)
 
     // Obtain read-lock on VB state to ensure VB state changes are interlocked
     // with this add
-    folly::SharedMutex::ReadHolder rlh(vb->getStateLock());
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, vb->getStateLock());
     if (vb->getState() == vbucket_state_dead ||
         vb->getState() == vbucket_state_replica) {
         ++stats.numNotMyVBuckets;
@@ -694,7 +964,8 @@ ENGINE_ERROR_CODE KVBucket::replace(Item& itm,
 
     // Obtain read-lock on VB state to ensure VB state changes are interlocked
     // with this replace
-    folly::SharedMutex::ReadHolder rlh(vb->getStateLock());
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, vb->getStateLock());
     if (vb->getState() == vbucket_state_dead ||
         vb->getState() == vbucket_state_replica) {
         ++stats.numNotMyVBuckets;
@@ -731,7 +1002,8 @@ ENGINE_ERROR_CODE KVBucket::addBackfillItem(Item& itm,
 
     // Obtain read-lock on VB state to ensure VB state changes are interlocked
     // with this addBackfillItem
-    folly::SharedMutex::ReadHolder rlh(vb->getStateLock());
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, vb->getStateLock());
     if (vb->getState() == vbucket_state_dead ||
         vb->getState() == vbucket_state_active) {
         ++stats.numNotMyVBuckets;
@@ -872,8 +1144,10 @@ ENGINE_ERROR_CODE KVBucket::setVBucketState_UNLOCKED(
         if (config.isBfilterEnabled()) {
             // Initialize bloom filters upon vbucket creation during
             // bucket creation and rebalance
-            newvb->createFilter(config.getBfilterKeyCount(),
-                                config.getBfilterFpProb());
+            newvb->createFilter(
+                    config.getBfilterKeyCount(),
+                    config.getBfilterFpProb(),
+                    BloomFilter::typeFromString(config.getBfilterType()));
         }
 
         // The first checkpoint for active vbucket should start with id 2.
@@ -1081,6 +1355,49 @@ void KVBucket::getAggregatedVBucketStats(const void* cookie,
             *active, *replica, *pending, *dead, cookie, add_stat);
 }
 
+void KVBucket::getAggregatedVBucketMetrics(cb::metrics::Collector& collector) {
+    const std::array<std::unique_ptr<VBucketCountVisitor>, 3> visitors{
+            {makeVBCountVisitor(vbucket_state_active),
+             makeVBCountVisitor(vbucket_state_replica),
+             makeVBCountVisitor(vbucket_state_pending)}};
+
+    VBucketCountAggregator aggregator;
+    for (const auto& visitor : visitors) {
+        aggregator.addVisitor(visitor.get());
+    }
+    visit(aggregator);
+
+    // Each metric's series are to be added together
+    for (const auto& visitor : visitors) {
+        collector.addGauge("vb_num",
+                           "The number of vBuckets",
+                           {{"state", VBucket::toString(
+                                              visitor->getVBucketState())}},
+                           visitor->getVBucketNumber());
+    }
+    for (const auto& visitor : visitors) {
+        collector.addGauge("vb_curr_items",
+                           "The number of documents in the vBuckets",
+                           {{"state", VBucket::toString(
+                                              visitor->getVBucketState())}},
+                           visitor->getNumItems());
+    }
+    for (const auto& visitor : visitors) {
+        collector.addGauge(
+                "vb_num_non_resident",
+                "The number of documents whose value isn't in memory",
+                {{"state", VBucket::toString(visitor->getVBucketState())}},
+                visitor->getNonResident());
+    }
+    for (const auto& visitor : visitors) {
+        collector.addGauge(
+                "vb_queue_size",
+                "The number of items waiting to be written to disk",
+                {{"state", VBucket::toString(visitor->getVBucketState())}},
+                visitor->getQueueSize());
+    }
+}
+
 std::unique_ptr<VBucketCountVisitor> KVBucket::makeVBCountVisitor(
         vbucket_state_t state) {
     return std::make_unique<VBucketCountVisitor>(state);
@@ -1309,6 +1626,10 @@ void KVBucket::completeBGFetchMulti(
             auto* fetched_item = item.second;
             ENGINE_ERROR_CODE status = vb->completeBGFetchForSingleItem(
                     key, *fetched_item, startTime);
+            if (evictionGhostList) {
+                evictionGhostList->recordFetch(key.getDocKey(),
+                                               ep_current_time());
+            }
             engine.notifyIOComplete(fetched_item->cookie, status);
         }
         EP_LOG_DEBUG(
@@ -1348,7 +1669,8 @@ GetValue KVBucket::getInternal(const DocKey& key,
 
     const bool honorStates = (options & HONOR_STATES);
 
-    folly::SharedMutex::ReadHolder rlh(vb->getStateLock());
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, vb->getStateLock());
     if (honorStates) {
         vbucket_state_t vbState = vb->getState();
         if (vbState == vbucket_state_dead) {
@@ -1423,6 +1745,37 @@ GetValue KVBucket::getRandomKey() {
     return GetValue(NULL, ENGINE_KEY_ENOENT);
 }
 
+std::vector<StoredDocKey> KVBucket::getRandomKeys(size_t count) {
+    std::vector<StoredDocKey> keys;
+    keys.reserve(count);
+    const size_t max = vbMap.getSize();
+
+    while (keys.size() < count) {
+        // As getRandomKey(), each key is of the first active vbucket with a
+        // resident item from a random one.
+        const Vbid::id_type start = labs(getRandom()) % max;
+        Vbid::id_type curr = start;
+        boost::optional<StoredDocKey> key;
+        do {
+            VBucketPtr vb = getVBucket(Vbid(curr++));
+            if (vb && vb->getState() == vbucket_state_active) {
+                key = vb->ht.getRandomDocKey(getRandom());
+            }
+            if (curr == max) {
+                curr = 0;
+            }
+        } while (!key && curr != start);
+
+        if (!key) {
+            // No active vbucket has a resident item
+            break;
+        }
+        keys.push_back(std::move(*key));
+    }
+
+    return keys;
+}
+
 ENGINE_ERROR_CODE KVBucket::getMetaData(const DocKey& key,
                                         Vbid vbucket,
                                         const void* cookie,
@@ -1436,7 +1789,8 @@ ENGINE_ERROR_CODE KVBucket::getMetaData(const DocKey& key,
         return ENGINE_NOT_MY_VBUCKET;
     }
 
-    folly::SharedMutex::ReadHolder rlh(vb->getStateLock());
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, vb->getStateLock());
     if (vb->getState() == vbucket_state_dead ||
         vb->getState() == vbucket_state_replica) {
         ++stats.numNotMyVBuckets;
@@ -1459,6 +1813,59 @@ ENGINE_ERROR_CODE KVBucket::getMetaData(const DocKey& key,
     }
 }
 
+std::vector<ItemMetaDataResult> KVBucket::getMetaDataMulti(
+        const std::vector<DocKey>& keys, Vbid vbucket, const void* cookie) {
+    std::vector<ItemMetaDataResult> results(keys.size());
+    auto fail = [&results](ENGINE_ERROR_CODE status) {
+        for (auto& result : results) {
+            result.status = status;
+        }
+        return results;
+    };
+
+    VBucketPtr vb = getVBucket(vbucket);
+    if (!vb) {
+        stats.numNotMyVBuckets += keys.size();
+        return fail(ENGINE_NOT_MY_VBUCKET);
+    }
+
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, vb->getStateLock());
+    if (vb->getState() == vbucket_state_dead ||
+        vb->getState() == vbucket_state_replica) {
+        stats.numNotMyVBuckets += keys.size();
+        return fail(ENGINE_NOT_MY_VBUCKET);
+    }
+
+    std::vector<DocKey> bgFetches;
+    for (size_t ii = 0; ii < keys.size(); ++ii) {
+        auto& result = results[ii];
+        auto cHandle = vb->lockCollections(keys[ii]);
+        if (!cHandle.valid()) {
+            engine.setErrorJsonExtras(
+                    cookie,
+                    Collections::getUnknownCollectionErrorContext(
+                            cHandle.getManifestUid()));
+            result.status = ENGINE_UNKNOWN_COLLECTION;
+            continue;
+        }
+        result.status = vb->getMetaData(cookie,
+                                        engine,
+                                        cHandle,
+                                        result.metadata,
+                                        result.deleted,
+                                        result.datatype,
+                                        &bgFetches);
+    }
+
+    // The metadata of all of the keys missing from memory is read with one
+    // batch of fetches.
+    if (!bgFetches.empty()) {
+        vb->bgFetchMulti(bgFetches, cookie, engine, true);
+    }
+    return results;
+}
+
 ENGINE_ERROR_CODE KVBucket::setWithMeta(Item& itm,
                                         uint64_t cas,
                                         uint64_t* seqno,
@@ -1475,7 +1882,8 @@ ENGINE_ERROR_CODE KVBucket::setWithMeta(Item& itm,
         return ENGINE_NOT_MY_VBUCKET;
     }
 
-    folly::SharedMutex::ReadHolder rlh(vb->getStateLock());
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, vb->getStateLock());
     if (!permittedVBStates.test(vb->getState())) {
         if (vb->getState() == vbucket_state_pending) {
             if (vb->addPendingOp(cookie)) {
@@ -1529,6 +1937,102 @@ ENGINE_ERROR_CODE KVBucket::setWithMeta(Item& itm,
     return rv;
 }
 
+std::vector<ENGINE_ERROR_CODE> KVBucket::setWithMetaMulti(
+        const std::vector<std::pair<Item*, uint64_t>>& items,
+        Vbid vbucket,
+        std::vector<uint64_t>& seqnos,
+        const void* cookie,
+        PermittedVBStates permittedVBStates,
+        CheckConflicts checkConflicts,
+        bool allowExisting,
+        GenerateBySeqno genBySeqno,
+        GenerateCas genCas) {
+    std::vector<ENGINE_ERROR_CODE> results(items.size(), ENGINE_SUCCESS);
+    seqnos.assign(items.size(), 0);
+
+    VBucketPtr vb = getVBucket(vbucket);
+    if (!vb) {
+        stats.numNotMyVBuckets += items.size();
+        results.assign(items.size(), ENGINE_NOT_MY_VBUCKET);
+        return results;
+    }
+
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, vb->getStateLock());
+    if (!permittedVBStates.test(vb->getState())) {
+        if (vb->getState() == vbucket_state_pending) {
+            if (vb->addPendingOp(cookie)) {
+                results.assign(items.size(), ENGINE_EWOULDBLOCK);
+                return results;
+            }
+        } else {
+            stats.numNotMyVBuckets += items.size();
+            results.assign(items.size(), ENGINE_NOT_MY_VBUCKET);
+            return results;
+        }
+    } else if (vb->isTakeoverBackedUp()) {
+        EP_LOG_DEBUG(
+                "({}) Returned TMPFAIL to a setWithMetaMulti op"
+                ", becuase takeover is lagging",
+                vb->getId());
+        results.assign(items.size(), ENGINE_TMPFAIL);
+        return results;
+    }
+
+    std::vector<DocKey> bgFetches;
+    bool stored = false;
+    for (size_t ii = 0; ii < items.size(); ++ii) {
+        auto& itm = *items[ii].first;
+        if (itm.getVBucketId() != vbucket) {
+            throw std::invalid_argument(
+                    "KVBucket::setWithMetaMulti: item of " +
+                    itm.getVBucketId().to_string() + " in batch for " +
+                    vbucket.to_string());
+        }
+
+        //check for the incoming item's CAS validity
+        if (!Item::isValidCas(itm.getCas())) {
+            results[ii] = ENGINE_KEY_EEXISTS;
+            continue;
+        }
+
+        // hold collections read lock for duration of each set
+        auto cHandle = vb->lockCollections(itm.getKey());
+        if (!cHandle.valid()) {
+            engine.setErrorJsonExtras(
+                    cookie,
+                    Collections::getUnknownCollectionErrorContext(
+                            cHandle.getManifestUid()));
+            results[ii] = ENGINE_UNKNOWN_COLLECTION;
+            continue;
+        }
+        cHandle.processExpiryTime(itm, getMaxTtl());
+        results[ii] = vb->setWithMeta(itm,
+                                      items[ii].second,
+                                      &seqnos[ii],
+                                      cookie,
+                                      engine,
+                                      checkConflicts,
+                                      allowExisting,
+                                      genBySeqno,
+                                      genCas,
+                                      cHandle,
+                                      &bgFetches);
+        stored |= results[ii] == ENGINE_SUCCESS;
+    }
+
+    // The metadata of all of the keys missing from memory is read with one
+    // batch of fetches; those items are retried once it completes.
+    if (!bgFetches.empty()) {
+        vb->bgFetchMulti(bgFetches, cookie, engine, true);
+    }
+
+    if (stored) {
+        checkAndMaybeFreeMemory();
+    }
+    return results;
+}
+
 GetValue KVBucket::getAndUpdateTtl(const DocKey& key,
                                    Vbid vbucket,
                                    const void* cookie,
@@ -1539,7 +2043,8 @@ GetValue KVBucket::getAndUpdateTtl(const DocKey& key,
         return GetValue(NULL, ENGINE_NOT_MY_VBUCKET);
     }
 
-    folly::SharedMutex::ReadHolder rlh(vb->getStateLock());
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, vb->getStateLock());
     if (vb->getState() == vbucket_state_dead) {
         ++stats.numNotMyVBuckets;
         return GetValue(NULL, ENGINE_NOT_MY_VBUCKET);
@@ -1766,7 +2271,8 @@ ENGINE_ERROR_CODE KVBucket::deleteWithMeta(const DocKey& key,
         return ENGINE_NOT_MY_VBUCKET;
     }
 
-    folly::SharedMutex::ReadHolder rlh(vb->getStateLock());
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, vb->getStateLock());
     if (!permittedVBStates.test(vb->getState())) {
         if (vb->getState() == vbucket_state_pending) {
             if (vb->addPendingOp(cookie)) {
@@ -1845,6 +2351,10 @@ bool KVBucket::isWarmingUp() {
     return false;
 }
 
+bool KVBucket::isVBucketWarmingUp(Vbid vbid) {
+    return false;
+}
+
 bool KVBucket::isWarmupOOMFailure() {
     return false;
 }
@@ -2131,7 +2641,7 @@ bool VBCBAdaptor::run() {
         VBucketPtr vb = store->getVBucket(vbid);
         if (vb) {
             if (visitor->pauseVisitor()) {
-                snooze(0);
+                snooze(visitor->getPauseDuration());
                 return true;
             }
             visitor->visitBucket(vb);
@@ -2232,7 +2742,8 @@ TaskStatus KVBucket::rollback(Vbid vbid, uint64_t rollbackSeqno) {
         return TaskStatus::Abort;
     }
 
-    folly::SharedMutex::ReadHolder rlh(vb->getStateLock());
+    ProfiledLockHolder<folly::SharedMutex::ReadHolder> rlh(
+            LockSite::VBucketState, vb->getStateLock());
     if ((vb->getState() == vbucket_state_replica) ||
         (vb->getState() == vbucket_state_pending)) {
         uint64_t prevHighSeqno =
@@ -2436,6 +2947,16 @@ SyncWriteCompleteCallback KVBucket::makeSyncWriteCompleteCB() {
     };
 }
 
+SyncWriteTimeoutCallback KVBucket::makeSyncWriteTimeoutCB() const {
+    auto& task = this->durabilityTimeoutTask;
+    return [&task](Vbid vbid, std::chrono::steady_clock::time_point expiry) {
+        if (task) {
+            static_cast<DurabilityTimeoutTask&>(*task).addDeadline(vbid,
+                                                                   expiry);
+        }
+    };
+}
+
 SeqnoAckCallback KVBucket::makeSeqnoAckCB() const {
     auto& engine = this->engine;
     return [&engine](Vbid vbid, int64_t seqno) {
@@ -28,6 +28,7 @@
 #include <cstdlib>
 #include <deque>
 
+class EvictionGhostList;
 class ReplicationThrottle;
 class VBucketCountVisitor;
 namespace Collections {
@@ -110,10 +111,39 @@ public:
 
     void deinitialize() override;
 
+    /**
+     * Delete all of the vBuckets (along with their HashTables and
+     * checkpoints), spread across up to the given number of threads; the
+     * caller being one of them. Called once the bucket has been
+     * deinitialized, as freeing a large bucket one vBucket after another can
+     * take minutes.
+     */
+    void freeVBuckets(size_t threads);
+
     ENGINE_ERROR_CODE set(Item& item,
                           const void* cookie,
                           cb::StoreIfPredicate predicate = {}) override;
 
+    cb::EngineErrorArithmeticResult arithmetic(const DocKey& key,
+                                               Vbid vbid,
+                                               const void* cookie,
+                                               bool increment,
+                                               uint64_t delta,
+                                               uint64_t cas) override;
+
+    ENGINE_ERROR_CODE appendPrepend(const DocKey& key,
+                                    Vbid vbid,
+                                    const void* cookie,
+                                    bool append,
+                                    cb::const_char_buffer value,
+                                    uint64_t& cas,
+                                    mutation_descr_t& mutInfo) override;
+
+    ENGINE_ERROR_CODE bulkSet(Vbid vbid,
+                              std::vector<std::unique_ptr<Item>>& items,
+                              const void* cookie,
+                              size_t& stored) override;
+
     ENGINE_ERROR_CODE add(Item &item, const void *cookie) override;
 
     ENGINE_ERROR_CODE replace(Item& item,
@@ -133,6 +163,8 @@ public:
 
     GetValue getRandomKey() override;
 
+    std::vector<StoredDocKey> getRandomKeys(size_t count) override;
+
     GetValue getReplica(const DocKey& key,
                         Vbid vbucket,
                         const void* cookie,
@@ -148,6 +180,11 @@ public:
                                   uint32_t& deleted,
                                   uint8_t& datatype) override;
 
+    std::vector<ItemMetaDataResult> getMetaDataMulti(
+            const std::vector<DocKey>& keys,
+            Vbid vbucket,
+            const void* cookie) override;
+
     ENGINE_ERROR_CODE setWithMeta(
             Item& item,
             uint64_t cas,
@@ -160,6 +197,17 @@ public:
             GenerateCas genCas = GenerateCas::No,
             ExtendedMetaData* emd = NULL) override;
 
+    std::vector<ENGINE_ERROR_CODE> setWithMetaMulti(
+            const std::vector<std::pair<Item*, uint64_t>>& items,
+            Vbid vbucket,
+            std::vector<uint64_t>& seqnos,
+            const void* cookie,
+            PermittedVBStates permittedVBStates,
+            CheckConflicts checkConflicts,
+            bool allowExisting,
+            GenerateBySeqno genBySeqno = GenerateBySeqno::Yes,
+            GenerateCas genCas = GenerateCas::No) override;
+
     GetValue getAndUpdateTtl(const DocKey& key,
                              Vbid vbucket,
                              const void* cookie,
@@ -200,6 +248,9 @@ public:
     void getAggregatedVBucketStats(const void* cookie,
                                    const AddStatFn& add_stat) override;
 
+    void getAggregatedVBucketMetrics(
+            cb::metrics::Collector& collector) override;
+
     void completeBGFetchMulti(Vbid vbId,
                               std::vector<bgfetched_item_t>& fetchedItems,
                               std::chrono::steady_clock::time_point start) override;
@@ -412,9 +463,25 @@ public:
      */
     void runPreExpiryHook(VBucket& vb, Item& it);
 
+    /**
+     * Get an expired Item ready to be expired in the vBucket: fetch the value
+     * of an xattr item whose value was evicted, and run the pre-expiry hook.
+     */
+    void prepareExpiredItem(VBucket& vb, Item& it);
+
     void deleteExpiredItem(Item& it, time_t startTime, ExpireBy source) override;
     void deleteExpiredItems(std::list<Item>&, ExpireBy) override;
 
+    /**
+     * Expire the given items, as of startTime. Each run of items of the same
+     * vBucket is expired under a single acquisition of the vBucket's state
+     * lock (with the pre-expiry hooks of the run's items run before it),
+     * rather than one per item.
+     */
+    void deleteExpiredItems(std::list<Item>& itms,
+                            time_t startTime,
+                            ExpireBy source);
+
     /**
      * Get the value for the Item
      * If the value is already deleted no update occurs
@@ -578,6 +645,8 @@ public:
 
     bool isWarmingUp() override;
 
+    bool isVBucketWarmingUp(Vbid vbid) override;
+
     bool isWarmupOOMFailure() override;
 
     /**
@@ -652,6 +721,15 @@ public:
      *
      * @return Ref to replication throttle
      */
+    /**
+     * @return the list of recently evicted keys used to track how often
+     *         evicted items are fetched back, or nullptr if tracking is
+     *         disabled (or the bucket never fetches from disk).
+     */
+    EvictionGhostList* getEvictionGhostList() {
+        return evictionGhostList.get();
+    }
+
     ReplicationThrottle& getReplicationThrottle() {
         return *replicationThrottle;
     }
@@ -717,6 +795,12 @@ protected:
      */
     SeqnoAckCallback makeSeqnoAckCB() const;
 
+    /**
+     * Returns the callback function to be invoked at Active when a SyncWrite
+     * will time out, which registers it with the DurabilityTimeoutTask.
+     */
+    SyncWriteTimeoutCallback makeSyncWriteTimeoutCB() const;
+
     friend class Warmup;
     friend class PersistenceCallback;
 
@@ -797,6 +881,9 @@ protected:
     /* Contains info about throttling the replication */
     std::unique_ptr<ReplicationThrottle> replicationThrottle;
 
+    /// Recently evicted keys; created by buckets which BG fetch.
+    std::unique_ptr<EvictionGhostList> evictionGhostList;
+
     std::atomic<size_t> maxTtl;
 
     /**
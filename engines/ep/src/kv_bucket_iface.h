@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include "item.h"
 #include "kvstore.h"
 #include "permitted_vb_states.h"
 #include "task_type.h"
@@ -31,7 +32,6 @@ class DefragmenterTask;
 class DiskDocKey;
 class Flusher;
 class HashTable;
-class ItemMetaData;
 class KVBucket;
 class MutationLog;
 class PauseResumeVBVisitor;
@@ -40,12 +40,25 @@ class VBucketMap;
 class VBucketVisitor;
 class PausableVBucketVisitor;
 class Warmup;
+namespace cb {
+namespace metrics {
+class Collector;
+}
+} // namespace cb
 namespace Collections {
 class Manager;
 }
 
 using bgfetched_item_t = std::pair<DiskDocKey, const VBucketBGFetchItem*>;
 
+/// The metadata of one key of a batch (see KVBucketIface::getMetaDataMulti)
+struct ItemMetaDataResult {
+    ENGINE_ERROR_CODE status = ENGINE_SUCCESS;
+    ItemMetaData metadata;
+    uint32_t deleted = 0;
+    uint8_t datatype = 0;
+};
+
 /**
  * This is the abstract base class that manages the bucket behavior in
  * ep-engine.
@@ -105,6 +118,61 @@ public:
                                   const void* cookie,
                                   cb::StoreIfPredicate predicate = {}) = 0;
 
+    /**
+     * Increment or decrement the counter held by an existing document in
+     * place (see VBucket::arithmetic).
+     * @param key the key of the document
+     * @param vbid the vbucket of the document
+     * @param cookie the cookie representing the client
+     * @param increment true to add delta to the counter, false to subtract
+     * @param delta the amount to change the counter by
+     * @param cas the CAS the document must have (0 for any)
+     * @return the status and, if successful, the counter's new value and the
+     *         document's CAS, vbucket UUID and seqno
+     */
+    virtual cb::EngineErrorArithmeticResult arithmetic(const DocKey& key,
+                                                       Vbid vbid,
+                                                       const void* cookie,
+                                                       bool increment,
+                                                       uint64_t delta,
+                                                       uint64_t cas) = 0;
+
+    /**
+     * Append or prepend data to the value of an existing document in place
+     * (see VBucket::appendPrepend).
+     * @param key the key of the document
+     * @param vbid the vbucket of the document
+     * @param cookie the cookie representing the client
+     * @param append true to append value to the document, false to prepend
+     * @param value the data to add
+     * @param cas the CAS the document must have (0 for any); on success the
+     *        document's new CAS
+     * @param mutInfo on success the vbucket UUID and seqno of the mutation
+     * @return the result of the operation
+     */
+    virtual ENGINE_ERROR_CODE appendPrepend(const DocKey& key,
+                                            Vbid vbid,
+                                            const void* cookie,
+                                            bool append,
+                                            cb::const_char_buffer value,
+                                            uint64_t& cas,
+                                            mutation_descr_t& mutInfo) = 0;
+
+    /**
+     * Set a batch of items of one vbucket and collection, in order, under
+     * one acquisition of the vbucket state and collections locks.
+     * @param vbid the vbucket of the items
+     * @param items the items to set
+     * @param cookie the cookie representing the client to store the items
+     * @param [out] stored the number of items set; on error the items after
+     *        these were not set
+     * @return the result of the first item which failed, else success
+     */
+    virtual ENGINE_ERROR_CODE bulkSet(Vbid vbid,
+                                      std::vector<std::unique_ptr<Item>>& items,
+                                      const void* cookie,
+                                      size_t& stored) = 0;
+
     /**
      * Add an item in the store.
      * @param item the item to add
@@ -156,6 +224,16 @@ public:
      */
     virtual GetValue getRandomKey() = 0;
 
+    /**
+     * Sample the keys of the store at random (with replacement, so a key
+     * may be returned more than once), as getRandomKey() picks a document.
+     *
+     * @param count the number of keys to sample
+     * @return the keys; fewer than count only if the store has no resident
+     *         documents
+     */
+    virtual std::vector<StoredDocKey> getRandomKeys(size_t count) = 0;
+
     /**
      * Retrieve a value from a vbucket in replica state.
      *
@@ -191,6 +269,24 @@ public:
                                           uint32_t& deleted,
                                           uint8_t& datatype) = 0;
 
+    /**
+     * Retrieve the meta data for a batch of items of one vbucket (see
+     * getMetaData).
+     *
+     * The vbucket is looked up once for the whole batch, and the metadata of
+     * every key which isn't in memory is read from disk by a single batch of
+     * background fetches; the cookie is notified as each of them completes.
+     *
+     * @param keys the keys to get the meta data for
+     * @param vbucket the vbucket from which to retrieve the keys
+     * @param cookie the connection cookie
+     * @return one result per key, in the order of keys
+     */
+    virtual std::vector<ItemMetaDataResult> getMetaDataMulti(
+            const std::vector<DocKey>& keys,
+            Vbid vbucket,
+            const void* cookie) = 0;
+
     /**
      * Set an item in the store.
      * @param item the item to set
@@ -218,6 +314,39 @@ public:
             GenerateCas genCas = GenerateCas::No,
             ExtendedMetaData* emd = NULL) = 0;
 
+    /**
+     * Set a batch of items of one vbucket in the store (see setWithMeta).
+     *
+     * The vbucket's state is checked once for the whole batch. If conflicts
+     * are checked, the metadata of every key which isn't in memory is read
+     * from disk by a single batch of background fetches, and those items
+     * fail with ENGINE_EWOULDBLOCK (the cookie is notified as each fetch
+     * completes); the conflicts of the others are resolved straight away.
+     *
+     * @param items the items to set, each with the CAS value to match
+     * @param vbucket the vbucket of the items
+     * @param[out] seqnos the sequence number of each item set
+     * @param cookie the cookie representing the client to store the items
+     * @param permittedVBStates set of VB states that the target VB can be in
+     * @param checkConflicts set to Yes if conflict resolution must be done
+     * @param allowExisting set to false if you want set to fail if an
+     *                      item exists already
+     * @param genBySeqno whether or not to generate sequence numbers
+     * @param genCas whether or not to generate CAS values
+     *
+     * @return the result of each store operation, in the order of items
+     */
+    virtual std::vector<ENGINE_ERROR_CODE> setWithMetaMulti(
+            const std::vector<std::pair<Item*, uint64_t>>& items,
+            Vbid vbucket,
+            std::vector<uint64_t>& seqnos,
+            const void* cookie,
+            PermittedVBStates permittedVBStates,
+            CheckConflicts checkConflicts,
+            bool allowExisting,
+            GenerateBySeqno genBySeqno = GenerateBySeqno::Yes,
+            GenerateCas genCas = GenerateCas::No) = 0;
+
     /**
      * Retrieve a value, but update its TTL first
      *
@@ -352,6 +481,13 @@ public:
     virtual void getAggregatedVBucketStats(const void* cookie,
                                            const AddStatFn& add_stat) = 0;
 
+    /**
+     * Add the summarized vBucket metrics of this bucket (per vBucket state)
+     * to the collector.
+     */
+    virtual void getAggregatedVBucketMetrics(
+            cb::metrics::Collector& collector) = 0;
+
     /**
      * Get file statistics
      *
@@ -642,6 +778,12 @@ public:
 
     virtual bool isWarmingUp() = 0;
 
+    /**
+     * @return true if warmup hasn't yet loaded the given vBucket enough for
+     *         it to serve front-end traffic.
+     */
+    virtual bool isVBucketWarmingUp(Vbid vbid) = 0;
+
     /**
      * Checks the memory consumption.
      * To be used by backfill tasks (DCP).
@@ -23,6 +23,7 @@
 #include "ep_engine.h"
 #include "flusher.h"
 #include "kvshard.h"
+#include "numa_topology.h"
 #ifdef EP_USE_MAGMA
 #include "magma-kvstore/magma-kvstore_config.h"
 #endif
@@ -32,7 +33,12 @@
 
 /* [EPHE TODO]: Consider not using KVShard for ephemeral bucket */
 KVShard::KVShard(uint16_t id, Configuration& config)
-    : vbuckets(config.getMaxVbuckets()), highPriorityCount(0) {
+    : numaNode(config.isNumaAffinityEnabled() &&
+                       NumaTopology::getNumNodes() > 1
+               ? int(id % NumaTopology::getNumNodes())
+               : -1),
+      vbuckets(config.getMaxVbuckets()),
+      highPriorityCount(0) {
     const std::string backend = config.getBackend();
     if (backend == "couchdb") {
         kvConfig = std::make_unique<KVStoreConfig>(config, id);
@@ -98,6 +104,13 @@ void KVShard::dropVBucketAndSetupDeferredDeletion(Vbid id, const void* cookie) {
     vb.reset();
 }
 
+VBucketPtr KVShard::detachBucket(Vbid id) {
+    auto vb = vbuckets[id.get()].lock();
+    auto vbPtr = vb.get();
+    vb.reset();
+    return vbPtr;
+}
+
 std::vector<Vbid> KVShard::getVBucketsSortedByState() {
     std::vector<Vbid> rv;
     for (int state = vbucket_state_active;
@@ -105,7 +118,7 @@ std::vector<Vbid> KVShard::getVBucketsSortedByState() {
          ++state) {
         for (const auto& b : vbuckets) {
             auto vb = b.lock();
-            auto vbPtr = vb.get();
+            const auto& vbPtr = vb.get();
             if (vbPtr && vbPtr->getState() == state) {
                 rv.push_back(vbPtr->getId());
             }
@@ -118,7 +131,7 @@ std::vector<Vbid> KVShard::getVBuckets() {
     std::vector<Vbid> rv;
     for (const auto& b : vbuckets) {
         auto vb = b.lock();
-        auto vbPtr = vb.get();
+        const auto& vbPtr = vb.get();
         if (vbPtr) {
             rv.push_back(vbPtr->getId());
         }
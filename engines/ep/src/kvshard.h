@@ -21,6 +21,8 @@
 #include "utility.h"
 #include "vbucket.h"
 
+#include <folly/SharedMutex.h>
+
 #include <atomic>
 
 /**
@@ -96,10 +98,28 @@ public:
      */
     void dropVBucketAndSetupDeferredDeletion(Vbid id, const void* cookie);
 
+    /**
+     * Drop the vbucket from the map, without setting up deferred deletion.
+     *
+     * @return the VBucketPtr which was in the map (which may be empty), the
+     *         VBucket being deleted once the caller releases it
+     */
+    VBucketPtr detachBucket(Vbid id);
+
     KVShard::id_type getId() const {
         return kvConfig->getShardId();
     }
 
+    /**
+     * The NUMA node the shard is placed on: its flusher and BG fetcher
+     * tasks prefer threads of this node, and its vBuckets are allocated
+     * from it. -1 unless numa_affinity_enabled is set (on a machine with
+     * more than one node).
+     */
+    int getNumaNode() const {
+        return numaNode;
+    }
+
     std::vector<Vbid> getVBucketsSortedByState();
     std::vector<Vbid> getVBuckets();
 
@@ -111,10 +131,18 @@ private:
     // RocksDBKVStoreConfig) instance.
     std::unique_ptr<KVStoreConfig> kvConfig;
 
+    const int numaNode;
+
     /**
      * VBMapElement comprises the VBucket smart pointer and a mutex.
      * Access to the smart pointer must be performed through the ::Access object
      * which will perform RAII locking of the mutex.
+     *
+     * Every front-end operation looks its vbucket up, so the const (lookup)
+     * access only takes the mutex shared; with folly's SharedMutex concurrent
+     * readers mostly use their own (deferred) slots rather than all writing
+     * to the element, which would otherwise bounce between the cores (along
+     * with the neighbouring elements sharing its cache line).
      */
     class VBMapElement {
     public:
@@ -126,10 +154,10 @@ private:
          * but MSVC could not cope with it, so now you must use:
          *    access.get()-><Vbucket-method>
          */
-        template <class T>
+        template <class T, class Holder>
         class Access {
         public:
-            Access(std::mutex& m, T e) : lock(m), element(e) {
+            Access(folly::SharedMutex& m, T e) : lock(m), element(e) {
             }
 
             /**
@@ -177,20 +205,21 @@ private:
             }
 
         private:
-            std::unique_lock<std::mutex> lock;
+            Holder lock;
             T& element;
         };
 
-        Access<VBMapElement&> lock() {
+        Access<VBMapElement&, folly::SharedMutex::WriteHolder> lock() {
             return {mutex, *this};
         }
 
-        Access<const VBMapElement&> lock() const {
+        Access<const VBMapElement&, folly::SharedMutex::ReadHolder> lock()
+                const {
             return {mutex, *this};
         }
 
     private:
-        mutable std::mutex mutex;
+        mutable folly::SharedMutex mutex;
         VBucketPtr vbPtr;
     };
 
@@ -156,6 +156,7 @@ bool KVStore::updateCachedVBState(Vbid vbid, const vbucket_state& newState) {
         vbState->maxCas = std::max(vbState->maxCas, newState.maxCas);
         vbState->hlcCasEpochSeqno = newState.hlcCasEpochSeqno;
         vbState->mightContainXattrs = newState.mightContainXattrs;
+        vbState->preparesStartSeqno = newState.preparesStartSeqno;
     } else {
         cachedVBStates[vbid.get()] = std::make_unique<vbucket_state>(newState);
         if (cachedVBStates[vbid.get()]->state != vbucket_state_dead) {
@@ -290,6 +291,11 @@ void KVStore::addStats(const AddStatFn& add_stat,
         addStat(prefix, "failure_del",   st.numDelFailure,   add_stat, c);
         addStat(prefix, "failure_vbset", st.numVbSetFailure, add_stat, c);
         addStat(prefix, "lastCommDocs",  st.docsCommitted,   add_stat, c);
+        addStat(prefix,
+                "compaction_catchup_items",
+                st.compactCatchupItems,
+                add_stat,
+                c);
     }
 
     addStat(prefix,
@@ -317,9 +323,31 @@ void KVStore::addStats(const AddStatFn& add_stat,
             st.fsStatsCompaction.totalBytesRead, add_stat, c);
     addStat(prefix, "io_compaction_write_bytes",
             st.fsStatsCompaction.totalBytesWritten, add_stat, c);
+    addStat(prefix,
+            "io_flusher_write_bytes",
+            st.fsStats.totalBytesWritten,
+            add_stat,
+            c);
 
-    // Specific to RocksDB. Per-shard stats.
     size_t value = 0;
+    // Specific to CouchKVStore.
+    if (getStat("read_handle_cache_hits", value)) {
+        addStat(prefix, "read_handle_cache_hits", value, add_stat, c);
+    }
+    if (getStat("read_handle_cache_misses", value)) {
+        addStat(prefix, "read_handle_cache_misses", value, add_stat, c);
+    }
+    if (getStat("block_cache_hits", value)) {
+        addStat(prefix, "block_cache_hits", value, add_stat, c);
+    }
+    if (getStat("block_cache_misses", value)) {
+        addStat(prefix, "block_cache_misses", value, add_stat, c);
+    }
+    if (getStat("block_cache_memory", value)) {
+        addStat(prefix, "block_cache_memory", value, add_stat, c);
+    }
+
+    // Specific to RocksDB. Per-shard stats.
     // Memory Usage
     if (getStat("kMemTableTotal", value)) {
         addStat(prefix, "rocksdb_kMemTableTotal", value, add_stat, c);
@@ -436,6 +464,11 @@ void KVStore::addTimingStats(const AddStatFn& add_stat, const void* c) {
 
     addStat(prefix, "commit",      st.commitHisto,      add_stat, c);
     addStat(prefix, "compact",     st.compactHisto,     add_stat, c);
+    addStat(prefix,
+            "compact_write_block",
+            st.compactWriteBlockHisto,
+            add_stat,
+            c);
     addStat(prefix, "snapshot",    st.snapshotHisto,    add_stat, c);
     addStat(prefix, "delete",      st.delTimeHisto,     add_stat, c);
     addStat(prefix, "save_documents", st.saveDocsHisto, add_stat, c);
@@ -451,6 +484,12 @@ void KVStore::addTimingStats(const AddStatFn& add_stat, const void* c) {
             st.getMultiFsReadPerDocHisto,
             add_stat,
             c);
+    addStat(prefix, "getMultiBatchSize", st.getMultiBatchSizeHisto, add_stat, c);
+    addStat(prefix,
+            "getMultiDocReadTime",
+            st.getMultiDocReadTimeHisto,
+            add_stat,
+            c);
 
     //file ops stats
     addStat(prefix, "fsReadTime",  st.fsStats.readTimeHisto,  add_stat, c);
@@ -21,6 +21,7 @@
 #include "collections/eraser_context.h"
 #include "collections/kvstore.h"
 
+#include <boost/optional/optional.hpp>
 #include <memcached/engine_common.h>
 #include <utilities/hdrhistogram.h>
 
@@ -37,6 +38,7 @@
 
 /* Forward declarations */
 class BucketLogger;
+class CompactionThrottle;
 class DiskDocKey;
 class Item;
 class KVStore;
@@ -129,6 +131,11 @@ struct compaction_ctx {
     /// pointer as context cannot be constructed until deeper inside storage
     std::unique_ptr<Collections::VB::EraserContext> eraserContext;
     Collections::KVStore::DroppedCb droppedKeyCb;
+    /// If non-null, paces the compaction's disk IO.
+    CompactionThrottle* throttle = nullptr;
+    /// If true, the IO is only charged to the throttle - the compaction runs
+    /// under the vBucket lock, so must not sleep.
+    bool throttleDeferred = false;
 };
 
 struct kvstats_ctx {
@@ -234,11 +241,27 @@ public:
     const Vbid vbid;
     const DocumentFilter docFilter;
     const ValueFilter valFilter;
-    const uint64_t documentCount;
+    uint64_t documentCount;
 
     BucketLogger* logger;
     const KVStoreConfig& config;
     Collections::VB::ScanContext collectionsContext;
+
+    /**
+     * Set by KVStore::setScanCollections(): the (seqno, key) of each
+     * document to visit, in seqno order, in place of the by-seqno index;
+     * and how many of them have been visited so far.
+     */
+    boost::optional<std::vector<std::pair<uint64_t, DiskDocKey>>>
+            collectionKeys;
+    size_t collectionKeysVisited = 0;
+
+    /**
+     * Set by KVStore::setScanKeyOrder(): visit the documents in key order;
+     * and the key at which scan() resumes, if it returned scan_again.
+     */
+    bool keyOrder = false;
+    boost::optional<DiskDocKey> keyOrderResumeKey;
 };
 
 struct FileStats {
@@ -302,6 +325,7 @@ public:
           io_num_write(0),
           io_bgfetch_doc_bytes(0),
           io_write_bytes(0),
+          compactCatchupItems(0),
           getMultiFsReadCount(0) {
     }
 
@@ -325,6 +349,8 @@ public:
         writeSizeHisto.reset();
         delTimeHisto.reset();
         compactHisto.reset();
+        compactWriteBlockHisto.reset();
+        compactCatchupItems = 0;
         snapshotHisto.reset();
         commitHisto.reset();
         saveDocsHisto.reset();
@@ -332,6 +358,8 @@ public:
         getMultiFsReadCount = 0;
         getMultiFsReadHisto.reset();
         getMultiFsReadPerDocHisto.reset();
+        getMultiBatchSizeHisto.reset();
+        getMultiDocReadTimeHisto.reset();
         fsStats.reset();
     }
 
@@ -381,6 +409,12 @@ public:
     Hdr1sfMicroSecHistogram commitHisto;
     // Time spent in compaction
     Hdr1sfMicroSecHistogram compactHisto;
+    // Time writes to a vBucket were blocked by the final catch-up phase of
+    // a concurrent compaction
+    Hdr1sfMicroSecHistogram compactWriteBlockHisto;
+    //! Number of documents written during compaction which compaction copied
+    //! into the compacted file (concurrent compaction only)
+    cb::RelaxedAtomic<size_t> compactCatchupItems;
     // Time spent in saving documents to disk
     Hdr1sfMicroSecHistogram saveDocsHisto;
     // Batch size while saving documents
@@ -397,6 +431,13 @@ public:
     // per fetched document.
     Hdr1sfInt32Histogram getMultiFsReadPerDocHisto;
 
+    // Number of documents requested per getMulti() request; i.e. the depth
+    // of the read queue issued to the underlying storage in one go.
+    Hdr1sfInt32Histogram getMultiBatchSizeHisto;
+
+    // Time taken to read each individual document of a getMulti() request.
+    Hdr1sfMicroSecHistogram getMultiDocReadTimeHisto;
+
     // Stats from the underlying OS file operations
     FileStats fsStats;
 
@@ -409,10 +450,13 @@ public:
                writeTimeHisto.getMemFootPrint() +
                writeSizeHisto.getMemFootPrint() +
                delTimeHisto.getMemFootPrint() + compactHisto.getMemFootPrint() +
+               compactWriteBlockHisto.getMemFootPrint() +
                snapshotHisto.getMemFootPrint() + commitHisto.getMemFootPrint() +
                saveDocsHisto.getMemFootPrint() + batchSize.getMemFootPrint() +
                getMultiFsReadHisto.getMemFootPrint() +
                getMultiFsReadPerDocHisto.getMemFootPrint() +
+               getMultiBatchSizeHisto.getMemFootPrint() +
+               getMultiDocReadTimeHisto.getMemFootPrint() +
                fsStats.getMemFootPrint() + fsStatsCompaction.getMemFootPrint();
     }
 };
@@ -463,11 +507,22 @@ public:
         No
     };
 
+    enum class RangeScan {
+        Yes,
+        No
+    };
+
+    enum class ConcurrentFlush {
+        Yes,
+        No
+    };
+
     StorageProperties(EfficientVBDump evb, EfficientVBDeletion evd, PersistedDeletion pd,
-                      EfficientGet eget, ConcurrentWriteCompact cwc)
+                      EfficientGet eget, ConcurrentWriteCompact cwc,
+                      RangeScan rs, ConcurrentFlush cf)
         : efficientVBDump(evb), efficientVBDeletion(evd),
           persistedDeletions(pd), efficientGet(eget),
-          concWriteCompact(cwc) {}
+          concWriteCompact(cwc), rangeScan(rs), concurrentFlush(cf) {}
 
     /* True if we can efficiently dump a single vbucket */
     bool hasEfficientVBDump() const {
@@ -495,12 +550,25 @@ public:
         return (concWriteCompact == ConcurrentWriteCompact::Yes);
     }
 
+    /* True if the underlying storage supports scanRange() */
+    bool hasRangeScan() const {
+        return (rangeScan == RangeScan::Yes);
+    }
+
+    /* True if the flushes of different vBuckets may be made concurrently
+     * (from different threads) through one KVStore */
+    bool hasConcurrentFlush() const {
+        return (concurrentFlush == ConcurrentFlush::Yes);
+    }
+
 private:
     EfficientVBDump efficientVBDump;
     EfficientVBDeletion efficientVBDeletion;
     PersistedDeletion persistedDeletions;
     EfficientGet efficientGet;
     ConcurrentWriteCompact concWriteCompact;
+    RangeScan rangeScan;
+    ConcurrentFlush concurrentFlush;
 };
 
 /**
@@ -647,6 +715,16 @@ public:
         throw std::runtime_error("Backend does not support getMulti()");
     }
 
+    /**
+     * Retrieve multiple documents, as getMulti(), for a caller which is
+     * loading a large number of documents and doesn't care what order they
+     * are read in (access log warmup). Backends may read them in on-disk
+     * order with readahead (see warmup_access_log_readahead_size).
+     */
+    virtual void getMultiSequential(Vbid vb, vb_bgfetch_queue_t& itms) {
+        getMulti(vb, itms);
+    }
+
     /**
      * Callback for getRange().
      * @param value The fetched value. Note r-value receiver can modify (e.g.
@@ -669,11 +747,50 @@ public:
      *         completed. (Note: finding zero docments in the given range is
      *         considered successful).
      */
-    virtual void getRange(Vbid vb,
-                          const DiskDocKey& startKey,
-                          const DiskDocKey& endKey,
-                          const GetRangeCb& cb) {
-        throw std::runtime_error("Backend does not support getRange()");
+    void getRange(Vbid vb,
+                  const DiskDocKey& startKey,
+                  const DiskDocKey& endKey,
+                  const GetRangeCb& cb) {
+        scanRange(vb,
+                  startKey,
+                  endKey,
+                  ValueFilter::VALUES_DECOMPRESSED,
+                  [&cb](GetValue&& value) {
+                      cb(std::move(value));
+                      return true;
+                  });
+    }
+
+    /**
+     * Callback for scanRange().
+     * @param value The fetched item (without a value for KEYS_ONLY).
+     * @return true to continue the scan, false to stop it.
+     */
+    using ScanRangeCb = std::function<bool(GetValue&& value)>;
+
+    /**
+     * Scan a range of items from a single vBucket in key order, using the
+     * backend's by-key index (if supported by the kv store).
+     *
+     * As getRange(), but the caller chooses whether values are read, and can
+     * stop the scan early (e.g. when a page of results is full) - resuming
+     * later by scanning from the first key it didn't want.
+     *
+     * @param vb vBucket id to fetch from.
+     * @param startKey The key to start searching at. Search includes this key.
+     * @param endKey The key to end searching at. Search excludes this key.
+     * @param filter Whether to read values, and whether to decompress them.
+     * @param callback Callback invoked for each (non-deleted) key found, in
+     *        ascending key order, until it returns false.
+     * @throws std::runtime_error if the range scan could not be successfully
+     *         completed.
+     */
+    virtual void scanRange(Vbid vb,
+                           const DiskDocKey& startKey,
+                           const DiskDocKey& endKey,
+                           ValueFilter filter,
+                           const ScanRangeCb& cb) {
+        throw std::runtime_error("Backend does not support scanRange()");
     }
 
     /**
@@ -866,6 +983,35 @@ public:
             DocumentFilter options,
             ValueFilter valOptions) = 0;
 
+    /**
+     * Make a scan created by initScanContext() visit the documents in key
+     * order (walking the by-key index) instead of seqno order. Must be
+     * called before setScanCollections().
+     *
+     * @return false if the KVStore doesn't support key order scans; the scan
+     *         is then unchanged, and visits documents in seqno order.
+     */
+    virtual bool setScanKeyOrder(ScanContext& sctx) {
+        return false;
+    }
+
+    /**
+     * Restrict a scan created by initScanContext() to the documents of the
+     * given collections (and to system events): instead of walking the
+     * whole by-seqno index, read just the collections' key ranges of the
+     * by-key index, then visit the documents found in seqno order (or in
+     * key order, if setScanKeyOrder() was called).
+     * Worthwhile when the collections hold a small part of the vBucket.
+     * Updates sctx.documentCount.
+     *
+     * @return false if the KVStore doesn't support key range scans; the scan
+     *         is then unchanged, and visits every document.
+     */
+    virtual bool setScanCollections(
+            ScanContext& sctx, const std::vector<CollectionID>& collections) {
+        return false;
+    }
+
     virtual scan_error_t scan(ScanContext* sctx) = 0;
 
     virtual void destroyScanContext(ScanContext* ctx) = 0;
@@ -44,6 +44,22 @@ KVStoreConfig::KVStoreConfig(Configuration& config, uint16_t shardid)
                     config.getBackend(),
                     shardid) {
     setPeriodicSyncBytes(config.getFsyncAfterEveryNBytesWritten());
+    setWritebackBytes(config.getFsyncWritebackAfterEveryNBytesWritten());
+    setBgFetchOffsetOrder(config.isBgfetchOffsetOrder());
+    setBgFetchMergeGap(config.getBgfetchMergeGap());
+    setBackfillReadaheadSize(config.getBackfillReadaheadSize());
+    setBackfillDropBehindSize(config.getBackfillDropBehindSize());
+    setCompactionDropBehindSize(config.getCompactionDropBehindSize());
+    setWarmupReadaheadSize(config.getWarmupAccessLogReadaheadSize());
+    setConcurrentCompaction(config.isCouchstoreConcurrentCompaction());
+    setCompactionTailItems(config.getCouchstoreCompactionTailItems());
+    setCollectionPurgeRatio(config.getCouchstoreCollectionPurgeRatio());
+    setReadHandleCacheSize(config.getCouchstoreReadHandleCacheSize());
+    setRollbackIndexInterval(config.getCouchstoreRollbackIndexInterval());
+    setBlockCacheSize(size_t(config.getMaxSize() *
+                             config.getCouchstoreBlockCacheRatio() /
+                             config.getMaxNumShards()));
+    setEncryptionKeyFile(config.getCouchstoreEncryptionKeyFile());
     config.addValueChangedListener(
             "fsync_after_every_n_bytes_written",
             std::make_unique<ConfigChangeListener>(*this));
@@ -60,7 +76,21 @@ KVStoreConfig::KVStoreConfig(uint16_t _maxVBuckets,
       backend(_backend),
       shardId(_shardId),
       logger(globalBucketLogger.get()),
-      buffered(true) {
+      buffered(true),
+      bgFetchOffsetOrder(false),
+      bgFetchMergeGap(16384),
+      backfillReadaheadSize(0),
+      backfillDropBehindSize(0),
+      compactionDropBehindSize(0),
+      warmupReadaheadSize(0),
+      concurrentCompaction(true),
+      compactionTailItems(1000),
+      collectionPurgeRatio(0),
+      readHandleCacheSize(0),
+      rollbackIndexInterval(0),
+      blockCacheSize(0),
+      periodicSyncBytes(0),
+      writebackBytes(0) {
 }
 
 KVStoreConfig::~KVStoreConfig() = default;
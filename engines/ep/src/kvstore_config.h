@@ -90,6 +90,206 @@ public:
      */
     KVStoreConfig& setBuffered(bool _buffered);
 
+    /**
+     * Indicates whether getMulti() should first look up all requested
+     * documents and then read them in ascending file offset order (rather
+     * than reading each document as it is looked up, in key order).
+     *
+     * Only recognised by CouchKVStore
+     */
+    bool getBgFetchOffsetOrder() const {
+        return bgFetchOffsetOrder;
+    }
+
+    KVStoreConfig& setBgFetchOffsetOrder(bool value) {
+        bgFetchOffsetOrder = value;
+        return *this;
+    }
+
+    /**
+     * With getBgFetchOffsetOrder(), reads of documents at most this many
+     * bytes apart are merged into one (see bgfetch_merge_gap).
+     *
+     * Only recognised by CouchKVStore
+     */
+    size_t getBgFetchMergeGap() const {
+        return bgFetchMergeGap;
+    }
+
+    KVStoreConfig& setBgFetchMergeGap(size_t value) {
+        bgFetchMergeGap = value;
+        return *this;
+    }
+
+    /**
+     * Number of bytes to read ahead of a sequential by-seqno scan (see
+     * backfill_readahead_size); 0 if disabled.
+     *
+     * Only recognised by CouchKVStore
+     */
+    size_t getBackfillReadaheadSize() const {
+        return backfillReadaheadSize;
+    }
+
+    KVStoreConfig& setBackfillReadaheadSize(size_t value) {
+        backfillReadaheadSize = value;
+        return *this;
+    }
+
+    /**
+     * Number of bytes a by-seqno scan reads between asking the OS to drop
+     * what it has read from the page cache (see backfill_drop_behind_size);
+     * 0 if disabled.
+     *
+     * Only recognised by CouchKVStore
+     */
+    size_t getBackfillDropBehindSize() const {
+        return backfillDropBehindSize;
+    }
+
+    KVStoreConfig& setBackfillDropBehindSize(size_t value) {
+        backfillDropBehindSize = value;
+        return *this;
+    }
+
+    /**
+     * Number of bytes compaction reads between asking the OS to drop what it
+     * has read from the page cache (see compaction_drop_behind_size); 0 if
+     * disabled.
+     *
+     * Only recognised by CouchKVStore
+     */
+    size_t getCompactionDropBehindSize() const {
+        return compactionDropBehindSize;
+    }
+
+    KVStoreConfig& setCompactionDropBehindSize(size_t value) {
+        compactionDropBehindSize = value;
+        return *this;
+    }
+
+    /**
+     * Number of bytes to read ahead of the (offset ordered) reads of
+     * getMultiSequential() (see warmup_access_log_readahead_size); 0 if
+     * disabled, in which case getMultiSequential() is getMulti().
+     *
+     * Only recognised by CouchKVStore
+     */
+    size_t getWarmupReadaheadSize() const {
+        return warmupReadaheadSize;
+    }
+
+    KVStoreConfig& setWarmupReadaheadSize(size_t value) {
+        warmupReadaheadSize = value;
+        return *this;
+    }
+
+    /**
+     * Indicates whether writes to a vBucket may carry on while it is
+     * compacted (see couchstore_concurrent_compaction).
+     *
+     * Only recognised by CouchKVStore
+     */
+    bool getConcurrentCompaction() const {
+        return concurrentCompaction;
+    }
+
+    KVStoreConfig& setConcurrentCompaction(bool value) {
+        concurrentCompaction = value;
+        return *this;
+    }
+
+    /**
+     * Number of seqnos a concurrent compaction may leave to be copied with
+     * writes to the vBucket blocked (see couchstore_compaction_tail_items).
+     *
+     * Only recognised by CouchKVStore
+     */
+    size_t getCompactionTailItems() const {
+        return compactionTailItems;
+    }
+
+    KVStoreConfig& setCompactionTailItems(size_t value) {
+        compactionTailItems = value;
+        return *this;
+    }
+
+    /**
+     * Fraction of a vBucket's items its dropped collections must hold before
+     * they are purged by an immediate compaction (see
+     * couchstore_collection_purge_ratio).
+     *
+     * Only recognised by CouchKVStore
+     */
+    float getCollectionPurgeRatio() const {
+        return collectionPurgeRatio;
+    }
+
+    KVStoreConfig& setCollectionPurgeRatio(float value) {
+        collectionPurgeRatio = value;
+        return *this;
+    }
+
+    /**
+     * Number of idle read-only file handles each store keeps open for reuse
+     * by later reads (see couchstore_read_handle_cache_size); 0 if disabled.
+     *
+     * Only recognised by CouchKVStore
+     */
+    size_t getReadHandleCacheSize() const {
+        return readHandleCacheSize;
+    }
+
+    KVStoreConfig& setReadHandleCacheSize(size_t value) {
+        readHandleCacheSize = value;
+        return *this;
+    }
+
+    /**
+     * Seqnos between the headers recorded in each vBucket file's rollback
+     * index (see couchstore_rollback_index_interval); 0 if disabled.
+     *
+     * Only recognised by CouchKVStore
+     */
+    size_t getRollbackIndexInterval() const {
+        return rollbackIndexInterval;
+    }
+
+    KVStoreConfig& setRollbackIndexInterval(size_t value) {
+        rollbackIndexInterval = value;
+        return *this;
+    }
+
+    /**
+     * Bytes of couchstore file blocks the shard caches for reads (see
+     * couchstore_block_cache_ratio); 0 if disabled.
+     *
+     * Only recognised by CouchKVStore
+     */
+    size_t getBlockCacheSize() const {
+        return blockCacheSize;
+    }
+
+    KVStoreConfig& setBlockCacheSize(size_t value) {
+        blockCacheSize = value;
+        return *this;
+    }
+
+    /**
+     * Path of the file holding the key couchstore files are encrypted with
+     * (see couchstore_encryption_key_file); empty if disabled.
+     *
+     * Only recognised by CouchKVStore
+     */
+    const std::string& getEncryptionKeyFile() const {
+        return encryptionKeyFile;
+    }
+
+    KVStoreConfig& setEncryptionKeyFile(const std::string& value) {
+        encryptionKeyFile = value;
+        return *this;
+    }
+
     uint64_t getPeriodicSyncBytes() const {
         return periodicSyncBytes;
     }
@@ -98,6 +298,22 @@ public:
         periodicSyncBytes = bytes;
     }
 
+    /**
+     * Bytes a flush or compaction writes between starting the writeback of
+     * what it has written (see fsync_writeback_after_every_n_bytes_written);
+     * 0 if disabled.
+     *
+     * Only recognised by CouchKVStore
+     */
+    size_t getWritebackBytes() const {
+        return writebackBytes;
+    }
+
+    KVStoreConfig& setWritebackBytes(size_t value) {
+        writebackBytes = value;
+        return *this;
+    }
+
 private:
     class ConfigChangeListener;
 
@@ -109,9 +325,51 @@ private:
     BucketLogger* logger;
     bool buffered;
 
+    /// See getBgFetchOffsetOrder().
+    bool bgFetchOffsetOrder;
+
+    /// See getBgFetchMergeGap().
+    size_t bgFetchMergeGap;
+
+    /// See getBackfillReadaheadSize().
+    size_t backfillReadaheadSize;
+
+    /// See getBackfillDropBehindSize().
+    size_t backfillDropBehindSize;
+
+    /// See getCompactionDropBehindSize().
+    size_t compactionDropBehindSize;
+
+    /// See getWarmupReadaheadSize().
+    size_t warmupReadaheadSize;
+
+    /// See getConcurrentCompaction().
+    bool concurrentCompaction;
+
+    /// See getCompactionTailItems().
+    size_t compactionTailItems;
+
+    /// See getCollectionPurgeRatio().
+    float collectionPurgeRatio;
+
+    /// See getReadHandleCacheSize().
+    size_t readHandleCacheSize;
+
+    /// See getRollbackIndexInterval().
+    size_t rollbackIndexInterval;
+
+    /// See getBlockCacheSize().
+    size_t blockCacheSize;
+
+    /// See getEncryptionKeyFile().
+    std::string encryptionKeyFile;
+
     /**
      * If non-zero, tell storage layer to issue a sync() operation after every
      * N bytes written.
      */
     uint64_t periodicSyncBytes;
+
+    /// See getWritebackBytes().
+    size_t writebackBytes;
 };
@@ -20,18 +20,22 @@
 #include "item.h"
 #include "stats.h"
 
+#include <algorithm>
 #include <memcached/vbucket.h>
 #include <mutex>
 
 BasicLinkedList::BasicLinkedList(Vbid vbucketId, EPStats& st)
     : SequenceList(),
-      readRange(0, 0),
       staleSize(0),
       staleMetaDataSize(0),
+      numSinceLastIndexed(0),
+      droppedKeysPurgeScheduled(false),
+      droppedKeysPurgeInProgress(false),
       highSeqno(0),
       highestDedupedSeqno(0),
       highestPurgedDeletedSeqno(0),
       numStaleItems(0),
+      numRangeReadStaleItems(0),
       numDeletedItems(0),
       vbid(vbucketId),
       st(st),
@@ -42,6 +46,7 @@ BasicLinkedList::~BasicLinkedList() {
     /* Delete stale items here, other items are deleted by the hash
        table */
     std::lock_guard<std::mutex> writeGuard(getListWriteLock());
+    seqnoIndex.clear();
     seqList.remove_and_dispose_if(
             [&writeGuard](const OrderedStoredValue& v) {
                 return v.isStale(writeGuard);
@@ -67,18 +72,21 @@ SequenceList::UpdateStatus BasicLinkedList::updateListElem(
         std::lock_guard<std::mutex>& seqLock,
         std::lock_guard<std::mutex>& writeLock,
         OrderedStoredValue& v) {
-    /* Lock that needed for consistent read of SeqRange 'readRange' */
+    /* Lock that needed for consistent read of the 'readRanges' */
     std::lock_guard<SpinLock> lh(rangeLock);
 
-    if (readRange.fallsInRange(v.getBySeqno())) {
-        /* Range read is in middle of a point-in-time snapshot, hence we cannot
-           move the element to the end of the list. Return a temp failure */
+    if (isInReadRange(lh, v.getBySeqno())) {
+        /* A range read is in middle of a point-in-time snapshot, hence we
+           cannot move the element to the end of the list. Return a temp
+           failure */
+        ++numRangeReadStaleItems;
         return UpdateStatus::Append;
     }
 
     /* Since there is no other reads or writes happenning in this range, we can
        move the item to the end of the list */
     auto it = seqList.iterator_to(v);
+    removeFromSeqnoIndex(writeLock, it);
     /* If the list is being updated at 'pausedPurgePoint', then we must save
        the new 'pausedPurgePoint' */
     if (pausedPurgePoint == it) {
@@ -102,9 +110,12 @@ BasicLinkedList::rangeRead(seqno_t start, seqno_t end) {
         return std::make_tuple(ENGINE_ERANGE, std::vector<UniqueItemPtr>(), 0);
     }
 
-    /* Allows only 1 rangeRead for now */
-    std::lock_guard<std::mutex> lckGd(rangeReadLock);
+    /* Any number of range reads may run concurrently, but not while the
+       list is being purged */
+    std::shared_lock<folly::SharedMutex> lckGd(rangeReadLock);
 
+    ReadRanges::iterator readRange;
+    OrderedLL::iterator startIt;
     {
         std::lock_guard<std::mutex> listWriteLg(getListWriteLock());
         std::lock_guard<SpinLock> lh(rangeLock);
@@ -124,13 +135,20 @@ BasicLinkedList::rangeRead(seqno_t start, seqno_t end) {
         /* Mark the initial read range */
         end = std::min(end, static_cast<seqno_t>(highSeqno));
         end = std::max(end, static_cast<seqno_t>(highestDedupedSeqno));
-        readRange = SeqRange(1, end);
+        /* Skip the items before the start; they need not be read (hence nor
+           be in the read range) */
+        startIt = seekToSeqno(listWriteLg, start);
+        const seqno_t begin = (startIt == seqList.end())
+                                      ? end
+                                      : std::min(startIt->getBySeqno(), end);
+        readRange = addReadRange(lh, SeqRange(begin, end));
     }
 
     /* Read items in the range */
     std::vector<UniqueItemPtr> items;
 
-    for (const auto& osv : seqList) {
+    for (auto it = startIt; it != seqList.end(); ++it) {
+        const auto& osv = *it;
         int64_t currSeqno(osv.getBySeqno());
 
         if (currSeqno > end || currSeqno < 0) {
@@ -141,7 +159,7 @@ BasicLinkedList::rangeRead(seqno_t start, seqno_t end) {
 
         {
             std::lock_guard<SpinLock> lh(rangeLock);
-            readRange.setBegin(currSeqno); /* [EPHE TODO]: should we
+            readRange->setBegin(currSeqno); /* [EPHE TODO]: should we
                                                      update the min every time ?
                                                    */
         }
@@ -178,15 +196,19 @@ BasicLinkedList::rangeRead(seqno_t start, seqno_t end) {
                     "item with seqno {}before streaming it",
                     vbid,
                     currSeqno);
+            {
+                std::lock_guard<SpinLock> lh(rangeLock);
+                removeReadRange(lh, readRange);
+            }
             return std::make_tuple(
                     ENGINE_ENOMEM, std::vector<UniqueItemPtr>(), 0);
         }
     }
 
-    /* Done with range read, reset the range */
+    /* Done with range read, remove the range */
     {
         std::lock_guard<SpinLock> lh(rangeLock);
-        readRange.reset();
+        removeReadRange(lh, readRange);
     }
 
     /* Return all the range read items */
@@ -202,6 +224,17 @@ void BasicLinkedList::updateHighSeqno(std::lock_guard<std::mutex>& listWriteLg,
                 std::to_string(v.getBySeqno()) + " which is < 1");
     }
     highSeqno = v.getBySeqno();
+
+    /* Index one in every SeqnoIndexInterval elements as they are appended
+       (are at the back of the list) */
+    if (++numSinceLastIndexed >= SeqnoIndexInterval && !seqList.empty() &&
+        &seqList.back() == &v) {
+        seqnoIndex.emplace_hint(
+                seqnoIndex.end(),
+                v.getBySeqno(),
+                seqList.iterator_to(const_cast<OrderedStoredValue&>(v)));
+        numSinceLastIndexed = 0;
+    }
 }
 void BasicLinkedList::updateHighestDedupedSeqno(
         std::lock_guard<std::mutex>& listWriteLg, const OrderedStoredValue& v) {
@@ -230,44 +263,122 @@ void BasicLinkedList::markItemStale(std::lock_guard<std::mutex>& listWriteLg,
 
     ++numStaleItems;
     v->toOrderedStoredValue()->markStale(listWriteLg, newSv);
+    staleItems.push_back(v->toOrderedStoredValue());
 }
 
 size_t BasicLinkedList::purgeTombstones(
         seqno_t purgeUpToSeqno,
         Collections::IsDroppedEphemeralCb isDroppedKeyCb,
         std::function<bool()> shouldPause) {
-    // Purge items marked as stale from the seqList.
+    // Purge items marked as stale (and, if scheduled, items of dropped
+    // collections) from the seqList.
     //
     // Strategy - we try to ensure that this function does not block
     // frontend-writes (adding new OrderedStoredValues (OSVs) to the seqList).
-    // To achieve this (safely),
-    // we (try to) acquire the rangeReadLock and setup a 'read' range for the
-    // whole of the seqList. This prevents any other readers from iterating
-    // the list (and accessing stale items) while we purge on it; but permits
-    // front-end operations to continue as they:
-    //   a) Only read/modify non-stale items (we only change stale items) and
-    //   b) Do not change the list membership of anything within the read-range.
-    // However, we do need to be careful about what members of OSVs we access
-    // here - the only OSVs we can safely access are ones marked stale as they
-    // are no longer in the HashTable (and hence subject to HashTable locks).
-    // To check if an item is stale we need to acquire the writeLock
-    // (OSV::stale is guarded by it) for each list item. While this isn't
-    // ideal (that's the same lock needed by front-end operations), we can
-    // release the lock between each element so front-end operations can
-    // have the opportunity to acquire it.
+    // To achieve this (safely), we (try to) acquire the rangeReadLock
+    // exclusively. This prevents any other readers from iterating the list
+    // (and accessing stale items) while we purge on it; but permits front-end
+    // operations to continue as they only read/modify non-stale items (we
+    // only change stale items, which are found from 'staleItems' without
+    // visiting the rest of the list).
+    //
+    // Only the scan for dropped keys iterates over the list; see
+    // purgeDroppedKeys().
     //
-    // Attempt to acquire the readRangeLock, to block anyone else concurrently
-    // reading from the list while we remove elements from it.
-    std::unique_lock<std::mutex> rrGuard(rangeReadLock, std::try_to_lock);
+    // Attempt to acquire the readRangeLock exclusively, to block anyone else
+    // concurrently reading from the list while we remove elements from it.
+    std::unique_lock<folly::SharedMutex> rrGuard(rangeReadLock,
+                                                 std::try_to_lock);
     if (!rrGuard) {
-        // If we cannot acquire the lock then another thread is
-        // running a range read. Given these are typically long-running,
+        // If we cannot acquire the lock then other thread(s) are
+        // running range reads. Given these are typically long-running,
         // return without blocking.
         return 0;
     }
 
+    bool paused = false;
+    size_t purgedCount = purgeStaleItems(purgeUpToSeqno, shouldPause, paused);
+    if (paused || !isDroppedKeyCb) {
+        return purgedCount;
+    }
+
+    // Scan for dropped keys if a scan is in progress, or has been scheduled
+    // since the last one started.
+    if (!droppedKeysPurgeInProgress) {
+        if (!droppedKeysPurgeScheduled.exchange(false)) {
+            return purgedCount;
+        }
+        droppedKeysPurgeInProgress = true;
+        pausedPurgePoint = seqList.end();
+    }
+    purgedCount += purgeDroppedKeys(
+            purgeUpToSeqno, isDroppedKeyCb, shouldPause, paused);
+    if (!paused) {
+        droppedKeysPurgeInProgress = false;
+    }
+    return purgedCount;
+}
+
+size_t BasicLinkedList::purgeStaleItems(
+        seqno_t purgeUpToSeqno,
+        const std::function<bool()>& shouldPause,
+        bool& paused) {
+    // Take the stale items; any marked stale while we purge are added to
+    // (the now empty) staleItems.
+    std::vector<OrderedStoredValue*> toPurge;
+    {
+        std::lock_guard<std::mutex> writeGuard(getListWriteLock());
+        toPurge.swap(staleItems);
+    }
+
+    // Stale items are no longer in the HashTable, and are only modified (or
+    // deleted) by the purger, so we can read them without the writeLock.
+    size_t purgedCount = 0;
+    auto keep = toPurge.begin();
+    auto it = toPurge.begin();
+    for (; it != toPurge.end(); ++it) {
+        if ((*it)->getBySeqno() > purgeUpToSeqno) {
+            *keep++ = *it;
+            continue;
+        }
+
+        purgeListElem(seqList.iterator_to(**it), true /*isStale*/);
+        ++purgedCount;
+
+        if (shouldPause()) {
+            paused = true;
+            ++it;
+            break;
+        }
+    }
+    keep = std::copy(it, toPurge.end(), keep);
+
+    // Return the items not purged
+    if (keep != toPurge.begin()) {
+        std::lock_guard<std::mutex> writeGuard(getListWriteLock());
+        staleItems.insert(staleItems.end(), toPurge.begin(), keep);
+    }
+    return purgedCount;
+}
+
+size_t BasicLinkedList::purgeDroppedKeys(
+        seqno_t purgeUpToSeqno,
+        const Collections::IsDroppedEphemeralCb& isDropped,
+        const std::function<bool()>& shouldPause,
+        bool& paused) {
+    // We setup a 'read' range for the part of the seqList being scanned, so
+    // that front-end operations do not change the list membership of
+    // anything in it while we iterate over it.
+    // However, we do need to be careful about what members of OSVs we access
+    // here. To check if an item is stale we need to acquire the writeLock
+    // (OSV::stale is guarded by it) for each list item. While this isn't
+    // ideal (that's the same lock needed by front-end operations), we can
+    // release the lock between each element so front-end operations can
+    // have the opportunity to acquire it.
+
     // Determine the start and end iterators.
     OrderedLL::iterator startIt;
+    ReadRanges::iterator readRange;
     {
         std::lock_guard<std::mutex> writeGuard(getListWriteLock());
         if (seqList.empty()) {
@@ -288,13 +399,14 @@ size_t BasicLinkedList::purgeTombstones(
             return 0;
         }
 
-        // Update readRange
+        // Add the purge's read range
         std::lock_guard<SpinLock> rangeGuard(rangeLock);
-        readRange = SeqRange(startIt->getBySeqno(), purgeUpToSeqno);
+        readRange = addReadRange(
+                rangeGuard, SeqRange(startIt->getBySeqno(), purgeUpToSeqno));
     }
 
     // Iterate across all but the last item in the seqList, looking
-    // for stale items.
+    // for dropped items.
     size_t purgedCount = 0;
     bool stale;
     for (auto it = startIt; it != seqList.end();) {
@@ -308,7 +420,7 @@ size_t BasicLinkedList::purgeTombstones(
             // 'readRange' to reduce the window of creating stale items during
             // updates
             std::lock_guard<SpinLock> rangeGuard(rangeLock);
-            readRange.setBegin(it->getBySeqno());
+            readRange->setBegin(it->getBySeqno());
         }
 
         {
@@ -316,34 +428,35 @@ size_t BasicLinkedList::purgeTombstones(
             stale = it->isStale(writeGuard);
         }
 
-        bool isDropped = false;
-        if (!stale && isDroppedKeyCb) {
-            isDropped = isDroppedKeyCb(it->getKey(), it->getBySeqno());
-        }
-
-        // Only stale or dropped items are purged.
-        if (stale || isDropped) {
-            // Checks pass, remove from list and delete.
-            it = purgeListElem(it, stale);
+        // Stale items are purged by purgeStaleItems(), only purge the
+        // (live) items of dropped collections.
+        if (!stale && isDropped(it->getKey(), it->getBySeqno())) {
+            it = purgeListElem(it, false /*isStale*/);
             ++purgedCount;
         } else {
             ++it;
         }
 
         if (shouldPause()) {
+            // If we paused at the end, the scan is complete
+            paused = (it != seqList.end());
             pausedPurgePoint = it;
             break;
         }
     }
 
-    // Complete; reset the readRange.
+    // Complete; remove the readRange.
     {
         std::lock_guard<SpinLock> lh(rangeLock);
-        readRange.reset();
+        removeReadRange(lh, readRange);
     }
     return purgedCount;
 }
 
+void BasicLinkedList::scheduleDroppedKeysPurge() {
+    droppedKeysPurgeScheduled = true;
+}
+
 void BasicLinkedList::updateNumDeletedItems(bool oldDeleted, bool newDeleted) {
     if (oldDeleted && !newDeleted) {
         --numDeletedItems;
@@ -390,20 +503,98 @@ seqno_t BasicLinkedList::getHighestPurgedDeletedSeqno() const {
 
 uint64_t BasicLinkedList::getRangeReadBegin() const {
     std::lock_guard<SpinLock> lh(rangeLock);
-    return readRange.getBegin();
+    if (readRanges.empty()) {
+        return 0;
+    }
+    seqno_t begin = readRanges.front().getBegin();
+    for (const auto& range : readRanges) {
+        begin = std::min(begin, range.getBegin());
+    }
+    return begin;
 }
 
 uint64_t BasicLinkedList::getRangeReadEnd() const {
     std::lock_guard<SpinLock> lh(rangeLock);
-    return readRange.getEnd();
+    seqno_t end = 0;
+    for (const auto& range : readRanges) {
+        end = std::max(end, range.getEnd());
+    }
+    return end;
+}
+
+uint64_t BasicLinkedList::getNumRangeReads() const {
+    std::lock_guard<SpinLock> lh(rangeLock);
+    return readRanges.size();
+}
+
+uint64_t BasicLinkedList::getNumRangeReadStaleItems() const {
+    return numRangeReadStaleItems;
+}
+
+BasicLinkedList::ReadRanges::iterator BasicLinkedList::addReadRange(
+        std::lock_guard<SpinLock>& rangeGuard, const SeqRange& range) {
+    return readRanges.insert(readRanges.end(), range);
+}
+
+void BasicLinkedList::removeReadRange(std::lock_guard<SpinLock>& rangeGuard,
+                                      ReadRanges::iterator range) {
+    readRanges.erase(range);
+}
+
+bool BasicLinkedList::isInReadRange(std::lock_guard<SpinLock>& rangeGuard,
+                                    seqno_t seqno) const {
+    /* There are typically very few range reads in progress at once, so a
+       linear search is cheapest */
+    for (const auto& range : readRanges) {
+        if (range.fallsInRange(seqno)) {
+            return true;
+        }
+    }
+    return false;
 }
+
 std::mutex& BasicLinkedList::getListWriteLock() const {
     return writeLock;
 }
 
+OrderedLL::iterator BasicLinkedList::seekToSeqno(
+        std::lock_guard<std::mutex>& writeGuard, seqno_t start) {
+    if (seqList.empty()) {
+        return seqList.end();
+    }
+
+    /* Start from the last indexed element at or before start */
+    auto it = seqList.begin();
+    auto indexed = seqnoIndex.upper_bound(start);
+    if (indexed != seqnoIndex.begin()) {
+        it = std::prev(indexed)->second;
+    }
+
+    while (it->getBySeqno() < start) {
+        auto next = std::next(it);
+        if (next == seqList.end() || next->getBySeqno() <= 0) {
+            /* No item with a valid seqno >= start */
+            break;
+        }
+        it = next;
+    }
+    return it;
+}
+
+void BasicLinkedList::removeFromSeqnoIndex(
+        std::lock_guard<std::mutex>& writeGuard, OrderedLL::iterator it) {
+    if (seqnoIndex.empty()) {
+        return;
+    }
+    auto indexed = seqnoIndex.find(it->getBySeqno());
+    if (indexed != seqnoIndex.end() && indexed->second == it) {
+        seqnoIndex.erase(indexed);
+    }
+}
+
 boost::optional<SequenceList::RangeIterator> BasicLinkedList::makeRangeIterator(
-        bool isBackfill) {
-    auto pRangeItr = RangeIteratorLL::create(*this, isBackfill);
+        bool isBackfill, seqno_t start) {
+    auto pRangeItr = RangeIteratorLL::create(*this, isBackfill, start);
     return pRangeItr ? RangeIterator(std::move(pRangeItr))
                      : boost::optional<SequenceList::RangeIterator>{};
 }
@@ -432,7 +623,15 @@ OrderedLL::iterator BasicLinkedList::purgeListElem(OrderedLL::iterator it,
     StoredValue::UniquePtr purged(&*it);
     {
         std::lock_guard<std::mutex> lckGd(getListWriteLock());
-        it = seqList.erase(it);
+        removeFromSeqnoIndex(lckGd, it);
+        /* If the element at 'pausedPurgePoint' is purged, then we must save
+           the new 'pausedPurgePoint' */
+        if (pausedPurgePoint == it) {
+            it = seqList.erase(it);
+            pausedPurgePoint = it;
+        } else {
+            it = seqList.erase(it);
+        }
     }
 
     if (isStale) {
@@ -456,16 +655,19 @@ OrderedLL::iterator BasicLinkedList::purgeListElem(OrderedLL::iterator it,
 }
 
 std::unique_ptr<BasicLinkedList::RangeIteratorLL>
-BasicLinkedList::RangeIteratorLL::create(BasicLinkedList& ll, bool isBackfill) {
+BasicLinkedList::RangeIteratorLL::create(BasicLinkedList& ll,
+                                         bool isBackfill,
+                                         seqno_t start) {
     /* Note: cannot use std::make_unique because the constructor of
        RangeIteratorLL is private */
     std::unique_ptr<BasicLinkedList::RangeIteratorLL> pRangeItr(
-            new BasicLinkedList::RangeIteratorLL(ll, isBackfill));
+            new BasicLinkedList::RangeIteratorLL(ll, isBackfill, start));
     return pRangeItr->tryLater() ? nullptr : std::move(pRangeItr);
 }
 
 BasicLinkedList::RangeIteratorLL::RangeIteratorLL(BasicLinkedList& ll,
-                                                  bool isBackfill)
+                                                  bool isBackfill,
+                                                  seqno_t start)
     : list(ll),
       /* Try to get range read lock, do not block */
       readLockHolder(list.rangeReadLock, std::try_to_lock),
@@ -487,11 +689,19 @@ BasicLinkedList::RangeIteratorLL::RangeIteratorLL(BasicLinkedList& ll,
         return;
     }
 
-    /* Iterator to the beginning of linked list */
-    currIt = list.seqList.begin();
+    /* Iterator to the first item to be read */
+    currIt = list.seekToSeqno(listWriteLg, start);
 
-    /* Number of items that can be iterated over */
-    numRemaining = list.seqList.size();
+    /* Number of items that can be iterated over (at most, as there may be
+       gaps in the seqnos, if the iterator does not start at the beginning) */
+    if (currIt == list.seqList.begin()) {
+        numRemaining = list.seqList.size();
+    } else {
+        numRemaining = std::min(
+                uint64_t(list.seqList.size()),
+                uint64_t(list.seqList.back().getBySeqno() -
+                         currIt->getBySeqno() + 1));
+    }
 
     /* The minimum seqno in the iterator that must be read to get a consistent
        read snapshot */
@@ -499,13 +709,14 @@ BasicLinkedList::RangeIteratorLL::RangeIteratorLL(BasicLinkedList& ll,
 
     /* Mark the snapshot range on linked list. The range that can be read by the
        iterator is inclusive of the start and the end. */
-    list.readRange =
-            SeqRange(currIt->getBySeqno(), list.seqList.back().getBySeqno());
+    readRange = list.addReadRange(
+            lh,
+            SeqRange(currIt->getBySeqno(), list.seqList.back().getBySeqno()));
 
     /* Keep the range in the iterator obj. We store the range end seqno as one
        higher than the end seqno that can be read by this iterator.
        This is because, we must identify the end point of the iterator, and
-       we the read is inclusive of the end points of list.readRange.
+       we the read is inclusive of the end points of the readRange.
 
        Further, since use the class 'SeqRange' for 'itrRange' we cannot use
        curr() == end() + 1 to identify the end point because 'SeqRange' does
@@ -524,17 +735,22 @@ BasicLinkedList::RangeIteratorLL::RangeIteratorLL(BasicLinkedList& ll,
 }
 
 BasicLinkedList::RangeIteratorLL::~RangeIteratorLL() {
-    std::lock_guard<SpinLock> lh(list.rangeLock);
+    /* we must remove the readRange only if the list iterator still owns
+       the read lock on the list */
     if (readLockHolder.owns_lock()) {
-        /* we must reset the list readRange only if the list iterator still owns
-           the read lock on the list */
-        list.readRange.reset();
-        auto severity = isBackfill ? spdlog::level::level_enum::info
-                                   : spdlog::level::level_enum::debug;
-        EP_LOG_FMT(severity, "{} Releasing the range iterator", list.vbid);
+        releaseReadRange();
+    }
+}
+
+void BasicLinkedList::RangeIteratorLL::releaseReadRange() {
+    {
+        std::lock_guard<SpinLock> lh(list.rangeLock);
+        list.removeReadRange(lh, readRange);
     }
-    /* As readLockHolder goes out of scope here, it will automatically release
-       the snapshot read lock on the linked list */
+    auto severity = isBackfill ? spdlog::level::level_enum::info
+                               : spdlog::level::level_enum::debug;
+    EP_LOG_FMT(severity, "{} Releasing the range iterator", list.vbid);
+    readLockHolder.unlock();
 }
 
 OrderedStoredValue& BasicLinkedList::RangeIteratorLL::operator*() const {
@@ -574,15 +790,10 @@ void BasicLinkedList::RangeIteratorLL::incrOperatorHelper() {
     /* Check if the iterator is pointing to the last element. Increment beyond
        the last element indicates the end of the iteration */
     if (curr() == itrRange.getEnd() - 1) {
-        std::lock_guard<SpinLock> lh(list.rangeLock);
-        /* We reset the range and release the readRange lock here so that any
+        /* We remove the range and release the read lock here so that any
            iterator client that does not delete the iterator obj will not end up
-           holding the list readRange lock forever */
-        list.readRange.reset();
-        auto severity = isBackfill ? spdlog::level::level_enum::info
-                                   : spdlog::level::level_enum::debug;
-        EP_LOG_FMT(severity, "{} Releasing the range iterator", list.vbid);
-        readLockHolder.unlock();
+           holding the list read lock forever */
+        releaseReadRange();
 
         /* Update the begin to end() so the client can see that the iteration
            has ended */
@@ -596,7 +807,7 @@ void BasicLinkedList::RangeIteratorLL::incrOperatorHelper() {
            linked list. This helps reduce the stale items in the list during
            heavy update load from the front end */
         std::lock_guard<SpinLock> lh(list.rangeLock);
-        list.readRange.setBegin(currIt->getBySeqno());
+        readRange->setBegin(currIt->getBySeqno());
     }
 
     /* Also update the current range stored in the iterator obj */
@@ -28,9 +28,15 @@
 #include "stored-value.h"
 
 #include <boost/intrusive/list.hpp>
+#include <folly/SharedMutex.h>
 #include <platform/non_negative_counter.h>
 #include <relaxed_atomic.h>
 
+#include <atomic>
+#include <list>
+#include <map>
+#include <vector>
+
 /* This option will configure "list" to use the member hook */
 using MemberHookOption =
         boost::intrusive::member_hook<OrderedStoredValue,
@@ -117,6 +123,14 @@ private:
  * BasicLinkedList sees only the hook for next and prev; HashTable
  * see only the hook for hashtable chaining.
  *
+ * The stale elements are also tracked in a separate list (staleItems), so that
+ * they can be purged without visiting the live elements of the list.
+ *
+ * As the list is in seqno order, a sparse index of the seqnos of some of its
+ * elements (one in every SeqnoIndexInterval appended) lets range reads
+ * position themselves at an arbitrary start seqno in O(log n) time, without
+ * walking the list from its head.
+ *
  * But there should be an agreement on the deletion (invalidation of next and
  * prev link; chaining link) of the elements between these 2 class objects.
  * Currently,
@@ -142,10 +156,15 @@ private:
  * ================================
  * 'writeLock' and 'rangeLock' are held for short durations, typically for
  * single list element writes and reads.
- * 'rangeReadLock' is held for longer duration on the list (for entire range).
+ * 'rangeReadLock' is held for longer duration on the list (for entire range);
+ * shared by range reads (any number of which may run concurrently), and
+ * exclusively by purgeTombstones().
  */
 class BasicLinkedList : public SequenceList {
 public:
+    /// One in every SeqnoIndexInterval elements appended is indexed
+    static const size_t SeqnoIndexInterval = 1024;
+
     BasicLinkedList(Vbid vbucketId, EPStats& st);
 
     ~BasicLinkedList();
@@ -178,6 +197,8 @@ public:
                            std::function<bool()> shouldPause =
                                    []() { return false; }) override;
 
+    void scheduleDroppedKeysPurge() override;
+
     void updateNumDeletedItems(bool oldDeleted, bool newDeleted) override;
 
     uint64_t getNumStaleItems() const override;
@@ -200,10 +221,14 @@ public:
 
     uint64_t getRangeReadEnd() const override;
 
+    uint64_t getNumRangeReads() const override;
+
+    uint64_t getNumRangeReadStaleItems() const override;
+
     std::mutex& getListWriteLock() const override;
 
     boost::optional<SequenceList::RangeIterator> makeRangeIterator(
-            bool isBackfill) override;
+            bool isBackfill, seqno_t start = 1) override;
 
     void dump() const override;
 
@@ -218,34 +243,51 @@ protected:
      */
     mutable std::mutex writeLock;
 
+    using ReadRanges = std::list<SeqRange>;
+
     /**
-     * Used to mark of the range where point-in-time snapshot is happening.
+     * The ranges in which point-in-time snapshots are being read, one per
+     * range read (or purge) in progress.
      * To get a valid point-in-time snapshot and for correct list iteration we
-     * must not de-duplicate an item in the list in this range.
+     * must not de-duplicate an item in the list which is in any of these
+     * ranges.
      */
-    SeqRange readRange;
+    ReadRanges readRanges;
 
     /**
-     * Lock that protects readRange.
+     * Lock that protects readRanges (and the ranges in it).
      * We use spinlock here since the lock is held only for very small time
      * periods.
      */
     mutable SpinLock rangeLock;
 
     /**
-     * Lock that serializes range reads on the 'seqList' - i.e. serializes
-     * the addition / removal of range reads from the set in-flight.
-     * We need to serialize range reads because, range reads set a list level
-     * range in which items are read. If we have multiple range reads then we
-     * must handle the races in the updation of the range to have most inclusive
-     * range.
-     * For now we use this lock to allow only one range read at a time.
+     * Lock held (shared) by each range read on the 'seqList' for as long as it
+     * has a range in readRanges.
+     *
+     * It is held exclusively in purgeTombstones() to prevent the creation of
+     * any new rangeReads while purge is in-progress (and to not purge while
+     * a range read is in progress) - see detailed comments there.
+     */
+    folly::SharedMutex rangeReadLock;
+
+    /**
+     * Add a range to readRanges.
      *
-     * It is also additionally used in purgeTombstones() to prevent the
-     * creation of any new rangeReads while purge is in-progress - see
-     * detailed comments there.
+     * @return the position of the range, to be passed to removeReadRange()
+     *         when the read completes
      */
-    std::mutex rangeReadLock;
+    ReadRanges::iterator addReadRange(std::lock_guard<SpinLock>& rangeGuard,
+                                      const SeqRange& range);
+
+    void removeReadRange(std::lock_guard<SpinLock>& rangeGuard,
+                         ReadRanges::iterator range);
+
+    /**
+     * @return true if the seqno is in any of the readRanges
+     */
+    bool isInReadRange(std::lock_guard<SpinLock>& rangeGuard,
+                       seqno_t seqno) const;
 
     /* Overall memory consumed by (stale) OrderedStoredValues owned by the
        list */
@@ -255,9 +297,77 @@ protected:
        list */
     cb::RelaxedAtomic<size_t> staleMetaDataSize;
 
+    /**
+     * Sparse index of the list elements by seqno; the elements are added as
+     * their seqno is set (in updateHighSeqno()) and removed as they are
+     * moved or purged from their position in the list.
+     *
+     * Guarded by writeLock.
+     */
+    std::map<seqno_t, OrderedLL::iterator> seqnoIndex;
+
+    /* Number of elements appended since the last one was indexed.
+       Guarded by writeLock. */
+    size_t numSinceLastIndexed;
+
+    /**
+     * Find the first element of the list with a seqno >= start (or the last
+     * element with a valid seqno, if all of them are lower than start),
+     * starting at the closest indexed element.
+     *
+     * @return the element, or seqList.end() if the list is empty
+     */
+    OrderedLL::iterator seekToSeqno(std::lock_guard<std::mutex>& writeGuard,
+                                    seqno_t start);
+
+    /* Remove the element from the seqnoIndex (if it is indexed) */
+    void removeFromSeqnoIndex(std::lock_guard<std::mutex>& writeGuard,
+                              OrderedLL::iterator it);
+
+    /**
+     * The stale elements of the list (in the order they were marked stale),
+     * which are yet to be purged.
+     *
+     * Guarded by writeLock.
+     */
+    std::vector<OrderedStoredValue*> staleItems;
+
+    /* Set when a scan of the list for dropped keys is to be done by the next
+       purge */
+    std::atomic<bool> droppedKeysPurgeScheduled;
+
+    /* True while a scan of the list for dropped keys is in progress (paused
+       at 'pausedPurgePoint'). Accessed only with rangeReadLock held
+       exclusively */
+    bool droppedKeysPurgeInProgress;
+
 private:
     OrderedLL::iterator purgeListElem(OrderedLL::iterator it, bool isStale);
 
+    /**
+     * Purge the items in staleItems with seqno <= purgeUpToSeqno. Must be
+     * called with the rangeReadLock held exclusively.
+     *
+     * @param [out] paused set to true if shouldPause() asked to pause
+     * @return the number of items purged
+     */
+    size_t purgeStaleItems(seqno_t purgeUpToSeqno,
+                           const std::function<bool()>& shouldPause,
+                           bool& paused);
+
+    /**
+     * Scan the list (from 'pausedPurgePoint', if the scan was paused) for
+     * the (non-stale) items of dropped collections and purge them. Must be
+     * called with the rangeReadLock held exclusively.
+     *
+     * @param [out] paused set to true if shouldPause() asked to pause
+     * @return the number of items purged
+     */
+    size_t purgeDroppedKeys(seqno_t purgeUpToSeqno,
+                            const Collections::IsDroppedEphemeralCb& isDropped,
+                            const std::function<bool()>& shouldPause,
+                            bool& paused);
+
     /**
      * We need to keep track of the highest seqno separately because there is a
      * small window wherein the last element of the list (though in correct
@@ -293,6 +403,13 @@ private:
      */
     cb::NonNegativeCounter<uint64_t> numStaleItems;
 
+    /**
+     * The number of updates which had to append a new element (leaving a
+     * stale one behind) instead of moving the element to the end of the list,
+     * because it was in a read range.
+     */
+    cb::RelaxedAtomic<uint64_t> numRangeReadStaleItems;
+
     /**
      * Indicates the number of logically deleted items in the list.
      * Since we are append-only, distributed cache supporting incremental
@@ -316,20 +433,22 @@ private:
     class RangeIteratorLL : public SequenceList::RangeIteratorImpl {
     public:
         /**
-         * Method to create instances of RangeIteratorLL. We only
-         * allow one RangeIteratorLL object to exist at any one time,
-         * hence creation can fail and that's why object creation is via a
-         * public method and not constructor.
+         * Method to create instances of RangeIteratorLL. Any number of
+         * RangeIteratorLL objects may exist at once, but none may be created
+         * while the list is being purged, hence creation can fail and that's
+         * why object creation is via a public method and not constructor.
          *
          * @param ll ref to the linkedlist on which the iterator is created
          * @param isBackfill indicates if the iterator is for backfill (for
          *                   debug)
+         * @param start seqno to position the iterator at
          *
-         * @return Non-null pointer on success, or null if a RangeIteratorLL
-         *         already exists.
+         * @return Non-null pointer on success, or null if the list is being
+         *         purged.
          */
         static std::unique_ptr<RangeIteratorLL> create(BasicLinkedList& ll,
-                                                       bool isBackfill);
+                                                       bool isBackfill,
+                                                       seqno_t start);
 
         ~RangeIteratorLL();
 
@@ -363,7 +482,7 @@ private:
     private:
         /* We have a private constructor because we want to create the iterator
            optionally, that is, only when it is possible to get a read lock */
-        RangeIteratorLL(BasicLinkedList& ll, bool isBackfill);
+        RangeIteratorLL(BasicLinkedList& ll, bool isBackfill, seqno_t start);
 
         /**
          * Indicates if the client should try creating the iterator at a later
@@ -383,6 +502,12 @@ private:
          */
         void incrOperatorHelper();
 
+        /**
+         * Remove the iterator's range from the list's readRanges and release
+         * its read lock on the list.
+         */
+        void releaseReadRange();
+
         /**
          * Indicates if there is a newer version of the curr item in the
          * iterator range
@@ -399,8 +524,13 @@ private:
         /* The current list element pointed by the iterator */
         OrderedLL::iterator currIt;
 
-        /* Lock holder which allows having only one iterator at a time */
-        std::unique_lock<std::mutex> readLockHolder;
+        /* Shared lock holder which prevents the list being purged while the
+           iterator exists */
+        std::shared_lock<folly::SharedMutex> readLockHolder;
+
+        /* The iterator's range in the list's readRanges (valid if the
+           readLockHolder owns the lock) */
+        ReadRanges::iterator readRange;
 
         /* Current range of the iterator */
         SeqRange itrRange;
@@ -0,0 +1,119 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "lock_profiler.h"
+
+#include "hdrhistogram.h"
+#include "objectregistry.h"
+#include "statwriter.h"
+
+#include <array>
+#include <string>
+
+std::atomic<size_t> LockProfiler::sampleInterval{0};
+
+namespace {
+struct SiteHistograms {
+    Hdr1sfMicroSecHistogram wait;
+    Hdr1sfMicroSecHistogram hold;
+};
+
+using Histograms = std::array<SiteHistograms, NumLockSites>;
+
+Histograms* createHistograms() {
+    // Shared by all buckets, so not accounted to the one which happens to
+    // take the first lock.
+    NonBucketAllocationGuard guard;
+    return new Histograms();
+}
+
+Histograms& getHistograms() {
+    // Created on first use, as locks may be taken while other statics are
+    // being initialised (and never freed, as they may be taken while others
+    // are being destroyed).
+    static Histograms* histograms = createHistograms();
+    return *histograms;
+}
+} // namespace
+
+const char* to_string(LockSite site) {
+    switch (site) {
+    case LockSite::HashBucket:
+        return "hash_bucket";
+    case LockSite::CheckpointQueue:
+        return "checkpoint_queue";
+    case LockSite::VBucketState:
+        return "vbucket_state";
+    case LockSite::TaskQueue:
+        return "task_queue";
+    case LockSite::DcpStream:
+        return "dcp_stream";
+    }
+    return "unknown";
+}
+
+void LockProfiler::setSampleInterval(size_t interval) {
+    sampleInterval.store(interval, std::memory_order_relaxed);
+}
+
+size_t LockProfiler::getSampleInterval() {
+    return sampleInterval.load(std::memory_order_relaxed);
+}
+
+bool LockProfiler::shouldSample() {
+    const auto interval = sampleInterval.load(std::memory_order_relaxed);
+    if (interval == 0) {
+        return false;
+    }
+    static thread_local size_t acquisitions = 0;
+    if (++acquisitions < interval) {
+        return false;
+    }
+    acquisitions = 0;
+    return true;
+}
+
+void LockProfiler::recordWait(LockSite site,
+                              std::chrono::nanoseconds duration) {
+    getHistograms()[size_t(site)].wait.add(
+            std::chrono::duration_cast<std::chrono::microseconds>(duration));
+}
+
+void LockProfiler::recordHold(LockSite site,
+                              std::chrono::nanoseconds duration) {
+    getHistograms()[size_t(site)].hold.add(
+            std::chrono::duration_cast<std::chrono::microseconds>(duration));
+}
+
+void LockProfiler::addStats(const AddStatFn& add_stat, const void* cookie) {
+    add_casted_stat("sample_interval", getSampleInterval(), add_stat, cookie);
+    auto& histograms = getHistograms();
+    for (size_t ii = 0; ii < NumLockSites; ++ii) {
+        const std::string name = to_string(LockSite(ii));
+        add_casted_stat(
+                (name + "_wait").c_str(), histograms[ii].wait, add_stat, cookie);
+        add_casted_stat(
+                (name + "_hold").c_str(), histograms[ii].hold, add_stat, cookie);
+    }
+}
+
+void LockProfiler::reset() {
+    for (auto& site : getHistograms()) {
+        site.wait.reset();
+        site.hold.reset();
+    }
+}
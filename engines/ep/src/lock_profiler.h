@@ -0,0 +1,167 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <memcached/engine_common.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+/**
+ * The locks whose contention is profiled by the LockProfiler.
+ */
+enum class LockSite {
+    /// A HashTable's hash bucket (HashBucketLock).
+    HashBucket,
+    /// CheckpointManager::queueLock.
+    CheckpointQueue,
+    /// VBucket::stateLock (read or write).
+    VBucketState,
+    /// The mutex of an ExecutorPool TaskQueue.
+    TaskQueue,
+    /// ActiveStream::streamMutex.
+    DcpStream,
+};
+
+/// The number of LockSites.
+const size_t NumLockSites = size_t(LockSite::DcpStream) + 1;
+
+const char* to_string(LockSite site);
+
+/**
+ * A continuous, sampled profile of how long locks are waited for and held,
+ * per lock site.
+ *
+ * Every Nth acquisition (per thread) of the profiled locks records the time
+ * taken to acquire the lock and the time it was then held for into the
+ * site's histograms; the others only pay for a thread local counter. The
+ * profile (like the ExecutorPool whose TaskQueues it covers) is shared by all
+ * buckets, and is reported by "stats lockprofile".
+ */
+class LockProfiler {
+public:
+    /**
+     * Set how often acquisitions are sampled.
+     *
+     * @param interval sample one in this many acquisitions; 0 disables the
+     *        profiler
+     */
+    static void setSampleInterval(size_t interval);
+
+    static size_t getSampleInterval();
+
+    /// @return true if the calling thread's next acquisition is to be sampled
+    static bool shouldSample();
+
+    static void recordWait(LockSite site, std::chrono::nanoseconds duration);
+
+    static void recordHold(LockSite site, std::chrono::nanoseconds duration);
+
+    /// Add the wait / hold histograms of every site.
+    static void addStats(const AddStatFn& add_stat, const void* cookie);
+
+    static void reset();
+
+private:
+    static std::atomic<size_t> sampleInterval;
+};
+
+/**
+ * Profiles one acquisition of a lock: construct it just before acquiring the
+ * lock, and call acquired() once it's held. Unless discarded, the hold time
+ * is recorded when the sample is destroyed (or released() is called).
+ *
+ * Moving a sample transfers the (remaining) measurement to the new object.
+ */
+class LockSample {
+public:
+    LockSample() = default;
+
+    explicit LockSample(LockSite site)
+        : site(site), sampled(LockProfiler::shouldSample()) {
+        if (sampled) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    LockSample(LockSample&& other)
+        : site(other.site), sampled(other.sampled), start(other.start) {
+        other.sampled = false;
+    }
+
+    LockSample(const LockSample&) = delete;
+    LockSample& operator=(const LockSample&) = delete;
+
+    ~LockSample() {
+        released();
+    }
+
+    /// Record the wait for the lock; the hold time is measured from now.
+    void acquired() {
+        if (sampled) {
+            const auto now = std::chrono::steady_clock::now();
+            LockProfiler::recordWait(site, now - start);
+            start = now;
+        }
+    }
+
+    /// Record the hold time (if not done already).
+    void released() {
+        if (sampled) {
+            LockProfiler::recordHold(site,
+                                     std::chrono::steady_clock::now() - start);
+            sampled = false;
+        }
+    }
+
+    /// Don't record the hold time (e.g. if the lock has been released early
+    /// by some other means).
+    void discard() {
+        sampled = false;
+    }
+
+private:
+    LockSite site = LockSite::HashBucket;
+    bool sampled = false;
+    std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * A lock holder (such as LockHolder or folly::SharedMutex::ReadHolder) which
+ * profiles its acquisition. As it *is* a T it can be passed to any function
+ * expecting the lock holder it replaces:
+ *
+ *   LockHolder lh(queueLock);
+ *
+ * becomes:
+ *
+ *   ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, queueLock);
+ *
+ * The hold time is measured until the holder is destroyed, so it shouldn't
+ * be used for holders which are unlocked early.
+ */
+template <typename T>
+class ProfiledLockHolder : private LockSample, public T {
+public:
+    template <typename Mutex>
+    ProfiledLockHolder(LockSite site, Mutex& mutex)
+        : LockSample(site), T(mutex) {
+        acquired();
+    }
+};
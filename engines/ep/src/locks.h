@@ -26,6 +26,7 @@ using LockHolder = std::lock_guard<std::mutex>;
 /**
  * RAII lock holder over multiple locks.
  */
+template <class Mutex = std::mutex>
 class MultiLockHolder {
 public:
 
@@ -34,7 +35,7 @@ public:
      *
      * @param m reference to a vector of locks
      */
-    MultiLockHolder(std::vector<std::mutex>& m)
+    MultiLockHolder(std::vector<Mutex>& m)
         : mutexes(m) {
         lock();
     }
@@ -62,7 +63,7 @@ private:
         }
     }
 
-    std::vector<std::mutex>& mutexes;
+    std::vector<Mutex>& mutexes;
 
     DISALLOW_COPY_AND_ASSIGN(MultiLockHolder);
 };
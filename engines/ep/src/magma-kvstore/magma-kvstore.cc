@@ -570,7 +570,9 @@ StorageProperties MagmaKVStore::getStorageProperties() {
                          StorageProperties::EfficientVBDeletion::Yes,
                          StorageProperties::PersistedDeletion::No,
                          StorageProperties::EfficientGet::Yes,
-                         StorageProperties::ConcurrentWriteCompact::Yes);
+                         StorageProperties::ConcurrentWriteCompact::Yes,
+                         StorageProperties::RangeScan::No,
+                         StorageProperties::ConcurrentFlush::No);
     return rv;
 }
 
@@ -292,9 +292,7 @@ void MutationLog::disable() {
 
 void MutationLog::newItem(Vbid vbucket, const StoredDocKey& key) {
     if (isEnabled()) {
-        MutationLogEntry* mle = MutationLogEntry::newEntry(
-                entryBuffer.get(), MutationLogType::New, vbucket, key);
-        writeEntry(mle);
+        writeEntry(MutationLogType::New, vbucket, {key.data(), key.size()});
     }
 }
 
@@ -303,6 +301,11 @@ void MutationLog::sync() {
         throw std::logic_error("MutationLog::sync: Not valid on a closed log");
     }
 
+    if (!writeBuffered()) {
+        throw WriteException("MutationLog::sync: Failed to write the "
+                             "buffered blocks");
+    }
+
     HdrMicroSecBlockTimer timer(&syncTimeHisto);
     try {
         doFsync(file);
@@ -313,9 +316,7 @@ void MutationLog::sync() {
 
 void MutationLog::commit1() {
     if (isEnabled()) {
-        MutationLogEntry* mle = MutationLogEntry::newEntry(
-                entryBuffer.get(), MutationLogType::Commit1, Vbid(0));
-        writeEntry(mle);
+        writeEntry(MutationLogType::Commit1, Vbid(0), {});
 
         if ((getSyncConfig() & FLUSH_COMMIT_1) != 0) {
             flush();
@@ -328,9 +329,7 @@ void MutationLog::commit1() {
 
 void MutationLog::commit2() {
     if (isEnabled()) {
-        MutationLogEntry* mle = MutationLogEntry::newEntry(
-                entryBuffer.get(), MutationLogType::Commit2, Vbid(0));
-        writeEntry(mle);
+        writeEntry(MutationLogType::Commit2, Vbid(0), {});
 
         if ((getSyncConfig() & FLUSH_COMMIT_2) != 0) {
             flush();
@@ -397,11 +396,12 @@ void MutationLog::readInitialBlock() {
 
     headerBlock.set(buf);
 
-    // Check the version is one we can handle, V1 and V2.
+    // Check the version is one we can handle, V1 to V4.
     switch (headerBlock.version()) {
     case MutationLogVersion::V1:
     case MutationLogVersion::V2:
     case MutationLogVersion::V3:
+    case MutationLogVersion::V4:
         break;
     default: {
         std::stringstream ss;
@@ -674,10 +674,24 @@ bool MutationLog::flush() {
         uint16_t crc16(htons(crc32 & 0xffff));
         memcpy(blockBuffer.get(), &crc16, sizeof(crc16));
 
-        if (writeFully(file, blockBuffer.get(), blockSize)) {
-            logSize.fetch_add(blockSize);
+        bool written;
+        if (writeBufferSize == 0) {
+            written = writeFully(file, blockBuffer.get(), blockSize);
+            if (written) {
+                logSize.fetch_add(blockSize);
+            }
+        } else {
+            writeBuffer.insert(writeBuffer.end(),
+                               blockBuffer.get(),
+                               blockBuffer.get() + blockSize);
+            written = writeBuffer.size() + blockSize <= writeBufferSize ||
+                      writeBuffered();
+        }
+
+        if (written) {
             blockPos = HEADER_RESERVED;
             entries = 0;
+            lastKey.clear();
         } else {
             /* write to the mutation log failed. Disable the log */
             disabled = true;
@@ -689,10 +703,35 @@ bool MutationLog::flush() {
     return true;
 }
 
-void MutationLog::writeEntry(MutationLogEntry *mle) {
-    if (mle->len() >= blockSize) {
-        throw std::invalid_argument("MutationLog::writeEntry: argument mle "
-                "has length (which is " + std::to_string(mle->len()) +
+bool MutationLog::writeBuffered() {
+    if (writeBuffer.empty()) {
+        return true;
+    }
+    if (!writeFully(file, writeBuffer.data(), writeBuffer.size())) {
+        return false;
+    }
+    logSize.fetch_add(writeBuffer.size());
+    writeBuffer.clear();
+    return true;
+}
+
+void MutationLog::setWriteBufferSize(size_t size) {
+    if (isOpen() && !readOnly && !writeBuffered()) {
+        throw WriteException("MutationLog::setWriteBufferSize: Failed to "
+                             "write the buffered blocks");
+    }
+    writeBufferSize = size;
+    writeBuffer.reserve(size);
+}
+
+void MutationLog::writeEntry(MutationLogType type,
+                             Vbid vb,
+                             cb::const_byte_buffer key) {
+    // Upper bound of the entry's size (without any shared prefix).
+    if (MutationLogEntryV4::len(key.size()) >= blockSize) {
+        throw std::invalid_argument("MutationLog::writeEntry: entry "
+                "has length (which is " +
+                std::to_string(MutationLogEntryV4::len(key.size())) +
                 ") greater than or equal to blockSize (which is" +
                 std::to_string(blockSize) + ")");
     }
@@ -706,16 +745,24 @@ void MutationLog::writeEntry(MutationLogEntry *mle) {
     }
     needWriteAccess();
 
-    size_t len(mle->len());
-    if (blockPos + len > blockSize) {
+    auto* mle = MutationLogEntryV4::newEntry(
+            entryBuffer.get(), type, vb, key, {lastKey.data(), lastKey.size()});
+    if (blockPos + mle->len() > blockSize) {
+        // The new block starts without a previous key.
         flush();
+        mle = MutationLogEntryV4::newEntry(
+                entryBuffer.get(), type, vb, key, {});
     }
 
+    size_t len(mle->len());
     memcpy(blockBuffer.get() + blockPos, mle, len);
     blockPos += len;
     ++entries;
+    if (type == MutationLogType::New) {
+        lastKey.assign(key.begin(), key.end());
+    }
 
-    ++itemsLogged[int(mle->type())];
+    ++itemsLogged[int(type)];
 }
 
 // ----------------------------------------------------------------------
@@ -739,7 +786,9 @@ MutationLog::iterator::iterator(const MutationLog::iterator& mit)
       p(buf.begin() + (mit.p - mit.buf.begin())),
       offset(mit.offset),
       items(mit.items),
-      isEnd(mit.isEnd) {
+      isEnd(mit.isEnd),
+      currentEntryLen(mit.currentEntryLen),
+      prevKey(mit.prevKey) {
 }
 
 MutationLog::iterator& MutationLog::iterator::operator=(const MutationLog::iterator& other)
@@ -751,6 +800,8 @@ MutationLog::iterator& MutationLog::iterator::operator=(const MutationLog::itera
     offset = other.offset;
     items = other.items;
     isEnd = other.isEnd;
+    currentEntryLen = other.currentEntryLen;
+    prevKey = other.prevKey;
 
     return *this;
 }
@@ -779,11 +830,44 @@ void MutationLog::iterator::prepItem() {
                 MutationLogEntryV3::newEntry(p, bufferBytesRemaining())->len();
         break;
     }
+    case MutationLogVersion::V4: {
+        prepItemV4();
+        return;
+    }
     }
 
     std::copy_n(p, copyLen, entryBuf.begin());
 }
 
+void MutationLog::iterator::prepItemV4() {
+    const auto* mle = MutationLogEntryV4::newEntry(p, bufferBytesRemaining());
+    if (mle->getPrefixLen() > prevKey.size()) {
+        throw ReadException(
+                "MutationLog::iterator::prepItemV4: prefix length (which is " +
+                std::to_string(mle->getPrefixLen()) +
+                ") is greater than the previous key's length (which is " +
+                std::to_string(prevKey.size()) + ")");
+    }
+    currentEntryLen = mle->len();
+
+    if (mle->type() != MutationLogType::New) {
+        MutationLogEntryV3::newEntry(
+                entryBuf.data(), mle->type(), mle->vbucket());
+        return;
+    }
+
+    const auto suffix = mle->getSuffix();
+    prevKey.resize(mle->getPrefixLen());
+    prevKey.insert(prevKey.end(), suffix.begin(), suffix.end());
+    MutationLogEntryV3::newEntry(
+            entryBuf.data(),
+            MutationLogType::New,
+            mle->vbucket(),
+            DocKey(prevKey.data(),
+                   prevKey.size(),
+                   DocKeyEncodesCollectionId::Yes));
+}
+
 size_t MutationLog::iterator::getCurrentEntryLen() const {
     switch (log->headerBlock.version()) {
     case MutationLogVersion::V1: {
@@ -798,6 +882,10 @@ size_t MutationLog::iterator::getCurrentEntryLen() const {
         return MutationLogEntryV3::newEntry(entryBuf.begin(), entryBuf.size())
                 ->len();
     }
+    case MutationLogVersion::V4: {
+        // entryBuf holds the expanded entry; use the on-disk length.
+        return currentEntryLen;
+    }
     }
     throw std::logic_error(
             "MutationLog::iterator::getCurrentEntryLen unknown version " +
@@ -832,8 +920,11 @@ bool MutationLog::iterator::operator!=(const MutationLog::iterator& rhs) const {
  * The upgrade technique is to upgrade from n to n+1 without any skips, this
  * simplifies each upgrade step, but may have a cost if many steps exist.
  *
- * git blame on the addition of MutationLogEntryV3 to see how V4 can be reached
+ * git blame on the addition of MutationLogEntryV3 to see how a new version
+ * can be reached.
  *
+ * V3 and V4 files are not upgraded: a V3 entry is already the in-memory
+ * layout, and prepItem() expands V4 entries into it.
  */
 MutationLog::MutationLogEntryHolder MutationLog::iterator::upgradeEntry()
         const {
@@ -844,9 +935,8 @@ MutationLog::MutationLogEntryHolder MutationLog::iterator::upgradeEntry()
     std::unique_ptr<uint8_t[]> allocatedV2;
     std::unique_ptr<uint8_t[]> allocated;
 
-    // With only two versions this code is a little unnecessary but will
-    // cause the addition of V4 to fail compile. The aim is that the addition of
-    // V4 should now be obvious. I.e. we can step V1->V2->V3->V4 or V2->V3->V4
+    // Any new version will fail to compile here until it is handled. We can
+    // step V1->V2->V3 or V2->V3.
     switch (log->headerBlock.version()) {
     case MutationLogVersion::V1: {
         mleV1 = MutationLogEntryV1::newEntry(entryBuf.begin(), entryBuf.size());
@@ -856,16 +946,11 @@ MutationLog::MutationLogEntryHolder MutationLog::iterator::upgradeEntry()
         mleV2 = MutationLogEntryV2::newEntry(entryBuf.begin(), entryBuf.size());
         break;
     }
-    /* If V4 exists then add a case for V3, for example:
-    case MutationLogVersion::V3: {
-        mleV3 = MutationLogEntryV3::newEntry(entryBuf.begin(), entryBuf.size());
-        break;
-    }
-    */
-    case MutationLogVersion::Current: {
+    case MutationLogVersion::V3:
+    case MutationLogVersion::V4: {
         throw std::invalid_argument(
                 "MutationLog::iterator::upgradeEntry cannot"
-                " upgrade if version == current");
+                " upgrade V3 or V4 (already the in-memory layout)");
     }
     }
 
@@ -905,23 +990,13 @@ MutationLog::MutationLogEntryHolder MutationLog::iterator::upgradeEntry()
 
         // Now in-place construct into the new buffer and assign to mleV3
         (void)new (allocated.get()) MutationLogEntryV3(*mleV2);
-        // If adding more cases, we should assign the above "new" pointer to a
-        // mleV3 and allow the next case to read it.
-
-        // fall through
+        // V3 is the in-memory layout (MutationLogEntry), so stop here.
+        break;
+    }
+    case MutationLogVersion::V4: {
+        throw std::logic_error(
+                "MutationLog::iterator::upgradeEntry: V3 is not upgraded");
     }
-        /* If V4 exists then add a case (which is hit by V3 falling through)
-        case MutationLogVersion::V4: {
-            // Upgrade V3 to V4
-            // Alloc a buffer using the length read from V3 as input to V4::len
-            allocated = std::make_unique<uint8_t[]>(
-                    MutationLogEntryV4::len(mleV3->getKeylen()));
-
-            // Now in-place construct into the new buffer and assign to mleV4
-            mleV4 = new (allocated.get()) MutationLogEntryV3(*mleV3);
-            // fall through
-        }
-        */
     }
 
     // transfer ownership to the MutationLogEntryHolder and mark that it's
@@ -930,12 +1005,17 @@ MutationLog::MutationLogEntryHolder MutationLog::iterator::upgradeEntry()
 }
 
 MutationLog::MutationLogEntryHolder MutationLog::iterator::operator*() {
-    // If the file version is down-level return an upgraded entry
-    if (log->headerBlock.version() != MutationLogVersion::Current) {
+    // If the file version is older than the in-memory layout (V3) return an
+    // upgraded entry
+    switch (log->headerBlock.version()) {
+    case MutationLogVersion::V1:
+    case MutationLogVersion::V2:
         return upgradeEntry();
-    } else {
-        return {entryBuf.data(), false /*not allocated*/};
+    case MutationLogVersion::V3:
+    case MutationLogVersion::V4:
+        break;
     }
+    return {entryBuf.data(), false /*not allocated*/};
 }
 
 size_t MutationLog::iterator::bufferBytesRemaining() {
@@ -983,6 +1063,8 @@ void MutationLog::iterator::nextBlock() {
     // the first item.
     p = buf.begin() + sizeof(uint16_t) + sizeof(uint16_t);
 
+    // V4 keys are prefix-compressed within a block only.
+    prevKey.clear();
     prepItem();
 }
 
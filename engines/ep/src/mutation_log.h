@@ -73,7 +73,7 @@ const int MUTATION_LOG_COMPACTOR_FREQ(3600);
 const size_t MIN_LOG_HEADER_SIZE(4096);
 const size_t HEADER_RESERVED(4);
 
-enum class MutationLogVersion { V1 = 1, V2 = 2, V3 = 3, Current = V3 };
+enum class MutationLogVersion { V1 = 1, V2 = 2, V3 = 3, V4 = 4, Current = V4 };
 
 const size_t LOG_ENTRY_BUF_SIZE(512);
 
@@ -250,6 +250,15 @@ public:
         return blockSize;
     }
 
+    /**
+     * Gather the blocks as they are flushed into writes of (up to) the given
+     * number of bytes, rather than writing each block individually. The
+     * gathered blocks are written once there are enough of them, and by
+     * sync() and close(). 0 (the default) writes each block as it is
+     * flushed.
+     */
+    void setWriteBufferSize(size_t size);
+
     bool exists() const;
 
     const std::string &getLogFile() const { return logPath; }
@@ -408,6 +417,9 @@ public:
          */
         MutationLogEntryHolder upgradeEntry() const;
 
+        /// Expand the V4 entry at p (into entryBuf, as a V3 entry)
+        void prepItemV4();
+
         const MutationLog* log;
         std::vector<uint8_t> entryBuf;
         std::vector<uint8_t> buf;
@@ -415,6 +427,10 @@ public:
         off_t              offset;
         uint16_t           items;
         bool               isEnd;
+        /// V4: on-disk length of the entry at p.
+        size_t currentEntryLen = 0;
+        /// V4: key of the previous New entry in the current block.
+        std::vector<uint8_t> prevKey;
     };
 
     /**
@@ -448,7 +464,11 @@ private:
             throw WriteException("Invalid access (file opened read only)");
         }
     }
-    void writeEntry(MutationLogEntry *mle);
+    /**
+     * Append an entry (as a MutationLogEntryV4) to the current block,
+     * flushing the block first if the entry doesn't fit.
+     */
+    void writeEntry(MutationLogType type, Vbid vb, cb::const_byte_buffer key);
 
     bool writeInitialBlock();
     void readInitialBlock();
@@ -456,6 +476,9 @@ private:
 
     bool prepareWrites();
 
+    /// Write the blocks gathered in writeBuffer to the file.
+    bool writeBuffered();
+
     file_handle_t fd() const { return file; }
 
     LogHeaderBlock     headerBlock;
@@ -467,8 +490,14 @@ private:
     uint16_t           entries;
     std::unique_ptr<uint8_t[]> entryBuffer;
     std::unique_ptr<uint8_t[]> blockBuffer;
+    /// Key of the last New entry in blockBuffer, which the next is
+    /// prefix-compressed against.
+    std::vector<uint8_t> lastKey;
     uint8_t            syncConfig;
     bool               readOnly;
+    /// Flushed blocks not yet written, see setWriteBufferSize().
+    std::vector<uint8_t> writeBuffer;
+    size_t writeBufferSize = 0;
 
     friend std::ostream& operator<<(std::ostream& os, const MutationLog& mlog);
 
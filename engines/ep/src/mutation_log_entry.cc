@@ -65,3 +65,15 @@ std::ostream& operator<<(std::ostream& out, const MutationLogEntryV3& mle) {
         << "''";
     return out;
 }
+
+std::ostream& operator<<(std::ostream& out, const MutationLogEntryV4& mle) {
+    const auto suffix = mle.getSuffix();
+    out << "{MutationLogEntryV4 vbucket=" << mle.vbucket().get() << ", magic=0x"
+        << std::hex << static_cast<uint16_t>(mle.magic) << std::dec
+        << ", type=" << to_string(mle.type())
+        << ", prefixLen=" << int(mle.prefixLen) << ", suffix=``"
+        << std::string(reinterpret_cast<const char*>(suffix.data()),
+                       suffix.size())
+        << "''";
+    return out;
+}
@@ -21,6 +21,9 @@
 #include "utility.h"
 
 #include <memcached/vbucket.h>
+#include <platform/sized_buffer.h>
+
+#include <algorithm>
 #include <type_traits>
 
 enum class MutationLogType : uint8_t {
@@ -455,8 +458,165 @@ private:
                   "_type must be a uint8_t");
 };
 
+/**
+ * An entry in the MutationLog.
+ * This is the V4 layout which prefix-compresses keys: each entry stores only
+ * the number of leading bytes it shares with the (collection-encoded) key of
+ * the previous New entry in the same block, followed by the remaining bytes.
+ * The first entry of each block has no previous key, so blocks can still be
+ * read (and their CRC checked) independently.
+ *
+ * V4 only exists on disk; MutationLog::iterator expands each V4 entry back
+ * into a MutationLogEntryV3.
+ */
+class MutationLogEntryV4 {
+public:
+    static const uint8_t MagicMarker = 0x48;
+
+    /**
+     * Initialize a new entry inside the given buffer.
+     *
+     * @param t the type of log entry
+     * @param vb the vbucket
+     * @param key the (collection-encoded) key; empty for Commit1/Commit2
+     * @param prevKey the key of the previous New entry in the block, which
+     *        key is prefix-compressed against
+     */
+    static MutationLogEntryV4* newEntry(uint8_t* buf,
+                                        MutationLogType t,
+                                        Vbid vb,
+                                        cb::const_byte_buffer key,
+                                        cb::const_byte_buffer prevKey) {
+        size_t prefix = 0;
+        const size_t maxPrefix = std::min(
+                {key.size(),
+                 prevKey.size(),
+                 size_t(std::numeric_limits<uint8_t>::max())});
+        while (prefix < maxPrefix && key[prefix] == prevKey[prefix]) {
+            ++prefix;
+        }
+        return new (buf) MutationLogEntryV4(
+                t, vb, uint8_t(prefix), {key.data() + prefix, key.size() - prefix});
+    }
+
+    /**
+     * Initialize a new entry using the contents of the given buffer.
+     *
+     * @param buf a chunk of memory thought to contain a valid
+     *        MutationLogEntryV4
+     * @param buflen the length of said buf
+     */
+    static const MutationLogEntryV4* newEntry(
+            std::vector<uint8_t>::const_iterator itr, size_t buflen) {
+        if (buflen < len(0)) {
+            throw std::invalid_argument(
+                    "MutationLogEntryV4::newEntry: buflen "
+                    "(which is " +
+                    std::to_string(buflen) +
+                    ") is less than minimum required (which is " +
+                    std::to_string(len(0)) + ")");
+        }
+
+        const auto* me = reinterpret_cast<const MutationLogEntryV4*>(&(*itr));
+
+        if (me->magic != MagicMarker) {
+            throw std::invalid_argument(
+                    "MutationLogEntryV4::newEntry: "
+                    "magic (which is " +
+                    std::to_string(me->magic) + ") is not equal to " +
+                    std::to_string(MagicMarker));
+        }
+        if (me->len() > buflen) {
+            throw std::invalid_argument(
+                    "MutationLogEntryV4::newEntry: "
+                    "entry length (which is " +
+                    std::to_string(me->len()) +
+                    ") is greater than available buflen (which is " +
+                    std::to_string(buflen) + ")");
+        }
+        return me;
+    }
+
+    // Statically buffered.  There is no delete.
+    void operator delete(void*) = delete;
+
+    /**
+     * The size of a MutationLogEntryV4, in bytes, storing a key suffix of
+     * the specified length.
+     */
+    static size_t len(size_t suffixLen) {
+        return offsetof(MutationLogEntryV4, _suffix) + suffixLen;
+    }
+
+    /**
+     * The number of bytes of the serialized form of this
+     * MutationLogEntryV4.
+     */
+    size_t len() const {
+        return len(suffixLen);
+    }
+
+    /**
+     * Number of leading bytes this entry's key shares with the previous key.
+     */
+    uint8_t getPrefixLen() const {
+        return prefixLen;
+    }
+
+    /**
+     * The bytes of this entry's key following the shared prefix.
+     */
+    cb::const_byte_buffer getSuffix() const {
+        return {_suffix, suffixLen};
+    }
+
+    /**
+     * This entry's vbucket.
+     */
+    Vbid vbucket() const {
+        return _vbucket.ntoh();
+    }
+
+    /**
+     * The type of this log entry.
+     */
+    MutationLogType type() const {
+        return _type;
+    }
+
+private:
+    friend std::ostream& operator<<(std::ostream& out,
+                                    const MutationLogEntryV4& e);
+
+    MutationLogEntryV4(MutationLogType t,
+                       Vbid vb,
+                       uint8_t prefix,
+                       cb::const_byte_buffer suffix)
+        : _vbucket(vb.hton()),
+          magic(MagicMarker),
+          _type(t),
+          prefixLen(prefix),
+          suffixLen(gsl::narrow_cast<uint8_t>(suffix.size())) {
+        std::copy(suffix.begin(), suffix.end(), _suffix);
+    }
+
+    const Vbid _vbucket;
+    const uint8_t magic;
+    const MutationLogType _type;
+    const uint8_t prefixLen;
+    const uint8_t suffixLen;
+    uint8_t _suffix[1];
+
+    DISALLOW_COPY_AND_ASSIGN(MutationLogEntryV4);
+
+    static_assert(sizeof(MutationLogType) == sizeof(uint8_t),
+                  "_type must be a uint8_t");
+};
+
+/// The in-memory layout of an entry, as returned by MutationLog::iterator.
 using MutationLogEntry = MutationLogEntryV3;
 
 std::ostream& operator<<(std::ostream& out, const MutationLogEntryV1& mle);
 std::ostream& operator<<(std::ostream& out, const MutationLogEntryV2& mle);
 std::ostream& operator<<(std::ostream& out, const MutationLogEntryV3& mle);
+std::ostream& operator<<(std::ostream& out, const MutationLogEntryV4& mle);
@@ -0,0 +1,88 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "numa_topology.h"
+
+#ifdef HAVE_LIBNUMA
+#include <numa.h>
+#include <numaif.h>
+#endif
+
+namespace NumaTopology {
+
+#ifdef HAVE_LIBNUMA
+static bool isAvailable() {
+    static const bool available = numa_available() >= 0;
+    return available;
+}
+
+size_t getNumNodes() {
+    if (!isAvailable()) {
+        return 1;
+    }
+    const int nodes = numa_num_configured_nodes();
+    return nodes > 0 ? size_t(nodes) : 1;
+}
+
+bool bindCurrentThreadToNode(size_t node) {
+    if (!isAvailable()) {
+        return false;
+    }
+    return numa_run_on_node(int(node)) == 0;
+}
+#else
+size_t getNumNodes() {
+    return 1;
+}
+
+bool bindCurrentThreadToNode(size_t) {
+    return false;
+}
+#endif
+
+} // namespace NumaTopology
+
+#ifdef HAVE_LIBNUMA
+NumaPreferredNodeGuard::NumaPreferredNodeGuard(int node) {
+    if (node < 0 || NumaTopology::getNumNodes() < 2) {
+        return;
+    }
+    savedNodes = numa_allocate_nodemask();
+    if (get_mempolicy(&savedMode,
+                      savedNodes->maskp,
+                      savedNodes->size + 1,
+                      nullptr,
+                      0) != 0) {
+        numa_free_nodemask(savedNodes);
+        savedNodes = nullptr;
+        return;
+    }
+    numa_set_preferred(node);
+}
+
+NumaPreferredNodeGuard::~NumaPreferredNodeGuard() {
+    if (savedNodes) {
+        set_mempolicy(savedMode, savedNodes->maskp, savedNodes->size + 1);
+        numa_free_nodemask(savedNodes);
+    }
+}
+#else
+NumaPreferredNodeGuard::NumaPreferredNodeGuard(int) {
+}
+
+NumaPreferredNodeGuard::~NumaPreferredNodeGuard() = default;
+#endif
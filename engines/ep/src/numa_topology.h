@@ -0,0 +1,67 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <cstddef>
+
+struct bitmask;
+
+/**
+ * Placement of threads and memory on the NUMA nodes of the machine, used
+ * when the numa_affinity_enabled configuration parameter is set (see
+ * KVShard::getNumaNode() and ExecutorThread).
+ *
+ * If memcached was built without libnuma, or the kernel doesn't support
+ * NUMA, the machine is treated as a single node and nothing is ever bound.
+ */
+namespace NumaTopology {
+
+/// The number of NUMA nodes threads and memory can be placed on (>= 1).
+size_t getNumNodes();
+
+/**
+ * Restrict the calling thread to the CPUs of the given node.
+ *
+ * @return true if the thread was bound, false if NUMA isn't available or
+ *         the request failed.
+ */
+bool bindCurrentThreadToNode(size_t node);
+
+} // namespace NumaTopology
+
+/**
+ * While in scope, pages the calling thread faults in are preferably
+ * allocated from the given NUMA node; the thread's previous memory policy
+ * is restored on destruction. A node of -1 (or a single node machine)
+ * makes the guard a no-op.
+ *
+ * This is best-effort: it only affects memory the allocator has to get
+ * fresh pages for, not memory it recycles.
+ */
+class NumaPreferredNodeGuard {
+public:
+    explicit NumaPreferredNodeGuard(int node);
+    ~NumaPreferredNodeGuard();
+
+    NumaPreferredNodeGuard(const NumaPreferredNodeGuard&) = delete;
+    NumaPreferredNodeGuard& operator=(const NumaPreferredNodeGuard&) = delete;
+
+private:
+    /// The policy to restore; null if the guard didn't change it.
+    struct bitmask* savedNodes = nullptr;
+    int savedMode = 0;
+};
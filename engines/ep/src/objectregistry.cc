@@ -22,6 +22,8 @@
 #include "stored-value.h"
 #include "threadlocal.h"
 
+#include <stdexcept>
+
 #if 1
 static ThreadLocal<EventuallyPersistentEngine*> *th;
 static ThreadLocal<std::atomic<size_t>*> *initial_track;
@@ -34,6 +36,8 @@ extern "C" {
 
 static get_allocation_size getAllocSize = defaultGetAllocSize;
 
+/// The MemoryDomain the current thread is allocating in
+static thread_local MemoryDomain currentMemoryDomain = MemoryDomain::Other;
 
 
 /**
@@ -82,7 +86,8 @@ void ObjectRegistry::onCreateBlob(const Blob *blob)
    if (verifyEngine(engine)) {
        auto& coreLocalStats = engine->getEpStats().coreLocal.get();
 
-       size_t size = getAllocSize(blob);
+       // An inline Blob is part of its owner's allocation
+       size_t size = blob->isInline() ? 0 : getAllocSize(blob);
        if (size == 0) {
            size = blob->getSize();
        } else {
@@ -100,7 +105,8 @@ void ObjectRegistry::onDeleteBlob(const Blob *blob)
    if (verifyEngine(engine)) {
        auto& coreLocalStats = engine->getEpStats().coreLocal.get();
 
-       size_t size = getAllocSize(blob);
+       // An inline Blob is part of its owner's allocation
+       size_t size = blob->isInline() ? 0 : getAllocSize(blob);
        if (size == 0) {
            size = blob->getSize();
        } else {
@@ -212,6 +218,41 @@ bool ObjectRegistry::memoryDeallocated(size_t mem) {
     return true;
 }
 
+MemoryDomain ObjectRegistry::getMemoryDomain() {
+    return currentMemoryDomain;
+}
+
+MemoryDomain ObjectRegistry::setMemoryDomain(MemoryDomain domain) {
+    const auto previous = currentMemoryDomain;
+    currentMemoryDomain = domain;
+    return previous;
+}
+
+std::string to_string(MemoryDomain domain) {
+    switch (domain) {
+    case MemoryDomain::Other:
+        return "other";
+    case MemoryDomain::HashTable:
+        return "hashtable";
+    case MemoryDomain::Blob:
+        return "blob";
+    case MemoryDomain::Checkpoint:
+        return "checkpoint";
+    case MemoryDomain::Dcp:
+        return "dcp";
+    case MemoryDomain::Backfill:
+        return "backfill";
+    case MemoryDomain::Collections:
+        return "collections";
+    case MemoryDomain::Connections:
+        return "connections";
+    case MemoryDomain::Count:
+        break;
+    }
+    throw std::invalid_argument("to_string(MemoryDomain): invalid domain " +
+                                std::to_string(int(domain)));
+}
+
 NonBucketAllocationGuard::NonBucketAllocationGuard() {
     engine = th->get();
     th->set(nullptr);
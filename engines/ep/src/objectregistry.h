@@ -18,6 +18,9 @@
 
 #include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
 
 class EventuallyPersistentEngine;
 class Blob;
@@ -30,6 +33,43 @@ extern "C" {
 
 class StoredValue;
 
+/**
+ * The subsystems memory tracked for a bucket (mem_used) is attributed to.
+ *
+ * Memory is charged to the domain of the allocating thread (as set by a
+ * MemoryDomainGuard) when it's allocated, and credited to the domain of the
+ * freeing thread when it's freed - so a subsystem is only attributed its
+ * memory if both the allocation and release of its objects happen within its
+ * guards. Anything allocated outside of a guard is charged to Other; the sum
+ * of all the domains is the memory tracked for the bucket.
+ */
+enum class MemoryDomain : uint8_t {
+    /// Anything not attributed to one of the domains below
+    Other,
+    /// StoredValues and the HashTable bucket arrays
+    HashTable,
+    /// Document values
+    Blob,
+    /// Checkpoint objects and their queues and indexes (but not the
+    /// items queued in them, which are shared with the HashTable, flusher
+    /// and DCP)
+    Checkpoint,
+    /// DCP messages queued to be sent by a producer or processed by a
+    /// consumer
+    Dcp,
+    /// Backfill objects and their disk scan contexts
+    Backfill,
+    /// The bucket's collections manifest and its updates of the vBucket
+    /// manifests
+    Collections,
+    /// DCP connection objects
+    Connections,
+    /// Not a domain; the number of domains
+    Count
+};
+
+std::string to_string(MemoryDomain domain);
+
 class ObjectRegistry {
 public:
     static void initialize(get_allocation_size func);
@@ -58,6 +98,16 @@ public:
     static void setStats(std::atomic<size_t>* init_track);
     static bool memoryAllocated(size_t mem);
     static bool memoryDeallocated(size_t mem);
+
+    /// @return the MemoryDomain the current thread is allocating in
+    static MemoryDomain getMemoryDomain();
+
+    /**
+     * Set the MemoryDomain the current thread is allocating in.
+     *
+     * @return the previous domain
+     */
+    static MemoryDomain setMemoryDomain(MemoryDomain domain);
 };
 
 /**
@@ -71,3 +121,47 @@ public:
 private:
     EventuallyPersistentEngine* engine = nullptr;
 };
+
+/**
+ * Attribute the memory the current thread allocates and frees to the given
+ * domain until the guard goes out of scope, when the thread's previous domain
+ * is restored (so the guards nest).
+ */
+class MemoryDomainGuard {
+public:
+    explicit MemoryDomainGuard(MemoryDomain domain)
+        : previous(ObjectRegistry::setMemoryDomain(domain)) {
+    }
+
+    ~MemoryDomainGuard() {
+        ObjectRegistry::setMemoryDomain(previous);
+    }
+
+    MemoryDomainGuard(const MemoryDomainGuard&) = delete;
+    MemoryDomainGuard& operator=(const MemoryDomainGuard&) = delete;
+
+private:
+    const MemoryDomain previous;
+};
+
+/**
+ * Base class giving a class an operator new and delete which attribute its
+ * objects to the given domain wherever they are created and destroyed.
+ *
+ * Only the object itself is covered; any memory the object owns (allocated
+ * by its constructor or other members, and freed by its destructor) is
+ * attributed to the domain of the thread doing so.
+ */
+template <MemoryDomain Domain>
+class MemoryDomainAllocated {
+public:
+    static void* operator new(std::size_t count) {
+        MemoryDomainGuard guard(Domain);
+        return ::operator new(count);
+    }
+
+    static void operator delete(void* ptr) {
+        MemoryDomainGuard guard(Domain);
+        ::operator delete(ptr);
+    }
+};
@@ -22,6 +22,7 @@
 #include "dcp/dcpconnmap.h"
 #include "ep_engine.h"
 #include "ep_time.h"
+#include "eviction_ghost_list.h"
 #include "executorpool.h"
 #include "item.h"
 #include "item_eviction.h"
@@ -76,6 +77,8 @@ PagingVisitor::PagingVisitor(KVBucket& s,
 }
 
 bool PagingVisitor::visit(const HashTable::HashBucketLock& lh, StoredValue& v) {
+    ++visited;
+
     // Delete expired items for an active vbucket.
     bool isExpired = (currentBucket->getState() == vbucket_state_active) &&
                      v.isExpired(startTime) && !v.isDeleted();
@@ -90,6 +93,11 @@ bool PagingVisitor::visit(const HashTable::HashBucketLock& lh, StoredValue& v) {
         return true;
     }
 
+    if (!collectionOverage.empty()) {
+        evictCollectionOverage(lh, v);
+        return true;
+    }
+
     /*
      * We take a copy of the freqCounterValue because calling
      * doEviction can modify the value, and when we want to
@@ -116,9 +124,20 @@ bool PagingVisitor::visit(const HashTable::HashBucketLock& lh, StoredValue& v) {
     uint64_t age = (maxCas > v.getCas()) ? (maxCas - v.getCas()) : 0;
     age = age >> ItemEviction::casBitsNotTime;
 
-    if ((storedValueFreqCounter <= freqCounterThreshold) &&
-        ((storedValueFreqCounter < freqCounterAgeThreshold) ||
-         (age >= ageThreshold))) {
+    bool oldEnough;
+    if (evictionPolicy == EvictionPolicy::adaptive) {
+        // Items referenced since they were stored are judged by frequency
+        // first; the others (e.g. those brought in by a scan) by recency.
+        oldEnough = age >= ((storedValueFreqCounter >
+                             ItemEviction::initialFreqCount)
+                                    ? frequencyAgeThreshold
+                                    : recencyAgeThreshold);
+    } else {
+        oldEnough = (storedValueFreqCounter < freqCounterAgeThreshold) ||
+                    (age >= ageThreshold);
+    }
+
+    if ((storedValueFreqCounter <= freqCounterThreshold) && oldEnough) {
         /*
          * If the storedValue is eligible for eviction then add its
          * frequency counter value to the histogram, otherwise add the
@@ -180,6 +199,16 @@ bool PagingVisitor::visit(const HashTable::HashBucketLock& lh, StoredValue& v) {
                 itemEviction.getThresholds(percent * 100.0, agePercentage);
         freqCounterThreshold = thresholds.first;
         ageThreshold = thresholds.second;
+        if (evictionPolicy == EvictionPolicy::adaptive) {
+            recencyAgeThreshold =
+                    itemEviction.getThresholds(percent * 100.0, recencyTarget)
+                            .second;
+            frequencyAgeThreshold =
+                    itemEviction
+                            .getThresholds(percent * 100.0,
+                                           100 - recencyTarget)
+                            .second;
+        }
     }
 
     return true;
@@ -193,9 +222,18 @@ void PagingVisitor::visitBucket(const VBucketPtr& vb) {
     if (percent <= 0 || !pager_phase) {
         if (vBucketFilter(vb->getId())) {
             currentBucket = vb;
-            // EvictionPolicy is not required when running expiry item
-            // pager
-            vb->ht.visit(*this);
+            if (owner == EXPIRY_PAGER && vb->hasExpiryIndex()) {
+                // Only look at the items which are due to expire (and only
+                // active vBuckets expire items).
+                if (vb->getState() == vbucket_state_active) {
+                    visited += vb->getExpiredItemsFromIndex(startTime,
+                                                            expired);
+                }
+            } else {
+                // EvictionPolicy is not required when running expiry item
+                // pager
+                vb->ht.visit(*this);
+            }
         }
         return;
     }
@@ -217,6 +255,14 @@ void PagingVisitor::visitBucket(const VBucketPtr& vb) {
             maxCas = currentBucket->getMaxCas();
             itemEviction.reset();
             freqCounterThreshold = 0;
+            if (evictionPolicy == EvictionPolicy::adaptive) {
+                auto* ghosts = store.getEvictionGhostList();
+                if (ghosts) {
+                    recencyTarget = ghosts->getRecencyTarget();
+                } else {
+                    evictionPolicy = EvictionPolicy::hifi_mfu;
+                }
+            }
 
             // Percent of items in the hash table to be visited
             // between updating the interval.
@@ -229,8 +275,13 @@ void PagingVisitor::visitBucket(const VBucketPtr& vb) {
                                         ? noOfItems
                                         : ItemEviction::learningPopulation;
             itemEviction.setUpdateInterval(interval);
+            findCollectionOverage(*vb);
 
-            vb->ht.visit(*this);
+            if (sampleSize) {
+                sampleHashTable(*vb);
+            } else {
+                vb->ht.visit(*this);
+            }
             /**
              * Note: We are not taking a reader lock on the vbucket state.
              * Therefore it is possible that the stats could be slightly
@@ -277,13 +328,38 @@ void PagingVisitor::update() {
         EP_LOG_DEBUG("Purged {} expired items", num_expired);
     }
 
+    if (owner == ITEM_PAGER) {
+        stats.pagerItemsVisited.fetch_add(visited);
+        stats.pagerItemsEvicted.fetch_add(numEjected());
+    }
+
     ejected = 0;
+    visited = 0;
     expired.clear();
 }
 
+void PagingVisitor::sampleHashTable(VBucket& vb) {
+    const size_t maxItems = vb.ht.getNumItems();
+    // Also bound the number of buckets sampled, in case most are empty.
+    const size_t maxBuckets = 2 * vb.ht.getSize();
+    const auto lower = stats.mem_low_wat.load();
+
+    size_t items = 0;
+    size_t buckets = 0;
+    while (items < maxItems && buckets < maxBuckets) {
+        for (size_t ii = 0; ii < sampleSize; ++ii, ++buckets) {
+            items += vb.ht.visitRandomBucket(*this, sampleGenerator());
+        }
+        if (stats.getEstimatedTotalMemoryUsed() <= lower) {
+            break;
+        }
+    }
+}
+
 bool PagingVisitor::pauseVisitor() {
     size_t queueSize = stats.diskQueueSize.load();
-    return canPause && queueSize >= MAX_PERSISTENCE_QUEUE_SIZE;
+    return canPause && (queueSize >= MAX_PERSISTENCE_QUEUE_SIZE ||
+                        GlobalTask::isCpuBudgetExhausted());
 }
 
 void PagingVisitor::complete() {
@@ -355,9 +431,14 @@ bool PagingVisitor::doEviction(const HashTable::HashBucketLock& lh,
                                StoredValue* v) {
     auto policy = store.getItemEvictionPolicy();
     StoredDocKey key(v->getKey());
+    const bool referenced =
+            v->getFreqCounterValue() > ItemEviction::initialFreqCount;
 
     if (currentBucket->pageOut(readHandle, lh, v)) {
         ++ejected;
+        if (auto* ghosts = store.getEvictionGhostList()) {
+            ghosts->recordEviction(key, ep_current_time(), referenced);
+        }
 
         /**
          * For FULL EVICTION MODE, add all items that are being
@@ -373,6 +454,43 @@ bool PagingVisitor::doEviction(const HashTable::HashBucketLock& lh,
     return false;
 }
 
+void PagingVisitor::findCollectionOverage(VBucket& vb) {
+    collectionOverage.clear();
+    if (collectionMemoryShare <= 0) {
+        return;
+    }
+
+    const auto limit = static_cast<size_t>(collectionMemoryShare *
+                                           vb.ht.getItemMemory());
+    for (const auto& entry : vb.ht.getCollectionItemMemory()) {
+        if (!entry.first.isSystem() && entry.second > limit) {
+            collectionOverage.emplace(entry.first, entry.second - limit);
+        }
+    }
+}
+
+void PagingVisitor::evictCollectionOverage(const HashTable::HashBucketLock& lh,
+                                           StoredValue& v) {
+    auto it = collectionOverage.find(v.getKey().getCollectionID());
+    if (it == collectionOverage.end()) {
+        return;
+    }
+
+    // Value eviction only frees the value; full eviction the whole item.
+    const int64_t size = (store.getItemEvictionPolicy() ==
+                          ::EvictionPolicy::Value)
+                                 ? v.valuelen()
+                                 : v.size();
+    if (doEviction(lh, &v)) {
+        it->second -= size;
+        if (it->second <= 0) {
+            // Back within its share; once every collection is, the
+            // frequency and age thresholds apply again.
+            collectionOverage.erase(it);
+        }
+    }
+}
+
 void PagingVisitor::setUpHashBucketVisit() {
     // Grab a locked ReadHandle
     readHandle = currentBucket->lockCollections();
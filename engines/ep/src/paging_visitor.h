@@ -25,6 +25,8 @@
 
 #include <atomic>
 #include <list>
+#include <random>
+#include <unordered_map>
 
 class EPStats;
 class EventuallyPersistentEngine;
@@ -41,7 +43,11 @@ class PagingVisitor : public PausableVBucketVisitor, public HashTableVisitor {
 public:
     enum class EvictionPolicy : uint8_t {
         lru2Bit, // The original 2-bit LRU policy
-        hifi_mfu // The new hifi_mfu policy
+        hifi_mfu, // The new hifi_mfu policy
+        // hifi_mfu with separate age thresholds for items which have and
+        // haven't been referenced since they were stored, adapted from
+        // refetches of evicted items (see EvictionGhostList)
+        adaptive
     };
 
     /**
@@ -103,6 +109,36 @@ public:
         return ejected;
     }
 
+    /**
+     * Select the items to evict from each vBucket by visiting the given
+     * number of random hash buckets at a time, until memory usage drops
+     * below the low watermark, instead of visiting all of the vBucket's
+     * items. 0 (the default) visits all items.
+     */
+    void setSampleSize(size_t buckets) {
+        sampleSize = buckets;
+    }
+
+    /**
+     * Select the hifi_mfu (the default) or adaptive eviction policy.
+     * adaptive requires the bucket to have an EvictionGhostList; without
+     * one hifi_mfu is used.
+     */
+    void setEvictionPolicy(EvictionPolicy policy) {
+        evictionPolicy = policy;
+    }
+
+    /**
+     * Evict from the collections using more than the given fraction of a
+     * vBucket's item memory first: until they are back within it, their
+     * items are evicted regardless of frequency and age, and the items of
+     * other collections are left alone. 0 (the default) treats all
+     * collections alike.
+     */
+    void setCollectionMemoryShare(double share) {
+        collectionMemoryShare = share;
+    }
+
 protected:
     // Protected for testing purposes
     // Holds the data structures used during the selection of documents to
@@ -123,6 +159,18 @@ protected:
     // items from the hash table.
     uint64_t ageThreshold;
 
+    // The adaptive policy's age thresholds for items which haven't / have
+    // been referenced since they were stored.
+    uint64_t recencyAgeThreshold = 0;
+    uint64_t frequencyAgeThreshold = 0;
+
+    // The adaptive policy's age percentile for recencyAgeThreshold (the
+    // frequency one uses 100 - recencyTarget); read from the bucket's
+    // EvictionGhostList for each vBucket.
+    size_t recencyTarget = 0;
+
+    EvictionPolicy evictionPolicy = EvictionPolicy::hifi_mfu;
+
 private:
     // Removes checkpoints that are both closed and unreferenced, thereby
     // freeing the associated memory.
@@ -133,6 +181,27 @@ private:
 
     bool doEviction(const HashTable::HashBucketLock& lh, StoredValue* v);
 
+    /**
+     * Visit random hash buckets of the vBucket (sampleSize at a time) until
+     * memory usage is below the low watermark; or until as many items as
+     * the vBucket holds have been visited, so a vBucket is never visited
+     * more than by a full sweep.
+     */
+    void sampleHashTable(VBucket& vb);
+
+    /**
+     * Record in collectionOverage how far each collection of the vBucket
+     * is over collectionMemoryShare of its item memory.
+     */
+    void findCollectionOverage(VBucket& vb);
+
+    /**
+     * visit() whilst some collection is over its share: evict v if it
+     * belongs to such a collection.
+     */
+    void evictCollectionOverage(const HashTable::HashBucketLock& lh,
+                                StoredValue& v);
+
     std::list<Item> expired;
 
     KVBucket& store;
@@ -166,6 +235,24 @@ private:
     // visit all items in the vbucket.
     uint64_t maxCas;
 
+    // Number of hash buckets visited per round when sampling (0 = visit all
+    // items; see setSampleSize()).
+    size_t sampleSize = 0;
+
+    // Items visited since the last update(), added to
+    // EPStats::pagerItemsVisited.
+    size_t visited = 0;
+
+    std::minstd_rand sampleGenerator{std::random_device()()};
+
+    // Fraction of a vBucket's item memory a collection may use before it is
+    // evicted from first (0 = off; see setCollectionMemoryShare()).
+    double collectionMemoryShare = 0;
+
+    // Bytes still to be evicted from each collection of the current
+    // vBucket which is over collectionMemoryShare.
+    std::unordered_map<CollectionID, int64_t> collectionOverage;
+
     // The VB::Manifest read handle that we use to lock around HashBucket
     // visits. Will contain a nullptr if we aren't currently locking anything.
     Collections::VB::Manifest::ReadHandle readHandle;
@@ -0,0 +1,67 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "pid_controller.h"
+
+#include <algorithm>
+
+PIDController::PIDController(double setPoint,
+                             double kp,
+                             double ki,
+                             double kd,
+                             double minOutput,
+                             double maxOutput)
+    : setPoint(setPoint),
+      kp(kp),
+      ki(ki),
+      kd(kd),
+      minOutput(minOutput),
+      maxOutput(maxOutput) {
+}
+
+double PIDController::step(double measured,
+                           std::chrono::steady_clock::time_point now) {
+    const double error = measured - setPoint;
+
+    // The first step has no interval, so only the proportional term applies
+    double dt = 0.0;
+    if (lastStep != std::chrono::steady_clock::time_point{}) {
+        dt = std::chrono::duration<double>(now - lastStep).count();
+    }
+    lastStep = now;
+
+    const double nextIntegral = integral + error * dt;
+    const double derivative = dt > 0.0 ? (error - lastError) / dt : 0.0;
+    lastError = error;
+
+    const double raw = kp * error + ki * nextIntegral + kd * derivative;
+    output = std::min(maxOutput, std::max(minOutput, raw));
+
+    // Only integrate while the output isn't saturated (or the error brings
+    // it back off the limit).
+    if ((raw < maxOutput || error < 0) && (raw > minOutput || error > 0)) {
+        integral = nextIntegral;
+    }
+    return output;
+}
+
+void PIDController::reset() {
+    integral = 0.0;
+    lastError = 0.0;
+    output = 0.0;
+    lastStep = {};
+}
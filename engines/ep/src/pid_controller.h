@@ -0,0 +1,81 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <chrono>
+
+/**
+ * A PID (proportional, integral, derivative) controller, which computes the
+ * effort to apply to a process to move a measured value towards a set point.
+ *
+ * The error is taken as (measured - set point), so a positive output asks
+ * for more effort to bring the value down (for example more defragmenting
+ * when fragmentation is above its target). The output is clamped to
+ * [minOutput, maxOutput]; while it is clamped the integral isn't
+ * accumulated further, so it doesn't "wind up" and overshoot once the value
+ * comes back towards the set point.
+ *
+ * Not thread-safe.
+ */
+class PIDController {
+public:
+    PIDController(double setPoint,
+                  double kp,
+                  double ki,
+                  double kd,
+                  double minOutput = 0.0,
+                  double maxOutput = 1.0);
+
+    void setSetPoint(double value) {
+        setPoint = value;
+    }
+
+    /// Set the gains of the proportional, integral and derivative terms
+    void setGains(double p, double i, double d) {
+        kp = p;
+        ki = i;
+        kd = d;
+    }
+
+    /**
+     * Feed the controller the value measured at the given time.
+     *
+     * @return the output (in [minOutput, maxOutput])
+     */
+    double step(double measured, std::chrono::steady_clock::time_point now);
+
+    /// Forget the history (the integral and last error)
+    void reset();
+
+    double getOutput() const {
+        return output;
+    }
+
+private:
+    double setPoint;
+    double kp;
+    double ki;
+    double kd;
+    const double minOutput;
+    const double maxOutput;
+
+    double integral = 0.0;
+    double lastError = 0.0;
+    double output = 0.0;
+    /// When step() was last called; unset until the first step
+    std::chrono::steady_clock::time_point lastStep{};
+};
@@ -59,6 +59,11 @@ public:
      */
     void preLink(uint64_t cas, uint64_t seqno);
 
+    /// @return the cookie of the connection modifying the document
+    const void* getCookie() const {
+        return cookie;
+    }
+
     PreLinkDocumentContext(const PreLinkDocumentContext&) = delete;
 
 protected:
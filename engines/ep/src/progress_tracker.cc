@@ -17,6 +17,8 @@
 
 #include "progress_tracker.h"
 
+#include "globaltask.h"
+
 #include <limits>
 
 ProgressTracker::ProgressTracker()
@@ -55,9 +57,10 @@ bool ProgressTracker::shouldContinueVisiting(size_t visited_items) {
         return true;
     }
 
-    // First check if the deadline has been exceeded; if so need to pause.
+    // First check if the deadline has been exceeded, or the task we're
+    // running in has used up its CPU budget; if so need to pause.
     const auto now = std::chrono::steady_clock::now();
-    if (now >= deadline) {
+    if (now >= deadline || GlobalTask::isCpuBudgetExhausted()) {
         return false;
     }
 
@@ -18,10 +18,13 @@
 #include "configuration.h"
 #include "replicationthrottle.h"
 
+#include <algorithm>
+
 ReplicationThrottle::ReplicationThrottle(const Configuration& config,
                                          EPStats& s)
     : queueCap(config.getReplicationThrottleQueueCap()),
       capPercent(config.getReplicationThrottleCapPcnt()),
+      rateBased(config.isReplicationThrottleRateBased()),
       stats(s) {
 }
 
@@ -60,6 +63,83 @@ void ReplicationThrottle::adjustWriteQueueCap(size_t totalItems) {
                                          qcap);
 }
 
+size_t ReplicationThrottle::getAckableBytes(
+        size_t freedBytes, std::chrono::steady_clock::time_point now) {
+    if (!rateBased) {
+        return freedBytes;
+    }
+
+    std::lock_guard<std::mutex> lh(rateMutex);
+    updateAckRate_UNLOCKED(now);
+
+    const double elapsed =
+            std::chrono::duration<double>(now - lastRefill).count();
+    lastRefill = now;
+    if (ackRate < 0) {
+        ackedBytes += freedBytes;
+        return freedBytes;
+    }
+
+    // Allow a burst of at most a second's worth of acks
+    ackBudget = std::min(ackBudget + ackRate * elapsed, ackRate);
+    const auto ackable =
+            static_cast<size_t>(std::min(double(freedBytes), ackBudget));
+    ackBudget -= ackable;
+    ackedBytes += ackable;
+    if (ackable < freedBytes) {
+        ++stats.replicationThrottleDeferredAcks;
+    }
+    return ackable;
+}
+
+size_t ReplicationThrottle::getAckRate() const {
+    std::lock_guard<std::mutex> lh(rateMutex);
+    return ackRate < 0 ? 0 : static_cast<size_t>(ackRate);
+}
+
+void ReplicationThrottle::updateAckRate_UNLOCKED(
+        std::chrono::steady_clock::time_point now) {
+    if (lastRateUpdate == std::chrono::steady_clock::time_point{}) {
+        // First use; measure from now
+        lastRefill = lastRateUpdate = now;
+        persistedAtUpdate = stats.totalPersisted;
+        enqueuedAtUpdate = stats.totalEnqueued;
+        ackedAtUpdate = ackedBytes;
+        return;
+    }
+    const auto elapsed = now - lastRateUpdate;
+    if (elapsed < std::chrono::seconds(1)) {
+        return;
+    }
+    const double secs = std::chrono::duration<double>(elapsed).count();
+    const size_t persisted = stats.totalPersisted;
+    const size_t enqueued = stats.totalEnqueued;
+    const double flushRate = (persisted - persistedAtUpdate) / secs;
+    if (enqueued > enqueuedAtUpdate && ackedBytes > ackedAtUpdate) {
+        bytesPerItem = double(ackedBytes - ackedAtUpdate) /
+                       (enqueued - enqueuedAtUpdate);
+    }
+    lastRateUpdate = now;
+    persistedAtUpdate = persisted;
+    enqueuedAtUpdate = enqueued;
+    ackedAtUpdate = ackedBytes;
+
+    const ssize_t cap = stats.replicationThrottleWriteQueueCap;
+    const size_t queueSize = stats.diskQueueSize;
+    const size_t start = cap / 2;
+    if (cap <= 0 || queueSize <= start || bytesPerItem == 0) {
+        ackRate = -1;
+        return;
+    }
+
+    // Let items in at the rate the flusher is persisting them once the
+    // queue reaches half the cap (so that it stops growing), scaled down
+    // linearly to nothing as it approaches the cap.
+    const size_t headroom = size_t(cap) - std::min(queueSize, size_t(cap));
+    const double itemRate = flushRate * headroom / (size_t(cap) - start);
+    ackRate = itemRate * bytesPerItem;
+}
+
 ReplicationThrottleEphe::ReplicationThrottleEphe(const Configuration& config,
                                                  EPStats& s)
     : ReplicationThrottle(config, s), config(config) {
@@ -20,6 +20,9 @@
 
 #include "stats.h"
 
+#include <chrono>
+#include <mutex>
+
 class Configuration;
 
 /**
@@ -54,15 +57,67 @@ public:
     void setCapPercent(size_t perc) { capPercent = perc; }
     void setQueueCap(ssize_t cap) { queueCap = cap; }
 
+    void setRateBased(bool enabled) {
+        rateBased = enabled;
+    }
+
     void adjustWriteQueueCap(size_t totalItems);
 
+    /**
+     * With replication_throttle_rate_based, pace the buffer acks the DCP
+     * consumers send (and so the rate their producers may send at) once the
+     * disk write queue is over half of the throttle's cap, so that replicas
+     * slow down smoothly as the queue fills rather than running at full
+     * speed until getStatus() pauses them.
+     *
+     * Called by a consumer about to ack freedBytes; it must only ack the
+     * returned number of bytes.
+     *
+     * @return how many of the consumer's freed bytes it may ack now
+     */
+    size_t getAckableBytes(size_t freedBytes) {
+        return getAckableBytes(freedBytes, std::chrono::steady_clock::now());
+    }
+
+    /// As above, at the given time (for testing)
+    size_t getAckableBytes(size_t freedBytes,
+                           std::chrono::steady_clock::time_point now);
+
+    /// @return the rate (bytes/s) acks are paced at; 0 if they aren't
+    size_t getAckRate() const;
+
 private:
     bool persistenceQueueSmallEnough() const;
     bool hasSomeMemory() const;
 
+    /**
+     * Re-evaluate ackRate, at most once a second, from the disk write
+     * queue's depth and the rate the flusher is persisting items at.
+     */
+    void updateAckRate_UNLOCKED(std::chrono::steady_clock::time_point now);
+
     cb::RelaxedAtomic<ssize_t> queueCap;
     cb::RelaxedAtomic<size_t> capPercent;
+    cb::RelaxedAtomic<bool> rateBased;
     EPStats &stats;
+
+    // The rate-based throttle's state, shared by all of the bucket's
+    // consumers and guarded by rateMutex.
+    mutable std::mutex rateMutex;
+    // Bytes per second acks are paced at; negative if they're not paced
+    double ackRate{-1};
+    // Bytes which may be acked now (a token bucket filled at ackRate)
+    double ackBudget{0};
+    std::chrono::steady_clock::time_point lastRefill{};
+    // Totals at, and the time of, the last ackRate update
+    std::chrono::steady_clock::time_point lastRateUpdate{};
+    size_t persistedAtUpdate{0};
+    size_t enqueuedAtUpdate{0};
+    uint64_t ackedAtUpdate{0};
+    // Total bytes the consumers have been allowed to ack
+    uint64_t ackedBytes{0};
+    // Replicated bytes acked per item queued for persistence
+    double bytesPerItem{0};
 };
 
 /**
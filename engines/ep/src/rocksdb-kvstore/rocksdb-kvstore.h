@@ -187,10 +187,11 @@ public:
 
     void getMulti(Vbid vb, vb_bgfetch_queue_t& itms) override;
 
-    void getRange(Vbid vb,
-                  const DiskDocKey& startKey,
-                  const DiskDocKey& endKey,
-                  const GetRangeCb& cb) override;
+    void scanRange(Vbid vb,
+                   const DiskDocKey& startKey,
+                   const DiskDocKey& endKey,
+                   ValueFilter filter,
+                   const ScanRangeCb& cb) override;
 
     /**
      * Overrides del().
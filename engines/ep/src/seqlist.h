@@ -156,8 +156,8 @@ public:
      * Note: (a) Do not hold the iterator for long, as it will result in stale
      *           items in list and hence increased memory usage.
      *       (b) Make sure to delete the iterator after using it.
-     *       (c) For now, we allow on one RangeIterator. Try to create more
-     *           iterators will result in the create call(s) being blocked.
+     *       (c) Any number of RangeIterators may exist at once, but the
+     *           create call fails while the list is being purged.
      */
     class RangeIterator {
     public:
@@ -323,15 +323,17 @@ public:
     /**
      * Remove from sequence list and delete all OSVs which are purgable.
      * OSVs which can be purged are items which are outside the ReadRange and
-     * are Stale.
+     * are Stale, and, if a purge of dropped keys has been scheduled (see
+     * scheduleDroppedKeysPurge()), the items of dropped collections.
      *
      * @param purgeUpToSeqno Indicates the max seqno (inclusive) that could be
      *                       purged
      * @param isDroppedKey Callback function the purger will use to determine if
      *                     a key is belongs to a dropped collection.
      * @param shouldPause Callback function that indicates if tombstone purging
-     *                    should pause. This is called for every element in the
-     *                    sequence list when we iterate over the list during the
+     *                    should pause. This is called for every element
+     *                    visited (every stale item, and every item when
+     *                    scanning the list for dropped keys) during the
      *                    purge. The caller should decide if the purge should
      *                    continue or if it should be paused (in case it is
      *                    running for a long time). By default, we assume that
@@ -347,6 +349,13 @@ public:
 
             std::function<bool()> shouldPause = []() { return false; }) = 0;
 
+    /**
+     * Schedule a scan of the whole sequence list for the keys of dropped
+     * collections, by the next purgeTombstones() (which otherwise only visits
+     * the stale items). To be called when a collection is dropped.
+     */
+    virtual void scheduleDroppedKeysPurge() = 0;
+
     /**
      * Updates the number of deleted items in the sequence list whenever
      * an item is modified.
@@ -403,15 +412,28 @@ public:
     virtual seqno_t getHighestPurgedDeletedSeqno() const = 0;
 
     /**
-     * Returns the current range read begin sequence number.
+     * Returns the current range read begin sequence number (the lowest begin
+     * of the ranges being read, if there is more than one).
      */
     virtual uint64_t getRangeReadBegin() const = 0;
 
     /**
-     * Returns the current range read end sequence number.
+     * Returns the current range read end sequence number (the highest end of
+     * the ranges being read, if there is more than one).
      */
     virtual uint64_t getRangeReadEnd() const = 0;
 
+    /**
+     * Returns the number of range reads in progress.
+     */
+    virtual uint64_t getNumRangeReads() const = 0;
+
+    /**
+     * Returns the number of stale items created because the updated item
+     * was in a range being read.
+     */
+    virtual uint64_t getNumRangeReadStaleItems() const = 0;
+
     /**
      * Returns the lock which must be held to make append/update to the seqList
      * + the updation of the corresponding highSeqno or the
@@ -425,12 +447,15 @@ public:
      * the SequenceList, new range iterator will not be allowed
      *
      * @param isBackfill indicates if the iterator is for backfill (for debug)
+     * @param start seqno from which the iterator is to read; it is positioned
+     *        at the first item with a seqno >= start (or at the last item, if
+     *        there is no such item)
      *
      * @return range iterator object when possible
      *         null when not possible
      */
     virtual boost::optional<SequenceList::RangeIterator> makeRangeIterator(
-            bool isBackfill) = 0;
+            bool isBackfill, seqno_t start = 1) = 0;
 
     /**
      * Debug - prints a representation of the list to stderr.
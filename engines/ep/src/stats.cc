@@ -32,10 +32,17 @@ EPStats::EPStats()
       warmupMemUsedCap(0),
       warmupNumReadCap(0),
       replicationThrottleWriteQueueCap(0),
+      replicationThrottleDeferredAcks(0),
       diskQueueSize(0),
       vbBackfillQueueSize(0),
       flusher_todo(0),
       flusherCommits(0),
+      flusherCommittedItems(0),
+      flusherDeferrals(0),
+      flusherHotKeyDeferrals(0),
+      flusherSupersededItems(0),
+      flusherVBStateDeferrals(0),
+      flusherVBStateFolded(0),
       cumulativeFlushTime(0),
       cumulativeCommitTime(0),
       tooYoung(0),
@@ -65,8 +72,17 @@ EPStats::EPStats()
       cursorMemoryFreed(0),
       pagerRuns(0),
       expiryPagerRuns(0),
+      pagerItemsVisited(0),
+      pagerItemsEvicted(0),
+      numProactiveEvictions(0),
+      evictedRefetched(0),
+      spillCacheWrites(0),
+      spillCacheBytesWritten(0),
+      spillCacheHits(0),
+      spillCacheMisses(0),
       freqDecayerRuns(0),
       itemsExpelledFromCheckpoints(0),
+      checkpointCompressedBytesSaved(0),
       itemsRemovedFromCheckpoints(0),
       numValueEjects(0),
       numFailedEjects(0),
@@ -81,8 +97,12 @@ EPStats::EPStats()
       pendingOpsMax(0),
       pendingOpsMaxDuration(0),
       pendingCompactions(0),
+      compactionThrottledTime(0),
+      compactionExpiryTime(0),
+      bfilterRebuilds(0),
       bg_fetched(0),
       bg_meta_fetched(0),
+      bg_fetch_coalesced(0),
       numRemainingBgItems(0),
       numRemainingBgJobs(0),
       bgNumOperations(0),
@@ -96,6 +116,9 @@ EPStats::EPStats()
       vbucketDelTotWalltime(0),
       replicationThrottleThreshold(0),
       numOpsStore(0),
+      numOpsArithmeticInPlace(0),
+      numOpsAppendPrependInPlace(0),
+      numOpsTouchCoalesced(0),
       numOpsDelete(0),
       numOpsGet(0),
       numOpsGetMeta(0),
@@ -109,6 +132,7 @@ EPStats::EPStats()
       alogRuns(0),
       accessScannerSkips(0),
       alogNumItems(0),
+      alogNumVbsReused(0),
       alogTime(0),
       alogRuntime(0),
       expPagerTime(0),
@@ -117,8 +141,18 @@ EPStats::EPStats()
       defragNumVisited(0),
       defragNumMoved(0),
       defragStoredValueNumMoved(0),
+      defragBytesMoved(0),
+      defragNumSkipped(0),
+      defragBytesReclaimed(0),
+      defragFragmentation(0),
+      defragIntensity(0),
       compressorNumVisited(0),
       compressorNumCompressed(0),
+      compressorNumSkippedHot(0),
+      compressorNumSkippedIncompressible(0),
+      dcpTransformedItemCacheHits(0),
+      dcpTransformedItemCacheMisses(0),
+      dcpCompressionNumSkipped(0),
       dirtyAgeHisto(),
       diskCommitHisto(),
       timingLog(NULL),
@@ -161,7 +195,9 @@ void EPStats::memAllocated(size_t sz) {
         return;
     }
 
-    auto& coreMemory = coreLocal.get()->totalMemory;
+    auto& core = *coreLocal.get();
+    core.domainMemory[size_t(ObjectRegistry::getMemoryDomain())].fetch_add(sz);
+    auto& coreMemory = core.totalMemory;
 
     // Update the coreMemory and also create a local copy of the old value + sz
     // This value will be used to check the threshold
@@ -179,7 +215,9 @@ void EPStats::memDeallocated(size_t sz) {
         return;
     }
 
-    auto& coreMemory = coreLocal.get()->totalMemory;
+    auto& core = *coreLocal.get();
+    core.domainMemory[size_t(ObjectRegistry::getMemoryDomain())].fetch_sub(sz);
+    auto& coreMemory = core.totalMemory;
 
     // Update the coreMemory and also create a local copy of the old value - sz
     // This value will be used to check the threshold
@@ -273,3 +311,11 @@ size_t EPStats::getNumItem() const {
     }
     return std::max(int64_t(0), result);
 }
+
+int64_t EPStats::getMemoryDomainUsed(MemoryDomain domain) const {
+    int64_t result = 0;
+    for (const auto& core : coreLocal) {
+        result += core->domainMemory[size_t(domain)];
+    }
+    return result;
+}
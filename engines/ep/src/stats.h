@@ -18,6 +18,7 @@
 #pragma once
 
 #include "hdrhistogram.h"
+#include "log_linear_histogram.h"
 #include "objectregistry.h"
 
 #include <folly/CachelinePadded.h>
@@ -28,6 +29,7 @@
 #include <relaxed_atomic.h>
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 
 class CoreLocalStats;
@@ -124,6 +126,13 @@ public:
     /// @returns number of Item objects which exist.
     size_t getNumItem() const;
 
+    /**
+     * @returns the memory tracked as allocated (less that freed) in the given
+     * domain; may be negative for a domain releasing objects it didn't
+     * allocate.
+     */
+    int64_t getMemoryDomainUsed(MemoryDomain domain) const;
+
     // account for allocated mem
     void memAllocated(size_t sz);
 
@@ -147,6 +156,9 @@ public:
 
     //! The replication throttle write queue cap
     std::atomic<ssize_t> replicationThrottleWriteQueueCap;
+    //! Number of DCP buffer acks the rate-based replication throttle
+    //! deferred or shortened.
+    Counter replicationThrottleDeferredAcks;
 
     //! Amount of items waiting for persistence
     cb::NonNegativeCounter<size_t> diskQueueSize;
@@ -156,6 +168,22 @@ public:
     Counter flusher_todo;
     //! Number of transaction commits.
     Counter flusherCommits;
+    //! Number of items written by transaction commits.
+    Counter flusherCommittedItems;
+    //! Number of times the flush of a vBucket was deferred to batch more
+    //! items into a single commit.
+    Counter flusherDeferrals;
+    //! Number of times the flush of a vBucket with hot keys was deferred to
+    //! de-duplicate more of their updates.
+    Counter flusherHotKeyDeferrals;
+    //! Number of mutations never written by the flusher as they were
+    //! superseded by a later mutation of the same key.
+    Counter flusherSupersededItems;
+    //! Number of vBucket state changes whose commit was deferred.
+    Counter flusherVBStateDeferrals;
+    //! Number of deferred vBucket states which were written by a later
+    //! flush of the vBucket rather than committed on their own.
+    Counter flusherVBStateFolded;
     //! Total time spent flushing.
     Counter cumulativeFlushTime;
     //! Total time spent committing.
@@ -227,10 +255,28 @@ public:
     Counter pagerRuns;
     //! Number of times the expiry pager runs for purging expired items
     Counter expiryPagerRuns;
+    //! Number of items the item pager visited (hash table items considered
+    //! for eviction)
+    Counter pagerItemsVisited;
+    //! Number of items the item pager evicted
+    Counter pagerItemsEvicted;
+    //! Number of items evicted by front-end writes (proactive eviction)
+    Counter numProactiveEvictions;
+    //! Number of BG fetches of keys the item pager had recently evicted
+    //! (see EvictionGhostList)
+    Counter evictedRefetched;
+    //! Number of values written to / bytes written to, hits in and misses in
+    //! the ValueSpillCache
+    Counter spillCacheWrites;
+    Counter spillCacheBytesWritten;
+    Counter spillCacheHits;
+    Counter spillCacheMisses;
     //! Number of times the item frequency decayer runs
     Counter freqDecayerRuns;
     //! The number items expelled from checkpoints
     Counter itemsExpelledFromCheckpoints;
+    //! Bytes saved by compressing values queued into checkpoints
+    Counter checkpointCompressedBytesSaved;
     //! Number of items removed from closed unreferenced checkpoints.
     Counter itemsRemovedFromCheckpoints;
     //! Number of times a value is ejected
@@ -271,11 +317,21 @@ public:
 
     //! Number of pending vbucket compaction requests
     Counter pendingCompactions;
+    //! Total time (in usec) compactions were delayed by CompactionThrottle
+    Counter compactionThrottledTime;
+    //! Total time (in usec) compactions spent expiring the items they found
+    //! expired
+    Counter compactionExpiryTime;
+    //! Number of vbucket bloom filters rebuilt from a key-only disk scan
+    Counter bfilterRebuilds;
 
     //! Number of times background fetches occurred.
     Counter bg_fetched;
     //! Number of times meta background fetches occurred.
     Counter bg_meta_fetched;
+    //! Number of background fetches which were satisfied by attaching to an
+    //! identical fetch already in flight, instead of issuing another read.
+    Counter bg_fetch_coalesced;
     //! Number of remaining bg fetch items
     Counter numRemainingBgItems;
     //! Number of remaining bg fetch jobs.
@@ -329,6 +385,15 @@ public:
 
     //! The number of basic store (add, set, arithmetic, touch, etc.) operations
     Counter numOpsStore;
+    //! The number of arithmetic operations performed in place (see
+    //! EngineIface::arithmetic); also counted by numOpsStore
+    Counter numOpsArithmeticInPlace;
+    //! The number of append and prepend operations performed in place (see
+    //! EngineIface::append_prepend); also counted by numOpsStore
+    Counter numOpsAppendPrependInPlace;
+    //! The number of touch operations which left the item as it was, as they
+    //! only extended its expiry time a little (see touch_coalesce_window)
+    Counter numOpsTouchCoalesced;
     //! The number of basic delete operations
     Counter numOpsDelete;
     //! The number of basic get operations
@@ -357,6 +422,9 @@ public:
     Counter accessScannerSkips;
     //! The number of items that last access scanner task swept to log
     Counter alogNumItems;
+    //! The number of vBuckets whose access log entries the access scanner
+    //! copied from the previous log rather than rescanning
+    Counter alogNumVbsReused;
     //! The next access scanner task schedule time (GMT)
     std::atomic<hrtime_t> alogTime;
     //! The number of seconds that the last access scanner task took
@@ -387,8 +455,44 @@ public:
      */
     Counter defragStoredValueNumMoved;
 
+    //! Bytes of the Blobs and StoredValues moved by the defragmenter task.
+    Counter defragBytesMoved;
+
+    /**
+     * The number of objects old enough to be moved by the defragmenter task
+     * but left in place as they live in a densely used slab.
+     */
+    Counter defragNumSkipped;
+
+    /**
+     * Estimate of the mapped bytes released by the defragmenter task (the
+     * drop in mapped bytes across each of its runs).
+     */
+    Counter defragBytesReclaimed;
+
+    //! The fragmentation the defragmenter task last measured (0-1)
+    std::atomic<double> defragFragmentation;
+
+    //! The effort (0-1) the defragmenter task's auto mode last chose
+    std::atomic<double> defragIntensity;
+
     Counter compressorNumVisited;
     Counter compressorNumCompressed;
+    //! Number of hot documents the item compressor left uncompressed.
+    Counter compressorNumSkippedHot;
+    //! Number of documents the item compressor didn't try to compress as
+    //! their collection's recent documents were incompressible.
+    Counter compressorNumSkippedIncompressible;
+
+    //! Number of DCP items which were found already transformed (for the
+    //! stream's features) in the vBucket's TransformedItemCache.
+    Counter dcpTransformedItemCacheHits;
+    //! Number of DCP items which had to be transformed, as they were not in
+    //! the vBucket's TransformedItemCache.
+    Counter dcpTransformedItemCacheMisses;
+    //! Number of DCP values streamed without trying to force compress them,
+    //! as their collection's recent values were incompressible.
+    Counter dcpCompressionNumSkipped;
 
     //! Histogram of queue processing dirty age.
     Hdr1sfMicroSecHistogram dirtyAgeHisto;
@@ -408,6 +512,12 @@ public:
      */
     Hdr1sfInt32Histogram getMultiBatchSizeHisto;
 
+    /**
+     * Histogram of the time (in seconds) between the item pager evicting
+     * an item and it being BG fetched back.
+     */
+    Hdr1sfInt32Histogram evictionRefetchIntervalHisto;
+
     /**
      * Histogram of frequency counts for items evicted from active or pending
      * vbuckets.
@@ -461,6 +571,14 @@ public:
     //! Histogram of wait_for_checkpoint_persistence command
     Hdr1sfMicroSecHistogram chkPersistenceHisto;
 
+    //! Histogram of the DCP takeover phases sending the remaining mutations
+    //! and the vbucket state, per vbucket (two per vbucket moved)
+    Hdr1sfMicroSecHistogram dcpTakeoverSendHisto;
+
+    //! Histogram of the DCP takeover phases waiting for the consumer to ack
+    //! the vbucket state, per vbucket (two per vbucket moved)
+    Hdr1sfMicroSecHistogram dcpTakeoverWaitHisto;
+
     //
     // DB timers.
     //
@@ -483,11 +601,13 @@ public:
     //! Historgram of batch reads
     Hdr1sfMicroSecHistogram getMultiHisto;
 
-    // ! Histograms of various task wait times, one per Task.
-    std::vector<Hdr1sfMicroSecHistogram> schedulingHisto;
+    // ! Histograms of various task wait times, one per Task. There are as
+    // ! many as there are task types (most of which rarely run, if ever), so
+    // ! these are the (sparse) LogLinear histograms.
+    std::vector<LogLinearMicroSecHistogram> schedulingHisto;
 
     // ! Histograms of various task run times, one per Task.
-    std::vector<Hdr1sfMicroSecHistogram> taskRuntimeHisto;
+    std::vector<LogLinearMicroSecHistogram> taskRuntimeHisto;
 
     //! Checkpoint Cursor histograms
     Hdr1sfMicroSecHistogram persistenceCursorGetItemsHisto;
@@ -505,13 +625,29 @@ public:
         cursorMemoryFreed.store(0);
         pagerRuns.store(0);
         expiryPagerRuns.store(0);
+        pagerItemsVisited.store(0);
+        pagerItemsEvicted.store(0);
+        numProactiveEvictions.store(0);
+        evictedRefetched.store(0);
+        spillCacheWrites.store(0);
+        spillCacheBytesWritten.store(0);
+        spillCacheHits.store(0);
+        spillCacheMisses.store(0);
         freqDecayerRuns.store(0);
         itemsExpelledFromCheckpoints.store(0);
+        checkpointCompressedBytesSaved.store(0);
         itemsRemovedFromCheckpoints.store(0);
         numValueEjects.store(0);
         numFailedEjects.store(0);
         numNotMyVBuckets.store(0);
+        numOpsArithmeticInPlace.store(0);
+        numOpsAppendPrependInPlace.store(0);
+        numOpsTouchCoalesced.store(0);
         bg_fetched.store(0);
+        compactionThrottledTime.store(0);
+        compactionExpiryTime.store(0);
+        replicationThrottleDeferredAcks.store(0);
+        bfilterRebuilds.store(0);
         bgNumOperations.store(0);
         bgWait.store(0);
         bgLoad.store(0);
@@ -530,11 +666,17 @@ public:
 
         alogRuns.store(0);
         accessScannerSkips.store(0),
+        alogNumVbsReused.store(0);
         defragNumVisited.store(0),
         defragNumMoved.store(0);
 
         compressorNumVisited.store(0);
         compressorNumCompressed.store(0);
+        compressorNumSkippedHot.store(0);
+        compressorNumSkippedIncompressible.store(0);
+        dcpTransformedItemCacheHits.store(0);
+        dcpTransformedItemCacheMisses.store(0);
+        dcpCompressionNumSkipped.store(0);
 
         pendingOpsHisto.reset();
         bgWaitHisto.reset();
@@ -553,6 +695,8 @@ public:
         notifyIOHisto.reset();
         getStatsCmdHisto.reset();
         chkPersistenceHisto.reset();
+        dcpTakeoverSendHisto.reset();
+        dcpTakeoverWaitHisto.reset();
         diskInsertHisto.reset();
         diskUpdateHisto.reset();
         diskDelHisto.reset();
@@ -560,6 +704,7 @@ public:
         diskCommitHisto.reset();
         itemAllocSizeHisto.reset();
         getMultiBatchSizeHisto.reset();
+        evictionRefetchIntervalHisto.reset();
         dirtyAgeHisto.reset();
         getMultiHisto.reset();
         persistenceCursorGetItemsHisto.reset();
@@ -574,13 +719,12 @@ public:
     size_t getMemFootPrint() const {
         size_t taskHistogramSizes = 0;
 
-        if (!schedulingHisto.empty()) {
-            taskHistogramSizes += schedulingHisto.size() *
-                                  schedulingHisto[0].getMemFootPrint();
+        // The size of each depends on the values it has recorded
+        for (const auto& histo : schedulingHisto) {
+            taskHistogramSizes += histo.getMemFootPrint();
         }
-        if (!taskRuntimeHisto.empty()) {
-            taskHistogramSizes += taskRuntimeHisto.size() *
-                                  taskRuntimeHisto[0].getMemFootPrint();
+        for (const auto& histo : taskRuntimeHisto) {
+            taskHistogramSizes += histo.getMemFootPrint();
         }
 
         return pendingOpsHisto.getMemFootPrint() +
@@ -598,6 +742,8 @@ public:
                notifyIOHisto.getMemFootPrint() +
                getStatsCmdHisto.getMemFootPrint() +
                chkPersistenceHisto.getMemFootPrint() +
+               dcpTakeoverSendHisto.getMemFootPrint() +
+               dcpTakeoverWaitHisto.getMemFootPrint() +
                diskInsertHisto.getMemFootPrint() +
                diskUpdateHisto.getMemFootPrint() +
                diskDelHisto.getMemFootPrint() +
@@ -605,6 +751,7 @@ public:
                diskCommitHisto.getMemFootPrint() +
                itemAllocSizeHisto.getMemFootPrint() +
                getMultiBatchSizeHisto.getMemFootPrint() +
+               evictionRefetchIntervalHisto.getMemFootPrint() +
                dirtyAgeHisto.getMemFootPrint() +
                getMultiHisto.getMemFootPrint() +
                persistenceCursorGetItemsHisto.getMemFootPrint() +
@@ -696,6 +843,9 @@ public:
 
     //! Total number of Item objects
     Counter numItem;
+
+    //! The memory tracked as allocated (less that freed) in each domain
+    std::array<Counter, size_t(MemoryDomain::Count)> domainMemory{};
 };
 
 /**
@@ -18,6 +18,7 @@
 #pragma once
 
 #include "hdrhistogram.h"
+#include "log_linear_histogram.h"
 
 #include <boost/optional.hpp>
 #include <memcached/engine_common.h>
@@ -131,6 +132,25 @@ inline void add_casted_stat(const char* k,
     add_casted_histo_stat<HdrUint8Histogram>(k, v, add_stat, cookie);
 }
 
+inline void add_casted_stat(const char* k,
+                            const LogLinearHistogram& v,
+                            const AddStatFn& add_stat,
+                            const void* cookie) {
+    if (v.getValueCount() > 0) {
+        std::string meanKey(k);
+        meanKey += "_mean";
+        add_casted_stat(
+                meanKey.c_str(), std::round(v.getMean()), add_stat, cookie);
+
+        v.forEachBucket([k, &add_stat, cookie](
+                                uint64_t low, uint64_t high, uint64_t count) {
+            std::string newKey(k);
+            newKey += "_" + std::to_string(low) + "," + std::to_string(high);
+            add_casted_stat(newKey.c_str(), count, add_stat, cookie);
+        });
+    }
+}
+
 /// @cond DETAILS
 /**
  * Convert a histogram into a bunch of calls to add stats.
@@ -19,12 +19,16 @@
 
 #include "ep_time.h"
 #include "item.h"
+#include "key_prefix_dictionary.h"
 #include "objectregistry.h"
 #include "stats.h"
+#include "stored_value_arena.h"
 
 #include <platform/cb_malloc.h>
 #include <platform/compress.h>
 
+#include <cstring>
+
 const int64_t StoredValue::state_pending_seqno = -2;
 const int64_t StoredValue::state_deleted_key = -3;
 const int64_t StoredValue::state_non_existent_key = -4;
@@ -33,7 +37,8 @@ const int64_t StoredValue::state_temp_init = -5;
 StoredValue::StoredValue(const Item& itm,
                          UniquePtr n,
                          EPStats& stats,
-                         bool isOrdered)
+                         bool isOrdered,
+                         uint16_t keyPrefix)
     : value(itm.getValue()),
       chain_next_or_replacement(std::move(n)),
       cas(itm.getCas()),
@@ -44,7 +49,11 @@ StoredValue::StoredValue(const Item& itm,
       revSeqno(itm.getRevSeqno()),
       datatype(itm.getDataType()),
       deletionSource(0),
-      committed(static_cast<uint8_t>(CommittedState::CommittedViaMutation)) {
+      committed(static_cast<uint8_t>(CommittedState::CommittedViaMutation)),
+      arenaAllocated(0),
+      inlineValueCapacity(0),
+      keyPrefixed(keyPrefix != 0),
+      keyHashTag(0) {
     // Initialise bit fields
     setDeletedPriv(itm.isDeleted());
     setNewCacheItem(true);
@@ -58,7 +67,22 @@ StoredValue::StoredValue(const Item& itm,
 
     // Placement-new the key which lives in memory directly after this
     // object.
-    new (key()) SerialisedDocKey(itm.getKey());
+    if (keyPrefix) {
+        // Store the prefix ID (little-endian) followed by the rest of the key
+        const DocKey itmKey = itm.getKey();
+        const auto prefixLen =
+                KeyPrefixDictionary::get().getPrefix(keyPrefix).size();
+        std::array<uint8_t, 255> stored;
+        stored[0] = uint8_t(keyPrefix);
+        stored[1] = uint8_t(keyPrefix >> 8);
+        std::copy(itmKey.data() + prefixLen,
+                  itmKey.data() + itmKey.size(),
+                  stored.begin() + KeyPrefixDictionary::IdSize);
+        new (key()) SerialisedDocKey(cb::const_byte_buffer{
+                stored.data(), getStoredKeyLength(itmKey, keyPrefix)});
+    } else {
+        new (key()) SerialisedDocKey(itm.getKey());
+    }
 
     if (isTempInitialItem()) {
         markClean();
@@ -90,7 +114,11 @@ StoredValue::StoredValue(const StoredValue& other, UniquePtr n, EPStats& stats)
       exptime(other.exptime),
       flags(other.flags),
       revSeqno(other.revSeqno),
-      datatype(other.datatype) {
+      datatype(other.datatype),
+      arenaAllocated(0),
+      inlineValueCapacity(0),
+      keyPrefixed(other.keyPrefixed),
+      keyHashTag(other.keyHashTag) {
     setDirty(other.isDirty());
     setDeletedPriv(other.isDeleted());
     setNewCacheItem(other.isNewCacheItem());
@@ -101,9 +129,10 @@ StoredValue::StoredValue(const StoredValue& other, UniquePtr n, EPStats& stats)
     setCommitted(other.getCommitted());
     setAge(0);
     // Placement-new the key which lives in memory directly after this
-    // object.
-    StoredDocKey sKey(other.getKey());
-    new (key()) SerialisedDocKey(sKey);
+    // object - a copy of the other's key as stored (prefixed or not).
+    const auto& otherKey = other.getSerialisedKey();
+    new (key()) SerialisedDocKey(
+            cb::const_byte_buffer{otherKey.data(), otherKey.size()});
 
     if (isDeleted()) {
         setDeletionSource(other.getDeletionSource());
@@ -167,7 +196,7 @@ void StoredValue::restoreValue(const Item& itm) {
     auto freq = itm.getFreqCounterValue();
     auto age = getAge();
 
-    value = itm.getValue();
+    assignValue(itm.getValue());
 
     setFreqCounterValue(freq);
     setCommitted(itm.getCommitted());
@@ -216,8 +245,63 @@ bool StoredValue::del(DeleteSource delSource) {
     }
 }
 
-size_t StoredValue::getRequiredStorage(const DocKey& key) {
-    return sizeof(StoredValue) + SerialisedDocKey::getObjectSize(key.size());
+size_t StoredValue::getRequiredStorage(const DocKey& key, uint16_t keyPrefix) {
+    return sizeof(StoredValue) +
+           SerialisedDocKey::getObjectSize(
+                   getStoredKeyLength(key, keyPrefix));
+}
+
+size_t StoredValue::getStoredKeyLength(const DocKey& key, uint16_t keyPrefix) {
+    if (keyPrefix == 0) {
+        return key.size();
+    }
+    return key.size() -
+           KeyPrefixDictionary::get().getPrefix(keyPrefix).size() +
+           KeyPrefixDictionary::IdSize;
+}
+
+StoredValueKey StoredValue::makePrefixedKey() const {
+    const auto& stored = getSerialisedKey();
+    return {KeyPrefixDictionary::get().getPrefix(getKeyPrefixId()),
+            {stored.data() + KeyPrefixDictionary::IdSize,
+             stored.size() - KeyPrefixDictionary::IdSize}};
+}
+
+bool StoredValue::hasPrefixedKey(const DocKey& k) const {
+    if (k.getEncoding() != DocKeyEncodesCollectionId::Yes) {
+        return getKey() == k;
+    }
+    // Compare the two parts of the key in place, without rebuilding it
+    const auto& stored = getSerialisedKey();
+    const auto prefix = KeyPrefixDictionary::get().getPrefix(getKeyPrefixId());
+    const auto suffixLen = stored.size() - KeyPrefixDictionary::IdSize;
+    return k.size() == prefix.size() + suffixLen &&
+           std::memcmp(k.data(), prefix.data(), prefix.size()) == 0 &&
+           std::memcmp(k.data() + prefix.size(),
+                       stored.data() + KeyPrefixDictionary::IdSize,
+                       suffixLen) == 0;
+}
+
+StoredValueKey::StoredValueKey(cb::const_byte_buffer prefix,
+                               cb::const_byte_buffer suffix)
+    : length(prefix.size() + suffix.size()) {
+    std::copy(prefix.begin(), prefix.end(), owned.begin());
+    std::copy(suffix.begin(), suffix.end(), owned.begin() + prefix.size());
+}
+
+bool StoredValueKey::operator==(const DocKey& rhs) const {
+    // As SerialisedDocKey::operator==
+    if (rhs.getEncoding() == DocKeyEncodesCollectionId::Yes) {
+        return size() == rhs.size() &&
+               std::memcmp(data(), rhs.data(), size()) == 0;
+    }
+    return size() == rhs.size() + 1 &&
+           data()[0] == DefaultCollectionLeb128Encoded &&
+           std::memcmp(data() + 1, rhs.data(), rhs.size()) == 0;
+}
+
+std::ostream& operator<<(std::ostream& os, const StoredValueKey& key) {
+    return os << StoredDocKey(DocKey(key));
 }
 
 std::unique_ptr<Item> StoredValue::toItem(
@@ -263,7 +347,66 @@ void StoredValue::reallocate() {
     replaceValue(std::unique_ptr<Blob>{Blob::Copy(*value)});
 }
 
+void StoredValue::initInlineValue(size_t capacity) {
+    inlineValueCapacity = capacity / InlineValueGranularity;
+    const auto offset = getInlineValueOffset(getObjectSize());
+    Blob::NewInline(
+            reinterpret_cast<char*>(this) + offset, offset, nullptr, 0);
+    const value_t current = value;
+    assignValue(current);
+}
+
+Blob* StoredValue::getInlineValue() {
+    if (inlineValueCapacity == 0) {
+        return nullptr;
+    }
+    return reinterpret_cast<Blob*>(reinterpret_cast<char*>(this) +
+                                   getInlineValueOffset(getObjectSize()));
+}
+
+void StoredValue::assignValue(const value_t& newValue) {
+    Blob* inlineValue = getInlineValue();
+    if (inlineValue == nullptr || !newValue ||
+        newValue.get().get() == inlineValue ||
+        newValue->valueSize() > getInlineValueCapacity()) {
+        replaceValue(newValue);
+        return;
+    }
+
+    // Maintain the tag
+    auto tag = getValueTag();
+    if (value.get().get() == inlineValue) {
+        // Drop our reference, so the inline Blob may be reused unless an
+        // Item still shares the current value.
+        value.reset();
+    }
+    if (inlineValue->isInlineUnused()) {
+        inlineValue->reuseInline(newValue->getData(), newValue->valueSize());
+        value.reset(TaggedPtr<Blob>(inlineValue));
+    } else {
+        value = newValue;
+    }
+    setValueTag(tag);
+}
+
 void StoredValue::Deleter::operator()(StoredValue* val) {
+    MemoryDomainGuard guard(MemoryDomain::HashTable);
+    if (val->isArenaAllocated() || val->inlineValueCapacity != 0) {
+        Blob* inlineValue = val->getInlineValue();
+        if (val->isOrdered()) {
+            static_cast<OrderedStoredValue*>(val)->~OrderedStoredValue();
+        } else {
+            val->~StoredValue();
+        }
+        if (inlineValue) {
+            // The storage is freed along with the inline value, once no
+            // Item references it either.
+            Blob::releaseInline(inlineValue);
+        } else {
+            StoredValueArena::deallocate(val);
+        }
+        return;
+    }
     if (val->isOrdered()) {
         delete static_cast<OrderedStoredValue*>(val);
     } else {
@@ -378,7 +521,7 @@ void StoredValue::setValueImpl(const Item& itm) {
         setResident(false);
     } else {
         setResident(true);
-        replaceValue(itm.getValue().get());
+        assignValue(itm.getValue());
     }
     setCommitted(itm.getCommitted());
 }
@@ -417,7 +560,8 @@ void StoredValue::storeCompressedBuffer(cb::const_char_buffer deflated) {
 /**
  * Get an item_info from the StoredValue
  */
-boost::optional<item_info> StoredValue::getItemInfo(uint64_t vbuuid) const {
+boost::optional<item_info> StoredValue::getItemInfo(
+        uint64_t vbuuid, const StoredValueKey& key) const {
     if (isTempItem()) {
         return boost::none;
     }
@@ -436,7 +580,7 @@ boost::optional<item_info> StoredValue::getItemInfo(uint64_t vbuuid) const {
         info.value[0].iov_base = const_cast<char*>(getValue()->getData());
         info.value[0].iov_len = getValue()->valueSize();
     }
-    info.key = getKey();
+    info.key = key;
     return info;
 }
 
@@ -540,8 +684,12 @@ bool OrderedStoredValue::operator==(const OrderedStoredValue& other) const {
     return StoredValue::operator==(other);
 }
 
-size_t OrderedStoredValue::getRequiredStorage(const DocKey& key) {
-    return sizeof(OrderedStoredValue) + SerialisedDocKey::getObjectSize(key);
+size_t OrderedStoredValue::getRequiredStorage(const DocKey& key,
+                                              uint16_t keyPrefix) {
+    // The same key storage, after the larger fixed part
+    return sizeof(OrderedStoredValue) +
+           StoredValue::getRequiredStorage(key, keyPrefix) -
+           sizeof(StoredValue);
 }
 
 /**
@@ -32,9 +32,64 @@
 #include <memcached/durability_spec.h>
 #include <relaxed_atomic.h>
 
+#include <algorithm>
+#include <array>
+
 class Item;
 class OrderedStoredValue;
 
+/**
+ * The key of a StoredValue, as returned by StoredValue::getKey(): a view of
+ * the key stored in the StoredValue or, for a prefixed key (see
+ * StoredValue::isKeyPrefixed), a copy of the whole key rebuilt from its
+ * prefix.
+ */
+class StoredValueKey : public DocKeyInterface<StoredValueKey> {
+public:
+    /// View the given key
+    explicit StoredValueKey(const SerialisedDocKey& key)
+        : view(key.data()), length(key.size()) {
+    }
+
+    /// Build the key from its prefix and the rest of it
+    StoredValueKey(cb::const_byte_buffer prefix, cb::const_byte_buffer suffix);
+
+    const uint8_t* data() const {
+        return view ? view : owned.data();
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    CollectionID getCollectionID() const {
+        return DocKey(*this).getCollectionID();
+    }
+
+    DocKeyEncodesCollectionId getEncoding() const {
+        return DocKeyEncodesCollectionId::Yes;
+    }
+
+    operator DocKey() const {
+        return {data(), size(), DocKeyEncodesCollectionId::Yes};
+    }
+
+    bool operator==(const DocKey& rhs) const;
+
+    bool operator!=(const DocKey& rhs) const {
+        return !(*this == rhs);
+    }
+
+private:
+    /// The key viewed, or nullptr if it's in owned
+    const uint8_t* view = nullptr;
+    size_t length = 0;
+    /// A rebuilt key (which, as stored, is at most 255 bytes)
+    std::array<uint8_t, 255> owned;
+};
+
+std::ostream& operator<<(std::ostream& os, const StoredValueKey& key);
+
 /**
  * In-memory storage for an item.
  *
@@ -272,15 +327,84 @@ public:
      * @return true if this item's key is equal to k
      */
     bool hasKey(const DocKey& k) const {
-        return getKey() == k;
+        if (keyPrefixed) {
+            return hasPrefixedKey(k);
+        }
+        return getSerialisedKey() == k;
     }
 
     /**
-     * Get this item's key.
+     * Get the key hash tag of this item - a fragment of the owning
+     * HashTable's hash of the key, used to skip full key comparisons when
+     * walking a hash chain. Zero until set by the HashTable.
      */
-    const SerialisedDocKey& getKey() const {
-        return *const_cast<const SerialisedDocKey*>(
-                const_cast<StoredValue&>(*this).key());
+    uint16_t getKeyHashTag() const {
+        return keyHashTag;
+    }
+
+    /// Set the key hash tag of this item. See getKeyHashTag().
+    void setKeyHashTag(uint16_t tag) {
+        keyHashTag = tag;
+    }
+
+    /// @return true if this object was allocated from a StoredValueArena.
+    bool isArenaAllocated() const {
+        return arenaAllocated;
+    }
+
+    /// The largest value which may be stored inline (see initInlineValue)
+    static const size_t MaxInlineValueSize = 32;
+
+    /// The inline value capacity is a multiple of this many bytes
+    static const size_t InlineValueGranularity = 8;
+
+    /**
+     * @return the capacity of the inline value storage to create for a value
+     *         of the given size, or 0 if it is too large to be stored inline
+     */
+    static size_t getInlineValueCapacityFor(size_t valueSize) {
+        if (valueSize > MaxInlineValueSize) {
+            return 0;
+        }
+        const size_t units = (valueSize + InlineValueGranularity - 1) /
+                             InlineValueGranularity;
+        return std::max(units, size_t(1)) * InlineValueGranularity;
+    }
+
+    /**
+     * @return the bytes required for an object of the given size (see
+     *         getRequiredStorage) followed by inline value storage of the
+     *         given capacity
+     */
+    static size_t getInlineValueStorage(size_t objectSize, size_t capacity) {
+        return getInlineValueOffset(objectSize) +
+               Blob::getAllocationSize(capacity);
+    }
+
+    /// @return the capacity of this object's inline value storage, or 0 if
+    ///         it has none
+    size_t getInlineValueCapacity() const {
+        return inlineValueCapacity * InlineValueGranularity;
+    }
+
+    /**
+     * Get this item's key - a view of the key held by this object, unless it
+     * is prefixed (see isKeyPrefixed) in which case the whole key is rebuilt.
+     */
+    StoredValueKey getKey() const {
+        if (keyPrefixed) {
+            return makePrefixedKey();
+        }
+        return StoredValueKey(getSerialisedKey());
+    }
+
+    /**
+     * @return true if this object stores the prefix of its key as the ID of
+     *         the prefix in the KeyPrefixDictionary, instead of the prefix
+     *         itself.
+     */
+    bool isKeyPrefixed() const {
+        return keyPrefixed;
     }
 
     /**
@@ -680,12 +804,15 @@ public:
      * Get an item_info from the StoredValue
      *
      * @param vbuuid a VB UUID to set in to the item_info
+     * @param key this object's key (from getKey()), which the item_info views
+     *        so it must outlive the item_info
      * @returns item_info populated with the StoredValue's state if the
      *                    StoredValue is not a temporary item (!::isTempItem()).
      *                    If the object is a temporary item the optional is not
      *                    initialised.
      */
-    boost::optional<item_info> getItemInfo(uint64_t vbuuid) const;
+    boost::optional<item_info> getItemInfo(uint64_t vbuuid,
+                                           const StoredValueKey& key) const;
 
     void setNext(UniquePtr&& nextSv) {
         if (isStalePriv()) {
@@ -780,8 +907,20 @@ public:
 
     bool operator!=(const StoredValue& other) const;
 
-    /// Return how many bytes are need to store item given key as a StoredValue
-    static size_t getRequiredStorage(const DocKey& key);
+    /**
+     * Return how many bytes are need to store item given key as a StoredValue
+     *
+     * @param keyPrefix the ID in the KeyPrefixDictionary of the key's prefix
+     *        to store instead of the prefix, or 0 to store the whole key
+     */
+    static size_t getRequiredStorage(const DocKey& key,
+                                     uint16_t keyPrefix = 0);
+
+    /**
+     * @return the length of the given key as stored by a StoredValue, with
+     *         its prefix replaced by the given prefix ID (unless 0)
+     */
+    static size_t getStoredKeyLength(const DocKey& key, uint16_t keyPrefix);
 
     /**
      * @return the deletion source of the stored value
@@ -830,11 +969,14 @@ protected:
      *           which the new item is being inserted).
      * @param stats EPStats to update for this new StoredValue
      * @param isOrdered Are we constructing an OrderedStoredValue?
+     * @param keyPrefix the ID of the key's prefix to store in place of the
+     *        prefix (see getRequiredStorage), or 0
      */
     StoredValue(const Item& itm,
                 UniquePtr n,
                 EPStats& stats,
-                bool isOrdered);
+                bool isOrdered,
+                uint16_t keyPrefix = 0);
 
     // Destructor. protected, as needs to be carefully deleted (via
     // StoredValue::Destructor) depending on the value of isOrdered flag.
@@ -932,6 +1074,59 @@ protected:
         deletionSource = static_cast<uint8_t>(delSource);
     }
 
+    /// Record that this object's storage came from a StoredValueArena, so
+    /// the Deleter returns it there.
+    void setArenaAllocated() {
+        arenaAllocated = 1;
+    }
+
+    /**
+     * Create the inline value storage of this object: a Blob of the given
+     * capacity following the key (at getInlineValueOffset), so the object
+     * must have been allocated with getInlineValueStorage() bytes. The value
+     * is moved there if it fits.
+     *
+     * While a value which fits is stored in the inline Blob (instead of a
+     * separate allocation) it's shared with Items like any other - the
+     * inline Blob holds a reference for this object, and the object's
+     * storage is only freed once nothing references the Blob.
+     */
+    void initInlineValue(size_t capacity);
+
+    /// @return the inline value storage of this object, or nullptr if none
+    Blob* getInlineValue();
+
+    /**
+     * Replace the value with the given one - copied into the inline value
+     * storage if it fits and the inline Blob isn't shared with any Item,
+     * otherwise shared. Maintains the tag.
+     */
+    void assignValue(const value_t& newValue);
+
+    /// @return the key as stored in this object
+    const SerialisedDocKey& getSerialisedKey() const {
+        return *const_cast<const SerialisedDocKey*>(
+                const_cast<StoredValue&>(*this).key());
+    }
+
+    /// @return the ID of the key's prefix, for a prefixed key
+    uint16_t getKeyPrefixId() const {
+        const auto* bytes = getSerialisedKey().data();
+        return uint16_t(bytes[0]) | uint16_t(bytes[1] << 8);
+    }
+
+    /// @return the whole key of a prefixed key
+    StoredValueKey makePrefixedKey() const;
+
+    /// hasKey() for a prefixed key
+    bool hasPrefixedKey(const DocKey& k) const;
+
+    /// @return the offset of the inline value storage of an object of the
+    ///         given size (getObjectSize)
+    static size_t getInlineValueOffset(size_t objectSize) {
+        return (objectSize + alignof(Blob) - 1) & ~(alignof(Blob) - 1);
+    }
+
     friend class StoredValueFactory;
 
     /**
@@ -1024,6 +1219,18 @@ protected:
     uint8_t deletionSource : 1;
     /// 2-bit value which encodes the CommittedState of the StoredValue
     uint8_t committed : 2;
+    /// True if allocated from a StoredValueArena (see isArenaAllocated).
+    uint8_t arenaAllocated : 1;
+    /// Capacity of the inline value storage, in InlineValueGranularity
+    /// units (0 if there is none). See initInlineValue.
+    uint8_t inlineValueCapacity : 3;
+    /// True if the key is stored with its prefix replaced by the ID of the
+    /// prefix (see isKeyPrefixed).
+    uint8_t keyPrefixed : 1;
+
+    /// Fragment of the key's hash (see getKeyHashTag). Occupies what would
+    /// otherwise be tail padding, so does not increase sizeof(StoredValue).
+    uint16_t keyHashTag;
 
     friend std::ostream& operator<<(std::ostream& os, const StoredValue& sv);
 };
@@ -1099,8 +1306,9 @@ public:
     bool operator==(const OrderedStoredValue& other) const;
 
     /// Return how many bytes are need to store item with given key as an
-    /// OrderedStoredValue
-    static size_t getRequiredStorage(const DocKey& key);
+    /// OrderedStoredValue (see StoredValue::getRequiredStorage)
+    static size_t getRequiredStorage(const DocKey& key,
+                                     uint16_t keyPrefix = 0);
 
     /**
      * C++14 will call the sized delete version, but we
@@ -1141,8 +1349,10 @@ private:
     // OrderedStoredValueFactory.
     OrderedStoredValue(const Item& itm,
                        UniquePtr n,
-                       EPStats& stats)
-        : StoredValue(itm, std::move(n), stats, /*isOrdered*/ true) {
+                       EPStats& stats,
+                       uint16_t keyPrefix = 0)
+        : StoredValue(
+                  itm, std::move(n), stats, /*isOrdered*/ true, keyPrefix) {
     }
 
     // Copy Constructor. Private, as needs to be carefully created via
@@ -1184,7 +1394,8 @@ size_t StoredValue::getObjectSize() const {
     // Size of fixed part of OrderedStoredValue or StoredValue, plus size of
     // (variable) key.
     if (isOrdered()) {
-        return sizeof(OrderedStoredValue) + getKey().getObjectSize();
+        return sizeof(OrderedStoredValue) +
+               getSerialisedKey().getObjectSize();
     }
-    return sizeof(*this) + getKey().getObjectSize();
+    return sizeof(*this) + getSerialisedKey().getObjectSize();
 }
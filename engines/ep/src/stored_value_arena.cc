@@ -0,0 +1,150 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "stored_value_arena.h"
+
+#include <cstdint>
+#include <new>
+
+/// Free objects are linked through their own storage.
+struct StoredValueArena::FreeObject {
+    FreeObject* next;
+};
+
+/// Reserved at the start of each page for the back-pointer to the Slab; kept
+/// at 16 bytes so objects remain 16-byte aligned.
+static constexpr size_t PageHeaderSize = 16;
+
+StoredValueArena::Slab::Slab(SizeClass& sizeClass, size_t objectSize)
+    : sizeClass(sizeClass),
+      memory(static_cast<char*>(::operator new(SlabSize))) {
+    // Carve the slab into pages, each headed by a pointer back to this Slab.
+    // Objects never straddle a page boundary so the owning page (and hence
+    // Slab) can be found by masking the object address. The underlying
+    // allocator normally returns page-aligned memory for this size; if not
+    // the partial pages at either end are unused.
+    const auto base = reinterpret_cast<uintptr_t>(memory);
+    const auto end = base + SlabSize;
+    auto page = (base + PageSize - 1) & ~uintptr_t(PageSize - 1);
+    for (; page + PageSize <= end; page += PageSize) {
+        *reinterpret_cast<Slab**>(page) = this;
+        const auto pageEnd = page + PageSize;
+        for (auto obj = page + PageHeaderSize; obj + objectSize <= pageEnd;
+             obj += objectSize) {
+            auto* freeObj = new (reinterpret_cast<void*>(obj)) FreeObject;
+            freeObj->next = freeList;
+            freeList = freeObj;
+            ++capacity;
+        }
+    }
+}
+
+StoredValueArena::Slab::~Slab() {
+    ::operator delete(memory);
+}
+
+StoredValueArena::StoredValueArena() {
+    for (size_t ii = 0; ii < NumSizeClasses; ++ii) {
+        sizeClasses[ii].arena = this;
+        sizeClasses[ii].objectSize = (ii + 1) * SizeClassGranularity;
+    }
+}
+
+StoredValueArena::~StoredValueArena() {
+    for (auto& sizeClass : sizeClasses) {
+        sizeClass.current = nullptr;
+        sizeClass.partial.clear();
+        sizeClass.slabs.clear_and_dispose([](Slab* slab) { delete slab; });
+    }
+}
+
+void* StoredValueArena::allocate(size_t size) {
+    if (size > MaxObjectSize) {
+        return nullptr;
+    }
+    auto& sizeClass =
+            sizeClasses[size == 0 ? 0 : (size - 1) / SizeClassGranularity];
+
+    std::lock_guard<std::mutex> lh(sizeClass.mutex);
+    auto* slab = sizeClass.current;
+    if (!slab || !slab->freeList) {
+        // Current slab is full; switch to the most used slab which has
+        // space, so sparse slabs drain and can be released.
+        slab = nullptr;
+        for (auto& candidate : sizeClass.partial) {
+            if (!slab || candidate.used > slab->used) {
+                slab = &candidate;
+            }
+        }
+        if (!slab) {
+            slab = new Slab(sizeClass, sizeClass.objectSize);
+            sizeClass.slabs.push_back(*slab);
+            sizeClass.partial.push_back(*slab);
+            ++numSlabs;
+        }
+        sizeClass.current = slab;
+    }
+
+    auto* obj = slab->freeList;
+    slab->freeList = obj->next;
+    ++slab->used;
+    if (!slab->freeList) {
+        sizeClass.partial.erase(sizeClass.partial.iterator_to(*slab));
+    }
+    ++numObjects;
+    return obj;
+}
+
+void StoredValueArena::deallocate(void* ptr) {
+    auto& slab = slabFor(ptr);
+    auto& sizeClass = slab.sizeClass;
+    auto* arena = sizeClass.arena;
+    {
+        std::lock_guard<std::mutex> lh(sizeClass.mutex);
+        const bool wasFull = !slab.freeList;
+        auto* obj = new (ptr) FreeObject;
+        obj->next = slab.freeList;
+        slab.freeList = obj;
+        --slab.used;
+        if (wasFull) {
+            sizeClass.partial.push_back(slab);
+        }
+
+        // Return empty slabs to the underlying allocator, other than the
+        // current one (avoids repeatedly allocating / freeing a slab when a
+        // single object is added and removed).
+        if (slab.used == 0 && &slab != sizeClass.current) {
+            sizeClass.partial.erase(sizeClass.partial.iterator_to(slab));
+            sizeClass.slabs.erase(sizeClass.slabs.iterator_to(slab));
+            delete &slab;
+            --arena->numSlabs;
+        }
+    }
+    --arena->numObjects;
+}
+
+bool StoredValueArena::isFragmented(const void* ptr) {
+    auto& slab = slabFor(ptr);
+    std::lock_guard<std::mutex> lh(slab.sizeClass.mutex);
+    return &slab != slab.sizeClass.current && slab.used * 2 < slab.capacity;
+}
+
+StoredValueArena::Slab& StoredValueArena::slabFor(const void* ptr) {
+    const auto page =
+            reinterpret_cast<uintptr_t>(ptr) & ~uintptr_t(PageSize - 1);
+    return **reinterpret_cast<Slab* const*>(page);
+}
@@ -0,0 +1,152 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <boost/intrusive/list.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+
+/**
+ * Size-class slab allocator for StoredValue objects, owned by a
+ * StoredValueFactory (and hence by a single vBucket's HashTable).
+ *
+ * Objects are rounded up to a multiple of SizeClassGranularity and carved
+ * from SlabSize chunks dedicated to that size class. Keeping all of a
+ * vBucket's StoredValues together (instead of interleaved with every other
+ * allocation of the process) limits the fragmentation caused by those
+ * objects; when all objects of a slab have been freed the slab itself is
+ * returned to the underlying allocator.
+ *
+ * Each page of a slab starts with a pointer back to its Slab, so
+ * deallocate() can locate the owning slab (and arena) from just the object
+ * address - no per-object header is needed.
+ *
+ * Allocation prefers the most densely used slab with free space, so
+ * relocating objects out of sparse slabs (see isFragmented()) - as
+ * DefragmentVisitor does - drains them until they can be released.
+ *
+ * Thread-safe; each size class is guarded by its own mutex. The arena must
+ * outlive all objects allocated from it.
+ */
+class StoredValueArena {
+public:
+    /// Size of each slab requested from the underlying allocator.
+    static constexpr size_t SlabSize = 64 * 1024;
+    /// Granularity of the back-pointer to the owning slab.
+    static constexpr size_t PageSize = 4096;
+    /// Object sizes are rounded up to a multiple of this.
+    static constexpr size_t SizeClassGranularity = 16;
+    /// Largest object size served from the arena.
+    static constexpr size_t MaxObjectSize = 512;
+
+    StoredValueArena();
+
+    ~StoredValueArena();
+
+    StoredValueArena(const StoredValueArena&) = delete;
+    StoredValueArena& operator=(const StoredValueArena&) = delete;
+
+    /**
+     * Allocate memory for an object of the given size.
+     *
+     * @return pointer to the allocated memory, or nullptr if size is larger
+     *         than MaxObjectSize (the caller should use the general purpose
+     *         allocator instead).
+     */
+    void* allocate(size_t size);
+
+    /**
+     * Free memory previously returned from allocate() of any arena.
+     */
+    static void deallocate(void* ptr);
+
+    /**
+     * @return true if the given object (allocated from an arena) lives in a
+     * slab which is less than half used, i.e. relocating the object would
+     * help return that slab to the underlying allocator.
+     */
+    static bool isFragmented(const void* ptr);
+
+    /// @return the number of slabs currently allocated.
+    size_t getNumSlabs() const {
+        return numSlabs;
+    }
+
+    /// @return the number of objects currently allocated.
+    size_t getNumObjects() const {
+        return numObjects;
+    }
+
+private:
+    struct SizeClass;
+    struct FreeObject;
+
+    using SlabHook = boost::intrusive::list_member_hook<>;
+
+    struct Slab {
+        Slab(SizeClass& sizeClass, size_t objectSize);
+        ~Slab();
+
+        SizeClass& sizeClass;
+        /// Memory obtained from the underlying allocator.
+        char* const memory;
+        /// Singly-linked list of free objects within this slab.
+        FreeObject* freeList = nullptr;
+        /// Number of objects handed out from this slab.
+        size_t used = 0;
+        /// Total number of objects this slab can hold.
+        size_t capacity = 0;
+
+        /// Links this slab into its SizeClass' list of all slabs.
+        SlabHook allHook;
+        /// Links this slab into its SizeClass' list of slabs with space.
+        SlabHook partialHook;
+    };
+
+    using SlabList = boost::intrusive::list<
+            Slab,
+            boost::intrusive::member_hook<Slab, SlabHook, &Slab::allHook>>;
+    using PartialSlabList = boost::intrusive::list<
+            Slab,
+            boost::intrusive::member_hook<Slab, SlabHook, &Slab::partialHook>>;
+
+    struct SizeClass {
+        StoredValueArena* arena = nullptr;
+        size_t objectSize = 0;
+
+        std::mutex mutex;
+        SlabList slabs;
+        PartialSlabList partial;
+        /// Slab objects are currently being allocated from.
+        Slab* current = nullptr;
+    };
+
+    /// @return the Slab owning the given object.
+    static Slab& slabFor(const void* ptr);
+
+    static constexpr size_t NumSizeClasses =
+            MaxObjectSize / SizeClassGranularity;
+
+    std::array<SizeClass, NumSizeClasses> sizeClasses;
+
+    std::atomic<size_t> numSlabs{0};
+    std::atomic<size_t> numObjects{0};
+};
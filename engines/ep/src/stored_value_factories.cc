@@ -18,43 +18,114 @@
 #include "stored_value_factories.h"
 
 #include "item.h"
+#include "key_prefix_dictionary.h"
+#include "objectregistry.h"
+
+void* ArenaStoredValueFactory::allocate(size_t size, bool& fromArena) {
+    MemoryDomainGuard guard(MemoryDomain::HashTable);
+    if (arena) {
+        if (auto* ptr = arena->allocate(size)) {
+            fromArena = true;
+            return ptr;
+        }
+    }
+    fromArena = false;
+    return ::operator new(size);
+}
+
+uint16_t ArenaStoredValueFactory::getKeyPrefix(const DocKey& key) const {
+    if (!keyPrefixes) {
+        return 0;
+    }
+    return KeyPrefixDictionary::get().intern(key);
+}
 
 StoredValue::UniquePtr StoredValueFactory::operator()(
         const Item& itm, StoredValue::UniquePtr next) {
     // Allocate a buffer to store the StoredValue and any trailing bytes
     // that maybe required.
-    return StoredValue::UniquePtr(
-            new (::operator new(StoredValue::getRequiredStorage(itm.getKey())))
-                    StoredValue(itm,
-                                std::move(next),
-                                *stats,
-                                /*isOrdered*/ false));
+    const auto inlineCapacity = getInlineValueCapacity(itm.getValue());
+    const auto keyPrefix = getKeyPrefix(itm.getKey());
+    auto size = StoredValue::getRequiredStorage(itm.getKey(), keyPrefix);
+    if (inlineCapacity) {
+        size = StoredValue::getInlineValueStorage(size, inlineCapacity);
+    }
+    bool fromArena;
+    auto* sv = new (allocate(size, fromArena))
+            StoredValue(itm,
+                        std::move(next),
+                        *stats,
+                        /*isOrdered*/ false,
+                        keyPrefix);
+    if (fromArena) {
+        sv->setArenaAllocated();
+    }
+    if (inlineCapacity) {
+        sv->initInlineValue(inlineCapacity);
+    }
+    return StoredValue::UniquePtr(sv);
 }
 
 StoredValue::UniquePtr StoredValueFactory::copyStoredValue(
         const StoredValue& other, StoredValue::UniquePtr next) {
     // Allocate a buffer to store the copy of StoredValue and any
     // trailing bytes required for the key.
-    return StoredValue::UniquePtr(
-            new (::operator new(other.getObjectSize()))
-                    StoredValue(other, std::move(next), *stats));
+    const auto inlineCapacity = getInlineValueCapacity(other.getValue());
+    auto size = other.getObjectSize();
+    if (inlineCapacity) {
+        size = StoredValue::getInlineValueStorage(size, inlineCapacity);
+    }
+    bool fromArena;
+    auto* sv = new (allocate(size, fromArena))
+            StoredValue(other, std::move(next), *stats);
+    if (fromArena) {
+        sv->setArenaAllocated();
+    }
+    if (inlineCapacity) {
+        sv->initInlineValue(inlineCapacity);
+    }
+    return StoredValue::UniquePtr(sv);
 }
 
 StoredValue::UniquePtr OrderedStoredValueFactory::operator()(
         const Item& itm, StoredValue::UniquePtr next) {
     // Allocate a buffer to store the OrderStoredValue and any trailing
     // bytes required for the key.
-    return StoredValue::UniquePtr(
-            new (::operator new(
-                    OrderedStoredValue::getRequiredStorage(itm.getKey())))
-                    OrderedStoredValue(itm, std::move(next), *stats));
+    const auto inlineCapacity = getInlineValueCapacity(itm.getValue());
+    const auto keyPrefix = getKeyPrefix(itm.getKey());
+    auto size = OrderedStoredValue::getRequiredStorage(itm.getKey(), keyPrefix);
+    if (inlineCapacity) {
+        size = StoredValue::getInlineValueStorage(size, inlineCapacity);
+    }
+    bool fromArena;
+    auto* osv = new (allocate(size, fromArena))
+            OrderedStoredValue(itm, std::move(next), *stats, keyPrefix);
+    if (fromArena) {
+        osv->setArenaAllocated();
+    }
+    if (inlineCapacity) {
+        osv->initInlineValue(inlineCapacity);
+    }
+    return StoredValue::UniquePtr(osv);
 }
 
 StoredValue::UniquePtr OrderedStoredValueFactory::copyStoredValue(
         const StoredValue& other, StoredValue::UniquePtr next) {
     // Allocate a buffer to store the copy ofOrderStoredValue and any
     // trailing bytes required for the key.
-    return StoredValue::UniquePtr(
-            new (::operator new(other.getObjectSize()))
-                    OrderedStoredValue(other, std::move(next), *stats));
+    const auto inlineCapacity = getInlineValueCapacity(other.getValue());
+    auto size = other.getObjectSize();
+    if (inlineCapacity) {
+        size = StoredValue::getInlineValueStorage(size, inlineCapacity);
+    }
+    bool fromArena;
+    auto* osv = new (allocate(size, fromArena))
+            OrderedStoredValue(other, std::move(next), *stats);
+    if (fromArena) {
+        osv->setArenaAllocated();
+    }
+    if (inlineCapacity) {
+        osv->initInlineValue(inlineCapacity);
+    }
+    return StoredValue::UniquePtr(osv);
 }
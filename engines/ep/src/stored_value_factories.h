@@ -24,6 +24,7 @@
 #include <memory>
 
 #include "stored-value.h"
+#include "stored_value_arena.h"
 
 /**
  * Abstract base class for StoredValue factories.
@@ -56,14 +57,102 @@ public:
                                                    StoredValue::UniquePtr next) = 0;
 };
 
+/**
+ * Base for the concrete factories; owns the optional StoredValueArena which
+ * objects are allocated from.
+ */
+class ArenaStoredValueFactory : public AbstractStoredValueFactory {
+public:
+    /// @return the arena objects are allocated from, or nullptr if disabled.
+    const StoredValueArena* getArena() const {
+        return arena.get();
+    }
+
+    /// @return true if small values are stored inline in the objects.
+    bool isInlineValues() const {
+        return inlineValues;
+    }
+
+    /// @return true if key prefixes are stored as KeyPrefixDictionary IDs.
+    bool isKeyPrefixes() const {
+        return keyPrefixes;
+    }
+
+protected:
+    ArenaStoredValueFactory(EPStats& s,
+                            bool useArena,
+                            bool useInlineValues,
+                            bool useKeyPrefixes)
+        : stats(&s),
+          arena(useArena ? std::make_unique<StoredValueArena>() : nullptr),
+          inlineValues(useInlineValues && !useArena),
+          keyPrefixes(useKeyPrefixes) {
+    }
+
+    /**
+     * @return the ID of the prefix to store the given key with, 0 to store
+     *         it whole.
+     */
+    uint16_t getKeyPrefix(const DocKey& key) const;
+
+    /**
+     * @return the capacity of the inline value storage to create objects
+     *         holding the given value with, 0 for none.
+     */
+    size_t getInlineValueCapacity(const value_t& value) const {
+        if (!inlineValues || !value) {
+            return 0;
+        }
+        return StoredValue::getInlineValueCapacityFor(value->valueSize());
+    }
+
+    /**
+     * Allocate storage for a StoredValue of the given size - from the arena
+     * if enabled and the object fits a size class, otherwise from the
+     * general purpose allocator.
+     *
+     * @param size Bytes required
+     * @param[out] fromArena Set to true if allocated from the arena
+     */
+    void* allocate(size_t size, bool& fromArena);
+
+    EPStats* stats;
+
+    // Must outlive all StoredValues created by this factory - the factory is
+    // owned by the HashTable which frees all its StoredValues on destruction.
+    std::unique_ptr<StoredValueArena> arena;
+
+    // Inline values aren't used along with the arena: an inline value may
+    // keep its StoredValue's storage after the HashTable (and arena) is
+    // destroyed, while Items still reference it.
+    const bool inlineValues;
+
+    const bool keyPrefixes;
+};
+
 /**
  * Creator of StoredValue instances.
  */
-class StoredValueFactory : public AbstractStoredValueFactory {
+class StoredValueFactory : public ArenaStoredValueFactory {
 public:
     using value_type = StoredValue;
 
-    StoredValueFactory(EPStats& s) : stats(&s) {
+    /**
+     * @param s EPStats to update for created StoredValues
+     * @param useArena If true, allocate StoredValues from a
+     *        StoredValueArena owned by this factory.
+     * @param useInlineValues If true (and useArena false), store values of
+     *        up to StoredValue::MaxInlineValueSize bytes inline in the
+     *        StoredValues (see StoredValue::initInlineValue).
+     * @param useKeyPrefixes If true, store the prefix of keys as an ID in
+     *        the KeyPrefixDictionary (see StoredValue::isKeyPrefixed).
+     */
+    StoredValueFactory(EPStats& s,
+                       bool useArena = false,
+                       bool useInlineValues = false,
+                       bool useKeyPrefixes = false)
+        : ArenaStoredValueFactory(
+                  s, useArena, useInlineValues, useKeyPrefixes) {
     }
 
     /**
@@ -74,19 +163,22 @@ public:
 
     StoredValue::UniquePtr copyStoredValue(
             const StoredValue& other, StoredValue::UniquePtr next) override;
-
-private:
-    EPStats* stats;
 };
 
 /**
  * Creator of OrderedStoredValue instances.
  */
-class OrderedStoredValueFactory : public AbstractStoredValueFactory {
+class OrderedStoredValueFactory : public ArenaStoredValueFactory {
 public:
     using value_type = OrderedStoredValue;
 
-    OrderedStoredValueFactory(EPStats& s) : stats(&s) {
+    /// @see StoredValueFactory::StoredValueFactory
+    OrderedStoredValueFactory(EPStats& s,
+                              bool useArena = false,
+                              bool useInlineValues = false,
+                              bool useKeyPrefixes = false)
+        : ArenaStoredValueFactory(
+                  s, useArena, useInlineValues, useKeyPrefixes) {
     }
 
     /**
@@ -100,7 +192,4 @@ public:
      */
     StoredValue::UniquePtr copyStoredValue(
             const StoredValue& other, StoredValue::UniquePtr next) override;
-
-private:
-    EPStats* stats;
 };
@@ -16,6 +16,7 @@
 
 #include "storeddockey.h"
 #include <mcbp/protocol/unsigned_leb128.h>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
@@ -84,14 +85,19 @@ CollectionID SerialisedDocKey::getCollectionID() const {
 }
 
 bool SerialisedDocKey::operator==(const DocKey& rhs) const {
-    auto rhsIdAndData = rhs.getIdAndKey();
-    auto lhsIdAndData = cb::mcbp::decode_unsigned_leb128<CollectionIDType>(
-            {data(), size()});
-    return lhsIdAndData.first == rhsIdAndData.first &&
-           lhsIdAndData.second.size() == rhsIdAndData.second.size() &&
-           std::equal(lhsIdAndData.second.begin(),
-                      lhsIdAndData.second.end(),
-                      rhsIdAndData.second.begin());
+    // Keys are hashed over their encoded bytes (see DocKeyInterface::hash),
+    // with a key which doesn't encode a collection-ID hashed as if it had the
+    // (single byte) DefaultCollection prefix. As such two keys are only ever
+    // considered equal if those bytes are identical - compare them directly
+    // with memcmp (which is vectorised) instead of decoding and comparing the
+    // collection-ID of each.
+    if (rhs.getEncoding() == DocKeyEncodesCollectionId::Yes) {
+        return size() == rhs.size() &&
+               std::memcmp(data(), rhs.data(), size()) == 0;
+    }
+    return size() == rhs.size() + 1 &&
+           data()[0] == DefaultCollectionLeb128Encoded &&
+           std::memcmp(data() + 1, rhs.data(), rhs.size()) == 0;
 }
 
 SerialisedDocKey::SerialisedDocKey(cb::const_byte_buffer key,
@@ -0,0 +1,104 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "task_type_stats.h"
+#include "statwriter.h"
+
+void TaskTypeStats::logQTime(std::chrono::microseconds wait) {
+    queueWait.add(wait);
+    currentInterval().queueWait.add(wait);
+}
+
+void TaskTypeStats::logRunTime(std::chrono::microseconds runtime) {
+    runTime.add(runtime);
+    currentInterval().runTime.add(runtime);
+}
+
+void TaskTypeStats::sample(size_t ready,
+                           size_t future,
+                           std::chrono::steady_clock::time_point now) {
+    std::lock_guard<std::mutex> lh(mutex);
+    const uint8_t next = current ^ 1;
+    intervals[next].queueWait.reset();
+    intervals[next].runTime.reset();
+    current = next;
+
+    if (intervalStart != std::chrono::steady_clock::time_point{}) {
+        lastIntervalDuration = now - intervalStart;
+    }
+    intervalStart = now;
+    readyQueueDepth = ready;
+    futureQueueDepth = future;
+}
+
+std::chrono::microseconds TaskTypeStats::getLastIntervalQueueWait(
+        double percentile) {
+    std::lock_guard<std::mutex> lh(mutex);
+    return std::chrono::microseconds(
+            intervals[current ^ 1].queueWait.getValueAtPercentile(percentile));
+}
+
+void TaskTypeStats::addStats(const std::string& prefix,
+                             const void* cookie,
+                             const AddStatFn& add_stat) {
+    add_casted_stat((prefix + ":queue_wait").c_str(),
+                    queueWait,
+                    add_stat,
+                    cookie);
+    add_casted_stat(
+            (prefix + ":runtime").c_str(), runTime, add_stat, cookie);
+    add_casted_stat((prefix + ":ready_queue_depth").c_str(),
+                    readyQueueDepth,
+                    add_stat,
+                    cookie);
+    add_casted_stat((prefix + ":future_queue_depth").c_str(),
+                    futureQueueDepth,
+                    add_stat,
+                    cookie);
+
+    std::lock_guard<std::mutex> lh(mutex);
+    // The last interval is the one sample() most recently ended
+    const auto& last = intervals[current ^ 1];
+    add_casted_stat(
+            (prefix + ":interval:duration_ms").c_str(),
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                    lastIntervalDuration)
+                    .count(),
+            add_stat,
+            cookie);
+    const std::pair<const char*, const Hdr1sfMicroSecHistogram*> histos[] = {
+            {"queue_wait", &last.queueWait}, {"runtime", &last.runTime}};
+    for (const auto& h : histos) {
+        const auto key = prefix + ":interval:" + h.first;
+        add_casted_stat((key + "_count").c_str(),
+                        h.second->getValueCount(),
+                        add_stat,
+                        cookie);
+        add_casted_stat((key + "_p50").c_str(),
+                        h.second->getValueAtPercentile(50),
+                        add_stat,
+                        cookie);
+        add_casted_stat((key + "_p99").c_str(),
+                        h.second->getValueAtPercentile(99),
+                        add_stat,
+                        cookie);
+        add_casted_stat((key + "_max").c_str(),
+                        h.second->getMaxValue(),
+                        add_stat,
+                        cookie);
+    }
+}
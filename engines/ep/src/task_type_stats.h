@@ -0,0 +1,105 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <memcached/engine_common.h>
+#include <utilities/hdrhistogram.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+
+/**
+ * How long the ExecutorPool's tasks of one type (writer, reader, auxio or
+ * nonio) waited to run once ready, and how long they ran for, across all of
+ * the buckets. Kept both in total and for the last sampled interval (with
+ * the depth of the type's queues at the end of it), so that a starved queue
+ * can be alarmed on from the recent percentiles rather than the totals since
+ * the process started.
+ */
+class TaskTypeStats {
+public:
+    void logQTime(std::chrono::microseconds wait);
+
+    void logRunTime(std::chrono::microseconds runtime);
+
+    /**
+     * End the current interval, and start the next.
+     *
+     * @param readyQueueDepth the number of the type's tasks ready to run now
+     * @param futureQueueDepth the number of the type's tasks scheduled to
+     *        run later
+     */
+    void sample(size_t readyQueueDepth,
+                size_t futureQueueDepth,
+                std::chrono::steady_clock::time_point now);
+
+    /**
+     * Add the stats, with keys of the form "<prefix>:interval:runtime_p99"
+     * (and the totals as "<prefix>:queue_wait"/"<prefix>:runtime"
+     * histograms).
+     */
+    void addStats(const std::string& prefix,
+                  const void* cookie,
+                  const AddStatFn& add_stat);
+
+    const Hdr1sfMicroSecHistogram& getQueueWaitHisto() const {
+        return queueWait;
+    }
+
+    const Hdr1sfMicroSecHistogram& getRunTimeHisto() const {
+        return runTime;
+    }
+
+    /// @return the given percentile of the last interval's queue wait
+    std::chrono::microseconds getLastIntervalQueueWait(double percentile);
+
+    size_t getReadyQueueDepth() const {
+        return readyQueueDepth;
+    }
+
+    size_t getFutureQueueDepth() const {
+        return futureQueueDepth;
+    }
+
+private:
+    struct Interval {
+        Hdr1sfMicroSecHistogram queueWait;
+        Hdr1sfMicroSecHistogram runTime;
+    };
+
+    Interval& currentInterval() {
+        return intervals[current];
+    }
+
+    Hdr1sfMicroSecHistogram queueWait;
+    Hdr1sfMicroSecHistogram runTime;
+
+    // The tasks are logged to the current interval without a lock; sample()
+    // resets the last interval and makes it the current one.
+    std::array<Interval, 2> intervals;
+    std::atomic<uint8_t> current{0};
+
+    // Serialises sample() and addStats() (the reading of the last interval)
+    std::mutex mutex;
+    std::chrono::steady_clock::time_point intervalStart{};
+    std::chrono::steady_clock::duration lastIntervalDuration{};
+    std::atomic<size_t> readyQueueDepth{0};
+    std::atomic<size_t> futureQueueDepth{0};
+};
@@ -17,12 +17,16 @@
 #include "bucket_logger.h"
 #include "executorpool.h"
 #include "executorthread.h"
+#include "lock_profiler.h"
 #include "taskqueue.h"
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
 
 TaskQueue::TaskQueue(ExecutorPool *m, task_type_t t, const char *nm) :
-    name(nm), queueType(t), manager(m), sleepers(0)
+    name(nm), queueType(t), manager(m), sleepers(0),
+    readyTopPriority(std::numeric_limits<queue_priority_t>::max())
 {
     // EMPTY
 }
@@ -36,29 +40,100 @@ const std::string TaskQueue::getName() const {
 }
 
 size_t TaskQueue::getReadyQueueSize() {
-    LockHolder lh(mutex);
+    ProfiledLockHolder<LockHolder> lh(LockSite::TaskQueue, mutex);
     return readyQueue.size();
 }
 
 size_t TaskQueue::getFutureQueueSize() {
-    LockHolder lh(mutex);
+    ProfiledLockHolder<LockHolder> lh(LockSite::TaskQueue, mutex);
     return futureQueue.size();
 }
 
 size_t TaskQueue::getPendingQueueSize() {
-    LockHolder lh(mutex);
+    ProfiledLockHolder<LockHolder> lh(LockSite::TaskQueue, mutex);
     return pendingQueue.size();
 }
 
 ExTask TaskQueue::_popReadyTask(void) {
     ExTask t = readyQueue.top();
     readyQueue.pop();
+    _updateReadyTopPriority();
     manager->lessWork(queueType);
     return t;
 }
 
+ExTask TaskQueue::_popReadyTaskFor(const ExecutorThread& t) {
+    ExTask task = _popReadyTask();
+    const int node = t.getNumaNode();
+    const bool otherNode =
+            node >= 0 && task->numaNode >= 0 && task->numaNode != node;
+    if (!otherNode || task->passedOverForNumaNode || readyQueue.empty()) {
+        task->passedOverForNumaNode = false;
+        return task;
+    }
+
+    // The task would rather run on another node. Leave it for a thread of
+    // that node if this one can run something else just as urgent instead;
+    // but only once, so the task isn't held back if that node is busy.
+    const ExTask& next = readyQueue.top();
+    if (next->getQueuePriority() != task->getQueuePriority() ||
+        (next->numaNode >= 0 && next->numaNode != node)) {
+        task->passedOverForNumaNode = false;
+        return task;
+    }
+    ExTask ret = next;
+    readyQueue.pop();
+    ret->passedOverForNumaNode = false;
+    task->passedOverForNumaNode = true;
+    readyQueue.push(task);
+    _updateReadyTopPriority();
+    return ret;
+}
+
+void TaskQueue::_updateReadyTopPriority() {
+    readyTopPriority = readyQueue.empty()
+                               ? std::numeric_limits<queue_priority_t>::max()
+                               : readyQueue.top()->getQueuePriority();
+}
+
+void TaskQueue::_batchReadyTasks(ExecutorThread& t, size_t batchSize) {
+    // Leave at least half of the remaining ready tasks for the other threads
+    const size_t count = std::min(batchSize, readyQueue.size() / 2);
+    if (count == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(t.localTasksMutex);
+    if (!t.localTasks.empty()) {
+        return;
+    }
+    // The tasks remain counted as ready work (ExecutorPool::numReadyTasks)
+    // until the thread (or a thread which steals them) runs them.
+    for (size_t ii = 0; ii < count; ++ii) {
+        t.localTasks.emplace_back(readyQueue.top(), this);
+        readyQueue.pop();
+    }
+    _updateReadyTopPriority();
+}
+
+void TaskQueue::requeueReadyTask(ExTask& task) {
+    NonBucketAllocationGuard guard;
+    TaskQueue* sleepQ;
+    size_t numToWake = 1;
+    {
+        ProfiledLockHolder<LockHolder> lh(LockSite::TaskQueue, mutex);
+        readyQueue.push(task);
+        _updateReadyTopPriority();
+        sleepQ = manager->getSleepQ(queueType);
+        _doWake_UNLOCKED(numToWake);
+    }
+    if (this != sleepQ) {
+        sleepQ->doWake(numToWake);
+    }
+}
+
 void TaskQueue::doWake(size_t &numToWake) {
-    LockHolder lh(mutex);
+    ProfiledLockHolder<LockHolder> lh(LockSite::TaskQueue, mutex);
     _doWake_UNLOCKED(numToWake);
 }
 
@@ -113,21 +188,23 @@ bool TaskQueue::_doSleep(ExecutorThread &t,
     return true;
 }
 
-bool TaskQueue::_sleepThenFetchNextTask(ExecutorThread& t) {
+bool TaskQueue::_sleepThenFetchNextTask(ExecutorThread& t, size_t batchSize) {
     std::unique_lock<std::mutex> lh(mutex);
     if (!_doSleep(t, lh)) {
         return false; // shutting down
     }
-    return _fetchNextTaskInner(t, lh);
+    return _fetchNextTaskInner(t, lh, batchSize);
 }
 
-bool TaskQueue::_fetchNextTask(ExecutorThread& t) {
-    std::unique_lock<std::mutex> lh(mutex);
-    return _fetchNextTaskInner(t, lh);
+bool TaskQueue::_fetchNextTask(ExecutorThread& t, size_t batchSize) {
+    ProfiledLockHolder<std::unique_lock<std::mutex>> lh(LockSite::TaskQueue,
+                                                        mutex);
+    return _fetchNextTaskInner(t, lh, batchSize);
 }
 
 bool TaskQueue::_fetchNextTaskInner(ExecutorThread& t,
-                                    const std::unique_lock<std::mutex>&) {
+                                    const std::unique_lock<std::mutex>&,
+                                    size_t batchSize) {
     bool ret = false;
 
     size_t numToWake = _moveReadyTasks(t.getCurTime());
@@ -146,9 +223,13 @@ bool TaskQueue::_fetchNextTaskInner(ExecutorThread& t,
         // order, the function below will push any pending task back into the
         // readyQueue (sorted by priority)
         _checkPendingQueue();
-        ExTask tid = _popReadyTask(); // and pop out the top task
+        // and pop out the top task (or one for this thread's NUMA node)
+        ExTask tid = _popReadyTaskFor(t);
         t.setCurrentTask(tid);
         ret = true;
+        if (batchSize) {
+            _batchReadyTasks(t, batchSize);
+        }
     } else { // Let the task continue waiting in pendingQueue
         numToWake = numToWake ? numToWake - 1 : 0; // 1 fewer task ready
     }
@@ -157,14 +238,15 @@ bool TaskQueue::_fetchNextTaskInner(ExecutorThread& t,
     return ret;
 }
 
-bool TaskQueue::fetchNextTask(ExecutorThread& thread) {
+bool TaskQueue::fetchNextTask(ExecutorThread& thread, size_t batchSize) {
     NonBucketAllocationGuard guard;
-    return _fetchNextTask(thread);
+    return _fetchNextTask(thread, batchSize);
 }
 
-bool TaskQueue::sleepThenFetchNextTask(ExecutorThread& thread) {
+bool TaskQueue::sleepThenFetchNextTask(ExecutorThread& thread,
+                                       size_t batchSize) {
     NonBucketAllocationGuard guard;
-    return _sleepThenFetchNextTask(thread);
+    return _sleepThenFetchNextTask(thread, batchSize);
 }
 
 size_t TaskQueue::_moveReadyTasks(
@@ -184,6 +266,7 @@ size_t TaskQueue::_moveReadyTasks(
             break;
         }
     }
+    _updateReadyTopPriority();
 
     manager->addWork(numReady, queueType);
 
@@ -195,13 +278,14 @@ void TaskQueue::_checkPendingQueue(void) {
     if (!pendingQueue.empty()) {
         ExTask runnableTask = pendingQueue.front();
         readyQueue.push(runnableTask);
+        _updateReadyTopPriority();
         manager->addWork(1, queueType);
         pendingQueue.pop_front();
     }
 }
 
 std::chrono::steady_clock::time_point TaskQueue::_reschedule(ExTask& task) {
-    LockHolder lh(mutex);
+    ProfiledLockHolder<LockHolder> lh(LockSite::TaskQueue, mutex);
 
     futureQueue.push(task);
     return futureQueue.top()->getWaketime();
@@ -218,7 +302,7 @@ void TaskQueue::_schedule(ExTask &task) {
     size_t numToWake = 1;
 
     {
-        LockHolder lh(mutex);
+        ProfiledLockHolder<LockHolder> lh(LockSite::TaskQueue, mutex);
 
         // If we are rescheduling a previously cancelled task, we should reset
         // the task state to the initial value of running.
@@ -251,7 +335,7 @@ void TaskQueue::_wake(ExTask &task) {
     // One task is being made ready regardless of the queue it's in.
     size_t readyCount = 1;
     {
-        LockHolder lh(mutex);
+        ProfiledLockHolder<LockHolder> lh(LockSite::TaskQueue, mutex);
         EP_LOG_DEBUG("{}: Wake a task \"{}\" id {}",
                      name,
                      task->getDescription(),
@@ -19,6 +19,7 @@
 #include "syncobject.h"
 #include "task_type.h"
 
+#include <atomic>
 #include <chrono>
 #include <list>
 #include <queue>
@@ -43,16 +44,37 @@ public:
     /**
      * Fetch the next task to be run from the task queues, updating
      * thread::currentTask with the next task to run (if one found).
+     * @param batchSize the maximum number of further ready tasks (in
+     *        priority order) to move to the thread's local queue along with
+     *        it, so the thread doesn't have to come back to this queue for
+     *        them. At most half of the remaining ready tasks are taken,
+     *        and only if the thread's local queue is empty.
      * @returns true if there is a task to run, otherwise false.
      */
-    bool fetchNextTask(ExecutorThread& thread);
+    bool fetchNextTask(ExecutorThread& thread, size_t batchSize = 0);
 
     /**
      * Sleeps until the next task is ready to run, waking up when ready and
      * updating thread::currentTask with the task to run.
+     * @param batchSize as for fetchNextTask()
      * @returns true if there is a task to run, otherwise false.
      */
-    bool sleepThenFetchNextTask(ExecutorThread& thread);
+    bool sleepThenFetchNextTask(ExecutorThread& thread, size_t batchSize = 0);
+
+    /**
+     * Put a ready task which was moved to a thread's local queue (and not
+     * run) back into this queue's ready queue.
+     */
+    void requeueReadyTask(ExTask& task);
+
+    /**
+     * The priority of the most urgent task in the ready queue (the maximum
+     * queue_priority_t if it is empty). Readable without the queue lock so
+     * a thread can check its local tasks are still the ones to run next.
+     */
+    queue_priority_t getReadyTopPriority() const {
+        return readyTopPriority;
+    }
 
     void wake(ExTask &task);
 
@@ -76,15 +98,19 @@ private:
     void _schedule(ExTask &task);
     std::chrono::steady_clock::time_point _reschedule(ExTask& task);
     void _checkPendingQueue(void);
-    bool _sleepThenFetchNextTask(ExecutorThread& t);
-    bool _fetchNextTask(ExecutorThread& thread);
+    bool _sleepThenFetchNextTask(ExecutorThread& t, size_t batchSize);
+    bool _fetchNextTask(ExecutorThread& thread, size_t batchSize);
     bool _fetchNextTaskInner(ExecutorThread& t,
-                             const std::unique_lock<std::mutex>& lh);
+                             const std::unique_lock<std::mutex>& lh,
+                             size_t batchSize);
+    void _batchReadyTasks(ExecutorThread& t, size_t batchSize);
+    void _updateReadyTopPriority();
     void _wake(ExTask &task);
     bool _doSleep(ExecutorThread &thread, std::unique_lock<std::mutex>& lock);
     void _doWake_UNLOCKED(size_t &numToWake);
     size_t _moveReadyTasks(const std::chrono::steady_clock::time_point tv);
     ExTask _popReadyTask(void);
+    ExTask _popReadyTaskFor(const ExecutorThread& t);
 
     SyncObject mutex;
     const std::string name;
@@ -96,6 +122,9 @@ private:
     std::priority_queue<ExTask, std::deque<ExTask>,
                         CompareByPriority> readyQueue;
 
+    // priority of readyQueue.top(), updated whenever readyQueue changes.
+    std::atomic<queue_priority_t> readyTopPriority;
+
     // sorted by waketime.
     FutureQueue<> futureQueue;
 
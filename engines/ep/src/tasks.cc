@@ -32,6 +32,11 @@ bool FlusherTask::run() {
     return flusher->step(this);
 }
 
+bool FlushVBucketTask::run() {
+    flusher->flushDispatched(vbid);
+    return false;
+}
+
 CompactTask::CompactTask(EPBucket& bucket,
                          const CompactionConfig& c,
                          uint64_t purgeSeqno,
@@ -66,6 +71,33 @@ bool CompactTask::run() {
     return bucket.doCompact(compactionConfig, purgeSeqno, cookie);
 }
 
+BloomFilterRebuildTask::BloomFilterRebuildTask(EPBucket& bucket)
+    : GlobalTask(&bucket.getEPEngine(), TaskId::BloomFilterRebuildTask, 0, false),
+      bucket(bucket) {
+}
+
+bool BloomFilterRebuildTask::run() {
+    TRACE_EVENT0("ep-engine/task", "BloomFilterRebuildTask");
+    const auto& config = engine->getConfiguration();
+    if (config.isBfilterEnabled()) {
+        const auto maxVbuckets = config.getMaxVbuckets();
+        while (nextVbid < maxVbuckets) {
+            const Vbid vbid(nextVbid++);
+            auto vb = bucket.getVBucket(vbid);
+            if (vb && vb->getState() != vbucket_state_dead &&
+                vb->needsFilterRebuild()) {
+                bucket.rebuildBloomFilter(vbid);
+                // Yield between vBuckets.
+                snooze(0);
+                return true;
+            }
+        }
+    }
+    nextVbid = 0;
+    snooze(config.getBfilterRebuildInterval());
+    return true;
+}
+
 bool StatSnap::run() {
     TRACE_EVENT0("ep-engine/task", "StatSnap");
     engine->getKVBucket()->snapshotStats();
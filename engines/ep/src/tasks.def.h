@@ -30,6 +30,7 @@
 // Read IO tasks
 TASK(MultiBGFetcherTask, READER_TASK_IDX, 0)
 TASK(FetchAllKeysTask, READER_TASK_IDX, 0)
+TASK(RangeScanTask, READER_TASK_IDX, 0)
 TASK(Warmup, READER_TASK_IDX, 0)
 TASK(WarmupInitialize, READER_TASK_IDX, 0)
 TASK(WarmupCreateVBuckets, READER_TASK_IDX, 0)
@@ -49,6 +50,7 @@ TASK(BackfillDiskLoad, AUXIO_TASK_IDX, 1)
 TASK(VBucketMemoryAndDiskDeletionTask, AUXIO_TASK_IDX, 1)
 TASK(AccessScanner, AUXIO_TASK_IDX, 3)
 TASK(AccessScannerVisitor, AUXIO_TASK_IDX, 3)
+TASK(BloomFilterRebuildTask, AUXIO_TASK_IDX, 3)
 TASK(ActiveStreamCheckpointProcessorTask, AUXIO_TASK_IDX, 5)
 TASK(BackfillManagerTask, AUXIO_TASK_IDX, 8)
 
@@ -57,6 +59,7 @@ TASK(BackfillManagerTask, AUXIO_TASK_IDX, 8)
 TASK(RollbackTask, WRITER_TASK_IDX, 1)
 TASK(CompactVBucketTask, WRITER_TASK_IDX, 2)
 TASK(FlusherTask, WRITER_TASK_IDX, 5)
+TASK(FlushVBucketTask, WRITER_TASK_IDX, 5)
 TASK(StatSnap, WRITER_TASK_IDX, 9)
 
 // Non-IO tasks
@@ -68,7 +71,6 @@ TASK(ItemPagerVisitor, NONIO_TASK_IDX, 1)
 TASK(ExpiredItemPagerVisitor, NONIO_TASK_IDX, 1)
 TASK(DcpConsumerTask, NONIO_TASK_IDX, 2)
 TASK(DurabilityTimeoutTask, NONIO_TASK_IDX, 1)
-TASK(DurabilityTimeoutVisitor, NONIO_TASK_IDX, 1)
 TASK(ConnNotifierCallback, NONIO_TASK_IDX, 5)
 TASK(ClosedUnrefCheckpointRemoverTask, NONIO_TASK_IDX, 6)
 TASK(ClosedUnrefCheckpointRemoverVisitorTask, NONIO_TASK_IDX, 6)
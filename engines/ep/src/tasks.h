@@ -64,6 +64,35 @@ private:
     std::string desc;
 };
 
+/**
+ * A task flushing a single vBucket on behalf of a shard's FlusherTask, so
+ * that (with flusher_concurrency > 1) several of the shard's vBuckets can be
+ * flushed at once on different writer threads.
+ */
+class FlushVBucketTask : public GlobalTask {
+public:
+    FlushVBucketTask(EventuallyPersistentEngine* e, Flusher* f, Vbid vbid)
+        : GlobalTask(e, TaskId::FlushVBucketTask, 0, true),
+          flusher(f),
+          vbid(vbid) {
+    }
+
+    bool run();
+
+    std::string getDescription() {
+        return "Flushing " + vbid.to_string();
+    }
+
+    std::chrono::microseconds maxExpectedDuration() {
+        // As FlusherTask.
+        return std::chrono::seconds(1);
+    }
+
+private:
+    Flusher* flusher;
+    const Vbid vbid;
+};
+
 /**
  * A task for compacting a vbucket db file
  */
@@ -95,6 +124,34 @@ private:
     std::string desc;
 };
 
+/**
+ * A task which rebuilds the bloom filters of vBuckets which need it (see
+ * VBucket::needsFilterRebuild) from a key-only disk scan, one vBucket per
+ * run. Once every vBucket has been checked, it sleeps for
+ * bfilter_rebuild_interval seconds.
+ */
+class BloomFilterRebuildTask : public GlobalTask {
+public:
+    explicit BloomFilterRebuildTask(EPBucket& bucket);
+
+    bool run();
+
+    std::string getDescription() {
+        return "Rebuilding bloom filters";
+    }
+
+    std::chrono::microseconds maxExpectedDuration() {
+        // Each run scans (the keys of) at most one vBucket; similar to
+        // compacting one.
+        return std::chrono::seconds(25);
+    }
+
+private:
+    EPBucket& bucket;
+    /// The next vBucket to check.
+    uint16_t nextVbid = 0;
+};
+
 /**
  * A task that periodically takes a snapshot of the stats and persists them to
  * disk.
@@ -0,0 +1,168 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "value_spill_cache.h"
+
+#include "bucket_logger.h"
+#include "stats.h"
+
+#include <folly/portability/Fcntl.h>
+#include <folly/portability/Unistd.h>
+#include <platform/crc32c.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+/// Roughly one index slot per this many bytes of cache.
+static const size_t bytesPerIndexSlot = 512;
+static const size_t minIndexSlots = 1024;
+
+static size_t indexSizeFor(size_t capacity) {
+    size_t ret = minIndexSlots;
+    while (ret < capacity / bytesPerIndexSlot) {
+        ret <<= 1;
+    }
+    return ret;
+}
+
+ValueSpillCache::ValueSpillCache(EPStats& stats,
+                                 std::string path,
+                                 size_t capacity)
+    : stats(stats),
+      path(std::move(path)),
+      capacity(capacity),
+      fd(-1),
+      indexMask(indexSizeFor(capacity) - 1),
+      index(new std::atomic<uint64_t>[indexMask + 1]) {
+    if (capacity <= sizeof(RecordHeader)) {
+        throw std::invalid_argument("ValueSpillCache: capacity " +
+                                    std::to_string(capacity) +
+                                    " is too small");
+    }
+    for (size_t ii = 0; ii <= indexMask; ++ii) {
+        index[ii].store(0, std::memory_order_relaxed);
+    }
+
+    fd = open(this->path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        throw std::system_error(errno,
+                                std::system_category(),
+                                "ValueSpillCache: failed to open '" +
+                                        this->path + "'");
+    }
+}
+
+ValueSpillCache::~ValueSpillCache() {
+    close(fd);
+    if (remove(path.c_str()) != 0) {
+        EP_LOG_WARN("ValueSpillCache: failed to remove '{}': {}",
+                    path,
+                    strerror(errno));
+    }
+}
+
+std::atomic<uint64_t>& ValueSpillCache::indexSlot(Vbid vbid,
+                                                  int64_t bySeqno) {
+    const uint64_t key = (uint64_t(vbid.get()) << 48) ^ uint64_t(bySeqno);
+    // Fibonacci hashing; seqnos are dense so spread them over the index.
+    const uint64_t hash = (key * 0x9E3779B97F4A7C15ull) >> 32;
+    return index[hash & indexMask];
+}
+
+bool ValueSpillCache::spill(Vbid vbid,
+                            int64_t bySeqno,
+                            uint64_t cas,
+                            cb::const_char_buffer value) {
+    const size_t size = sizeof(RecordHeader) + value.size();
+    if (size > capacity) {
+        return false;
+    }
+
+    std::vector<char> record(size);
+    RecordHeader header = {};
+    header.cas = cas;
+    header.bySeqno = bySeqno;
+    header.length = uint32_t(value.size());
+    header.crc = crc32c(reinterpret_cast<const uint8_t*>(value.data()),
+                        value.size(),
+                        0);
+    header.vbid = vbid.get();
+    std::memcpy(record.data(), &header, sizeof(header));
+    std::copy(value.begin(), value.end(), record.begin() + sizeof(header));
+
+    uint64_t pos;
+    {
+        std::lock_guard<std::mutex> lh(appendMutex);
+        pos = head.load();
+        // Records never wrap around the end of the file.
+        const auto offset = pos % capacity;
+        if (offset + size > capacity) {
+            pos += capacity - offset;
+        }
+        // Advance the head before writing, so readers of the records being
+        // overwritten can tell.
+        head.store(pos + size);
+    }
+
+    if (pwrite(fd, record.data(), size, off_t(pos % capacity)) !=
+        ssize_t(size)) {
+        EP_LOG_WARN("ValueSpillCache::spill: write to '{}' failed: {}",
+                    path,
+                    strerror(errno));
+        return false;
+    }
+
+    indexSlot(vbid, bySeqno).store(pos + 1);
+    ++stats.spillCacheWrites;
+    stats.spillCacheBytesWritten.fetch_add(size);
+    return true;
+}
+
+value_t ValueSpillCache::fetch(Vbid vbid, int64_t bySeqno, uint64_t cas) {
+    const auto entry = indexSlot(vbid, bySeqno).load();
+    if (entry != 0) {
+        const uint64_t pos = entry - 1;
+        const off_t offset = off_t(pos % capacity);
+
+        RecordHeader header;
+        if (!overwritten(pos, sizeof(header)) &&
+            pread(fd, &header, sizeof(header), offset) ==
+                    ssize_t(sizeof(header)) &&
+            header.vbid == vbid.get() && header.bySeqno == bySeqno &&
+            header.cas == cas &&
+            header.length <= capacity - sizeof(header)) {
+            std::vector<char> data(header.length);
+            const auto size = sizeof(header) + header.length;
+            if (pread(fd, data.data(), header.length, offset + sizeof(header)) ==
+                        ssize_t(header.length) &&
+                !overwritten(pos, size) &&
+                crc32c(reinterpret_cast<const uint8_t*>(data.data()),
+                       data.size(),
+                       0) == header.crc) {
+                ++stats.spillCacheHits;
+                return value_t{TaggedPtr<Blob>(
+                        Blob::New(data.data(), data.size()))};
+            }
+        }
+    }
+    ++stats.spillCacheMisses;
+    return {};
+}
@@ -0,0 +1,128 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "blob.h"
+
+#include <memcached/vbucket.h>
+#include <platform/sized_buffer.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class EPStats;
+
+/**
+ * A second tier for ejected values: a log-structured cache file on fast
+ * local storage which the item pager writes values to as it ejects them
+ * (value eviction only), so that a later read of the value can be served
+ * with a single pread of the raw bytes instead of a BG fetch through the
+ * KVStore.
+ *
+ * The file is a circular log of records (a header identifying the
+ * revision - vbid, bySeqno and CAS - followed by the value exactly as it
+ * was held in memory). When the log wraps, the oldest records are simply
+ * overwritten; the cache is a best-effort accelerator and a miss just
+ * falls back to a BG fetch. Its contents don't survive a restart (the file
+ * is truncated when it's opened).
+ *
+ * Records are found through a fixed-size, direct-mapped index from
+ * (vbid, bySeqno) to log position. The index is lossy: two revisions which
+ * map to the same slot evict each other. Every lookup checks the record's
+ * header against the revision asked for, and checks the record wasn't
+ * overwritten while it was being read, so a stale or clobbered record is
+ * never returned.
+ *
+ * Thread safe. Appends are serialised (only to reserve space in the log);
+ * reads are lock free.
+ */
+class ValueSpillCache {
+public:
+    /**
+     * Create (or truncate) the cache file.
+     *
+     * @param stats stats to record cache activity in
+     * @param path the cache file
+     * @param capacity maximum size of the file in bytes
+     * @throws std::system_error if the file can't be opened
+     */
+    ValueSpillCache(EPStats& stats, std::string path, size_t capacity);
+
+    /// Closes and removes the cache file.
+    ~ValueSpillCache();
+
+    /**
+     * Write a value to the cache.
+     *
+     * @return true if it was written (false if it is too large, or the
+     *         write failed)
+     */
+    bool spill(Vbid vbid,
+               int64_t bySeqno,
+               uint64_t cas,
+               cb::const_char_buffer value);
+
+    /**
+     * Read back the value of the given revision.
+     *
+     * @return the value, or a null value_t if the cache doesn't hold it
+     *         (any more)
+     */
+    value_t fetch(Vbid vbid, int64_t bySeqno, uint64_t cas);
+
+    size_t getCapacity() const {
+        return capacity;
+    }
+
+private:
+    struct RecordHeader {
+        uint64_t cas;
+        int64_t bySeqno;
+        uint32_t length;
+        uint32_t crc;
+        uint16_t vbid;
+        uint16_t padding[3];
+    };
+
+    std::atomic<uint64_t>& indexSlot(Vbid vbid, int64_t bySeqno);
+
+    /**
+     * @return true if the record of the given size at log position pos
+     *         could have been (partly) overwritten by later appends.
+     */
+    bool overwritten(uint64_t pos, size_t size) const {
+        return head.load() - pos > capacity - size;
+    }
+
+    EPStats& stats;
+    const std::string path;
+    const size_t capacity;
+    int fd;
+
+    /// Serialises reserving space at the head of the log.
+    std::mutex appendMutex;
+    /// Total bytes ever appended; records are at (position % capacity).
+    std::atomic<uint64_t> head{0};
+
+    /// Log position + 1 of the record for each slot (0 = empty).
+    const size_t indexMask;
+    std::unique_ptr<std::atomic<uint64_t>[]> index;
+};
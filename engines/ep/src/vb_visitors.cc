@@ -17,6 +17,7 @@
 
 #include "vb_visitors.h"
 
+#include "globaltask.h"
 #include "vbucket.h"
 
 VBucketVisitor::VBucketVisitor() = default;
@@ -33,7 +34,8 @@ void CappedDurationVBucketVisitor::begin() {
 }
 
 bool CappedDurationVBucketVisitor::pauseVisitor() {
-    return std::chrono::steady_clock::now() > (chunkStart + maxChunkDuration);
+    return std::chrono::steady_clock::now() > (chunkStart + maxChunkDuration) ||
+           GlobalTask::isCpuBudgetExhausted();
 }
 
 PauseResumeVBAdapter::PauseResumeVBAdapter(
@@ -90,15 +90,27 @@ public:
     /**
      * Return true if visiting vbuckets should be paused temporarily.
      *
-     * Default implementation pauses if the chunk has been running for
-     * more than maxChunkDuration.
+     * Implementations which can pause should also do so when the task
+     * driving them has used up its CPU budget (see
+     * GlobalTask::isCpuBudgetExhausted()).
      */
     virtual bool pauseVisitor() = 0;
+
+    /**
+     * How long the task driving the visitor should sleep for (in seconds)
+     * after pauseVisitor() returned true, before visiting resumes. Visitors
+     * which pause to yield the thread return 0 (the default), those which
+     * pause to limit their rate return how long to wait.
+     */
+    virtual double getPauseDuration() const {
+        return 0;
+    }
 };
 
 /**
  * A base class for a vBucket visitor which pauses after a given duration of
- * time has been spent executing (maxChunkDuration).
+ * time has been spent executing (maxChunkDuration), or once the task's CPU
+ * budget is exhausted.
  */
 class CappedDurationVBucketVisitor : public PausableVBucketVisitor {
     void visitBucket(const VBucketPtr& vb) override = 0;
@@ -24,11 +24,13 @@
 #include "collections/collection_persisted_stats.h"
 #include "conflict_resolution.h"
 #include "dcp/dcpconnmap.h"
+#include "dcp/transformed_item_cache.h"
 #include "durability/active_durability_monitor.h"
 #include "durability/passive_durability_monitor.h"
 #include "ep_engine.h"
 #include "ep_time.h"
 #include "ep_types.h"
+#include "expiry_index.h"
 #include "failover-table.h"
 #include "flusher.h"
 #include "hash_table.h"
@@ -36,19 +38,24 @@
 #include "pre_link_document_context.h"
 #include "statwriter.h"
 #include "stored_value_factories.h"
+#include "trace_helpers.h"
 #include "vb_filter.h"
 #include "vbucket_state.h"
 #include "vbucketdeletiontask.h"
 
+#include <JSON_checker.h>
 #include <folly/lang/Assume.h>
 #include <memcached/protocol_binary.h>
 #include <memcached/server_document_iface.h>
+#include <memcached/util.h>
+#include <phosphor/phosphor.h>
 #include <platform/compress.h>
 #include <xattr/blob.h>
 #include <xattr/utils.h>
 
 #include <gsl.h>
 #include <logtags.h>
+#include <algorithm>
 #include <functional>
 #include <list>
 #include <set>
@@ -64,6 +71,9 @@ const auto MAX_CHK_FLUSH_TIMEOUT = std::chrono::seconds(30);
 /* Statics definitions */
 cb::AtomicDuration VBucket::chkFlushTimeout(MIN_CHK_FLUSH_TIMEOUT);
 double VBucket::mutationMemThreshold = 0.9;
+std::atomic<size_t> VBucket::proactiveEvictionThreshold{0};
+std::atomic<size_t> VBucket::proactiveEvictionMaxItems{2};
+std::atomic<size_t> VBucket::touchCoalesceWindow{0};
 
 VBucketFilter VBucketFilter::filter_diff(const VBucketFilter &other) const {
     std::vector<Vbid> tmp(acceptable.size() + other.size());
@@ -174,7 +184,14 @@ VBucket::VBucket(Vbid i,
                  int64_t hlcEpochSeqno,
                  bool mightContainXattrs,
                  const nlohmann::json& replTopology)
-    : ht(st, std::move(valFact), config.getHtSize(), config.getHtLocks()),
+    : ht(st,
+         std::move(valFact),
+         config.getHtSize(),
+         config.getHtLocks(),
+         HashTable::layoutFromString(config.getHtLayout()),
+         HashTable::hashAlgorithmFromString(config.getHtHashAlgorithm()),
+         config.getHtEvictedMetaIndexSize(),
+         config.isHtSharedReaderLocks()),
       checkpointManager(std::make_unique<CheckpointManager>(st,
                                                             i,
                                                             chkConfig,
@@ -229,6 +246,15 @@ VBucket::VBucket(Vbid i,
         conflictResolver.reset(new RevisionSeqnoResolution());
     }
 
+    if (config.getDcpTransformedItemCacheSize() != 0) {
+        transformedItemCache = std::make_shared<TransformedItemCache>(
+                config.getDcpTransformedItemCacheSize(), stats);
+    }
+
+    if (config.isExpPagerUseIndex()) {
+        expiryIndex = std::make_unique<ExpiryIndex>();
+    }
+
     backfill.wlock()->isBackfillPhase = false;
     pendingOpsStart = std::chrono::steady_clock::time_point();
     stats.coreLocal.get()->memOverhead.fetch_add(
@@ -282,6 +308,10 @@ int64_t VBucket::getHighPreparedSeqno() const {
     return durabilityMonitor->getHighPreparedSeqno();
 }
 
+bool VBucket::hasTrackedSyncWrites() const {
+    return durabilityMonitor && durabilityMonitor->getNumTracked() > 0;
+}
+
 size_t VBucket::getChkMgrMemUsage() const {
     return checkpointManager->getMemoryUsage();
 }
@@ -342,6 +372,12 @@ void VBucket::fireAllOps(EventuallyPersistentEngine &engine) {
 }
 
 VBucket::ItemsToFlush VBucket::getItemsToPersist(size_t approxLimit) {
+    TRACE_EVENT2("ep-engine/flusher",
+                 "getItemsToPersist",
+                 "vbid",
+                 getId().get(),
+                 "limit",
+                 approxLimit);
     // Fetch up to approxLimit items from rejectQueue, backfill items and
     // checkpointManager (in that order); then check if we obtained everything
     // which is available.
@@ -423,7 +459,8 @@ vbucket_state_t VBucket::fromString(const char* state) {
 }
 
 void VBucket::setState(vbucket_state_t to, const nlohmann::json& meta) {
-    folly::SharedMutex::WriteHolder wlh(getStateLock());
+    ProfiledLockHolder<folly::SharedMutex::WriteHolder> wlh(
+            LockSite::VBucketState, getStateLock());
     setState_UNLOCKED(to, meta, wlh);
 }
 
@@ -624,6 +661,13 @@ void VBucket::processDurabilityTimeout(
     getActiveDM().processTimeout(asOf);
 }
 
+void VBucket::scheduleSyncWriteTimeout(
+        std::chrono::steady_clock::time_point expiry) {
+    if (syncWriteTimeoutCb) {
+        syncWriteTimeoutCb(getId(), expiry);
+    }
+}
+
 void VBucket::doStatsForQueueing(const Item& qi, size_t itemBytes)
 {
     ++dirtyQueueSize;
@@ -743,6 +787,61 @@ ENGINE_ERROR_CODE VBucket::commit(
         boost::optional<int64_t> commitSeqno,
         const Collections::VB::Manifest::CachingReadHandle& cHandle,
         const void* cookie) {
+    VBNotifyCtx notify;
+    auto ret = commitPending(key, commitSeqno, notify);
+    if (ret != ENGINE_SUCCESS) {
+        return ret;
+    }
+
+    notifyNewSeqno(notify);
+    doCollectionsStats(cHandle, notify);
+
+    // Cookie representing the client connection, provided only at Active
+    if (cookie) {
+        notifyClientOfSyncWriteComplete(cookie, ENGINE_SUCCESS);
+    }
+
+    return ENGINE_SUCCESS;
+}
+
+ENGINE_ERROR_CODE VBucket::commitBatch(
+        const std::vector<PendingCommit>& commits) {
+    ENGINE_ERROR_CODE ret = ENGINE_SUCCESS;
+    VBNotifyCtx batchNotify;
+    std::vector<const void*> cookies;
+    {
+        auto readHandle = lockCollections();
+        for (const auto& pending : commits) {
+            VBNotifyCtx notify;
+            ret = commitPending(pending.key, {}, notify);
+            if (ret != ENGINE_SUCCESS) {
+                break;
+            }
+            doCollectionsStats(
+                    readHandle, pending.key.getCollectionID(), notify);
+
+            batchNotify.bySeqno = std::max(batchNotify.bySeqno, notify.bySeqno);
+            batchNotify.notifyReplication |= notify.notifyReplication;
+            batchNotify.notifyFlusher |= notify.notifyFlusher;
+            if (pending.cookie) {
+                cookies.push_back(pending.cookie);
+            }
+        }
+    }
+
+    if (batchNotify.bySeqno) {
+        notifyNewSeqno(batchNotify);
+    }
+    for (const auto* cookie : cookies) {
+        notifyClientOfSyncWriteComplete(cookie, ENGINE_SUCCESS);
+    }
+
+    return ret;
+}
+
+ENGINE_ERROR_CODE VBucket::commitPending(const DocKey& key,
+                                         boost::optional<int64_t> commitSeqno,
+                                         VBNotifyCtx& notify) {
     auto htRes = ht.findForWrite(key);
     if (!htRes.storedValue) {
         // If we are committing we /should/ always find the pending item.
@@ -774,17 +873,9 @@ ENGINE_ERROR_CODE VBucket::commit(
     if (commitSeqno) {
         queueItmCtx.genBySeqno = GenerateBySeqno::No;
     }
-    auto notify = commitStoredValue(
+    notify = commitStoredValue(
             htRes.lock, *htRes.storedValue, queueItmCtx, commitSeqno);
 
-    notifyNewSeqno(notify);
-    doCollectionsStats(cHandle, notify);
-
-    // Cookie representing the client connection, provided only at Active
-    if (cookie) {
-        notifyClientOfSyncWriteComplete(cookie, ENGINE_SUCCESS);
-    }
-
     return ENGINE_SUCCESS;
 }
 
@@ -840,6 +931,9 @@ void VBucket::notifyClientOfSyncWriteComplete(const void* cookie,
             cookie,
             result);
     Expects(cookie);
+    TRACE_END(cookie,
+              cb::tracing::TraceCode::SYNC_WRITE,
+              std::chrono::steady_clock::now());
     syncWriteCompleteCb(cookie, result);
 }
 
@@ -904,27 +998,31 @@ bool VBucket::isResidentRatioUnderThreshold(float threshold) {
     }
 }
 
-void VBucket::createFilter(size_t key_count, double probability) {
+void VBucket::createFilter(size_t key_count,
+                           double probability,
+                           BloomFilter::Type type) {
     // Create the actual bloom filter upon vbucket creation during
     // scenarios:
     //      - Bucket creation
     //      - Rebalance
     LockHolder lh(bfMutex);
     if (bFilter == nullptr && tempFilter == nullptr) {
-        bFilter = std::make_unique<BloomFilter>(key_count, probability,
-                                        BFILTER_ENABLED);
+        bFilter = std::make_unique<BloomFilter>(
+                key_count, probability, BFILTER_ENABLED, type);
     } else {
         EP_LOG_WARN("({}) Bloom filter / Temp filter already exist!", id);
     }
 }
 
-void VBucket::initTempFilter(size_t key_count, double probability) {
+void VBucket::initTempFilter(size_t key_count,
+                             double probability,
+                             BloomFilter::Type type) {
     // Create a temp bloom filter with status as COMPACTING,
     // if the main filter is found to exist, set its state to
     // COMPACTING as well.
     LockHolder lh(bfMutex);
-    tempFilter = std::make_unique<BloomFilter>(key_count, probability,
-                                     BFILTER_COMPACTING);
+    tempFilter = std::make_unique<BloomFilter>(
+            key_count, probability, BFILTER_COMPACTING, type);
     if (bFilter) {
         bFilter->setStatus(BFILTER_COMPACTING);
     }
@@ -944,6 +1042,9 @@ void VBucket::addToFilter(const DocKey& key) {
     if (tempFilter) {
         tempFilter->addKey(key);
     }
+    if (rebuildFilter) {
+        rebuildFilter->addKey(key);
+    }
 }
 
 bool VBucket::maybeKeyExistsInFilter(const DocKey& key) {
@@ -1005,6 +1106,7 @@ void VBucket::clearFilter() {
     LockHolder lh(bfMutex);
     bFilter.reset();
     tempFilter.reset();
+    rebuildFilter.reset();
 }
 
 void VBucket::setFilterStatus(bfilter_status_t to) {
@@ -1015,6 +1117,9 @@ void VBucket::setFilterStatus(bfilter_status_t to) {
     if (tempFilter) {
         tempFilter->setStatus(to);
     }
+    if (rebuildFilter) {
+        rebuildFilter->setStatus(to);
+    }
 }
 
 std::string VBucket::getFilterStatusString() {
@@ -1046,6 +1151,58 @@ size_t VBucket::getNumOfKeysInFilter() {
     }
 }
 
+bool VBucket::needsFilterRebuild() {
+    LockHolder lh(bfMutex);
+    if (tempFilter || rebuildFilter) {
+        return false;
+    }
+    if (!bFilter) {
+        return true;
+    }
+    return bFilter->getStatus() == BFILTER_ENABLED &&
+           bFilter->getNumOfKeysInFilter() > bFilter->getEstimatedKeyCount();
+}
+
+bool VBucket::initRebuildFilter(size_t key_count,
+                                double probability,
+                                BloomFilter::Type type) {
+    LockHolder lh(bfMutex);
+    if (rebuildFilter) {
+        return false;
+    }
+    rebuildFilter = std::make_unique<BloomFilter>(
+            key_count, probability, BFILTER_ENABLED, type);
+    return true;
+}
+
+void VBucket::addToRebuildFilter(const DocKey& key) {
+    LockHolder lh(bfMutex);
+    if (rebuildFilter) {
+        rebuildFilter->addKey(key);
+    }
+}
+
+void VBucket::swapRebuiltFilter() {
+    // As with swapFilter(), a rebuilt filter which was disabled meanwhile is
+    // just discarded. A compaction running meanwhile still swaps its own
+    // filter in when it completes.
+    LockHolder lh(bfMutex);
+    if (rebuildFilter) {
+        if (rebuildFilter->getStatus() == BFILTER_ENABLED) {
+            bFilter = std::move(rebuildFilter);
+            if (tempFilter) {
+                bFilter->setStatus(BFILTER_COMPACTING);
+            }
+        }
+        rebuildFilter.reset();
+    }
+}
+
+void VBucket::clearRebuildFilter() {
+    LockHolder lh(bfMutex);
+    rebuildFilter.reset();
+}
+
 VBNotifyCtx VBucket::queueItem(queued_item& item, const VBQueueItemCtx& ctx) {
     // Ensure that durable writes are queued with the same seqno-order in both
     // Backfill/CheckpointManager Queues and DurabilityMonitor. Note that
@@ -1086,6 +1243,9 @@ VBNotifyCtx VBucket::queueItem(queued_item& item, const VBQueueItemCtx& ctx) {
         // Register this mutation with the durability monitor.
         Expects(ctx.durability.is_initialized());
         if (state == vbucket_state_active) {
+            TRACE_BEGIN(ctx.durability->cookie,
+                        cb::tracing::TraceCode::SYNC_WRITE,
+                        std::chrono::steady_clock::now());
             getActiveDM().addSyncWrite(ctx.durability->cookie, item);
         } else if (state == vbucket_state_replica ||
                    state == vbucket_state_pending) {
@@ -1096,6 +1256,53 @@ VBNotifyCtx VBucket::queueItem(queued_item& item, const VBQueueItemCtx& ctx) {
     return notifyCtx;
 }
 
+/**
+ * Share the Item being stored with the checkpoint, if it is just what
+ * StoredValue::toItem() would create - a committed mutation sharing the
+ * StoredValue's Blob - to save allocating (and copying the key into) a new
+ * Item for every mutation.
+ *
+ * @return the shared Item, or null if it must be copied from the StoredValue
+ */
+static queued_item shareWithCheckpoint(Item& itm,
+                                       const StoredValue& v,
+                                       Vbid vbid) {
+    if (v.isDeleted() ||
+        v.getCommitted() != CommittedState::CommittedViaMutation ||
+        itm.isDeleted() || itm.getOperation() != queue_op::mutation ||
+        v.getValue().get().get() != itm.getValue().get().get() ||
+        v.getDatatype() != itm.getDataType() ||
+        v.getFlags() != itm.getFlags() || v.getExptime() != itm.getExptime()) {
+        return {};
+    }
+
+    auto qi = itm.shareWithCheckpoint();
+    if (qi) {
+        // Not yet queued, so still only visible to this thread
+        qi->setVBucketId(vbid);
+        qi->setCas(v.getCas());
+        qi->setBySeqno(v.getBySeqno());
+        qi->setRevSeqno(v.getRevSeqno());
+        qi->setNRUValue(v.getNru());
+        qi->setFreqCounterValue(v.getFreqCounterValue());
+    }
+    return qi;
+}
+
+/**
+ * Copy the seqno and CAS assigned to a stored Item back to it. If the Item
+ * was shared with the checkpoint (and so may be being read by the flusher)
+ * it already has them, and mustn't be written to.
+ */
+static void updateSeqnoAndCas(Item& itm, const StoredValue& v) {
+    if (itm.getBySeqno() != v.getBySeqno()) {
+        itm.setBySeqno(v.getBySeqno());
+    }
+    if (itm.getCas() != v.getCas()) {
+        itm.setCas(v.getCas());
+    }
+}
+
 VBNotifyCtx VBucket::queueDirty(const HashTable::HashBucketLock& hbl,
                                 StoredValue& v,
                                 const VBQueueItemCtx& ctx) {
@@ -1109,10 +1316,16 @@ VBNotifyCtx VBucket::queueDirty(const HashTable::HashBucketLock& hbl,
     if (ctx.durability) {
         durabilityReqs = ctx.durability->requirements;
     }
-    queued_item qi(v.toItem(getId(),
-                            StoredValue::HideLockedCas::No,
-                            StoredValue::IncludeValue::Yes,
-                            durabilityReqs));
+    queued_item qi;
+    if (ctx.frontEndItem && !durabilityReqs) {
+        qi = shareWithCheckpoint(*ctx.frontEndItem, v, getId());
+    }
+    if (!qi) {
+        qi = queued_item(v.toItem(getId(),
+                                  StoredValue::HideLockedCas::No,
+                                  StoredValue::IncludeValue::Yes,
+                                  durabilityReqs));
+    }
 
     // MB-27457: Timestamp deletes only when they don't already have a timestamp
     // assigned. This is here to ensure all deleted items have a timestamp which
@@ -1140,6 +1353,8 @@ VBNotifyCtx VBucket::queueDirty(const HashTable::HashBucketLock& hbl,
         v.setBySeqno(qi->getBySeqno());
     }
 
+    updateExpiryIndex(v);
+
     return notifyCtx;
 }
 
@@ -1201,6 +1416,198 @@ HashTable::FindResult VBucket::fetchValidValue(
     return {v, std::move(hbl)};
 }
 
+cb::EngineErrorArithmeticResult VBucket::arithmetic(
+        const void* cookie,
+        EventuallyPersistentEngine& engine,
+        bool increment,
+        uint64_t delta,
+        uint64_t cas,
+        std::chrono::seconds maxTtl,
+        const Collections::VB::Manifest::CachingReadHandle& cHandle) {
+    const cb::EngineErrorArithmeticResult notSupported{
+            cb::engine_errc::not_supported, 0, 0, 0, 0};
+
+    auto htRes = tracedFindForWrite(cookie, cHandle.getKey());
+    auto* v = htRes.storedValue;
+    auto& hbl = htRes.lock;
+    if (v && v->isPending()) {
+        return {cb::engine_errc::sync_write_in_progress, 0, 0, 0, 0};
+    }
+    if (!v || v->isDeleted() || v->isTempItem() || !v->isResident() ||
+        v->isExpired(ep_real_time()) || v->isLocked(ep_current_time()) ||
+        cHandle.isLogicallyDeleted(v->getBySeqno()) ||
+        mcbp::datatype::is_xattr(v->getDatatype()) ||
+        mcbp::datatype::is_snappy(v->getDatatype())) {
+        return notSupported;
+    }
+    if (cas != 0 && cas != v->getCas()) {
+        return {cb::engine_errc::key_already_exists, 0, 0, 0, 0};
+    }
+
+    uint64_t value;
+    const auto& blob = v->getValue();
+    const std::string oldValue(blob ? blob->getData() : "",
+                               blob ? blob->valueSize() : 0);
+    if (!safe_strtoull(oldValue.c_str(), value)) {
+        return {cb::engine_errc::delta_badval, 0, 0, 0, 0};
+    }
+    if (increment) {
+        value += delta;
+    } else {
+        value = (value < delta) ? 0 : value - delta;
+    }
+    const auto newValue = std::to_string(value);
+
+    // The new revision of the document keeps its flags and expiry, as the
+    // get and CAS set of the counter would.
+    Item itm(cHandle.getKey(),
+             v->getFlags(),
+             v->getExptime(),
+             newValue.data(),
+             newValue.size(),
+             PROTOCOL_BINARY_RAW_BYTES,
+             v->getCas(),
+             -1,
+             getId());
+    cHandle.processExpiryTime(itm, maxTtl);
+
+    PreLinkDocumentContext preLinkDocumentContext(engine, cookie, &itm);
+    VBQueueItemCtx queueItmCtx;
+    queueItmCtx.preLinkDocumentContext = &preLinkDocumentContext;
+    MutationStatus status;
+    boost::optional<VBNotifyCtx> notifyCtx;
+    std::tie(status, notifyCtx) = processSet(hbl,
+                                             v,
+                                             itm,
+                                             itm.getCas(),
+                                             /*allowExisting*/ true,
+                                             /*hashMetaData*/ false,
+                                             queueItmCtx,
+                                             cb::StoreIfStatus::Continue);
+    switch (status) {
+    case MutationStatus::NoMem:
+        return {cb::engine_errc::no_memory, 0, 0, 0, 0};
+    case MutationStatus::WasDirty:
+    case MutationStatus::WasClean:
+        notifyNewSeqno(*notifyCtx);
+        doCollectionsStats(cHandle, *notifyCtx);
+        maybeEvictColdItems(hbl, *v);
+        return {cb::engine_errc::success,
+                value,
+                v->getCas(),
+                failovers->getLatestUUID(),
+                uint64_t(v->getBySeqno())};
+    case MutationStatus::InvalidCas:
+    case MutationStatus::IsLocked:
+    case MutationStatus::NotFound:
+    case MutationStatus::NeedBgFetch:
+    case MutationStatus::IsPendingSyncWrite:
+        // Not expected for the document checked above, but the get and CAS
+        // set will report them correctly.
+        return notSupported;
+    }
+    folly::assume_unreachable();
+}
+
+ENGINE_ERROR_CODE VBucket::appendPrepend(
+        const void* cookie,
+        EventuallyPersistentEngine& engine,
+        bool append,
+        cb::const_char_buffer value,
+        uint64_t& cas,
+        std::chrono::seconds maxTtl,
+        const Collections::VB::Manifest::CachingReadHandle& cHandle,
+        mutation_descr_t& mutInfo) {
+    auto htRes = tracedFindForWrite(cookie, cHandle.getKey());
+    auto* v = htRes.storedValue;
+    auto& hbl = htRes.lock;
+    if (v && v->isPending()) {
+        return ENGINE_SYNC_WRITE_IN_PROGRESS;
+    }
+    if (!v || v->isDeleted() || v->isTempItem() || !v->isResident() ||
+        v->isExpired(ep_real_time()) || v->isLocked(ep_current_time()) ||
+        cHandle.isLogicallyDeleted(v->getBySeqno()) ||
+        mcbp::datatype::is_xattr(v->getDatatype()) ||
+        mcbp::datatype::is_snappy(v->getDatatype())) {
+        return ENGINE_ENOTSUP;
+    }
+    if (cas != 0 && cas != v->getCas()) {
+        return ENGINE_KEY_EEXISTS;
+    }
+
+    const auto& blob = v->getValue();
+    const cb::const_char_buffer old{blob ? blob->getData() : nullptr,
+                                    blob ? blob->valueSize() : 0};
+    const size_t size = old.size() + value.size();
+    if (size > engine.getMaxItemSize()) {
+        return ENGINE_E2BIG;
+    }
+
+    // The new revision of the document keeps its flags and expiry, as the
+    // get and CAS set of it would. Its value is built directly in the new
+    // Item's Blob - the only copy made of the old value.
+    Item itm(cHandle.getKey(),
+             v->getFlags(),
+             v->getExptime(),
+             nullptr,
+             size,
+             PROTOCOL_BINARY_RAW_BYTES,
+             v->getCas(),
+             -1,
+             getId());
+    auto* data = const_cast<char*>(itm.getData());
+    const auto& first = append ? old : value;
+    const auto& second = append ? value : old;
+    std::copy(first.begin(), first.end(), data);
+    std::copy(second.begin(), second.end(), data + first.size());
+    if (checkUTF8JSON(reinterpret_cast<const uint8_t*>(data), size)) {
+        itm.setDataType(PROTOCOL_BINARY_DATATYPE_JSON);
+    }
+    cHandle.processExpiryTime(itm, maxTtl);
+
+    PreLinkDocumentContext preLinkDocumentContext(engine, cookie, &itm);
+    VBQueueItemCtx queueItmCtx;
+    queueItmCtx.preLinkDocumentContext = &preLinkDocumentContext;
+    MutationStatus status;
+    boost::optional<VBNotifyCtx> notifyCtx;
+    std::tie(status, notifyCtx) = processSet(hbl,
+                                             v,
+                                             itm,
+                                             itm.getCas(),
+                                             /*allowExisting*/ true,
+                                             /*hashMetaData*/ false,
+                                             queueItmCtx,
+                                             cb::StoreIfStatus::Continue);
+    switch (status) {
+    case MutationStatus::NoMem:
+        return ENGINE_ENOMEM;
+    case MutationStatus::WasDirty:
+    case MutationStatus::WasClean:
+        notifyNewSeqno(*notifyCtx);
+        doCollectionsStats(cHandle, *notifyCtx);
+        cas = v->getCas();
+        mutInfo.vbucket_uuid = failovers->getLatestUUID();
+        mutInfo.seqno = v->getBySeqno();
+        maybeEvictColdItems(hbl, *v);
+        return ENGINE_SUCCESS;
+    case MutationStatus::InvalidCas:
+    case MutationStatus::IsLocked:
+    case MutationStatus::NotFound:
+    case MutationStatus::NeedBgFetch:
+    case MutationStatus::IsPendingSyncWrite:
+        // Not expected for the document checked above, but the get and CAS
+        // set will report them correctly.
+        return ENGINE_ENOTSUP;
+    }
+    folly::assume_unreachable();
+}
+
+HashTable::FindResult VBucket::tracedFindForWrite(const void* cookie,
+                                                  const DocKey& key) {
+    TRACE_SCOPE(cookie, cb::tracing::TraceCode::HT_LOCK);
+    return ht.findForWrite(key);
+}
+
 HashTable::FindResult VBucket::fetchPreparedValue(
         const Collections::VB::Manifest::CachingReadHandle& cHandle) {
     const auto& key = cHandle.getKey();
@@ -1242,7 +1649,8 @@ cb::StoreIfStatus VBucket::callPredicate(cb::StoreIfPredicate predicate,
                                          StoredValue* v) {
     cb::StoreIfStatus storeIfStatus = cb::StoreIfStatus::Continue;
     if (v) {
-        auto info = v->getItemInfo(failovers->getLatestUUID());
+        const auto key = v->getKey();
+        auto info = v->getItemInfo(failovers->getLatestUUID(), key);
         storeIfStatus = predicate(info, getInfo());
         // No no, you can't ask for it again
         if (storeIfStatus == cb::StoreIfStatus::GetItemInfo &&
@@ -1274,7 +1682,7 @@ ENGINE_ERROR_CODE VBucket::set(
     }
 
     bool cas_op = (itm.getCas() != 0);
-    auto htRes = ht.findForWrite(itm.getKey());
+    auto htRes = tracedFindForWrite(cookie, itm.getKey());
     auto* v = htRes.storedValue;
     auto& hbl = htRes.lock;
 
@@ -1310,6 +1718,8 @@ ENGINE_ERROR_CODE VBucket::set(
     if (itm.isPending()) {
         queueItmCtx.durability =
                 DurabilityItemCtx{itm.getDurabilityReqs(), cookie};
+    } else {
+        queueItmCtx.frontEndItem = &itm;
     }
     queueItmCtx.preLinkDocumentContext = &preLinkDocumentContext;
     MutationStatus status;
@@ -1351,8 +1761,8 @@ ENGINE_ERROR_CODE VBucket::set(
         notifyNewSeqno(*notifyCtx);
         doCollectionsStats(cHandle, *notifyCtx);
 
-        itm.setBySeqno(v->getBySeqno());
-        itm.setCas(v->getCas());
+        updateSeqnoAndCas(itm, *v);
+        maybeEvictColdItems(hbl, *v);
         break;
     case MutationStatus::NeedBgFetch: { // CAS operation with non-resident item
         // +
@@ -1385,7 +1795,7 @@ ENGINE_ERROR_CODE VBucket::replace(
         return ENGINE_DURABILITY_IMPOSSIBLE;
     }
 
-    auto htRes = ht.findForWrite(itm.getKey());
+    auto htRes = tracedFindForWrite(cookie, itm.getKey());
     auto* v = htRes.storedValue;
     auto& hbl = htRes.lock;
 
@@ -1413,6 +1823,8 @@ ENGINE_ERROR_CODE VBucket::replace(
             if (itm.isPending()) {
                 queueItmCtx.durability =
                         DurabilityItemCtx{itm.getDurabilityReqs(), cookie};
+            } else {
+                queueItmCtx.frontEndItem = &itm;
             }
             std::tie(mtype, notifyCtx) = processSet(hbl,
                                                     v,
@@ -1447,8 +1859,8 @@ ENGINE_ERROR_CODE VBucket::replace(
             notifyNewSeqno(*notifyCtx);
             doCollectionsStats(cHandle, *notifyCtx);
 
-            itm.setBySeqno(v->getBySeqno());
-            itm.setCas(v->getCas());
+            updateSeqnoAndCas(itm, *v);
+            maybeEvictColdItems(hbl, *v);
             break;
         case MutationStatus::NeedBgFetch: {
             // temp item is already created. Simply schedule a bg fetch job
@@ -1572,12 +1984,17 @@ ENGINE_ERROR_CODE VBucket::setWithMeta(
         bool allowExisting,
         GenerateBySeqno genBySeqno,
         GenerateCas genCas,
-        const Collections::VB::Manifest::CachingReadHandle& cHandle) {
+        const Collections::VB::Manifest::CachingReadHandle& cHandle,
+        std::vector<DocKey>* deferredBgFetches) {
     auto htRes = ht.findForWrite(itm.getKey());
     auto* v = htRes.storedValue;
     auto& hbl = htRes.lock;
     bool maybeKeyExists = true;
 
+    if (!v && checkConflicts == CheckConflicts::Yes) {
+        v = restoreEvictedMeta(hbl, itm.getKey());
+    }
+
     // Effectively ignore logically deleted keys, they cannot stop the op
     if (v && cHandle.isLogicallyDeleted(v->getBySeqno())) {
         // v is not really here, operate like it's not and skip conflict checks
@@ -1589,7 +2006,11 @@ ENGINE_ERROR_CODE VBucket::setWithMeta(
     if (checkConflicts == CheckConflicts::Yes) {
         if (v) {
             if (v->isTempInitialItem()) {
-                bgFetch(itm.getKey(), cookie, engine, true);
+                if (deferredBgFetches) {
+                    deferredBgFetches->push_back(itm.getKey());
+                } else {
+                    bgFetch(itm.getKey(), cookie, engine, true);
+                }
                 return ENGINE_EWOULDBLOCK;
             }
 
@@ -1607,6 +2028,10 @@ ENGINE_ERROR_CODE VBucket::setWithMeta(
             }
         } else {
             if (maybeKeyExistsInFilter(itm.getKey())) {
+                if (deferredBgFetches) {
+                    return addTempItemAndDeferBGFetch(
+                            hbl, itm.getKey(), *deferredBgFetches);
+                }
                 return addTempItemAndBGFetch(
                         hbl, itm.getKey(), cookie, engine, true);
             } else {
@@ -1682,10 +2107,20 @@ ENGINE_ERROR_CODE VBucket::setWithMeta(
         // + full eviction.
         if (v) { // temp item is already created. Simply schedule a
             hbl.getHTLock().unlock(); // bg fetch job.
-            bgFetch(itm.getKey(), cookie, engine, true);
+            if (deferredBgFetches) {
+                deferredBgFetches->push_back(itm.getKey());
+            } else {
+                bgFetch(itm.getKey(), cookie, engine, true);
+            }
             return ENGINE_EWOULDBLOCK;
         }
-        ret = addTempItemAndBGFetch(hbl, itm.getKey(), cookie, engine, true);
+        if (deferredBgFetches) {
+            ret = addTempItemAndDeferBGFetch(
+                    hbl, itm.getKey(), *deferredBgFetches);
+        } else {
+            ret = addTempItemAndBGFetch(
+                    hbl, itm.getKey(), cookie, engine, true);
+        }
         break;
     }
     case MutationStatus::IsPendingSyncWrite:
@@ -1709,7 +2144,7 @@ ENGINE_ERROR_CODE VBucket::deleteItem(
         return ENGINE_DURABILITY_IMPOSSIBLE;
     }
 
-    auto htRes = ht.findForWrite(cHandle.getKey());
+    auto htRes = tracedFindForWrite(cookie, cHandle.getKey());
     auto* v = htRes.storedValue;
     auto& hbl = htRes.lock;
 
@@ -1851,6 +2286,10 @@ ENGINE_ERROR_CODE VBucket::deleteWithMeta(
     auto* v = htRes.storedValue;
     auto& hbl = htRes.lock;
 
+    if (!v && checkConflicts == CheckConflicts::Yes) {
+        v = restoreEvictedMeta(hbl, key);
+    }
+
     if (v && cHandle.isLogicallyDeleted(v->getBySeqno())) {
         return ENGINE_KEY_ENOENT;
     }
@@ -2001,6 +2440,70 @@ ENGINE_ERROR_CODE VBucket::deleteWithMeta(
     return ENGINE_SUCCESS;
 }
 
+void VBucket::updateExpiryIndex(const StoredValue& v) {
+    // Prepares don't expire; the item they commit is indexed then.
+    if (!expiryIndex || v.isTempItem() || v.isPending()) {
+        return;
+    }
+    if (v.isDeleted() || v.getExptime() == 0) {
+        expiryIndex->remove(v.getKey());
+    } else {
+        expiryIndex->add(v.getKey(),
+                         {v.getExptime(),
+                          v.getCas(),
+                          v.getRevSeqno(),
+                          v.getFlags(),
+                          mcbp::datatype::is_xattr(v.getDatatype())});
+    }
+}
+
+void VBucket::updateExpiryIndex(const Item& item) {
+    if (!expiryIndex || item.isPending()) {
+        return;
+    }
+    if (item.isDeleted() || item.getExptime() == 0) {
+        expiryIndex->remove(item.getKey());
+    } else {
+        expiryIndex->add(item.getKey(),
+                         {item.getExptime(),
+                          item.getCas(),
+                          item.getRevSeqno(),
+                          item.getFlags(),
+                          mcbp::datatype::is_xattr(item.getDataType())});
+    }
+}
+
+size_t VBucket::getExpiredItemsFromIndex(time_t now,
+                                         std::list<Item>& expired) {
+    const auto entries = expiryIndex->takeExpired(now);
+    for (const auto& entry : entries) {
+        const auto& key = entry.first;
+        const auto& meta = entry.second;
+        auto res = ht.findForRead(key, TrackReference::No, WantsDeleted::Yes);
+        const auto* v = res.storedValue;
+        if (v) {
+            // The entry may be stale (e.g. the item has since been touched
+            // to a later expiry); go by what's in the HashTable.
+            if (!v->isTempItem() && !v->isDeleted() && v->isExpired(now)) {
+                expired.push_back(*v->toItem(getId()));
+            }
+        } else if (eviction == EvictionPolicy::Full && !meta.xattrs) {
+            // Fully evicted; deleteExpiredItem() will expire it (if the
+            // bloom filter says it may still be on disk) given its metadata.
+            expired.emplace_back(key,
+                                 meta.flags,
+                                 meta.exptime,
+                                 value_t{},
+                                 PROTOCOL_BINARY_RAW_BYTES,
+                                 meta.cas,
+                                 -1,
+                                 getId(),
+                                 meta.revSeqno);
+        }
+    }
+    return entries.size();
+}
+
 void VBucket::deleteExpiredItem(const Item& it,
                                 time_t startTime,
                                 ExpireBy source) {
@@ -2094,7 +2597,7 @@ ENGINE_ERROR_CODE VBucket::add(
     if (itm.isPending() && !getActiveDM().isDurabilityPossible()) {
         return ENGINE_DURABILITY_IMPOSSIBLE;
     }
-    auto htRes = ht.findForWrite(itm.getKey());
+    auto htRes = tracedFindForWrite(cookie, itm.getKey());
     auto* v = htRes.storedValue;
     auto& hbl = htRes.lock;
 
@@ -2113,6 +2616,8 @@ ENGINE_ERROR_CODE VBucket::add(
     if (itm.isPending()) {
         queueItmCtx.durability =
                 DurabilityItemCtx{itm.getDurabilityReqs(), cookie};
+    } else {
+        queueItmCtx.frontEndItem = &itm;
     }
     AddStatus status;
     boost::optional<VBNotifyCtx> notifyCtx;
@@ -2134,8 +2639,8 @@ ENGINE_ERROR_CODE VBucket::add(
     case AddStatus::UnDel:
         notifyNewSeqno(*notifyCtx);
         doCollectionsStats(cHandle, *notifyCtx);
-        itm.setBySeqno(v->getBySeqno());
-        itm.setCas(v->getCas());
+        updateSeqnoAndCas(itm, *v);
+        maybeEvictColdItems(hbl, *v);
         break;
     }
 
@@ -2144,6 +2649,21 @@ ENGINE_ERROR_CODE VBucket::add(
     return itm.isPending() ? ENGINE_EWOULDBLOCK : ENGINE_SUCCESS;
 }
 
+bool VBucket::canCoalesceTouch(time_t current, time_t requested, time_t now) {
+    const auto window = time_t(touchCoalesceWindow.load());
+    if (window == 0 || current == 0 || requested <= current) {
+        // Disabled, or the touch adds an expiry or brings it forward
+        return false;
+    }
+    if (requested - current >= window) {
+        return false;
+    }
+    // The current expiry must still leave the item at least half of the TTL
+    // it was touched with, so that short TTLs refreshed before they run out
+    // are kept alive.
+    return (current - now) * 2 >= requested - now;
+}
+
 std::pair<MutationStatus, GetValue> VBucket::processGetAndUpdateTtl(
         HashTable::HashBucketLock& hbl,
         StoredValue* v,
@@ -2164,7 +2684,14 @@ std::pair<MutationStatus, GetValue> VBucket::processGetAndUpdateTtl(
                     GetValue(nullptr, ENGINE_KEY_EEXISTS, 0)};
         }
 
-        const bool exptime_mutated = exptime != v->getExptime();
+        bool exptime_mutated = exptime != v->getExptime();
+        if (exptime_mutated &&
+            canCoalesceTouch(v->getExptime(), exptime, ep_real_time())) {
+            // Only extends the TTL a little - leave the item (and its
+            // checkpoint, disk and replica copies) as it is
+            ++stats.numOpsTouchCoalesced;
+            exptime_mutated = false;
+        }
         auto bySeqNo = v->getBySeqno();
         if (exptime_mutated) {
             v->markDirty();
@@ -2247,8 +2774,61 @@ GetValue VBucket::getInternal(
     const bool metadataOnly = (options & ALLOW_META_ONLY);
     const bool getDeletedValue = (options & GET_DELETED_VALUE);
     const bool bgFetchRequired = (options & QUEUE_BG_FETCH);
-    auto res = fetchValidValue(
-            WantsDeleted::Yes, trackReference, QueueExpired::Yes, cHandle);
+
+    auto toGetValue = [this, options, getKeyOnly](const StoredValue& v) {
+        std::unique_ptr<Item> item;
+        if (getKeyOnly == GetKeyOnly::Yes) {
+            item = v.toItem(getId(),
+                            StoredValue::HideLockedCas::No,
+                            StoredValue::IncludeValue::No);
+        } else {
+            const auto hideLockedCas =
+                    ((options & HIDE_LOCKED_CAS) &&
+                                     v.isLocked(ep_current_time())
+                             ? StoredValue::HideLockedCas::Yes
+                             : StoredValue::HideLockedCas::No);
+            item = v.toItem(getId(), hideLockedCas);
+        }
+
+        if (options & TRACK_STATISTICS) {
+            opsGet++;
+        }
+
+        return GetValue(std::move(item),
+                        ENGINE_SUCCESS,
+                        v.getBySeqno(),
+                        !v.isResident(),
+                        v.getNRUValue());
+    };
+
+    // With shared reader locks the common case - a resident, unexpired item -
+    // is read without excluding the other readers of its stripe. Anything
+    // else is handled by the exclusive lookup below (which mustn't track the
+    // reference a second time).
+    auto exclusiveTrackReference = trackReference;
+    if (ht.hasSharedReaderLocks()) {
+        auto shared = [&] {
+            TRACE_SCOPE(cookie, cb::tracing::TraceCode::HT_LOCK);
+            return ht.findForReadShared(cHandle.getKey(), trackReference);
+        }();
+        const auto* v = shared.storedValue;
+        if (v) {
+            if (v->isResident() && !v->isTempItem() &&
+                !v->isExpired(ep_real_time()) &&
+                !cHandle.isLogicallyDeleted(v->getBySeqno())) {
+                return toGetValue(*v);
+            }
+            exclusiveTrackReference = TrackReference::No;
+        }
+    }
+
+    auto res = [&] {
+        TRACE_SCOPE(cookie, cb::tracing::TraceCode::HT_LOCK);
+        return fetchValidValue(WantsDeleted::Yes,
+                               exclusiveTrackReference,
+                               QueueExpired::Yes,
+                               cHandle);
+    }();
     auto* v = res.storedValue;
     if (v) {
         // 1 If SV is deleted and user didn't request deleted items
@@ -2290,29 +2870,7 @@ GetValue VBucket::getInternal(
                     cHandle.getKey(), cookie, engine, queueBgFetch, *v);
         }
 
-        std::unique_ptr<Item> item;
-        if (getKeyOnly == GetKeyOnly::Yes) {
-            item = v->toItem(getId(),
-                             StoredValue::HideLockedCas::No,
-                             StoredValue::IncludeValue::No);
-        } else {
-            const auto hideLockedCas =
-                    ((options & HIDE_LOCKED_CAS) &&
-                                     v->isLocked(ep_current_time())
-                             ? StoredValue::HideLockedCas::Yes
-                             : StoredValue::HideLockedCas::No);
-            item = v->toItem(getId(), hideLockedCas);
-        }
-
-        if (options & TRACK_STATISTICS) {
-            opsGet++;
-        }
-
-        return GetValue(std::move(item),
-                        ENGINE_SUCCESS,
-                        v->getBySeqno(),
-                        !v->isResident(),
-                        v->getNRUValue());
+        return toGetValue(*v);
     } else {
         if (!getDeletedValue &&
             (eviction == EvictionPolicy::Value || diskFlushAll)) {
@@ -2343,17 +2901,26 @@ ENGINE_ERROR_CODE VBucket::getMetaData(
         const Collections::VB::Manifest::CachingReadHandle& cHandle,
         ItemMetaData& metadata,
         uint32_t& deleted,
-        uint8_t& datatype) {
+        uint8_t& datatype,
+        std::vector<DocKey>* deferredBgFetches) {
     deleted = 0;
     auto htRes = ht.findForWrite(cHandle.getKey());
     auto* v = htRes.storedValue;
     auto& hbl = htRes.lock;
 
+    if (!v) {
+        v = restoreEvictedMeta(hbl, cHandle.getKey());
+    }
+
     if (v) {
         stats.numOpsGetMeta++;
         if (v->isTempInitialItem()) {
             // Need bg meta fetch.
-            bgFetch(cHandle.getKey(), cookie, engine, true);
+            if (deferredBgFetches) {
+                deferredBgFetches->push_back(cHandle.getKey());
+            } else {
+                bgFetch(cHandle.getKey(), cookie, engine, true);
+            }
             return ENGINE_EWOULDBLOCK;
         } else if (v->isTempNonExistentItem()) {
             metadata.cas = v->getCas();
@@ -2389,6 +2956,10 @@ ENGINE_ERROR_CODE VBucket::getMetaData(
         // existent on disk by the bloomfilter.
 
         if (maybeKeyExistsInFilter(cHandle.getKey())) {
+            if (deferredBgFetches) {
+                return addTempItemAndDeferBGFetch(
+                        hbl, cHandle.getKey(), *deferredBgFetches);
+            }
             return addTempItemAndBGFetch(
                     hbl, cHandle.getKey(), cookie, engine, true);
         } else {
@@ -2559,13 +3130,40 @@ void VBucket::deletedOnDiskCbk(const Item& queuedItem, bool deleted) {
 bool VBucket::deleteKey(const DocKey& key) {
     auto htRes = ht.findForWrite(key);
     if (!htRes.storedValue) {
+        // It may have been evicted, with its metadata still indexed.
+        ht.unlocked_eraseEvictedMeta(htRes.lock, key);
         return false;
     }
     return deleteStoredValue(htRes.lock, *htRes.storedValue);
 }
 
+/**
+ * Re-populates a vBucket's expiry index from the items in its HashTable.
+ */
+class ExpiryIndexRebuilder : public HashTableVisitor {
+public:
+    explicit ExpiryIndexRebuilder(VBucket& vb) : vb(vb) {
+    }
+
+    bool visit(const HashTable::HashBucketLock& lh, StoredValue& v) override {
+        vb.updateExpiryIndex(v);
+        return true;
+    }
+
+private:
+    VBucket& vb;
+};
+
 void VBucket::postProcessRollback(const RollbackResult& rollbackResult,
                                   uint64_t prevHighSeqno) {
+    if (expiryIndex) {
+        // Entries for the revisions rolled back are stale; rebuild the index
+        // from what's left. (Keys no longer in memory are left to
+        // compaction.)
+        expiryIndex->clear();
+        ExpiryIndexRebuilder rebuilder(*this);
+        ht.visit(rebuilder);
+    }
     failovers->pruneEntries(rollbackResult.highSeqno);
     checkpointManager->clear(*this, rollbackResult.highSeqno);
     setPersistedSnapshot(rollbackResult.snapStartSeqno,
@@ -2610,6 +3208,39 @@ void VBucket::setMutationMemoryThreshold(size_t memThreshold) {
     }
 }
 
+void VBucket::setProactiveEvictionThreshold(size_t memThreshold) {
+    if (memThreshold <= 100) {
+        proactiveEvictionThreshold = memThreshold;
+    } else {
+        throw std::invalid_argument(
+                "VBucket::setProactiveEvictionThreshold invalid "
+                "memThreshold:" +
+                std::to_string(memThreshold));
+    }
+}
+
+void VBucket::setProactiveEvictionMaxItems(size_t maxItems) {
+    proactiveEvictionMaxItems = maxItems;
+}
+
+void VBucket::setTouchCoalesceWindow(size_t seconds) {
+    touchCoalesceWindow = seconds;
+}
+
+void VBucket::maybeEvictColdItems(const HashTable::HashBucketLock& hbl,
+                                  const StoredValue& written) {
+    const size_t threshold = proactiveEvictionThreshold;
+    if (threshold == 0) {
+        return;
+    }
+    const double maxSize = static_cast<double>(stats.getMaxDataSize());
+    if (stats.getEstimatedTotalMemoryUsed() <= maxSize * threshold / 100.0) {
+        return;
+    }
+    stats.numProactiveEvictions += evictColdItemsFromChain(
+            hbl, written, proactiveEvictionMaxItems);
+}
+
 bool VBucket::hasMemoryForStoredValue(
         EPStats& st,
         const Item& item,
@@ -2646,6 +3277,24 @@ void VBucket::_addStats(bool details,
                 c);
         addStat("ht_cache_size", ht.getCacheSize(), add_stat, c);
         addStat("ht_size", ht.getSize(), add_stat, c);
+        if (expiryIndex) {
+            addStat("expiry_index_size", expiryIndex->size(), add_stat, c);
+        }
+        const auto& evictedMeta = ht.getEvictedMetaIndex();
+        if (evictedMeta.isEnabled()) {
+            addStat("ht_evicted_meta_index_size",
+                    evictedMeta.size(),
+                    add_stat,
+                    c);
+            addStat("ht_evicted_meta_index_memory",
+                    evictedMeta.getMemoryUsage(),
+                    add_stat,
+                    c);
+            addStat("ht_evicted_meta_index_hits",
+                    evictedMeta.getNumHits(),
+                    add_stat,
+                    c);
+        }
         addStat("num_ejects", ht.getNumEjects(), add_stat, c);
         addStat("ops_create", opsCreate.load(), add_stat, c);
 	addStat("ops_delete", opsDelete.load(), add_stat, c);
@@ -2827,7 +3476,10 @@ std::pair<MutationStatus, boost::optional<VBNotifyCtx>> VBucket::processSet(
                            GenerateRevSeqno::Yes;
         std::tie(v, notifyCtx) =
                 addNewStoredValue(hbl, itm, queueItmCtx, genRevSeqno);
-        itm.setRevSeqno(v->getRevSeqno());
+        // Already set if the Item was shared with the checkpoint
+        if (itm.getRevSeqno() != v->getRevSeqno()) {
+            itm.setRevSeqno(v->getRevSeqno());
+        }
         return {MutationStatus::WasClean, notifyCtx};
     }
 }
@@ -2894,7 +3546,10 @@ std::pair<AddStatus, boost::optional<VBNotifyCtx>> VBucket::processAdd(
                     hbl, itm, queueItmCtx, GenerateRevSeqno::Yes);
         }
 
-        itm.setRevSeqno(v->getRevSeqno());
+        // Already set if the Item was shared with the checkpoint
+        if (itm.getRevSeqno() != v->getRevSeqno()) {
+            itm.setRevSeqno(v->getRevSeqno());
+        }
 
         if (v->isTempItem()) {
             rv.first = AddStatus::BgFetch;
@@ -3061,6 +3716,33 @@ TempAddStatus VBucket::addTempStoredValue(const HashTable::HashBucketLock& hbl,
     return TempAddStatus::BgFetch;
 }
 
+ENGINE_ERROR_CODE VBucket::addTempItemAndDeferBGFetch(
+        const HashTable::HashBucketLock& hbl,
+        const DocKey& key,
+        std::vector<DocKey>& deferredBgFetches) {
+    if (addTempStoredValue(hbl, key) == TempAddStatus::NoMem) {
+        return ENGINE_ENOMEM;
+    }
+    deferredBgFetches.push_back(key);
+    return ENGINE_EWOULDBLOCK;
+}
+
+StoredValue* VBucket::restoreEvictedMeta(const HashTable::HashBucketLock& hbl,
+                                         const DocKey& key) {
+    auto meta = ht.unlocked_takeEvictedMeta(hbl, key);
+    if (!meta) {
+        return nullptr;
+    }
+    // Add a temp item and complete it as a metadata bgFetch would have.
+    if (addTempStoredValue(hbl, key) != TempAddStatus::BgFetch) {
+        return nullptr;
+    }
+    auto* v = ht.unlocked_find(
+            key, hbl.getBucketNum(), WantsDeleted::Yes, TrackReference::No);
+    ht.unlocked_restoreMeta(hbl.getHTLock(), *meta, *v);
+    return v;
+}
+
 void VBucket::notifyNewSeqno(
         const VBNotifyCtx& notifyCtx) {
     if (newSeqnoCb) {
@@ -45,10 +45,12 @@ class DCPBackfill;
 class DurabilityMonitor;
 class EPStats;
 class EventuallyPersistentEngine;
+class ExpiryIndex;
 class ItemMetaData;
 class PassiveDurabilityMonitor;
 class PreLinkDocumentContext;
 class RollbackResult;
+class TransformedItemCache;
 class VBucketBGFetchItem;
 struct vbucket_state;
 
@@ -87,6 +89,17 @@ struct DurabilityItemCtx {
     const void* cookie;
 };
 
+/**
+ * A pending SyncWrite to be committed as part of a batch (see
+ * VBucket::commitBatch).
+ */
+struct PendingCommit {
+    /// Key of the Prepare; must outlive the commitBatch call.
+    DocKey key;
+    /// The client connection to notify, nullptr if none.
+    const void* cookie;
+};
+
 /**
  * Structure that holds info needed to queue an item in chkpt or vb backfill
  * queue
@@ -117,6 +130,9 @@ struct VBQueueItemCtx {
     /// Context object that allows running the pre-link callback after the CAS
     /// is assigned but the document is not yet available for reading
     PreLinkDocumentContext* preLinkDocumentContext = nullptr;
+    /// The Item being stored, which may be shared with the checkpoint rather
+    /// than copied from the StoredValue (see Item::shareWithCheckpoint())
+    Item* frontEndItem = nullptr;
 };
 
 /**
@@ -165,6 +181,14 @@ using SeqnoAckCallback = std::function<void(Vbid vbid, int64_t seqno)>;
 /// Instance of SeqnoAckCallback which does nothing.
 const SeqnoAckCallback NoopSeqnoAckCb = [](Vbid vbid, int64_t seqno) {};
 
+/**
+ * Callback function invoked at Active when the given vBucket has a tracked
+ * SyncWrite which times out at the given time, so it must be checked for
+ * timeouts (VBucket::processDurabilityTimeout) then.
+ */
+using SyncWriteTimeoutCallback = std::function<void(
+        Vbid vbid, std::chrono::steady_clock::time_point expiry)>;
+
 class EventuallyPersistentEngine;
 class FailoverTable;
 class KVShard;
@@ -223,6 +247,13 @@ public:
      */
     int64_t getHighPreparedSeqno() const;
 
+    /**
+     * @return true if the DurabilityMonitor is tracking SyncWrites, i.e.
+     *     there are clients (at the Active) waiting on their completion,
+     *     which may depend on local persistence
+     */
+    bool hasTrackedSyncWrites() const;
+
     size_t getChkMgrMemUsage() const;
 
     size_t getChkMgrMemUsageOfUnrefCheckpoints() const;
@@ -390,6 +421,19 @@ public:
         persistenceSeqno.store(seqno);
     }
 
+    /**
+     * Set the percentage of the mutations covered by the last flush of this
+     * vBucket which were superseded by a later mutation of the same key (and
+     * so never written); used by the flusher to identify hot keys.
+     */
+    void setFlushSupersededPercent(size_t percent) {
+        flushSupersededPercent.store(percent);
+    }
+
+    size_t getFlushSupersededPercent() const {
+        return flushSupersededPercent.load();
+    }
+
     Vbid getId() const {
         return id;
     }
@@ -436,6 +480,20 @@ public:
     void processDurabilityTimeout(
             const std::chrono::steady_clock::time_point asOf);
 
+    /**
+     * Set the callback invoked when this VBucket has a SyncWrite which will
+     * time out. Must be set before the VBucket is visible to other threads.
+     */
+    void setSyncWriteTimeoutCallback(SyncWriteTimeoutCallback cb) {
+        syncWriteTimeoutCb = std::move(cb);
+    }
+
+    /**
+     * Called by the ActiveDurabilityMonitor: a tracked SyncWrite times out
+     * at expiry, so processDurabilityTimeout() must be run by then.
+     */
+    void scheduleSyncWriteTimeout(std::chrono::steady_clock::time_point expiry);
+
     /**
      * This method performs operations on the stored value prior
      * to expiring the item.
@@ -616,8 +674,13 @@ public:
     /**
      * BloomFilter operations for vbucket
      */
-    void createFilter(size_t key_count, double probability);
-    void initTempFilter(size_t key_count, double probability);
+    void createFilter(
+            size_t key_count,
+            double probability,
+            BloomFilter::Type type = BloomFilter::Type::Standard);
+    void initTempFilter(size_t key_count,
+                        double probability,
+                        BloomFilter::Type type = BloomFilter::Type::Standard);
     void addToFilter(const DocKey& key);
     virtual bool maybeKeyExistsInFilter(const DocKey& key);
     bool isTempFilterAvailable();
@@ -629,6 +692,30 @@ public:
     size_t getFilterSize();
     size_t getNumOfKeysInFilter();
 
+    /**
+     * Filter rebuild (from a key-only disk scan, see
+     * EPBucket::rebuildBloomFilter). While a rebuild is in progress, keys
+     * added to the main filter are also added to the one being rebuilt, so
+     * it is complete when swapped in.
+     */
+
+    /**
+     * @return true if the vbucket's bloom filter should be rebuilt: it is
+     *         missing (e.g. after warmup), or holds more keys than it was
+     *         sized for. Filters being (re)built by compaction or a rebuild
+     *         never need one.
+     */
+    bool needsFilterRebuild();
+    /// @return false if a rebuild is already in progress.
+    bool initRebuildFilter(
+            size_t key_count,
+            double probability,
+            BloomFilter::Type type = BloomFilter::Type::Standard);
+    void addToRebuildFilter(const DocKey& key);
+    /// Replace the main filter with the rebuilt one.
+    void swapRebuiltFilter();
+    void clearRebuildFilter();
+
     uint64_t nextHLCCas() {
         return hlc.nextHLC();
     }
@@ -819,6 +906,39 @@ public:
         return *manifest;
     }
 
+    /**
+     * @return the cache of items transformed for DCP streams of this
+     *         vBucket, or nullptr if the cache is disabled
+     *         (dcp_transformed_item_cache_size=0).
+     */
+    const std::shared_ptr<TransformedItemCache>& getTransformedItemCache()
+            const {
+        return transformedItemCache;
+    }
+
+    /// @return true if the expiry pager can use an index of this vBucket's
+    ///         items with an expiry time (exp_pager_use_index=true).
+    bool hasExpiryIndex() const {
+        return expiryIndex != nullptr;
+    }
+
+    /**
+     * Take the items which have expired at time `now` from the expiry
+     * index, adding them to `expired` to be deleted by
+     * KVBucket::deleteExpiredItems. Items which are no longer in the
+     * HashTable (full eviction) are added with just their metadata.
+     *
+     * @return the number of index entries taken.
+     */
+    size_t getExpiredItemsFromIndex(time_t now, std::list<Item>& expired);
+
+    /**
+     * Update the expiry index (if any) with the latest revision of a key,
+     * as stored in the HashTable or loaded at warmup.
+     */
+    void updateExpiryIndex(const StoredValue& v);
+    void updateExpiryIndex(const Item& item);
+
     void incrementCollectionDiskCount(const DocKey& key) {
         // Obtain caching read handle
         lockCollections(key).incrementDiskCount();
@@ -884,6 +1004,14 @@ public:
     HashTable::FindResult fetchPreparedValue(
             const Collections::VB::Manifest::CachingReadHandle& cHandle);
 
+    /**
+     * HashTable::findForWrite() on behalf of the given front-end cookie,
+     * recording the time taken to lock (and search) the key's hash bucket
+     * in the cookie's trace.
+     */
+    HashTable::FindResult tracedFindForWrite(const void* cookie,
+                                             const DocKey& key);
+
     /**
      * Complete the background fetch for the specified item. Depending on the
      * state of the item, restore it to the hashtable as appropriate,
@@ -957,6 +1085,66 @@ public:
             cb::StoreIfPredicate predicate,
             const Collections::VB::Manifest::CachingReadHandle& cHandle);
 
+    /**
+     * Increment or decrement the counter held by an existing document in
+     * place, by setting the new value under the same HashBucketLock as the
+     * old one is read (see EngineIface::arithmetic).
+     *
+     * Only a resident, committed, unlocked document whose value is neither
+     * compressed nor has xattrs is updated in place; for anything else
+     * not_supported is returned, and the caller should fall back to a get
+     * and a CAS set.
+     *
+     * @param cookie the connection cookie
+     * @param engine Reference to ep engine
+     * @param increment true to add delta to the counter, false to subtract
+     * @param delta the amount to change the counter by
+     * @param cas the CAS the document must have (0 for any)
+     * @param maxTtl the bucket's max TTL, applied as it is to a set
+     * @param cHandle Collections readhandle (caching mode) for this key
+     * @return the status and, if successful, the counter's new value and the
+     *         document's CAS, vbucket UUID and seqno
+     */
+    cb::EngineErrorArithmeticResult arithmetic(
+            const void* cookie,
+            EventuallyPersistentEngine& engine,
+            bool increment,
+            uint64_t delta,
+            uint64_t cas,
+            std::chrono::seconds maxTtl,
+            const Collections::VB::Manifest::CachingReadHandle& cHandle);
+
+    /**
+     * Append (or prepend) data to the value of an existing document in
+     * place, by setting the combined value under the same HashBucketLock as
+     * the old one is read (see EngineIface::append_prepend).
+     *
+     * As for arithmetic(), only a resident, committed, unlocked document
+     * whose value is neither compressed nor has xattrs is updated in place;
+     * for anything else ENGINE_ENOTSUP is returned, and the caller should
+     * fall back to a get and a CAS set.
+     *
+     * @param cookie the connection cookie
+     * @param engine Reference to ep engine
+     * @param append true to append value to the document, false to prepend
+     * @param value the data to add
+     * @param cas the CAS the document must have (0 for any); on success the
+     *        document's new CAS
+     * @param maxTtl the bucket's max TTL, applied as it is to a set
+     * @param cHandle Collections readhandle (caching mode) for this key
+     * @param mutInfo on success the vbucket UUID and seqno of the mutation
+     * @return ENGINE_SUCCESS if the document was updated
+     */
+    ENGINE_ERROR_CODE appendPrepend(
+            const void* cookie,
+            EventuallyPersistentEngine& engine,
+            bool append,
+            cb::const_char_buffer value,
+            uint64_t& cas,
+            std::chrono::seconds maxTtl,
+            const Collections::VB::Manifest::CachingReadHandle& cHandle,
+            mutation_descr_t& mutInfo);
+
     /**
      * Replace (overwrite existing) an item in the vbucket.
      *
@@ -1006,6 +1194,9 @@ public:
      * @param genBySeqno whether or not to generate sequence number
      * @param genCas
      * @param cHandle Collections readhandle (caching mode) for this key
+     * @param deferredBgFetches if non-null, a key whose metadata must be
+     *        fetched from disk is added to it instead of the fetch being
+     *        queued (see bgFetchMulti)
      *
      * @return the result of the store operation
      */
@@ -1019,7 +1210,8 @@ public:
             bool allowExisting,
             GenerateBySeqno genBySeqno,
             GenerateCas genCas,
-            const Collections::VB::Manifest::CachingReadHandle& cHandle);
+            const Collections::VB::Manifest::CachingReadHandle& cHandle,
+            std::vector<DocKey>* deferredBgFetches = nullptr);
 
     /**
      * Delete an item in the vbucket
@@ -1143,6 +1335,42 @@ public:
     virtual bool eligibleToPageOut(const HashTable::HashBucketLock& lh,
                                    const StoredValue& v) const = 0;
 
+    /**
+     * Evict up to maxItems cold items from the given (locked) hash chain.
+     * Used by front-end writes to free some memory from the chain they
+     * already hold, when memory usage is above the proactive eviction
+     * threshold.
+     *
+     * The default does nothing: Ephemeral buckets can't evict without
+     * deleting the document, which isn't done from the write path.
+     *
+     * @param lh Bucket lock of the chain to evict from.
+     * @param written The item which was just written; it isn't evicted.
+     * @param maxItems Maximum number of items to evict.
+     * @return the number of items evicted.
+     */
+    virtual size_t evictColdItemsFromChain(const HashTable::HashBucketLock& lh,
+                                           const StoredValue& written,
+                                           size_t maxItems) {
+        return 0;
+    }
+
+    /**
+     * Serve those of the given BG fetches whose values a second-tier cache
+     * of ejected values still holds, making the values resident again
+     * without reading them from the KVStore.
+     *
+     * The default does nothing (there is no such cache).
+     *
+     * @param fetches The BG fetches of this vBucket; those served are
+     *        removed.
+     * @return The fetches served, with their values set.
+     */
+    virtual vb_bgfetch_queue_t fetchSpilledValues(
+            vb_bgfetch_queue_t& fetches) {
+        return {};
+    }
+
     /**
      * Add an item in the store
      *
@@ -1231,6 +1459,9 @@ public:
      * @param[out] deleted specifies the caller whether or not the key is
      *                     deleted
      * @param[out] datatype specifies the datatype of the item
+     * @param deferredBgFetches if non-null, the key is added to it if its
+     *        metadata must be fetched from disk, instead of the fetch being
+     *        queued (see bgFetchMulti)
      *
      * @return the result of the operation
      */
@@ -1240,7 +1471,23 @@ public:
             const Collections::VB::Manifest::CachingReadHandle& cHandle,
             ItemMetaData& metadata,
             uint32_t& deleted,
-            uint8_t& datatype);
+            uint8_t& datatype,
+            std::vector<DocKey>* deferredBgFetches = nullptr);
+
+    /**
+     * Enqueue background fetches for a batch of keys, waking the BgFetcher
+     * once they are all queued so that they are read from disk together.
+     *
+     * @param keys the keys to be bg fetched
+     * @param cookie the cookie of the requestor (notified once per key)
+     * @param engine Reference to ep engine
+     * @param isMeta whether the fetches are for non-resident values or
+     *               metadata of (possibly) deleted items
+     */
+    virtual void bgFetchMulti(const std::vector<DocKey>& keys,
+                              const void* cookie,
+                              EventuallyPersistentEngine& engine,
+                              bool isMeta) = 0;
 
     /**
      * Looks up the key stats for the given {vbucket, key}.
@@ -1300,6 +1547,20 @@ public:
             const Collections::VB::Manifest::CachingReadHandle& cHandle,
             const void* cookie = nullptr);
 
+    /**
+     * Commit a batch of pending Sync Writes, in the given order. Equivalent
+     * to calling commit() (with a generated commit seqno) for each of them,
+     * except that the collections manifest is locked once for the whole
+     * batch and the Flusher and DCP are notified once, after the last
+     * commit, instead of once per commit.
+     *
+     * @param commits The SyncWrites to commit
+     * @return ENGINE_SUCCESS, or the error of the first commit which failed
+     *     (in which case the commits before it have been applied, and the
+     *     ones after it haven't)
+     */
+    ENGINE_ERROR_CODE commitBatch(const std::vector<PendingCommit>& commits);
+
     /**
      * Perform an abort against the given pending Sync Write.
      *
@@ -1470,6 +1731,26 @@ public:
      */
     static void setMutationMemoryThreshold(size_t memThreshold);
 
+    /**
+     * Set the memory threshold (as a percentage of the bucket quota) above
+     * which front-end writes evict cold items from the hash chain they
+     * wrote to. Same across all the vbuckets.
+     *
+     * @param memThreshold Threshold between 0 and 100; 0 disables proactive
+     *        eviction
+     */
+    static void setProactiveEvictionThreshold(size_t memThreshold);
+
+    /// Set the maximum number of items a single write may evict.
+    static void setProactiveEvictionMaxItems(size_t maxItems);
+
+    /**
+     * Set the largest extension (in seconds) of an item's expiry time which
+     * a touch leaves unapplied (see touch_coalesce_window); 0 applies every
+     * change. Same across all the vbuckets.
+     */
+    static void setTouchCoalesceWindow(size_t seconds);
+
     /**
      * Check if this StoredValue has become logically non-existent.
      * By logically non-existent, the item has been deleted
@@ -1558,6 +1839,12 @@ public:
     };
 
 protected:
+    /**
+     * Can a touch changing an item's expiry time from current to requested be
+     * left unapplied (see touch_coalesce_window)?
+     */
+    static bool canCoalesceTouch(time_t current, time_t requested, time_t now);
+
     /**
      * This function checks for the various states of the value & depending on
      * which the calling function can issue a bgfetch as needed.
@@ -1719,6 +2006,38 @@ protected:
     TempAddStatus addTempStoredValue(const HashTable::HashBucketLock& hbl,
                                      const DocKey& key);
 
+    /**
+     * Adds a temporary StoredValue for a key whose metadata must be fetched
+     * from disk, deferring the fetch to the caller (see bgFetchMulti).
+     * Assumes that HT bucket lock is grabbed.
+     *
+     * @param hbl Hash table bucket lock that must be held
+     * @param key the key to be bg fetched
+     * @param deferredBgFetches the key is added to it if the temporary item
+     *        was added
+     *
+     * @return ENGINE_EWOULDBLOCK, or ENGINE_ENOMEM if there isn't memory for
+     *         the temporary item
+     */
+    ENGINE_ERROR_CODE addTempItemAndDeferBGFetch(
+            const HashTable::HashBucketLock& hbl,
+            const DocKey& key,
+            std::vector<DocKey>& deferredBgFetches);
+
+    /**
+     * Add a fully evicted item back to the HashTable (as a non-resident
+     * item) from the metadata kept in the HashTable's EvictedMetaIndex, in
+     * place of a metadata-only background fetch.
+     * Assumes that HT bucket lock is grabbed.
+     *
+     * @param hbl Hash table bucket lock that must be held
+     * @param key the key, which isn't in the HashTable
+     * @return the restored StoredValue, or nullptr if the key's metadata
+     *         isn't indexed (or there's no memory to restore it)
+     */
+    StoredValue* restoreEvictedMeta(const HashTable::HashBucketLock& hbl,
+                                    const DocKey& key);
+
     /**
      * Internal wrapper function around the callback to be called when a new
      * seqno is generated in the vbucket.
@@ -1807,6 +2126,17 @@ protected:
             UseActiveVBMemThreshold useActiveVBMemThrehsold =
                     UseActiveVBMemThreshold::No);
 
+    /**
+     * Called by a front-end write (with the chain still locked) once it has
+     * stored its item: if memory usage is above the proactive eviction
+     * threshold, evict a few cold items from the same chain.
+     *
+     * @param hbl Lock of the chain the item was written to
+     * @param written The StoredValue which was written
+     */
+    void maybeEvictColdItems(const HashTable::HashBucketLock& hbl,
+                             const StoredValue& written);
+
     void _addStats(bool details, const AddStatFn& add_stat, const void* c);
 
     template <typename T>
@@ -1824,6 +2154,9 @@ protected:
     /* last seqno that is persisted on the disk */
     std::atomic<uint64_t> persistenceSeqno;
 
+    /* See setFlushSupersededPercent() */
+    std::atomic<size_t> flushSupersededPercent{0};
+
     /* holds all high priority async requests to the vbucket */
     std::list<HighPriorityVBEntry> hpVBReqs;
 
@@ -1960,6 +2293,19 @@ private:
                           uint64_t bySeqno,
                           DeleteSource deleteSource) = 0;
 
+    /**
+     * Find the pending item for key and commit it, without notifying the
+     * Flusher / DCP or updating the collection stats; the common part of
+     * commit() and commitBatch().
+     *
+     * @param notify [out] Information on who should be notified of the commit
+     * @return ENGINE_KEY_ENOENT / ENGINE_EINVAL if there is no pending item
+     *     for key
+     */
+    ENGINE_ERROR_CODE commitPending(const DocKey& key,
+                                    boost::optional<int64_t> commitSeqno,
+                                    VBNotifyCtx& notify);
+
     /**
      * Commit the given pending item; removing any previous committed item with
      * the same key from in-memory structures.
@@ -2155,6 +2501,7 @@ private:
     std::mutex bfMutex;
     std::unique_ptr<BloomFilter> bFilter;
     std::unique_ptr<BloomFilter> tempFilter;    // Used during compaction.
+    std::unique_ptr<BloomFilter> rebuildFilter; // Used during a rebuild.
 
     std::atomic<uint64_t> rollbackItemCount;
 
@@ -2189,6 +2536,9 @@ private:
      */
     SeqnoAckCallback seqnoAckCb;
 
+    /// Callback invoked at Active when a tracked SyncWrite will time out
+    SyncWriteTimeoutCallback syncWriteTimeoutCb;
+
     /// The VBucket collection state
     std::unique_ptr<Collections::VB::Manifest> manifest;
 
@@ -2199,6 +2549,14 @@ private:
      */
     std::atomic<bool> mayContainXattrs;
 
+    /// Items transformed for this vBucket's DCP streams; shared with them
+    /// so it outlives the VBucket if a stream does.
+    std::shared_ptr<TransformedItemCache> transformedItemCache;
+
+    /// The keys of this vBucket with an expiry time, by expiry time; only
+    /// used by the expiry pager (nullptr unless exp_pager_use_index=true).
+    std::unique_ptr<ExpiryIndex> expiryIndex;
+
     /// Tracks SyncWrites and determines when they should be committed /
     /// aborted.
     std::unique_ptr<DurabilityMonitor> durabilityMonitor;
@@ -2214,6 +2572,11 @@ private:
 
     static double mutationMemThreshold;
 
+    static std::atomic<size_t> proactiveEvictionThreshold;
+    static std::atomic<size_t> proactiveEvictionMaxItems;
+
+    static std::atomic<size_t> touchCoalesceWindow;
+
     friend class DurabilityMonitorTest;
     friend class SingleThreadedActiveStreamTest;
     friend class VBucketTestBase;
@@ -43,6 +43,7 @@ void vbucket_state::reset() {
     failovers.clear();
     supportsNamespaces = true;
     replicationTopology.clear();
+    preparesStartSeqno = 0;
 }
 
 void to_json(nlohmann::json& json, const vbucket_state& vbs) {
@@ -72,6 +73,9 @@ void to_json(nlohmann::json& json, const vbucket_state& vbs) {
     if (!vbs.replicationTopology.empty()) {
         json["replication_topology"] = vbs.replicationTopology;
     }
+    if (vbs.preparesStartSeqno != 0) {
+        json["prepares_start_seqno"] = std::to_string(vbs.preparesStartSeqno);
+    }
 }
 
 void from_json(const nlohmann::json& j, vbucket_state& vbs) {
@@ -100,4 +104,9 @@ void from_json(const nlohmann::json& j, vbucket_state& vbs) {
     if (topologyIt != j.end()) {
         vbs.replicationTopology = *topologyIt;
     }
+
+    auto preparesIt = j.find("prepares_start_seqno");
+    if (preparesIt != j.end()) {
+        vbs.preparesStartSeqno = std::stoull(preparesIt->get<std::string>());
+    }
 }
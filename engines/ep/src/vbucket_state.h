@@ -103,6 +103,14 @@ struct vbucket_state {
      * First GA'd in 6.5
      */
     nlohmann::json replicationTopology;
+
+    /**
+     * The seqno warmup must scan from to find every prepared SyncWrite which
+     * has no persisted Commit or Abort - the lowest such prepare's seqno, or
+     * one past the persisted high seqno if there are none. 0 (scan the
+     * whole vBucket) if unknown.
+     */
+    uint64_t preparesStartSeqno = 0;
 };
 
 /// Method to allow nlohmann::json to convert vbucket_state to JSON.
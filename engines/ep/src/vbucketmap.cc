@@ -71,6 +71,17 @@ void VBucketMap::dropVBucketAndSetupDeferredDeletion(Vbid id,
     }
 }
 
+std::vector<VBucketPtr> VBucketMap::detachAllBuckets() {
+    std::vector<VBucketPtr> rv;
+    for (size_t i = 0; i < size; ++i) {
+        auto vb = getShardByVbId(Vbid(i))->detachBucket(Vbid(i));
+        if (vb) {
+            rv.push_back(std::move(vb));
+        }
+    }
+    return rv;
+}
+
 std::vector<Vbid> VBucketMap::getBuckets(void) const {
     std::vector<Vbid> rv;
     for (size_t i = 0; i < size; ++i) {
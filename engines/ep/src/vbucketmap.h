@@ -72,6 +72,15 @@ public:
      *        when the deletion task is completed.
      */
     void dropVBucketAndSetupDeferredDeletion(Vbid id, const void* cookie);
+
+    /**
+     * Drop every vbucket from the map (the bucket is shutting down).
+     *
+     * @return the VBuckets which were in the map; each is deleted once the
+     *         last reference to it is released
+     */
+    std::vector<VBucketPtr> detachAllBuckets();
+
     VBucketPtr getBucket(Vbid id) const;
 
     // Returns the size of the map, i.e. the total number of VBuckets it can
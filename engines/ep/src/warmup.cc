@@ -27,6 +27,7 @@
 #include "ep_engine.h"
 #include "ep_vb.h"
 #include "failover-table.h"
+#include "hash_table_snapshot.h"
 #include "item.h"
 #include "mutation_log.h"
 #include "statwriter.h"
@@ -39,6 +40,7 @@
 #include <platform/timeutils.h>
 #include <utilities/logtags.h>
 
+#include <algorithm>
 #include <array>
 #include <limits>
 #include <memory>
@@ -196,15 +198,22 @@ private:
 
 class WarmupEstimateDatabaseItemCount : public GlobalTask {
 public:
-    WarmupEstimateDatabaseItemCount(EPBucket& st, uint16_t sh, Warmup* w)
+    WarmupEstimateDatabaseItemCount(EPBucket& st,
+                                    uint16_t sh,
+                                    size_t taskIndex,
+                                    Warmup* w)
         : GlobalTask(&st.getEPEngine(),
                      TaskId::WarmupEstimateDatabaseItemCount,
                      0,
                      false),
           _shardId(sh),
+          _taskIndex(taskIndex),
           _warmup(w),
           _description("Warmup - estimate item count: shard " +
-                       std::to_string(_shardId)) {
+                       std::to_string(_shardId) +
+                       (w->loadTasksPerShard > 1
+                                ? " task " + std::to_string(_taskIndex)
+                                : "")) {
         _warmup->addToTaskSet(uid);
     }
 
@@ -220,13 +229,14 @@ public:
 
     bool run() override {
         TRACE_EVENT0("ep-engine/task", "WarpupEstimateDatabaseItemCount");
-        _warmup->estimateDatabaseItemCount(_shardId);
+        _warmup->estimateDatabaseItemCount(_shardId, _taskIndex);
         _warmup->removeFromTaskSet(uid);
         return false;
     }
 
 private:
     uint16_t _shardId;
+    size_t _taskIndex;
     Warmup* _warmup;
     const std::string _description;
 };
@@ -239,12 +249,17 @@ class WarmupLoadPreparedSyncWrites : public GlobalTask {
 public:
     WarmupLoadPreparedSyncWrites(EventuallyPersistentEngine* engine,
                                  uint16_t shard,
+                                 size_t taskIndex,
                                  Warmup& warmup)
         : GlobalTask(engine, TaskId::WarmupLoadPreparedSyncWrites, 0, false),
           shardId(shard),
+          taskIndex(taskIndex),
           warmup(warmup),
           description("Warmup - loading prepared SyncWrites: shard " +
-                      std::to_string(shardId)){};
+                      std::to_string(shardId) +
+                      (warmup.loadTasksPerShard > 1
+                               ? " task " + std::to_string(taskIndex)
+                               : "")){};
 
     std::string getDescription() override {
         return description;
@@ -263,13 +278,14 @@ public:
                      "WarmupLoadPreparedSyncWrites",
                      "shard",
                      shardId);
-        warmup.loadPreparedSyncWrites(shardId);
+        warmup.loadPreparedSyncWrites(shardId, taskIndex);
         warmup.removeFromTaskSet(uid);
         return false;
     }
 
 private:
     uint16_t shardId;
+    size_t taskIndex;
     Warmup& warmup;
     const std::string description;
 };
@@ -378,12 +394,16 @@ private:
 
 class WarmupLoadingKVPairs : public GlobalTask {
 public:
-    WarmupLoadingKVPairs(EPBucket& st, uint16_t sh, Warmup* w)
+    WarmupLoadingKVPairs(EPBucket& st, uint16_t sh, size_t taskIndex, Warmup* w)
         : GlobalTask(&st.getEPEngine(), TaskId::WarmupLoadingKVPairs, 0, false),
           _shardId(sh),
+          _taskIndex(taskIndex),
           _warmup(w),
           _description("Warmup - loading KV Pairs: shard " +
-                       std::to_string(_shardId)) {
+                       std::to_string(_shardId) +
+                       (w->loadTasksPerShard > 1
+                                ? " task " + std::to_string(_taskIndex)
+                                : "")) {
         _warmup->addToTaskSet(uid);
     }
 
@@ -402,25 +422,30 @@ public:
 
     bool run() override {
         TRACE_EVENT0("ep-engine/task", "WarmupLoadingKVPairs");
-        _warmup->loadKVPairsforShard(_shardId);
+        _warmup->loadKVPairsforShard(_shardId, _taskIndex);
         _warmup->removeFromTaskSet(uid);
         return false;
     }
 
 private:
     uint16_t _shardId;
+    size_t _taskIndex;
     Warmup* _warmup;
     const std::string _description;
 };
 
 class WarmupLoadingData : public GlobalTask {
 public:
-    WarmupLoadingData(EPBucket& st, uint16_t sh, Warmup* w)
+    WarmupLoadingData(EPBucket& st, uint16_t sh, size_t taskIndex, Warmup* w)
         : GlobalTask(&st.getEPEngine(), TaskId::WarmupLoadingData, 0, false),
           _shardId(sh),
+          _taskIndex(taskIndex),
           _warmup(w),
           _description("Warmup - loading data: shard " +
-                       std::to_string(_shardId)) {
+                       std::to_string(_shardId) +
+                       (w->loadTasksPerShard > 1
+                                ? " task " + std::to_string(_taskIndex)
+                                : "")) {
         _warmup->addToTaskSet(uid);
     }
 
@@ -439,32 +464,40 @@ public:
 
     bool run() override {
         TRACE_EVENT0("ep-engine/task", "WarmupLoadingData");
-        _warmup->loadDataforShard(_shardId);
+        _warmup->loadDataforShard(_shardId, _taskIndex);
         _warmup->removeFromTaskSet(uid);
         return false;
     }
 
 private:
     uint16_t _shardId;
+    size_t _taskIndex;
     Warmup* _warmup;
     const std::string _description;
 };
 
 class WarmupLoadingCollectionCounts : public GlobalTask {
 public:
-    WarmupLoadingCollectionCounts(EPBucket& st, uint16_t sh, Warmup& w)
+    WarmupLoadingCollectionCounts(EPBucket& st,
+                                  uint16_t sh,
+                                  size_t taskIndex,
+                                  Warmup& w)
         : GlobalTask(&st.getEPEngine(),
                      TaskId::WarmupLoadingCollectionCounts,
                      0,
                      false),
           shardId(sh),
+          taskIndex(taskIndex),
           warmup(w) {
         warmup.addToTaskSet(uid);
     }
 
     std::string getDescription() override {
         return "Warmup - loading collection counts: shard " +
-               std::to_string(shardId);
+               std::to_string(shardId) +
+               (warmup.loadTasksPerShard > 1
+                        ? " task " + std::to_string(taskIndex)
+                        : "");
     }
 
     std::chrono::microseconds maxExpectedDuration() override {
@@ -475,13 +508,14 @@ public:
 
     bool run() override {
         TRACE_EVENT0("ep-engine/task", "WarmupLoadingCollectionCounts");
-        warmup.loadCollectionStatsForShard(shardId);
+        warmup.loadCollectionStatsForShard(shardId, taskIndex);
         warmup.removeFromTaskSet(uid);
         return false;
     }
 
 private:
     uint16_t shardId;
+    size_t taskIndex;
     Warmup& warmup;
 };
 
@@ -532,7 +566,8 @@ static bool batchWarmupCallback(Vbid vbId,
             bg_itm_ctx.bgfetched_list.back()->value = &bg_itm_ctx.value;
         }
 
-        c->epstore->getROUnderlying(vbId)->getMulti(vbId, items2fetch);
+        c->epstore->getROUnderlying(vbId)->getMultiSequential(vbId,
+                                                              items2fetch);
 
         // applyItem controls the  mode this loop operates in.
         // true we will attempt the callback (attempt a HashTable insert)
@@ -710,8 +745,13 @@ void LoadStorageKVPairCallback::callback(GetValue &val) {
                 return;
             }
 
-            const auto res =
-                    epVb->insertFromWarmup(*i, shouldEject(), val.isPartial());
+            // A vBucket already serving traffic has the latest version of
+            // each key in memory, so only restore values evicted there.
+            const auto res = epVb->insertFromWarmup(
+                    *i,
+                    shouldEject(),
+                    val.isPartial(),
+                    epstore.getWarmup()->isVBucketWarmedUp(vb->getId()));
             switch (res) {
             case MutationStatus::NoMem:
                 if (retry == 2) {
@@ -872,7 +912,16 @@ Warmup::Warmup(EPBucket& st, Configuration& config_)
     : store(st),
       config(config_),
       shardVbStates(store.vbMap.getNumShards()),
-      shardVbIds(store.vbMap.getNumShards()) {
+      shardVbIds(store.vbMap.getNumShards()),
+      vbLoadStates(store.vbMap.getSize()),
+      earlyVBucketTraffic(config_.isWarmupEarlyVbucketTraffic()),
+      vbWarmedUp(store.vbMap.getSize()) {
+    for (auto& vbState : vbLoadStates) {
+        vbState = VBLoadState::Pending;
+    }
+    for (auto& warmedUp : vbWarmedUp) {
+        warmedUp = false;
+    }
 }
 
 Warmup::~Warmup() = default;
@@ -1006,6 +1055,8 @@ void Warmup::createVBuckets(uint16_t shardId) {
                                    vbs.hlcCasEpochSeqno,
                                    vbs.mightContainXattrs,
                                    vbs.replicationTopology);
+            // Until loadPreparedSyncWrites indexes the prepares on disk
+            static_cast<EPVBucket&>(*vb).setOnDiskPreparesKnown(false);
 
             if(vbs.state == vbucket_state_active && !cleanShutdown) {
                 if (static_cast<uint64_t>(vbs.highSeqno) == vbs.lastSnapEnd) {
@@ -1077,19 +1128,24 @@ void Warmup::scheduleEstimateDatabaseItemCount()
     threadtask_count = 0;
     estimateTime.store(std::chrono::steady_clock::duration::zero());
     estimatedItemCount = 0;
+    initLoadTasksPerShard();
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
-        ExTask task = std::make_shared<WarmupEstimateDatabaseItemCount>(
-                store, i, this);
-        ExecutorPool::get()->schedule(task);
+        for (size_t t = 0; t < loadTasksPerShard; t++) {
+            ExTask task = std::make_shared<WarmupEstimateDatabaseItemCount>(
+                    store, i, t, this);
+            ExecutorPool::get()->schedule(task);
+        }
     }
 }
 
-void Warmup::estimateDatabaseItemCount(uint16_t shardId)
+void Warmup::estimateDatabaseItemCount(uint16_t shardId, size_t taskIndex)
 {
     auto st = std::chrono::steady_clock::now();
     size_t item_count = 0;
 
-    for (const auto vbid : shardVbIds[shardId]) {
+    const auto& vbIds = shardVbIds[shardId];
+    for (size_t i = taskIndex; i < vbIds.size(); i += loadTasksPerShard) {
+        const auto vbid = vbIds[i];
         size_t vbItemCount = store.getROUnderlyingByShard(shardId)->
                                                         getItemCount(vbid);
         VBucketPtr vb = store.getVBucket(vbid);
@@ -1102,22 +1158,28 @@ void Warmup::estimateDatabaseItemCount(uint16_t shardId)
     estimatedItemCount.fetch_add(item_count);
     estimateTime.fetch_add(std::chrono::steady_clock::now() - st);
 
-    if (++threadtask_count == store.vbMap.getNumShards()) {
+    if (++threadtask_count ==
+        store.vbMap.getNumShards() * loadTasksPerShard) {
         transition(WarmupState::State::LoadPreparedSyncWrites);
     }
 }
 
 void Warmup::scheduleLoadPreparedSyncWrites() {
     threadtask_count = 0;
+    initLoadTasksPerShard();
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
-        ExTask task = std::make_shared<WarmupLoadPreparedSyncWrites>(
-                &store.getEPEngine(), i, *this);
-        ExecutorPool::get()->schedule(task);
+        for (size_t t = 0; t < loadTasksPerShard; t++) {
+            ExTask task = std::make_shared<WarmupLoadPreparedSyncWrites>(
+                    &store.getEPEngine(), i, t, *this);
+            ExecutorPool::get()->schedule(task);
+        }
     }
 }
 
-void Warmup::loadPreparedSyncWrites(uint16_t shardId) {
-    // Perform an in-order scan of the seqno index.
+void Warmup::loadPreparedSyncWrites(uint16_t shardId, size_t taskIndex) {
+    // Perform an in-order scan of the seqno index, from the lowest seqno of
+    // a prepare which had no Commit or Abort persisted when the vBucket was
+    // last flushed (vbucket_state::preparesStartSeqno).
     // a) For each Prepared item found, add to the Durability Monitor and
     //    HashTable.
     // b) For each Committed (via Mutation or Prepare) item, if a prepared
@@ -1126,7 +1188,7 @@ void Warmup::loadPreparedSyncWrites(uint16_t shardId) {
     //
     // At the end of the scan, all in-flight Prepared items (which did not
     // have a Commit persisted to disk) will be registered with the Durability
-    // Monitor.
+    // Monitor, and the vBucket's index of them rebuilt.
 
     /// Disk load callback for scan.
     struct LoadSyncWrites : public StatusCallback<GetValue> {
@@ -1138,6 +1200,7 @@ void Warmup::loadPreparedSyncWrites(uint16_t shardId) {
                 // Pending item which was not aborted (deleted). Load into
                 // VBucket.
                 queued_item qi(val.item.release());
+                vb.loadOnDiskPrepare(*qi);
                 const auto res = vb.insertFromWarmup(*qi,
                                                      /*shouldEject*/ false,
                                                      /*keyMetaDataOnly*/ false);
@@ -1154,6 +1217,7 @@ void Warmup::loadPreparedSyncWrites(uint16_t shardId) {
                     return;
                 }
 
+                vb.loadOnDiskPrepare(*val.item);
                 vb.ht.commit(prepared.lock, *prepared.storedValue);
             }
         }
@@ -1161,21 +1225,28 @@ void Warmup::loadPreparedSyncWrites(uint16_t shardId) {
         EPVBucket& vb;
     };
 
-    for (const auto vbid : shardVbIds[shardId]) {
+    const auto& vbIds = shardVbIds[shardId];
+    for (size_t i = taskIndex; i < vbIds.size(); i += loadTasksPerShard) {
+        const auto vbid = vbIds[i];
         auto vb = store.getVBucket(vbid);
         auto& epVb = dynamic_cast<EPVBucket&>(*vb);
 
+        // All earlier prepares were committed or aborted. (0 if written by a
+        // version without the index, or after a rollback.)
+        const auto& vbs = shardVbStates[shardId].at(vbid);
+        const uint64_t startSeqno = vbs.preparesStartSeqno;
+        if (startSeqno > uint64_t(vbs.highSeqno)) {
+            // No outstanding prepares
+            epVb.setOnDiskPreparesKnown(true);
+            continue;
+        }
+
         auto storageCB = std::make_shared<LoadSyncWrites>(epVb);
 
         // Don't expect to find anything already in the HashTable, so use
         // NoLookupCallback.
         auto cacheCB = std::make_shared<NoLookupCallback>();
 
-        // @todo-durability: We can optimise this by starting the scan at the
-        // high_committed_seqno - all earlier prepares would have been committed
-        // (or were aborted).
-        uint64_t startSeqno = 0;
-
         auto valFilter = getValueFilterForCompressionMode(
                 store.getEPEngine().getCompressionMode());
 
@@ -1192,9 +1263,11 @@ void Warmup::loadPreparedSyncWrites(uint16_t shardId) {
         Expects(scanResult == scan_success);
 
         kvStore->destroyScanContext(scanCtx);
+        epVb.setOnDiskPreparesKnown(true);
     }
 
-    if (++threadtask_count == store.vbMap.getNumShards()) {
+    if (++threadtask_count ==
+        store.vbMap.getNumShards() * loadTasksPerShard) {
         if (store.getItemEvictionPolicy() == EvictionPolicy::Value) {
             transition(WarmupState::State::KeyDump);
         } else {
@@ -1221,6 +1294,20 @@ void Warmup::keyDumpforShard(uint16_t shardId)
     auto cl = std::make_shared<NoLookupCallback>();
 
     for (const auto vbid : shardVbIds[shardId]) {
+        bool loadedFromSnapshot = false;
+        if (config.isWarmupHashTableSnapshot()) {
+            loadedFromSnapshot = loadHashTableSnapshot(vbid, *cb);
+            if (cb->getStatus() == ENGINE_ENOMEM) {
+                break;
+            }
+        }
+        // A snapshot is only valid for the shutdown it was written at.
+        remove(HashTableSnapshot::getPath(config.getDbname(), vbid).c_str());
+        if (loadedFromSnapshot) {
+            setVBucketWarmedUp(vbid);
+            continue;
+        }
+
         ScanContext* ctx = kvstore->initScanContext(cb, cl, vbid, 0,
                                                     DocumentFilter::NO_DELETES,
                                                     ValueFilter::KEYS_ONLY);
@@ -1231,6 +1318,9 @@ void Warmup::keyDumpforShard(uint16_t shardId)
                 // skip loading remaining VBuckets as memory limit was reached
                 break;
             }
+            if (errorCode == scan_success) {
+                setVBucketWarmedUp(vbid);
+            }
         }
     }
 
@@ -1239,6 +1329,34 @@ void Warmup::keyDumpforShard(uint16_t shardId)
     }
 }
 
+bool Warmup::loadHashTableSnapshot(Vbid vbid,
+                                   LoadStorageKVPairCallback& cb) {
+    auto vb = store.getVBucket(vbid);
+    if (!vb) {
+        return false;
+    }
+
+    const auto path = HashTableSnapshot::getPath(config.getDbname(), vbid);
+    if (!cb::io::isFile(path)) {
+        return false;
+    }
+
+    const bool loaded = HashTableSnapshot::load(
+            path,
+            vbid,
+            vb->getHighSeqno(),
+            vb->failovers->getLatestUUID(),
+            [&cb](std::unique_ptr<Item> item) {
+                GetValue gv(std::move(item), ENGINE_SUCCESS, -1, true);
+                cb.callback(gv);
+                return cb.getStatus() != ENGINE_ENOMEM;
+            });
+    if (loaded) {
+        ++snapshotLoadedVBuckets;
+    }
+    return loaded;
+}
+
 void Warmup::scheduleCheckForAccessLog()
 {
     ExTask task = std::make_shared<WarmupCheckforAccessLog>(store, this);
@@ -1399,11 +1517,14 @@ void Warmup::scheduleLoadingKVPairs()
     setEstimatedWarmupCount(estimatedItemCount);
 
     threadtask_count = 0;
+    initLoadTasksPerShard();
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
-        ExTask task = std::make_shared<WarmupLoadingKVPairs>(store, i, this);
-        ExecutorPool::get()->schedule(task);
+        for (size_t t = 0; t < loadTasksPerShard; t++) {
+            ExTask task =
+                    std::make_shared<WarmupLoadingKVPairs>(store, i, t, this);
+            ExecutorPool::get()->schedule(task);
+        }
     }
-
 }
 
 ValueFilter getValueFilterForCompressionMode(
@@ -1416,38 +1537,69 @@ ValueFilter getValueFilterForCompressionMode(
     return ValueFilter::VALUES_DECOMPRESSED;
 }
 
-void Warmup::loadKVPairsforShard(uint16_t shardId)
-{
-    bool maybe_enable_traffic = false;
-    scan_error_t errorCode = scan_success;
+void Warmup::initLoadTasksPerShard() {
+    const size_t numShards = store.vbMap.getNumShards();
+    const size_t maxPerShard =
+            std::max(size_t(1), ExecutorPool::get()->getNumReaders() / numShards);
+    loadTasksPerShard = std::min(config.getWarmupTasksPerShard(), maxPerShard);
 
-    if (store.getItemEvictionPolicy() == EvictionPolicy::Full) {
-        maybe_enable_traffic = true;
+    for (auto& vbState : vbLoadStates) {
+        vbState = VBLoadState::Pending;
     }
+}
 
+void Warmup::loadVBucketsForShard(
+        uint16_t shardId,
+        size_t taskIndex,
+        std::shared_ptr<StatusCallback<GetValue>> cb,
+        std::shared_ptr<StatusCallback<CacheLookup>> cl) {
     KVStore* kvstore = store.getROUnderlyingByShard(shardId);
-    auto cb = std::make_shared<LoadStorageKVPairCallback>(
-            store, maybe_enable_traffic, state.getState());
-    auto cl =
-            std::make_shared<LoadValueCallback>(store.vbMap, state.getState());
 
     ValueFilter valFilter = getValueFilterForCompressionMode(
                                     store.getEPEngine().getCompressionMode());
 
-    for (const auto vbid : shardVbIds[shardId]) {
+    const auto& vbIds = shardVbIds[shardId];
+    for (size_t i = taskIndex; i < vbIds.size(); i += loadTasksPerShard) {
+        const auto vbid = vbIds[i];
+        auto& vbState = vbLoadStates[vbid.get()];
+        vbState = VBLoadState::Loading;
         ScanContext* ctx = kvstore->initScanContext(cb, cl, vbid, 0,
                                                     DocumentFilter::NO_DELETES,
                                                     valFilter);
         if (ctx) {
-            errorCode = kvstore->scan(ctx);
+            scan_error_t errorCode = kvstore->scan(ctx);
             kvstore->destroyScanContext(ctx);
             if (errorCode == scan_again) { // ENGINE_ENOMEM
                 // skip loading remaining VBuckets as memory limit was reached
+                vbState = VBLoadState::Pending;
                 break;
             }
+            // For full eviction this is the vBucket's first load of its keys
+            if (errorCode == scan_success) {
+                setVBucketWarmedUp(vbid);
+            }
         }
+        vbState = VBLoadState::Done;
     }
-    if (++threadtask_count == store.vbMap.getNumShards()) {
+}
+
+void Warmup::loadKVPairsforShard(uint16_t shardId, size_t taskIndex)
+{
+    bool maybe_enable_traffic = false;
+
+    if (store.getItemEvictionPolicy() == EvictionPolicy::Full) {
+        maybe_enable_traffic = true;
+    }
+
+    auto cb = std::make_shared<LoadStorageKVPairCallback>(
+            store, maybe_enable_traffic, state.getState());
+    auto cl =
+            std::make_shared<LoadValueCallback>(store.vbMap, state.getState());
+
+    loadVBucketsForShard(shardId, taskIndex, cb, cl);
+
+    if (++threadtask_count ==
+        store.vbMap.getNumShards() * loadTasksPerShard) {
         transition(WarmupState::State::Done);
     }
 }
@@ -1458,60 +1610,52 @@ void Warmup::scheduleLoadingData()
     setEstimatedWarmupCount(estimatedCount);
 
     threadtask_count = 0;
+    initLoadTasksPerShard();
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
-        ExTask task = std::make_shared<WarmupLoadingData>(store, i, this);
-        ExecutorPool::get()->schedule(task);
+        for (size_t t = 0; t < loadTasksPerShard; t++) {
+            ExTask task =
+                    std::make_shared<WarmupLoadingData>(store, i, t, this);
+            ExecutorPool::get()->schedule(task);
+        }
     }
 }
 
 void Warmup::scheduleLoadingCollectionCounts() {
     threadtask_count = 0;
+    initLoadTasksPerShard();
     for (size_t i = 0; i < store.vbMap.shards.size(); i++) {
-        ExTask task = std::make_shared<WarmupLoadingCollectionCounts>(
-                store, i, *this);
-        ExecutorPool::get()->schedule(task);
+        for (size_t t = 0; t < loadTasksPerShard; t++) {
+            ExTask task = std::make_shared<WarmupLoadingCollectionCounts>(
+                    store, i, t, *this);
+            ExecutorPool::get()->schedule(task);
+        }
     }
 }
 
-void Warmup::loadDataforShard(uint16_t shardId)
+void Warmup::loadDataforShard(uint16_t shardId, size_t taskIndex)
 {
-    scan_error_t errorCode = scan_success;
-
-    KVStore* kvstore = store.getROUnderlyingByShard(shardId);
     auto cb = std::make_shared<LoadStorageKVPairCallback>(
             store, true, state.getState());
     auto cl =
             std::make_shared<LoadValueCallback>(store.vbMap, state.getState());
 
-    ValueFilter valFilter = getValueFilterForCompressionMode(
-                                          store.getEPEngine().getCompressionMode());
+    loadVBucketsForShard(shardId, taskIndex, cb, cl);
 
-    for (const auto vbid : shardVbIds[shardId]) {
-        ScanContext* ctx = kvstore->initScanContext(cb, cl, vbid, 0,
-                                                    DocumentFilter::NO_DELETES,
-                                                    valFilter);
-        if (ctx) {
-            errorCode = kvstore->scan(ctx);
-            kvstore->destroyScanContext(ctx);
-            if (errorCode == scan_again) { // ENGINE_ENOMEM
-                // skip loading remaining VBuckets as memory limit was reached
-                break;
-            }
-        }
-    }
-
-    if (++threadtask_count == store.vbMap.getNumShards()) {
+    if (++threadtask_count ==
+        store.vbMap.getNumShards() * loadTasksPerShard) {
         transition(WarmupState::State::Done);
     }
 }
 
-void Warmup::loadCollectionStatsForShard(uint16_t shardId) {
+void Warmup::loadCollectionStatsForShard(uint16_t shardId, size_t taskIndex) {
     // get each VB in the shard and iterate its collections manifest
     // load the _local doc count value
 
     KVStore* kvstore = store.getROUnderlyingByShard(shardId);
-    // Iterate the VBs in the shard
-    for (const auto vbid : shardVbIds[shardId]) {
+    // Iterate the task's share of the VBs in the shard
+    const auto& vbIds = shardVbIds[shardId];
+    for (size_t i = taskIndex; i < vbIds.size(); i += loadTasksPerShard) {
+        const auto vbid = vbIds[i];
         auto vb = store.getVBucket(vbid);
         if (!vb) {
             continue;
@@ -1531,7 +1675,8 @@ void Warmup::loadCollectionStatsForShard(uint16_t shardId) {
         }
     }
 
-    if (++threadtask_count == store.vbMap.getNumShards()) {
+    if (++threadtask_count ==
+        store.vbMap.getNumShards() * loadTasksPerShard) {
         transition(WarmupState::State::EstimateDatabaseItemCount);
     }
 }
@@ -1676,6 +1821,45 @@ void Warmup::addStats(const AddStatFn& add_stat, const void* c) const {
     } else {
         addStat("estimated_value_count", warmupCount, add_stat, c);
     }
+
+    // Per-vBucket progress of loading data (for those vBuckets being loaded
+    // right now), plus totals.
+    size_t vbsLoading = 0;
+    size_t vbsLoaded = 0;
+    for (size_t vb = 0; vb < vbLoadStates.size(); ++vb) {
+        switch (vbLoadStates[vb].load()) {
+        case VBLoadState::Pending:
+            break;
+        case VBLoadState::Loading:
+            ++vbsLoading;
+            addStat(("vb_" + std::to_string(vb)).c_str(),
+                    "loading",
+                    add_stat,
+                    c);
+            break;
+        case VBLoadState::Done:
+            ++vbsLoaded;
+            break;
+        }
+    }
+    addStat("vbuckets_loading", vbsLoading, add_stat, c);
+    addStat("vbuckets_loaded", vbsLoaded, add_stat, c);
+    addStat("snapshot_vbuckets", snapshotLoadedVBuckets.load(), add_stat, c);
+    addStat("vbuckets_warmed_up",
+            std::count(vbWarmedUp.begin(), vbWarmedUp.end(), true),
+            add_stat,
+            c);
+}
+
+bool Warmup::isVBucketWarmedUp(Vbid vbid) const {
+    return isComplete() ||
+           (vbid.get() < vbWarmedUp.size() && vbWarmedUp[vbid.get()]);
+}
+
+void Warmup::setVBucketWarmedUp(Vbid vbid) {
+    if (earlyVBucketTraffic) {
+        vbWarmedUp[vbid.get()] = true;
+    }
 }
 
 /* In the case of CouchKVStore, all vbucket states of all the shards
@@ -1732,6 +1916,17 @@ void Warmup::populateShardVbStates()
             activeVBs.pop_back();
         }
 
+        // If vBuckets serve traffic as soon as they're loaded, load all of
+        // the actives (the only ones serving front-end traffic) first.
+        if (earlyVBucketTraffic) {
+            shardVbIds[i].insert(
+                    shardVbIds[i].end(), activeVBs.rbegin(), activeVBs.rend());
+            shardVbIds[i].insert(shardVbIds[i].end(),
+                                 replicaVBs.rbegin(),
+                                 replicaVBs.rend());
+            continue;
+        }
+
         // Now the VB lottery can begin.
         // Generate a psudeo random, weighted list of active/replica vbuckets.
         // The random seed is the shard ID so that re-running warmup
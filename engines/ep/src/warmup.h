@@ -36,6 +36,7 @@ class Configuration;
 class EPStats;
 class EPBucket;
 class GetValue;
+class LoadStorageKVPairCallback;
 class MutationLog;
 class VBucketMap;
 class Vbid;
@@ -173,6 +174,12 @@ public:
 
     size_t getEstimatedItemCount() const;
 
+    /// @return the number of vBuckets whose keys were loaded from a
+    ///         HashTableSnapshot.
+    size_t getSnapshotLoadedVBuckets() const {
+        return snapshotLoadedVBuckets;
+    }
+
     void addStats(const AddStatFn& add_stat, const void* c) const;
 
     std::chrono::steady_clock::duration getTime() {
@@ -193,6 +200,15 @@ public:
         return warmupComplete.load();
     }
 
+    /**
+     * @return true if the given vBucket can serve front-end traffic: warmup
+     *         is complete, or (with warmup_early_vbucket_traffic) has loaded
+     *         the vBucket's keys (value eviction) or its keys and values
+     *         (full eviction). Any values still to be loaded are fetched
+     *         from disk as for an evicted item.
+     */
+    bool isVBucketWarmedUp(Vbid vbid) const;
+
     bool setComplete() {
         bool inverse = false;
         return warmupComplete.compare_exchange_strong(inverse, true);
@@ -257,24 +273,27 @@ private:
 
     /**
      * Loads the persisted per-collection document count for each vBucket in
-     * the given shard.
+     * the given task's share of the given shard.
      */
-    void loadCollectionStatsForShard(uint16_t shardId);
+    void loadCollectionStatsForShard(uint16_t shardId, size_t taskIndex);
 
     /**
-     * Loads the item count of each vBucket from disk for the given shardId:
+     * Loads the item count of each vBucket from disk for the given task's
+     * share of the given shard:
      * - Reads the item count from disk and sets VBucket::numTotalItems
      * - Updates Warmup::estimatedItemCount with the estimated total items
      *   needed for warmup.
      */
-    void estimateDatabaseItemCount(uint16_t shardId);
+    void estimateDatabaseItemCount(uint16_t shardId, size_t taskIndex);
 
     /**
-     * Loads all prepared SyncWrites for each vBucket in the given shard
-     * - Performs a KVStore scan against the DurabilityPrepare namespace,
-     *   loading all found documents into memory.
+     * Loads all prepared SyncWrites for each vBucket in the given task's
+     * share of the given shard
+     * - Performs a KVStore scan from the vBucket's persisted
+     *   preparesStartSeqno (skipped if there are no outstanding prepares),
+     *   loading all prepares found which have no later Commit into memory.
      */
-    void loadPreparedSyncWrites(uint16_t shardId);
+    void loadPreparedSyncWrites(uint16_t shardId, size_t taskIndex);
 
     /**
      * [Value-eviction only]
@@ -282,6 +301,15 @@ private:
      */
     void keyDumpforShard(uint16_t shardId);
 
+    /**
+     * Load the given vBucket's keys from the HashTableSnapshot written at the
+     * last clean shutdown, if there is one and it matches what's on disk.
+     *
+     * @return true if the vBucket was loaded from the snapshot; false if it
+     *         must be loaded from disk.
+     */
+    bool loadHashTableSnapshot(Vbid vbid, LoadStorageKVPairCallback& cb);
+
     /**
      * Checks for the existance of an access log file for each shard:
      * - Checks if traffic should be enabled (i.e. enough data already
@@ -302,15 +330,40 @@ private:
 
     /**
      * [Full-eviction only]
-     * Loads both keys and values into memory for each vBucket in the given
-     * shard.
+     * Loads both keys and values into memory for the given task's share of
+     * the vBuckets in the given shard.
+     */
+    void loadKVPairsforShard(uint16_t shardId, size_t taskIndex);
+
+    /**
+     * Loads values into memory for the given task's share of the vBuckets in
+     * the given shard.
+     */
+    void loadDataforShard(uint16_t shardId, size_t taskIndex);
+
+    /**
+     * Scan the given task's share of the vBuckets in the given shard - every
+     * loadTasksPerShard'th vBucket starting at taskIndex, so each task keeps
+     * the shard's (active first) priority order - with the given callbacks.
+     */
+    void loadVBucketsForShard(uint16_t shardId,
+                              size_t taskIndex,
+                              std::shared_ptr<StatusCallback<GetValue>> cb,
+                              std::shared_ptr<StatusCallback<CacheLookup>> cl);
+
+    /**
+     * Set loadTasksPerShard for a phase which splits each shard's vBuckets
+     * between several tasks: warmup_tasks_per_shard, limited so the total
+     * number of tasks doesn't exceed the number of reader threads. Also
+     * resets the per-vBucket load progress.
      */
-    void loadKVPairsforShard(uint16_t shardId);
+    void initLoadTasksPerShard();
 
     /**
-     * Loads values into memory for each vBucket in the given shard.
+     * Mark the given vBucket as having been loaded, so that (with
+     * warmup_early_vbucket_traffic) it can serve traffic.
      */
-    void loadDataforShard(uint16_t shardId);
+    void setVBucketWarmedUp(Vbid vbid);
 
     /* Terminal state of warmup. Updates statistics and marks warmup as
      * completed
@@ -360,6 +413,22 @@ private:
     std::vector<std::map<Vbid, vbucket_state>> shardVbStates;
     std::atomic<size_t> threadtask_count{0};
 
+    /// Number of tasks loading each shard in the current phase.
+    size_t loadTasksPerShard{1};
+
+    /// Progress of loading each vBucket's data (LoadingKVPairs/LoadingData).
+    enum class VBLoadState : uint8_t { Pending, Loading, Done };
+    std::vector<std::atomic<VBLoadState>> vbLoadStates;
+
+    /// Whether vBuckets serve traffic as soon as they're loaded.
+    const bool earlyVBucketTraffic;
+    /// Which vBuckets have been loaded, and so can serve traffic before
+    /// warmup completes (only set if earlyVBucketTraffic).
+    std::vector<std::atomic<bool>> vbWarmedUp;
+
+    /// Number of vBuckets whose keys were loaded from a HashTableSnapshot.
+    std::atomic<size_t> snapshotLoadedVBuckets{0};
+
     /// vector of vectors of VBucket IDs (one vector per shard). Each vector
     /// contains all vBucket IDs which are present for the given shard.
     std::vector<std::vector<Vbid>> shardVbIds;
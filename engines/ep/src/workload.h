@@ -17,7 +17,7 @@
 #pragma once
 
 #include <atomic>
-
+#include <chrono>
 #include <string>
 
 enum bucket_priority_t {
@@ -60,7 +60,11 @@ public:
     }
 
     std::string stringOfWorkLoadPattern(void) {
-        switch (workloadPattern.load()) {
+        return stringOfWorkLoadPattern(workloadPattern.load());
+    }
+
+    static std::string stringOfWorkLoadPattern(workload_pattern_t pattern) {
+        switch (pattern) {
         case READ_HEAVY:
             return "read_heavy";
         case WRITE_HEAVY:
@@ -74,6 +78,27 @@ public:
         workloadPattern.store(pattern);
     }
 
+    /**
+     * Classify the IO workload from how long the reader tasks (BG fetches)
+     * and the writer tasks (flushers) recently waited to run: it's read
+     * (write) heavy if the reader (writer) tasks waited for at least
+     * `threshold`, and for more than twice as long as the writer (reader)
+     * tasks - i.e. a writer (reader) thread would be better used as a
+     * reader (writer) thread.
+     */
+    static workload_pattern_t patternFromQueueWaits(
+            std::chrono::microseconds readerWait,
+            std::chrono::microseconds writerWait,
+            std::chrono::microseconds threshold) {
+        if (readerWait >= threshold && readerWait > 2 * writerWait) {
+            return READ_HEAVY;
+        }
+        if (writerWait >= threshold && writerWait > 2 * readerWait) {
+            return WRITE_HEAVY;
+        }
+        return MIXED;
+    }
+
 private:
 
     int maxNumWorkers;
@@ -5287,6 +5287,145 @@ static enum test_result test_multiple_transactions(EngineIface* h) {
     return SUCCESS;
 }
 
+// Check that with flusher_batch_delay set, the flush of a vBucket with few
+// outstanding items is deferred, with all items still persisted.
+static enum test_result test_flusher_batch_delay(EngineIface* h) {
+    const int numItems = 10;
+    for (int j = 0; j < numItems; ++j) {
+        const auto key = "key-" + std::to_string(j);
+        checkeq(ENGINE_SUCCESS,
+                store(h, nullptr, OPERATION_SET, key.c_str(), "value"),
+                "Failed to store a value");
+    }
+    wait_for_stat_to_be(h, "ep_total_persisted", numItems);
+    checklt(0,
+            get_int_stat(h, "ep_flusher_deferrals"),
+            "Expected at least one flush to be deferred");
+    checkeq(numItems,
+            get_int_stat(h, "ep_commit_items"),
+            "Expected all items to be committed");
+    return SUCCESS;
+}
+
+// Check that with flusher_concurrency set, the items of many vBuckets of a
+// shard are all persisted when they're flushed concurrently.
+static enum test_result test_flusher_concurrency(EngineIface* h) {
+    const int numVbs = 16;
+    const int numItems = 10;
+    for (int vb = 1; vb < numVbs; ++vb) {
+        check(set_vbucket_state(h, Vbid(vb), vbucket_state_active),
+              "Failed to set vbucket state.");
+    }
+    for (int vb = 0; vb < numVbs; ++vb) {
+        for (int j = 0; j < numItems; ++j) {
+            const auto key = "key-" + std::to_string(j);
+            checkeq(ENGINE_SUCCESS,
+                    store(h,
+                          nullptr,
+                          OPERATION_SET,
+                          key.c_str(),
+                          "value",
+                          nullptr,
+                          0,
+                          Vbid(vb)),
+                    "Failed to store a value");
+        }
+    }
+    wait_for_stat_to_be(h, "ep_total_persisted", numVbs * numItems);
+    checkeq(numVbs * numItems,
+            get_int_stat(h, "ep_commit_items"),
+            "Expected all items to be committed");
+    return SUCCESS;
+}
+
+// Check that with flusher_hot_key_delay set, a vBucket whose flushes are
+// mostly superseded updates of a hot key is deferred, and the latest value
+// of the key is still persisted.
+static enum test_result test_flusher_hot_key_delay(EngineIface* h) {
+    const int numUpdates = 100;
+    for (int j = 0; j < numUpdates; ++j) {
+        const auto value = "value-" + std::to_string(j);
+        checkeq(ENGINE_SUCCESS,
+                store(h, nullptr, OPERATION_SET, "hot", value.c_str()),
+                "Failed to store a value");
+        if (j % 10 == 0) {
+            wait_for_flusher_to_settle(h);
+        }
+    }
+    wait_for_flusher_to_settle(h);
+    checklt(0,
+            get_int_stat(h, "ep_flusher_superseded_items"),
+            "Expected superseded updates not to be written");
+    checkgt(numUpdates,
+            get_int_stat(h, "ep_commit_items"),
+            "Expected fewer items committed than updates made");
+
+    // The last value written must be the one persisted.
+    testHarness->reload_engine(&h,
+                               testHarness->engine_path,
+                               testHarness->get_current_testcase()->cfg,
+                               true,
+                               false);
+    wait_for_warmup_complete(h);
+    check_key_value(h, "hot", "value-99", 8);
+    return SUCCESS;
+}
+
+// Check that with flusher_vbstate_delay set, a vBucket state change with no
+// data to go with it isn't committed on its own: it is written by the
+// vBucket's next data flush, or at the latest at shutdown.
+static enum test_result test_flusher_vbstate_delay(EngineIface* h) {
+    // Creating a vBucket is never deferred.
+    check(set_vbucket_state(h, Vbid(1), vbucket_state_active),
+          "Failed to set vbucket state.");
+    check(set_vbucket_state(h, Vbid(2), vbucket_state_active),
+          "Failed to set vbucket state.");
+    wait_for_flusher_to_settle(h);
+    checkeq(0,
+            get_int_stat(h, "ep_flusher_vbstate_deferrals"),
+            "Expected vbucket creation not to be deferred");
+
+    check(set_vbucket_state(h, Vbid(1), vbucket_state_replica),
+          "Failed to set vbucket state.");
+    wait_for_stat_to_be(h, "ep_flusher_vbstate_deferrals", 1);
+    check(set_vbucket_state(h, Vbid(1), vbucket_state_active),
+          "Failed to set vbucket state.");
+    wait_for_stat_to_be(h, "ep_flusher_vbstate_deferrals", 2);
+    check(set_vbucket_state(h, Vbid(2), vbucket_state_replica),
+          "Failed to set vbucket state.");
+    wait_for_stat_to_be(h, "ep_flusher_vbstate_deferrals", 3);
+
+    // A data flush of vb:1 writes its state along with the item.
+    checkeq(ENGINE_SUCCESS,
+            store(h,
+                  nullptr,
+                  OPERATION_SET,
+                  "key",
+                  "value",
+                  nullptr,
+                  0,
+                  Vbid(1)),
+            "Failed to store a value");
+    wait_for_flusher_to_settle(h);
+    checkeq(1,
+            get_int_stat(h, "ep_flusher_vbstate_folded"),
+            "Expected vb:1's state to be written by its data flush");
+
+    // vb:2's state is still deferred; shutdown commits it.
+    testHarness->reload_engine(&h,
+                               testHarness->engine_path,
+                               testHarness->get_current_testcase()->cfg,
+                               true,
+                               false);
+    wait_for_warmup_complete(h);
+    check(verify_vbucket_state(h, Vbid(1), vbucket_state_active),
+          "Expected vb:1 to be active");
+    check(verify_vbucket_state(h, Vbid(2), vbucket_state_replica),
+          "Expected vb:2 to be replica");
+    check_key_value(h, "key", "value", 5, Vbid(1));
+    return SUCCESS;
+}
+
 static enum test_result test_set_ret_meta(EngineIface* h) {
     // Check that set without cas succeeds
     checkeq(ENGINE_SUCCESS,
@@ -6380,6 +6519,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "ro_0:failure_open",
                 "ro_0:io_compaction_read_bytes",
                 "ro_0:io_compaction_write_bytes",
+                "ro_0:io_flusher_write_bytes",
                 "ro_0:io_bg_fetch_docs_read",
                 "ro_0:io_num_write",
                 "ro_0:io_bg_fetch_doc_bytes",
@@ -6395,6 +6535,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "ro_1:failure_open",
                 "ro_1:io_compaction_read_bytes",
                 "ro_1:io_compaction_write_bytes",
+                "ro_1:io_flusher_write_bytes",
                 "ro_1:io_bg_fetch_docs_read",
                 "ro_1:io_num_write",
                 "ro_1:io_bg_fetch_doc_bytes",
@@ -6410,6 +6551,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "ro_2:failure_open",
                 "ro_2:io_compaction_read_bytes",
                 "ro_2:io_compaction_write_bytes",
+                "ro_2:io_flusher_write_bytes",
                 "ro_2:io_bg_fetch_docs_read",
                 "ro_2:io_num_write",
                 "ro_2:io_bg_fetch_doc_bytes",
@@ -6425,6 +6567,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "ro_3:failure_open",
                 "ro_3:io_compaction_read_bytes",
                 "ro_3:io_compaction_write_bytes",
+                "ro_3:io_flusher_write_bytes",
                 "ro_3:io_bg_fetch_docs_read",
                 "ro_3:io_num_write",
                 "ro_3:io_bg_fetch_doc_bytes",
@@ -6438,6 +6581,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
     std::vector<std::string> rwKVStoreStats = {
                 "rw_0:backend_type",
                 "rw_0:close",
+                "rw_0:compaction_catchup_items",
                 "rw_0:failure_compaction",
                 "rw_0:failure_del",
                 "rw_0:failure_get",
@@ -6446,6 +6590,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "rw_0:failure_vbset",
                 "rw_0:io_compaction_read_bytes",
                 "rw_0:io_compaction_write_bytes",
+                "rw_0:io_flusher_write_bytes",
                 "rw_0:io_bg_fetch_docs_read",
                 "rw_0:io_num_write",
                 "rw_0:io_bg_fetch_doc_bytes",
@@ -6457,6 +6602,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "rw_0:open",
                 "rw_1:backend_type",
                 "rw_1:close",
+                "rw_1:compaction_catchup_items",
                 "rw_1:failure_compaction",
                 "rw_1:failure_del",
                 "rw_1:failure_get",
@@ -6465,6 +6611,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "rw_1:failure_vbset",
                 "rw_1:io_compaction_read_bytes",
                 "rw_1:io_compaction_write_bytes",
+                "rw_1:io_flusher_write_bytes",
                 "rw_1:io_bg_fetch_docs_read",
                 "rw_1:io_num_write",
                 "rw_1:io_bg_fetch_doc_bytes",
@@ -6476,6 +6623,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "rw_1:open",
                 "rw_2:backend_type",
                 "rw_2:close",
+                "rw_2:compaction_catchup_items",
                 "rw_2:failure_compaction",
                 "rw_2:failure_del",
                 "rw_2:failure_get",
@@ -6484,6 +6632,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "rw_2:failure_vbset",
                 "rw_2:io_compaction_read_bytes",
                 "rw_2:io_compaction_write_bytes",
+                "rw_2:io_flusher_write_bytes",
                 "rw_2:io_bg_fetch_docs_read",
                 "rw_2:io_num_write",
                 "rw_2:io_bg_fetch_doc_bytes",
@@ -6495,6 +6644,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "rw_2:open",
                 "rw_3:backend_type",
                 "rw_3:close",
+                "rw_3:compaction_catchup_items",
                 "rw_3:failure_compaction",
                 "rw_3:failure_del",
                 "rw_3:failure_get",
@@ -6503,6 +6653,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                 "rw_3:failure_vbset",
                 "rw_3:io_compaction_read_bytes",
                 "rw_3:io_compaction_write_bytes",
+                "rw_3:io_flusher_write_bytes",
                 "rw_3:io_bg_fetch_docs_read",
                 "rw_3:io_num_write",
                 "rw_3:io_bg_fetch_doc_bytes",
@@ -6525,6 +6676,13 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
     if (backend == "couchdb") {
         kvstats.insert(kvstats.end(), roKVStoreStats.begin(),
                        roKVStoreStats.end());
+        for (const auto* store : {"ro_", "rw_"}) {
+            for (int shard = 0; shard < 4; ++shard) {
+                const auto prefix = store + std::to_string(shard);
+                kvstats.push_back(prefix + ":read_handle_cache_hits");
+                kvstats.push_back(prefix + ":read_handle_cache_misses");
+            }
+        }
     }
 
     std::map<std::string, std::vector<std::string> > statsKeys{
@@ -6535,7 +6693,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "chk_items",
               "estimate"}},
             {"dcp",
-             {"ep_dcp_count",
+             {"ep_dcp_compression_num_skipped",
+              "ep_dcp_count",
               "ep_dcp_dead_conn_count",
               "ep_dcp_items_remaining",
               "ep_dcp_items_sent",
@@ -6545,7 +6704,9 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_dcp_queue_fill",
               "ep_dcp_total_bytes",
               "ep_dcp_total_uncompressed_data_size",
-              "ep_dcp_total_queue"}},
+              "ep_dcp_total_queue",
+              "ep_dcp_transformed_item_cache_hits",
+              "ep_dcp_transformed_item_cache_misses"}},
             {"hash",
              {"vb_0:counted",
               "vb_0:locks",
@@ -6653,17 +6814,22 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_bfilter_fp_prob",
               "ep_bfilter_key_count",
               "ep_bfilter_residency_threshold",
+              "ep_bfilter_type",
               "ep_bucket_type",
               "ep_cache_size",
+              "ep_chk_compress_values",
               "ep_chk_expel_enabled",
               "ep_chk_max_items",
               "ep_chk_period",
               "ep_chk_remover_stime",
+              "ep_collection_memory_share",
               "ep_collections_enabled",
               "ep_collections_max_size",
               "ep_compaction_exp_mem_threshold",
               "ep_compaction_write_queue_cap",
               "ep_compression_mode",
+              "ep_compression_sample_interval",
+              "ep_compression_skip_threshold",
               "ep_config_file",
               "ep_conflict_resolution_type",
               "ep_connection_manager_interval",
@@ -6675,11 +6841,14 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_data_traffic_enabled",
               "ep_dbname",
               "ep_dcp_backfill_byte_limit",
+              "ep_dcp_backfill_collection_scan_ratio",
+              "ep_dcp_backfill_concurrency",
               "ep_dcp_conn_buffer_size",
               "ep_dcp_conn_buffer_size_aggr_mem_threshold",
               "ep_dcp_conn_buffer_size_aggressive_perc",
               "ep_dcp_conn_buffer_size_max",
               "ep_dcp_conn_buffer_size_perc",
+              "ep_dcp_conn_notifier_linger_time",
               "ep_dcp_enable_noop",
               "ep_dcp_ephemeral_backfill_type",
               "ep_dcp_flow_control_policy",
@@ -6691,38 +6860,75 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_dcp_producer_snapshot_marker_yield_limit",
               "ep_dcp_consumer_process_buffered_messages_yield_limit",
               "ep_dcp_consumer_process_buffered_messages_batch_size",
+              "ep_dcp_consumer_process_buffered_messages_concurrency",
               "ep_dcp_scan_byte_limit",
               "ep_dcp_scan_item_limit",
               "ep_dcp_takeover_max_time",
+              "ep_dcp_transformed_item_cache_size",
               "ep_defragmenter_age_threshold",
+              "ep_defragmenter_auto_enabled",
+              "ep_defragmenter_auto_max_chunk_duration",
+              "ep_defragmenter_auto_max_sleep",
+              "ep_defragmenter_auto_min_sleep",
+              "ep_defragmenter_auto_pid_d",
+              "ep_defragmenter_auto_pid_i",
+              "ep_defragmenter_auto_pid_p",
+              "ep_defragmenter_auto_target_fragmentation",
               "ep_defragmenter_chunk_duration",
               "ep_defragmenter_enabled",
               "ep_defragmenter_interval",
+              "ep_defragmenter_slab_aware",
               "ep_defragmenter_stored_value_age_threshold",
               "ep_disk_backfill_queue",
               "ep_durability_timeout_task_interval",
+              "ep_eviction_refetch_tracking_size",
               "ep_exp_pager_enabled",
               "ep_exp_pager_initial_run_time",
               "ep_exp_pager_stime",
+              "ep_exp_pager_use_index",
               "ep_failpartialwarmup",
+              "ep_flusher_batch_delay",
+              "ep_flusher_batch_min_items",
               "ep_flusher_batch_split_trigger",
+              "ep_flusher_concurrency",
+              "ep_flusher_hot_key_delay",
+              "ep_flusher_hot_key_percent",
+              "ep_flusher_vbstate_delay",
               "ep_fsync_after_every_n_bytes_written",
+              "ep_fsync_writeback_after_every_n_bytes_written",
               "ep_getl_default_timeout",
               "ep_getl_max_timeout",
               "ep_hlc_drift_ahead_threshold_us",
               "ep_hlc_drift_behind_threshold_us",
+              "ep_ht_evicted_meta_index_size",
+              "ep_ht_hash_algorithm",
+              "ep_ht_inline_values",
+              "ep_ht_key_prefix_compression",
+              "ep_ht_layout",
               "ep_ht_locks",
+              "ep_ht_resize_algo",
               "ep_ht_resize_interval",
+              "ep_ht_shared_reader_locks",
               "ep_ht_size",
+              "ep_ht_stored_value_arena",
               "ep_initfile",
+              "ep_io_threads_adaptive",
+              "ep_io_threads_adaptive_max",
+              "ep_io_threads_adaptive_min",
+              "ep_io_threads_adaptive_wait_threshold",
               "ep_item_compressor_chunk_duration",
+              "ep_item_compressor_hot_threshold",
               "ep_item_compressor_interval",
               "ep_item_eviction_age_percentage",
+              "ep_item_eviction_algorithm",
               "ep_item_eviction_freq_counter_age_threshold",
+              "ep_item_eviction_sample_size",
+              "ep_item_eviction_strategy",
               "ep_item_freq_decayer_chunk_duration",
               "ep_item_freq_decayer_percent",
               "ep_item_num_based_new_chk",
               "ep_keep_closed_chks",
+              "ep_lock_profile_sample_interval",
               "ep_magma_commit_point_every_batch",
               "ep_magma_commit_point_interval",
               "ep_magma_delete_frag_ratio",
@@ -6754,15 +6960,20 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_mem_used_merge_threshold_percent",
               "ep_min_compression_ratio",
               "ep_mutation_mem_threshold",
+              "ep_nonio_task_cpu_budget",
               "ep_num_auxio_threads",
               "ep_num_nonio_threads",
               "ep_num_reader_threads",
               "ep_num_writer_threads",
+              "ep_numa_affinity_enabled",
               "ep_pager_active_vb_pcnt",
               "ep_pager_sleep_time_ms",
               "ep_postInitfile",
+              "ep_proactive_eviction_max_items",
+              "ep_proactive_eviction_threshold",
               "ep_replication_throttle_cap_pcnt",
               "ep_replication_throttle_queue_cap",
+              "ep_replication_throttle_rate_based",
               "ep_replication_throttle_threshold",
               "ep_retain_erroneous_tombstones",
               "ep_rocksdb_options",
@@ -6780,13 +6991,20 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_rocksdb_uc_max_size_amplification_percent",
               "ep_scopes_max_size",
               "ep_time_synchronization",
+              "ep_touch_coalesce_window",
               "ep_uuid",
+              "ep_value_spill_cache_path",
+              "ep_value_spill_cache_size",
               "ep_vb0",
+              "ep_vbucket_teardown_threads",
               "ep_waitforwarmup",
               "ep_warmup",
               "ep_warmup_batch_size",
+              "ep_warmup_early_vbucket_traffic",
+              "ep_warmup_hash_table_snapshot",
               "ep_warmup_min_items_threshold",
               "ep_warmup_min_memory_threshold",
+              "ep_warmup_tasks_per_shard",
               "ep_xattr_enabled"}},
             {"workload",
              {"ep_workload:num_readers",
@@ -6825,6 +7043,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "curr_temp_items",
               "ep_access_scanner_last_runtime",
               "ep_access_scanner_num_items",
+              "ep_access_scanner_num_vbs_reused",
               "ep_access_scanner_task_time",
               "ep_active_ahead_exceptions",
               "ep_active_behind_exceptions",
@@ -6843,8 +7062,11 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_bfilter_enabled",
               "ep_bfilter_fp_prob",
               "ep_bfilter_key_count",
+              "ep_bfilter_rebuilds",
               "ep_bfilter_residency_threshold",
+              "ep_bfilter_type",
               "ep_bg_fetch_avg_read_amplification",
+              "ep_bg_fetch_coalesced",
               "ep_bg_fetched",
               "ep_bg_meta_fetched",
               "ep_bg_remaining_items",
@@ -6854,17 +7076,24 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_bucket_priority",
               "ep_bucket_type",
               "ep_cache_size",
+              "ep_checkpoint_compressed_bytes_saved",
+              "ep_chk_compress_values",
               "ep_chk_expel_enabled",
               "ep_chk_max_items",
               "ep_chk_period",
               "ep_chk_persistence_remains",
               "ep_chk_remover_stime",
               "ep_clock_cas_drift_threshold_exceeded",
+              "ep_collection_memory_share",
               "ep_collections_enabled",
               "ep_collections_max_size",
               "ep_compaction_exp_mem_threshold",
+              "ep_compaction_expiry_time",
+              "ep_compaction_throttled_time",
               "ep_compaction_write_queue_cap",
               "ep_compression_mode",
+              "ep_compression_sample_interval",
+              "ep_compression_skip_threshold",
               "ep_config_file",
               "ep_conflict_resolution_type",
               "ep_connection_manager_interval",
@@ -6882,12 +7111,16 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_data_traffic_enabled",
               "ep_dbname",
               "ep_dcp_backfill_byte_limit",
+              "ep_dcp_backfill_collection_scan_ratio",
+              "ep_dcp_backfill_concurrency",
               "ep_dcp_conn_buffer_size",
               "ep_dcp_conn_buffer_size_aggr_mem_threshold",
               "ep_dcp_conn_buffer_size_aggressive_perc",
               "ep_dcp_conn_buffer_size_max",
               "ep_dcp_conn_buffer_size_perc",
+              "ep_dcp_conn_notifier_linger_time",
               "ep_dcp_consumer_process_buffered_messages_batch_size",
+              "ep_dcp_consumer_process_buffered_messages_concurrency",
               "ep_dcp_consumer_process_buffered_messages_yield_limit",
               "ep_dcp_enable_noop",
               "ep_dcp_ephemeral_backfill_type",
@@ -6901,12 +7134,27 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_dcp_scan_byte_limit",
               "ep_dcp_scan_item_limit",
               "ep_dcp_takeover_max_time",
+              "ep_dcp_transformed_item_cache_size",
               "ep_defragmenter_age_threshold",
+              "ep_defragmenter_auto_enabled",
+              "ep_defragmenter_auto_max_chunk_duration",
+              "ep_defragmenter_auto_max_sleep",
+              "ep_defragmenter_auto_min_sleep",
+              "ep_defragmenter_auto_pid_d",
+              "ep_defragmenter_auto_pid_i",
+              "ep_defragmenter_auto_pid_p",
+              "ep_defragmenter_auto_target_fragmentation",
+              "ep_defragmenter_bytes_moved",
+              "ep_defragmenter_bytes_reclaimed",
               "ep_defragmenter_chunk_duration",
               "ep_defragmenter_enabled",
+              "ep_defragmenter_fragmentation",
+              "ep_defragmenter_intensity",
               "ep_defragmenter_interval",
               "ep_defragmenter_num_moved",
+              "ep_defragmenter_num_skipped",
               "ep_defragmenter_num_visited",
+              "ep_defragmenter_slab_aware",
               "ep_defragmenter_stored_value_age_threshold",
               "ep_defragmenter_sv_num_moved",
               "ep_degraded_mode",
@@ -6917,9 +7165,13 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_diskqueue_pending",
               "ep_disk_backfill_queue",
               "ep_durability_timeout_task_interval",
+              "ep_evicted_refetched",
+              "ep_eviction_recency_target",
+              "ep_eviction_refetch_tracking_size",
               "ep_exp_pager_enabled",
               "ep_exp_pager_initial_run_time",
               "ep_exp_pager_stime",
+              "ep_exp_pager_use_index",
               "ep_expired_access",
               "ep_expired_compactor",
               "ep_expired_pager",
@@ -6927,27 +7179,52 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_failpartialwarmup",
               "ep_flush_all",
               "ep_flush_duration_total",
+              "ep_flusher_batch_delay",
+              "ep_flusher_batch_min_items",
               "ep_flusher_batch_split_trigger",
+              "ep_flusher_concurrency",
+              "ep_flusher_hot_key_delay",
+              "ep_flusher_hot_key_percent",
+              "ep_flusher_vbstate_delay",
               "ep_fsync_after_every_n_bytes_written",
+              "ep_fsync_writeback_after_every_n_bytes_written",
               "ep_getl_default_timeout",
               "ep_getl_max_timeout",
               "ep_hlc_drift_ahead_threshold_us",
               "ep_hlc_drift_behind_threshold_us",
+              "ep_ht_evicted_meta_index_size",
+              "ep_ht_hash_algorithm",
+              "ep_ht_inline_values",
+              "ep_ht_key_prefix_compression",
+              "ep_ht_layout",
               "ep_ht_locks",
+              "ep_ht_resize_algo",
               "ep_ht_resize_interval",
+              "ep_ht_shared_reader_locks",
               "ep_ht_size",
+              "ep_ht_stored_value_arena",
               "ep_initfile",
               "ep_io_bg_fetch_read_count",
               "ep_io_compaction_read_bytes",
               "ep_io_compaction_write_bytes",
+              "ep_io_threads_adaptive",
+              "ep_io_threads_adaptive_max",
+              "ep_io_threads_adaptive_min",
+              "ep_io_threads_adaptive_wait_threshold",
               "ep_io_total_read_bytes",
               "ep_io_total_write_bytes",
               "ep_item_compressor_chunk_duration",
+              "ep_item_compressor_hot_threshold",
               "ep_item_compressor_interval",
               "ep_item_compressor_num_compressed",
+              "ep_item_compressor_num_skipped_hot",
+              "ep_item_compressor_num_skipped_incompressible",
               "ep_item_compressor_num_visited",
               "ep_item_eviction_age_percentage",
+              "ep_item_eviction_algorithm",
               "ep_item_eviction_freq_counter_age_threshold",
+              "ep_item_eviction_sample_size",
+              "ep_item_eviction_strategy",
               "ep_item_freq_decayer_chunk_duration",
               "ep_item_freq_decayer_percent",
               "ep_item_num",
@@ -6956,6 +7233,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_items_rm_from_checkpoints",
               "ep_keep_closed_chks",
               "ep_kv_size",
+              "ep_lock_profile_sample_interval",
               "ep_max_checkpoints",
               "ep_max_failover_entries",
               "ep_max_item_privileged_bytes",
@@ -6979,6 +7257,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_meta_data_memory",
               "ep_min_compression_ratio",
               "ep_mutation_mem_threshold",
+              "ep_nonio_task_cpu_budget",
               "ep_num_access_scanner_runs",
               "ep_num_access_scanner_skips",
               "ep_num_auxio_threads",
@@ -6988,6 +7267,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_num_non_resident",
               "ep_num_nonio_threads",
               "ep_num_not_my_vbuckets",
+              "ep_num_ops_append_prepend_in_place",
+              "ep_num_ops_arithmetic_in_place",
               "ep_num_ops_del_meta",
               "ep_num_ops_del_meta_res_fail",
               "ep_num_ops_del_ret_meta",
@@ -6996,11 +7277,14 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_num_ops_set_meta",
               "ep_num_ops_set_meta_res_fail",
               "ep_num_ops_set_ret_meta",
+              "ep_num_ops_touch_coalesced",
               "ep_num_pager_runs",
+              "ep_num_proactive_evictions",
               "ep_num_reader_threads",
               "ep_num_value_ejects",
               "ep_num_workers",
               "ep_num_writer_threads",
+              "ep_numa_affinity_enabled",
               "ep_magma_commit_point_every_batch",
               "ep_magma_commit_point_interval",
               "ep_magma_delete_frag_ratio",
@@ -7020,6 +7304,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_oom_errors",
               "ep_overhead",
               "ep_pager_active_vb_pcnt",
+              "ep_pager_items_evicted",
+              "ep_pager_items_visited",
               "ep_pager_sleep_time_ms",
               "ep_pending_compactions",
               "ep_pending_ops",
@@ -7028,6 +7314,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_pending_ops_total",
               "ep_persist_vbstate_total",
               "ep_postInitfile",
+              "ep_proactive_eviction_max_items",
+              "ep_proactive_eviction_threshold",
               "ep_queue_size",
               "ep_replica_ahead_exceptions",
               "ep_replica_behind_exceptions",
@@ -7041,8 +7329,11 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_replica_datatype_xattr",
               "ep_replica_hlc_drift",
               "ep_replica_hlc_drift_count",
+              "ep_replication_throttle_ack_rate",
               "ep_replication_throttle_cap_pcnt",
+              "ep_replication_throttle_deferred_acks",
               "ep_replication_throttle_queue_cap",
+              "ep_replication_throttle_rate_based",
               "ep_replication_throttle_threshold",
               "ep_retain_erroneous_tombstones",
               "ep_rocksdb_options",
@@ -7060,6 +7351,10 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_rocksdb_uc_max_size_amplification_percent",
               "ep_rollback_count",
               "ep_scopes_max_size",
+              "ep_spill_cache_bytes_written",
+              "ep_spill_cache_hits",
+              "ep_spill_cache_misses",
+              "ep_spill_cache_writes",
               "ep_startup_time",
               "ep_storage_age",
               "ep_storage_age_highwat",
@@ -7073,18 +7368,25 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
               "ep_total_del_items",
               "ep_total_enqueued",
               "ep_total_new_items",
+              "ep_touch_coalesce_window",
               "ep_uuid",
               "ep_value_size",
+              "ep_value_spill_cache_path",
+              "ep_value_spill_cache_size",
               "ep_vb0",
               "ep_vb_backfill_queue_size",
               "ep_vb_total",
               "ep_vbucket_del",
               "ep_vbucket_del_fail",
+              "ep_vbucket_teardown_threads",
               "ep_waitforwarmup",
               "ep_warmup",
               "ep_warmup_batch_size",
+              "ep_warmup_early_vbucket_traffic",
+              "ep_warmup_hash_table_snapshot",
               "ep_warmup_min_items_threshold",
               "ep_warmup_min_memory_threshold",
+              "ep_warmup_tasks_per_shard",
               "ep_workload_pattern",
               "ep_xattr_enabled",
               "mem_used",
@@ -7206,6 +7508,13 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                                                             "ep_flusher_todo"});
         eng_stats.insert(eng_stats.end(),
                          {"ep_commit_num",
+                          "ep_commit_items",
+                          "ep_commit_items_per_commit",
+                          "ep_flusher_deferrals",
+                          "ep_flusher_hot_key_deferrals",
+                          "ep_flusher_superseded_items",
+                          "ep_flusher_vbstate_deferrals",
+                          "ep_flusher_vbstate_folded",
                           "ep_commit_time",
                           "ep_commit_time_total",
                           "ep_item_begin_failed",
@@ -7220,12 +7529,32 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
         eng_stats.insert(eng_stats.end(),
                          {"ep_access_scanner_enabled",
                           "ep_alog_block_size",
+                          "ep_alog_max_items_per_sec",
                           "ep_alog_max_stored_items",
                           "ep_alog_path",
                           "ep_alog_resident_ratio_threshold",
+                          "ep_alog_residency_change_threshold",
                           "ep_alog_sleep_time",
                           "ep_alog_task_time",
-                          "ep_item_eviction_policy"});
+                          "ep_alog_write_buffer_size",
+                          "ep_backfill_drop_behind_size",
+                          "ep_backfill_readahead_size",
+                          "ep_bfilter_rebuild_interval",
+                          "ep_bgfetch_merge_gap",
+                          "ep_bgfetch_offset_order",
+                          "ep_compaction_bg_fetch_latency_threshold",
+                          "ep_compaction_drop_behind_size",
+                          "ep_compaction_max_bytes_per_sec",
+                          "ep_couchstore_block_cache_ratio",
+                          "ep_couchstore_collection_purge_ratio",
+                          "ep_couchstore_compaction_tail_items",
+                          "ep_couchstore_concurrent_compaction",
+                          "ep_couchstore_encryption_key_file",
+                          "ep_couchstore_read_handle_cache_size",
+                          "ep_couchstore_rollback_index_interval",
+                          "ep_item_eviction_policy",
+                          "ep_range_scan_max_bytes_per_sec",
+                          "ep_warmup_access_log_readahead_size"});
 
         // 'diskinfo and 'diskinfo detail' keys should be present now.
         statsKeys["diskinfo"] = {"ep_db_data_size", "ep_db_file_size"};
@@ -7253,12 +7582,32 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
         config_stats.insert(config_stats.end(),
                             {"ep_access_scanner_enabled",
                              "ep_alog_block_size",
+                             "ep_alog_max_items_per_sec",
                              "ep_alog_max_stored_items",
                              "ep_alog_path",
                              "ep_alog_resident_ratio_threshold",
+                             "ep_alog_residency_change_threshold",
                              "ep_alog_sleep_time",
                              "ep_alog_task_time",
-                             "ep_item_eviction_policy"});
+                             "ep_alog_write_buffer_size",
+                             "ep_backfill_drop_behind_size",
+                             "ep_backfill_readahead_size",
+                             "ep_bfilter_rebuild_interval",
+                             "ep_bgfetch_merge_gap",
+                             "ep_bgfetch_offset_order",
+                             "ep_compaction_bg_fetch_latency_threshold",
+                             "ep_compaction_drop_behind_size",
+                             "ep_compaction_max_bytes_per_sec",
+                             "ep_couchstore_block_cache_ratio",
+                             "ep_couchstore_collection_purge_ratio",
+                             "ep_couchstore_compaction_tail_items",
+                             "ep_couchstore_concurrent_compaction",
+                             "ep_couchstore_encryption_key_file",
+                             "ep_couchstore_read_handle_cache_size",
+                             "ep_couchstore_rollback_index_interval",
+                             "ep_item_eviction_policy",
+                             "ep_range_scan_max_bytes_per_sec",
+                             "ep_warmup_access_log_readahead_size"});
     }
 
     if (isEphemeralBucket(h)) {
@@ -7269,6 +7618,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                           "ep_ephemeral_metadata_purge_age",
                           "ep_ephemeral_metadata_purge_interval",
                           "ep_ephemeral_metadata_purge_stale_chunk_duration",
+                          "ep_ephemeral_restart_snapshot",
 
                           "vb_active_auto_delete_count",
                           "vb_active_ht_tombstone_purged_count",
@@ -7276,6 +7626,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                           "vb_active_seqlist_deleted_count",
                           "vb_active_seqlist_purged_count",
                           "vb_active_seqlist_read_range_count",
+                          "vb_active_seqlist_range_read_stale_count",
                           "vb_active_seqlist_stale_count",
                           "vb_active_seqlist_stale_value_bytes",
                           "vb_active_seqlist_stale_metadata_bytes",
@@ -7286,6 +7637,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                           "vb_replica_seqlist_deleted_count",
                           "vb_replica_seqlist_purged_count",
                           "vb_replica_seqlist_read_range_count",
+                          "vb_replica_seqlist_range_read_stale_count",
                           "vb_replica_seqlist_stale_count",
                           "vb_replica_seqlist_stale_value_bytes",
                           "vb_replica_seqlist_stale_metadata_bytes",
@@ -7296,6 +7648,7 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                           "vb_pending_seqlist_deleted_count",
                           "vb_pending_seqlist_purged_count",
                           "vb_pending_seqlist_read_range_count",
+                          "vb_pending_seqlist_range_read_stale_count",
                           "vb_pending_seqlist_stale_count",
                           "vb_pending_seqlist_stale_value_bytes",
                           "vb_pending_seqlist_stale_metadata_bytes"});
@@ -7312,6 +7665,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                            "vb_0:seqlist_range_read_begin",
                            "vb_0:seqlist_range_read_count",
                            "vb_0:seqlist_range_read_end",
+                           "vb_0:seqlist_range_read_stale_count",
+                           "vb_0:seqlist_range_reads",
                            "vb_0:seqlist_stale_count",
                            "vb_0:seqlist_stale_metadata_bytes",
                            "vb_0:seqlist_stale_value_bytes"});
@@ -7323,7 +7678,8 @@ static enum test_result test_mb19687_fixed(EngineIface* h) {
                  "ep_ephemeral_metadata_mark_stale_chunk_duration",
                  "ep_ephemeral_metadata_purge_age",
                  "ep_ephemeral_metadata_purge_interval",
-                 "ep_ephemeral_metadata_purge_stale_chunk_duration"});
+                 "ep_ephemeral_metadata_purge_stale_chunk_duration",
+                 "ep_ephemeral_restart_snapshot"});
     }
 
     // In addition to the exact stat keys above, we also use regex patterns
@@ -7438,6 +7794,14 @@ static enum test_result test_mb19687_variable(EngineIface* h) {
                      "ep_item_num",
                      "ep_kv_size",
                      "ep_max_size",
+                     "ep_mem_domain_backfill",
+                     "ep_mem_domain_blob",
+                     "ep_mem_domain_checkpoint",
+                     "ep_mem_domain_collections",
+                     "ep_mem_domain_connections",
+                     "ep_mem_domain_dcp",
+                     "ep_mem_domain_hashtable",
+                     "ep_mem_domain_other",
                      "ep_mem_high_wat",
                      "ep_mem_high_wat_percent",
                      "ep_mem_low_wat",
@@ -8322,6 +8686,34 @@ BaseTestCase testsuite_testcases[] = {
         // Transaction tests
         TestCase("multiple transactions", test_multiple_transactions,
                  test_setup, teardown, NULL, prepare_ep_bucket, cleanup),
+        TestCase("flusher batch delay",
+                 test_flusher_batch_delay,
+                 test_setup,
+                 teardown,
+                 "flusher_batch_delay=200",
+                 prepare_ep_bucket,
+                 cleanup),
+        TestCase("flusher concurrency",
+                 test_flusher_concurrency,
+                 test_setup,
+                 teardown,
+                 "flusher_concurrency=4;max_num_shards=1",
+                 prepare_ep_bucket,
+                 cleanup),
+        TestCase("flusher hot key delay",
+                 test_flusher_hot_key_delay,
+                 test_setup,
+                 teardown,
+                 "flusher_hot_key_delay=200",
+                 prepare_ep_bucket,
+                 cleanup),
+        TestCase("flusher vbstate delay",
+                 test_flusher_vbstate_delay,
+                 test_setup,
+                 teardown,
+                 "flusher_vbstate_delay=60000",
+                 prepare_ep_bucket,
+                 cleanup),
 
         // Returning meta tests
         TestCase("test set ret meta", test_set_ret_meta,
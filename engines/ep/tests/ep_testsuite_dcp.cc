@@ -1583,6 +1583,34 @@ static enum test_result test_dcp_consumer_flow_control_static(EngineIface* h) {
     return SUCCESS;
 }
 
+static enum test_result test_dcp_consumer_flow_control_bdp(EngineIface* h) {
+    const auto* cookie1 = testHarness->create_cookie();
+    const std::string name("unittest");
+    const uint32_t opaque = 0;
+    const uint32_t seqno = 0;
+    const uint32_t flags = 0;
+    const auto flow_ctl_buf_min = 10485760;
+    auto dcp = requireDcpIface(h);
+
+    checkeq(ENGINE_SUCCESS,
+            dcp->open(cookie1, opaque, seqno, flags, name),
+            "Failed dcp consumer open connection.");
+
+    /* New connections start at the min size, and haven't measured a round
+       trip time yet */
+    const auto stat_name("eq_dcpq:" + name + ":max_buffer_bytes");
+    checkeq(flow_ctl_buf_min,
+            get_int_stat(h, stat_name.c_str(), "dcp"),
+            "Flow Control Buffer Size not equal to min");
+    const auto rtt_stat_name("eq_dcpq:" + name + ":buffer_ack_rtt_us");
+    checkeq(0,
+            get_int_stat(h, rtt_stat_name.c_str(), "dcp"),
+            "Buffer ack RTT not zero");
+    testHarness->destroy_cookie(cookie1);
+
+    return SUCCESS;
+}
+
 static enum test_result test_dcp_consumer_flow_control_dynamic(EngineIface* h) {
     const auto* cookie1 = testHarness->create_cookie();
     const std::string name("unittest");
@@ -7118,6 +7146,8 @@ static enum test_result test_set_dcp_param(EngineIface* h) {
     func("dcp_consumer_process_buffered_messages_batch_size", 1000, true);
     func("dcp_consumer_process_buffered_messages_yield_limit", 0, false);
     func("dcp_consumer_process_buffered_messages_batch_size", 0, false);
+    func("dcp_conn_notifier_linger_time", 500, true);
+    func("dcp_conn_notifier_linger_time", 1000000, false);
     return SUCCESS;
 }
 
@@ -7159,6 +7189,10 @@ BaseTestCase testsuite_testcases[] = {
                  test_dcp_consumer_flow_control_aggressive,
                  test_setup, teardown, "dcp_flow_control_policy=aggressive",
                  prepare, cleanup),
+        TestCase("test dcp consumer flow control bdp",
+                 test_dcp_consumer_flow_control_bdp,
+                 test_setup, teardown, "dcp_flow_control_policy=bdp",
+                 prepare, cleanup),
         TestCase("test open producer", test_dcp_producer_open,
                  test_setup, teardown, nullptr, prepare, cleanup),
         TestCase("test open producer same cookie", test_dcp_producer_open_same_cookie,
@@ -23,6 +23,8 @@
 
 #include "linked_list.h"
 
+#include <boost/optional.hpp>
+
 #include <mutex>
 #include <vector>
 
@@ -46,18 +48,29 @@ public:
     }
 
     /// Expose the rangeReadLock for testing.
-    std::mutex& getRangeReadLock() {
+    folly::SharedMutex& getRangeReadLock() {
         return rangeReadLock;
     }
 
-    /* Register fake read range for testing */
+    /* Register fake read range for testing (replacing any previously
+       registered fake read range) */
     void registerFakeReadRange(seqno_t start, seqno_t end) {
         std::lock_guard<SpinLock> lh(rangeLock);
-        readRange = SeqRange(start, end);
+        if (fakeReadRange) {
+            **fakeReadRange = SeqRange(start, end);
+        } else {
+            fakeReadRange = addReadRange(lh, SeqRange(start, end));
+        }
     }
 
     void resetReadRange() {
         std::lock_guard<SpinLock> lh(rangeLock);
-        readRange.reset();
+        if (fakeReadRange) {
+            removeReadRange(lh, *fakeReadRange);
+            fakeReadRange.reset();
+        }
     }
+
+private:
+    boost::optional<ReadRanges::iterator> fakeReadRange;
 };
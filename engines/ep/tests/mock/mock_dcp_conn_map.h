@@ -53,7 +53,7 @@ public:
 
     /// return if the named handler exists for the vbid in the vbConns structure
     bool doesConnHandlerExist(Vbid vbid, const std::string& name) const {
-        const auto& list = vbConns[vbid.get()];
+        const auto& list = vbConns[vbid.get()]->conns;
         return std::find_if(
                        list.begin(),
                        list.end(),
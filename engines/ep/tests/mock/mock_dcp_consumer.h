@@ -49,6 +49,22 @@ public:
         notifyVbucketReady(vbid);
     }
 
+    bool public_startProcessingVBucket(Vbid vbid) {
+        return startProcessingVBucket(vbid);
+    }
+
+    void public_finishProcessingVBucket(Vbid vbid) {
+        finishProcessingVBucket(vbid);
+    }
+
+    size_t public_getVbReadySize() {
+        return vbReady.size();
+    }
+
+    bool public_notifiedProcessor(size_t task, bool to) {
+        return notifiedProcessor(task, to);
+    }
+
     uint32_t getNumBackoffs() const {
         return backoffs.load();
     }
@@ -432,6 +432,47 @@ TEST_F(BasicLinkedListTest, UpdateDuringRangeRead) {
     EXPECT_EQ(expectedSeqno, basicLL->getAllSeqnoForVerification());
 }
 
+TEST_F(BasicLinkedListTest, UpdateDuringConcurrentRangeReads) {
+    const int numItems = 5;
+    const std::string keyPrefix("key");
+
+    /* Add 5 new items */
+    addNewItemsToList(1, keyPrefix, numItems);
+
+    /* One (fake) range read of [1, 1], and an iterator which has moved on to
+       read [4, 5] */
+    basicLL->registerFakeReadRange(1, 1);
+    {
+        auto itr = getRangeIterator();
+        while ((*itr).getBySeqno() < 4) {
+            ++itr;
+        }
+        EXPECT_EQ(2, basicLL->getNumRangeReads());
+        EXPECT_EQ(1, basicLL->getRangeReadBegin());
+        EXPECT_EQ(numItems, basicLL->getRangeReadEnd());
+
+        /* Items not in any read range are moved to the end of the list, items
+           in either have to be appended */
+        updateItem(numItems, keyPrefix + "2");
+        updateItemDuringRangeRead(numItems + 1, keyPrefix + "1");
+        updateItemDuringRangeRead(numItems + 2, keyPrefix + "4");
+        updateItem(numItems + 3, keyPrefix + "3");
+    }
+
+    std::vector<seqno_t> expectedSeqno = {1, 4, 5, 6, 7, 8, 9};
+    EXPECT_EQ(expectedSeqno, basicLL->getAllSeqnoForVerification());
+    EXPECT_EQ(2, basicLL->getNumStaleItems());
+    EXPECT_EQ(2, basicLL->getNumRangeReadStaleItems());
+
+    /* Only the fake range read remains */
+    EXPECT_EQ(1, basicLL->getNumRangeReads());
+    EXPECT_EQ(1, basicLL->getRangeReadEnd());
+    basicLL->resetReadRange();
+    EXPECT_EQ(0, basicLL->getNumRangeReads());
+    EXPECT_EQ(0, basicLL->getRangeReadBegin());
+    EXPECT_EQ(0, basicLL->getRangeReadEnd());
+}
+
 TEST_F(BasicLinkedListTest, DeletedItem) {
     const std::string keyPrefix("key");
     const int numItems = 1;
@@ -721,7 +762,7 @@ TEST_F(BasicLinkedListTest, MultipleRangeIterator_MB24474) {
     EXPECT_EQ(expectedSeqno, actualSeqno);
 }
 
-TEST_F(BasicLinkedListTest, NonBlockingRangeIterators) {
+TEST_F(BasicLinkedListTest, ConcurrentRangeIterators) {
     const int numItems = 3;
     const std::string keyPrefix("key");
 
@@ -729,27 +770,134 @@ TEST_F(BasicLinkedListTest, NonBlockingRangeIterators) {
     std::vector<seqno_t> expectedSeqno =
             addNewItemsToList(1, keyPrefix, numItems);
 
+    /* Both iterators can use the list at the same time */
+    auto itr1 = getRangeIterator();
+    auto itr2 = getRangeIterator();
+    EXPECT_EQ(2, basicLL->getNumRangeReads());
+
+    /* Read all the items with both the iterators, in lockstep */
+    std::vector<seqno_t> actualSeqno1;
+    std::vector<seqno_t> actualSeqno2;
+    while (itr1.curr() != itr1.end()) {
+        ASSERT_NE(itr2.curr(), itr2.end());
+        actualSeqno1.push_back((*itr1).getBySeqno());
+        actualSeqno2.push_back((*itr2).getBySeqno());
+        ++itr1;
+        ++itr2;
+    }
+    EXPECT_EQ(itr2.curr(), itr2.end());
+    EXPECT_EQ(expectedSeqno, actualSeqno1);
+    EXPECT_EQ(expectedSeqno, actualSeqno2);
+
+    /* The iterators release their ranges once they reach the end */
+    EXPECT_EQ(0, basicLL->getNumRangeReads());
+}
+
+TEST_F(BasicLinkedListTest, NonBlockingRangeIterators) {
+    const int numItems = 3;
+    const std::string keyPrefix("key");
+
+    /* Add 3 items */
+    addNewItemsToList(1, keyPrefix, numItems);
+
     {
-        auto itr1 = getRangeIterator();
-        auto itr2 = basicLL->makeRangeIterator(true /*isBackfill*/);
-        /* itr1 is already using the list, we cannot have another iterator */
-        EXPECT_FALSE(itr2);
+        /* The list is being purged, we cannot create an iterator (but must
+           not block) */
+        std::lock_guard<folly::SharedMutex> purgeGuard(
+                basicLL->getRangeReadLock());
+        auto itr = basicLL->makeRangeIterator(true /*isBackfill*/);
+        EXPECT_FALSE(itr);
+    }
 
-        /* itr1 goes out of scope and releases the read lock on the list */
+    {
+        /* The list is being read, it cannot be purged (but must not block) */
+        auto itr = getRangeIterator();
+        addStaleItem("stale", numItems + 1);
+        EXPECT_EQ(0, basicLL->purgeTombstones(numItems + 1));
+        EXPECT_EQ(1, basicLL->getNumStaleItems());
     }
+}
 
-    /* Iterator created now, should be able to read all items */
-    auto itr = getRangeIterator();
-    std::vector<seqno_t> actualSeqno;
+TEST_F(BasicLinkedListTest, RangeIteratorFromSeqno) {
+    const int numItems = 3 * BasicLinkedList::SeqnoIndexInterval;
+    const std::string keyPrefix("key");
 
-    /* Read all the items with the iterator */
-    while (itr.curr() != itr.end()) {
+    addNewItemsToList(1, keyPrefix, numItems);
+
+    /* Move an indexed item to the end of the list */
+    const seqno_t indexedSeqno = 2 * BasicLinkedList::SeqnoIndexInterval;
+    updateItem(numItems, keyPrefix + std::to_string(indexedSeqno));
+
+    /* Check the iterators are positioned at the first item >= start */
+    for (const seqno_t start : {seqno_t(1),
+                                seqno_t(10),
+                                indexedSeqno - 1,
+                                indexedSeqno,
+                                indexedSeqno + 1,
+                                seqno_t(numItems + 1)}) {
+        auto itrOptional =
+                basicLL->makeRangeIterator(true /*isBackfill*/, start);
+        ASSERT_TRUE(itrOptional);
+        const auto expected = (start == indexedSeqno) ? start + 1 : start;
+        EXPECT_EQ(expected, itrOptional->curr()) << "start:" << start;
+        EXPECT_EQ(numItems + 1, itrOptional->back());
+    }
+
+    /* Beyond the high seqno, the iterator is at the last item */
+    {
+        auto itrOptional = basicLL->makeRangeIterator(true /*isBackfill*/,
+                                                      numItems + 10);
+        ASSERT_TRUE(itrOptional);
+        EXPECT_EQ(numItems + 1, itrOptional->curr());
+    }
+
+    /* Read all items from the middle of the list */
+    auto itrOptional = basicLL->makeRangeIterator(true /*isBackfill*/,
+                                                  indexedSeqno - 10);
+    ASSERT_TRUE(itrOptional);
+    auto& itr = *itrOptional;
+    std::vector<seqno_t> expectedSeqno;
+    for (seqno_t seqno = indexedSeqno - 10; seqno <= numItems + 1; ++seqno) {
+        if (seqno != indexedSeqno) {
+            expectedSeqno.push_back(seqno);
+        }
+    }
+    std::vector<seqno_t> actualSeqno;
+    for (; itr.curr() != itr.end(); ++itr) {
         actualSeqno.push_back((*itr).getBySeqno());
-        ++itr;
     }
     EXPECT_EQ(expectedSeqno, actualSeqno);
 }
 
+TEST_F(BasicLinkedListTest, RangeReadFromSeqno) {
+    const int numItems = 3 * BasicLinkedList::SeqnoIndexInterval;
+    const std::string keyPrefix("key");
+
+    addNewItemsToList(1, keyPrefix, numItems);
+
+    /* Move an indexed item to the end of the list */
+    const seqno_t indexedSeqno = 2 * BasicLinkedList::SeqnoIndexInterval;
+    updateItem(numItems, keyPrefix + std::to_string(indexedSeqno));
+
+    auto res = basicLL->rangeRead(indexedSeqno, indexedSeqno + 100);
+    EXPECT_EQ(ENGINE_SUCCESS, std::get<0>(res));
+    EXPECT_EQ(indexedSeqno + 100, std::get<2>(res));
+
+    std::vector<seqno_t> expectedSeqno;
+    for (seqno_t seqno = indexedSeqno + 1; seqno <= indexedSeqno + 100;
+         ++seqno) {
+        expectedSeqno.push_back(seqno);
+    }
+    std::vector<seqno_t> actualSeqno;
+    for (const auto& item : std::get<1>(res)) {
+        actualSeqno.push_back(item->getBySeqno());
+    }
+    EXPECT_EQ(expectedSeqno, actualSeqno);
+
+    /* The read range is removed once the read completes */
+    EXPECT_EQ(0, basicLL->getNumRangeReads());
+}
+
 TEST_F(BasicLinkedListTest, RangeReadStopsOnInvalidSeqno) {
     /* MB-24376: rangeRead has to stop if it encounters an OSV with a seqno of
      * -1; this item is definitely past the end of the rangeRead, and has not
@@ -851,33 +999,90 @@ TEST_F(BasicLinkedListTest, UpdateDuringPurge) {
     const int numItems = 2;
     const std::string keyPrefix("key");
 
-    /* Add 2 new items */
+    /* Add 2 new items, followed by 2 stale items */
     addNewItemsToList(1, keyPrefix, numItems);
+    addStaleItem("stale1", numItems + 1);
+    addStaleItem("stale2", numItems + 2);
 
-    /* Start the purger, in between send an update. Update is done at a point
-       (first key here) in the linked list that is already visited by
-       the purger, hence we do not expect the update to create a stale copy of
-       the updated item */
+    /* Start the purger, in between send an update. The purger only visits
+       the stale items, hence we do not expect the update (of a live item) to
+       create a stale copy of the updated item */
     bool sendUpdateOnce = true;
-    bool afterFirst = false;
-    basicLL->purgeTombstones(numItems, {}, [&]() {
+    basicLL->purgeTombstones(numItems + 2, {}, [&]() {
         /* By sending the update in the callback, we are simulating a
            scenario where an update happens in between the purge */
-        if (sendUpdateOnce && afterFirst) {
+        if (sendUpdateOnce) {
             sendUpdateOnce = false;
             /* update first key */
-            updateItem(numItems, keyPrefix + std::to_string(1));
+            updateItem(numItems + 2, keyPrefix + std::to_string(1));
         }
-        afterFirst = true;
         return false;
     });
 
     /* Update should succeed */
-    EXPECT_EQ(numItems + 1, basicLL->getHighSeqno());
+    EXPECT_EQ(numItems + 3, basicLL->getHighSeqno());
     /* Update should not create stale items */
     EXPECT_EQ(0, basicLL->getNumStaleItems());
 }
 
+/* The purge of stale items must not visit the live items of the list */
+TEST_F(BasicLinkedListTest, PurgeVisitsOnlyStaleItems) {
+    const int numItems = 100;
+    const std::string keyPrefix("key");
+
+    addNewItemsToList(1, keyPrefix, numItems / 2);
+    addStaleItem("stale1", numItems / 2 + 1);
+    addNewItemsToList(numItems / 2 + 2, keyPrefix, numItems / 2);
+    addStaleItem("stale2", numItems + 2);
+    addNewItemsToList(numItems + 3, keyPrefix, 1);
+
+    int visited = 0;
+    EXPECT_EQ(2, basicLL->purgeTombstones(numItems + 2, {}, [&visited]() {
+        ++visited;
+        return false;
+    }));
+    EXPECT_EQ(2, visited);
+    EXPECT_EQ(0, basicLL->getNumStaleItems());
+    EXPECT_EQ(numItems + 1, basicLL->getNumItems());
+}
+
+/* Items of dropped collections are only scanned for once a purge of dropped
+   keys has been scheduled */
+TEST_F(BasicLinkedListTest, PurgeDroppedKeys) {
+    const int numItems = 4;
+    const std::string keyPrefix("key");
+
+    addNewItemsToList(1, keyPrefix, numItems);
+    addStaleItem("stale", numItems + 1);
+    addNewItemsToList(numItems + 2, keyPrefix, 1);
+
+    /* Drop key2; as the list owns the items of dropped collections, release
+       it from the hash table */
+    const auto droppedKey = makeStoredDocKey(keyPrefix + "2");
+    releaseFromHashTable(keyPrefix + "2").release();
+    int checked = 0;
+    auto isDropped = [&droppedKey, &checked](const DocKey& key, int64_t) {
+        ++checked;
+        return StoredDocKey(key) == droppedKey;
+    };
+
+    /* Nothing scheduled, only the stale item is purged */
+    EXPECT_EQ(1, basicLL->purgeTombstones(numItems + 1, isDropped));
+    EXPECT_EQ(0, checked);
+
+    /* Once scheduled, the next purge scans the list */
+    basicLL->scheduleDroppedKeysPurge();
+    EXPECT_EQ(1, basicLL->purgeTombstones(numItems + 1, isDropped));
+    EXPECT_EQ(numItems, checked);
+    std::vector<seqno_t> expectedSeqno = {1, 3, 4, numItems + 2};
+    EXPECT_EQ(expectedSeqno, basicLL->getAllSeqnoForVerification());
+
+    /* ... but only the next one */
+    checked = 0;
+    EXPECT_EQ(0, basicLL->purgeTombstones(numItems + 1, isDropped));
+    EXPECT_EQ(0, checked);
+}
+
 /* Run purge when the last item in the list does not yet have a seqno */
 TEST_F(BasicLinkedListTest, PurgeWithItemWithoutSeqno) {
     const int numItems = 2;
@@ -950,7 +1155,7 @@ TEST_F(BasicLinkedListTest, PurgePauseResume) {
 }
 
 TEST_F(BasicLinkedListTest, PurgePauseResumeWithUpdate) {
-    const int numItems = 2, numPurgeItems = 1;
+    const int numItems = 2, numPurgeItems = 2;
     const std::string keyPrefix("key");
 
     /* Add a new item */
@@ -962,6 +1167,10 @@ TEST_F(BasicLinkedListTest, PurgePauseResumeWithUpdate) {
     /* Add another item */
     addNewItemsToList(3 /*seqno*/, keyPrefix, 1);
 
+    /* Add another stale item at the end, so that the purge pauses between
+       the two stale items */
+    addStaleItem("stale2", 4 /*seqno*/);
+
     ASSERT_EQ(numItems + numPurgeItems, basicLL->getNumItems());
     ASSERT_EQ(numPurgeItems, basicLL->getNumStaleItems());
 
@@ -80,6 +80,56 @@ TEST_P(BloomFilterDocKeyTest, check_maybeKeyExist) {
     }
 }
 
+class BlockedBloomFilterTest : public ::testing::Test {
+protected:
+    BlockedBloomFilterTest()
+        : filter(10000, 0.01, BFILTER_ENABLED, BloomFilter::Type::Blocked) {
+    }
+
+    BloomFilter filter;
+};
+
+TEST_F(BlockedBloomFilterTest, NoFalseNegatives) {
+    for (int i = 0; i < 10000; i++) {
+        filter.addKey(makeStoredDocKey("key_" + std::to_string(i)));
+    }
+    for (int i = 0; i < 10000; i++) {
+        EXPECT_TRUE(filter.maybeKeyExists(
+                makeStoredDocKey("key_" + std::to_string(i))));
+    }
+}
+
+TEST_F(BlockedBloomFilterTest, FalsePositiveRate) {
+    for (int i = 0; i < 10000; i++) {
+        filter.addKey(makeStoredDocKey("key_" + std::to_string(i)));
+    }
+    int positives = 0;
+    for (int i = 0; i < 10000; i++) {
+        positives += filter.maybeKeyExists(
+                makeStoredDocKey("missing_" + std::to_string(i)));
+    }
+    // Sized for 1%; a blocked filter does a little worse than a standard
+    // one of the same size, but not by much.
+    EXPECT_LT(positives, 300);
+}
+
+TEST_F(BlockedBloomFilterTest, KeyCount) {
+    auto key = makeStoredDocKey("key");
+    filter.addKey(key);
+    filter.addKey(key);
+    EXPECT_EQ(1, filter.getNumOfKeysInFilter());
+    EXPECT_EQ(0, filter.getFilterSize() % 256);
+    EXPECT_FALSE(filter.maybeKeyExists(makeStoredDocKey("other")));
+}
+
+TEST(BloomFilterTest, TypeFromString) {
+    EXPECT_EQ(BloomFilter::Type::Standard,
+              BloomFilter::typeFromString("standard"));
+    EXPECT_EQ(BloomFilter::Type::Blocked,
+              BloomFilter::typeFromString("blocked"));
+    EXPECT_THROW(BloomFilter::typeFromString("other"), std::invalid_argument);
+}
+
 // Test params includes our labelled collections that have 'special meaning' and
 // one normal collection ID (100)
 static std::vector<CollectionID> allDocNamespaces = {
@@ -680,6 +680,46 @@ TYPED_TEST(CheckpointTest, ItemsForCheckpointCursor) {
     EXPECT_EQ(1000 + 2 * MIN_CHECKPOINT_ITEMS, range.end);
 }
 
+// Test that with chk_compress_values enabled, documents are stored in the
+// checkpoint Snappy-compressed and can be decompressed back to the original.
+TYPED_TEST(CheckpointTest, CompressValues) {
+    this->checkpoint_config = CheckpointConfig(DEFAULT_CHECKPOINT_PERIOD,
+                                               DEFAULT_CHECKPOINT_ITEMS,
+                                               /*numCheckpoints*/ 2,
+                                               /*itemBased*/ true,
+                                               /*keepClosed*/ false,
+                                               /*persistenceEnabled*/ true,
+                                               /*compressValues*/ true);
+    this->createManager();
+
+    const std::string value(1024, 'x');
+    queued_item qi(new Item(makeStoredDocKey("key"),
+                            0,
+                            0,
+                            value.data(),
+                            value.size()));
+    ASSERT_TRUE(this->manager->queueDirty(*this->vbucket,
+                                          qi,
+                                          GenerateBySeqno::Yes,
+                                          GenerateCas::Yes,
+                                          /*preLinkDocCtx*/ nullptr));
+
+    std::vector<queued_item> items;
+    this->manager->getAllItemsForPersistence(items);
+    // checkpoint_start + the mutation
+    ASSERT_EQ(2, items.size());
+    auto& queued = *items.back();
+    ASSERT_EQ(queue_op::mutation, queued.getOperation());
+    EXPECT_TRUE(mcbp::datatype::is_snappy(queued.getDataType()));
+    EXPECT_LT(queued.getNBytes(), value.size());
+    EXPECT_EQ(value.size() - queued.getNBytes(),
+              this->global_stats.checkpointCompressedBytesSaved);
+
+    Item copy(queued);
+    ASSERT_TRUE(copy.decompressValue());
+    EXPECT_EQ(value, std::string(copy.getData(), copy.getNBytes()));
+}
+
 // Test getAllItemsForCursor() when it is limited to fewer items than exist
 // in total. Cursor should only advanced to the start of the 2nd checkpoint.
 TYPED_TEST(CheckpointTest, ItemsForCheckpointCursorLimited) {
@@ -1739,6 +1779,33 @@ TYPED_TEST(CheckpointTest, expelCheckpointItemsTest) {
     EXPECT_FALSE(regResult.tryBackfill);
 }
 
+// Test that registering a cursor by seqno positions it correctly in a large
+// checkpoint (where the search starts from the checkpoint's seqno index),
+// including when an indexed item has been de-duplicated.
+TYPED_TEST(CheckpointTest, RegisterCursorBySeqnoLargeCheckpoint) {
+    const int itemCount{300};
+    for (auto ii = 0; ii < itemCount; ++ii) {
+        ASSERT_TRUE(this->queueNewItem("key" + std::to_string(ii)));
+    }
+    // De-duplicate key63 (seqno 1064) - the first item in the seqno index.
+    EXPECT_FALSE(this->queueNewItem("key63"));
+    ASSERT_EQ(1, this->manager->getNumCheckpoints());
+    ASSERT_EQ(itemCount, this->manager->getNumOpenChkItems());
+    const uint64_t highSeqno = 1000 + itemCount + 1;
+    ASSERT_EQ(highSeqno, this->manager->getHighSeqno());
+
+    // The cursor should be positioned after all items <= the requested
+    // seqno; the seqno returned is that of the next item.
+    std::string dcp_cursor(DCP_CURSOR_PREFIX + std::to_string(1));
+    for (uint64_t seqno = 1001; seqno <= highSeqno; ++seqno) {
+        auto regResult = this->manager->registerCursorBySeqno(
+                dcp_cursor.c_str(), seqno);
+        const uint64_t expected = (seqno == 1063) ? 1065 : seqno + 1;
+        EXPECT_EQ(expected, regResult.seqno) << "seqno:" << seqno;
+        EXPECT_FALSE(regResult.tryBackfill);
+    }
+}
+
 // Test that we correctly handle duplicates, where the initial version of the
 // document has been expelled.
 TYPED_TEST(CheckpointTest, expelCheckpointItemsWithDuplicateTest) {
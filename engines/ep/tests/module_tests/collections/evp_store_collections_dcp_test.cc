@@ -1221,6 +1221,29 @@ TEST_F(CollectionsFilteredDcpTest, filtering) {
     testDcpCreateDelete({CollectionEntry::dairy}, {}, 2, false);
 }
 
+// A disk backfill of a stream filtered to a collection can read just the
+// collection's keys (dcp_backfill_collection_scan_ratio), and streams the
+// same as a by-seqno scan.
+TEST_F(CollectionsFilteredDcpTest, filtering_backfill_by_key_range) {
+    CollectionsManifest cm;
+    store->setCollections({cm.add(CollectionEntry::meat)
+                                   .add(CollectionEntry::dairy)
+                                   .remove(CollectionEntry::defaultC)});
+    store_item(vbid, StoredDocKey{"meat:one", CollectionEntry::meat}, "value");
+    store_item(vbid, StoredDocKey{"dairy:one", CollectionEntry::dairy}, "v");
+    store_item(vbid, StoredDocKey{"meat:two", CollectionEntry::meat}, "value");
+    store_item(vbid, StoredDocKey{"dairy:two", CollectionEntry::dairy}, "v");
+    flush_vbucket_to_disk(vbid, 7);
+
+    resetEngineAndWarmup();
+    engine->getConfiguration().setDcpBackfillCollectionScanRatio(1.0);
+
+    createDcpObjects({{R"({"collections":["c"]})"}});
+
+    // 1x create of dairy, then its 2 mutations in seqno order.
+    testDcpCreateDelete({CollectionEntry::dairy}, {}, 2, false);
+}
+
 TEST_F(CollectionsFilteredDcpTest, filtering_scope) {
     VBucketPtr vb = store->getVBucket(vbid);
 
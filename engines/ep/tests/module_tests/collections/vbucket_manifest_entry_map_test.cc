@@ -0,0 +1,101 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "collections/vbucket_manifest_entry_map.h"
+#include "test_manifest.h"
+
+#include <folly/portability/GTest.h>
+
+using Collections::VB::ManifestEntry;
+using Collections::VB::ManifestEntryMap;
+
+// The entry of each collection is found by its ID, whether or not the ID is
+// in the indexed range
+TEST(ManifestEntryMap, emplace_find) {
+    ManifestEntryMap map;
+    const CollectionID large = ManifestEntryMap::maxIndexedID + 8;
+    const std::vector<CollectionID> ids = {
+            CollectionID::Default, CollectionEntry::fruit, large};
+
+    int64_t seqno = 1;
+    for (const auto& id : ids) {
+        auto inserted = map.emplace(id, {ScopeEntry::defaultS, {}, seqno++});
+        EXPECT_TRUE(inserted.second);
+        EXPECT_EQ(id, inserted.first->first);
+    }
+
+    EXPECT_EQ(3, map.size());
+    seqno = 1;
+    for (const auto& id : ids) {
+        auto itr = map.find(id);
+        ASSERT_NE(map.end(), itr);
+        EXPECT_EQ(id, itr->first);
+        EXPECT_EQ(seqno++, itr->second.getStartSeqno());
+        EXPECT_EQ(1, map.count(id));
+    }
+
+    EXPECT_EQ(map.end(), map.find(CollectionEntry::dairy));
+    EXPECT_EQ(0, map.count(CollectionEntry::dairy));
+    EXPECT_EQ(map.end(), map.find(large + 1));
+    EXPECT_EQ(0, map.count(CollectionID(100000000)));
+}
+
+// Emplacing an existing collection leaves its entry as it was
+TEST(ManifestEntryMap, emplace_existing) {
+    ManifestEntryMap map;
+    map.emplace(CollectionEntry::fruit, {ScopeEntry::defaultS, {}, 1});
+
+    auto inserted =
+            map.emplace(CollectionEntry::fruit, {ScopeEntry::defaultS, {}, 5});
+    EXPECT_FALSE(inserted.second);
+    EXPECT_EQ(1, inserted.first->second.getStartSeqno());
+    EXPECT_EQ(1, map.size());
+}
+
+// Erasing a collection moves the last entry into its slot; every other
+// collection must still be found
+TEST(ManifestEntryMap, erase) {
+    ManifestEntryMap map;
+    const CollectionID large = ManifestEntryMap::maxIndexedID + 8;
+    map.emplace(CollectionEntry::fruit, {ScopeEntry::defaultS, {}, 1});
+    map.emplace(CollectionEntry::dairy, {ScopeEntry::defaultS, {}, 2});
+    map.emplace(large, {ScopeEntry::defaultS, {}, 3});
+
+    auto next = map.erase(map.find(CollectionEntry::fruit));
+    ASSERT_NE(map.end(), next);
+    EXPECT_EQ(large, next->first);
+
+    EXPECT_EQ(2, map.size());
+    EXPECT_EQ(map.end(), map.find(CollectionEntry::fruit));
+    ASSERT_NE(map.end(), map.find(CollectionEntry::dairy));
+    EXPECT_EQ(2, map.find(CollectionEntry::dairy)->second.getStartSeqno());
+    ASSERT_NE(map.end(), map.find(large));
+    EXPECT_EQ(3, map.find(large)->second.getStartSeqno());
+
+    EXPECT_EQ(map.end(), map.erase(map.find(large)));
+    EXPECT_EQ(map.end(), map.find(large));
+    map.erase(map.find(CollectionEntry::dairy));
+    EXPECT_TRUE(map.empty());
+
+    // The IDs can be added back
+    EXPECT_TRUE(map.emplace(large, {ScopeEntry::defaultS, {}, 4}).second);
+    EXPECT_TRUE(map.emplace(CollectionEntry::fruit,
+                            {ScopeEntry::defaultS, {}, 5})
+                        .second);
+    EXPECT_EQ(4, map.find(large)->second.getStartSeqno());
+    EXPECT_EQ(5, map.find(CollectionEntry::fruit)->second.getStartSeqno());
+}
@@ -38,19 +38,19 @@ public:
     }
 
     bool exists(CollectionID identifier) const {
-        std::lock_guard<cb::ReaderLock> readLock(rwlock.reader());
+        std::shared_lock<Mutex> readLock(rwlock);
         return exists_UNLOCKED(identifier);
     }
 
     size_t size() const {
-        std::lock_guard<cb::ReaderLock> readLock(rwlock.reader());
+        std::shared_lock<Mutex> readLock(rwlock);
         return map.size();
     }
 
     bool compareEntry(CollectionID id,
                       const Collections::VB::ManifestEntry& entry,
                       bool ignoreHighSeqno = false) const {
-        std::lock_guard<cb::ReaderLock> readLock(rwlock.reader());
+        std::shared_lock<Mutex> readLock(rwlock);
         if (exists_UNLOCKED(id)) {
             auto itr = map.find(id);
             const auto& myEntry = itr->second;
@@ -76,7 +76,7 @@ public:
     }
 
     bool operator==(const MockVBManifest& rhs) const {
-        std::lock_guard<cb::ReaderLock> readLock(rwlock.reader());
+        std::shared_lock<Mutex> readLock(rwlock);
         if (rhs.size() != size()) {
             return false;
         }
@@ -0,0 +1,131 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "compaction_throttle.h"
+#include "stats.h"
+
+#include <folly/portability/GTest.h>
+
+using namespace std::chrono;
+
+class CompactionThrottleTest : public ::testing::Test {
+protected:
+    /// @return how long throttle(bytes) blocked for.
+    microseconds timeThrottle(CompactionThrottle& throttle, size_t bytes) {
+        const auto start = steady_clock::now();
+        throttle.throttle(bytes);
+        return duration_cast<microseconds>(steady_clock::now() - start);
+    }
+
+    EPStats stats;
+};
+
+// With no limits set, compaction IO is never delayed.
+TEST_F(CompactionThrottleTest, Disabled) {
+    CompactionThrottle throttle(stats);
+    for (int ii = 0; ii < 10; ++ii) {
+        throttle.throttle(1024 * 1024 * 1024);
+    }
+    EXPECT_EQ(0, stats.compactionThrottledTime);
+}
+
+// IO is paced to the configured bytes/sec; the first IO goes immediately.
+TEST_F(CompactionThrottleTest, RateLimited) {
+    CompactionThrottle throttle(stats);
+    throttle.setMaxBytesPerSec(1000 * 1000);
+
+    EXPECT_LT(timeThrottle(throttle, 100 * 1000), milliseconds(50));
+    EXPECT_EQ(0, stats.compactionThrottledTime);
+
+    // Each 100KB must wait for the previous one's 100ms slot.
+    const auto elapsed = timeThrottle(throttle, 100 * 1000) +
+                         timeThrottle(throttle, 100 * 1000);
+    EXPECT_GE(elapsed, milliseconds(190));
+    EXPECT_GE(stats.compactionThrottledTime, 190 * 1000);
+
+    // Removing the limit takes effect immediately.
+    throttle.setMaxBytesPerSec(0);
+    EXPECT_LT(timeThrottle(throttle, 100 * 1000), milliseconds(50));
+}
+
+// Charged IO never waits, but the next throttle() waits out the debt.
+TEST_F(CompactionThrottleTest, ChargeDefersWait) {
+    CompactionThrottle throttle(stats);
+    throttle.setMaxBytesPerSec(1000 * 1000);
+
+    const auto start = steady_clock::now();
+    for (int ii = 0; ii < 3; ++ii) {
+        throttle.charge(100 * 1000);
+    }
+    EXPECT_LT(steady_clock::now() - start, milliseconds(50));
+    EXPECT_EQ(0, stats.compactionThrottledTime);
+
+    // 300KB at 1MB/s: the debt runs out 300ms after the first charge.
+    EXPECT_GE(timeThrottle(throttle, 0), milliseconds(240));
+    EXPECT_GE(steady_clock::now() - start, milliseconds(290));
+    EXPECT_GT(stats.compactionThrottledTime, 0);
+}
+
+// The mean BG fetch latency is computed over each sample interval.
+TEST_F(CompactionThrottleTest, BgFetchLatency) {
+    CompactionThrottle throttle(stats, milliseconds(0));
+    throttle.setBgFetchLatencyThreshold(microseconds(1000));
+
+    EXPECT_FALSE(throttle.isBgFetchLatencyHigh());
+
+    // 10 fetches averaging 500us: under the threshold.
+    stats.bgNumOperations.fetch_add(10);
+    stats.bgWait.fetch_add(2000);
+    stats.bgLoad.fetch_add(3000);
+    EXPECT_FALSE(throttle.isBgFetchLatencyHigh());
+
+    // 10 fetches averaging 5ms: over it.
+    stats.bgNumOperations.fetch_add(10);
+    stats.bgLoad.fetch_add(50000);
+    EXPECT_TRUE(throttle.isBgFetchLatencyHigh());
+
+    // No fetches since; not high.
+    EXPECT_FALSE(throttle.isBgFetchLatencyHigh());
+
+    // A stats reset isn't taken as a latency sample.
+    stats.reset();
+    stats.bgNumOperations.fetch_add(1);
+    EXPECT_FALSE(throttle.isBgFetchLatencyHigh());
+
+    // Disabled.
+    stats.bgNumOperations.fetch_add(1);
+    stats.bgWait.fetch_add(1000000);
+    throttle.setBgFetchLatencyThreshold(microseconds(0));
+    EXPECT_FALSE(throttle.isBgFetchLatencyHigh());
+}
+
+// Compaction pauses while BG fetch latency is high.
+TEST_F(CompactionThrottleTest, PausesOnHighBgFetchLatency) {
+    CompactionThrottle throttle(stats, milliseconds(0));
+    throttle.setBgFetchLatencyThreshold(microseconds(1000));
+
+    stats.bgNumOperations.fetch_add(1);
+    stats.bgWait.fetch_add(10000);
+
+    // High for the first check, then (no further fetches) not.
+    EXPECT_GE(timeThrottle(throttle, 4096), CompactionThrottle::latencyPause);
+    EXPECT_GE(stats.compactionThrottledTime,
+              duration_cast<microseconds>(CompactionThrottle::latencyPause)
+                      .count());
+
+    EXPECT_LT(timeThrottle(throttle, 4096), CompactionThrottle::latencyPause);
+}
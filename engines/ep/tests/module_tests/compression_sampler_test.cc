@@ -0,0 +1,110 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the CompressionSampler class.
+ */
+
+#include "compression_sampler.h"
+
+#include <folly/portability/GTest.h>
+
+// Count how many of the next n values of cid would be compressed, recording
+// each attempt as a failure.
+static size_t countAttempts(CompressionSampler& sampler,
+                            CollectionID cid,
+                            size_t n) {
+    size_t attempts = 0;
+    for (size_t ii = 0; ii < n; ++ii) {
+        if (sampler.shouldAttempt(cid)) {
+            sampler.record(cid, false);
+            ++attempts;
+        }
+    }
+    return attempts;
+}
+
+TEST(CompressionSamplerTest, Disabled) {
+    CompressionSampler sampler(0, 10);
+    EXPECT_EQ(100, countAttempts(sampler, CollectionID::Default, 100));
+}
+
+TEST(CompressionSamplerTest, SkipsIncompressibleCollection) {
+    CompressionSampler sampler(4, 10);
+    const CollectionID cid = 8;
+
+    // The first 4 failures are all attempted, then only 1 in 10.
+    EXPECT_EQ(4, countAttempts(sampler, cid, 4));
+    EXPECT_EQ(10, countAttempts(sampler, cid, 100));
+
+    // Other collections are unaffected.
+    EXPECT_TRUE(sampler.shouldAttempt(9));
+    EXPECT_TRUE(sampler.shouldAttempt(CollectionID::Default));
+}
+
+TEST(CompressionSamplerTest, SuccessfulSampleResumes) {
+    CompressionSampler sampler(4, 10);
+    const CollectionID cid = 8;
+    countAttempts(sampler, cid, 4);
+    ASSERT_FALSE(sampler.shouldAttempt(cid));
+
+    // The collection's data became compressible.
+    sampler.record(cid, true);
+    EXPECT_EQ(4, countAttempts(sampler, cid, 4));
+}
+
+TEST(CompressionSamplerTest, SuccessResetsFailures) {
+    CompressionSampler sampler(4, 10);
+    const CollectionID cid = 8;
+    for (int ii = 0; ii < 10; ++ii) {
+        sampler.record(cid, false);
+        sampler.record(cid, false);
+        sampler.record(cid, true);
+    }
+    EXPECT_TRUE(sampler.shouldAttempt(cid));
+}
+
+// A collection sharing the slot of an incompressible one starts afresh.
+TEST(CompressionSamplerTest, SlotCollision) {
+    CompressionSampler sampler(4, 10);
+    const CollectionID first = 8;
+    const CollectionID second = 8 + CompressionSampler::NumSlots;
+    countAttempts(sampler, first, 4);
+    ASSERT_FALSE(sampler.shouldAttempt(first));
+
+    EXPECT_TRUE(sampler.shouldAttempt(second));
+    sampler.record(second, false);
+    EXPECT_TRUE(sampler.shouldAttempt(second));
+    EXPECT_TRUE(sampler.shouldAttempt(first));
+}
+
+TEST(CompressionSamplerTest, Reconfigure) {
+    CompressionSampler sampler(4, 10);
+    const CollectionID cid = 8;
+    countAttempts(sampler, cid, 4);
+    ASSERT_FALSE(sampler.shouldAttempt(cid));
+
+    sampler.setSkipThreshold(8);
+    EXPECT_EQ(4, countAttempts(sampler, cid, 4));
+
+    sampler.setSkipThreshold(0);
+    EXPECT_TRUE(sampler.shouldAttempt(cid));
+
+    sampler.setSkipThreshold(8);
+    sampler.reset();
+    EXPECT_EQ(8, countAttempts(sampler, cid, 8));
+}
@@ -0,0 +1,268 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "tests/wrapped_fileops_test.h"
+#include "src/couch-kvstore/couch-fs-block-cache.h"
+
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+
+using namespace testing;
+
+/*
+ * Run the generic wrapped-FileOps tests against BlockCacheOps. The cache is
+ * disabled here as those tests set exact expectations on the calls made to
+ * the wrapped ops (and overwrite data, which couchstore never does); the
+ * caching itself is tested below.
+ */
+class TestBlockCacheOps : public BlockCacheOps {
+public:
+    TestBlockCacheOps(FileOpsInterface* ops)
+        : BlockCacheOps(*ops, disabledCache), owned_ops(ops) {
+    }
+
+protected:
+    static CouchBlockCache disabledCache;
+    std::unique_ptr<FileOpsInterface> owned_ops;
+};
+
+CouchBlockCache TestBlockCacheOps::disabledCache(0);
+
+typedef testing::Types<TestBlockCacheOps> WrappedOpsImplementation;
+
+INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
+                              WrappedOpsTest,
+                              WrappedOpsImplementation);
+
+INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
+                              UnbufferedWrappedOpsTest,
+                              WrappedOpsImplementation);
+
+/* NOOP to suppress compiler warning for an unused variable defined when
+ * registering BufferedWrappedOpsTest in wrapped_fileops_test.h
+ */
+INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
+                              BufferedWrappedOpsTest,
+                              testing::Types<>);
+
+class MockFileOps : public FileOpsInterface {
+public:
+    MOCK_METHOD1(constructor, couch_file_handle(couchstore_error_info_t*));
+    MOCK_METHOD4(open,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle*,
+                                    const char*,
+                                    int));
+    MOCK_METHOD2(close,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle));
+    MOCK_METHOD2(set_periodic_sync,
+                 couchstore_error_t(couch_file_handle, uint64_t));
+    MOCK_METHOD5(pread,
+                 ssize_t(couchstore_error_info_t*,
+                         couch_file_handle,
+                         void*,
+                         size_t,
+                         cs_off_t));
+    MOCK_METHOD5(pwrite,
+                 ssize_t(couchstore_error_info_t*,
+                         couch_file_handle,
+                         const void*,
+                         size_t,
+                         cs_off_t));
+    MOCK_METHOD2(goto_eof,
+                 cs_off_t(couchstore_error_info_t*, couch_file_handle));
+    MOCK_METHOD2(sync,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle));
+    MOCK_METHOD5(advise,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle,
+                                    cs_off_t,
+                                    cs_off_t,
+                                    couchstore_file_advice_t));
+    MOCK_METHOD1(get_stats, FHStats*(couch_file_handle));
+    MOCK_METHOD1(destructor, void(couch_file_handle));
+};
+
+/// The contents of the (fake) file at the given offset.
+static uint8_t fileByte(cs_off_t offset) {
+    return uint8_t(offset % 251);
+}
+
+class BlockCacheOpsTest : public ::testing::Test {
+protected:
+    static const size_t BlockSize = CouchBlockCache::BlockSize;
+
+    void SetUp() override {
+        // A file of fileSize bytes, filled with fileByte().
+        ON_CALL(mock, pread(_, _, _, _, _))
+                .WillByDefault(Invoke([this](couchstore_error_info_t*,
+                                             couch_file_handle,
+                                             void* buf,
+                                             size_t sz,
+                                             cs_off_t off) -> ssize_t {
+                    if (off >= fileSize) {
+                        return 0;
+                    }
+                    sz = std::min(sz, size_t(fileSize - off));
+                    auto* bytes = static_cast<uint8_t*>(buf);
+                    for (size_t ii = 0; ii < sz; ++ii) {
+                        bytes[ii] = fileByte(off + ii);
+                    }
+                    return sz;
+                }));
+    }
+
+    couch_file_handle open(BlockCacheOps& ops, const char* path = "0.couch.1") {
+        auto h = ops.constructor(&errinfo);
+        ops.open(&errinfo, &h, path, O_RDONLY);
+        return h;
+    }
+
+    /// Read and check nbytes at offset; returns the number of bytes read.
+    ssize_t read(BlockCacheOps& ops,
+                 couch_file_handle h,
+                 cs_off_t offset,
+                 size_t nbytes = 100) {
+        std::vector<uint8_t> buf(nbytes);
+        auto got = ops.pread(&errinfo, h, buf.data(), nbytes, offset);
+        for (ssize_t ii = 0; ii < got; ++ii) {
+            EXPECT_EQ(fileByte(offset + ii), buf[ii]) << "offset:" << offset;
+        }
+        return got;
+    }
+
+    NiceMock<MockFileOps> mock;
+    couchstore_error_info_t errinfo;
+    cs_off_t fileSize = 1024 * 1024;
+};
+
+TEST_F(BlockCacheOpsTest, ReadsServedFromCache) {
+    CouchBlockCache cache(16 * BlockSize);
+    BlockCacheOps ops(mock, cache);
+    auto h = open(ops);
+
+    // The first read fetches the whole block it's in...
+    EXPECT_CALL(mock, pread(_, _, _, BlockSize, BlockSize));
+    EXPECT_EQ(100, read(ops, h, BlockSize + 1000));
+    Mock::VerifyAndClearExpectations(&mock);
+
+    // ... so later reads of the block don't touch the file.
+    EXPECT_CALL(mock, pread(_, _, _, _, _)).Times(0);
+    EXPECT_EQ(100, read(ops, h, BlockSize + 2000));
+    EXPECT_EQ(100, read(ops, h, BlockSize));
+    Mock::VerifyAndClearExpectations(&mock);
+
+    // A read spanning a cached and an uncached block reads both.
+    EXPECT_CALL(mock, pread(_, _, _, 2 * BlockSize, BlockSize));
+    EXPECT_EQ(100, read(ops, h, 2 * BlockSize - 50));
+    Mock::VerifyAndClearExpectations(&mock);
+
+    EXPECT_EQ(2, ops.getHits());
+    EXPECT_EQ(2, ops.getMisses());
+    EXPECT_EQ(2 * BlockSize, cache.getMemoryUsage());
+    ops.destructor(h);
+}
+
+// The last, partial, block of the file may be appended to, so isn't cached.
+TEST_F(BlockCacheOpsTest, PartialBlockNotCached) {
+    CouchBlockCache cache(16 * BlockSize);
+    BlockCacheOps ops(mock, cache);
+    auto h = open(ops);
+    fileSize = BlockSize + 1000;
+
+    EXPECT_CALL(mock, pread(_, _, _, BlockSize, BlockSize)).Times(2);
+    EXPECT_EQ(100, read(ops, h, BlockSize + 500));
+    EXPECT_EQ(100, read(ops, h, BlockSize + 500));
+    Mock::VerifyAndClearExpectations(&mock);
+
+    // Reads are truncated at the end of the file.
+    EXPECT_EQ(50, read(ops, h, BlockSize + 950));
+    EXPECT_EQ(0, read(ops, h, BlockSize + 2000));
+    EXPECT_EQ(0, cache.getMemoryUsage());
+    ops.destructor(h);
+}
+
+TEST_F(BlockCacheOpsTest, LargeReadsBypassCache) {
+    CouchBlockCache cache(64 * BlockSize);
+    BlockCacheOps ops(mock, cache);
+    auto h = open(ops);
+
+    const size_t large = BlockCacheOps::MaxCachedReadSize + 1;
+    EXPECT_CALL(mock, pread(_, _, _, large, 10)).Times(2);
+    EXPECT_EQ(large, read(ops, h, 10, large));
+    EXPECT_EQ(large, read(ops, h, 10, large));
+    EXPECT_EQ(0, cache.getMemoryUsage());
+    ops.destructor(h);
+}
+
+TEST_F(BlockCacheOpsTest, LeastRecentlyUsedEvicted) {
+    CouchBlockCache cache(2 * BlockSize);
+    BlockCacheOps ops(mock, cache);
+    auto h = open(ops);
+
+    read(ops, h, 0);
+    read(ops, h, BlockSize);
+    read(ops, h, 0);
+    // Evicts block 1, the least recently used.
+    read(ops, h, 2 * BlockSize);
+    EXPECT_EQ(2 * BlockSize, cache.getMemoryUsage());
+
+    EXPECT_CALL(mock, pread(_, _, _, _, _)).Times(0);
+    read(ops, h, 0);
+    read(ops, h, 2 * BlockSize);
+    Mock::VerifyAndClearExpectations(&mock);
+
+    EXPECT_CALL(mock, pread(_, _, _, BlockSize, BlockSize));
+    read(ops, h, BlockSize);
+    ops.destructor(h);
+}
+
+// Blocks are per file, and a removed file's blocks aren't seen by a new file
+// of the same name.
+TEST_F(BlockCacheOpsTest, FilesAreDistinct) {
+    CouchBlockCache cache(16 * BlockSize);
+    BlockCacheOps ops(mock, cache);
+    auto h1 = open(ops, "0.couch.1");
+    auto h2 = open(ops, "1.couch.1");
+
+    EXPECT_CALL(mock, pread(_, _, _, BlockSize, 0)).Times(2);
+    read(ops, h1, 0);
+    read(ops, h2, 0);
+    Mock::VerifyAndClearExpectations(&mock);
+
+    // Another handle on the same file shares its blocks.
+    auto h3 = open(ops, "0.couch.1");
+    EXPECT_CALL(mock, pread(_, _, _, _, _)).Times(0);
+    read(ops, h3, 0);
+    Mock::VerifyAndClearExpectations(&mock);
+    ops.destructor(h3);
+
+    cache.forgetFile("0.couch.1");
+    h3 = open(ops, "0.couch.1");
+    EXPECT_CALL(mock, pread(_, _, _, BlockSize, 0));
+    read(ops, h3, 0);
+    Mock::VerifyAndClearExpectations(&mock);
+
+    ops.destructor(h1);
+    ops.destructor(h2);
+    ops.destructor(h3);
+}
@@ -0,0 +1,196 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "tests/wrapped_fileops_test.h"
+#include "src/couch-kvstore/couch-fs-drop-behind.h"
+
+#include <gmock/gmock.h>
+
+using namespace testing;
+
+/*
+ * Run the generic wrapped-FileOps tests against DropBehindOps. Dropping is
+ * disabled here as those tests set exact expectations on the calls made to
+ * the wrapped ops; dropping itself is tested below.
+ */
+class TestDropBehindOps : public DropBehindOps {
+public:
+    TestDropBehindOps(FileOpsInterface* ops)
+        : DropBehindOps(*ops, 0), owned_ops(ops) {
+    }
+
+protected:
+    std::unique_ptr<FileOpsInterface> owned_ops;
+};
+
+typedef testing::Types<TestDropBehindOps> WrappedOpsImplementation;
+
+INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
+                              WrappedOpsTest,
+                              WrappedOpsImplementation);
+
+INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
+                              UnbufferedWrappedOpsTest,
+                              WrappedOpsImplementation);
+
+/* NOOP to suppress compiler warning for an unused variable defined when
+ * registering BufferedWrappedOpsTest in wrapped_fileops_test.h
+ */
+INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
+                              BufferedWrappedOpsTest,
+                              testing::Types<>);
+
+class MockFileOps : public FileOpsInterface {
+public:
+    MOCK_METHOD1(constructor, couch_file_handle(couchstore_error_info_t*));
+    MOCK_METHOD4(open,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle*,
+                                    const char*,
+                                    int));
+    MOCK_METHOD2(close,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle));
+    MOCK_METHOD2(set_periodic_sync,
+                 couchstore_error_t(couch_file_handle, uint64_t));
+    MOCK_METHOD5(pread,
+                 ssize_t(couchstore_error_info_t*,
+                         couch_file_handle,
+                         void*,
+                         size_t,
+                         cs_off_t));
+    MOCK_METHOD5(pwrite,
+                 ssize_t(couchstore_error_info_t*,
+                         couch_file_handle,
+                         const void*,
+                         size_t,
+                         cs_off_t));
+    MOCK_METHOD2(goto_eof,
+                 cs_off_t(couchstore_error_info_t*, couch_file_handle));
+    MOCK_METHOD2(sync,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle));
+    MOCK_METHOD5(advise,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle,
+                                    cs_off_t,
+                                    cs_off_t,
+                                    couchstore_file_advice_t));
+    MOCK_METHOD1(get_stats, FHStats*(couch_file_handle));
+    MOCK_METHOD1(destructor, void(couch_file_handle));
+};
+
+class DropBehindOpsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ON_CALL(mock, pread(_, _, _, _, _))
+                .WillByDefault(ReturnArg<3>());
+        ON_CALL(mock, pwrite(_, _, _, _, _))
+                .WillByDefault(ReturnArg<3>());
+    }
+
+    void read(DropBehindOps& ops, couch_file_handle h, cs_off_t offset) {
+        ops.pread(&errinfo, h, buf, sizeof(buf), offset);
+    }
+
+    void write(DropBehindOps& ops, couch_file_handle h, cs_off_t offset) {
+        ops.pwrite(&errinfo, h, buf, sizeof(buf), offset);
+    }
+
+    NiceMock<MockFileOps> mock;
+    couchstore_error_info_t errinfo;
+    char buf[100];
+};
+
+TEST_F(DropBehindOpsTest, ReadsDroppedEveryWindow) {
+    DropBehindOps ops(mock, 500);
+    auto h = ops.constructor(&errinfo);
+
+    // Nothing is dropped until a window's worth has been read.
+    EXPECT_CALL(mock, advise(_, _, _, _, _)).Times(0);
+    read(ops, h, 1000);
+    read(ops, h, 1100);
+    read(ops, h, 5000);
+    read(ops, h, 1200);
+    Mock::VerifyAndClearExpectations(&mock);
+
+    // Then each range read is dropped, adjacent reads coalesced.
+    EXPECT_CALL(mock,
+                advise(_, _, 1000, 200, COUCHSTORE_FILE_ADVICE_DONTNEED));
+    EXPECT_CALL(mock,
+                advise(_, _, 5000, 100, COUCHSTORE_FILE_ADVICE_DONTNEED));
+    EXPECT_CALL(mock,
+                advise(_, _, 1200, 200, COUCHSTORE_FILE_ADVICE_DONTNEED));
+    read(ops, h, 1300);
+    Mock::VerifyAndClearExpectations(&mock);
+
+    // Whatever is left is dropped on close.
+    EXPECT_CALL(mock,
+                advise(_, _, 2000, 100, COUCHSTORE_FILE_ADVICE_DONTNEED));
+    read(ops, h, 2000);
+    ops.close(&errinfo, h);
+    Mock::VerifyAndClearExpectations(&mock);
+
+    ops.destructor(h);
+}
+
+TEST_F(DropBehindOpsTest, WritesDroppedOnceSynced) {
+    DropBehindOps ops(mock, 500);
+    auto h = ops.constructor(&errinfo);
+
+    // Dirty pages can't be dropped, so nothing is until they are synced.
+    EXPECT_CALL(mock, advise(_, _, _, _, _)).Times(0);
+    for (cs_off_t offset = 0; offset < 1000; offset += sizeof(buf)) {
+        write(ops, h, offset);
+    }
+    Mock::VerifyAndClearExpectations(&mock);
+
+    EXPECT_CALL(mock, advise(_, _, 0, 1000, COUCHSTORE_FILE_ADVICE_DONTNEED));
+    ops.sync(&errinfo, h);
+    Mock::VerifyAndClearExpectations(&mock);
+
+    // A failed sync doesn't drop anything.
+    EXPECT_CALL(mock, sync(_, _))
+            .WillOnce(Return(COUCHSTORE_ERROR_WRITE));
+    EXPECT_CALL(mock, advise(_, _, _, _, _)).Times(0);
+    write(ops, h, 1000);
+    ops.sync(&errinfo, h);
+    Mock::VerifyAndClearExpectations(&mock);
+
+    EXPECT_CALL(mock,
+                advise(_, _, 1000, 200, COUCHSTORE_FILE_ADVICE_DONTNEED));
+    write(ops, h, 1100);
+    ops.sync(&errinfo, h);
+    Mock::VerifyAndClearExpectations(&mock);
+
+    ops.destructor(h);
+}
+
+TEST_F(DropBehindOpsTest, Disabled) {
+    DropBehindOps ops(mock, 0);
+    auto h = ops.constructor(&errinfo);
+
+    EXPECT_CALL(mock, advise(_, _, _, _, _)).Times(0);
+    for (cs_off_t offset = 0; offset < 10000; offset += sizeof(buf)) {
+        read(ops, h, offset);
+        write(ops, h, offset);
+    }
+    ops.sync(&errinfo, h);
+    ops.close(&errinfo, h);
+
+    ops.destructor(h);
+}
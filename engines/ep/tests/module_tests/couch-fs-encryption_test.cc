@@ -0,0 +1,214 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "src/couch-kvstore/couch-fs-encryption.h"
+
+#include <folly/portability/GTest.h>
+
+#include <fcntl.h>
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+/**
+ * FileOps over files held in memory, so that the tests can see what
+ * EncryptedOps stores.
+ */
+class MemoryFileOps : public FileOpsInterface {
+public:
+    couch_file_handle constructor(couchstore_error_info_t*) override {
+        return reinterpret_cast<couch_file_handle>(new std::string*());
+    }
+    couchstore_error_t open(couchstore_error_info_t*,
+                            couch_file_handle* h,
+                            const char* path,
+                            int) override {
+        *reinterpret_cast<std::string**>(*h) = &files[path];
+        return COUCHSTORE_SUCCESS;
+    }
+    couchstore_error_t close(couchstore_error_info_t*,
+                             couch_file_handle) override {
+        return COUCHSTORE_SUCCESS;
+    }
+    couchstore_error_t set_periodic_sync(couch_file_handle,
+                                         uint64_t) override {
+        return COUCHSTORE_SUCCESS;
+    }
+    ssize_t pread(couchstore_error_info_t*,
+                  couch_file_handle h,
+                  void* buf,
+                  size_t sz,
+                  cs_off_t off) override {
+        const auto& file = data(h);
+        if (size_t(off) >= file.size()) {
+            return 0;
+        }
+        sz = std::min(sz, file.size() - off);
+        std::memcpy(buf, file.data() + off, sz);
+        return sz;
+    }
+    ssize_t pwrite(couchstore_error_info_t*,
+                   couch_file_handle h,
+                   const void* buf,
+                   size_t sz,
+                   cs_off_t off) override {
+        auto& file = data(h);
+        if (file.size() < off + sz) {
+            file.resize(off + sz);
+        }
+        std::memcpy(&file[off], buf, sz);
+        return sz;
+    }
+    cs_off_t goto_eof(couchstore_error_info_t*, couch_file_handle h) override {
+        return data(h).size();
+    }
+    couchstore_error_t sync(couchstore_error_info_t*,
+                            couch_file_handle) override {
+        return COUCHSTORE_SUCCESS;
+    }
+    couchstore_error_t advise(couchstore_error_info_t*,
+                              couch_file_handle,
+                              cs_off_t,
+                              cs_off_t,
+                              couchstore_file_advice_t) override {
+        return COUCHSTORE_SUCCESS;
+    }
+    FHStats* get_stats(couch_file_handle) override {
+        return nullptr;
+    }
+    void destructor(couch_file_handle h) override {
+        delete reinterpret_cast<std::string**>(h);
+    }
+
+    std::map<std::string, std::string> files;
+
+private:
+    std::string& data(couch_file_handle h) {
+        return **reinterpret_cast<std::string**>(h);
+    }
+};
+
+class EncryptedOpsTest : public ::testing::Test {
+protected:
+    /// Open path with ops, returning the handle (or nullptr on failure)
+    couch_file_handle open(FileOpsInterface& ops,
+                           const std::string& path,
+                           int flags = O_RDWR | O_CREAT) {
+        auto h = ops.constructor(&errinfo);
+        openResult = ops.open(&errinfo, &h, path.c_str(), flags);
+        if (openResult != COUCHSTORE_SUCCESS) {
+            ops.destructor(h);
+            return nullptr;
+        }
+        return h;
+    }
+
+    void closeFile(FileOpsInterface& ops, couch_file_handle h) {
+        ops.close(&errinfo, h);
+        ops.destructor(h);
+    }
+
+    std::string read(FileOpsInterface& ops,
+                     couch_file_handle h,
+                     size_t size,
+                     cs_off_t offset) {
+        std::string ret(size, '\0');
+        ret.resize(ops.pread(&errinfo, h, &ret[0], size, offset));
+        return ret;
+    }
+
+    void write(FileOpsInterface& ops,
+               couch_file_handle h,
+               const std::string& data,
+               cs_off_t offset) {
+        ASSERT_EQ(ssize_t(data.size()),
+                  ops.pwrite(&errinfo, h, data.data(), data.size(), offset));
+    }
+
+    MemoryFileOps memory;
+    EncryptedOps ops{memory, std::string(32, 'k')};
+    couchstore_error_info_t errinfo;
+    couchstore_error_t openResult = COUCHSTORE_SUCCESS;
+    // Larger than the write buffer, and not a multiple of the block size
+    const std::string data = std::string(100 * 1024 + 7, 'x') + "end";
+};
+
+// What's written is encrypted after the header, and read back decrypted, at
+// couchstore's offsets.
+TEST_F(EncryptedOpsTest, RoundTrip) {
+    auto h = open(ops, "file");
+    ASSERT_NE(nullptr, h);
+    EXPECT_EQ(0, ops.goto_eof(&errinfo, h));
+    write(ops, h, data, 0);
+    write(ops, h, "appended", data.size());
+    EXPECT_EQ(cs_off_t(data.size() + 8), ops.goto_eof(&errinfo, h));
+
+    const auto& stored = memory.files["file"];
+    ASSERT_EQ(EncryptedOps::headerSize + data.size() + 8, stored.size());
+    EXPECT_EQ(std::string::npos,
+              stored.find("xxxxxxxx", EncryptedOps::headerSize));
+    EXPECT_EQ(std::string::npos, stored.find("appended"));
+
+    EXPECT_EQ(data, read(ops, h, data.size(), 0));
+    EXPECT_EQ("xend", read(ops, h, 4, data.size() - 4));
+    EXPECT_EQ("appended", read(ops, h, 100, data.size()));
+    closeFile(ops, h);
+
+    // The file can be reopened (and read) with the same key.
+    EncryptedOps other(memory, std::string(32, 'k'));
+    h = open(other, "file", O_RDONLY);
+    ASSERT_NE(nullptr, h);
+    EXPECT_EQ(cs_off_t(data.size() + 8), other.goto_eof(&errinfo, h));
+    EXPECT_EQ(data + "appended", read(other, h, data.size() + 8, 0));
+    closeFile(other, h);
+}
+
+// Each file is encrypted with its own IV.
+TEST_F(EncryptedOpsTest, FilesHaveTheirOwnIV) {
+    for (const auto* path : {"a", "b"}) {
+        auto h = open(ops, path);
+        ASSERT_NE(nullptr, h);
+        write(ops, h, data, 0);
+        closeFile(ops, h);
+    }
+    EXPECT_NE(memory.files["a"].substr(EncryptedOps::headerSize),
+              memory.files["b"].substr(EncryptedOps::headerSize));
+}
+
+// A file encrypted with another key can't be opened.
+TEST_F(EncryptedOpsTest, WrongKey) {
+    auto h = open(ops, "file");
+    ASSERT_NE(nullptr, h);
+    write(ops, h, data, 0);
+    closeFile(ops, h);
+
+    EncryptedOps other(memory, std::string(32, 'x'));
+    EXPECT_EQ(nullptr, open(other, "file"));
+    EXPECT_EQ(COUCHSTORE_ERROR_CORRUPT, openResult);
+}
+
+// Files written before encryption was enabled are used as they are.
+TEST_F(EncryptedOpsTest, UnencryptedFile) {
+    memory.files["file"] = data;
+    auto h = open(ops, "file");
+    ASSERT_NE(nullptr, h);
+    EXPECT_EQ(cs_off_t(data.size()), ops.goto_eof(&errinfo, h));
+    EXPECT_EQ(data, read(ops, h, data.size(), 0));
+    write(ops, h, "appended", data.size());
+    closeFile(ops, h);
+    EXPECT_EQ(data + "appended", memory.files["file"]);
+}
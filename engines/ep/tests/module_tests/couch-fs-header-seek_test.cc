@@ -0,0 +1,175 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "tests/wrapped_fileops_test.h"
+#include "src/couch-kvstore/couch-fs-header-seek.h"
+
+#include <gmock/gmock.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+using namespace testing;
+
+/*
+ * Run the generic wrapped-FileOps tests against HeaderSeekOps, hiding
+ * nothing; hiding itself is tested below.
+ */
+class TestHeaderSeekOps : public HeaderSeekOps {
+public:
+    TestHeaderSeekOps(FileOpsInterface* ops)
+        : HeaderSeekOps(*ops, std::numeric_limits<cs_off_t>::max()),
+          owned_ops(ops) {
+    }
+
+protected:
+    std::unique_ptr<FileOpsInterface> owned_ops;
+};
+
+typedef testing::Types<TestHeaderSeekOps> WrappedOpsImplementation;
+
+INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
+                              WrappedOpsTest,
+                              WrappedOpsImplementation);
+
+INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
+                              UnbufferedWrappedOpsTest,
+                              WrappedOpsImplementation);
+
+/* NOOP to suppress compiler warning for an unused variable defined when
+ * registering BufferedWrappedOpsTest in wrapped_fileops_test.h
+ */
+INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
+                              BufferedWrappedOpsTest,
+                              testing::Types<>);
+
+class MockFileOps : public FileOpsInterface {
+public:
+    MOCK_METHOD1(constructor, couch_file_handle(couchstore_error_info_t*));
+    MOCK_METHOD4(open,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle*,
+                                    const char*,
+                                    int));
+    MOCK_METHOD2(close,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle));
+    MOCK_METHOD2(set_periodic_sync,
+                 couchstore_error_t(couch_file_handle, uint64_t));
+    MOCK_METHOD5(pread,
+                 ssize_t(couchstore_error_info_t*,
+                         couch_file_handle,
+                         void*,
+                         size_t,
+                         cs_off_t));
+    MOCK_METHOD5(pwrite,
+                 ssize_t(couchstore_error_info_t*,
+                         couch_file_handle,
+                         const void*,
+                         size_t,
+                         cs_off_t));
+    MOCK_METHOD2(goto_eof,
+                 cs_off_t(couchstore_error_info_t*, couch_file_handle));
+    MOCK_METHOD2(sync,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle));
+    MOCK_METHOD5(advise,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle,
+                                    cs_off_t,
+                                    cs_off_t,
+                                    couchstore_file_advice_t));
+    MOCK_METHOD1(get_stats, FHStats*(couch_file_handle));
+    MOCK_METHOD1(destructor, void(couch_file_handle));
+};
+
+class HeaderSeekOpsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // The wrapped file is all 0xff.
+        ON_CALL(mock, pread(_, _, _, _, _))
+                .WillByDefault(
+                        Invoke([](couchstore_error_info_t*,
+                                  couch_file_handle,
+                                  void* buf,
+                                  size_t sz,
+                                  cs_off_t) {
+                            std::memset(buf, 0xff, sz);
+                            return ssize_t(sz);
+                        }));
+        ON_CALL(mock, pwrite(_, _, _, _, _))
+                .WillByDefault(ReturnArg<3>());
+    }
+
+    /// Read buf from offset, returning how many of its bytes are zero.
+    size_t readZeros(HeaderSeekOps& ops, couch_file_handle h, cs_off_t off) {
+        std::memset(buf, 0x11, sizeof(buf));
+        EXPECT_EQ(ssize_t(sizeof(buf)),
+                  ops.pread(&errinfo, h, buf, sizeof(buf), off));
+        return std::count(buf, buf + sizeof(buf), 0);
+    }
+
+    NiceMock<MockFileOps> mock;
+    couchstore_error_info_t errinfo;
+    char buf[100];
+};
+
+TEST_F(HeaderSeekOpsTest, ReadsFromOffsetHidden) {
+    HeaderSeekOps ops(mock, 1000);
+    auto h = ops.constructor(&errinfo);
+
+    // Reads before the offset are passed through.
+    EXPECT_CALL(mock, pread(_, _, _, sizeof(buf), 800));
+    EXPECT_EQ(0u, readZeros(ops, h, 800));
+    Mock::VerifyAndClearExpectations(&mock);
+
+    // Those straddling it are read, with the part from it zeroed.
+    EXPECT_CALL(mock, pread(_, _, _, sizeof(buf), 950));
+    EXPECT_EQ(50u, readZeros(ops, h, 950));
+    Mock::VerifyAndClearExpectations(&mock);
+
+    // Those after it aren't read at all.
+    EXPECT_CALL(mock, pread(_, _, _, _, _)).Times(0);
+    EXPECT_EQ(sizeof(buf), readZeros(ops, h, 1000));
+    EXPECT_EQ(sizeof(buf), readZeros(ops, h, 5000));
+    Mock::VerifyAndClearExpectations(&mock);
+
+    ops.destructor(h);
+}
+
+TEST_F(HeaderSeekOpsTest, WritesNotHidden) {
+    HeaderSeekOps ops(mock, 1000);
+    auto h = ops.constructor(&errinfo);
+
+    // Appending at the end of the file stops what is written being hidden.
+    EXPECT_CALL(mock, pwrite(_, _, _, sizeof(buf), 5000));
+    ops.pwrite(&errinfo, h, buf, sizeof(buf), 5000);
+    Mock::VerifyAndClearExpectations(&mock);
+
+    EXPECT_EQ(sizeof(buf), readZeros(ops, h, 4900));
+    EXPECT_EQ(0u, readZeros(ops, h, 5000));
+    EXPECT_EQ(0u, readZeros(ops, h, 5050));
+    EXPECT_EQ(50u, readZeros(ops, h, 4950));
+
+    // Reopening starts hiding again.
+    ops.close(&errinfo, h);
+    ops.open(&errinfo, &h, "file", 0);
+    EXPECT_EQ(sizeof(buf), readZeros(ops, h, 5000));
+
+    ops.destructor(h);
+}
@@ -0,0 +1,243 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "tests/wrapped_fileops_test.h"
+#include "src/couch-kvstore/couch-fs-merge.h"
+
+#include <gmock/gmock.h>
+
+#include <algorithm>
+
+using namespace testing;
+
+/*
+ * Run the generic wrapped-FileOps tests against MergedReadOps (which is a
+ * pass-through without a plan installed).
+ */
+class TestMergedReadOps : public MergedReadOps {
+public:
+    TestMergedReadOps(FileOpsInterface* ops)
+        : MergedReadOps(*ops), owned_ops(ops) {
+    }
+
+protected:
+    std::unique_ptr<FileOpsInterface> owned_ops;
+};
+
+typedef testing::Types<TestMergedReadOps> WrappedOpsImplementation;
+
+INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
+                              WrappedOpsTest,
+                              WrappedOpsImplementation);
+
+INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
+                              UnbufferedWrappedOpsTest,
+                              WrappedOpsImplementation);
+
+/* NOOP to suppress compiler warning for an unused variable defined when
+ * registering BufferedWrappedOpsTest in wrapped_fileops_test.h
+ */
+INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
+                              BufferedWrappedOpsTest,
+                              testing::Types<>);
+
+class MockFileOps : public FileOpsInterface {
+public:
+    MOCK_METHOD1(constructor, couch_file_handle(couchstore_error_info_t*));
+    MOCK_METHOD4(open,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle*,
+                                    const char*,
+                                    int));
+    MOCK_METHOD2(close,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle));
+    MOCK_METHOD2(set_periodic_sync,
+                 couchstore_error_t(couch_file_handle, uint64_t));
+    MOCK_METHOD5(pread,
+                 ssize_t(couchstore_error_info_t*,
+                         couch_file_handle,
+                         void*,
+                         size_t,
+                         cs_off_t));
+    MOCK_METHOD5(pwrite,
+                 ssize_t(couchstore_error_info_t*,
+                         couch_file_handle,
+                         const void*,
+                         size_t,
+                         cs_off_t));
+    MOCK_METHOD2(goto_eof,
+                 cs_off_t(couchstore_error_info_t*, couch_file_handle));
+    MOCK_METHOD2(sync,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle));
+    MOCK_METHOD5(advise,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle,
+                                    cs_off_t,
+                                    cs_off_t,
+                                    couchstore_file_advice_t));
+    MOCK_METHOD1(get_stats, FHStats*(couch_file_handle));
+    MOCK_METHOD1(destructor, void(couch_file_handle));
+};
+
+/// The contents of the (fake) file at the given offset.
+static uint8_t fileByte(cs_off_t offset) {
+    return uint8_t(offset % 251);
+}
+
+class MergedReadOpsTest : public ::testing::Test {
+protected:
+    static const size_t Align = MergedReadOps::ReadBufferSize;
+
+    MergedReadOpsTest() : ops(mock) {
+    }
+
+    void SetUp() override {
+        // A file of fileSize bytes, filled with fileByte().
+        ON_CALL(mock, pread(_, _, _, _, _))
+                .WillByDefault(Invoke([this](couchstore_error_info_t*,
+                                             couch_file_handle,
+                                             void* buf,
+                                             size_t sz,
+                                             cs_off_t off) -> ssize_t {
+                    if (off >= fileSize) {
+                        return 0;
+                    }
+                    sz = std::min(sz, size_t(fileSize - off));
+                    auto* bytes = static_cast<uint8_t*>(buf);
+                    for (size_t ii = 0; ii < sz; ++ii) {
+                        bytes[ii] = fileByte(off + ii);
+                    }
+                    return sz;
+                }));
+    }
+
+    /// Read and check nbytes at offset; returns the number of bytes read.
+    ssize_t read(cs_off_t offset, size_t nbytes = 100) {
+        std::vector<uint8_t> buf(nbytes);
+        auto got = ops.pread(&errinfo, nullptr, buf.data(), nbytes, offset);
+        for (ssize_t ii = 0; ii < got; ++ii) {
+            EXPECT_EQ(fileByte(offset + ii), buf[ii]) << "offset:" << offset;
+        }
+        return got;
+    }
+
+    NiceMock<MockFileOps> mock;
+    MergedReadOps ops;
+    couchstore_error_info_t errinfo;
+    cs_off_t fileSize = 1024 * 1024;
+};
+
+TEST_F(MergedReadOpsTest, PassThroughWithoutPlan) {
+    EXPECT_CALL(mock, pread(_, _, _, 100, 5000));
+    EXPECT_EQ(100, read(5000));
+}
+
+TEST_F(MergedReadOpsTest, CloseRangesMerged) {
+    MergedReadOps::Plan plan(8192, 1024 * 1024);
+    plan.add(100, 200);
+    plan.add(5000, 300);
+    plan.add(13000, 100);
+    EXPECT_EQ(1, plan.getNumMergedRuns());
+    MergedReadOps::ScopedPlan scopedPlan(plan);
+
+    // The first read of the run reads all of it (widened to whole read
+    // buffers)...
+    EXPECT_CALL(mock, pread(_, _, _, 4 * Align, 0));
+    EXPECT_EQ(200, read(100, 200));
+    Mock::VerifyAndClearExpectations(&mock);
+
+    // ... and the rest are served from memory.
+    EXPECT_CALL(mock, pread(_, _, _, _, _)).Times(0);
+    EXPECT_EQ(ssize_t(Align), read(Align, Align));
+    EXPECT_EQ(300, read(5000, 300));
+    EXPECT_EQ(100, read(13000, 100));
+}
+
+TEST_F(MergedReadOpsTest, DistantRangesNotMerged) {
+    MergedReadOps::Plan plan(0, 1024 * 1024);
+    plan.add(100, 200);
+    plan.add(100000, 200);
+    EXPECT_EQ(0, plan.getNumMergedRuns());
+    MergedReadOps::ScopedPlan scopedPlan(plan);
+
+    EXPECT_CALL(mock, pread(_, _, _, 200, 100));
+    EXPECT_CALL(mock, pread(_, _, _, 200, 100000));
+    read(100, 200);
+    read(100000, 200);
+}
+
+TEST_F(MergedReadOpsTest, RunSizeLimited) {
+    MergedReadOps::Plan plan(Align, 2 * Align);
+    plan.add(0, 100);
+    plan.add(Align, 100);
+    plan.add(2 * Align, 100);
+    plan.add(3 * Align, 100);
+    EXPECT_EQ(2, plan.getNumMergedRuns());
+    MergedReadOps::ScopedPlan scopedPlan(plan);
+
+    EXPECT_CALL(mock, pread(_, _, _, 2 * Align, 0));
+    EXPECT_CALL(mock, pread(_, _, _, 2 * Align, 2 * Align));
+    for (int ii = 0; ii < 4; ++ii) {
+        read(ii * Align);
+    }
+}
+
+// A read which doesn't fit in a run (e.g. a larger document than described)
+// goes to the file.
+TEST_F(MergedReadOpsTest, ReadOutsideRun) {
+    MergedReadOps::Plan plan(Align, 1024 * 1024);
+    plan.add(0, 100);
+    plan.add(Align, 100);
+    MergedReadOps::ScopedPlan scopedPlan(plan);
+
+    EXPECT_CALL(mock, pread(_, _, _, 3 * Align, Align));
+    EXPECT_EQ(3 * Align, read(Align, 3 * Align));
+    Mock::VerifyAndClearExpectations(&mock);
+
+    EXPECT_CALL(mock, pread(_, _, _, 100, 10 * Align));
+    read(10 * Align);
+}
+
+TEST_F(MergedReadOpsTest, ShortReadAtEndOfFile) {
+    fileSize = Align + 500;
+    MergedReadOps::Plan plan(Align, 1024 * 1024);
+    plan.add(0, 100);
+    plan.add(Align, 1000);
+    MergedReadOps::ScopedPlan scopedPlan(plan);
+
+    EXPECT_CALL(mock, pread(_, _, _, 2 * Align, 0));
+    EXPECT_EQ(100, read(0));
+    EXPECT_EQ(500, read(Align, 1000));
+    EXPECT_EQ(0, read(Align + 600));
+}
+
+// The plan only applies for the lifetime of the ScopedPlan.
+TEST_F(MergedReadOpsTest, PlanScoped) {
+    MergedReadOps::Plan plan(Align, 1024 * 1024);
+    plan.add(0, 100);
+    plan.add(Align, 100);
+    {
+        MergedReadOps::ScopedPlan scopedPlan(plan);
+        EXPECT_CALL(mock, pread(_, _, _, 2 * Align, 0));
+        read(0);
+        Mock::VerifyAndClearExpectations(&mock);
+    }
+    EXPECT_CALL(mock, pread(_, _, _, 100, Align));
+    read(Align);
+}
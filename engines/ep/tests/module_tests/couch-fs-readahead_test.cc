@@ -0,0 +1,180 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "tests/wrapped_fileops_test.h"
+#include "src/couch-kvstore/couch-fs-readahead.h"
+
+#include <gmock/gmock.h>
+
+using namespace testing;
+
+/*
+ * Run the generic wrapped-FileOps tests against ReadaheadOps. Readahead is
+ * disabled here as those tests set exact expectations on the calls made to
+ * the wrapped ops; the readahead itself is tested below.
+ */
+class TestReadaheadOps : public ReadaheadOps {
+public:
+    TestReadaheadOps(FileOpsInterface* ops)
+        : ReadaheadOps(*ops, 0), owned_ops(ops) {
+    }
+
+protected:
+    std::unique_ptr<FileOpsInterface> owned_ops;
+};
+
+typedef testing::Types<TestReadaheadOps> WrappedOpsImplementation;
+
+INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
+                              WrappedOpsTest,
+                              WrappedOpsImplementation);
+
+INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
+                              UnbufferedWrappedOpsTest,
+                              WrappedOpsImplementation);
+
+/* NOOP to suppress compiler warning for an unused variable defined when
+ * registering BufferedWrappedOpsTest in wrapped_fileops_test.h
+ */
+INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
+                              BufferedWrappedOpsTest,
+                              testing::Types<>);
+
+class MockFileOps : public FileOpsInterface {
+public:
+    MOCK_METHOD1(constructor, couch_file_handle(couchstore_error_info_t*));
+    MOCK_METHOD4(open,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle*,
+                                    const char*,
+                                    int));
+    MOCK_METHOD2(close,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle));
+    MOCK_METHOD2(set_periodic_sync,
+                 couchstore_error_t(couch_file_handle, uint64_t));
+    MOCK_METHOD5(pread,
+                 ssize_t(couchstore_error_info_t*,
+                         couch_file_handle,
+                         void*,
+                         size_t,
+                         cs_off_t));
+    MOCK_METHOD5(pwrite,
+                 ssize_t(couchstore_error_info_t*,
+                         couch_file_handle,
+                         const void*,
+                         size_t,
+                         cs_off_t));
+    MOCK_METHOD2(goto_eof,
+                 cs_off_t(couchstore_error_info_t*, couch_file_handle));
+    MOCK_METHOD2(sync,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle));
+    MOCK_METHOD5(advise,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle,
+                                    cs_off_t,
+                                    cs_off_t,
+                                    couchstore_file_advice_t));
+    MOCK_METHOD1(get_stats, FHStats*(couch_file_handle));
+    MOCK_METHOD1(destructor, void(couch_file_handle));
+};
+
+class ReadaheadOpsTest : public ::testing::Test {
+protected:
+    void read(ReadaheadOps& ops, couch_file_handle h, cs_off_t offset) {
+        ops.pread(&errinfo, h, buf, sizeof(buf), offset);
+    }
+
+    NiceMock<MockFileOps> mock;
+    couchstore_error_info_t errinfo;
+    char buf[100];
+};
+
+TEST_F(ReadaheadOpsTest, SequentialReadsReadAhead) {
+    const cs_off_t window = 1024;
+    ReadaheadOps ops(mock, window);
+    auto h = ops.constructor(&errinfo);
+
+    // A single read somewhere in the file doesn't trigger readahead.
+    EXPECT_CALL(mock, advise(_, _, _, _, _)).Times(0);
+    read(ops, h, 10000);
+    Mock::VerifyAndClearExpectations(&mock);
+
+    // A read carrying on from it starts a sequential stream; read ahead of
+    // it.
+    EXPECT_CALL(mock,
+                advise(_, _, 10200, window, COUCHSTORE_FILE_ADVICE_WILLNEED));
+    read(ops, h, 10100);
+    Mock::VerifyAndClearExpectations(&mock);
+
+    // Further reads in the first half of the window, and reads elsewhere
+    // (e.g. btree nodes) don't issue any more.
+    EXPECT_CALL(mock, advise(_, _, _, _, _)).Times(0);
+    read(ops, h, 10200);
+    read(ops, h, 500);
+    read(ops, h, 10300);
+    Mock::VerifyAndClearExpectations(&mock);
+
+    // Once the stream is within half a window of the end of the readahead,
+    // the next window is requested.
+    EXPECT_CALL(mock,
+                advise(_,
+                       _,
+                       10200 + window,
+                       window,
+                       COUCHSTORE_FILE_ADVICE_WILLNEED));
+    read(ops, h, 10700);
+    Mock::VerifyAndClearExpectations(&mock);
+
+    ops.destructor(h);
+}
+
+TEST_F(ReadaheadOpsTest, Disabled) {
+    ReadaheadOps ops(mock, 0);
+    auto h = ops.constructor(&errinfo);
+
+    EXPECT_CALL(mock, advise(_, _, _, _, _)).Times(0);
+    for (cs_off_t offset = 0; offset < 10000; offset += sizeof(buf)) {
+        read(ops, h, offset);
+    }
+
+    ops.destructor(h);
+}
+
+TEST_F(ReadaheadOpsTest, SparseAscendingReadsWithMaxGap) {
+    const cs_off_t window = 1024;
+    ReadaheadOps ops(mock, window, window);
+    auto h = ops.constructor(&errinfo);
+
+    // Reads which skip forward (but by less than maxGap) still form a stream.
+    EXPECT_CALL(mock, advise(_, _, _, _, _)).Times(0);
+    read(ops, h, 10000);
+    Mock::VerifyAndClearExpectations(&mock);
+
+    EXPECT_CALL(mock,
+                advise(_, _, 10600, window, COUCHSTORE_FILE_ADVICE_WILLNEED));
+    read(ops, h, 10500);
+    Mock::VerifyAndClearExpectations(&mock);
+
+    // A jump of more than maxGap isn't part of the stream.
+    EXPECT_CALL(mock, advise(_, _, _, _, _)).Times(0);
+    read(ops, h, 10600 + window + window + 1);
+    Mock::VerifyAndClearExpectations(&mock);
+
+    ops.destructor(h);
+}
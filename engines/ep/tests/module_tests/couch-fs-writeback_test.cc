@@ -0,0 +1,176 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "tests/wrapped_fileops_test.h"
+#include "src/couch-kvstore/couch-fs-writeback.h"
+
+#include <gmock/gmock.h>
+
+using namespace testing;
+
+/*
+ * Run the generic wrapped-FileOps tests against WritebackOps. Writeback is
+ * disabled here as those tests set exact expectations on the calls made to
+ * the wrapped ops; writeback itself is tested below.
+ */
+class TestWritebackOps : public WritebackOps {
+public:
+    TestWritebackOps(FileOpsInterface* ops)
+        : WritebackOps(*ops, 0), owned_ops(ops) {
+    }
+
+protected:
+    std::unique_ptr<FileOpsInterface> owned_ops;
+};
+
+typedef testing::Types<TestWritebackOps> WrappedOpsImplementation;
+
+INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
+                              WrappedOpsTest,
+                              WrappedOpsImplementation);
+
+INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
+                              UnbufferedWrappedOpsTest,
+                              WrappedOpsImplementation);
+
+/* NOOP to suppress compiler warning for an unused variable defined when
+ * registering BufferedWrappedOpsTest in wrapped_fileops_test.h
+ */
+INSTANTIATE_TYPED_TEST_CASE_P(CouchstoreOpsTest,
+                              BufferedWrappedOpsTest,
+                              testing::Types<>);
+
+class MockFileOps : public FileOpsInterface {
+public:
+    MOCK_METHOD1(constructor, couch_file_handle(couchstore_error_info_t*));
+    MOCK_METHOD4(open,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle*,
+                                    const char*,
+                                    int));
+    MOCK_METHOD2(close,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle));
+    MOCK_METHOD2(set_periodic_sync,
+                 couchstore_error_t(couch_file_handle, uint64_t));
+    MOCK_METHOD5(pread,
+                 ssize_t(couchstore_error_info_t*,
+                         couch_file_handle,
+                         void*,
+                         size_t,
+                         cs_off_t));
+    MOCK_METHOD5(pwrite,
+                 ssize_t(couchstore_error_info_t*,
+                         couch_file_handle,
+                         const void*,
+                         size_t,
+                         cs_off_t));
+    MOCK_METHOD2(goto_eof,
+                 cs_off_t(couchstore_error_info_t*, couch_file_handle));
+    MOCK_METHOD2(sync,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle));
+    MOCK_METHOD5(advise,
+                 couchstore_error_t(couchstore_error_info_t*,
+                                    couch_file_handle,
+                                    cs_off_t,
+                                    cs_off_t,
+                                    couchstore_file_advice_t));
+    MOCK_METHOD1(get_stats, FHStats*(couch_file_handle));
+    MOCK_METHOD1(destructor, void(couch_file_handle));
+};
+
+class WritebackOpsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ON_CALL(mock, pwrite(_, _, _, _, _))
+                .WillByDefault(ReturnArg<3>());
+    }
+
+    void write(WritebackOps& ops, couch_file_handle h, cs_off_t offset) {
+        ops.pwrite(&errinfo, h, buf, sizeof(buf), offset);
+    }
+
+    NiceMock<MockFileOps> mock;
+    couchstore_error_info_t errinfo;
+    char buf[100];
+};
+
+TEST_F(WritebackOpsTest, WritebackStartedEveryWindow) {
+    WritebackOps ops(mock, 500);
+    auto h = ops.constructor(&errinfo);
+
+    // Nothing is written back until a window's worth has been written.
+    EXPECT_CALL(mock, advise(_, _, _, _, _)).Times(0);
+    for (cs_off_t offset = 0; offset < 400; offset += sizeof(buf)) {
+        write(ops, h, offset);
+    }
+    Mock::VerifyAndClearExpectations(&mock);
+
+    // Then the window is, without a sync.
+    EXPECT_CALL(mock, advise(_, _, 0, 500, COUCHSTORE_FILE_ADVICE_DONTNEED));
+    EXPECT_CALL(mock, sync(_, _)).Times(0);
+    write(ops, h, 400);
+    Mock::VerifyAndClearExpectations(&mock);
+
+    // And the next window from where that one ended.
+    EXPECT_CALL(mock,
+                advise(_, _, 500, 500, COUCHSTORE_FILE_ADVICE_DONTNEED));
+    for (cs_off_t offset = 500; offset < 1000; offset += sizeof(buf)) {
+        write(ops, h, offset);
+    }
+    Mock::VerifyAndClearExpectations(&mock);
+
+    ops.destructor(h);
+}
+
+TEST_F(WritebackOpsTest, SyncStartsNewWindow) {
+    WritebackOps ops(mock, 500);
+    auto h = ops.constructor(&errinfo);
+
+    // What was written before a sync is no longer outstanding.
+    EXPECT_CALL(mock, advise(_, _, _, _, _)).Times(0);
+    for (cs_off_t offset = 0; offset < 400; offset += sizeof(buf)) {
+        write(ops, h, offset);
+    }
+    ops.sync(&errinfo, h);
+    write(ops, h, 400);
+    Mock::VerifyAndClearExpectations(&mock);
+
+    EXPECT_CALL(mock,
+                advise(_, _, 400, 500, COUCHSTORE_FILE_ADVICE_DONTNEED));
+    for (cs_off_t offset = 500; offset < 900; offset += sizeof(buf)) {
+        write(ops, h, offset);
+    }
+    Mock::VerifyAndClearExpectations(&mock);
+
+    ops.destructor(h);
+}
+
+TEST_F(WritebackOpsTest, Disabled) {
+    WritebackOps ops(mock, 0);
+    auto h = ops.constructor(&errinfo);
+
+    EXPECT_CALL(mock, advise(_, _, _, _, _)).Times(0);
+    for (cs_off_t offset = 0; offset < 10000; offset += sizeof(buf)) {
+        write(ops, h, offset);
+    }
+    ops.sync(&errinfo, h);
+    ops.close(&errinfo, h);
+
+    ops.destructor(h);
+}
@@ -0,0 +1,66 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for crc32buf.
+ */
+
+extern "C" {
+#include "crc32.h"
+}
+
+#include <folly/portability/GTest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+// The bit-at-a-time CRC-32, which crc32buf must match (it is persisted in
+// the access log).
+static uint32_t referenceCrc32(const uint8_t* buf, size_t len) {
+    uint32_t crc = 0xffffffff;
+    for (size_t ii = 0; ii < len; ++ii) {
+        crc ^= buf[ii];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+        }
+    }
+    return ~crc;
+}
+
+TEST(Crc32Test, KnownValues) {
+    std::string check = "123456789";
+    EXPECT_EQ(0xcbf43926,
+              crc32buf(reinterpret_cast<uint8_t*>(&check[0]), check.size()));
+    EXPECT_EQ(0, crc32buf(nullptr, 0));
+}
+
+// Every length and alignment around the 8-byte steps.
+TEST(Crc32Test, MatchesReference) {
+    std::vector<uint8_t> buffer(1024);
+    std::mt19937 rng(0);
+    for (auto& byte : buffer) {
+        byte = uint8_t(rng());
+    }
+    for (size_t offset = 0; offset < 8; ++offset) {
+        for (size_t len = 0; len < buffer.size() - offset; len += 3) {
+            uint8_t* data = buffer.data() + offset;
+            ASSERT_EQ(referenceCrc32(data, len), crc32buf(data, len))
+                    << "offset:" << offset << " len:" << len;
+        }
+    }
+}
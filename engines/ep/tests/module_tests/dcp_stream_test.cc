@@ -408,10 +408,12 @@ TEST_P(StreamTest, test_keyAndValueExcludingXattrsMessageSize) {
             stream->public_makeResponseFromItem(qi);
 
     /**
-     * Create a DCP response and check that a new item is created
+     * Create a DCP response and check that a new item is created (which
+     * shares the value of the original, rather than copying it)
      */
     auto mutProdResponse = dynamic_cast<MutationResponse*>(dcpResponse.get());
     ASSERT_NE(qi.get(), mutProdResponse->getItem().get());
+    EXPECT_EQ(qi->getData(), mutProdResponse->getItem()->getData());
     EXPECT_EQ(keyAndValueMessageSize, dcpResponse->getMessageSize());
     destroy_dcp_stream();
 }
@@ -995,6 +997,26 @@ TEST_P(StreamTest, CursorDroppingBasicNotAllowedStates) {
     destroy_dcp_stream();
 }
 
+/* Check that the time spent in each takeover phase is recorded */
+TEST_P(StreamTest, TakeoverPhaseTimings) {
+    auto& stats = engine->getEpStats();
+    stats.dcpTakeoverSendHisto.reset();
+    stats.dcpTakeoverWaitHisto.reset();
+    setup_dcp_stream(DCP_ADD_STREAM_FLAG_TAKEOVER);
+
+    stream->transitionStateToTakeoverSend();
+    EXPECT_EQ(0, stats.dcpTakeoverSendHisto.getValueCount());
+
+    stream->transitionStateToTakeoverWait();
+    EXPECT_EQ(1, stats.dcpTakeoverSendHisto.getValueCount());
+    EXPECT_EQ(0, stats.dcpTakeoverWaitHisto.getValueCount());
+
+    stream->transitionStateToTakeoverDead();
+    EXPECT_EQ(1, stats.dcpTakeoverSendHisto.getValueCount());
+    EXPECT_EQ(1, stats.dcpTakeoverWaitHisto.getValueCount());
+    destroy_dcp_stream();
+}
+
 TEST_P(StreamTest, RollbackDueToPurge) {
     setup_dcp_stream(0, IncludeValue::No, IncludeXattrs::No);
 
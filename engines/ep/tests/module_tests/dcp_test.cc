@@ -35,6 +35,7 @@
 #include "dcp/active_stream_checkpoint_processor_task.h"
 #include "dcp/dcp-types.h"
 #include "dcp/dcpconnmap.h"
+#include "dcp/flow-control-manager.h"
 #include "dcp/producer.h"
 #include "dcp/stream.h"
 #include "dcp_utils.h"
@@ -42,6 +43,7 @@
 #include "evp_engine_test.h"
 #include "memory_tracker.h"
 #include "objectregistry.h"
+#include "replicationthrottle.h"
 #include "test_helpers.h"
 
 #include <folly/portability/GTest.h>
@@ -50,6 +52,7 @@
 #include <platform/compress.h>
 #include <programs/engine_testapp/mock_server.h>
 
+#include <numeric>
 #include <thread>
 
 /**
@@ -1133,6 +1136,34 @@ TEST_P(ConnectionTest, test_producer_no_stream_end_on_client_close_stream) {
     connMap.manageConnections();
 }
 
+/* Checks that a vbucket state change closes the streams of the connections
+   registered for that vbucket (found through the vbucket's connection list
+   rather than by visiting every connection). */
+TEST_P(ConnectionTest, test_producer_stream_closed_on_vb_state_change) {
+    MockDcpConnMap connMap(*engine);
+    connMap.initialize();
+    const void* cookie = create_mock_cookie();
+
+    DcpProducer* producer = connMap.newProducer(cookie,
+                                                "test_producer",
+                                                /*flags*/ 0);
+    EXPECT_EQ(ENGINE_SUCCESS, doStreamRequest(*producer).status);
+    ASSERT_TRUE(connMap.doesConnHandlerExist(vbid, "test_producer"));
+
+    auto stream = producer->findStreams(vbid)->rlock().get();
+    ASSERT_TRUE(stream->isActive());
+
+    // A change to a different vbucket leaves the stream alone
+    connMap.vbucketStateChanged(Vbid(vbid.get() + 1), vbucket_state_replica);
+    EXPECT_TRUE(stream->isActive());
+
+    connMap.vbucketStateChanged(vbid, vbucket_state_replica);
+    EXPECT_FALSE(stream->isActive());
+
+    connMap.disconnect(cookie);
+    connMap.manageConnections();
+}
+
 TEST_P(ConnectionTest, test_producer_unknown_ctrl_msg) {
     const void* cookie = create_mock_cookie();
     /* Create a new Dcp producer */
@@ -1923,6 +1954,37 @@ TEST_F(NotifyTest, test_mb19503_connmap_notify_paused) {
     EXPECT_EQ(1, notifyTest.getCallbacks());
 }
 
+// Check that a connection queued more than once before the notifier runs is
+// only notified once.
+TEST_F(NotifyTest, connmap_notify_duplicates) {
+    ConnMapNotifyTest notifyTest(*engine);
+
+    // Hook into notify_io_complete; count the notifications without queueing
+    // the producer again.
+    size_t notify_count = 0;
+    class MockServerCookieApi : public WrappedServerCookieIface {
+    public:
+        explicit MockServerCookieApi(size_t& count) : count(count) {
+        }
+        void notify_io_complete(gsl::not_null<const void*> cookie,
+                                ENGINE_ERROR_CODE status) override {
+            count++;
+        }
+        size_t& count;
+    } scapi(notify_count);
+
+    ASSERT_TRUE(notifyTest.producer->isPaused());
+    for (int ii = 0; ii < 3; ii++) {
+        notifyTest.connMap->addConnectionToPending(
+                notifyTest.producer->shared_from_this());
+    }
+    EXPECT_EQ(3, notifyTest.connMap->getPendingNotifications().size());
+
+    notifyTest.connMap->processPendingNotifications();
+    EXPECT_EQ(1, notify_count);
+    EXPECT_EQ(0, notifyTest.connMap->getPendingNotifications().size());
+}
+
 // Tests that the MutationResponse created for the deletion response is of the
 // correct size.
 TEST_P(ConnectionTest, test_mb24424_deleteResponse) {
@@ -2149,6 +2211,102 @@ TEST_P(ConnectionTest, ReplicateAfterThrottleThreshold) {
     sendConsumerMutationsNearThreshold(true);
 }
 
+/*
+ * With more than one Processor task, a vBucket must only be processed by one
+ * task at a time: a task which takes it from the ready queue while another is
+ * processing it skips it, and it is re-queued when the other task finishes.
+ */
+TEST_P(ConnectionTest, ConsumerConcurrentProcessorsSerialisePerVBucket) {
+    engine->getConfiguration().setDcpConsumerProcessBufferedMessagesConcurrency(
+            2);
+    const void* cookie = create_mock_cookie();
+    auto consumer =
+            std::make_shared<MockDcpConsumer>(*engine, cookie, "test_consumer");
+
+    // First task processing vbid; a second one must skip it.
+    ASSERT_TRUE(consumer->public_startProcessingVBucket(vbid));
+    EXPECT_FALSE(consumer->public_startProcessingVBucket(vbid));
+
+    // Other vBuckets can be processed meanwhile.
+    const Vbid other(1);
+    EXPECT_TRUE(consumer->public_startProcessingVBucket(other));
+    consumer->public_finishProcessingVBucket(other);
+    EXPECT_EQ(0, consumer->public_getVbReadySize());
+
+    // When the first task finishes, vbid is re-queued to be processed.
+    consumer->public_finishProcessingVBucket(vbid);
+    EXPECT_EQ(1, consumer->public_getVbReadySize());
+    destroy_mock_cookie(cookie);
+}
+
+/*
+ * Test that the bdp flow control policy resizes consumer buffers to the size
+ * they ask for, within the min/max sizes and only growing while the aggregate
+ * buffer memory is below the threshold (10% of the quota by default).
+ */
+TEST_P(ConnectionTest, FlowControlBdpResizeWithinAggrThreshold) {
+    const size_t minSize = 10485760;
+    const size_t maxSize = 52428800;
+    engine->getEpStats().setMaxDataSize(400000000);
+    const size_t aggrLimit = 40000000;
+
+    DcpFlowControlManagerBdp manager(*engine);
+    ASSERT_TRUE(manager.isEnabled());
+    ASSERT_TRUE(manager.isAdaptive());
+
+    const void* cookie1 = create_mock_cookie();
+    const void* cookie2 = create_mock_cookie();
+    auto consumer1 =
+            std::make_shared<MockDcpConsumer>(*engine, cookie1, "consumer1");
+    auto consumer2 =
+            std::make_shared<MockDcpConsumer>(*engine, cookie2, "consumer2");
+
+    // Connections start at the min size.
+    auto size1 = manager.newConsumerConn(consumer1.get());
+    EXPECT_EQ(minSize, size1);
+
+    // Small changes are ignored; larger ones are granted.
+    EXPECT_EQ(size1,
+              manager.resizeConsumerConn(consumer1.get(), size1, 11000000));
+    size1 = manager.resizeConsumerConn(consumer1.get(), size1, 30000000);
+    EXPECT_EQ(30000000, size1);
+
+    // The aggregate is now over the threshold, so consumer2 can't grow.
+    auto size2 = manager.newConsumerConn(consumer2.get());
+    EXPECT_EQ(minSize, size2);
+    EXPECT_EQ(size2,
+              manager.resizeConsumerConn(consumer2.get(), size2, maxSize));
+
+    // Shrinking is bounded by the min size, and frees memory for consumer2 -
+    // which can grow up to the threshold (and never beyond the max size).
+    size1 = manager.resizeConsumerConn(consumer1.get(), size1, 1000);
+    EXPECT_EQ(minSize, size1);
+    size2 = manager.resizeConsumerConn(consumer2.get(), size2, 100000000);
+    EXPECT_EQ(aggrLimit - size1, size2);
+
+    destroy_mock_cookie(cookie1);
+    destroy_mock_cookie(cookie2);
+}
+
+/*
+ * With more than one Processor task, each task must see a notification of a
+ * ready vBucket: one task taking it mustn't leave the others asleep.
+ */
+TEST_P(ConnectionTest, ConsumerConcurrentProcessorsEachNotified) {
+    engine->getConfiguration().setDcpConsumerProcessBufferedMessagesConcurrency(
+            2);
+    const void* cookie = create_mock_cookie();
+    auto consumer =
+            std::make_shared<MockDcpConsumer>(*engine, cookie, "test_consumer");
+
+    consumer->public_notifyVbucketReady(vbid);
+    EXPECT_TRUE(consumer->public_notifiedProcessor(0, false));
+    EXPECT_TRUE(consumer->public_notifiedProcessor(1, false));
+    EXPECT_FALSE(consumer->public_notifiedProcessor(0, false));
+    EXPECT_FALSE(consumer->public_notifiedProcessor(1, false));
+    destroy_mock_cookie(cookie);
+}
+
 /* Here we test how the DCP consumer handles the scenario where the memory
    usage is just below the replication throttle threshold, but will go over the
    threshold when it adds the new mutation from the processor buffer to the
@@ -2396,6 +2554,181 @@ TEST_F(ActiveStreamChkptProcessorTaskTest, DeleteDeadStreamEntry) {
     notifyAndStepToCheckpoint();
 }
 
+/*
+ * Test fixture for a DCP consumer with two Processor tasks, which are run by
+ * hand (on the fake executor) so that they can be interleaved.
+ */
+class ConsumerProcessorTasksTest : public SingleThreadedKVBucketTest {
+protected:
+    void SetUp() override {
+        // Bucket Quota 100MB, Replication Threshold 4%
+        config_string +=
+                "max_size=104857600;replication_throttle_threshold=4;"
+                "dcp_consumer_process_buffered_messages_concurrency=2";
+        SingleThreadedKVBucketTest::SetUp();
+        cookie = create_mock_cookie();
+
+        for (auto vb : {vbid, otherVbid}) {
+            setVBucketStateAndRunPersistTask(vb, vbucket_state_replica);
+        }
+        consumer = std::make_shared<MockDcpConsumer>(
+                *engine, cookie, "test_consumer");
+        // The streams get opaques 1 and 2; the tasks are scheduled with the
+        // first stream.
+        ASSERT_EQ(ENGINE_SUCCESS, consumer->addStream(0, vbid, 0 /*flags*/));
+        ASSERT_EQ(ENGINE_SUCCESS,
+                  consumer->addStream(0, otherVbid, 0 /*flags*/));
+    }
+
+    void TearDown() override {
+        consumer->closeAllStreams();
+        consumer.reset();
+        destroy_mock_cookie(cookie);
+        SingleThreadedKVBucketTest::TearDown();
+    }
+
+    uint32_t opaqueFor(Vbid vb) const {
+        return vb == vbid ? 1 : 2;
+    }
+
+    void sendMutation(Vbid vb, uint64_t seqno) {
+        ASSERT_EQ(ENGINE_SUCCESS,
+                  consumer->mutation(
+                          opaqueFor(vb),
+                          makeStoredDocKey("k" + std::to_string(seqno)),
+                          {},
+                          0,
+                          0,
+                          0,
+                          vb,
+                          0,
+                          seqno,
+                          0,
+                          0,
+                          0,
+                          {},
+                          0));
+    }
+
+    MockPassiveStream& getStream(Vbid vb) {
+        return static_cast<MockPassiveStream&>(
+                *consumer->getVbucketStream(vb));
+    }
+
+    /**
+     * Run the next DcpConsumerTask.
+     * @return the task, to check when it's next due to run.
+     */
+    ExTask runProcessorTask() {
+        auto& nonIo = *task_executor->getLpTaskQ()[NONIO_TASK_IDX];
+        CheckedExecutor executor(task_executor, nonIo);
+        executor.runCurrentTask(
+                "DcpConsumerTask, processing buffered items for " +
+                consumer->getName());
+        auto task = executor.getCurrentTask();
+        executor.completeCurrentTask();
+        return task;
+    }
+
+    /// @return the seqnos of the mutations queued for the given vBucket
+    std::vector<int64_t> getQueuedSeqnos(Vbid vb) {
+        auto vbucket = store->getVBucket(vb);
+        std::vector<queued_item> items;
+        vbucket->checkpointManager->getAllItemsForPersistence(items);
+        std::vector<int64_t> seqnos;
+        for (const auto& item : items) {
+            if (!item->isCheckPointMetaItem()) {
+                seqnos.push_back(item->getBySeqno());
+            }
+        }
+        return seqnos;
+    }
+
+    const void* cookie;
+    std::shared_ptr<MockDcpConsumer> consumer;
+    const Vbid otherVbid = Vbid(1);
+};
+
+/*
+ * Two Processor tasks interleaved on the same vBucket: the task which takes
+ * the vBucket while the other is processing it skips it, the vBucket is
+ * re-queued when the first task finishes, its messages are applied in order,
+ * and neither task snoozes while there are vBuckets ready.
+ */
+TEST_F(ConsumerProcessorTasksTest, InterleavedTasksApplyMessagesInOrder) {
+    const uint64_t numItems = 10;
+    for (auto vb : {vbid, otherVbid}) {
+        consumer->snapshotMarker(opaqueFor(vb),
+                                 vb,
+                                 1,
+                                 numItems + 1,
+                                 dcp_marker_flag_t::MARKER_FLAG_MEMORY);
+    }
+
+    // Trick the replication throttle into pausing, so the mutations are
+    // buffered (which readies both vBuckets and wakes both tasks).
+    engine->getReplicationThrottle().adjustWriteQueueCap(0);
+    const size_t size = engine->getEpStats().getMaxDataSize();
+    engine->getEpStats().setMaxDataSize(1);
+    ASSERT_EQ(ReplicationThrottle::Status::Pause,
+              engine->getReplicationThrottle().getStatus());
+    for (uint64_t seqno = 1; seqno <= numItems; ++seqno) {
+        sendMutation(vbid, seqno);
+        sendMutation(otherVbid, seqno);
+    }
+    ASSERT_EQ(numItems, getStream(vbid).getNumBufferItems());
+    ASSERT_EQ(numItems, getStream(otherVbid).getNumBufferItems());
+    engine->getEpStats().setMaxDataSize(size);
+    ASSERT_EQ(2, consumer->public_getVbReadySize());
+
+    // While the first task is processing vbid: another mutation for it
+    // arrives (and, as there are messages buffered, is buffered behind them,
+    // readying vbid again), and the second task runs twice - processing
+    // otherVbid and then taking vbid from the ready queue, which it must
+    // skip.
+    ExTask second;
+    bool hookRan = false;
+    std::function<void()> hook = [this, &second, &hookRan, numItems]() {
+        if (hookRan) {
+            return;
+        }
+        hookRan = true;
+        sendMutation(vbid, numItems + 1);
+        EXPECT_EQ(2, consumer->public_getVbReadySize());
+
+        second = runProcessorTask();
+        EXPECT_EQ(0, getStream(otherVbid).getNumBufferItems());
+        EXPECT_LE(second->getWaketime(), std::chrono::steady_clock::now());
+        EXPECT_EQ(1, consumer->public_getVbReadySize());
+
+        EXPECT_EQ(second, runProcessorTask());
+        EXPECT_EQ(0, consumer->public_getVbReadySize());
+        // Nothing is ready, so the second task may now snooze.
+        EXPECT_GT(second->getWaketime(), std::chrono::steady_clock::now());
+    };
+    getStream(vbid).setProcessBufferedMessages_postFront_Hook(hook);
+
+    auto first = runProcessorTask();
+    ASSERT_TRUE(hookRan);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(0, getStream(vbid).getNumBufferItems());
+
+    // vbid was re-queued for the second task, which was woken for it, and
+    // the first task runs again too.
+    EXPECT_EQ(1, consumer->public_getVbReadySize());
+    EXPECT_LE(first->getWaketime(), std::chrono::steady_clock::now());
+    EXPECT_LE(second->getWaketime(), std::chrono::steady_clock::now());
+    runProcessorTask();
+    runProcessorTask();
+    EXPECT_EQ(0, consumer->public_getVbReadySize());
+
+    std::vector<int64_t> expected(numItems + 1);
+    std::iota(expected.begin(), expected.end(), 1);
+    EXPECT_EQ(expected, getQueuedSeqnos(vbid));
+    expected.pop_back();
+    EXPECT_EQ(expected, getQueuedSeqnos(otherVbid));
+}
+
 struct PrintToStringCombinedNameXattrOnOff {
     std::string operator()(
             const ::testing::TestParamInfo<::testing::tuple<std::string, bool>>&
@@ -390,6 +390,56 @@ TEST_P(DefragmenterTest, DISABLED_MaxDefragValueSize) {
                       get_mock_server_api()->alloc_hooks));
 }
 
+/// Whether the fake allocator below reports the slabs as sparsely used
+static bool fakeSlabsSparse = false;
+
+/// Reports each slab as 90% free (sparse) or 10% free (dense), in a size
+/// class which is half free.
+static bool fake_get_slab_utilization(const void* ptr,
+                                      allocator_slab_utilization* util) {
+    util->nfree = fakeSlabsSparse ? 9 : 1;
+    util->nregs = 10;
+    util->size = 128;
+    util->bin_nfree = 50;
+    util->bin_nregs = 100;
+    util->is_current = false;
+    return true;
+}
+
+// Check that, given the utilization of the slabs, only the documents in the
+// sparsely used slabs are moved.
+TEST_P(DefragmenterTest, OnlySparseSlabsMoved) {
+    const size_t num_docs = 10;
+    setDocs(64, num_docs);
+
+    ServerAllocatorIface hooks = *get_mock_server_api()->alloc_hooks;
+    hooks.get_slab_utilization = fake_get_slab_utilization;
+
+    for (const bool sparse : {false, true}) {
+        fakeSlabsSparse = sparse;
+        auto defragVisitor = std::make_unique<DefragmentVisitor>(4096);
+        defragVisitor->setDeadline(std::chrono::steady_clock::now() +
+                                   std::chrono::hours(5));
+        defragVisitor->setAllocHooks(&hooks);
+
+        PauseResumeVBAdapter prAdapter(std::move(defragVisitor));
+        prAdapter.visit(*vbucket);
+
+        auto& visitor =
+                dynamic_cast<DefragmentVisitor&>(prAdapter.getHTVisitor());
+        EXPECT_EQ(num_docs, visitor.getVisitedCount());
+        if (sparse) {
+            EXPECT_EQ(num_docs, visitor.getDefragCount());
+            EXPECT_LT(num_docs * 64, visitor.getDefragBytes());
+            EXPECT_EQ(0, visitor.getSkippedCount());
+        } else {
+            EXPECT_EQ(0, visitor.getDefragCount());
+            EXPECT_EQ(0, visitor.getDefragBytes());
+            EXPECT_EQ(num_docs, visitor.getSkippedCount());
+        }
+    }
+}
+
 INSTANTIATE_TEST_CASE_P(
         FullAndValueEviction,
         DefragmenterTest,
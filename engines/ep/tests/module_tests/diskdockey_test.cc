@@ -87,6 +87,36 @@ TEST_P(DiskDocKeyTest, construct_prepared) {
               key1_pre.getDocKey().getIdAndKey());
 }
 
+// Every key of a collection (and only that collection) is within its range,
+// and its prepares are within its prepared range.
+TEST_P(DiskDocKeyTest, collectionRange) {
+    auto inRange = [](const DiskDocKey& key,
+                      const std::pair<DiskDocKey, DiskDocKey>& range) {
+        return !(key < range.first) && key < range.second;
+    };
+    const auto committed = DiskDocKey::collectionRange(GetParam());
+    const auto prepared = DiskDocKey::collectionRange(GetParam(), true);
+
+    for (const auto* key : {"", "a", "key", "\xff\xff"}) {
+        DiskDocKey committedKey{StoredDocKey{key, GetParam()}};
+        DiskDocKey preparedKey{StoredDocKey{key, GetParam()}, true};
+        EXPECT_TRUE(inRange(committedKey, committed)) << key;
+        EXPECT_FALSE(inRange(committedKey, prepared)) << key;
+        EXPECT_TRUE(inRange(preparedKey, prepared)) << key;
+        EXPECT_FALSE(inRange(preparedKey, committed)) << key;
+
+        // Including collections whose leb128 encoding starts with the same
+        // byte.
+        for (CollectionID other :
+             {CollectionID(uint32_t(GetParam()) + 1),
+              CollectionID(uint32_t(GetParam()) + 128),
+              CollectionID(uint32_t(GetParam()) + 256)}) {
+            DiskDocKey otherKey{StoredDocKey{key, other}};
+            EXPECT_FALSE(inRange(otherKey, committed)) << key;
+        }
+    }
+}
+
 TEST_P(DiskDocKeyTestCombi, equalityOperators) {
     DiskDocKey key1{StoredDocKey{"key1", std::get<0>(GetParam())}};
     DiskDocKey key2{StoredDocKey{"key1", std::get<1>(GetParam())}};
@@ -20,12 +20,18 @@
 #include "checkpoint_manager.h"
 #include "dcp/backfill-manager.h"
 #include "ephemeral_bucket.h"
+#include "ephemeral_restart_snapshot.h"
+#include "ephemeral_vb.h"
+#include "failover-table.h"
 #include "test_helpers.h"
 
 #include "../mock/mock_checkpoint_manager.h"
 #include "../mock/mock_dcp_consumer.h"
 #include "../mock/mock_synchronous_ep_engine.h"
 #include "dcp/dcpconnmap.h"
+
+#include <platform/dirutils.h>
+
 /*
  * Test statistics related to an individual VBucket's sequence list.
  */
@@ -283,3 +289,70 @@ TEST_F(SingleThreadedEphemeralPurgerTest, PurgeAcrossAllVbuckets) {
     EXPECT_GT(numPaused, 2 /* 1 run of 'HTCleaner' and more than 1 run of
                               'EphTombstoneStaleItemDeleter' */);
 }
+
+class SingleThreadedEphemeralRestartSnapshotTest
+    : public SingleThreadedKVBucketTest {
+protected:
+    void SetUp() override {
+        config_string +=
+                "bucket_type=ephemeral;"
+                "ephemeral_restart_snapshot=true";
+        SingleThreadedKVBucketTest::SetUp();
+    }
+};
+
+// Test that a clean shutdown snapshots a vBucket, and that startup recreates
+// it from the snapshot - at the same seqno and failover table, with its
+// items (and tombstones) in the sequence list.
+TEST_F(SingleThreadedEphemeralRestartSnapshotTest, ReloadsVBucket) {
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+    const auto key1 = makeStoredDocKey("key1");
+    const auto key2 = makeStoredDocKey("key2");
+    store_item(vbid, key1, "value1");
+    store_item(vbid, key2, "value2");
+    store_item(vbid, key1, "value3");
+    delete_item(vbid, key2);
+
+    auto vb = store->getVBucket(vbid);
+    const auto highSeqno = vb->getHighSeqno();
+    const auto uuid = vb->failovers->getLatestUUID();
+    const auto cas = vb->ht.findForRead(key1).storedValue->getCas();
+    vb.reset();
+
+    shutdownAndPurgeTasks(engine.get());
+    reinitialise(config_string);
+    dynamic_cast<EphemeralBucket*>(store)->loadRestartSnapshots();
+
+    // The snapshot is only ever loaded once.
+    EXPECT_FALSE(cb::io::isFile(EphemeralRestartSnapshot::getPath(
+            engine->getConfiguration().getDbname(), vbid)));
+
+    vb = store->getVBucket(vbid);
+    ASSERT_TRUE(vb);
+    EXPECT_EQ(vbucket_state_active, vb->getState());
+    EXPECT_EQ(highSeqno, vb->getHighSeqno());
+    EXPECT_EQ(uuid, vb->failovers->getLatestUUID());
+    EXPECT_EQ(1, vb->getNumItems());
+
+    auto result = vb->ht.findForRead(key1);
+    ASSERT_TRUE(result.storedValue);
+    EXPECT_EQ(cas, result.storedValue->getCas());
+    EXPECT_EQ(highSeqno - 1, result.storedValue->getBySeqno());
+    EXPECT_EQ("value3", result.storedValue->getValue()->to_s());
+
+    result = vb->ht.findForRead(key2, TrackReference::No, WantsDeleted::Yes);
+    ASSERT_TRUE(result.storedValue);
+    EXPECT_TRUE(result.storedValue->isDeleted());
+    EXPECT_EQ(highSeqno, result.storedValue->getBySeqno());
+
+    // Only the latest revision of each key is in the sequence list.
+    auto rangeItr =
+            dynamic_cast<EphemeralVBucket&>(*vb).makeRangeIterator(false);
+    ASSERT_TRUE(rangeItr);
+    EXPECT_EQ(2u, rangeItr->count());
+    rangeItr.reset();
+
+    // The vBucket takes new writes from the restored seqno.
+    store_item(vbid, makeStoredDocKey("key3"), "value");
+    EXPECT_EQ(highSeqno + 1, vb->getHighSeqno());
+}
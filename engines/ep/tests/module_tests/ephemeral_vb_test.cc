@@ -653,7 +653,7 @@ TEST_F(EphTombstoneTest, ImmediatePurgeOfAliveStale) {
     // be added for that key.
     auto& seqList = mockEpheVB->getLL()->getSeqList();
     {
-        std::lock_guard<std::mutex> rrGuard(
+        std::lock_guard<folly::SharedMutex> rrGuard(
                 mockEpheVB->getLL()->getRangeReadLock());
         mockEpheVB->registerFakeReadRange(1, 2);
         ASSERT_EQ(MutationStatus::WasClean, setOne(keys.at(1)));
@@ -923,10 +923,11 @@ TEST_F(EphemeralVBucketTest, SnapshotHasNoDuplicatesWithMultipleStale) {
 
 // Check that tombstone purger runs fine in pause-resume mode
 TEST_F(EphTombstoneTest, PurgePauseResume) {
-    // Delete the second item
+    // Delete the second and third items
     softDeleteOne(keys.at(1), MutationStatus::WasDirty);
-    ASSERT_EQ(keys.size() - 1, vbucket->getNumItems());
-    ASSERT_EQ(1, vbucket->getNumInMemoryDeletes());
+    softDeleteOne(keys.at(2), MutationStatus::WasDirty);
+    ASSERT_EQ(keys.size() - 2, vbucket->getNumItems());
+    ASSERT_EQ(2, vbucket->getNumInMemoryDeletes());
 
     // Add one key as we do not purge the last element
     setOne(makeStoredDocKey("last_key"));
@@ -935,19 +936,20 @@ TEST_F(EphTombstoneTest, PurgePauseResume) {
     TimeTraveller looper(30);
 
     // Purge 1/2: mark tombstones older than 10s as stale
-    EXPECT_EQ(1, mockEpheVB->markOldTombstonesStale(10));
-    EXPECT_EQ(keys.size(), vbucket->getNumItems());
+    EXPECT_EQ(2, mockEpheVB->markOldTombstonesStale(10));
+    EXPECT_EQ(keys.size() - 1, vbucket->getNumItems());
     EXPECT_EQ(nullptr, findValue(keys.at(1)));
+    EXPECT_EQ(nullptr, findValue(keys.at(2)));
 
-    // Purge 2/2: delete the stale item. Set the max purge duration to 0 to
+    // Purge 2/2: delete the stale items. Set the max purge duration to 0 to
     //            simulate pause-resume
     int numPurged = 0, numPaused = -1;
-    while (numPurged != 1) {
+    while (numPurged != 2) {
         numPurged += mockEpheVB->purgeStaleItems([]() { return true; });
         ++numPaused;
     }
-    EXPECT_EQ(keys.size() + 1, vbucket->getPurgeSeqno())
-            << "Should have purged up to 4th update (1st delete, after 3 sets)";
+    EXPECT_EQ(keys.size() + 2, vbucket->getPurgeSeqno())
+            << "Should have purged up to 5th update (2nd delete, after 3 sets)";
     EXPECT_GE(numPaused, 1)
             << "Test expected to simulate atleast one pause-resume";
 }
@@ -0,0 +1,133 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the EvictedMetaIndex class.
+ */
+
+#include "evicted_meta_index.h"
+
+#include <folly/portability/GTest.h>
+
+#include <map>
+#include <random>
+
+static EvictedMetaIndex::Meta makeMeta(uint64_t n) {
+    return {n,
+            int64_t(n) + 1,
+            n + 2,
+            uint32_t(n + 3),
+            uint32_t(n + 4),
+            PROTOCOL_BINARY_DATATYPE_JSON,
+            CommittedState::CommittedViaPrepare};
+}
+
+TEST(EvictedMetaIndexTest, Disabled) {
+    EvictedMetaIndex index(0);
+    EXPECT_FALSE(index.isEnabled());
+    EXPECT_FALSE(index.insert(1, makeMeta(1)));
+    EXPECT_FALSE(index.take(1));
+    EXPECT_EQ(0, index.getMemoryUsage());
+}
+
+TEST(EvictedMetaIndexTest, InsertTake) {
+    EvictedMetaIndex index(100);
+    ASSERT_TRUE(index.isEnabled());
+    EXPECT_TRUE(index.insert(0x1234, makeMeta(10)));
+    EXPECT_EQ(1, index.size());
+    EXPECT_NE(0, index.getMemoryUsage());
+
+    // Replacing an entry doesn't add one.
+    EXPECT_TRUE(index.insert(0x1234, makeMeta(20)));
+    EXPECT_EQ(1, index.size());
+
+    EXPECT_FALSE(index.take(0x4321));
+    auto meta = index.take(0x1234);
+    ASSERT_TRUE(meta);
+    EXPECT_EQ(20, meta->cas);
+    EXPECT_EQ(21, meta->bySeqno);
+    EXPECT_EQ(22, meta->revSeqno);
+    EXPECT_EQ(23, meta->flags);
+    EXPECT_EQ(24, meta->exptime);
+    EXPECT_EQ(PROTOCOL_BINARY_DATATYPE_JSON, meta->datatype);
+    EXPECT_EQ(CommittedState::CommittedViaPrepare, meta->committed);
+    EXPECT_EQ(0, index.size());
+    EXPECT_EQ(1, index.getNumHits());
+
+    EXPECT_FALSE(index.take(0x1234));
+}
+
+// Fingerprint 0 (which marks an empty slot) is still indexed.
+TEST(EvictedMetaIndexTest, ZeroFingerprint) {
+    EvictedMetaIndex index(100);
+    EXPECT_TRUE(index.insert(0, makeMeta(1)));
+    EXPECT_TRUE(index.take(0));
+}
+
+TEST(EvictedMetaIndexTest, Full) {
+    const size_t maxEntries = 1000;
+    EvictedMetaIndex index(maxEntries);
+    size_t inserted = 0;
+    for (uint64_t fp = 1; fp < 10 * maxEntries; ++fp) {
+        // Spread the fingerprints over the shards.
+        if (index.insert(fp * 0x9E3779B97F4A7C15ull, makeMeta(fp))) {
+            ++inserted;
+        }
+    }
+    EXPECT_EQ(inserted, index.size());
+    EXPECT_GE(inserted, maxEntries);
+    EXPECT_LT(inserted, maxEntries + EvictedMetaIndex::NumShards);
+
+    index.clear();
+    EXPECT_EQ(0, index.size());
+    EXPECT_EQ(0, index.getMemoryUsage());
+}
+
+// Mix of operations on clustered fingerprints, checked against a std::map.
+TEST(EvictedMetaIndexTest, MatchesMap) {
+    EvictedMetaIndex index(1000);
+    std::map<uint64_t, uint64_t> expected;
+    std::mt19937_64 rng(0);
+    for (uint64_t ii = 0; ii < 100000; ++ii) {
+        // Few distinct low bits, so probe sequences are long and overlap.
+        const uint64_t fp = (rng() & 0xf000000000000000ull) | (rng() % 3000);
+        switch (rng() % 3) {
+        case 0:
+            if (index.insert(fp, makeMeta(ii))) {
+                expected[fp] = ii;
+            } else {
+                EXPECT_EQ(0, expected.count(fp));
+            }
+            break;
+        case 1: {
+            auto meta = index.take(fp);
+            auto it = expected.find(fp);
+            ASSERT_EQ(it != expected.end(), bool(meta));
+            if (meta) {
+                EXPECT_EQ(it->second, meta->cas);
+                expected.erase(it);
+            }
+            break;
+        }
+        case 2:
+            index.erase(fp);
+            expected.erase(fp);
+            break;
+        }
+        ASSERT_EQ(expected.size(), index.size());
+    }
+}
@@ -0,0 +1,89 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "eviction_ghost_list.h"
+#include "stats.h"
+#include "tests/module_tests/test_helpers.h"
+
+#include <folly/portability/GTest.h>
+
+class EvictionGhostListTest : public ::testing::Test {
+protected:
+    EPStats stats;
+};
+
+TEST_F(EvictionGhostListTest, SizeRoundedUp) {
+    EXPECT_EQ(1, EvictionGhostList(stats, 1).size());
+    EXPECT_EQ(1024, EvictionGhostList(stats, 1000).size());
+    EXPECT_THROW(EvictionGhostList(stats, 0), std::invalid_argument);
+}
+
+// A fetch of an evicted key is counted (once), with the time since the
+// eviction; fetches of keys which weren't evicted aren't.
+TEST_F(EvictionGhostListTest, RefetchCounted) {
+    EvictionGhostList ghosts(stats, 1024);
+    const auto evicted = makeStoredDocKey("evicted");
+    const auto other = makeStoredDocKey("other");
+
+    ghosts.recordEviction(evicted, 100, false);
+    EXPECT_FALSE(ghosts.recordFetch(other, 105));
+    EXPECT_EQ(0, stats.evictedRefetched);
+
+    EXPECT_TRUE(ghosts.recordFetch(evicted, 105));
+    EXPECT_EQ(1, stats.evictedRefetched);
+    EXPECT_EQ(1, stats.evictionRefetchIntervalHisto.getValueCount());
+    EXPECT_EQ(5, stats.evictionRefetchIntervalHisto.getMaxValue());
+
+    // Fetched again without being evicted in between - not counted.
+    EXPECT_FALSE(ghosts.recordFetch(evicted, 106));
+    EXPECT_EQ(1, stats.evictedRefetched);
+}
+
+// Later evictions overwrite earlier ones which map to the same slot, so only
+// (roughly) the last size() evictions are remembered.
+TEST_F(EvictionGhostListTest, OldEvictionsForgotten) {
+    EvictionGhostList ghosts(stats, 1);
+    const auto first = makeStoredDocKey("first");
+    const auto second = makeStoredDocKey("second");
+
+    ghosts.recordEviction(first, 0, false);
+    ghosts.recordEviction(second, 1, false);
+    EXPECT_FALSE(ghosts.recordFetch(first, 2));
+    EXPECT_TRUE(ghosts.recordFetch(second, 2));
+    EXPECT_EQ(1, stats.evictedRefetched);
+}
+
+// Refetches of unreferenced items move the recency target up, refetches of
+// referenced items move it down, within 0-100.
+TEST_F(EvictionGhostListTest, RecencyTargetAdapts) {
+    EvictionGhostList ghosts(stats, 1024);
+    const auto key = makeStoredDocKey("key");
+    ASSERT_EQ(EvictionGhostList::initialRecencyTarget,
+              ghosts.getRecencyTarget());
+
+    ghosts.recordEviction(key, 10, false);
+    ASSERT_TRUE(ghosts.recordFetch(key, 11));
+    EXPECT_EQ(EvictionGhostList::initialRecencyTarget + 1,
+              ghosts.getRecencyTarget());
+
+    for (int ii = 0; ii < 200; ++ii) {
+        ghosts.recordEviction(key, 10, true);
+        ASSERT_TRUE(ghosts.recordFetch(key, 11));
+    }
+    EXPECT_EQ(0, ghosts.getRecencyTarget());
+    EXPECT_EQ(1, stats.evictionRefetchIntervalHisto.getMaxValue());
+}
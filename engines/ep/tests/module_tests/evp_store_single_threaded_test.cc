@@ -37,16 +37,19 @@
 #include "evp_store_test.h"
 #include "failover-table.h"
 #include "fakes/fake_executorpool.h"
-#include "item_freq_decayer_visitor.h"
 #include "programs/engine_testapp/mock_server.h"
 #include "taskqueue.h"
 #include "tests/module_tests/test_helpers.h"
 #include "tests/module_tests/test_task.h"
 
+#include <platform/compress.h>
+#include <platform/dirutils.h>
+#include <platform/string_hex.h>
 #include <string_utilities.h>
 #include <xattr/blob.h>
 #include <xattr/utils.h>
 
+#include <algorithm>
 #include <thread>
 #include <engines/ep/src/ephemeral_vb.h>
 
@@ -1671,6 +1674,79 @@ TEST_F(SingleThreadedEPBucketTest, MB19892_BackfillNotDeleted) {
                                        {}));
 }
 
+/*
+ * Test that with dcp_backfill_concurrency > 1 a producer schedules a
+ * BackfillManagerTask per backfill (up to the limit), and that the backfills
+ * still all complete.
+ */
+TEST_F(SingleThreadedEPBucketTest, BackfillConcurrency) {
+    engine->getConfiguration().setDcpBackfillConcurrency(2);
+
+    // Three vBuckets whose items are only on disk, so a stream of each has
+    // to backfill.
+    const std::vector<Vbid> vbids = {Vbid(0), Vbid(1), Vbid(2)};
+    for (auto id : vbids) {
+        setVBucketStateAndRunPersistTask(id, vbucket_state_active);
+        store_item(id, makeStoredDocKey("key"), "value");
+        auto vb = store->getVBuckets().getBucket(id);
+        auto& ckpt_mgr = *vb->checkpointManager;
+        ckpt_mgr.createNewCheckpoint();
+        EXPECT_EQ(std::make_pair(false, size_t(1)),
+                  getEPBucket().flushVBucket(id));
+        bool new_ckpt_created;
+        EXPECT_EQ(1,
+                  ckpt_mgr.removeClosedUnrefCheckpoints(*vb, new_ckpt_created));
+    }
+
+    auto producer = std::make_shared<MockDcpProducer>(*engine,
+                                                      cookie,
+                                                      "test_producer",
+                                                      /*notifyOnly*/ false);
+    auto& lpAuxioQ = *task_executor->getLpTaskQ()[AUXIO_TASK_IDX];
+    const auto initialTasks = lpAuxioQ.getFutureQueueSize();
+
+    std::vector<std::shared_ptr<MockActiveStream>> streams;
+    for (auto id : vbids) {
+        auto vb = store->getVBuckets().getBucket(id);
+        streams.push_back(std::make_shared<MockActiveStream>(
+                static_cast<EventuallyPersistentEngine*>(engine.get()),
+                producer,
+                /*flags*/ 0,
+                /*opaque*/ 0,
+                *vb,
+                /*st_seqno*/ 0,
+                /*en_seqno*/ ~0,
+                /*vb_uuid*/ 0xabcd,
+                /*snap_start_seqno*/ 0,
+                /*snap_end_seqno*/ ~0,
+                IncludeValue::Yes,
+                IncludeXattrs::Yes));
+        streams.back()->transitionStateToBackfilling();
+        ASSERT_TRUE(streams.back()->isBackfilling());
+    }
+
+    // Three backfills, but only two tasks to run them.
+    EXPECT_EQ(initialTasks + 2, lpAuxioQ.getFutureQueueSize());
+
+    // Each backfill needs create, scan and complete steps; run until both
+    // tasks have finished.
+    while (lpAuxioQ.getFutureQueueSize() > initialTasks) {
+        runNextTask(lpAuxioQ, "Backfilling items for a DCP Connection");
+    }
+    EXPECT_EQ(0, producer->getBFM().getNumRunningBackfills());
+
+    for (auto& stream : streams) {
+        auto resp = stream->next();
+        ASSERT_TRUE(resp);
+        EXPECT_EQ(DcpResponse::Event::SnapshotMarker, resp->getEvent());
+        resp = stream->next();
+        ASSERT_TRUE(resp);
+        EXPECT_EQ(DcpResponse::Event::Mutation, resp->getEvent());
+    }
+
+    producer->cancelCheckpointCreatorTask();
+}
+
 /*
  * Test that the DCP processor returns a 'yield' return code when
  * working on a large enough buffer size.
@@ -2408,21 +2484,21 @@ TEST_F(SingleThreadedEPBucketTest, mb25273) {
     EXPECT_EQ(value.size(), gv.item->getValue()->valueSize());
 }
 
-// Test the item freq decayer task.  A mock version of the task is used,
-// which has the ChunkDuration reduced to 0ms which mean as long as the
-// number of documents is greater than
-// ProgressTracker:INITIAL_VISIT_COUNT_CHECK the task will require multiple
-// runs to complete.  If the task takes less than or more than two passes to
-// complete then an error will be reported.
+// Test the item freq decayer task. A single run of the task should decay
+// the frequency counter of every document (when next accessed), without
+// visiting them.
 TEST_F(SingleThreadedEPBucketTest, ItemFreqDecayerTaskTest) {
     setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
 
-    // ProgressTracker:INITIAL_VISIT_COUNT_CHECK = 100 and therefore
-    // add 110 documents to the hash table to ensure all documents cannot be
-    // visited in a single pass.
+    std::vector<StoredDocKey> keys;
     for (uint32_t ii = 1; ii < 110; ii++) {
-        auto key = makeStoredDocKey("DOC_" + std::to_string(ii));
-        store_item(vbid, key, "value");
+        keys.push_back(makeStoredDocKey("DOC_" + std::to_string(ii)));
+        store_item(vbid, keys.back(), "value");
+    }
+
+    auto vb = store->getVBucket(vbid);
+    for (const auto& key : keys) {
+        vb->ht.findForWrite(key).storedValue->setFreqCounterValue(100);
     }
 
     auto& lpNonioQ = *task_executor->getLpTaskQ()[NONIO_TASK_IDX];
@@ -2434,12 +2510,14 @@ TEST_F(SingleThreadedEPBucketTest, ItemFreqDecayerTaskTest) {
     EXPECT_EQ(1, lpNonioQ.getFutureQueueSize());
     itemFreqDecayerTask->wakeup();
 
-    EXPECT_FALSE(itemFreqDecayerTask->isCompleted());
+    const auto epoch = vb->ht.getFreqDecayEpoch();
     runNextTask(lpNonioQ, "Item frequency count decayer task");
-    EXPECT_FALSE(itemFreqDecayerTask->isCompleted());
-    runNextTask(lpNonioQ, "Item frequency count decayer task");
-    // The item freq decayer task should have completed.
-    EXPECT_TRUE(itemFreqDecayerTask->isCompleted());
+    EXPECT_EQ(epoch + 1, vb->ht.getFreqDecayEpoch());
+
+    for (const auto& key : keys) {
+        EXPECT_EQ(50,
+                  vb->ht.findForWrite(key).storedValue->getFreqCounterValue());
+    }
 }
 
 // Test to confirm that the ItemFreqDecayerTask gets created on kv_bucket
@@ -2579,6 +2657,100 @@ TEST_P(XattrSystemUserTest, MB_29040) {
             << "The meta attribute should be gone";
 }
 
+/// Stands in for an unexpanded ${Mutation.CAS}: subdoc pads the macro to the
+/// length of its expansion ("0x" and 16 hex digits) so it can be replaced in
+/// place.
+static const std::string casMacro = "${Mutation.CAS}___";
+
+/// pre_link callback which expands casMacro in place, as
+/// SubdocCmdContext::pre_link_document does.
+static void expandCasMacro(item_info& info) {
+    auto* begin = static_cast<char*>(info.value[0].iov_base);
+    auto* end = begin + info.value[0].iov_len;
+    auto* macro = std::search(begin, end, casMacro.begin(), casMacro.end());
+    ASSERT_NE(end, macro) << "the value should contain the macro";
+    std::string cas = cb::to_hex(info.cas);
+    std::copy(cas.begin(), cas.end(), macro);
+}
+
+/// @return the "_sync" xattr of the given (possibly Snappy) value
+static std::string getSyncXattr(std::string value,
+                                protocol_binary_datatype_t datatype) {
+    if (mcbp::datatype::is_snappy(datatype)) {
+        cb::compression::Buffer inflated;
+        EXPECT_TRUE(cb::compression::inflate(
+                cb::compression::Algorithm::Snappy, value, inflated));
+        value.assign(inflated.data(), inflated.size());
+    }
+    cb::char_buffer buffer{const_cast<char*>(value.data()), value.size()};
+    return to_string(cb::xattr::Blob(buffer, false).get("_sync"));
+}
+
+// Check that values queued into checkpoints compressed still carry the xattr
+// macros expanded by pre_link: both the flusher and DCP must see the
+// expanded value.
+TEST_F(SingleThreadedEPBucketTest, CompressValuesAfterPreLink) {
+    engine->getConfiguration().setChkCompressValues(true);
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+    auto vb = store->getVBucket(vbid);
+
+    auto producer = createDcpProducer(cookie, IncludeDeleteTime::No);
+    auto producers = std::make_unique<MockDcpMessageProducers>(engine.get());
+    producer->mockActiveStreamRequest(0, // flags
+                                      1, // opaque
+                                      *vb,
+                                      0, // start_seqno
+                                      ~0, // end_seqno
+                                      0, // vbucket_uuid,
+                                      0, // snap_start_seqno,
+                                      0); // snap_end_seqno,
+
+    cb::xattr::Blob blob;
+    blob.set("_sync", "{\"cas\":\"" + casMacro + "\"}");
+    auto xattrs = blob.finalize();
+    // A body which compresses well.
+    const std::string value =
+            std::string(xattrs.buf, xattrs.len) + std::string(1024, 'x');
+
+    auto key = makeStoredDocKey("key");
+    mock_set_pre_link_function(expandCasMacro);
+    store_item(vbid,
+               key,
+               value,
+               0,
+               {cb::engine_errc::success},
+               PROTOCOL_BINARY_DATATYPE_XATTR);
+    mock_set_pre_link_function({});
+    EXPECT_LT(0, engine->getEpStats().checkpointCompressedBytesSaved);
+
+    auto cas = vb->ht.findForRead(key).storedValue->getCas();
+    const std::string expected = "{\"cas\":\"" + cb::to_hex(cas) + "\"}";
+
+    // DCP
+    notifyAndStepToCheckpoint(*producer, *producers);
+    EXPECT_EQ(ENGINE_SUCCESS, producer->step(producers.get()));
+    ASSERT_EQ(cb::mcbp::ClientOpcode::DcpMutation, producers->last_op);
+    EXPECT_EQ(expected,
+              getSyncXattr(producers->last_value, producers->last_datatype));
+
+    // Disk
+    flush_vbucket_to_disk(vbid, 1);
+    evict_key(vbid, key);
+    auto options = static_cast<get_options_t>(QUEUE_BG_FETCH);
+    ASSERT_EQ(ENGINE_EWOULDBLOCK,
+              store->get(key, vbid, cookie, options).getStatus());
+    runBGFetcherTask();
+    auto gv = store->get(key, vbid, cookie, options);
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ(expected,
+              getSyncXattr(std::string(gv.item->getData(),
+                                       gv.item->getNBytes()),
+                           gv.item->getDataType()));
+
+    producer->closeAllStreams();
+    producer->cancelCheckpointCreatorTask();
+}
+
 class MB_29287 : public SingleThreadedEPBucketTest {
 public:
     void SetUp() override {
@@ -3637,6 +3809,91 @@ TEST_F(SingleThreadedEPBucketTest, ProducerReadyQConnectionLimitOnBackfill) {
     producerReadyQLimitOnBackfill(BackfillBufferLimit::ConnectionByte);
 }
 
+/*
+ * Test that a stream of a producer with persisted_only enabled never registers
+ * a checkpoint cursor, and sends each item once it has been persisted, by
+ * backfilling again from disk.
+ */
+TEST_F(SingleThreadedEPBucketTest, PersistedOnlyStream) {
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+    auto vb = store->getVBuckets().getBucket(vbid);
+    auto& ckpt_mgr = *vb->checkpointManager;
+
+    store_item(vbid, makeStoredDocKey("key1"), "value");
+    flushVBucketToDiskIfPersistent(vbid, 1);
+    // Not persisted (yet)
+    store_item(vbid, makeStoredDocKey("key2"), "value");
+
+    auto producer = std::make_shared<MockDcpProducer>(*engine,
+                                                      cookie,
+                                                      "test_producer",
+                                                      /*flags*/ 0,
+                                                      /*startTask*/ false);
+    ASSERT_EQ(ENGINE_SUCCESS,
+              producer->control(0, "persisted_only", "true"));
+
+    auto stream = std::make_shared<MockActiveStream>(
+            engine.get(),
+            producer,
+            /*flags*/ 0,
+            /*opaque*/ 0,
+            *vb,
+            /*st_seqno*/ 0,
+            /*en_seqno*/ ~0,
+            /*vb_uuid*/ 0xabcd,
+            /*snap_start_seqno*/ 0,
+            /*snap_end_seqno*/ ~0);
+    ASSERT_TRUE(stream->isPersistedOnly());
+
+    const auto cursors = ckpt_mgr.getNumOfCursors();
+    stream->transitionStateToBackfilling();
+    EXPECT_EQ(cursors, ckpt_mgr.getNumOfCursors());
+
+    auto& lpAuxioQ = *task_executor->getLpTaskQ()[AUXIO_TASK_IDX];
+    auto runBackfill = [this, &lpAuxioQ]() {
+        // backfill:create()
+        runNextTask(lpAuxioQ);
+        // backfill:scan()
+        runNextTask(lpAuxioQ);
+        // backfill:complete()
+        runNextTask(lpAuxioQ);
+        // backfill:finished()
+        runNextTask(lpAuxioQ);
+    };
+
+    // Only key1 has been persisted, so is the only item sent.
+    runBackfill();
+    auto resp = stream->next();
+    ASSERT_TRUE(resp);
+    EXPECT_EQ(DcpResponse::Event::SnapshotMarker, resp->getEvent());
+    resp = stream->next();
+    ASSERT_TRUE(resp);
+    EXPECT_EQ(DcpResponse::Event::Mutation, resp->getEvent());
+    EXPECT_EQ(1, *resp->getBySeqno());
+    EXPECT_FALSE(stream->next());
+    EXPECT_TRUE(stream->isBackfilling());
+    EXPECT_EQ(cursors, ckpt_mgr.getNumOfCursors());
+
+    // Once key2 is persisted the stream backfills it.
+    flushVBucketToDiskIfPersistent(vbid, 1);
+    EXPECT_FALSE(stream->next());
+    runBackfill();
+    resp = stream->next();
+    ASSERT_TRUE(resp);
+    EXPECT_EQ(DcpResponse::Event::SnapshotMarker, resp->getEvent());
+    resp = stream->next();
+    ASSERT_TRUE(resp);
+    EXPECT_EQ(DcpResponse::Event::Mutation, resp->getEvent());
+    EXPECT_EQ(2, *resp->getBySeqno());
+    EXPECT_FALSE(stream->next());
+    EXPECT_TRUE(stream->isBackfilling());
+    EXPECT_EQ(cursors, ckpt_mgr.getNumOfCursors());
+
+    // BackfillManagerTask
+    runNextTask(lpAuxioQ);
+    producer->cancelCheckpointCreatorTask();
+}
+
 /*
  * Test to verify that if retain_erroneous_tombstones is set to
  * true, then the compactor will retain the tombstones, and if
@@ -3776,6 +4033,68 @@ TEST_F(SingleThreadedEPBucketTest, testValidTombstonePurgeOnRetainErroneousTombs
     EXPECT_EQ(2, store->getVBucket(vbid)->getPurgeSeqno());
 }
 
+class ValueSpillCacheBucketTest : public SingleThreadedEPBucketTest {
+protected:
+    void SetUp() override {
+        spillCachePath = cb::io::mktemp("value_spill_cache");
+        config_string += "value_spill_cache_path=" + spillCachePath +
+                         ";value_spill_cache_size=1048576";
+        SingleThreadedEPBucketTest::SetUp();
+    }
+
+    void TearDown() override {
+        SingleThreadedEPBucketTest::TearDown();
+        if (cb::io::isFile(spillCachePath)) {
+            cb::io::rmrf(spillCachePath);
+        }
+    }
+
+    std::string spillCachePath;
+};
+
+// A read of a value the item pager spilled waits for the BG fetcher, which
+// serves it from the spill cache rather than the front end reading it.
+TEST_F(ValueSpillCacheBucketTest, SpilledValueFetchedInBackground) {
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+    auto key = makeStoredDocKey("key");
+    store_item(vbid, key, "value");
+    flush_vbucket_to_disk(vbid);
+
+    struct Visitor : public HashTableVisitor {
+        explicit Visitor(VBucket& vb)
+            : vb(vb), readHandle(vb.lockCollections()) {
+        }
+        bool visit(const HashTable::HashBucketLock& lh,
+                   StoredValue& v) override {
+            StoredValue* vPtr = &v;
+            EXPECT_TRUE(vb.pageOut(readHandle, lh, vPtr));
+            return true;
+        }
+        VBucket& vb;
+        Collections::VB::Manifest::ReadHandle readHandle;
+    };
+    auto vb = store->getVBucket(vbid);
+    Visitor visitor(*vb);
+    vb->ht.visit(visitor);
+
+    auto& stats = engine->getEpStats();
+    ASSERT_EQ(1, stats.spillCacheWrites);
+
+    const auto options = static_cast<get_options_t>(
+            QUEUE_BG_FETCH | HONOR_STATES | TRACK_REFERENCE | DELETE_TEMP |
+            HIDE_LOCKED_CAS | TRACK_STATISTICS);
+    auto gv = store->get(key, vbid, cookie, options);
+    EXPECT_EQ(ENGINE_EWOULDBLOCK, gv.getStatus());
+    EXPECT_EQ(0, stats.spillCacheHits);
+
+    runBGFetcherTask();
+    EXPECT_EQ(1, stats.spillCacheHits);
+
+    gv = store->get(key, vbid, cookie, options);
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ("value", gv.item->getValue()->to_s());
+}
+
 INSTANTIATE_TEST_CASE_P(XattrSystemUserTest,
                         XattrSystemUserTest,
                         ::testing::Bool(), );
@@ -410,6 +410,38 @@ TEST_P(EPStoreEvictionTest, SetWithMeta_ReplaceNonResident) {
     }
 }
 
+// Bloom filter tests ////////////////////////////////////////////////////////
+
+// Check that a vBucket's bloom filter can be rebuilt from disk without
+// compacting it, and that the rebuilt filter contains the keys which
+// compaction would have added.
+TEST_P(EPStoreEvictionTest, RebuildBloomFilter) {
+    auto key = makeStoredDocKey("key");
+    auto deleted = makeStoredDocKey("deleted");
+    store_item(vbid, key, "value");
+    store_item(vbid, deleted, "value");
+    flush_vbucket_to_disk(vbid, 2);
+    delete_item(vbid, deleted);
+    flush_vbucket_to_disk(vbid);
+    evict_key(vbid, key);
+
+    auto vb = store->getVBucket(vbid);
+    vb->clearFilter();
+    EXPECT_TRUE(vb->needsFilterRebuild());
+
+    EXPECT_TRUE(getEPBucket().rebuildBloomFilter(vbid));
+    EXPECT_EQ("ENABLED", vb->getFilterStatusString());
+    EXPECT_FALSE(vb->needsFilterRebuild());
+    EXPECT_EQ(1, engine->getEpStats().bfilterRebuilds);
+
+    // Deleted keys are always in the filter; in full eviction so are
+    // non-resident keys.
+    EXPECT_TRUE(vb->maybeKeyExistsInFilter(deleted));
+    if (GetParam() == "full_eviction") {
+        EXPECT_TRUE(vb->maybeKeyExistsInFilter(key));
+    }
+}
+
 // Deleted-with-Value Tests ///////////////////////////////////////////////////
 
 TEST_P(EPStoreEvictionTest, DeletedValue) {
@@ -919,6 +951,33 @@ TEST_P(EPStoreEvictionTest, expiredItemCount) {
     EXPECT_EQ(1, store->getVBucket(vbid)->numExpiredItems);
 }
 
+// Check that a batch of expired items spanning vBuckets only expires those
+// of the vBuckets still active once the batch is applied.
+TEST_P(EPStoreEvictionTest, deleteExpiredItemsAcrossVBuckets) {
+    const Vbid replica(1);
+    store->setVBucketState(replica, vbucket_state_active);
+
+    auto expiryTime = time(NULL) + 290;
+    std::list<Item> expired;
+    for (auto vb : {vbid, replica}) {
+        for (int ii = 0; ii < 3; ++ii) {
+            auto key = makeStoredDocKey("key" + std::to_string(ii));
+            auto item = make_item(vb, key, "expire value", expiryTime);
+            ASSERT_EQ(ENGINE_SUCCESS, store->set(item, cookie));
+            expired.push_back(item);
+        }
+        flush_vbucket_to_disk(vb, 3);
+    }
+    store->setVBucketState(replica, vbucket_state_replica);
+
+    TimeTraveller docBrown(64000);
+    store->deleteExpiredItems(expired, ExpireBy::Compactor);
+
+    EXPECT_EQ(3, engine->getEpStats().expired_compactor);
+    EXPECT_EQ(3, store->getVBucket(vbid)->numExpiredItems);
+    EXPECT_EQ(0, store->getVBucket(replica)->numExpiredItems);
+}
+
 class EPStoreEvictionBloomOnOffTest
         : public EPBucketTest,
           public ::testing::WithParamInterface<
@@ -1148,6 +1207,73 @@ TEST_F(EPStoreFullEvictionNoBloomFIlterTest, MB_29816) {
     ASSERT_EQ(ENGINE_KEY_ENOENT, gv.getStatus());
 }
 
+// Run in FE with the evicted metadata index enabled, so metadata lookups of
+// evicted items are answered without a bgFetch.
+class EPStoreFullEvictionMetaIndexTest : public EPBucketTest {
+    void SetUp() override {
+        config_string += std::string{"item_eviction_policy=full_eviction;"
+                                     "ht_evicted_meta_index_size=100"};
+        EPBucketTest::SetUp();
+
+        // Have all the objects, activate vBucket zero so we can store data.
+        store->setVBucketState(vbid, vbucket_state_active);
+    }
+};
+
+TEST_F(EPStoreFullEvictionMetaIndexTest, GetMetaOfEvictedItem) {
+    auto key = makeStoredDocKey("key");
+    store_item(vbid, key, "value");
+    flush_vbucket_to_disk(vbid);
+
+    auto vb = store->getVBucket(vbid);
+    const auto cas = vb->ht.findForRead(key).storedValue->getCas();
+    evict_key(vbid, key);
+    ASSERT_EQ(1, vb->ht.getEvictedMetaIndex().size());
+
+    ItemMetaData metadata;
+    uint32_t deleted = 0;
+    uint8_t datatype = 0;
+    EXPECT_EQ(ENGINE_SUCCESS,
+              store->getMetaData(
+                      key, vbid, cookie, metadata, deleted, datatype));
+    EXPECT_EQ(cas, metadata.cas);
+    EXPECT_EQ(1, metadata.revSeqno);
+    EXPECT_EQ(0, deleted);
+    EXPECT_EQ(1, vb->ht.getEvictedMetaIndex().getNumHits());
+
+    // The item is back in the HashTable, without its value.
+    EXPECT_EQ(0, vb->ht.getEvictedMetaIndex().size());
+    auto* v = vb->ht.findForRead(key).storedValue;
+    ASSERT_TRUE(v);
+    EXPECT_FALSE(v->isResident());
+    EXPECT_FALSE(v->isTempItem());
+
+    // A get still fetches the value.
+    auto options = static_cast<get_options_t>(QUEUE_BG_FETCH | HONOR_STATES);
+    EXPECT_EQ(ENGINE_EWOULDBLOCK,
+              store->get(key, vbid, cookie, options).getStatus());
+    runBGFetcherTask();
+    auto gv = store->get(key, vbid, cookie, options);
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ("value", gv.item->getValue()->to_s());
+}
+
+// Deleting an evicted item drops its index entry.
+TEST_F(EPStoreFullEvictionMetaIndexTest, DeleteEvictedItem) {
+    auto key = makeStoredDocKey("key");
+    store_item(vbid, key, "value");
+    flush_vbucket_to_disk(vbid);
+    evict_key(vbid, key);
+
+    auto vb = store->getVBucket(vbid);
+    ASSERT_EQ(1, vb->ht.getEvictedMetaIndex().size());
+    uint64_t cas = 0;
+    mutation_descr_t mutInfo;
+    EXPECT_EQ(ENGINE_EWOULDBLOCK,
+              store->deleteItem(key, cas, vbid, cookie, {}, nullptr, mutInfo));
+    EXPECT_EQ(0, vb->ht.getEvictedMetaIndex().size());
+}
+
 struct PrintToStringCombinedName {
     std::string operator()(
             const ::testing::TestParamInfo<::testing::tuple<std::string, bool>>&
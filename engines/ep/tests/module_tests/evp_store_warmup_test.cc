@@ -23,12 +23,16 @@
 #include "ep_time.h"
 #include "evp_store_durability_test.h"
 #include "evp_store_single_threaded_test.h"
+#include "failover-table.h"
+#include "hash_table_snapshot.h"
 #include "kvstore.h"
 #include "programs/engine_testapp/mock_server.h"
 #include "test_helpers.h"
 #include "vbucket_state.h"
 #include "warmup.h"
 
+#include <platform/dirutils.h>
+
 class WarmupTest : public SingleThreadedKVBucketTest {};
 
 // Test that the FreqSaturatedCallback of a vbucket is initialized and after
@@ -212,6 +216,104 @@ TEST_F(WarmupTest, MB_27162) {
     EXPECT_EQ(3, itemMeta.revSeqno);
 }
 
+// Check that warmup loads every vBucket when each shard's vBuckets are split
+// across more than one loading task.
+TEST_F(WarmupTest, MultipleTasksPerShard) {
+    const Vbid sameShardVbid(vbid.get() + store->getVBuckets().getNumShards());
+    for (const auto vb : {vbid, sameShardVbid}) {
+        setVBucketStateAndRunPersistTask(vb, vbucket_state_active);
+        store_item(vb, makeStoredDocKey("key1"), "value");
+        flush_vbucket_to_disk(vb);
+    }
+
+    resetEngineAndWarmup("warmup_tasks_per_shard=2");
+
+    for (const auto vb : {vbid, sameShardVbid}) {
+        auto item = store->get(makeStoredDocKey("key1"), vb, nullptr, {});
+        ASSERT_EQ(ENGINE_SUCCESS, item.getStatus()) << vb;
+        EXPECT_EQ("value", item.item->getValue()->to_s()) << vb;
+    }
+}
+
+// Check that keys are loaded from the HashTable snapshot written at a clean
+// shutdown, and that a snapshot which doesn't match the disk is ignored.
+TEST_F(WarmupTest, HashTableSnapshot) {
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+    auto stored = store_item(vbid, makeStoredDocKey("key1"), "value");
+    flush_vbucket_to_disk(vbid);
+
+    // No snapshot written by the previous (non-snapshotting) shutdown.
+    config_string += ";warmup_hash_table_snapshot=true";
+    resetEngineAndWarmup();
+    EXPECT_EQ(0, store->getWarmup()->getSnapshotLoadedVBuckets());
+
+    const auto path = HashTableSnapshot::getPath(
+            engine->getConfiguration().getDbname(), vbid);
+    resetEngineAndWarmup();
+    EXPECT_EQ(1, store->getWarmup()->getSnapshotLoadedVBuckets());
+    // Consumed by warmup.
+    EXPECT_FALSE(cb::io::isFile(path));
+
+    auto item = store->get(makeStoredDocKey("key1"), vbid, nullptr, {});
+    ASSERT_EQ(ENGINE_SUCCESS, item.getStatus());
+    EXPECT_EQ(stored.getCas(), item.item->getCas());
+    EXPECT_EQ("value", item.item->getValue()->to_s());
+
+    // A snapshot tagged with a different seqno or failover UUID is rejected
+    // without loading anything.
+    auto vb = store->getVBucket(vbid);
+    ASSERT_TRUE(HashTableSnapshot::save(path, *vb));
+    size_t loaded = 0;
+    auto countItems = [&loaded](std::unique_ptr<Item>) {
+        ++loaded;
+        return true;
+    };
+    const auto uuid = vb->failovers->getLatestUUID();
+    EXPECT_FALSE(HashTableSnapshot::load(
+            path, vbid, vb->getHighSeqno() + 1, uuid, countItems));
+    EXPECT_FALSE(HashTableSnapshot::load(
+            path, vbid, vb->getHighSeqno(), uuid + 1, countItems));
+    EXPECT_EQ(0, loaded);
+    EXPECT_TRUE(HashTableSnapshot::load(
+            path, vbid, vb->getHighSeqno(), uuid, countItems));
+    EXPECT_EQ(1, loaded);
+}
+
+// Check that with warmup_early_vbucket_traffic a vBucket can serve traffic
+// once its keys are loaded, before warmup completes, and that loading its
+// values afterwards doesn't undo the mutations made meanwhile.
+TEST_F(WarmupTest, EarlyVBucketTraffic) {
+    setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
+    store_item(vbid, makeStoredDocKey("key1"), "value");
+    store_item(vbid, makeStoredDocKey("key2"), "value");
+    flush_vbucket_to_disk(vbid, 2);
+
+    resetEngineAndEnableWarmup("warmup_early_vbucket_traffic=true");
+
+    auto& readerQueue = *task_executor->getLpTaskQ()[READER_TASK_IDX];
+    while (store->isVBucketWarmingUp(vbid)) {
+        CheckedExecutor executor(task_executor, readerQueue);
+        executor.runCurrentTask();
+    }
+    ASSERT_TRUE(store->isWarmingUp());
+    EXPECT_TRUE(store->isVBucketWarmingUp(Vbid(vbid.get() + 1)));
+
+    store_item(vbid, makeStoredDocKey("key1"), "new value");
+    delete_item(vbid, makeStoredDocKey("key2"));
+
+    while (store->isWarmingUp()) {
+        CheckedExecutor executor(task_executor, readerQueue);
+        executor.runCurrentTask();
+    }
+
+    auto item = store->get(makeStoredDocKey("key1"), vbid, nullptr, {});
+    ASSERT_EQ(ENGINE_SUCCESS, item.getStatus());
+    EXPECT_EQ("new value", item.item->getValue()->to_s());
+    EXPECT_EQ(ENGINE_KEY_ENOENT,
+              store->get(makeStoredDocKey("key2"), vbid, nullptr, {})
+                      .getStatus());
+}
+
 TEST_F(WarmupTest, MB_25197) {
     setVBucketStateAndRunPersistTask(vbid, vbucket_state_active);
 
@@ -664,6 +766,56 @@ TEST_P(DurabilityWarmupTest, AbortedSyncWritePrepareIsNotLoaded) {
     EXPECT_FALSE(prepared.storedValue);
 }
 
+// Test that the flusher persists the seqno of the oldest prepare without a
+// persisted Commit, and that warmup only loads prepares from it.
+TEST_P(DurabilityWarmupTest, PreparesStartSeqno) {
+    auto* kvstore = engine->getKVBucket()->getRWUnderlying(vbid);
+    store_item(vbid, makeStoredDocKey("committed"), "A");
+    flush_vbucket_to_disk(vbid);
+    auto highSeqno = engine->getVBucket(vbid)->getHighSeqno();
+    EXPECT_EQ(highSeqno + 1,
+              kvstore->getVBucketState(vbid)->preparesStartSeqno);
+
+    auto key1 = makeStoredDocKey("key1");
+    auto item1 = makePendingItem(key1, "B");
+    ASSERT_EQ(ENGINE_EWOULDBLOCK, store->set(*item1, cookie));
+    auto item2 = makePendingItem(makeStoredDocKey("key2"), "C");
+    ASSERT_EQ(ENGINE_EWOULDBLOCK, store->set(*item2, cookie));
+    flush_vbucket_to_disk(vbid, 2);
+    EXPECT_EQ(item1->getBySeqno(),
+              kvstore->getVBucketState(vbid)->preparesStartSeqno);
+
+    { // scoping vb - is invalid once resetEngineAndWarmup() is called.
+        auto vb = engine->getVBucket(vbid);
+        vb->commit(key1, item1->getBySeqno(), {}, vb->lockCollections(key1));
+        flush_vbucket_to_disk(vbid, 1);
+    }
+    EXPECT_EQ(item2->getBySeqno(),
+              kvstore->getVBucketState(vbid)->preparesStartSeqno);
+
+    resetEngineAndWarmup();
+
+    // Only key2's prepare is outstanding
+    auto vb = engine->getVBucket(vbid);
+    EXPECT_EQ(1, vb->ht.getNumPreparedSyncWrites());
+    {
+        auto handle = vb->lockCollections(item2->getKey());
+        auto prepared = vb->fetchPreparedValue(handle);
+        ASSERT_TRUE(prepared.storedValue);
+        EXPECT_TRUE(prepared.storedValue->isPending());
+    }
+
+    // Warmup rebuilt the index; completing key2 leaves no prepares to load
+    vb->commit(item2->getKey(),
+               item2->getBySeqno(),
+               {},
+               vb->lockCollections(item2->getKey()));
+    flush_vbucket_to_disk(vbid, 1);
+    kvstore = engine->getKVBucket()->getRWUnderlying(vbid);
+    EXPECT_EQ(vb->getHighSeqno() + 1,
+              kvstore->getVBucketState(vbid)->preparesStartSeqno);
+}
+
 // Test that not having a replication topology stored on disk (i.e. pre v6.5
 // file) is correctly handled during warmup.
 TEST_P(DurabilityWarmupTest, ReplicationTopologyMissing) {
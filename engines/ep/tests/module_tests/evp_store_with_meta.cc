@@ -1386,6 +1386,104 @@ TEST_P(DelWithMetaTest, isExpirationOption) {
                   withValue ? ENGINE_SUCCESS : ENGINE_EWOULDBLOCK);
 }
 
+// A batch of GET_META answers the keys in memory straight away and reads the
+// metadata of the others from disk with a single getMulti.
+TEST_F(WithMetaTest, getMetaDataMulti) {
+    const auto resident = makeStoredDocKey("resident");
+    const auto deleted1 = makeStoredDocKey("deleted1");
+    const auto deleted2 = makeStoredDocKey("deleted2");
+    store_item(vbid, resident, "value");
+    store_item(vbid, deleted1, "value");
+    store_item(vbid, deleted2, "value");
+    flush_vbucket_to_disk(vbid, 3);
+    // Persisting the deletes removes them from the HashTable.
+    delete_item(vbid, deleted1);
+    delete_item(vbid, deleted2);
+    flush_vbucket_to_disk(vbid, 2);
+
+    const std::vector<DocKey> keys{resident, deleted1, deleted2};
+    auto results = store->getMetaDataMulti(keys, vbid, cookie);
+    ASSERT_EQ(3, results.size());
+    EXPECT_EQ(ENGINE_SUCCESS, results[0].status);
+    EXPECT_EQ(0, results[0].deleted);
+    EXPECT_EQ(ENGINE_EWOULDBLOCK, results[1].status);
+    EXPECT_EQ(ENGINE_EWOULDBLOCK, results[2].status);
+
+    auto& stats = engine->getEpStats();
+    stats.getMultiBatchSizeHisto.reset();
+    runBGFetcherTask();
+    EXPECT_EQ(1, stats.getMultiBatchSizeHisto.getValueCount());
+
+    results = store->getMetaDataMulti(keys, vbid, cookie);
+    for (const auto& result : results) {
+        EXPECT_EQ(ENGINE_SUCCESS, result.status);
+    }
+    EXPECT_EQ(0, results[0].deleted);
+    EXPECT_EQ(GET_META_ITEM_DELETED_FLAG, results[1].deleted);
+    EXPECT_EQ(GET_META_ITEM_DELETED_FLAG, results[2].deleted);
+}
+
+TEST_F(WithMetaTest, getMetaDataMultiNotMyVbucket) {
+    const auto key = makeStoredDocKey("key");
+    const std::vector<DocKey> keys{key, key};
+    for (const auto& result :
+         store->getMetaDataMulti(keys, Vbid(vbid.get() + 1), cookie)) {
+        EXPECT_EQ(ENGINE_NOT_MY_VBUCKET, result.status);
+    }
+}
+
+// A batch of SET_WITH_META resolves the conflicts of the keys in memory
+// straight away; the others are retried once their metadata is fetched.
+TEST_F(WithMetaTest, setWithMetaMulti) {
+    const auto resident = makeStoredDocKey("resident");
+    const auto deleted = makeStoredDocKey("deleted");
+    store_item(vbid, resident, "value");
+    store_item(vbid, deleted, "value");
+    flush_vbucket_to_disk(vbid, 2);
+    delete_item(vbid, deleted);
+    flush_vbucket_to_disk(vbid, 1);
+
+    // Both win conflict resolution, with a higher revSeqno.
+    auto makeItem = [this](const StoredDocKey& key, uint64_t revSeqno) {
+        auto item = makeCommittedItem(key, "new value");
+        item->setVBucketId(vbid);
+        item->setCas(0xdeadbeef);
+        item->setRevSeqno(revSeqno);
+        return item;
+    };
+    auto residentItem = makeItem(resident, 10);
+    auto deletedItem = makeItem(deleted, 10);
+    auto loser = makeItem(resident, 1);
+
+    std::vector<uint64_t> seqnos;
+    auto results = store->setWithMetaMulti(
+            {{residentItem.get(), 0}, {deletedItem.get(), 0}},
+            vbid,
+            seqnos,
+            cookie,
+            {vbucket_state_active},
+            CheckConflicts::Yes,
+            true /*allowExisting*/);
+    ASSERT_EQ(2, results.size());
+    ASSERT_EQ(2, seqnos.size());
+    EXPECT_EQ(ENGINE_SUCCESS, results[0]);
+    EXPECT_NE(0, seqnos[0]);
+    EXPECT_EQ(ENGINE_EWOULDBLOCK, results[1]);
+
+    runBGFetcherTask();
+    results = store->setWithMetaMulti({{deletedItem.get(), 0}, {loser.get(), 0}},
+                                      vbid,
+                                      seqnos,
+                                      cookie,
+                                      {vbucket_state_active},
+                                      CheckConflicts::Yes,
+                                      true /*allowExisting*/);
+    EXPECT_EQ(ENGINE_SUCCESS, results[0]);
+    EXPECT_GT(seqnos[0], 0);
+    // The earlier batch already stored a higher revSeqno.
+    EXPECT_EQ(ENGINE_KEY_EEXISTS, results[1]);
+}
+
 auto opcodeValues = ::testing::Values(cb::mcbp::ClientOpcode::SetWithMeta,
                                       cb::mcbp::ClientOpcode::SetqWithMeta,
                                       cb::mcbp::ClientOpcode::AddWithMeta,
@@ -64,6 +64,76 @@ TEST_P(EPVBucketTest, GetBGFetchItemsPerformance) {
     auto items = this->vbucket->getBGFetchItems();
 }
 
+// Check that a bgfetch for a key which is already being read from disk is
+// attached to the in-flight read instead of being queued again.
+TEST_P(EPVBucketTest, BGFetchCoalescedWithInFlight) {
+    auto mockEPBucket =
+            engine->public_makeMockBucket(engine->getConfiguration());
+    KVShard kvShard(0, engine->getConfiguration());
+    BgFetcher bgFetcher(*mockEPBucket.get(), kvShard);
+    auto& stats = engine->getEpStats();
+    const auto vbid = this->vbucket->getId();
+    const auto key = makeStoredDocKey("key");
+    const auto metaKey = makeStoredDocKey("meta");
+
+    this->public_queueBGFetchItem(
+            key,
+            std::make_unique<VBucketBGFetchItem>(nullptr, /*isMeta*/ false),
+            &bgFetcher);
+    this->public_queueBGFetchItem(
+            metaKey,
+            std::make_unique<VBucketBGFetchItem>(nullptr, /*isMeta*/ true),
+            &bgFetcher);
+    auto items = this->vbucket->getBGFetchItems();
+    ASSERT_EQ(2, items.size());
+    bgFetcher.registerInFlight(vbid, items);
+
+    // Both full and meta-only requests attach to a full fetch in flight.
+    const auto coalesced = stats.bg_fetch_coalesced.load();
+    this->public_queueBGFetchItem(
+            key,
+            std::make_unique<VBucketBGFetchItem>(nullptr, /*isMeta*/ false),
+            &bgFetcher);
+    this->public_queueBGFetchItem(
+            key,
+            std::make_unique<VBucketBGFetchItem>(nullptr, /*isMeta*/ true),
+            &bgFetcher);
+    EXPECT_FALSE(this->vbucket->hasPendingBGFetchItems());
+    EXPECT_EQ(coalesced + 2, stats.bg_fetch_coalesced);
+
+    // Only meta-only requests attach to a meta-only fetch in flight.
+    this->public_queueBGFetchItem(
+            metaKey,
+            std::make_unique<VBucketBGFetchItem>(nullptr, /*isMeta*/ true),
+            &bgFetcher);
+    EXPECT_FALSE(this->vbucket->hasPendingBGFetchItems());
+    this->public_queueBGFetchItem(
+            metaKey,
+            std::make_unique<VBucketBGFetchItem>(nullptr, /*isMeta*/ false),
+            &bgFetcher);
+    EXPECT_TRUE(this->vbucket->hasPendingBGFetchItems());
+    EXPECT_EQ(coalesced + 3, stats.bg_fetch_coalesced);
+
+    // Completing the in-flight batch hands it the attached requests, which
+    // share the batch's result.
+    bgFetcher.completeInFlight(vbid, items);
+    const auto& keyCtx = items.at(DiskDocKey{key});
+    ASSERT_EQ(3, keyCtx.bgfetched_list.size());
+    for (const auto& fetch : keyCtx.bgfetched_list) {
+        EXPECT_EQ(&keyCtx.value, fetch->value);
+    }
+    EXPECT_EQ(2, items.at(DiskDocKey{metaKey}).bgfetched_list.size());
+
+    // No longer in flight - new requests are queued as normal.
+    this->public_queueBGFetchItem(
+            key,
+            std::make_unique<VBucketBGFetchItem>(nullptr, /*isMeta*/ false),
+            &bgFetcher);
+    auto pending = this->vbucket->getBGFetchItems();
+    EXPECT_EQ(2, pending.size());
+    EXPECT_EQ(coalesced + 3, stats.bg_fetch_coalesced);
+}
+
 // Test statistics after softDelete.
 // Persistent VBucket only as Ephemeral cannot totally clear the VBucket; it
 // must keep at least the last deleted seqno for correct tombstone handling
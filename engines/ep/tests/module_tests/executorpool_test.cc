@@ -250,6 +250,181 @@ TEST_F(ExecutorPoolDynamicWorkerTest, reschedule_dead_task) {
     EXPECT_EQ(2, runCount);
 }
 
+/* Make sure that the ready tasks a thread takes into its local queue along
+ * with the task it runs don't wait for that task to complete when it blocks;
+ * the other thread of the same type steals and runs them.
+ */
+TEST_F(ExecutorPoolDynamicWorkerTest, local_tasks_are_stolen) {
+    const size_t numTasks = 8;
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool gateRunning = false;
+    bool gateOpen = false;
+    bool blocked = false;
+    size_t done = 0;
+
+    // Occupy the only writer thread while the tasks are scheduled, so they
+    // are all ready by the time a thread fetches the first of them.
+    pool->setNumWriters(1);
+    pool->schedule(std::make_shared<LambdaTask>(
+            taskable, TaskId::StatSnap, 0, true, [&]() -> bool {
+                std::unique_lock<std::mutex> lh(mutex);
+                gateRunning = true;
+                cond.notify_all();
+                cond.wait(lh, [&gateOpen] { return gateOpen; });
+                return false;
+            }));
+    {
+        std::unique_lock<std::mutex> lh(mutex);
+        cond.wait(lh, [&gateRunning] { return gateRunning; });
+    }
+
+    for (size_t ii = 0; ii < numTasks; ++ii) {
+        pool->schedule(std::make_shared<LambdaTask>(
+                taskable, TaskId::StatSnap, 0, true, [&]() -> bool {
+                    std::unique_lock<std::mutex> lh(mutex);
+                    if (!blocked) {
+                        // The first task to run (on the thread which took
+                        // the batch) blocks until all the others have run
+                        blocked = true;
+                        cond.wait_for(lh, std::chrono::seconds(10), [&] {
+                            return done == numTasks - 1;
+                        });
+                    }
+                    ++done;
+                    cond.notify_all();
+                    return false;
+                }));
+    }
+
+    pool->setNumWriters(2);
+    {
+        std::lock_guard<std::mutex> lh(mutex);
+        gateOpen = true;
+        cond.notify_all();
+    }
+
+    {
+        std::unique_lock<std::mutex> lh(mutex);
+        cond.wait_for(lh, std::chrono::seconds(20), [&] {
+            return done == numTasks;
+        });
+        EXPECT_EQ(numTasks, done);
+    }
+    pool->waitForEmptyTaskLocator();
+    EXPECT_LT(0, pool->getNumStolenTasks());
+}
+
+/// A task which keeps checking its CPU budget is told to yield once it has
+/// used up the budget of its type, but never outside of its run().
+TEST_F(ExecutorPoolDynamicWorkerTest, cpu_budget_exhausted) {
+    EXPECT_FALSE(GlobalTask::isCpuBudgetExhausted());
+
+    const auto oldBudget = GlobalTask::getCpuBudget(WRITER_TASK_IDX);
+    GlobalTask::setCpuBudget(WRITER_TASK_IDX, std::chrono::milliseconds(1));
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool done = false;
+    bool exhausted = false;
+    ExTask task = std::make_shared<LambdaTask>(
+            taskable, TaskId::StatSnap, 0, true, [&]() -> bool {
+                // Spin (for at most 10s of wall time) until told to yield.
+                const auto end = std::chrono::steady_clock::now() +
+                                 std::chrono::seconds(10);
+                while (!GlobalTask::isCpuBudgetExhausted() &&
+                       std::chrono::steady_clock::now() < end) {
+                }
+                std::lock_guard<std::mutex> lh(mutex);
+                exhausted = GlobalTask::isCpuBudgetExhausted();
+                done = true;
+                cond.notify_all();
+                return false;
+            });
+    pool->schedule(task);
+    {
+        std::unique_lock<std::mutex> lh(mutex);
+        cond.wait_for(lh, std::chrono::seconds(20), [&done] { return done; });
+        EXPECT_TRUE(exhausted);
+    }
+    pool->waitForEmptyTaskLocator();
+    EXPECT_LE(std::chrono::milliseconds(1), task->getTotalCpuTime());
+
+    GlobalTask::setCpuBudget(WRITER_TASK_IDX, oldBudget);
+}
+
+/// The queue wait and runtime of the tasks are recorded against their type,
+/// and the sample records the depth of the type's queues.
+TEST_F(ExecutorPoolDynamicWorkerTest, task_type_stats) {
+    const auto& writer = pool->getTaskTypeStats(WRITER_TASK_IDX);
+    const auto runs = writer.getRunTimeHisto().getValueCount();
+    const auto waits = writer.getQueueWaitHisto().getValueCount();
+
+    pool->schedule(std::make_shared<LambdaTask>(
+            taskable, TaskId::StatSnap, 0, true, [] { return false; }));
+    pool->waitForEmptyTaskLocator();
+    EXPECT_EQ(runs + 1, writer.getRunTimeHisto().getValueCount());
+    EXPECT_EQ(waits + 1, writer.getQueueWaitHisto().getValueCount());
+
+    // A task which isn't due to run for a while sits in the future queue
+    ExTask task = std::make_shared<LambdaTask>(
+            taskable, TaskId::StatSnap, 600, true, [] { return false; });
+    pool->schedule(task);
+    pool->sampleTaskTypes(std::chrono::steady_clock::now());
+    EXPECT_EQ(1, writer.getFutureQueueDepth());
+    EXPECT_EQ(0, writer.getReadyQueueDepth());
+    EXPECT_EQ(0,
+              pool->getTaskTypeStats(READER_TASK_IDX).getFutureQueueDepth());
+
+    pool->cancel(task->getId());
+    pool->waitForEmptyTaskLocator();
+}
+
+/// With adaptive IO threads, each sample moves a thread to whichever of the
+/// readers and writers has starved tasks, within the configured bounds.
+TEST_F(ExecutorPoolDynamicWorkerTest, adaptive_io_threads) {
+    pool->setAdaptiveIOThreads(1, 3, std::chrono::milliseconds(1));
+    auto starve = [this](task_type_t type) {
+        for (int ii = 0; ii < 100; ++ii) {
+            pool->logTaskTypeQTime(type, std::chrono::milliseconds(50));
+        }
+        pool->sampleTaskTypes(std::chrono::steady_clock::now());
+    };
+
+    starve(READER_TASK_IDX);
+    EXPECT_EQ(READ_HEAVY, pool->getIOPattern());
+    // A writer thread can't stop itself, so leaves the move to another
+    pool->balanceIOThreads(WRITER_TASK_IDX);
+    EXPECT_EQ(2, pool->getNumWriters());
+    pool->balanceIOThreads(NO_TASK_TYPE);
+    EXPECT_EQ(3, pool->getNumReaders());
+    EXPECT_EQ(1, pool->getNumWriters());
+    EXPECT_EQ(1, pool->getNumIOThreadMovesToReaders());
+
+    // Only one thread is moved per sample
+    pool->balanceIOThreads(NO_TASK_TYPE);
+    EXPECT_EQ(3, pool->getNumReaders());
+
+    // The readers are at the max (and the writers at the min)
+    starve(READER_TASK_IDX);
+    pool->balanceIOThreads(NO_TASK_TYPE);
+    EXPECT_EQ(3, pool->getNumReaders());
+    EXPECT_EQ(1, pool->getNumIOThreadMovesToReaders());
+
+    starve(WRITER_TASK_IDX);
+    EXPECT_EQ(WRITE_HEAVY, pool->getIOPattern());
+    pool->balanceIOThreads(NO_TASK_TYPE);
+    EXPECT_EQ(2, pool->getNumReaders());
+    EXPECT_EQ(2, pool->getNumWriters());
+    EXPECT_EQ(1, pool->getNumIOThreadMovesToWriters());
+
+    // Without starved tasks, the threads stay where they are
+    pool->sampleTaskTypes(std::chrono::steady_clock::now());
+    EXPECT_EQ(MIXED, pool->getIOPattern());
+    pool->balanceIOThreads(NO_TASK_TYPE);
+    EXPECT_EQ(2, pool->getNumReaders());
+}
+
 /* Testing to ensure that repeatedly scheduling a task does not result in
  * multiple entries in the taskQueue - this could cause a deadlock in
  * _unregisterTaskable when the taskLocator is empty but duplicate tasks remain
@@ -275,3 +450,44 @@ TEST_F(SingleThreadedExecutorPoolTest, ignore_duplicate_schedule) {
 
     pool->cancel(taskId, true);
 }
+
+/// An ExecutorThread which isn't started, for fetching tasks by hand.
+class NumaTestThread : public ExecutorThread {
+public:
+    using ExecutorThread::ExecutorThread;
+
+    ExTask& getCurrentTask() {
+        return currentTask;
+    }
+};
+
+/// A thread bound to one NUMA node leaves a ready task which prefers
+/// another node for that node's threads (once), if it has an equally urgent
+/// task to run instead.
+TEST_F(SingleThreadedExecutorPoolTest, numa_node_preference) {
+    ExTask remote = std::make_shared<LambdaTask>(
+            taskable, TaskId::ItemPager, 0, true, [&] { return false; });
+    remote->setNumaNode(1);
+    ExTask local = std::make_shared<LambdaTask>(
+            taskable, TaskId::ItemPager, 0, true, [&] { return false; });
+    local->setNumaNode(0);
+    pool->schedule(remote);
+    pool->schedule(local);
+
+    auto taskLocator =
+            dynamic_cast<SingleThreadedExecutorPool*>(ExecutorPool::get())
+                    ->getTaskLocator();
+    TaskQueue* queue = taskLocator.find(remote->getId())->second.second;
+
+    NumaTestThread thread(pool, NONIO_TASK_IDX, "numa_node_0", 0);
+    ASSERT_TRUE(queue->fetchNextTask(thread));
+    EXPECT_EQ(local, thread.getCurrentTask());
+
+    // Nothing else to run; the remote task isn't held back any longer.
+    ASSERT_TRUE(queue->fetchNextTask(thread));
+    EXPECT_EQ(remote, thread.getCurrentTask());
+
+    thread.resetCurrentTask();
+    pool->cancel(remote->getId(), true);
+    pool->cancel(local->getId(), true);
+}
@@ -0,0 +1,80 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "expiry_index.h"
+#include "tests/module_tests/test_helpers.h"
+
+#include <folly/portability/GTest.h>
+
+static ExpiryIndex::Entry makeEntry(time_t exptime, uint64_t cas = 1) {
+    return {exptime, cas, 1, 0, false};
+}
+
+// Only entries which have expired (strictly before now) are taken, and
+// they're taken once.
+TEST(ExpiryIndexTest, TakeExpired) {
+    ExpiryIndex index;
+    const time_t base = 100 * ExpiryIndex::slotSeconds;
+    index.add(makeStoredDocKey("a"), makeEntry(base + 1));
+    index.add(makeStoredDocKey("b"), makeEntry(base + 2));
+    index.add(makeStoredDocKey("c"),
+              makeEntry(base + 10 * ExpiryIndex::slotSeconds));
+    ASSERT_EQ(3, index.size());
+
+    EXPECT_TRUE(index.takeExpired(base + 1).empty());
+
+    auto expired = index.takeExpired(base + 2);
+    ASSERT_EQ(1, expired.size());
+    EXPECT_EQ(makeStoredDocKey("a"), expired[0].first);
+    EXPECT_EQ(base + 1, expired[0].second.exptime);
+    EXPECT_EQ(2, index.size());
+
+    const time_t end = base + 20 * ExpiryIndex::slotSeconds;
+    expired = index.takeExpired(end);
+    EXPECT_EQ(2, expired.size());
+    EXPECT_EQ(0, index.size());
+    EXPECT_TRUE(index.takeExpired(end).empty());
+}
+
+// Re-adding a key replaces its entry, moving it to its new expiry time.
+TEST(ExpiryIndexTest, ReAddMovesKey) {
+    ExpiryIndex index;
+    const auto key = makeStoredDocKey("key");
+    const time_t first = 100 * ExpiryIndex::slotSeconds;
+    const time_t later = first + 5 * ExpiryIndex::slotSeconds;
+    index.add(key, makeEntry(first, 1));
+    index.add(key, makeEntry(later, 2));
+    EXPECT_EQ(1, index.size());
+
+    EXPECT_TRUE(index.takeExpired(first + 1).empty());
+
+    auto expired = index.takeExpired(later + 1);
+    ASSERT_EQ(1, expired.size());
+    EXPECT_EQ(2, expired[0].second.cas);
+}
+
+TEST(ExpiryIndexTest, Remove) {
+    ExpiryIndex index;
+    const auto key = makeStoredDocKey("key");
+    index.add(key, makeEntry(10));
+    index.remove(makeStoredDocKey("other"));
+    EXPECT_EQ(1, index.size());
+
+    index.remove(key);
+    EXPECT_EQ(0, index.size());
+    EXPECT_TRUE(index.takeExpired(1000).empty());
+}
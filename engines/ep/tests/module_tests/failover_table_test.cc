@@ -19,6 +19,7 @@
 #include <folly/portability/GTest.h>
 
 #include <engines/ep/src/bucket_logger.h>
+#include <nlohmann/json.hpp>
 #include <limits>
 
 typedef std::list<failover_entry_t> table_t;
@@ -580,3 +581,40 @@ TEST(FailoverTableTest, test_sanitize_failover_table_all) {
     EXPECT_EQ(numErroneousEntries, table.getNumErroneousEntriesErased());
     EXPECT_NE(failover_json, table.toJSON());
 }
+
+// Test that the cached failover log and JSON follow changes to the table, and
+// that the JSON is in the format the table is loaded from
+TEST(FailoverTableTest, test_cached_encodings) {
+    FailoverTable table(5 /* max_entries */);
+    const auto initial = table.getLatestEntry();
+    auto expected = generate_entries(table, 3, 1);
+    expected.push_back(initial);
+    table.pruneEntries(150);
+    expected.remove_if(
+            [](const failover_entry_t& e) { return e.by_seqno > 150; });
+    table.createEntry(200);
+    expected.push_front(table.getLatestEntry());
+
+    auto checkLog = [&expected](FailoverTable& t) {
+        const auto log = t.getFailoverLog();
+        ASSERT_EQ(expected.size(), log.size());
+        auto it = expected.begin();
+        for (const auto& entry : log) {
+            EXPECT_EQ(it->vb_uuid, entry.uuid);
+            EXPECT_EQ(it->by_seqno, entry.seqno);
+            ++it;
+        }
+    };
+    checkLog(table);
+
+    const auto json = table.toJSON();
+    nlohmann::json parsed;
+    for (const auto& e : expected) {
+        parsed.push_back({{"id", e.vb_uuid}, {"seq", e.by_seqno}});
+    }
+    EXPECT_EQ(parsed.dump(), json);
+
+    FailoverTable loaded(json, 5 /* max_entries */, 0);
+    EXPECT_EQ(json, loaded.toJSON());
+    checkLog(loaded);
+}
@@ -224,3 +224,76 @@ TEST_F(FutureQueueTest, taskNotInQueue) {
     EXPECT_EQ(-1,
               static_cast<TestTask*>(queue.top().get())->order);
 }
+
+/*
+ * Move tasks both forwards and backwards in time, checking the heap stays
+ * valid and tasks are popped in wakeTime order.
+ */
+TEST_F(FutureQueueTest, updateWaketimeKeepsOrder) {
+    const int n = 100;
+    std::vector<ExTask> tasks;
+    for (int i = 0; i < n; i++) {
+        ExTask task = std::make_shared<TestTask>(
+                taskable, TaskId::PendingOpsNotification, i);
+        task->updateWaketime(std::chrono::steady_clock::time_point(
+                std::chrono::nanoseconds((i * 37) % n)));
+        queue.push(task);
+        tasks.push_back(task);
+    }
+
+    for (int i = 0; i < n; i++) {
+        const auto newtime = std::chrono::nanoseconds((i * 53) % (2 * n));
+        EXPECT_TRUE(queue.updateWaketime(
+                tasks[(i * 7) % n],
+                std::chrono::steady_clock::time_point(newtime)));
+        queue.assertInvariants();
+    }
+
+    EXPECT_EQ(size_t(n), queue.size());
+    ExTask lastTask;
+    while (!queue.empty()) {
+        if (lastTask) {
+            EXPECT_LE(lastTask->getWaketime(), queue.top()->getWaketime());
+        }
+        lastTask = queue.top();
+        queue.pop();
+    }
+}
+
+/*
+ * The same task is pushed twice; re-ordering it must still work, both while
+ * it's queued twice and once one of the copies has been popped.
+ */
+TEST_F(FutureQueueTest, updateWaketimeDuplicateTask) {
+    for (int i = 1; i <= 5; i++) {
+        ExTask task = std::make_shared<TestTask>(
+                taskable, TaskId::PendingOpsNotification, i);
+        task->updateWaketime(std::chrono::steady_clock::time_point(
+                std::chrono::nanoseconds(i * 10)));
+        queue.push(task);
+    }
+    ExTask task = std::make_shared<TestTask>(
+            taskable, TaskId::PendingOpsNotification, -1);
+    task->updateWaketime(std::chrono::steady_clock::time_point(
+            std::chrono::nanoseconds(1)));
+    queue.push(task);
+    queue.push(task);
+
+    EXPECT_TRUE(queue.updateWaketime(
+            task,
+            std::chrono::steady_clock::time_point(
+                    std::chrono::nanoseconds(25))));
+    queue.assertInvariants();
+    EXPECT_EQ(1, static_cast<TestTask*>(queue.top().get())->order);
+
+    // Pop tasks 1 and 2 and the first copy of the duplicate
+    for (int i = 0; i < 3; i++) {
+        queue.pop();
+    }
+    EXPECT_EQ(4u, queue.size());
+
+    EXPECT_TRUE(queue.updateWaketime(
+            task, std::chrono::steady_clock::time_point::min()));
+    queue.assertInvariants();
+    EXPECT_EQ(-1, static_cast<TestTask*>(queue.top().get())->order);
+}
@@ -16,7 +16,6 @@
  */
 #include "hash_table_test.h"
 #include "item.h"
-#include "item_freq_decayer_visitor.h"
 #include "kv_bucket.h"
 #include "programs/engine_testapp/mock_server.h"
 #include "stats.h"
@@ -31,7 +30,9 @@
 #include <signal.h>
 #include <algorithm>
 #include <limits>
+#include <set>
 #include <string>
+#include <unordered_map>
 
 EPStats global_stats;
 
@@ -160,6 +161,33 @@ TEST_F(HashTableTest, SizeTwo) {
     EXPECT_EQ(0, count(h));
 }
 
+// The item memory of each collection is accounted separately, and adds up
+// to the HashTable's.
+TEST_F(HashTableTest, CollectionItemMemory) {
+    HashTable h(global_stats, makeFactory(), defaultHtSize, /*locks*/ 1);
+    const CollectionID fruit = 8;
+    const CollectionID veg = 9;
+    store(h, makeStoredDocKey("apple", fruit));
+    store(h, makeStoredDocKey("banana", fruit));
+    store(h, makeStoredDocKey("carrot", veg));
+
+    const auto sizes = h.getCollectionItemMemory();
+    ASSERT_EQ(2, sizes.size());
+    EXPECT_EQ(h.getCollectionItemMemory(fruit), sizes.at(fruit));
+    EXPECT_EQ(h.getItemMemory(), sizes.at(fruit) + sizes.at(veg));
+    EXPECT_EQ(0, h.getCollectionItemMemory(CollectionID::Default));
+
+    const auto vegSize = sizes.at(veg);
+    EXPECT_TRUE(del(h, makeStoredDocKey("apple", fruit)));
+    EXPECT_TRUE(del(h, makeStoredDocKey("banana", fruit)));
+    EXPECT_EQ(0, h.getCollectionItemMemory(fruit));
+    EXPECT_EQ(vegSize, h.getCollectionItemMemory(veg));
+    EXPECT_EQ(1, h.getCollectionItemMemory().size());
+
+    h.clear();
+    EXPECT_TRUE(h.getCollectionItemMemory().empty());
+}
+
 TEST_F(HashTableTest, ReverseDeletions) {
     size_t initialSize = global_stats.getCurrentSize();
     HashTable h(global_stats, makeFactory(), 5, 1);
@@ -246,6 +274,320 @@ TEST_F(HashTableTest, Resize) {
     verifyFound(h, keys);
 }
 
+// Visiting each bucket number once with visitRandomBucket() visits every
+// item exactly once.
+TEST_F(HashTableTest, VisitRandomBucket) {
+    HashTable h(global_stats, makeFactory(), 47, 3);
+
+    auto keys = generateKeys(500);
+    storeMany(h, keys);
+
+    Counter c(true);
+    size_t visited = 0;
+    for (size_t ii = 0; ii < h.getSize(); ++ii) {
+        visited += h.visitRandomBucket(c, ii);
+    }
+    EXPECT_EQ(keys.size(), visited);
+    EXPECT_EQ(keys.size(), c.count);
+
+    // Numbers beyond the size of the table wrap around.
+    Counter wrapped(true);
+    EXPECT_EQ(h.visitRandomBucket(wrapped, 1),
+              h.visitRandomBucket(wrapped, h.getSize() + 1));
+}
+
+// getRandomKey() finds the only item of a sparse table, and from a table
+// with many items picks each of them.
+TEST_F(HashTableTest, GetRandomKey) {
+    HashTable h(global_stats, makeFactory(), 1024, 4);
+    EXPECT_FALSE(h.getRandomKey(0));
+    EXPECT_FALSE(h.getRandomDocKey(0));
+
+    auto keys = generateKeys(1);
+    storeMany(h, keys);
+    for (long rnd = 0; rnd < 10; ++rnd) {
+        auto item = h.getRandomKey(rnd);
+        ASSERT_TRUE(item);
+        EXPECT_EQ(keys[0], item->getKey());
+        EXPECT_EQ(keys[0], *h.getRandomDocKey(rnd));
+    }
+
+    HashTable dense(global_stats, makeFactory(), 7, 1);
+    keys = generateKeys(20);
+    storeMany(dense, keys);
+    std::set<StoredDocKey> picked;
+    for (long rnd = 0; rnd < 2000; ++rnd) {
+        auto key = dense.getRandomDocKey(rnd);
+        ASSERT_TRUE(key);
+        picked.insert(*key);
+    }
+    // Every item of the (long) chains is picked, not just the first
+    EXPECT_EQ(keys.size(), picked.size());
+}
+
+// Check that unlocked_findColdestEvictable picks the coldest clean item in
+// the chain, skipping the excluded item, dirty items and anything at or
+// above the frequency limit.
+TEST_F(HashTableTest, FindColdestEvictable) {
+    // A single chain, so every key shares the one bucket.
+    HashTable h(global_stats, makeFactory(), 1, 1);
+    auto keys = generateKeys(4);
+    storeMany(h, keys);
+
+    const uint8_t freqs[] = {3, 1, 2, 8};
+    for (size_t ii = 0; ii < keys.size(); ++ii) {
+        auto res = h.findForWrite(keys[ii]);
+        ASSERT_TRUE(res.storedValue);
+        res.storedValue->setFreqCounterValue(freqs[ii]);
+        if (ii != 2) {
+            res.storedValue->markClean();
+        }
+    }
+
+    auto lock = h.getLockedBucket(keys[0]);
+    const auto* key1 = h.unlocked_find(keys[1],
+                                       lock.getBucketNum(),
+                                       WantsDeleted::No,
+                                       TrackReference::No);
+    ASSERT_TRUE(key1);
+
+    auto* v = h.unlocked_findColdestEvictable(
+            lock, EvictionPolicy::Value, 4, nullptr);
+    ASSERT_TRUE(v);
+    EXPECT_EQ(keys[1], StoredDocKey(v->getKey()));
+
+    // Excluding key 1 leaves key 0 (key 2 is dirty, key 3 is too warm).
+    v = h.unlocked_findColdestEvictable(lock, EvictionPolicy::Value, 4, key1);
+    ASSERT_TRUE(v);
+    EXPECT_EQ(keys[0], StoredDocKey(v->getKey()));
+
+    EXPECT_FALSE(h.unlocked_findColdestEvictable(
+            lock, EvictionPolicy::Value, 1, nullptr));
+}
+
+// Check that lookups with Layout::Bucketed find every key, including those
+// beyond the tagged prefix of the (deliberately long) chains.
+TEST_F(HashTableTest, BucketedLayoutFind) {
+    HashTable h(global_stats, makeFactory(), 5, 1, HashTable::Layout::Bucketed);
+    ASSERT_EQ(HashTable::Layout::Bucketed, h.getLayout());
+    testFind(h);
+}
+
+// Check that the BucketTags are kept in step with the chains as items are
+// removed, the table is resized and items are found via each perspective.
+TEST_F(HashTableTest, BucketedLayoutMutations) {
+    HashTable h(global_stats, makeFactory(), 5, 3, HashTable::Layout::Bucketed);
+    auto keys = generateKeys(1000);
+    storeMany(h, keys);
+
+    h.resize(769);
+    verifyFound(h, keys);
+
+    // Remove every other key; the remainder must still be found and the
+    // removed ones not.
+    for (size_t i = 0; i < keys.size(); i += 2) {
+        ASSERT_TRUE(del(h, keys[i]));
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+        const auto found = h.findForWrite(keys[i]).storedValue != nullptr;
+        EXPECT_EQ(i % 2 == 1, found) << keys[i].to_string();
+    }
+
+    h.resize(7);
+    for (size_t i = 1; i < keys.size(); i += 2) {
+        EXPECT_TRUE(h.findForRead(keys[i]).storedValue)
+                << keys[i].to_string();
+    }
+
+    h.clear();
+    EXPECT_EQ(0, count(h));
+    EXPECT_FALSE(h.findForRead(keys[1]).storedValue);
+}
+
+TEST_F(HashTableTest, LayoutFromString) {
+    EXPECT_EQ(HashTable::Layout::Chained,
+              HashTable::layoutFromString("chained"));
+    EXPECT_EQ(HashTable::Layout::Bucketed,
+              HashTable::layoutFromString("bucketed"));
+    EXPECT_THROW(HashTable::layoutFromString("open"), std::invalid_argument);
+}
+
+TEST_F(HashTableTest, HashAlgorithmFromString) {
+    EXPECT_EQ(HashTable::HashAlgorithm::Djb,
+              HashTable::hashAlgorithmFromString("djb"));
+    EXPECT_EQ(HashTable::HashAlgorithm::Crc32c,
+              HashTable::hashAlgorithmFromString("crc32c"));
+    EXPECT_THROW(HashTable::hashAlgorithmFromString("md5"),
+                 std::invalid_argument);
+}
+
+// A key with no encoded collection must hash the same as the equivalent
+// default collection key, for every algorithm.
+TEST_F(HashTableTest, HashKeyNoEncodedCollection) {
+    uint8_t keyRaw[4] = {'k', 'e', 'y', '!'};
+    DocKey docKey(keyRaw, 4, DocKeyEncodesCollectionId::No);
+    StoredDocKey storedKey(docKey);
+    for (auto algorithm :
+         {HashTable::HashAlgorithm::Djb, HashTable::HashAlgorithm::Crc32c}) {
+        EXPECT_EQ(HashTable::hashKey(docKey, algorithm),
+                  HashTable::hashKey(DocKey(storedKey), algorithm));
+    }
+}
+
+TEST_F(HashTableTest, FindCrc32c) {
+    HashTable h(global_stats,
+                makeFactory(),
+                5,
+                1,
+                HashTable::Layout::Chained,
+                HashTable::HashAlgorithm::Crc32c);
+    testFind(h);
+
+    h.resize(769);
+    verifyFound(h, generateKeys(1000));
+}
+
+// Every StoredValue in the table must carry the tag of its key's hash (for the
+// table's HashAlgorithm), including after being copied.
+TEST_F(HashTableTest, KeyHashTag) {
+    for (auto algorithm :
+         {HashTable::HashAlgorithm::Djb, HashTable::HashAlgorithm::Crc32c}) {
+        HashTable h(global_stats,
+                    makeFactory(),
+                    5,
+                    1,
+                    HashTable::Layout::Chained,
+                    algorithm);
+        auto keys = generateKeys(100);
+        storeMany(h, keys);
+
+        auto expectedTag = [algorithm](const DocKey& key) {
+            return uint16_t(HashTable::hashKey(key, algorithm) >> 16);
+        };
+        for (const auto& key : keys) {
+            auto res = h.findForWrite(key);
+            ASSERT_TRUE(res.storedValue);
+            EXPECT_EQ(expectedTag(key), res.storedValue->getKeyHashTag());
+
+            auto copy = h.unlocked_replaceByCopy(res.lock, *res.storedValue);
+            EXPECT_EQ(expectedTag(key), copy.first->getKeyHashTag());
+        }
+        verifyFound(h, keys);
+    }
+}
+
+// Check that an incremental resize keeps every item accessible (and visited
+// exactly once) while the migration is in progress.
+TEST_F(HashTableTest, IncrementalResize) {
+    for (auto layout :
+         {HashTable::Layout::Chained, HashTable::Layout::Bucketed}) {
+        // Initial size must be a multiple of the lock count.
+        HashTable h(global_stats, makeFactory(), 6, 3, layout);
+        auto keys = generateKeys(1000);
+        storeMany(h, keys);
+        const auto numResizes = h.getNumResizes();
+
+        ASSERT_TRUE(h.resizeIncrementally(1));
+        ASSERT_TRUE(h.isResizing());
+        EXPECT_EQ(6, h.getSize());
+        verifyFound(h, keys);
+        EXPECT_EQ(1000, count(h));
+
+        // Modify items on both sides of the migration.
+        ASSERT_TRUE(del(h, keys.front()));
+        ASSERT_TRUE(del(h, keys.back()));
+        store(h, keys.front());
+
+        while (h.resizeIncrementally(1)) {
+            EXPECT_TRUE(h.findForRead(keys.front()).storedValue);
+            EXPECT_FALSE(h.findForRead(keys.back()).storedValue);
+        }
+        EXPECT_FALSE(h.isResizing());
+        EXPECT_EQ(numResizes + 1, h.getNumResizes());
+        EXPECT_EQ(0, h.getSize() % 3);
+        EXPECT_GT(h.getSize(), 6);
+
+        keys.pop_back();
+        verifyFound(h, keys);
+        EXPECT_EQ(999, count(h));
+
+        // Already at the preferred size - nothing further to do.
+        EXPECT_FALSE(h.resizeIncrementally(1));
+    }
+}
+
+// Check that a paused visit resumed after an incremental resize migrated some
+// of the buckets it had visited doesn't visit their items again.
+TEST_F(HashTableTest, PauseResumeVisitDuringIncrementalResize) {
+    HashTable h(global_stats, makeFactory(), 12, 3);
+    auto keys = generateKeys(1000);
+    storeMany(h, keys);
+    ASSERT_TRUE(h.resizeIncrementally(1));
+
+    // Pauses after the last item of each chain, so none are skipped by the
+    // pause itself.
+    struct Visitor : public HashTableVisitor {
+        bool visit(const HashTable::HashBucketLock& lh,
+                   StoredValue& v) override {
+            ++visited[StoredDocKey(v.getKey())];
+            return v.getNext().get().get() != nullptr;
+        }
+        std::unordered_map<StoredDocKey, int> visited;
+    } visitor;
+
+    HashTable::Position pos;
+    int migrations = 0;
+    while (pos != h.endPosition()) {
+        pos = h.pauseResumeVisit(visitor, pos);
+        // Migrate a bucket of each lock (but don't complete the resize,
+        // which restarts the visit) between the first pauses.
+        if (migrations < 2) {
+            ASSERT_TRUE(h.resizeIncrementally(1));
+            ++migrations;
+        }
+    }
+    ASSERT_TRUE(h.isResizing());
+
+    EXPECT_EQ(keys.size(), visitor.visited.size());
+    for (const auto& key : keys) {
+        EXPECT_EQ(1, visitor.visited[key]) << key;
+    }
+}
+
+// An incremental resize from a size which isn't a multiple of the lock count
+// falls back to a one-off blocking resize.
+TEST_F(HashTableTest, IncrementalResizeFallback) {
+    HashTable h(global_stats, makeFactory(), 5, 3);
+    auto keys = generateKeys(1000);
+    storeMany(h, keys);
+
+    EXPECT_FALSE(h.resizeIncrementally(1));
+    EXPECT_FALSE(h.isResizing());
+    EXPECT_EQ(0, h.getSize() % 3);
+    verifyFound(h, keys);
+}
+
+// A blocking resize (or clear) part way through an incremental resize must
+// finish (or discard) the incremental one.
+TEST_F(HashTableTest, IncrementalResizeInterrupted) {
+    HashTable h(global_stats, makeFactory(), 6, 3);
+    auto keys = generateKeys(1000);
+    storeMany(h, keys);
+
+    ASSERT_TRUE(h.resizeIncrementally(1));
+    h.resize(6143);
+    EXPECT_FALSE(h.isResizing());
+    EXPECT_EQ(6143, h.getSize());
+    verifyFound(h, keys);
+
+    h.resize(6);
+    ASSERT_TRUE(h.resizeIncrementally(1));
+    h.clear();
+    EXPECT_FALSE(h.isResizing());
+    EXPECT_EQ(0, count(h));
+    EXPECT_EQ(6, h.getSize());
+}
+
 class AccessGenerator : public Generator<bool> {
 public:
 
@@ -366,6 +708,7 @@ protected:
 
     void TearDown() override {
         EXPECT_EQ(0, ht.getItemMemory());
+        EXPECT_TRUE(ht.getCollectionItemMemory().empty());
         EXPECT_EQ(0, ht.getUncompressedItemMemory());
         EXPECT_EQ(0, ht.getCacheSize());
         EXPECT_EQ(initialSize, stats.getCurrentSize());
@@ -1169,44 +1512,142 @@ TEST_F(HashTableTest, PauseResumeHashBucket) {
     ht.pauseResumeVisit(mockVisitor, start);
 }
 
-// Test the itemFreqDecayerVisitor by adding 256 documents to the hash table.
-// Then set the frequency count of each document in the range 0 to 255.  We
-// then visit each document and decay it by 50%.  The test checks that the
-// frequency count of each document has been decayed by 50%.
-TEST_F(HashTableTest, ItemFreqDecayerVisitorTest) {
+// Test the lazy decay of the frequency counters by adding 256 documents to
+// the hash table, with frequency counts in the range 0 to 255. We then
+// advance the decay epoch (by 50%) and check that the frequency count of
+// each document has been decayed when next found.
+TEST_F(HashTableTest, FreqDecayEpoch) {
     HashTable ht(global_stats, makeFactory(true), 128, 1);
     auto keys = generateKeys(256);
     // Add 256 documents to the hash table
     storeMany(ht, keys);
-    StoredValue* v;
 
     // Set the frequency count of each document in the range 0 to 255.
     for (int ii = 0; ii < 256; ii++) {
         auto key = makeStoredDocKey(std::to_string(ii));
-        v = ht.findForWrite(key).storedValue;
-        v->setFreqCounterValue(ii);
-       }
-
-       ItemFreqDecayerVisitor itemFreqDecayerVisitor(
-               Configuration().getItemFreqDecayerPercent());
-       // Decay the frequency count of each document by the configuration
-       // default of 50%
-       for (int ii = 0; ii < 256; ii++) {
-           auto key = makeStoredDocKey(std::to_string(ii));
-           auto item = ht.findForWrite(key);
-           itemFreqDecayerVisitor.visit(item.lock, *item.storedValue);
-       }
-
-       // Confirm we visited all the documents
-       EXPECT_EQ(256, itemFreqDecayerVisitor.getVisitedCount());
-
-       // Check the frequency of the docs have been decayed by 50%.
-       for (int ii = 0; ii < 256; ii++) {
-           auto key = makeStoredDocKey(std::to_string(ii));
-           v = ht.findForWrite(key).storedValue;
-           uint16_t expectVal = ii * 0.5;
-           EXPECT_EQ(expectVal, v->getFreqCounterValue());
-       }
+        ht.findForWrite(key).storedValue->setFreqCounterValue(ii);
+    }
+
+    ht.advanceFreqDecayEpoch(Configuration().getItemFreqDecayerPercent());
+
+    // Check the frequency of the docs have been decayed by 50%.
+    for (int ii = 0; ii < 256; ii++) {
+        auto key = makeStoredDocKey(std::to_string(ii));
+        auto* v = ht.findForWrite(key).storedValue;
+        uint16_t expectVal = ii * 0.5;
+        EXPECT_EQ(expectVal, v->getFreqCounterValue());
+    }
+
+    // An epoch which hasn't been applied yet survives a resize, and several
+    // pending epochs are applied together.
+    ht.advanceFreqDecayEpoch(50);
+    ht.resize(ht.getSize() * 2);
+    ht.advanceFreqDecayEpoch(50);
+    ht.advanceFreqDecayEpoch(50);
+    for (int ii = 0; ii < 256; ii++) {
+        auto key = makeStoredDocKey(std::to_string(ii));
+        auto* v = ht.findForWrite(key).storedValue;
+        uint16_t expectVal = uint8_t(uint8_t(ii * 0.5) * 0.5) * 0.25;
+        EXPECT_EQ(expectVal, v->getFreqCounterValue());
+    }
+}
+
+// A bucket left untouched for 65536 epochs (a whole wrap of a 16-bit epoch)
+// must still have all of them applied when next found.
+TEST_F(HashTableTest, FreqDecayEpochWrap) {
+    HashTable ht(global_stats, makeFactory(true), 128, 1);
+    auto key = makeStoredDocKey("key");
+    store(ht, key);
+    ht.findForWrite(key).storedValue->setFreqCounterValue(200);
+
+    for (int ii = 0; ii < 65536; ii++) {
+        ht.advanceFreqDecayEpoch(50);
+    }
+    EXPECT_EQ(65536, ht.getFreqDecayEpoch());
+    EXPECT_EQ(0, ht.findForWrite(key).storedValue->getFreqCounterValue());
+
+    // And the bucket is now current; only later epochs apply to it.
+    ht.findForWrite(key).storedValue->setFreqCounterValue(200);
+    ht.advanceFreqDecayEpoch(50);
+    EXPECT_EQ(100, ht.findForWrite(key).storedValue->getFreqCounterValue());
+}
+
+// With shared reader locks findForReadShared holds the stripe shared, unless
+// it has to modify the bucket (to decay it, or increment a counter).
+TEST_F(HashTableTest, FindForReadShared) {
+    HashTable ht(global_stats,
+                 makeFactory(true),
+                 128,
+                 1,
+                 HashTable::Layout::Chained,
+                 HashTable::HashAlgorithm::Djb,
+                 0,
+                 /*sharedReaderLocks*/ true);
+    ASSERT_TRUE(ht.hasSharedReaderLocks());
+    auto keys = generateKeys(10);
+    storeMany(ht, keys);
+
+    {
+        // Readers of the same stripe (there's only one) don't exclude each
+        // other.
+        auto first = ht.findForReadShared(keys[0], TrackReference::No);
+        auto second = ht.findForReadShared(keys[1], TrackReference::No);
+        ASSERT_NE(nullptr, first.storedValue);
+        ASSERT_NE(nullptr, second.storedValue);
+        EXPECT_TRUE(first.sharedLock.owns_lock());
+        EXPECT_TRUE(second.sharedLock.owns_lock());
+        EXPECT_FALSE(first.lock.getHTLock().owns_lock());
+
+        auto missing = ht.findForReadShared(makeStoredDocKey("missing"),
+                                            TrackReference::No);
+        EXPECT_EQ(nullptr, missing.storedValue);
+        EXPECT_TRUE(missing.sharedLock.owns_lock());
+    }
+
+    // A pending decay is applied exclusively.
+    ht.findForWrite(keys[0]).storedValue->setFreqCounterValue(100);
+    ht.advanceFreqDecayEpoch(50);
+    {
+        auto result = ht.findForReadShared(keys[0], TrackReference::No);
+        EXPECT_FALSE(result.sharedLock.owns_lock());
+        EXPECT_TRUE(result.lock.getHTLock().owns_lock());
+        EXPECT_EQ(50, result.storedValue->getFreqCounterValue());
+    }
+
+    // A saturated counter can't change, so tracking it stays shared (and
+    // reports the saturation).
+    bool saturated = false;
+    ht.setFreqSaturatedCallback([&saturated]() { saturated = true; });
+    ht.findForWrite(keys[0]).storedValue->setFreqCounterValue(
+            std::numeric_limits<uint8_t>::max());
+    {
+        auto result = ht.findForReadShared(keys[0], TrackReference::Yes);
+        EXPECT_TRUE(result.sharedLock.owns_lock());
+        EXPECT_TRUE(saturated);
+    }
+
+    // A counter at zero is always incremented, which needs the exclusive
+    // lock.
+    ht.findForWrite(keys[0]).storedValue->setFreqCounterValue(0);
+    {
+        auto result = ht.findForReadShared(keys[0], TrackReference::Yes);
+        EXPECT_FALSE(result.sharedLock.owns_lock());
+        EXPECT_TRUE(result.lock.getHTLock().owns_lock());
+        EXPECT_EQ(1, result.storedValue->getFreqCounterValue());
+    }
+}
+
+// Without shared reader locks findForReadShared is findForRead.
+TEST_F(HashTableTest, FindForReadSharedExclusiveLocks) {
+    HashTable ht(global_stats, makeFactory(true), 128, 1);
+    ASSERT_FALSE(ht.hasSharedReaderLocks());
+    auto keys = generateKeys(1);
+    storeMany(ht, keys);
+
+    auto result = ht.findForReadShared(keys[0], TrackReference::No);
+    ASSERT_NE(nullptr, result.storedValue);
+    EXPECT_FALSE(result.sharedLock.owns_lock());
+    EXPECT_TRUE(result.lock.getHTLock().owns_lock());
 }
 
 // Test the reallocateStoredValue method.
@@ -1245,3 +1686,79 @@ TEST_F(HashTableTest, reallocateStoredValue) {
     // Check the empty hash-table returns false as well
     EXPECT_FALSE(ht3.reallocateStoredValue(std::forward<StoredValue>(*v2)));
 }
+
+// Fully evicted items keep their metadata in the EvictedMetaIndex until the
+// key is added back to the HashTable.
+TEST_F(HashTableTest, EvictedMetaIndex) {
+    HashTable ht(global_stats,
+                 makeFactory(),
+                 5,
+                 1,
+                 HashTable::Layout::Chained,
+                 HashTable::HashAlgorithm::Djb,
+                 /*evictedMetaIndexSize*/ 100);
+    const auto key = makeStoredDocKey("key");
+    Item item(key, 0xcafe, 1234, "value", strlen("value"));
+    item.setCas(10);
+    item.setRevSeqno(3);
+    item.setBySeqno(7);
+    ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
+    {
+        auto res = ht.findForWrite(key);
+        res.storedValue->markClean();
+        ASSERT_TRUE(ht.unlocked_ejectItem(
+                res.lock, res.storedValue, EvictionPolicy::Full));
+    }
+    EXPECT_EQ(1, ht.getEvictedMetaIndex().size());
+    EXPECT_EQ(0, ht.getNumInMemoryItems());
+
+    {
+        auto hbl = ht.getLockedBucket(key);
+        auto meta = ht.unlocked_takeEvictedMeta(hbl, key);
+        ASSERT_TRUE(meta);
+        EXPECT_EQ(key, meta->getKey());
+        EXPECT_EQ(10, meta->getCas());
+        EXPECT_EQ(3, meta->getRevSeqno());
+        EXPECT_EQ(7, meta->getBySeqno());
+        EXPECT_EQ(0xcafe, meta->getFlags());
+        EXPECT_EQ(1234, meta->getExptime());
+        EXPECT_FALSE(meta->isDeleted());
+
+        // Taken, so no longer indexed.
+        EXPECT_FALSE(ht.unlocked_takeEvictedMeta(hbl, key));
+    }
+    EXPECT_EQ(1, ht.getEvictedMetaIndex().getNumHits());
+
+    // Evict again, then add the key back: the index entry is dropped.
+    ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
+    {
+        auto res = ht.findForWrite(key);
+        res.storedValue->markClean();
+        ASSERT_TRUE(ht.unlocked_ejectItem(
+                res.lock, res.storedValue, EvictionPolicy::Full));
+    }
+    EXPECT_EQ(1, ht.getEvictedMetaIndex().size());
+    ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
+    EXPECT_EQ(0, ht.getEvictedMetaIndex().size());
+    {
+        auto hbl = ht.getLockedBucket(key);
+        EXPECT_FALSE(ht.unlocked_takeEvictedMeta(
+                hbl, makeStoredDocKey("other")));
+    }
+}
+
+// A disabled index keeps nothing.
+TEST_F(HashTableTest, EvictedMetaIndexDisabled) {
+    HashTable ht(global_stats, makeFactory(), 5, 1);
+    EXPECT_FALSE(ht.getEvictedMetaIndex().isEnabled());
+    const auto key = makeStoredDocKey("key");
+    Item item(key, 0, 0, "value", strlen("value"));
+    ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
+    {
+        auto res = ht.findForWrite(key);
+        res.storedValue->markClean();
+        ASSERT_TRUE(ht.unlocked_ejectItem(
+                res.lock, res.storedValue, EvictionPolicy::Full));
+    }
+    EXPECT_EQ(0, ht.getEvictedMetaIndex().size());
+}
@@ -398,4 +398,23 @@ TEST(HdrHistogramTest, aggregationTestEmptyRhs) {
     // Check the totals of each histogram
     EXPECT_EQ(200, histogramOne.getValueCount());
     EXPECT_EQ(0, histogramTwo.getValueCount());
-}
\ No newline at end of file
+}
+TEST(HdrHistogramTest, getMetricsData) {
+    HdrHistogram histogram{0, 255, 3};
+    EXPECT_TRUE(histogram.getMetricsData().buckets.empty());
+
+    for (int i = 0; i < 100; i++) {
+        histogram.addValue(i);
+    }
+
+    const auto data = histogram.getMetricsData();
+    EXPECT_EQ(100, data.count);
+    EXPECT_NEAR(4950, data.sum, 50);
+    ASSERT_FALSE(data.buckets.empty());
+    // The buckets are cumulative, with increasing upper bounds
+    for (size_t ii = 1; ii < data.buckets.size(); ++ii) {
+        EXPECT_LT(data.buckets[ii - 1].first, data.buckets[ii].first);
+        EXPECT_LE(data.buckets[ii - 1].second, data.buckets[ii].second);
+    }
+    EXPECT_EQ(100, data.buckets.back().second);
+}
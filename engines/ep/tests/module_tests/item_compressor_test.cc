@@ -16,11 +16,14 @@
  */
 
 #include "item_compressor_test.h"
+#include "compression_sampler.h"
 #include "item.h"
 #include "item_compressor_visitor.h"
 #include "test_helpers.h"
 #include "vbucket.h"
 
+#include <random>
+
 TEST_P(ItemCompressorTest, testCompressionInActiveMode) {
     std::string compressibleValue(
             "{\"product\": \"car\",\"price\": \"100\"},"
@@ -129,6 +132,77 @@ TEST_P(ItemCompressorTest, testStoreUncompressedInActiveMode) {
     EXPECT_EQ(PROTOCOL_BINARY_DATATYPE_JSON, v->getDatatype());
 }
 
+// Test that items whose frequency counter has reached the hot threshold are
+// left uncompressed, while colder items are still compressed.
+TEST_P(ItemCompressorTest, testHotItemsNotCompressed) {
+    std::string compressibleValue(
+            "{\"product\": \"car\",\"price\": \"100\"},"
+            "{\"product\": \"bus\",\"price\": \"1000\"},"
+            "{\"product\": \"Train\",\"price\": \"100000\"}");
+
+    auto hotKey = makeStoredDocKey("hot");
+    auto coldKey = makeStoredDocKey("cold");
+    for (const auto& key : {hotKey, coldKey}) {
+        auto item = make_item(vbucket->getId(),
+                              key,
+                              compressibleValue,
+                              0,
+                              PROTOCOL_BINARY_DATATYPE_JSON);
+        ASSERT_EQ(MutationStatus::WasClean, public_processSet(item, 0));
+    }
+    findValue(hotKey)->setFreqCounterValue(200);
+
+    PauseResumeVBAdapter prAdapter(std::make_unique<ItemCompressorVisitor>());
+
+    auto& visitor =
+            dynamic_cast<ItemCompressorVisitor&>(prAdapter.getHTVisitor());
+    visitor.setCompressionMode(BucketCompressionMode::Active);
+    visitor.setMinCompressionRatio(config.getMinCompressionRatio());
+    visitor.setHotThreshold(200);
+    prAdapter.visit(*vbucket);
+
+    EXPECT_EQ(PROTOCOL_BINARY_DATATYPE_JSON, findValue(hotKey)->getDatatype());
+    EXPECT_EQ(compressibleValue, findValue(hotKey)->getValue()->to_s());
+    EXPECT_EQ(PROTOCOL_BINARY_DATATYPE_JSON | PROTOCOL_BINARY_DATATYPE_SNAPPY,
+              findValue(coldKey)->getDatatype());
+    EXPECT_EQ(1, visitor.getSkippedHotCount());
+    EXPECT_EQ(1, visitor.getCompressedCount());
+    EXPECT_EQ(2, visitor.getVisitedCount());
+}
+
+// Test that once enough values of a collection failed to compress, the
+// compressor stops trying to compress that collection's values.
+TEST_P(ItemCompressorTest, testIncompressibleCollectionSkipped) {
+    std::mt19937 rng(0);
+    for (int ii = 0; ii < 20; ++ii) {
+        std::string randomValue(256, '\0');
+        for (auto& c : randomValue) {
+            c = char(rng());
+        }
+        auto item = make_item(vbucket->getId(),
+                              makeStoredDocKey("key" + std::to_string(ii)),
+                              randomValue,
+                              0,
+                              PROTOCOL_BINARY_RAW_BYTES);
+        ASSERT_EQ(MutationStatus::WasClean, public_processSet(item, 0));
+    }
+
+    PauseResumeVBAdapter prAdapter(std::make_unique<ItemCompressorVisitor>());
+
+    auto& visitor =
+            dynamic_cast<ItemCompressorVisitor&>(prAdapter.getHTVisitor());
+    CompressionSampler sampler(4, 1000);
+    visitor.setCompressionMode(BucketCompressionMode::Active);
+    visitor.setMinCompressionRatio(config.getMinCompressionRatio());
+    visitor.setCompressionSampler(&sampler);
+    prAdapter.visit(*vbucket);
+
+    EXPECT_EQ(0, visitor.getCompressedCount());
+    EXPECT_EQ(16, visitor.getSkippedIncompressibleCount());
+    EXPECT_EQ(20, visitor.getVisitedCount());
+    EXPECT_FALSE(sampler.shouldAttempt(CollectionID::Default));
+}
+
 INSTANTIATE_TEST_CASE_P(
         AllVBTypesAllEvictionModes,
         ItemCompressorTest,
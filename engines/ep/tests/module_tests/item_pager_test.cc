@@ -290,6 +290,30 @@ TEST_P(STItemPagerTest, ServerQuotaReached) {
     }
 }
 
+// Test that the sampled eviction strategy brings memory usage down to the
+// low watermark without visiting every item.
+TEST_P(STItemPagerTest, ServerQuotaReachedSampled) {
+    if (std::get<1>(GetParam()) == "fail_new_data") {
+        // No ItemPager to configure.
+        return;
+    }
+    engine->getConfiguration().setItemEvictionStrategy("sampled");
+    engine->getConfiguration().setItemEvictionSampleSize(1);
+
+    size_t count = populateUntilTmpFail(vbid);
+    ASSERT_GE(count, 50) << "Too few documents stored";
+
+    runHighMemoryPager();
+
+    auto& stats = engine->getEpStats();
+    EXPECT_LT(stats.getEstimatedTotalMemoryUsed(), stats.mem_low_wat.load())
+            << "Expected to be below low watermark after running item pager";
+    EXPECT_GT(stats.pagerItemsEvicted, 0);
+    EXPECT_LT(stats.pagerItemsVisited, count)
+            << "Expected the sampled strategy to visit fewer items than the "
+               "vBucket holds";
+}
+
 TEST_P(STItemPagerTest, HighWaterMarkTriggersPager) {
     // Fill to just over HWM
     populateUntilAboveHighWaterMark(vbid);
@@ -1078,6 +1102,79 @@ TEST_P(STValueEvictionExpiryPagerTest, MB_25991_ExpiryNonResident) {
     EXPECT_EQ(ENGINE_KEY_ENOENT, result.getStatus());
 }
 
+/**
+ * Expiry pager tests with the expiry index enabled, so the pager only looks
+ * at the items due to expire.
+ */
+class STExpiryIndexPagerTest : public STExpiryPagerTest {
+protected:
+    void SetUp() override {
+        config_string += "exp_pager_use_index=true;";
+        STExpiryPagerTest::SetUp();
+    }
+};
+
+TEST_P(STExpiryIndexPagerTest, ExpiredItemsDeleted) {
+    expiredItemsDeleted();
+
+    std::list<Item> expired;
+    EXPECT_EQ(0,
+              engine->getVBucket(vbid)->getExpiredItemsFromIndex(
+                      ep_real_time(), expired))
+            << "Expired items should have been removed from the index";
+}
+
+// An item touched to a later expiry isn't expired at its original expiry.
+TEST_P(STExpiryIndexPagerTest, TouchedItemNotExpired) {
+    auto key = makeStoredDocKey("key");
+    auto item = make_item(
+            vbid, key, "value", ep_abs_time(ep_current_time() + 10));
+    ASSERT_EQ(ENGINE_SUCCESS, storeItem(item));
+    auto touched = make_item(
+            vbid, key, "value", ep_abs_time(ep_current_time() + 100));
+    ASSERT_EQ(ENGINE_SUCCESS, storeItem(touched));
+    flushDirectlyIfPersistent(vbid, std::make_pair(false, 1));
+
+    TimeTraveller marty(20);
+    wakeUpExpiryPager();
+
+    EXPECT_EQ(1, engine->getVBucket(vbid)->getNumItems());
+    EXPECT_EQ(ENGINE_SUCCESS,
+              store->get(key, vbid, cookie, get_options_t()).getStatus());
+}
+
+/**
+ * Expiry index tests only applicable to Full eviction persistent buckets.
+ */
+class STFullEvictionExpiryIndexPagerTest : public STExpiryIndexPagerTest {
+public:
+    static auto configValues() {
+        return ::testing::Values(
+                std::make_tuple("persistent"s, "full_eviction"s));
+    }
+};
+
+// With the index, the expiry pager also expires items which have been
+// fully evicted from memory (otherwise only compaction would).
+TEST_P(STFullEvictionExpiryIndexPagerTest, FullyEvictedItemExpired) {
+    auto key = makeStoredDocKey("key");
+    auto item = make_item(
+            vbid, key, "value", ep_abs_time(ep_current_time() + 5));
+    ASSERT_EQ(ENGINE_SUCCESS, storeItem(item));
+    flushDirectlyIfPersistent(vbid, std::make_pair(false, 1));
+
+    evict_key(vbid, key);
+    auto vb = engine->getVBucket(vbid);
+    ASSERT_FALSE(vb->ht.findForRead(key).storedValue);
+
+    TimeTraveller tedTheodoreLogan(11);
+    wakeUpExpiryPager();
+    flushDirectlyIfPersistent(vbid, std::make_pair(false, 1));
+
+    EXPECT_EQ(0, vb->getNumItems());
+    EXPECT_EQ(1, vb->numExpiredItems);
+}
+
 class MB_32669 : public STValueEvictionExpiryPagerTest {
 public:
     void SetUp() override {
@@ -1195,6 +1292,16 @@ INSTANTIATE_TEST_CASE_P(ValueOnly,
                         STValueEvictionExpiryPagerTest::configValues(),
                         STParameterizedBucketTest::PrintToStringParamName);
 
+INSTANTIATE_TEST_CASE_P(EphemeralOrPersistent,
+                        STExpiryIndexPagerTest,
+                        STParameterizedBucketTest::allConfigValues(),
+                        STParameterizedBucketTest::PrintToStringParamName);
+
+INSTANTIATE_TEST_CASE_P(FullEviction,
+                        STFullEvictionExpiryIndexPagerTest,
+                        STFullEvictionExpiryIndexPagerTest::configValues(),
+                        STParameterizedBucketTest::PrintToStringParamName);
+
 INSTANTIATE_TEST_CASE_P(Persistent,
                         MB_32669,
                         STValueEvictionExpiryPagerTest::configValues(),
@@ -162,6 +162,30 @@ TEST_F(ItemTest, retainInfoUponItemCopy) {
     EXPECT_EQ(item1, item2) << "Item values not retained on copy";
 }
 
+TEST_F(ItemTest, compressValueMaxCompressedRatio) {
+    const std::string valueData(1000, 'a');
+    item = std::make_unique<Item>(makeStoredDocKey("key"),
+                                  0,
+                                  0,
+                                  valueData.c_str(),
+                                  valueData.size(),
+                                  PROTOCOL_BINARY_DATATYPE_JSON);
+
+    // Compresses to a few percent of its size, which isn't enough.
+    ASSERT_TRUE(item->compressValue(0.01));
+    EXPECT_EQ(PROTOCOL_BINARY_DATATYPE_JSON, item->getDataType());
+    EXPECT_EQ(valueData.size(), item->getNBytes());
+
+    ASSERT_TRUE(item->compressValue(0.5));
+    EXPECT_EQ(PROTOCOL_BINARY_DATATYPE_JSON | PROTOCOL_BINARY_DATATYPE_SNAPPY,
+              item->getDataType());
+    EXPECT_LT(item->getNBytes(), valueData.size() / 2);
+
+    ASSERT_TRUE(item->decompressValue());
+    EXPECT_EQ(valueData,
+              std::string(item->getData(), item->getNBytes()));
+}
+
 TEST_F(ItemPruneTest, testPruneNothing) {
     item->pruneValueAndOrXattrs(IncludeValue::Yes, IncludeXattrs::Yes);
 
@@ -194,6 +218,33 @@ TEST_F(ItemPruneTest, testPruneXattrs) {
                          item->getNBytes()));
 }
 
+TEST_F(ItemPruneTest, testHideXattrs) {
+    Item copy(*item);
+    copy.hideXattrs();
+
+    // The value is shared with the original item, and still has the xattrs
+    EXPECT_EQ(item->getData(), copy.getData());
+    EXPECT_EQ(item->getNBytes(), copy.getNBytes());
+    EXPECT_TRUE(mcbp::datatype::is_xattr(copy.getDataType()));
+
+    // ... but they're not exposed
+    std::string valueData = R"({"json":"yes"})";
+    auto info = copy.toItemInfo(0, 0);
+    EXPECT_EQ(PROTOCOL_BINARY_DATATYPE_JSON, info.datatype);
+    EXPECT_EQ(valueData.size(), info.nbytes);
+    EXPECT_EQ(valueData,
+              std::string(static_cast<const char*>(info.value[0].iov_base),
+                          info.value[0].iov_len));
+    auto visible = copy.getVisibleValue();
+    EXPECT_EQ(valueData, std::string(visible.data(), visible.size()));
+
+    // Replacing the value exposes all of it again
+    copy.replaceValue(Blob::New(valueData.data(), valueData.size()));
+    copy.setDataType(PROTOCOL_BINARY_DATATYPE_JSON);
+    visible = copy.getVisibleValue();
+    EXPECT_EQ(valueData, std::string(visible.data(), visible.size()));
+}
+
 TEST_F(ItemPruneTest, testPruneValue) {
     item->pruneValueAndOrXattrs(IncludeValue::No, IncludeXattrs::Yes);
 
@@ -38,6 +38,7 @@
 #include "tasks.h"
 #include "tests/mock/mock_global_task.h"
 #include "tests/mock/mock_synchronous_ep_engine.h"
+#include "tests/module_tests/collections/test_manifest.h"
 #include "tests/module_tests/test_helpers.h"
 #include "vbucketdeletiontask.h"
 #include "warmup.h"
@@ -587,6 +588,216 @@ TEST_P(KVBucketParamTest, AddNMVB) {
     EXPECT_EQ(ENGINE_NOT_MY_VBUCKET, store->add(item, cookie));
 }
 
+// Check bulkSet stores all of the items, in order
+TEST_P(KVBucketParamTest, BulkSet) {
+    std::vector<std::unique_ptr<Item>> items;
+    for (int ii = 0; ii < 3; ++ii) {
+        items.push_back(std::make_unique<Item>(
+                make_item(vbid,
+                          makeStoredDocKey("key" + std::to_string(ii)),
+                          "value" + std::to_string(ii))));
+    }
+    // The same key again, which must win
+    items.push_back(std::make_unique<Item>(
+            make_item(vbid, makeStoredDocKey("key0"), "value3")));
+
+    size_t stored = 0;
+    EXPECT_EQ(ENGINE_SUCCESS, store->bulkSet(vbid, items, cookie, stored));
+    EXPECT_EQ(4, stored);
+
+    auto gv = store->get(makeStoredDocKey("key0"), vbid, cookie, NONE);
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ("value3", gv.item->getValue()->to_s());
+    gv = store->get(makeStoredDocKey("key2"), vbid, cookie, NONE);
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ("value2", gv.item->getValue()->to_s());
+
+    auto vb = store->getVBucket(vbid);
+    EXPECT_EQ(4, vb->getHighSeqno());
+}
+
+// Check bulkSet stores nothing if the items are not of one collection, or
+// not for an active vbucket
+TEST_P(KVBucketParamTest, BulkSetInvalid) {
+    std::vector<std::unique_ptr<Item>> items;
+    items.push_back(std::make_unique<Item>(
+            make_item(vbid, makeStoredDocKey("key"), "value")));
+    items.push_back(std::make_unique<Item>(make_item(
+            vbid, makeStoredDocKey("key", CollectionEntry::fruit), "value")));
+
+    size_t stored = 1;
+    EXPECT_EQ(ENGINE_EINVAL, store->bulkSet(vbid, items, cookie, stored));
+    EXPECT_EQ(0, stored);
+
+    items.pop_back();
+    EXPECT_EQ(ENGINE_NOT_MY_VBUCKET,
+              store->bulkSet(Vbid(vbid.get() + 1), items, cookie, stored));
+    store->setVBucketState(vbid, vbucket_state_replica);
+    EXPECT_EQ(ENGINE_NOT_MY_VBUCKET,
+              store->bulkSet(vbid, items, cookie, stored));
+    EXPECT_EQ(0, stored);
+    EXPECT_EQ(0, store->getVBucket(vbid)->getHighSeqno());
+}
+
+// Arithmetic tests ///////////////////////////////////////////////////////////
+
+// Check arithmetic updates a resident counter in place, as a new revision
+TEST_P(KVBucketParamTest, Arithmetic) {
+    const auto key = makeStoredDocKey("counter");
+    auto stored = store_item(vbid, key, "10");
+
+    auto result = store->arithmetic(key, vbid, cookie, true, 5, 0);
+    ASSERT_EQ(cb::engine_errc::success, result.status);
+    EXPECT_EQ(15, result.value);
+    EXPECT_NE(stored.getCas(), result.cas);
+    auto vb = store->getVBucket(vbid);
+    EXPECT_EQ(vb->getHighSeqno(), result.seqno);
+    EXPECT_EQ(vb->failovers->getLatestUUID(), result.vbucket_uuid);
+
+    // Decrement stops at zero
+    result = store->arithmetic(key, vbid, cookie, false, 20, result.cas);
+    ASSERT_EQ(cb::engine_errc::success, result.status);
+    EXPECT_EQ(0, result.value);
+
+    auto gv = store->get(key, vbid, cookie, NONE);
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ("0", gv.item->getValue()->to_s());
+    EXPECT_EQ(result.cas, gv.item->getCas());
+    EXPECT_EQ(2, engine->getEpStats().numOpsArithmeticInPlace);
+}
+
+// Check the errors arithmetic reports itself, and the documents it leaves to
+// a get and CAS set
+TEST_P(KVBucketParamTest, ArithmeticNotInPlace) {
+    const auto key = makeStoredDocKey("counter");
+    EXPECT_EQ(cb::engine_errc::not_supported,
+              store->arithmetic(key, vbid, cookie, true, 1, 0).status);
+
+    auto stored = store_item(vbid, key, "1");
+    EXPECT_EQ(cb::engine_errc::key_already_exists,
+              store->arithmetic(key, vbid, cookie, true, 1, stored.getCas() + 1)
+                      .status);
+    EXPECT_EQ(cb::engine_errc::not_my_vbucket,
+              store->arithmetic(key, Vbid(vbid.get() + 1), cookie, true, 1, 0)
+                      .status);
+
+    store_item(vbid, key, "not a number");
+    EXPECT_EQ(cb::engine_errc::delta_badval,
+              store->arithmetic(key, vbid, cookie, true, 1, 0).status);
+
+    delete_item(vbid, key);
+    EXPECT_EQ(cb::engine_errc::not_supported,
+              store->arithmetic(key, vbid, cookie, true, 1, 0).status);
+    EXPECT_EQ(0, engine->getEpStats().numOpsArithmeticInPlace);
+}
+
+TEST_P(KVBucketParamTest, AppendPrepend) {
+    const auto key = makeStoredDocKey("key");
+    auto stored = store_item(vbid, key, R"({"a":1})");
+
+    uint64_t cas = 0;
+    mutation_descr_t mutInfo;
+    ASSERT_EQ(
+            ENGINE_SUCCESS,
+            store->appendPrepend(key, vbid, cookie, true, "xy", cas, mutInfo));
+    EXPECT_NE(stored.getCas(), cas);
+    auto vb = store->getVBucket(vbid);
+    EXPECT_EQ(uint64_t(vb->getHighSeqno()), mutInfo.seqno);
+    EXPECT_EQ(vb->failovers->getLatestUUID(), mutInfo.vbucket_uuid);
+
+    ASSERT_EQ(
+            ENGINE_SUCCESS,
+            store->appendPrepend(key, vbid, cookie, false, "[", cas, mutInfo));
+    auto gv = store->get(key, vbid, cookie, NONE);
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ(R"([{"a":1}xy)", gv.item->getValue()->to_s());
+    EXPECT_EQ(cas, gv.item->getCas());
+    EXPECT_EQ(stored.getFlags(), gv.item->getFlags());
+    EXPECT_EQ(PROTOCOL_BINARY_RAW_BYTES, gv.item->getDataType());
+
+    // A value which becomes JSON is flagged as such
+    store_item(vbid, key, "[1");
+    cas = 0;
+    ASSERT_EQ(ENGINE_SUCCESS,
+              store->appendPrepend(key, vbid, cookie, true, "]", cas, mutInfo));
+    gv = store->get(key, vbid, cookie, NONE);
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ(PROTOCOL_BINARY_DATATYPE_JSON, gv.item->getDataType());
+    EXPECT_EQ(3, engine->getEpStats().numOpsAppendPrependInPlace);
+}
+
+// Check the errors appendPrepend reports itself, and the documents it leaves
+// to a get and CAS set
+TEST_P(KVBucketParamTest, AppendPrependNotInPlace) {
+    const auto key = makeStoredDocKey("key");
+    uint64_t cas = 0;
+    mutation_descr_t mutInfo;
+    EXPECT_EQ(ENGINE_ENOTSUP,
+              store->appendPrepend(key, vbid, cookie, true, "x", cas, mutInfo));
+
+    auto stored = store_item(vbid, key, "value");
+    cas = stored.getCas() + 1;
+    EXPECT_EQ(ENGINE_KEY_EEXISTS,
+              store->appendPrepend(key, vbid, cookie, true, "x", cas, mutInfo));
+    cas = 0;
+    EXPECT_EQ(ENGINE_NOT_MY_VBUCKET,
+              store->appendPrepend(key,
+                                   Vbid(vbid.get() + 1),
+                                   cookie,
+                                   true,
+                                   "x",
+                                   cas,
+                                   mutInfo));
+
+    const std::string big(engine->getMaxItemSize(), 'x');
+    EXPECT_EQ(ENGINE_E2BIG,
+              store->appendPrepend(key, vbid, cookie, true, big, cas, mutInfo));
+
+    delete_item(vbid, key);
+    EXPECT_EQ(ENGINE_ENOTSUP,
+              store->appendPrepend(key, vbid, cookie, true, "x", cas, mutInfo));
+    EXPECT_EQ(0, engine->getEpStats().numOpsAppendPrependInPlace);
+}
+
+// A SET of an Item allocated for the front end shares it with the checkpoint,
+// rather than the checkpoint copying it from the StoredValue
+TEST_P(KVBucketParamTest, SetSharesFrontEndItemWithCheckpoint) {
+    item* itm = nullptr;
+    ASSERT_EQ(ENGINE_SUCCESS,
+              engine->itemAllocate(
+                      &itm, makeStoredDocKey("key"), 5, 0, 0, 0, 0, vbid));
+    auto* allocated = reinterpret_cast<Item*>(itm);
+    std::memcpy(const_cast<char*>(allocated->getData()), "value", 5);
+
+    auto vb = store->getVBucket(vbid);
+    auto cursor = vb->checkpointManager->registerCursorBySeqno("test", 0)
+                          .cursor.lock();
+    ASSERT_EQ(ENGINE_SUCCESS, store->set(*allocated, cookie));
+    // An Item the front end doesn't own is copied
+    auto other = make_item(vbid, makeStoredDocKey("other"), "value");
+    ASSERT_EQ(ENGINE_SUCCESS, store->set(other, cookie));
+
+    std::vector<queued_item> items;
+    vb->checkpointManager->getAllItemsForCursor(cursor.get(), items);
+    std::vector<const Item*> mutations;
+    for (const auto& qi : items) {
+        if (!qi->isCheckPointMetaItem()) {
+            mutations.push_back(qi.get());
+        }
+    }
+    ASSERT_EQ(2, mutations.size());
+    EXPECT_EQ(allocated, mutations[0]);
+    EXPECT_EQ(vb->getHighSeqno() - 1, allocated->getBySeqno());
+    EXPECT_NE(0, allocated->getCas());
+    EXPECT_NE(&other, mutations[1]);
+    EXPECT_EQ(other.getKey(), mutations[1]->getKey());
+
+    // The Item outlives the front end's release while the checkpoint has it
+    engine->itemRelease(itm);
+    EXPECT_EQ("value", mutations[0]->getValue()->to_s());
+    vb->checkpointManager->removeCursor(cursor.get());
+}
+
 // SetWithMeta tests //////////////////////////////////////////////////////////
 
 // Test basic setWithMeta
@@ -1018,6 +1229,45 @@ TEST_P(KVBucketParamTest, getAndUpdateTtlTempDeletedItemTest) {
     EXPECT_EQ(0, store->getVBucket(vbid)->getNumTempItems());
 }
 
+// Check that with touch_coalesce_window set, a touch which only extends an
+// item's expiry a little leaves the item as it is, and any other is applied.
+TEST_P(KVBucketParamTest, getAndUpdateTtlCoalesced) {
+    engine->getConfiguration().setTouchCoalesceWindow(60);
+    auto key = makeStoredDocKey("key");
+    const uint32_t expiry = ep_real_time() + 1000;
+    store_item(vbid, key, "value", expiry);
+    flushVBucketToDiskIfPersistent(vbid, 1);
+    auto vb = store->getVBucket(vbid);
+    const auto seqno = vb->getHighSeqno();
+
+    // Extended by less than the window: coalesced
+    auto gv = store->getAndUpdateTtl(key, vbid, cookie, expiry + 30);
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ(expiry, gv.item->getExptime());
+    EXPECT_EQ(seqno, vb->getHighSeqno());
+    EXPECT_EQ(1, engine->getEpStats().numOpsTouchCoalesced);
+
+    // Extended by the window, or brought forward: applied
+    gv = store->getAndUpdateTtl(key, vbid, cookie, expiry + 60);
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ(expiry + 60, gv.item->getExptime());
+    EXPECT_EQ(seqno + 1, vb->getHighSeqno());
+    gv = store->getAndUpdateTtl(key, vbid, cookie, expiry);
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ(expiry, gv.item->getExptime());
+    EXPECT_EQ(seqno + 2, vb->getHighSeqno());
+
+    // A short TTL which would be left with less than half of the requested
+    // TTL: applied
+    auto shortKey = makeStoredDocKey("short");
+    const uint32_t shortExpiry = ep_real_time() + 10;
+    store_item(vbid, shortKey, "value", shortExpiry);
+    gv = store->getAndUpdateTtl(shortKey, vbid, cookie, shortExpiry + 15);
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ(shortExpiry + 15, gv.item->getExptime());
+    EXPECT_EQ(1, engine->getEpStats().numOpsTouchCoalesced);
+}
+
 TEST_P(KVBucketParamTest, validateKeyTempDeletedItemTest) {
     //This test is to check if the getAndUpdateTtl function will
     //remove temporary deleted items from memory
@@ -1278,6 +1528,22 @@ TEST_P(KVBucketParamTest, MB31495_GetRandomKey) {
     EXPECT_EQ(ENGINE_SUCCESS, gv.getStatus());
 }
 
+TEST_P(KVBucketParamTest, GetRandomKeys) {
+    EXPECT_TRUE(store->getRandomKeys(10).empty());
+
+    const auto key1 = makeStoredDocKey("key1");
+    const auto key2 = makeStoredDocKey("key2");
+    store_item(vbid, key1, "value");
+    store_item(vbid, key2, "value");
+
+    // Keys are sampled with replacement
+    auto keys = store->getRandomKeys(100);
+    ASSERT_EQ(100, keys.size());
+    for (const auto& key : keys) {
+        EXPECT_TRUE(key == key1 || key == key2) << key.to_string();
+    }
+}
+
 // MB-33702: Test that SetVBucket state creates a new failover table entry when
 // transitioning from non-active to active.
 TEST_P(KVBucketParamTest, FailoverEntryAddedNonActiveToActive) {
@@ -1398,6 +1664,31 @@ TEST_F(ExpiryLimitTest, gat) {
     EXPECT_NE(0, info.exptime);
 }
 
+// Test that freeVBuckets deletes every vBucket, crediting the memory of their
+// HashTables back to the bucket, when spread across more threads than there
+// are vBuckets
+TEST_P(KVBucketParamTest, FreeVBuckets) {
+    const size_t initialSize = engine->getEpStats().getCurrentSize();
+    for (uint16_t ii = 1; ii < 4; ++ii) {
+        store->setVBucketState(Vbid(ii), vbucket_state_active);
+    }
+    for (uint16_t ii = 0; ii < 4; ++ii) {
+        for (int key = 0; key < 10; ++key) {
+            store_item(Vbid(ii),
+                       makeStoredDocKey("key" + std::to_string(key)),
+                       "value");
+        }
+    }
+    ASSERT_LT(initialSize, engine->getEpStats().getCurrentSize());
+
+    store->freeVBuckets(8);
+
+    for (uint16_t ii = 0; ii < 4; ++ii) {
+        EXPECT_FALSE(store->getVBucket(Vbid(ii)));
+    }
+    EXPECT_EQ(initialSize, engine->getEpStats().getCurrentSize());
+}
+
 // Test cases which run for EP (Full and Value eviction) and Ephemeral
 INSTANTIATE_TEST_CASE_P(EphemeralOrPersistent,
                         KVBucketParamTest,
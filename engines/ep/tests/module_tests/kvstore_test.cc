@@ -44,6 +44,7 @@
 #include <folly/portability/GMock.h>
 #include <folly/portability/GTest.h>
 #include <kvstore.h>
+#include <random>
 #include <thread>
 #include <unordered_map>
 #include <vector>
@@ -270,6 +271,56 @@ TEST_F(CouchKVStoreTest, CompressedTest) {
     kvstore->destroyScanContext(scanCtx);
 }
 
+// A key order scan visits the documents by key, not by seqno.
+TEST_F(CouchKVStoreTest, ScanKeyOrder) {
+    KVStoreConfig config(1024, 4, data_dir, "couchdb", 0);
+    auto kvstore = setup_kv_store(config);
+
+    kvstore->begin(std::make_unique<TransactionContext>());
+
+    // key5 has seqno 1, ..., key1 has seqno 5
+    WriteCallback wc;
+    for (int i = 1; i <= 5; i++) {
+        std::string key("key" + std::to_string(6 - i));
+        Item item(makeStoredDocKey(key),
+                  0,
+                  0,
+                  "value",
+                  5,
+                  PROTOCOL_BINARY_RAW_BYTES,
+                  0,
+                  i);
+        kvstore->set(item, wc);
+    }
+
+    kvstore->commit(flush);
+
+    std::vector<std::string> keys;
+    std::vector<int64_t> seqnos;
+    auto cb = std::make_shared<CustomCallback<GetValue>>(
+            [&keys, &seqnos](GetValue result) {
+                keys.push_back(result.item->getKey().c_str());
+                seqnos.push_back(result.item->getBySeqno());
+            });
+    auto cl = std::make_shared<KVStoreTestCacheCallback>(1, 5, Vbid(0));
+    // Start at seqno 2, so key5 is not visited.
+    ScanContext* scanCtx =
+            kvstore->initScanContext(cb,
+                                     cl,
+                                     Vbid(0),
+                                     2,
+                                     DocumentFilter::ALL_ITEMS,
+                                     ValueFilter::VALUES_DECOMPRESSED);
+    ASSERT_NE(nullptr, scanCtx);
+    ASSERT_TRUE(kvstore->setScanKeyOrder(*scanCtx));
+    EXPECT_EQ(scan_success, kvstore->scan(scanCtx));
+    kvstore->destroyScanContext(scanCtx);
+
+    EXPECT_EQ(std::vector<std::string>({"key1", "key2", "key3", "key4"}),
+              keys);
+    EXPECT_EQ(std::vector<int64_t>({5, 4, 3, 2}), seqnos);
+}
+
 // Verify the stats returned from operations are accurate.
 TEST_F(CouchKVStoreTest, StatsTest) {
     KVStoreConfig config(1024, 4, data_dir, "couchdb", 0);
@@ -301,6 +352,240 @@ TEST_F(CouchKVStoreTest, StatsTest) {
     EXPECT_GE(io_total_write_bytes, io_write_bytes);
 }
 
+// Verify getMulti returns the correct documents when reading in file offset
+// order, where offset order differs from key order.
+TEST_F(CouchKVStoreTest, GetMultiOffsetOrder) {
+    KVStoreConfig config(1024, 4, data_dir, "couchdb", 0);
+    config.setBgFetchOffsetOrder(true);
+    auto kvstore = setup_kv_store(config);
+
+    // Write keys in descending order, one commit each, so later keys
+    // (in key order) are earlier in the file.
+    const int numKeys = 10;
+    WriteCallback wc;
+    for (int i = numKeys - 1; i >= 0; --i) {
+        kvstore->begin(std::make_unique<TransactionContext>());
+        const auto key = "key" + std::to_string(i);
+        Item item(makeStoredDocKey(key), 0, 0, key.c_str(), key.size());
+        kvstore->set(item, wc);
+        ASSERT_TRUE(kvstore->commit(flush));
+    }
+
+    vb_bgfetch_queue_t itms;
+    for (int i = 0; i < numKeys; ++i) {
+        vb_bgfetch_item_ctx_t ctx;
+        ctx.isMetaOnly = GetMetaOnly::No;
+        itms[DiskDocKey{makeStoredDocKey("key" + std::to_string(i))}] =
+                std::move(ctx);
+    }
+    kvstore->getMulti(Vbid(0), itms);
+
+    for (int i = 0; i < numKeys; ++i) {
+        const auto key = "key" + std::to_string(i);
+        auto& value = itms[DiskDocKey{makeStoredDocKey(key)}].value;
+        ASSERT_EQ(ENGINE_SUCCESS, value.getStatus()) << key;
+        EXPECT_EQ(key, value.item->getValue()->to_s()) << key;
+    }
+
+    const auto& st = kvstore->getKVStoreStat();
+    EXPECT_EQ(1, st.getMultiBatchSizeHisto.getValueCount());
+    EXPECT_EQ(numKeys, st.getMultiDocReadTimeHisto.getValueCount());
+}
+
+// Verify reads reuse a cached read handle, and that a commit invalidates it so
+// the next read sees the new header.
+TEST_F(CouchKVStoreTest, ReadHandleCache) {
+    KVStoreConfig config(1024, 4, data_dir, "couchdb", 0);
+    config.setReadHandleCacheSize(4);
+    auto kvstore = setup_kv_store(config);
+
+    WriteCallback wc;
+    auto store = [&](const std::string& key, const std::string& value) {
+        kvstore->begin(std::make_unique<TransactionContext>());
+        Item item(makeStoredDocKey(key), 0, 0, value.c_str(), value.size());
+        kvstore->set(item, wc);
+        ASSERT_TRUE(kvstore->commit(flush));
+    };
+    auto getStats = [&kvstore]() {
+        std::map<std::string, std::string> stats;
+        kvstore->addStats(add_stat_callback, &stats, "");
+        return stats;
+    };
+
+    store("key", "value1");
+
+    auto gv = kvstore->get(DiskDocKey{makeStoredDocKey("key")}, Vbid(0));
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    gv = kvstore->get(DiskDocKey{makeStoredDocKey("key")}, Vbid(0));
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    auto stats = getStats();
+    EXPECT_EQ("1", stats["rw_0:read_handle_cache_hits"]);
+    EXPECT_EQ("1", stats["rw_0:read_handle_cache_misses"]);
+
+    // The cached handle predates this commit, so must not be reused.
+    store("key", "value2");
+    gv = kvstore->get(DiskDocKey{makeStoredDocKey("key")}, Vbid(0));
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ("value2", gv.item->getValue()->to_s());
+    stats = getStats();
+    EXPECT_EQ("1", stats["rw_0:read_handle_cache_hits"]);
+    EXPECT_EQ("2", stats["rw_0:read_handle_cache_misses"]);
+}
+
+// Verify reads are served from the block cache once it holds the blocks they
+// need, and still see later commits.
+TEST_F(CouchKVStoreTest, BlockCache) {
+    KVStoreConfig config(1024, 4, data_dir, "couchdb", 0);
+    config.setBlockCacheSize(1024 * 1024);
+    auto kvstore = setup_kv_store(config);
+
+    WriteCallback wc;
+    auto store = [&](const std::string& key, const std::string& value) {
+        kvstore->begin(std::make_unique<TransactionContext>());
+        Item item(makeStoredDocKey(key), 0, 0, value.c_str(), value.size());
+        kvstore->set(item, wc);
+        ASSERT_TRUE(kvstore->commit(flush));
+    };
+    auto getStat = [&kvstore](const std::string& name) {
+        std::map<std::string, std::string> stats;
+        kvstore->addStats(add_stat_callback, &stats, "");
+        return std::stoull(stats.at("rw_0:" + name));
+    };
+
+    for (int i = 0; i < 100; ++i) {
+        store("key" + std::to_string(i), std::string(100, 'a' + i % 26));
+    }
+
+    auto gv = kvstore->get(DiskDocKey{makeStoredDocKey("key10")}, Vbid(0));
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_NE(0, getStat("block_cache_misses"));
+    EXPECT_NE(0, getStat("block_cache_memory"));
+
+    // The second read finds the btree nodes in the cache. (The header is
+    // in the last, partial, block of the file, which is never cached.)
+    const auto hits = getStat("block_cache_hits");
+    gv = kvstore->get(DiskDocKey{makeStoredDocKey("key10")}, Vbid(0));
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ(std::string(100, 'a' + 10), gv.item->getValue()->to_s());
+    EXPECT_LT(hits, getStat("block_cache_hits"));
+
+    store("key10", "updated");
+    gv = kvstore->get(DiskDocKey{makeStoredDocKey("key10")}, Vbid(0));
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ("updated", gv.item->getValue()->to_s());
+}
+
+// Verify a vBucket file deleted and recreated at the same revision (so the
+// same path) isn't served the blocks cached from the old file.
+TEST_F(CouchKVStoreTest, BlockCacheFileRecreated) {
+    KVStoreConfig config(1024, 4, data_dir, "couchdb", 0);
+    config.setBlockCacheSize(1024 * 1024);
+    auto kvstore = setup_kv_store(config);
+
+    WriteCallback wc;
+    // Values of the same length each time, so the new file lays out its
+    // documents and btree nodes at the same offsets as the old one.
+    auto storeAll = [&](char base) {
+        for (int i = 0; i < 100; ++i) {
+            kvstore->begin(std::make_unique<TransactionContext>());
+            const std::string value(100, base + i % 13);
+            Item item(makeStoredDocKey("key" + std::to_string(i)),
+                      0,
+                      0,
+                      value.c_str(),
+                      value.size());
+            kvstore->set(item, wc);
+            ASSERT_TRUE(kvstore->commit(flush));
+        }
+    };
+    auto getStat = [&kvstore](const std::string& name) {
+        std::map<std::string, std::string> stats;
+        kvstore->addStats(add_stat_callback, &stats, "");
+        return std::stoull(stats.at("rw_0:" + name));
+    };
+
+    storeAll('a');
+    for (int ii = 0; ii < 2; ++ii) {
+        auto gv = kvstore->get(DiskDocKey{makeStoredDocKey("key10")}, Vbid(0));
+        ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+        EXPECT_EQ(std::string(100, 'a' + 10), gv.item->getValue()->to_s());
+    }
+    ASSERT_NE(0, getStat("block_cache_hits"));
+
+    const auto rev = kvstore->prepareToDelete(Vbid(0));
+    kvstore->delVBucket(Vbid(0), rev);
+    auto files = cb::io::findFilesWithPrefix(data_dir + "/0.couch");
+    ASSERT_TRUE(files.empty());
+
+    storeAll('n');
+    ASSERT_TRUE(cb::io::isFile(data_dir + "/0.couch." + std::to_string(rev)));
+
+    for (int i = 0; i < 100; ++i) {
+        const auto key = "key" + std::to_string(i);
+        auto gv = kvstore->get(DiskDocKey{makeStoredDocKey(key)}, Vbid(0));
+        ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus()) << key;
+        EXPECT_EQ(std::string(100, 'n' + i % 13), gv.item->getValue()->to_s())
+                << key;
+    }
+}
+
+// Verify getMulti in file offset order merges the reads of documents which
+// are adjacent in the file, and still returns the right documents.
+TEST_F(CouchKVStoreTest, GetMultiMergesAdjacentReads) {
+    const int numKeys = 10;
+    std::mt19937 gen(42);
+    std::vector<std::string> values;
+    {
+        KVStoreConfig config(1024, 4, data_dir, "couchdb", 0);
+        auto kvstore = setup_kv_store(config);
+        // Documents larger than couchstore's read buffer, so each is read
+        // on its own unless merged.
+        WriteCallback wc;
+        kvstore->begin(std::make_unique<TransactionContext>());
+        for (int i = 0; i < numKeys; ++i) {
+            std::string value(6000, '\0');
+            for (auto& c : value) {
+                c = char(gen());
+            }
+            values.push_back(value);
+            const auto key = "key" + std::to_string(i);
+            Item item(makeStoredDocKey(key), 0, 0, value.c_str(), value.size());
+            kvstore->set(item, wc);
+        }
+        ASSERT_TRUE(kvstore->commit(flush));
+    }
+
+    auto fetchAll = [&](bool offsetOrder) {
+        KVStoreConfig config(1024, 4, data_dir, "couchdb", 0);
+        config.setBgFetchOffsetOrder(offsetOrder);
+        auto kvstore = KVStoreFactory::create(config);
+        vb_bgfetch_queue_t itms;
+        for (int i = 0; i < numKeys; ++i) {
+            vb_bgfetch_item_ctx_t ctx;
+            ctx.isMetaOnly = GetMetaOnly::No;
+            itms[DiskDocKey{makeStoredDocKey("key" + std::to_string(i))}] =
+                    std::move(ctx);
+        }
+        kvstore.rw->getMulti(Vbid(0), itms);
+        for (int i = 0; i < numKeys; ++i) {
+            const auto key = "key" + std::to_string(i);
+            auto& value = itms[DiskDocKey{makeStoredDocKey(key)}].value;
+            EXPECT_EQ(ENGINE_SUCCESS, value.getStatus()) << key;
+            if (value.item) {
+                EXPECT_EQ(values[i], value.item->getValue()->to_s()) << key;
+            }
+        }
+        size_t reads = 0;
+        EXPECT_TRUE(kvstore.rw->getStat("io_bg_fetch_read_count", reads));
+        return reads;
+    };
+
+    const auto unmerged = fetchAll(false);
+    const auto merged = fetchAll(true);
+    EXPECT_GE(unmerged, size_t(numKeys));
+    EXPECT_LT(merged, unmerged - numKeys / 2);
+}
+
 // Verify the compaction stats returned from operations are accurate.
 TEST_F(CouchKVStoreTest, CompactStatsTest) {
     KVStoreConfig config(1, 4, data_dir, "couchdb", 0);
@@ -343,6 +628,242 @@ TEST_F(CouchKVStoreTest, CompactStatsTest) {
     EXPECT_GE(io_compaction_write_bytes, io_write_bytes);
 }
 
+/// Compaction BloomFilter callback which runs a function on its first call.
+class OnceBloomFilterCallback : public Callback<Vbid&, const DocKey&, bool&> {
+public:
+    explicit OnceBloomFilterCallback(std::function<void()> fn)
+        : fn(std::move(fn)) {
+    }
+
+    void callback(Vbid&, const DocKey&, bool&) override {
+        if (fn) {
+            fn();
+            fn = nullptr;
+        }
+    }
+
+private:
+    std::function<void()> fn;
+};
+
+// Verify that writes made to a vBucket whilst it is being compacted
+// concurrently are present in the compacted file.
+TEST_F(CouchKVStoreTest, ConcurrentCompactionCatchesUp) {
+    KVStoreConfig config(1, 4, data_dir, "couchdb", 0);
+    config.setConcurrentCompaction(true);
+    auto kvstore = setup_kv_store(config);
+    ASSERT_TRUE(kvstore->getStorageProperties().hasConcWriteCompact());
+
+    int64_t seqno = 0;
+    WriteCallback wc;
+    auto store = [&kvstore, &seqno, &wc, this](const std::string& key,
+                                               const std::string& value) {
+        kvstore->begin(std::make_unique<TransactionContext>());
+        Item item(makeStoredDocKey(key), 0, 0, value.c_str(), value.size());
+        item.setBySeqno(++seqno);
+        kvstore->set(item, wc);
+        ASSERT_TRUE(kvstore->commit(flush));
+    };
+
+    const int numKeys = 10;
+    for (int i = 0; i < numKeys; ++i) {
+        store("key" + std::to_string(i), "old");
+    }
+
+    CompactionConfig compactionConfig;
+    compactionConfig.db_file_id = Vbid(0);
+    compaction_ctx cctx(compactionConfig, 0);
+    cctx.curr_time = 0;
+
+    // Part way through compaction, update and delete existing keys and add
+    // a new one, as the flusher might.
+    cctx.bloomFilterCallback = std::make_shared<OnceBloomFilterCallback>(
+            [&kvstore, &seqno, &store, this]() {
+                store("key0", "new");
+                store("key10", "new");
+
+                kvstore->begin(std::make_unique<TransactionContext>());
+                Item item(makeStoredDocKey("key1"), 0, 0, nullptr, 0);
+                item.setDeleted();
+                item.setBySeqno(++seqno);
+                DeleteCallback dc;
+                kvstore->del(item, dc);
+                ASSERT_TRUE(kvstore->commit(flush));
+            });
+
+    EXPECT_TRUE(kvstore->compactDB(&cctx));
+
+    auto gv = kvstore->get(DiskDocKey{makeStoredDocKey("key0")}, Vbid(0));
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ("new", gv.item->getValue()->to_s());
+    gv = kvstore->get(DiskDocKey{makeStoredDocKey("key10")}, Vbid(0));
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ("new", gv.item->getValue()->to_s());
+    gv = kvstore->get(DiskDocKey{makeStoredDocKey("key1")}, Vbid(0));
+    EXPECT_EQ(ENGINE_KEY_ENOENT, gv.getStatus());
+    gv = kvstore->get(DiskDocKey{makeStoredDocKey("key2")}, Vbid(0));
+    ASSERT_EQ(ENGINE_SUCCESS, gv.getStatus());
+    EXPECT_EQ("old", gv.item->getValue()->to_s());
+
+    // The cached vBucket state reflects the caught-up file.
+    auto* state = kvstore->getVBucketState(Vbid(0));
+    ASSERT_TRUE(state);
+    EXPECT_EQ(seqno, state->highSeqno);
+
+    std::map<std::string, std::string> stats;
+    kvstore->addStats(add_stat_callback, &stats, "");
+    EXPECT_EQ("3", stats["rw_0:compaction_catchup_items"]);
+    EXPECT_EQ(1,
+              kvstore->getKVStoreStat()
+                      .compactWriteBlockHisto.getValueCount());
+}
+
+// Verify that a vBucket reset or deleted whilst it is being compacted
+// concurrently discards the compacted file, rather than switching to it and
+// leaving the file orphaned.
+TEST_F(CouchKVStoreTest, ConcurrentCompactionDiscardedByResetOrDelete) {
+    KVStoreConfig config(1, 4, data_dir, "couchdb", 0);
+    config.setConcurrentCompaction(true);
+    auto kvstore = setup_kv_store(config);
+
+    int64_t seqno = 0;
+    WriteCallback wc;
+    auto store = [&kvstore, &seqno, &wc, this]() {
+        kvstore->begin(std::make_unique<TransactionContext>());
+        Item item(makeStoredDocKey("key"), 0, 0, "value", 5);
+        item.setBySeqno(++seqno);
+        kvstore->set(item, wc);
+        ASSERT_TRUE(kvstore->commit(flush));
+    };
+    auto compact = [&kvstore](std::function<void()> duringCompaction) {
+        CompactionConfig compactionConfig;
+        compactionConfig.db_file_id = Vbid(0);
+        compaction_ctx cctx(compactionConfig, 0);
+        cctx.curr_time = 0;
+        cctx.bloomFilterCallback = std::make_shared<OnceBloomFilterCallback>(
+                std::move(duringCompaction));
+        return kvstore->compactDB(&cctx);
+    };
+
+    store();
+    EXPECT_FALSE(compact([&kvstore]() { kvstore->reset(Vbid(0)); }));
+    auto files = cb::io::findFilesWithPrefix(data_dir + "/0.couch");
+    ASSERT_EQ(1, files.size());
+    EXPECT_EQ(ENGINE_KEY_ENOENT,
+              kvstore->get(DiskDocKey{makeStoredDocKey("key")}, Vbid(0))
+                      .getStatus());
+
+    store();
+    EXPECT_FALSE(compact([&kvstore]() {
+        kvstore->delVBucket(Vbid(0), kvstore->prepareToDelete(Vbid(0)));
+    }));
+    files = cb::io::findFilesWithPrefix(data_dir + "/0.couch");
+    EXPECT_TRUE(files.empty());
+}
+
+// The flushes of different vBuckets can be made through one store from
+// different threads at once; each thread's transaction is its own until
+// committed.
+TEST_F(CouchKVStoreTest, ConcurrentFlushes) {
+    KVStoreConfig config(2, 1, data_dir, "couchdb", 0);
+    auto kvstore = setup_kv_store(config, {Vbid(0), Vbid(1)});
+    ASSERT_TRUE(kvstore->getStorageProperties().hasConcurrentFlush());
+
+    const int numFlushes = 50;
+    auto flushVBucket = [&kvstore](Vbid vbid) {
+        Collections::VB::Manifest manifest;
+        Collections::VB::Flush flush(manifest);
+        WriteCallback wc;
+        for (int i = 1; i <= numFlushes; ++i) {
+            kvstore->begin(std::make_unique<TransactionContext>());
+            const auto key = "key" + std::to_string(i);
+            Item item(makeStoredDocKey(key),
+                      0,
+                      0,
+                      "value",
+                      5,
+                      PROTOCOL_BINARY_RAW_BYTES,
+                      0,
+                      i,
+                      vbid);
+            kvstore->set(item, wc);
+            EXPECT_TRUE(kvstore->commit(flush));
+        }
+    };
+    std::thread t1(flushVBucket, Vbid(0));
+    std::thread t2(flushVBucket, Vbid(1));
+    t1.join();
+    t2.join();
+
+    for (auto vbid : {Vbid(0), Vbid(1)}) {
+        for (int i = 1; i <= numFlushes; ++i) {
+            const auto key = "key" + std::to_string(i);
+            auto gv = kvstore->get(DiskDocKey{makeStoredDocKey(key)}, vbid);
+            EXPECT_EQ(ENGINE_SUCCESS, gv.getStatus()) << key << " " << vbid;
+        }
+        auto* state = kvstore->getVBucketState(vbid);
+        ASSERT_TRUE(state);
+        EXPECT_EQ(numFlushes, state->highSeqno);
+    }
+}
+
+// Verify rollback opens the file at the first indexed header past the
+// rollback seqno, rolling back to the same header as without the index (and
+// reading less), and that the index is trimmed by the rollback.
+TEST_F(CouchKVStoreTest, RollbackIndex) {
+    auto rollback = [this](size_t interval) {
+        KVStoreConfig config(1024, 4, data_dir, "couchdb", 0);
+        config.setRollbackIndexInterval(interval);
+        auto kvstore = setup_kv_store(config);
+
+        WriteCallback wc;
+        auto store = [&](int64_t seqno) {
+            kvstore->begin(std::make_unique<TransactionContext>());
+            const auto key = "key" + std::to_string(seqno);
+            Item item(makeStoredDocKey(key),
+                      0,
+                      0,
+                      key.c_str(),
+                      key.size(),
+                      PROTOCOL_BINARY_RAW_BYTES,
+                      0,
+                      seqno);
+            kvstore->set(item, wc);
+            ASSERT_TRUE(kvstore->commit(flush));
+        };
+        for (int64_t seqno = 1; seqno <= 100; ++seqno) {
+            store(seqno);
+        }
+
+        size_t rolledBack = 0;
+        auto rcb = std::make_shared<CustomRBCallback>(
+                [&rolledBack](GetValue) { ++rolledBack; });
+        const auto& reads = kvstore->getKVStoreStat().fsStats.readSizeHisto;
+        const auto readsBefore = reads.getValueCount();
+        auto result = kvstore->rollback(Vbid(0), 60, rcb);
+        const auto rollbackReads = reads.getValueCount() - readsBefore;
+        EXPECT_TRUE(result.success);
+        EXPECT_EQ(60, result.highSeqno);
+        EXPECT_EQ(40, rolledBack);
+
+        // Write past (and roll back across) the headers rolled back.
+        for (int64_t seqno = 61; seqno <= 65; ++seqno) {
+            store(seqno);
+        }
+        result = kvstore->rollback(Vbid(0), 62, rcb);
+        EXPECT_TRUE(result.success);
+        EXPECT_EQ(62, result.highSeqno);
+
+        kvstore.reset();
+        cb::io::rmrf(data_dir);
+        return rollbackReads;
+    };
+
+    const auto unindexedReads = rollback(0);
+    const auto indexedReads = rollback(1);
+    EXPECT_LT(indexedReads, unindexedReads);
+}
+
 // Regression test for MB-17517 - ensure that if a couchstore file has a max
 // CAS of -1, it is detected and reset to zero when file is loaded.
 TEST_F(CouchKVStoreTest, MB_17517MaxCasOfMinus1) {
@@ -2428,6 +2949,80 @@ TEST_P(KVStoreParamTest, GetRangeDeleted) {
     EXPECT_EQ("value_e"s, results.at(1).item->getValue()->to_s());
 }
 
+// Test scanRange() can return just keys, and stops when the callback asks it
+// to - from where a later scan resumes.
+TEST_P(KVStoreParamTest, ScanRangeKeysOnlyAndStop) {
+    kvstore->begin(std::make_unique<TransactionContext>());
+    WriteCallback dummyCb;
+    for (char k = 'a'; k < 'h'; k++) {
+        auto item = makeCommittedItem(makeStoredDocKey({k}),
+                                      "value_"s + std::string{k});
+        kvstore->set(*item, dummyCb);
+    }
+    kvstore->commit(flush);
+
+    // Test: Scan [a,g) keys-only, stopping after 3 keys.
+    std::vector<std::string> keys;
+    kvstore->scanRange(Vbid{0},
+                       makeDiskDocKey("a"),
+                       makeDiskDocKey("g"),
+                       ValueFilter::KEYS_ONLY,
+                       [&keys](GetValue&& gv) {
+                           EXPECT_EQ(0, gv.item->getNBytes());
+                           keys.push_back(gv.item->getKey().c_str());
+                           return keys.size() < 3;
+                       });
+    EXPECT_EQ((std::vector<std::string>{"a", "b", "c"}), keys);
+
+    // Resume from the next key, with values, to the end of the range.
+    keys.clear();
+    std::vector<std::string> values;
+    kvstore->scanRange(Vbid{0},
+                       makeDiskDocKey("d"),
+                       makeDiskDocKey("g"),
+                       ValueFilter::VALUES_DECOMPRESSED,
+                       [&keys, &values](GetValue&& gv) {
+                           keys.push_back(gv.item->getKey().c_str());
+                           values.push_back(gv.item->getValue()->to_s());
+                           return true;
+                       });
+    EXPECT_EQ((std::vector<std::string>{"d", "e", "f"}), keys);
+    EXPECT_EQ((std::vector<std::string>{"value_d", "value_e", "value_f"}),
+              values);
+}
+
+// Test getMulti() fetches every key of a batch, in a single batched read.
+TEST_P(KVStoreParamTest, GetMultiBasic) {
+    kvstore->begin(std::make_unique<TransactionContext>());
+    WriteCallback dummyCb;
+    for (char k = 'a'; k < 'f'; k++) {
+        auto item = makeCommittedItem(makeStoredDocKey({k}),
+                                      "value_"s + std::string{k});
+        kvstore->set(*item, dummyCb);
+    }
+    kvstore->commit(flush);
+
+    // Ask for all of them, plus a key which doesn't exist.
+    vb_bgfetch_queue_t itms;
+    for (char k = 'a'; k < 'g'; k++) {
+        vb_bgfetch_item_ctx_t ctx;
+        ctx.isMetaOnly = GetMetaOnly::No;
+        itms[makeDiskDocKey({k})] = std::move(ctx);
+    }
+    kvstore->getMulti(Vbid(0), itms);
+
+    for (char k = 'a'; k < 'f'; k++) {
+        auto& value = itms[makeDiskDocKey({k})].value;
+        ASSERT_EQ(ENGINE_SUCCESS, value.getStatus()) << k;
+        ASSERT_TRUE(value.item) << k;
+        EXPECT_EQ("value_"s + std::string{k}, value.item->getValue()->to_s());
+    }
+    EXPECT_FALSE(itms[makeDiskDocKey("f")].value.item);
+
+    const auto& st = kvstore->getKVStoreStat();
+    EXPECT_EQ(1, st.getMultiBatchSizeHisto.getValueCount());
+}
+
 TEST_P(KVStoreParamTest, Durability_PersistPrepare) {
     StoredDocKey key = makeStoredDocKey("key");
     Item item(key,
@@ -0,0 +1,115 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "lock_profiler.h"
+#include "locks.h"
+
+#include <folly/portability/GTest.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+
+class LockProfilerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        LockProfiler::reset();
+    }
+
+    void TearDown() override {
+        LockProfiler::setSampleInterval(0);
+        LockProfiler::reset();
+    }
+
+    /// @return the total count of the given histogram stat of the profile
+    static uint64_t getCount(const std::string& name) {
+        uint64_t count = 0;
+        LockProfiler::addStats(
+                [&count, &name](const char* key,
+                                const uint16_t klen,
+                                const char* val,
+                                const uint32_t vlen,
+                                gsl::not_null<const void*>) {
+                    const std::string k(key, klen);
+                    // Histogram buckets are reported as <name>_<low>,<high>
+                    if (k.compare(0, name.size() + 1, name + "_") == 0 &&
+                        k.find(',') != std::string::npos) {
+                        count += std::stoull(std::string(val, vlen));
+                    }
+                },
+                &count);
+        return count;
+    }
+
+    std::mutex mutex;
+};
+
+TEST_F(LockProfilerTest, DisabledByDefault) {
+    EXPECT_EQ(0u, LockProfiler::getSampleInterval());
+    for (int ii = 0; ii < 10; ++ii) {
+        EXPECT_FALSE(LockProfiler::shouldSample());
+    }
+}
+
+TEST_F(LockProfilerTest, SampleInterval) {
+    LockProfiler::setSampleInterval(4);
+    int sampled = 0;
+    for (int ii = 0; ii < 40; ++ii) {
+        if (LockProfiler::shouldSample()) {
+            ++sampled;
+        }
+    }
+    EXPECT_EQ(10, sampled);
+}
+
+TEST_F(LockProfilerTest, ProfiledLockHolder) {
+    LockProfiler::setSampleInterval(1);
+    {
+        ProfiledLockHolder<LockHolder> lh(LockSite::CheckpointQueue, mutex);
+        EXPECT_FALSE(mutex.try_lock());
+    }
+    EXPECT_TRUE(mutex.try_lock());
+    mutex.unlock();
+
+    EXPECT_EQ(1u, getCount("checkpoint_queue_wait"));
+    EXPECT_EQ(1u, getCount("checkpoint_queue_hold"));
+    EXPECT_EQ(0u, getCount("hash_bucket_wait"));
+}
+
+TEST_F(LockProfilerTest, DiscardedHold) {
+    LockProfiler::setSampleInterval(1);
+    {
+        LockSample sample(LockSite::HashBucket);
+        std::unique_lock<std::mutex> lh(mutex);
+        sample.acquired();
+        lh.unlock();
+        sample.discard();
+    }
+    EXPECT_EQ(1u, getCount("hash_bucket_wait"));
+    EXPECT_EQ(0u, getCount("hash_bucket_hold"));
+}
+
+TEST_F(LockProfilerTest, MovedSample) {
+    LockProfiler::setSampleInterval(1);
+    {
+        LockSample sample(LockSite::DcpStream);
+        sample.acquired();
+        LockSample moved(std::move(sample));
+    }
+    // Only the sample moved to records the hold.
+    EXPECT_EQ(1u, getCount("dcp_stream_hold"));
+}
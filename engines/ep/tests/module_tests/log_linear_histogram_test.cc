@@ -0,0 +1,162 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "hdrhistogram.h"
+#include "log_linear_histogram.h"
+
+#include <folly/portability/GTest.h>
+
+#include <thread>
+#include <vector>
+
+/*
+ * Unit tests for the LogLinearHistogram
+ */
+
+// Values below SubBucketCount are counted exactly
+TEST(LogLinearHistogramTest, SmallValuesAreExact) {
+    LogLinearHistogram histogram;
+    for (uint64_t ii = 0; ii < LogLinearHistogram::SubBucketCount; ++ii) {
+        histogram.addValue(ii);
+    }
+    EXPECT_EQ(LogLinearHistogram::SubBucketCount, histogram.getValueCount());
+
+    uint64_t expected = 0;
+    histogram.forEachBucket([&expected](uint64_t low, uint64_t high,
+                                        uint64_t count) {
+        EXPECT_EQ(expected, low);
+        EXPECT_EQ(expected + 1, high);
+        EXPECT_EQ(1, count);
+        ++expected;
+    });
+    EXPECT_EQ(LogLinearHistogram::SubBucketCount, expected);
+}
+
+// Every value is counted in a bucket which contains it, and whose width is
+// at most 1/SubBucketCount of its low value.
+TEST(LogLinearHistogramTest, BucketBounds) {
+    for (uint64_t value : {8ull, 9ull, 15ull, 16ull, 17ull, 1000ull, 65535ull,
+                           1234567ull, 60000000ull}) {
+        LogLinearHistogram histogram;
+        histogram.addValue(value);
+        histogram.forEachBucket([value](uint64_t low, uint64_t high,
+                                        uint64_t count) {
+            EXPECT_LE(low, value);
+            EXPECT_GT(high, value);
+            EXPECT_LE((high - low) * LogLinearHistogram::SubBucketCount, low);
+            EXPECT_EQ(1, count);
+        });
+        EXPECT_EQ(1, histogram.getValueCount());
+        EXPECT_DOUBLE_EQ(double(value), histogram.getMean());
+    }
+}
+
+// Values above the trackable range are counted in the last bucket
+TEST(LogLinearHistogramTest, Overflow) {
+    LogLinearHistogram histogram;
+    histogram.addValue(std::numeric_limits<uint64_t>::max() / 2);
+    histogram.addValue(uint64_t(1) << 40);
+    EXPECT_EQ(2, histogram.getValueCount());
+
+    int buckets = 0;
+    histogram.forEachBucket([&buckets](uint64_t low, uint64_t, uint64_t count) {
+        EXPECT_EQ(LogLinearHistogram::getBucketLow(
+                          LogLinearHistogram::NumBlocks - 1,
+                          LogLinearHistogram::SubBucketCount - 1),
+                  low);
+        EXPECT_EQ(2, count);
+        ++buckets;
+    });
+    EXPECT_EQ(1, buckets);
+}
+
+TEST(LogLinearHistogramTest, Percentiles) {
+    LogLinearHistogram histogram;
+    EXPECT_EQ(0, histogram.getValueAtPercentile(50.0));
+    for (uint64_t ii = 1; ii <= 100; ++ii) {
+        histogram.addValue(ii);
+    }
+    EXPECT_EQ(1, histogram.getValueAtPercentile(0.0));
+    // 50 is in [48, 52)
+    EXPECT_EQ(51, histogram.getValueAtPercentile(50.0));
+    // 100 is in [96, 104)
+    EXPECT_EQ(103, histogram.getValueAtPercentile(100.0));
+}
+
+// Merging (and copying) adds up the counts of each bucket
+TEST(LogLinearHistogramTest, Merge) {
+    LogLinearHistogram a;
+    LogLinearHistogram b;
+    a.addValue(1, 2);
+    a.addValue(1000);
+    b.addValue(1000, 3);
+    b.addValue(100000);
+
+    a += b;
+    EXPECT_EQ(7, a.getValueCount());
+    EXPECT_EQ(4, b.getValueCount());
+    // 1000 is in [960, 1024)
+    EXPECT_EQ(1023, a.getValueAtPercentile(50.0));
+
+    LogLinearHistogram copy(a);
+    EXPECT_EQ(a.to_string(), copy.to_string());
+    EXPECT_DOUBLE_EQ(a.getMean(), copy.getMean());
+
+    copy = b;
+    EXPECT_EQ(b.to_string(), copy.to_string());
+
+    copy.reset();
+    EXPECT_EQ(0, copy.getValueCount());
+    EXPECT_EQ("{}", copy.to_string());
+}
+
+// Blocks are only allocated for the ranges recorded
+TEST(LogLinearHistogramTest, MemFootPrint) {
+    LogLinearHistogram histogram;
+    const auto empty = histogram.getMemFootPrint();
+    EXPECT_LT(empty, Hdr1sfMicroSecHistogram().getMemFootPrint());
+
+    histogram.addValue(1000);
+    histogram.addValue(1001);
+    const auto oneBlock = histogram.getMemFootPrint();
+    EXPECT_GT(oneBlock, empty);
+
+    histogram.addValue(1000000);
+    EXPECT_GT(histogram.getMemFootPrint(), oneBlock);
+
+    // reset() keeps the blocks
+    const auto before = histogram.getMemFootPrint();
+    histogram.reset();
+    EXPECT_EQ(before, histogram.getMemFootPrint());
+}
+
+TEST(LogLinearHistogramTest, ConcurrentAdd) {
+    LogLinearMicroSecHistogram histogram;
+    const int threads = 4;
+    const int iterations = 10000;
+    std::vector<std::thread> workers;
+    for (int tt = 0; tt < threads; ++tt) {
+        workers.emplace_back([&histogram]() {
+            for (int ii = 0; ii < iterations; ++ii) {
+                histogram.add(std::chrono::microseconds(ii));
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    EXPECT_EQ(threads * iterations, histogram.getValueCount());
+}
@@ -482,6 +482,78 @@ TEST_F(MutationLogTest, BatchLoad) {
     }
 }
 
+TEST_F(MutationLogTest, PrefixCompressedKeys) {
+    // Sorted keys sharing a long prefix, enough to span several blocks.
+    const std::string prefix(40, 'k');
+    std::set<StoredDocKey> expected;
+    for (size_t ii = 0; ii < 2000; ii++) {
+        expected.insert(makeStoredDocKey(prefix + std::to_string(ii)));
+    }
+
+    size_t uncompressedSize = 0;
+    {
+        MutationLog ml(tmp_log_filename.c_str());
+        ml.open();
+        for (const auto& key : expected) {
+            ml.newItem(Vbid(0), key);
+            uncompressedSize += MutationLogEntryV3::len(key.size());
+        }
+        ml.commit1();
+        ml.commit2();
+
+        // Each key is stored as a (short) suffix of the previous one.
+        EXPECT_LT(ml.logSize, uncompressedSize / 2);
+        EXPECT_LT(ml.getBlockSize(), ml.logSize);
+    }
+
+    {
+        MutationLog ml(tmp_log_filename.c_str());
+        ml.open(true);
+        MutationLogHarvester h(ml);
+        h.setVBucket(Vbid(0));
+        EXPECT_TRUE(h.load());
+
+        std::set<StoredDocKey> maps[1];
+        h.apply(&maps, loaderFun);
+        EXPECT_EQ(expected, maps[0]);
+    }
+}
+
+TEST_F(MutationLogTest, WriteBuffer) {
+    std::set<StoredDocKey> expected;
+    for (size_t ii = 0; ii < 2000; ii++) {
+        expected.insert(makeStoredDocKey("key" + std::to_string(ii)));
+    }
+
+    {
+        MutationLog ml(tmp_log_filename.c_str());
+        ml.open();
+        ml.setSyncConfig(0);
+        ml.setWriteBufferSize(ml.getBlockSize() * 2);
+        const size_t initialSize = ml.logSize;
+        for (const auto& key : expected) {
+            ml.newItem(Vbid(0), key);
+        }
+        ml.commit1();
+        ml.commit2();
+
+        // The flushed blocks are only written once 2 have gathered.
+        EXPECT_LT(initialSize, ml.logSize);
+        EXPECT_EQ(0, (ml.logSize - initialSize) % (ml.getBlockSize() * 2));
+    }
+
+    // Everything gathered is written by close()
+    MutationLog ml(tmp_log_filename.c_str());
+    ml.open(true);
+    MutationLogHarvester h(ml);
+    h.setVBucket(Vbid(0));
+    EXPECT_TRUE(h.load());
+
+    std::set<StoredDocKey> maps[1];
+    h.apply(&maps, loaderFun);
+    EXPECT_EQ(expected, maps[0]);
+}
+
 // @todo
 //   Test Read Only log
 //   Test close / open / close / open
@@ -0,0 +1,79 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "pid_controller.h"
+
+#include <folly/portability/GTest.h>
+
+using namespace std::chrono;
+
+// With only a proportional gain the output follows the error.
+TEST(PIDControllerTest, Proportional) {
+    PIDController pid(0.1, 2.0, 0.0, 0.0);
+    const auto now = steady_clock::now();
+    EXPECT_DOUBLE_EQ(0.4, pid.step(0.3, now));
+    EXPECT_DOUBLE_EQ(0.2, pid.step(0.2, now + seconds(1)));
+    // At (or below) the set point no effort is asked for.
+    EXPECT_DOUBLE_EQ(0.0, pid.step(0.1, now + seconds(2)));
+    EXPECT_DOUBLE_EQ(0.0, pid.step(0.05, now + seconds(3)));
+}
+
+// A steady error builds up the integral term over time.
+TEST(PIDControllerTest, Integral) {
+    PIDController pid(0.1, 0.0, 0.5, 0.0);
+    const auto now = steady_clock::now();
+    // No interval yet on the first step.
+    EXPECT_DOUBLE_EQ(0.0, pid.step(0.2, now));
+    EXPECT_NEAR(0.05, pid.step(0.2, now + seconds(1)), 1e-9);
+    EXPECT_NEAR(0.15, pid.step(0.2, now + seconds(3)), 1e-9);
+}
+
+// The output is clamped, and the integral doesn't wind up while it is, so the
+// output drops as soon as the measured value falls below the set point.
+TEST(PIDControllerTest, ClampedWithoutWindup) {
+    PIDController pid(0.1, 1.0, 1.0, 0.0);
+    auto now = steady_clock::now();
+    pid.step(0.9, now);
+    for (int ii = 0; ii < 100; ++ii) {
+        now += seconds(1);
+        EXPECT_DOUBLE_EQ(1.0, pid.step(0.9, now));
+    }
+
+    now += seconds(1);
+    EXPECT_LT(pid.step(0.0, now), 1.0);
+    now += seconds(1);
+    EXPECT_DOUBLE_EQ(0.0, pid.step(0.0, now));
+}
+
+// The derivative term responds to how fast the error changes.
+TEST(PIDControllerTest, Derivative) {
+    PIDController pid(0.0, 0.0, 0.0, 1.0);
+    const auto now = steady_clock::now();
+    pid.step(0.1, now);
+    EXPECT_NEAR(0.2, pid.step(0.3, now + seconds(1)), 1e-9);
+    EXPECT_DOUBLE_EQ(0.0, pid.step(0.3, now + seconds(2)));
+}
+
+TEST(PIDControllerTest, Reset) {
+    PIDController pid(0.0, 0.0, 1.0, 0.0);
+    const auto now = steady_clock::now();
+    pid.step(0.5, now);
+    EXPECT_NEAR(0.5, pid.step(0.5, now + seconds(1)), 1e-9);
+    pid.reset();
+    EXPECT_DOUBLE_EQ(0.0, pid.getOutput());
+    EXPECT_DOUBLE_EQ(0.0, pid.step(0.5, now + seconds(2)));
+}
@@ -0,0 +1,86 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "configuration.h"
+#include "replicationthrottle.h"
+#include "stats.h"
+
+#include <folly/portability/GTest.h>
+
+using namespace std::chrono;
+
+class ReplicationThrottleTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        config.setReplicationThrottleRateBased(true);
+        stats.replicationThrottleWriteQueueCap = 1000;
+    }
+
+    Configuration config;
+    EPStats stats;
+};
+
+// Without replication_throttle_rate_based, acks are never paced.
+TEST_F(ReplicationThrottleTest, RateBasedDisabled) {
+    config.setReplicationThrottleRateBased(false);
+    ReplicationThrottle throttle(config, stats);
+    stats.diskQueueSize.store(999);
+
+    auto now = steady_clock::now();
+    for (int ii = 0; ii < 3; ++ii) {
+        EXPECT_EQ(10000, throttle.getAckableBytes(10000, now));
+        now += seconds(1);
+    }
+    EXPECT_EQ(0, throttle.getAckRate());
+    EXPECT_EQ(0, stats.replicationThrottleDeferredAcks);
+}
+
+// From half the cap, acks are paced to the flusher's throughput, scaled down
+// as the queue approaches the cap; below it they aren't paced.
+TEST_F(ReplicationThrottleTest, PacedToFlusherThroughput) {
+    ReplicationThrottle throttle(config, stats);
+    auto now = steady_clock::now();
+
+    // Below half the cap nothing is paced. 10000 bytes are acked for the
+    // 100 items they queued for persistence (100 bytes per item).
+    stats.diskQueueSize.store(400);
+    EXPECT_EQ(10000, throttle.getAckableBytes(10000, now));
+    stats.totalEnqueued.fetch_add(100);
+
+    // A second later the queue is at 3/4 of the cap, and the flusher has
+    // persisted 100 items/s: half of the headroom between half the cap and
+    // the cap is left, so 50 items (5000 bytes) a second are let in.
+    stats.diskQueueSize.store(750);
+    stats.totalPersisted.fetch_add(100);
+    now += seconds(1);
+    EXPECT_EQ(5000, throttle.getAckableBytes(10000, now));
+    EXPECT_EQ(5000, throttle.getAckRate());
+
+    // The budget is used up until more time passes.
+    EXPECT_EQ(0, throttle.getAckableBytes(10000, now));
+    now += milliseconds(500);
+    EXPECT_EQ(2500, throttle.getAckableBytes(10000, now));
+    EXPECT_EQ(3, stats.replicationThrottleDeferredAcks);
+
+    // Once the queue drains back under half the cap acks aren't paced.
+    stats.diskQueueSize.store(400);
+    stats.totalEnqueued.fetch_add(75);
+    stats.totalPersisted.fetch_add(425);
+    now += milliseconds(500);
+    EXPECT_EQ(10000, throttle.getAckableBytes(10000, now));
+    EXPECT_EQ(0, throttle.getAckRate());
+}
@@ -493,3 +493,39 @@ TEST_F(EpStatsTest, memoryAllocated) {
 
     EXPECT_EQ(0, stats.getPreciseTotalMemoryUsed());
 }
+
+// Check memory is attributed to the domain of the MemoryDomainGuard it's
+// allocated (or freed) within, and that the domains add up to the total.
+TEST_F(EpStatsTest, memoryDomains) {
+    TestEpStat stats;
+    stats.memoryTrackerEnabled = true;
+
+    ASSERT_EQ(MemoryDomain::Other, ObjectRegistry::getMemoryDomain());
+    stats.memAllocated(100);
+    {
+        MemoryDomainGuard hashTable(MemoryDomain::HashTable);
+        EXPECT_EQ(MemoryDomain::HashTable, ObjectRegistry::getMemoryDomain());
+        stats.memAllocated(30);
+        {
+            MemoryDomainGuard blob(MemoryDomain::Blob);
+            stats.memAllocated(20);
+            stats.memDeallocated(5);
+        }
+        // The enclosing guard's domain is restored
+        EXPECT_EQ(MemoryDomain::HashTable, ObjectRegistry::getMemoryDomain());
+        stats.memDeallocated(10);
+    }
+    EXPECT_EQ(MemoryDomain::Other, ObjectRegistry::getMemoryDomain());
+
+    EXPECT_EQ(100, stats.getMemoryDomainUsed(MemoryDomain::Other));
+    EXPECT_EQ(20, stats.getMemoryDomainUsed(MemoryDomain::HashTable));
+    EXPECT_EQ(15, stats.getMemoryDomainUsed(MemoryDomain::Blob));
+    EXPECT_EQ(0, stats.getMemoryDomainUsed(MemoryDomain::Checkpoint));
+
+    int64_t total = 0;
+    for (size_t ii = 0; ii < size_t(MemoryDomain::Count); ++ii) {
+        EXPECT_NO_THROW(to_string(MemoryDomain(ii)));
+        total += stats.getMemoryDomainUsed(MemoryDomain(ii));
+    }
+    EXPECT_EQ(stats.getPreciseTotalMemoryUsed(), size_t(total));
+}
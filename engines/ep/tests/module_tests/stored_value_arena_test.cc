@@ -0,0 +1,164 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the StoredValueArena class.
+ */
+
+#include "hash_table.h"
+#include "stats.h"
+#include "stored_value_arena.h"
+#include "stored_value_factories.h"
+#include "tests/module_tests/test_helpers.h"
+
+#include <folly/portability/GTest.h>
+
+#include <cstring>
+#include <set>
+
+TEST(StoredValueArenaTest, AllocateDeallocate) {
+    StoredValueArena arena;
+    EXPECT_EQ(0, arena.getNumSlabs());
+
+    std::vector<void*> objects;
+    for (size_t size = 1; size <= StoredValueArena::MaxObjectSize; ++size) {
+        auto* ptr = arena.allocate(size);
+        ASSERT_TRUE(ptr);
+        // Objects must be usable for their full size, and suitably aligned.
+        std::memset(ptr, 0xff, size);
+        EXPECT_EQ(0,
+                  reinterpret_cast<uintptr_t>(ptr) %
+                          StoredValueArena::SizeClassGranularity);
+        objects.push_back(ptr);
+    }
+    EXPECT_EQ(StoredValueArena::MaxObjectSize, arena.getNumObjects());
+    EXPECT_EQ(StoredValueArena::MaxObjectSize /
+                      StoredValueArena::SizeClassGranularity,
+              arena.getNumSlabs());
+
+    // No two allocations may be the same.
+    EXPECT_EQ(objects.size(),
+              std::set<void*>(objects.begin(), objects.end()).size());
+
+    for (auto* ptr : objects) {
+        StoredValueArena::deallocate(ptr);
+    }
+    EXPECT_EQ(0, arena.getNumObjects());
+}
+
+TEST(StoredValueArenaTest, TooLarge) {
+    StoredValueArena arena;
+    EXPECT_FALSE(arena.allocate(StoredValueArena::MaxObjectSize + 1));
+    EXPECT_EQ(0, arena.getNumSlabs());
+}
+
+// Check that slabs are returned once all their objects have been freed, and
+// that sparse slabs are reported as fragmented.
+TEST(StoredValueArenaTest, SlabsReleased) {
+    StoredValueArena arena;
+    const size_t size = 64;
+    std::vector<void*> objects;
+    while (arena.getNumSlabs() < 3) {
+        objects.push_back(arena.allocate(size));
+    }
+    // Last object is the first of the third (current) slab.
+    auto* last = objects.back();
+    objects.pop_back();
+
+    // Free three quarters of the objects of the first two slabs, leaving
+    // them sparse.
+    std::vector<void*> remaining;
+    for (size_t ii = 0; ii < objects.size(); ++ii) {
+        if (ii % 4 != 3) {
+            StoredValueArena::deallocate(objects[ii]);
+        } else {
+            remaining.push_back(objects[ii]);
+        }
+    }
+    EXPECT_EQ(3, arena.getNumSlabs());
+    EXPECT_FALSE(StoredValueArena::isFragmented(last));
+    for (auto* ptr : remaining) {
+        EXPECT_TRUE(StoredValueArena::isFragmented(ptr));
+    }
+
+    // Freeing the remainder releases the non-current slabs.
+    for (auto* ptr : remaining) {
+        StoredValueArena::deallocate(ptr);
+    }
+    EXPECT_EQ(1, arena.getNumSlabs());
+    StoredValueArena::deallocate(last);
+    EXPECT_EQ(0, arena.getNumObjects());
+}
+
+/**
+ * Test fixture for HashTables whose StoredValues come from an arena;
+ * type-parameterized over the StoredValue factories.
+ */
+template <typename Factory>
+class StoredValueArenaHashTableTest : public ::testing::Test {
+protected:
+    EPStats stats;
+};
+
+using ArenaFactories =
+        ::testing::Types<StoredValueFactory, OrderedStoredValueFactory>;
+TYPED_TEST_CASE(StoredValueArenaHashTableTest, ArenaFactories);
+
+TYPED_TEST(StoredValueArenaHashTableTest, StoreFindDelete) {
+    auto factory = std::make_unique<TypeParam>(this->stats, true);
+    const auto* arena = factory->getArena();
+    ASSERT_TRUE(arena);
+
+    HashTable ht(this->stats, std::move(factory), 47, 1);
+    std::vector<StoredDocKey> keys;
+    for (int ii = 0; ii < 1000; ++ii) {
+        keys.push_back(makeStoredDocKey("key" + std::to_string(ii)));
+    }
+    for (const auto& key : keys) {
+        auto item = make_item(Vbid(0), key, "value");
+        ASSERT_EQ(MutationStatus::WasClean, ht.set(item));
+    }
+    EXPECT_EQ(keys.size(), arena->getNumObjects());
+
+    for (const auto& key : keys) {
+        auto result = ht.findForWrite(key);
+        ASSERT_TRUE(result.storedValue);
+        EXPECT_TRUE(result.storedValue->isArenaAllocated());
+        EXPECT_EQ(key, StoredDocKey(result.storedValue->getKey()));
+
+        // Copies are also arena allocated.
+        auto copy = ht.unlocked_replaceByCopy(result.lock,
+                                              *result.storedValue);
+        EXPECT_TRUE(copy.first->isArenaAllocated());
+    }
+    EXPECT_EQ(keys.size(), arena->getNumObjects());
+
+    for (const auto& key : keys) {
+        auto result = ht.findForWrite(key);
+        ht.unlocked_del(result.lock, key);
+    }
+    EXPECT_EQ(0, arena->getNumObjects());
+}
+
+TYPED_TEST(StoredValueArenaHashTableTest, ArenaDisabled) {
+    TypeParam factory(this->stats);
+    EXPECT_FALSE(factory.getArena());
+
+    auto item = make_item(Vbid(0), makeStoredDocKey("key"), "value");
+    auto sv = factory(item, {});
+    EXPECT_FALSE(sv->isArenaAllocated());
+}
@@ -23,6 +23,7 @@
 #include "hash_table.h"
 #include "item.h"
 #include "item_eviction.h"
+#include "key_prefix_dictionary.h"
 #include "stats.h"
 #include "stored_value_factories.h"
 #include "tests/module_tests/test_helpers.h"
@@ -500,3 +501,200 @@ TYPED_TEST(StoredValueProtectedTest, MB_32835) {
 
     EXPECT_EQ(this->sv, sv2);
 }
+
+/**
+ * Test fixture for (Ordered)StoredValues created with inline values.
+ */
+template <typename Factory>
+class InlineValueTest : public ::testing::Test {
+public:
+    InlineValueTest()
+        : factory(stats, /*useArena*/ false, /*useInlineValues*/ true) {
+    }
+
+protected:
+    StoredValue::UniquePtr makeStoredValue(const std::string& value) {
+        return factory(make_item(Vbid(0), makeStoredDocKey("key"), value),
+                       {});
+    }
+
+    /// @return true if the value of sv is in sv's own allocation
+    static bool isValueInline(StoredValue& sv) {
+        const auto* blob = reinterpret_cast<const char*>(
+                sv.getValue().get().get());
+        const auto* start = reinterpret_cast<const char*>(&sv);
+        const auto size = StoredValue::getInlineValueStorage(
+                sv.getObjectSize(), sv.getInlineValueCapacity());
+        return sv.getValue()->isInline() && blob > start &&
+               blob < start + size;
+    }
+
+    EPStats stats;
+    Factory factory;
+};
+
+TYPED_TEST_CASE(InlineValueTest, ValueFactories);
+
+TYPED_TEST(InlineValueTest, SmallValueIsInline) {
+    auto sv = this->makeStoredValue("value");
+    EXPECT_EQ(StoredValue::InlineValueGranularity,
+              sv->getInlineValueCapacity());
+    ASSERT_TRUE(this->isValueInline(*sv));
+    EXPECT_EQ("value", sv->getValue()->to_s());
+    EXPECT_EQ(5, sv->valuelen());
+}
+
+TYPED_TEST(InlineValueTest, LargeValueIsNotInline) {
+    auto sv = this->makeStoredValue(
+            std::string(StoredValue::MaxInlineValueSize + 1, 'x'));
+    EXPECT_EQ(0, sv->getInlineValueCapacity());
+    EXPECT_FALSE(sv->getValue()->isInline());
+}
+
+// Updates which fit reuse the inline value, others are stored separately
+TYPED_TEST(InlineValueTest, SetValueReusesInlineValue) {
+    auto sv = this->makeStoredValue("1");
+    sv->setFreqCounterValue(100);
+    const auto* inlineValue = sv->getValue().get().get();
+
+    sv->setValue(make_item(Vbid(0), makeStoredDocKey("key"), "12345678"));
+    EXPECT_EQ(inlineValue, sv->getValue().get().get());
+    EXPECT_EQ("12345678", sv->getValue()->to_s());
+    EXPECT_EQ(100, sv->getFreqCounterValue());
+
+    sv->setValue(make_item(Vbid(0), makeStoredDocKey("key"), "123456789"));
+    EXPECT_FALSE(sv->getValue()->isInline());
+    EXPECT_EQ("123456789", sv->getValue()->to_s());
+    EXPECT_EQ(100, sv->getFreqCounterValue());
+
+    sv->setValue(make_item(Vbid(0), makeStoredDocKey("key"), "2"));
+    EXPECT_EQ(inlineValue, sv->getValue().get().get());
+    EXPECT_EQ("2", sv->getValue()->to_s());
+}
+
+// An Item sharing the inline value keeps it (and its StoredValue's storage)
+// valid after the StoredValue is updated and freed.
+TYPED_TEST(InlineValueTest, SharedInlineValueOutlivesStoredValue) {
+    auto sv = this->makeStoredValue("value");
+    auto item = sv->toItem(Vbid(0));
+    ASSERT_EQ(sv->getValue().get().get(), item->getValue().get().get());
+
+    // Can't reuse the inline value while the Item shares it.
+    sv->setValue(make_item(Vbid(0), makeStoredDocKey("key"), "other"));
+    EXPECT_FALSE(sv->getValue()->isInline());
+    EXPECT_EQ("other", sv->getValue()->to_s());
+
+    sv.reset();
+    EXPECT_TRUE(item->getValue()->isInline());
+    EXPECT_EQ("value", item->getValue()->to_s());
+}
+
+TYPED_TEST(InlineValueTest, CopyStoredValue) {
+    auto sv = this->makeStoredValue("value");
+    auto copy = this->factory.copyStoredValue(*sv, {});
+    ASSERT_TRUE(this->isValueInline(*copy));
+    EXPECT_NE(sv->getValue().get().get(), copy->getValue().get().get());
+    EXPECT_EQ("value", copy->getValue()->to_s());
+}
+
+/**
+ * Test fixture for (Ordered)StoredValues created with key prefixes.
+ */
+template <typename Factory>
+class KeyPrefixTest : public ::testing::Test {
+public:
+    KeyPrefixTest()
+        : factory(stats,
+                  /*useArena*/ false,
+                  /*useInlineValues*/ false,
+                  /*useKeyPrefixes*/ true) {
+    }
+
+protected:
+    StoredValue::UniquePtr makeStoredValue(const StoredDocKey& key) {
+        return factory(make_item(Vbid(0), key, "value"), {});
+    }
+
+    EPStats stats;
+    Factory factory;
+};
+
+TYPED_TEST_CASE(KeyPrefixTest, ValueFactories);
+
+TYPED_TEST(KeyPrefixTest, PrefixedKey) {
+    const auto key = makeStoredDocKey("user::1234");
+    auto sv = this->makeStoredValue(key);
+    ASSERT_TRUE(sv->isKeyPrefixed());
+    EXPECT_EQ(key, StoredDocKey(sv->getKey()));
+    EXPECT_TRUE(sv->getKey() == key);
+    EXPECT_TRUE(sv->hasKey(key));
+    EXPECT_FALSE(sv->hasKey(makeStoredDocKey("user::1235")));
+    EXPECT_FALSE(sv->hasKey(makeStoredDocKey("session::1234")));
+    EXPECT_FALSE(sv->hasKey(makeStoredDocKey("user::12345")));
+
+    // The 7 byte prefix (collection-ID and "user::") is replaced by its ID.
+    EXPECT_EQ(TypeParam::value_type::getRequiredStorage(key) - 5,
+              sv->getObjectSize());
+}
+
+TYPED_TEST(KeyPrefixTest, KeyWithoutPrefix) {
+    for (const auto* k : {"user1234", "a:1234", "a_very_long_key_without_a_"
+                                                 "separator_early_on:1234"}) {
+        const auto key = makeStoredDocKey(k);
+        auto sv = this->makeStoredValue(key);
+        EXPECT_FALSE(sv->isKeyPrefixed()) << k;
+        EXPECT_EQ(key, StoredDocKey(sv->getKey()));
+        EXPECT_TRUE(sv->hasKey(key));
+        EXPECT_EQ(TypeParam::value_type::getRequiredStorage(key),
+                  sv->getObjectSize());
+    }
+}
+
+TYPED_TEST(KeyPrefixTest, CopyStoredValue) {
+    const auto key = makeStoredDocKey("user::1234");
+    auto sv = this->makeStoredValue(key);
+    auto copy = this->factory.copyStoredValue(*sv, {});
+    ASSERT_TRUE(copy->isKeyPrefixed());
+    EXPECT_EQ(sv->getObjectSize(), copy->getObjectSize());
+    EXPECT_EQ(key, StoredDocKey(copy->getKey()));
+    EXPECT_TRUE(copy->hasKey(key));
+}
+
+TYPED_TEST(KeyPrefixTest, ToItem) {
+    const auto key = makeStoredDocKey("user::1234");
+    auto sv = this->makeStoredValue(key);
+    auto item = sv->toItem(Vbid(0));
+    EXPECT_EQ(key, item->getKey());
+}
+
+TEST(KeyPrefixDictionaryTest, PrefixLength) {
+    // Includes the 1 byte collection-ID of the default collection.
+    EXPECT_EQ(7, KeyPrefixDictionary::getPrefixLength(
+                         makeStoredDocKey("user::1234")));
+    EXPECT_EQ(5, KeyPrefixDictionary::getPrefixLength(
+                         makeStoredDocKey("abc:1234")));
+    EXPECT_EQ(0, KeyPrefixDictionary::getPrefixLength(
+                         makeStoredDocKey("a:1234")));
+    EXPECT_EQ(0, KeyPrefixDictionary::getPrefixLength(
+                         makeStoredDocKey("user1234")));
+    EXPECT_EQ(0, KeyPrefixDictionary::getPrefixLength(
+                         makeStoredDocKey(std::string(40, 'a') + ":1234")));
+    EXPECT_EQ(0, KeyPrefixDictionary::getPrefixLength(
+                         DocKey("user::1234", DocKeyEncodesCollectionId::No)));
+}
+
+TEST(KeyPrefixDictionaryTest, Intern) {
+    auto& dictionary = KeyPrefixDictionary::get();
+    const auto id = dictionary.intern(makeStoredDocKey("prefix::1"));
+    ASSERT_NE(0, id);
+    EXPECT_EQ(id, dictionary.intern(makeStoredDocKey("prefix::2")));
+    EXPECT_NE(id, dictionary.intern(makeStoredDocKey("other::1")));
+    EXPECT_EQ(0, dictionary.intern(makeStoredDocKey("none")));
+
+    const auto key = makeStoredDocKey("prefix::");
+    const auto prefix = dictionary.getPrefix(id);
+    EXPECT_EQ(std::string(reinterpret_cast<const char*>(key.data()),
+                          key.size()),
+              std::string(reinterpret_cast<const char*>(prefix.data()),
+                          prefix.size()));
+}
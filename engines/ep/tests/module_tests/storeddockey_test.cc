@@ -88,6 +88,24 @@ TEST(StoredDocKey, no_encoded_collectionId) {
     EXPECT_EQ(0, key3.getCollectionID());
 }
 
+TEST(SerialisedDocKey, equals_no_encoded_collectionId) {
+    // A SerialisedDocKey always stores the collection prefix; it must still
+    // compare equal to a DocKey which has no encoded collection (i.e. the
+    // default collection), and unequal to one with a different key.
+    uint8_t keyRaw[4] = {'k', 'e', 'y', '!'};
+    DocKey docKey(keyRaw, 4, DocKeyEncodesCollectionId::No);
+    auto serialKey = SerialisedDocKey::make(StoredDocKey(docKey));
+    EXPECT_EQ(*serialKey, docKey);
+
+    uint8_t otherRaw[4] = {'k', 'e', 'y', '?'};
+    DocKey otherKey(otherRaw, 4, DocKeyEncodesCollectionId::No);
+    EXPECT_NE(*serialKey, otherKey);
+
+    // A non-default collection never matches a key without a prefix.
+    auto serialKey100 = SerialisedDocKey::make({"key!", CollectionID(100)});
+    EXPECT_NE(*serialKey100, docKey);
+}
+
 TEST_P(StoredDocKeyTest, copy_constructor) {
     StoredDocKey key1("key1", GetParam());
     StoredDocKey key2(key1);
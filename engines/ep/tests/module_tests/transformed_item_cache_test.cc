@@ -0,0 +1,94 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Unit tests for the TransformedItemCache class.
+ */
+
+#include "dcp/transformed_item_cache.h"
+#include "stats.h"
+#include "tests/module_tests/test_helpers.h"
+
+#include <folly/portability/GTest.h>
+
+class TransformedItemCacheTest : public ::testing::Test {
+protected:
+    queued_item makeItem(int64_t seqno, uint64_t cas) {
+        queued_item item(new Item(make_item(
+                Vbid(0), makeStoredDocKey("key" + std::to_string(seqno)),
+                "value")));
+        item->setBySeqno(seqno);
+        item->setCas(cas);
+        return item;
+    }
+
+    EPStats stats;
+    const TransformedItemCache::Features compressed{
+            IncludeValue::Yes,
+            IncludeXattrs::No,
+            SnappyEnabled::Yes,
+            ForceValueCompression::Yes};
+    const TransformedItemCache::Features keyOnly{IncludeValue::No,
+                                                 IncludeXattrs::No,
+                                                 SnappyEnabled::No,
+                                                 ForceValueCompression::No};
+};
+
+TEST_F(TransformedItemCacheTest, FindInserted) {
+    TransformedItemCache cache(16, stats);
+    auto original = makeItem(1, 100);
+    EXPECT_FALSE(cache.find(*original, compressed));
+    EXPECT_EQ(1, stats.dcpTransformedItemCacheMisses);
+
+    auto transformed = makeItem(1, 100);
+    cache.insert(*original, compressed, transformed);
+    EXPECT_EQ(transformed.get(), cache.find(*original, compressed).get());
+    EXPECT_EQ(1, stats.dcpTransformedItemCacheHits);
+
+    // A different feature set needs its own transformation.
+    EXPECT_FALSE(cache.find(*original, keyOnly));
+    EXPECT_EQ(2, stats.dcpTransformedItemCacheMisses);
+}
+
+// A different revision with the same seqno (e.g. after a rollback) must not
+// match.
+TEST_F(TransformedItemCacheTest, CasMismatch) {
+    TransformedItemCache cache(16, stats);
+    auto original = makeItem(1, 100);
+    cache.insert(*original, compressed, makeItem(1, 100));
+    EXPECT_FALSE(cache.find(*makeItem(1, 101), compressed));
+}
+
+TEST_F(TransformedItemCacheTest, Bounded) {
+    const size_t slots = 4;
+    TransformedItemCache cache(slots, stats);
+    for (int64_t seqno = 1; seqno <= 100; ++seqno) {
+        auto original = makeItem(seqno, 100);
+        cache.insert(*original, compressed, makeItem(seqno, 100));
+    }
+    EXPECT_EQ(slots, cache.getNumSlots());
+
+    // Only the most recent items are still cached.
+    for (int64_t seqno = 97; seqno <= 100; ++seqno) {
+        EXPECT_TRUE(cache.find(*makeItem(seqno, 100), compressed));
+    }
+    EXPECT_FALSE(cache.find(*makeItem(1, 100), compressed));
+}
+
+TEST_F(TransformedItemCacheTest, ZeroSlotsInvalid) {
+    EXPECT_THROW(TransformedItemCache(0, stats), std::invalid_argument);
+}
@@ -0,0 +1,99 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "value_spill_cache.h"
+#include "stats.h"
+
+#include <folly/portability/GTest.h>
+#include <platform/dirutils.h>
+
+class ValueSpillCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path = cb::io::mktemp("value_spill_cache_test");
+    }
+
+    void TearDown() override {
+        if (cb::io::isFile(path)) {
+            cb::io::rmrf(path);
+        }
+    }
+
+    static std::string toString(const value_t& value) {
+        return {value->getData(), value->valueSize()};
+    }
+
+    EPStats stats;
+    std::string path;
+    const Vbid vbid{0};
+};
+
+TEST_F(ValueSpillCacheTest, RoundTrip) {
+    ValueSpillCache cache(stats, path, 4096);
+    const std::string value = "a spilled value";
+    ASSERT_TRUE(cache.spill(vbid, 10, 1234, value));
+    EXPECT_EQ(1, stats.spillCacheWrites);
+
+    auto fetched = cache.fetch(vbid, 10, 1234);
+    ASSERT_TRUE(fetched);
+    EXPECT_EQ(value, toString(fetched));
+    EXPECT_EQ(1, stats.spillCacheHits);
+    EXPECT_EQ(0, stats.spillCacheMisses);
+}
+
+// Only the exact revision which was spilled is returned.
+TEST_F(ValueSpillCacheTest, OtherRevisionMisses) {
+    ValueSpillCache cache(stats, path, 4096);
+    ASSERT_TRUE(cache.spill(vbid, 10, 1234, "value"));
+
+    EXPECT_FALSE(cache.fetch(vbid, 10, 1235));
+    EXPECT_FALSE(cache.fetch(vbid, 11, 1234));
+    EXPECT_FALSE(cache.fetch(Vbid(1), 10, 1234));
+    EXPECT_EQ(3, stats.spillCacheMisses);
+    EXPECT_EQ(0, stats.spillCacheHits);
+}
+
+// Once the log wraps, the oldest records are gone; the most recent ones are
+// still there.
+TEST_F(ValueSpillCacheTest, OverwrittenWhenLogWraps) {
+    ValueSpillCache cache(stats, path, 4096);
+    const std::string value(100, 'x');
+    const int64_t numRecords = 100;
+    for (int64_t seqno = 1; seqno <= numRecords; ++seqno) {
+        ASSERT_TRUE(cache.spill(vbid, seqno, seqno, value));
+    }
+
+    EXPECT_FALSE(cache.fetch(vbid, 1, 1));
+    auto fetched = cache.fetch(vbid, numRecords, numRecords);
+    ASSERT_TRUE(fetched);
+    EXPECT_EQ(value, toString(fetched));
+}
+
+TEST_F(ValueSpillCacheTest, TooLargeRejected) {
+    ValueSpillCache cache(stats, path, 4096);
+    EXPECT_FALSE(cache.spill(vbid, 1, 1, std::string(4096, 'x')));
+    EXPECT_EQ(0, stats.spillCacheWrites);
+    EXPECT_FALSE(cache.fetch(vbid, 1, 1));
+}
+
+TEST_F(ValueSpillCacheTest, FileRemovedOnDestruction) {
+    {
+        ValueSpillCache cache(stats, path, 4096);
+        EXPECT_TRUE(cb::io::isFile(path));
+    }
+    EXPECT_FALSE(cb::io::isFile(path));
+}
@@ -537,6 +537,84 @@ TEST_P(VBucketDurabilityTest, NonPendingKeyAtAbort) {
                              vbucket->lockCollections(nonPendingKey)));
 }
 
+// The DurabilityTimeoutTask is told when each vBucket has a SyncWrite to
+// time out.
+TEST_P(VBucketDurabilityTest, SyncWriteTimeoutScheduled) {
+    std::vector<std::chrono::steady_clock::time_point> scheduled;
+    vbucket->setSyncWriteTimeoutCallback(
+            [this, &scheduled](Vbid vbid,
+                               std::chrono::steady_clock::time_point expiry) {
+                EXPECT_EQ(vbucket->getId(), vbid);
+                scheduled.push_back(expiry);
+            });
+
+    ckptMgr->createSnapshot(1, 1);
+    using namespace cb::durability;
+    auto item = makePendingItem(makeStoredDocKey("key"),
+                                "value",
+                                Requirements{Level::Majority, Timeout(10000)});
+    item->setBySeqno(1);
+    VBQueueItemCtx ctx;
+    ctx.genBySeqno = GenerateBySeqno::No;
+    ctx.durability = DurabilityItemCtx{item->getDurabilityReqs(), cookie};
+    ASSERT_EQ(MutationStatus::WasClean,
+              public_processSet(*item, 0 /*cas*/, ctx));
+    ASSERT_EQ(1, scheduled.size());
+    const auto expiry = scheduled.back();
+
+    // Not expired yet: still due a check at its expiry-time.
+    vbucket->processDurabilityTimeout(expiry - std::chrono::milliseconds(1));
+    ASSERT_EQ(2, scheduled.size());
+    EXPECT_EQ(expiry, scheduled.back());
+
+    // Expired: nothing left to time out.
+    vbucket->processDurabilityTimeout(expiry + std::chrono::milliseconds(1));
+    EXPECT_EQ(0,
+              VBucketTestIntrospector::public_getActiveDM(*vbucket)
+                      .getNumTracked());
+    EXPECT_EQ(2, scheduled.size());
+}
+
+TEST_P(VBucketDurabilityTest, HasTrackedSyncWrites) {
+    EXPECT_FALSE(vbucket->hasTrackedSyncWrites());
+    storeSyncWrites({1});
+    EXPECT_TRUE(vbucket->hasTrackedSyncWrites());
+
+    // Replica and active seqno-ack: the SyncWrite is committed
+    vbucket->seqnoAcknowledged(replica1, 1);
+    simulateLocalAck(1);
+    EXPECT_FALSE(vbucket->hasTrackedSyncWrites());
+}
+
+// A batch of commits is applied in order, and stops at the first failure.
+TEST_P(VBucketDurabilityTest, CommitBatch) {
+    storeSyncWrites({1, 2, 3});
+    ckptMgr->clear(*vbucket, ckptMgr->getHighSeqno());
+
+    const auto key1 = makeStoredDocKey("key1");
+    const auto key2 = makeStoredDocKey("key2");
+    const auto key3 = makeStoredDocKey("key3");
+    const auto noentKey = makeStoredDocKey("non-existing-key");
+    EXPECT_EQ(ENGINE_KEY_ENOENT,
+              vbucket->commitBatch({{key1, nullptr},
+                                    {key2, nullptr},
+                                    {noentKey, nullptr},
+                                    {key3, nullptr}}));
+
+    for (const auto& key : {key1, key2}) {
+        const auto* sv = ht->findForRead(key).storedValue;
+        ASSERT_TRUE(sv);
+        EXPECT_EQ(CommittedState::CommittedViaPrepare, sv->getCommitted());
+    }
+    EXPECT_FALSE(ht->findForRead(key3).storedValue);
+    const auto* sv = ht->findForWrite(key3).storedValue;
+    ASSERT_TRUE(sv);
+    EXPECT_EQ(CommittedState::Pending, sv->getCommitted());
+
+    // Only the two successful commits were queued.
+    EXPECT_EQ(2, ckptMgr->getNumOpenChkItems());
+}
+
 /*
  * This test checks that at abort:
  * 1) the Pending is removed from the HashTable
@@ -546,6 +546,11 @@ public:
         return real_engine->reset_stats(cookie);
     }
 
+    ENGINE_ERROR_CODE get_metrics(gsl::not_null<const void*> cookie,
+                                  cb::metrics::Collector& collector) override {
+        return real_engine->get_metrics(cookie, collector);
+    }
+
     /* Handle 'unknown_command'. In additional to wrapping calls to the
      * underlying real engine, this is also used to configure
      * ewouldblock_engine itself using he CMD_EWOULDBLOCK_CTL opcode.
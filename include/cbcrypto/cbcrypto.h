@@ -20,6 +20,7 @@
 #include <nlohmann/json_fwd.hpp>
 #include <platform/sized_buffer.h>
 #include <cstdint>
+#include <memory>
 #include <string>
 
 namespace cb {
@@ -61,7 +62,7 @@ std::string PBKDF2_HMAC(Algorithm algorithm,
  */
 std::string digest(Algorithm algorithm, cb::const_char_buffer data);
 
-enum class Cipher { AES_256_cbc };
+enum class Cipher { AES_256_cbc, AES_256_ctr };
 
 Cipher to_cipher(const std::string& str);
 
@@ -125,5 +126,62 @@ std::string decrypt(Cipher cipher,
  */
 std::string decrypt(const nlohmann::json& json, cb::const_char_buffer data);
 
+/**
+ * Encrypts (or decrypts) a stream, such as a file, in place and in blocks
+ * of any size and at any offset of the stream, without the copies and
+ * allocations of encrypt() and decrypt().
+ *
+ * Only AES_256_ctr is supported, for which encryption and decryption are
+ * the same operation: the data is XORed with the keystream at its offset
+ * in the stream. The IV is the counter of the stream's first 16 byte
+ * block, so the same key and IV must never be used for two streams (or
+ * to write different data at the same offset of one).
+ *
+ * The cipher's context and key schedule are set up once, by the
+ * constructor. process() then uses the CPU's AES instructions (through
+ * OpenSSL) where available, and doesn't allocate.
+ *
+ * Not thread safe.
+ */
+class StreamCipher {
+public:
+    /**
+     * @param cipher The cipher to use (AES_256_ctr)
+     * @param key The key (32 bytes)
+     * @param iv The IV (16 bytes)
+     * @throws std::invalid_argument for an unsupported cipher, or a key or
+     *         iv of the wrong size
+     */
+    StreamCipher(Cipher cipher,
+                 cb::const_char_buffer key,
+                 cb::const_char_buffer iv);
+
+    ~StreamCipher();
+
+    StreamCipher(const StreamCipher&) = delete;
+    StreamCipher& operator=(const StreamCipher&) = delete;
+
+    /**
+     * Encrypt or decrypt the given bytes of the stream.
+     *
+     * @param offset the offset in the stream of the first byte of in
+     * @param in the bytes to encrypt or decrypt
+     * @param out where to write the result; at least in.size() bytes, and
+     *        may be in itself
+     */
+    void process(uint64_t offset,
+                 cb::const_char_buffer in,
+                 cb::char_buffer out);
+
+    /// Encrypt or decrypt the given bytes of the stream in place
+    void process(uint64_t offset, cb::char_buffer data) {
+        process(offset, {data.data(), data.size()}, data);
+    }
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
 } // namespace crypto
 } // namespace cb
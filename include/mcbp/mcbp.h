@@ -158,6 +158,37 @@ nlohmann::json to_json();
  */
 std::chrono::nanoseconds getSlowOpThreshold(const nlohmann::json& doc);
 
+/**
+ * The adaptive slow operation detection, configured by the optional
+ * "adaptive" entry of the SLA configuration:
+ *
+ *     "adaptive": {
+ *       "enabled": true,
+ *       "percentile": 99.9,
+ *       "factor": 2,
+ *       "minimum": "10 ms",
+ *       "log_limit": 10
+ *     }
+ *
+ * (all of its members are optional). When enabled, an operation is also
+ * reported as slow if it took longer than factor times the given
+ * percentile of its opcode's recent durations (but at least minimum), and
+ * no more than log_limit slow operations are logged per second.
+ */
+struct AdaptiveConfig {
+    bool enabled = false;
+    double percentile = 99.9;
+    double factor = 2.0;
+    std::chrono::nanoseconds minimum = std::chrono::milliseconds(10);
+    /// The most slow operations logged per second; 0 for no limit
+    size_t logLimit = 10;
+};
+
+/**
+ * Get the current adaptive slow operation configuration.
+ */
+AdaptiveConfig getAdaptiveConfig();
+
 } // namespace sla
 }
 }
@@ -260,6 +260,21 @@ enum class ClientOpcode : uint8_t {
      */
     CollectionsGetScopeID = 0xbc,
 
+    /**
+     * Command to read a page of the documents of a key range (in key order)
+     */
+    RangeScan = 0xbd,
+
+    /**
+     * Command to store a batch of documents in a vbucket
+     */
+    BulkStore = 0xbe,
+
+    /**
+     * Command to sample a number of random keys
+     */
+    GetRandomKeys = 0xbf,
+
     /**
      * Commands for GO-XDCR
      */
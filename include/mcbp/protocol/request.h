@@ -212,6 +212,15 @@ public:
     boost::optional<cb::durability::Requirements> getDurabilityRequirements()
             const;
 
+    /**
+     * May this command be reordered with other commands?
+     *
+     * @return true if the client allows this command to be reordered (it
+     *              carries the Reorder frame info) and the server supports
+     *              reordering of this command type
+     */
+    bool isReorderable() const;
+
     /**
      * May this command be reordered with the next command?
      *
@@ -12,6 +12,7 @@
 #include <string>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include <boost/optional/optional_fwd.hpp>
 #include <gsl/gsl>
@@ -37,6 +38,12 @@ class Request;
 }
 } // namespace cb
 
+namespace cb {
+namespace metrics {
+class Collector;
+}
+} // namespace cb
+
 /*! \mainpage memcached public API
  *
  * \section intro_sec Introduction
@@ -128,6 +135,17 @@ struct EngineErrorCasPair {
     engine_errc status;
     uint64_t cas;
 };
+
+/// The result of EngineIface::arithmetic()
+struct EngineErrorArithmeticResult {
+    engine_errc status;
+    /// The value of the counter after the operation
+    uint64_t value;
+    /// The CAS, vbucket UUID and sequence number of the updated document
+    uint64_t cas;
+    uint64_t vbucket_uuid;
+    uint64_t seqno;
+};
 } // namespace cb
 
 /**
@@ -353,6 +371,34 @@ struct MEMCACHED_PUBLIC_CLASS EngineIface {
             const DocKey& key,
             Vbid vbucket) = 0;
 
+    /**
+     * Retrieve the metadata of a batch of items from one vbucket (see
+     * get_meta()).
+     *
+     * Optional interface: the default implementation calls get_meta() for
+     * each key. Engines may implement it to share the per-call work between
+     * the keys - for example reading the metadata of all of the keys missing
+     * from memory in a single disk fetch.
+     *
+     * @param cookie The cookie provided by the frontend
+     * @param keys the keys to look up
+     * @param vbucket the virtual bucket id
+     * @return one result per key, in the order of keys. A key's result may
+     *         be ENGINE_EWOULDBLOCK (the engine notifies the cookie once it
+     *         may be retried), independently of the other keys
+     */
+    virtual std::vector<cb::EngineErrorMetadataPair> get_meta_multi(
+            gsl::not_null<const void*> cookie,
+            const std::vector<DocKey>& keys,
+            Vbid vbucket) {
+        std::vector<cb::EngineErrorMetadataPair> ret;
+        ret.reserve(keys.size());
+        for (const auto& key : keys) {
+            ret.emplace_back(get_meta(cookie, key, vbucket));
+        }
+        return ret;
+    }
+
     /**
      * Lock and Retrieve an item.
      *
@@ -470,6 +516,149 @@ struct MEMCACHED_PUBLIC_CLASS EngineIface {
         return {cb::engine_errc::not_supported, 0};
     }
 
+    /**
+     * Increment or decrement the (ASCII decimal) counter held by an
+     * existing document in place, atomically with any other update of the
+     * document - so concurrent updates of a hot counter don't need to retry
+     * a get and a CAS store until one of them wins.
+     *
+     * Optional interface; not supported by all engines. An engine may also
+     * return not_supported for a document it doesn't update in place (for
+     * example one which doesn't exist, isn't resident in memory or has
+     * extended attributes); the caller should then perform the operation
+     * with get() and store() instead.
+     *
+     * Incrementing wraps on overflow, decrementing stops at 0.
+     *
+     * @param cookie The cookie provided by the frontend
+     * @param key the key of the document holding the counter
+     * @param vbucket the virtual bucket id
+     * @param increment true to add delta to the counter, false to subtract
+     * @param delta the amount to change the counter by
+     * @param cas the CAS value the document must have (0 for any)
+     * @param durability An optional durability requirement
+     *
+     * @return the status and, if successful, the counter's new value and
+     *         the updated document's CAS, vbucket UUID and sequence number
+     */
+    virtual cb::EngineErrorArithmeticResult arithmetic(
+            gsl::not_null<const void*> cookie,
+            const DocKey& key,
+            Vbid vbucket,
+            bool increment,
+            uint64_t delta,
+            uint64_t cas,
+            const boost::optional<cb::durability::Requirements>& durability) {
+        return {cb::engine_errc::not_supported, 0, 0, 0, 0};
+    }
+
+    /**
+     * Append (or prepend) data to the value of an existing document in
+     * place, atomically with any other update of the document - without the
+     * caller reading the document, building the new value itself and
+     * retrying a CAS store until no other update raced with it.
+     *
+     * Optional interface; not supported by all engines. An engine may also
+     * return ENGINE_ENOTSUP for a document it doesn't update (for example
+     * one which doesn't exist, isn't resident in memory, is compressed or
+     * has extended attributes); the caller should then perform the
+     * operation with get() and store() instead.
+     *
+     * The document keeps its flags and expiry; its datatype is set to JSON
+     * if the new value is JSON, else raw.
+     *
+     * @param cookie The cookie provided by the frontend
+     * @param key the key of the document
+     * @param vbucket the virtual bucket id
+     * @param append true to append value to the document, false to prepend
+     * @param value the (uncompressed) data to add
+     * @param cas The CAS value the document must have (or 0 as wildcard);
+     *            on success the document's new CAS
+     * @param durability An optional durability requirement
+     * @param mut_info On success the mutation details are written here
+     *
+     * @return ENGINE_SUCCESS if all goes well
+     */
+    virtual ENGINE_ERROR_CODE append_prepend(
+            gsl::not_null<const void*> cookie,
+            const DocKey& key,
+            Vbid vbucket,
+            bool append,
+            cb::const_char_buffer value,
+            uint64_t& cas,
+            const boost::optional<cb::durability::Requirements>& durability,
+            mutation_descr_t& mut_info) {
+        return ENGINE_ENOTSUP;
+    }
+
+    /**
+     * Retrieve a batch of items from one vbucket (see get()).
+     *
+     * Optional interface: the default implementation calls get() for each
+     * key. Engines may implement it to share the per-call work (looking up
+     * the vbucket, taking locks, updating stats) between the keys.
+     *
+     * @param cookie The cookie provided by the frontend
+     * @param keys the keys to look up
+     * @param vbucket the virtual bucket id
+     * @param documentStateFilter The documents to return must be in any of
+     *                            these states (see get())
+     * @return one result per key, in the order of keys. A key's result may
+     *         be ENGINE_EWOULDBLOCK (the engine notifies the cookie once it
+     *         may be retried), independently of the other keys
+     */
+    virtual std::vector<cb::EngineErrorItemPair> get_multi(
+            gsl::not_null<const void*> cookie,
+            const std::vector<DocKey>& keys,
+            Vbid vbucket,
+            DocStateFilter documentStateFilter) {
+        std::vector<cb::EngineErrorItemPair> ret;
+        ret.reserve(keys.size());
+        for (const auto& key : keys) {
+            ret.emplace_back(get(cookie, key, vbucket, documentStateFilter));
+        }
+        return ret;
+    }
+
+    /**
+     * Store a batch of items (see store()).
+     *
+     * Optional interface: the default implementation calls store() for each
+     * item. Engines may implement it to share the per-call work between the
+     * items.
+     *
+     * @param cookie The cookie provided by the frontend
+     * @param items the items to store, each with the CAS value for a
+     *              conditional store (0 for none)
+     * @param operation the type of store operation to perform
+     * @param durability An optional durability requirement (for all items)
+     * @param document_state The state the documents should have after
+     *                       the update
+     * @return one result per item, in the order of items: the status and,
+     *         if stored, the item's new CAS
+     */
+    virtual std::vector<cb::EngineErrorCasPair> store_multi(
+            gsl::not_null<const void*> cookie,
+            const std::vector<std::pair<gsl::not_null<item*>, uint64_t>>&
+                    items,
+            ENGINE_STORE_OPERATION operation,
+            const boost::optional<cb::durability::Requirements>& durability,
+            DocumentState document_state) {
+        std::vector<cb::EngineErrorCasPair> ret;
+        ret.reserve(items.size());
+        for (const auto& entry : items) {
+            uint64_t cas = entry.second;
+            const auto status = store(cookie,
+                                      entry.first,
+                                      cas,
+                                      operation,
+                                      durability,
+                                      document_state);
+            ret.push_back({cb::engine_errc(status), cas});
+        }
+        return ret;
+    }
+
     /**
      * Flush the cache.
      *
@@ -506,6 +695,21 @@ struct MEMCACHED_PUBLIC_CLASS EngineIface {
      */
     virtual void reset_stats(gsl::not_null<const void*> cookie) = 0;
 
+    /**
+     * Add the engine's metrics to the collector (as typed values, for
+     * "stats prometheus").
+     *
+     * Optional interface; not supported by all engines.
+     *
+     * @param cookie The cookie provided by the frontend
+     * @param collector the collector to add the metrics to
+     * @return ENGINE_SUCCESS if all goes well
+     */
+    virtual ENGINE_ERROR_CODE get_metrics(gsl::not_null<const void*> cookie,
+                                          cb::metrics::Collector& collector) {
+        return ENGINE_ENOTSUP;
+    }
+
     /**
      * Any unknown command will be considered engine specific.
      *
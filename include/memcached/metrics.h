@@ -0,0 +1,85 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include <platform/sized_buffer.h>
+
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+namespace cb {
+namespace metrics {
+
+/// A label of a metric, such as {"state", "active"}
+using Label = std::pair<cb::const_char_buffer, cb::const_char_buffer>;
+using Labels = std::initializer_list<Label>;
+
+/**
+ * How many series the collector wants: Low for those which are (roughly)
+ * per bucket, High to also include those per collection and scope.
+ */
+enum class Cardinality { Low, High };
+
+/**
+ * The buckets of a histogram, as needed to export it: the count of the
+ * values less than or equal to each upper bound (in increasing order), and
+ * the count and sum of all of the values.
+ */
+struct HistogramData {
+    std::vector<std::pair<double, uint64_t>> buckets;
+    uint64_t count = 0;
+    double sum = 0;
+};
+
+/**
+ * The interface the daemon and the engines add their metrics through, as
+ * typed values rather than the strings of an AddStatFn, so that they can be
+ * rendered (for instance in the Prometheus exposition format) without being
+ * formatted and parsed again.
+ *
+ * The series of a metric (the same name with different labels) must be added
+ * one after the other. The names are without the "kv_" prefix the renderer
+ * adds.
+ */
+class Collector {
+public:
+    virtual ~Collector() = default;
+
+    virtual Cardinality getCardinality() const = 0;
+
+    /// Add a value which only ever increases (until it is reset)
+    virtual void addCounter(cb::const_char_buffer name,
+                            cb::const_char_buffer help,
+                            Labels labels,
+                            uint64_t value) = 0;
+
+    /// Add a value which may go up and down
+    virtual void addGauge(cb::const_char_buffer name,
+                          cb::const_char_buffer help,
+                          Labels labels,
+                          double value) = 0;
+
+    virtual void addHistogram(cb::const_char_buffer name,
+                              cb::const_char_buffer help,
+                              Labels labels,
+                              const HistogramData& histogram) = 0;
+};
+
+} // namespace metrics
+} // namespace cb
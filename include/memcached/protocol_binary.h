@@ -1732,8 +1732,208 @@ protected:
     Vbid db_file_id = Vbid{0};
     uint32_t align_pad3 = 0;
 };
+
+/**
+ * Message format for CMD_RANGE_SCAN
+ *
+ * Reads (a page of) the documents of a vbucket with keys in a range, in key
+ * order.
+ *
+ * Request:
+ *
+ * Key:    The key to start the scan at (inclusive). With collections
+ *         enabled this is a collection-encoded key, and the scan is of that
+ *         collection.
+ * Value:  The (logical) key to stop the scan at (exclusive), or empty to
+ *         scan to the end of the collection.
+ * Extras:
+ * - max_items: Maximum number of documents to return in this page.
+ * - max_bytes: Approximate maximum size of the page (at least one document
+ *              is always returned).
+ * - flags:     RangeScanFlag::KeysOnly to return just the keys.
+ *
+ * Response:
+ *
+ * Key:   The continuation token; the key to pass as the start key of the
+ *        next request to read the next page. Empty if the scan is complete.
+ * Value: For each document, a 2 byte key length followed by the key and,
+ *        unless KeysOnly was requested, the 4 byte flags, 1 byte datatype,
+ *        4 byte value length and the value. All lengths are network order.
+ */
+enum class RangeScanFlag : uint8_t { KeysOnly = 0x1 };
+
+class RangeScanPayload {
+public:
+    uint32_t getMaxItems() const {
+        return ntohl(max_items);
+    }
+    void setMaxItems(uint32_t max_items) {
+        RangeScanPayload::max_items = htonl(max_items);
+    }
+    uint32_t getMaxBytes() const {
+        return ntohl(max_bytes);
+    }
+    void setMaxBytes(uint32_t max_bytes) {
+        RangeScanPayload::max_bytes = htonl(max_bytes);
+    }
+    bool isKeysOnly() const {
+        return (flags & uint8_t(RangeScanFlag::KeysOnly)) != 0;
+    }
+    uint8_t getFlags() const {
+        return flags;
+    }
+    void setFlags(uint8_t flags) {
+        RangeScanPayload::flags = flags;
+    }
+
+protected:
+    uint32_t max_items = 0;
+    uint32_t max_bytes = 0;
+    uint8_t flags = 0;
+};
+
+/**
+ * Message format for CMD_GET_RANDOM_KEYS
+ *
+ * Samples keys of the bucket at random, each as GET_RANDOM_KEY picks a
+ * document (with replacement, so a key may be returned more than once).
+ *
+ * Request:
+ *
+ * Key:    None
+ * Value:  None
+ * Extras:
+ * - count: The number of keys to sample (1 to MaxCount).
+ *
+ * Response:
+ *
+ * Value: For each key, a 2 byte key length (network order) followed by the
+ *        key. Fewer than count keys are returned only if the bucket has no
+ *        resident documents.
+ */
+class GetRandomKeysPayload {
+public:
+    static const uint32_t MaxCount = 1000;
+
+    uint32_t getCount() const {
+        return ntohl(count);
+    }
+    void setCount(uint32_t count) {
+        GetRandomKeysPayload::count = htonl(count);
+    }
+
+protected:
+    uint32_t count = 0;
+};
+
+/**
+ * Message format for CMD_BULK_STORE
+ *
+ * Stores (upserts) a batch of documents in the vbucket of the request. The
+ * documents are stored in order; if a document fails to store the command
+ * stops there, and the documents before it remain stored.
+ *
+ * Request:
+ *
+ * Key:    None
+ * Extras: None
+ * Value:  For each document, a 2 byte key length followed by the key, the
+ *         4 byte flags, 4 byte expiry, 1 byte datatype, 4 byte value length
+ *         and the value. All lengths are network order. With collections
+ *         enabled the keys are collection-encoded, and must all be of the
+ *         same collection.
+ *
+ * Response:
+ *
+ * Value: The 4 byte number of documents stored (network order). If a
+ *        document fails after others were stored the response has its
+ *        status and this value; if none were stored it has no value.
+ */
+struct BulkStoreDocument {
+    cb::const_byte_buffer key;
+    /// In network byte order, as the flags of a SET are stored
+    uint32_t flags = 0;
+    uint32_t expiry = 0;
+    uint8_t datatype = 0;
+    cb::const_byte_buffer value;
+};
+
+class BulkStoreParser {
+public:
+    explicit BulkStoreParser(cb::const_byte_buffer value) : value(value) {
+    }
+
+    /// @return true if the value is a sequence of complete documents
+    bool isValid() const {
+        size_t offset = 0;
+        while (offset < value.size()) {
+            const auto size = getDocumentSize(offset);
+            if (size == 0) {
+                return false;
+            }
+            offset += size;
+        }
+        return true;
+    }
+
+    /**
+     * Decode the next document of a (valid) value
+     *
+     * @param doc set to the next document, referencing the value
+     * @return false once all of the documents have been read
+     */
+    bool next(BulkStoreDocument& doc) {
+        if (offset >= value.size()) {
+            return false;
+        }
+        const auto* ptr = value.data() + offset;
+        const auto keylen = ntohs(*reinterpret_cast<const uint16_t*>(ptr));
+        ptr += sizeof(uint16_t);
+        doc.key = {ptr, keylen};
+        ptr += keylen;
+        doc.flags = *reinterpret_cast<const uint32_t*>(ptr);
+        ptr += sizeof(uint32_t);
+        doc.expiry = ntohl(*reinterpret_cast<const uint32_t*>(ptr));
+        ptr += sizeof(uint32_t);
+        doc.datatype = *ptr;
+        ptr += sizeof(uint8_t);
+        const auto vallen = ntohl(*reinterpret_cast<const uint32_t*>(ptr));
+        ptr += sizeof(uint32_t);
+        doc.value = {ptr, vallen};
+        offset = (ptr + vallen) - value.data();
+        return true;
+    }
+
+protected:
+    /// @return the size of the document at offset, or 0 if it is truncated
+    size_t getDocumentSize(size_t offset) const {
+        const size_t avail = value.size() - offset;
+        if (avail < sizeof(uint16_t)) {
+            return 0;
+        }
+        const size_t keylen = ntohs(
+                *reinterpret_cast<const uint16_t*>(value.data() + offset));
+        // key length, key, flags, expiry and datatype
+        const size_t header = sizeof(uint16_t) + keylen + 2 * sizeof(uint32_t) +
+                              sizeof(uint8_t);
+        if (avail < header + sizeof(uint32_t)) {
+            return 0;
+        }
+        const size_t vallen = ntohl(*reinterpret_cast<const uint32_t*>(
+                value.data() + offset + header));
+        if (avail - header - sizeof(uint32_t) < vallen) {
+            return 0;
+        }
+        return header + sizeof(uint32_t) + vallen;
+    }
+
+    cb::const_byte_buffer value;
+    size_t offset = 0;
+};
 #pragma pack()
 static_assert(sizeof(CompactDbPayload) == 24, "Unexpected struct size");
+static_assert(sizeof(RangeScanPayload) == 9, "Unexpected struct size");
+static_assert(sizeof(GetRandomKeysPayload) == 4, "Unexpected struct size");
 } // namespace request
 } // namespace mcbp
 } // namespace cb
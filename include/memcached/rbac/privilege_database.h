@@ -184,6 +184,12 @@ public:
      */
     PrivilegeAccess check(Privilege privilege) const;
 
+    /**
+     * Check if the privilege database has been reloaded since this context
+     * was created (in which case check() returns Stale for all privileges).
+     */
+    bool isStale() const;
+
     /**
      * Get the generation of the Privilege Database this context maps
      * to. If there is a mismatch with this number and the current number
@@ -47,6 +47,26 @@ typedef struct allocator_stats {
 
 } allocator_stats;
 
+/**
+ * How much of the slab (the run of same sized objects) holding an allocation
+ * is in use, compared to all of the slabs of its size class.
+ */
+typedef struct allocator_slab_utilization {
+    /* Number of free / total objects of the slab holding the allocation */
+    size_t nfree;
+    size_t nregs;
+
+    /* Size (bytes) of each of the slab's objects */
+    size_t size;
+
+    /* Number of free / total objects of all the slabs of the size class */
+    size_t bin_nfree;
+    size_t bin_nregs;
+
+    /* True if the slab is the one the size class allocates from next */
+    bool is_current;
+} allocator_slab_utilization;
+
 /**
  * Engine allocator hooks for memory tracking.
  */
@@ -128,6 +148,16 @@ struct ServerAllocatorIface {
      * @return whether the call was successful
      */
     bool (*get_allocator_property)(const char* name, size_t* value);
+
+    /**
+     * Gets the utilization of the slab which holds the given allocation.
+     * @param ptr an allocation (of a small size class)
+     * @param util destination for the utilization
+     * @return false if the allocator can't tell (for example the allocation
+     *         isn't in a slab)
+     */
+    bool (*get_slab_utilization)(const void* ptr,
+                                 allocator_slab_utilization* util);
 };
 
 #ifdef __cplusplus
@@ -195,7 +195,9 @@ public:
             const auto keylen = strlen(ptr);
             cb::const_char_buffer key{ptr, keylen};
             ptr += (keylen + 1);
-            cb::const_char_buffer value{ptr, strlen(ptr)};
+            // The kv-pair length is the zero terminated key and value
+            const auto valuelen = blob.read_length(current) - keylen - 2;
+            cb::const_char_buffer value{ptr, valuelen};
             return {key, value};
         }
 
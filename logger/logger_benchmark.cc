@@ -69,6 +69,40 @@ protected:
     }
 };
 
+/**
+ * A fixture for benchmarking the asynchronous logger (as used in
+ * production) without a file or console sink, so that the cost measured
+ * is that of formatting and queueing the message to the logger thread
+ * (and any contention on the queue). The argument selects the overflow
+ * policy: 0 blocks when the queue is full, 1 drops the oldest messages.
+ */
+class LoggerBench_Async : public benchmark::Fixture {
+protected:
+    void SetUp(const benchmark::State& state) override {
+        if (state.thread_index == 0) {
+            cb::logger::Config config{};
+            config.buffersize = 8192;
+            config.drop_on_overflow = state.range(0) != 0;
+            config.unit_test = false;
+            config.console = false;
+
+            auto init = cb::logger::initialize(config);
+            if (init) {
+                std::cerr << "Failed to initialize logger: " << *init;
+                return;
+            }
+
+            cb::logger::get()->set_level(spdlog::level::level_enum::trace);
+        }
+    }
+
+    void TearDown(const benchmark::State& state) override {
+        if (state.thread_index == 0) {
+            cb::logger::shutdown();
+        }
+    }
+};
+
 /**
  * Benchmark the cost of logging to a level which is dropped.
  * We're currently using the async logging (which is the one
@@ -99,6 +133,18 @@ BENCHMARK_DEFINE_F(LoggerBench, LogToLoggerWithEnabledLogLevel)
     }
 }
 
+/**
+ * Benchmark the latency (time per message) and throughput of logging to
+ * the asynchronous logger from multiple threads.
+ */
+BENCHMARK_DEFINE_F(LoggerBench_Async, LogToAsyncLogger)
+(benchmark::State& state) {
+    while (state.KeepRunning()) {
+        LOG_INFO("{}: Foo {}", state.thread_index, state.iterations());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
 /**
  * Benchmark the cost of grabbing the logger (which means checking
  * for it's existence and copy a shared pointer).
@@ -118,6 +164,14 @@ BENCHMARK_REGISTER_F(LoggerBench, LogToLoggerWithEnabledLogLevel)
         ->Threads(1)
         ->Threads(16);
 
+BENCHMARK_REGISTER_F(LoggerBench_Async, LogToAsyncLogger)
+        ->Arg(0)
+        ->Arg(1)
+        ->Threads(1)
+        ->Threads(4)
+        ->Threads(16)
+        ->UseRealTime();
+
 int main(int argc, char** argv) {
     ::benchmark::Initialize(&argc, argv);
     if (::benchmark::ReportUnrecognizedArguments(argc, argv)) {
@@ -25,6 +25,7 @@ namespace logger {
 Config::Config(const nlohmann::json& json) {
     filename = json.value("filename", filename);
     buffersize = json.value("buffersize", buffersize);
+    drop_on_overflow = json.value("drop_on_overflow", drop_on_overflow);
     cyclesize = json.value("cyclesize", cyclesize);
     unit_test = json.value("unit_test", unit_test);
     console = json.value("console", console);
@@ -33,6 +34,7 @@ Config::Config(const nlohmann::json& json) {
 bool Config::operator==(const Config& other) const {
     return (this->filename == other.filename) &&
            (this->buffersize == other.buffersize) &&
+           (this->drop_on_overflow == other.drop_on_overflow) &&
            (this->cyclesize == other.cyclesize) &&
            (this->unit_test == other.unit_test) &&
            (this->console == other.console);
@@ -38,6 +38,10 @@ struct LOGGER_PUBLIC_API Config {
     std::string filename;
     /// 8192 item size for the logging queue. This is equivalent to 2 MB
     size_t buffersize = 8192;
+    /// When the logging queue is full, should the oldest queued messages be
+    /// dropped to make room (rather than blocking the thread which is
+    /// logging until the sink catches up)
+    bool drop_on_overflow = false;
     /// 100 MB per cycled file
     size_t cyclesize = 100 * 1024 * 1024;
     /// if running in a unit test or not
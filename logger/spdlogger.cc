@@ -164,7 +164,9 @@ boost::optional<std::string> cb::logger::initialize(
                     logger_name,
                     sink,
                     tp,
-                    spdlog::async_overflow_policy::block);
+                    logger_settings.drop_on_overflow
+                            ? spdlog::async_overflow_policy::overrun_oldest
+                            : spdlog::async_overflow_policy::block);
         }
 
         file_logger->set_pattern(log_pattern);
@@ -0,0 +1,599 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * dcpbench - measure the DCP (replication) throughput of a running server.
+ *
+ * It opens a number of DCP producer connections to the bucket, spreads the
+ * active vbuckets over them and streams them (acting as the consumer, with
+ * the same flow control a replica uses) - either until everything stored
+ * has been received, or for a given duration while some other client keeps
+ * mutating the bucket. It then reports the items/s and bytes/s received,
+ * the replication lag (how far behind the high seqno of each vbucket the
+ * streams are) and the CPU time used by the server per item.
+ */
+
+#include <getopt.h>
+#include <mcbp/protocol/framebuilder.h>
+#include <memcached/protocol_binary.h>
+#include <nlohmann/json.hpp>
+#include <programs/getpass.h>
+#include <programs/hostname_utils.h>
+#include <protocol/connection/client_connection.h>
+#include <protocol/connection/client_mcbp_commands.h>
+#include <utilities/terminate_handler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+/// The options shared by all of the DCP connections
+struct Options {
+    std::string host{"localhost"};
+    std::string port{"11210"};
+    std::string user;
+    std::string password;
+    std::string bucket;
+    sa_family_t family = AF_UNSPEC;
+    bool secure = false;
+    size_t connections = 1;
+    uint32_t bufferSize = 10 * 1024 * 1024;
+    bool compression = false;
+    bool xattrs = false;
+    bool collections = false;
+    bool noValue = false;
+    /// Keep streaming (and don't end the streams) for this long
+    seconds follow{0};
+    bool json = false;
+};
+
+/// The highest seqno received on each vbucket
+static std::vector<std::atomic<uint64_t>> receivedSeqno(1024);
+
+static std::unique_ptr<MemcachedConnection> connect(const Options& options,
+                                                    const std::string& name) {
+    std::string host;
+    in_port_t port;
+    sa_family_t family;
+    std::tie(host, port, family) =
+            cb::inet::parse_hostname(options.host, options.port);
+    if (options.family != AF_UNSPEC) {
+        family = options.family;
+    }
+
+    auto ret = std::make_unique<MemcachedConnection>(
+            host, port, family, options.secure);
+    ret->connect();
+
+    std::vector<cb::mcbp::Feature> features = {cb::mcbp::Feature::XERROR};
+    if (options.compression) {
+        features.push_back(cb::mcbp::Feature::SNAPPY);
+    }
+    if (options.xattrs) {
+        features.push_back(cb::mcbp::Feature::XATTR);
+    }
+    if (options.collections) {
+        features.push_back(cb::mcbp::Feature::Collections);
+    }
+    ret->setFeatures(name, features);
+
+    if (!options.user.empty()) {
+        ret->authenticate(
+                options.user, options.password, ret->getSaslMechanisms());
+    }
+    ret->selectBucket(options.bucket);
+    return ret;
+}
+
+/**
+ * One DCP producer connection, streaming a set of vbuckets
+ */
+class DcpStreamer {
+public:
+    DcpStreamer(const Options& options,
+                std::string name,
+                std::vector<std::pair<Vbid, uint64_t>> vbuckets)
+        : options(options), name(std::move(name)), vbuckets(vbuckets) {
+    }
+
+    /// Open the connection and its streams
+    void open();
+
+    /// Receive until all of the streams ended, or stop is set
+    void run(const std::atomic<bool>& stop);
+
+    std::atomic<uint64_t> items{0};
+    std::atomic<uint64_t> bytes{0};
+    std::string error;
+
+private:
+    void control(const std::string& key, const std::string& value);
+
+    void handleRequest(const cb::mcbp::Request& request);
+
+    void handleResponse(const cb::mcbp::Response& response);
+
+    void sendBufferAck();
+
+    const Options& options;
+    const std::string name;
+    /// The vbuckets to stream, with the seqno to stream them to
+    const std::vector<std::pair<Vbid, uint64_t>> vbuckets;
+    std::unique_ptr<MemcachedConnection> connection;
+    size_t openStreams = 0;
+    uint32_t unackedBytes = 0;
+};
+
+void DcpStreamer::control(const std::string& key, const std::string& value) {
+    BinprotGenericCommand cmd(cb::mcbp::ClientOpcode::DcpControl, key, value);
+    BinprotResponse rsp;
+    connection->executeCommand(cmd, rsp);
+    if (!rsp.isSuccess()) {
+        throw ConnectionError("Failed to set DCP control " + key, rsp);
+    }
+}
+
+void DcpStreamer::open() {
+    connection = connect(options, name);
+
+    uint32_t flags = cb::mcbp::request::DcpOpenPayload::Producer;
+    if (options.xattrs) {
+        flags |= cb::mcbp::request::DcpOpenPayload::IncludeXattrs;
+    }
+    if (options.noValue) {
+        flags |= cb::mcbp::request::DcpOpenPayload::NoValue;
+    }
+    BinprotDcpOpenCommand open(name, 0, flags);
+    BinprotResponse rsp;
+    connection->executeCommand(open, rsp);
+    if (!rsp.isSuccess()) {
+        throw ConnectionError("Failed to open DCP producer", rsp);
+    }
+
+    if (options.bufferSize != 0) {
+        control("connection_buffer_size", std::to_string(options.bufferSize));
+    }
+    if (options.compression) {
+        control("force_value_compression", "true");
+    }
+    // Noops (which are sent when the streams are idle) allow us to notice
+    // the end of the run while following
+    control("enable_noop", "true");
+    control("set_noop_interval", "1");
+
+    // The stream request responses are told apart by their opaque (all of
+    // the requests are sent before reading any response).
+    Frame frame;
+    for (const auto& vb : vbuckets) {
+        BinprotDcpStreamRequestCommand cmd;
+        cmd.setVBucket(vb.first);
+        cmd.setDcpStartSeqno(0);
+        cmd.setDcpEndSeqno(vb.second);
+        cmd.setDcpSnapStartSeqno(0);
+        cmd.setDcpSnapEndSeqno(0);
+        std::vector<uint8_t> buffer;
+        cmd.encode(buffer);
+        reinterpret_cast<cb::mcbp::Request*>(buffer.data())
+                ->setOpaque(vb.first.get());
+        frame.payload.insert(frame.payload.end(), buffer.begin(), buffer.end());
+    }
+    connection->sendFrame(frame);
+    openStreams = vbuckets.size();
+}
+
+void DcpStreamer::run(const std::atomic<bool>& stop) {
+    Frame frame;
+    try {
+        while (openStreams != 0 && !stop) {
+            connection->recvFrame(frame);
+            if (frame.getMagic() == cb::mcbp::Magic::ClientResponse) {
+                handleResponse(*frame.getResponse());
+            } else {
+                // Only the DCP messages count against the flow control
+                // buffer
+                unackedBytes += uint32_t(frame.payload.size());
+                handleRequest(*frame.getRequest());
+            }
+            if (options.bufferSize != 0 &&
+                unackedBytes > options.bufferSize / 2) {
+                sendBufferAck();
+            }
+        }
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    connection.reset();
+}
+
+void DcpStreamer::handleRequest(const cb::mcbp::Request& request) {
+    using cb::mcbp::ClientOpcode;
+    switch (request.getClientOpcode()) {
+    case ClientOpcode::DcpMutation:
+    case ClientOpcode::DcpDeletion:
+    case ClientOpcode::DcpExpiration: {
+        // The by_seqno is the first field of the extras of all of them
+        const auto extras = request.getExtdata();
+        uint64_t seqno;
+        std::copy(extras.begin(),
+                  extras.begin() + sizeof(seqno),
+                  reinterpret_cast<uint8_t*>(&seqno));
+        const auto vbid = request.getVBucket().get();
+        if (vbid < receivedSeqno.size()) {
+            receivedSeqno[vbid].store(ntohll(seqno));
+        }
+        ++items;
+        bytes += sizeof(request) + request.getBodylen();
+        return;
+    }
+    case ClientOpcode::DcpStreamEnd:
+        --openStreams;
+        return;
+    case ClientOpcode::DcpNoop: {
+        std::vector<uint8_t> buffer(sizeof(cb::mcbp::Response));
+        cb::mcbp::ResponseBuilder builder({buffer.data(), buffer.size()});
+        builder.setMagic(cb::mcbp::Magic::ClientResponse);
+        builder.setOpcode(ClientOpcode::DcpNoop);
+        builder.setStatus(cb::mcbp::Status::Success);
+        builder.setOpaque(request.getOpaque());
+        Frame frame;
+        frame.payload = std::move(buffer);
+        connection->sendFrame(frame);
+        return;
+    }
+    default:
+        // Snapshot markers, system events etc
+        return;
+    }
+}
+
+void DcpStreamer::handleResponse(const cb::mcbp::Response& response) {
+    if (response.getClientOpcode() == cb::mcbp::ClientOpcode::DcpStreamReq &&
+        response.getStatus() != cb::mcbp::Status::Success) {
+        std::cerr << name << ": stream request for "
+                  << Vbid(uint16_t(response.getOpaque())) << " failed with "
+                  << to_string(response.getStatus()) << std::endl;
+        --openStreams;
+    }
+}
+
+void DcpStreamer::sendBufferAck() {
+    cb::mcbp::request::DcpBufferAckPayload payload;
+    payload.setBufferBytes(unackedBytes);
+    std::vector<uint8_t> buffer(sizeof(cb::mcbp::Request) + sizeof(payload));
+    cb::mcbp::RequestBuilder builder({buffer.data(), buffer.size()});
+    builder.setMagic(cb::mcbp::Magic::ClientRequest);
+    builder.setOpcode(cb::mcbp::ClientOpcode::DcpBufferAcknowledgement);
+    builder.setExtras(payload.getBuffer());
+    Frame frame;
+    frame.payload = std::move(buffer);
+    connection->sendFrame(frame);
+    unackedBytes = 0;
+}
+
+/// @return the CPU time used by the server so far (if it reports it)
+static double getServerCpuTime(MemcachedConnection& connection) {
+    const auto stats = connection.stats("");
+    double ret = 0;
+    for (const auto* key : {"rusage_user", "rusage_system"}) {
+        auto iter = stats.find(key);
+        if (iter != stats.end() && iter->is_number()) {
+            ret += iter->get<double>();
+        }
+    }
+    return ret;
+}
+
+/// @return the active vbuckets of the bucket, and their high seqnos
+static std::vector<std::pair<Vbid, uint64_t>> getActiveVBuckets(
+        MemcachedConnection& connection) {
+    const auto states = connection.stats("vbucket");
+    const auto seqnos = connection.stats("vbucket-seqno");
+    std::vector<std::pair<Vbid, uint64_t>> ret;
+    for (auto iter = states.begin(); iter != states.end(); ++iter) {
+        if (iter.key().find("vb_") != 0 || iter.value() != "active") {
+            continue;
+        }
+        const auto vbid = std::stoul(iter.key().substr(3));
+        const auto seqno = seqnos.find(iter.key() + ":high_seqno");
+        ret.emplace_back(Vbid(uint16_t(vbid)),
+                         seqno == seqnos.end() ? 0 : seqno->get<uint64_t>());
+    }
+    return ret;
+}
+
+/// @return the sum, over all of the vbuckets, of how far the streams are
+///         behind the high seqno
+static uint64_t getLag(MemcachedConnection& connection) {
+    uint64_t ret = 0;
+    for (const auto& vb : getActiveVBuckets(connection)) {
+        const auto vbid = vb.first.get();
+        const auto received =
+                vbid < receivedSeqno.size() ? receivedSeqno[vbid].load() : 0;
+        if (vb.second > received) {
+            ret += vb.second - received;
+        }
+    }
+    return ret;
+}
+
+static void usage() {
+    std::cerr << R"(Usage: dcpbench [options]
+
+Options:
+
+  -h or --host hostname[:port]   The host (with an optional port) to connect to
+                                 (for IPv6 use: [address]:port if you'd like to
+                                 specify port)
+  -p or --port port              The port number to connect to
+  -b or --bucket bucketname      The name of the bucket to stream
+  -u or --user username          The name of the user to authenticate as
+  -P or --password password      The passord to use for authentication
+                                 (use '-' to read from standard input)
+  -s or --ssl                    Connect to the server over SSL
+  -4 or --ipv4                   Connect over IPv4
+  -6 or --ipv6                   Connect over IPv6
+  -n or --connections num        The number of DCP producer connections to
+                                 spread the vbuckets over (default 1)
+  -B or --buffer-size bytes      The flow control buffer size of each
+                                 connection (default 10MB, 0 disables flow
+                                 control)
+  -c or --compression            Enable snappy and force value compression
+  -x or --xattrs                 Include the extended attributes
+  -C or --collections            Enable collections on the connections
+  -V or --no-value               Stream the keys and metadata only
+  -f or --follow seconds         Don't end the streams at the current high
+                                 seqnos, but keep streaming for the given
+                                 time (e.g. while the bucket is loaded) and
+                                 report the replication lag every second
+  -j or --json                   Print the result as JSON
+  --help                         This help text
+)";
+
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv) {
+    // Make sure that we dump callstacks on the console
+    install_backtrace_terminate_handler();
+
+    Options options;
+    int cmd;
+
+    cb_initialize_sockets();
+
+    struct option long_options[] = {
+            {"ipv4", no_argument, nullptr, '4'},
+            {"ipv6", no_argument, nullptr, '6'},
+            {"host", required_argument, nullptr, 'h'},
+            {"port", required_argument, nullptr, 'p'},
+            {"bucket", required_argument, nullptr, 'b'},
+            {"password", required_argument, nullptr, 'P'},
+            {"user", required_argument, nullptr, 'u'},
+            {"ssl", no_argument, nullptr, 's'},
+            {"connections", required_argument, nullptr, 'n'},
+            {"buffer-size", required_argument, nullptr, 'B'},
+            {"compression", no_argument, nullptr, 'c'},
+            {"xattrs", no_argument, nullptr, 'x'},
+            {"collections", no_argument, nullptr, 'C'},
+            {"no-value", no_argument, nullptr, 'V'},
+            {"follow", required_argument, nullptr, 'f'},
+            {"json", no_argument, nullptr, 'j'},
+            {"help", no_argument, nullptr, 0},
+            {nullptr, 0, nullptr, 0}};
+
+    while ((cmd = getopt_long(argc,
+                              argv,
+                              "46h:p:u:b:P:sn:B:cxCVf:j",
+                              long_options,
+                              nullptr)) != EOF) {
+        switch (cmd) {
+        case '6':
+            options.family = AF_INET6;
+            break;
+        case '4':
+            options.family = AF_INET;
+            break;
+        case 'h':
+            options.host.assign(optarg);
+            break;
+        case 'p':
+            options.port.assign(optarg);
+            break;
+        case 'b':
+            options.bucket.assign(optarg);
+            break;
+        case 'u':
+            options.user.assign(optarg);
+            break;
+        case 'P':
+            options.password.assign(optarg);
+            break;
+        case 's':
+            options.secure = true;
+            break;
+        case 'n':
+            options.connections = std::max(1ul, std::stoul(optarg));
+            break;
+        case 'B':
+            options.bufferSize = uint32_t(std::stoul(optarg));
+            break;
+        case 'c':
+            options.compression = true;
+            break;
+        case 'x':
+            options.xattrs = true;
+            break;
+        case 'C':
+            options.collections = true;
+            break;
+        case 'V':
+            options.noValue = true;
+            break;
+        case 'f':
+            options.follow = seconds(std::stoul(optarg));
+            break;
+        case 'j':
+            options.json = true;
+            break;
+        default:
+            usage();
+        }
+    }
+
+    if (options.bucket.empty()) {
+        std::cerr << "A bucket must be specified with -b" << std::endl;
+        usage();
+    }
+
+    if (options.password == "-") {
+        options.password.assign(getpass());
+    } else if (options.password.empty()) {
+        const char* env_password = std::getenv("CB_PASSWORD");
+        if (env_password) {
+            options.password = env_password;
+        }
+    }
+
+    try {
+        auto control = connect(options, "dcpbench");
+        auto vbuckets = getActiveVBuckets(*control);
+        if (vbuckets.empty()) {
+            std::cerr << "The bucket has no active vbuckets" << std::endl;
+            return EXIT_FAILURE;
+        }
+        // Only stream the vbuckets with something in them (unless following)
+        if (options.follow.count() == 0) {
+            vbuckets.erase(std::remove_if(vbuckets.begin(),
+                                          vbuckets.end(),
+                                          [](const auto& vb) {
+                                              return vb.second == 0;
+                                          }),
+                           vbuckets.end());
+        } else {
+            for (auto& vb : vbuckets) {
+                vb.second = std::numeric_limits<uint64_t>::max();
+            }
+        }
+
+        if (vbuckets.empty()) {
+            std::cerr << "The bucket is empty (use --follow to stream new "
+                         "mutations)"
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::vector<std::vector<std::pair<Vbid, uint64_t>>> assignments(
+                options.connections);
+        for (size_t ii = 0; ii < vbuckets.size(); ++ii) {
+            assignments[ii % options.connections].push_back(vbuckets[ii]);
+        }
+
+        std::vector<std::unique_ptr<DcpStreamer>> streamers;
+        for (size_t ii = 0; ii < options.connections; ++ii) {
+            streamers.emplace_back(std::make_unique<DcpStreamer>(
+                    options,
+                    "dcpbench:" + std::to_string(ii),
+                    assignments[ii]));
+        }
+
+        const auto cpuStart = getServerCpuTime(*control);
+        const auto start = steady_clock::now();
+        std::atomic<bool> stop{false};
+        std::vector<std::thread> threads;
+        for (auto& streamer : streamers) {
+            streamer->open();
+            auto* ptr = streamer.get();
+            threads.emplace_back([ptr, &stop]() { ptr->run(stop); });
+        }
+
+        nlohmann::json lag = nlohmann::json::array();
+        if (options.follow.count() != 0) {
+            const auto end = start + options.follow;
+            while (steady_clock::now() < end) {
+                std::this_thread::sleep_for(seconds(1));
+                lag.push_back(getLag(*control));
+                if (!options.json) {
+                    std::cout << "lag: " << lag.back() << " items"
+                              << std::endl;
+                }
+            }
+            stop = true;
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        const auto duration = duration_cast<std::chrono::duration<double>>(
+                                      steady_clock::now() - start)
+                                      .count();
+        const auto cpu = getServerCpuTime(*control) - cpuStart;
+
+        uint64_t items = 0;
+        uint64_t bytes = 0;
+        for (const auto& streamer : streamers) {
+            items += streamer->items;
+            bytes += streamer->bytes;
+            if (!streamer->error.empty()) {
+                std::cerr << "Error: " << streamer->error << std::endl;
+            }
+        }
+
+        nlohmann::json result;
+        result["connections"] = options.connections;
+        result["vbuckets"] = vbuckets.size();
+        result["items"] = items;
+        result["bytes"] = bytes;
+        result["duration_s"] = duration;
+        result["items_per_sec"] = items / duration;
+        result["bytes_per_sec"] = bytes / duration;
+        result["server_cpu_s"] = cpu;
+        if (items != 0) {
+            result["server_cpu_us_per_item"] = cpu * 1000000.0 / items;
+        }
+        if (options.follow.count() != 0) {
+            result["lag"] = lag;
+        }
+
+        if (options.json) {
+            std::cout << result.dump() << std::endl;
+        } else {
+            std::cout << "Streamed " << items << " items (" << bytes
+                      << " bytes) from " << vbuckets.size() << " vbuckets over "
+                      << options.connections << " connections in " << duration
+                      << "s" << std::endl
+                      << "  " << uint64_t(items / duration) << " items/s, "
+                      << uint64_t(bytes / duration) << " bytes/s" << std::endl;
+            if (items != 0 && cpu != 0) {
+                std::cout << "  server CPU: " << cpu * 1000000.0 / items
+                          << " us/item" << std::endl;
+            }
+        }
+    } catch (const ConnectionError& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    } catch (const std::runtime_error& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -396,6 +396,7 @@ SERVER_HANDLE_V1* get_mock_server_api() {
         hooks_api.release_free_memory = AllocHooks::release_free_memory;
         hooks_api.enable_thread_cache = AllocHooks::enable_thread_cache;
         hooks_api.get_allocator_property = AllocHooks::get_allocator_property;
+        hooks_api.get_slab_utilization = AllocHooks::get_slab_utilization;
 
         rv.core = &core_api;
         rv.callback = &callback_api;
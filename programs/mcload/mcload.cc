@@ -0,0 +1,438 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * mcload - generate a get/set load against a running server.
+ *
+ * A number of threads each open a connection to the bucket and keep a
+ * window of commands outstanding on it (see MemcachedPipeline), picking
+ * random keys from a fixed key space spread over the active vbuckets of
+ * the node. After the given duration it reports the ops/s, the latency
+ * percentiles (measured from sending a command until its response is read)
+ * and the CPU time used by the server per operation.
+ */
+
+#include <getopt.h>
+#include <memcached/protocol_binary.h>
+#include <nlohmann/json.hpp>
+#include <platform/random.h>
+#include <programs/getpass.h>
+#include <programs/hostname_utils.h>
+#include <protocol/connection/client_connection.h>
+#include <protocol/connection/client_mcbp_commands.h>
+#include <protocol/connection/client_pipeline.h>
+#include <utilities/hdrhistogram.h>
+#include <utilities/terminate_handler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+/// The options shared by all of the load threads
+struct Options {
+    std::string host{"localhost"};
+    std::string port{"11210"};
+    std::string user;
+    std::string password;
+    std::string bucket;
+    sa_family_t family = AF_UNSPEC;
+    bool secure = false;
+    size_t threads = 1;
+    size_t window = 16;
+    seconds duration{10};
+    size_t keys = 10000;
+    size_t valueSize = 256;
+    /// The percentage of the operations which are gets (the rest are sets)
+    unsigned int readRatio = 80;
+    bool json = false;
+};
+
+static std::unique_ptr<MemcachedConnection> connect(const Options& options,
+                                                    const std::string& name) {
+    std::string host;
+    in_port_t port;
+    sa_family_t family;
+    std::tie(host, port, family) =
+            cb::inet::parse_hostname(options.host, options.port);
+    if (options.family != AF_UNSPEC) {
+        family = options.family;
+    }
+
+    auto ret = std::make_unique<MemcachedConnection>(
+            host, port, family, options.secure);
+    ret->connect();
+    ret->setFeatures(name, {cb::mcbp::Feature::XERROR});
+    if (!options.user.empty()) {
+        ret->authenticate(
+                options.user, options.password, ret->getSaslMechanisms());
+    }
+    ret->selectBucket(options.bucket);
+    return ret;
+}
+
+/**
+ * One connection, sending a mix of gets and sets until stopped
+ */
+class LoadGenerator {
+public:
+    LoadGenerator(const Options& options,
+                  std::string name,
+                  const std::vector<Vbid>& vbuckets)
+        : options(options), name(std::move(name)), vbuckets(vbuckets) {
+    }
+
+    /// Open the connection
+    void open() {
+        connection = connect(options, name);
+    }
+
+    /// Send commands until stop is set
+    void run(const std::atomic<bool>& stop);
+
+    uint64_t gets = 0;
+    uint64_t sets = 0;
+    /// Gets of a key which hasn't been set yet
+    uint64_t misses = 0;
+    uint64_t errors = 0;
+    Hdr2sfMicroSecHistogram latency;
+    std::string error;
+
+private:
+    void onResponse(BinprotResponse& response,
+                    steady_clock::time_point sent,
+                    bool get);
+
+    const Options& options;
+    const std::string name;
+    const std::vector<Vbid>& vbuckets;
+    std::unique_ptr<MemcachedConnection> connection;
+};
+
+void LoadGenerator::run(const std::atomic<bool>& stop) {
+    try {
+        MemcachedPipeline pipeline(*connection, options.window);
+        cb::RandomGenerator rng;
+        const std::string value(options.valueSize, 'x');
+        BinprotGetCommand get;
+        BinprotMutationCommand set;
+        set.setMutationType(MutationType::Set);
+        set.setValue(value);
+
+        while (!stop) {
+            const auto key = rng.next() % options.keys;
+            const auto vbid = vbuckets[key % vbuckets.size()];
+            const bool isGet = (rng.next() % 100) < options.readRatio;
+            BinprotCommand& cmd = isGet ? static_cast<BinprotCommand&>(get)
+                                        : static_cast<BinprotCommand&>(set);
+            cmd.setKey("mcload_" + std::to_string(key));
+            cmd.setVBucket(vbid);
+
+            // Wait for room in the window first so the latency only covers
+            // the time the command spent at the server (and on the wire)
+            while (pipeline.getOutstanding() >= pipeline.getWindow()) {
+                pipeline.receive();
+            }
+            const auto sent = steady_clock::now();
+            pipeline.submit(cmd, [this, sent, isGet](BinprotResponse& rsp) {
+                onResponse(rsp, sent, isGet);
+            });
+        }
+        pipeline.wait();
+    } catch (const std::exception& ex) {
+        error = name + ": " + ex.what();
+    }
+}
+
+void LoadGenerator::onResponse(BinprotResponse& response,
+                               steady_clock::time_point sent,
+                               bool get) {
+    latency.add(duration_cast<microseconds>(steady_clock::now() - sent));
+    if (get) {
+        ++gets;
+        if (response.getStatus() == cb::mcbp::Status::KeyEnoent) {
+            ++misses;
+            return;
+        }
+    } else {
+        ++sets;
+    }
+    if (!response.isSuccess()) {
+        ++errors;
+    }
+}
+
+/// @return the (user + system) CPU time used by the server in seconds
+static double getServerCpuTime(MemcachedConnection& connection) {
+    const auto stats = connection.stats("");
+    double ret = 0;
+    for (const auto* key : {"rusage_user", "rusage_system"}) {
+        auto iter = stats.find(key);
+        if (iter != stats.end() && iter->is_number()) {
+            ret += iter->get<double>();
+        }
+    }
+    return ret;
+}
+
+/// @return the active vbuckets of the bucket on the node
+static std::vector<Vbid> getActiveVBuckets(MemcachedConnection& connection) {
+    const auto states = connection.stats("vbucket");
+    std::vector<Vbid> ret;
+    for (auto iter = states.begin(); iter != states.end(); ++iter) {
+        if (iter.key().find("vb_") == 0 && iter.value() == "active") {
+            ret.emplace_back(uint16_t(std::stoul(iter.key().substr(3))));
+        }
+    }
+    return ret;
+}
+
+static void usage() {
+    std::cerr << R"(Usage: mcload [options]
+
+Options:
+
+  -h or --host hostname[:port]   The host (with an optional port) to connect to
+                                 (for IPv6 use: [address]:port if you'd like to
+                                 specify port)
+  -p or --port port              The port number to connect to
+  -b or --bucket bucketname      The name of the bucket to load
+  -u or --user username          The name of the user to authenticate as
+  -P or --password password      The passord to use for authentication
+                                 (use '-' to read from standard input)
+  -s or --ssl                    Connect to the server over SSL
+  -4 or --ipv4                   Connect over IPv4
+  -6 or --ipv6                   Connect over IPv6
+  -t or --threads num            The number of threads (each with its own
+                                 connection) to run (default 1)
+  -w or --window num             The number of commands each connection keeps
+                                 outstanding (default 16)
+  -d or --duration seconds       How long to run for (default 10)
+  -k or --keys num               The number of keys to pick from (default
+                                 10000)
+  -S or --value-size bytes       The size of the values to set (default 256)
+  -r or --read-ratio percent     The percentage of the operations which are
+                                 gets rather than sets (default 80)
+  -j or --json                   Print the result as JSON
+  --help                         This help text
+)";
+
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv) {
+    // Make sure that we dump callstacks on the console
+    install_backtrace_terminate_handler();
+
+    Options options;
+    int cmd;
+
+    cb_initialize_sockets();
+
+    struct option long_options[] = {
+            {"ipv4", no_argument, nullptr, '4'},
+            {"ipv6", no_argument, nullptr, '6'},
+            {"host", required_argument, nullptr, 'h'},
+            {"port", required_argument, nullptr, 'p'},
+            {"bucket", required_argument, nullptr, 'b'},
+            {"password", required_argument, nullptr, 'P'},
+            {"user", required_argument, nullptr, 'u'},
+            {"ssl", no_argument, nullptr, 's'},
+            {"threads", required_argument, nullptr, 't'},
+            {"window", required_argument, nullptr, 'w'},
+            {"duration", required_argument, nullptr, 'd'},
+            {"keys", required_argument, nullptr, 'k'},
+            {"value-size", required_argument, nullptr, 'S'},
+            {"read-ratio", required_argument, nullptr, 'r'},
+            {"json", no_argument, nullptr, 'j'},
+            {"help", no_argument, nullptr, 0},
+            {nullptr, 0, nullptr, 0}};
+
+    while ((cmd = getopt_long(argc,
+                              argv,
+                              "46h:p:u:b:P:st:w:d:k:S:r:j",
+                              long_options,
+                              nullptr)) != EOF) {
+        switch (cmd) {
+        case '6':
+            options.family = AF_INET6;
+            break;
+        case '4':
+            options.family = AF_INET;
+            break;
+        case 'h':
+            options.host.assign(optarg);
+            break;
+        case 'p':
+            options.port.assign(optarg);
+            break;
+        case 'b':
+            options.bucket.assign(optarg);
+            break;
+        case 'u':
+            options.user.assign(optarg);
+            break;
+        case 'P':
+            options.password.assign(optarg);
+            break;
+        case 's':
+            options.secure = true;
+            break;
+        case 't':
+            options.threads = std::max(1ul, std::stoul(optarg));
+            break;
+        case 'w':
+            options.window = std::max(1ul, std::stoul(optarg));
+            break;
+        case 'd':
+            options.duration = seconds(std::stoul(optarg));
+            break;
+        case 'k':
+            options.keys = std::max(1ul, std::stoul(optarg));
+            break;
+        case 'S':
+            options.valueSize = std::stoul(optarg);
+            break;
+        case 'r':
+            options.readRatio = std::min(100u, unsigned(std::stoul(optarg)));
+            break;
+        case 'j':
+            options.json = true;
+            break;
+        default:
+            usage();
+        }
+    }
+
+    if (options.bucket.empty()) {
+        std::cerr << "A bucket must be specified with -b" << std::endl;
+        usage();
+    }
+
+    if (options.password == "-") {
+        options.password.assign(getpass());
+    } else if (options.password.empty()) {
+        const char* env_password = std::getenv("CB_PASSWORD");
+        if (env_password) {
+            options.password = env_password;
+        }
+    }
+
+    try {
+        auto control = connect(options, "mcload");
+        const auto vbuckets = getActiveVBuckets(*control);
+        if (vbuckets.empty()) {
+            std::cerr << "The bucket has no active vbuckets" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::vector<std::unique_ptr<LoadGenerator>> generators;
+        for (size_t ii = 0; ii < options.threads; ++ii) {
+            generators.emplace_back(std::make_unique<LoadGenerator>(
+                    options, "mcload:" + std::to_string(ii), vbuckets));
+            generators.back()->open();
+        }
+
+        const auto cpuStart = getServerCpuTime(*control);
+        const auto start = steady_clock::now();
+        std::atomic<bool> stop{false};
+        std::vector<std::thread> threads;
+        for (auto& generator : generators) {
+            auto* ptr = generator.get();
+            threads.emplace_back([ptr, &stop]() { ptr->run(stop); });
+        }
+        std::this_thread::sleep_for(options.duration);
+        stop = true;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        const auto duration = duration_cast<std::chrono::duration<double>>(
+                                      steady_clock::now() - start)
+                                      .count();
+        const auto cpu = getServerCpuTime(*control) - cpuStart;
+
+        uint64_t gets = 0;
+        uint64_t sets = 0;
+        uint64_t misses = 0;
+        uint64_t errors = 0;
+        Hdr2sfMicroSecHistogram latency;
+        for (const auto& generator : generators) {
+            gets += generator->gets;
+            sets += generator->sets;
+            misses += generator->misses;
+            errors += generator->errors;
+            latency += generator->latency;
+            if (!generator->error.empty()) {
+                std::cerr << "Error: " << generator->error << std::endl;
+            }
+        }
+        const auto ops = gets + sets;
+
+        nlohmann::json result;
+        result["threads"] = options.threads;
+        result["window"] = options.window;
+        result["ops"] = ops;
+        result["gets"] = gets;
+        result["sets"] = sets;
+        result["misses"] = misses;
+        result["errors"] = errors;
+        result["duration_s"] = duration;
+        result["ops_per_sec"] = ops / duration;
+        nlohmann::json percentiles;
+        for (const auto& p : std::vector<std::pair<std::string, double>>{
+                     {"p50", 50.0},
+                     {"p90", 90.0},
+                     {"p99", 99.0},
+                     {"p99.9", 99.9}}) {
+            percentiles[p.first] = latency.getValueAtPercentile(p.second);
+        }
+        result["latency_us"] = percentiles;
+        result["server_cpu_s"] = cpu;
+        if (ops != 0) {
+            result["server_cpu_us_per_op"] = cpu * 1000000.0 / ops;
+        }
+
+        if (options.json) {
+            std::cout << result.dump() << std::endl;
+        } else {
+            std::cout << "Ran " << ops << " ops (" << gets << " gets, " << sets
+                      << " sets) over " << options.threads
+                      << " connections with a window of " << options.window
+                      << " in " << duration << "s" << std::endl
+                      << "  " << uint64_t(ops / duration) << " ops/s, "
+                      << misses << " misses, " << errors << " errors"
+                      << std::endl
+                      << "  latency (us): " << percentiles.dump() << std::endl;
+            if (ops != 0 && cpu != 0) {
+                std::cout << "  server CPU: " << cpu * 1000000.0 / ops
+                          << " us/op" << std::endl;
+            }
+        }
+    } catch (const ConnectionError& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    } catch (const std::runtime_error& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
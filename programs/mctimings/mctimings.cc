@@ -28,11 +28,18 @@
 
 #include <inttypes.h>
 #include <strings.h>
+#include <algorithm>
 #include <array>
+#include <cctype>
+#include <chrono>
 #include <cstdlib>
+#include <ctime>
 #include <gsl/gsl>
+#include <iomanip>
 #include <iostream>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 
 #define JSON_DUMP_INDENT_SIZE 4
 
@@ -314,6 +321,78 @@ static void request_stat_timings(MemcachedConnection& connection,
     }
 }
 
+/**
+ * Print the percentiles of the commands completed in each of the server's
+ * one second intervals (see "stats interval_timings") until interrupted.
+ *
+ * @param opcodes the opcodes to print (all of those with commands in the
+ *                interval if empty)
+ */
+static void stream_interval_timings(MemcachedConnection& connection,
+                                    const std::vector<std::string>& opcodes,
+                                    bool json_output) {
+    uint64_t lastInterval = 0;
+    size_t lines = 0;
+    while (true) {
+        nlohmann::json stats;
+        try {
+            stats = connection.stats("interval_timings");
+        } catch (const ConnectionError& ex) {
+            if (ex.isAccessDenied()) {
+                std::cerr << "Not authorized to access timings data"
+                          << std::endl;
+            } else {
+                std::cerr << "Fatal error: " << ex.what() << std::endl;
+            }
+            exit(EXIT_FAILURE);
+        }
+
+        // Poll more often than the server samples so that we don't skip
+        // an interval, and print each one once.
+        if (stats.empty() ||
+            stats.begin()->at("interval").get<uint64_t>() == lastInterval) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+            continue;
+        }
+        lastInterval = stats.begin()->at("interval").get<uint64_t>();
+
+        if (!opcodes.empty()) {
+            nlohmann::json selected = nlohmann::json::object();
+            for (const auto& opcode : opcodes) {
+                auto iter = stats.find(opcode);
+                if (iter != stats.end()) {
+                    selected[opcode] = *iter;
+                }
+            }
+            stats = selected;
+        }
+
+        if (json_output) {
+            std::cout << stats.dump() << std::endl;
+            continue;
+        }
+
+        const auto now = std::time(nullptr);
+        char time[16];
+        std::strftime(time, sizeof(time), "%H:%M:%S", std::localtime(&now));
+        if (lines++ % 20 == 0) {
+            std::cout << "time     opcode                    ops      p50      "
+                         "p90      p99    p99.9      max (us)"
+                      << std::endl;
+        }
+        for (auto it = stats.begin(); it != stats.end(); ++it) {
+            const auto& value = it.value();
+            std::cout << time << " " << std::left << std::setw(20) << it.key()
+                      << std::right << std::setw(9)
+                      << value["count"].get<uint64_t>();
+            for (const auto* field : {"p50", "p90", "p99", "p99.9", "max"}) {
+                std::cout << std::setw(9) << value[field].get<uint64_t>();
+            }
+            std::cout << std::endl;
+        }
+    }
+}
+
 void usage() {
     std::cerr << "Usage mctimings [options] [opcode / statname]\n"
               << R"(Options:
@@ -330,6 +409,14 @@ void usage() {
   -v or --verbose                Use verbose output
   -S                             Read password from standard input
   -j or --json[=pretty]          Print JSON instead of histograms
+  -V or --vbucket vbid           Print the timings of the GET, SET and DELETE
+                                 commands on the given vbucket (requires
+                                 keyed_timings_enabled on the server)
+  -C or --collection cid         Print the timings of the GET, SET and DELETE
+                                 commands on the given collection (in hex)
+  -i or --interval               Print the percentiles of the commands
+                                 completed in each second (of the selected
+                                 bucket) until interrupted
   --help                         This help text
 
 )" << std::endl
@@ -338,6 +425,33 @@ void usage() {
               << "Example:" << std::endl
               << "    mctimings --user operator --bucket /all/ --password - "
                  "--verbose GET SET"
+              << std::endl
+              << std::endl
+              << "The time spent in the spans traced within a command (for "
+                 "connections with"
+              << std::endl
+              << "tracing enabled) is available as the span_timings "
+                 "statistic:"
+              << std::endl
+              << "    mctimings --user operator --bucket /all/ --password - "
+                 "--verbose \"span_timings SET ht.lock\""
+              << std::endl
+              << std::endl
+              << "The timings of a bucket's GET, SET and DELETE commands on a "
+                 "vbucket or"
+              << std::endl
+              << "collection (if keyed_timings_enabled is set) are printed "
+                 "with:"
+              << std::endl
+              << "    mctimings --user operator --bucket default --password - "
+                 "--verbose --vbucket 12 GET"
+              << std::endl
+              << std::endl
+              << "The percentiles of a bucket's commands are printed every "
+                 "second with:"
+              << std::endl
+              << "    mctimings --user operator --bucket default --password - "
+                 "--interval GET SET"
               << std::endl;
 }
 
@@ -355,6 +469,10 @@ int main(int argc, char** argv) {
     bool verbose = false;
     bool secure = false;
     bool json = false;
+    bool interval = false;
+    // "vbucket <vbid>" or "collection <cid>" if the keyed timings are
+    // requested
+    std::string keyed;
 
     /* Initialize the socket subsystem */
     cb_initialize_sockets();
@@ -370,12 +488,17 @@ int main(int argc, char** argv) {
             {"ssl", no_argument, nullptr, 's'},
             {"verbose", no_argument, nullptr, 'v'},
             {"json", optional_argument, nullptr, 'j'},
+            {"vbucket", required_argument, nullptr, 'V'},
+            {"collection", required_argument, nullptr, 'C'},
+            {"interval", no_argument, nullptr, 'i'},
             {"help", no_argument, nullptr, 0},
             {nullptr, 0, nullptr, 0}};
 
-    while ((cmd = getopt_long(
-                    argc, argv, "46h:p:u:b:P:sSvj", long_options, nullptr)) !=
-           EOF) {
+    while ((cmd = getopt_long(argc,
+                              argv,
+                              "46h:p:u:b:P:sSvjV:C:i",
+                              long_options,
+                              nullptr)) != EOF) {
         switch (cmd) {
         case '6':
             family = AF_INET6;
@@ -413,6 +536,15 @@ int main(int argc, char** argv) {
                 verbose = true;
             }
             break;
+        case 'V':
+            keyed = std::string("vbucket ") + optarg;
+            break;
+        case 'C':
+            keyed = std::string("collection ") + optarg;
+            break;
+        case 'i':
+            interval = true;
+            break;
         default:
             usage();
             return cmd == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
@@ -428,6 +560,12 @@ int main(int argc, char** argv) {
         }
     }
 
+    if (interval && bucket == "/all/") {
+        std::cerr << "--interval requires a bucket (use -b bucketname)"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
     try {
         in_port_t in_port;
         sa_family_t fam;
@@ -455,7 +593,38 @@ int main(int argc, char** argv) {
             connection.selectBucket(bucket);
         }
 
-        if (optind == argc) {
+        if (interval) {
+            std::vector<std::string> opcodes;
+            for (; optind < argc; ++optind) {
+                try {
+                    opcodes.emplace_back(
+                            opcode2string(to_opcode(argv[optind])));
+                } catch (const std::invalid_argument&) {
+                    std::cerr << "Unknown opcode: " << argv[optind]
+                              << std::endl;
+                    return EXIT_FAILURE;
+                }
+            }
+            stream_interval_timings(connection, opcodes, json);
+        } else if (!keyed.empty()) {
+            std::vector<std::string> operations;
+            for (; optind < argc; ++optind) {
+                operations.emplace_back(argv[optind]);
+            }
+            if (operations.empty()) {
+                operations = {"GET", "SET", "DELETE"};
+            }
+            for (auto operation : operations) {
+                std::transform(operation.begin(),
+                               operation.end(),
+                               operation.begin(),
+                               ::tolower);
+                request_stat_timings(connection,
+                                     "keyed_timings " + keyed + " " + operation,
+                                     verbose,
+                                     json);
+            }
+        } else if (optind == argc) {
             for (int ii = 0; ii < 256; ++ii) {
                 request_cmd_timings(connection,
                                     bucket,
@@ -23,6 +23,7 @@
 #include <memcached/openssl.h>
 #include <memcached/protocol_binary.h>
 #include <memcached/util.h>
+#include <nlohmann/json.hpp>
 #include <platform/cb_malloc.h>
 #include <platform/dirutils.h>
 #include <platform/interrupt.h>
@@ -74,6 +75,10 @@ Options:
                       data. This option clears the data on the server before
                       waiting for the user to press ctrl-c and may be used
                       to get information for a known window of time.
+    --samples / -S    Instead of a trace dump, write the requests recently
+                      sampled by each front-end thread of the server (see
+                      "request_sample_interval") as JSON, with the trace
+                      spans of each request.
     --help            This help text
 
 )";
@@ -95,6 +100,7 @@ int main(int argc, char** argv) {
     std::string trace_config;
     std::string output("-");
     bool interactive = false;
+    bool samples = false;
 
     /* Initialize the socket subsystem */
     cb_initialize_sockets();
@@ -110,11 +116,12 @@ int main(int argc, char** argv) {
             {"config", required_argument, nullptr, 'c'},
             {"output", required_argument, nullptr, 'o'},
             {"wait", no_argument, nullptr, 'w'},
+            {"samples", no_argument, nullptr, 'S'},
             {"help", no_argument, nullptr, 0},
             {nullptr, 0, nullptr, 0}};
 
     while ((cmd = getopt_long(
-                    argc, argv, "46h:p:u:P:sc:o:w", long_options, nullptr)) !=
+                    argc, argv, "46h:p:u:P:sc:o:wS", long_options, nullptr)) !=
            EOF) {
         switch (cmd) {
         case '6':
@@ -169,6 +176,9 @@ int main(int argc, char** argv) {
         case 'w':
             interactive = true;
             break;
+        case 'S':
+            samples = true;
+            break;
         default:
             usage();
         }
@@ -217,6 +227,27 @@ int main(int argc, char** argv) {
                     user, password, connection.getSaslMechanisms());
         }
 
+        if (samples) {
+            // The samples are always being collected, so there is nothing
+            // to start (or stop)
+            const auto json = connection.stats("request_samples");
+            if (output.empty() || output == "-") {
+                std::cout << json.dump(2) << std::endl;
+            } else {
+                FILE* destination = fopen(output.c_str(), "w");
+                if (destination == nullptr) {
+                    fprintf(stderr,
+                            R"(Failed to open "%s": %s)",
+                            output.c_str(),
+                            cb_strerror().c_str());
+                    exit(EXIT_FAILURE);
+                }
+                fprintf(destination, "%s\n", json.dump(2).c_str());
+                fclose(destination);
+            }
+            return EXIT_SUCCESS;
+        }
+
         if (!trace_config.empty()) {
             // Start the trace
             connection.ioctl_set("trace.config", trace_config);
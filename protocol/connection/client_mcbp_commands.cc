@@ -64,7 +64,7 @@ void BinprotCommand::fillHeader(cb::mcbp::Request& header,
     header.setDatatype(cb::mcbp::Datatype::Raw);
     header.setVBucket(vbucket);
     header.setBodylen(gsl::narrow<uint32_t>(key.size() + extlen + payload_len));
-    header.setOpaque(0xdeadbeef);
+    header.setOpaque(opaque);
     // @todo fix this to use the setter. There is still some dependency
     // in other tests which use expects this to be in the same byte order
     // as the server sent it..
@@ -99,6 +99,7 @@ void BinprotCommand::clear() {
     key.clear();
     cas = 0;
     vbucket = Vbid(0);
+    opaque = 0xdeadbeef;
 }
 
 uint64_t BinprotCommand::getCas() const {
@@ -118,6 +119,15 @@ BinprotCommand& BinprotCommand::setVBucket(Vbid vbid) {
     return *this;
 }
 
+uint32_t BinprotCommand::getOpaque() const {
+    return opaque;
+}
+
+BinprotCommand& BinprotCommand::setOpaque(uint32_t opaque_) {
+    opaque = opaque_;
+    return *this;
+}
+
 void BinprotCommand::ExpiryValue::assign(uint32_t value_) {
     value = value_;
     set = true;
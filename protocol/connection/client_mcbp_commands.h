@@ -51,6 +51,15 @@ public:
 
     BinprotCommand& setVBucket(Vbid vbid);
 
+    uint32_t getOpaque() const;
+
+    /**
+     * Set the opaque to send, which the server returns in the response. Only
+     * needed when more than one command is outstanding (see
+     * MemcachedPipeline).
+     */
+    BinprotCommand& setOpaque(uint32_t opaque_);
+
     /**
      * Encode the command to a buffer.
      * @param buf The buffer
@@ -122,6 +131,7 @@ protected:
     std::string key;
     uint64_t cas = 0;
     Vbid vbucket = Vbid(0);
+    uint32_t opaque = 0xdeadbeef;
 
 private:
     /**
@@ -0,0 +1,82 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include "client_pipeline.h"
+
+#include <stdexcept>
+
+MemcachedPipeline::MemcachedPipeline(MemcachedConnection& connection,
+                                     size_t window)
+    : connection(connection), window(window) {
+    if (window == 0) {
+        throw std::invalid_argument(
+                "MemcachedPipeline: window must be greater than 0");
+    }
+}
+
+void MemcachedPipeline::submit(BinprotCommand& command, Callback callback) {
+    while (outstanding.size() >= window) {
+        receive();
+    }
+
+    // Skip any opaque still outstanding (only possible after the counter
+    // wraps)
+    while (outstanding.count(nextOpaque) != 0) {
+        ++nextOpaque;
+    }
+    const auto opaque = nextOpaque++;
+    command.setOpaque(opaque);
+    connection.sendCommand(command);
+    outstanding.emplace(opaque, std::move(callback));
+}
+
+std::future<BinprotResponse> MemcachedPipeline::submit(
+        BinprotCommand& command) {
+    // std::function must be copyable, so share the promise
+    auto promise = std::make_shared<std::promise<BinprotResponse>>();
+    auto ret = promise->get_future();
+    submit(command, [promise](BinprotResponse& response) {
+        promise->set_value(std::move(response));
+    });
+    return ret;
+}
+
+bool MemcachedPipeline::receive() {
+    if (outstanding.empty()) {
+        return false;
+    }
+
+    BinprotResponse response;
+    connection.recvResponse(response);
+    const auto opaque = response.getResponse().getOpaque();
+    auto iter = outstanding.find(opaque);
+    if (iter == outstanding.end()) {
+        throw ValidationError(
+                "MemcachedPipeline::receive: received a response for opaque " +
+                std::to_string(opaque) + " which isn't outstanding");
+    }
+
+    // Remove it first, in case the callback submits another command
+    auto callback = std::move(iter->second);
+    outstanding.erase(iter);
+    callback(response);
+    return true;
+}
+
+void MemcachedPipeline::wait() {
+    while (receive()) {
+    }
+}
@@ -0,0 +1,94 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#pragma once
+
+#include "client_connection.h"
+#include "client_mcbp_commands.h"
+
+#include <functional>
+#include <future>
+#include <unordered_map>
+
+/**
+ * The MemcachedPipeline sends commands over a MemcachedConnection without
+ * waiting for the response to one before sending the next, keeping up to
+ * a configurable number (the window) of commands outstanding.
+ *
+ * Every command is given a unique opaque, and its response is matched to
+ * it by that opaque, so the responses may be returned in any order (see
+ * ExecutionMode::Unordered). The completion of a command is reported
+ * through the callback (or future) provided when it was submitted, which
+ * is called from within submit(), receive() or wait() as the responses are
+ * read.
+ *
+ * Like the connection it's built on the pipeline isn't thread safe; use
+ * one connection (and pipeline) per thread. The commands must all get a
+ * response (i.e. no quiet commands), and the connection must not be used
+ * directly while commands are outstanding.
+ */
+class MemcachedPipeline {
+public:
+    using Callback = std::function<void(BinprotResponse&)>;
+
+    /**
+     * @param connection the (connected) connection to send the commands on
+     * @param window the maximum number of commands to have outstanding
+     */
+    MemcachedPipeline(MemcachedConnection& connection, size_t window);
+
+    /**
+     * Send the command, first reading responses until there is room in the
+     * window for it. The command's opaque is overwritten, and the command
+     * may be reused or destroyed once this returns.
+     *
+     * @param command the command to send
+     * @param callback called with the response to the command
+     */
+    void submit(BinprotCommand& command, Callback callback);
+
+    /**
+     * Send the command as above, returning a future for the response. The
+     * future is only satisfied once the pipeline has read the response,
+     * i.e. by a later call to submit(), receive() or wait() on this thread.
+     */
+    std::future<BinprotResponse> submit(BinprotCommand& command);
+
+    /**
+     * Read the next response and call the callback of its command
+     *
+     * @return false if there were no commands outstanding
+     * @throws ValidationError if the response is for no outstanding command
+     */
+    bool receive();
+
+    /// Read the responses to all of the outstanding commands
+    void wait();
+
+    size_t getOutstanding() const {
+        return outstanding.size();
+    }
+
+    size_t getWindow() const {
+        return window;
+    }
+
+private:
+    MemcachedConnection& connection;
+    const size_t window;
+    uint32_t nextOpaque = 0;
+    std::unordered_map<uint32_t, Callback> outstanding;
+};
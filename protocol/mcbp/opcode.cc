@@ -157,6 +157,9 @@ bool is_valid_opcode(ClientOpcode opcode) {
     case ClientOpcode::CollectionsGetManifest:
     case ClientOpcode::CollectionsGetID:
     case ClientOpcode::CollectionsGetScopeID:
+    case ClientOpcode::RangeScan:
+    case ClientOpcode::BulkStore:
+    case ClientOpcode::GetRandomKeys:
     case ClientOpcode::SetDriftCounterState:
     case ClientOpcode::GetAdjustedTime:
     case ClientOpcode::SubdocGet:
@@ -470,6 +473,12 @@ std::string to_string(cb::mcbp::ClientOpcode opcode) {
         return "COLLECTIONS_GET_ID";
     case ClientOpcode::CollectionsGetScopeID:
         return "COLLECTIONS_GET_SCOPE_ID";
+    case ClientOpcode::RangeScan:
+        return "RANGE_SCAN";
+    case ClientOpcode::BulkStore:
+        return "BULK_STORE";
+    case ClientOpcode::GetRandomKeys:
+        return "GET_RANDOM_KEYS";
     case ClientOpcode::SetDriftCounterState:
         return "SET_DRIFT_COUNTER_STATE";
     case ClientOpcode::GetAdjustedTime:
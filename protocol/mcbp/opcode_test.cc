@@ -156,6 +156,9 @@ const std::map<cb::mcbp::ClientOpcode, std::string> client_blueprint = {
          {ClientOpcode::CollectionsGetManifest, "COLLECTIONS_GET_MANIFEST"},
          {ClientOpcode::CollectionsGetID, "COLLECTIONS_GET_ID"},
          {ClientOpcode::CollectionsGetScopeID, "COLLECTIONS_GET_SCOPE_ID"},
+         {ClientOpcode::RangeScan, "RANGE_SCAN"},
+         {ClientOpcode::BulkStore, "BULK_STORE"},
+         {ClientOpcode::GetRandomKeys, "GET_RANDOM_KEYS"},
          {ClientOpcode::SetDriftCounterState, "SET_DRIFT_COUNTER_STATE"},
          {ClientOpcode::GetAdjustedTime, "GET_ADJUSTED_TIME"},
          {ClientOpcode::SubdocGet, "SUBDOC_GET"},
@@ -163,6 +163,9 @@ static bool reorderSupported(ClientOpcode opcode) {
     case ClientOpcode::CollectionsGetManifest:
     case ClientOpcode::CollectionsGetID:
     case ClientOpcode::CollectionsGetScopeID:
+    case ClientOpcode::RangeScan:
+    case ClientOpcode::BulkStore:
+    case ClientOpcode::GetRandomKeys:
     case ClientOpcode::SetDriftCounterState:
     case ClientOpcode::GetAdjustedTime:
     case ClientOpcode::SubdocGet:
@@ -383,6 +386,9 @@ bool Request::isQuiet() const {
         case ClientOpcode::CollectionsGetManifest:
         case ClientOpcode::CollectionsGetID:
         case ClientOpcode::CollectionsGetScopeID:
+        case ClientOpcode::RangeScan:
+        case ClientOpcode::BulkStore:
+        case ClientOpcode::GetRandomKeys:
         case ClientOpcode::SetDriftCounterState:
         case ClientOpcode::GetAdjustedTime:
         case ClientOpcode::SubdocGet:
@@ -478,9 +484,8 @@ Request::getDurabilityRequirements() const {
     return {};
 }
 
-bool Request::mayReorder(const Request& other) const {
-    if (!reorderSupported(getClientOpcode()) ||
-        !reorderSupported(other.getClientOpcode())) {
+bool Request::isReorderable() const {
+    if (!reorderSupported(getClientOpcode())) {
         return false;
     }
 
@@ -496,26 +501,13 @@ bool Request::mayReorder(const Request& other) const {
         return true;
     });
 
-    if (!allowReorder) {
-        // This command don't allow for reordering of commands
-        return false;
-    }
-
-    allowReorder = false;
-    other.parseFrameExtras([&allowReorder](cb::mcbp::request::FrameInfoId id,
-                                           cb::const_byte_buffer data) -> bool {
-        if (id == cb::mcbp::request::FrameInfoId::Reorder) {
-            allowReorder = true;
-            // stop parsing
-            return false;
-        }
-        // Continue parsing
-        return true;
-    });
-
     return allowReorder;
 }
 
+bool Request::mayReorder(const Request& other) const {
+    return isReorderable() && other.isReorderable();
+}
+
 nlohmann::json Request::toJSON() const {
     if (!isValid()) {
         throw std::logic_error("Request::toJSON(): Invalid packet");
@@ -365,3 +365,15 @@ TEST(Request_MayReorder, both_do_opcode_do) {
     EXPECT_TRUE(m.mayReorder(o));
     EXPECT_TRUE(o.mayReorder(m));
 }
+
+TEST(Request_IsReorderable, Get) {
+    auto reorder = buildPacket(ClientOpcode::Get, true);
+    auto ordered = buildPacket(ClientOpcode::Get, false);
+    EXPECT_TRUE(reinterpret_cast<Request*>(reorder.data())->isReorderable());
+    EXPECT_FALSE(reinterpret_cast<Request*>(ordered.data())->isReorderable());
+}
+
+TEST(Request_IsReorderable, OpcodeNotSupported) {
+    auto packet = buildPacket(ClientOpcode::SelectBucket, true);
+    EXPECT_FALSE(reinterpret_cast<Request*>(packet.data())->isReorderable());
+}
@@ -28,6 +28,7 @@
 #include <cctype>
 #include <gsl/gsl>
 #include <iostream>
+#include <mutex>
 #include <unordered_map>
 
 namespace cb {
@@ -53,6 +54,20 @@ static void merge_docs(nlohmann::json& doc1, const nlohmann::json& doc2);
  */
 static std::array<std::atomic<std::chrono::nanoseconds>, 0x100> threshold;
 
+/**
+ * The adaptive slow operation configuration. It's only read once a second
+ * (and for the operations which are slow), so it may use a lock.
+ */
+static std::mutex adaptiveMutex;
+static AdaptiveConfig adaptive;
+
+/**
+ * Parse the "adaptive" entry of the SLA configuration, starting from the
+ * given (current) configuration.
+ */
+static AdaptiveConfig getAdaptiveConfig(const nlohmann::json& doc,
+                                        AdaptiveConfig config);
+
 /**
  * Convert the time to a textual representation which may be used
  * to generate the JSON representation of the SLAs
@@ -106,6 +121,15 @@ nlohmann::json to_json() {
     const auto def = getDefaultValue();
     ret["default"]["slow"] = time2text(def);
 
+    const auto config = getAdaptiveConfig();
+    if (config.enabled) {
+        ret["adaptive"] = {{"enabled", true},
+                           {"percentile", config.percentile},
+                           {"factor", config.factor},
+                           {"minimum", time2text(config.minimum)},
+                           {"log_limit", config.logLimit}};
+    }
+
     for (unsigned int ii = 0; ii < threshold.size(); ++ii) {
         try {
             auto opcode = cb::mcbp::ClientOpcode(ii);
@@ -135,6 +159,11 @@ std::chrono::nanoseconds getSlowOpThreshold(cb::mcbp::ClientOpcode opcode) {
     return threshold[uint8_t(opcode)].load(std::memory_order_relaxed);
 }
 
+AdaptiveConfig getAdaptiveConfig() {
+    std::lock_guard<std::mutex> guard(adaptiveMutex);
+    return adaptive;
+}
+
 /**
  * Read and merge all of the files specified in the system default locations:
  *
@@ -237,8 +266,14 @@ void reconfigure(const std::string& root, const nlohmann::json& override) {
  *       },
  *       "compact_db": {
  *         "slow": "30 m"
+ *       },
+ *       "adaptive": {
+ *         "factor": 4
  *       }
  *     }
+ *
+ * (see AdaptiveConfig for the "adaptive" entry; the members it doesn't
+ * specify keep their current values, unless there's a default entry).
  */
 void reconfigure(const nlohmann::json& doc, bool apply) {
     // Check the version!
@@ -272,9 +307,24 @@ void reconfigure(const nlohmann::json& doc, bool apply) {
         }
     }
 
+    // Like the thresholds, a document with a default entry replaces the
+    // whole adaptive configuration (disabling it if it has none)
+    const bool complete = obj != doc.end();
+    obj = doc.find("adaptive");
+    if (obj != doc.end() || complete) {
+        auto config = complete ? AdaptiveConfig{} : getAdaptiveConfig();
+        if (obj != doc.end()) {
+            config = getAdaptiveConfig(*obj, config);
+        }
+        if (apply) {
+            std::lock_guard<std::mutex> guard(adaptiveMutex);
+            adaptive = config;
+        }
+    }
+
     for (auto it = doc.cbegin(); it != doc.cend(); ++it) {
         if (it.key() == "version" || it.key() == "default" ||
-            it.key() == "comment") {
+            it.key() == "comment" || it.key() == "adaptive") {
             // Ignore these entries
             continue;
         }
@@ -327,6 +377,48 @@ std::chrono::nanoseconds getSlowOpThreshold(const nlohmann::json& doc) {
     }
 }
 
+static AdaptiveConfig getAdaptiveConfig(const nlohmann::json& doc,
+                                        AdaptiveConfig config) {
+    if (!doc.is_object()) {
+        throw std::invalid_argument(
+                "cb::mcbp::sla::reconfigure: 'adaptive' is not an object");
+    }
+
+    // Any adaptive entry enables it, unless it says otherwise
+    config.enabled = true;
+    for (auto it = doc.cbegin(); it != doc.cend(); ++it) {
+        const auto& value = it.value();
+        if (it.key() == "enabled" && value.is_boolean()) {
+            config.enabled = value.get<bool>();
+        } else if (it.key() == "percentile" && value.is_number()) {
+            config.percentile = value.get<double>();
+            if (config.percentile <= 0 || config.percentile >= 100) {
+                throw std::invalid_argument(
+                        "cb::mcbp::sla::reconfigure: 'adaptive' percentile "
+                        "must be between 0 and 100");
+            }
+        } else if (it.key() == "factor" && value.is_number()) {
+            config.factor = value.get<double>();
+            if (config.factor < 1) {
+                throw std::invalid_argument(
+                        "cb::mcbp::sla::reconfigure: 'adaptive' factor must "
+                        "be at least 1");
+            }
+        } else if (it.key() == "minimum") {
+            config.minimum = getSlowOpThreshold(
+                    nlohmann::json{{"slow", value}});
+        } else if (it.key() == "log_limit" && value.is_number_unsigned()) {
+            config.logLimit = value.get<size_t>();
+        } else {
+            throw std::invalid_argument(
+                    "cb::mcbp::sla::reconfigure: Invalid 'adaptive' "
+                    "element '" +
+                    it.key() + "'");
+        }
+    }
+    return config;
+}
+
 static void merge_docs(nlohmann::json& doc1, const nlohmann::json& doc2) {
     for (auto it = doc2.cbegin(); it != doc2.cend(); ++it) {
         if (it.key() == "version" || it.key() == "comment") {
@@ -334,6 +426,15 @@ static void merge_docs(nlohmann::json& doc1, const nlohmann::json& doc2) {
             continue;
         }
 
+        if (it.key() == "adaptive" && it.value().is_object()) {
+            // Merge the members, so an override may change just one
+            for (auto member = it.value().cbegin(); member != it.value().cend();
+                 ++member) {
+                doc1["adaptive"][member.key()] = member.value();
+            }
+            continue;
+        }
+
         // For some reason we don't have a slow entry!
         auto slow = it.value().find("slow");
         if (slow == it.value().end()) {
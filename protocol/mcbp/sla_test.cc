@@ -235,3 +235,72 @@ TEST(McbpSlaReconfig, toJSON) {
     json = cb::mcbp::sla::to_json();
     EXPECT_EQ("1001 ns", json["GET"]["slow"].get<std::string>());
 }
+
+TEST(McbpSlaReconfig, Adaptive) {
+    // An adaptive entry enables it, with the defaults for the members it
+    // doesn't specify
+    auto doc = R"({"version": 1, "default": {"slow": 500},
+                   "adaptive": {"factor": 4}})"_json;
+    cb::mcbp::sla::reconfigure(doc);
+    auto config = cb::mcbp::sla::getAdaptiveConfig();
+    EXPECT_TRUE(config.enabled);
+    EXPECT_EQ(99.9, config.percentile);
+    EXPECT_EQ(4, config.factor);
+    EXPECT_EQ(std::chrono::milliseconds(10), config.minimum);
+    EXPECT_EQ(10, config.logLimit);
+
+    auto json = cb::mcbp::sla::to_json();
+    ASSERT_NE(json.end(), json.find("adaptive"));
+    EXPECT_EQ("10 ms", json["adaptive"]["minimum"].get<std::string>());
+
+    // Without a default entry the other members are left alone
+    doc = R"({"version": 1, "adaptive": {"percentile": 99,
+                                          "minimum": "1 ms",
+                                          "log_limit": 0}})"_json;
+    cb::mcbp::sla::reconfigure(doc);
+    config = cb::mcbp::sla::getAdaptiveConfig();
+    EXPECT_TRUE(config.enabled);
+    EXPECT_EQ(99, config.percentile);
+    EXPECT_EQ(4, config.factor);
+    EXPECT_EQ(std::chrono::milliseconds(1), config.minimum);
+    EXPECT_EQ(0, config.logLimit);
+
+    doc = R"({"version": 1, "adaptive": {"enabled": false}})"_json;
+    cb::mcbp::sla::reconfigure(doc);
+    EXPECT_FALSE(cb::mcbp::sla::getAdaptiveConfig().enabled);
+    json = cb::mcbp::sla::to_json();
+    EXPECT_EQ(json.end(), json.find("adaptive"));
+
+    // An empty entry enables it again, and a document with a default entry
+    // (but no adaptive entry) disables it
+    doc = R"({"version": 1, "adaptive": {}})"_json;
+    cb::mcbp::sla::reconfigure(doc);
+    EXPECT_TRUE(cb::mcbp::sla::getAdaptiveConfig().enabled);
+    doc = R"({"version": 1, "default": {"slow": 500}})"_json;
+    cb::mcbp::sla::reconfigure(doc);
+    EXPECT_FALSE(cb::mcbp::sla::getAdaptiveConfig().enabled);
+}
+
+TEST(McbpSlaReconfig, AdaptiveInvalid) {
+    const std::vector<std::pair<std::string, std::string>> invalid = {
+            {R"("adaptive": true)", "'adaptive' is not an object"},
+            {R"("adaptive": {"percentile": 100})",
+             "'adaptive' percentile must be between 0 and 100"},
+            {R"("adaptive": {"factor": 0.5})",
+             "'adaptive' factor must be at least 1"},
+            {R"("adaptive": {"foo": 1})", "Invalid 'adaptive' element 'foo'"},
+            {R"("adaptive": {"log_limit": -1})",
+             "Invalid 'adaptive' element 'log_limit'"}};
+
+    for (const auto& entry : invalid) {
+        const auto doc =
+                nlohmann::json::parse(R"({"version": 1, )" + entry.first + "}");
+        try {
+            cb::mcbp::sla::reconfigure(doc);
+            FAIL() << "Should not allow " << entry.first;
+        } catch (const std::invalid_argument& e) {
+            EXPECT_EQ("cb::mcbp::sla::reconfigure: " + entry.second,
+                      std::string(e.what()));
+        }
+    }
+}
@@ -273,8 +273,12 @@ PrivilegeAccess PrivilegeDatabase::check(const PrivilegeContext& context,
     return context.check(privilege);
 }
 
+bool PrivilegeContext::isStale() const {
+    return generation != contexts[to_index(domain)].current_generation;
+}
+
 PrivilegeAccess PrivilegeContext::check(Privilege privilege) const {
-    if (generation != contexts[to_index(domain)].current_generation) {
+    if (isStale()) {
         return PrivilegeAccess::Stale;
     }
 
@@ -144,3 +144,10 @@ TEST(PrivilegeDatabaseTest, to_json) {
     cb::rbac::PrivilegeDatabase db(json, cb::rbac::Domain::External);
     EXPECT_EQ(json.dump(2), db.to_json(cb::rbac::Domain::External).dump(2));
 }
+
+TEST(PrivilegeContextTest, InitialContextIsStale) {
+    cb::rbac::PrivilegeContext context{cb::rbac::Domain::Local};
+    EXPECT_TRUE(context.isStale());
+    EXPECT_EQ(cb::rbac::PrivilegeAccess::Stale,
+              context.check(cb::rbac::Privilege::Read));
+}
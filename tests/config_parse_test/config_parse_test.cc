@@ -15,6 +15,7 @@
  *   limitations under the License.
  */
 
+#include <daemon/bucket_throttle.h>
 #include <daemon/settings.h>
 #include <folly/portability/GTest.h>
 #include <getopt.h>
@@ -469,6 +470,7 @@ TEST_F(SettingsTest, ParseLoggerSettings) {
     nlohmann::json obj;
     obj["filename"] = "logs/n_1/memcached.log";
     obj["buffersize"] = 1024;
+    obj["drop_on_overflow"] = true;
     obj["cyclesize"] = 10485760;
     obj["unit_test"] = true;
 
@@ -481,6 +483,7 @@ TEST_F(SettingsTest, ParseLoggerSettings) {
     const auto config = settings.getLoggerConfig();
     EXPECT_EQ("logs/n_1/memcached.log", config.filename);
     EXPECT_EQ(1024, config.buffersize);
+    EXPECT_TRUE(config.drop_on_overflow);
     EXPECT_EQ(10485760, config.cyclesize);
     EXPECT_EQ(true, config.unit_test);
 }
@@ -508,6 +511,132 @@ TEST_F(SettingsTest, StdinListener) {
     }
 }
 
+TEST_F(SettingsTest, PerThreadListeners) {
+    nonBooleanValuesShouldFail("per_thread_listeners");
+
+    nlohmann::json obj;
+    obj["per_thread_listeners"] = true;
+    try {
+        Settings settings(obj);
+        EXPECT_TRUE(settings.isPerThreadListenersEnabled());
+        EXPECT_TRUE(settings.has.per_thread_listeners);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    obj["per_thread_listeners"] = false;
+    try {
+        Settings settings(obj);
+        EXPECT_FALSE(settings.isPerThreadListenersEnabled());
+        EXPECT_TRUE(settings.has.per_thread_listeners);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+}
+
+TEST_F(SettingsTest, NumaAffinity) {
+    nonBooleanValuesShouldFail("numa_affinity");
+
+    nlohmann::json obj;
+    obj["numa_affinity"] = true;
+    try {
+        Settings settings(obj);
+        EXPECT_TRUE(settings.isNumaAffinityEnabled());
+        EXPECT_TRUE(settings.has.numa_affinity);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    obj["numa_affinity"] = false;
+    try {
+        Settings settings(obj);
+        EXPECT_FALSE(settings.isNumaAffinityEnabled());
+        EXPECT_TRUE(settings.has.numa_affinity);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+}
+
+TEST_F(SettingsTest, KeyedTimingsEnabled) {
+    nonBooleanValuesShouldFail("keyed_timings_enabled");
+
+    nlohmann::json obj;
+    obj["keyed_timings_enabled"] = true;
+    Settings settings(obj);
+    EXPECT_TRUE(settings.isKeyedTimingsEnabled());
+    EXPECT_TRUE(settings.has.keyed_timings_enabled);
+}
+
+TEST_F(SettingsTest, BucketThrottle) {
+    nonObjectValuesShouldFail("bucket_throttle");
+
+    nlohmann::json obj;
+    obj["bucket_throttle"] = {{"*", {{"ops_per_sec", 100}}},
+                              {"batch", {{"cpu_usec_per_sec", 1000}}}};
+    Settings settings(obj);
+    EXPECT_TRUE(settings.has.bucket_throttle);
+    EXPECT_EQ(obj["bucket_throttle"],
+              nlohmann::json::parse(settings.getBucketThrottle()));
+
+    // Every entry must be an object of known (unsigned) limits
+    obj["bucket_throttle"] = {{"batch", 10}};
+    expectFail<std::invalid_argument>(obj);
+    obj["bucket_throttle"] = {{"batch", {{"ops_per_sec", -1}}}};
+    expectFail<std::invalid_argument>(obj);
+    obj["bucket_throttle"] = {{"batch", {{"ops_per_sec", "10"}}}};
+    expectFail<std::invalid_argument>(obj);
+    obj["bucket_throttle"] = {{"batch", {{"ops", 10}}}};
+    expectFail<std::invalid_argument>(obj);
+}
+
+TEST(BucketThrottleTest, Lookup) {
+    const auto config = nlohmann::json::parse(
+            R"({"*":{"ops_per_sec":100},
+                "batch":{"ops_per_sec":10,"cpu_usec_per_sec":1000}})");
+
+    auto limits = BucketThrottle::lookup(config, "batch");
+    EXPECT_EQ(10, limits.opsPerSec);
+    EXPECT_EQ(std::chrono::microseconds(1000), limits.cpuPerSec);
+
+    // Buckets not listed get the "*" limits
+    limits = BucketThrottle::lookup(config, "default");
+    EXPECT_EQ(100, limits.opsPerSec);
+    EXPECT_EQ(std::chrono::microseconds(0), limits.cpuPerSec);
+
+    // .. or none at all
+    EXPECT_EQ(BucketThrottle::Limits{},
+              BucketThrottle::lookup(nlohmann::json::parse(R"({"x":{}})"),
+                                     "default"));
+    EXPECT_EQ(BucketThrottle::Limits{},
+              BucketThrottle::lookup(nlohmann::json{}, "default"));
+}
+
+TEST(BucketThrottleTest, OpsBudget) {
+    BucketThrottle throttle;
+    EXPECT_TRUE(throttle.tryStartCommand());
+
+    // 10 ops/s gives a budget of 1 command per window
+    throttle.setLimits({10, std::chrono::microseconds(0)});
+    EXPECT_TRUE(throttle.tryStartCommand());
+    EXPECT_FALSE(throttle.tryStartCommand());
+    EXPECT_GT(throttle.getWindowEnd(), std::chrono::steady_clock::now());
+
+    throttle.reset();
+    EXPECT_TRUE(throttle.tryStartCommand());
+    EXPECT_TRUE(throttle.tryStartCommand());
+}
+
+TEST(BucketThrottleTest, CpuBudget) {
+    BucketThrottle throttle;
+    // 1ms/s gives a budget of 100us per window
+    throttle.setLimits({0, std::chrono::microseconds(1000)});
+    EXPECT_TRUE(throttle.tryStartCommand());
+    throttle.addCpuTime(std::chrono::microseconds(99));
+    EXPECT_TRUE(throttle.tryStartCommand());
+    throttle.addCpuTime(std::chrono::microseconds(1));
+    EXPECT_FALSE(throttle.tryStartCommand());
+}
+
 TEST_F(SettingsTest, TopkeysEnabled) {
     nonBooleanValuesShouldFail("topkeys_enabled");
 
@@ -867,6 +996,39 @@ TEST_F(SettingsTest, system_connections) {
     EXPECT_TRUE(settings.has.system_connections);
 }
 
+TEST_F(SettingsTest, max_unordered_commands) {
+    nonNumericValuesShouldFail("max_unordered_commands");
+
+    nlohmann::json obj;
+    const size_t max = 4;
+    obj["max_unordered_commands"] = max;
+    Settings settings(obj);
+    EXPECT_EQ(max, settings.getMaxUnorderedCommands());
+    EXPECT_TRUE(settings.has.max_unordered_commands);
+}
+
+TEST_F(SettingsTest, sasl_auth_threads) {
+    nonNumericValuesShouldFail("sasl_auth_threads");
+
+    nlohmann::json obj;
+    const size_t threads = 4;
+    obj["sasl_auth_threads"] = threads;
+    Settings settings(obj);
+    EXPECT_EQ(threads, settings.getSaslAuthThreads());
+    EXPECT_TRUE(settings.has.sasl_auth_threads);
+}
+
+TEST_F(SettingsTest, request_sample_interval) {
+    nonNumericValuesShouldFail("request_sample_interval");
+
+    nlohmann::json obj;
+    const size_t interval = 100;
+    obj["request_sample_interval"] = interval;
+    Settings settings(obj);
+    EXPECT_EQ(interval, settings.getRequestSampleInterval());
+    EXPECT_TRUE(settings.has.request_sample_interval);
+}
+
 TEST_F(SettingsTest, SaslMechanisms) {
     nonStringValuesShouldFail("sasl_mechanisms");
 
@@ -961,6 +1123,29 @@ TEST_F(SettingsTest, TracingEnabled) {
     }
 }
 
+TEST_F(SettingsTest, ConnectionRebalance) {
+    nonBooleanValuesShouldFail("connection_rebalance");
+
+    nlohmann::json obj;
+    obj["connection_rebalance"] = true;
+    try {
+        Settings settings(obj);
+        EXPECT_TRUE(settings.isConnectionRebalanceEnabled());
+        EXPECT_TRUE(settings.has.connection_rebalance);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+
+    obj["connection_rebalance"] = false;
+    try {
+        Settings settings(obj);
+        EXPECT_FALSE(settings.isConnectionRebalanceEnabled());
+        EXPECT_TRUE(settings.has.connection_rebalance);
+    } catch (std::exception& exception) {
+        FAIL() << exception.what();
+    }
+}
+
 TEST_F(SettingsTest, ExternalAuthService) {
     nonBooleanValuesShouldFail("external_auth_service");
 
@@ -1455,6 +1640,26 @@ TEST(SettingsUpdateTest, OpcodeAttributesOverrideIsDynamic) {
               settings.getOpcodeAttributesOverride());
 }
 
+TEST(SettingsUpdateTest, BucketThrottleIsDynamic) {
+    Settings settings;
+    Settings updated;
+
+    settings.setBucketThrottle(R"({"*":{"ops_per_sec":100}})");
+    updated.setBucketThrottle(R"({"*":{"ops_per_sec":200}})");
+
+    // Dry-run
+    EXPECT_NO_THROW(settings.updateSettings(updated, false));
+    EXPECT_NE(updated.getBucketThrottle(), settings.getBucketThrottle());
+
+    // with update
+    EXPECT_NO_THROW(settings.updateSettings(updated, true));
+    EXPECT_EQ(updated.getBucketThrottle(), settings.getBucketThrottle());
+
+    // Setting to an empty value drops all of the budgets
+    settings.setBucketThrottle("");
+    EXPECT_EQ("", settings.getBucketThrottle());
+}
+
 TEST(SettingsUpdateTest, OpcodeAttributesMustBeValidFormat) {
     Settings settings;
 
@@ -26,6 +26,8 @@
 #include <platform/backtrace.h>
 #include <atomic>
 #include <memory>
+#include <thread>
+#include <vector>
 
 class ExecutorTest : public ::testing::Test {
 protected:
@@ -392,6 +394,116 @@ TEST_F(StaleTraceDumpRemoverTest, DoesRemove) {
     }
 }
 
+/**
+ * A task of the given class which blocks its executor until released
+ */
+class BlockingTestTask : public Task {
+public:
+    BlockingTestTask(Class taskClass, std::atomic_bool& release)
+        : taskClass(taskClass), release(release) {
+    }
+
+    Status execute() override {
+        while (!release) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return Status::Finished;
+    }
+
+    void notifyExecutionComplete() override {
+        executionComplete.store(true);
+    }
+
+    Class getClass() const override {
+        return taskClass;
+    }
+
+    const Class taskClass;
+    std::atomic_bool& release;
+    std::atomic_bool executionComplete{false};
+};
+
+/*
+ * Tasks queued behind a slow task (on the same executor, as they're
+ * scheduled round robin) are stolen by the idle executors, and the slow
+ * tasks of one class can't occupy all of the executors.
+ */
+TEST_F(ExecutorTest, SlowTasksDontBlockOtherClasses) {
+    std::atomic_bool release{false};
+    std::vector<std::shared_ptr<Task>> slow;
+    for (int ii = 0; ii < 8; ++ii) {
+        slow.emplace_back(std::make_shared<BlockingTestTask>(
+                Task::Class::Stats, release));
+        std::lock_guard<std::mutex> guard(slow.back()->getMutex());
+        executorpool->schedule(slow.back());
+    }
+
+    auto cmd = std::make_shared<BasicTestTask>(1);
+    std::shared_ptr<Task> task = cmd;
+    {
+        std::unique_lock<std::mutex> lock(task->getMutex());
+        executorpool->schedule(task);
+        cmd->cond.wait(lock,
+                       [&cmd]() { return cmd->executionComplete.load(); });
+    }
+    EXPECT_EQ(1, cmd->runcount);
+
+    // The slow tasks all get to run once they're released
+    release = true;
+    for (const auto& t : slow) {
+        const auto& blocking = static_cast<BlockingTestTask&>(*t);
+        while (!blocking.executionComplete) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    EXPECT_EQ(0, executorpool->runqSize());
+}
+
+/*
+ * A task due more than a turn of the futureq's timer wheel away isn't made
+ * runnable when the wheel passes its slot on an earlier turn.
+ */
+TEST_F(ExecutorTest, FarFutureExecution) {
+    using namespace testing;
+
+    MockProcessClockSource mockClock;
+    auto now = std::chrono::steady_clock::now();
+
+    executorpool = std::make_unique<ExecutorPool>(4, mockClock);
+
+    auto cmd = std::make_shared<BasicTestTask>(1);
+    std::shared_ptr<Task> task = cmd;
+
+    std::unique_lock<std::mutex> lock(task->getMutex());
+    executorpool->schedule(task, false);
+
+    auto taskTime = now + std::chrono::seconds(300);
+    task->makeRunnable(taskTime);
+
+    for (int ii = 0; ii < 300; ii += 7) {
+        EXPECT_CALL(mockClock, now())
+                .Times(AtLeast(4))
+                .WillRepeatedly(Return(now + std::chrono::seconds(ii)));
+        lock.unlock();
+        executorpool->clockTick();
+        lock.lock();
+        EXPECT_EQ(1, executorpool->futureqSize());
+    }
+
+    EXPECT_CALL(mockClock, now())
+            .Times(AtLeast(4))
+            .WillRepeatedly(Return(taskTime));
+    lock.unlock();
+    executorpool->clockTick();
+    lock.lock();
+    EXPECT_EQ(0, executorpool->futureqSize());
+
+    if (!cmd->executionComplete) {
+        cmd->cond.wait(lock);
+    }
+    EXPECT_EQ(1, cmd->runcount);
+}
+
 static std::terminate_handler default_terminate_handler;
 
 static void my_terminate_handler() {
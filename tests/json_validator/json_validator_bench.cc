@@ -0,0 +1,73 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks comparing the JsonValidator used for datatype detection with
+ * the JSON_checker it replaced, for typical document sizes.
+ */
+
+#include <JSON_checker.h>
+#include <benchmark/benchmark.h>
+#include <daemon/json_validator.h>
+
+#include <string>
+
+/**
+ * Create a JSON document of (approximately) the given size: an array of
+ * user-profile like objects.
+ */
+static std::string makeDocument(size_t size) {
+    std::string doc("[");
+    for (size_t ii = 0; doc.size() < size; ii++) {
+        doc.append(R"({"id":)" + std::to_string(ii) +
+                   R"(,"name":"Some User Name",)"
+                   R"("email":"some.user@example.com",)"
+                   R"("active":true,"score":3.14159,"tags":["one","two"],)"
+                   R"("address":{"street":"123 Some Street","city":"City"}},)");
+    }
+    doc.back() = ']';
+    return doc;
+}
+
+static void JsonValidatorValidate(benchmark::State& state) {
+    const auto doc = makeDocument(state.range(0));
+    JsonValidator validator;
+    while (state.KeepRunning()) {
+        if (!validator.validate(doc.data(), doc.size())) {
+            state.SkipWithError("Document isn't valid JSON");
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * doc.size());
+}
+
+static void JsonCheckerValidate(benchmark::State& state) {
+    const auto doc = makeDocument(state.range(0));
+    JSON_checker::Validator validator;
+    const auto* ptr = reinterpret_cast<const uint8_t*>(doc.data());
+    while (state.KeepRunning()) {
+        if (!validator.validate(ptr, doc.size())) {
+            state.SkipWithError("Document isn't valid JSON");
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * doc.size());
+}
+
+// 100 bytes to 500KB.
+BENCHMARK(JsonValidatorValidate)->Arg(100)->Arg(1024)->Arg(10240)->Arg(512000);
+BENCHMARK(JsonCheckerValidate)->Arg(100)->Arg(1024)->Arg(10240)->Arg(512000);
+
+BENCHMARK_MAIN()
@@ -0,0 +1,113 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <daemon/json_validator.h>
+#include <folly/portability/GTest.h>
+
+#include <string>
+
+class JsonValidatorTest : public ::testing::Test {
+protected:
+    bool validate(const std::string& value) {
+        return validator.validate(value.data(), value.size());
+    }
+
+    JsonValidator validator;
+};
+
+TEST_F(JsonValidatorTest, Values) {
+    EXPECT_TRUE(validate("{}"));
+    EXPECT_TRUE(validate("[]"));
+    EXPECT_TRUE(validate(R"("string")"));
+    EXPECT_TRUE(validate("1"));
+    EXPECT_TRUE(validate("-0.5e+10"));
+    EXPECT_TRUE(validate("true"));
+    EXPECT_TRUE(validate("false"));
+    EXPECT_TRUE(validate("null"));
+    EXPECT_TRUE(validate(" \t\r\n{ \"a\" : [ 1 , { } ] } \n"));
+    EXPECT_TRUE(validate(R"({"a":[1,2,{"b":null}],"c":"\"\\\/\b\f\n\r\t"})"));
+    EXPECT_TRUE(validate("[[[[]]],[{}]]"));
+}
+
+TEST_F(JsonValidatorTest, Invalid) {
+    EXPECT_FALSE(validate(""));
+    EXPECT_FALSE(validate("  "));
+    EXPECT_FALSE(validate("{"));
+    EXPECT_FALSE(validate("]"));
+    EXPECT_FALSE(validate("[[[]]"));
+    EXPECT_FALSE(validate(R"({"a":1}})"));
+    EXPECT_FALSE(validate(R"({"a":})"));
+    EXPECT_FALSE(validate(R"({"a":1,})"));
+    EXPECT_FALSE(validate("[1,]"));
+    EXPECT_FALSE(validate("[1 2]"));
+    EXPECT_FALSE(validate("{1:2}"));
+    EXPECT_FALSE(validate(R"({"a" 1})"));
+    EXPECT_FALSE(validate("1 2"));
+    EXPECT_FALSE(validate("truex"));
+    EXPECT_FALSE(validate("nul"));
+    EXPECT_FALSE(validate("01"));
+    EXPECT_FALSE(validate("1."));
+    EXPECT_FALSE(validate("-"));
+    EXPECT_FALSE(validate("1e"));
+    EXPECT_FALSE(validate(".5"));
+    EXPECT_FALSE(validate("binary data"));
+}
+
+TEST_F(JsonValidatorTest, Strings) {
+    EXPECT_TRUE(validate(R"("éꯍ")"));
+    EXPECT_FALSE(validate(R"("\u00g9")"));
+    EXPECT_FALSE(validate(R"("\u00")"));
+    EXPECT_FALSE(validate(R"("\q")"));
+    EXPECT_FALSE(validate(R"("unterminated)"));
+    EXPECT_FALSE(validate("\"tab\tinside\""));
+    EXPECT_FALSE(validate(std::string("\"nul\0inside\"", 12)));
+
+    // Long strings are scanned a word at a time; check that whatever we
+    // find at any position (relative to a word) is still seen.
+    for (size_t ii = 0; ii < 16; ii++) {
+        const std::string prefix(ii, 'x');
+        EXPECT_TRUE(validate('"' + prefix + "0123456789abcdef\""));
+        EXPECT_TRUE(validate('"' + prefix + "\\\"0123456789abcdef\""));
+        EXPECT_FALSE(validate('"' + prefix + "\n0123456789abcdef\""));
+        EXPECT_FALSE(validate('"' + prefix + "0123456789abcdef"));
+        EXPECT_TRUE(validate('"' + prefix + "\xc3\xa9" + "0123456789\""));
+        EXPECT_FALSE(validate('"' + prefix + "\xc3" + "0123456789\""));
+    }
+}
+
+TEST_F(JsonValidatorTest, UTF8) {
+    EXPECT_TRUE(validate("\"\xc3\xa9\""));             // U+00E9
+    EXPECT_TRUE(validate("\"\xe2\x82\xac\""));         // U+20AC
+    EXPECT_TRUE(validate("\"\xf0\x9f\x98\x80\""));     // U+1F600
+    EXPECT_TRUE(validate("\"\xf4\x8f\xbf\xbf\""));     // U+10FFFF
+    EXPECT_FALSE(validate("\"\xc3\""));                // Truncated
+    EXPECT_FALSE(validate("\"\xe2\x82\""));            // Truncated
+    EXPECT_FALSE(validate("\"\x80\""));                // Continuation
+    EXPECT_FALSE(validate("\"\xc0\xaf\""));            // Overlong
+    EXPECT_FALSE(validate("\"\xe0\x80\xaf\""));        // Overlong
+    EXPECT_FALSE(validate("\"\xed\xa0\x80\""));        // Surrogate
+    EXPECT_FALSE(validate("\"\xf4\x90\x80\x80\""));    // > U+10FFFF
+    EXPECT_FALSE(validate("\xc3\xa9"));                // Outside a string
+}
+
+// The validator is reused for many documents; an error part way through
+// one mustn't affect the next.
+TEST_F(JsonValidatorTest, Reuse) {
+    EXPECT_FALSE(validate(R"({"a":[[{"b":)"));
+    EXPECT_TRUE(validate("[]"));
+    EXPECT_FALSE(validate("]"));
+}
@@ -19,6 +19,7 @@
 #include <benchmark/benchmark.h>
 #include <daemon/cookie.h>
 #include <daemon/mcbp_validators.h>
+#include <mcbp/protocol/framebuilder.h>
 #include <mcbp/protocol/header.h>
 #include <memcached/protocol_binary.h>
 
@@ -98,7 +99,41 @@ BENCHMARK_DEFINE_F(McbpValidatorBench, AddBench)(benchmark::State& state) {
     }
 }
 
+/// A durable Set carrying an OpenTracing context, decoding both frame infos
+BENCHMARK_DEFINE_F(McbpValidatorBench, DurableTracedSetBench)
+(benchmark::State& state) {
+    using cb::mcbp::request::FrameInfoId;
+    const std::string context{"trace-context"};
+    std::vector<uint8_t> fe;
+    // Durability requirement: level majority
+    fe.push_back(uint8_t(FrameInfoId::DurabilityRequirement) << 4 | 1);
+    fe.push_back(1);
+    fe.push_back(uint8_t(FrameInfoId::OpenTracingContext) << 4 |
+                 uint8_t(context.size()));
+    fe.insert(fe.end(), context.begin(), context.end());
+
+    cb::mcbp::RequestBuilder builder({blob, sizeof(blob)});
+    builder.setMagic(cb::mcbp::Magic::AltClientRequest);
+    builder.setOpcode(cb::mcbp::ClientOpcode::Set);
+    builder.setFramingExtras({fe.data(), fe.size()});
+    cb::mcbp::request::MutationPayload extras;
+    builder.setExtras(extras.getBuffer());
+    builder.setKey("helloworld");
+
+    const auto& req = *reinterpret_cast<const cb::mcbp::Header*>(blob);
+    const size_t size = sizeof(req) + req.getBodylen();
+    cb::const_byte_buffer buffer{blob, size};
+    Cookie cookie(connection);
+
+    while (state.KeepRunning()) {
+        cookie.reset();
+        cookie.setPacket(Cookie::PacketContent::Full, buffer);
+        validator.validate(cb::mcbp::ClientOpcode::Set, cookie);
+    }
+}
+
 BENCHMARK_REGISTER_F(McbpValidatorBench, GetBench);
 BENCHMARK_REGISTER_F(McbpValidatorBench, SetBench);
 BENCHMARK_REGISTER_F(McbpValidatorBench, AddBench);
+BENCHMARK_REGISTER_F(McbpValidatorBench, DurableTracedSetBench);
 BENCHMARK_MAIN()
@@ -16,6 +16,7 @@
  */
 #include "mcbp_test.h"
 
+#include <daemon/cookie.h>
 #include <mcbp/protocol/framebuilder.h>
 
 using cb::mcbp::ClientOpcode;
@@ -71,6 +72,13 @@ TEST_F(FrameExtrasValidatorTests, Reorder) {
     EXPECT_EQ(Status::NotSupported, validate(ClientOpcode::Set, blob));
 }
 
+TEST_F(FrameExtrasValidatorTests, ReorderUnorderedExecution) {
+    connection.setAllowUnorderedExecution(true);
+    auto fe = encodeFrameInfo(FrameInfoId::Reorder, {});
+    builder.setFramingExtras({fe.data(), fe.size()});
+    EXPECT_EQ(Status::Success, validate(ClientOpcode::Set, blob));
+}
+
 TEST_F(FrameExtrasValidatorTests, ReorderInvalidSize) {
     auto fe = encodeFrameInfo(FrameInfoId::Reorder, {blob, 1});
     builder.setFramingExtras({fe.data(), fe.size()});
@@ -159,6 +167,37 @@ TEST_F(FrameExtrasValidatorTests, OpenTracingContextInvalidSize) {
               validate_error_context(ClientOpcode::Set, blob, Status::Einval));
 }
 
+// The validator decodes the frame infos into the cookie, so the executors
+// don't have to parse the framing extras again
+TEST_F(FrameExtrasValidatorTests, FrameInfosDecoded) {
+    uint8_t level = 1;
+    auto fe = encodeFrameInfo(FrameInfoId::DurabilityRequirement, {&level, 1});
+    const uint16_t id = htons(5);
+    const auto sid = encodeFrameInfo(
+            FrameInfoId::DcpStreamId,
+            {reinterpret_cast<const uint8_t*>(&id), sizeof(id)});
+    fe.insert(fe.end(), sid.begin(), sid.end());
+    builder.setFramingExtras({fe.data(), fe.size()});
+
+    const auto& header = *reinterpret_cast<const cb::mcbp::Header*>(blob);
+    Cookie cookie(connection);
+    cookie.setPacket(Cookie::PacketContent::Full,
+                     {blob, sizeof(header) + header.getBodylen()});
+    ASSERT_EQ(Status::Success,
+              validatorChains.validate(ClientOpcode::Set, cookie));
+
+    const auto& frameInfos = cookie.getFrameInfos();
+    ASSERT_TRUE(frameInfos.durability);
+    EXPECT_EQ(cb::durability::Level::Majority,
+              frameInfos.durability->getLevel());
+    EXPECT_EQ(cb::mcbp::DcpStreamId(5), frameInfos.dcpStreamId);
+    EXPECT_FALSE(frameInfos.reorderable);
+
+    cookie.reset();
+    EXPECT_FALSE(cookie.getFrameInfos().durability);
+    EXPECT_EQ(cb::mcbp::DcpStreamId(), cookie.getFrameInfos().dcpStreamId);
+}
+
 TEST_F(FrameExtrasValidatorTests, UnknownFrameId) {
     auto fe = encodeFrameInfo(FrameInfoId(0xff), {});
     builder.setFramingExtras({fe.data(), fe.size()});
@@ -460,6 +460,230 @@ TEST_P(GetKeysValidatorTest, InvalidBodylen) {
     EXPECT_EQ(cb::mcbp::Status::Einval, validate());
 }
 
+class RangeScanValidatorTest : public ::testing::WithParamInterface<bool>,
+                               public ValidatorTest {
+public:
+    RangeScanValidatorTest()
+        : ValidatorTest(GetParam()), req(request.message.header.request) {
+    }
+
+    void SetUp() override {
+        ValidatorTest::SetUp();
+        using cb::mcbp::request::RangeScanPayload;
+        RangeScanPayload payload;
+        payload.setMaxItems(100);
+        auto* ptr = reinterpret_cast<RangeScanPayload*>(request.bytes + 24);
+        memcpy(ptr, &payload, sizeof(payload));
+        req.setExtlen(sizeof(payload));
+        req.setKeylen(2);
+        req.setBodylen(req.getExtlen() + req.getKeylen() + 2);
+    }
+
+protected:
+    cb::mcbp::Request& req;
+    cb::mcbp::Status validate() {
+        return ValidatorTest::validate(cb::mcbp::ClientOpcode::RangeScan,
+                                       static_cast<void*>(&request));
+    }
+};
+
+TEST_P(RangeScanValidatorTest, CorrectMessage) {
+    EXPECT_EQ(cb::mcbp::Status::Success, validate());
+
+    // The end key (value) is optional
+    req.setBodylen(req.getExtlen() + req.getKeylen());
+    EXPECT_EQ(cb::mcbp::Status::Success, validate());
+}
+
+TEST_P(RangeScanValidatorTest, InvalidExtlen) {
+    req.setExtlen(4);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+    req.setExtlen(0);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+}
+
+TEST_P(RangeScanValidatorTest, InvalidKey) {
+    // The start key must be present
+    req.setKeylen(0);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+}
+
+TEST_P(RangeScanValidatorTest, Extras) {
+    using cb::mcbp::request::RangeScanPayload;
+    auto* ptr = reinterpret_cast<RangeScanPayload*>(request.bytes + 24);
+    ptr->setFlags(uint8_t(cb::mcbp::request::RangeScanFlag::KeysOnly));
+    EXPECT_EQ(cb::mcbp::Status::Success, validate());
+    ptr->setFlags(0x2);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+    ptr->setFlags(0);
+    ptr->setMaxItems(0);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+}
+
+TEST_P(RangeScanValidatorTest, IvalidCas) {
+    req.setCas(0xff);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+}
+
+class BulkStoreValidatorTest : public ::testing::WithParamInterface<bool>,
+                               public ValidatorTest {
+public:
+    BulkStoreValidatorTest()
+        : ValidatorTest(GetParam()), req(request.message.header.request) {
+    }
+
+    void SetUp() override {
+        ValidatorTest::SetUp();
+        // Keys of the default collection, valid with or without collections
+        addDocument(std::string{"\0key1", 5}, "value1");
+        addDocument(std::string{"\0key2", 5},
+                    R"({"json":true})",
+                    PROTOCOL_BINARY_DATATYPE_JSON);
+    }
+
+protected:
+    /// Append a document to the value of the request
+    void addDocument(const std::string& key,
+                     const std::string& value,
+                     uint8_t datatype = PROTOCOL_BINARY_RAW_BYTES) {
+        const uint16_t keylen = htons(gsl::narrow<uint16_t>(key.size()));
+        const uint32_t flags = 0xcafefeed;
+        const uint32_t expiry = htonl(10);
+        const uint32_t vallen = htonl(gsl::narrow<uint32_t>(value.size()));
+        auto* ptr =
+                request.bytes + sizeof(cb::mcbp::Request) + req.getBodylen();
+        auto append = [&ptr](const void* data, size_t size) {
+            memcpy(ptr, data, size);
+            ptr += size;
+        };
+        append(&keylen, sizeof(keylen));
+        append(key.data(), key.size());
+        append(&flags, sizeof(flags));
+        append(&expiry, sizeof(expiry));
+        append(&datatype, sizeof(datatype));
+        append(&vallen, sizeof(vallen));
+        append(value.data(), value.size());
+        req.setBodylen(gsl::narrow<uint32_t>(ptr - request.bytes -
+                                             sizeof(cb::mcbp::Request)));
+    }
+
+    cb::mcbp::Request& req;
+    cb::mcbp::Status validate() {
+        return ValidatorTest::validate(cb::mcbp::ClientOpcode::BulkStore,
+                                       static_cast<void*>(&request));
+    }
+};
+
+TEST_P(BulkStoreValidatorTest, CorrectMessage) {
+    EXPECT_EQ(cb::mcbp::Status::Success, validate());
+}
+
+TEST_P(BulkStoreValidatorTest, Parser) {
+    cb::mcbp::request::BulkStoreParser parser(req.getValue());
+    ASSERT_TRUE(parser.isValid());
+    cb::mcbp::request::BulkStoreDocument doc;
+    ASSERT_TRUE(parser.next(doc));
+    EXPECT_EQ(std::string("\0key1", 5),
+              std::string(reinterpret_cast<const char*>(doc.key.data()),
+                          doc.key.size()));
+    EXPECT_EQ(0xcafefeed, doc.flags);
+    EXPECT_EQ(10, doc.expiry);
+    EXPECT_EQ(PROTOCOL_BINARY_RAW_BYTES, doc.datatype);
+    EXPECT_EQ("value1",
+              std::string(reinterpret_cast<const char*>(doc.value.data()),
+                          doc.value.size()));
+    ASSERT_TRUE(parser.next(doc));
+    EXPECT_EQ(PROTOCOL_BINARY_DATATYPE_JSON, doc.datatype);
+    EXPECT_FALSE(parser.next(doc));
+}
+
+TEST_P(BulkStoreValidatorTest, InvalidValue) {
+    // Truncated in the last value, and in the header of the last document
+    req.setBodylen(req.getBodylen() - 1);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+    req.setBodylen(req.getBodylen() - 20);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+    // No documents
+    req.setBodylen(0);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+}
+
+TEST_P(BulkStoreValidatorTest, InvalidKey) {
+    addDocument("", "value");
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+}
+
+TEST_P(BulkStoreValidatorTest, InvalidDatatype) {
+    addDocument(std::string{"\0key3", 5},
+                "value",
+                PROTOCOL_BINARY_DATATYPE_SNAPPY);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+}
+
+TEST_P(BulkStoreValidatorTest, InvalidHeader) {
+    req.setCas(0xff);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+    req.setCas(0);
+    req.setKeylen(2);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+    req.setKeylen(0);
+    req.setExtlen(2);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+}
+
+class GetRandomKeysValidatorTest : public ::testing::WithParamInterface<bool>,
+                                   public ValidatorTest {
+public:
+    GetRandomKeysValidatorTest()
+        : ValidatorTest(GetParam()), req(request.message.header.request) {
+    }
+
+    void SetUp() override {
+        ValidatorTest::SetUp();
+        setCount(10);
+        req.setExtlen(sizeof(cb::mcbp::request::GetRandomKeysPayload));
+        req.setBodylen(req.getExtlen());
+    }
+
+protected:
+    void setCount(uint32_t count) {
+        cb::mcbp::request::GetRandomKeysPayload payload;
+        payload.setCount(count);
+        memcpy(request.bytes + 24, &payload, sizeof(payload));
+    }
+
+    cb::mcbp::Request& req;
+    cb::mcbp::Status validate() {
+        return ValidatorTest::validate(cb::mcbp::ClientOpcode::GetRandomKeys,
+                                       static_cast<void*>(&request));
+    }
+};
+
+TEST_P(GetRandomKeysValidatorTest, CorrectMessage) {
+    EXPECT_EQ(cb::mcbp::Status::Success, validate());
+    setCount(cb::mcbp::request::GetRandomKeysPayload::MaxCount);
+    EXPECT_EQ(cb::mcbp::Status::Success, validate());
+}
+
+TEST_P(GetRandomKeysValidatorTest, InvalidCount) {
+    setCount(0);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+    setCount(cb::mcbp::request::GetRandomKeysPayload::MaxCount + 1);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+}
+
+TEST_P(GetRandomKeysValidatorTest, InvalidHeader) {
+    req.setCas(0xff);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+    req.setCas(0);
+    req.setExtlen(0);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+    req.setExtlen(sizeof(cb::mcbp::request::GetRandomKeysPayload));
+    req.setKeylen(2);
+    req.setBodylen(req.getExtlen() + 2);
+    EXPECT_EQ(cb::mcbp::Status::Einval, validate());
+}
+
 class SetParamValidatorTest : public ::testing::WithParamInterface<bool>,
                               public ValidatorTest {
 public:
@@ -1002,6 +1226,21 @@ INSTANTIATE_TEST_CASE_P(CollectionsOnOff,
                         ::testing::Bool(),
                         ::testing::PrintToStringParamName());
 
+INSTANTIATE_TEST_CASE_P(CollectionsOnOff,
+                        RangeScanValidatorTest,
+                        ::testing::Bool(),
+                        ::testing::PrintToStringParamName());
+
+INSTANTIATE_TEST_CASE_P(CollectionsOnOff,
+                        BulkStoreValidatorTest,
+                        ::testing::Bool(),
+                        ::testing::PrintToStringParamName());
+
+INSTANTIATE_TEST_CASE_P(CollectionsOnOff,
+                        GetRandomKeysValidatorTest,
+                        ::testing::Bool(),
+                        ::testing::PrintToStringParamName());
+
 INSTANTIATE_TEST_CASE_P(CollectionsOnOff,
                         SetParamValidatorTest,
                         ::testing::Bool(),
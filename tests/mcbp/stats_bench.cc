@@ -0,0 +1,124 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks of the front-end threads' stats: the updates on the hot path,
+ * and the aggregation done by a stats request while they keep running.
+ */
+
+#include <benchmark/benchmark.h>
+#include <daemon/stats.h>
+#include <daemon/timings.h>
+
+#include <chrono>
+
+/// The layout of a bucket's per-thread stats before they were padded
+using PackedThreadStats = std::vector<thread_stats>;
+
+static thread_stats& getSlot(PackedThreadStats& slots, size_t index) {
+    return slots[index];
+}
+
+static thread_stats& getSlot(ThreadStatsSlots& slots, size_t index) {
+    return *slots[index];
+}
+
+/// One slot per benchmark thread (ThreadRange(1, 16) below)
+static const size_t numSlots = 16;
+
+template <typename Slots>
+static Slots& getSlots() {
+    static Slots slots(numSlots);
+    return slots;
+}
+
+/// What a front-end thread updates for a GET hit
+static void updateStats(thread_stats& stats) {
+    stats.cmd_get++;
+    stats.get_hits++;
+    stats.bytes_read += 24;
+    stats.bytes_written += 100;
+}
+
+/**
+ * Every thread updates its own slot, as the front-end threads do. Packed
+ * slots share cache lines between neighbouring threads.
+ */
+template <typename Slots>
+static void BM_ThreadStatsUpdate(benchmark::State& state) {
+    auto& stats = getSlot(getSlots<Slots>(), state.thread_index);
+    while (state.KeepRunning()) {
+        updateStats(stats);
+    }
+}
+
+/**
+ * Models a stats request: thread 0 repeatedly aggregates all of the slots
+ * while every other thread keeps updating its own.
+ */
+template <typename Slots>
+static void BM_ThreadStatsCollect(benchmark::State& state) {
+    auto& slots = getSlots<Slots>();
+    while (state.KeepRunning()) {
+        if (state.thread_index == 0) {
+            thread_stats total;
+            for (size_t ii = 0; ii < slots.size(); ++ii) {
+                total += getSlot(slots, ii);
+            }
+            benchmark::DoNotOptimize(total.cmd_get.load());
+        } else {
+            updateStats(getSlot(slots, state.thread_index));
+        }
+    }
+}
+
+/**
+ * Every thread records the duration of a GET in the bucket's Timings, as
+ * each command does once it completes.
+ */
+static void BM_TimingsCollect(benchmark::State& state) {
+    static Timings timings;
+    while (state.KeepRunning()) {
+        timings.collect(cb::mcbp::ClientOpcode::Get,
+                        std::chrono::microseconds(100));
+    }
+}
+
+/**
+ * Models a timings stats request: thread 0 repeatedly generates the GET
+ * histogram while every other thread keeps recording durations.
+ */
+static void BM_TimingsGenerate(benchmark::State& state) {
+    static Timings timings;
+    while (state.KeepRunning()) {
+        if (state.thread_index == 0) {
+            benchmark::DoNotOptimize(
+                    timings.generate(cb::mcbp::ClientOpcode::Get));
+        } else {
+            timings.collect(cb::mcbp::ClientOpcode::Get,
+                            std::chrono::microseconds(100));
+        }
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_ThreadStatsUpdate, PackedThreadStats)->ThreadRange(1, 16);
+BENCHMARK_TEMPLATE(BM_ThreadStatsUpdate, ThreadStatsSlots)->ThreadRange(1, 16);
+BENCHMARK_TEMPLATE(BM_ThreadStatsCollect, PackedThreadStats)
+        ->ThreadRange(2, 16);
+BENCHMARK_TEMPLATE(BM_ThreadStatsCollect, ThreadStatsSlots)->ThreadRange(2, 16);
+BENCHMARK(BM_TimingsCollect)->ThreadRange(1, 16);
+BENCHMARK(BM_TimingsGenerate)->ThreadRange(2, 16);
@@ -0,0 +1,92 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+#include <benchmark/benchmark.h>
+#include <xattr/blob.h>
+
+#include <memory>
+#include <string>
+
+/**
+ * Benchmark the xattr operations used on the GET and DCP paths for documents
+ * with a lot of xattrs (such as Sync Gateway metadata or transaction
+ * records). The argument is the number of system xattrs; the blob contains as
+ * many user xattrs (interleaved with them), each with a 256 byte value.
+ */
+class XattrBlobBench : public ::benchmark::Fixture {
+public:
+    void SetUp(benchmark::State& state) override {
+        blob = std::make_unique<cb::xattr::Blob>();
+        const std::string value = "\"" + std::string(254, 'x') + "\"";
+        for (int64_t ii = 0; ii < state.range(0); ++ii) {
+            blob->set("_sys" + std::to_string(ii), value);
+            blob->set("user" + std::to_string(ii), value);
+        }
+        lastSystemKey = "_sys" + std::to_string(state.range(0) - 1);
+    }
+
+    void TearDown(benchmark::State& state) override {
+        blob.reset();
+    }
+
+protected:
+    std::unique_ptr<cb::xattr::Blob> blob;
+    std::string lastSystemKey;
+};
+
+/// Look up the last system xattr (as done by subdoc lookups)
+BENCHMARK_DEFINE_F(XattrBlobBench, Get)(benchmark::State& state) {
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(blob->get(lastSystemKey));
+    }
+}
+
+/// Calculate the size of the system xattrs (as done for DCP and GET
+/// responses which strip the user xattrs)
+BENCHMARK_DEFINE_F(XattrBlobBench, GetSystemSize)(benchmark::State& state) {
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(blob->get_system_size());
+    }
+}
+
+/// Strip the user xattrs from a copy of the blob (as done on deletion and
+/// expiry)
+BENCHMARK_DEFINE_F(XattrBlobBench, PruneUserKeys)(benchmark::State& state) {
+    while (state.KeepRunning()) {
+        cb::xattr::Blob copy(*blob);
+        copy.prune_user_keys();
+        benchmark::DoNotOptimize(copy.size());
+    }
+}
+
+/// Iterate over all of the xattrs (as done when building the JSON
+/// representation)
+BENCHMARK_DEFINE_F(XattrBlobBench, Iterate)(benchmark::State& state) {
+    while (state.KeepRunning()) {
+        size_t size = 0;
+        for (const auto& kv : *blob) {
+            size += kv.second.size();
+        }
+        benchmark::DoNotOptimize(size);
+    }
+}
+
+BENCHMARK_REGISTER_F(XattrBlobBench, Get)->Arg(1)->Arg(16)->Arg(128);
+BENCHMARK_REGISTER_F(XattrBlobBench, GetSystemSize)->Arg(1)->Arg(16)->Arg(128);
+BENCHMARK_REGISTER_F(XattrBlobBench, PruneUserKeys)->Arg(1)->Arg(16)->Arg(128);
+BENCHMARK_REGISTER_F(XattrBlobBench, Iterate)->Arg(1)->Arg(16)->Arg(128);
+
+BENCHMARK_MAIN()
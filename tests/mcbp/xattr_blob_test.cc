@@ -125,6 +125,28 @@ TEST(XattrBlob, TestPruneUser) {
     EXPECT_EQ(std::string{"{\"foo\":\"bar\"}"}, to_string(blob.get("_rbac")));
 }
 
+TEST(XattrBlob, TestPruneUserInterleaved) {
+    cb::xattr::Blob blob;
+    cb::xattr::Blob expected;
+    for (int ii = 0; ii < 10; ++ii) {
+        const auto value = "{\"id\":" + std::to_string(ii) + "}";
+        blob.set("user" + std::to_string(ii), value);
+        blob.set("_sys" + std::to_string(ii), value);
+        expected.set("_sys" + std::to_string(ii), value);
+    }
+
+    blob.prune_user_keys();
+    validate(blob.finalize());
+    EXPECT_EQ(to_string(expected.finalize()), to_string(blob.finalize()));
+
+    // Pruning a blob with only user xattrs leaves it empty
+    cb::xattr::Blob user;
+    user.set("user", "{\"author\":\"bubba\"}");
+    user.set("meta", "{\"content-type\":\"text\"}");
+    user.prune_user_keys();
+    EXPECT_EQ(0, user.finalize().len);
+}
+
 TEST(XattrBlob, TestToJson) {
     cb::xattr::Blob blob;
     blob.set("_sync",
@@ -0,0 +1,102 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "daemon/pipe_pool.h"
+#include <folly/portability/GTest.h>
+#include <platform/pipe.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+TEST(PipePoolTest, AllocateRoundsUpToSizeClass) {
+    PipePool pool;
+    bool allocated = false;
+    auto pipe = pool.allocate(100, &allocated);
+    EXPECT_TRUE(allocated);
+    EXPECT_EQ(PipePool::MinSize, pipe->capacity());
+
+    pipe = pool.allocate(PipePool::MinSize + 1);
+    EXPECT_EQ(PipePool::MinSize * 4, pipe->capacity());
+}
+
+TEST(PipePoolTest, ReleasedPipesAreReused) {
+    PipePool pool;
+    auto pipe = pool.allocate(PipePool::MinSize);
+    const auto* buffer = pipe->wdata().data();
+    pool.release(std::move(pipe));
+    EXPECT_EQ(1, pool.size());
+    EXPECT_EQ(PipePool::MinSize, pool.getCachedBytes());
+
+    bool allocated = true;
+    pipe = pool.allocate(PipePool::MinSize, &allocated);
+    EXPECT_FALSE(allocated);
+    EXPECT_EQ(buffer, pipe->wdata().data());
+    EXPECT_EQ(0, pool.size());
+}
+
+TEST(PipePoolTest, CacheIsBounded) {
+    PipePool pool;
+    const size_t size = PipePool::MaxCachedSize;
+    pool.release(pool.allocate(size));
+    pool.release(pool.allocate(size));
+    // Only one buffer of the largest cached class is kept
+    EXPECT_EQ(1, pool.size());
+
+    // ... and larger buffers aren't cached at all
+    pool.release(pool.allocate(size * 4));
+    EXPECT_EQ(1, pool.size());
+    EXPECT_EQ(size, pool.getCachedBytes());
+
+    // The small classes are bounded by MaxCachedBytesPerClass
+    std::vector<std::unique_ptr<cb::Pipe>> pipes;
+    const auto limit = PipePool::MaxCachedBytesPerClass / PipePool::MinSize;
+    for (size_t ii = 0; ii < limit + 10; ++ii) {
+        pipes.push_back(pool.allocate(PipePool::MinSize));
+    }
+    for (auto& pipe : pipes) {
+        pool.release(std::move(pipe));
+    }
+    EXPECT_EQ(limit + 1, pool.size());
+}
+
+TEST(PipePoolTest, EnsureCapacityMovesToLargerClass) {
+    PipePool pool;
+    auto pipe = pool.allocate(PipePool::MinSize);
+    const std::string data = "Hello world";
+    std::copy(data.begin(), data.end(), pipe->wdata().begin());
+    pipe->produced(data.size());
+
+    // Fits in the existing buffer; nothing moves
+    const auto* buffer = pipe->rdata().data();
+    pool.ensureCapacity(pipe, 100);
+    EXPECT_EQ(buffer, pipe->rdata().data());
+
+    // Needs a bigger one, sized for the whole packet in one go
+    const size_t needed = 1024 * 1024;
+    pool.ensureCapacity(pipe, needed);
+    EXPECT_LE(data.size() + needed, pipe->capacity());
+    EXPECT_LE(needed, pipe->wsize());
+    const auto rdata = pipe->rdata();
+    EXPECT_EQ(data,
+              std::string(reinterpret_cast<const char*>(rdata.data()),
+                          rdata.size()));
+
+    // The old buffer went back to the pool
+    EXPECT_EQ(1, pool.size());
+    EXPECT_EQ(PipePool::MinSize, pool.getCachedBytes());
+}
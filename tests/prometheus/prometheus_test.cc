@@ -0,0 +1,93 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "daemon/prometheus.h"
+#include <folly/portability/GTest.h>
+
+#include <string>
+
+using cb::metrics::Cardinality;
+
+static const std::string dropped =
+        "# HELP kv_metrics_dropped_series The series dropped as there were "
+        "more than the max\n"
+        "# TYPE kv_metrics_dropped_series gauge\n";
+
+TEST(PrometheusRendererTest, CountersAndGauges) {
+    PrometheusRenderer renderer(Cardinality::Low);
+    renderer.addCounter("cmd_get", "Reads", {}, 10);
+    renderer.setConstantLabels({{"bucket", "default"}});
+    renderer.addGauge("vb_num", "vBuckets", {{"state", "active"}}, 512);
+    renderer.addGauge("vb_num", "vBuckets", {{"state", "replica"}}, 0.5);
+
+    EXPECT_EQ(
+            "# HELP kv_cmd_get Reads\n"
+            "# TYPE kv_cmd_get counter\n"
+            "kv_cmd_get 10\n"
+            "# HELP kv_vb_num vBuckets\n"
+            "# TYPE kv_vb_num gauge\n"
+            "kv_vb_num{bucket=\"default\",state=\"active\"} 512\n"
+            "kv_vb_num{bucket=\"default\",state=\"replica\"} 0.5\n" +
+                    dropped + "kv_metrics_dropped_series 0\n",
+            renderer.finish());
+}
+
+TEST(PrometheusRendererTest, Histogram) {
+    PrometheusRenderer renderer(Cardinality::Low);
+    cb::metrics::HistogramData histogram;
+    histogram.buckets = {{1, 2}, {2, 5}};
+    histogram.count = 6;
+    histogram.sum = 12;
+    renderer.addHistogram(
+            "cmd_duration", "Time", {{"opcode", "GET"}}, histogram);
+
+    EXPECT_EQ(
+            "# HELP kv_cmd_duration Time\n"
+            "# TYPE kv_cmd_duration histogram\n"
+            "kv_cmd_duration_bucket{opcode=\"GET\",le=\"1\"} 2\n"
+            "kv_cmd_duration_bucket{opcode=\"GET\",le=\"2\"} 5\n"
+            "kv_cmd_duration_bucket{opcode=\"GET\",le=\"+Inf\"} 6\n"
+            "kv_cmd_duration_sum{opcode=\"GET\"} 12\n"
+            "kv_cmd_duration_count{opcode=\"GET\"} 6\n" +
+                    dropped + "kv_metrics_dropped_series 0\n",
+            renderer.finish());
+}
+
+TEST(PrometheusRendererTest, LabelValuesAreEscaped) {
+    PrometheusRenderer renderer(Cardinality::Low);
+    renderer.addGauge("g", "Help", {{"name", "a\"b\\c\nd"}}, 1);
+    const auto text = renderer.finish();
+    EXPECT_NE(std::string::npos, text.find(R"(kv_g{name="a\"b\\c\nd"} 1)"))
+            << text;
+}
+
+TEST(PrometheusRendererTest, SeriesBeyondTheMaxAreDropped) {
+    PrometheusRenderer renderer(Cardinality::High, 2);
+    EXPECT_EQ(Cardinality::High, renderer.getCardinality());
+    renderer.addGauge("g", "Help", {{"id", "0"}}, 1);
+    renderer.addGauge("g", "Help", {{"id", "1"}}, 1);
+    renderer.addGauge("g", "Help", {{"id", "2"}}, 1);
+    // A histogram is a series per bucket (and for the sum and count)
+    renderer.addHistogram("h", "Help", {}, {});
+    EXPECT_EQ(4u, renderer.getDroppedSeries());
+
+    const auto text = renderer.finish();
+    EXPECT_EQ(std::string::npos, text.find("id=\"2\"")) << text;
+    EXPECT_EQ(std::string::npos, text.find("kv_h")) << text;
+    EXPECT_NE(std::string::npos, text.find("kv_metrics_dropped_series 4"))
+            << text;
+}
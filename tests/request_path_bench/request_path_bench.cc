@@ -0,0 +1,307 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/*
+ * Benchmarks of the full request path of memcached: the packet validation,
+ * dispatch, engine call and response write of every command.
+ *
+ * The server runs embedded in the benchmark process (in the same way as
+ * memcached_testapp -e) with a single default_engine bucket, and each
+ * benchmark drives one connection (over the loopback interface, plain or
+ * TLS) with a mix of GET and SET commands of a given value size, sending
+ * a batch of `depth` pipelined commands before reading their responses.
+ *
+ * Besides the time per batch it reports the operations per second, and
+ * (when memcached is built with an allocator supporting the allocation
+ * hooks, i.e. jemalloc) the number of allocations made per operation by
+ * the whole process - that is both by the server and (a small constant
+ * number) by the client.
+ */
+
+#include <benchmark/benchmark.h>
+#include <daemon/alloc_hooks.h>
+#include <mcbp/protocol/response.h>
+#include <nlohmann/json.hpp>
+#include <platform/dirutils.h>
+#include <platform/platform_thread.h>
+#include <protocol/connection/client_connection.h>
+#include <protocol/connection/client_connection_map.h>
+#include <protocol/connection/client_mcbp_commands.h>
+
+#include <getopt.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+extern "C" int memcached_main(int argc, char** argv);
+extern void shutdown_server();
+
+/// The number of distinct keys (and commands) used by each benchmark
+static const int NumKeys = 100;
+
+static std::atomic<uint64_t> allocations{0};
+
+static void countAllocation(const void*, size_t) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * The memcached server, running in a thread of the benchmark process
+ */
+class EmbeddedServer {
+public:
+    void start();
+
+    void stop();
+
+    /**
+     * Create a new connection to the server, authenticated and connected
+     * to the benchmark bucket.
+     */
+    std::unique_ptr<MemcachedConnection> connect(bool tls);
+
+private:
+    static void threadMain(void* arg);
+
+    void waitForPortFile();
+
+    std::string configFile;
+    std::string portFile;
+    cb_thread_t thread;
+    ConnectionMap connectionMap;
+};
+
+void EmbeddedServer::start() {
+    const std::string cwd = cb::io::getcwd();
+    const std::string source = SOURCE_ROOT;
+    configFile = cwd + "/" + cb::io::mktemp("request_path_bench.json");
+    portFile = cwd + "/" + cb::io::mktemp("request_path_bench.ports");
+    cb::io::rmrf(portFile);
+
+    nlohmann::json config = {
+            {"stdin_listener", false},
+            {"error_maps_dir", source + "/etc/couchbase/kv/error_maps"},
+            {"rbac_file", source + "/tests/testapp/rbac.json"},
+            {"ssl_cipher_list", "HIGH"},
+            {"logger", {{"unit_test", true}, {"console", false}}}};
+    config["interfaces"][0] = {{"tag", "plain"},
+                               {"port", 0},
+                               {"ipv4", "required"},
+                               {"ipv6", "off"},
+                               {"host", "127.0.0.1"}};
+    config["interfaces"][1] = {
+            {"tag", "ssl"},
+            {"port", 0},
+            {"ipv4", "required"},
+            {"ipv6", "off"},
+            {"host", "127.0.0.1"},
+            {"ssl",
+             {{"key", source + "/tests/cert/testapp.pem"},
+              {"cert", source + "/tests/cert/testapp.cert"}}}};
+
+    std::ofstream out(configFile);
+    out << config.dump(2);
+    out.close();
+
+    static std::string pwfile = "CBSASL_PWFILE=" + source +
+                                "/tests/testapp/cbsaslpw.json";
+    putenv(const_cast<char*>(pwfile.c_str()));
+    static std::string portEnv = "MEMCACHED_PORT_FILENAME=" + portFile;
+    putenv(const_cast<char*>(portEnv.c_str()));
+
+    if (cb_create_thread(&thread,
+                         threadMain,
+                         const_cast<char*>(configFile.c_str()),
+                         0) != 0) {
+        throw std::runtime_error("Failed to start the memcached thread");
+    }
+    waitForPortFile();
+
+    auto conn = connectionMap.getConnection(false).clone();
+    conn->authenticate("@admin", "password", "PLAIN");
+    conn->createBucket("default", "", BucketType::Memcached);
+}
+
+void EmbeddedServer::threadMain(void* arg) {
+    char* argv[3];
+    int argc = 0;
+    argv[argc++] = const_cast<char*>("./memcached");
+    argv[argc++] = const_cast<char*>("-C");
+    argv[argc++] = reinterpret_cast<char*>(arg);
+
+    // Reset getopt()'s optind so memcached_main starts from the first
+    // argument.
+    optind = 1;
+
+    memcached_main(argc, argv);
+}
+
+void EmbeddedServer::waitForPortFile() {
+    using std::chrono::steady_clock;
+    const auto timeout = steady_clock::now() + std::chrono::minutes(1);
+    while (!cb::io::isFile(portFile)) {
+        if (steady_clock::now() > timeout) {
+            throw std::runtime_error("Timed out waiting for memcached to "
+                                     "create the port file " +
+                                     portFile);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    connectionMap.initialize(
+            nlohmann::json::parse(cb::io::loadFile(portFile)));
+    cb::io::rmrf(portFile);
+}
+
+std::unique_ptr<MemcachedConnection> EmbeddedServer::connect(bool tls) {
+    auto conn = connectionMap.getConnection(tls).clone();
+    conn->authenticate("@admin", "password", "PLAIN");
+    conn->selectBucket("default");
+    return conn;
+}
+
+void EmbeddedServer::stop() {
+    connectionMap.invalidate();
+    shutdown_server();
+    cb_join_thread(thread);
+    cb::io::rmrf(configFile);
+    cb::io::rmrf(portFile);
+}
+
+static EmbeddedServer server;
+
+static std::string getKey(int index) {
+    return "request_path_bench_" + std::to_string(index);
+}
+
+/**
+ * Encode the NumKeys commands to send: getPercent of them GETs and the rest
+ * SETs, spread evenly.
+ */
+static std::vector<std::vector<uint8_t>> encodeCommands(int getPercent,
+                                                        size_t valueSize) {
+    const std::string value(valueSize, 'x');
+    std::vector<std::vector<uint8_t>> ret(NumKeys);
+    for (int ii = 0; ii < NumKeys; ++ii) {
+        if ((ii * 37) % 100 < getPercent) {
+            BinprotGetCommand cmd;
+            cmd.setKey(getKey(ii));
+            cmd.encode(ret[ii]);
+        } else {
+            BinprotMutationCommand cmd;
+            cmd.setKey(getKey(ii));
+            cmd.setMutationType(MutationType::Set);
+            cmd.addValueBuffer({reinterpret_cast<const uint8_t*>(value.data()),
+                                value.size()});
+            cmd.encode(ret[ii]);
+        }
+    }
+    return ret;
+}
+
+/**
+ * Arguments: the percentage of GETs (the rest are SETs), the value size,
+ * the number of commands pipelined per batch and TLS (0 or 1).
+ */
+static void RequestPathBench(benchmark::State& state) {
+    const auto getPercent = int(state.range(0));
+    const auto valueSize = size_t(state.range(1));
+    const auto depth = int(state.range(2));
+    const bool tls = state.range(3) != 0;
+
+    auto conn = server.connect(tls);
+
+    // Store all of the documents first, so that every GET is a hit.
+    const std::string value(valueSize, 'x');
+    for (int ii = 0; ii < NumKeys; ++ii) {
+        Document doc;
+        doc.info.id = getKey(ii);
+        doc.value = value;
+        conn->mutate(doc, Vbid(0), MutationType::Set);
+    }
+
+    // Encode the batches up front, so the loop only measures the server
+    // (and the client socket calls).
+    const auto commands = encodeCommands(getPercent, valueSize);
+    std::vector<Frame> batches(NumKeys);
+    for (int ii = 0; ii < NumKeys; ++ii) {
+        for (int jj = 0; jj < depth; ++jj) {
+            const auto& cmd = commands[(ii * depth + jj) % NumKeys];
+            batches[ii].payload.insert(
+                    batches[ii].payload.end(), cmd.begin(), cmd.end());
+        }
+    }
+
+    Frame response;
+    size_t next = 0;
+    const auto allocationsBefore = allocations.load();
+    while (state.KeepRunning()) {
+        conn->sendFrame(batches[next]);
+        next = (next + 1) % batches.size();
+        for (int ii = 0; ii < depth; ++ii) {
+            conn->recvFrame(response);
+            const auto status = response.getResponse()->getStatus();
+            if (status != cb::mcbp::Status::Success) {
+                state.SkipWithError(("Unexpected status: " + to_string(status))
+                                            .c_str());
+                break;
+            }
+        }
+    }
+
+    const auto ops = state.iterations() * depth;
+    state.SetItemsProcessed(ops);
+    if (ops != 0 && allocations.load() != allocationsBefore) {
+        state.counters["AllocsPerOp"] =
+                double(allocations.load() - allocationsBefore) / ops;
+    }
+}
+
+static void RequestPathArguments(benchmark::internal::Benchmark* bench) {
+    for (int tls : {0, 1}) {
+        for (int depth : {1, 16}) {
+            for (int valueSize : {32, 4096}) {
+                for (int getPercent : {100, 80, 0}) {
+                    bench->Args({getPercent, valueSize, depth, tls});
+                }
+            }
+        }
+    }
+}
+
+// The work is done by the server's threads, so wall clock time is what counts
+BENCHMARK(RequestPathBench)->Apply(RequestPathArguments)->UseRealTime();
+
+int main(int argc, char** argv) {
+    ::benchmark::Initialize(&argc, argv);
+    try {
+        server.start();
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to start memcached: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Only supported with jemalloc, in which case AllocsPerOp is reported
+    AllocHooks::add_new_hook(countAllocation);
+    ::benchmark::RunSpecifiedBenchmarks();
+    AllocHooks::remove_new_hook(countAllocation);
+
+    server.stop();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,90 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "daemon/stats_delta.h"
+#include <folly/portability/GTest.h>
+
+#include <string>
+
+TEST(StatsDeltaTest, OnlyChangedValuesAreSent) {
+    StatsDeltaSnapshot snapshot;
+    snapshot.beginPoll();
+    EXPECT_TRUE(snapshot.update("vb_0:state", "active"));
+    EXPECT_TRUE(snapshot.update("vb_0:high_seqno", "10"));
+    snapshot.endPoll();
+
+    snapshot.beginPoll();
+    EXPECT_FALSE(snapshot.update("vb_0:state", "active"));
+    EXPECT_TRUE(snapshot.update("vb_0:high_seqno", "11"));
+    snapshot.endPoll();
+
+    snapshot.beginPoll();
+    EXPECT_FALSE(snapshot.update("vb_0:state", "active"));
+    EXPECT_FALSE(snapshot.update("vb_0:high_seqno", "11"));
+    snapshot.endPoll();
+    EXPECT_EQ(2u, snapshot.size());
+}
+
+TEST(StatsDeltaTest, UnreportedStatsAreForgotten) {
+    StatsDeltaSnapshot snapshot;
+    snapshot.beginPoll();
+    EXPECT_TRUE(snapshot.update("eq_dcpq:conn1:items_sent", "5"));
+    EXPECT_TRUE(snapshot.update("eq_dcpq:conn2:items_sent", "7"));
+    snapshot.endPoll();
+
+    // conn2 went away...
+    snapshot.beginPoll();
+    EXPECT_FALSE(snapshot.update("eq_dcpq:conn1:items_sent", "5"));
+    snapshot.endPoll();
+    EXPECT_EQ(1u, snapshot.size());
+
+    // ... and when it comes back it's sent in full again
+    snapshot.beginPoll();
+    EXPECT_FALSE(snapshot.update("eq_dcpq:conn1:items_sent", "5"));
+    EXPECT_TRUE(snapshot.update("eq_dcpq:conn2:items_sent", "7"));
+    snapshot.endPoll();
+}
+
+TEST(StatsDeltaTest, GroupsAreIndependent) {
+    StatsDeltaCache cache;
+    auto& dcp = cache.beginPoll("dcp");
+    EXPECT_TRUE(dcp.update("key", "value"));
+    dcp.endPoll();
+
+    auto& checkpoint = cache.beginPoll("checkpoint");
+    EXPECT_TRUE(checkpoint.update("key", "value"));
+    checkpoint.endPoll();
+
+    auto& again = cache.beginPoll("dcp");
+    EXPECT_EQ(&dcp, &again);
+    EXPECT_FALSE(again.update("key", "value"));
+}
+
+TEST(StatsDeltaTest, GroupsAreBounded) {
+    StatsDeltaCache cache;
+    for (size_t ii = 0; ii < StatsDeltaCache::MaxGroups; ++ii) {
+        cache.beginPoll("vbucket-details " + std::to_string(ii));
+    }
+    EXPECT_EQ(StatsDeltaCache::MaxGroups, cache.size());
+
+    // Polling a known group doesn't drop anything
+    cache.beginPoll("vbucket-details 0");
+    EXPECT_EQ(StatsDeltaCache::MaxGroups, cache.size());
+
+    cache.beginPoll("dcp");
+    EXPECT_EQ(1u, cache.size());
+}
@@ -16,6 +16,7 @@
  */
 
 #include "testapp_xattr.h"
+#include <platform/compress.h>
 #include <cctype>
 #include <limits>
 #include <thread>
@@ -204,6 +205,41 @@ TEST_P(ClusterConfigTest, CccpPushNotification) {
     EXPECT_EQ(R"({"rev":666})", config);
 }
 
+/// Clients which enabled Snappy get the config pushed compressed
+TEST_P(ClusterConfigTest, CccpPushNotificationSnappy) {
+    auto& conn = getAdminConnection();
+    conn.selectBucket("default");
+
+    auto second = conn.clone();
+
+    second->setDuplexSupport(true);
+    second->setClustermapChangeNotification(true);
+    second->setFeature(cb::mcbp::Feature::SNAPPY, true);
+
+    const std::string clustermap =
+            R"({"rev":667,"nodes":")" + std::string(4096, 'x') + R"("})";
+    BinprotResponse response;
+    conn.executeCommand(BinprotSetClusterConfigCommand{token, clustermap},
+                        response);
+
+    Frame frame;
+    second->recvFrame(frame);
+    auto* request = frame.getRequest();
+    EXPECT_EQ(cb::mcbp::ServerOpcode::ClustermapChangeNotification,
+              request->getServerOpcode());
+    EXPECT_EQ(uint8_t(cb::mcbp::Datatype::JSON) |
+                      uint8_t(cb::mcbp::Datatype::Snappy),
+              uint8_t(request->getDatatype()));
+
+    auto value = request->getValue();
+    cb::compression::Buffer inflated;
+    ASSERT_TRUE(cb::compression::inflate(
+            cb::compression::Algorithm::Snappy,
+            {reinterpret_cast<const char*>(value.data()), value.size()},
+            inflated));
+    EXPECT_EQ(clustermap, std::string(inflated.data(), inflated.size()));
+}
+
 TEST_P(ClusterConfigTest, SetGlobalClusterConfig) {
     // Set one for the default bucket
     setClusterConfig(token, R"({"rev":1000})");
@@ -19,6 +19,7 @@
 #include "testapp_client_test.h"
 
 #include <platform/compress.h>
+#include <protocol/connection/client_pipeline.h>
 #include <algorithm>
 #include <gsl/gsl>
 
@@ -603,6 +604,47 @@ TEST_P(GetSetTest, TestGetSuccess) {
     EXPECT_EQ(document.value, stored.value);
 }
 
+/// A bulk get (a run of GETKQ terminated by a NOOP, all in the input buffer
+/// at once) returns the hits, in order, followed by the NOOP
+TEST_P(GetSetTest, TestPipelinedQuietGets) {
+    MemcachedConnection& conn = getConnection();
+    std::vector<std::string> keys;
+    for (int ii = 0; ii < 10; ++ii) {
+        keys.push_back(name + "_" + std::to_string(ii));
+        if (ii % 3 != 0) {
+            store_document(keys.back(), std::to_string(ii));
+        }
+    }
+
+    Frame frame;
+    for (const auto& key : keys) {
+        std::vector<uint8_t> buf;
+        BinprotGenericCommand(cb::mcbp::ClientOpcode::Getkq, key).encode(buf);
+        std::copy(buf.begin(), buf.end(), std::back_inserter(frame.payload));
+    }
+    std::vector<uint8_t> buf;
+    BinprotGenericCommand(cb::mcbp::ClientOpcode::Noop).encode(buf);
+    std::copy(buf.begin(), buf.end(), std::back_inserter(frame.payload));
+    conn.sendFrame(frame);
+
+    for (int ii = 0; ii < 10; ++ii) {
+        if (ii % 3 == 0) {
+            continue;
+        }
+        BinprotResponse rsp;
+        conn.recvResponse(rsp);
+        ASSERT_EQ(cb::mcbp::ClientOpcode::Getkq, rsp.getOp());
+        ASSERT_TRUE(rsp.isSuccess());
+        EXPECT_EQ(keys[ii], rsp.getKeyString());
+        EXPECT_EQ(std::to_string(ii), rsp.getDataString());
+    }
+
+    BinprotResponse rsp;
+    conn.recvResponse(rsp);
+    EXPECT_EQ(cb::mcbp::ClientOpcode::Noop, rsp.getOp());
+    EXPECT_TRUE(rsp.isSuccess());
+}
+
 TEST_P(GetSetTest, TestAppend) {
     MemcachedConnection& conn = getConnection();
     document.info.datatype = cb::mcbp::Datatype::Raw;
@@ -1155,3 +1197,40 @@ TEST_P(GetSetTest, ServerRejectsLargeSizeWithXattr) {
 TEST_P(GetSetTest, ServerRejectsLargeSizeWithXattrCompressed) {
     doTestServerRejectsLargeSizeWithXattr(/*compressedSource*/true);
 }
+
+// Test that the pipeline keeps no more than its window of commands
+// outstanding, and reports each response to the command which sent it
+TEST_P(GetSetTest, Pipeline) {
+    const size_t window = 4;
+    const int count = 20;
+    MemcachedPipeline pipeline(getConnection(), window);
+
+    int stored = 0;
+    for (int ii = 0; ii < count; ++ii) {
+        BinprotMutationCommand cmd;
+        cmd.setMutationType(MutationType::Set);
+        cmd.setKey(name + std::to_string(ii));
+        cmd.setValue(std::to_string(ii));
+        pipeline.submit(cmd, [&stored](BinprotResponse& rsp) {
+            EXPECT_TRUE(rsp.isSuccess()) << to_string(rsp.getStatus());
+            ++stored;
+        });
+        EXPECT_LE(pipeline.getOutstanding(), window);
+    }
+    pipeline.wait();
+    EXPECT_EQ(count, stored);
+    EXPECT_EQ(0, pipeline.getOutstanding());
+
+    std::vector<std::future<BinprotResponse>> gets;
+    for (int ii = 0; ii < count; ++ii) {
+        BinprotGetCommand cmd;
+        cmd.setKey(name + std::to_string(ii));
+        gets.push_back(pipeline.submit(cmd));
+    }
+    pipeline.wait();
+    for (int ii = 0; ii < count; ++ii) {
+        auto rsp = gets[ii].get();
+        ASSERT_TRUE(rsp.isSuccess()) << to_string(rsp.getStatus());
+        EXPECT_EQ(std::to_string(ii), rsp.getDataString());
+    }
+}
@@ -18,6 +18,9 @@
 #include "testapp_client_test.h"
 #include <gsl/gsl>
 
+#include <chrono>
+#include <thread>
+
 class StatsTest : public TestappClientTest {
 public:
     void SetUp() {
@@ -273,9 +276,10 @@ TEST_P(StatsTest, TestAudit) {
     conn.authenticate("@admin", "password", "PLAIN");
 
     auto stats = conn.stats("audit");
-    EXPECT_EQ(2, stats.size());
+    EXPECT_EQ(3, stats.size());
     EXPECT_EQ(false, stats["enabled"].get<bool>());
     EXPECT_EQ(0, stats["dropped_events"].get<size_t>());
+    EXPECT_EQ(0, stats["queued_events"].get<size_t>());
 
     conn.reconnect();
 }
@@ -333,6 +337,23 @@ TEST_P(StatsTest, TestSchedulerInfo_Aggregate) {
     EXPECT_NE(stats.end(), stats.find("aggregate"));
 }
 
+TEST_P(StatsTest, TestSchedulerInfo_Load) {
+    auto stats = getConnection().stats("worker_thread_info load");
+    EXPECT_NE(stats.end(), stats.find("0:connections"));
+    EXPECT_NE(stats.end(), stats.find("0:busy_time"));
+    EXPECT_NE(stats.end(), stats.find("0:utilization"));
+    EXPECT_NE(stats.end(), stats.find("0:migrated_in"));
+    EXPECT_NE(stats.end(), stats.find("0:migrated_out"));
+}
+
+TEST_P(StatsTest, TestSchedulerInfo_RunQueue) {
+    auto stats = getConnection().stats("worker_thread_info run_queue");
+    EXPECT_EQ(3, stats.size());
+    EXPECT_NE(stats.end(), stats.find("high"));
+    EXPECT_NE(stats.end(), stats.find("medium"));
+    EXPECT_NE(stats.end(), stats.find("low"));
+}
+
 TEST_P(StatsTest, TestSchedulerInfo_InvalidSubcommand) {
     try {
         getConnection().stats("worker_thread_info foo");
@@ -487,6 +508,149 @@ TEST_P(StatsTest, TestTracingStats) {
     EXPECT_NE(stats.end(), enabled);
 }
 
+TEST_P(StatsTest, DeltaStats) {
+    MemcachedConnection& conn = getConnection();
+
+    // The first poll of the group sends all of the stats, the next only
+    // those which changed since
+    auto full = conn.stats("delta");
+    auto delta = conn.stats("delta");
+    EXPECT_NE(full.end(), full.find("threads"));
+    EXPECT_EQ(delta.end(), delta.find("threads"));
+    EXPECT_LT(delta.size(), full.size());
+
+    // Groups are tracked independently
+    EXPECT_FALSE(conn.stats("delta connections").empty());
+    delta = conn.stats("delta");
+    EXPECT_EQ(delta.end(), delta.find("threads"));
+
+    // ... and the plain group still sends everything
+    full = conn.stats("");
+    EXPECT_NE(full.end(), full.find("threads"));
+}
+
+TEST_P(StatsTest, KeyedTimings) {
+    memcached_cfg["keyed_timings_enabled"] = true;
+    reconfigure();
+
+    MemcachedConnection& conn = getConnection();
+    Document doc;
+    doc.info.cas = mcbp::cas::Wildcard;
+    doc.info.id = name;
+    doc.value = "value";
+    conn.mutate(doc, Vbid(0), MutationType::Set);
+
+    auto stats = conn.stats("keyed_timings");
+    auto vbucket = conn.stats("keyed_timings vbucket 0 set").front();
+    auto collection = conn.stats("keyed_timings collection 0 set").front();
+
+    memcached_cfg["keyed_timings_enabled"] = false;
+    reconfigure();
+
+    EXPECT_NE(stats.end(), stats.find("vb_0:set")) << stats.dump();
+    EXPECT_NE(stats.end(), stats.find("collection_0x0:set")) << stats.dump();
+    EXPECT_LE(1, vbucket["total"].get<int>());
+    EXPECT_LE(1, collection["total"].get<int>());
+
+    try {
+        conn.stats("keyed_timings vbucket 0 append");
+        FAIL() << "append isn't one of the keyed timings";
+    } catch (ConnectionError& error) {
+        EXPECT_TRUE(error.isInvalidArguments());
+    }
+}
+
+TEST_P(StatsTest, IntervalTimings) {
+    MemcachedConnection& conn = getConnection();
+    Document doc;
+    doc.info.cas = mcbp::cas::Wildcard;
+    doc.info.id = name;
+    doc.value = "value";
+    conn.mutate(doc, Vbid(0), MutationType::Set);
+
+    // The set is reported once the interval it completed in is sampled
+    // (every second)
+    nlohmann::json set;
+    const auto timeout =
+            std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    do {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        set = conn.stats("interval_timings SET").front();
+    } while (set["count"].get<uint64_t>() == 0 &&
+             std::chrono::steady_clock::now() < timeout);
+
+    ASSERT_LE(1u, set["count"].get<uint64_t>()) << set.dump();
+    EXPECT_LE(set["p50"].get<uint64_t>(), set["max"].get<uint64_t>());
+    EXPECT_NE(0u, set["interval"].get<uint64_t>());
+
+    try {
+        conn.stats("interval_timings NOT_AN_OPCODE");
+        FAIL() << "The opcode should be rejected";
+    } catch (ConnectionError& error) {
+        EXPECT_TRUE(error.isInvalidArguments());
+    }
+}
+
+TEST_P(StatsTest, Prometheus) {
+    MemcachedConnection& conn = getConnection();
+    Document doc;
+    doc.info.cas = mcbp::cas::Wildcard;
+    doc.info.id = name;
+    doc.value = "value";
+    conn.mutate(doc, Vbid(0), MutationType::Set);
+
+    const auto text = conn.stats("prometheus").front().get<std::string>();
+    EXPECT_NE(std::string::npos, text.find("# TYPE kv_curr_connections gauge"))
+            << text;
+    EXPECT_NE(std::string::npos, text.find("kv_cmd_set{bucket=")) << text;
+    EXPECT_NE(std::string::npos,
+              text.find("kv_cmd_duration_microseconds_count{bucket="))
+            << text;
+    EXPECT_NE(std::string::npos, text.find("kv_metrics_dropped_series 0"))
+            << text;
+
+    EXPECT_FALSE(conn.stats("prometheus high").empty());
+    try {
+        conn.stats("prometheus everything");
+        FAIL() << "The cardinality should be rejected";
+    } catch (ConnectionError& error) {
+        EXPECT_TRUE(error.isInvalidArguments());
+    }
+}
+
+TEST_P(StatsTest, RequestSamples) {
+    memcached_cfg["request_sample_interval"] = 1;
+    reconfigure();
+
+    MemcachedConnection& conn = getConnection();
+    Document doc;
+    doc.info.cas = mcbp::cas::Wildcard;
+    doc.info.id = name;
+    doc.value = "value";
+    conn.mutate(doc, Vbid(0), MutationType::Set);
+
+    conn.authenticate("@admin", "password", "PLAIN");
+    auto stats = conn.stats("request_samples");
+
+    memcached_cfg["request_sample_interval"] = 1000;
+    reconfigure();
+
+    const auto key_hash = std::hash<cb::const_char_buffer>()(
+            {name.data(), name.size()});
+    bool found = false;
+    for (const auto& thread : stats) {
+        for (const auto& sample : thread) {
+            if (sample["opcode"] == "SET" && sample["key_hash"] == key_hash) {
+                EXPECT_EQ(0, sample["vbucket"].get<int>());
+                ASSERT_FALSE(sample["spans"].empty());
+                EXPECT_EQ("request", sample["spans"][0]["name"]);
+                found = true;
+            }
+        }
+    }
+    EXPECT_TRUE(found) << stats.dump();
+}
+
 /**
  * Subclass of StatsTest which doesn't have a default bucket; hence connections
  * will intially not be associated with any bucket.
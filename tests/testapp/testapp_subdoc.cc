@@ -1331,6 +1331,55 @@ TEST_P(SubdocTestappTest, SubdocGetCount) {
     delete_object("a");
 }
 
+// Lookups in a document large enough for its top-level keys to be indexed
+// (and the index to be cached) must find the same results as when scanning
+// the document, also after it has been modified.
+TEST_P(SubdocTestappTest, SubdocGet_LargeDict) {
+    std::string dict(R"({"first":1, "nested" : {"a":[1,{"b":"}]"}]},)");
+    dict.append(R"("esc\"aped":true,"list":[1,2,3],)");
+    for (int i = 0; i < 1000; i++) {
+        dict.append("\"pad" + std::to_string(i) + "\":\"" +
+                    std::string(20, 'x') + "\",");
+    }
+    dict.append(R"("first":2,"last":"end"})");
+    store_document("large", dict);
+
+    // Repeat the lookups so they're also served from the cached index.
+    for (int i = 0; i < 2; i++) {
+        EXPECT_SD_GET("large", "first", "1");
+        EXPECT_SD_GET("large", "nested", R"({"a":[1,{"b":"}]"}]})");
+        EXPECT_SD_GET("large", "nested.a[1].b", R"("}]")");
+        EXPECT_SD_GET("large", "list[-1]", "3");
+        EXPECT_SD_GET("large", "last", R"("end")");
+        EXPECT_SD_GET("large", "pad999", "\"" + std::string(20, 'x') + "\"");
+        EXPECT_SD_VALEQ(
+                BinprotSubdocCommand(cb::mcbp::ClientOpcode::SubdocGetCount,
+                                     "large",
+                                     "list"),
+                "3");
+        EXPECT_SD_ERR(BinprotSubdocCommand(cb::mcbp::ClientOpcode::SubdocGet,
+                                           "large",
+                                           "missing"),
+                      cb::mcbp::Status::SubdocPathEnoent);
+        EXPECT_SD_ERR(BinprotSubdocCommand(cb::mcbp::ClientOpcode::SubdocGet,
+                                           "large",
+                                           "first.nothing_here"),
+                      cb::mcbp::Status::SubdocPathMismatch);
+        EXPECT_SD_OK(BinprotSubdocCommand(
+                cb::mcbp::ClientOpcode::SubdocExists, "large", "nested.a"));
+    }
+
+    // Modify the document; lookups must see the new revision.
+    EXPECT_SD_OK(BinprotSubdocCommand(cb::mcbp::ClientOpcode::SubdocReplace,
+                                      "large",
+                                      "first",
+                                      R"("replaced")"));
+    EXPECT_SD_GET("large", "first", R"("replaced")");
+    EXPECT_SD_GET("large", "last", R"("end")");
+
+    delete_object("large");
+}
+
 void SubdocTestappTest::test_subdoc_counter_simple() {
     store_document("a", "{}");
 
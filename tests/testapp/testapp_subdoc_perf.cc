@@ -26,6 +26,10 @@
  *
  * - Dict: As per Array, except start with an empty dictionary and add
  *         K/V pairs of the form <num>: value_<num>.
+ *
+ * - LargeDoc: Operate on a single small field of a ~200KB dictionary (e.g.
+ *             increment a counter), where the cost is dominated by copying
+ *             the rest of the document.
  */
 
 #include "testapp_subdoc_common.h"
@@ -495,6 +499,64 @@ TEST_P(SubdocPerfTest, Array_Replace_Fulldoc) {
     delete_object("list");
 }
 
+/*****************************************************************************
+ * Sub-document API Performance Tests - Large documents.
+ ****************************************************************************/
+
+// Create a dictionary of a counter field followed by ~200KB of padding
+// fields.
+static std::string subdoc_create_large_dict() {
+    std::string dict(R"({"counter":0)");
+    const std::string padding(1000, 'x');
+    for (size_t i = 0; i < 200; i++) {
+        dict.append(",\"field_" + std::to_string(i) + "\":\"" + padding + '"');
+    }
+    dict.push_back('}');
+    return dict;
+}
+
+// Measure incrementing a counter in a large document.
+TEST_P(SubdocPerfTest, LargeDoc_Counter) {
+    store_document("large", subdoc_create_large_dict());
+
+    for (size_t i = 0; i < iterations; i++) {
+        subdoc_verify_cmd(BinprotSubdocCommand(
+                                  cb::mcbp::ClientOpcode::SubdocCounter,
+                                  "large",
+                                  "counter",
+                                  "1"),
+                          cb::mcbp::Status::Success,
+                          std::to_string(i + 1));
+    }
+
+    delete_object("large");
+}
+
+// As LargeDoc_Counter, but also replacing a second field in the same
+// (multi-path) command.
+TEST_P(SubdocPerfTest, LargeDoc_Counter_Multipath) {
+    store_document("large", subdoc_create_large_dict());
+
+    SubdocMultiMutationCmd mutation;
+    mutation.key = "large";
+    mutation.specs.push_back({cb::mcbp::ClientOpcode::SubdocCounter,
+                              SUBDOC_FLAG_NONE,
+                              "counter",
+                              "1"});
+    mutation.specs.push_back({cb::mcbp::ClientOpcode::SubdocDictUpsert,
+                              SUBDOC_FLAG_NONE,
+                              "last_update",
+                              "\"now\""});
+    for (size_t i = 0; i < iterations; i++) {
+        expect_subdoc_cmd(mutation,
+                          cb::mcbp::Status::Success,
+                          {{0, cb::mcbp::Status::Success,
+                            std::to_string(i + 1)}});
+    }
+
+    delete_object("large");
+}
+
 INSTANTIATE_TEST_CASE_P(
         SDPerf,
         SubdocPerfTest,
@@ -0,0 +1,148 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc.
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "testapp_client_test.h"
+
+#include <mcbp/protocol/framebuilder.h>
+
+using namespace cb::mcbp;
+
+class UnorderedExecutionTest : public TestappClientTest {
+protected:
+    /**
+     * Encode a GET command for the given key which allows the server to
+     * reorder it.
+     */
+    Frame encodeReorderableGet(const std::string& key, uint32_t opaque) {
+        // Reorder frame info: id 0, no value
+        const std::vector<uint8_t> fe = {0x00};
+        std::vector<uint8_t> buffer(sizeof(Request) + fe.size() + key.size());
+        RequestBuilder builder({buffer.data(), buffer.size()});
+        builder.setMagic(Magic::AltClientRequest);
+        builder.setOpcode(ClientOpcode::Get);
+        builder.setOpaque(opaque);
+        builder.setFramingExtras({fe.data(), fe.size()});
+        builder.setKey(
+                {reinterpret_cast<const uint8_t*>(key.data()), key.size()});
+
+        Frame frame;
+        frame.payload = std::move(buffer);
+        return frame;
+    }
+
+    /// Encode a response to a server initiated ClustermapChangeNotification
+    Frame encodeServerResponse(uint32_t opaque) {
+        Frame frame;
+        frame.payload.resize(sizeof(Response));
+        ResponseBuilder builder({frame.payload.data(), frame.payload.size()});
+        builder.setMagic(Magic::ServerResponse);
+        builder.setOpcode(ServerOpcode::ClustermapChangeNotification);
+        builder.setOpaque(opaque);
+        builder.setStatus(Status::Success);
+        return frame;
+    }
+};
+
+INSTANTIATE_TEST_CASE_P(TransportProtocols,
+                        UnorderedExecutionTest,
+                        ::testing::Values(TransportProtocols::McbpPlain),
+                        ::testing::PrintToStringParamName());
+
+/// The Reorder frame is rejected unless the client enabled unordered
+/// execution
+TEST_P(UnorderedExecutionTest, ReorderRequiresUnorderedExecution) {
+    auto& conn = getConnection();
+    conn.setUnorderedExecutionMode(ExecutionMode::Ordered);
+    conn.sendFrame(encodeReorderableGet(name, 1));
+
+    BinprotResponse rsp;
+    conn.recvResponse(rsp);
+    EXPECT_EQ(Status::NotSupported, rsp.getStatus());
+}
+
+/// A GET blocked in the engine doesn't hold back the GET pipelined after
+/// it; the response to the second GET is returned first.
+TEST_P(UnorderedExecutionTest, BlockedGetDoesNotStallPipeline) {
+    store_document(name + "_1", "1");
+    store_document(name + "_2", "2");
+
+    auto& conn = getConnection();
+    conn.setUnorderedExecutionMode(ExecutionMode::Unordered);
+
+    // Suspend the next command on the connection until it's resumed from
+    // another connection
+    const uint32_t id = 0xdeadbeef;
+    conn.configureEwouldBlockEngine(EWBEngineMode::Suspend,
+                                    ENGINE_EWOULDBLOCK,
+                                    id);
+
+    conn.sendFrame(encodeReorderableGet(name + "_1", 1));
+    conn.sendFrame(encodeReorderableGet(name + "_2", 2));
+
+    BinprotResponse rsp;
+    conn.recvResponse(rsp);
+    ASSERT_TRUE(rsp.isSuccess()) << to_string(rsp.getStatus());
+    EXPECT_EQ(2, rsp.getResponse().getOpaque());
+    EXPECT_EQ("2", rsp.getDataString());
+
+    auto& admin = getAdminConnection();
+    admin.selectBucket("default");
+    admin.configureEwouldBlockEngine(
+            EWBEngineMode::Resume, ENGINE_SUCCESS, id);
+
+    conn.recvResponse(rsp);
+    ASSERT_TRUE(rsp.isSuccess()) << to_string(rsp.getStatus());
+    EXPECT_EQ(1, rsp.getResponse().getOpaque());
+    EXPECT_EQ("1", rsp.getDataString());
+}
+
+/// A response to a server initiated request waits for the blocked GET in
+/// front of it, and is then handled (so the command after it is executed)
+/// once the GET completes.
+TEST_P(UnorderedExecutionTest, ServerResponseWaitsForBlockedGet) {
+    store_document(name + "_1", "1");
+    store_document(name + "_2", "2");
+
+    auto& conn = getConnection();
+    conn.setUnorderedExecutionMode(ExecutionMode::Unordered);
+
+    const uint32_t id = 0xdeadbeef;
+    conn.configureEwouldBlockEngine(EWBEngineMode::Suspend,
+                                    ENGINE_EWOULDBLOCK,
+                                    id);
+
+    conn.sendFrame(encodeReorderableGet(name + "_1", 1));
+    conn.sendFrame(encodeServerResponse(2));
+    conn.sendFrame(encodeReorderableGet(name + "_2", 3));
+
+    auto& admin = getAdminConnection();
+    admin.selectBucket("default");
+    admin.configureEwouldBlockEngine(
+            EWBEngineMode::Resume, ENGINE_SUCCESS, id);
+
+    // The response isn't answered, and the second GET can't overtake it
+    BinprotResponse rsp;
+    conn.recvResponse(rsp);
+    ASSERT_TRUE(rsp.isSuccess()) << to_string(rsp.getStatus());
+    EXPECT_EQ(1, rsp.getResponse().getOpaque());
+    EXPECT_EQ("1", rsp.getDataString());
+
+    conn.recvResponse(rsp);
+    ASSERT_TRUE(rsp.isSuccess()) << to_string(rsp.getStatus());
+    EXPECT_EQ(3, rsp.getResponse().getOpaque());
+    EXPECT_EQ("2", rsp.getDataString());
+}
@@ -19,6 +19,9 @@
 #include "daemon/topkeys.h"
 #include <folly/portability/GTest.h>
 #include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
 class TopKeysTest : public ::testing::Test {
 protected:
@@ -58,3 +61,42 @@ TEST_F(TopKeysTest, Basic) {
     topkeys->stats(&count, 0, dump_key);
     EXPECT_EQ(80, count);
 }
+
+static void collect_key(const char* key,
+                        const uint16_t klen,
+                        const char* val,
+                        const uint32_t vlen,
+                        gsl::not_null<const void*> cookie) {
+    auto* keys = static_cast<std::vector<std::string>*>(
+            const_cast<void*>(cookie.get()));
+    keys->emplace_back(key, klen);
+}
+
+// A key accessed (by many threads) far more often than any other is
+// reported first, even though far more distinct keys are accessed than are
+// tracked.
+TEST_F(TopKeysTest, HotKey) {
+    topkeys.reset(new TopKeys(1, 4));
+
+    std::vector<std::thread> threads;
+    for (int tt = 0; tt < 4; tt++) {
+        threads.emplace_back([this, tt]() {
+            const std::string hot("hot_key");
+            for (int ii = 0; ii < 10000; ii++) {
+                const auto cold = "cold_" + std::to_string(tt) + "_" +
+                                  std::to_string(ii);
+                topkeys->updateKey(cold.data(), cold.size(), ii);
+                topkeys->updateKey(hot.data(), hot.size(), ii);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::vector<std::string> keys;
+    topkeys->stats(&keys, 0, collect_key);
+    EXPECT_EQ(TopKeys::KEYS_PER_MKEY, keys.size());
+    ASSERT_FALSE(keys.empty());
+    EXPECT_EQ("hot_key", keys.front());
+}
@@ -14,10 +14,13 @@
  *   See the License for the specific language governing permissions and
  *   limitations under the License.
  */
+#include "daemon/timings.h"
 #include "tests/mcbp/mock_connection.h"
 #include "tracing/trace_helpers.h"
 
 #include <folly/portability/GTest.h>
+#include <mcbp/mcbp.h>
+#include <nlohmann/json.hpp>
 #include <tracing/tracer.h>
 #include <unistd.h>
 #include <algorithm>
@@ -125,3 +128,85 @@ TEST_F(TracingCookieTest, InstantTracerEnd) {
     const auto& durations = cookie.getTracer().getDurations();
     EXPECT_EQ(0u, durations.size());
 }
+
+/// Test that tracing against a null cookie (an engine's own work) is a no-op.
+TEST_F(TracingCookieTest, NullCookie) {
+    const void* nullCookie = nullptr;
+    { TRACE_SCOPE(nullCookie, cb::tracing::TraceCode::HT_LOCK); }
+    TRACE_BEGIN(nullCookie,
+                cb::tracing::TraceCode::SYNC_WRITE,
+                std::chrono::steady_clock::now());
+    TRACE_END(nullCookie,
+              cb::tracing::TraceCode::SYNC_WRITE,
+              std::chrono::steady_clock::now());
+}
+
+/// Test that the completed spans within a request are recorded in the
+/// per-opcode span histograms.
+TEST_F(TracingCookieTest, TimingsCollectSpans) {
+    { TRACE_SCOPE(cookie, cb::tracing::TraceCode::HT_LOCK); }
+    { TRACE_SCOPE(cookie, cb::tracing::TraceCode::HT_LOCK); }
+    // A span which never ended isn't recorded.
+    InstantTracer(cookie, cb::tracing::TraceCode::BG_WAIT, /*start*/ true);
+
+    Timings timings;
+    timings.collect(cb::mcbp::ClientOpcode::Set, cookie.getTracer());
+
+    const auto set = uint8_t(cb::mcbp::ClientOpcode::Set);
+    const auto* histogram = timings.get_span_histogram(
+            set, cb::tracing::TraceCode::HT_LOCK);
+    ASSERT_NE(nullptr, histogram);
+    EXPECT_EQ(2u, histogram->getValueCount());
+    EXPECT_EQ(nullptr,
+              timings.get_span_histogram(set,
+                                         cb::tracing::TraceCode::BG_WAIT));
+    EXPECT_EQ(nullptr,
+              timings.get_span_histogram(uint8_t(cb::mcbp::ClientOpcode::Get),
+                                         cb::tracing::TraceCode::HT_LOCK));
+
+    timings.reset();
+    EXPECT_EQ(0u, histogram->getValueCount());
+}
+
+/// Test that sample() derives the adaptive slow operation thresholds from
+/// the durations of the last interval, once it has enough of them.
+TEST_F(TracingCookieTest, TimingsAdaptiveSlowThreshold) {
+    const auto get = uint8_t(cb::mcbp::ClientOpcode::Get);
+    Timings timings;
+    auto collect = [&timings](size_t count) {
+        for (size_t ii = 0; ii < count; ++ii) {
+            timings.collect(cb::mcbp::ClientOpcode::Get,
+                            std::chrono::milliseconds(20));
+        }
+    };
+
+    // Not enabled
+    collect(1000);
+    timings.sample(std::chrono::seconds(1));
+    EXPECT_EQ(0, timings.get_slow_threshold(get).count());
+
+    cb::mcbp::sla::reconfigure(
+            R"({"version": 1, "default": {"slow": 500},
+                "adaptive": {"factor": 2}})"_json);
+
+    // Too few operations for the 99.9th percentile
+    collect(999);
+    timings.sample(std::chrono::seconds(1));
+    EXPECT_EQ(0, timings.get_slow_threshold(get).count());
+
+    collect(1000);
+    timings.sample(std::chrono::seconds(1));
+    const auto threshold = timings.get_slow_threshold(get);
+    EXPECT_LE(std::chrono::milliseconds(40), threshold);
+    // (the histograms only have a precision of one significant figure)
+    EXPECT_GT(std::chrono::milliseconds(50), threshold);
+
+    // An opcode without enough operations keeps its last threshold
+    timings.sample(std::chrono::seconds(1));
+    EXPECT_EQ(threshold, timings.get_slow_threshold(get));
+
+    cb::mcbp::sla::reconfigure(
+            R"({"version": 1, "default": {"slow": 500}})"_json);
+    timings.sample(std::chrono::seconds(1));
+    EXPECT_EQ(0, timings.get_slow_threshold(get).count());
+}
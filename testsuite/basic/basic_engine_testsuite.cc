@@ -15,16 +15,23 @@
  *   limitations under the License.
  */
 #include "basic_engine_testsuite.h"
+#include <mcbp/protocol/framebuilder.h>
 #include <memcached/durability_spec.h>
+#include <memcached/protocol_binary.h>
 #include <platform/cb_malloc.h>
 #include <platform/cbassert.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include <chrono>
 #include <iostream>
-#include <vector>
+#include <map>
+#include <set>
 #include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 struct test_harness* test_harness;
 
@@ -506,6 +513,580 @@ static enum test_result lru_test(EngineIface* h) {
     return SUCCESS;
 }
 
+static std::map<std::string, std::string> stats_values;
+static void stats_values_handler(const char* key,
+                                 const uint16_t klen,
+                                 const char* val,
+                                 const uint32_t vlen,
+                                 gsl::not_null<const void*>) {
+    stats_values[std::string(key, klen)] = std::string(val, vlen);
+}
+
+/* Fetch the given group of stats into stats_values */
+static void fetch_stats(EngineIface* h,
+                        const void* cookie,
+                        const std::string& group) {
+    stats_values.clear();
+    cb_assert(h->get_stats(cookie,
+                           {group.data(), group.size()},
+                           stats_values_handler) == ENGINE_SUCCESS);
+}
+
+static uint64_t stat_value(const std::string& name) {
+    auto iter = stats_values.find(name);
+    if (iter == stats_values.end()) {
+        return 0;
+    }
+    return std::stoull(iter->second);
+}
+
+/* The sum of a per slab class stat ("[items:]<clsid>:<name>") */
+static uint64_t stat_sum(const std::string& name) {
+    const std::string suffix = ":" + name;
+    uint64_t sum = 0;
+    for (const auto& stat : stats_values) {
+        const auto& key = stat.first;
+        if (key.size() > suffix.size() &&
+            key.compare(key.size() - suffix.size(), suffix.size(), suffix) ==
+                    0) {
+            sum += std::stoull(stat.second);
+        }
+    }
+    return sum;
+}
+
+/* The slab classes with pages, from the "slabs" stats in stats_values */
+static std::set<unsigned int> slab_classes() {
+    const std::string suffix = ":total_pages";
+    std::set<unsigned int> classes;
+    for (const auto& stat : stats_values) {
+        const auto& key = stat.first;
+        if (key.size() > suffix.size() &&
+            key.compare(key.size() - suffix.size(), suffix.size(), suffix) ==
+                    0) {
+            classes.insert(std::stoul(key));
+        }
+    }
+    return classes;
+}
+
+static std::string test_key(int ii) {
+    return "test_key_" + std::to_string(ii);
+}
+
+static void store_item(EngineIface* h,
+                       const void* cookie,
+                       const std::string& key,
+                       size_t nbytes) {
+    uint64_t cas = 0;
+    DocKey docKey(key, DocKeyEncodesCollectionId::No);
+    auto ret = h->allocate(
+            cookie, docKey, nbytes, 0, 0, PROTOCOL_BINARY_RAW_BYTES, Vbid(0));
+    cb_assert(ret.first == cb::engine_errc::success);
+    cb_assert(h->store(cookie,
+                       ret.second.get(),
+                       cas,
+                       OPERATION_SET,
+                       {},
+                       DocumentState::Alive) == ENGINE_SUCCESS);
+}
+
+static bool item_exists(EngineIface* h,
+                        const void* cookie,
+                        const std::string& key) {
+    DocKey docKey(key, DocKeyEncodesCollectionId::No);
+    auto ret = h->get(cookie, docKey, Vbid(0), DocStateFilter::Alive);
+    return ret.first == cb::engine_errc::success;
+}
+
+static cb::mcbp::Status last_status;
+static bool add_response_handler(const void*,
+                                 uint16_t,
+                                 const void*,
+                                 uint8_t,
+                                 const void*,
+                                 uint32_t,
+                                 uint8_t,
+                                 cb::mcbp::Status status,
+                                 uint64_t,
+                                 const void*) {
+    last_status = status;
+    return true;
+}
+
+/* Send the engine a SetParam (of the Flush type) */
+static cb::mcbp::Status set_param(EngineIface* h,
+                                  const void* cookie,
+                                  const std::string& key,
+                                  const std::string& value) {
+    cb::mcbp::request::SetParamPayload payload;
+    payload.setParamType(cb::mcbp::request::SetParamPayload::Type::Flush);
+    const auto extras = payload.getBuffer();
+
+    std::vector<uint8_t> buffer(sizeof(cb::mcbp::Request) + extras.size() +
+                                key.size() + value.size());
+    cb::mcbp::RequestBuilder builder({buffer.data(), buffer.size()});
+    builder.setMagic(cb::mcbp::Magic::ClientRequest);
+    builder.setOpcode(cb::mcbp::ClientOpcode::SetParam);
+    builder.setExtras(extras);
+    builder.setKey({reinterpret_cast<const uint8_t*>(key.data()), key.size()});
+    builder.setValue(
+            {reinterpret_cast<const uint8_t*>(value.data()), value.size()});
+    cb_assert(h->unknown_command(cookie,
+                                 *builder.getFrame(),
+                                 add_response_handler) == ENGINE_SUCCESS);
+    return last_status;
+}
+
+/*
+ * With the segmented LRU an item read before it reached the tail of the hot
+ * segment is moved to the warm segment, and the items which weren't read
+ * (moved to the cold segment) are evicted before it.
+ */
+static enum test_result segmented_lru_test(EngineIface* h) {
+    const auto* cookie = test_harness->create_cookie();
+
+    /* Run the LRU maintainer by hand, so the segments are deterministic */
+    cb_assert(set_param(h, cookie, "lru_maintainer_paused", "true") ==
+              cb::mcbp::Status::Success);
+
+    store_item(h, cookie, "hot_key", 4096);
+    cb_assert(item_exists(h, cookie, "hot_key"));
+    int ii;
+    for (ii = 0; ii < 20; ++ii) {
+        store_item(h, cookie, test_key(ii), 4096);
+    }
+    fetch_stats(h, cookie, "items");
+    assert_equal(uint64_t(21), stat_sum("number_hot"));
+
+    /*
+     * The maintainer moves hot_key (which was read) to the warm segment,
+     * and the rest of the tail of the hot segment to the cold one, leaving
+     * 20% of the items hot
+     */
+    cb_assert(set_param(h, cookie, "lru_maintainer_run", "") ==
+              cb::mcbp::Status::Success);
+    fetch_stats(h, cookie, "items");
+    assert_equal(uint64_t(1), stat_sum("moves_to_warm"));
+    assert_equal(uint64_t(16), stat_sum("moves_to_cold"));
+    assert_equal(uint64_t(4), stat_sum("number_hot"));
+    assert_equal(uint64_t(1), stat_sum("number_warm"));
+    assert_equal(uint64_t(16), stat_sum("number_cold"));
+    assert_equal(uint64_t(21), stat_sum("number"));
+
+    /* cache_size=48 leaves the slab class with a single page */
+    for (; ii < 1000; ++ii) {
+        store_item(h, cookie, test_key(ii), 4096);
+        fetch_stats(h, cookie, "");
+        if (stat_value("evictions") == 1) {
+            break;
+        }
+    }
+    cb_assert(ii < 1000);
+
+    /* The oldest cold item goes first; the warm item survives */
+    cb_assert(item_exists(h, cookie, "hot_key"));
+    cb_assert(!item_exists(h, cookie, test_key(0)));
+    cb_assert(item_exists(h, cookie, test_key(1)));
+
+    test_harness->destroy_cookie(cookie);
+    return SUCCESS;
+}
+
+/* Ask the engine to move a slab page from class src to class dst */
+static cb::mcbp::Status slab_reassign(EngineIface* h,
+                                      const void* cookie,
+                                      unsigned int src,
+                                      unsigned int dst) {
+    return set_param(h,
+                     cookie,
+                     "slab_reassign",
+                     std::to_string(src) + ":" + std::to_string(dst));
+}
+
+/*
+ * Moving a page to another slab class evicts the items on it and gives its
+ * chunks to the destination class.
+ */
+static enum test_result slab_reassign_test(EngineIface* h) {
+    const auto* cookie = test_harness->create_cookie();
+
+    store_item(h, cookie, "small_key", 10);
+    fetch_stats(h, cookie, "slabs");
+    auto classes = slab_classes();
+    assert_equal(size_t(1), classes.size());
+    const unsigned int dst = *classes.begin();
+
+    /* Fill more than one page of the class of the 4k items */
+    const int nitems = 600;
+    for (int ii = 0; ii < nitems; ++ii) {
+        store_item(h, cookie, test_key(ii), 4096);
+    }
+    fetch_stats(h, cookie, "slabs");
+    classes = slab_classes();
+    assert_equal(size_t(2), classes.size());
+    classes.erase(dst);
+    const unsigned int src = *classes.begin();
+    const std::string src_prefix = std::to_string(src) + ":";
+    const std::string dst_prefix = std::to_string(dst) + ":";
+    const uint64_t src_pages = stat_value(src_prefix + "total_pages");
+    const uint64_t per_page = stat_value(src_prefix + "chunks_per_page");
+    cb_assert(src_pages >= 2);
+    assert_equal(uint64_t(1), stat_value(dst_prefix + "total_pages"));
+
+    cb_assert(slab_reassign(h, cookie, src, src) ==
+              cb::mcbp::Status::Einval);
+    cb_assert(slab_reassign(h, cookie, src, dst) ==
+              cb::mcbp::Status::Success);
+
+    fetch_stats(h, cookie, "slabs");
+    assert_equal(uint64_t(1), stat_value("slabs_moved"));
+    assert_equal(per_page, stat_value("slab_reassign_evictions"));
+    assert_equal(src_pages - 1, stat_value(src_prefix + "total_pages"));
+    assert_equal(uint64_t(2), stat_value(dst_prefix + "total_pages"));
+
+    /* The first page held the items stored first */
+    fetch_stats(h, cookie, "");
+    assert_equal(uint64_t(1 + nitems - per_page), stat_value("curr_items"));
+    cb_assert(!item_exists(h, cookie, test_key(0)));
+    cb_assert(item_exists(h, cookie, test_key(nitems - 1)));
+    cb_assert(item_exists(h, cookie, "small_key"));
+
+    test_harness->destroy_cookie(cookie);
+    return SUCCESS;
+}
+
+/*
+ * Items above slab_chunk_max get memory of their own size rather than a
+ * chunk of a slab class, which is returned once they are replaced.
+ */
+static enum test_result large_item_test(EngineIface* h) {
+    DocKey key("large_item_test_key", DocKeyEncodesCollectionId::No);
+    const size_t nbytes = 100000;
+    uint64_t cas = 0;
+    item_info ii;
+    const auto* cookie = test_harness->create_cookie();
+
+    auto ret = h->allocate(
+            cookie, key, nbytes, 0, 0, PROTOCOL_BINARY_RAW_BYTES, Vbid(0));
+    cb_assert(ret.first == cb::engine_errc::success);
+    cb_assert(h->get_item_info(ret.second.get(), &ii));
+    assert_equal(nbytes, ii.value[0].iov_len);
+    auto* data = static_cast<uint8_t*>(ii.value[0].iov_base);
+    for (size_t jj = 0; jj < nbytes; ++jj) {
+        data[jj] = uint8_t(jj);
+    }
+    cb_assert(h->store(cookie,
+                       ret.second.get(),
+                       cas,
+                       OPERATION_SET,
+                       {},
+                       DocumentState::Alive) == ENGINE_SUCCESS);
+    ret.second.reset();
+
+    fetch_stats(h, cookie, "slabs");
+    assert_equal(uint64_t(1), stat_value("large_items"));
+    assert_ge(stat_value("large_malloced"), uint64_t(nbytes));
+
+    ret = h->get(cookie, key, Vbid(0), DocStateFilter::Alive);
+    cb_assert(ret.first == cb::engine_errc::success);
+    cb_assert(h->get_item_info(ret.second.get(), &ii));
+    assert_equal(nbytes, ii.value[0].iov_len);
+    data = static_cast<uint8_t*>(ii.value[0].iov_base);
+    for (size_t jj = 0; jj < nbytes; ++jj) {
+        cb_assert(data[jj] == uint8_t(jj));
+    }
+    ret.second.reset();
+
+    /* A small item doesn't need a large allocation */
+    store_item(h, cookie, "large_item_test_key", 10);
+    fetch_stats(h, cookie, "slabs");
+    assert_equal(uint64_t(0), stat_value("large_items"));
+    assert_equal(uint64_t(0), stat_value("large_malloced"));
+
+    test_harness->destroy_cookie(cookie);
+    return SUCCESS;
+}
+
+/*
+ * A flush only bumps the flush generation: the flushed items are gone for
+ * the clients straight away, but count towards curr_items until they are
+ * reclaimed (by an access, the allocator or the scrubber).
+ */
+static enum test_result flush_curr_items_test(EngineIface* h) {
+    const auto* cookie = test_harness->create_cookie();
+    const int nitems = 100;
+    for (int ii = 0; ii < nitems; ++ii) {
+        store_item(h, cookie, test_key(ii), 100);
+    }
+    fetch_stats(h, cookie, "");
+    assert_equal(uint64_t(nitems), stat_value("curr_items"));
+
+    /* The scrubber can't reclaim an item which is in use */
+    DocKey held_key(test_key(0), DocKeyEncodesCollectionId::No);
+    auto held = h->get(cookie, held_key, Vbid(0), DocStateFilter::Alive);
+    cb_assert(held.first == cb::engine_errc::success);
+
+    cb_assert(h->flush(cookie) == ENGINE_SUCCESS);
+    cb_assert(!item_exists(h, cookie, test_key(1)));
+
+    /* Wait for the scrubber started by the flush to reclaim the rest */
+    for (int ii = 0; ii < 10000; ++ii) {
+        fetch_stats(h, cookie, "scrub");
+        if (stats_values["scrubber:status"] == "stopped") {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    cb_assert(stats_values["scrubber:status"] == "stopped");
+    fetch_stats(h, cookie, "");
+    assert_equal(uint64_t(1), stat_value("curr_items"));
+
+    /* Until it is accessed */
+    held.second.reset();
+    cb_assert(!item_exists(h, cookie, test_key(0)));
+    fetch_stats(h, cookie, "");
+    assert_equal(uint64_t(0), stat_value("curr_items"));
+
+    /* Items stored in the same second as the flush survive it */
+    store_item(h, cookie, test_key(0), 100);
+    cb_assert(item_exists(h, cookie, test_key(0)));
+    fetch_stats(h, cookie, "");
+    assert_equal(uint64_t(1), stat_value("curr_items"));
+
+    test_harness->destroy_cookie(cookie);
+    return SUCCESS;
+}
+
+static ENGINE_ERROR_CODE remove_item(EngineIface* h,
+                                     const void* cookie,
+                                     const std::string& key) {
+    DocKey docKey(key, DocKeyEncodesCollectionId::No);
+    uint64_t cas = 0;
+    mutation_descr_t mut_info;
+    return h->remove(cookie, docKey, cas, Vbid(0), {}, mut_info);
+}
+
+/*
+ * Concurrent sets, gets and deletes from several threads. Every thread works
+ * on its own keys (most of which are in different lock stripes, but with
+ * thousands of keys many share one) and on a few keys common to all of them
+ * (where they contend for the same stripe).
+ */
+static enum test_result concurrent_ops_test(EngineIface* h) {
+    const int nthreads = 4;
+    const int nkeys = 1000;
+    const int nshared = 4;
+    const int iterations = 20;
+
+    std::vector<std::thread> threads;
+    for (int tt = 0; tt < nthreads; ++tt) {
+        threads.emplace_back([h, tt]() {
+            const auto* cookie = test_harness->create_cookie();
+            const std::string prefix = "thread_" + std::to_string(tt) + "_";
+            for (int it = 0; it < iterations; ++it) {
+                for (int ii = 0; ii < nkeys; ++ii) {
+                    const auto key = prefix + std::to_string(ii);
+                    store_item(h, cookie, key, 100);
+                    cb_assert(item_exists(h, cookie, key));
+
+                    const auto shared = "shared_" + std::to_string(ii % nshared);
+                    store_item(h, cookie, shared, 100);
+                    item_exists(h, cookie, shared);
+                    const auto ret = remove_item(h, cookie, shared);
+                    cb_assert(ret == ENGINE_SUCCESS ||
+                              ret == ENGINE_KEY_ENOENT);
+                }
+                /* Leave the odd keys stored after the last iteration */
+                for (int ii = 0; ii < nkeys; ++ii) {
+                    if (it + 1 < iterations || ii % 2 == 0) {
+                        const auto key = prefix + std::to_string(ii);
+                        cb_assert(remove_item(h, cookie, key) ==
+                                  ENGINE_SUCCESS);
+                        cb_assert(!item_exists(h, cookie, key));
+                    }
+                }
+            }
+            test_harness->destroy_cookie(cookie);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    const auto* cookie = test_harness->create_cookie();
+    for (int tt = 0; tt < nthreads; ++tt) {
+        const std::string prefix = "thread_" + std::to_string(tt) + "_";
+        for (int ii = 0; ii < nkeys; ++ii) {
+            cb_assert(item_exists(h, cookie, prefix + std::to_string(ii)) ==
+                      (ii % 2 == 1));
+        }
+    }
+    for (int ii = 0; ii < nshared; ++ii) {
+        cb_assert(!item_exists(h, cookie, "shared_" + std::to_string(ii)));
+    }
+
+    const uint64_t expected = nthreads * nkeys / 2;
+    fetch_stats(h, cookie, "");
+    assert_equal(expected, stat_value("curr_items"));
+    fetch_stats(h, cookie, "items");
+    assert_equal(expected, stat_sum("number"));
+
+    test_harness->destroy_cookie(cookie);
+    return SUCCESS;
+}
+
+/*
+ * flush_all racing with sets from several threads: whatever survives, the
+ * item counts must agree with the items which can be found.
+ */
+static enum test_result flush_race_test(EngineIface* h) {
+    const int nthreads = 4;
+    const int nkeys = 2000;
+
+    std::vector<std::thread> threads;
+    for (int tt = 0; tt < nthreads; ++tt) {
+        threads.emplace_back([h, tt]() {
+            const auto* cookie = test_harness->create_cookie();
+            for (int ii = 0; ii < nkeys; ++ii) {
+                store_item(h,
+                           cookie,
+                           "thread_" + std::to_string(tt) + "_" +
+                                   std::to_string(ii),
+                           100);
+            }
+            test_harness->destroy_cookie(cookie);
+        });
+    }
+
+    const auto* cookie = test_harness->create_cookie();
+    for (int ii = 0; ii < 10; ++ii) {
+        cb_assert(h->flush(cookie) == ENGINE_SUCCESS);
+        std::this_thread::yield();
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    /* Looking a key up reclaims it if it was flushed */
+    uint64_t found = 0;
+    for (int tt = 0; tt < nthreads; ++tt) {
+        for (int ii = 0; ii < nkeys; ++ii) {
+            if (item_exists(h,
+                            cookie,
+                            "thread_" + std::to_string(tt) + "_" +
+                                    std::to_string(ii))) {
+                ++found;
+            }
+        }
+    }
+
+    fetch_stats(h, cookie, "");
+    assert_equal(found, stat_value("curr_items"));
+    fetch_stats(h, cookie, "items");
+    assert_equal(found, stat_sum("number"));
+
+    test_harness->destroy_cookie(cookie);
+    return SUCCESS;
+}
+
+/* The size of the value stored for key, or 0 if there is none */
+static uint32_t item_nbytes(EngineIface* h,
+                            const void* cookie,
+                            const std::string& key) {
+    DocKey docKey(key, DocKeyEncodesCollectionId::No);
+    auto ret = h->get(cookie, docKey, Vbid(0), DocStateFilter::Alive);
+    if (ret.first != cb::engine_errc::success) {
+        return 0;
+    }
+    item_info info;
+    cb_assert(h->get_item_info(ret.second.get(), &info));
+    return info.value[0].iov_len;
+}
+
+/* Fetch the "hash" stats until they satisfy pred (for at most 10s) */
+template <typename Pred>
+static bool wait_for_hash_stats(EngineIface* h,
+                                const void* cookie,
+                                Pred pred) {
+    const auto deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    do {
+        fetch_stats(h, cookie, "hash");
+        if (pred()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    } while (std::chrono::steady_clock::now() < deadline);
+    return false;
+}
+
+/*
+ * The hash table is expanded by the maintenance thread once it holds more
+ * than 1.5 items per bucket. Items must stay reachable (and mutable) while
+ * they are migrated, whether their bucket has been migrated yet or not.
+ */
+static enum test_result hash_expansion_test(EngineIface* h) {
+    const auto* cookie = test_harness->create_cookie();
+    fetch_stats(h, cookie, "hash");
+    const auto power_level = stat_value("hash:power_level");
+    const uint64_t old_size = uint64_t(1) << power_level;
+    const int nitems = int(old_size * 3 / 2) + 1000;
+
+    /* Stop the migration after the first chunk (1024) of buckets */
+    cb_assert(set_param(h, cookie, "hash_expansion_paused", "true") ==
+              cb::mcbp::Status::Success);
+    for (int ii = 0; ii < nitems; ++ii) {
+        store_item(h, cookie, test_key(ii), 10);
+    }
+    cb_assert(wait_for_hash_stats(h, cookie, [] {
+        return stat_value("hash:is_expanding") == 1 &&
+               stat_value("hash:expand_buckets_done") == 1024;
+    }));
+    assert_equal(power_level + 1, stat_value("hash:power_level"));
+
+    /*
+     * Overwrite and delete items while almost all of them are still in the
+     * buckets of the old table
+     */
+    for (int ii = 0; ii < nitems; ++ii) {
+        if (ii % 3 == 0) {
+            store_item(h, cookie, test_key(ii), 20);
+            assert_equal(uint32_t(20), item_nbytes(h, cookie, test_key(ii)));
+        } else if (ii % 3 == 1) {
+            cb_assert(remove_item(h, cookie, test_key(ii)) == ENGINE_SUCCESS);
+            cb_assert(!item_exists(h, cookie, test_key(ii)));
+        }
+    }
+    fetch_stats(h, cookie, "hash");
+    assert_equal(uint64_t(1), stat_value("hash:is_expanding"));
+    assert_equal(uint64_t(1024), stat_value("hash:expand_buckets_done"));
+
+    cb_assert(set_param(h, cookie, "hash_expansion_paused", "false") ==
+              cb::mcbp::Status::Success);
+    cb_assert(wait_for_hash_stats(h, cookie, [] {
+        return stat_value("hash:is_expanding") == 0 &&
+               stat_value("hash:expansions") == 1;
+    }));
+    assert_equal(power_level + 1, stat_value("hash:power_level"));
+    assert_equal(old_size, stat_value("hash:expand_buckets_done"));
+    assert_equal(old_size, stat_value("hash:expand_buckets_total"));
+
+    uint64_t remaining = 0;
+    for (int ii = 0; ii < nitems; ++ii) {
+        const uint32_t expected = ii % 3 == 0 ? 20 : (ii % 3 == 1 ? 0 : 10);
+        assert_equal(expected, item_nbytes(h, cookie, test_key(ii)));
+        if (expected != 0) {
+            ++remaining;
+        }
+    }
+    fetch_stats(h, cookie, "hash");
+    assert_equal(remaining, stat_value("hash:items"));
+
+    test_harness->destroy_cookie(cookie);
+    return SUCCESS;
+}
+
 static enum test_result get_stats_test(EngineIface* h) {
     return PENDING;
 }
@@ -659,7 +1240,18 @@ engine_test_t* get_tests(void) {
 #ifndef VALGRIND
         // this test is disabled for VALGRIND because cache_size=48 and using malloc don't work.
         TEST_CASE("LRU test", lru_test, NULL, NULL, "cache_size=48", NULL, NULL),
+        TEST_CASE("segmented LRU test", segmented_lru_test, NULL, NULL,
+                  "cache_size=48;lru_segmented=true", NULL, NULL),
+        TEST_CASE("slab reassign test", slab_reassign_test, NULL, NULL,
+                  "slab_automove=true", NULL, NULL),
+        TEST_CASE("large item test", large_item_test, NULL, NULL,
+                  "slab_chunk_max=16384", NULL, NULL),
+        TEST_CASE("hash expansion test", hash_expansion_test, NULL, NULL,
+                  NULL, NULL, NULL),
 #endif
+        TEST_CASE("flush curr_items test", flush_curr_items_test, NULL, NULL, NULL, NULL, NULL),
+        TEST_CASE("concurrent ops test", concurrent_ops_test, NULL, NULL, NULL, NULL, NULL),
+        TEST_CASE("flush race test", flush_race_test, NULL, NULL, NULL, NULL, NULL),
         TEST_CASE("get stats test", get_stats_test, NULL, NULL, NULL, NULL, NULL),
         TEST_CASE("reset stats test", reset_stats_test, NULL, NULL, NULL, NULL, NULL),
         TEST_CASE("get stats struct test", get_stats_struct_test, NULL, NULL, NULL, NULL, NULL),
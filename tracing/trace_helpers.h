@@ -35,26 +35,31 @@
 class ScopedTracer {
 public:
     ScopedTracer(Cookie& cookie, const cb::tracing::TraceCode code)
-        : cookie(cookie) {
+        : cookie(&cookie) {
         if (cookie.isTracingEnabled()) {
             spanId = cookie.getTracer().begin(code);
         }
     }
 
-    /// Constructor from Cookie (void*)
+    /**
+     * Constructor from Cookie (void*). The cookie may be null (for work the
+     * engine performs on its own behalf), in which case nothing is traced.
+     */
     ScopedTracer(const void* cookie, const cb::tracing::TraceCode code)
-        : ScopedTracer(*reinterpret_cast<Cookie*>(const_cast<void*>(cookie)),
-                       code) {
+        : cookie(reinterpret_cast<Cookie*>(const_cast<void*>(cookie))) {
+        if (this->cookie && this->cookie->isTracingEnabled()) {
+            spanId = this->cookie->getTracer().begin(code);
+        }
     }
 
     ~ScopedTracer() {
-        if (cookie.isTracingEnabled()) {
-            cookie.getTracer().end(spanId);
+        if (cookie && cookie->isTracingEnabled()) {
+            cookie->getTracer().end(spanId);
         }
     }
 
 protected:
-    Cookie& cookie;
+    Cookie* cookie;
 
     /// ID of our Span.
     cb::tracing::Tracer::SpanId spanId = {};
@@ -83,16 +88,18 @@ public:
         }
     }
 
-    /// Constructor from Cookie (void*)
+    /// Constructor from Cookie (void*); nothing is traced for a null cookie.
     InstantTracer(const void* cookie,
                   const cb::tracing::TraceCode code,
                   bool begin,
                   std::chrono::steady_clock::time_point time =
-                          std::chrono::steady_clock::now())
-        : InstantTracer(*reinterpret_cast<Cookie*>(const_cast<void*>(cookie)),
-                        code,
-                        begin,
-                        time) {
+                          std::chrono::steady_clock::now()) {
+        if (cookie) {
+            InstantTracer(*reinterpret_cast<Cookie*>(const_cast<void*>(cookie)),
+                          code,
+                          begin,
+                          time);
+        }
     }
 };
 
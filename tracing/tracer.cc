@@ -155,6 +155,14 @@ MEMCACHED_PUBLIC_API std::string to_string(
         return "set.with.meta";
     case TraceCode::STORE:
         return "store";
+    case TraceCode::HT_LOCK:
+        return "ht.lock";
+    case TraceCode::QUEUE_DIRTY:
+        return "queue.dirty";
+    case TraceCode::COMPRESS:
+        return "compress";
+    case TraceCode::SYNC_WRITE:
+        return "sync.write";
     }
     return "unknown tracecode";
 }
@@ -16,6 +16,7 @@
  */
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 #include <memcached/visibility.h>
@@ -35,7 +36,18 @@ enum class TraceCode : uint8_t {
     GETSTATS,
     SETWITHMETA,
     STORE,
+    /// Time spent locking (and searching) the hash bucket of a document.
+    HT_LOCK,
+    /// Time spent queueing a mutation into the checkpoint.
+    QUEUE_DIRTY,
+    /// Time spent compressing a value.
+    COMPRESS,
+    /// Time from a SyncWrite being prepared until it is committed / aborted.
+    SYNC_WRITE,
 };
+
+/// The number of TraceCodes (for per-code arrays).
+const size_t NumTraceCodes = size_t(TraceCode::SYNC_WRITE) + 1;
 } // namespace tracing
 } // namespace cb
 
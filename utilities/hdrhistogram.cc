@@ -306,6 +306,23 @@ std::string HdrHistogram::to_string() {
     return to_json().dump();
 }
 
+cb::metrics::HistogramData HdrHistogram::getMetricsData() const {
+    cb::metrics::HistogramData data;
+    data.count = getValueCount();
+    if (data.count == 0) {
+        return data;
+    }
+    data.sum = getMean() * data.count;
+
+    auto iter = makeLogIterator(1, 2);
+    uint64_t cumulative = 0;
+    while (auto bucket = getNextBucketLowHighAndCount(iter)) {
+        cumulative += std::get<2>(*bucket);
+        data.buckets.emplace_back(double(std::get<1>(*bucket)), cumulative);
+    }
+    return data;
+}
+
 size_t HdrHistogram::getMemFootPrint() const {
     return hdr_get_memory_size(histogram.get()) + sizeof(HdrHistogram);
 }
@@ -18,6 +18,7 @@
 #pragma once
 
 #include <boost/optional/optional_fwd.hpp>
+#include <memcached/metrics.h>
 #include <nlohmann/json_fwd.hpp>
 #include <platform/histogram.h>
 #include <chrono>
@@ -293,6 +294,13 @@ public:
      */
     std::string to_string();
 
+    /**
+     * Get the histogram's data to add to a cb::metrics::Collector, with
+     * buckets whose upper bounds are powers of two (so that the buckets
+     * exported don't change from one collection to the next).
+     */
+    cb::metrics::HistogramData getMetricsData() const;
+
     /**
      * Method to get the total amount of memory being used by this histogram
      * @return number of bytes being used by this histogram
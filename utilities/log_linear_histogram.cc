@@ -0,0 +1,213 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include "log_linear_histogram.h"
+
+#include <folly/lang/Bits.h>
+#include <nlohmann/json.hpp>
+
+#include <cmath>
+#include <memory>
+
+const size_t LogLinearHistogram::SubBucketBits;
+const size_t LogLinearHistogram::SubBucketCount;
+const size_t LogLinearHistogram::NumBlocks;
+
+LogLinearHistogram& LogLinearHistogram::operator=(
+        const LogLinearHistogram& other) {
+    if (this != &other) {
+        reset();
+        *this += other;
+    }
+    return *this;
+}
+
+LogLinearHistogram::~LogLinearHistogram() {
+    for (auto& block : blocks) {
+        delete block.load(std::memory_order_relaxed);
+    }
+}
+
+LogLinearHistogram& LogLinearHistogram::operator+=(
+        const LogLinearHistogram& other) {
+    for (size_t ii = 0; ii < NumBlocks; ++ii) {
+        const auto* counts = other.blocks[ii].load(std::memory_order_acquire);
+        if (counts == nullptr) {
+            continue;
+        }
+        Block* mine = nullptr;
+        for (size_t sub = 0; sub < SubBucketCount; ++sub) {
+            const auto count =
+                    counts->counts[sub].load(std::memory_order_relaxed);
+            if (count != 0) {
+                if (mine == nullptr) {
+                    mine = &getBlock(ii);
+                }
+                mine->counts[sub].fetch_add(count, std::memory_order_relaxed);
+            }
+        }
+    }
+    sum.fetch_add(other.sum.load(std::memory_order_relaxed),
+                  std::memory_order_relaxed);
+    return *this;
+}
+
+void LogLinearHistogram::addValue(uint64_t value, uint64_t count) {
+    size_t block = 0;
+    size_t sub = value;
+    if (value >= SubBucketCount) {
+        // The index of the most significant bit, >= SubBucketBits
+        const size_t msb = folly::findLastSet(value) - 1;
+        block = msb - SubBucketBits + 1;
+        if (block < NumBlocks) {
+            sub = (value >> (msb - SubBucketBits)) & (SubBucketCount - 1);
+        } else {
+            block = NumBlocks - 1;
+            sub = SubBucketCount - 1;
+        }
+    }
+    getBlock(block).counts[sub].fetch_add(count, std::memory_order_relaxed);
+    sum.fetch_add(value * count, std::memory_order_relaxed);
+}
+
+LogLinearHistogram::Block& LogLinearHistogram::getBlock(size_t block) {
+    auto* ret = blocks[block].load(std::memory_order_acquire);
+    if (ret == nullptr) {
+        auto created = std::make_unique<Block>();
+        if (blocks[block].compare_exchange_strong(ret,
+                                                  created.get(),
+                                                  std::memory_order_acq_rel,
+                                                  std::memory_order_acquire)) {
+            ret = created.release();
+        }
+        // else another thread installed the block first, and ret is it
+    }
+    return *ret;
+}
+
+uint64_t LogLinearHistogram::getValueCount() const {
+    uint64_t total = 0;
+    forEachBucket([&total](uint64_t, uint64_t, uint64_t count) {
+        total += count;
+    });
+    return total;
+}
+
+double LogLinearHistogram::getMean() const {
+    const auto total = getValueCount();
+    if (total == 0) {
+        return 0;
+    }
+    return double(sum.load(std::memory_order_relaxed)) / double(total);
+}
+
+uint64_t LogLinearHistogram::getValueAtPercentile(double percentage) const {
+    const auto total = getValueCount();
+    if (total == 0) {
+        return 0;
+    }
+    percentage = std::min(std::max(percentage, 0.0), 100.0);
+    const auto target = std::max(
+            uint64_t(1), uint64_t(std::ceil(percentage * total / 100.0)));
+    uint64_t cumulative = 0;
+    uint64_t ret = 0;
+    bool found = false;
+    forEachBucket([&](uint64_t, uint64_t high, uint64_t count) {
+        if (!found) {
+            cumulative += count;
+            ret = high - 1;
+            found = cumulative >= target;
+        }
+    });
+    return ret;
+}
+
+void LogLinearHistogram::reset() {
+    for (auto& block : blocks) {
+        auto* counts = block.load(std::memory_order_acquire);
+        if (counts != nullptr) {
+            for (auto& count : counts->counts) {
+                count.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+    sum.store(0, std::memory_order_relaxed);
+}
+
+nlohmann::json LogLinearHistogram::to_json() const {
+    static const size_t NumBuckets = NumBlocks * SubBucketCount;
+    std::array<uint64_t, NumBuckets> counts{};
+    uint64_t total = 0;
+    for (size_t block = 0; block < NumBlocks; ++block) {
+        const auto* values = blocks[block].load(std::memory_order_acquire);
+        if (values != nullptr) {
+            for (size_t sub = 0; sub < SubBucketCount; ++sub) {
+                const auto count =
+                        values->counts[sub].load(std::memory_order_relaxed);
+                counts[block * SubBucketCount + sub] = count;
+                total += count;
+            }
+        }
+    }
+
+    nlohmann::json ret;
+    if (total == 0) {
+        return ret;
+    }
+
+    size_t first = 0;
+    while (counts[first] == 0) {
+        ++first;
+    }
+    size_t last = NumBuckets - 1;
+    while (counts[last] == 0) {
+        --last;
+    }
+
+    // Each data entry only holds the high value of its bucket, so the
+    // empty buckets between the first and last are included too.
+    ret["total"] = total;
+    ret["bucketsLow"] =
+            getBucketLow(first / SubBucketCount, first % SubBucketCount);
+    auto data = nlohmann::json::array();
+    uint64_t cumulative = 0;
+    for (size_t ii = first; ii <= last; ++ii) {
+        const auto block = ii / SubBucketCount;
+        cumulative += counts[ii];
+        data.push_back({getBucketLow(block, ii % SubBucketCount) +
+                                getBucketWidth(block),
+                        counts[ii],
+                        double(cumulative) * 100.0 / double(total)});
+    }
+    ret["data"] = data;
+    return ret;
+}
+
+std::string LogLinearHistogram::to_string() const {
+    const auto json = to_json();
+    return json.is_null() ? std::string("{}") : json.dump();
+}
+
+size_t LogLinearHistogram::getMemFootPrint() const {
+    size_t ret = sizeof(*this);
+    for (const auto& block : blocks) {
+        if (block.load(std::memory_order_relaxed) != nullptr) {
+            ret += sizeof(Block);
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,158 @@
+/* -*- Mode: C++; tab-width: 4; c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/*
+ *     Copyright 2019 Couchbase, Inc
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#pragma once
+
+#include <nlohmann/json_fwd.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * A compact, mergeable histogram for where there are many histograms (for
+ * instance one per task type, vbucket or collection) and a HdrHistogram of
+ * several KB each costs too much.
+ *
+ * Values are counted in log-linear buckets: each power of two is split in
+ * SubBucketCount linear sub-buckets (so any value is within 1/SubBucketCount
+ * of its bucket), and values below SubBucketCount are counted exactly. The
+ * counts of a power of two are in a Block which is only allocated when a
+ * value is first recorded in it, so an unused histogram costs little more
+ * than its array of block pointers and a typical latency histogram only a
+ * handful of cache lines.
+ *
+ * Recording is lock-free (relaxed atomic increments, and a compare-exchange
+ * to install a new block), so a histogram may be updated from any number of
+ * threads; histograms recorded separately (e.g. per thread) are merged with
+ * operator+=.
+ */
+class LogLinearHistogram {
+public:
+    static const size_t SubBucketBits = 3;
+    static const size_t SubBucketCount = size_t(1) << SubBucketBits;
+
+    /**
+     * The number of blocks: block 0 counts the values below SubBucketCount
+     * and block N the values in [2^(N+SubBucketBits-1), 2^(N+SubBucketBits))
+     * - so values up to 2^34 (~4.7 hours in microseconds) are tracked, and
+     * any larger value is counted in the last bucket.
+     */
+    static const size_t NumBlocks = 32;
+
+    LogLinearHistogram() = default;
+
+    LogLinearHistogram(const LogLinearHistogram& other) {
+        *this += other;
+    }
+
+    LogLinearHistogram& operator=(const LogLinearHistogram& other);
+
+    ~LogLinearHistogram();
+
+    /// Add the counts of another histogram to this one
+    LogLinearHistogram& operator+=(const LogLinearHistogram& other);
+
+    void addValue(uint64_t value, uint64_t count = 1);
+
+    uint64_t getValueCount() const;
+
+    double getMean() const;
+
+    /**
+     * @return the highest value which is equivalent to (in the same bucket
+     *         as) the value at the given percentile, or 0 if empty
+     */
+    uint64_t getValueAtPercentile(double percentage) const;
+
+    /**
+     * Clear the counts. The blocks remain allocated, as other threads may be
+     * recording in them.
+     */
+    void reset();
+
+    /**
+     * Call callback(low, high, count) for each bucket with a non-zero
+     * count, in increasing order of value; the bucket counts the values in
+     * [low, high).
+     */
+    template <typename Callback>
+    void forEachBucket(Callback&& callback) const {
+        for (size_t block = 0; block < NumBlocks; ++block) {
+            const auto* counts = blocks[block].load(std::memory_order_acquire);
+            if (counts == nullptr) {
+                continue;
+            }
+            for (size_t sub = 0; sub < SubBucketCount; ++sub) {
+                const auto count =
+                        counts->counts[sub].load(std::memory_order_relaxed);
+                if (count != 0) {
+                    const auto low = getBucketLow(block, sub);
+                    callback(low, low + getBucketWidth(block), count);
+                }
+            }
+        }
+    }
+
+    /**
+     * Get the histogram in the same JSON format as HdrHistogram::to_json()
+     * (so it can be displayed by mctimings), with one data entry per bucket
+     * from the lowest to the highest non-empty one.
+     */
+    nlohmann::json to_json() const;
+
+    std::string to_string() const;
+
+    /// @return the memory used by the histogram, including its blocks
+    size_t getMemFootPrint() const;
+
+    /// @return the lowest value of the given bucket
+    static uint64_t getBucketLow(size_t block, size_t sub) {
+        if (block == 0) {
+            return sub;
+        }
+        return uint64_t(SubBucketCount + sub) << (block - 1);
+    }
+
+    /// @return the number of values counted by each bucket of the block
+    static uint64_t getBucketWidth(size_t block) {
+        return block == 0 ? 1 : uint64_t(1) << (block - 1);
+    }
+
+private:
+    struct Block {
+        std::array<std::atomic<uint64_t>, SubBucketCount> counts{};
+    };
+
+    Block& getBlock(size_t block);
+
+    std::array<std::atomic<Block*>, NumBlocks> blocks{};
+    std::atomic<uint64_t> sum{0};
+};
+
+/// LogLinearHistogram of microsecond durations
+class LogLinearMicroSecHistogram : public LogLinearHistogram {
+public:
+    void add(std::chrono::microseconds v, size_t count = 1) {
+        addValue(uint64_t(std::max(v.count(), decltype(v.count())(0))),
+                 uint64_t(count));
+    }
+};
@@ -95,9 +95,11 @@ cb::char_buffer Blob::get(const cb::const_char_buffer& key) const {
                 // This may be the next key
                 if (blob.buf[current + key.len] == '\0' &&
                     std::memcmp(blob.buf + current, key.buf, key.len) == 0) {
-                    // Yay this is the key!!!
+                    // Yay this is the key!!! The kv-pair length tells us
+                    // the length of the value (so we don't need to scan
+                    // through it)
                     auto* value = blob.buf + current + key.len + 1;
-                    return {value, strlen(value)};
+                    return {value, size - key.len - 2};
                 } else {
                     // jump to the next key!!
                     current += size;
@@ -114,19 +116,39 @@ cb::char_buffer Blob::get(const cb::const_char_buffer& key) const {
 }
 
 void Blob::prune_user_keys() {
+    if (blob.len == 0) {
+        return;
+    }
+
+    // Move the system xattrs down over the user xattrs in a single pass
+    // (rather than moving the rest of the blob for every user xattr)
+    size_t current = 4;
+    size_t next = 4;
     try {
-        size_t current = 4;
         while (current < blob.len) {
             // Get the length of the next kv-pair
-            const auto size = read_length(current);
+            const auto size = read_length(current) + 4;
 
-            if (blob.buf[current + 4] != '_') {
-                remove_segment(current, size + 4);
-            } else {
-                current += 4 + size;
+            if (blob.buf[current + 4] == '_') {
+                if (next != current) {
+                    std::memmove(blob.buf + next, blob.buf + current, size);
+                }
+                next += size;
             }
+            current += size;
         }
     } catch (const std::out_of_range&) {
+        // Keep whatever we failed to parse
+        std::memmove(blob.buf + next, blob.buf + current, blob.len - current);
+        next += blob.len - current;
+    }
+
+    if (next == 4) {
+        // the last xattr removed... we could just nuke it..
+        blob.len = 0;
+    } else {
+        blob.len = next;
+        write_length(0, gsl::narrow<uint32_t>(blob.len) - 4);
     }
 }
 